@@ -252,21 +252,13 @@ void stetmesh::DiffBoundary::setID(std::string const & id)
 
 std::vector<bool> stetmesh::DiffBoundary::isTriInside(std::vector<uint> tri) const
 {
+	// The mesh records the diffusion boundary of each triangle.
 	uint notris = tri.size();
+	uint ntris = pTetmesh->countTris();
 	std::vector<bool> inside(notris);
 	for (uint i=0; i < notris; ++i)
 	{
-		bool triinside = false;
-		for (uint j=0; j< pTri_indices.size() ; ++j)
-		{
-			if (tri[i] == pTri_indices[j])
-			{
-				triinside = true;
-				break;
-			}
-		}
-		if (triinside == true) inside[i] = true;
-		else inside[i] = false;
+		inside[i] = (tri[i] < ntris && pTetmesh->getTriDiffBoundary(tri[i]) == this);
 	}
 	return inside;
 }
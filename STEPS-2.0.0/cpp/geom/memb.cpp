@@ -25,15 +25,16 @@
 // STL headers.
 #include <cassert>
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <vector>
 #include <sstream>
 #include <string>
-#include <queue>
-#include <set>
 
 // STEPS headers.
 #include "../common.h"
 #include "../error.hpp"
+#include "../meshcache.hpp"
 #include "memb.hpp"
 #include "tri.hpp"
 #include "tmpatch.hpp"
@@ -49,6 +50,7 @@ stetmesh::Memb::Memb(std::string const & id, Tetmesh * container,
 : pID(id)
 , pTetmesh(container)
 , pTri_indices()
+, pTri_inside()
 , pTrivirt_indices()
 , pTet_indices()
 , pVert_indices()
@@ -73,30 +75,34 @@ stetmesh::Memb::Memb(std::string const & id, Tetmesh * container,
   	    throw steps::ArgErr(os.str());
     }
 
-    if (pOpt_method != 1 and pOpt_method != 2)
+    if (pOpt_method < 1 || pOpt_method > 5)
     {
     	std::ostringstream os;
-		os << "Unknown optimization method. Choices are 1 or 2.\n";
+		os << "Unknown optimization method. Choices are 1, 2, 3, 4 or 5.\n";
 		throw steps::ArgErr(os.str());
     }
 
-    // BUGFIX, IH: This should be a set because the patches can share an inner compartment,
-    // which would otherwise result in multiple occurances of tets
-    std::set<uint> tets_set = std::set<uint>();
+    // BUGFIX, IH: The patches can share an inner compartment, so tets are
+    // marked rather than appended, which would otherwise result in
+    // multiple occurances of tets.
+    uint ntets = pTetmesh->countTets();
+    std::vector<bool> in_vol(ntets, false);
 
     std::vector<TmPatch *>::const_iterator p_end = patches.end();
     for (std::vector<TmPatch *>::const_iterator p = patches.begin(); p != p_end; ++p)
     {
-    	std::vector<uint> tris_temp = (*p)->getAllTriIndices();
+    	std::vector<uint> const & tris_temp = (*p)->_getAllTriIndices();
     	pTri_indices.insert(pTri_indices.end(), tris_temp.begin(), tris_temp.end());
     	pTrisN += tris_temp.size();
 
     	if (stetmesh::TmComp * comp_temp = dynamic_cast<stetmesh::TmComp *>((*p)->getIComp()))
     	{
-    		std::vector<uint> tets_temp = comp_temp->getAllTetIndices();
-    		tets_set.insert(tets_temp.begin(), tets_temp.end());
-			//pTet_indices.insert(pTet_indices.end(), tets_temp.begin(), tets_temp.end());
-    		//pTetsN += tets_temp.size();
+    		std::vector<uint> const & tets_temp = comp_temp->_getAllTetIndices();
+    		std::vector<uint>::const_iterator t_end = tets_temp.end();
+    		for (std::vector<uint>::const_iterator t = tets_temp.begin(); t != t_end; ++t)
+    		{
+    			in_vol[*t] = true;
+    		}
     	}
     	else
     	{
@@ -107,397 +113,339 @@ stetmesh::Memb::Memb(std::string const & id, Tetmesh * container,
     	}
     }
 
-    pTetsN = tets_set.size();
-
-    pTet_indices.resize(pTetsN);
-
-    std::copy(tets_set.begin(), tets_set.end(), pTet_indices.begin());
+    for (uint t = 0; t < ntets; ++t)
+    {
+    	if (in_vol[t] == true) pTet_indices.push_back(t);
+    }
+    pTetsN = pTet_indices.size();
 
     assert (pTrisN == pTri_indices.size());
     assert(pTetsN == pTet_indices.size());
 
+    pTri_inside.assign(pTetmesh->countTris(), false);
+    for (uint i = 0; i < pTrisN; ++i) pTri_inside[pTri_indices[i]] = true;
+
+    if (verify) _verifyCached(in_vol);
+
+    _setupVerts();
+
+    pTetmesh->_handleMembAdd(this);
+}
 
-    /* Previous code with user-given triangle indices
-    // The maximum triangle index in tetrahedral mesh
-    uint maxidx = (pTetmesh->countTris() -1);
+////////////////////////////////////////////////////////////////////////////////
 
-    for (uint i=0; i <tris.size(); ++i)
+stetmesh::Memb::Memb(std::string const & id, Tetmesh * container,
+					 std::vector<uint> const & tris,
+					 std::vector<uint> const & tets,
+					 std::vector<uint> const & trivirts,
+					 bool open, uint opt_method, std::string const & opt_file_name)
+: pID(id)
+, pTetmesh(container)
+, pTri_indices(tris)
+, pTri_inside()
+, pTrivirt_indices(trivirts)
+, pTet_indices(tets)
+, pVert_indices()
+, pTrisN(tris.size())
+, pTetsN(tets.size())
+, pTriVirtsN(trivirts.size())
+, pVertsN(0)
+, pOpen(open)
+, pOpt_method(opt_method)
+, pOpt_file_name(opt_file_name)
+{
+    assert(pTetmesh != 0);
+
+    uint ntris = pTetmesh->countTris();
+    uint ntets = pTetmesh->countTets();
+    for (uint i = 0; i < pTrisN; ++i)
     {
-    	// perform some checks on this triangle
-    	bool included = false;
-    	for(uint j = 0; j <pTrisN; ++j)
+    	if (pTri_indices[i] >= ntris)
     	{
-    		// check if tri has already occured in this list (duplicate)
-    		if (tris[i] == pTri_indices[j])
-    		{
-    			included = true;
-    			break;
-    		}
+    		std::ostringstream os;
+    		os << "Invalid index supplied for triangle #" << i << " in list.";
+    		throw steps::ArgErr(os.str());
     	}
-    	if (included == true) continue;
-
-    	if (tris[i] > maxidx)
+    }
+    for (uint i = 0; i < pTriVirtsN; ++i)
+    {
+    	if (pTrivirt_indices[i] >= ntris)
     	{
     		std::ostringstream os;
-    		os << "Invalid index supplied for triangle #" << i << " in list.";
+    		os << "Invalid index supplied for virtual triangle #" << i << " in list.";
     		throw steps::ArgErr(os.str());
     	}
-
-		// add the triangle to this patch
-		pTri_indices.push_back(tris[i]);
-		++pTrisN;
-	}
-	*/
-
-    if (verify)
+    }
+    for (uint i = 0; i < pTetsN; ++i)
     {
-    	std::ostringstream os;
-    	os << "Verifying membrane. This can take some time...\n";
-    	// Now perform some checks on the triangle and print warning if surface is open, or has more than 3 neighbours
-    	std::vector<uint>::const_iterator tri_end = pTri_indices.end();
-    	for (std::vector<uint>::const_iterator tri = pTri_indices.begin(); tri != tri_end; ++tri)
+    	if (pTet_indices[i] >= ntets)
     	{
-    		uint neighbours = 0;
+    		std::ostringstream os;
+    		os << "Invalid index supplied for tetrahedron #" << i << " in list.";
+    		throw steps::ArgErr(os.str());
+    	}
+    }
 
-    		// Fetch all triangle neighbours- we don't know how many neighbours there are
-    		std::set<uint> tritrineighbs = pTetmesh->getTriTriNeighbs(*(tri));
+    pTri_inside.assign(ntris, false);
+    for (uint i = 0; i < pTrisN; ++i) pTri_inside[pTri_indices[i]] = true;
 
-    		std::vector<uint>::const_iterator t_end = pTri_indices.end();
-    		for (std::vector<uint>::const_iterator t = pTri_indices.begin(); t != t_end; ++t)
-    		{
-    			// continue of this is the same triangle
-    			if ((*t) == (*tri)) continue;
-    			if (tritrineighbs.find(*t) != tritrineighbs.end()) neighbours +=1;
-    		}
+    _setupVerts();
 
-    		// If 3 neighbours weren't found this is not a closed surface
-    		// MOST SURFACE TRIANGLES WILL HAVE 3 NEIGHBOURS, BUT
-    		// IF A TRIANGLE IS ON A SHARP EDGE IT CAN HAVE 5 OR EVEN 7 NEIGHBOURS
-    		if ((!open()) && neighbours < 3)
-    		{
-    			os << "WARNING: Triangular surface provided to Membrane initializer function";
-    			os << " is thought to be an open surface.\n";
-    			pOpen = true;
-    			// throw steps::ArgErr(os.str());
-    		}
-    		// What can we say if tri has more than 3 neighbours? Probably a bad surface, though with particularly
-    		// 'pointed' regions neighbours can be 5, 7, or even higher even number and still
-    		// be a closed surface. If one of these triangles further happens to be on an edge
-    		// may have 4, 6, or higher even number, though these numbers would usually
-    		// suggest a bad surface. However, don't complain yet- perform the multiple surface
-    		// test later to catch that.
-    		if (neighbours > 3)
-    		{
-    			os << "WARNING: Triangle " << (*tri) << " has " << neighbours << " neighbours.\n";
-    		}
+    pTetmesh->_handleMembAdd(this);
+}
 
-    		/*
-			// If neighbours are even, this is a bad mesh.
-			else if (neighbours > 3 && neighbours%2 == 0 )
-			{
-				std::ostringstream os;
-				os << "Triangular surface provided to Membrane initializer function";
-				os << " is thought to be an open surface.";
-				throw steps::ArgErr(os.str());
-			}
-    		 */
-    	}
+////////////////////////////////////////////////////////////////////////////////
 
+// Union-find over local indices: return the root of i, halving the path.
+static uint uf_find(std::vector<uint> & parent, uint i)
+{
+	while (parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
 
-    	// Now to perform a basic multiple surfaces test
+////////////////////////////////////////////////////////////////////////////////
 
-    	// Create the queue of triangles- each triangle's neighbours will be
-    	// added to the queue only once
-    	std::queue<uint> tri_queue;
-		// Let's start with the zeroth element
-		tri_queue.push(pTri_indices[0]);
+// Merge the sets of a and b, keeping the smaller root.
+static void uf_union(std::vector<uint> & parent, uint a, uint b)
+{
+	a = uf_find(parent, a);
+	b = uf_find(parent, b);
+	if (a < b) parent[b] = a;
+	else if (b < a) parent[a] = b;
+}
 
-		// Create the set of triangle neighbours. If this set contains all triangle
-		// indices at the end of the loop, this is a single closed surface
-		std::set<uint> tri_set;
+////////////////////////////////////////////////////////////////////////////////
 
-		while (! tri_queue.empty())
+// Join the triangles tris[i] (by local index i) that share a bar.
+static void uf_join_tris(stetmesh::Tetmesh * mesh, std::vector<uint> const & tris,
+						 std::vector<uint> & parent)
+{
+	// The first triangle found on a bar, plus one, 0 if none yet.
+	std::vector<uint> barfirst(mesh->countBars(), 0);
+	uint ntris = tris.size();
+	parent.resize(ntris);
+	for (uint i = 0; i < ntris; ++i)
+	{
+		parent[i] = i;
+		uint * bars = mesh->_getTriBars(tris[i]);
+		for (uint j = 0; j < 3; ++j)
 		{
-			uint triidx = tri_queue.front();
-			std::set<uint> trineighbs = pTetmesh->getTriTriNeighbs(triidx);
-			std::vector<uint>::const_iterator t_end = pTri_indices.end();
-			for (std::vector<uint>::const_iterator t = pTri_indices.begin(); t != t_end; ++t)
-			{
-				// continue if this is the same triangle
-				if ((*t) == triidx) continue;
-				if (trineighbs.find(*t) != trineighbs.end())
-				{
-					// A triangle's neighbour. Now need to check if it is already in the queue
-					if (tri_set.find((*t)) == tri_set.end())
-					{
-						tri_queue.push(*t);
-						tri_set.insert(*t);
-					}
-				}
-			}
-			tri_queue.pop();
+			if (barfirst[bars[j]] == 0) barfirst[bars[j]] = i + 1;
+			else uf_union(parent, barfirst[bars[j]] - 1, i);
 		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
 
-		if (tri_set.size() != pTri_indices.size())
+void stetmesh::Memb::_verify(std::vector<bool> const & in_vol)
+{
+	uint ntets = pTetmesh->countTets();
+
+	// A triangle's neighbours are the other membrane triangles on its
+	// three bars. If 3 neighbours weren't found this is not a closed surface.
+	// MOST SURFACE TRIANGLES WILL HAVE 3 NEIGHBOURS, BUT
+	// IF A TRIANGLE IS ON A SHARP EDGE IT CAN HAVE 5 OR EVEN 7 NEIGHBOURS
+	std::vector<uint> barcount(pTetmesh->countBars(), 0);
+	for (uint i = 0; i < pTrisN; ++i)
+	{
+		uint * bars = pTetmesh->_getTriBars(pTri_indices[i]);
+		for (uint j = 0; j < 3; ++j) ++barcount[bars[j]];
+	}
+	for (uint i = 0; i < pTrisN; ++i)
+	{
+		uint * bars = pTetmesh->_getTriBars(pTri_indices[i]);
+		uint neighbours = barcount[bars[0]] + barcount[bars[1]] + barcount[bars[2]] - 3;
+		if (neighbours < 3) pOpen = true;
+	}
+
+	// Now to perform a basic multiple surfaces test: this is a single
+	// surface if all triangles are joined to the zeroth.
+	std::vector<uint> parent;
+	uf_join_tris(pTetmesh, pTri_indices, parent);
+	for (uint i = 0; i < pTrisN; ++i)
+	{
+		if (uf_find(parent, i) != 0)
 		{
 			std::ostringstream os;
 			os << "Triangular surface provided to Membrane initializer function";
 			os << " is a multiple surface.\n";
 			throw steps::ArgErr(os.str());
 		}
+	}
 
-
-		/* Previous code when conduction volume was explicitly given by the user
-		// Now perform checks on the conduction volume.
-		// The maximum tetrahedron index in tetrahedral mesh
-		uint maxtetidx = (pTetmesh->countTets() -1);
-
-		for (uint i=0; i < vol_tets.size(); ++i)
+	// Test that all triangles have one tetrahedron neighbour in the volume.
+	for (uint i = 0; i < pTrisN; ++i)
+	{
+		int * tritetneighbs = pTetmesh->_getTriTetNeighb(pTri_indices[i]);
+		uint tetneighbours = 0;
+		for (uint j = 0; j < 2; ++j)
 		{
-			// perform some checks on this triangle
-			bool included = false;
-			for(uint j = 0; j <pTetsN; ++j)
-			{
-				// check if tet has already occured in this list (duplicate)
-				if (vol_tets[i] == pTet_indices[j])
-				{
-					included = true;
-					break;
-				}
-			}
-			if (included == true) continue;
-
-			if (vol_tets[i] > maxtetidx)
-			{
-				std::ostringstream os;
-				os << "Invalid index supplied for tetrahedron #" << i << " in list.";
-				throw steps::ArgErr(os.str());
-			}
-
-			// add the triangle to this patch
-			pTet_indices.push_back(vol_tets[i]);
-			++pTetsN;
+			if (tritetneighbs[j] >= 0 && in_vol[tritetneighbs[j]] == true) tetneighbours += 1;
 		}
-		 */
-
 
-		// Loop over all triangles and test that all triangles have one tetrahedron
-		// neighbour in the volume.
-		tri_end = pTri_indices.end();
-		for (std::vector<uint>::const_iterator tri = pTri_indices.begin(); tri != tri_end; ++tri)
+		if (tetneighbours < 1)
 		{
-			uint tetneighbours = 0;
-			// Fetch the two triangle tet neighbours
-			int * tritetneighbs = pTetmesh->_getTriTetNeighb(*(tri));
-
-			std::vector<uint>::const_iterator t_end = pTet_indices.end();
-			for (std::vector<uint>::const_iterator t = pTet_indices.begin(); t!= t_end; ++t)
-			{
-				if (tritetneighbs[0] == (*t) || tritetneighbs[1] == (*t)) tetneighbours+=1;
-			}
-
-			if (tetneighbours < 1)
-			{
-				std::ostringstream os;
-				os << "Conduction volume provided to Membrane initializer function";
-				os << " is not connected to membrane triangle # " << (*tri) << "\n";
-				throw steps::ArgErr(os.str());
-			}
-			if (tetneighbours > 1)
-			{
-				std::ostringstream os;
-				os << "Conduction volume provided to Membrane initializer function";
-				os << " is connected twice to membrane triangle # " << (*tri) << "\n";
-				throw steps::ArgErr(os.str());
-			}
+			std::ostringstream os;
+			os << "Conduction volume provided to Membrane initializer function";
+			os << " is not connected to membrane triangle # " << pTri_indices[i] << "\n";
+			throw steps::ArgErr(os.str());
 		}
+		if (tetneighbours > 1)
+		{
+			std::ostringstream os;
+			os << "Conduction volume provided to Membrane initializer function";
+			os << " is connected twice to membrane triangle # " << pTri_indices[i] << "\n";
+			throw steps::ArgErr(os.str());
+		}
+	}
 
-		// Now perform the 'multiple volume' test
-
-		// Create the queue of tetrahedrons- each tetrahedrons' neighbours
-		// will be added to the queue only once
-		std::queue<uint> tet_queue;
-		// Start with the zeroth element
-		tet_queue.push(pTet_indices[0]);
-
-		// Create the set of tetrahedron's neighbours. If this set contains all
-		// tetrahedrons at the end of the loop, this is a single volume.
-		std::set<uint> tet_set;
-
-		while(! tet_queue.empty())
+	// Now perform the 'multiple volume' test, joining neighbouring tets
+	// of the volume by their local index in pTet_indices.
+	std::vector<uint> tetlocal(ntets, 0);
+	for (uint i = 0; i < pTetsN; ++i) tetlocal[pTet_indices[i]] = i;
+	parent.resize(pTetsN);
+	for (uint i = 0; i < pTetsN; ++i) parent[i] = i;
+	for (uint i = 0; i < pTetsN; ++i)
+	{
+		int * tetneighbs = pTetmesh->_getTetTetNeighb(pTet_indices[i]);
+		for (uint j = 0; j < 4; ++j)
 		{
-			uint tetidx = tet_queue.front();
-			int * tetneighbs = pTetmesh->_getTetTetNeighb(tetidx);
-			std::vector<uint>::const_iterator t_end = pTet_indices.end();
-			for (std::vector<uint>::const_iterator t = pTet_indices.begin(); t != t_end; ++t)
+			if (tetneighbs[j] >= 0 && in_vol[tetneighbs[j]] == true)
 			{
-				// continue if this is the same tet
-				if ((*t) == tetidx) continue;
-				for (uint i = 0; i < 4; ++i)
-				{
-					if (tetneighbs[i] == (*t))
-					{
-						if (tet_set.find((*t)) == tet_set.end())
-						{
-							tet_queue.push(*t);
-							tet_set.insert(*t);
-						}
-
-						// No need to test other neighbours
-						break;
-					}
-				}
+				uf_union(parent, i, tetlocal[tetneighbs[j]]);
 			}
-			tet_queue.pop();
 		}
-
-		if (tet_set.size() != pTet_indices.size())
+	}
+	for (uint i = 0; i < pTetsN; ++i)
+	{
+		if (uf_find(parent, i) != 0)
 		{
 			std::ostringstream os;
 			os << "Conduction volume provided to Membrane initializer function";
 			os << " is a multiple volume.\n";
 			throw steps::ArgErr(os.str());
 		}
+	}
 
+	// Now to set up the 'virtual membrane triangles'. That is, with an open
+	// surface, we need to know which triangles are in the open region.
+	if (open() == false) return;
 
-		// Now to set up the 'virtual membrane triangles'. That is, with an open
-		// surface, we need to know which triangles are in the open region.
-		if (open())
+	// The candidates are the triangles of the volume's surface tets, in
+	// the direction of no neighbour in the volume, that are not already
+	// in pTri_indices. They follow the membrane triangles in alltris.
+	std::vector<uint> alltris(pTri_indices);
+	for (uint i = 0; i < pTetsN; ++i)
+	{
+		int * tetneighbs = pTetmesh->_getTetTetNeighb(pTet_indices[i]);
+		uint * tettris = pTetmesh->_getTetTriNeighb(pTet_indices[i]);
+		for (uint j = 0; j < 4; ++j)
 		{
-			std::vector<uint> trivirttemp = std::vector<uint>();
-			// Loop over tetrahedrons and add triangles from surface tets that
-			// are not already in pTri_indices
-			std::vector<uint>::const_iterator tet_end = pTet_indices.end();
-			for (std::vector<uint>::const_iterator tet = pTet_indices.begin(); tet != tet_end; ++tet)
-			{
-				// Fetch neighbours
-				std::vector<int> tettetneighbs = pTetmesh->getTetTetNeighb(*tet);
-				// Loop over all tets again and find how many neighbours this tet has.
-				// If it has less than 4 it is a candidate for a surface tet whose
-				// triangle (in the correct direction) makes up part of the
-				// 'virtual surface'
-				std::vector<uint>::const_iterator tettemp_end = pTet_indices.end();
-				bool gotneighb[4] = {false, false, false, false};
-				for (std::vector<uint>::const_iterator tettemp = pTet_indices.begin(); tettemp!= tettemp_end; ++tettemp)
-				{
-					if ((*tettemp) == (*tet)) continue;
-					for (uint i = 0; i < 4; ++i)
-					{
-						if (tettetneighbs[i] == (*tettemp))
-						{
-							assert(gotneighb[i] == false);
-							gotneighb[i] = true;
-							break;
-						}
-					}
-				}
-				// Now need to check if the triangle in this direction is in
-				// pTri_indices
-				std::vector<uint> tettrineighb = pTetmesh->getTetTriNeighb(*tet);
-				for (uint j = 0; j < 4; ++j)
-				{
-					if (gotneighb[j] == false)
-					{
-						// Now need to check if the triangle in this direction is in
-						// pTri_indices
-						tri_end = pTri_indices.end();
-						bool membtri = false;
-						for (std::vector<uint>::const_iterator tri = pTri_indices.begin(); tri != tri_end; ++tri)
-						{
-							if (tettrineighb[j] == *tri)
-							{
-								membtri = true;
-								break;
-							}
-						}
-						if (membtri == false) trivirttemp.push_back(pTetmesh->getTetTriNeighb(*tet)[j]);
-					}
-				}
-			}
-
-			// Ok, let's now go on a little walk and add the correct surface triangles
-			// Create the queue of triangles- each triangle's neighbours will be
-			// added to the queue only once
-			std::queue<uint> tri_queue;
-			// Let's start with the zeroth element
-			tri_queue.push(pTri_indices[0]);
+			if (tetneighbs[j] >= 0 && in_vol[tetneighbs[j]] == true) continue;
+			if (pTri_inside[tettris[j]] == false) alltris.push_back(tettris[j]);
+		}
+	}
 
-			// Create the set of triangle neighbours. This set will contain all the
-			// surface triangles at the end- real and virtual
-			std::set<uint> tri_set;
+	// The virtual triangles are the candidates joined to the membrane.
+	uf_join_tris(pTetmesh, alltris, parent);
+	uint nall = alltris.size();
+	for (uint i = pTrisN; i < nall; ++i)
+	{
+		if (uf_find(parent, i) == 0) pTrivirt_indices.push_back(alltris[i]);
+	}
+	std::sort(pTrivirt_indices.begin(), pTrivirt_indices.end());
+	pTriVirtsN = pTrivirt_indices.size();
+}
 
-			// The virtual triangles, in a set
-			std::set<uint> trivirt_set;
+////////////////////////////////////////////////////////////////////////////////
 
-			while (! tri_queue.empty())
-			{
-				uint triidx = tri_queue.front();
-				std::set<uint> trineighbs = pTetmesh->getTriTriNeighbs(triidx);
-
-				std::vector<uint>::const_iterator t_end = pTri_indices.end();
-				for (std::vector<uint>::const_iterator t = pTri_indices.begin(); t != t_end; ++t)
-				{
-					// continue if this is the same triangle
-					if ((*t) == triidx) continue;
-					if (trineighbs.find(*t) != trineighbs.end())
-					{
-						// A triangle's neighbour. Now need to check if it is already in the queue
-						if (tri_set.find((*t)) == tri_set.end())
-						{
-							tri_queue.push(*t);
-							tri_set.insert(*t);
-						}
-					}
-				}
-				std::vector<uint>::const_iterator tv_end = trivirttemp.end();
-				for (std::vector<uint>::const_iterator tv = trivirttemp.begin(); tv!= tv_end; ++tv)
-				{
-					if ((*tv) == triidx) continue;
-					if (trineighbs.find(*tv) != trineighbs.end())
-					{
-						if (tri_set.find((*tv)) == tri_set.end())
-						{
-							tri_queue.push(*tv);
-							tri_set.insert(*tv);
-							trivirt_set.insert(*tv);
-						}
-					}
-				}
-				tri_queue.pop();
-			}
+void stetmesh::Memb::_verifyCached(std::vector<bool> const & in_vol)
+{
+	if (steps::meshCacheOn() == false)
+	{
+		_verify(in_vol);
+		return;
+	}
 
-			// So trivirt_set holds all the virtual triangles. Just need to copy to
-			// vector
-			std::set<uint>::const_iterator tvset_end = trivirt_set.end();
-			for (std::set<uint>::const_iterator tvset = trivirt_set.begin(); tvset != tvset_end; ++tvset)
-			{
-				pTrivirt_indices.push_back(*tvset);
-			}
+	// The result depends on the mesh topology and the membrane's
+	// triangles and conduction volume.
+	uint version = 1;
+	uint ntris = pTetmesh->countTris();
+	uint ntets = pTetmesh->countTets();
+	steps::ContentHash key;
+	key.add(&version, sizeof(uint));
+	key.add(&ntris, sizeof(uint));
+	key.add(&ntets, sizeof(uint));
+	key.add(pTetmesh->_getTri(0), ntris * 3 * sizeof(uint));
+	key.add(pTetmesh->_getTet(0), ntets * 4 * sizeof(uint));
+	key.add(pTri_indices);
+	key.add(pTet_indices);
+	std::string path = steps::meshCachePath("memb", key, ".bin");
+
+	// A cache file holds whether the surface is open and the virtual
+	// triangles; it is only written once the membrane is verified.
+	if (steps::meshCacheHas(path))
+	{
+		std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+		uint head[2] = {0, 0};
+		in.read(reinterpret_cast<char *>(head), sizeof(head));
+		std::vector<uint> virts(in ? head[1] : 0);
+		if (virts.empty() == false)
+		{
+			in.read(reinterpret_cast<char *>(&virts[0]), virts.size() * sizeof(uint));
+		}
+		bool valid = static_cast<bool>(in) && head[0] <= 1;
+		for (uint i = 0; valid && i < virts.size(); ++i) valid = virts[i] < ntris;
+		if (valid)
+		{
+			pOpen = (head[0] == 1);
+			pTrivirt_indices.swap(virts);
 			pTriVirtsN = pTrivirt_indices.size();
+			return;
 		}
+	}
 
+	_verify(in_vol);
+
+	std::string tmp = steps::meshCacheTemp(path);
+	std::ofstream out(tmp.c_str(), std::ios::out | std::ios::binary);
+	uint head[2] = {pOpen ? 1u : 0u, pTriVirtsN};
+	out.write(reinterpret_cast<char const *>(head), sizeof(head));
+	if (pTriVirtsN != 0)
+	{
+		out.write(reinterpret_cast<char const *>(&pTrivirt_indices[0]),
+		          pTriVirtsN * sizeof(uint));
 	}
-	// Create empty set of vertex indices
-	std::set<uint> vertset = std::set<uint>();
+	out.close();
+	if (out) steps::meshCachePublish(tmp, path);
+	else std::remove(tmp.c_str());
+}
 
-	std::vector<uint>::const_iterator tet_end = pTet_indices.end();
-    for (std::vector<uint>::const_iterator tet = pTet_indices.begin(); tet != tet_end; ++tet)
-    {
-    	uint * tettemp = getContainer()->_getTet(*tet);
-    	for (uint i = 0; i < 4; ++i)
-    	{
-    		vertset.insert(tettemp[i]);
-    	}
-    }
+////////////////////////////////////////////////////////////////////////////////
 
-    std::set<uint>::const_iterator vset_end = vertset.end();
-    for (std::set<uint>::const_iterator vset = vertset.begin(); vset != vset_end; ++vset)
-    {
-    	pVert_indices.push_back(*vset);
-    }
-    pVertsN = pVert_indices.size();
+void stetmesh::Memb::_setupVerts(void)
+{
+	// The vertices of the conduction volume, in index order.
+	uint nverts = pTetmesh->countVertices();
+	std::vector<bool> in_memb(nverts, false);
+	std::vector<uint>::const_iterator tet_end = pTet_indices.end();
+	for (std::vector<uint>::const_iterator tet = pTet_indices.begin(); tet != tet_end; ++tet)
+	{
+		uint * tettemp = pTetmesh->_getTet(*tet);
+		for (uint i = 0; i < 4; ++i) in_memb[tettemp[i]] = true;
+	}
 
-    pTetmesh->_handleMembAdd(this);
+	pVert_indices.clear();
+	for (uint v = 0; v < nverts; ++v)
+	{
+		if (in_memb[v] == true) pVert_indices.push_back(v);
+	}
+	pVertsN = pVert_indices.size();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -515,6 +463,7 @@ void stetmesh::Memb::_handleSelfDelete(void)
 	pTetmesh->_handleMembDel(this);
 
 	pTri_indices.clear();
+	pTri_inside.clear();
 	pTet_indices.clear();
 	pTrivirt_indices.clear();
 	pVert_indices.clear();
@@ -533,20 +482,11 @@ void stetmesh::Memb::_handleSelfDelete(void)
 std::vector<bool> stetmesh::Memb::isTriInside(std::vector<uint> tri) const
 {
 	uint notris = tri.size();
+	uint ntris = pTri_inside.size();
 	std::vector<bool> inside(notris);
 	for (uint i=0; i < notris; ++i)
 	{
-		bool triinside = false;
-		for (uint j=0; j< pTri_indices.size() ; ++j)
-		{
-			if (tri[i] == pTri_indices[j])
-			{
-				triinside = true;
-				break;
-			}
-		}
-		if (triinside == true) inside[i] = true;
-		else inside[i] = false;
+		inside[i] = (tri[i] < ntris && pTri_inside[tri[i]]);
 	}
 	return inside;
 }
@@ -233,11 +233,47 @@ private:
 
 	////////////////////////////////////////////////////////////////////////
 
+	friend Tetmesh * loadBinary(std::string pathname, bool shared);
+
+	/// Constructor from a known topology, as stored by saveBinary.
+	/// No verification is performed.
+	///
+	/// \param id ID of the membrane.
+	/// \param container Pointer to the Tetmesh container.
+	/// \param tris Indices of the membrane triangles.
+	/// \param tets Indices of the conduction volume tetrahedrons, sorted.
+	/// \param trivirts Indices of the virtual triangles, sorted.
+	/// \param open Whether the surface is open.
+	///
+	Memb(std::string const & id, Tetmesh * container,
+		 std::vector<uint> const & tris, std::vector<uint> const & tets,
+		 std::vector<uint> const & trivirts, bool open,
+		 uint opt_method, std::string const & opt_file_name);
+
+	/// Closed-surface, single-surface and single-volume tests and, for an
+	/// open surface, the virtual triangles. in_vol marks the tetrahedrons
+	/// of the conduction volume.
+	///
+	void _verify(std::vector<bool> const & in_vol);
+
+	/// _verify, or its result read from the mesh cache if there is one.
+	///
+	void _verifyCached(std::vector<bool> const & in_vol);
+
+	/// Collect the vertices of the conduction volume.
+	///
+	void _setupVerts(void);
+
+	////////////////////////////////////////////////////////////////////////
+
 	std::string                         pID;
 	Tetmesh                           * pTetmesh;
 
 	std::vector<uint>                   pTri_indices;
 
+	// Whether each triangle of the mesh is in pTri_indices
+	std::vector<bool>                   pTri_inside;
+
 	// The conduction volume tetrahedron indices
 	std::vector<uint>                   pTet_indices;
 
@@ -31,7 +31,12 @@
 
 // STL headers.
 #include <cassert>
+#include <cmath>
+#include <cstdio>
 #include <algorithm>
+#include <map>
+#include <set>
+#include <sys/mman.h>
 #include <iostream>
 #include <vector>
 #include <sstream>
@@ -44,11 +49,216 @@
 #include "memb.hpp"
 #include "../math/triangle.hpp"
 #include "../error.hpp"
+#include "../parallel.hpp"
+#include "../meshcache.hpp"
+#include "tetmesh_rw.hpp"
 
 NAMESPACE_ALIAS(steps::tetmesh, stetmesh);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// A triangle given to the Tetmesh constructor, or a face of one of its
+// tetrahedra, with sorted vertices and its position in the order in
+// which the constructor meets it.
+struct FaceKey
+{
+    uint v[3];
+    uint order;
+};
+
+static bool faceKeyLess(FaceKey const & a, FaceKey const & b)
+{
+    if (a.v[0] != b.v[0]) return a.v[0] < b.v[0];
+    if (a.v[1] != b.v[1]) return a.v[1] < b.v[1];
+    if (a.v[2] != b.v[2]) return a.v[2] < b.v[2];
+    return a.order < b.order;
+}
+
+static bool faceKeySame(FaceKey const & a, FaceKey const & b)
+{
+    return a.v[0] == b.v[0] && a.v[1] == b.v[1] && a.v[2] == b.v[2];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A bar of a triangle in numberBars: its sorted vertices packed in 64 bits
+// and its position in the order in which the bars are met.
+struct BarKey
+{
+    unsigned long long key;
+    uint order;
+};
+
+static bool barKeyLess(BarKey const & a, BarKey const & b)
+{
+    if (a.key != b.key) return a.key < b.key;
+    return a.order < b.order;
+}
+
+// Number the bars of ntris triangles, meeting bars (0,1), (0,2) and (1,2)
+// of each triangle in turn and giving a bar the next index when it is
+// first met. Fills tri_bars (three per triangle) and bars (two sorted
+// vertices per bar) and returns the number of bars.
+static uint numberBars(uint const * tris, uint ntris, uint * tri_bars,
+                       std::vector<uint> & bars, uint nthreads = 1)
+{
+    const uint barvert[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+    uint nedges = ntris * 3;
+    std::vector<BarKey> edges(nedges);
+    for (uint tri = 0; tri < ntris; ++tri)
+    {
+        for (uint i = 0; i < 3; ++i)
+        {
+            unsigned long long v0 = tris[(tri*3) + barvert[i][0]];
+            unsigned long long v1 = tris[(tri*3) + barvert[i][1]];
+            if (v1 < v0) std::swap(v0, v1);
+            BarKey & e = edges[(tri*3) + i];
+            e.key = (v0 << 32) | v1;
+            e.order = (tri*3) + i;
+        }
+    }
+    steps::parallelSort(edges.begin(), edges.end(), barKeyLess, nthreads);
+
+    // The first comer of the group of equal bars of each edge.
+    std::vector<uint> edge_first(nedges);
+    for (uint g = 0; g < nedges; )
+    {
+        uint e = g;
+        for (; e < nedges && edges[e].key == edges[g].key; ++e)
+        {
+            edge_first[edges[e].order] = edges[g].order;
+        }
+        g = e;
+    }
+
+    bars.clear();
+    for (uint e = 0; e < nedges; ++e)
+    {
+        uint first = edge_first[e];
+        if (first < e) tri_bars[e] = tri_bars[first];
+        else
+        {
+            uint v0 = tris[((e/3)*3) + barvert[e%3][0]];
+            uint v1 = tris[((e/3)*3) + barvert[e%3][1]];
+            if (v1 < v0) std::swap(v0, v1);
+            tri_bars[e] = bars.size() / 2;
+            bars.push_back(v0);
+            bars.push_back(v1);
+        }
+    }
+    return bars.size() / 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The vertices of faces 0 to 3 of a tetrahedron.
+static const uint faceVert[4][3] = {{0, 1, 2}, {0, 1, 3}, {0, 2, 3}, {1, 2, 3}};
+
+// Fills the FaceKeys of the faces of each tetrahedron, which follow the
+// nsupplied keys of the supplied triangles.
+class FaceKeyLoop : public steps::ParallelLoop
+{
+public:
+    FaceKeyLoop(uint const * tets, uint nsupplied, std::vector<FaceKey> & faces)
+    : pTets(tets), pNSupplied(nsupplied), pFaces(faces) { }
+
+    void run(uint tet, uint thread)
+    {
+        for (uint i = 0; i < 4; ++i)
+        {
+            FaceKey & f = pFaces[pNSupplied + (tet*4) + i];
+            for (uint j = 0; j < 3; ++j) f.v[j] = pTets[(tet*4) + faceVert[i][j]];
+            std::sort(f.v, f.v + 3);
+            f.order = pNSupplied + (tet*4) + i;
+        }
+    }
+
+private:
+    uint const                        * pTets;
+    uint                                pNSupplied;
+    std::vector<FaceKey>              & pFaces;
+};
+
+// Fills the neighbour tables of each tetrahedron, given the triangle of
+// each face and the face of another tetrahedron it shares it with (-1 if
+// none). The first of two tetrahedra sharing a triangle becomes its
+// inner neighbour, as if the tets were added one by one; each entry of
+// the tables is written by one face only.
+class NeighbLoop : public steps::ParallelLoop
+{
+public:
+    NeighbLoop(std::vector<int> const & face_tri, std::vector<int> const & face_partner,
+               uint * tet_tri_neighbs, int * tet_tet_neighbs, int * tri_tet_neighbs)
+    : pFaceTri(face_tri), pFacePartner(face_partner), pTetTri(tet_tri_neighbs)
+    , pTetTet(tet_tet_neighbs), pTriTet(tri_tet_neighbs) { }
+
+    void run(uint tet, uint thread)
+    {
+        for (uint f = tet*4; f < (tet*4) + 4; ++f)
+        {
+            int tri = pFaceTri[f];
+            int partner = pFacePartner[f];
+            pTetTri[f] = tri;
+            if (partner == -1 || partner > static_cast<int>(f)) pTriTet[tri*2] = tet;
+            else pTriTet[(tri*2)+1] = tet;
+            pTetTet[f] = (partner == -1 ? -1 : partner / 4);
+        }
+    }
+
+private:
+    std::vector<int> const            & pFaceTri;
+    std::vector<int> const            & pFacePartner;
+    uint                              * pTetTri;
+    int                               * pTetTet;
+    int                               * pTriTet;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Number of elements runKernel gives a thread at a time.
+#define TETMESH_KERNEL_CHUNK            4096
+
+// A batch geometry kernel of steps::math.
+typedef void (*GeomKernel)(double const * verts, uint const * elems, uint n, double * out);
+
+// Runs a GeomKernel on chunks of the elements.
+class KernelLoop : public steps::ParallelLoop
+{
+public:
+    KernelLoop(GeomKernel kernel, double const * verts, uint const * elems,
+               uint ncorners, uint n, double * out, uint outdim)
+    : pKernel(kernel), pVerts(verts), pElems(elems), pNCorners(ncorners)
+    , pN(n), pOut(out), pOutDim(outdim) { }
+
+    void run(uint i, uint thread)
+    {
+        uint b = i * TETMESH_KERNEL_CHUNK;
+        uint n = std::min(pN - b, static_cast<uint>(TETMESH_KERNEL_CHUNK));
+        pKernel(pVerts, pElems + (b * pNCorners), n, pOut + (b * pOutDim));
+    }
+
+private:
+    GeomKernel                          pKernel;
+    double const                      * pVerts;
+    uint const                        * pElems;
+    uint                                pNCorners;
+    uint                                pN;
+    double                            * pOut;
+    uint                                pOutDim;
+};
+
+// Apply kernel to the n elements elems, of ncorners vertices each, on
+// nthreads threads, writing outdim values per element to out.
+static void runKernel(GeomKernel kernel, double const * verts, uint const * elems,
+                      uint ncorners, uint n, double * out, uint outdim, uint nthreads)
+{
+    KernelLoop loop(kernel, verts, elems, ncorners, n, out, outdim);
+    uint nchunks = (n + TETMESH_KERNEL_CHUNK - 1) / TETMESH_KERNEL_CHUNK;
+    steps::parallelFor(loop, nchunks, nthreads);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool steps::tetmesh::isValidID(std::string const & id)
 {
     int idlen = id.length();
@@ -90,6 +300,8 @@ void steps::tetmesh::checkID(std::string const & id)
 stetmesh::Tetmesh::Tetmesh(uint nverts, uint ntets, uint ntris)
 : Geom()
 , pSetupDone(false)
+, pMapped(0)
+, pMappedSize(0)
 , pVertsN(nverts)
 , pVerts(0)
 , pBarsN(0)
@@ -201,9 +413,11 @@ stetmesh::Tetmesh::Tetmesh(uint nverts, uint ntets, uint ntris)
 
 stetmesh::Tetmesh::Tetmesh(std::vector<double> const & verts,
 						   std::vector<uint> const & tets,
-		                   std::vector<uint> const & tris)
+		                   std::vector<uint> const & tris, uint nthreads)
 : Geom()
 , pSetupDone(false)
+, pMapped(0)
+, pMappedSize(0)
 , pVertsN(0)
 , pVerts(0)
 , pBarsN(0)
@@ -250,6 +464,32 @@ stetmesh::Tetmesh::Tetmesh(std::vector<double> const & verts,
 	    os << "Vertex table or Tet table not supplied to Tet mesh initialiser function.\n";
 	    throw steps::ArgErr(os.str());
 	}
+	if (nthreads == 0)
+	{
+		std::ostringstream os;
+	    os << "Tet mesh initialiser function needs at least one thread.\n";
+	    throw steps::ArgErr(os.str());
+	}
+
+	// With a mesh cache, the tables are read from the file saved for
+	// the same vertices, tetrahedrons and triangles, if there is one.
+	std::string cachefile;
+	if (steps::meshCacheOn())
+	{
+		steps::ContentHash key;
+		uint version = TETMESH_BINARY_VERSION;
+		key.add(TETMESH_BINARY_MAGIC, 8);
+		key.add(&version, sizeof(uint));
+		key.add(verts);
+		key.add(tets);
+		key.add(tris);
+		cachefile = steps::meshCachePath("tetmesh", key, ".stepsmesh");
+		if (steps::meshCacheHas(cachefile) && _loadCached(cachefile, verts, tets))
+		{
+			pSetupDone = true;
+			return;
+		}
+	}
 
 	pVerts = new double[pVertsN * 3];
 	// copy the supplied vertices information to pVerts member
@@ -281,9 +521,6 @@ stetmesh::Tetmesh::Tetmesh(std::vector<double> const & verts,
 	int * tri_tet_neighbours_temp = new int[trisn_max * 2];
 	std::fill_n(tri_tet_neighbours_temp, (trisn_max *2), -1);
 
-	// Each 'bar' must connect at least 2 triangles, each tri has 3 bars TODO: better maximum
-	uint barsn_max = trisn_max *2;
-	uint * bars_temp = new uint[barsn_max];
 
 
 	// Add any triangles supplied first; maintaining indices
@@ -298,213 +535,85 @@ stetmesh::Tetmesh::Tetmesh(std::vector<double> const & verts,
 		tris_added++;
 	}
 
-	uint tettetadded = 0;
-	// Loop over all tetrahedra and fill tris_temp, pTet_tri_neighbours,
-	// pTet_tet_neighbours, tri_tet_neighbours_temp
-	for (uint tet=0; tet < pTetsN; ++tet)
+	// Match the faces of the tetrahedra to triangles by sorting them on
+	// their vertices. The triangles are numbered as a search through all
+	// triangles found so far would do it: supplied triangles keep their
+	// index, which faces take if they match any (the lowest if several
+	// do), and other triangles are numbered in the order of their first
+	// face, counting faces (0,1,2), (0,1,3), (0,2,3), (1,2,3) of each tet
+	// in turn.
+	uint nsupplied = tris_added;
+	uint nfaces = pTetsN * 4;
+	std::vector<FaceKey> faces(nsupplied + nfaces);
+	for (uint tri = 0; tri < nsupplied; ++tri)
 	{
-		/// set this tetrahedron's volume
-		///
-		// find pointers to this tetrahedron's 4 vertices
-		double * vert0 = pVerts + (3 * pTets[tet*4]);
-		double * vert1 = pVerts + (3 * pTets[(tet*4)+1]);
-		double * vert2 = pVerts + (3 * pTets[(tet*4)+2]);
-		double * vert3 = pVerts + (3 * pTets[(tet*4)+3]);
-		pTet_vols[tet] = steps::math::tet_vol(vert0, vert1, vert2, vert3);
-		steps::math::tet_barycenter(vert0, vert1, vert2, vert3,pTet_barycentres + tet*3);
-
-		// create array for triangle formed by edges (0,1,2)
-		// will also sort for ease of comparison
-		uint tri_vert0[3] = {pTets[tet*4], pTets[(tet*4)+1], pTets[(tet*4)+2]};
-		std::sort(tri_vert0, tri_vert0 + 3);
-		// create array for triangle formed by edges (0,1,3)
-		uint tri_vert1[3] = {pTets[tet*4], pTets[(tet*4)+1], pTets[(tet*4)+3]};
-		std::sort(tri_vert1, tri_vert1 + 3);
-		// create array for triangle formed by edges (0,2,3)
-		uint tri_vert2[3] = {pTets[tet*4], pTets[(tet*4)+2], pTets[(tet*4)+3]};
-		std::sort(tri_vert2, tri_vert2 + 3);
-		// create array for triangle formed by edges (1,2,3)
-		uint tri_vert3[3] = {pTets[(tet*4)+1], pTets[(tet*4)+2], pTets[(tet*4)+3]};
-		std::sort(tri_vert3, tri_vert3 + 3);
-
-		int tri0idx = -1;
-		int tri1idx = -1;
-		int tri2idx = -1;
-		int tri3idx = -1;
-
-		uint trisfound = 0;	/// unused at the moment
-		for (uint tri = 0; tri < tris_added; ++tri)
-		{
-			uint thistri[3] = {tris_temp[tri*3], tris_temp[(tri*3)+1], tris_temp[(tri*3)+2]};
-			// should be no need to sort them now // std::sort(thistri, thistri + 3);
-			if (tri0idx == -1 && array_srt_cmp(tri_vert0, thistri, 3)) tri0idx = tri;
-			if (tri1idx == -1 && array_srt_cmp(tri_vert1, thistri, 3)) tri1idx = tri;
-			if (tri2idx == -1 && array_srt_cmp(tri_vert2, thistri, 3)) tri2idx = tri;
-			if (tri3idx == -1 && array_srt_cmp(tri_vert3, thistri, 3)) tri3idx = tri;
-		}
-		// First add the triangles that are not already included
-		if (tri0idx == -1)
-		{
-			tris_temp[tris_added*3] = tri_vert0[0];
-			tris_temp[(tris_added*3)+1] = tri_vert0[1];
-			tris_temp[(tris_added*3)+2] = tri_vert0[2];
-			// label this triangle and increment triangle counter
-			tri0idx = tris_added++;
-		}
-		if (tri1idx == -1)
-		{
-			tris_temp[tris_added*3] = tri_vert1[0];
-			tris_temp[(tris_added*3)+1] = tri_vert1[1];
-			tris_temp[(tris_added*3)+2] = tri_vert1[2];
-			// label this triangle and increment triangle counter
-			tri1idx = tris_added++;
-		}
-		if (tri2idx == -1)
-		{
-			tris_temp[tris_added*3] = tri_vert2[0];
-			tris_temp[(tris_added*3)+1] = tri_vert2[1];
-			tris_temp[(tris_added*3)+2] = tri_vert2[2];
-			// label this triangle and increment triangle counter
-			tri2idx = tris_added++;
-		}
-		if (tri3idx == -1)
-		{
-			tris_temp[tris_added*3] = tri_vert3[0];
-			tris_temp[(tris_added*3)+1] = tri_vert3[1];
-			tris_temp[(tris_added*3)+2] = tri_vert3[2];
-			// label this triangle and increment triangle counter
-			tri3idx = tris_added++;
-		}
-
-		// Use this information to fill neighbours information
-		pTet_tri_neighbours[tet*4] = tri0idx;
-		pTet_tri_neighbours[(tet*4)+1] = tri1idx;
-		pTet_tri_neighbours[(tet*4)+2] = tri2idx;
-		pTet_tri_neighbours[(tet*4)+3] = tri3idx;
-
-
-		/* BUGFIX 13/08/09 In following if else section:
-		 * Indexing of triangle and tet neighbours were not aligned.
-		 * This was causing descrepancies in the setting of the scaled dcsts in the simulation
-		 * layer algorithm, causing concentration differences at steady-state.
-		 * It was decided to fix the indexing here rather than alter the sim algorithm.
-		 */
-
-		// Add this tet to neighbours of first triangle
-		if (tri_tet_neighbours_temp[tri0idx*2] == -1) tri_tet_neighbours_temp[tri0idx*2] = tet;
-		else if (tri_tet_neighbours_temp[(tri0idx*2)+1] == -1)
-		{
-
-			tri_tet_neighbours_temp[(tri0idx*2)+1] = tet;
-
-			// This triangle has a 2 tet neighbours now- time to tell those tets they are neighbours
-			uint tet1 = tri_tet_neighbours_temp[tri0idx*2];
-
-			assert(pTet_tet_neighbours[(tet*4)] == -1);
-			pTet_tet_neighbours[(tet*4)] = tet1;
-
-			// Find this triangle's index from tet1's triangle neighbours
-			for (uint idx = 0; idx <=4; ++idx)
-			{
-				assert(idx != 4);
-				int tet1tri0idx = pTet_tri_neighbours[(tet1*4)+idx];
-				assert(tet1tri0idx >= 0);
-				if (tet1tri0idx == tri0idx)
-				{
-					assert(pTet_tet_neighbours[(tet1*4)+idx] == -1);
-					pTet_tet_neighbours[(tet1*4)+idx] = tet;
-					break;
-				}
-			}
-
-			tettetadded+=2;
-		}
-		else assert(false);
-		if (tri_tet_neighbours_temp[tri1idx*2] == -1) tri_tet_neighbours_temp[tri1idx*2] = tet;
-		else if (tri_tet_neighbours_temp[(tri1idx*2)+1] == -1)
+		FaceKey & f = faces[tri];
+		f.v[0] = tris_temp[tri*3];
+		f.v[1] = tris_temp[(tri*3)+1];
+		f.v[2] = tris_temp[(tri*3)+2];
+		f.order = tri;
+	}
+	FaceKeyLoop facekeys(pTets, nsupplied, faces);
+	steps::parallelFor(facekeys, pTetsN, nthreads);
+	steps::parallelSort(faces.begin(), faces.end(), faceKeyLess, nthreads);
+
+	// The first comer (lowest order) of the group of equal faces of each
+	// face, and the other tetrahedron face in its group, if any.
+	std::vector<uint> face_first(nfaces);
+	std::vector<int> face_partner(nfaces, -1);
+	uint nkeys = faces.size();
+	for (uint g = 0; g < nkeys; )
+	{
+		uint first = faces[g].order;
+		int prev = -1;
+		uint e = g;
+		for (; e < nkeys && faceKeySame(faces[g], faces[e]); ++e)
 		{
-			tri_tet_neighbours_temp[(tri1idx*2)+1] = tet;
-			// This triangle has a 2 tet neighbours now- time to tell those tets they are neighbours
-			uint tet1 = tri_tet_neighbours_temp[tri1idx*2];
-
-			assert(pTet_tet_neighbours[(tet*4)+1] == -1);
-			pTet_tet_neighbours[(tet*4)+1] = tet1;
-
-			// Find this triangle's index from tet1's triangle neighbours
-			for (uint idx = 0; idx <= 4; ++idx)
+			if (faces[e].order < nsupplied) continue;
+			int f = faces[e].order - nsupplied;
+			face_first[f] = first;
+			if (prev != -1)
 			{
-				assert(idx != 4);
-				int tet1tri1idx = pTet_tri_neighbours[(tet1*4)+idx];
-				assert(tet1tri1idx >= 0);
-				if (tet1tri1idx == tri1idx)
-				{
-					assert(pTet_tet_neighbours[(tet1*4)+idx] == -1);
-					pTet_tet_neighbours[(tet1*4)+idx] = tet;
-					break;
-				}
+				// A triangle can only be shared by two tetrahedra.
+				assert(face_partner[prev] == -1);
+				face_partner[prev] = f;
+				face_partner[f] = prev;
 			}
-
-			tettetadded+=2;
+			prev = f;
 		}
-		else assert(false);
-		if (tri_tet_neighbours_temp[tri2idx*2] == -1) tri_tet_neighbours_temp[tri2idx*2] = tet;
-		else if (tri_tet_neighbours_temp[(tri2idx*2)+1] == -1)
-		{
-			tri_tet_neighbours_temp[(tri2idx*2)+1] = tet;
-			// This triangle has a 2 tet neighbours now- time to tell those tets they are neighbours
-			uint tet1 = tri_tet_neighbours_temp[tri2idx*2];
-
-			assert(pTet_tet_neighbours[(tet*4)+2] == -1);
-			pTet_tet_neighbours[(tet*4)+2] = tet1;
-
-			// Find this triangle's index from tet1's triangle neighbours
-			for (uint idx = 0; idx <= 4; ++idx)
-			{
-				assert(idx != 4);
-				int tet1tri2idx = pTet_tri_neighbours[(tet1*4)+idx];
-				assert(tet1tri2idx >= 0);
-				if (tet1tri2idx == tri2idx)
-				{
-					assert(pTet_tet_neighbours[(tet1*4)+idx] == -1);
-					pTet_tet_neighbours[(tet1*4)+idx] = tet;
-					break;
-				}
-			}
+		g = e;
+	}
+	std::vector<FaceKey>().swap(faces);
 
-			tettetadded+=2;
-		}
-		else assert(false);
-		if (tri_tet_neighbours_temp[tri3idx*2] == -1) tri_tet_neighbours_temp[tri3idx*2] = tet;
-		else if (tri_tet_neighbours_temp[(tri3idx*2)+1] == -1)
+	std::vector<int> face_tri(nfaces, -1);
+	for (uint f = 0; f < nfaces; ++f)
+	{
+		uint first = face_first[f];
+		if (first < nsupplied) face_tri[f] = first;
+		else if (first - nsupplied < f) face_tri[f] = face_tri[first - nsupplied];
+		else
 		{
-			tri_tet_neighbours_temp[(tri3idx*2)+1] = tet;
-			// This triangle has a 2 tet neighbours now- time to tell those tets they are neighbours
-			uint tet1 = tri_tet_neighbours_temp[tri3idx*2];
-
-			assert(pTet_tet_neighbours[(tet*4)+3] == -1);
-			pTet_tet_neighbours[(tet*4)+3] = tet1;
-
-			// Find this triangle's index from tet1's triangle neighbours
-			for (uint idx = 0; idx <= 4; ++idx)
-			{
-				assert(idx != 4);
-				int tet1tri3idx = pTet_tri_neighbours[(tet1*4)+idx];
-				assert(tet1tri3idx >= 0);
-				if (tet1tri3idx == tri3idx)
-				{
-					assert(pTet_tet_neighbours[(tet1*4)+idx] == -1);
-					pTet_tet_neighbours[(tet1*4)+idx] = tet;
-					break;
-				}
-			}
-
-			tettetadded+=2;
+			uint tet = f / 4;
+			uint i = f % 4;
+			uint tri_vert[3];
+			for (uint j = 0; j < 3; ++j) tri_vert[j] = pTets[(tet*4) + faceVert[i][j]];
+			std::sort(tri_vert, tri_vert + 3);
+			tris_temp[tris_added*3] = tri_vert[0];
+			tris_temp[(tris_added*3)+1] = tri_vert[1];
+			tris_temp[(tris_added*3)+2] = tri_vert[2];
+			face_tri[f] = tris_added++;
 		}
-		else assert(false);
-	} // end of loop over all tetrahedra
+	}
+	std::vector<uint>().swap(face_first);
 
-	// Most tetrahedra should have had 4 tetneighbours added, but fewer for surface tets
-	assert (tettetadded < pTetsN*4);
+	// Fill pTet_tri_neighbours, pTet_tet_neighbours and
+	// tri_tet_neighbours_temp, and the volumes and barycentres.
+	NeighbLoop neighbs(face_tri, face_partner, pTet_tri_neighbours,
+	                   pTet_tet_neighbours, tri_tet_neighbours_temp);
+	steps::parallelFor(neighbs, pTetsN, nthreads);
+	runKernel(steps::math::tet_vols, pVerts, pTets, 4, pTetsN, pTet_vols, 1, nthreads);
+	runKernel(steps::math::tet_barycenters, pVerts, pTets, 4, pTetsN,
+	          pTet_barycentres, 3, nthreads);
 
     ////////////////////////////////////////////////////////////////////////
 
@@ -532,98 +641,18 @@ stetmesh::Tetmesh::Tetmesh(std::vector<double> const & verts,
 	delete[] tri_tet_neighbours_temp;
 
 
-	// Create a set of vectors to store the bars.
-	std::set<std::vector<uint> > bars = std::set<std::vector<uint> >();
-
-	//pTri_Bars = new uint[pTrisN*2];
-
-	uint bars_added = 0;
-	/// loop over all triangles and set pTri_areas and pTri_norms
-	for (uint tri = 0; tri < pTrisN; ++tri)
-	{
-		assert(bars_added <= barsn_max);
-		// create array for bar formed by edges (0,1)
-		// will also sort for ease of comparison
-		uint bar_vert0[2]= {pTris[tri*3], pTris[(tri*3)+1]};
-		std::sort(bar_vert0, bar_vert0 + 2);
-
-		// create array for bar formed by edges (0,2)
-		uint bar_vert1[2] = {pTris[tri*3], pTris[(tri*3)+2]};
-		std::sort(bar_vert1, bar_vert1 + 2);
-
-		// create array for bar formed by edges (1,2)
-		uint bar_vert2[2] = {pTris[(tri*3)+1], pTris[(tri*3)+2]};
-		std::sort(bar_vert2, bar_vert2 + 2);
-
-		int bar0idx = -1;
-		int bar1idx = -1;
-		int bar2idx = -1;
-
-		for (uint bar = 0; bar < bars_added; ++bar)
-		{
-			uint thisbar[2] = {bars_temp[bar*2], bars_temp[(bar*2)+1]};
-			if (bar0idx == -1 && array_srt_cmp(bar_vert0, thisbar, 2)) bar0idx = bar;
-			if (bar1idx == -1 && array_srt_cmp(bar_vert1, thisbar, 2)) bar1idx = bar;
-			if (bar2idx == -1 && array_srt_cmp(bar_vert2, thisbar, 2)) bar2idx = bar;
-		}
-
-		// Add the bars that are not already included
-		if (bar0idx == -1)
-		{
-			bars_temp[bars_added*2] = bar_vert0[0];
-			bars_temp[(bars_added*2)+1] = bar_vert0[1];
-			bar0idx = bars_added++;
-		}
-		if (bar1idx == -1)
-		{
-			bars_temp[bars_added*2] = bar_vert1[0];
-			bars_temp[(bars_added*2)+1] = bar_vert1[1];
-			bar1idx = bars_added++;
-		}
-		if (bar2idx == -1)
-		{
-			bars_temp[bars_added*2] = bar_vert2[0];
-			bars_temp[(bars_added*2)+1] = bar_vert2[1];
-			bar2idx = bars_added++;
-		}
-
-		pTri_bars[tri*3] = bar0idx;
-		pTri_bars[(tri*3)+1] = bar1idx;
-		pTri_bars[(tri*3)+2] = bar2idx;
-
-		/// set this triangle's area
-		///
-		// find pointers to this triangle's 3 vertices
-		double * vert0 = pVerts + (3 * pTris[tri*3]);
-		double * vert1 = pVerts + (3 * pTris[(tri*3)+1]);
-		double * vert2 = pVerts + (3 * pTris[(tri*3)+2]);
-		// call steps::math method to set the area
-		pTri_areas[tri] = steps::math::triArea(vert0, vert1, vert2);
-
-		// create arrays to store this triangle's barycenter and normal
-		double baryc[3];
-		double norm[3];
-		// call math methods to find the barycenter, normal and store in arrays
-		steps::math::triBarycenter(vert0, vert1, vert2, baryc);
-		steps::math::triNormal(vert0, vert1, vert2, norm);
-
-		// set the barycenter
-		pTri_barycs[tri*3] = baryc[0];
-		pTri_barycs[(tri*3)+1] = baryc[1];
-		pTri_barycs[(tri*3)+2] = baryc[2];
-		// set the normal
-		pTri_norms[tri*3] = norm[0];
-		pTri_norms[(tri*3)+1] = norm[1];
-		pTri_norms[(tri*3)+2] = norm[2];
-	}
-
-	// We know know how many bars are in the mesh
-	pBarsN = bars_added;
+	// Number the bars.
+	std::vector<uint> bars;
+	pBarsN = numberBars(pTris, pTrisN, pTri_bars, bars, nthreads);
 	pBars = new uint[pBarsN * 2];
-	// copy the supplied triangles information to pBars member
-	for (uint i = 0; i < pBarsN*2; ++i) pBars[i] = bars_temp[i];
+	std::copy(bars.begin(), bars.end(), pBars);
+	std::vector<uint>().swap(bars);
+
+	/// set pTri_areas, pTri_barycs and pTri_norms for all triangles
+	runKernel(steps::math::triAreas, pVerts, pTris, 3, pTrisN, pTri_areas, 1, nthreads);
+	runKernel(steps::math::triBarycenters, pVerts, pTris, 3, pTrisN, pTri_barycs, 3, nthreads);
+	runKernel(steps::math::triNormals, pVerts, pTris, 3, pTrisN, pTri_norms, 3, nthreads);
 
-	delete[] bars_temp;
 
     ////////////////////////////////////////////////////////////////////////
 
@@ -653,6 +682,8 @@ stetmesh::Tetmesh::Tetmesh(std::vector<double> const & verts,
 
 	// Constructor has completed all necessary setting-up: Set flag.
 	pSetupDone = true;
+
+	if (cachefile.empty() == false) _saveCached(cachefile);
 }
 
 
@@ -670,6 +701,8 @@ stetmesh::Tetmesh::Tetmesh(std::vector<double> const & verts,
    		std::vector<int> const & tet_tet_neighbs)
 : Geom()
 , pSetupDone(false)
+, pMapped(0)
+, pMappedSize(0)
 , pVertsN(0)
 , pVerts(0)
 , pTrisN(0)
@@ -816,23 +849,11 @@ stetmesh::Tetmesh::Tetmesh(std::vector<double> const & verts,
 
 		pTri_tet_neighbours[t*2] = tri_tet_neighbs[t*2];
 		pTri_tet_neighbours[(t*2)+1] = tri_tet_neighbs[(t*2)+1];
-
-		// The barycenter of the triangle is not store in the text file right now
-		/// set this triangle's barycenter
-		///
-		// find pointers to this triangle's 3 vertices
-		double * vert0 = pVerts + (3 * tris[t*3]);
-		double * vert1 = pVerts + (3 * tris[(t*3)+1]);
-		double * vert2 = pVerts + (3 * tris[(t*3)+2]);
-		// create array to store this triangle's barycenter
-		double baryc[3];
-		steps::math::triBarycenter(vert0, vert1, vert2, baryc);
-		// set the barycenter
-		pTri_barycs[t*3] = baryc[0];
-		pTri_barycs[(t*3)+1] = baryc[1];
-		pTri_barycs[(t*3)+2] = baryc[2];
 	}
 
+	// The barycenter of the triangle is not store in the text file right now
+	steps::math::triBarycenters(pVerts, pTris, pTrisN, pTri_barycs);
+
 	for (uint t = 0; t < pTetsN; ++t)
 	{
 		pTets[t*4] = tets[t*4];
@@ -859,76 +880,11 @@ stetmesh::Tetmesh::Tetmesh(std::vector<double> const & verts,
 	}
 
 
-	// Each 'bar' must connect at least 2 triangles, each tri has 3 bars TODO: better maximum
-	uint barsn_max = pTrisN *2;
-	uint * bars_temp = new uint[barsn_max];
-
-	// Create a set of vectors to store the bars.
-	std::set<std::vector<uint> > bars = std::set<std::vector<uint> >();
-
-	uint bars_added = 0;
-	/// loop over all triangles and set pTri_areas and pTri_norms
-	for (uint tri = 0; tri < pTrisN; ++tri)
-	{
-		assert(bars_added <= barsn_max);
-		// create array for bar formed by edges (0,1)
-		// will also sort for ease of comparison
-		uint bar_vert0[2]= {pTris[tri*3], pTris[(tri*3)+1]};
-		std::sort(bar_vert0, bar_vert0 + 2);
-
-		// create array for bar formed by edges (0,2)
-		uint bar_vert1[2] = {pTris[tri*3], pTris[(tri*3)+2]};
-		std::sort(bar_vert1, bar_vert1 + 2);
-
-		// create array for bar formed by edges (1,2)
-		uint bar_vert2[2] = {pTris[(tri*3)+1], pTris[(tri*3)+2]};
-		std::sort(bar_vert2, bar_vert2 + 2);
-
-		int bar0idx = -1;
-		int bar1idx = -1;
-		int bar2idx = -1;
-
-		for (uint bar = 0; bar < bars_added; ++bar)
-		{
-			uint thisbar[2] = {bars_temp[bar*2], bars_temp[(bar*2)+1]};
-			if (bar0idx == -1 && array_srt_cmp(bar_vert0, thisbar, 2)) bar0idx = bar;
-			if (bar1idx == -1 && array_srt_cmp(bar_vert1, thisbar, 2)) bar1idx = bar;
-			if (bar2idx == -1 && array_srt_cmp(bar_vert2, thisbar, 2)) bar2idx = bar;
-		}
-
-		// Add the bars that are not already included
-		if (bar0idx == -1)
-		{
-			bars_temp[bars_added*2] = bar_vert0[0];
-			bars_temp[(bars_added*2)+1] = bar_vert0[1];
-			bar0idx = bars_added++;
-		}
-		if (bar1idx == -1)
-		{
-			bars_temp[bars_added*2] = bar_vert1[0];
-			bars_temp[(bars_added*2)+1] = bar_vert1[1];
-			bar1idx = bars_added++;
-		}
-		if (bar2idx == -1)
-		{
-			bars_temp[bars_added*2] = bar_vert2[0];
-			bars_temp[(bars_added*2)+1] = bar_vert2[1];
-			bar2idx = bars_added++;
-		}
-
-		pTri_bars[tri*3] = bar0idx;
-		pTri_bars[(tri*3)+1] = bar1idx;
-		pTri_bars[(tri*3)+2] = bar2idx;
-
-	}
-
-	// We know know how many bars are in the mesh
-	pBarsN = bars_added;
+	// Number the bars.
+	std::vector<uint> bars;
+	pBarsN = numberBars(pTris, pTrisN, pTri_bars, bars);
 	pBars = new uint[pBarsN * 2];
-	// copy the supplied triangles information to pBars member
-	for (uint i = 0; i < pBarsN*2; ++i) pBars[i] = bars_temp[i];
-
-	delete[] bars_temp;
+	std::copy(bars.begin(), bars.end(), pBars);
 
 
 	/// Find the minimal and maximal boundary values
@@ -960,6 +916,145 @@ stetmesh::Tetmesh::Tetmesh(std::vector<double> const & verts,
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+
+stetmesh::Tetmesh::Tetmesh(uint nverts, uint nbars, uint ntris, uint ntets,
+                           bool tables)
+: Geom()
+, pSetupDone(false)
+, pMapped(0)
+, pMappedSize(0)
+, pVertsN(nverts)
+, pVerts(0)
+, pBarsN(nbars)
+, pBars(0)
+, pTrisN(ntris)
+, pTris(0)
+, pTri_areas(0)
+, pTri_bars(0)
+, pTri_norms(0)
+, pTri_barycs(0)
+, pTri_patches(0)
+, pTri_diffboundaries(0)
+, pTri_tet_neighbours(0)
+, pTris_user(0) // not used by this contructor
+, pTetsN(ntets)
+, pTets(0)
+, pTet_vols(0)
+, pTet_barycentres(0)
+, pTet_comps(0)
+, pTet_tri_neighbours(0)
+, pTet_tet_neighbours(0)
+, pXmin(0.0)
+, pXmax(0.0)
+, pYmin(0.0)
+, pYmax(0.0)
+, pZmin(0.0)
+, pZmax(0.0)
+, pMembs()
+, pDiffBoundaries()
+{
+	if (tables == true)
+	{
+		pVerts = new double[pVertsN * 3];
+		pBars = new uint[pBarsN * 2];
+		pTris = new uint[pTrisN * 3];
+		pTri_areas = new double[pTrisN];
+		pTri_norms = new double[pTrisN*3];
+		pTri_barycs = new double[pTrisN*3];
+		pTri_bars = new uint[pTrisN*3];
+		pTri_tet_neighbours = new int[pTrisN*2];
+		pTets = new uint[pTetsN * 4];
+		pTet_vols = new double[pTetsN];
+		pTet_barycentres = new double[pTetsN*3];
+		pTet_tri_neighbours = new uint[pTetsN*4];
+		pTet_tet_neighbours = new int[pTetsN*4];
+	}
+
+	pTet_comps = new stetmesh::TmComp*[pTetsN];
+	for (uint i=0; i<pTetsN; ++i) pTet_comps[i] = 0;
+	pTri_patches = new stetmesh::TmPatch*[pTrisN];
+	for (uint i=0; i<pTrisN; ++i) pTri_patches[i] = 0;
+	pTri_diffboundaries = new stetmesh::DiffBoundary*[pTrisN];
+	for (uint i=0; i<pTrisN; ++i) pTri_diffboundaries[i] = 0;
+
+	pSetupDone = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stetmesh::Tetmesh::_loadCached(std::string const & path,
+                                    std::vector<double> const & verts,
+                                    std::vector<uint> const & tets)
+{
+	Tetmesh * c = 0;
+	try
+	{
+		// Shared, so that meshes built from the cache in several
+		// processes keep one copy of the tables between them.
+		c = loadBinary(path, true);
+	}
+	catch (steps::Err & e)
+	{
+		return false;
+	}
+
+	// The hash in the file name is only a hint: the input must match.
+	bool same = c->pVertsN == pVertsN && c->pTetsN == pTetsN
+		&& std::equal(verts.begin(), verts.end(), c->pVerts)
+		&& std::equal(tets.begin(), tets.end(), c->pTets);
+	if (same)
+	{
+		pBarsN = c->pBarsN;
+		pTrisN = c->pTrisN;
+		pXmin = c->pXmin;
+		pXmax = c->pXmax;
+		pYmin = c->pYmin;
+		pYmax = c->pYmax;
+		pZmin = c->pZmin;
+		pZmax = c->pZmax;
+
+		// Take the tables; c is left with none to delete.
+		std::swap(pVerts, c->pVerts);
+		std::swap(pBars, c->pBars);
+		std::swap(pTris, c->pTris);
+		std::swap(pTri_areas, c->pTri_areas);
+		std::swap(pTri_bars, c->pTri_bars);
+		std::swap(pTri_norms, c->pTri_norms);
+		std::swap(pTri_barycs, c->pTri_barycs);
+		std::swap(pTri_patches, c->pTri_patches);
+		std::swap(pTri_diffboundaries, c->pTri_diffboundaries);
+		std::swap(pTri_tet_neighbours, c->pTri_tet_neighbours);
+		std::swap(pTets, c->pTets);
+		std::swap(pTet_vols, c->pTet_vols);
+		std::swap(pTet_comps, c->pTet_comps);
+		std::swap(pTet_tri_neighbours, c->pTet_tri_neighbours);
+		std::swap(pTet_tet_neighbours, c->pTet_tet_neighbours);
+		pTet_barycentres = c->pTet_barycentres;
+		c->pTet_barycentres = 0;
+		std::swap(pMapped, c->pMapped);
+		std::swap(pMappedSize, c->pMappedSize);
+	}
+	delete c;
+	return same;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stetmesh::Tetmesh::_saveCached(std::string const & path)
+{
+	std::string tmp = steps::meshCacheTemp(path);
+	try
+	{
+		saveBinary(tmp, this);
+		steps::meshCachePublish(tmp, path);
+	}
+	catch (steps::Err & e)
+	{
+		std::remove(tmp.c_str());
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 stetmesh::Tetmesh::~Tetmesh(void)
@@ -967,20 +1062,27 @@ stetmesh::Tetmesh::~Tetmesh(void)
 	// Memory created in 1st constructor must be freed if setup hasn't been called
 	if (pSetupDone == false) delete[] pTris_user;
 
-	delete[] pVerts;
-	delete[] pBars;
-	delete[] pTris;
-	delete[] pTri_areas;
-	delete[] pTri_bars;
-	delete[] pTri_norms;
+	if (pMapped != 0)
+	{
+		munmap(pMapped, pMappedSize);
+	}
+	else
+	{
+		delete[] pVerts;
+		delete[] pBars;
+		delete[] pTris;
+		delete[] pTri_areas;
+		delete[] pTri_bars;
+		delete[] pTri_norms;
+		delete[] pTri_tet_neighbours;
+		delete[] pTets;
+		delete[] pTet_vols;
+		delete[] pTet_tri_neighbours;
+		delete[] pTet_tet_neighbours;
+		delete[] pTet_barycentres;
+	}
 	delete[] pTri_patches;
-	delete[] pTri_tet_neighbours;
-	delete[] pTets;
-	delete[] pTet_vols;
 	delete[] pTet_comps;
-	delete[] pTet_tri_neighbours;
-	delete[] pTet_tet_neighbours;
-	delete[] pTet_barycentres;
 	delete[] pTri_diffboundaries;
 
 	while (pMembs.empty() == false)
@@ -1345,17 +1447,10 @@ void stetmesh::Tetmesh::setup(void)
 	uint tettetadded = 0;
 	// Loop over all tetrahedra and fill tris_temp, pTet_tri_neighbours,
 	// pTet_tet_neighbours, tri_tet_neighbours_temp
+	steps::math::tet_vols(pVerts, pTets, pTetsN, pTet_vols);
+	steps::math::tet_barycenters(pVerts, pTets, pTetsN, pTet_barycentres);
 	for (uint tet=0; tet < pTetsN; ++tet)
 	{
-		/// set this tetrahedron's volume
-		///
-		// find pointers to this tetrahedron's 4 vertices
-		double * vert0 = pVerts + (3 * pTets[tet*4]);
-		double * vert1 = pVerts + (3 * pTets[(tet*4)+1]);
-		double * vert2 = pVerts + (3 * pTets[(tet*4)+2]);
-		double * vert3 = pVerts + (3 * pTets[(tet*4)+3]);
-		pTet_vols[tet] = steps::math::tet_vol(vert0, vert1, vert2, vert3);
-		steps::math::tet_barycenter(vert0, vert1, vert2, vert3,pTet_barycentres + tet*3);
 
 		// create array for triangle formed by edges (0,1,2)
 		// will also sort for ease of comparison
@@ -1547,27 +1642,9 @@ void stetmesh::Tetmesh::setup(void)
 	delete[] tris_temp;
 	delete[] tri_tet_neighbours_temp;
 
-	/// loop over all triangles and set pTri_areas and pTri_norms
-	for (uint tri = 0; tri < pTrisN; ++tri)
-	{
-		/// set this triangle's area
-		///
-		// find pointers to this triangle's 3 vertices
-		double * vert0 = pVerts + (3 * pTris[tri*3]);
-		double * vert1 = pVerts + (3 * pTris[(tri*3)+1]);
-		double * vert2 = pVerts + (3 * pTris[(tri*3)+2]);
-		// call steps::math method to set the area
-		pTri_areas[tri] = steps::math::triArea(vert0, vert1, vert2);
-
-		// create an array to store this triangle's normal
-		double norm[3];
-		// call steps::math method to find the normal and store in norm array
-		steps::math::triNormal(vert0, vert1, vert2, norm);
-		// set the normal
-		pTri_norms[tri*3] = norm[0];
-		pTri_norms[(tri*3)+1] = norm[1];
-		pTri_norms[(tri*3)+2] = norm[2];
-	}
+	/// set pTri_areas and pTri_norms for all triangles
+	steps::math::triAreas(pVerts, pTris, pTrisN, pTri_areas);
+	steps::math::triNormals(pVerts, pTris, pTrisN, pTri_norms);
 
     ////////////////////////////////////////////////////////////////////////
 
@@ -1956,6 +2033,30 @@ double stetmesh::Tetmesh::getMeshVolume(void) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t stetmesh::Tetmesh::getMemoryUsage(void) const
+{
+	std::size_t bytes = sizeof(Tetmesh);
+
+	bytes += pVertsN * 3 * sizeof(double);
+	bytes += pBarsN * 2 * sizeof(uint);
+
+	// Vertices, bars, areas, barycentres, normals, patch, diffusion
+	// boundary and tetrahedron neighbours of each triangle.
+	bytes += pTrisN * (6 * sizeof(uint) + 7 * sizeof(double));
+	bytes += pTrisN * (sizeof(TmPatch *) + sizeof(DiffBoundary *) + 2 * sizeof(int));
+	if (pTris_user != 0) bytes += pTrisN * 3 * sizeof(uint);
+
+	// Vertices, volume, barycentre, compartment, and triangle and
+	// tetrahedron neighbours of each tetrahedron.
+	bytes += pTetsN * (8 * sizeof(uint) + 4 * sizeof(double));
+	bytes += pTetsN * (sizeof(TmComp *) + 4 * sizeof(int));
+
+	bytes += (pGridStart.capacity() + pGridTets.capacity()) * sizeof(uint);
+	return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 double stetmesh::Tetmesh::getTetVol(uint tidx) const
 {
     assert(pSetupDone == true);
@@ -2079,84 +2180,1093 @@ std::vector<int> stetmesh::Tetmesh::getTetTetNeighb(uint tidx) const
 int stetmesh::Tetmesh::findTetByPoint(std::vector<double> p) const
 {
     assert(pSetupDone == true);
-    int tetidx = -1;
+    if (p.size() != 3)
+    {
+        std::ostringstream os;
+        os << "A point must have 3 coordinates.\n";
+        throw steps::ArgErr(os.str());
+    }
+    if (pGridStart.empty()) _buildGrid();
+    return _findTet(&p[0]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<int> stetmesh::Tetmesh::findTetsByPoints(std::vector<double> const & points) const
+{
+    assert(pSetupDone == true);
+    if ((points.size() % 3) != 0)
+    {
+        std::ostringstream os;
+        os << "Point list length must be a multiple of 3.\n";
+        throw steps::ArgErr(os.str());
+    }
+    if (pGridStart.empty()) _buildGrid();
+    uint npoints = points.size() / 3;
+    std::vector<int> tets(npoints);
+    for (uint i = 0; i < npoints; ++i) tets[i] = _findTet(&points[i*3]);
+    return tets;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Cells of the point search grid along an axis of length l, for about
+// ncells cells in total over a box with sides lx, ly, lz.
+static uint gridCells(double l, double lx, double ly, double lz, uint ncells)
+{
+    double vol = std::max(lx, 1e-300) * std::max(ly, 1e-300) * std::max(lz, 1e-300);
+    double h = std::pow(vol / ncells, 1.0 / 3.0);
+    if (!(h > 0.0)) return 1;
+    double n = std::ceil(l / h);
+    if (n < 1.0) return 1;
+    if (n > 1024.0) return 1024;
+    return static_cast<uint>(n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stetmesh::Tetmesh::_buildGrid(void) const
+{
+    double bmin[3] = {pXmin, pYmin, pZmin};
+    double len[3] = {pXmax - pXmin, pYmax - pYmin, pZmax - pZmin};
+    for (uint d = 0; d < 3; ++d)
+    {
+        pGridN[d] = gridCells(len[d], len[0], len[1], len[2], pTetsN);
+        pGridH[d] = (len[d] > 0.0 ? len[d] / pGridN[d] : 1.0);
+    }
+    uint ncells = pGridN[0] * pGridN[1] * pGridN[2];
+
+    // The range of cells of the bounding box of each tet, padded so that
+    // points on its faces are never missed through rounding.
+    std::vector<uint> range(pTetsN * 6);
+    for (uint t = 0; t < pTetsN; ++t)
+    {
+        for (uint d = 0; d < 3; ++d)
+        {
+            double lo = pVerts[(3 * pTets[t*4]) + d];
+            double hi = lo;
+            for (uint v = 1; v < 4; ++v)
+            {
+                double x = pVerts[(3 * pTets[(t*4)+v]) + d];
+                lo = std::min(lo, x);
+                hi = std::max(hi, x);
+            }
+            double pad = 1.0e-9 * (len[d] > 0.0 ? len[d] : 1.0);
+            double c0 = std::floor((lo - pad - bmin[d]) / pGridH[d]);
+            double c1 = std::floor((hi + pad - bmin[d]) / pGridH[d]);
+            range[(t*6) + d] = static_cast<uint>(std::max(c0, 0.0));
+            range[(t*6) + 3 + d] = static_cast<uint>(std::min(c1, pGridN[d] - 1.0));
+        }
+    }
+
+    // Count, then fill, the tets of each cell.
+    pGridStart.assign(ncells + 1, 0);
+    for (uint pass = 0; pass < 2; ++pass)
+    {
+        std::vector<uint> fill;
+        if (pass == 1)
+        {
+            for (uint c = 0; c < ncells; ++c) pGridStart[c + 1] += pGridStart[c];
+            pGridTets.resize(pGridStart[ncells]);
+            fill.assign(pGridStart.begin(), pGridStart.end() - 1);
+        }
+        for (uint t = 0; t < pTetsN; ++t)
+        {
+            uint const * r = &range[t*6];
+            for (uint k = r[2]; k <= r[5]; ++k)
+            {
+                for (uint j = r[1]; j <= r[4]; ++j)
+                {
+                    for (uint i = r[0]; i <= r[3]; ++i)
+                    {
+                        uint c = (((k * pGridN[1]) + j) * pGridN[0]) + i;
+                        if (pass == 0) pGridStart[c + 1] += 1;
+                        else pGridTets[fill[c]++] = t;
+                    }
+                }
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int stetmesh::Tetmesh::_findTet(double const * p) const
+{
     // initial check to see if point is outside boundary box
     if (p[0] < pXmin || p[1] < pYmin || p[2] < pZmin
     	|| p[0] > pXmax || p[1] > pYmax || p[2] > pZmax)
     {
-		return tetidx;
+		return -1;
+    }
+
+    // Every tet that contains p overlaps its cell, and the cell lists
+    // its tets in index order, so this finds the same tet as a scan
+    // over all of them.
+    double bmin[3] = {pXmin, pYmin, pZmin};
+    uint cell[3];
+    for (uint d = 0; d < 3; ++d)
+    {
+        double c = std::floor((p[d] - bmin[d]) / pGridH[d]);
+        cell[d] = static_cast<uint>(std::min(std::max(c, 0.0), pGridN[d] - 1.0));
     }
+    uint c = (((cell[2] * pGridN[1]) + cell[1]) * pGridN[0]) + cell[0];
+
     double pnt[3] = {p[0], p[1], p[2]};
-    for (uint tidx = 0; tidx < pTetsN; ++tidx)
+    uint end = pGridStart[c + 1];
+    for (uint i = pGridStart[c]; i < end; ++i)
     {
+    	uint tidx = pGridTets[i];
     	double * vert0 = pVerts + (3 * pTets[tidx*4]);
     	double * vert1 = pVerts + (3 * pTets[(tidx*4)+1]);
     	double * vert2 = pVerts + (3 * pTets[(tidx*4)+2]);
     	double * vert3 = pVerts + (3 * pTets[(tidx*4)+3]);
     	if (steps::math::tet_inside(vert0, vert1, vert2, vert3, pnt))
     	{
-    		tetidx = tidx;
-    		break;
+    		return tidx;
     	}
     }
 
-	return tetidx;
+	return -1;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::vector<double> stetmesh::Tetmesh::getBoundMin(void) const
+// Throws unless p has 3 coordinates.
+static void checkPoint(std::vector<double> const & p)
 {
-	assert(pSetupDone == true);
+    if (p.size() != 3)
+    {
+        std::ostringstream os;
+        os << "A point must have 3 coordinates.\n";
+        throw steps::ArgErr(os.str());
+    }
+}
 
-	std::vector<double> b_min(3);
-	b_min[0] = pXmin;
-	b_min[1] = pYmin;
-	b_min[2] = pZmin;
-	return b_min;
+// Throws if the radius r is negative.
+static void checkRadius(double r)
+{
+    if (!(r >= 0.0))
+    {
+        std::ostringstream os;
+        os << "Radius or distance " << r << " must not be negative.\n";
+        throw steps::ArgErr(os.str());
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::vector<double> stetmesh::Tetmesh::getBoundMax(void) const
+bool stetmesh::Tetmesh::_gridRange(double const * lo, double const * hi,
+    uint * cell0, uint * cell1) const
 {
-	assert(pSetupDone == true);
+    double bmin[3] = {pXmin, pYmin, pZmin};
+    double bmax[3] = {pXmax, pYmax, pZmax};
+    for (uint d = 0; d < 3; ++d)
+    {
+        if (hi[d] < bmin[d] || lo[d] > bmax[d] || lo[d] > hi[d]) return false;
+        double c0 = std::floor((lo[d] - bmin[d]) / pGridH[d]);
+        double c1 = std::floor((hi[d] - bmin[d]) / pGridH[d]);
+        cell0[d] = static_cast<uint>(std::min(std::max(c0, 0.0), pGridN[d] - 1.0));
+        cell1[d] = static_cast<uint>(std::min(std::max(c1, 0.0), pGridN[d] - 1.0));
+    }
+    return true;
+}
 
-	std::vector<double> b_max(3);
-	b_max[0] = pXmax;
-	b_max[1] = pYmax;
-	b_max[2] = pZmax;
-	return b_max;
+////////////////////////////////////////////////////////////////////////////////
+
+void stetmesh::Tetmesh::_gridTets(double const * lo, double const * hi,
+    std::vector<uint> & tets) const
+{
+    tets.clear();
+    uint c0[3], c1[3];
+    if (_gridRange(lo, hi, c0, c1) == false) return;
+    for (uint k = c0[2]; k <= c1[2]; ++k)
+    {
+        for (uint j = c0[1]; j <= c1[1]; ++j)
+        {
+            for (uint i = c0[0]; i <= c1[0]; ++i)
+            {
+                uint c = (((k * pGridN[1]) + j) * pGridN[0]) + i;
+                tets.insert(tets.end(), pGridTets.begin() + pGridStart[c],
+                            pGridTets.begin() + pGridStart[c + 1]);
+            }
+        }
+    }
+    std::sort(tets.begin(), tets.end());
+    tets.erase(std::unique(tets.begin(), tets.end()), tets.end());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-// Created by weiliang 2010.02.02
-std::vector<int> stetmesh::Tetmesh::getSurfTris(void) const
+std::vector<uint> stetmesh::Tetmesh::getTetsInBox(std::vector<double> const & lo,
+    std::vector<double> const & hi) const
 {
     assert(pSetupDone == true);
-    std::vector<int> tribounds;
-    for (int t = 0; t < pTrisN; t++) {
-        std::vector<int> trineighbor = getTriTetNeighb(t);
-        if (trineighbor[0] == -1 || trineighbor[1] == -1) {
-            tribounds.push_back(t);
+    checkPoint(lo);
+    checkPoint(hi);
+    if (pGridStart.empty()) _buildGrid();
+
+    // A tet's barycentre is in its bounding box, so the tet is listed in
+    // the cell of its barycentre.
+    std::vector<uint> cand;
+    _gridTets(&lo[0], &hi[0], cand);
+    std::vector<uint> tets;
+    uint n = cand.size();
+    for (uint i = 0; i < n; ++i)
+    {
+        double const * b = pTet_barycentres + (cand[i] * 3);
+        bool in = true;
+        for (uint d = 0; d < 3; ++d)
+        {
+            if (b[d] < lo[d] || b[d] > hi[d]) in = false;
         }
+        if (in == true) tets.push_back(cand[i]);
     }
-    return tribounds;
+    return tets;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double * stetmesh::Tetmesh::_getVertex(uint vidx) const
+std::vector<uint> stetmesh::Tetmesh::getTetsInSphere(std::vector<double> const & centre,
+    double radius) const
 {
-    return pVerts + (vidx * 3);
+    assert(pSetupDone == true);
+    checkPoint(centre);
+    checkRadius(radius);
+    if (pGridStart.empty()) _buildGrid();
+
+    double lo[3], hi[3];
+    for (uint d = 0; d < 3; ++d)
+    {
+        lo[d] = centre[d] - radius;
+        hi[d] = centre[d] + radius;
+    }
+    std::vector<uint> cand;
+    _gridTets(lo, hi, cand);
+    std::vector<uint> tets;
+    uint n = cand.size();
+    double r2 = radius * radius;
+    for (uint i = 0; i < n; ++i)
+    {
+        double const * b = pTet_barycentres + (cand[i] * 3);
+        double dx = b[0] - centre[0];
+        double dy = b[1] - centre[1];
+        double dz = b[2] - centre[2];
+        if ((dx * dx) + (dy * dy) + (dz * dz) <= r2) tets.push_back(cand[i]);
+    }
+    return tets;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-uint * stetmesh::Tetmesh::_getTri(uint tidx) const
+std::vector<uint> stetmesh::Tetmesh::getTrisWithinDistance(std::vector<double> const & point,
+    double dist) const
 {
-    return pTris + (tidx * 3);
+    assert(pSetupDone == true);
+    checkPoint(point);
+    checkRadius(dist);
+    if (pGridStart.empty()) _buildGrid();
+
+    // Every triangle is a face of a tet, inside that tet's bounding box,
+    // so a triangle point within dist is in a cell of the box around
+    // the sphere.
+    double lo[3], hi[3];
+    for (uint d = 0; d < 3; ++d)
+    {
+        lo[d] = point[d] - dist;
+        hi[d] = point[d] + dist;
+    }
+    std::vector<uint> cand;
+    _gridTets(lo, hi, cand);
+    std::vector<uint> faces;
+    uint n = cand.size();
+    for (uint i = 0; i < n; ++i)
+    {
+        uint const * tris = pTet_tri_neighbours + (cand[i] * 4);
+        faces.insert(faces.end(), tris, tris + 4);
+    }
+    std::sort(faces.begin(), faces.end());
+    faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+
+    std::vector<uint> tris;
+    uint nfaces = faces.size();
+    double d2 = dist * dist;
+    for (uint i = 0; i < nfaces; ++i)
+    {
+        uint const * v = pTris + (faces[i] * 3);
+        if (steps::math::triPointDist2(pVerts + (3 * v[0]), pVerts + (3 * v[1]),
+                                       pVerts + (3 * v[2]), &point[0]) <= d2)
+        {
+            tris.push_back(faces[i]);
+        }
+    }
+    return tris;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int stetmesh::Tetmesh::_nearestSurfTri(double const * p, double & dist2) const
+{
+    // The cells are searched in shells of growing Chebyshev distance s
+    // from the (clamped) cell of p. A cell of shell s + 1 is at least
+    // s * hmin from p, so the search stops once the best triangle is
+    // closer than that.
+    double bmin[3] = {pXmin, pYmin, pZmin};
+    int cell[3];
+    int nmax = 0;
+    double hmin = pGridH[0];
+    for (uint d = 0; d < 3; ++d)
+    {
+        double c = std::floor((p[d] - bmin[d]) / pGridH[d]);
+        cell[d] = static_cast<int>(std::min(std::max(c, 0.0), pGridN[d] - 1.0));
+        nmax = std::max(nmax, static_cast<int>(pGridN[d]));
+        hmin = std::min(hmin, pGridH[d]);
+    }
+
+    int best = -1;
+    dist2 = 0.0;
+    for (int s = 0; s < nmax; ++s)
+    {
+        int lo[3], hi[3];
+        for (uint d = 0; d < 3; ++d)
+        {
+            lo[d] = std::max(cell[d] - s, 0);
+            hi[d] = std::min(cell[d] + s, static_cast<int>(pGridN[d]) - 1);
+        }
+        for (int k = lo[2]; k <= hi[2]; ++k)
+        {
+            for (int j = lo[1]; j <= hi[1]; ++j)
+            {
+                for (int i = lo[0]; i <= hi[0]; ++i)
+                {
+                    int ds = std::max(std::abs(i - cell[0]),
+                             std::max(std::abs(j - cell[1]), std::abs(k - cell[2])));
+                    if (ds != s) continue;
+                    uint c = (((k * pGridN[1]) + j) * pGridN[0]) + i;
+                    for (uint g = pGridStart[c]; g < pGridStart[c + 1]; ++g)
+                    {
+                        uint const * tris = pTet_tri_neighbours + (pGridTets[g] * 4);
+                        for (uint f = 0; f < 4; ++f)
+                        {
+                            int const * neighb = pTri_tet_neighbours + (tris[f] * 2);
+                            if (neighb[0] != -1 && neighb[1] != -1) continue;
+                            uint const * v = pTris + (tris[f] * 3);
+                            double d2 = steps::math::triPointDist2(pVerts + (3 * v[0]),
+                                pVerts + (3 * v[1]), pVerts + (3 * v[2]), p);
+                            if (best < 0 || d2 < dist2
+                                || (d2 == dist2 && static_cast<int>(tris[f]) < best))
+                            {
+                                best = tris[f];
+                                dist2 = d2;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        double bound = s * hmin;
+        if (best >= 0 && dist2 < bound * bound) break;
+    }
+    return best;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int stetmesh::Tetmesh::findNearestSurfTri(std::vector<double> const & point) const
+{
+    assert(pSetupDone == true);
+    checkPoint(point);
+    if (pGridStart.empty()) _buildGrid();
+    double dist2;
+    return _nearestSurfTri(&point[0], dist2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stetmesh::Tetmesh::getSurfDistance(std::vector<double> const & point) const
+{
+    assert(pSetupDone == true);
+    checkPoint(point);
+    if (pGridStart.empty()) _buildGrid();
+    double dist2;
+    if (_nearestSurfTri(&point[0], dist2) < 0)
+    {
+        std::ostringstream os;
+        os << "The mesh has no surface triangles.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return std::sqrt(dist2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Walk breadth-first over the face neighbours tettet of the tets from
+// start, appending the tets not yet marked in seen to order. Return the
+// last tet reached, which is one of the farthest from start.
+static uint tetWalk(int const * tettet, uint start, std::vector<bool> & seen,
+                    std::vector<uint> & order)
+{
+    uint head = order.size();
+    order.push_back(start);
+    seen[start] = true;
+    while (head < order.size())
+    {
+        uint t = order[head++];
+        for (uint j = 0; j < 4; ++j)
+        {
+            int n = tettet[(t * 4) + j];
+            if (n < 0 || seen[n] == true) continue;
+            seen[n] = true;
+            order.push_back(n);
+        }
+    }
+    return order.back();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stetmesh::Tetmesh::partitionTets(uint nparts,
+    std::vector<double> const & weights) const
+{
+    assert(pSetupDone == true);
+    if (nparts == 0)
+    {
+        std::ostringstream os;
+        os << "Number of parts must be at least 1.\n";
+        throw steps::ArgErr(os.str());
+    }
+    if (weights.empty() == false && weights.size() != pTetsN)
+    {
+        std::ostringstream os;
+        os << "Weight list length (" << weights.size() << ") is not the ";
+        os << "number of tetrahedrons (" << pTetsN << ").\n";
+        throw steps::ArgErr(os.str());
+    }
+    std::vector<double> w(pTetsN, 1.0);
+    for (uint t = 0; t < weights.size(); ++t)
+    {
+        if (!(weights[t] >= 0.0) || weights[t] > 1.0e300)
+        {
+            std::ostringstream os;
+            os << "Weight of tetrahedron " << t << " is not a finite, ";
+            os << "non-negative number.\n";
+            throw steps::ArgErr(os.str());
+        }
+        w[t] = weights[t];
+    }
+
+    // Order the tets of each face-connected piece of the mesh by a walk
+    // from the far end of a first walk, so that runs of the order are
+    // compact slabs.
+    std::vector<uint> order;
+    order.reserve(pTetsN);
+    std::vector<bool> seen(pTetsN, false);
+    std::vector<bool> probed(pTetsN, false);
+    std::vector<uint> probe;
+    for (uint t = 0; t < pTetsN; ++t)
+    {
+        if (seen[t] == true) continue;
+        probe.clear();
+        uint start = tetWalk(pTet_tet_neighbours, t, probed, probe);
+        tetWalk(pTet_tet_neighbours, start, seen, order);
+    }
+    assert(order.size() == pTetsN);
+
+    double total = 0.0;
+    for (uint t = 0; t < pTetsN; ++t) total += w[t];
+
+    // Cut the order where the running weight passes each share.
+    std::vector<uint> parts(pTetsN, 0);
+    std::vector<double> partw(nparts, 0.0);
+    std::vector<uint> partn(nparts, 0);
+    uint p = 0;
+    double acc = 0.0;
+    for (uint i = 0; i < pTetsN; ++i)
+    {
+        uint t = order[i];
+        while (p + 1 < nparts && acc + (0.5 * w[t]) > (total * (p + 1)) / nparts) ++p;
+        parts[t] = p;
+        partw[p] += w[t];
+        partn[p] += 1;
+        acc += w[t];
+    }
+
+    // Move boundary tets to the neighbouring part they share the most
+    // faces with, as long as no part gets heavier than 3% over its share
+    // or the heaviest part of the cut. Each move removes shared faces
+    // between parts, so this ends.
+    double limit = std::max(1.03 * total / nparts,
+                            *std::max_element(partw.begin(), partw.end()));
+    for (uint pass = 0; pass < 8; ++pass)
+    {
+        uint moved = 0;
+        for (uint i = 0; i < pTetsN; ++i)
+        {
+            uint t = order[i];
+            uint a = parts[t];
+            if (partn[a] == 1) continue;
+            uint nb[4];
+            uint nnb = 0;
+            for (uint j = 0; j < 4; ++j)
+            {
+                int n = pTet_tet_neighbours[(t * 4) + j];
+                if (n >= 0) nb[nnb++] = parts[n];
+            }
+            uint ina = std::count(nb, nb + nnb, a);
+            uint best = a;
+            uint bestn = ina;
+            for (uint j = 0; j < nnb; ++j)
+            {
+                uint b = nb[j];
+                if (b == a || partw[b] + w[t] > limit) continue;
+                uint inb = std::count(nb, nb + nnb, b);
+                if (inb > bestn)
+                {
+                    best = b;
+                    bestn = inb;
+                }
+            }
+            if (best == a) continue;
+            parts[t] = best;
+            partw[a] -= w[t];
+            partw[best] += w[t];
+            partn[a] -= 1;
+            partn[best] += 1;
+            ++moved;
+        }
+        if (moved == 0) break;
+    }
+
+    return parts;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stetmesh::Tetmesh::getPartitionHalo(std::vector<uint> const & parts,
+    uint p) const
+{
+    assert(pSetupDone == true);
+    if (parts.size() != pTetsN)
+    {
+        std::ostringstream os;
+        os << "Partition length (" << parts.size() << ") is not the ";
+        os << "number of tetrahedrons (" << pTetsN << ").\n";
+        throw steps::ArgErr(os.str());
+    }
+
+    std::vector<bool> inhalo(pTetsN, false);
+    for (uint t = 0; t < pTetsN; ++t)
+    {
+        if (parts[t] != p) continue;
+        for (uint j = 0; j < 4; ++j)
+        {
+            int n = pTet_tet_neighbours[(t * 4) + j];
+            if (n >= 0 && parts[n] != p) inhalo[n] = true;
+        }
+    }
+
+    std::vector<uint> halo;
+    for (uint t = 0; t < pTetsN; ++t)
+    {
+        if (inhalo[t] == true) halo.push_back(t);
+    }
+    return halo;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stetmesh::Tetmesh::getBoundMin(void) const
+{
+	assert(pSetupDone == true);
+
+	std::vector<double> b_min(3);
+	b_min[0] = pXmin;
+	b_min[1] = pYmin;
+	b_min[2] = pZmin;
+	return b_min;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stetmesh::Tetmesh::getBoundMax(void) const
+{
+	assert(pSetupDone == true);
+
+	std::vector<double> b_max(3);
+	b_max[0] = pXmax;
+	b_max[1] = pYmax;
+	b_max[2] = pZmax;
+	return b_max;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Created by weiliang 2010.02.02
+std::vector<int> stetmesh::Tetmesh::getSurfTris(void) const
+{
+    assert(pSetupDone == true);
+    std::vector<int> tribounds;
+    for (int t = 0; t < pTrisN; t++) {
+        int * trineighbor = pTri_tet_neighbours + (t * 2);
+        if (trineighbor[0] == -1 || trineighbor[1] == -1) {
+            tribounds.push_back(t);
+        }
+    }
+    return tribounds;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Throws if an index of tets is not below ntets.
+static void checkTetIndices(std::vector<uint> const & tets, uint ntets)
+{
+    uint n = tets.size();
+    for (uint i = 0; i < n; ++i)
+    {
+        if (tets[i] >= ntets)
+        {
+            std::ostringstream os;
+            os << "Tetrahedron index " << tets[i] << " out of range.\n";
+            throw steps::ArgErr(os.str());
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stetmesh::Tetmesh::findOverlapTris(std::vector<uint> const & tets1,
+    std::vector<uint> const & tets2) const
+{
+    assert(pSetupDone == true);
+    checkTetIndices(tets1, pTetsN);
+    checkTetIndices(tets2, pTetsN);
+
+    // Bit 0: a face of tets1, bit 1: a face of tets2.
+    std::vector<unsigned char> mark(pTrisN, 0);
+    uint n1 = tets1.size();
+    for (uint i = 0; i < n1; ++i)
+    {
+        uint const * tris = pTet_tri_neighbours + (tets1[i] * 4);
+        for (uint j = 0; j < 4; ++j) mark[tris[j]] |= 1;
+    }
+    uint n2 = tets2.size();
+    for (uint i = 0; i < n2; ++i)
+    {
+        uint const * tris = pTet_tri_neighbours + (tets2[i] * 4);
+        for (uint j = 0; j < 4; ++j) mark[tris[j]] |= 2;
+    }
+
+    std::vector<uint> overlap;
+    for (uint t = 0; t < pTrisN; ++t)
+    {
+        if (mark[t] == 3) overlap.push_back(t);
+    }
+    return overlap;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stetmesh::Tetmesh::findSurfTrisInTets(std::vector<uint> const & tets) const
+{
+    assert(pSetupDone == true);
+    checkTetIndices(tets, pTetsN);
+
+    // A surface triangle has one tetrahedron, so it is found once.
+    std::vector<uint> surf;
+    uint n = tets.size();
+    for (uint i = 0; i < n; ++i)
+    {
+        uint const * tris = pTet_tri_neighbours + (tets[i] * 4);
+        for (uint j = 0; j < 4; ++j)
+        {
+            int const * neighb = pTri_tet_neighbours + (tris[j] * 2);
+            if (neighb[0] == -1 || neighb[1] == -1) surf.push_back(tris[j]);
+        }
+    }
+    return surf;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stetmesh::Tetmesh::findSurfTrisInComp(stetmesh::TmComp * comp) const
+{
+    assert(pSetupDone == true);
+    if (comp == 0 || comp->getContainer() != this)
+    {
+        std::ostringstream os;
+        os << "Compartment is not part of this mesh.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return findSurfTrisInTets(comp->_getAllTetIndices());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stetmesh::Tetmesh * stetmesh::Tetmesh::extractSubmesh(std::vector<uint> const & tets) const
+{
+    assert(pSetupDone == true);
+    checkTetIndices(tets, pTetsN);
+    if (tets.empty())
+    {
+        std::ostringstream os;
+        os << "A sub-mesh needs at least one tetrahedron.\n";
+        throw steps::ArgErr(os.str());
+    }
+
+    // Mark the tets and what they use, then number each in order.
+    std::vector<bool> intet(pTetsN, false);
+    std::vector<bool> invert(pVertsN, false);
+    std::vector<bool> intri(pTrisN, false);
+    uint ntets = tets.size();
+    for (uint i = 0; i < ntets; ++i)
+    {
+        uint t = tets[i];
+        intet[t] = true;
+        for (uint j = 0; j < 4; ++j)
+        {
+            invert[pTets[(t * 4) + j]] = true;
+            intri[pTet_tri_neighbours[(t * 4) + j]] = true;
+        }
+    }
+    std::vector<uint> ptets, pverts, ptris;
+    std::vector<int> tetmap(pTetsN, -1), vertmap(pVertsN, -1), trimap(pTrisN, -1);
+    for (uint t = 0; t < pTetsN; ++t)
+    {
+        if (intet[t] == false) continue;
+        tetmap[t] = ptets.size();
+        ptets.push_back(t);
+    }
+    for (uint v = 0; v < pVertsN; ++v)
+    {
+        if (invert[v] == false) continue;
+        vertmap[v] = pverts.size();
+        pverts.push_back(v);
+    }
+    for (uint t = 0; t < pTrisN; ++t)
+    {
+        if (intri[t] == false) continue;
+        trimap[t] = ptris.size();
+        ptris.push_back(t);
+    }
+
+    // The triangles are supplied, so they keep these indices.
+    std::vector<double> sverts(pverts.size() * 3);
+    for (uint v = 0; v < pverts.size(); ++v)
+    {
+        std::copy(pVerts + (pverts[v] * 3), pVerts + (pverts[v] * 3) + 3, &sverts[v * 3]);
+    }
+    std::vector<uint> stets(ptets.size() * 4);
+    for (uint t = 0; t < ptets.size(); ++t)
+    {
+        for (uint j = 0; j < 4; ++j) stets[(t * 4) + j] = vertmap[pTets[(ptets[t] * 4) + j]];
+    }
+    std::vector<uint> stris(ptris.size() * 3);
+    for (uint t = 0; t < ptris.size(); ++t)
+    {
+        for (uint j = 0; j < 3; ++j) stris[(t * 3) + j] = vertmap[pTris[(ptris[t] * 3) + j]];
+    }
+    Tetmesh * sub = new Tetmesh(sverts, stets, stris);
+    sub->pParentVerts.swap(pverts);
+    sub->pParentTris.swap(ptris);
+    sub->pParentTets.swap(ptets);
+
+    try
+    {
+        std::map<steps::wm::Comp *, TmComp *> comps;
+        uint ncomps = _countComps();
+        for (uint c = 0; c < ncomps; ++c)
+        {
+            TmComp * comp = dynamic_cast<TmComp *>(_getComp(c));
+            if (comp == 0) continue;
+            std::vector<uint> const & ctets = comp->_getAllTetIndices();
+            std::vector<uint> stets;
+            for (uint i = 0; i < ctets.size(); ++i)
+            {
+                if (tetmap[ctets[i]] >= 0) stets.push_back(tetmap[ctets[i]]);
+            }
+            if (stets.empty()) continue;
+            std::sort(stets.begin(), stets.end());
+            TmComp * scomp = new TmComp(comp->getID(), sub, stets);
+            std::set<std::string> volsys = comp->getVolsys();
+            for (std::set<std::string>::const_iterator v = volsys.begin();
+                 v != volsys.end(); ++v)
+            {
+                scomp->addVolsys(*v);
+            }
+            comps[comp] = scomp;
+        }
+
+        uint npatches = _countPatches();
+        for (uint p = 0; p < npatches; ++p)
+        {
+            TmPatch * patch = dynamic_cast<TmPatch *>(_getPatch(p));
+            if (patch == 0 || comps.count(patch->getIComp()) == 0) continue;
+            TmComp * icomp = comps[patch->getIComp()];
+            TmComp * ocomp = 0;
+            if (patch->getOComp() != 0 && comps.count(patch->getOComp()) != 0)
+            {
+                ocomp = comps[patch->getOComp()];
+            }
+            std::vector<uint> const & ptris = patch->_getAllTriIndices();
+            std::vector<uint> stris;
+            for (uint i = 0; i < ptris.size(); ++i)
+            {
+                int st = trimap[ptris[i]];
+                if (st < 0) continue;
+                int const * neighb = sub->_getTriTetNeighb(st);
+                TmComp * c0 = (neighb[0] >= 0) ? sub->getTetComp(neighb[0]) : 0;
+                TmComp * c1 = (neighb[1] >= 0) ? sub->getTetComp(neighb[1]) : 0;
+                if ((c0 == icomp && c1 == ocomp) || (c1 == icomp && c0 == ocomp))
+                {
+                    stris.push_back(st);
+                }
+            }
+            if (stris.empty()) continue;
+            std::sort(stris.begin(), stris.end());
+            TmPatch * spatch = new TmPatch(patch->getID(), sub, stris, icomp, ocomp);
+            std::set<std::string> surfsys = patch->getSurfsys();
+            for (std::set<std::string>::const_iterator s = surfsys.begin();
+                 s != surfsys.end(); ++s)
+            {
+                spatch->addSurfsys(*s);
+            }
+        }
+    }
+    catch (...)
+    {
+        delete sub;
+        throw;
+    }
+    return sub;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A surface triangle of a mesh by its barycentre, for sorting.
+struct SurfTriKey
+{
+    double                              x[3];
+    uint                                tri;
+
+    bool operator<(SurfTriKey const & k) const
+    {
+        for (uint j = 0; j < 3; ++j)
+        {
+            if (x[j] != k.x[j]) return x[j] < k.x[j];
+        }
+        return tri < k.tri;
+    }
+};
+
+// The tetrahedron of surface triangle t of a mesh.
+static int surfTriTet(int const * tri_tet_neighbours, uint t)
+{
+    int const * neighb = tri_tet_neighbours + (t * 2);
+    return (neighb[0] >= 0) ? neighb[0] : neighb[1];
+}
+
+std::vector<double> stetmesh::Tetmesh::findOverlapSurfTris(Tetmesh const & mesh) const
+{
+    assert(pSetupDone == true);
+    assert(mesh.pSetupDone == true);
+
+    // The surface triangles of mesh are sorted by barycentre, then each
+    // of this mesh's is looked up, rather than comparing every pair.
+    std::vector<SurfTriKey> keys;
+    for (uint t = 0; t < mesh.pTrisN; ++t)
+    {
+        int const * neighb = mesh.pTri_tet_neighbours + (t * 2);
+        if (neighb[0] != -1 && neighb[1] != -1) continue;
+        SurfTriKey k;
+        std::copy(mesh.pTri_barycs + (t * 3), mesh.pTri_barycs + (t * 3) + 3, k.x);
+        k.tri = t;
+        keys.push_back(k);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<double> data;
+    for (uint t = 0; t < pTrisN; ++t)
+    {
+        int const * neighb = pTri_tet_neighbours + (t * 2);
+        if (neighb[0] != -1 && neighb[1] != -1) continue;
+        SurfTriKey k;
+        std::copy(pTri_barycs + (t * 3), pTri_barycs + (t * 3) + 3, k.x);
+        k.tri = 0;
+        std::vector<SurfTriKey>::const_iterator it =
+            std::lower_bound(keys.begin(), keys.end(), k);
+        int tet1 = surfTriTet(pTri_tet_neighbours, t);
+        assert(tet1 >= 0);
+        double const * c1 = pTet_barycentres + (tet1 * 3);
+        for (; it != keys.end(); ++it)
+        {
+            if (it->x[0] != k.x[0] || it->x[1] != k.x[1] || it->x[2] != k.x[2]) break;
+            int tet2 = surfTriTet(mesh.pTri_tet_neighbours, it->tri);
+            assert(tet2 >= 0);
+            double const * c2 = mesh.pTet_barycentres + (tet2 * 3);
+            double dx = c1[0] - c2[0];
+            double dy = c1[1] - c2[1];
+            double dz = c1[2] - c2[2];
+            data.push_back(tet1);
+            data.push_back(t);
+            data.push_back(tet2);
+            data.push_back(it->tri);
+            data.push_back(std::sqrt((dx * dx) + (dy * dy) + (dz * dz)));
+        }
+    }
+    return data;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Copy the n entries of a table into a vector.
+template <class T>
+static std::vector<T> wholeTable(T const * a, uint n)
+{
+    if (n == 0) return std::vector<T>();
+    return std::vector<T>(a, a + n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stetmesh::Tetmesh::getTetStats(std::vector<uint> const & tets,
+    uint nthreads) const
+{
+    assert(pSetupDone == true);
+    checkTetIndices(tets, pTetsN);
+
+    uint n = tets.size();
+    uint const * corners = pTets;
+    std::vector<uint> sel;
+    if (n == 0)
+    {
+        n = pTetsN;
+    }
+    else
+    {
+        sel.resize(n * 4);
+        for (uint i = 0; i < n; ++i)
+        {
+            std::copy(pTets + (tets[i] * 4), pTets + (tets[i] * 4) + 4, &sel[i * 4]);
+        }
+        corners = &sel[0];
+    }
+
+    std::vector<double> stats(n * TET_STATS_N);
+    if (n != 0)
+    {
+        runKernel(steps::math::tet_stats, pVerts, corners, 4, n,
+                  &stats[0], TET_STATS_N, nthreads);
+    }
+    return stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stetmesh::Tetmesh::getAllVertices(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pVerts, pVertsN * 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stetmesh::Tetmesh::getAllTris(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pTris, pTrisN * 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stetmesh::Tetmesh::getAllTets(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pTets, pTetsN * 4);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stetmesh::Tetmesh::getAllTriAreas(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pTri_areas, pTrisN);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stetmesh::Tetmesh::getAllTriBarycenters(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pTri_barycs, pTrisN * 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stetmesh::Tetmesh::getAllTriNorms(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pTri_norms, pTrisN * 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<int> stetmesh::Tetmesh::getAllTriTetNeighbs(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pTri_tet_neighbours, pTrisN * 2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stetmesh::Tetmesh::getAllTetVols(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pTet_vols, pTetsN);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stetmesh::Tetmesh::getAllTetBarycenters(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pTet_barycentres, pTetsN * 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stetmesh::Tetmesh::getAllTetTriNeighbs(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pTet_tri_neighbours, pTetsN * 4);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<int> stetmesh::Tetmesh::getAllTetTetNeighbs(void) const
+{
+    assert(pSetupDone == true);
+    return wholeTable(pTet_tet_neighbours, pTetsN * 4);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double * stetmesh::Tetmesh::_getVertex(uint vidx) const
+{
+    return pVerts + (vidx * 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * stetmesh::Tetmesh::_getTri(uint tidx) const
+{
+    return pTris + (tidx * 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * stetmesh::Tetmesh::_getTriBars(uint tidx) const
+{
+    return pTri_bars + (tidx * 3);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
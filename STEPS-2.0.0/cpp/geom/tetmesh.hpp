@@ -162,8 +162,11 @@ public:
     /// \param verts List of vertices.
     /// \param tets List of tetrahedrons.
     /// \param tris List of triangles.
+    /// \param nthreads Number of threads to build the mesh tables with.
+    ///        The tables do not depend on it.
     Tetmesh(std::vector<double> const & verts, std::vector<uint> const & tets,
-    		std::vector<uint> const & tris = std::vector<uint>());
+    		std::vector<uint> const & tris = std::vector<uint>(),
+    		uint nthreads = 1);
 
     /// Constructor
     ///
@@ -388,6 +391,17 @@ public:
     /// \return Quality RER of the tetrahedron.
     double getTetQualityRER(uint tidx) const;
 
+    /// Compute the quality and size statistics of math::tet_stats for a
+    /// selection of tetrahedrons, TET_STATS_N values per tet: the RER
+    /// quality of getTetQualityRER, volume, shortest and longest edge,
+    /// and smallest and largest dihedral angle in radians.
+    ///
+    /// \param tets Indices of the tetrahedrons; all of them if empty.
+    /// \param nthreads Number of threads to compute with.
+    /// \return The statistics of each tet, one tet after the other.
+    std::vector<double> getTetStats(std::vector<uint> const & tets
+        = std::vector<uint>(), uint nthreads = 1) const;
+
     /// Return the barycentre of the tetrahedron in x,y,z coordinates
     /// \param tidx Index of the tetrahedron
     /// \return Barycentre of the tetrahedron
@@ -428,6 +442,65 @@ public:
 
     int findTetByPoint(std::vector<double> p) const;
 
+    /// Find the tetrahedra that encompass a list of points, as
+    /// findTetByPoint does for each of them.
+    /// \param points The coordinates x, y, z of each point, one after the
+    ///        other.
+    /// \return The index of the tetrahedron of each point, or -1.
+    std::vector<int> findTetsByPoints(std::vector<double> const & points) const;
+
+    /// Find the tetrahedrons whose barycentre lies in the box from lo to
+    /// hi (bounds included), with the grid of findTetByPoint.
+    /// \param lo The lower x, y, z corner of the box.
+    /// \param hi The upper x, y, z corner of the box.
+    /// \return The tetrahedrons, in increasing order.
+    std::vector<uint> getTetsInBox(std::vector<double> const & lo,
+        std::vector<double> const & hi) const;
+
+    /// Find the tetrahedrons whose barycentre lies within radius of
+    /// centre.
+    /// \return The tetrahedrons, in increasing order.
+    std::vector<uint> getTetsInSphere(std::vector<double> const & centre,
+        double radius) const;
+
+    /// Find the triangles with a point (vertex, edge or interior) within
+    /// dist of point.
+    /// \return The triangles, in increasing order.
+    std::vector<uint> getTrisWithinDistance(std::vector<double> const & point,
+        double dist) const;
+
+    /// Find the surface triangle (see getSurfTris) closest to point, by
+    /// searching the grid of findTetByPoint outwards from it.
+    /// \return The triangle, the lowest index of equally close ones, or
+    ///         -1 if the mesh has no surface triangles.
+    int findNearestSurfTri(std::vector<double> const & point) const;
+
+    /// Return the distance from point to the closest surface triangle.
+    ///
+    double getSurfDistance(std::vector<double> const & point) const;
+
+    /// Split the tetrahedrons into nparts parts of about equal weight,
+    /// each made of face-connected tetrahedrons where the mesh allows.
+    /// The tets are ordered by a breadth-first walk over
+    /// getTetTetNeighb from a pseudo-peripheral tet and cut into
+    /// consecutive runs, then tets on part boundaries are moved to the
+    /// neighbouring part they share more faces with, keeping the parts
+    /// balanced.
+    /// \param nparts Number of parts.
+    /// \param weights Expected load of each tetrahedron, for instance
+    ///        from Tetexact::getTetLoads; all tets weigh 1 if empty.
+    /// \return The part of each tetrahedron, from 0 to nparts - 1.
+    std::vector<uint> partitionTets(uint nparts,
+        std::vector<double> const & weights = std::vector<double>()) const;
+
+    /// Return the halo of part p of a partition: the tetrahedrons of
+    /// other parts that share a face with a tetrahedron of part p.
+    /// \param parts The part of each tetrahedron, as from partitionTets.
+    /// \param p The part.
+    /// \return The halo tetrahedrons, in increasing order.
+    std::vector<uint> getPartitionHalo(std::vector<uint> const & parts,
+        uint p) const;
+
 	////////////////////////////////////////////////////////////////////////
 	// DATA ACCESS (EXPOSED TO PYTHON): MESH
 	////////////////////////////////////////////////////////////////////////
@@ -445,11 +518,100 @@ public:
     /// \return Volume of the mesh.
     double getMeshVolume(void) const;
 
+    /// Return the number of bytes held by the vertex, bar, triangle and
+    /// tetrahedron tables of the mesh and by its point search grid.
+    ///
+    /// \return Size of the mesh tables in bytes.
+    std::size_t getMemoryUsage(void) const;
+
     /// Return the triangles which form the surface boundary of the mesh.
     /// \return Vector of the triangle boundary.
     // Weiliang 2010.02.02
     std::vector<int> getSurfTris(void) const;
 
+	////////////////////////////////////////////////////////////////////////
+	// DATA ACCESS (EXPOSED TO PYTHON): REGIONS
+	////////////////////////////////////////////////////////////////////////
+
+    /// These replace the loops of steps.utilities.meshctrl, marking the
+    /// elements of a region in a bitmap rather than collecting them in
+    /// sets, and throw steps::ArgErr for indices out of range.
+
+    /// Return the triangles that are a face of a tetrahedron of tets1
+    /// and of one of tets2.
+    /// \return The triangles, in increasing order.
+    std::vector<uint> findOverlapTris(std::vector<uint> const & tets1,
+        std::vector<uint> const & tets2) const;
+
+    /// Return the surface triangles (see getSurfTris) that are a face of
+    /// a tetrahedron of tets.
+    /// \return The triangles, in the order of their tetrahedrons in tets.
+    std::vector<uint> findSurfTrisInTets(std::vector<uint> const & tets) const;
+
+    /// Return the surface triangles that are a face of a tetrahedron of
+    /// comp, which must be a compartment of this mesh.
+    /// \return The triangles, in the order of the tetrahedrons of comp.
+    std::vector<uint> findSurfTrisInComp(steps::tetmesh::TmComp * comp) const;
+
+    /// Pair the surface triangles of this mesh with those of mesh that
+    /// have the same barycentre.
+    /// \return For each pair, by triangle of this mesh and then of mesh,
+    ///         five entries: the tetrahedron and triangle of this mesh,
+    ///         the tetrahedron and triangle of mesh and the distance
+    ///         between the barycentres of the two tetrahedrons.
+    std::vector<double> findOverlapSurfTris(Tetmesh const & mesh) const;
+
+	////////////////////////////////////////////////////////////////////////
+	// OPERATIONS (EXPOSED TO PYTHON): SUB-MESHES
+	////////////////////////////////////////////////////////////////////////
+
+    /// Make a new mesh of the tetrahedrons tets of this one, with the
+    /// vertices and triangles they use, renumbered in increasing order of
+    /// their indices here. Every compartment with tetrahedrons in tets
+    /// is carried over with those, under the same ID and with the same
+    /// volume systems. A patch is carried over with the triangles whose
+    /// tetrahedrons in the new mesh are in its inner compartment and in
+    /// its outer one (or, if no tetrahedron of the outer compartment is
+    /// left, on no side), and its surface systems. Membranes and
+    /// diffusion boundaries are not carried over.
+    /// \param tets The tetrahedrons of the sub-mesh.
+    /// \return The sub-mesh, owned by the caller.
+    Tetmesh * extractSubmesh(std::vector<uint> const & tets) const;
+
+    /// For a mesh made by extractSubmesh, the index in the parent mesh of
+    /// each vertex, triangle and tetrahedron; empty for other meshes.
+    std::vector<uint> getParentVerts(void) const
+    { return pParentVerts; }
+
+    std::vector<uint> getParentTris(void) const
+    { return pParentTris; }
+
+    std::vector<uint> getParentTets(void) const
+    { return pParentTets; }
+
+	////////////////////////////////////////////////////////////////////////
+	// DATA ACCESS (EXPOSED TO PYTHON): WHOLE TABLES
+	////////////////////////////////////////////////////////////////////////
+
+    /// Each of these returns a whole table of the mesh in one flat
+    /// vector, element after element, in the layout of the
+    /// per-element getter it replaces: 3 entries per vertex, triangle,
+    /// barycentre and normal, 4 per tetrahedron, 2 per triangle's
+    /// tetrahedron neighbours and 1 per volume and area. A script that
+    /// needs all of them should use these rather than one call per
+    /// element.
+    std::vector<double> getAllVertices(void) const;
+    std::vector<uint> getAllTris(void) const;
+    std::vector<uint> getAllTets(void) const;
+    std::vector<double> getAllTriAreas(void) const;
+    std::vector<double> getAllTriBarycenters(void) const;
+    std::vector<double> getAllTriNorms(void) const;
+    std::vector<int> getAllTriTetNeighbs(void) const;
+    std::vector<double> getAllTetVols(void) const;
+    std::vector<double> getAllTetBarycenters(void) const;
+    std::vector<uint> getAllTetTriNeighbs(void) const;
+    std::vector<int> getAllTetTetNeighbs(void) const;
+
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS (C++ INTERNAL)
     ////////////////////////////////////////////////////////////////////////
@@ -466,6 +628,12 @@ public:
     /// \return List of the vertices form the triangle.
     uint * _getTri(uint tidx) const;
 
+    /// Return the bars of a triangle with index tidx.
+    ///
+    /// \param tidx Index of the triangle.
+    /// \return List of the three bars of the triangle.
+    uint * _getTriBars(uint tidx) const;
+
     /// Return a tetrahedron with index tidx.
     ///
     /// \param tidx Index of the tetrahedron.
@@ -496,6 +664,17 @@ public:
     /// \return Array of Coordinate of the normalised vertices form the triangle.
     double * _getTriNorm(uint tidx) const;
 
+    /// Return the whole table of tetrahedron volumes, triangle areas or
+    /// barycentres, without copying.
+    inline double * _getTetVols(void) const
+    { return pTet_vols; }
+    inline double * _getTriAreas(void) const
+    { return pTri_areas; }
+    inline double * _getTetBarycentres(void) const
+    { return pTet_barycentres; }
+    inline double * _getTriBarycs(void) const
+    { return pTri_barycs; }
+
     ////////////////////////////////////////////////////////////////////////
 
     /// Check if a membrane id is occupied.
@@ -574,8 +753,41 @@ private:
 
     ////////////////////////////////////////////////////////////////////////
 
+    // The binary mesh reader and writer in tetmesh_rw.cpp copy the
+    // tables directly.
+    friend Tetmesh * loadBinary(std::string pathname, bool shared);
+    friend void saveBinary(std::string pathname, Tetmesh * m);
+
+    /// Constructor for loadBinary: allocate all tables, with no
+    /// triangle or tetrahedron assigned to a patch or compartment, and
+    /// leave filling them in to the caller.
+    ///
+    /// \param nverts Number of vertices.
+    /// \param nbars Number of bars.
+    /// \param ntris Number of triangles.
+    /// \param ntets Number of tetrahedrons.
+    /// \param tables Whether to allocate the geometry tables; if not,
+    ///        the caller points them into pMapped.
+    Tetmesh(uint nverts, uint nbars, uint ntris, uint ntets, bool tables = true);
+
+    // Take the tables from the mesh cache file path if it holds these
+    // vertices and tetrahedrons; return whether it did.
+    bool _loadCached(std::string const & path, std::vector<double> const & verts,
+                     std::vector<uint> const & tets);
+
+    // Write the tables to the mesh cache file path.
+    void _saveCached(std::string const & path);
+
+    ////////////////////////////////////////////////////////////////////////
+
     bool                                pSetupDone;
 
+    /// The read-only file mapping that the geometry tables (vertices to
+    /// tetrahedron neighbours) point into for a mesh loaded shared, or 0
+    /// if the mesh owns them.
+    char                              * pMapped;
+    std::size_t                         pMappedSize;
+
     ///////////////////////// DATA: VERTICES ///////////////////////////////
     ///
     /// The total number of vertices in the mesh
@@ -643,6 +855,37 @@ private:
     double                      pZmin;
     double                      pZmax;
 
+    ///////////////////////// DATA: POINT SEARCH ///////////////////////////
+    ///
+    /// A uniform grid over the bounding box, built on the first point
+    /// query: the tets whose bounding box overlaps cell c are
+    /// pGridTets[pGridStart[c]] to pGridTets[pGridStart[c + 1] - 1], in
+    /// increasing order.
+    ///
+    mutable std::vector<uint>   pGridStart;
+    mutable std::vector<uint>   pGridTets;
+    mutable uint                pGridN[3];
+    mutable double              pGridH[3];
+
+    // Build the point search grid.
+    void _buildGrid(void) const;
+
+    // findTetByPoint for the point p[0..2].
+    int _findTet(double const * p) const;
+
+    // The range of grid cells cell0..cell1 (inclusive) overlapping the box
+    // lo..hi; false if the box misses the grid.
+    bool _gridRange(double const * lo, double const * hi, uint * cell0,
+                    uint * cell1) const;
+
+    // The tets listed in the grid cells overlapping the box lo..hi, each
+    // once, in increasing order.
+    void _gridTets(double const * lo, double const * hi,
+                   std::vector<uint> & tets) const;
+
+    // findNearestSurfTri for the point p[0..2], with the squared distance.
+    int _nearestSurfTri(double const * p, double & dist2) const;
+
     ////////////////////////////////////////////////////////////////////////
 
     // List of contained membranes. Members of this class because they
@@ -652,6 +895,12 @@ private:
 
 	std::map<std::string, steps::tetmesh::DiffBoundary *> pDiffBoundaries;
 
+    // The parent indices of the vertices, triangles and tets of a mesh
+    // made by extractSubmesh.
+    std::vector<uint>                   pParentVerts;
+    std::vector<uint>                   pParentTris;
+    std::vector<uint>                   pParentTets;
+
 
     ////////////////////////////////////////////////////////////////////////
 
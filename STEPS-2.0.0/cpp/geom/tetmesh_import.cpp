@@ -0,0 +1,779 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPSis free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPSis distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// POSIX headers.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "tetmesh.hpp"
+#include "tetmesh_import.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+USING(std, map);
+USING(std, ostringstream);
+USING(std, pair);
+USING(std, string);
+USING(std, vector);
+USING(steps::tetmesh, ElementMap);
+USING(steps::tetmesh, Tetmesh);
+
+////////////////////////////////////////////////////////////////////////////////
+
+ElementMap::ElementMap(string const & type)
+: pType(type)
+, pImportIDs()
+, pGroups()
+, pBlocks()
+, pOpenBlock()
+, pOpenBlockStart(-1)
+, pIndexed(false)
+, pDenseMin(0)
+, pDense()
+, pSorted()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int ElementMap::getImportID(uint steps_id) const
+{
+    if (steps_id >= pImportIDs.size())
+    {
+        ostringstream os;
+        os << "No " << pType << " with STEPS index " << steps_id << ".";
+        throw steps::ArgErr(os.str());
+    }
+    return pImportIDs[steps_id];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint ElementMap::getSTEPSID(int import_id) const
+{
+    int sid = find(import_id);
+    if (sid < 0)
+    {
+        ostringstream os;
+        os << "No " << pType << " with import ID " << import_id << ".";
+        throw steps::ArgErr(os.str());
+    }
+    return sid;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+vector<string> ElementMap::getGroupNames(void) const
+{
+    vector<string> names;
+    map<string, vector<uint> >::const_iterator g_end = pGroups.end();
+    for (map<string, vector<uint> >::const_iterator g = pGroups.begin();
+         g != g_end; ++g)
+    {
+        names.push_back(g->first);
+    }
+    return names;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+vector<uint> const & ElementMap::getGroup(string const & name) const
+{
+    map<string, vector<uint> >::const_iterator g = pGroups.find(name);
+    if (g == pGroups.end())
+    {
+        ostringstream os;
+        os << "No " << pType << " group named \"" << name << "\".";
+        throw steps::ArgErr(os.str());
+    }
+    return g->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+vector<string> ElementMap::getBlockNames(void) const
+{
+    vector<string> names;
+    map<string, pair<uint, uint> >::const_iterator b_end = pBlocks.end();
+    for (map<string, pair<uint, uint> >::const_iterator b = pBlocks.begin();
+         b != b_end; ++b)
+    {
+        names.push_back(b->first);
+    }
+    return names;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+vector<uint> ElementMap::getBlock(string const & name) const
+{
+    map<string, pair<uint, uint> >::const_iterator b = pBlocks.find(name);
+    if (b == pBlocks.end())
+    {
+        ostringstream os;
+        os << "No " << pType << " block named \"" << name << "\".";
+        throw steps::ArgErr(os.str());
+    }
+    vector<uint> range(2);
+    range[0] = b->second.first;
+    range[1] = b->second.second;
+    return range;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ElementMap::clear(void)
+{
+    pImportIDs.clear();
+    pGroups.clear();
+    pBlocks.clear();
+    pOpenBlock.clear();
+    pOpenBlockStart = -1;
+    pIndexed = false;
+    pDense.clear();
+    pSorted.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint ElementMap::insert(int import_id)
+{
+    pImportIDs.push_back(import_id);
+    pIndexed = false;
+    return pImportIDs.size() - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ElementMap::addToGroup(string const & name, uint steps_id)
+{
+    pGroups[name].push_back(steps_id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ElementMap::blockBegin(string const & name)
+{
+    blockEnd();
+    pOpenBlock = name;
+    pOpenBlockStart = pImportIDs.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ElementMap::blockEnd(void)
+{
+    if (pOpenBlockStart == -1) return;
+    // Like the Python ElementProxy, an empty block ends before it begins.
+    pBlocks[pOpenBlock] = std::make_pair(static_cast<uint>(pOpenBlockStart),
+        static_cast<uint>(pImportIDs.size()) - 1);
+    pOpenBlockStart = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int ElementMap::find(int import_id) const
+{
+    if (!pIndexed) _index();
+    if (!pDense.empty())
+    {
+        // Compare as unsigned so that IDs below pDenseMin miss too.
+        uint off = static_cast<uint>(import_id - pDenseMin);
+        return (off < pDense.size()) ? pDense[off] : -1;
+    }
+    vector<pair<int, uint> >::const_iterator p =
+        std::lower_bound(pSorted.begin(), pSorted.end(),
+                         std::make_pair(import_id, 0U));
+    if (p == pSorted.end() || p->first != import_id) return -1;
+    return p->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ElementMap::_index(void) const
+{
+    pDense.clear();
+    pSorted.clear();
+    pIndexed = true;
+    uint n = pImportIDs.size();
+    if (n == 0) return;
+
+    int lo = *std::min_element(pImportIDs.begin(), pImportIDs.end());
+    int hi = *std::max_element(pImportIDs.begin(), pImportIDs.end());
+
+    // Meshers number from 0 or 1 without gaps, or nearly so; a table
+    // up to twice the element count covers that at one int per ID.
+    double span = static_cast<double>(hi) - static_cast<double>(lo) + 1.0;
+    if (span <= 2.0 * n + 16.0)
+    {
+        pDenseMin = lo;
+        pDense.assign(static_cast<uint>(span), -1);
+        for (uint i = 0; i < n; ++i)
+        {
+            int & slot = pDense[pImportIDs[i] - lo];
+            if (slot != -1) _duplicate(pImportIDs[i]);
+            slot = i;
+        }
+        return;
+    }
+
+    pSorted.reserve(n);
+    for (uint i = 0; i < n; ++i)
+    {
+        pSorted.push_back(std::make_pair(pImportIDs[i], i));
+    }
+    std::sort(pSorted.begin(), pSorted.end());
+    for (uint i = 1; i < n; ++i)
+    {
+        if (pSorted[i].first == pSorted[i - 1].first)
+        {
+            _duplicate(pSorted[i].first);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ElementMap::_duplicate(int import_id) const
+{
+    pIndexed = false;
+    pDense.clear();
+    pSorted.clear();
+    ostringstream os;
+    os << "Import ID " << import_id << " is used by more than one " << pType << ".";
+    throw steps::IOErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// A read-only memory-mapped text file, read line by line and token by
+// token without copying it.
+struct TextFile
+{
+    TextFile(string const & pathname)
+    : path(pathname)
+    , fd(-1)
+    , data(0)
+    , size(0)
+    , pos(0)
+    , lineno(0)
+    , cur(0)
+    , end(0)
+    {
+        fd = open(pathname.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd == -1 || fstat(fd, &st) != 0)
+        {
+            if (fd != -1) close(fd);
+            ostringstream os;
+            os << "Cannot open file \"" << pathname << "\"";
+            throw steps::IOErr(os.str());
+        }
+        size = st.st_size;
+        if (size != 0)
+        {
+            void * m = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m == MAP_FAILED)
+            {
+                close(fd);
+                ostringstream os;
+                os << "Cannot map file \"" << pathname << "\"";
+                throw steps::IOErr(os.str());
+            }
+            data = static_cast<char const *>(m);
+            madvise(m, size, MADV_SEQUENTIAL);
+        }
+    }
+
+    ~TextFile(void)
+    {
+        if (data != 0) munmap(const_cast<char *>(data), size);
+        close(fd);
+    }
+
+    // Move to the next line that is not blank once everything from
+    // comment on is cut off (comment 0 keeps the whole line). Return
+    // false at the end of the file.
+    bool nextLine(char comment = 0)
+    {
+        while (pos < size)
+        {
+            char const * b = data + pos;
+            char const * nl = static_cast<char const *>(memchr(b, '\n', size - pos));
+            char const * e = (nl != 0) ? nl : data + size;
+            pos = (nl != 0) ? (nl - data) + 1 : size;
+            ++lineno;
+            if (comment != 0)
+            {
+                char const * c = static_cast<char const *>(memchr(b, comment, e - b));
+                if (c != 0) e = c;
+            }
+            while (e != b && isSpace(e[-1])) --e;
+            while (b != e && isSpace(*b)) ++b;
+            if (b != e)
+            {
+                cur = b;
+                end = e;
+                return true;
+            }
+        }
+        cur = end = data + size;
+        return false;
+    }
+
+    // Move to the next line, which must exist.
+    void requireLine(char comment = 0)
+    {
+        if (!nextLine(comment)) fail("unexpected end of file");
+    }
+
+    // The rest of the current line.
+    string rest(void) const
+    {
+        return string(cur, end);
+    }
+
+    bool lineIs(char const * text) const
+    {
+        std::size_t n = strlen(text);
+        return static_cast<std::size_t>(end - cur) == n && memcmp(cur, text, n) == 0;
+    }
+
+    bool lineStarts(char const * text) const
+    {
+        std::size_t n = strlen(text);
+        return static_cast<std::size_t>(end - cur) >= n && memcmp(cur, text, n) == 0;
+    }
+
+    // Return the next token of the current line, separated by white
+    // space and, if commas is set, by commas.
+    string token(bool commas = false)
+    {
+        char const * b;
+        char const * e;
+        if (!nextToken(b, e, commas)) fail("too few values on line");
+        return string(b, e);
+    }
+
+    bool hasToken(bool commas = false)
+    {
+        while (cur != end && (isSpace(*cur) || (commas && *cur == ','))) ++cur;
+        return cur != end;
+    }
+
+    long integer(bool commas = false)
+    {
+        char buf[64];
+        char * e;
+        copyToken(buf, commas);
+        errno = 0;
+        long v = strtol(buf, &e, 10);
+        if (*e != 0 || e == buf || errno != 0) badNumber(buf);
+        return v;
+    }
+
+    double real(bool commas = false)
+    {
+        char buf[64];
+        char * e;
+        copyToken(buf, commas);
+        double v = strtod(buf, &e);
+        if (*e != 0 || e == buf) badNumber(buf);
+        return v;
+    }
+
+    void fail(string const & msg) const
+    {
+        ostringstream os;
+        os << "File \"" << path << "\", line " << lineno << ": " << msg << ".";
+        throw steps::IOErr(os.str());
+    }
+
+private:
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+    }
+
+    bool nextToken(char const *& b, char const *& e, bool commas)
+    {
+        if (!hasToken(commas)) return false;
+        b = cur;
+        while (cur != end && !isSpace(*cur) && !(commas && *cur == ',')) ++cur;
+        e = cur;
+        return true;
+    }
+
+    // The mapping has no terminating zero; numbers are parsed from a
+    // copy of their token.
+    void copyToken(char (&buf)[64], bool commas)
+    {
+        char const * b;
+        char const * e;
+        if (!nextToken(b, e, commas)) fail("too few values on line");
+        if (e - b >= 64) badNumber(string(b, e));
+        memcpy(buf, b, e - b);
+        buf[e - b] = 0;
+    }
+
+    void badNumber(string const & tok) const
+    {
+        fail("\"" + tok + "\" is not a number");
+    }
+
+public:
+
+    string                                      path;
+    int                                         fd;
+    char const                                * data;
+    std::size_t                                 size;
+    std::size_t                                 pos;
+    uint                                        lineno;
+    char const                                * cur;
+    char const                                * end;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Append the STEPS index of the node with import ID id to elems.
+inline void pushNode(TextFile & f, ElementMap const & nodes, long id,
+                     vector<uint> & elems)
+{
+    int sid = nodes.find(id);
+    if (sid < 0)
+    {
+        ostringstream os;
+        os << "no node with ID " << id;
+        f.fail(os.str());
+    }
+    elems.push_back(sid);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool fileExists(string const & pathname)
+{
+    struct stat st;
+    return stat(pathname.c_str(), &st) == 0;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Tetmesh * steps::tetmesh::importTetGen(string pathroot, ElementMap & nodes,
+                                       ElementMap & tets, ElementMap & tris)
+{
+    nodes = ElementMap("node");
+    tets = ElementMap("tet");
+    tris = ElementMap("tri");
+
+    vector<double> verts;
+    vector<uint> tetnodes;
+    vector<uint> trinodes;
+
+    // <input>.node: <# of points> <dimension (3)> <# of attributes>
+    // <boundary marker (0 or 1)>, then one line per point:
+    // <point #> <x> <y> <z> [attributes] [boundary marker]
+    {
+        TextFile f(pathroot + ".node");
+        f.requireLine('#');
+        long npoints = f.integer();
+        if (npoints <= 0) f.fail("no points");
+        if (f.integer() != 3) f.fail("points must be three-dimensional");
+        verts.reserve(npoints * 3);
+        for (long i = 0; i < npoints; ++i)
+        {
+            f.requireLine('#');
+            nodes.insert(f.integer());
+            verts.push_back(f.real());
+            verts.push_back(f.real());
+            verts.push_back(f.real());
+        }
+    }
+
+    // <input>.ele: <# of tetrahedra> <nodes per tetrahedron (4 or 10)>
+    // <# of attributes>, then one line per tetrahedron:
+    // <tetrahedron #> <node> <node> ... [attributes]
+    // Only the four corners of ten-node tetrahedra are read.
+    {
+        TextFile f(pathroot + ".ele");
+        f.requireLine('#');
+        long ntets = f.integer();
+        if (ntets <= 0) f.fail("no tetrahedra");
+        long npertet = f.integer();
+        if (npertet != 4 && npertet != 10) f.fail("tetrahedra must have 4 or 10 nodes");
+        long nattribs = f.hasToken() ? f.integer() : 0;
+        tetnodes.reserve(ntets * 4);
+        for (long i = 0; i < ntets; ++i)
+        {
+            f.requireLine('#');
+            uint sid = tets.insert(f.integer());
+            for (uint k = 0; k < 4; ++k) pushNode(f, nodes, f.integer(), tetnodes);
+            if (nattribs == 0) continue;
+            for (long k = 4; k < npertet; ++k) f.integer();
+            tets.addToGroup(f.token(), sid);
+        }
+    }
+
+    // <input>.face: <# of faces> <boundary marker (0 or 1)>, then one
+    // line per face: <face #> <node> <node> <node> [boundary marker]
+    string facename = pathroot + ".face";
+    if (fileExists(facename))
+    {
+        TextFile f(facename);
+        f.requireLine('#');
+        long nfaces = f.integer();
+        long markers = f.hasToken() ? f.integer() : 0;
+        trinodes.reserve(nfaces * 3);
+        for (long i = 0; i < nfaces; ++i)
+        {
+            f.requireLine('#');
+            uint sid = tris.insert(f.integer());
+            for (uint k = 0; k < 3; ++k) pushNode(f, nodes, f.integer(), trinodes);
+            if (markers != 0) tris.addToGroup(f.token(), sid);
+        }
+    }
+
+    return new Tetmesh(verts, tetnodes, trinodes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Tetmesh * steps::tetmesh::importGmsh(string filename, double scale,
+                                     ElementMap & nodes, ElementMap & tets,
+                                     ElementMap & tris)
+{
+    nodes = ElementMap("node");
+    tets = ElementMap("tet");
+    tris = ElementMap("tri");
+
+    vector<double> verts;
+    vector<uint> tetnodes;
+    vector<uint> trinodes;
+
+    TextFile f(filename);
+    f.requireLine();
+    if (!f.lineIs("$MeshFormat")) f.fail("not a Gmsh mesh file");
+    f.requireLine();
+    f.real();
+    if (f.integer() != 0) f.fail("only ASCII Gmsh files can be imported");
+    f.requireLine();
+    if (!f.lineIs("$EndMeshFormat")) f.fail("expected $EndMeshFormat");
+
+    bool seen_nodes = false;
+    while (f.nextLine())
+    {
+        if (f.lineIs("$Nodes"))
+        {
+            f.requireLine();
+            long nnodes = f.integer();
+            verts.reserve(nnodes * 3);
+            for (long i = 0; i < nnodes; ++i)
+            {
+                f.requireLine();
+                nodes.insert(f.integer());
+                verts.push_back(f.real() * scale);
+                verts.push_back(f.real() * scale);
+                verts.push_back(f.real() * scale);
+            }
+            f.requireLine();
+            if (!f.lineIs("$EndNodes")) f.fail("expected $EndNodes");
+            seen_nodes = true;
+        }
+        else if (f.lineIs("$Elements"))
+        {
+            if (!seen_nodes) f.fail("$Elements before $Nodes");
+            f.requireLine();
+            long nelems = f.integer();
+            for (long i = 0; i < nelems; ++i)
+            {
+                // <elm-number> <elm-type> <number-of-tags> <tag> ... <node> ...
+                f.requireLine();
+                long id = f.integer();
+                long type = f.integer();
+                if (type != 2 && type != 4) continue;
+                long ntags = f.integer();
+                string group;
+                for (long k = 0; k < ntags; ++k)
+                {
+                    string tag = f.token();
+                    if (k < 2) group = tag;
+                }
+                if (type == 4)
+                {
+                    uint sid = tets.insert(id);
+                    for (uint k = 0; k < 4; ++k) pushNode(f, nodes, f.integer(), tetnodes);
+                    if (ntags != 0) tets.addToGroup(group, sid);
+                }
+                else
+                {
+                    uint sid = tris.insert(id);
+                    for (uint k = 0; k < 3; ++k) pushNode(f, nodes, f.integer(), trinodes);
+                    if (ntags != 0) tris.addToGroup(group, sid);
+                }
+            }
+            f.requireLine();
+            if (!f.lineIs("$EndElements")) f.fail("expected $EndElements");
+        }
+        else if (f.lineStarts("$"))
+        {
+            // Skip any other section.
+            string endtag = "$End" + string(f.cur + 1, f.end);
+            do f.requireLine(); while (!f.lineIs(endtag.c_str()));
+        }
+        else
+        {
+            f.fail("expected a section");
+        }
+    }
+
+    return new Tetmesh(verts, tetnodes, trinodes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Tetmesh * steps::tetmesh::importAbaqus(string filename, double scale,
+                                       ElementMap & nodes, ElementMap & tets,
+                                       ElementMap & tris,
+                                       vector<string> const & blocks)
+{
+    nodes = ElementMap("node");
+    tets = ElementMap("tet");
+    tris = ElementMap("tri");
+
+    vector<double> verts;
+    vector<uint> tetnodes;
+    vector<uint> trinodes;
+
+    TextFile f(filename);
+    f.requireLine();
+    if (!f.lineIs("*HEADING")) f.fail("not an Abaqus input file (no *HEADING)");
+
+    // The section the data lines belong to, if any.
+    enum { NONE, NODES, TETS, TRIS } section = NONE;
+    ElementMap * current = 0;
+
+    while (f.nextLine())
+    {
+        if (f.lineStarts("**")) continue;
+
+        if (f.lineStarts("*"))
+        {
+            if (current != 0) current->blockEnd();
+            current = 0;
+            section = NONE;
+
+            // *KEYWORD, PARAM=VALUE, ...
+            string keyword = f.token(true);
+            string type;
+            string set;
+            while (f.hasToken(true))
+            {
+                string param = f.token(true);
+                std::size_t eq = param.find('=');
+                if (eq == string::npos) continue;
+                string name = param.substr(0, eq);
+                if (name == "TYPE") type = param.substr(eq + 1);
+                else if (name == "NSET" || name == "ELSET") set = param.substr(eq + 1);
+            }
+
+            if (keyword == "*NODE")
+            {
+                section = NODES;
+                current = &nodes;
+                current->blockBegin(set.empty() ? "AllNodes" : set);
+            }
+            else if (keyword == "*ELEMENT")
+            {
+                if (set.empty()) set = "AllElements";
+                if (!blocks.empty() &&
+                    std::find(blocks.begin(), blocks.end(), set) == blocks.end())
+                {
+                    continue;
+                }
+                if (type == "C3D4")
+                {
+                    section = TETS;
+                    current = &tets;
+                }
+                else if (type == "STRI3")
+                {
+                    section = TRIS;
+                    current = &tris;
+                }
+                if (current != 0) current->blockBegin(set);
+            }
+            continue;
+        }
+
+        switch (section)
+        {
+        case NODES:
+            nodes.insert(f.integer(true));
+            verts.push_back(f.real(true) * scale);
+            verts.push_back(f.real(true) * scale);
+            verts.push_back(f.real(true) * scale);
+            break;
+        case TETS:
+            tets.insert(f.integer(true));
+            for (uint k = 0; k < 4; ++k) pushNode(f, nodes, f.integer(true), tetnodes);
+            break;
+        case TRIS:
+            tris.insert(f.integer(true));
+            for (uint k = 0; k < 3; ++k) pushNode(f, nodes, f.integer(true), trinodes);
+            break;
+        case NONE:
+            break;
+        }
+    }
+    if (current != 0) current->blockEnd();
+
+    return new Tetmesh(verts, tetnodes, trinodes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
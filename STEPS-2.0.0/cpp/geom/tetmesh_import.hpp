@@ -0,0 +1,200 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPSis free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPSis distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETMESH_TETMESH_IMPORT_HPP
+#define STEPS_TETMESH_TETMESH_IMPORT_HPP 1
+
+
+// STEPS headers.
+#include "../common.h"
+
+// STL headers
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetmesh)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Forward & auxiliary declarations.
+class Tetmesh;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The nodes, tetrahedrons or triangles of a mesh read by one of the
+/// importers below, as far as the file says more about them than the
+/// Tetmesh keeps: the ID each element has in the file, and the groups
+/// and blocks of elements the file defines.
+///
+/// Elements get STEPS indices 0, 1, 2, ... in the order they appear in
+/// the file. Import IDs are kept in one array indexed by STEPS index;
+/// the reverse mapping is a table offset by the smallest ID when the
+/// IDs are (nearly) contiguous, as they usually are, and a sorted array
+/// otherwise.
+///
+/// A group is a list of STEPS indices that share an attribute in the
+/// file (a TetGen region attribute or boundary marker, a Gmsh entity
+/// tag). A block is a named run of consecutive STEPS indices (an Abaqus
+/// *NODE or *ELEMENT section).
+///
+class ElementMap
+{
+
+public:
+
+    ElementMap(std::string const & type = "");
+
+    /// "node", "tet" or "tri".
+    ///
+    std::string getType(void) const
+    { return pType; }
+
+    /// Return the number of elements.
+    ///
+    uint getSize(void) const
+    { return pImportIDs.size(); }
+
+    /// Return the import ID of each element, indexed by STEPS index.
+    ///
+    std::vector<int> const & getImportIDs(void) const
+    { return pImportIDs; }
+
+    /// Return the import ID of the element with STEPS index steps_id.
+    ///
+    int getImportID(uint steps_id) const;
+
+    /// Return the STEPS index of the element with import ID import_id.
+    ///
+    uint getSTEPSID(int import_id) const;
+
+    std::vector<std::string> getGroupNames(void) const;
+
+    /// Return the STEPS indices of the elements in group name.
+    ///
+    std::vector<uint> const & getGroup(std::string const & name) const;
+
+    std::vector<std::string> getBlockNames(void) const;
+
+    /// Return the STEPS indices of the first and the last element of
+    /// block name.
+    ///
+    std::vector<uint> getBlock(std::string const & name) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // FILLED IN BY THE IMPORTERS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Forget all elements, groups and blocks.
+    ///
+    void clear(void);
+
+    /// Add an element and return its STEPS index.
+    ///
+    uint insert(int import_id);
+
+    void addToGroup(std::string const & name, uint steps_id);
+
+    /// Start a block with the next element inserted; ends any block
+    /// still open.
+    ///
+    void blockBegin(std::string const & name);
+
+    /// End the open block, if any.
+    ///
+    void blockEnd(void);
+
+    /// Return the STEPS index of import_id, or -1 if there is none.
+    ///
+    int find(int import_id) const;
+
+private:
+
+    // (Re)build the import ID to STEPS index table.
+    void _index(void) const;
+
+    // Throw IOErr for an import ID given to two elements.
+    void _duplicate(int import_id) const;
+
+    std::string                                     pType;
+    std::vector<int>                                pImportIDs;
+    std::map<std::string, std::vector<uint> >       pGroups;
+    std::map<std::string, std::pair<uint, uint> >   pBlocks;
+    std::string                                     pOpenBlock;
+    int                                             pOpenBlockStart;
+
+    // Import ID to STEPS index, built on the first lookup after an
+    // insertion: either pDense, offset by pDenseMin (-1 where there is
+    // no element), or pSorted, ordered by import ID.
+    mutable bool                                    pIndexed;
+    mutable int                                     pDenseMin;
+    mutable std::vector<int>                        pDense;
+    mutable std::vector<std::pair<int, uint> >      pSorted;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The importers below read the mesh files of other programs straight
+/// into a Tetmesh. Each file is memory-mapped and parsed in place, and
+/// the nodes, tetrahedrons and triangles go into nodes, tets and tris
+/// (which are cleared first). They throw steps::IOErr, naming the file
+/// and line, if a file cannot be read or is not in the expected format.
+/// The caller owns the Tetmesh returned.
+
+/// Read a TetGen mesh from pathroot.node, pathroot.ele and, if it
+/// exists, pathroot.face. Tetrahedrons with a region attribute are
+/// grouped by it, triangles with a boundary marker by that.
+///
+Tetmesh * importTetGen(std::string pathroot, ElementMap & nodes,
+                       ElementMap & tets, ElementMap & tris);
+
+/// Read an ASCII Gmsh mesh (format 2), multiplying the coordinates by
+/// scale. Tetrahedrons (type 4) and triangles (type 2) are grouped by
+/// their second tag, the elementary entity; other elements are skipped.
+///
+Tetmesh * importGmsh(std::string filename, double scale, ElementMap & nodes,
+                     ElementMap & tets, ElementMap & tris);
+
+/// Read an Abaqus mesh, multiplying the coordinates by scale. Each
+/// *NODE and *ELEMENT section becomes a block named after its NSET or
+/// ELSET (AllNodes or AllElements if it has none). Only C3D4 and STRI3
+/// elements are read, and if blocks is not empty only those of the
+/// element sections it names.
+///
+Tetmesh * importAbaqus(std::string filename, double scale, ElementMap & nodes,
+                       ElementMap & tets, ElementMap & tris,
+                       std::vector<std::string> const & blocks = std::vector<std::string>());
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetmesh)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETMESH_TETMESH_IMPORT_HPP
+
+// END
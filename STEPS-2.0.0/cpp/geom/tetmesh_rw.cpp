@@ -31,6 +31,7 @@
 
 // STL headers.
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -38,10 +39,18 @@
 #include <sstream>
 #include <vector>
 
+// POSIX headers.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 // STEPS headers.
 #include "../common.h"
 #include "../error.hpp"
 #include "comp.hpp"
+#include "diffboundary.hpp"
+#include "memb.hpp"
 #include "patch.hpp"
 #include "tetmesh_rw.hpp"
 #include "tetmesh.hpp"
@@ -56,6 +65,8 @@ USING(std, ostringstream);
 USING(std, set);
 USING(std, string);
 USING(std, vector);
+USING(steps::tetmesh, DiffBoundary);
+USING(steps::tetmesh, Memb);
 USING(steps::tetmesh, Tetmesh);
 USING(steps::tetmesh, TmComp);
 USING(steps::tetmesh, TmPatch);
@@ -391,4 +402,431 @@ void steps::tetmesh::saveASCII(string pathname, Tetmesh * m)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Byte order mark of the binary format.
+#define TETMESH_BINARY_BOM              0x01020304u
+
+// Write size bytes from data followed by zeros up to a multiple of 8.
+static void writeBlock(std::ostream & os, void const * data, std::size_t size)
+{
+    static char const zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    if (size != 0) os.write(static_cast<char const *>(data), size);
+    if ((size % 8) != 0) os.write(zeros, 8 - (size % 8));
+}
+
+static void writeName(std::ostream & os, string const & name)
+{
+    uint len = name.size();
+    writeBlock(os, &len, sizeof(uint));
+    writeBlock(os, name.data(), len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A read-only memory-mapped binary mesh file, read block by block. A
+// shared image can hand its mapping over with release().
+struct MeshImage
+{
+    MeshImage(string const & pathname, bool shared = false)
+    : path(pathname)
+    , fd(-1)
+    , data(0)
+    , size(0)
+    , pos(0)
+    , owner(true)
+    {
+        fd = open(pathname.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd == -1 || fstat(fd, &st) != 0)
+        {
+            if (fd != -1) close(fd);
+            ostringstream os;
+            os << "Cannot open file \"" << pathname << "\"";
+            throw steps::IOErr(os.str());
+        }
+        size = st.st_size;
+        if (size != 0)
+        {
+            void * m = mmap(0, size, PROT_READ, shared ? MAP_SHARED : MAP_PRIVATE,
+                            fd, 0);
+            if (m == MAP_FAILED)
+            {
+                close(fd);
+                ostringstream os;
+                os << "Cannot map file \"" << pathname << "\"";
+                throw steps::IOErr(os.str());
+            }
+            data = static_cast<char const *>(m);
+        }
+    }
+
+    ~MeshImage(void)
+    {
+        if (data != 0 && owner == true) munmap(const_cast<char *>(data), size);
+        close(fd);
+    }
+
+    // Give up the mapping; the caller unmaps it.
+    char * release(void)
+    {
+        owner = false;
+        return const_cast<char *>(data);
+    }
+
+    // Return the next block of n bytes.
+    char const * take(std::size_t n)
+    {
+        std::size_t padded = n + ((8 - (n % 8)) % 8);
+        if (padded < n || size - pos < padded) truncated();
+        char const * b = data + pos;
+        pos += padded;
+        return b;
+    }
+
+    void truncated(void) const
+    {
+        ostringstream os;
+        os << "File \"" << path << "\" is truncated or not a binary mesh.";
+        throw steps::IOErr(os.str());
+    }
+
+    // Copy the next block of n elements to out.
+    template <class T>
+    void copy(T * out, std::size_t n)
+    {
+        if (n > (size - pos) / sizeof(T)) truncated();
+        std::memcpy(out, take(n * sizeof(T)), n * sizeof(T));
+    }
+
+    // Point out at the next block of n elements in place; blocks start on
+    // 8 byte boundaries of the page aligned mapping.
+    template <class T>
+    void attach(T *& out, std::size_t n)
+    {
+        if (n > (size - pos) / sizeof(T)) truncated();
+        out = reinterpret_cast<T *>(const_cast<char *>(take(n * sizeof(T))));
+    }
+
+    string name(void)
+    {
+        uint len;
+        copy(&len, 1);
+        return string(take(len), len);
+    }
+
+    string                      path;
+    int                         fd;
+    char const                * data;
+    std::size_t                 size;
+    std::size_t                 pos;
+    bool                        owner;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+Tetmesh * steps::tetmesh::loadBinary(string pathname, bool shared)
+{
+    MeshImage mf(pathname, shared);
+
+    if (std::memcmp(mf.take(8), TETMESH_BINARY_MAGIC, 8) != 0)
+    {
+        ostringstream os;
+        os << "File \"" << pathname << "\" is not a binary mesh.";
+        throw steps::IOErr(os.str());
+    }
+    uint head[8];
+    mf.copy(head, 8);
+    if (head[1] != TETMESH_BINARY_BOM)
+    {
+        ostringstream os;
+        os << "Binary mesh \"" << pathname << "\" was written on a machine ";
+        os << "with a different byte order.";
+        throw steps::IOErr(os.str());
+    }
+    if (head[0] == 0 || head[0] > TETMESH_BINARY_VERSION)
+    {
+        ostringstream os;
+        os << "Binary mesh \"" << pathname << "\" has version " << head[0];
+        os << ", expected at most " << TETMESH_BINARY_VERSION << ".";
+        throw steps::IOErr(os.str());
+    }
+    uint nverts = head[2];
+    uint nbars = head[3];
+    uint ntris = head[4];
+    uint ntets = head[5];
+    uint ncomps = head[6];
+    uint npatches = head[7];
+
+    // The tables must fit in the file before anything is allocated.
+    double need = nverts * 24.0 + nbars * 8.0 + ntris * 80.0 + ntets * 88.0;
+    if (need > static_cast<double>(mf.size - mf.pos)) mf.truncated();
+
+    Tetmesh * m = new Tetmesh(nverts, nbars, ntris, ntets, shared == false);
+    if (shared == true)
+    {
+        // The mesh unmaps the file from now on, even if loading fails.
+        m->pMapped = mf.release();
+        m->pMappedSize = mf.size;
+    }
+    try
+    {
+        double bounds[6];
+        mf.copy(bounds, 6);
+        m->pXmin = bounds[0];
+        m->pXmax = bounds[1];
+        m->pYmin = bounds[2];
+        m->pYmax = bounds[3];
+        m->pZmin = bounds[4];
+        m->pZmax = bounds[5];
+
+        if (shared == true)
+        {
+            mf.attach(m->pVerts, nverts * 3);
+            mf.attach(m->pBars, nbars * 2);
+            mf.attach(m->pTris, ntris * 3);
+            mf.attach(m->pTri_bars, ntris * 3);
+            mf.attach(m->pTri_areas, ntris);
+            mf.attach(m->pTri_barycs, ntris * 3);
+            mf.attach(m->pTri_norms, ntris * 3);
+            mf.attach(m->pTri_tet_neighbours, ntris * 2);
+            mf.attach(m->pTets, ntets * 4);
+            mf.attach(m->pTet_vols, ntets);
+            mf.attach(m->pTet_barycentres, ntets * 3);
+            mf.attach(m->pTet_tri_neighbours, ntets * 4);
+            mf.attach(m->pTet_tet_neighbours, ntets * 4);
+        }
+        else
+        {
+            mf.copy(m->pVerts, nverts * 3);
+            mf.copy(m->pBars, nbars * 2);
+            mf.copy(m->pTris, ntris * 3);
+            mf.copy(m->pTri_bars, ntris * 3);
+            mf.copy(m->pTri_areas, ntris);
+            mf.copy(m->pTri_barycs, ntris * 3);
+            mf.copy(m->pTri_norms, ntris * 3);
+            mf.copy(m->pTri_tet_neighbours, ntris * 2);
+            mf.copy(m->pTets, ntets * 4);
+            mf.copy(m->pTet_vols, ntets);
+            mf.copy(m->pTet_barycentres, ntets * 3);
+            mf.copy(m->pTet_tri_neighbours, ntets * 4);
+            mf.copy(m->pTet_tet_neighbours, ntets * 4);
+        }
+
+        vector<TmComp*> comps(ncomps);
+        for (uint c = 0; c < ncomps; ++c)
+        {
+            string compid = mf.name();
+            uint cnt[2];
+            mf.copy(cnt, 2);
+            vector<string> volsys(cnt[0]);
+            for (uint v = 0; v < cnt[0]; ++v) volsys[v] = mf.name();
+            if (cnt[1] > (mf.size - mf.pos) / sizeof(uint)) mf.truncated();
+            vector<uint> comptets(cnt[1]);
+            if (cnt[1] != 0) mf.copy(&comptets[0], cnt[1]);
+
+            comps[c] = new TmComp(compid, m, comptets);
+            for (uint v = 0; v < cnt[0]; ++v) comps[c]->addVolsys(volsys[v]);
+        }
+
+        for (uint p = 0; p < npatches; ++p)
+        {
+            string patchid = mf.name();
+            int cnt[4];
+            mf.copy(cnt, 4);
+            TmComp * icomp = 0;
+            TmComp * ocomp = 0;
+            for (uint i = 0; i < 2; ++i)
+            {
+                if (cnt[i] < -1 || cnt[i] >= static_cast<int>(ncomps))
+                {
+                    ostringstream os;
+                    os << "Binary mesh \"" << pathname << "\" refers to ";
+                    os << "an unknown compartment.";
+                    throw steps::IOErr(os.str());
+                }
+            }
+            if (cnt[0] != -1) icomp = comps[cnt[0]];
+            if (cnt[1] != -1) ocomp = comps[cnt[1]];
+            uint nsurfsys = static_cast<uint>(cnt[2]);
+            uint ntris_in_p = static_cast<uint>(cnt[3]);
+            vector<string> surfsys(nsurfsys);
+            for (uint s = 0; s < nsurfsys; ++s) surfsys[s] = mf.name();
+            if (ntris_in_p > (mf.size - mf.pos) / sizeof(uint)) mf.truncated();
+            vector<uint> patchtris(ntris_in_p);
+            if (ntris_in_p != 0) mf.copy(&patchtris[0], ntris_in_p);
+
+            TmPatch * patch = new TmPatch(patchid, m, patchtris, icomp, ocomp);
+            for (uint s = 0; s < nsurfsys; ++s) patch->addSurfsys(surfsys[s]);
+        }
+
+        // Version 1 files end here.
+        uint nmembs = 0;
+        if (head[0] >= 2) mf.copy(&nmembs, 1);
+        for (uint i = 0; i < nmembs; ++i)
+        {
+            string membid = mf.name();
+            string optfile = mf.name();
+            uint cnt[5];
+            mf.copy(cnt, 5);
+            if (cnt[2] + static_cast<double>(cnt[3]) + cnt[4]
+                > (mf.size - mf.pos) / sizeof(uint)) mf.truncated();
+            vector<uint> membtris(cnt[2]);
+            vector<uint> membtets(cnt[3]);
+            vector<uint> membvirts(cnt[4]);
+            if (cnt[2] != 0) mf.copy(&membtris[0], cnt[2]);
+            if (cnt[3] != 0) mf.copy(&membtets[0], cnt[3]);
+            if (cnt[4] != 0) mf.copy(&membvirts[0], cnt[4]);
+
+            new Memb(membid, m, membtris, membtets, membvirts,
+                     cnt[0] != 0, cnt[1], optfile);
+        }
+
+        // Version 2 files end here.
+        uint ndiffbs = 0;
+        if (head[0] >= 3) mf.copy(&ndiffbs, 1);
+        for (uint i = 0; i < ndiffbs; ++i)
+        {
+            string diffbid = mf.name();
+            uint ndbtris;
+            mf.copy(&ndbtris, 1);
+            if (ndbtris > (mf.size - mf.pos) / sizeof(uint)) mf.truncated();
+            vector<uint> dbtris(ndbtris);
+            if (ndbtris != 0) mf.copy(&dbtris[0], ndbtris);
+
+            new DiffBoundary(diffbid, m, dbtris);
+        }
+    }
+    catch (...)
+    {
+        delete m;
+        throw;
+    }
+
+    return m;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::tetmesh::saveBinary(string pathname, Tetmesh * m)
+{
+    if (m == 0)
+    {
+        ostringstream os;
+        os << "No model specified";
+        throw steps::ArgErr(os.str());
+    }
+
+    ofstream mf(pathname.c_str(), std::ios::out | std::ios::binary);
+    if (!mf)
+    {
+        ostringstream os;
+        os << "Cannot open file \"" << pathname << "\"";
+        throw steps::IOErr(os.str());
+    }
+
+    uint ncomps = m->_countComps();
+    uint npatches = m->_countPatches();
+    map<Comp*, int> compidx;
+    for (uint c = 0; c < ncomps; ++c) compidx[m->_getComp(c)] = c;
+
+    uint nverts = m->pVertsN;
+    uint nbars = m->pBarsN;
+    uint ntris = m->pTrisN;
+    uint ntets = m->pTetsN;
+    uint head[8] = {TETMESH_BINARY_VERSION, TETMESH_BINARY_BOM,
+                    nverts, nbars, ntris, ntets, ncomps, npatches};
+    double bounds[6] = {m->pXmin, m->pXmax, m->pYmin, m->pYmax, m->pZmin, m->pZmax};
+    writeBlock(mf, TETMESH_BINARY_MAGIC, 8);
+    writeBlock(mf, head, sizeof(head));
+    writeBlock(mf, bounds, sizeof(bounds));
+
+    writeBlock(mf, m->pVerts, nverts * 3 * sizeof(double));
+    writeBlock(mf, m->pBars, nbars * 2 * sizeof(uint));
+    writeBlock(mf, m->pTris, ntris * 3 * sizeof(uint));
+    writeBlock(mf, m->pTri_bars, ntris * 3 * sizeof(uint));
+    writeBlock(mf, m->pTri_areas, ntris * sizeof(double));
+    writeBlock(mf, m->pTri_barycs, ntris * 3 * sizeof(double));
+    writeBlock(mf, m->pTri_norms, ntris * 3 * sizeof(double));
+    writeBlock(mf, m->pTri_tet_neighbours, ntris * 2 * sizeof(int));
+    writeBlock(mf, m->pTets, ntets * 4 * sizeof(uint));
+    writeBlock(mf, m->pTet_vols, ntets * sizeof(double));
+    writeBlock(mf, m->pTet_barycentres, ntets * 3 * sizeof(double));
+    writeBlock(mf, m->pTet_tri_neighbours, ntets * 4 * sizeof(uint));
+    writeBlock(mf, m->pTet_tet_neighbours, ntets * 4 * sizeof(int));
+
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        TmComp * comp = dynamic_cast<TmComp*>(m->_getComp(c));
+        assert(comp != 0);
+        set<string> volsys = comp->getVolsys();
+        vector<uint> const & tets = comp->_getAllTetIndices();
+        uint cnt[2] = {static_cast<uint>(volsys.size()), static_cast<uint>(tets.size())};
+        writeName(mf, comp->getID());
+        writeBlock(mf, cnt, sizeof(cnt));
+        for (set<string>::const_iterator v = volsys.begin(); v != volsys.end(); ++v)
+        {
+            writeName(mf, *v);
+        }
+        if (tets.empty() == false) writeBlock(mf, &tets[0], tets.size() * sizeof(uint));
+    }
+
+    for (uint p = 0; p < npatches; ++p)
+    {
+        TmPatch * patch = dynamic_cast<TmPatch*>(m->_getPatch(p));
+        assert(patch != 0);
+        set<string> surfsys = patch->getSurfsys();
+        vector<uint> const & tris = patch->_getAllTriIndices();
+        int cnt[4] = {-1, -1, static_cast<int>(surfsys.size()), static_cast<int>(tris.size())};
+        if (patch->getIComp() != 0) cnt[0] = compidx[patch->getIComp()];
+        if (patch->getOComp() != 0) cnt[1] = compidx[patch->getOComp()];
+        writeName(mf, patch->getID());
+        writeBlock(mf, cnt, sizeof(cnt));
+        for (set<string>::const_iterator s = surfsys.begin(); s != surfsys.end(); ++s)
+        {
+            writeName(mf, *s);
+        }
+        if (tris.empty() == false) writeBlock(mf, &tris[0], tris.size() * sizeof(uint));
+    }
+
+    uint nmembs = m->_countMembs();
+    writeBlock(mf, &nmembs, sizeof(uint));
+    for (uint i = 0; i < nmembs; ++i)
+    {
+        Memb * memb = m->_getMemb(i);
+        vector<uint> const & tris = memb->_getAllTriIndices();
+        vector<uint> const & tets = memb->_getAllVolTetIndices();
+        vector<uint> const & virts = memb->_getAllVirtTriIndices();
+        uint cnt[5] = {memb->open() ? 1u : 0u, memb->_getOpt_method(),
+                       static_cast<uint>(tris.size()), static_cast<uint>(tets.size()),
+                       static_cast<uint>(virts.size())};
+        writeName(mf, memb->getID());
+        writeName(mf, memb->_getOpt_file_name());
+        writeBlock(mf, cnt, sizeof(cnt));
+        if (tris.empty() == false) writeBlock(mf, &tris[0], tris.size() * sizeof(uint));
+        if (tets.empty() == false) writeBlock(mf, &tets[0], tets.size() * sizeof(uint));
+        if (virts.empty() == false) writeBlock(mf, &virts[0], virts.size() * sizeof(uint));
+    }
+
+    uint ndiffbs = m->_countDiffBoundaries();
+    writeBlock(mf, &ndiffbs, sizeof(uint));
+    for (uint i = 0; i < ndiffbs; ++i)
+    {
+        DiffBoundary * diffb = m->_getDiffBoundary(i);
+        vector<uint> const & tris = diffb->_getAllTriIndices();
+        uint ndbtris = tris.size();
+        writeName(mf, diffb->getID());
+        writeBlock(mf, &ndbtris, sizeof(uint));
+        if (tris.empty() == false) writeBlock(mf, &tris[0], tris.size() * sizeof(uint));
+    }
+
+    mf.close();
+    if (!mf)
+    {
+        ostringstream os;
+        os << "Cannot write file \"" << pathname << "\"";
+        throw steps::IOErr(os.str());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
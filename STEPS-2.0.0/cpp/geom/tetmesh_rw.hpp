@@ -112,6 +112,61 @@ void saveASCII(std::string pathname, Tetmesh * m);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// Magic string at the start of a binary mesh file.
+#define TETMESH_BINARY_MAGIC            "STEPSMSH"
+/// Version of the binary mesh format written by saveBinary.
+#define TETMESH_BINARY_VERSION          3
+
+//@{
+/// loadBinary() and saveBinary() read and write a tetmesh in a binary
+/// format that holds all of its tables, so that loading a mesh is
+/// little more than copying them out of the memory-mapped file: no
+/// bars, neighbours, areas, normals, volumes or barycentres are
+/// recomputed. The file consists of blocks, each padded to a multiple
+/// of 8 bytes:
+///
+/// <OL>
+/// <LI>The magic string TETMESH_BINARY_MAGIC.
+/// <LI>The version, the byte order mark 0x01020304 and the number of
+///     vertices, bars, triangles, tetrahedrons, compartments and
+///     patches, as unsigned 32 bit integers.
+/// <LI>The bounds of the mesh: xmin, xmax, ymin, ymax, zmin, zmax.
+/// <LI>The tables, in this order: vertices, bars, triangles, bars of
+///     the triangles, areas, barycentres, normals and tetrahedron
+///     neighbours of the triangles, tetrahedrons, volumes and
+///     barycentres, triangle neighbours and tetrahedron neighbours of
+///     the tetrahedrons.
+/// <LI>For each compartment its name, the number of volume systems
+///     and tetrahedrons, then the names of the volume systems and the
+///     tetrahedron indices.
+/// <LI>For each patch its name, the indices of the inner and outer
+///     compartment in the compartment list above (-1 if none), the
+///     number of surface systems and triangles, then the names of the
+///     surface systems and the triangle indices.
+/// <LI>From version 2, the number of membranes and for each membrane
+///     its name, the name of its optimization file, whether it is open,
+///     its optimization method and the number of triangles, volume
+///     tetrahedrons and virtual triangles, then those three lists.
+/// <LI>From version 3, the number of diffusion boundaries and for each
+///     its name and number of triangles, then the triangle indices.
+/// </OL>
+///
+/// A name is stored as its length followed by its characters.
+/// Integers and doubles are in the byte order of the machine that wrote
+/// the file, and loadBinary refuses files with a different byte order.
+/// A membrane is loaded without being verified again.
+///
+/// With shared set, the geometry tables are not copied but used in place
+/// in a read-only shared mapping of the file, so that processes loading
+/// the same file share one copy of them in the page cache. Such a mesh
+/// keeps the file mapped until it is deleted.
+///
+Tetmesh * loadBinary(std::string pathname, bool shared = false);
+void saveBinary(std::string pathname, Tetmesh * m);
+//@}
+
+////////////////////////////////////////////////////////////////////////////////
+
 END_NAMESPACE(tetmesh)
 END_NAMESPACE(steps)
 
@@ -77,24 +77,14 @@ stetmesh::TmComp::TmComp(std::string const & id, Tetmesh * container,
 	for(uint i=0; i< tets.size(); ++i)
 	{
 		// perform some checks on this tet
-		bool included = false;
-		for (uint j=0; j < pTetsN; ++j)
-		{
-			// check if tet has already occurred in this list (duplicate)
-			if (tets[i] == pTet_indices[j])
-			{
-				included = true;
-				break;
-			}
-		}
-		if (included == true) continue;
-
 		if (tets[i] > maxidx)
 		{
 			std::ostringstream os;
 			os << "Invalid index supplied for tetrahedron #" << i << " in list.\n";
 			throw steps::ArgErr(os.str());
 		}
+		// check if tet has already occurred in this list (duplicate)
+		if (pTetmesh->getTetComp(tets[i]) == this) continue;
 		if (pTetmesh->getTetComp(tets[i]) != 0)
 		{
 			std::ostringstream os;
@@ -192,21 +182,13 @@ std::vector<double> stetmesh::TmComp::getBoundMax(void) const
 
 std::vector<bool> stetmesh::TmComp::isTetInside(std::vector<uint> tet) const
 {
+	// The mesh records the compartment of each tetrahedron.
 	uint notets = tet.size();
+	uint ntets = pTetmesh->countTets();
 	std::vector<bool> inside(notets);
 	for (uint i=0; i < notets; ++i)
 	{
-		bool tetinside = false;
-		for (uint j=0; j< pTet_indices.size() ; ++j)
-		{
-			if (tet[i] == pTet_indices[j])
-			{
-				tetinside = true;
-				break;
-			}
-		}
-		if (tetinside == true) inside[i] = true;
-		else inside[i] = false;
+		inside[i] = (tet[i] < ntets && pTetmesh->getTetComp(tet[i]) == this);
 	}
 	return inside;
 }
@@ -80,24 +80,14 @@ stetmesh::TmPatch::TmPatch(std::string const & id, Tetmesh * container,
     for (uint i=0; i < tris.size(); ++i)
     {
     	// perform some checks on this triangle
-    	bool included = false;
-    	for(uint j = 0; j <pTrisN; ++j)
-    	{
-    		// check if tri has already occured in this list (duplicate)
-    		if (tris[i] == pTri_indices[j])
-    		{
-    			included = true;
-    			break;
-    		}
-    	}
-    	if (included == true) continue;
-
     	if (tris[i] > maxidx)
     	{
     		std::ostringstream os;
     		os << "Invalid index supplied for triangle #" << i << " in list.\n";
     		throw steps::ArgErr(os.str());
     	}
+    	// check if tri has already occured in this list (duplicate)
+    	if (pTetmesh->getTriPatch(tris[i]) == this) continue;
     	if (pTetmesh->getTriPatch(tris[i]) != 0)
     	{
     		std::ostringstream os;
@@ -237,24 +227,14 @@ stetmesh::TmPatch::TmPatch(std::string const & id, Tetmesh * container,
     for (uint i=0; i <tris.size(); ++i)
     {
     	// perform some checks on this triangle
-    	bool included = false;
-    	for(uint j = 0; j <pTrisN; ++j)
-    	{
-    		// check if tri has already occured in this list (duplicate)
-    		if (tris[i] == pTri_indices[j])
-    		{
-    			included = true;
-    			break;
-    		}
-    	}
-    	if (included == true) continue;
-
     	if (tris[i] > maxidx)
     	{
     		std::ostringstream os;
     		os << "Invalid index supplied for triangle #" << i << " in list.\n";
     		throw steps::ArgErr(os.str());
     	}
+    	// check if tri has already occured in this list (duplicate)
+    	if (pTetmesh->getTriPatch(tris[i]) == this) continue;
     	if (pTetmesh->getTriPatch(tris[i]) != 0)
     	{
     		std::ostringstream os;
@@ -371,21 +351,13 @@ stetmesh::TmPatch::~TmPatch(void)
 
 std::vector<bool> stetmesh::TmPatch::isTriInside(std::vector<uint> tri) const
 {
+	// The mesh records the patch of each triangle.
 	uint notris = tri.size();
+	uint ntris = pTetmesh->countTris();
 	std::vector<bool> inside(notris);
 	for (uint i=0; i < notris; ++i)
 	{
-		bool triinside = false;
-		for (uint j=0; j< pTri_indices.size() ; ++j)
-		{
-			if (tri[i] == pTri_indices[j])
-			{
-				triinside = true;
-				break;
-			}
-		}
-		if (triinside == true) inside[i] = true;
-		else inside[i] = false;
+		inside[i] = (tri[i] < ntris && pTetmesh->getTriPatch(tri[i]) == this);
 	}
 	return inside;
 }
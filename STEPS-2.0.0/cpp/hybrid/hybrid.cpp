@@ -0,0 +1,810 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// STL headers.
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "hybrid.hpp"
+#include "../error.hpp"
+#include "../math/constants.hpp"
+#include "../geom/tmcomp.hpp"
+#include "../geom/tmpatch.hpp"
+#include "../solver/compdef.hpp"
+#include "../solver/patchdef.hpp"
+#include "../solver/reacdef.hpp"
+#include "../solver/sreacdef.hpp"
+#include "../solver/diffdef.hpp"
+#include "../solver/surfdiffdef.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::hybrid, shybrid);
+NAMESPACE_ALIAS(steps::solver, ssolver);
+NAMESPACE_ALIAS(steps::math, smath);
+
+////////////////////////////////////////////////////////////////////////////////
+
+shybrid::Hybrid::Hybrid(steps::model::Model * m, steps::wm::Geom * g,
+                        steps::rng::RNG * r, std::string const & scheduler)
+: API(m, g, r)
+, pMesh(0)
+, pSSA(0)
+, pODE(0)
+, pDet()
+, pCompTets()
+, pPatchTris()
+, pSyncTet()
+, pSyncTetSpec()
+, pSyncTetSet()
+, pSyncTetCarry()
+, pSyncTri()
+, pSyncTriSpec()
+, pSyncTriSet()
+, pSyncTriCarry()
+, pAnyDet(false)
+, pSyncDT(1.0e-4)
+{
+    if (! (pMesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom())))
+    {
+        std::ostringstream os;
+        os << "Geometry description to steps::solver::Hybrid solver";
+        os << " constructor is not a valid steps::tetmesh::Tetmesh object.";
+        throw steps::ArgErr(os.str());
+    }
+
+    uint ncomps = statedef()->countComps();
+    pCompTets.resize(ncomps);
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        steps::tetmesh::TmComp * tmcomp =
+            dynamic_cast<steps::tetmesh::TmComp*>(pMesh->_getComp(c));
+        assert(tmcomp != 0);
+        pCompTets[c] = tmcomp->_getAllTetIndices();
+    }
+    uint npatches = statedef()->countPatches();
+    pPatchTris.resize(npatches);
+    for (uint p = 0; p < npatches; ++p)
+    {
+        steps::tetmesh::TmPatch * tmpatch =
+            dynamic_cast<steps::tetmesh::TmPatch*>(pMesh->_getPatch(p));
+        assert(tmpatch != 0);
+        pPatchTris[p] = tmpatch->_getAllTriIndices();
+    }
+
+    pSSA = new steps::tetexact::Tetexact(m, g, r, false, scheduler);
+    pODE = new steps::tetode::TetODE(m, g, r);
+
+    pDet.assign(statedef()->countSpecs(), false);
+    _applyPartition();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+shybrid::Hybrid::~Hybrid(void)
+{
+    delete pSSA;
+    delete pODE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string shybrid::Hybrid::getSolverName(void) const
+{
+    return "hybrid";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string shybrid::Hybrid::getSolverDesc(void) const
+{
+    return "Partitioned SSA and ODE reaction-diffusion solver in tetrahedral mesh";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string shybrid::Hybrid::getSolverAuthors(void) const
+{
+    return "Iain Hepburn, Weiliang Chen and Stefan Wils";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string shybrid::Hybrid::getSolverEmail(void) const
+{
+    return "steps.dev@gmail.com";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::checkpoint(std::string const & file_name)
+{
+    std::ostringstream os;
+    os << "checkpoint() not implemented for steps::solver::Hybrid solver";
+    throw steps::NotImplErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::restore(std::string const & file_name)
+{
+    std::ostringstream os;
+    os << "restore() not implemented for steps::solver::Hybrid solver";
+    throw steps::NotImplErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::reset(void)
+{
+    std::ostringstream os;
+    os << "reset() not implemented for steps::solver::Hybrid solver";
+    throw steps::NotImplErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::run(double endtime)
+{
+    double t = getTime();
+    if (endtime < t)
+    {
+        std::ostringstream os;
+        os << "Endtime is before current simulation time";
+        throw steps::ArgErr(os.str());
+    }
+
+    if (not pAnyDet)
+    {
+        pSSA->run(endtime);
+        statedef()->setTime(endtime);
+        return;
+    }
+
+    uint ntets = pSyncTet.size();
+    uint ntris = pSyncTri.size();
+    while (t < endtime)
+    {
+        double t1 = std::min(t + pSyncDT, endtime);
+
+        // The SSA sees the deterministic species at the start of the
+        // window; _set*Count rounds them stochastically.
+        for (uint i = 0; i < ntets; ++i)
+        {
+            uint tidx = pSyncTet[i];
+            uint sidx = pSyncTetSpec[i];
+            double n = pODE->_getTetCount(tidx, sidx) + pSyncTetCarry[i];
+            pSSA->_setTetCount(tidx, sidx, std::max(n, 0.0));
+            pSyncTetSet[i] = pSSA->_getTetCount(tidx, sidx);
+        }
+        for (uint i = 0; i < ntris; ++i)
+        {
+            uint tidx = pSyncTri[i];
+            uint sidx = pSyncTriSpec[i];
+            double n = pODE->_getTriCount(tidx, sidx) + pSyncTriCarry[i];
+            pSSA->_setTriCount(tidx, sidx, std::max(n, 0.0));
+            pSyncTriSet[i] = pSSA->_getTriCount(tidx, sidx);
+        }
+
+        pSSA->run(t1);
+
+        // Hand what the stochastic processes did to them back to the ODE.
+        for (uint i = 0; i < ntets; ++i)
+        {
+            uint tidx = pSyncTet[i];
+            uint sidx = pSyncTetSpec[i];
+            double d = pSSA->_getTetCount(tidx, sidx) - pSyncTetSet[i];
+            d += pSyncTetCarry[i];
+            if (d == 0.0) continue;
+            double n = pODE->_getTetCount(tidx, sidx) + d;
+            pSyncTetCarry[i] = std::min(n, 0.0);
+            pODE->_setTetCount(tidx, sidx, std::max(n, 0.0));
+        }
+        for (uint i = 0; i < ntris; ++i)
+        {
+            uint tidx = pSyncTri[i];
+            uint sidx = pSyncTriSpec[i];
+            double d = pSSA->_getTriCount(tidx, sidx) - pSyncTriSet[i];
+            d += pSyncTriCarry[i];
+            if (d == 0.0) continue;
+            double n = pODE->_getTriCount(tidx, sidx) + d;
+            pSyncTriCarry[i] = std::min(n, 0.0);
+            pODE->_setTriCount(tidx, sidx, std::max(n, 0.0));
+        }
+
+        pODE->run(t1);
+        t = t1;
+    }
+    statedef()->setTime(endtime);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::advance(double adv)
+{
+    if (adv < 0.0)
+    {
+        std::ostringstream os;
+        os << "Time to advance cannot be negative";
+        throw steps::ArgErr(os.str());
+    }
+
+    run(getTime() + adv);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::getTime(void) const
+{
+    return pSSA->getTime();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::setSpecDeterministic(std::string const & s, bool det)
+{
+    // statedef() throws if the species is unknown.
+    uint sidx = statedef()->getSpecIdx(s);
+    if (pDet[sidx] == det) return;
+
+    _copySpec(sidx, det);
+    pDet[sidx] = det;
+    _applyPartition();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool shybrid::Hybrid::getSpecDeterministic(std::string const & s) const
+{
+    uint sidx = statedef()->getSpecIdx(s);
+    return pDet[sidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::selectDeterministic(double threshold)
+{
+    uint nspecs = statedef()->countSpecs();
+    std::vector<double> count(nspecs, 0.0);
+    std::vector<double> nelems(nspecs, 0.0);
+
+    uint ncomps = statedef()->countComps();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        for (uint l = 0; l < cdef->countSpecs(); ++l)
+        {
+            uint sidx = cdef->specL2G(l);
+            count[sidx] += _getCompCount(c, sidx);
+            nelems[sidx] += pCompTets[c].size();
+        }
+    }
+    uint npatches = statedef()->countPatches();
+    for (uint p = 0; p < npatches; ++p)
+    {
+        ssolver::Patchdef * pdef = statedef()->patchdef(p);
+        for (uint l = 0; l < pdef->countSpecs(); ++l)
+        {
+            uint sidx = pdef->specL2G(l);
+            count[sidx] += _getPatchCount(p, sidx);
+            nelems[sidx] += pPatchTris[p].size();
+        }
+    }
+
+    bool changed = false;
+    for (uint s = 0; s < nspecs; ++s)
+    {
+        bool det = (nelems[s] > 0.0 and count[s] >= threshold * nelems[s]);
+        if (det == pDet[s]) continue;
+        _copySpec(s, det);
+        pDet[s] = det;
+        changed = true;
+    }
+    if (changed) _applyPartition();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::setSyncDT(double dt)
+{
+    if (dt <= 0.0)
+    {
+        std::ostringstream os;
+        os << "Synchronisation window must be positive.\n";
+        throw steps::ArgErr(os.str());
+    }
+    pSyncDT = dt;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::setTolerances(double atol, double rtol)
+{
+    pODE->setTolerances(atol, rtol);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::setMaxNumSteps(uint maxn)
+{
+    pODE->setMaxNumSteps(maxn);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::setStiff(bool stiff)
+{
+    pODE->setStiff(stiff);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_copySpec(uint sidx, bool todet)
+{
+    std::vector<bool> spec(statedef()->countSpecs(), false);
+    spec[sidx] = true;
+    if (todet) pSSA->copyStateTo(*pODE, spec);
+    else pSSA->setStateFrom(*pODE, spec);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_applyPartition(void)
+{
+    uint nspecs = statedef()->countSpecs();
+    pAnyDet = (std::find(pDet.begin(), pDet.end(), true) != pDet.end());
+
+    // Deterministic species read or updated by a process left to the SSA.
+    std::vector<bool> sync(nspecs, false);
+
+    uint ncomps = statedef()->countComps();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        for (uint l = 0; l < cdef->countReacs(); ++l)
+        {
+            ssolver::Reacdef * rdef = cdef->reacdef(l);
+            bool det = true;
+            for (uint s = 0; s < nspecs; ++s)
+            {
+                if (rdef->reqspec(s) and not pDet[s]) det = false;
+            }
+            if (not det)
+            {
+                for (uint s = 0; s < nspecs; ++s)
+                {
+                    if (rdef->reqspec(s) and pDet[s]) sync[s] = true;
+                }
+            }
+            if (pSSA->_getCompReacActive(c, rdef->gidx()) == det)
+            {
+                pSSA->_setCompReacActive(c, rdef->gidx(), not det);
+            }
+        }
+        for (uint l = 0; l < cdef->countDiffs(); ++l)
+        {
+            ssolver::Diffdef * ddef = cdef->diffdef(l);
+            bool det = pDet[ddef->lig()];
+            if (pSSA->_getCompDiffActive(c, ddef->gidx()) == det)
+            {
+                pSSA->_setCompDiffActive(c, ddef->gidx(), not det);
+            }
+        }
+    }
+
+    uint npatches = statedef()->countPatches();
+    for (uint p = 0; p < npatches; ++p)
+    {
+        ssolver::Patchdef * pdef = statedef()->patchdef(p);
+        for (uint l = 0; l < pdef->countSReacs(); ++l)
+        {
+            ssolver::SReacdef * srdef = pdef->sreacdef(l);
+            bool det = true;
+            for (uint s = 0; s < nspecs; ++s)
+            {
+                bool req = srdef->reqspec_S(s) or srdef->reqspec_I(s)
+                    or srdef->reqspec_O(s);
+                if (req and not pDet[s]) det = false;
+            }
+            if (not det)
+            {
+                for (uint s = 0; s < nspecs; ++s)
+                {
+                    bool req = srdef->reqspec_S(s) or srdef->reqspec_I(s)
+                        or srdef->reqspec_O(s);
+                    if (req and pDet[s]) sync[s] = true;
+                }
+            }
+            if (pSSA->_getPatchSReacActive(p, srdef->gidx()) == det)
+            {
+                pSSA->_setPatchSReacActive(p, srdef->gidx(), not det);
+            }
+        }
+        for (uint l = 0; l < pdef->countSurfDiffs(); ++l)
+        {
+            ssolver::SurfDiffdef * sddef = pdef->surfdiffdef(l);
+            bool det = pDet[sddef->lig()];
+            if (pSSA->_getPatchSDiffActive(p, sddef->gidx()) == det)
+            {
+                pSSA->_setPatchSDiffActive(p, sddef->gidx(), not det);
+            }
+        }
+    }
+
+    pODE->_restrictToSpecs(pDet);
+
+    pSyncTet.clear();
+    pSyncTetSpec.clear();
+    pSyncTri.clear();
+    pSyncTriSpec.clear();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        for (uint l = 0; l < cdef->countSpecs(); ++l)
+        {
+            uint sidx = cdef->specL2G(l);
+            if (not sync[sidx]) continue;
+            pSyncTet.insert(pSyncTet.end(), pCompTets[c].begin(), pCompTets[c].end());
+            pSyncTetSpec.resize(pSyncTet.size(), sidx);
+        }
+    }
+    for (uint p = 0; p < npatches; ++p)
+    {
+        ssolver::Patchdef * pdef = statedef()->patchdef(p);
+        for (uint l = 0; l < pdef->countSpecs(); ++l)
+        {
+            uint sidx = pdef->specL2G(l);
+            if (not sync[sidx]) continue;
+            pSyncTri.insert(pSyncTri.end(), pPatchTris[p].begin(), pPatchTris[p].end());
+            pSyncTriSpec.resize(pSyncTri.size(), sidx);
+        }
+    }
+    pSyncTetSet.assign(pSyncTet.size(), 0.0);
+    pSyncTetCarry.assign(pSyncTet.size(), 0.0);
+    pSyncTriSet.assign(pSyncTri.size(), 0.0);
+    pSyncTriCarry.assign(pSyncTri.size(), 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SOLVER STATE ACCESS: COMPARTMENT
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getCompVol(uint cidx) const
+{
+    return pSSA->_getCompVol(cidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getCompCount(uint cidx, uint sidx) const
+{
+    if (pDet[sidx]) return pODE->_getCompCount(cidx, sidx);
+    return pSSA->_getCompCount(cidx, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setCompCount(uint cidx, uint sidx, double n)
+{
+    // Both copies are set, so the state is right whichever side the
+    // species is moved to later.
+    pSSA->_setCompCount(cidx, sidx, n);
+    pODE->_setCompCount(cidx, sidx, n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getCompAmount(uint cidx, uint sidx) const
+{
+    return _getCompCount(cidx, sidx) / smath::AVOGADRO;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setCompAmount(uint cidx, uint sidx, double a)
+{
+    _setCompCount(cidx, sidx, a * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getCompConc(uint cidx, uint sidx) const
+{
+    double vol = _getCompVol(cidx);
+    return _getCompCount(cidx, sidx) / (1.0e3 * vol * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setCompConc(uint cidx, uint sidx, double c)
+{
+    assert(c >= 0.0);
+    double vol = _getCompVol(cidx);
+    _setCompCount(cidx, sidx, c * (1.0e3 * vol * smath::AVOGADRO));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool shybrid::Hybrid::_getCompClamped(uint cidx, uint sidx) const
+{
+    throw steps::NotImplErr();
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setCompClamped(uint cidx, uint sidx, bool b)
+{
+    throw steps::NotImplErr();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getCompReacK(uint cidx, uint ridx) const
+{
+    return pSSA->_getCompReacK(cidx, ridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setCompReacK(uint cidx, uint ridx, double kf)
+{
+    pSSA->_setCompReacK(cidx, ridx, kf);
+    pODE->_setCompReacK(cidx, ridx, kf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool shybrid::Hybrid::_getCompReacActive(uint cidx, uint ridx) const
+{
+    // The active flags of both solvers implement the partition.
+    throw steps::NotImplErr();
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setCompReacActive(uint cidx, uint ridx, bool a)
+{
+    throw steps::NotImplErr();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SOLVER STATE ACCESS: PATCH
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getPatchArea(uint pidx) const
+{
+    return pSSA->_getPatchArea(pidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getPatchCount(uint pidx, uint sidx) const
+{
+    if (pDet[sidx]) return pODE->_getPatchCount(pidx, sidx);
+    return pSSA->_getPatchCount(pidx, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setPatchCount(uint pidx, uint sidx, double n)
+{
+    pSSA->_setPatchCount(pidx, sidx, n);
+    pODE->_setPatchCount(pidx, sidx, n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getPatchAmount(uint pidx, uint sidx) const
+{
+    return _getPatchCount(pidx, sidx) / smath::AVOGADRO;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setPatchAmount(uint pidx, uint sidx, double a)
+{
+    _setPatchCount(pidx, sidx, a * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool shybrid::Hybrid::_getPatchClamped(uint pidx, uint sidx) const
+{
+    throw steps::NotImplErr();
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setPatchClamped(uint pidx, uint sidx, bool buf)
+{
+    throw steps::NotImplErr();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getPatchSReacK(uint pidx, uint ridx) const
+{
+    return pSSA->_getPatchSReacK(pidx, ridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setPatchSReacK(uint pidx, uint ridx, double kf)
+{
+    pSSA->_setPatchSReacK(pidx, ridx, kf);
+    pODE->_setPatchSReacK(pidx, ridx, kf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool shybrid::Hybrid::_getPatchSReacActive(uint pidx, uint ridx) const
+{
+    throw steps::NotImplErr();
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setPatchSReacActive(uint pidx, uint ridx, bool a)
+{
+    throw steps::NotImplErr();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SOLVER STATE ACCESS: TETRAHEDRAL VOLUME ELEMENTS
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getTetVol(uint tidx) const
+{
+    return pSSA->_getTetVol(tidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getTetCount(uint tidx, uint sidx) const
+{
+    if (pDet[sidx]) return pODE->_getTetCount(tidx, sidx);
+    return pSSA->_getTetCount(tidx, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setTetCount(uint tidx, uint sidx, double n)
+{
+    pSSA->_setTetCount(tidx, sidx, n);
+    pODE->_setTetCount(tidx, sidx, n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getTetAmount(uint tidx, uint sidx) const
+{
+    return _getTetCount(tidx, sidx) / smath::AVOGADRO;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setTetAmount(uint tidx, uint sidx, double m)
+{
+    _setTetCount(tidx, sidx, m * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getTetConc(uint tidx, uint sidx) const
+{
+    double vol = _getTetVol(tidx);
+    return _getTetCount(tidx, sidx) / (1.0e3 * vol * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setTetConc(uint tidx, uint sidx, double c)
+{
+    assert(c >= 0.0);
+    double vol = _getTetVol(tidx);
+    _setTetCount(tidx, sidx, c * (1.0e3 * vol * smath::AVOGADRO));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getTetReacK(uint tidx, uint ridx) const
+{
+    return pSSA->_getTetReacK(tidx, ridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setTetReacK(uint tidx, uint ridx, double kf)
+{
+    pSSA->_setTetReacK(tidx, ridx, kf);
+    pODE->_setTetReacK(tidx, ridx, kf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SOLVER STATE ACCESS: TRIANGULAR SURFACE ELEMENTS
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getTriArea(uint tidx) const
+{
+    return pSSA->_getTriArea(tidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getTriCount(uint tidx, uint sidx) const
+{
+    if (pDet[sidx]) return pODE->_getTriCount(tidx, sidx);
+    return pSSA->_getTriCount(tidx, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setTriCount(uint tidx, uint sidx, double n)
+{
+    pSSA->_setTriCount(tidx, sidx, n);
+    pODE->_setTriCount(tidx, sidx, n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getTriAmount(uint tidx, uint sidx) const
+{
+    return _getTriCount(tidx, sidx) / smath::AVOGADRO;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setTriAmount(uint tidx, uint sidx, double m)
+{
+    _setTriCount(tidx, sidx, m * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Hybrid::_getTriSReacK(uint tidx, uint ridx) const
+{
+    return pSSA->_getTriSReacK(tidx, ridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Hybrid::_setTriSReacK(uint tidx, uint ridx, double kf)
+{
+    pSSA->_setTriSReacK(tidx, ridx, kf);
+    pODE->_setTriSReacK(tidx, ridx, kf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
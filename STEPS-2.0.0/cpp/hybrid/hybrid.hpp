@@ -0,0 +1,281 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef STEPS_HYBRID_HYBRID_HPP
+#define STEPS_HYBRID_HYBRID_HPP 1
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../solver/api.hpp"
+#include "../solver/statedef.hpp"
+#include "../geom/tetmesh.hpp"
+#include "../tetexact/tetexact.hpp"
+#include "../tetode/tetode.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(hybrid)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Partitioned SSA-ODE solver on a tetrahedral mesh.
+///
+/// Every species is either stochastic or deterministic. The solver owns
+/// a Tetexact and a TetODE solver on the same model and mesh: the
+/// reactions, surface reactions and diffusion rules whose species are
+/// all deterministic are integrated by TetODE and switched off in
+/// Tetexact, every other process runs in Tetexact and is switched off in
+/// TetODE. The two are advanced in turn over windows of length
+/// setSyncDT(). At the start of each window the deterministic species
+/// that take part in a stochastic process are copied into Tetexact,
+/// rounded stochastically, which updates the propensities of those
+/// kprocs; at its end the changes the SSA made to them are added back to
+/// the ODE state.
+///
+/// All species start stochastic, which is plain Tetexact.
+///
+class Hybrid: public steps::solver::API
+{
+
+public:
+
+    Hybrid(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+           std::string const & scheduler = "cr");
+    ~Hybrid(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER INFORMATION
+    ////////////////////////////////////////////////////////////////////////
+
+    std::string getSolverName(void) const;
+    std::string getSolverDesc(void) const;
+    std::string getSolverAuthors(void) const;
+    std::string getSolverEmail(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER CONTROLS
+    ////////////////////////////////////////////////////////////////////////
+
+    void checkpoint(std::string const & file_name);
+    void restore(std::string const & file_name);
+
+    void reset(void);
+    void run(double endtime);
+    void advance(double adv);
+
+    double getTime(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // PARTITION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Treat species s deterministically or not. Its current state is
+    /// handed from the solver that owned it to the other one.
+    ///
+    void setSpecDeterministic(std::string const & s, bool det);
+
+    bool getSpecDeterministic(std::string const & s) const;
+
+    /// Make every species whose mean count per tetrahedron or triangle,
+    /// over the elements it is defined in, is at least threshold
+    /// deterministic and every other species stochastic.
+    ///
+    void selectDeterministic(double threshold);
+
+    /// Set the synchronisation window (default 1.0e-4s). It should be
+    /// short compared to the time the deterministic species that take
+    /// part in stochastic processes take to change appreciably.
+    ///
+    void setSyncDT(double dt);
+
+    double getSyncDT(void) const
+    { return pSyncDT; }
+
+    ////////////////////////////////////////////////////////////////////////
+    // CVODE CONTROLS (see steps::tetode::TetODE)
+    ////////////////////////////////////////////////////////////////////////
+
+    void setTolerances(double atol, double rtol);
+
+    void setMaxNumSteps(uint maxn);
+
+    void setStiff(bool stiff);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    inline steps::tetmesh::Tetmesh * mesh(void) const
+    { return pMesh; }
+
+    inline steps::tetexact::Tetexact * ssa(void) const
+    { return pSSA; }
+
+    inline steps::tetode::TetODE * ode(void) const
+    { return pODE; }
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER STATE ACCESS:
+    //      COMPARTMENT
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getCompVol(uint cidx) const;
+
+    double _getCompCount(uint cidx, uint sidx) const;
+    void _setCompCount(uint cidx, uint sidx, double n);
+
+    double _getCompAmount(uint cidx, uint sidx) const;
+    void _setCompAmount(uint cidx, uint sidx, double a);
+
+    double _getCompConc(uint cidx, uint sidx) const;
+    void _setCompConc(uint cidx, uint sidx, double c);
+
+    bool _getCompClamped(uint cidx, uint sidx) const;
+    void _setCompClamped(uint cidx, uint sidx, bool b);
+
+    double _getCompReacK(uint cidx, uint ridx) const;
+    void _setCompReacK(uint cidx, uint ridx, double kf);
+
+    bool _getCompReacActive(uint cidx, uint ridx) const;
+    void _setCompReacActive(uint cidx, uint ridx, bool a);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER STATE ACCESS:
+    //      PATCH
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getPatchArea(uint pidx) const;
+
+    double _getPatchCount(uint pidx, uint sidx) const;
+    void _setPatchCount(uint pidx, uint sidx, double n);
+
+    double _getPatchAmount(uint pidx, uint sidx) const;
+    void _setPatchAmount(uint pidx, uint sidx, double a);
+
+    bool _getPatchClamped(uint pidx, uint sidx) const;
+    void _setPatchClamped(uint pidx, uint sidx, bool buf);
+
+    double _getPatchSReacK(uint pidx, uint ridx) const;
+    void _setPatchSReacK(uint pidx, uint ridx, double kf);
+
+    bool _getPatchSReacActive(uint pidx, uint ridx) const;
+    void _setPatchSReacActive(uint pidx, uint ridx, bool a);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER STATE ACCESS:
+    //      TETRAHEDRAL VOLUME ELEMENTS
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getTetVol(uint tidx) const;
+
+    double _getTetCount(uint tidx, uint sidx) const;
+    void _setTetCount(uint tidx, uint sidx, double n);
+
+    double _getTetAmount(uint tidx, uint sidx) const;
+    void _setTetAmount(uint tidx, uint sidx, double m);
+
+    double _getTetConc(uint tidx, uint sidx) const;
+    void _setTetConc(uint tidx, uint sidx, double c);
+
+    double _getTetReacK(uint tidx, uint ridx) const;
+    void _setTetReacK(uint tidx, uint ridx, double kf);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER STATE ACCESS:
+    //      TRIANGULAR SURFACE ELEMENTS
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getTriArea(uint tidx) const;
+
+    double _getTriCount(uint tidx, uint sidx) const;
+    void _setTriCount(uint tidx, uint sidx, double n);
+
+    double _getTriAmount(uint tidx, uint sidx) const;
+    void _setTriAmount(uint tidx, uint sidx, double m);
+
+    double _getTriSReacK(uint tidx, uint ridx) const;
+    void _setTriSReacK(uint tidx, uint ridx, double kf);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// copy the counts of species sidx in every element from Tetexact to
+    /// TetODE if todet, otherwise the other way
+    ///
+    void _copySpec(uint sidx, bool todet);
+
+    /// switch processes on and off in both solvers to match pDet and
+    /// rebuild the synchronisation lists
+    ///
+    void _applyPartition(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    steps::tetmesh::Tetmesh *               pMesh;
+
+    steps::tetexact::Tetexact *             pSSA;
+    steps::tetode::TetODE *                 pODE;
+
+    // Per species: whether it is deterministic.
+    std::vector<bool>                       pDet;
+
+    // Tets of each compartment and triangles of each patch.
+    std::vector<std::vector<uint> >         pCompTets;
+    std::vector<std::vector<uint> >         pPatchTris;
+
+    // The (element, species) pairs copied into the SSA at each sync, the
+    // counts the SSA was given and what the ODE state is short of, which
+    // is at most 0: the SSA can use up a molecule that rounding added, and
+    // the ODE state is kept non-negative. Only deterministic species that
+    // take part in a stochastic process are listed.
+    std::vector<uint>                       pSyncTet;
+    std::vector<uint>                       pSyncTetSpec;
+    std::vector<double>                     pSyncTetSet;
+    std::vector<double>                     pSyncTetCarry;
+    std::vector<uint>                       pSyncTri;
+    std::vector<uint>                       pSyncTriSpec;
+    std::vector<double>                     pSyncTriSet;
+    std::vector<double>                     pSyncTriCarry;
+
+    bool                                    pAnyDet;
+    double                                  pSyncDT;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(hybrid)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_HYBRID_HYBRID_HPP
+
+// END
@@ -0,0 +1,623 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// STL headers.
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "wmhybrid.hpp"
+#include "../error.hpp"
+#include "../math/constants.hpp"
+#include "../solver/compdef.hpp"
+#include "../solver/patchdef.hpp"
+#include "../solver/reacdef.hpp"
+#include "../solver/sreacdef.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::hybrid, shybrid);
+NAMESPACE_ALIAS(steps::solver, ssolver);
+NAMESPACE_ALIAS(steps::math, smath);
+
+////////////////////////////////////////////////////////////////////////////////
+
+shybrid::Wmhybrid::Wmhybrid(steps::model::Model * m, steps::wm::Geom * g,
+                            steps::rng::RNG * r, std::string const & scheduler)
+: API(m, g, r)
+, pSSA(0)
+, pODE(0)
+, pReacLoc()
+, pReacIdx()
+, pReacActive()
+, pReacFast()
+, pNCompReacs(0)
+, pCompReacStart()
+, pPatchReacStart()
+, pPoolLoc()
+, pPoolSpec()
+, pPoolSet()
+, pPoolCarry()
+, pNCompPools(0)
+, pCompPoolStart()
+, pPatchPoolStart()
+, pSyncDT(1.0e-4)
+, pFastThreshold(100.0)
+, pNFast(0)
+{
+    pSSA = new steps::wmdirect::Wmdirect(m, g, r, scheduler);
+    pODE = new steps::wmrk4::Wmrk4(m, g, r);
+    pODE->setAdaptive(true);
+
+    uint ncomps = statedef()->countComps();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        pCompReacStart.push_back(pReacIdx.size());
+        for (uint l = 0; l < cdef->countReacs(); ++l)
+        {
+            pReacLoc.push_back(c);
+            pReacIdx.push_back(cdef->reacdef(l)->gidx());
+        }
+        pCompPoolStart.push_back(pPoolSpec.size());
+        for (uint l = 0; l < cdef->countSpecs(); ++l)
+        {
+            pPoolLoc.push_back(c);
+            pPoolSpec.push_back(cdef->specL2G(l));
+        }
+    }
+    pNCompReacs = pReacIdx.size();
+    pNCompPools = pPoolSpec.size();
+
+    uint npatches = statedef()->countPatches();
+    for (uint p = 0; p < npatches; ++p)
+    {
+        ssolver::Patchdef * pdef = statedef()->patchdef(p);
+        pPatchReacStart.push_back(pReacIdx.size());
+        for (uint l = 0; l < pdef->countSReacs(); ++l)
+        {
+            pReacLoc.push_back(p);
+            pReacIdx.push_back(pdef->sreacdef(l)->gidx());
+        }
+        pPatchPoolStart.push_back(pPoolSpec.size());
+        for (uint l = 0; l < pdef->countSpecs(); ++l)
+        {
+            pPoolLoc.push_back(p);
+            pPoolSpec.push_back(pdef->specL2G(l));
+        }
+    }
+
+    // Everything starts slow, which is plain Wmdirect.
+    pReacActive.assign(pReacIdx.size(), true);
+    pReacFast.assign(pReacIdx.size(), false);
+    for (uint r = 0; r < pReacIdx.size(); ++r)
+    {
+        if (r < pNCompReacs) pODE->_setCompReacActive(pReacLoc[r], pReacIdx[r], false);
+        else pODE->_setPatchSReacActive(pReacLoc[r], pReacIdx[r], false);
+    }
+    pPoolSet.assign(pPoolSpec.size(), 0.0);
+    pPoolCarry.assign(pPoolSpec.size(), 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+shybrid::Wmhybrid::~Wmhybrid(void)
+{
+    delete pSSA;
+    delete pODE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string shybrid::Wmhybrid::getSolverName(void) const
+{
+    return "wmhybrid";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string shybrid::Wmhybrid::getSolverDesc(void) const
+{
+    return "Hybrid SSA and ODE method in well-mixed conditions";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string shybrid::Wmhybrid::getSolverAuthors(void) const
+{
+    return "Stefan Wils and Iain Hepburn";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string shybrid::Wmhybrid::getSolverEmail(void) const
+{
+    return "steps.dev@gmail.com";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::checkpoint(std::string const & file_name)
+{
+    std::ostringstream os;
+    os << "checkpoint() not implemented for steps::solver::Wmhybrid solver";
+    throw steps::NotImplErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::restore(std::string const & file_name)
+{
+    std::ostringstream os;
+    os << "restore() not implemented for steps::solver::Wmhybrid solver";
+    throw steps::NotImplErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::reset(void)
+{
+    pSSA->reset();
+    pODE->reset();
+
+    // Back to all active and all slow.
+    pReacActive.assign(pReacIdx.size(), true);
+    pReacFast.assign(pReacIdx.size(), false);
+    for (uint r = 0; r < pReacIdx.size(); ++r)
+    {
+        if (r < pNCompReacs)
+        {
+            pSSA->_setCompReacActive(pReacLoc[r], pReacIdx[r], true);
+            pODE->_setCompReacActive(pReacLoc[r], pReacIdx[r], false);
+        }
+        else
+        {
+            pSSA->_setPatchSReacActive(pReacLoc[r], pReacIdx[r], true);
+            pODE->_setPatchSReacActive(pReacLoc[r], pReacIdx[r], false);
+        }
+    }
+    pPoolCarry.assign(pPoolSpec.size(), 0.0);
+    pNFast = 0;
+    statedef()->resetTime();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::run(double endtime)
+{
+    double t = getTime();
+    if (endtime < t)
+    {
+        std::ostringstream os;
+        os << "Endtime is before current simulation time";
+        throw steps::ArgErr(os.str());
+    }
+
+    uint npools = pPoolSpec.size();
+    while (t < endtime)
+    {
+        // Never leave a sliver of a window that Wmrk4 cannot step over.
+        double t1 = t + pSyncDT;
+        if (t1 > endtime - 1.0e-6 * pSyncDT) t1 = endtime;
+
+        // Wmdirect gets the current state, rounded stochastically.
+        pSSA->_setAutoUpdate(false);
+        for (uint i = 0; i < npools; ++i)
+        {
+            uint loc = pPoolLoc[i];
+            uint sidx = pPoolSpec[i];
+            if (i < pNCompPools)
+            {
+                double n = pODE->_getCompCount(loc, sidx) + pPoolCarry[i];
+                pSSA->_setCompCount(loc, sidx, std::max(n, 0.0));
+                pPoolSet[i] = pSSA->_getCompCount(loc, sidx);
+            }
+            else
+            {
+                double n = pODE->_getPatchCount(loc, sidx) + pPoolCarry[i];
+                pSSA->_setPatchCount(loc, sidx, std::max(n, 0.0));
+                pPoolSet[i] = pSSA->_getPatchCount(loc, sidx);
+            }
+        }
+        _partition();
+        pSSA->_setAutoUpdate(true);
+
+        pSSA->run(t1);
+
+        // Add what the slow reactions did to the continuous state.
+        for (uint i = 0; i < npools; ++i)
+        {
+            uint loc = pPoolLoc[i];
+            uint sidx = pPoolSpec[i];
+            double d = pPoolCarry[i];
+            if (i < pNCompPools) d += pSSA->_getCompCount(loc, sidx) - pPoolSet[i];
+            else d += pSSA->_getPatchCount(loc, sidx) - pPoolSet[i];
+            if (d == 0.0) continue;
+            if (i < pNCompPools)
+            {
+                double n = pODE->_getCompCount(loc, sidx) + d;
+                pPoolCarry[i] = std::min(n, 0.0);
+                pODE->_setCompCount(loc, sidx, std::max(n, 0.0));
+            }
+            else
+            {
+                double n = pODE->_getPatchCount(loc, sidx) + d;
+                pPoolCarry[i] = std::min(n, 0.0);
+                pODE->_setPatchCount(loc, sidx, std::max(n, 0.0));
+            }
+        }
+
+        pODE->run(t1);
+        t = t1;
+    }
+    statedef()->setTime(endtime);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::advance(double adv)
+{
+    if (adv < 0.0)
+    {
+        std::ostringstream os;
+        os << "Time to advance cannot be negative";
+        throw steps::ArgErr(os.str());
+    }
+
+    run(getTime() + adv);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Wmhybrid::getTime(void) const
+{
+    return pSSA->getTime();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::setSyncDT(double dt)
+{
+    if (dt <= 0.0)
+    {
+        std::ostringstream os;
+        os << "Synchronisation window must be positive.\n";
+        throw steps::ArgErr(os.str());
+    }
+    pSyncDT = dt;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::setFastThreshold(double n)
+{
+    if (n <= 0.0)
+    {
+        std::ostringstream os;
+        os << "Fast reaction threshold must be positive.\n";
+        throw steps::ArgErr(os.str());
+    }
+    pFastThreshold = n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::setAdaptive(bool adapt)
+{
+    pODE->setAdaptive(adapt);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::setStiff(bool stiff)
+{
+    pODE->setStiff(stiff);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::setTolerances(double atol, double rtol)
+{
+    pODE->setTolerances(atol, rtol);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint shybrid::Wmhybrid::_compReac(uint cidx, uint ridx) const
+{
+    uint lridx = statedef()->compdef(cidx)->reacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return pCompReacStart[cidx] + lridx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint shybrid::Wmhybrid::_patchSReac(uint pidx, uint ridx) const
+{
+    uint lridx = statedef()->patchdef(pidx)->sreacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Surface reaction undefined in patch.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return pPatchReacStart[pidx] + lridx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_partition(void)
+{
+    pNFast = 0;
+    uint nreacs = pReacIdx.size();
+    for (uint r = 0; r < nreacs; ++r)
+    {
+        uint loc = pReacLoc[r];
+        uint ridx = pReacIdx[r];
+        bool comp = (r < pNCompReacs);
+
+        double a;
+        if (comp) a = pSSA->_getCompReacPropensity(loc, ridx);
+        else a = pSSA->_getPatchSReacPropensity(loc, ridx);
+        bool fast = pReacActive[r] and (a * pSyncDT >= pFastThreshold);
+        if (fast) ++pNFast;
+        if (fast == pReacFast[r]) continue;
+
+        pReacFast[r] = fast;
+        if (not pReacActive[r]) continue;
+        if (comp)
+        {
+            pSSA->_setCompReacActive(loc, ridx, not fast);
+            pODE->_setCompReacActive(loc, ridx, fast);
+        }
+        else
+        {
+            pSSA->_setPatchSReacActive(loc, ridx, not fast);
+            pODE->_setPatchSReacActive(loc, ridx, fast);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SOLVER STATE ACCESS: COMPARTMENT
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Wmhybrid::_getCompVol(uint cidx) const
+{
+    return pODE->_getCompVol(cidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setCompVol(uint cidx, double vol)
+{
+    pSSA->_setCompVol(cidx, vol);
+    pODE->_setCompVol(cidx, vol);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Wmhybrid::_getCompCount(uint cidx, uint sidx) const
+{
+    return pODE->_getCompCount(cidx, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setCompCount(uint cidx, uint sidx, double n)
+{
+    // Wmdirect gets the count again at the start of the next window; it
+    // is set here too for the argument checking.
+    pSSA->_setCompCount(cidx, sidx, n);
+    pODE->_setCompCount(cidx, sidx, n);
+    uint slidx = statedef()->compdef(cidx)->specG2L(sidx);
+    pPoolCarry[pCompPoolStart[cidx] + slidx] = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Wmhybrid::_getCompAmount(uint cidx, uint sidx) const
+{
+    return _getCompCount(cidx, sidx) / smath::AVOGADRO;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setCompAmount(uint cidx, uint sidx, double a)
+{
+    _setCompCount(cidx, sidx, a * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Wmhybrid::_getCompConc(uint cidx, uint sidx) const
+{
+    double vol = _getCompVol(cidx);
+    return _getCompCount(cidx, sidx) / (1.0e3 * vol * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setCompConc(uint cidx, uint sidx, double c)
+{
+    assert(c >= 0.0);
+    double vol = _getCompVol(cidx);
+    _setCompCount(cidx, sidx, c * (1.0e3 * vol * smath::AVOGADRO));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool shybrid::Wmhybrid::_getCompClamped(uint cidx, uint sidx) const
+{
+    return pODE->_getCompClamped(cidx, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setCompClamped(uint cidx, uint sidx, bool b)
+{
+    pSSA->_setCompClamped(cidx, sidx, b);
+    pODE->_setCompClamped(cidx, sidx, b);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Wmhybrid::_getCompReacK(uint cidx, uint ridx) const
+{
+    return pODE->_getCompReacK(cidx, ridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setCompReacK(uint cidx, uint ridx, double kf)
+{
+    pSSA->_setCompReacK(cidx, ridx, kf);
+    pODE->_setCompReacK(cidx, ridx, kf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool shybrid::Wmhybrid::_getCompReacActive(uint cidx, uint ridx) const
+{
+    return pReacActive[_compReac(cidx, ridx)];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setCompReacActive(uint cidx, uint ridx, bool a)
+{
+    uint r = _compReac(cidx, ridx);
+    pReacActive[r] = a;
+    pSSA->_setCompReacActive(cidx, ridx, a and not pReacFast[r]);
+    pODE->_setCompReacActive(cidx, ridx, a and pReacFast[r]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SOLVER STATE ACCESS: PATCH
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Wmhybrid::_getPatchArea(uint pidx) const
+{
+    return pODE->_getPatchArea(pidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setPatchArea(uint pidx, double area)
+{
+    pSSA->_setPatchArea(pidx, area);
+    pODE->_setPatchArea(pidx, area);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Wmhybrid::_getPatchCount(uint pidx, uint sidx) const
+{
+    return pODE->_getPatchCount(pidx, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setPatchCount(uint pidx, uint sidx, double n)
+{
+    pSSA->_setPatchCount(pidx, sidx, n);
+    pODE->_setPatchCount(pidx, sidx, n);
+    uint slidx = statedef()->patchdef(pidx)->specG2L(sidx);
+    pPoolCarry[pPatchPoolStart[pidx] + slidx] = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Wmhybrid::_getPatchAmount(uint pidx, uint sidx) const
+{
+    return _getPatchCount(pidx, sidx) / smath::AVOGADRO;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setPatchAmount(uint pidx, uint sidx, double a)
+{
+    _setPatchCount(pidx, sidx, a * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool shybrid::Wmhybrid::_getPatchClamped(uint pidx, uint sidx) const
+{
+    return pODE->_getPatchClamped(pidx, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setPatchClamped(uint pidx, uint sidx, bool buf)
+{
+    pSSA->_setPatchClamped(pidx, sidx, buf);
+    pODE->_setPatchClamped(pidx, sidx, buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double shybrid::Wmhybrid::_getPatchSReacK(uint pidx, uint ridx) const
+{
+    return pODE->_getPatchSReacK(pidx, ridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setPatchSReacK(uint pidx, uint ridx, double kf)
+{
+    pSSA->_setPatchSReacK(pidx, ridx, kf);
+    pODE->_setPatchSReacK(pidx, ridx, kf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool shybrid::Wmhybrid::_getPatchSReacActive(uint pidx, uint ridx) const
+{
+    return pReacActive[_patchSReac(pidx, ridx)];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shybrid::Wmhybrid::_setPatchSReacActive(uint pidx, uint ridx, bool a)
+{
+    uint r = _patchSReac(pidx, ridx);
+    pReacActive[r] = a;
+    pSSA->_setPatchSReacActive(pidx, ridx, a and not pReacFast[r]);
+    pODE->_setPatchSReacActive(pidx, ridx, a and pReacFast[r]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,245 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef STEPS_HYBRID_WMHYBRID_HPP
+#define STEPS_HYBRID_WMHYBRID_HPP 1
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../solver/api.hpp"
+#include "../solver/statedef.hpp"
+#include "../wmdirect/wmdirect.hpp"
+#include "../wmrk4/wmrk4.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(hybrid)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Well-mixed hybrid solver in the manner of Haseltine and Rawlings
+/// (J Chem Phys 117:6959, 2002): fast reactions are integrated as ODEs,
+/// slow reactions are fired exactly.
+///
+/// The solver owns a Wmdirect and a Wmrk4 solver on the same model and
+/// geometry and advances them in turn over windows of length
+/// setSyncDT(). At the start of each window every reaction and surface
+/// reaction is classed again: it is fast if it is expected to fire at
+/// least setFastThreshold() times in the window, at the current state.
+/// Fast reactions are active only in Wmrk4, slow ones only in Wmdirect.
+/// The state is the continuous Wmrk4 state; it is copied into Wmdirect,
+/// rounded stochastically, at the start of each window and the changes
+/// the slow reactions make are added back at its end.
+///
+/// Wmrk4 uses the adaptive Dormand-Prince method by default.
+///
+class Wmhybrid: public steps::solver::API
+{
+
+public:
+
+    Wmhybrid(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+             std::string const & scheduler = "direct");
+    ~Wmhybrid(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER INFORMATION
+    ////////////////////////////////////////////////////////////////////////
+
+    std::string getSolverName(void) const;
+    std::string getSolverDesc(void) const;
+    std::string getSolverAuthors(void) const;
+    std::string getSolverEmail(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER CONTROLS
+    ////////////////////////////////////////////////////////////////////////
+
+    void checkpoint(std::string const & file_name);
+    void restore(std::string const & file_name);
+
+    void reset(void);
+    void run(double endtime);
+    void advance(double adv);
+
+    double getTime(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // PARTITION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Set the synchronisation window (default 1.0e-4s), which is also
+    /// how often the reactions are classed again.
+    ///
+    void setSyncDT(double dt);
+
+    double getSyncDT(void) const
+    { return pSyncDT; }
+
+    /// Set the number of expected firings per window from which a
+    /// reaction is fast (default 100).
+    ///
+    void setFastThreshold(double n);
+
+    double getFastThreshold(void) const
+    { return pFastThreshold; }
+
+    /// Return the number of reactions and surface reactions that were
+    /// fast in the last window.
+    ///
+    uint getNFast(void) const
+    { return pNFast; }
+
+    ////////////////////////////////////////////////////////////////////////
+    // ODE CONTROLS (see steps::wmrk4::Wmrk4)
+    ////////////////////////////////////////////////////////////////////////
+
+    void setAdaptive(bool adapt);
+
+    void setStiff(bool stiff);
+
+    void setTolerances(double atol, double rtol);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    inline steps::wmdirect::Wmdirect * ssa(void) const
+    { return pSSA; }
+
+    inline steps::wmrk4::Wmrk4 * ode(void) const
+    { return pODE; }
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER STATE ACCESS:
+    //      COMPARTMENT
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getCompVol(uint cidx) const;
+    void _setCompVol(uint cidx, double vol);
+
+    double _getCompCount(uint cidx, uint sidx) const;
+    void _setCompCount(uint cidx, uint sidx, double n);
+
+    double _getCompAmount(uint cidx, uint sidx) const;
+    void _setCompAmount(uint cidx, uint sidx, double a);
+
+    double _getCompConc(uint cidx, uint sidx) const;
+    void _setCompConc(uint cidx, uint sidx, double c);
+
+    bool _getCompClamped(uint cidx, uint sidx) const;
+    void _setCompClamped(uint cidx, uint sidx, bool b);
+
+    double _getCompReacK(uint cidx, uint ridx) const;
+    void _setCompReacK(uint cidx, uint ridx, double kf);
+
+    bool _getCompReacActive(uint cidx, uint ridx) const;
+    void _setCompReacActive(uint cidx, uint ridx, bool a);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER STATE ACCESS:
+    //      PATCH
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getPatchArea(uint pidx) const;
+    void _setPatchArea(uint pidx, double area);
+
+    double _getPatchCount(uint pidx, uint sidx) const;
+    void _setPatchCount(uint pidx, uint sidx, double n);
+
+    double _getPatchAmount(uint pidx, uint sidx) const;
+    void _setPatchAmount(uint pidx, uint sidx, double a);
+
+    bool _getPatchClamped(uint pidx, uint sidx) const;
+    void _setPatchClamped(uint pidx, uint sidx, bool buf);
+
+    double _getPatchSReacK(uint pidx, uint ridx) const;
+    void _setPatchSReacK(uint pidx, uint ridx, double kf);
+
+    bool _getPatchSReacActive(uint pidx, uint ridx) const;
+    void _setPatchSReacActive(uint pidx, uint ridx, bool a);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// index of the reaction or surface reaction in pReacs
+    ///
+    uint _compReac(uint cidx, uint ridx) const;
+    uint _patchSReac(uint pidx, uint ridx) const;
+
+    /// class the reactions at the current state and switch them on and
+    /// off in both solvers accordingly
+    ///
+    void _partition(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    steps::wmdirect::Wmdirect *             pSSA;
+    steps::wmrk4::Wmrk4 *                   pODE;
+
+    // All reactions then all surface reactions, per compartment and
+    // patch in index order: the compartment or patch, the global index,
+    // whether the user has it active and whether it is fast.
+    std::vector<uint>                       pReacLoc;
+    std::vector<uint>                       pReacIdx;
+    std::vector<bool>                       pReacActive;
+    std::vector<bool>                       pReacFast;
+    uint                                    pNCompReacs;
+    std::vector<uint>                       pCompReacStart;
+    std::vector<uint>                       pPatchReacStart;
+
+    // All pools, per compartment then per patch: the compartment or
+    // patch and the species; the count Wmdirect was given at the start
+    // of the window, and what the Wmrk4 state is short of (at most 0,
+    // as it is kept non-negative).
+    std::vector<uint>                       pPoolLoc;
+    std::vector<uint>                       pPoolSpec;
+    std::vector<double>                     pPoolSet;
+    std::vector<double>                     pPoolCarry;
+    uint                                    pNCompPools;
+    std::vector<uint>                       pCompPoolStart;
+    std::vector<uint>                       pPatchPoolStart;
+
+    double                                  pSyncDT;
+    double                                  pFastThreshold;
+    uint                                    pNFast;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(hybrid)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_HYBRID_WMHYBRID_HPP
+
+// END
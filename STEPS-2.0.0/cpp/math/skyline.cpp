@@ -0,0 +1,282 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "skyline.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::math, smath);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Orders vertices by their degree.
+struct DegreeLess
+{
+    std::vector<uint> const & degree;
+    DegreeLess(std::vector<uint> const & d) : degree(d) { }
+    bool operator()(uint a, uint b) const
+    { return (degree[a] < degree[b]) || (degree[a] == degree[b] && a < b); }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+smath::SkylineLU::SkylineLU(void)
+: pN(0)
+, pPerm()
+, pIPerm()
+, pFirst()
+, pLStart()
+, pUStart()
+, pL()
+, pU()
+, pWork()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+smath::SkylineLU::~SkylineLU(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void smath::SkylineLU::setPattern(uint n, std::vector<uint> const & rowstart,
+                                  std::vector<uint> const & cols)
+{
+    assert(rowstart.size() == n + 1);
+    pN = n;
+
+    // The symmetrised graph, without the diagonal, in CSR form.
+    std::vector<uint> degree(n, 0);
+    for (uint i = 0; i < n; ++i)
+    {
+        for (uint k = rowstart[i]; k < rowstart[i + 1]; ++k)
+        {
+            uint j = cols[k];
+            if (j == i) continue;
+            ++degree[i];
+            ++degree[j];
+        }
+    }
+    std::vector<uint> adjstart(n + 1, 0);
+    for (uint i = 0; i < n; ++i) adjstart[i + 1] = adjstart[i] + degree[i];
+    std::vector<uint> adj(adjstart[n]);
+    std::vector<uint> fill(adjstart.begin(), adjstart.end() - 1);
+    for (uint i = 0; i < n; ++i)
+    {
+        for (uint k = rowstart[i]; k < rowstart[i + 1]; ++k)
+        {
+            uint j = cols[k];
+            if (j == i) continue;
+            adj[fill[i]++] = j;
+            adj[fill[j]++] = i;
+        }
+    }
+    DegreeLess less(degree);
+    for (uint i = 0; i < n; ++i)
+    {
+        std::vector<uint>::iterator b = adj.begin() + adjstart[i];
+        std::vector<uint>::iterator e = adj.begin() + adjstart[i + 1];
+        std::sort(b, e, less);
+    }
+
+    // Cuthill-McKee from a vertex of least degree of each component,
+    // neighbours in order of degree, then reversed.
+    std::vector<uint> bydegree(n);
+    for (uint i = 0; i < n; ++i) bydegree[i] = i;
+    std::sort(bydegree.begin(), bydegree.end(), less);
+    std::vector<uint> order;
+    order.reserve(n);
+    std::vector<char> seen(n, 0);
+    for (uint s = 0; s < n; ++s)
+    {
+        uint root = bydegree[s];
+        if (seen[root] != 0) continue;
+        seen[root] = 1;
+        uint head = order.size();
+        order.push_back(root);
+        while (head < order.size())
+        {
+            uint v = order[head++];
+            for (uint k = adjstart[v]; k < adjstart[v + 1]; ++k)
+            {
+                uint w = adj[k];
+                if (seen[w] != 0) continue;
+                seen[w] = 1;
+                order.push_back(w);
+            }
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    pIPerm = order;
+    pPerm.assign(n, 0);
+    for (uint i = 0; i < n; ++i) pPerm[pIPerm[i]] = i;
+
+    // The envelope: the first new index connected to each new index.
+    pFirst.resize(n);
+    for (uint i = 0; i < n; ++i) pFirst[i] = i;
+    for (uint i = 0; i < n; ++i)
+    {
+        uint pi = pPerm[i];
+        for (uint k = rowstart[i]; k < rowstart[i + 1]; ++k)
+        {
+            uint pj = pPerm[cols[k]];
+            if (pj < pi) pFirst[pi] = std::min(pFirst[pi], pj);
+            else pFirst[pj] = std::min(pFirst[pj], pi);
+        }
+    }
+
+    pLStart.resize(n + 1);
+    pUStart.resize(n + 1);
+    pLStart[0] = 0;
+    pUStart[0] = 0;
+    for (uint i = 0; i < n; ++i)
+    {
+        pLStart[i + 1] = pLStart[i] + (i - pFirst[i]);
+        pUStart[i + 1] = pUStart[i] + (i - pFirst[i] + 1);
+    }
+    pL.assign(pLStart[n], 0.0);
+    pU.assign(pUStart[n], 0.0);
+    pWork.resize(n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t smath::SkylineLU::getMemoryUsage(void) const
+{
+    return sizeof(SkylineLU)
+         + sizeof(uint) * (pPerm.capacity() + pIPerm.capacity() + pFirst.capacity())
+         + sizeof(std::size_t) * (pLStart.capacity() + pUStart.capacity())
+         + sizeof(double) * (pL.capacity() + pU.capacity() + pWork.capacity());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void smath::SkylineLU::clear(void)
+{
+    std::fill(pL.begin(), pL.end(), 0.0);
+    std::fill(pU.begin(), pU.end(), 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void smath::SkylineLU::add(uint i, uint j, double v)
+{
+    uint pi = pPerm[i];
+    uint pj = pPerm[j];
+    if (pj < pi)
+    {
+        assert(pj >= pFirst[pi]);
+        pL[pLStart[pi] + (pj - pFirst[pi])] += v;
+    }
+    else
+    {
+        assert(pi >= pFirst[pj]);
+        pU[pUStart[pj] + (pi - pFirst[pj])] += v;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool smath::SkylineLU::factor(void)
+{
+    // Doolittle, row i of L and then column i of U. Entry k of row i of
+    // L is pL[lo[i] + k] and entry k of column j of U is pU[uo[j] + k],
+    // with the offsets below.
+    double * l = pL.empty() ? 0 : &pL[0];
+    double * u = &pU[0];
+    for (uint i = 0; i < pN; ++i)
+    {
+        uint fi = pFirst[i];
+        std::ptrdiff_t li = static_cast<std::ptrdiff_t>(pLStart[i]) - fi;
+        std::ptrdiff_t ui = static_cast<std::ptrdiff_t>(pUStart[i]) - fi;
+
+        for (uint j = fi; j < i; ++j)
+        {
+            uint fj = pFirst[j];
+            std::ptrdiff_t uj = static_cast<std::ptrdiff_t>(pUStart[j]) - fj;
+            double s = l[li + j];
+            for (uint k = std::max(fi, fj); k < j; ++k) s -= l[li + k] * u[uj + k];
+            l[li + j] = s / u[uj + j];
+        }
+
+        for (uint j = fi; j <= i; ++j)
+        {
+            uint fj = pFirst[j];
+            std::ptrdiff_t lj = static_cast<std::ptrdiff_t>(pLStart[j]) - fj;
+            double s = u[ui + j];
+            for (uint k = std::max(fi, fj); k < j; ++k) s -= l[lj + k] * u[ui + k];
+            u[ui + j] = s;
+        }
+
+        if (u[ui + i] == 0.0) return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void smath::SkylineLU::solve(double * b) const
+{
+    double * y = &pWork[0];
+    double const * l = pL.empty() ? 0 : &pL[0];
+    double const * u = &pU[0];
+    for (uint i = 0; i < pN; ++i) y[i] = b[pIPerm[i]];
+
+    // L y = b, with a unit diagonal.
+    for (uint i = 0; i < pN; ++i)
+    {
+        uint fi = pFirst[i];
+        std::ptrdiff_t li = static_cast<std::ptrdiff_t>(pLStart[i]) - fi;
+        double s = y[i];
+        for (uint k = fi; k < i; ++k) s -= l[li + k] * y[k];
+        y[i] = s;
+    }
+
+    // U x = y, by columns.
+    for (uint i = pN; i > 0; --i)
+    {
+        uint j = i - 1;
+        uint fj = pFirst[j];
+        std::ptrdiff_t uj = static_cast<std::ptrdiff_t>(pUStart[j]) - fj;
+        double x = y[j] / u[uj + j];
+        y[j] = x;
+        for (uint k = fj; k < j; ++k) y[k] -= u[uj + k] * x;
+    }
+
+    for (uint i = 0; i < pN; ++i) b[pIPerm[i]] = y[i];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_MATH_SKYLINE_HPP
+#define STEPS_MATH_SKYLINE_HPP 1
+
+
+// STL headers.
+#include <cstddef>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+
+START_NAMESPACE(steps)
+START_NAMESPACE(math)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Sparse LU decomposition, without pivoting, of a matrix in variable band
+/// (skyline) storage. The unknowns are renumbered by reverse Cuthill-McKee
+/// over the symmetrised pattern, which keeps the envelope, and so the
+/// fill-in, narrow for matrices from meshes. Row i of L and column i of U
+/// hold the entries from the first column (row) of the envelope of i.
+///
+/// A zero pivot fails the decomposition rather than being pivoted away,
+/// which suits matrices near the identity such as the Newton matrices
+/// I - gamma J of an implicit integrator.
+///
+class SkylineLU
+{
+
+public:
+
+    SkylineLU(void);
+    ~SkylineLU(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Set up for an n by n matrix whose row i may have nonzeros in the
+    /// columns cols[rowstart[i]] to cols[rowstart[i + 1] - 1]. The
+    /// diagonal is always included.
+    ///
+    void setPattern(uint n, std::vector<uint> const & rowstart,
+                    std::vector<uint> const & cols);
+
+    inline uint size(void) const
+    { return pN; }
+
+    /// The number of stored entries of L and U.
+    ///
+    inline std::size_t getNEntries(void) const
+    { return pL.size() + pU.size(); }
+
+    std::size_t getMemoryUsage(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Set all entries to 0.
+    ///
+    void clear(void);
+
+    /// Add v to entry (i, j), which must be within the pattern.
+    ///
+    void add(uint i, uint j, double v);
+
+    /// Decompose in place. Returns false on a zero pivot, after which
+    /// the matrix has to be filled again.
+    ///
+    bool factor(void);
+
+    /// Overwrite b with the solution of A x = b.
+    ///
+    void solve(double * b) const;
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    uint                                pN;
+
+    // The new number of each unknown and the unknown of each new number.
+    std::vector<uint>                   pPerm;
+    std::vector<uint>                   pIPerm;
+
+    // Per new number i, the first index of its envelope, and where row i
+    // of L (columns pFirst[i] to i - 1) and column i of U (rows pFirst[i]
+    // to i) start in pL and pU.
+    std::vector<uint>                   pFirst;
+    std::vector<std::size_t>            pLStart;
+    std::vector<std::size_t>            pUStart;
+    std::vector<double>                 pL;
+    std::vector<double>                 pU;
+
+    // Work space of solve().
+    mutable std::vector<double>         pWork;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(math)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_MATH_SKYLINE_HPP
+
+// END
@@ -0,0 +1,200 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPSis free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPSis distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_MATH_SMALLMATRIX_HPP
+#define STEPS_MATH_SMALLMATRIX_HPP 1
+
+
+// Standard library & STL headers.
+#include <cmath>
+
+// STEPS headers.
+#include "../common.h"
+
+START_NAMESPACE(steps)
+START_NAMESPACE(math)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Determinant and inverse of N x N matrices, with N known at compile
+/// time, stored [row][column] on the stack. They allocate nothing and
+/// their fixed trip counts let the compiler unroll and vectorize them;
+/// 2 x 2 and 3 x 3 matrices use closed cofactor forms, larger ones
+/// Gaussian elimination with partial pivoting.
+///
+template<uint N>
+inline double det(double const (&m)[N][N])
+{
+    double a[N][N];
+    for (uint i = 0; i < N; ++i)
+    {
+        for (uint j = 0; j < N; ++j) a[i][j] = m[i][j];
+    }
+    double d = 1.0;
+    for (uint k = 0; k < N; ++k)
+    {
+        uint p = k;
+        for (uint i = k + 1; i < N; ++i)
+        {
+            if (fabs(a[i][k]) > fabs(a[p][k])) p = i;
+        }
+        if (a[p][k] == 0.0) return 0.0;
+        if (p != k)
+        {
+            for (uint j = k; j < N; ++j)
+            {
+                double w = a[k][j];
+                a[k][j] = a[p][j];
+                a[p][j] = w;
+            }
+            d = -d;
+        }
+        d *= a[k][k];
+        for (uint i = k + 1; i < N; ++i)
+        {
+            double f = a[i][k] / a[k][k];
+            for (uint j = k + 1; j < N; ++j) a[i][j] -= f * a[k][j];
+        }
+    }
+    return d;
+}
+
+template<>
+inline double det<2>(double const (&m)[2][2])
+{
+    return (m[0][0] * m[1][1]) - (m[0][1] * m[1][0]);
+}
+
+template<>
+inline double det<3>(double const (&m)[3][3])
+{
+    return (m[0][0] * ((m[1][1] * m[2][2]) - (m[1][2] * m[2][1])))
+         + (m[0][1] * ((m[1][2] * m[2][0]) - (m[1][0] * m[2][2])))
+         + (m[0][2] * ((m[1][0] * m[2][1]) - (m[1][1] * m[2][0])));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Write the inverse of m to inv and return the determinant of m. If
+/// that is 0, m is singular and inv is left undefined.
+///
+template<uint N>
+inline double inverse(double const (&m)[N][N], double (&inv)[N][N])
+{
+    // Gauss-Jordan on [a | inv].
+    double a[N][N];
+    for (uint i = 0; i < N; ++i)
+    {
+        for (uint j = 0; j < N; ++j)
+        {
+            a[i][j] = m[i][j];
+            inv[i][j] = (i == j ? 1.0 : 0.0);
+        }
+    }
+    double d = 1.0;
+    for (uint k = 0; k < N; ++k)
+    {
+        uint p = k;
+        for (uint i = k + 1; i < N; ++i)
+        {
+            if (fabs(a[i][k]) > fabs(a[p][k])) p = i;
+        }
+        if (a[p][k] == 0.0) return 0.0;
+        if (p != k)
+        {
+            for (uint j = 0; j < N; ++j)
+            {
+                double w = a[k][j];
+                a[k][j] = a[p][j];
+                a[p][j] = w;
+                w = inv[k][j];
+                inv[k][j] = inv[p][j];
+                inv[p][j] = w;
+            }
+            d = -d;
+        }
+        double piv = a[k][k];
+        d *= piv;
+        for (uint j = 0; j < N; ++j)
+        {
+            a[k][j] /= piv;
+            inv[k][j] /= piv;
+        }
+        for (uint i = 0; i < N; ++i)
+        {
+            if (i == k) continue;
+            double f = a[i][k];
+            for (uint j = 0; j < N; ++j)
+            {
+                a[i][j] -= f * a[k][j];
+                inv[i][j] -= f * inv[k][j];
+            }
+        }
+    }
+    return d;
+}
+
+template<>
+inline double inverse<2>(double const (&m)[2][2], double (&inv)[2][2])
+{
+    double d = det<2>(m);
+    if (d == 0.0) return 0.0;
+    inv[0][0] = m[1][1] / d;
+    inv[0][1] = -m[0][1] / d;
+    inv[1][0] = -m[1][0] / d;
+    inv[1][1] = m[0][0] / d;
+    return d;
+}
+
+template<>
+inline double inverse<3>(double const (&m)[3][3], double (&inv)[3][3])
+{
+    // Column j of the adjugate is the cross product of rows j+1 and j+2.
+    double c[3][3];
+    for (uint j = 0; j < 3; ++j)
+    {
+        double const * r1 = m[(j + 1) % 3];
+        double const * r2 = m[(j + 2) % 3];
+        c[j][0] = (r1[1] * r2[2]) - (r1[2] * r2[1]);
+        c[j][1] = (r1[2] * r2[0]) - (r1[0] * r2[2]);
+        c[j][2] = (r1[0] * r2[1]) - (r1[1] * r2[0]);
+    }
+    double d = (m[0][0] * c[0][0]) + (m[0][1] * c[0][1]) + (m[0][2] * c[0][2]);
+    if (d == 0.0) return 0.0;
+    for (uint i = 0; i < 3; ++i)
+    {
+        for (uint j = 0; j < 3; ++j) inv[i][j] = c[j][i] / d;
+    }
+    return d;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(math)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_MATH_SMALLMATRIX_HPP
+
+// END
@@ -32,6 +32,8 @@
 #include "../common.h"
 #include "linsolve.hpp"
 #include "tetrahedron.hpp"
+#include "tools.hpp"
+#include "../simd.hpp"
 
 // STL headers.
 #include <cassert>
@@ -39,20 +41,34 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// The determinant of the tetrahedron (a, b, c, d), by coordinates, so
+// that the batch kernels can evaluate it on gathered corners.
+static STEPS_SIMD_INLINE double det4X3s
+(
+    double ax, double ay, double az, double bx, double by, double bz,
+    double cx, double cy, double cz, double dx, double dy, double dz
+)
+{
+    return bz*cy*dx-az*cy*dx-1.0*by*cz*dx+ay*
+           cz*dx+az*by*dx-ay*bz*dx-1.0*bz*cx*
+           dy+az*cx*dy+1.0*bx*cz*dy-ax*cz*
+           dy-az*bx*dy+ax*bz*dy+1.0*by*cx*
+           dz-ay*cx*dz-1.0*bx*cy*dz+ax*cy*
+           dz+ay*bx*dz-ax*by*dz-az*by*cx*
+           1.0+ay*bz*cx*1.0+az*bx*cy*1.0-ax*bz*
+           cy*1.0-ay*bx*cz*1.0+ax*by*cz;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 static inline double det4X3
 (
     double * v0, double * v1,
     double * v2, double * v3
 )
 {
-    return v1[2]*v2[1]*v3[0]-v0[2]*v2[1]*v3[0]-1.0*v1[1]*v2[2]*v3[0]+v0[1]*
-           v2[2]*v3[0]+v0[2]*v1[1]*v3[0]-v0[1]*v1[2]*v3[0]-1.0*v1[2]*v2[0]*
-           v3[1]+v0[2]*v2[0]*v3[1]+1.0*v1[0]*v2[2]*v3[1]-v0[0]*v2[2]*
-           v3[1]-v0[2]*v1[0]*v3[1]+v0[0]*v1[2]*v3[1]+1.0*v1[1]*v2[0]*
-           v3[2]-v0[1]*v2[0]*v3[2]-1.0*v1[0]*v2[1]*v3[2]+v0[0]*v2[1]*
-           v3[2]+v0[1]*v1[0]*v3[2]-v0[0]*v1[1]*v3[2]-v0[2]*v1[1]*v2[0]*
-           1.0+v0[1]*v1[2]*v2[0]*1.0+v0[2]*v1[0]*v2[1]*1.0-v0[0]*v1[2]*
-           v2[1]*1.0-v0[1]*v1[0]*v2[2]*1.0+v0[0]*v1[1]*v2[2];
+    return det4X3s(v0[0], v0[1], v0[2], v1[0], v1[1], v1[2],
+                   v2[0], v2[1], v2[2], v3[0], v3[1], v3[2]);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -82,6 +98,181 @@ void steps::math::tet_barycenter
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static STEPS_SIMD_INLINE void tetVolsKernel
+(
+    double const * verts, uint const * tets, uint ntets,
+    double * vols
+)
+{
+    double c[12][MATH_BATCH_BLOCK];
+    for (uint b = 0; b < ntets; b += MATH_BATCH_BLOCK)
+    {
+        uint n = steps::math::min(ntets - b, static_cast<uint>(MATH_BATCH_BLOCK));
+        steps::math::gatherCorners(verts, tets + (b * 4), 4, n, c);
+        for (uint k = 0; k < n; ++k)
+        {
+            double d = det4X3s(c[0][k], c[1][k], c[2][k], c[3][k], c[4][k], c[5][k],
+                               c[6][k], c[7][k], c[8][k], c[9][k], c[10][k], c[11][k]);
+            vols[b + k] = fabs(d / 6.0);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+STEPS_SIMD_CLONES(tetVolsKernel, (double const * verts, uint const * tets,
+                                 uint ntets, double * vols),
+                  (verts, tets, ntets, vols))
+
+void steps::math::tet_vols
+(
+    double const * verts, uint const * tets, uint ntets,
+    double * vols
+)
+{
+    STEPS_SIMD_PICK(tetVolsKernel)(verts, tets, ntets, vols);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static STEPS_SIMD_INLINE void tetBarycentersKernel
+(
+    double const * verts, uint const * tets, uint ntets,
+    double * po
+)
+{
+    double c[12][MATH_BATCH_BLOCK];
+    for (uint b = 0; b < ntets; b += MATH_BATCH_BLOCK)
+    {
+        uint n = steps::math::min(ntets - b, static_cast<uint>(MATH_BATCH_BLOCK));
+        steps::math::gatherCorners(verts, tets + (b * 4), 4, n, c);
+        double * out = po + (b * 3);
+        for (uint k = 0; k < n; ++k)
+        {
+            out[k * 3] = (c[0][k] + c[3][k] + c[6][k] + c[9][k]) / 4.0;
+            out[(k * 3) + 1] = (c[1][k] + c[4][k] + c[7][k] + c[10][k]) / 4.0;
+            out[(k * 3) + 2] = (c[2][k] + c[5][k] + c[8][k] + c[11][k]) / 4.0;
+        }
+    }
+}
+
+STEPS_SIMD_CLONES(tetBarycentersKernel, (double const * verts, uint const * tets,
+                                        uint ntets, double * po),
+                  (verts, tets, ntets, po))
+
+void steps::math::tet_barycenters
+(
+    double const * verts, uint const * tets, uint ntets,
+    double * po
+)
+{
+    STEPS_SIMD_PICK(tetBarycentersKernel)(verts, tets, ntets, po);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static STEPS_SIMD_INLINE void tetStatsKernel
+(
+    double const * verts, uint const * tets, uint ntets,
+    double * stats
+)
+{
+    double c[12][MATH_BATCH_BLOCK];
+    // Cosines of the smallest and largest dihedral angles; the acos is
+    // left to a scalar loop so the main one stays vectorizable.
+    double cosmax[MATH_BATCH_BLOCK];
+    double cosmin[MATH_BATCH_BLOCK];
+    for (uint b = 0; b < ntets; b += MATH_BATCH_BLOCK)
+    {
+        uint n = steps::math::min(ntets - b, static_cast<uint>(MATH_BATCH_BLOCK));
+        steps::math::gatherCorners(verts, tets + (b * 4), 4, n, c);
+        double * out = stats + (b * TET_STATS_N);
+        for (uint k = 0; k < n; ++k)
+        {
+            // Edges from corner 0 and the other three.
+            double ax = c[3][k] - c[0][k], ay = c[4][k] - c[1][k], az = c[5][k] - c[2][k];
+            double bx = c[6][k] - c[0][k], by = c[7][k] - c[1][k], bz = c[8][k] - c[2][k];
+            double cx = c[9][k] - c[0][k], cy = c[10][k] - c[1][k], cz = c[11][k] - c[2][k];
+            double dx = bx - ax, dy = by - ay, dz = bz - az;
+            double ex = cx - ax, ey = cy - ay, ez = cz - az;
+            double fx = cx - bx, fy = cy - by, fz = cz - bz;
+            double la = (ax * ax) + (ay * ay) + (az * az);
+            double lb = (bx * bx) + (by * by) + (bz * bz);
+            double lc = (cx * cx) + (cy * cy) + (cz * cz);
+            double ld = (dx * dx) + (dy * dy) + (dz * dz);
+            double le = (ex * ex) + (ey * ey) + (ez * ez);
+            double lf = (fx * fx) + (fy * fy) + (fz * fz);
+            double emin = steps::math::min(steps::math::min(la, lb), steps::math::min(lc, ld));
+            emin = steps::math::min(emin, steps::math::min(le, lf));
+            double emax = steps::math::max(steps::math::max(la, lb), steps::math::max(lc, ld));
+            emax = steps::math::max(emax, steps::math::max(le, lf));
+
+            // Area vectors b x c, c x a and a x b; the outward ones of the
+            // faces opposite corners 1, 2 and 3 are their negatives when
+            // the corners are positively oriented.
+            double n1x = (by * cz) - (bz * cy), n1y = (bz * cx) - (bx * cz), n1z = (bx * cy) - (by * cx);
+            double n2x = (cy * az) - (cz * ay), n2y = (cz * ax) - (cx * az), n2z = (cx * ay) - (cy * ax);
+            double n3x = (ay * bz) - (az * by), n3y = (az * bx) - (ax * bz), n3z = (ax * by) - (ay * bx);
+            double det = (ax * n1x) + (ay * n1y) + (az * n1z);
+
+            // Circumcentre relative to corner 0.
+            double ox = ((la * n1x) + (lb * n2x) + (lc * n3x)) / (2.0 * det);
+            double oy = ((la * n1y) + (lb * n2y) + (lc * n3y)) / (2.0 * det);
+            double oz = ((la * n1z) + (lb * n2z) + (lc * n3z)) / (2.0 * det);
+            double rad = sqrt((ox * ox) + (oy * oy) + (oz * oz));
+
+            // The four outward area vectors sum to zero. A dihedral angle
+            // is pi minus the angle between the normals of its faces,
+            // which does not depend on the orientation.
+            double n0x = -(n1x + n2x + n3x), n0y = -(n1y + n2y + n3y), n0z = -(n1z + n2z + n3z);
+            double m0 = sqrt((n0x * n0x) + (n0y * n0y) + (n0z * n0z));
+            double m1 = sqrt((n1x * n1x) + (n1y * n1y) + (n1z * n1z));
+            double m2 = sqrt((n2x * n2x) + (n2y * n2y) + (n2z * n2z));
+            double m3 = sqrt((n3x * n3x) + (n3y * n3y) + (n3z * n3z));
+            double c01 = -((n0x * n1x) + (n0y * n1y) + (n0z * n1z)) / (m0 * m1);
+            double c02 = -((n0x * n2x) + (n0y * n2y) + (n0z * n2z)) / (m0 * m2);
+            double c03 = -((n0x * n3x) + (n0y * n3y) + (n0z * n3z)) / (m0 * m3);
+            double c12 = -((n1x * n2x) + (n1y * n2y) + (n1z * n2z)) / (m1 * m2);
+            double c13 = -((n1x * n3x) + (n1y * n3y) + (n1z * n3z)) / (m1 * m3);
+            double c23 = -((n2x * n3x) + (n2y * n3y) + (n2z * n3z)) / (m2 * m3);
+            double cmax = steps::math::max(steps::math::max(c01, c02), steps::math::max(c03, c12));
+            cosmax[k] = steps::math::max(cmax, steps::math::max(c13, c23));
+            double cmin = steps::math::min(steps::math::min(c01, c02), steps::math::min(c03, c12));
+            cosmin[k] = steps::math::min(cmin, steps::math::min(c13, c23));
+
+            double d = det4X3s(c[0][k], c[1][k], c[2][k], c[3][k], c[4][k], c[5][k],
+                               c[6][k], c[7][k], c[8][k], c[9][k], c[10][k], c[11][k]);
+            emin = sqrt(emin);
+            out[k * TET_STATS_N] = rad / emin;
+            out[(k * TET_STATS_N) + 1] = fabs(d / 6.0);
+            out[(k * TET_STATS_N) + 2] = emin;
+            out[(k * TET_STATS_N) + 3] = sqrt(emax);
+        }
+        for (uint k = 0; k < n; ++k)
+        {
+            double cmax = steps::math::min(steps::math::max(cosmax[k], -1.0), 1.0);
+            double cmin = steps::math::min(steps::math::max(cosmin[k], -1.0), 1.0);
+            out[(k * TET_STATS_N) + 4] = acos(cmax);
+            out[(k * TET_STATS_N) + 5] = acos(cmin);
+        }
+    }
+}
+
+STEPS_SIMD_CLONES(tetStatsKernel, (double const * verts, uint const * tets,
+                                  uint ntets, double * stats),
+                  (verts, tets, ntets, stats))
+
+void steps::math::tet_stats
+(
+    double const * verts, uint const * tets, uint ntets,
+    double * stats
+)
+{
+    STEPS_SIMD_PICK(tetStatsKernel)(verts, tets, ntets, stats);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void steps::math::tet_barycentric
 (
     double * v0, double * v1,
@@ -57,6 +57,49 @@ STEPS_EXTERN void tet_barycenter
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// Batch versions of tet_vol and tet_barycenter for the tetrahedrons
+/// tets[0..ntets*4-1], given as indices into the interleaved x,y,z
+/// coordinates verts. They give the same results as the single element
+/// functions.
+///
+STEPS_EXTERN void tet_vols
+(
+    double const * verts, uint const * tets, uint ntets,
+    double * vols
+);
+
+STEPS_EXTERN void tet_barycenters
+(
+    double const * verts, uint const * tets, uint ntets,
+    double * po
+);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Number of values tet_stats gives per tetrahedron.
+#define TET_STATS_N                     6
+
+/// Batch quality and size statistics of the tetrahedrons
+/// tets[0..ntets*4-1], as for tet_vols. For each tet, writes
+/// TET_STATS_N values to stats:
+///
+///    radius-edge ratio (tet_circumrad / tet_shortestedge),
+///    volume, shortest edge, longest edge,
+///    smallest dihedral angle, largest dihedral angle (radians).
+///
+/// The volume is that of tet_vols; the circumradius is found in closed
+/// form rather than by tet_circumrad's linear solve, so the ratio can
+/// differ from it in the last bits. Degenerate (flat) tetrahedrons give
+/// an infinite or NaN ratio.
+///
+STEPS_EXTERN void tet_stats
+(
+    double const * verts, uint const * tets, uint ntets,
+    double * stats
+);
+
+////////////////////////////////////////////////////////////////////////////////
+
 STEPS_EXTERN void tet_barycentric
 (
     double * v0, double * v1,
@@ -74,6 +74,32 @@ inline bool isSmallerEps(double r)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Number of elements the batch geometry kernels gather at a time.
+#define MATH_BATCH_BLOCK                64
+
+/// Gather the corners of elems[0..n-1], n <= MATH_BATCH_BLOCK, each
+/// element being ncorners indices into the interleaved x,y,z coordinates
+/// verts: c[(corner * 3) + d][k] becomes coordinate d of that corner of
+/// element k. Laid out like this, the batch geometry kernels work on
+/// contiguous arrays the compiler can vectorize.
+///
+inline void gatherCorners(double const * verts, uint const * elems,
+                          uint ncorners, uint n, double (*c)[MATH_BATCH_BLOCK])
+{
+    for (uint k = 0; k < n; ++k)
+    {
+        for (uint j = 0; j < ncorners; ++j)
+        {
+            double const * v = verts + (3 * elems[(k * ncorners) + j]);
+            c[j * 3][k] = v[0];
+            c[(j * 3) + 1][k] = v[1];
+            c[(j * 3) + 2][k] = v[2];
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 inline float getSysRand(float min, float max)
 {
     return min + ((max - min) *
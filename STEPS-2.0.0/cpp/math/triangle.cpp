@@ -34,7 +34,9 @@
 
 // STEPS headers.
 #include "../common.h"
+#include "tools.hpp"
 #include "triangle.hpp"
+#include "../simd.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -101,4 +103,221 @@ void steps::math::triNormal
 
 ////////////////////////////////////////////////////////////////////////////////
 
+double steps::math::triPointDist2
+(
+    double const * v0, double const * v1, double const * v2,
+    double const * p
+)
+{
+    // The closest point is found by the Voronoi region of p: a vertex,
+    // an edge or the interior (Ericson, Real-Time Collision Detection,
+    // 5.1.5), as barycentric coordinates (1 - v - w, v, w).
+    double ab[3], ac[3], ap[3];
+    for (uint d = 0; d < 3; ++d)
+    {
+        ab[d] = v1[d] - v0[d];
+        ac[d] = v2[d] - v0[d];
+        ap[d] = p[d] - v0[d];
+    }
+    double d1 = (ab[0] * ap[0]) + (ab[1] * ap[1]) + (ab[2] * ap[2]);
+    double d2 = (ac[0] * ap[0]) + (ac[1] * ap[1]) + (ac[2] * ap[2]);
+
+    double v = 0.0;
+    double w = 0.0;
+    if (d1 <= 0.0 && d2 <= 0.0)
+    {
+        // Vertex v0.
+    }
+    else
+    {
+        double bp[3];
+        for (uint d = 0; d < 3; ++d) bp[d] = p[d] - v1[d];
+        double d3 = (ab[0] * bp[0]) + (ab[1] * bp[1]) + (ab[2] * bp[2]);
+        double d4 = (ac[0] * bp[0]) + (ac[1] * bp[1]) + (ac[2] * bp[2]);
+        double cp[3];
+        for (uint d = 0; d < 3; ++d) cp[d] = p[d] - v2[d];
+        double d5 = (ab[0] * cp[0]) + (ab[1] * cp[1]) + (ab[2] * cp[2]);
+        double d6 = (ac[0] * cp[0]) + (ac[1] * cp[1]) + (ac[2] * cp[2]);
+        double vc = (d1 * d4) - (d3 * d2);
+        double vb = (d5 * d2) - (d1 * d6);
+        double va = (d3 * d6) - (d5 * d4);
+
+        if (d3 >= 0.0 && d4 <= d3)
+        {
+            // Vertex v1.
+            v = 1.0;
+        }
+        else if (d6 >= 0.0 && d5 <= d6)
+        {
+            // Vertex v2.
+            w = 1.0;
+        }
+        else if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+        {
+            // Edge v0-v1.
+            v = d1 / (d1 - d3);
+        }
+        else if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+        {
+            // Edge v0-v2.
+            w = d2 / (d2 - d6);
+        }
+        else if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+        {
+            // Edge v1-v2.
+            w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            v = 1.0 - w;
+        }
+        else
+        {
+            double denom = 1.0 / (va + vb + vc);
+            v = vb * denom;
+            w = vc * denom;
+        }
+    }
+
+    double dist2 = 0.0;
+    for (uint d = 0; d < 3; ++d)
+    {
+        double x = v0[d] + (ab[d] * v) + (ac[d] * w) - p[d];
+        dist2 += x * x;
+    }
+    return dist2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The cross product of the two edges from the first corner of each of
+// the n triangles gathered in c, as triArea and triNormal compute it.
+static STEPS_SIMD_INLINE void crossEdges(double (*c)[MATH_BATCH_BLOCK], uint n,
+                                        double (*cc)[MATH_BATCH_BLOCK])
+{
+    for (uint k = 0; k < n; ++k)
+    {
+        double vv0 = c[3][k] - c[0][k];
+        double vv1 = c[4][k] - c[1][k];
+        double vv2 = c[5][k] - c[2][k];
+        double ww0 = c[6][k] - c[0][k];
+        double ww1 = c[7][k] - c[1][k];
+        double ww2 = c[8][k] - c[2][k];
+        cc[0][k] = (vv1 * ww2) - (vv2 * ww1);
+        cc[1][k] = (vv2 * ww0) - (vv0 * ww2);
+        cc[2][k] = (vv0 * ww1) - (vv1 * ww0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static STEPS_SIMD_INLINE void triAreasKernel
+(
+    double const * verts, uint const * tris, uint ntris,
+    double * areas
+)
+{
+    double c[9][MATH_BATCH_BLOCK];
+    double cc[3][MATH_BATCH_BLOCK];
+    for (uint b = 0; b < ntris; b += MATH_BATCH_BLOCK)
+    {
+        uint n = steps::math::min(ntris - b, static_cast<uint>(MATH_BATCH_BLOCK));
+        steps::math::gatherCorners(verts, tris + (b * 3), 3, n, c);
+        crossEdges(c, n, cc);
+        for (uint k = 0; k < n; ++k)
+        {
+            areas[b + k] = 0.5 * sqrt((cc[0][k] * cc[0][k]) + (cc[1][k] * cc[1][k])
+                                      + (cc[2][k] * cc[2][k]));
+        }
+    }
+}
+
+STEPS_SIMD_CLONES(triAreasKernel, (double const * verts, uint const * tris,
+                                   uint ntris, double * areas),
+                  (verts, tris, ntris, areas))
+
+void steps::math::triAreas
+(
+    double const * verts, uint const * tris, uint ntris,
+    double * areas
+)
+{
+    STEPS_SIMD_PICK(triAreasKernel)(verts, tris, ntris, areas);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static STEPS_SIMD_INLINE void triBarycentersKernel
+(
+    double const * verts, uint const * tris, uint ntris,
+    double * po
+)
+{
+    double c[9][MATH_BATCH_BLOCK];
+    for (uint b = 0; b < ntris; b += MATH_BATCH_BLOCK)
+    {
+        uint n = steps::math::min(ntris - b, static_cast<uint>(MATH_BATCH_BLOCK));
+        steps::math::gatherCorners(verts, tris + (b * 3), 3, n, c);
+        double * out = po + (b * 3);
+        for (uint k = 0; k < n; ++k)
+        {
+            out[k * 3] = (c[0][k] + c[3][k] + c[6][k]) / 3.0;
+            out[(k * 3) + 1] = (c[1][k] + c[4][k] + c[7][k]) / 3.0;
+            out[(k * 3) + 2] = (c[2][k] + c[5][k] + c[8][k]) / 3.0;
+        }
+    }
+}
+
+STEPS_SIMD_CLONES(triBarycentersKernel, (double const * verts, uint const * tris,
+                                         uint ntris, double * po),
+                  (verts, tris, ntris, po))
+
+void steps::math::triBarycenters
+(
+    double const * verts, uint const * tris, uint ntris,
+    double * po
+)
+{
+    STEPS_SIMD_PICK(triBarycentersKernel)(verts, tris, ntris, po);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static STEPS_SIMD_INLINE void triNormalsKernel
+(
+    double const * verts, uint const * tris, uint ntris,
+    double * vo
+)
+{
+    double c[9][MATH_BATCH_BLOCK];
+    double cc[3][MATH_BATCH_BLOCK];
+    for (uint b = 0; b < ntris; b += MATH_BATCH_BLOCK)
+    {
+        uint n = steps::math::min(ntris - b, static_cast<uint>(MATH_BATCH_BLOCK));
+        steps::math::gatherCorners(verts, tris + (b * 3), 3, n, c);
+        crossEdges(c, n, cc);
+        double * out = vo + (b * 3);
+        for (uint k = 0; k < n; ++k)
+        {
+            double norm = sqrt((cc[0][k] * cc[0][k]) + (cc[1][k] * cc[1][k])
+                               + (cc[2][k] * cc[2][k]));
+            out[k * 3] = cc[0][k] / norm;
+            out[(k * 3) + 1] = cc[1][k] / norm;
+            out[(k * 3) + 2] = cc[2][k] / norm;
+        }
+    }
+}
+
+STEPS_SIMD_CLONES(triNormalsKernel, (double const * verts, uint const * tris,
+                                     uint ntris, double * vo),
+                  (verts, tris, ntris, vo))
+
+void steps::math::triNormals
+(
+    double const * verts, uint const * tris, uint ntris,
+    double * vo
+)
+{
+    STEPS_SIMD_PICK(triNormalsKernel)(verts, tris, ntris, vo);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
@@ -63,6 +63,42 @@ STEPS_EXTERN void triNormal
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// The squared distance from the point p to the closest point of the
+/// triangle (v0, v1, v2), its edges and interior included.
+///
+STEPS_EXTERN double triPointDist2
+(
+    double const * v0, double const * v1, double const * v2,
+    double const * p
+);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Batch versions of triArea, triBarycenter and triNormal for the
+/// triangles tris[0..ntris*3-1], given as indices into the interleaved
+/// x,y,z coordinates verts. They give the same results as the single
+/// element functions.
+///
+STEPS_EXTERN void triAreas
+(
+    double const * verts, uint const * tris, uint ntris,
+    double * areas
+);
+
+STEPS_EXTERN void triBarycenters
+(
+    double const * verts, uint const * tris, uint ntris,
+    double * po
+);
+
+STEPS_EXTERN void triNormals
+(
+    double const * verts, uint const * tris, uint ntris,
+    double * vo
+);
+
+////////////////////////////////////////////////////////////////////////////////
+
 END_NAMESPACE(math)
 END_NAMESPACE(steps)
 
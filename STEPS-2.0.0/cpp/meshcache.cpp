@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// Standard library & STL headers.
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STEPS headers.
+#include "common.h"
+#include "meshcache.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::string meshCacheFromEnv(void)
+{
+    char const * dir = getenv("STEPS_MESH_CACHE");
+    return (dir != 0) ? std::string(dir) : std::string();
+}
+
+static std::string pMeshCacheDir = meshCacheFromEnv();
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::setMeshCacheDir(std::string const & dir)
+{
+    pMeshCacheDir = dir;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string steps::getMeshCacheDir(void)
+{
+    return pMeshCacheDir;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool steps::meshCacheOn(void)
+{
+    return pMeshCacheDir.empty() == false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+steps::ContentHash::ContentHash(void)
+: pHash(14695981039346656037ULL)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::ContentHash::add(void const * data, std::size_t bytes)
+{
+    unsigned char const * b = static_cast<unsigned char const *>(data);
+    unsigned long long h = pHash;
+    for (std::size_t i = 0; i < bytes; ++i)
+    {
+        h ^= b[i];
+        h *= 1099511628211ULL;
+    }
+    pHash = h;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::ContentHash::add(std::string const & s)
+{
+    std::size_t n = s.size();
+    add(&n, sizeof(n));
+    add(s.data(), n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string steps::ContentHash::hex(void) const
+{
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", pHash);
+    return std::string(buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string steps::meshCachePath(std::string const & kind,
+                                 ContentHash const & key,
+                                 std::string const & ext)
+{
+    return pMeshCacheDir + "/" + kind + "-" + key.hex() + ext;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool steps::meshCacheHas(std::string const & path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string steps::meshCacheTemp(std::string const & path)
+{
+    std::ostringstream os;
+    // Meshes may be built on several threads of one process.
+    os << path << ".tmp" << getpid() << "." << (unsigned long) pthread_self();
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::meshCachePublish(std::string const & tmp, std::string const & path)
+{
+    if (rename(tmp.c_str(), path.c_str()) != 0) remove(tmp.c_str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
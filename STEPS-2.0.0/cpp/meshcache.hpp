@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef STEPS_MESHCACHE_HPP
+#define STEPS_MESHCACHE_HPP 1
+
+// Standard library & STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The mesh cache: a directory of files holding data derived from a
+/// mesh, each named after a hash of everything it was derived from, so
+/// that the many jobs run on one mesh compute it only once. While a
+/// cache directory is set,
+///
+/// <UL>
+/// <LI>Tetmesh construction reads the tables (bars, triangles,
+///     neighbours, volumes, areas, normals, barycentres) from
+///     tetmesh-<hash>.stepsmesh, written by saveBinary, if it exists and
+///     holds the same vertices and tetrahedrons, and writes it if not;
+/// <LI>a verified Memb reads whether it is open and its virtual
+///     triangles from memb-<hash>.bin;
+/// <LI>EField, when the membrane has no optimization file of its own,
+///     reads its vertex ordering and coupling constants from
+///     efield-<hash>.opt, written by saveOptimal.
+/// </UL>
+///
+/// A hash covers the input and the format version, so a changed mesh
+/// gets new files instead of stale data. Files are written under a
+/// temporary name and renamed, so jobs sharing the directory never see
+/// half a file. Failing to write a cache file is not an error.
+///
+/// The directory is taken from the environment variable
+/// STEPS_MESH_CACHE at startup; an empty name turns the cache off.
+///
+void setMeshCacheDir(std::string const & dir);
+
+std::string getMeshCacheDir(void);
+
+/// Whether a cache directory is set.
+///
+bool meshCacheOn(void);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// A 64 bit FNV-1a hash of the data added to it.
+///
+class ContentHash
+{
+
+public:
+
+    ContentHash(void);
+
+    void add(void const * data, std::size_t bytes);
+
+    template <class T>
+    void add(std::vector<T> const & v)
+    {
+        std::size_t n = v.size();
+        add(&n, sizeof(n));
+        if (n != 0) add(&v[0], n * sizeof(T));
+    }
+
+    void add(std::string const & s);
+
+    /// The hash as 16 hexadecimal digits.
+    ///
+    std::string hex(void) const;
+
+private:
+
+    unsigned long long                  pHash;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The cache file <kind>-<hash><ext> in the cache directory.
+///
+std::string meshCachePath(std::string const & kind, ContentHash const & key,
+                          std::string const & ext);
+
+bool meshCacheHas(std::string const & path);
+
+/// A temporary name for writing path, unique to this thread.
+///
+std::string meshCacheTemp(std::string const & path);
+
+/// Move the finished temporary file tmp to path, or remove it if that
+/// fails.
+///
+void meshCachePublish(std::string const & tmp, std::string const & path);
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_MESHCACHE_HPP
+
+// END
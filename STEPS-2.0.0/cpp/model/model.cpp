@@ -37,6 +37,7 @@
 #include "../common.h"
 #include "../error.hpp"
 #include "model.hpp"
+#include "network.hpp"
 #include "spec.hpp"
 #include "chan.hpp"
 #include "vdeptrans.hpp"
@@ -191,6 +192,13 @@ std::vector<Surfsys *> Model::getAllSurfsyss(void) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+Network * Model::compile(void) const
+{
+	return new Network(this);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 Chan * Model::getChan(string const & id) const
 {
     ChanPMapCI chan = pChans.find(id);
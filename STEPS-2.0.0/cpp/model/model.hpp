@@ -61,6 +61,7 @@ class VDepTrans;
 class VDepSReac;
 class OhmicCurr;
 class GHKcurr;
+class Network;
 
 // Auxiliary declarations.
 
@@ -227,6 +228,17 @@ public:
     /// \return List of pointers to the surface systems in the Model object.
 	std::vector<Surfsys *> getAllSurfsyss(void) const;
 
+	////////////////////////////////////////////////////////////////////////
+	// OPERATIONS: COMPILATION (EXPOSED TO PYTHON)
+	////////////////////////////////////////////////////////////////////////
+
+    /// Take a frozen snapshot of the model. Later changes to the model do
+    /// not affect the snapshot. The caller owns the network.
+    ///
+    /// \return Pointer to the network.
+    /// \sa Network
+	Network * compile(void) const;
+
 	////////////////////////////////////////////////////////////////////////
 	// INTERNAL (NON-EXPOSED): SOLVER HELPER METHODS
 	////////////////////////////////////////////////////////////////////////
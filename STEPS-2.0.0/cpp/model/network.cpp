@@ -0,0 +1,934 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <cassert>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "network.hpp"
+#include "model.hpp"
+#include "spec.hpp"
+#include "chan.hpp"
+#include "chanstate.hpp"
+#include "volsys.hpp"
+#include "surfsys.hpp"
+#include "reac.hpp"
+#include "sreac.hpp"
+#include "diff.hpp"
+#include "vdeptrans.hpp"
+#include "vdepsreac.hpp"
+#include "ohmiccurr.hpp"
+#include "ghkcurr.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+USING_NAMESPACE(std);
+USING_NAMESPACE(steps::model);
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+typedef map<Spec const *, uint>             SpecIdxMap;
+
+////////////////////////////////////////////////////////////////////////////////
+
+vector<uint> specIdcs(SpecIdxMap const & idcs, vector<Spec *> const & specs)
+{
+    vector<uint> res;
+    res.reserve(specs.size());
+    for (vector<Spec *>::const_iterator s = specs.begin(); s != specs.end(); ++s)
+    {
+        SpecIdxMap::const_iterator idx = idcs.find(*s);
+        assert(idx != idcs.end());
+        res.push_back(idx->second);
+    }
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+vector<Spec *> specPtrs(vector<Spec *> const & specs, vector<uint> const & idcs)
+{
+    vector<Spec *> res;
+    res.reserve(idcs.size());
+    for (vector<uint>::const_iterator i = idcs.begin(); i != idcs.end(); ++i)
+    {
+        res.push_back(specs[*i]);
+    }
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint specIdx(SpecIdxMap const & idcs, Spec const * spec)
+{
+    SpecIdxMap::const_iterator idx = idcs.find(spec);
+    assert(idx != idcs.end());
+    return idx->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Binary file helpers. Readers leave the stream failed on a short read.
+
+template <typename T>
+void writePOD(ostream & out, T const & v)
+{
+    out.write((char*)&v, sizeof(T));
+}
+
+template <typename T>
+void readPOD(istream & in, T & v)
+{
+    in.read((char*)&v, sizeof(T));
+}
+
+void writeStr(ostream & out, string const & s)
+{
+    uint n = s.size();
+    writePOD(out, n);
+    if (n > 0) out.write(s.data(), n);
+}
+
+void readStr(istream & in, string & s)
+{
+    uint n = 0;
+    readPOD(in, n);
+    if (!in) return;
+    s.assign(n, '\0');
+    if (n > 0) in.read(&s[0], n);
+}
+
+template <typename T>
+void writeVec(ostream & out, vector<T> const & v)
+{
+    uint n = v.size();
+    writePOD(out, n);
+    if (n > 0) out.write((char*)&v[0], sizeof(T) * n);
+}
+
+template <typename T>
+void readVec(istream & in, vector<T> & v)
+{
+    uint n = 0;
+    readPOD(in, n);
+    if (!in) return;
+    // Grow as the data arrives, so that a corrupt count fails on the read
+    // instead of on a huge allocation.
+    v.clear();
+    T x;
+    for (uint i = 0; i < n && in; ++i)
+    {
+        readPOD(in, x);
+        v.push_back(x);
+    }
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Network::Network(void)
+: pSpecs()
+, pChans()
+, pVolsyss()
+, pSurfsyss()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Network::Network(Model const * model)
+: pSpecs()
+, pChans()
+, pVolsyss()
+, pSurfsyss()
+{
+    assert(model != 0);
+
+    map<Chan const *, uint> chanidcs;
+    vector<Chan *> chans = model->getAllChans();
+    for (uint i = 0; i < chans.size(); ++i)
+    {
+        chanidcs[chans[i]] = i;
+        pChans.push_back(chans[i]->getID());
+    }
+
+    SpecIdxMap specidcs;
+    vector<Spec *> specs = model->getAllSpecs();
+    pSpecs.resize(specs.size());
+    for (uint i = 0; i < specs.size(); ++i)
+    {
+        specidcs[specs[i]] = i;
+        pSpecs[i].id = specs[i]->getID();
+        pSpecs[i].valence = specs[i]->getValence();
+        ChanState * cs = dynamic_cast<ChanState *>(specs[i]);
+        pSpecs[i].chan = (cs == 0 ? -1 : int(chanidcs[cs->getChan()]));
+    }
+
+    vector<Volsys *> volsyss = model->getAllVolsyss();
+    pVolsyss.resize(volsyss.size());
+    for (uint v = 0; v < volsyss.size(); ++v)
+    {
+        VolsysEntry & ve = pVolsyss[v];
+        ve.id = volsyss[v]->getID();
+
+        vector<Reac *> reacs = volsyss[v]->getAllReacs();
+        ve.reacs.resize(reacs.size());
+        for (uint r = 0; r < reacs.size(); ++r)
+        {
+            ve.reacs[r].id = reacs[r]->getID();
+            ve.reacs[r].lhs = specIdcs(specidcs, reacs[r]->getLHS());
+            ve.reacs[r].rhs = specIdcs(specidcs, reacs[r]->getRHS());
+            ve.reacs[r].kcst = reacs[r]->getKcst();
+        }
+
+        vector<Diff *> diffs = volsyss[v]->getAllDiffs();
+        ve.diffs.resize(diffs.size());
+        for (uint d = 0; d < diffs.size(); ++d)
+        {
+            ve.diffs[d].id = diffs[d]->getID();
+            ve.diffs[d].lig = specIdx(specidcs, diffs[d]->getLig());
+            ve.diffs[d].dcst = diffs[d]->getDcst();
+        }
+    }
+
+    vector<Surfsys *> surfsyss = model->getAllSurfsyss();
+    pSurfsyss.resize(surfsyss.size());
+    for (uint s = 0; s < surfsyss.size(); ++s)
+    {
+        SurfsysEntry & se = pSurfsyss[s];
+        se.id = surfsyss[s]->getID();
+
+        vector<SReac *> sreacs = surfsyss[s]->getAllSReacs();
+        se.sreacs.resize(sreacs.size());
+        for (uint r = 0; r < sreacs.size(); ++r)
+        {
+            SReacEntry & re = se.sreacs[r];
+            re.id = sreacs[r]->getID();
+            re.olhs = specIdcs(specidcs, sreacs[r]->getOLHS());
+            re.ilhs = specIdcs(specidcs, sreacs[r]->getILHS());
+            re.slhs = specIdcs(specidcs, sreacs[r]->getSLHS());
+            re.irhs = specIdcs(specidcs, sreacs[r]->getIRHS());
+            re.srhs = specIdcs(specidcs, sreacs[r]->getSRHS());
+            re.orhs = specIdcs(specidcs, sreacs[r]->getORHS());
+            re.kcst = sreacs[r]->getKcst();
+            re.vmin = re.vmax = re.dv = 0.0;
+        }
+
+        vector<Diff *> diffs = surfsyss[s]->getAllDiffs();
+        se.diffs.resize(diffs.size());
+        for (uint d = 0; d < diffs.size(); ++d)
+        {
+            se.diffs[d].id = diffs[d]->getID();
+            se.diffs[d].lig = specIdx(specidcs, diffs[d]->getLig());
+            se.diffs[d].dcst = diffs[d]->getDcst();
+        }
+
+        vector<VDepTrans *> vdts = surfsyss[s]->getAllVDepTrans();
+        se.vdeptrans.resize(vdts.size());
+        for (uint t = 0; t < vdts.size(); ++t)
+        {
+            VDepTransEntry & te = se.vdeptrans[t];
+            te.id = vdts[t]->getID();
+            te.src = specIdx(specidcs, vdts[t]->getSrc());
+            te.dst = specIdx(specidcs, vdts[t]->getDst());
+            double * rate = vdts[t]->_getRate();
+            te.rate.assign(rate, rate + vdts[t]->_getTablesize());
+            te.vmin = vdts[t]->_getVMin();
+            te.vmax = vdts[t]->_getVMax();
+            te.dv = vdts[t]->_getDV();
+        }
+
+        vector<VDepSReac *> vdsrs = surfsyss[s]->getAllVDepSReacs();
+        se.vdepsreacs.resize(vdsrs.size());
+        for (uint r = 0; r < vdsrs.size(); ++r)
+        {
+            SReacEntry & re = se.vdepsreacs[r];
+            re.id = vdsrs[r]->getID();
+            re.olhs = specIdcs(specidcs, vdsrs[r]->getOLHS());
+            re.ilhs = specIdcs(specidcs, vdsrs[r]->getILHS());
+            re.slhs = specIdcs(specidcs, vdsrs[r]->getSLHS());
+            re.irhs = specIdcs(specidcs, vdsrs[r]->getIRHS());
+            re.srhs = specIdcs(specidcs, vdsrs[r]->getSRHS());
+            re.orhs = specIdcs(specidcs, vdsrs[r]->getORHS());
+            re.kcst = 0.0;
+            double * k = vdsrs[r]->_getK();
+            re.ktab.assign(k, k + vdsrs[r]->_getTablesize());
+            re.vmin = vdsrs[r]->_getVMin();
+            re.vmax = vdsrs[r]->_getVMax();
+            re.dv = vdsrs[r]->_getDV();
+        }
+
+        vector<OhmicCurr *> ocs = surfsyss[s]->getAllOhmicCurrs();
+        se.ohmiccurrs.resize(ocs.size());
+        for (uint c = 0; c < ocs.size(); ++c)
+        {
+            se.ohmiccurrs[c].id = ocs[c]->getID();
+            se.ohmiccurrs[c].chanstate = specIdx(specidcs, ocs[c]->getChanState());
+            se.ohmiccurrs[c].erev = ocs[c]->getERev();
+            se.ohmiccurrs[c].g = ocs[c]->getG();
+        }
+
+        vector<GHKcurr *> ghks = surfsyss[s]->getAllGHKcurrs();
+        se.ghkcurrs.resize(ghks.size());
+        for (uint c = 0; c < ghks.size(); ++c)
+        {
+            GHKcurrEntry & ge = se.ghkcurrs[c];
+            GHKcurr * ghk = ghks[c];
+            ge.id = ghk->getID();
+            ge.chanstate = specIdx(specidcs, ghk->getChanState());
+            ge.ion = specIdx(specidcs, ghk->getIon());
+            ge.realflux = ghk->_realflux();
+            ge.voconc = ghk->_voconc();
+            ge.vshift = ghk->_vshift();
+            ge.info = 0;
+            ge.p = ge.g = ge.v = ge.temp = ge.oconc = ge.iconc = 0.0;
+            if (ghk->_infosupplied() == false) continue;
+            if (ghk->_P() != 0.0)
+            {
+                ge.info = 1;
+                ge.p = ghk->_P();
+            }
+            else
+            {
+                ge.info = 2;
+                ge.g = ghk->_G();
+                ge.v = ghk->_V();
+                ge.temp = ghk->_temp();
+                ge.oconc = ghk->_oconc();
+                ge.iconc = ghk->_iconc();
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Network::~Network(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Model * Network::build(void) const
+{
+    Model * model = new Model();
+
+    try
+    {
+        vector<Chan *> chans;
+        for (uint i = 0; i < pChans.size(); ++i)
+        {
+            chans.push_back(new Chan(pChans[i], model));
+        }
+
+        vector<Spec *> specs;
+        for (uint i = 0; i < pSpecs.size(); ++i)
+        {
+            SpecEntry const & e = pSpecs[i];
+            if (e.chan < 0)
+            {
+                specs.push_back(new Spec(e.id, model, e.valence));
+            }
+            else
+            {
+                specs.push_back(new ChanState(e.id, model, chans[e.chan]));
+                if (e.valence != 0) specs.back()->setValence(e.valence);
+            }
+        }
+
+        for (uint v = 0; v < pVolsyss.size(); ++v)
+        {
+            VolsysEntry const & ve = pVolsyss[v];
+            Volsys * volsys = new Volsys(ve.id, model);
+            for (uint r = 0; r < ve.reacs.size(); ++r)
+            {
+                ReacEntry const & re = ve.reacs[r];
+                new Reac(re.id, volsys, specPtrs(specs, re.lhs),
+                         specPtrs(specs, re.rhs), re.kcst);
+            }
+            for (uint d = 0; d < ve.diffs.size(); ++d)
+            {
+                DiffEntry const & de = ve.diffs[d];
+                new Diff(de.id, volsys, specs[de.lig], de.dcst);
+            }
+        }
+
+        for (uint s = 0; s < pSurfsyss.size(); ++s)
+        {
+            SurfsysEntry const & se = pSurfsyss[s];
+            Surfsys * surfsys = new Surfsys(se.id, model);
+            for (uint r = 0; r < se.sreacs.size(); ++r)
+            {
+                SReacEntry const & re = se.sreacs[r];
+                new SReac(re.id, surfsys, specPtrs(specs, re.olhs),
+                          specPtrs(specs, re.ilhs), specPtrs(specs, re.slhs),
+                          specPtrs(specs, re.irhs), specPtrs(specs, re.srhs),
+                          specPtrs(specs, re.orhs), re.kcst);
+            }
+            for (uint d = 0; d < se.diffs.size(); ++d)
+            {
+                DiffEntry const & de = se.diffs[d];
+                new Diff(de.id, surfsys, specs[de.lig], de.dcst);
+            }
+            for (uint t = 0; t < se.vdeptrans.size(); ++t)
+            {
+                VDepTransEntry const & te = se.vdeptrans[t];
+                new VDepTrans(te.id, surfsys,
+                              dynamic_cast<ChanState *>(specs[te.src]),
+                              dynamic_cast<ChanState *>(specs[te.dst]),
+                              te.rate, te.vmin, te.vmax, te.dv,
+                              te.rate.size());
+            }
+            for (uint r = 0; r < se.vdepsreacs.size(); ++r)
+            {
+                SReacEntry const & re = se.vdepsreacs[r];
+                new VDepSReac(re.id, surfsys, specPtrs(specs, re.olhs),
+                              specPtrs(specs, re.ilhs), specPtrs(specs, re.slhs),
+                              specPtrs(specs, re.irhs), specPtrs(specs, re.srhs),
+                              specPtrs(specs, re.orhs), re.ktab, re.vmin,
+                              re.vmax, re.dv, re.ktab.size());
+            }
+            for (uint c = 0; c < se.ohmiccurrs.size(); ++c)
+            {
+                OhmicCurrEntry const & oe = se.ohmiccurrs[c];
+                new OhmicCurr(oe.id, surfsys,
+                              dynamic_cast<ChanState *>(specs[oe.chanstate]),
+                              oe.erev, oe.g);
+            }
+            for (uint c = 0; c < se.ghkcurrs.size(); ++c)
+            {
+                GHKcurrEntry const & ge = se.ghkcurrs[c];
+                GHKcurr * ghk = new GHKcurr(ge.id, surfsys,
+                    dynamic_cast<ChanState *>(specs[ge.chanstate]),
+                    specs[ge.ion], ge.realflux, ge.voconc, ge.vshift);
+                if (ge.info == 1) ghk->setP(ge.p);
+                else if (ge.info == 2)
+                {
+                    ghk->setPInfo(ge.g, ge.v, ge.temp, ge.oconc, ge.iconc);
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        delete model;
+        throw;
+    }
+
+    return model;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Network::save(std::string const & file) const
+{
+    fstream out;
+    out.open(file.c_str(), fstream::out | fstream::binary | fstream::trunc);
+    if (!out)
+    {
+        ostringstream os;
+        os << "Cannot open network file '" << file << "'.";
+        throw steps::ArgErr(os.str());
+    }
+
+    uint version = NETWORK_FILE_VERSION;
+    out.write(NETWORK_FILE_MAGIC, 8);
+    writePOD(out, version);
+    _write(out);
+
+    if (!out)
+    {
+        ostringstream os;
+        os << "Failed to write network file '" << file << "'.";
+        throw steps::ArgErr(os.str());
+    }
+    out.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Network * Network::load(std::string const & file)
+{
+    fstream in;
+    in.open(file.c_str(), fstream::in | fstream::binary);
+    if (!in)
+    {
+        ostringstream os;
+        os << "Cannot open network file '" << file << "'.";
+        throw steps::ArgErr(os.str());
+    }
+
+    char magic[8];
+    uint version = 0;
+    in.read(magic, 8);
+    readPOD(in, version);
+    if (!in || string(magic, 8) != NETWORK_FILE_MAGIC
+        || version != NETWORK_FILE_VERSION)
+    {
+        ostringstream os;
+        os << "'" << file << "' is not a network file of format version ";
+        os << NETWORK_FILE_VERSION << ".";
+        throw steps::ArgErr(os.str());
+    }
+
+    Network * net = new Network();
+    net->_read(in);
+    if (!in)
+    {
+        delete net;
+        ostringstream os;
+        os << "Network file '" << file << "' is truncated or corrupt.";
+        throw steps::ArgErr(os.str());
+    }
+    return net;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<std::string> Network::getAllSpecIDs(void) const
+{
+    vector<string> ids;
+    ids.reserve(pSpecs.size());
+    for (uint i = 0; i < pSpecs.size(); ++i) ids.push_back(pSpecs[i].id);
+    return ids;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint Network::countReacs(void) const
+{
+    uint n = 0;
+    for (uint v = 0; v < pVolsyss.size(); ++v) n += pVolsyss[v].reacs.size();
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint Network::countSReacs(void) const
+{
+    uint n = 0;
+    for (uint s = 0; s < pSurfsyss.size(); ++s) n += pSurfsyss[s].sreacs.size();
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint Network::countDiffs(void) const
+{
+    uint n = 0;
+    for (uint v = 0; v < pVolsyss.size(); ++v) n += pVolsyss[v].diffs.size();
+    for (uint s = 0; s < pSurfsyss.size(); ++s) n += pSurfsyss[s].diffs.size();
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint Network::countVDepTrans(void) const
+{
+    uint n = 0;
+    for (uint s = 0; s < pSurfsyss.size(); ++s) n += pSurfsyss[s].vdeptrans.size();
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint Network::countVDepSReacs(void) const
+{
+    uint n = 0;
+    for (uint s = 0; s < pSurfsyss.size(); ++s) n += pSurfsyss[s].vdepsreacs.size();
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint Network::countOhmicCurrs(void) const
+{
+    uint n = 0;
+    for (uint s = 0; s < pSurfsyss.size(); ++s) n += pSurfsyss[s].ohmiccurrs.size();
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint Network::countGHKcurrs(void) const
+{
+    uint n = 0;
+    for (uint s = 0; s < pSurfsyss.size(); ++s) n += pSurfsyss[s].ghkcurrs.size();
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Network::_write(std::ostream & out) const
+{
+    uint n = pSpecs.size();
+    writePOD(out, n);
+    for (uint i = 0; i < n; ++i)
+    {
+        writeStr(out, pSpecs[i].id);
+        writePOD(out, pSpecs[i].valence);
+        writePOD(out, pSpecs[i].chan);
+    }
+
+    n = pChans.size();
+    writePOD(out, n);
+    for (uint i = 0; i < n; ++i) writeStr(out, pChans[i]);
+
+    n = pVolsyss.size();
+    writePOD(out, n);
+    for (uint v = 0; v < n; ++v)
+    {
+        VolsysEntry const & ve = pVolsyss[v];
+        writeStr(out, ve.id);
+        uint nr = ve.reacs.size();
+        writePOD(out, nr);
+        for (uint r = 0; r < nr; ++r)
+        {
+            writeStr(out, ve.reacs[r].id);
+            writeVec(out, ve.reacs[r].lhs);
+            writeVec(out, ve.reacs[r].rhs);
+            writePOD(out, ve.reacs[r].kcst);
+        }
+        uint nd = ve.diffs.size();
+        writePOD(out, nd);
+        for (uint d = 0; d < nd; ++d)
+        {
+            writeStr(out, ve.diffs[d].id);
+            writePOD(out, ve.diffs[d].lig);
+            writePOD(out, ve.diffs[d].dcst);
+        }
+    }
+
+    n = pSurfsyss.size();
+    writePOD(out, n);
+    for (uint s = 0; s < n; ++s)
+    {
+        SurfsysEntry const & se = pSurfsyss[s];
+        writeStr(out, se.id);
+
+        // Surface reactions, then voltage-dependent ones, in one layout.
+        for (uint k = 0; k < 2; ++k)
+        {
+            vector<SReacEntry> const & srs = (k == 0 ? se.sreacs : se.vdepsreacs);
+            uint nr = srs.size();
+            writePOD(out, nr);
+            for (uint r = 0; r < nr; ++r)
+            {
+                SReacEntry const & re = srs[r];
+                writeStr(out, re.id);
+                writeVec(out, re.olhs);
+                writeVec(out, re.ilhs);
+                writeVec(out, re.slhs);
+                writeVec(out, re.irhs);
+                writeVec(out, re.srhs);
+                writeVec(out, re.orhs);
+                writePOD(out, re.kcst);
+                writeVec(out, re.ktab);
+                writePOD(out, re.vmin);
+                writePOD(out, re.vmax);
+                writePOD(out, re.dv);
+            }
+        }
+
+        uint nd = se.diffs.size();
+        writePOD(out, nd);
+        for (uint d = 0; d < nd; ++d)
+        {
+            writeStr(out, se.diffs[d].id);
+            writePOD(out, se.diffs[d].lig);
+            writePOD(out, se.diffs[d].dcst);
+        }
+
+        uint nt = se.vdeptrans.size();
+        writePOD(out, nt);
+        for (uint t = 0; t < nt; ++t)
+        {
+            VDepTransEntry const & te = se.vdeptrans[t];
+            writeStr(out, te.id);
+            writePOD(out, te.src);
+            writePOD(out, te.dst);
+            writeVec(out, te.rate);
+            writePOD(out, te.vmin);
+            writePOD(out, te.vmax);
+            writePOD(out, te.dv);
+        }
+
+        uint no = se.ohmiccurrs.size();
+        writePOD(out, no);
+        for (uint c = 0; c < no; ++c)
+        {
+            OhmicCurrEntry const & oe = se.ohmiccurrs[c];
+            writeStr(out, oe.id);
+            writePOD(out, oe.chanstate);
+            writePOD(out, oe.erev);
+            writePOD(out, oe.g);
+        }
+
+        uint ng = se.ghkcurrs.size();
+        writePOD(out, ng);
+        for (uint c = 0; c < ng; ++c)
+        {
+            GHKcurrEntry const & ge = se.ghkcurrs[c];
+            writeStr(out, ge.id);
+            writePOD(out, ge.chanstate);
+            writePOD(out, ge.ion);
+            writePOD(out, ge.realflux);
+            writePOD(out, ge.voconc);
+            writePOD(out, ge.vshift);
+            writePOD(out, ge.info);
+            writePOD(out, ge.p);
+            writePOD(out, ge.g);
+            writePOD(out, ge.v);
+            writePOD(out, ge.temp);
+            writePOD(out, ge.oconc);
+            writePOD(out, ge.iconc);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Network::_read(std::istream & in)
+{
+    // Every count is checked against the stream before it is used, and every
+    // index against the table it refers to, so that a bad file fails here
+    // rather than in build().
+    uint n = 0;
+    readPOD(in, n);
+    for (uint i = 0; i < n && in; ++i)
+    {
+        SpecEntry e;
+        readStr(in, e.id);
+        readPOD(in, e.valence);
+        readPOD(in, e.chan);
+        pSpecs.push_back(e);
+    }
+
+    n = 0;
+    readPOD(in, n);
+    for (uint i = 0; i < n && in; ++i)
+    {
+        string id;
+        readStr(in, id);
+        pChans.push_back(id);
+    }
+
+    n = 0;
+    readPOD(in, n);
+    for (uint v = 0; v < n && in; ++v)
+    {
+        pVolsyss.push_back(VolsysEntry());
+        VolsysEntry & ve = pVolsyss.back();
+        readStr(in, ve.id);
+        uint nr = 0;
+        readPOD(in, nr);
+        for (uint r = 0; r < nr && in; ++r)
+        {
+            ReacEntry re;
+            readStr(in, re.id);
+            readVec(in, re.lhs);
+            readVec(in, re.rhs);
+            readPOD(in, re.kcst);
+            ve.reacs.push_back(re);
+        }
+        uint nd = 0;
+        readPOD(in, nd);
+        for (uint d = 0; d < nd && in; ++d)
+        {
+            DiffEntry de;
+            readStr(in, de.id);
+            readPOD(in, de.lig);
+            readPOD(in, de.dcst);
+            ve.diffs.push_back(de);
+        }
+    }
+
+    n = 0;
+    readPOD(in, n);
+    for (uint s = 0; s < n && in; ++s)
+    {
+        pSurfsyss.push_back(SurfsysEntry());
+        SurfsysEntry & se = pSurfsyss.back();
+        readStr(in, se.id);
+
+        for (uint k = 0; k < 2; ++k)
+        {
+            vector<SReacEntry> & srs = (k == 0 ? se.sreacs : se.vdepsreacs);
+            uint nr = 0;
+            readPOD(in, nr);
+            for (uint r = 0; r < nr && in; ++r)
+            {
+                SReacEntry re;
+                readStr(in, re.id);
+                readVec(in, re.olhs);
+                readVec(in, re.ilhs);
+                readVec(in, re.slhs);
+                readVec(in, re.irhs);
+                readVec(in, re.srhs);
+                readVec(in, re.orhs);
+                readPOD(in, re.kcst);
+                readVec(in, re.ktab);
+                readPOD(in, re.vmin);
+                readPOD(in, re.vmax);
+                readPOD(in, re.dv);
+                srs.push_back(re);
+            }
+        }
+
+        uint nd = 0;
+        readPOD(in, nd);
+        for (uint d = 0; d < nd && in; ++d)
+        {
+            DiffEntry de;
+            readStr(in, de.id);
+            readPOD(in, de.lig);
+            readPOD(in, de.dcst);
+            se.diffs.push_back(de);
+        }
+
+        uint nt = 0;
+        readPOD(in, nt);
+        for (uint t = 0; t < nt && in; ++t)
+        {
+            VDepTransEntry te;
+            readStr(in, te.id);
+            readPOD(in, te.src);
+            readPOD(in, te.dst);
+            readVec(in, te.rate);
+            readPOD(in, te.vmin);
+            readPOD(in, te.vmax);
+            readPOD(in, te.dv);
+            se.vdeptrans.push_back(te);
+        }
+
+        uint no = 0;
+        readPOD(in, no);
+        for (uint c = 0; c < no && in; ++c)
+        {
+            OhmicCurrEntry oe;
+            readStr(in, oe.id);
+            readPOD(in, oe.chanstate);
+            readPOD(in, oe.erev);
+            readPOD(in, oe.g);
+            se.ohmiccurrs.push_back(oe);
+        }
+
+        uint ng = 0;
+        readPOD(in, ng);
+        for (uint c = 0; c < ng && in; ++c)
+        {
+            GHKcurrEntry ge;
+            readStr(in, ge.id);
+            readPOD(in, ge.chanstate);
+            readPOD(in, ge.ion);
+            readPOD(in, ge.realflux);
+            readPOD(in, ge.voconc);
+            readPOD(in, ge.vshift);
+            readPOD(in, ge.info);
+            readPOD(in, ge.p);
+            readPOD(in, ge.g);
+            readPOD(in, ge.v);
+            readPOD(in, ge.temp);
+            readPOD(in, ge.oconc);
+            readPOD(in, ge.iconc);
+            se.ghkcurrs.push_back(ge);
+        }
+    }
+    if (!in) return;
+
+    // Check the cross references.
+    uint nspecs = pSpecs.size();
+    bool ok = true;
+    for (uint i = 0; i < nspecs; ++i)
+    {
+        if (pSpecs[i].chan >= int(pChans.size())) ok = false;
+    }
+    for (uint v = 0; v < pVolsyss.size(); ++v)
+    {
+        VolsysEntry const & ve = pVolsyss[v];
+        for (uint r = 0; r < ve.reacs.size(); ++r)
+        {
+            for (uint j = 0; j < ve.reacs[r].lhs.size(); ++j)
+                if (ve.reacs[r].lhs[j] >= nspecs) ok = false;
+            for (uint j = 0; j < ve.reacs[r].rhs.size(); ++j)
+                if (ve.reacs[r].rhs[j] >= nspecs) ok = false;
+        }
+        for (uint d = 0; d < ve.diffs.size(); ++d)
+        {
+            if (ve.diffs[d].lig >= nspecs) ok = false;
+        }
+    }
+    for (uint s = 0; s < pSurfsyss.size(); ++s)
+    {
+        SurfsysEntry const & se = pSurfsyss[s];
+        for (uint k = 0; k < 2; ++k)
+        {
+            vector<SReacEntry> const & srs = (k == 0 ? se.sreacs : se.vdepsreacs);
+            for (uint r = 0; r < srs.size(); ++r)
+            {
+                UIntVec const * lists[6] = { &srs[r].olhs, &srs[r].ilhs,
+                    &srs[r].slhs, &srs[r].irhs, &srs[r].srhs, &srs[r].orhs };
+                for (uint l = 0; l < 6; ++l)
+                    for (uint j = 0; j < lists[l]->size(); ++j)
+                        if ((*lists[l])[j] >= nspecs) ok = false;
+            }
+        }
+        for (uint d = 0; d < se.diffs.size(); ++d)
+        {
+            if (se.diffs[d].lig >= nspecs) ok = false;
+        }
+        for (uint t = 0; t < se.vdeptrans.size(); ++t)
+        {
+            uint src = se.vdeptrans[t].src, dst = se.vdeptrans[t].dst;
+            if (src >= nspecs || pSpecs[src].chan < 0) ok = false;
+            else if (dst >= nspecs || pSpecs[dst].chan < 0) ok = false;
+        }
+        for (uint c = 0; c < se.ohmiccurrs.size(); ++c)
+        {
+            uint cs = se.ohmiccurrs[c].chanstate;
+            if (cs >= nspecs || pSpecs[cs].chan < 0) ok = false;
+        }
+        for (uint c = 0; c < se.ghkcurrs.size(); ++c)
+        {
+            uint cs = se.ghkcurrs[c].chanstate;
+            if (cs >= nspecs || pSpecs[cs].chan < 0) ok = false;
+            if (se.ghkcurrs[c].ion >= nspecs) ok = false;
+        }
+    }
+    if (!ok) in.setstate(std::ios::failbit);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
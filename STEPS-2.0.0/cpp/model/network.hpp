@@ -0,0 +1,278 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_MODEL_NETWORK_HPP
+#define STEPS_MODEL_NETWORK_HPP 1
+
+
+// STL headers.
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Header of a network file: the magic string, then the format version
+/// (see Network::save).
+#define NETWORK_FILE_MAGIC      "STEPSNET"
+#define NETWORK_FILE_VERSION    1
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(model)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Forward declarations.
+class Model;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Frozen copy of a kinetic model, made by Model::compile().
+///
+/// A Network holds the species, channels, reactions with their
+/// stoichiometry and rate constants, diffusion rules, voltage-dependent
+/// transitions and reactions and currents of a model as plain tables.
+/// Objects refer to each other by their global index in the model (species
+/// and channels in ID order, as in the solvers), never by pointer. Nothing
+/// can change a Network after it is made, so one instance can be read by
+/// several threads at once.
+///
+/// A Network can be saved to and loaded from a binary file, and build()
+/// turns it back into a Model for the solvers. The rebuilt model has the
+/// same IDs, parameters and global indices as the compiled one.
+///
+class Network
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Constructor. Takes a snapshot of model.
+    ///
+    /// \param model The model to compile.
+    Network(Model const * model);
+
+    /// Destructor
+    ~Network(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // OPERATIONS (EXPOSED TO PYTHON)
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Create a new Model from the network. The caller owns the model.
+    ///
+    /// \return Pointer to the new model.
+    Model * build(void) const;
+
+    /// Write the network to file.
+    ///
+    /// \param file Name of the file.
+    void save(std::string const & file) const;
+
+    /// Read a network from a file written by save(). The caller owns the
+    /// network.
+    ///
+    /// \param file Name of the file.
+    /// \return Pointer to the new network.
+    static Network * load(std::string const & file);
+
+    /// Return the IDs of all species in the network, in index order.
+    std::vector<std::string> getAllSpecIDs(void) const;
+
+    /// Count the species (channel states included) in the network.
+    uint countSpecs(void) const
+    { return pSpecs.size(); }
+
+    /// Count the channels in the network.
+    uint countChans(void) const
+    { return pChans.size(); }
+
+    /// Count the volume systems in the network.
+    uint countVolsyss(void) const
+    { return pVolsyss.size(); }
+
+    /// Count the surface systems in the network.
+    uint countSurfsyss(void) const
+    { return pSurfsyss.size(); }
+
+    /// Count the reactions in all volume systems.
+    uint countReacs(void) const;
+
+    /// Count the surface reactions in all surface systems.
+    uint countSReacs(void) const;
+
+    /// Count the diffusion rules in all volume and surface systems.
+    uint countDiffs(void) const;
+
+    /// Count the voltage-dependent transitions in all surface systems.
+    uint countVDepTrans(void) const;
+
+    /// Count the voltage-dependent reactions in all surface systems.
+    uint countVDepSReacs(void) const;
+
+    /// Count the ohmic currents in all surface systems.
+    uint countOhmicCurrs(void) const;
+
+    /// Count the GHK currents in all surface systems.
+    uint countGHKcurrs(void) const;
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Empty network, filled in by load().
+    Network(void);
+
+    void _write(std::ostream & out) const;
+    void _read(std::istream & in);
+
+    ////////////////////////////////////////////////////////////////////////
+    // TABLES
+    ////////////////////////////////////////////////////////////////////////
+
+    typedef std::vector<uint>               UIntVec;
+    typedef std::vector<double>             DblVec;
+
+    /// A species, or a channel state when chan is a channel index.
+    struct SpecEntry
+    {
+        std::string                         id;
+        int                                 valence;
+        int                                 chan;
+    };
+
+    struct ReacEntry
+    {
+        std::string                         id;
+        UIntVec                             lhs;
+        UIntVec                             rhs;
+        double                              kcst;
+    };
+
+    struct DiffEntry
+    {
+        std::string                         id;
+        uint                                lig;
+        double                              dcst;
+    };
+
+    /// Surface reaction; the voltage-dependent ones keep their rate table
+    /// in ktab and have a kcst of 0.
+    struct SReacEntry
+    {
+        std::string                         id;
+        UIntVec                             olhs;
+        UIntVec                             ilhs;
+        UIntVec                             slhs;
+        UIntVec                             irhs;
+        UIntVec                             srhs;
+        UIntVec                             orhs;
+        double                              kcst;
+        DblVec                              ktab;
+        double                              vmin;
+        double                              vmax;
+        double                              dv;
+    };
+
+    struct VDepTransEntry
+    {
+        std::string                         id;
+        uint                                src;
+        uint                                dst;
+        DblVec                              rate;
+        double                              vmin;
+        double                              vmax;
+        double                              dv;
+    };
+
+    struct OhmicCurrEntry
+    {
+        std::string                         id;
+        uint                                chanstate;
+        double                              erev;
+        double                              g;
+    };
+
+    /// GHK current; info is 0 if no permeability was given, 1 if it was
+    /// given directly (p) and 2 if it was given as a measured conductance
+    /// (g, v, temp, oconc, iconc).
+    struct GHKcurrEntry
+    {
+        std::string                         id;
+        uint                                chanstate;
+        uint                                ion;
+        bool                                realflux;
+        double                              voconc;
+        double                              vshift;
+        uint                                info;
+        double                              p;
+        double                              g;
+        double                              v;
+        double                              temp;
+        double                              oconc;
+        double                              iconc;
+    };
+
+    struct VolsysEntry
+    {
+        std::string                         id;
+        std::vector<ReacEntry>              reacs;
+        std::vector<DiffEntry>              diffs;
+    };
+
+    struct SurfsysEntry
+    {
+        std::string                         id;
+        std::vector<SReacEntry>             sreacs;
+        std::vector<DiffEntry>              diffs;
+        std::vector<VDepTransEntry>         vdeptrans;
+        std::vector<SReacEntry>             vdepsreacs;
+        std::vector<OhmicCurrEntry>         ohmiccurrs;
+        std::vector<GHKcurrEntry>           ghkcurrs;
+    };
+
+    std::vector<SpecEntry>                  pSpecs;
+    std::vector<std::string>                pChans;
+    std::vector<VolsysEntry>                pVolsyss;
+    std::vector<SurfsysEntry>               pSurfsyss;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(model)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_MODEL_NETWORK_HPP
+
+// END
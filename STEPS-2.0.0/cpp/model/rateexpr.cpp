@@ -0,0 +1,338 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPSis free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPSis distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "rateexpr.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+USING_NAMESPACE(std);
+USING_NAMESPACE(steps::model);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Number of voltages fillTable evaluates at a time.
+#define RATEEXPR_BLOCK                  64
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Recursive descent parser, emitting the postfix program as it goes.
+class RateExprParser
+{
+public:
+    RateExprParser(string const & expr, vector<RateExpr::Op> & prog)
+    : pExpr(expr), pPos(0), pProg(prog) { }
+
+    void parse(void)
+    {
+        sum();
+        skipSpace();
+        if (pPos != pExpr.size()) error("unexpected character");
+    }
+
+private:
+    void emit(RateExpr::OpCode code, double val = 0.0)
+    {
+        RateExpr::Op op;
+        op.code = code;
+        op.val = val;
+        pProg.push_back(op);
+    }
+
+    void error(char const * msg)
+    {
+        ostringstream os;
+        os << "Rate expression '" << pExpr << "': " << msg;
+        os << " at position " << pPos << ".\n";
+        throw steps::ArgErr(os.str());
+    }
+
+    void skipSpace(void)
+    {
+        while (pPos < pExpr.size() && isspace(pExpr[pPos])) ++pPos;
+    }
+
+    // Skip spaces and consume c if it comes next.
+    bool accept(char c)
+    {
+        skipSpace();
+        if (pPos < pExpr.size() && pExpr[pPos] == c)
+        {
+            ++pPos;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if (accept(c) == false)
+        {
+            string msg = string("expected '") + c + "'";
+            error(msg.c_str());
+        }
+    }
+
+    // sum := product (('+' | '-') product)*
+    void sum(void)
+    {
+        product();
+        while (true)
+        {
+            if (accept('+')) { product(); emit(RateExpr::OP_ADD); }
+            else if (accept('-')) { product(); emit(RateExpr::OP_SUB); }
+            else return;
+        }
+    }
+
+    // product := unary (('*' | '/') unary)*
+    void product(void)
+    {
+        unary();
+        while (true)
+        {
+            skipSpace();
+            if (pExpr.compare(pPos, 2, "**") == 0) return;
+            if (accept('*')) { unary(); emit(RateExpr::OP_MUL); }
+            else if (accept('/')) { unary(); emit(RateExpr::OP_DIV); }
+            else return;
+        }
+    }
+
+    // unary := ('-' | '+') unary | power
+    void unary(void)
+    {
+        if (accept('-'))
+        {
+            unary();
+            emit(RateExpr::OP_NEG);
+        }
+        else if (accept('+')) unary();
+        else power();
+    }
+
+    // power := primary (('^' | '**') unary)?, so 2^-v and 2^3^2 work.
+    void power(void)
+    {
+        primary();
+        skipSpace();
+        if (pExpr.compare(pPos, 2, "**") == 0)
+        {
+            pPos += 2;
+            unary();
+            emit(RateExpr::OP_POW);
+        }
+        else if (accept('^'))
+        {
+            unary();
+            emit(RateExpr::OP_POW);
+        }
+    }
+
+    // primary := number | 'v' | name '(' sum (',' sum)* ')' | '(' sum ')'
+    void primary(void)
+    {
+        skipSpace();
+        if (pPos == pExpr.size()) error("unexpected end");
+        char c = pExpr[pPos];
+        if (isdigit(c) || c == '.')
+        {
+            char const * start = pExpr.c_str() + pPos;
+            char * end = 0;
+            double val = strtod(start, &end);
+            if (end == start) error("bad number");
+            pPos += end - start;
+            emit(RateExpr::OP_CONST, val);
+        }
+        else if (isalpha(c) || c == '_')
+        {
+            uint start = pPos;
+            while (pPos < pExpr.size() &&
+                   (isalnum(pExpr[pPos]) || pExpr[pPos] == '_')) ++pPos;
+            string name = pExpr.substr(start, pPos - start);
+            if (name == "v")
+            {
+                emit(RateExpr::OP_V);
+                return;
+            }
+            RateExpr::OpCode code;
+            uint nargs = 1;
+            if (name == "exp") code = RateExpr::OP_EXP;
+            else if (name == "log") code = RateExpr::OP_LOG;
+            else if (name == "sqrt") code = RateExpr::OP_SQRT;
+            else if (name == "abs") code = RateExpr::OP_ABS;
+            else if (name == "pow") { code = RateExpr::OP_POW; nargs = 2; }
+            else if (name == "vtrap") { code = RateExpr::OP_VTRAP; nargs = 2; }
+            else if (name == "boltz") { code = RateExpr::OP_BOLTZ; nargs = 2; }
+            else
+            {
+                pPos = start;
+                error("unknown name");
+            }
+            expect('(');
+            for (uint i = 0; i < nargs; ++i)
+            {
+                if (i != 0) expect(',');
+                sum();
+            }
+            expect(')');
+            emit(code);
+        }
+        else if (accept('('))
+        {
+            sum();
+            expect(')');
+        }
+        else error("unexpected character");
+    }
+
+    string const                      & pExpr;
+    uint                                pPos;
+    vector<RateExpr::Op>              & pProg;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+RateExpr::RateExpr(string const & expr)
+: pProg()
+, pDepth(0)
+{
+    RateExprParser parser(expr, pProg);
+    parser.parse();
+
+    uint depth = 0;
+    for (uint i = 0; i < pProg.size(); ++i)
+    {
+        OpCode code = pProg[i].code;
+        if (code == OP_CONST || code == OP_V) ++depth;
+        else if (code <= OP_BOLTZ) --depth;
+        if (depth > pDepth) pDepth = depth;
+    }
+    assert(depth == 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double RateExpr::eval(double v) const
+{
+    double r;
+    fillTable(v, 0.0, 1, &r);
+    return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void RateExpr::fillTable(double vmin, double dv, uint n, double * table) const
+{
+    vector<double> stack(pDepth * RATEEXPR_BLOCK);
+    uint nops = pProg.size();
+    for (uint b = 0; b < n; b += RATEEXPR_BLOCK)
+    {
+        uint m = n - b < RATEEXPR_BLOCK ? n - b : RATEEXPR_BLOCK;
+        // Number of values on the stack.
+        uint sp = 0;
+        for (uint i = 0; i < nops; ++i)
+        {
+            OpCode code = pProg[i].code;
+            double c = pProg[i].val;
+            if (code == OP_CONST || code == OP_V)
+            {
+                double * y = &stack[sp * RATEEXPR_BLOCK];
+                ++sp;
+                if (code == OP_CONST) for (uint k = 0; k < m; ++k) y[k] = c;
+                else for (uint k = 0; k < m; ++k) y[k] = vmin + ((b + k) * dv);
+                continue;
+            }
+            // The top of the stack, and for binary operations the value
+            // under it, which receives the result.
+            double * y = &stack[(sp - 1) * RATEEXPR_BLOCK];
+            double * x = y - RATEEXPR_BLOCK;
+            switch (code)
+            {
+                case OP_ADD:
+                    for (uint k = 0; k < m; ++k) x[k] += y[k];
+                    break;
+                case OP_SUB:
+                    for (uint k = 0; k < m; ++k) x[k] -= y[k];
+                    break;
+                case OP_MUL:
+                    for (uint k = 0; k < m; ++k) x[k] *= y[k];
+                    break;
+                case OP_DIV:
+                    for (uint k = 0; k < m; ++k) x[k] /= y[k];
+                    break;
+                case OP_POW:
+                    for (uint k = 0; k < m; ++k) x[k] = pow(x[k], y[k]);
+                    break;
+                case OP_VTRAP:
+                    for (uint k = 0; k < m; ++k)
+                    {
+                        double r = x[k] / y[k];
+                        // Series expansion where the quotient is 0 / 0.
+                        if (fabs(r) < 1.0e-6) x[k] = y[k] * (1.0 - (r / 2.0));
+                        else x[k] = x[k] / (exp(r) - 1.0);
+                    }
+                    break;
+                case OP_BOLTZ:
+                    for (uint k = 0; k < m; ++k) x[k] = 1.0 / (1.0 + exp(x[k] / y[k]));
+                    break;
+                case OP_NEG:
+                    for (uint k = 0; k < m; ++k) y[k] = -y[k];
+                    break;
+                case OP_EXP:
+                    for (uint k = 0; k < m; ++k) y[k] = exp(y[k]);
+                    break;
+                case OP_LOG:
+                    for (uint k = 0; k < m; ++k) y[k] = log(y[k]);
+                    break;
+                case OP_SQRT:
+                    for (uint k = 0; k < m; ++k) y[k] = sqrt(y[k]);
+                    break;
+                case OP_ABS:
+                    for (uint k = 0; k < m; ++k) y[k] = fabs(y[k]);
+                    break;
+                default:
+                    break;
+            }
+            if (code <= OP_BOLTZ) --sp;
+        }
+        assert(sp == 1);
+        for (uint k = 0; k < m; ++k) table[b + k] = stack[k];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
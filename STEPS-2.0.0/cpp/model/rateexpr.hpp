@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPSis free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPSis distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_MODEL_RATEEXPR_HPP
+#define STEPS_MODEL_RATEEXPR_HPP 1
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(model)
+
+////////////////////////////////////////////////////////////////////////////////
+/// A rate as a function of the membrane potential v (in volts), written
+/// in a small expression language, compiled once and evaluated over
+/// voltage tables without calling back into Python.
+///
+/// Expressions are made of numbers (as 1.5e-3), the variable v, the
+/// operators + - * / and ^ (or **), parentheses and the functions
+///
+///    exp(x), log(x), sqrt(x), abs(x), pow(x, y),
+///    vtrap(x, y)  = x / (exp(x / y) - 1), y at x = 0, for the
+///                   Hodgkin-Huxley alpha and beta forms,
+///    boltz(x, k)  = 1 / (1 + exp(x / k)), a Boltzmann function.
+///
+/// For instance the Hodgkin-Huxley alpha_n is
+///
+///    1.0e4 * vtrap(-(v + 0.055), 0.01)
+///
+class RateExpr
+{
+
+public:
+
+    /// Compile expr.
+    ///
+    /// Throws steps::ArgErr on a syntax error, naming its position.
+    RateExpr(std::string const & expr);
+
+    /// Return the value of the expression at voltage v.
+    ///
+    double eval(double v) const;
+
+    /// Write the values at vmin + i * dv, for i in 0..n-1, to table.
+    ///
+    /// The points are evaluated in blocks, one operation at a time over
+    /// a whole block, so the loops vectorize.
+    void fillTable(double vmin, double dv, uint n, double * table) const;
+
+    /// Operations of the compiled, postfix program: pushes, then the
+    /// binary operations up to OP_BOLTZ, then the unary ones.
+    enum OpCode
+    {
+        OP_CONST, OP_V,
+        OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW, OP_VTRAP, OP_BOLTZ,
+        OP_NEG, OP_EXP, OP_LOG, OP_SQRT, OP_ABS
+    };
+
+    struct Op
+    {
+        OpCode                          code;
+        double                          val;
+    };
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    std::vector<Op>                     pProg;
+    // Largest number of values on the stack.
+    uint                                pDepth;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(model)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_MODEL_RATEEXPR_HPP
+
+// END
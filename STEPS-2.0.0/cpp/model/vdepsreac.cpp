@@ -23,6 +23,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 // STL headers.
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 #include <string>
@@ -30,6 +31,7 @@
 // STEPS headers.
 #include "../common.h"
 #include "../error.hpp"
+#include "rateexpr.hpp"
 #include "model.hpp"
 #include "surfsys.hpp"
 #include "vdepsreac.hpp"
@@ -82,7 +84,7 @@ VDepSReac::VDepSReac(std::string const & id, Surfsys * surfsys,
     	throw steps::ArgErr(os.str());
     }
 
-	if (ktab.size() != pTablesize)
+	if (ktab.size() != 0 && ktab.size() != pTablesize)
 	{
 		ostringstream os;
 		os << "Table of reaction parameters is not of expected size";
@@ -102,7 +104,7 @@ VDepSReac::VDepSReac(std::string const & id, Surfsys * surfsys,
 
 	// Copy the rate information to local array
 	pK = new double[pTablesize];
-	for (uint i = 0; i < pTablesize; ++i) pK[i] = ktab[i];
+	for (uint i = 0; i < pTablesize; ++i) pK[i] = (ktab.empty() ? 0.0 : ktab[i]);
 
     pSurfsys->_handleVDepSReacAdd(this);
 
@@ -376,4 +378,19 @@ vector<Spec *> VDepSReac::getAllSpecs(void) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void VDepSReac::setKExpr(std::string const & expr)
+{
+	RateExpr(expr).fillTable(pVMin, pDV, pTablesize, pK);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void VDepSReac::setKAddr(size_t addr)
+{
+	double const * table = reinterpret_cast<double const *>(addr);
+	std::copy(table, table + pTablesize, pK);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
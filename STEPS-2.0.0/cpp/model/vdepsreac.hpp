@@ -83,7 +83,9 @@ public:
     /// \param srhs Surface species on the right hand side of the reaction.
     /// \param orhs Volume species in the outer compartment
     ///             and on the right hand side of the reaction.
-    /// \param ktab A table of the voltage-dependent reaction parameter.
+    /// \param ktab A table of the voltage-dependent reaction parameter. If
+    ///        empty, all parameters are 0 until set with setKExpr or
+    ///        setKAddr.
     ///
 
 	VDepSReac(std::string const & id, Surfsys * surfsys,
@@ -223,6 +225,18 @@ public:
 	///
 	std::vector<double> getK(void) const;
 
+	/// Fill the table of reaction parameters from a rate expression (see
+	/// RateExpr) of the voltage v, at vmin + i * dv.
+	///
+	/// \param expr The expression.
+	void setKExpr(std::string const & expr);
+
+	/// Copy the table of reaction parameters from tablesize contiguous
+	/// doubles at address addr, such as the data of a NumPy array.
+	///
+	/// \param addr Address of the table.
+	void setKAddr(size_t addr);
+
     /// Get a list of all species.
 	///
     /// Returns a list of all species involved in this
@@ -23,6 +23,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 // STL headers.
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 #include <string>
@@ -30,6 +31,7 @@
 // STEPS headers.
 #include "../common.h"
 #include "../error.hpp"
+#include "rateexpr.hpp"
 #include "model.hpp"
 #include "surfsys.hpp"
 #include "vdeptrans.hpp"
@@ -73,7 +75,7 @@ VDepTrans::VDepTrans(std::string const & id, Surfsys * surfsys,
 		throw steps::ArgErr(os.str());
 	}
 
-	if (rate.size() != pTablesize)
+	if (rate.size() != 0 && rate.size() != pTablesize)
 	{
 		ostringstream os;
 		os << "Table of transition rates is not of expected size";
@@ -88,7 +90,7 @@ VDepTrans::VDepTrans(std::string const & id, Surfsys * surfsys,
 
 	// Copy the rate information to local array
 	pRate = new double[pTablesize];
-	for (uint i = 0; i < pTablesize; ++i) pRate[i] = rate[i];
+	for (uint i = 0; i < pTablesize; ++i) pRate[i] = (rate.empty() ? 0.0 : rate[i]);
 
     pSurfsys->_handleVDepTransAdd(this);
 
@@ -173,4 +175,19 @@ std::vector<double> VDepTrans::getRate(void) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void VDepTrans::setRateExpr(std::string const & expr)
+{
+	RateExpr(expr).fillTable(pVMin, pDV, pTablesize, pRate);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void VDepTrans::setRateAddr(size_t addr)
+{
+	double const * table = reinterpret_cast<double const *>(addr);
+	std::copy(table, table + pTablesize, pRate);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
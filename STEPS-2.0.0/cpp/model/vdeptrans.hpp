@@ -76,7 +76,9 @@ public:
     /// \param surfsys Pointer to the parent surface system.
     /// \param src The 'source' state, the beginning state of the channel.
     /// \param dst The 'destination' state, the end state of the channel. species in the inner compartment
-    /// \param rate A table of the voltage-dependent transition rate.
+    /// \param rate A table of the voltage-dependent transition rate. If
+    ///        empty, all rates are 0 until set with setRateExpr or
+    ///        setRateAddr.
     ///
 
 	VDepTrans(std::string const & id, Surfsys * surfsys,
@@ -150,6 +152,18 @@ public:
 	///
 	std::vector<double> getRate(void) const;
 
+	/// Fill the table of transition rates from a rate expression (see
+	/// RateExpr) of the voltage v, at vmin + i * dv.
+	///
+	/// \param expr The expression.
+	void setRateExpr(std::string const & expr);
+
+	/// Copy the table of transition rates from tablesize contiguous
+	/// doubles at address addr, such as the data of a NumPy array.
+	///
+	/// \param addr Address of the table.
+	void setRateAddr(size_t addr);
+
 	////////////////////////////////////////////////////////////////////////
 	// INTERNAL (NON-EXPOSED): SOLVER-HELPER METHODS
 	////////////////////////////////////////////////////////////////////////
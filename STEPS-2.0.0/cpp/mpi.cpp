@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cstdlib>
+
+#ifdef STEPS_USE_MPI
+// MPI headers.
+#include <mpi.h>
+#endif
+
+// STEPS headers.
+#include "common.h"
+#include "mpi.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef STEPS_USE_MPI
+static void finalizeMPI(void)
+{
+    int done = 0;
+    MPI_Finalized(&done);
+    if (done == 0) MPI_Finalize();
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::initMPI(void)
+{
+#ifdef STEPS_USE_MPI
+    int init = 0;
+    MPI_Initialized(&init);
+    if (init != 0) return;
+    int provided = 0;
+    MPI_Init_thread(0, 0, MPI_THREAD_SERIALIZED, &provided);
+    atexit(finalizeMPI);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
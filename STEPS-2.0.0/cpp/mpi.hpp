@@ -0,0 +1,51 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_MPI_HPP
+#define STEPS_MPI_HPP 1
+
+// STEPS headers.
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Initialize MPI, asking for MPI_THREAD_SERIALIZED support, unless the
+/// caller has done so already, and finalize it at exit unless the caller
+/// has done that first. Every part of STEPS that talks to other ranks
+/// calls this before using MPI. Does nothing without STEPS_USE_MPI.
+///
+void initMPI(void);
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_MPI_HPP
+
+// END
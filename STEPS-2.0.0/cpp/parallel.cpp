@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cassert>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// STEPS headers.
+#include "common.h"
+#include "error.hpp"
+#include "parallel.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The block of a parallelFor given to one thread.
+struct ParallelBlock
+{
+    steps::ParallelLoop                * loop;
+    uint                                begin;
+    uint                                end;
+    uint                                thread;
+    int                                 cpu;
+    bool                                failed;
+    std::string                         error;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The CPUs of setParallelCPUs.
+static std::vector<uint>               pParallelCPUs;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Pin the calling thread to cpu, if cpu >= 0.
+static void pinThread(int cpu)
+{
+#ifdef __linux__
+    if (cpu < 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void * runBlock(void * arg)
+{
+    ParallelBlock * b = static_cast<ParallelBlock *>(arg);
+    pinThread(b->cpu);
+    try
+    {
+        for (uint i = b->begin; i < b->end; ++i) b->loop->run(i, b->thread);
+    }
+    catch (steps::Err & e)
+    {
+        b->failed = true;
+        b->error = e.getMsg();
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::parallelFor(steps::ParallelLoop & loop, uint n, uint nthreads)
+{
+    assert(nthreads > 0);
+    if (nthreads > n) nthreads = (n > 0 ? n : 1);
+
+    std::vector<ParallelBlock> blocks(nthreads);
+    for (uint t = 0; t < nthreads; ++t)
+    {
+        blocks[t].loop = &loop;
+        blocks[t].begin = static_cast<uint>(static_cast<unsigned long long>(n) * t / nthreads);
+        blocks[t].end = static_cast<uint>(static_cast<unsigned long long>(n) * (t + 1) / nthreads);
+        blocks[t].thread = t;
+        blocks[t].cpu = -1;
+        if (pParallelCPUs.empty() == false)
+        {
+            blocks[t].cpu = static_cast<int>(pParallelCPUs[t % pParallelCPUs.size()]);
+        }
+        blocks[t].failed = false;
+    }
+
+#ifdef __linux__
+    // Block 0 pins the calling thread, which gets its affinity back.
+    cpu_set_t caller;
+    bool restore = (pParallelCPUs.empty() == false &&
+                    pthread_getaffinity_np(pthread_self(), sizeof(caller), &caller) == 0);
+#endif
+
+    // Block 0 runs in the calling thread, as do the blocks of any thread
+    // that could not be started.
+    std::vector<pthread_t> threads(nthreads);
+    std::vector<bool> started(nthreads, false);
+    for (uint t = 1; t < nthreads; ++t)
+    {
+        started[t] = (pthread_create(&threads[t], 0, runBlock, &blocks[t]) == 0);
+    }
+    runBlock(&blocks[0]);
+    for (uint t = 1; t < nthreads; ++t)
+    {
+        if (started[t] == true) pthread_join(threads[t], 0);
+        else runBlock(&blocks[t]);
+    }
+#ifdef __linux__
+    if (restore == true) pthread_setaffinity_np(pthread_self(), sizeof(caller), &caller);
+#endif
+
+    for (uint t = 0; t < nthreads; ++t)
+    {
+        if (blocks[t].failed == true) throw steps::ArgErr(blocks[t].error);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::setParallelCPUs(std::vector<uint> const & cpus)
+{
+    pParallelCPUs = cpus;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> steps::getParallelCPUs(void)
+{
+    return pParallelCPUs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_PARALLEL_HPP
+#define STEPS_PARALLEL_HPP 1
+
+// Standard library & STL headers.
+#include <algorithm>
+#include <vector>
+
+// STEPS headers.
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The body of a loop run by parallelFor.
+///
+class ParallelLoop
+{
+
+public:
+
+    virtual ~ParallelLoop(void) { }
+
+    /// Do iteration i. thread is the index of the calling thread, in
+    /// [0, nthreads), for bodies that keep per thread state.
+    ///
+    virtual void run(uint i, uint thread) = 0;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Run loop.run(i, t) for all i in [0, n) on nthreads threads. Thread t
+/// does the contiguous block [n*t/nthreads, n*(t+1)/nthreads), so which
+/// thread does which iteration only depends on n and nthreads. With one
+/// thread, or if threads cannot be started, the loop runs in the
+/// calling thread.
+///
+/// A steps::Err thrown by the body stops its thread's block and is
+/// rethrown, as an ArgErr with the same message, once all threads have
+/// finished; if several threads fail, the error of the lowest thread
+/// wins.
+///
+void parallelFor(ParallelLoop & loop, uint n, uint nthreads);
+
+/// Pin thread t of every parallelFor to CPU cpus[t % cpus.size()] while
+/// it runs its block, or stop pinning (empty, the default). A pinned
+/// thread stays on the same CPU, and so the same NUMA node, from one
+/// loop to the next, so the memory it touched first in an earlier loop
+/// is local to it. The calling thread gets its own affinity back after
+/// every loop. Only available on Linux; elsewhere the CPUs are stored
+/// but ignored.
+///
+void setParallelCPUs(std::vector<uint> const & cpus);
+
+std::vector<uint> getParallelCPUs(void);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The loop bodies of parallelSort: sort the blocks [bounds[i],
+/// bounds[i+1]) of the range, or with a width w > 0, merge the sorted
+/// runs of w blocks starting at blocks 2*i*w and (2*i+1)*w.
+///
+template <class Iter, class Less>
+class ParallelSortLoop : public ParallelLoop
+{
+
+public:
+
+    ParallelSortLoop(Iter begin, std::vector<uint> const & bounds, Less less)
+    : pBegin(begin), pBounds(bounds), pLess(less), pWidth(0)
+    { }
+
+    void setWidth(uint w)
+    { pWidth = w; }
+
+    void run(uint i, uint thread)
+    {
+        if (pWidth == 0)
+        {
+            std::sort(pBegin + pBounds[i], pBegin + pBounds[i + 1], pLess);
+            return;
+        }
+        uint nblocks = pBounds.size() - 1;
+        uint lo = i * 2 * pWidth;
+        uint mid = std::min(lo + pWidth, nblocks);
+        uint hi = std::min(lo + (2 * pWidth), nblocks);
+        std::inplace_merge(pBegin + pBounds[lo], pBegin + pBounds[mid],
+                           pBegin + pBounds[hi], pLess);
+    }
+
+private:
+
+    Iter                                pBegin;
+    std::vector<uint> const           & pBounds;
+    Less                                pLess;
+    uint                                pWidth;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Sort [begin, end) by less on nthreads threads: each thread sorts one
+/// block, as parallelFor divides the range, and the sorted blocks are
+/// then merged pairwise, again in parallel, until one is left. If no two
+/// elements are equivalent under less, the result is the same as that of
+/// std::sort whatever the number of threads.
+///
+template <class Iter, class Less>
+void parallelSort(Iter begin, Iter end, Less less, uint nthreads)
+{
+    uint n = end - begin;
+    if (nthreads > n / 2) nthreads = n / 2;
+    if (nthreads <= 1)
+    {
+        std::sort(begin, end, less);
+        return;
+    }
+
+    std::vector<uint> bounds(nthreads + 1);
+    for (uint t = 0; t <= nthreads; ++t)
+    {
+        bounds[t] = static_cast<uint>(static_cast<unsigned long long>(n) * t / nthreads);
+    }
+    ParallelSortLoop<Iter, Less> loop(begin, bounds, less);
+    parallelFor(loop, nthreads, nthreads);
+    for (uint w = 1; w < nthreads; w *= 2)
+    {
+        loop.setWidth(w);
+        parallelFor(loop, (nthreads + (2 * w) - 1) / (2 * w), nthreads);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_PARALLEL_HPP
+
+// END
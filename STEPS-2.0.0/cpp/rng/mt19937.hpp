@@ -83,11 +83,13 @@ START_NAMESPACE(rng)
 
 #define MT_M                                    397
 
-#define MT_MATRIX_A                             0x9908b0dfUL
+#define MT_MATRIX_A                             0x9908b0dfU
 
-#define MT_UPPER_MASK                           0x80000000UL
+#define MT_UPPER_MASK                           0x80000000U
 
-#define MT_LOWER_MASK                           0x7fffffffUL
+#define MT_LOWER_MASK                           0x7fffffffU
+
+#define MT_DEGREE                               19937
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -117,13 +119,24 @@ protected:
     /// \param seed Seed for the generator.
     virtual void concreteInitialize(ulong seed);
 
+    /// Advance the generator by n * 2^128 numbers, by polynomial
+    /// jump-ahead.
+    ///
+    virtual void concreteJump(ulong n);
+
     /// Fills the buffer with random numbers on [0,0xffffffff]-interval.
     ///
     virtual void concreteFillBuffer(void);
 
 private:
 
-    unsigned long               pState[MT_N];
+    /// Regenerate the whole state block.
+    ///
+    void generateState(void);
+
+    /// The state words are stored as 32 bit values so that the state
+    /// update and the tempering of the buffer vectorize.
+    uint                        pState[MT_N];
     int                         pStateInit;
 
 };
@@ -0,0 +1,154 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cassert>
+
+// STEPS headers.
+#include "../common.h"
+#include "rng.hpp"
+#include "philox.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+// STEPS library.
+NAMESPACE_ALIAS(steps::rng, srng);
+USING(srng, Philox4x32);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// One Philox round on the 4 x 32 bit block ctr with key k.
+static inline void philox_round(uint * ctr, uint k0, uint k1)
+{
+    unsigned long long p0 = (unsigned long long)PHILOX_M0 * ctr[0];
+    unsigned long long p1 = (unsigned long long)PHILOX_M1 * ctr[2];
+    uint hi0 = static_cast<uint>(p0 >> 32);
+    uint hi1 = static_cast<uint>(p1 >> 32);
+    uint c1 = ctr[1];
+    ctr[0] = hi1 ^ c1 ^ k0;
+    ctr[1] = static_cast<uint>(p1);
+    ctr[2] = hi0 ^ ctr[3] ^ k1;
+    ctr[3] = static_cast<uint>(p0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Philox4x32::Philox4x32(uint bufsize)
+: RNG(bufsize)
+{
+    pKey[0] = pKey[1] = 0;
+    pCounter[0] = pCounter[1] = pCounter[2] = pCounter[3] = 0;
+    pBlockPos = 4;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Philox4x32::~Philox4x32(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Philox4x32::concreteInitialize(ulong seed)
+{
+    pKey[0] = static_cast<uint>(seed & 0xffffffffUL);
+    // Shift in two steps, ulong may only be 32 bits wide.
+    pKey[1] = static_cast<uint>(((seed >> 16) >> 16) & 0xffffffffUL);
+    pCounter[0] = pCounter[1] = pCounter[2] = pCounter[3] = 0;
+    pBlockPos = 4;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Philox4x32::concreteJump(ulong n)
+{
+    // Add n to the upper 64 bits of the counter; the rest of the block
+    // being generated is dropped.
+    uint lo = static_cast<uint>(n & 0xffffffffUL);
+    uint hi = static_cast<uint>(((n >> 16) >> 16) & 0xffffffffUL);
+    pCounter[2] += lo;
+    pCounter[3] += hi + (pCounter[2] < lo ? 1U : 0U);
+    pBlockPos = 4;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Philox4x32::generateBlock(uint * out)
+{
+    out[0] = pCounter[0];
+    out[1] = pCounter[1];
+    out[2] = pCounter[2];
+    out[3] = pCounter[3];
+
+    uint k0 = pKey[0];
+    uint k1 = pKey[1];
+    philox_round(out, k0, k1);
+    for (uint r = 1; r < PHILOX_ROUNDS; ++r)
+    {
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+        philox_round(out, k0, k1);
+    }
+
+    // 128-bit counter increment.
+    if (++pCounter[0] == 0)
+        if (++pCounter[1] == 0)
+            if (++pCounter[2] == 0)
+                ++pCounter[3];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Philox4x32::concreteFillBuffer(void)
+{
+    // Numbers left over from a block that did not fit in the buffer last
+    // time come first, so that the stream does not depend on the buffer
+    // size.
+    uint * b = rBuffer;
+    while (pBlockPos < 4 && b < rEnd) *(b++) = pBlock[pBlockPos++];
+
+    while (rEnd - b >= 4)
+    {
+        generateBlock(b);
+        b += 4;
+    }
+
+    if (b < rEnd)
+    {
+        generateBlock(pBlock);
+        pBlockPos = 0;
+        while (b < rEnd) *(b++) = pBlock[pBlockPos++];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+srng::RNG * srng::create_philox4x32(uint bufsize)
+{
+    return new Philox4x32(bufsize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
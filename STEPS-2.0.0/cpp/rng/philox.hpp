@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_RNG_PHILOX_HPP
+#define STEPS_RNG_PHILOX_HPP 1
+
+
+// STEPS headers.
+#include "../common.h"
+#include "rng.hpp"
+
+START_NAMESPACE(steps)
+START_NAMESPACE(rng)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Philox4x32-10 counter-based generator, after Salmon, Moraes, Dror and
+// Shaw, "Parallel random numbers: as easy as 1, 2, 3" (SC11) and their
+// Random123 library.
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define PHILOX_M0                               0xD2511F53U
+
+#define PHILOX_M1                               0xCD9E8D57U
+
+#define PHILOX_W0                               0x9E3779B9U
+
+#define PHILOX_W1                               0xBB67AE85U
+
+#define PHILOX_ROUNDS                           10
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Philox4x32-10 random number generator.
+///
+/// Each block of four numbers is a keyed bijection of a 128-bit counter,
+/// so there is no state to advance besides the counter. The seed is the
+/// key: generators initialized with different seeds produce independent
+/// streams, which makes it straightforward to derive one stream per run
+/// or per thread.
+
+class Philox4x32
+: public RNG
+{
+
+public:
+
+    /// Constructor
+    ///
+    /// \param bufsize Size of the buffer.
+    Philox4x32(uint bufsize);
+
+    /// Destructor
+    ///
+    virtual ~Philox4x32(void);
+
+protected:
+
+    /// Set the key to seed and reset the counter.
+    ///
+    /// \param seed Seed for the generator.
+    virtual void concreteInitialize(ulong seed);
+
+    /// Advance the counter by n * 2^64 blocks (n * 2^66 numbers).
+    ///
+    virtual void concreteJump(ulong n);
+
+    /// Fills the buffer with random numbers on [0,0xffffffff]-interval.
+    ///
+    virtual void concreteFillBuffer(void);
+
+private:
+
+    /// Compute the block for the current counter into out and advance
+    /// the counter.
+    ///
+    void generateBlock(uint * out);
+
+    uint                        pKey[2];
+    uint                        pCounter[4];
+
+    /// Last generated block and the position of its first unused number.
+    uint                        pBlock[4];
+    uint                        pBlockPos;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(rng)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_RNG_PHILOX_HPP
+
+// END
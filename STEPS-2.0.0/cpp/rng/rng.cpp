@@ -31,6 +31,7 @@
 // Standard library & STL headers.
 #include <cassert>
 #include <cmath>
+#include <sstream>
 #include <string>
 #include <iostream>
 
@@ -38,6 +39,8 @@
 #include "../common.h"
 #include "../math/tools.hpp"
 #include "rng.hpp"
+#include "../error.hpp"
+#include "../simd.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -56,9 +59,15 @@ RNG::RNG(uint bufsize)
 , rNext(0)
 , rEnd(0)
 , pInitialized(false)
+, pZiggurat(false)
+, pPsn()
 {
     rBuffer = new uint[rSize];
     rNext = rEnd = rBuffer + rSize;
+
+    // JJV changed the initial values of MUPREV and MUOLD.
+    pPsn.muold = -1.0E37;
+    pPsn.muprev = -1.0E37;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -81,16 +90,157 @@ void RNG::initialize(ulong const & seed)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void RNG::initializeStream(ulong const & seed, ulong const & stream)
+{
+    assert(rBuffer != 0);
+    concreteInitialize(seed);
+    concreteJump(stream);
+    pInitialized = true;
+    concreteFillBuffer();
+    rNext = rBuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void RNG::jump(ulong const & n)
+{
+    assert(rBuffer != 0);
+    concreteJump(n);
+    concreteFillBuffer();
+    rNext = rBuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void RNG::concreteJump(ulong n)
+{
+    std::ostringstream os;
+    os << "This random number generator cannot jump ahead.";
+    throw steps::NotImplErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The ziggurat method, after Marsaglia and Tsang, "The ziggurat method for
+// generating random variables", J. Stat. Softw. 5 (2000). The density is
+// covered by layers of equal area v: layer i is the rectangle of width
+// x[i] between heights f(x[i]) and f(x[i + 1]), with x[1] = r where the
+// tail starts and x[0] = v / f(r) the width of the base layer, which
+// holds the tail. One 32 bit number gives the layer (low bits), for the
+// normal the sign (next bit), and the abscissa (upper 24 bits); most
+// draws fall inside x[i + 1] and take nothing else.
+
+#define RNG_ZIG_NRM_N                       128
+#define RNG_ZIG_NRM_R                       3.442619855899
+#define RNG_ZIG_NRM_V                       9.91256303526217e-3
+#define RNG_ZIG_EXP_N                       256
+#define RNG_ZIG_EXP_R                       7.69711747013104972
+#define RNG_ZIG_EXP_V                       3.949659822581572e-3
+
+struct ZigTables
+{
+    double                      nx[RNG_ZIG_NRM_N + 1];
+    double                      nf[RNG_ZIG_NRM_N + 1];
+    double                      ex[RNG_ZIG_EXP_N + 1];
+    double                      ef[RNG_ZIG_EXP_N + 1];
+
+    ZigTables(void)
+    {
+        double r = RNG_ZIG_NRM_R;
+        nx[0] = RNG_ZIG_NRM_V / std::exp(-0.5 * r * r);
+        nx[1] = r;
+        for (uint i = 1; i < RNG_ZIG_NRM_N - 1; ++i)
+        {
+            double f = std::exp(-0.5 * nx[i] * nx[i]);
+            nx[i + 1] = std::sqrt(-2.0 * std::log(RNG_ZIG_NRM_V / nx[i] + f));
+        }
+        nx[RNG_ZIG_NRM_N] = 0.0;
+        for (uint i = 0; i <= RNG_ZIG_NRM_N; ++i)
+        {
+            nf[i] = std::exp(-0.5 * nx[i] * nx[i]);
+        }
+
+        r = RNG_ZIG_EXP_R;
+        ex[0] = RNG_ZIG_EXP_V / std::exp(-r);
+        ex[1] = r;
+        for (uint i = 1; i < RNG_ZIG_EXP_N - 1; ++i)
+        {
+            ex[i + 1] = -std::log(RNG_ZIG_EXP_V / ex[i] + std::exp(-ex[i]));
+        }
+        ex[RNG_ZIG_EXP_N] = 0.0;
+        for (uint i = 0; i <= RNG_ZIG_EXP_N; ++i) ef[i] = std::exp(-ex[i]);
+    }
+};
+
+// Built once at load time, read only afterwards.
+static const ZigTables zig;
+
+////////////////////////////////////////////////////////////////////////////////
+
+double RNG::_zigExp(void)
+{
+    for (;;)
+    {
+        uint j = get();
+        uint i = j & (RNG_ZIG_EXP_N - 1);
+        double x = ((j >> 8) + 0.5) * (1.0 / 16777216.0) * zig.ex[i];
+        if (x < zig.ex[i + 1]) return x;
+        // The tail is memoryless.
+        if (i == 0) return RNG_ZIG_EXP_R - std::log(getUnfEE());
+        double y = zig.ef[i] + getUnfEE() * (zig.ef[i + 1] - zig.ef[i]);
+        if (y < std::exp(-x)) return x;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double RNG::_zigNrm(void)
+{
+    for (;;)
+    {
+        uint j = get();
+        uint i = j & (RNG_ZIG_NRM_N - 1);
+        bool neg = (j & RNG_ZIG_NRM_N) != 0;
+        double x = (j >> 8) * (1.0 / 16777216.0) * zig.nx[i];
+        if (x >= zig.nx[i + 1])
+        {
+            if (i == 0)
+            {
+                // Tail, by Marsaglia's method.
+                double a, b;
+                do
+                {
+                    a = -std::log(getUnfEE()) / RNG_ZIG_NRM_R;
+                    b = -std::log(getUnfEE());
+                } while (b + b < a * a);
+                x = RNG_ZIG_NRM_R + a;
+            }
+            else
+            {
+                double y = zig.nf[i] + getUnfEE() * (zig.nf[i + 1] - zig.nf[i]);
+                if (y >= std::exp(-0.5 * x * x)) continue;
+            }
+        }
+        return neg ? -x : x;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 float RNG::getStdExp(void)
 {
-    static float q[8] =
+    if (pZiggurat == true) return static_cast<float>(_zigExp());
+
+    static const float q[8] =
     {
         0.6931472, 0.9333737, 0.9888778, 0.9984959,
         0.9998293, 0.9999833, 0.9999986, 0.9999999
     };
-    static long i;
-    static float sexpo, a, u, ustar, umin;
-    static float *q1 = q;
+    // Only the table is static: the working variables are local so that
+    // RNG objects can be used concurrently from different threads.
+    long i;
+    float sexpo, a, u, ustar, umin;
+    const float *q1 = q;
     a = 0.0;
     u = getUnfEE();
     goto S30;
@@ -125,19 +275,21 @@ S70:
 
 long RNG::getPsn(float lambda)
 {
-	static float a0 = -0.5;
-	static float a1 = 0.3333333;
-	static float a2 = -0.2500068;
-	static float a3 = 0.2000118;
-	static float a4 = -0.1661269;
-	static float a5 = 0.1421878;
-	static float a6 = -0.1384794;
-	static float a7 = 0.125006;
-
-	// JJV changed the initial values of MUPREV and MUOLD.
-	static float muold = -1.0E37;
-	static float muprev = -1.0E37;
-	static float fact[10] =
+	static const float a0 = -0.5;
+	static const float a1 = 0.3333333;
+	static const float a2 = -0.2500068;
+	static const float a3 = 0.2000118;
+	static const float a4 = -0.1661269;
+	static const float a5 = 0.1421878;
+	static const float a6 = -0.1384794;
+	static const float a7 = 0.125006;
+
+	// The set-up for the last mean is cached in the RNG object rather
+	// than in static variables, so that independent generators can be
+	// used concurrently and do not invalidate each other's tables.
+	float & muold = pPsn.muold;
+	float & muprev = pPsn.muprev;
+	static const float fact[10] =
     {
 		1.0, 1.0,
 		2.0, 6.0,
@@ -147,9 +299,27 @@ long RNG::getPsn(float lambda)
 	};
 
 	// JJV added ll to the list, for Case A.
-	static long ignpoi, j, k, kflag, l, ll, m;
-	static float b1, b2, c, c0, c1, c2, c3, d, del, difmuk, e, fk, fx, fy, g;
-	static float omega, p, p0, px, py, q, s, t, u, v, x, xx, pp[35];
+	long & l = pPsn.l;
+	long & ll = pPsn.ll;
+	long & m = pPsn.m;
+	float & b1 = pPsn.b1;
+	float & b2 = pPsn.b2;
+	float & c = pPsn.c;
+	float & c0 = pPsn.c0;
+	float & c1 = pPsn.c1;
+	float & c2 = pPsn.c2;
+	float & c3 = pPsn.c3;
+	float & d = pPsn.d;
+	float & omega = pPsn.omega;
+	float & p = pPsn.p;
+	float & p0 = pPsn.p0;
+	float & q = pPsn.q;
+	float & s = pPsn.s;
+	float * pp = pPsn.pp;
+
+	long ignpoi = 0, j, k, kflag;
+	float del, difmuk = 0.0, e, fk = 0.0, fx, fy, g;
+	float px, py, t, u, v, x, xx;
     float mu = 1.0 / lambda;
 
     if(mu == muprev) goto S10;
@@ -338,7 +508,9 @@ S180:
 // H(K) ARE ACCORDING TO THE ABOVEMENTIONED ARTICLE
 float RNG::getStdNrm(void)
 {
-	static float a[32] =
+    if (pZiggurat == true) return static_cast<float>(_zigNrm());
+
+	static const float a[32] =
     {
     	0.0000000,      3.917609E-2,    7.841241E-2,    0.11777,
         0.1573107,      0.1970991,      0.2372021,      0.2776904,
@@ -349,7 +521,7 @@ float RNG::getStdNrm(void)
         1.150349,       1.229859,       1.318011,       1.417797,
         1.534121,       1.67594,        1.862732,       2.153875
 	};
-	static float d[31] = {
+	static const float d[31] = {
     	0.0,            0.0,            0.0,            0.0,
         0.0,            0.2636843,      0.2425085,      0.2255674,
         0.2116342,      0.1999243,      0.1899108,      0.1812252,
@@ -359,7 +531,7 @@ float RNG::getStdNrm(void)
     	0.1226109,      0.1201036,      0.1177417,      0.1155119,
         0.1134023,      0.1114027,      0.1095039
 	};
-	static float t[31] = {
+	static const float t[31] = {
     	7.673828E-4,    2.30687E-3,     3.860618E-3,    5.438454E-3,
         7.0507E-3,      8.708396E-3,    1.042357E-2,    1.220953E-2,
         1.408125E-2,    1.605579E-2,    1.81529E-2,     2.039573E-2,
@@ -369,7 +541,7 @@ float RNG::getStdNrm(void)
     	9.462444E-2,    0.1123001,      0.136498,       0.1716886,
         0.2276241,      0.330498,       0.5847031
 	};
-	static float h[31] = {
+	static const float h[31] = {
     	3.920617E-2,    3.932705E-2,    3.951E-2,        3.975703E-2,
         4.007093E-2,    4.045533E-2,    4.091481E-2,     4.145507E-2,
         4.208311E-2,    4.280748E-2,    4.363863E-2,     4.458932E-2,
@@ -379,8 +551,8 @@ float RNG::getStdNrm(void)
     	8.781922E-2,    9.930398E-2,    0.11556,         0.1404344,
         0.1836142,      0.2790016,      0.7010474
 	};
-	static long i;
-	static float snorm, u, s, ustar, aa, w, y, tt;
+	long i;
+	float snorm, u, s, ustar, aa, w, y, tt;
     u = getUnfEE();
     s = 0.0;
     if(u > 0.5) s = 1.0;
@@ -457,9 +629,138 @@ S160:
 
 double RNG::getExp(double lambda)
 {
+     if (pZiggurat == true) return _zigExp() / lambda;
      return (1.0 / lambda) * (double)getStdExp();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+uint RNG::getBinom(uint n, double p)
+{
+    if (n == 0 || p <= 0.0) return 0;
+    if (p >= 1.0) return n;
+    if (p > 0.5) return n - getBinom(n, 1.0 - p);
+
+    double mean = n * p;
+    if (mean < RNG_BINOM_INV_MAX)
+    {
+        // Sequential search from k = 0; q^n does not underflow as
+        // n * p is small and p <= 0.5.
+        double q = 1.0 - p;
+        double r = p / q;
+        double pk = std::pow(q, static_cast<double>(n));
+        double u = getUnfEE();
+        uint k = 0;
+        while (u > pk && k < n)
+        {
+            u -= pk;
+            pk *= r * (n - k) / (k + 1);
+            ++k;
+        }
+        return k;
+    }
+
+    double x = std::floor(mean + std::sqrt(mean * (1.0 - p)) * getStdNrm() + 0.5);
+    if (x < 0.0) return 0;
+    if (x > n) return n;
+    return static_cast<uint>(x);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double RNG::getGamma(double k)
+{
+    assert(k > 0.0);
+    // Shapes below 1 are boosted: G(k) = G(k + 1) * U^(1/k).
+    if (k < 1.0) return getGamma(k + 1.0) * std::pow(getUnfEE(), 1.0 / k);
+
+    double d = k - 1.0 / 3.0;
+    double c = 1.0 / std::sqrt(9.0 * d);
+    while (true)
+    {
+        double x = getStdNrm();
+        double v = 1.0 + c * x;
+        if (v <= 0.0) continue;
+        v = v * v * v;
+        double u = getUnfEE();
+        double x2 = x * x;
+        if (u < 1.0 - 0.0331 * x2 * x2) return d * v;
+        if (std::log(u) < 0.5 * x2 + d * (1.0 - v + std::log(v))) return d * v;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The conversions of fillUnfIE and fillUnfEE, of n random words r.
+static STEPS_SIMD_INLINE void unfIE(uint const * r, double * out, uint n)
+{
+    for (uint i = 0; i < n; ++i)
+    {
+        // Divided by 2^32.
+        out[i] = r[i] * (1.0/4294967296.0);
+    }
+}
+
+STEPS_SIMD_CLONES(unfIE, (uint const * r, double * out, uint n), (r, out, n))
+
+static STEPS_SIMD_INLINE void unfEE(uint const * r, double * out, uint n)
+{
+    for (uint i = 0; i < n; ++i)
+    {
+        // Divided by 2^32.
+        out[i] = (((double)r[i]) + 0.5) * (1.0/4294967296.0);
+    }
+}
+
+STEPS_SIMD_CLONES(unfEE, (uint const * r, double * out, uint n), (r, out, n))
+
+////////////////////////////////////////////////////////////////////////////////
+
+void RNG::fillUnfIE(double * out, uint n)
+{
+    void (*conv)(uint const *, double *, uint) = STEPS_SIMD_PICK(unfIE);
+    while (n != 0)
+    {
+        if (rNext == rEnd) { concreteFillBuffer(); rNext = rBuffer; }
+        uint m = rEnd - rNext;
+        if (m > n) m = n;
+        conv(rNext, out, m);
+        rNext += m;
+        out += m;
+        n -= m;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void RNG::fillUnfEE(double * out, uint n)
+{
+    void (*conv)(uint const *, double *, uint) = STEPS_SIMD_PICK(unfEE);
+    while (n != 0)
+    {
+        if (rNext == rEnd) { concreteFillBuffer(); rNext = rBuffer; }
+        uint m = rEnd - rNext;
+        if (m > n) m = n;
+        conv(rNext, out, m);
+        rNext += m;
+        out += m;
+        n -= m;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void RNG::fillExp(double * out, uint n, double lambda)
+{
+    // Uniforms on the open interval, so the log is always finite.
+    fillUnfEE(out, n);
+    double scale = -1.0 / lambda;
+    for (uint i = 0; i < n; ++i)
+    {
+        out[i] = scale * std::log(out[i]);
+    }
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -42,6 +42,11 @@
 START_NAMESPACE(steps)
 START_NAMESPACE(rng)
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Largest mean for which getBinom samples by inversion.
+#define RNG_BINOM_INV_MAX   30.0
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Base class of random number generator.
 ///
@@ -64,6 +69,25 @@ public:
     /// \param seed Seed for the generator.
     void initialize(ulong const & seed);
 
+    /// Initialize the generator to stream number stream of seed. Stream 0
+    /// is the sequence initialize(seed) gives and stream k starts k stream
+    /// lengths after it, so the streams of one seed do not overlap and any
+    /// of them is set up directly, e.g. one per replicate or per thread.
+    /// This is not where jump() takes a generator set to stream k - 1:
+    /// jump() counts from the numbers already drawn into the buffer, so it
+    /// lands a buffer size further on.
+    ///
+    /// \param seed Master seed of the streams.
+    /// \param stream Index of the stream.
+    void initializeStream(ulong const & seed, ulong const & stream);
+
+    /// Move the generator n stream lengths ahead of the numbers it has
+    /// generated, discarding the ones left in the buffer. A stream is
+    /// 2^128 numbers long for MT19937 and 2^66 for Philox4x32.
+    ///
+    /// \param n Number of streams to jump.
+    void jump(ulong const & n = 1);
+
     /// Return the next random int in the buffer of the generator.
     ///
     inline uint get(void)
@@ -104,6 +128,18 @@ public:
         return(a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
     }
 
+    /// Choose the methods behind getStdExp, getExp and getStdNrm, and so
+    /// behind getPsn and the normal approximation of getBinom: the
+    /// ziggurat method of Marsaglia and Tsang (2000), or the algorithms
+    /// of Ahrens and Dieter, the default, which reproduce the numbers of
+    /// earlier versions.
+    ///
+    void setZiggurat(bool on)
+    { pZiggurat = on; }
+
+    bool getZiggurat(void) const
+    { return pZiggurat; }
+
     /// Get a standard exponentially distributed number.
     float getStdExp(void);
 
@@ -119,6 +155,40 @@ public:
     ///
     float getStdNrm(void);
 
+    /// Get a binomially distributed number of successes in n trials with
+    /// success probability p. Exact (by inversion) when the mean of the
+    /// smaller tail is below RNG_BINOM_INV_MAX, otherwise drawn from the
+    /// normal approximation.
+    ///
+    uint getBinom(uint n, double p);
+
+    /// Get a gamma distributed number with shape k > 0 and unit scale,
+    /// by the method of Marsaglia and Tsang (2000).
+    ///
+    double getGamma(double k);
+
+    ////////////////////////////////////////////////////////////////////////
+    // BATCHED SAMPLING
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Fill out[0..n-1] with uniform random numbers on [0,1), the same
+    /// numbers n calls to getUnfIE would return.
+    ///
+    void fillUnfIE(double * out, uint n);
+
+    /// Fill out[0..n-1] with uniform random numbers on (0,1), the same
+    /// numbers n calls to getUnfEE would return.
+    ///
+    void fillUnfEE(double * out, uint n);
+
+    /// Fill out[0..n-1] with exponentially distributed numbers with rate
+    /// lambda (mean 1/lambda, as getExp), by inversion of one uniform
+    /// number each. This consumes exactly n numbers from the buffer and
+    /// the log is applied in a separate loop the compiler can vectorize,
+    /// but the values differ from those n calls to getExp would give.
+    ///
+    void fillExp(double * out, uint n, double lambda);
+
 protected:
 
     uint                      * rBuffer;
@@ -129,14 +199,43 @@ protected:
 
     virtual void concreteInitialize(ulong seed) = 0;
 
+    /// Advance the generator by n stream lengths. Throws NotImplErr unless
+    /// the generator supports jumping ahead.
+    ///
+    virtual void concreteJump(ulong n);
+
     /// Fills the buffer with random numbers on [0,0xffffffff]-interval.
     ///
     virtual void concreteFillBuffer(void) = 0;
 
 private:
 
+    /// Ziggurat samplers of the standard exponential and normal
+    /// distributions.
+    ///
+    double _zigExp(void);
+    double _zigNrm(void);
+
     bool                        pInitialized;
 
+    bool                        pZiggurat;
+
+    /// Parameters and cumulative probability table that getPsn caches
+    /// for the last mean it was called with.
+    struct PsnCache
+    {
+        float                   muold;
+        float                   muprev;
+        long                    l;
+        long                    ll;
+        long                    m;
+        float                   b1, b2, c, c0, c1, c2, c3, d, omega;
+        float                   p, p0, q, s;
+        float                   pp[35];
+    };
+
+    PsnCache                    pPsn;
+
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -145,6 +244,11 @@ private:
 /// \param buffsize Size of buffer.
 RNG * create_mt19937(uint bufsize);
 
+/// Create a Philox4x32-10 random number generator and return as RNG object.
+///
+/// \param buffsize Size of buffer.
+RNG * create_philox4x32(uint bufsize);
+
 /// Create a random number generator with name rng_name and return as RNG object.
 ///
 /// \param rng_name Name of the random number generator.
@@ -0,0 +1,612 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "../math/constants.hpp"
+#include "mathml.hpp"
+#include "xml.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+USING_NAMESPACE(std);
+USING_NAMESPACE(steps::sbml);
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// Instructions. Binary operators pop b, then a, and push a op b.
+enum
+{
+    OP_CONST = 0,   // push val
+    OP_VAR,         // push vars[arg]
+    OP_NEG,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_POW,
+    OP_MIN,
+    OP_MAX,
+    OP_EQ,
+    OP_NEQ,
+    OP_LT,
+    OP_GT,
+    OP_LEQ,
+    OP_GEQ,
+    OP_AND,
+    OP_OR,
+    OP_XOR,
+    OP_NOT,
+    OP_FUNC,        // replace top with func[arg](top)
+    OP_JZ,          // pop; jump to arg if zero
+    OP_JMP          // jump to arg
+};
+
+// Stack effect of each instruction.
+const int OP_DEPTH[] =
+{
+    1, 1, 0, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, 0,
+    0, -1, 0
+};
+
+typedef double (*Func1)(double);
+
+double f_factorial(double x)
+{
+    double r = 1.0;
+    for (double i = 2.0; i <= x; i += 1.0) r *= i;
+    return r;
+}
+double f_sec(double x) { return 1.0 / cos(x); }
+double f_csc(double x) { return 1.0 / sin(x); }
+double f_cot(double x) { return 1.0 / tan(x); }
+double f_sech(double x) { return 1.0 / cosh(x); }
+double f_csch(double x) { return 1.0 / sinh(x); }
+double f_coth(double x) { return 1.0 / tanh(x); }
+double f_arcsec(double x) { return acos(1.0 / x); }
+double f_arccsc(double x) { return asin(1.0 / x); }
+double f_arccot(double x) { return atan(1.0 / x); }
+double f_arcsinh(double x) { return log(x + sqrt(x * x + 1.0)); }
+double f_arccosh(double x) { return log(x + sqrt(x * x - 1.0)); }
+double f_arctanh(double x) { return 0.5 * log((1.0 + x) / (1.0 - x)); }
+double f_arcsech(double x) { return f_arccosh(1.0 / x); }
+double f_arccsch(double x) { return f_arcsinh(1.0 / x); }
+double f_arccoth(double x) { return f_arctanh(1.0 / x); }
+double f_abs(double x) { return fabs(x); }
+double f_exp(double x) { return exp(x); }
+double f_ln(double x) { return log(x); }
+double f_floor(double x) { return floor(x); }
+double f_ceil(double x) { return ceil(x); }
+double f_sin(double x) { return sin(x); }
+double f_cos(double x) { return cos(x); }
+double f_tan(double x) { return tan(x); }
+double f_sinh(double x) { return sinh(x); }
+double f_cosh(double x) { return cosh(x); }
+double f_tanh(double x) { return tanh(x); }
+double f_asin(double x) { return asin(x); }
+double f_acos(double x) { return acos(x); }
+double f_atan(double x) { return atan(x); }
+
+struct FuncEntry
+{
+    char const *                        name;
+    Func1                               func;
+};
+
+const FuncEntry FUNCS[] =
+{
+    { "abs", f_abs }, { "exp", f_exp }, { "ln", f_ln },
+    { "floor", f_floor }, { "ceiling", f_ceil }, { "factorial", f_factorial },
+    { "sin", f_sin }, { "cos", f_cos }, { "tan", f_tan },
+    { "sec", f_sec }, { "csc", f_csc }, { "cot", f_cot },
+    { "sinh", f_sinh }, { "cosh", f_cosh }, { "tanh", f_tanh },
+    { "sech", f_sech }, { "csch", f_csch }, { "coth", f_coth },
+    { "arcsin", f_asin }, { "arccos", f_acos }, { "arctan", f_atan },
+    { "arcsec", f_arcsec }, { "arccsc", f_arccsc }, { "arccot", f_arccot },
+    { "arcsinh", f_arcsinh }, { "arccosh", f_arccosh },
+    { "arctanh", f_arctanh }, { "arcsech", f_arcsech },
+    { "arccsch", f_arccsch }, { "arccoth", f_arccoth }
+};
+
+const uint NFUNCS = sizeof(FUNCS) / sizeof(FuncEntry);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Children of an apply, csymbol or piece element that are operands, that
+// is, without qualifiers such as degree, logbase and bvar.
+vector<XMLNode const *> operands(XMLNode const * node, uint first)
+{
+    vector<XMLNode const *> res;
+    vector<XMLNode *> const & ch = node->children();
+    for (uint i = first; i < ch.size(); ++i)
+    {
+        string const & n = ch[i]->name();
+        if (n == "degree" || n == "logbase" || n == "bvar") continue;
+        res.push_back(ch[i]);
+    }
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double parseNumber(string const & s, XMLNode const * node)
+{
+    char * end = 0;
+    double v = strtod(s.c_str(), &end);
+    if (end == s.c_str())
+    {
+        ostringstream os;
+        os << "MathML number '" << node->text() << "' cannot be read.";
+        throw steps::ArgErr(os.str());
+    }
+    return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void notImpl(string const & what)
+{
+    ostringstream os;
+    os << "MathML " << what << " is not supported.";
+    throw steps::NotImplErr(os.str());
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MathExpr::MathExpr(void)
+: pCode()
+, pVars()
+, pMaxStack(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool MathExpr::reads(uint var) const
+{
+    return binary_search(pVars.begin(), pVars.end(), var);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double MathExpr::eval(vector<double> const & vars) const
+{
+    double fixed[32];
+    vector<double> big;
+    double * stack = fixed;
+    if (pMaxStack > 32)
+    {
+        big.resize(pMaxStack);
+        stack = &big[0];
+    }
+
+    int top = -1;
+    uint ncode = pCode.size();
+    for (uint pc = 0; pc < ncode; ++pc)
+    {
+        Instr const & in = pCode[pc];
+        switch (in.op)
+        {
+        case OP_CONST: stack[++top] = in.val; break;
+        case OP_VAR: stack[++top] = vars[in.arg]; break;
+        case OP_NEG: stack[top] = -stack[top]; break;
+        case OP_ADD: --top; stack[top] += stack[top + 1]; break;
+        case OP_SUB: --top; stack[top] -= stack[top + 1]; break;
+        case OP_MUL: --top; stack[top] *= stack[top + 1]; break;
+        case OP_DIV: --top; stack[top] /= stack[top + 1]; break;
+        case OP_POW: --top; stack[top] = pow(stack[top], stack[top + 1]); break;
+        case OP_MIN: --top; stack[top] = min(stack[top], stack[top + 1]); break;
+        case OP_MAX: --top; stack[top] = max(stack[top], stack[top + 1]); break;
+        case OP_EQ: --top; stack[top] = (stack[top] == stack[top + 1]); break;
+        case OP_NEQ: --top; stack[top] = (stack[top] != stack[top + 1]); break;
+        case OP_LT: --top; stack[top] = (stack[top] < stack[top + 1]); break;
+        case OP_GT: --top; stack[top] = (stack[top] > stack[top + 1]); break;
+        case OP_LEQ: --top; stack[top] = (stack[top] <= stack[top + 1]); break;
+        case OP_GEQ: --top; stack[top] = (stack[top] >= stack[top + 1]); break;
+        case OP_AND: --top; stack[top] = (stack[top] != 0.0 && stack[top + 1] != 0.0); break;
+        case OP_OR: --top; stack[top] = (stack[top] != 0.0 || stack[top + 1] != 0.0); break;
+        case OP_XOR: --top; stack[top] = ((stack[top] != 0.0) != (stack[top + 1] != 0.0)); break;
+        case OP_NOT: stack[top] = (stack[top] == 0.0); break;
+        case OP_FUNC: stack[top] = FUNCS[in.arg].func(stack[top]); break;
+        case OP_JZ: if (stack[top--] == 0.0) pc = in.arg - 1; break;
+        case OP_JMP: pc = in.arg - 1; break;
+        default: assert(false);
+        }
+    }
+    assert(top == 0);
+    return stack[0];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Arguments of the function definitions being expanded: each bound
+/// variable maps to the argument element, compiled in the caller's scope.
+struct MathCompiler::Scope
+{
+    map<string, XMLNode const *>                args;
+    Scope const *                               outer;
+    map<string, uint> const *                   locals;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+MathCompiler::MathCompiler(map<string, uint> const & vars,
+                           map<string, XMLNode const *> const & funcs,
+                           uint timevar)
+: rVars(vars)
+, rFuncs(funcs)
+, pTimeVar(timevar)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MathExpr MathCompiler::compile(XMLNode const * math,
+                               map<string, uint> const * locals) const
+{
+    assert(math != 0);
+    if (math->name() == "math")
+    {
+        if (math->children().size() != 1)
+        {
+            throw steps::ArgErr("A MathML <math> element must hold one expression.");
+        }
+        math = math->children()[0];
+    }
+
+    Scope scope;
+    scope.outer = 0;
+    scope.locals = locals;
+    MathExpr expr;
+    uint depth = 0;
+    _compile(math, &scope, expr, depth);
+    assert(depth == 1);
+
+    sort(expr.pVars.begin(), expr.pVars.end());
+    expr.pVars.erase(unique(expr.pVars.begin(), expr.pVars.end()), expr.pVars.end());
+    return expr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+pair<XMLNode const *, XMLNode const *> MathCompiler::splitMinus(XMLNode const * math)
+{
+    if (math->name() == "math" && math->children().size() == 1)
+    {
+        math = math->children()[0];
+    }
+    if (math->name() == "apply" && math->children().size() == 3
+        && math->children()[0]->name() == "minus")
+    {
+        return make_pair(math->children()[1], math->children()[2]);
+    }
+    return pair<XMLNode const *, XMLNode const *>(0, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void MathCompiler::_emit(MathExpr & expr, uint & depth, uint op, uint arg,
+                         double val) const
+{
+    MathExpr::Instr in;
+    in.op = op;
+    in.arg = arg;
+    in.val = val;
+    expr.pCode.push_back(in);
+    depth += OP_DEPTH[op];
+    if (depth > expr.pMaxStack) expr.pMaxStack = depth;
+    if (op == OP_VAR) expr.pVars.push_back(arg);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void MathCompiler::_compile(XMLNode const * node, Scope const * scope,
+                            MathExpr & expr, uint & depth) const
+{
+    string const & name = node->name();
+
+    if (name == "cn")
+    {
+        string type = node->attr("type", "real");
+        string text = node->text();
+        double v;
+        if (type == "e-notation" || type == "rational")
+        {
+            istringstream is(text);
+            string a, b;
+            is >> a >> b;
+            double x = parseNumber(a, node), y = parseNumber(b, node);
+            v = (type == "rational" ? x / y : x * pow(10.0, y));
+        }
+        else v = parseNumber(text, node);
+        _emit(expr, depth, OP_CONST, 0, v);
+    }
+    else if (name == "ci")
+    {
+        string id = node->text();
+        for (Scope const * s = scope; s != 0; s = s->outer)
+        {
+            map<string, XMLNode const *>::const_iterator a = s->args.find(id);
+            if (a != s->args.end())
+            {
+                _compile(a->second, s->outer, expr, depth);
+                return;
+            }
+            // Function bodies only see their own arguments.
+            if (!s->args.empty()) break;
+        }
+        if (scope->locals != 0)
+        {
+            map<string, uint>::const_iterator l = scope->locals->find(id);
+            if (l != scope->locals->end())
+            {
+                _emit(expr, depth, OP_VAR, l->second);
+                return;
+            }
+        }
+        map<string, uint>::const_iterator v = rVars.find(id);
+        if (v == rVars.end())
+        {
+            ostringstream os;
+            os << "Unknown identifier '" << id << "' in MathML expression.";
+            throw steps::ArgErr(os.str());
+        }
+        _emit(expr, depth, OP_VAR, v->second);
+    }
+    else if (name == "csymbol")
+    {
+        string url = node->attr("definitionURL");
+        if (url.find("/time") != string::npos) _emit(expr, depth, OP_VAR, pTimeVar);
+        else if (url.find("/avogadro") != string::npos)
+        {
+            _emit(expr, depth, OP_CONST, 0, steps::math::AVOGADRO);
+        }
+        else notImpl("symbol '" + url + "'");
+    }
+    else if (name == "true") _emit(expr, depth, OP_CONST, 0, 1.0);
+    else if (name == "false") _emit(expr, depth, OP_CONST, 0, 0.0);
+    else if (name == "pi") _emit(expr, depth, OP_CONST, 0, steps::math::PI);
+    else if (name == "exponentiale") _emit(expr, depth, OP_CONST, 0, exp(1.0));
+    else if (name == "infinity")
+    {
+        _emit(expr, depth, OP_CONST, 0, numeric_limits<double>::infinity());
+    }
+    else if (name == "notanumber")
+    {
+        _emit(expr, depth, OP_CONST, 0, numeric_limits<double>::quiet_NaN());
+    }
+    else if (name == "apply") _apply(node, scope, expr, depth);
+    else if (name == "piecewise")
+    {
+        // cond_1 JZ next_1 value_1 JMP end; next_1: cond_2 ... otherwise end:
+        vector<uint> jmps;
+        uint base = depth;
+        XMLNode const * otherwise = 0;
+        vector<XMLNode *> const & ch = node->children();
+        for (uint i = 0; i < ch.size(); ++i)
+        {
+            if (ch[i]->name() == "otherwise")
+            {
+                otherwise = ch[i];
+                continue;
+            }
+            if (ch[i]->name() != "piece" || ch[i]->children().size() != 2)
+            {
+                throw steps::ArgErr("Malformed MathML <piecewise> element.");
+            }
+            _compile(ch[i]->children()[1], scope, expr, depth);
+            uint jz = expr.pCode.size();
+            _emit(expr, depth, OP_JZ);
+            _compile(ch[i]->children()[0], scope, expr, depth);
+            jmps.push_back(expr.pCode.size());
+            _emit(expr, depth, OP_JMP);
+            expr.pCode[jz].arg = expr.pCode.size();
+            depth = base;
+        }
+        if (otherwise != 0 && otherwise->children().size() == 1)
+        {
+            _compile(otherwise->children()[0], scope, expr, depth);
+        }
+        else _emit(expr, depth, OP_CONST, 0, numeric_limits<double>::quiet_NaN());
+        for (uint i = 0; i < jmps.size(); ++i) expr.pCode[jmps[i]].arg = expr.pCode.size();
+    }
+    else if (name == "semantics" && !node->children().empty())
+    {
+        _compile(node->children()[0], scope, expr, depth);
+    }
+    else notImpl("element <" + name + ">");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void MathCompiler::_apply(XMLNode const * node, Scope const * scope,
+                          MathExpr & expr, uint & depth) const
+{
+    vector<XMLNode *> const & ch = node->children();
+    if (ch.empty()) throw steps::ArgErr("Empty MathML <apply> element.");
+    XMLNode const * head = ch[0];
+    string op = head->name();
+    vector<XMLNode const *> args = operands(node, 1);
+    uint nargs = args.size();
+
+    // A call of a function definition.
+    if (op == "ci")
+    {
+        map<string, XMLNode const *>::const_iterator f = rFuncs.find(head->text());
+        if (f == rFuncs.end())
+        {
+            ostringstream os;
+            os << "Unknown function '" << head->text() << "' in MathML expression.";
+            throw steps::ArgErr(os.str());
+        }
+        Scope inner;
+        inner.outer = scope;
+        inner.locals = 0;
+        XMLNode const * body = 0;
+        uint a = 0;
+        vector<XMLNode *> const & lch = f->second->children();
+        for (uint i = 0; i < lch.size(); ++i)
+        {
+            if (lch[i]->name() == "bvar" && lch[i]->child("ci") != 0)
+            {
+                if (a >= nargs) break;
+                inner.args[lch[i]->child("ci")->text()] = args[a++];
+            }
+            else body = lch[i];
+        }
+        if (a != nargs || body == 0)
+        {
+            ostringstream os;
+            os << "Function '" << head->text() << "' called with the wrong ";
+            os << "number of arguments.";
+            throw steps::ArgErr(os.str());
+        }
+        _compile(body, &inner, expr, depth);
+        return;
+    }
+    if (op == "csymbol")
+    {
+        notImpl("function '" + head->attr("definitionURL") + "'");
+    }
+
+    // N-ary operators.
+    uint binop = 0;
+    if (op == "plus") binop = OP_ADD;
+    else if (op == "times") binop = OP_MUL;
+    else if (op == "and") binop = OP_AND;
+    else if (op == "or") binop = OP_OR;
+    else if (op == "xor") binop = OP_XOR;
+    else if (op == "min") binop = OP_MIN;
+    else if (op == "max") binop = OP_MAX;
+    if (binop != 0)
+    {
+        if (nargs == 0)
+        {
+            double unit = (op == "times" || op == "and" ? 1.0 : 0.0);
+            _emit(expr, depth, OP_CONST, 0, unit);
+            return;
+        }
+        _compile(args[0], scope, expr, depth);
+        for (uint i = 1; i < nargs; ++i)
+        {
+            _compile(args[i], scope, expr, depth);
+            _emit(expr, depth, binop);
+        }
+        return;
+    }
+
+    if (op == "minus")
+    {
+        if (nargs == 1)
+        {
+            _compile(args[0], scope, expr, depth);
+            _emit(expr, depth, OP_NEG);
+            return;
+        }
+        binop = OP_SUB;
+    }
+    else if (op == "divide") binop = OP_DIV;
+    else if (op == "power") binop = OP_POW;
+    else if (op == "eq") binop = OP_EQ;
+    else if (op == "neq") binop = OP_NEQ;
+    else if (op == "lt") binop = OP_LT;
+    else if (op == "gt") binop = OP_GT;
+    else if (op == "leq") binop = OP_LEQ;
+    else if (op == "geq") binop = OP_GEQ;
+    if (binop != 0)
+    {
+        if (nargs != 2) notImpl("<" + op + "> with other than two operands");
+        _compile(args[0], scope, expr, depth);
+        _compile(args[1], scope, expr, depth);
+        _emit(expr, depth, binop);
+        return;
+    }
+
+    if (nargs != 1) notImpl("<" + op + "> with other than one operand");
+
+    if (op == "not")
+    {
+        _compile(args[0], scope, expr, depth);
+        _emit(expr, depth, OP_NOT);
+    }
+    else if (op == "root")
+    {
+        // x^(1/degree), degree 2 by default.
+        _compile(args[0], scope, expr, depth);
+        _emit(expr, depth, OP_CONST, 0, 1.0);
+        XMLNode const * deg = node->child("degree");
+        if (deg != 0 && deg->children().size() == 1)
+        {
+            _compile(deg->children()[0], scope, expr, depth);
+        }
+        else _emit(expr, depth, OP_CONST, 0, 2.0);
+        _emit(expr, depth, OP_DIV);
+        _emit(expr, depth, OP_POW);
+    }
+    else if (op == "log")
+    {
+        // ln(x) / ln(base), base 10 by default.
+        uint ln = 0;
+        while (string(FUNCS[ln].name) != "ln") ++ln;
+        _compile(args[0], scope, expr, depth);
+        _emit(expr, depth, OP_FUNC, ln);
+        XMLNode const * base = node->child("logbase");
+        if (base != 0 && base->children().size() == 1)
+        {
+            _compile(base->children()[0], scope, expr, depth);
+        }
+        else _emit(expr, depth, OP_CONST, 0, 10.0);
+        _emit(expr, depth, OP_FUNC, ln);
+        _emit(expr, depth, OP_DIV);
+    }
+    else
+    {
+        uint f = 0;
+        while (f < NFUNCS && op != FUNCS[f].name) ++f;
+        if (f == NFUNCS) notImpl("operator <" + op + ">");
+        _compile(args[0], scope, expr, depth);
+        _emit(expr, depth, OP_FUNC, f);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SBML_MATHML_HPP
+#define STEPS_SBML_MATHML_HPP 1
+
+
+// STL headers.
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(sbml)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Forward declarations.
+class XMLNode;
+class MathCompiler;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// A MathML expression compiled to a program for a small stack machine.
+///
+/// Identifiers are resolved to slots of a variable vector when the
+/// expression is compiled, and function definitions are expanded in
+/// place, so evaluation is a single pass over a flat array with no lookups
+/// and no allocation. Evaluation does not change the expression, so one
+/// expression can be evaluated by several threads.
+///
+class MathExpr
+{
+
+public:
+
+    MathExpr(void);
+
+    /// Return true if nothing was compiled into the expression.
+    bool empty(void) const
+    { return pCode.empty(); }
+
+    /// Evaluate the expression with variable slot i holding vars[i].
+    double eval(std::vector<double> const & vars) const;
+
+    /// Return the sorted slots the expression reads.
+    std::vector<uint> const & vars(void) const
+    { return pVars; }
+
+    /// Return true if the expression reads slot var.
+    bool reads(uint var) const;
+
+private:
+
+    friend class MathCompiler;
+
+    struct Instr
+    {
+        uint                                op;
+        uint                                arg;
+        double                              val;
+    };
+
+    std::vector<Instr>                      pCode;
+    std::vector<uint>                       pVars;
+    uint                                    pMaxStack;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Compiles MathML elements to MathExpr objects.
+///
+/// Supported are numbers (all cn types), identifiers, the time and
+/// avogadro symbols, the MathML constants, arithmetic, power and root,
+/// exponentials and logarithms, rounding, trigonometric and hyperbolic
+/// functions and their inverses, relations, logic, min and max, piecewise
+/// and calls of SBML function definitions. Anything else, notably the
+/// delay symbol, throws steps::NotImplErr; an unknown identifier throws
+/// steps::ArgErr.
+///
+class MathCompiler
+{
+
+public:
+
+    /// \param vars Variable slot of each identifier.
+    /// \param funcs Lambda element of each function definition.
+    /// \param timevar Slot of the simulation time.
+    MathCompiler(std::map<std::string, uint> const & vars,
+                 std::map<std::string, XMLNode const *> const & funcs,
+                 uint timevar);
+
+    /// Compile a math element (or its only child).
+    ///
+    /// \param math The element.
+    /// \param locals Slots of identifiers that shadow vars, such as the
+    ///        local parameters of a kinetic law.
+    MathExpr compile(XMLNode const * math,
+                     std::map<std::string, uint> const * locals = 0) const;
+
+    /// Return the operands of math if it is a binary minus, and 0 and 0
+    /// otherwise.
+    static std::pair<XMLNode const *, XMLNode const *>
+        splitMinus(XMLNode const * math);
+
+private:
+
+    struct Scope;
+
+    void _compile(XMLNode const * node, Scope const * scope,
+                  MathExpr & expr, uint & depth) const;
+    void _apply(XMLNode const * node, Scope const * scope,
+                MathExpr & expr, uint & depth) const;
+    void _emit(MathExpr & expr, uint & depth, uint op, uint arg = 0,
+               double val = 0.0) const;
+
+    std::map<std::string, uint> const &             rVars;
+    std::map<std::string, XMLNode const *> const &  rFuncs;
+    uint                                            pTimeVar;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(sbml)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SBML_MATHML_HPP
+
+// END
@@ -0,0 +1,1048 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "../math/constants.hpp"
+#include "../model/model.hpp"
+#include "../model/spec.hpp"
+#include "../model/volsys.hpp"
+#include "../model/surfsys.hpp"
+#include "../model/reac.hpp"
+#include "../model/sreac.hpp"
+#include "../geom/geom.hpp"
+#include "../geom/comp.hpp"
+#include "../geom/patch.hpp"
+#include "../solver/api.hpp"
+#include "sbml.hpp"
+#include "mathml.hpp"
+#include "xml.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+USING_NAMESPACE(std);
+USING_NAMESPACE(steps::sbml);
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// Level 1 names things with a name attribute, later levels with an id.
+string sbmlID(XMLNode const * node)
+{
+    return node->hasAttr("id") ? node->attr("id") : node->attr("name");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void notImpl(string const & what)
+{
+    ostringstream os;
+    os << what << " Use steps.utilities.sbml.Interface for this model.";
+    throw steps::NotImplErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Integer stoichiometry of a species reference.
+int stoichiometry(XMLNode const * ref, MathCompiler const & mc,
+                  vector<double> const & vars, string const & reac)
+{
+    double sto = ref->numAttr("stoichiometry", 1.0);
+    XMLNode const * stomath = ref->child("stoichiometryMath");
+    if (stomath != 0 && stomath->child("math") != 0)
+    {
+        sto = mc.compile(stomath->child("math")).eval(vars);
+    }
+    if (sto != sto || sto < 0.0 || fabs(sto - floor(sto + 0.5)) > 1.0e-3)
+    {
+        ostringstream os;
+        os << "Reaction '" << reac << "' has stoichiometry " << sto << ".";
+        notImpl(os.str());
+    }
+    return int(floor(sto + 0.5));
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Interface::Interface(string const & filename, double timeunits_def,
+                     double volunits_def, double subsunits_def,
+                     double volume_def, double area_def, bool strict_mode)
+: pModel(0)
+, pGeom(0)
+, pTimeUnits(1.0)
+, pVolUnits(1.0e-3)
+, pAreaUnits(1.0)
+, pSubsUnits(1.0)
+, pExtentUnits(1.0)
+, pUnitDefs()
+, pFuncDefs()
+, pVarIdcs()
+, pVars()
+, pInitVars()
+, pComps()
+, pCompIdcs()
+, pSpecs()
+, pSpecIdcs()
+, pReacs()
+, pMathReacs()
+, pRateRules()
+, pAssignRules()
+, pSeed(12345)
+, pSim(0)
+, pUpdateDt(1.0e-3)
+, pBefore()
+, pRates()
+, pDoc(0)
+{
+    ifstream in(filename.c_str(), ios::in | ios::binary);
+    if (!in)
+    {
+        ostringstream os;
+        os << "SBML file '" << filename << "' not found or unreadable.";
+        throw steps::ArgErr(os.str());
+    }
+    ostringstream buf;
+    buf << in.rdbuf();
+    pDoc = parseXML(buf.str());
+
+    try
+    {
+        XMLNode const * model = pDoc->child("model");
+        if (pDoc->name() != "sbml" || model == 0)
+        {
+            ostringstream os;
+            os << "'" << filename << "' is not an SBML file.";
+            throw steps::ArgErr(os.str());
+        }
+        if (!model->listOf("listOfEvents").empty())
+        {
+            notImpl("SBML events are not supported by the native importer.");
+        }
+
+        vector<XMLNode *> const & units = model->listOf("listOfUnitDefinitions");
+        for (uint i = 0; i < units.size(); ++i) pUnitDefs[sbmlID(units[i])] = units[i];
+
+        vector<XMLNode *> const & funcs = model->listOf("listOfFunctionDefinitions");
+        for (uint i = 0; i < funcs.size(); ++i)
+        {
+            XMLNode const * math = funcs[i]->child("math");
+            XMLNode const * lambda = (math == 0 ? 0 : math->child("lambda"));
+            if (lambda == 0)
+            {
+                ostringstream os;
+                os << "Function definition '" << sbmlID(funcs[i]) << "' has no lambda.";
+                throw steps::ArgErr(os.str());
+            }
+            pFuncDefs[sbmlID(funcs[i])] = lambda;
+        }
+
+        // Slot 0 is time.
+        pVars.push_back(0.0);
+
+        _parseUnits(model, timeunits_def, volunits_def, subsunits_def);
+        _parseComps(model, volume_def, area_def);
+        _parseSpecies(model);
+        _parseParams(model);
+
+        // Names that some models use for time without the csymbol.
+        char const * times[] = { "time", "t", "Time", "s" };
+        for (uint i = 0; i < 4; ++i)
+        {
+            if (pVarIdcs.find(times[i]) == pVarIdcs.end()) pVarIdcs[times[i]] = 0;
+        }
+
+        _parseInitialAssignments(model);
+        _parseRules(model);
+        _parseReactions(model, strict_mode);
+        pInitVars = pVars;
+        _build();
+    }
+    catch (...)
+    {
+        delete pModel;
+        delete pGeom;
+        delete pDoc;
+        throw;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Interface::~Interface(void)
+{
+    delete pModel;
+    delete pGeom;
+    delete pDoc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint Interface::_addVar(string const & id, double value)
+{
+    if (pVarIdcs.find(id) != pVarIdcs.end())
+    {
+        ostringstream os;
+        os << "SBML identifier '" << id << "' is defined twice.";
+        throw steps::ArgErr(os.str());
+    }
+    uint idx = pVars.size();
+    pVars.push_back(value);
+    pVarIdcs[id] = idx;
+    return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double Interface::_unitFactor(string const & units, double def) const
+{
+    if (units == "") return def;
+    if (units == "mole" || units == "second" || units == "metre"
+        || units == "meter" || units == "dimensionless") return 1.0;
+    if (units == "litre" || units == "liter") return 1.0e-3;
+    if (units == "item") return 1.0 / steps::math::AVOGADRO;
+
+    map<string, XMLNode const *>::const_iterator def_it = pUnitDefs.find(units);
+    if (def_it == pUnitDefs.end())
+    {
+        // The level 2 built-in units, unless redefined above.
+        if (units == "substance" || units == "volume" || units == "area"
+            || units == "time" || units == "length") return def;
+        ostringstream os;
+        os << "Unit '" << units << "' is not supported.";
+        notImpl(os.str());
+    }
+
+    double factor = 1.0;
+    vector<XMLNode *> const & us = def_it->second->listOf("listOfUnits");
+    for (uint i = 0; i < us.size(); ++i)
+    {
+        string kind = us[i]->attr("kind");
+        double kf;
+        if (kind == "mole" || kind == "second" || kind == "metre"
+            || kind == "meter" || kind == "dimensionless") kf = 1.0;
+        else if (kind == "litre" || kind == "liter") kf = 1.0e-3;
+        else if (kind == "item") kf = 1.0 / steps::math::AVOGADRO;
+        else
+        {
+            ostringstream os;
+            os << "Unit kind '" << kind << "' in unit '" << units;
+            os << "' is not supported.";
+            notImpl(os.str());
+        }
+        double mult = us[i]->numAttr("multiplier", 1.0);
+        double scale = us[i]->numAttr("scale", 0.0);
+        double exp = us[i]->numAttr("exponent", 1.0);
+        factor *= pow(mult * pow(10.0, scale) * kf, exp);
+    }
+    return factor;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_parseUnits(XMLNode const * model, double timeunits_def,
+                            double volunits_def, double subsunits_def)
+{
+    // Level 3 names the model units in attributes, earlier levels
+    // redefine the built-in units.
+    pTimeUnits = _unitFactor(model->attr("timeUnits", "time"), timeunits_def);
+    pVolUnits = _unitFactor(model->attr("volumeUnits", "volume"), volunits_def);
+    pAreaUnits = _unitFactor(model->attr("areaUnits", "area"), 1.0);
+    pSubsUnits = _unitFactor(model->attr("substanceUnits", "substance"), subsunits_def);
+    pExtentUnits = _unitFactor(model->attr("extentUnits", ""), pSubsUnits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_parseComps(XMLNode const * model, double volume_def,
+                            double area_def)
+{
+    vector<XMLNode *> const & comps = model->listOf("listOfCompartments");
+    for (uint i = 0; i < comps.size(); ++i)
+    {
+        XMLNode const * c = comps[i];
+        CompInfo ci;
+        ci.id = sbmlID(c);
+        double dims = c->numAttr("spatialDimensions", 3.0);
+        if (dims != 3.0 && dims != 2.0)
+        {
+            ostringstream os;
+            os << "Compartment '" << ci.id << "' has " << dims << " dimensions.";
+            notImpl(os.str());
+        }
+        ci.surface = (dims == 2.0);
+        double units = (ci.surface ? pAreaUnits : pVolUnits);
+        double size = c->numAttr("size", c->numAttr("volume", 1.0));
+        if (c->hasAttr("units"))
+        {
+            size *= _unitFactor(c->attr("units"), units) / units;
+        }
+        else if (size == 1.0)
+        {
+            double def = (ci.surface ? area_def : volume_def);
+            if (def > 0.0) size = def / units;
+        }
+        ci.var = _addVar(ci.id, size);
+        // Level 2 nesting; reactions fill in the rest.
+        ci.ocomp = c->attr("outside");
+        pCompIdcs[ci.id] = pComps.size();
+        pComps.push_back(ci);
+    }
+
+    // A volume outside a surface is the surface's outer compartment, a
+    // volume inside one its inner compartment.
+    for (uint i = 0; i < pComps.size(); ++i)
+    {
+        CompInfo & c = pComps[i];
+        map<string, uint>::const_iterator o = pCompIdcs.find(c.ocomp);
+        bool osurf = (o != pCompIdcs.end() && pComps[o->second].surface);
+        if (!c.surface && osurf) pComps[o->second].icomp = c.id;
+        if (!c.surface || osurf || o == pCompIdcs.end()) c.ocomp = "";
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_parseSpecies(XMLNode const * model)
+{
+    vector<XMLNode *> const & specs = model->listOf("listOfSpecies");
+    for (uint i = 0; i < specs.size(); ++i)
+    {
+        XMLNode const * s = specs[i];
+        SpecInfo si;
+        si.id = sbmlID(s);
+        map<string, uint>::const_iterator c = pCompIdcs.find(s->attr("compartment"));
+        if (c == pCompIdcs.end())
+        {
+            ostringstream os;
+            os << "Species '" << si.id << "' is in unknown compartment '";
+            os << s->attr("compartment") << "'.";
+            throw steps::ArgErr(os.str());
+        }
+        si.comp = c->second;
+        si.amount = s->boolAttr("hasOnlySubstanceUnits", false);
+        si.constant = s->boolAttr("constant", false);
+        si.bc = s->boolAttr("boundaryCondition", false);
+
+        double size = pVars[pComps[si.comp].var];
+        double value = 0.0;
+        if (s->hasAttr("initialAmount"))
+        {
+            value = s->numAttr("initialAmount", 0.0);
+            if (!si.amount) value /= size;
+        }
+        else if (s->hasAttr("initialConcentration"))
+        {
+            value = s->numAttr("initialConcentration", 0.0);
+            if (si.amount) value *= size;
+        }
+        si.var = _addVar(si.id, value);
+        pSpecIdcs[si.id] = pSpecs.size();
+        pSpecs.push_back(si);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_parseParams(XMLNode const * model)
+{
+    vector<XMLNode *> const & params = model->listOf("listOfParameters");
+    for (uint i = 0; i < params.size(); ++i)
+    {
+        _addVar(sbmlID(params[i]), params[i]->numAttr("value", 0.0));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_parseInitialAssignments(XMLNode const * model)
+{
+    MathCompiler mc(pVarIdcs, pFuncDefs, 0);
+    vector<XMLNode *> const & ias = model->listOf("listOfInitialAssignments");
+    for (uint i = 0; i < ias.size(); ++i)
+    {
+        string symbol = ias[i]->attr("symbol");
+        map<string, uint>::const_iterator v = pVarIdcs.find(symbol);
+        if (v == pVarIdcs.end() || v->second == 0)
+        {
+            ostringstream os;
+            os << "Initial assignment to '" << symbol << "' is not supported.";
+            notImpl(os.str());
+        }
+        XMLNode const * math = ias[i]->child("math");
+        if (math == 0) continue;
+        pVars[v->second] = mc.compile(math).eval(pVars);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_parseRules(XMLNode const * model)
+{
+    MathCompiler mc(pVarIdcs, pFuncDefs, 0);
+    vector<XMLNode *> const & rules = model->listOf("listOfRules");
+    for (uint i = 0; i < rules.size(); ++i)
+    {
+        XMLNode const * r = rules[i];
+        bool rate = (r->name() == "rateRule");
+        if (!rate && r->name() != "assignmentRule")
+        {
+            ostringstream os;
+            os << "Rule <" << r->name() << "> is not supported.";
+            notImpl(os.str());
+        }
+        string var = r->attr("variable");
+        map<string, uint>::const_iterator v = pVarIdcs.find(var);
+        if (v == pVarIdcs.end() || v->second == 0)
+        {
+            ostringstream os;
+            os << "Rule for unknown variable '" << var << "'.";
+            throw steps::ArgErr(os.str());
+        }
+        if (r->child("math") == 0) continue;
+        RuleInfo ri;
+        ri.var = v->second;
+        ri.expr = mc.compile(r->child("math"));
+        if (rate) pRateRules.push_back(ri);
+        else
+        {
+            // Assignment rules hold from the start.
+            pVars[ri.var] = ri.expr.eval(pVars);
+            pAssignRules.push_back(ri);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_parseReactions(XMLNode const * model, bool strict)
+{
+    MathCompiler mc(pVarIdcs, pFuncDefs, 0);
+    vector<XMLNode *> const & reacs = model->listOf("listOfReactions");
+    for (uint i = 0; i < reacs.size(); ++i)
+    {
+        XMLNode const * r = reacs[i];
+        string id = sbmlID(r);
+        bool reversible = r->boolAttr("reversible", true);
+
+        // Reactants and products, one entry per molecule.
+        vector<uint> react, prod;
+        for (uint side = 0; side < 2; ++side)
+        {
+            vector<uint> & specs = (side == 0 ? react : prod);
+            vector<XMLNode *> const & refs =
+                r->listOf(side == 0 ? "listOfReactants" : "listOfProducts");
+            for (uint j = 0; j < refs.size(); ++j)
+            {
+                string sid = refs[j]->attr("species", refs[j]->attr("specie"));
+                map<string, uint>::const_iterator s = pSpecIdcs.find(sid);
+                if (s == pSpecIdcs.end())
+                {
+                    ostringstream os;
+                    os << "Reaction '" << id << "' refers to unknown species '";
+                    os << sid << "'.";
+                    throw steps::ArgErr(os.str());
+                }
+                int sto = stoichiometry(refs[j], mc, pVars, id);
+                for (int k = 0; k < sto; ++k) specs.push_back(s->second);
+            }
+        }
+
+        // Where the reaction happens: one volume, or one surface and the
+        // volumes on either side of it.
+        int patch = -1;
+        vector<uint> vols;
+        for (uint side = 0; side < 2; ++side)
+        {
+            vector<uint> const & specs = (side == 0 ? react : prod);
+            for (uint j = 0; j < specs.size(); ++j)
+            {
+                uint c = pSpecs[specs[j]].comp;
+                if (pComps[c].surface)
+                {
+                    if (patch >= 0 && uint(patch) != c)
+                    {
+                        ostringstream os;
+                        os << "Reaction '" << id << "' spans two surfaces.";
+                        notImpl(os.str());
+                    }
+                    patch = c;
+                }
+                else if (find(vols.begin(), vols.end(), c) == vols.end())
+                {
+                    vols.push_back(c);
+                }
+            }
+        }
+        if (patch < 0 && vols.size() != 1)
+        {
+            ostringstream os;
+            os << "Reaction '" << id << "' does not happen in exactly one ";
+            os << "compartment or surface.";
+            notImpl(os.str());
+        }
+        if (patch >= 0)
+        {
+            CompInfo & p = pComps[patch];
+            for (uint j = 0; j < vols.size(); ++j)
+            {
+                string const & v = pComps[vols[j]].id;
+                if (v == p.icomp || v == p.ocomp) continue;
+                if (p.icomp == "") p.icomp = v;
+                else if (p.ocomp == "") p.ocomp = v;
+                else
+                {
+                    ostringstream os;
+                    os << "Reaction '" << id << "' involves a third ";
+                    os << "compartment of surface '" << p.id << "'.";
+                    notImpl(os.str());
+                }
+            }
+        }
+        uint space = (patch >= 0 ? uint(patch) : vols[0]);
+
+        XMLNode const * law = r->child("kineticLaw");
+        if (law == 0 || law->child("math") == 0)
+        {
+            cerr << "WARNING: Reaction '" << id << "' has undefined kinetic ";
+            cerr << "law and will be ignored.\n";
+            continue;
+        }
+
+        // Local parameters shadow global ones.
+        map<string, uint> locals;
+        for (uint k = 0; k < 2; ++k)
+        {
+            vector<XMLNode *> const & lps =
+                law->listOf(k == 0 ? "listOfParameters" : "listOfLocalParameters");
+            for (uint j = 0; j < lps.size(); ++j)
+            {
+                string pid = sbmlID(lps[j]);
+                locals[pid] = _addVar(id + "." + pid, lps[j]->numAttr("value", 0.0));
+            }
+        }
+
+        // Boundary species are not changed by reactions: make the
+        // products match the reactants for them.
+        vector<uint> prod_f = prod, prod_b = react;
+        for (uint side = 0; side < 2; ++side)
+        {
+            vector<uint> const & lhs = (side == 0 ? react : prod);
+            vector<uint> const & rhs = (side == 0 ? prod : react);
+            vector<uint> & out = (side == 0 ? prod_f : prod_b);
+            out.clear();
+            for (uint j = 0; j < rhs.size(); ++j)
+            {
+                if (!pSpecs[rhs[j]].bc) out.push_back(rhs[j]);
+            }
+            for (uint j = 0; j < lhs.size(); ++j)
+            {
+                if (pSpecs[lhs[j]].bc) out.push_back(lhs[j]);
+            }
+        }
+
+        XMLNode const * math = law->child("math");
+        ReacInfo fwd;
+        fwd.comp = space;
+        fwd.lhs = react;
+        fwd.rhs = prod_f;
+        fwd.sign = 1.0;
+        if (!reversible)
+        {
+            fwd.id = id;
+            fwd.rate = mc.compile(math, &locals);
+            if (_isMassAction(fwd))
+            {
+                pReacs.push_back(fwd);
+                continue;
+            }
+        }
+        else
+        {
+            ReacInfo bwd;
+            bwd.id = id + "_b";
+            bwd.comp = space;
+            bwd.lhs = prod;
+            bwd.rhs = prod_b;
+            bwd.sign = 1.0;
+            fwd.id = id + "_f";
+
+            // Written as forward minus backward, or else split by setting
+            // the products, then the reactants, to zero.
+            pair<XMLNode const *, XMLNode const *> fb = MathCompiler::splitMinus(math);
+            if (fb.first != 0)
+            {
+                fwd.rate = mc.compile(fb.first, &locals);
+                bwd.rate = mc.compile(fb.second, &locals);
+            }
+            bool split = (fb.first != 0 && _isMassAction(fwd) && _isMassAction(bwd));
+            if (!split)
+            {
+                fwd.rate = bwd.rate = mc.compile(math, &locals);
+                fwd.zero = prod;
+                bwd.zero = react;
+                bwd.sign = -1.0;
+                split = true;
+                for (uint j = 0; j < react.size(); ++j)
+                {
+                    if (find(prod.begin(), prod.end(), react[j]) != prod.end())
+                    {
+                        split = false;
+                    }
+                }
+                split = (split && _isMassAction(fwd) && _isMassAction(bwd)
+                         && _isSplit(fwd, bwd));
+            }
+            if (split)
+            {
+                pReacs.push_back(fwd);
+                pReacs.push_back(bwd);
+                continue;
+            }
+        }
+
+        if (strict)
+        {
+            ostringstream os;
+            os << "Reaction '" << id << "' does not have a mass-action ";
+            os << "kinetic law (strict mode).";
+            throw steps::NotImplErr(os.str());
+        }
+        // Net extent rate; reactants and products change by it.
+        fwd.id = id;
+        fwd.rate = mc.compile(math, &locals);
+        fwd.rhs = prod;
+        fwd.zero.clear();
+        pMathReacs.push_back(fwd);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_randomSpecs(vector<double> & vars)
+{
+    for (uint i = 0; i < pSpecs.size(); ++i)
+    {
+        pSeed = pSeed * 1103515245UL + 12345UL;
+        vars[pSpecs[i].var] = 0.5 + double((pSeed >> 8) % 1000000) / 1.0e6;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double Interface::_rate(ReacInfo const & r, vector<double> & vars) const
+{
+    for (uint i = 0; i < r.zero.size(); ++i) vars[pSpecs[r.zero[i]].var] = 0.0;
+    return r.sign * r.rate.eval(vars);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Interface::_isMassAction(ReacInfo const & r)
+{
+    // The rate divided by the product of the reactants must not change
+    // when all species values change.
+    vector<double> vars = pVars;
+    double ratio[2];
+    for (uint t = 0; t < 2; ++t)
+    {
+        _randomSpecs(vars);
+        double prod = 1.0;
+        for (uint i = 0; i < r.lhs.size(); ++i) prod *= vars[pSpecs[r.lhs[i]].var];
+        ratio[t] = _rate(r, vars) / prod;
+    }
+    if (ratio[0] != ratio[0] || ratio[1] != ratio[1] || ratio[0] < 0.0) return false;
+    double scale = max(fabs(ratio[0]), fabs(ratio[1]));
+    return fabs(ratio[0] - ratio[1]) <= 1.0e-9 * scale;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Interface::_isSplit(ReacInfo const & f, ReacInfo const & b)
+{
+    // The whole law must be the forward rate minus the backward rate.
+    vector<double> vars = pVars;
+    _randomSpecs(vars);
+    vector<double> fvars = vars, bvars = vars;
+    double whole = f.rate.eval(vars);
+    double parts = _rate(f, fvars) - _rate(b, bvars);
+    double scale = max(fabs(whole), fabs(parts));
+    return fabs(whole - parts) <= 1.0e-9 * scale;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double Interface::_molPerUnit(SpecInfo const & s) const
+{
+    return pSubsUnits * (s.amount ? 1.0 : pVars[pComps[s.comp].var]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double Interface::_kcst(ReacInfo const & r) const
+{
+    // With every reactant at one unit the law gives the constant K in
+    // model units. In moles and seconds the extent rate is
+    // K * (extent / time units) * prod(x_i), where species i has
+    // x_i * m_i moles (m_i from _molPerUnit). STEPS gives the same rate as
+    // kcst * S * prod(x_i * m_i / S), S the litres of the volume the
+    // reactants are in, or the square metres of the surface if none are
+    // in a volume.
+    vector<double> vars = pVars;
+    for (uint i = 0; i < r.lhs.size(); ++i) vars[pSpecs[r.lhs[i]].var] = 1.0;
+    double k = _rate(r, vars) * pExtentUnits / pTimeUnits;
+
+    uint space = r.comp;
+    for (uint i = 0; i < r.lhs.size(); ++i)
+    {
+        uint c = pSpecs[r.lhs[i]].comp;
+        if (!pComps[c].surface) space = c;
+    }
+    double size = pVars[pComps[space].var];
+    double s = (pComps[space].surface ? size * pAreaUnits : size * pVolUnits * 1.0e3);
+
+    for (uint i = 0; i < r.lhs.size(); ++i)
+    {
+        k *= s / _molPerUnit(pSpecs[r.lhs[i]]);
+    }
+    return k / s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_build(void)
+{
+    using namespace steps::model;
+
+    pModel = new Model();
+    pGeom = new steps::wm::Geom();
+
+    vector<Spec *> specs;
+    for (uint i = 0; i < pSpecs.size(); ++i)
+    {
+        specs.push_back(new Spec(pSpecs[i].id, pModel));
+    }
+
+    map<string, steps::wm::Comp *> comps;
+    for (uint i = 0; i < pComps.size(); ++i)
+    {
+        CompInfo const & c = pComps[i];
+        if (c.surface) continue;
+        steps::wm::Comp * comp =
+            new steps::wm::Comp(c.id, pGeom, pVars[c.var] * pVolUnits);
+        new Volsys(c.id + "_volsys", pModel);
+        comp->addVolsys(c.id + "_volsys");
+        comps[c.id] = comp;
+    }
+    for (uint i = 0; i < pComps.size(); ++i)
+    {
+        CompInfo & p = pComps[i];
+        if (!p.surface) continue;
+        // STEPS patches need an inner compartment; a surface with only
+        // one volume next to it gets that volume on the inside.
+        if (p.icomp == "")
+        {
+            p.icomp = p.ocomp;
+            p.ocomp = "";
+        }
+        if (p.icomp == "" && comps.size() == 1) p.icomp = comps.begin()->first;
+        if (p.icomp == "")
+        {
+            ostringstream os;
+            os << "Cannot tell which compartment surface '" << p.id;
+            os << "' encloses.";
+            notImpl(os.str());
+        }
+        steps::wm::Patch * patch = new steps::wm::Patch(p.id, pGeom,
+            comps[p.icomp], (p.ocomp == "" ? 0 : comps[p.ocomp]),
+            pVars[p.var] * pAreaUnits);
+        new Surfsys(p.id + "_ssys", pModel);
+        patch->addSurfsys(p.id + "_ssys");
+    }
+
+    for (uint i = 0; i < pReacs.size(); ++i)
+    {
+        ReacInfo const & r = pReacs[i];
+        CompInfo const & c = pComps[r.comp];
+        double kcst = _kcst(r);
+        if (!c.surface)
+        {
+            SpecPVec lhs, rhs;
+            for (uint j = 0; j < r.lhs.size(); ++j) lhs.push_back(specs[r.lhs[j]]);
+            for (uint j = 0; j < r.rhs.size(); ++j) rhs.push_back(specs[r.rhs[j]]);
+            new Reac(r.id, pModel->getVolsys(c.id + "_volsys"), lhs, rhs, kcst);
+            continue;
+        }
+        // Outer, inner and surface species of each side.
+        SpecPVec sides[6];
+        for (uint side = 0; side < 2; ++side)
+        {
+            vector<uint> const & sp = (side == 0 ? r.lhs : r.rhs);
+            for (uint j = 0; j < sp.size(); ++j)
+            {
+                CompInfo const & sc = pComps[pSpecs[sp[j]].comp];
+                uint where = (sc.surface ? 2 : (sc.id == c.icomp ? 1 : 0));
+                sides[side * 3 + where].push_back(specs[sp[j]]);
+            }
+        }
+        new SReac(r.id, pModel->getSurfsys(c.id + "_ssys"), sides[0], sides[1],
+                  sides[2], sides[4], sides[5], sides[3], kcst);
+    }
+
+    // Null reactions, so that every species exists in its compartment.
+    for (uint i = 0; i < pSpecs.size(); ++i)
+    {
+        SpecInfo const & s = pSpecs[i];
+        CompInfo const & c = pComps[s.comp];
+        SpecPVec sp(1, specs[i]), none;
+        if (!c.surface)
+        {
+            new Reac(s.id + "reac", pModel->getVolsys(c.id + "_volsys"), sp, sp, 0.0);
+        }
+        else
+        {
+            new SReac(s.id + "sreac", pModel->getSurfsys(c.id + "_ssys"),
+                      none, none, sp, none, sp, none, 0.0);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_bind(steps::solver::API * sim)
+{
+    if (sim == pSim) return;
+    for (uint i = 0; i < pComps.size(); ++i)
+    {
+        CompInfo & c = pComps[i];
+        c.sidx = (c.surface ? sim->getPatchIdx(c.id) : sim->getCompIdx(c.id));
+    }
+    for (uint i = 0; i < pSpecs.size(); ++i)
+    {
+        pSpecs[i].sidx = sim->getSpecIdx(pSpecs[i].id);
+    }
+    for (uint i = 0; i < pReacs.size(); ++i)
+    {
+        ReacInfo & r = pReacs[i];
+        r.sidx = (pComps[r.comp].surface ? sim->getSReacIdx(r.id)
+                                         : sim->getReacIdx(r.id));
+    }
+    pSim = sim;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_setSize(CompInfo const & c)
+{
+    double size = pVars[c.var];
+    if (size <= 0.0)
+    {
+        ostringstream os;
+        os << "Rules set the size of '" << c.id << "' to " << size << ".";
+        throw steps::ArgErr(os.str());
+    }
+    if (c.surface) pSim->_setPatchArea(c.sidx, size * pAreaUnits);
+    else pSim->_setCompVol(c.sidx, size * pVolUnits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_setSpec(SpecInfo const & s)
+{
+    double mol = max(0.0, pVars[s.var] * _molPerUnit(s));
+    CompInfo const & c = pComps[s.comp];
+    if (c.surface) pSim->_setPatchAmount(c.sidx, s.sidx, mol);
+    else pSim->_setCompAmount(c.sidx, s.sidx, mol);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::_setK(ReacInfo const & r)
+{
+    double k = _kcst(r);
+    if (k < 0.0 || k != k)
+    {
+        ostringstream os;
+        os << "Kinetic law of reaction '" << r.id << "' gives rate constant ";
+        os << k << ".";
+        throw steps::ArgErr(os.str());
+    }
+    CompInfo const & c = pComps[r.comp];
+    if (c.surface) pSim->_setPatchSReacK(c.sidx, r.sidx, k);
+    else pSim->_setCompReacK(c.sidx, r.sidx, k);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::setupSim(steps::solver::API * sim)
+{
+    _bind(sim);
+    pVars = pInitVars;
+    for (uint i = 0; i < pComps.size(); ++i) _setSize(pComps[i]);
+    for (uint i = 0; i < pSpecs.size(); ++i)
+    {
+        SpecInfo const & s = pSpecs[i];
+        _setSpec(s);
+        if (!s.constant) continue;
+        CompInfo const & c = pComps[s.comp];
+        if (c.surface) sim->_setPatchClamped(c.sidx, s.sidx, true);
+        else sim->_setCompClamped(c.sidx, s.sidx, true);
+    }
+    for (uint i = 0; i < pReacs.size(); ++i) _setK(pReacs[i]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::updateSim(steps::solver::API * sim, double simdt)
+{
+    _bind(sim);
+    double dt = simdt / pTimeUnits;
+
+    for (uint i = 0; i < pSpecs.size(); ++i)
+    {
+        SpecInfo const & s = pSpecs[i];
+        CompInfo const & c = pComps[s.comp];
+        double mol = (c.surface ? sim->_getPatchAmount(c.sidx, s.sidx)
+                                : sim->_getCompAmount(c.sidx, s.sidx));
+        pVars[s.var] = mol / _molPerUnit(s);
+    }
+    pBefore = pVars;
+
+    // Rate rules and non-mass-action reactions, all rates taken at the
+    // start of the step.
+    uint nrules = pRateRules.size();
+    pRates.resize(nrules + pMathReacs.size());
+    for (uint i = 0; i < nrules; ++i)
+    {
+        pRates[i] = pRateRules[i].expr.eval(pVars);
+    }
+    for (uint i = 0; i < pMathReacs.size(); ++i)
+    {
+        pRates[nrules + i] = pMathReacs[i].rate.eval(pVars);
+    }
+    for (uint i = 0; i < nrules; ++i)
+    {
+        pVars[pRateRules[i].var] += pRates[i] * dt;
+    }
+    for (uint i = 0; i < pMathReacs.size(); ++i)
+    {
+        ReacInfo const & r = pMathReacs[i];
+        double subs = pRates[nrules + i] * dt * pExtentUnits / pSubsUnits;
+        for (uint side = 0; side < 2; ++side)
+        {
+            vector<uint> const & sp = (side == 0 ? r.lhs : r.rhs);
+            for (uint j = 0; j < sp.size(); ++j)
+            {
+                SpecInfo const & s = pSpecs[sp[j]];
+                if (s.constant || s.bc) continue;
+                double size = (s.amount ? 1.0 : pBefore[pComps[s.comp].var]);
+                pVars[s.var] += (side == 0 ? -subs : subs) / size;
+            }
+        }
+    }
+
+    pVars[0] += dt;
+    for (uint i = 0; i < pAssignRules.size(); ++i)
+    {
+        pVars[pAssignRules[i].var] = pAssignRules[i].expr.eval(pVars);
+    }
+
+    bool sizes = false;
+    for (uint i = 0; i < pComps.size(); ++i)
+    {
+        CompInfo const & c = pComps[i];
+        if (pVars[c.var] == pBefore[c.var]) continue;
+        sizes = true;
+        _setSize(c);
+    }
+    for (uint i = 0; i < pSpecs.size(); ++i)
+    {
+        if (pVars[pSpecs[i].var] != pBefore[pSpecs[i].var]) _setSpec(pSpecs[i]);
+    }
+
+    // Rate constants that depend on changed variables (time always
+    // changes).
+    for (uint i = 0; i < pReacs.size(); ++i)
+    {
+        ReacInfo const & r = pReacs[i];
+        bool changed = sizes;
+        vector<uint> const & vs = r.rate.vars();
+        for (uint j = 0; j < vs.size() && !changed; ++j)
+        {
+            changed = (vs[j] == 0 || pVars[vs[j]] != pBefore[vs[j]]);
+        }
+        if (changed) _setK(r);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::run(steps::solver::API * sim, double endtime)
+{
+    if (endtime < sim->getTime())
+    {
+        ostringstream os;
+        os << "Endtime is before current simulation time";
+        throw steps::ArgErr(os.str());
+    }
+    while (sim->getTime() < endtime)
+    {
+        double t0 = sim->getTime();
+        double t = min(t0 + pUpdateDt, endtime);
+        sim->run(t);
+        updateSim(sim, t - t0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Interface::setUpdateInterval(double dt)
+{
+    if (dt <= 0.0)
+    {
+        ostringstream os;
+        os << "Update interval must be positive.";
+        throw steps::ArgErr(os.str());
+    }
+    pUpdateDt = dt;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,276 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SBML_SBML_HPP
+#define STEPS_SBML_SBML_HPP 1
+
+
+// STL headers.
+#include <map>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "mathml.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+
+// Forward declarations.
+namespace model { class Model; }
+namespace wm { class Geom; }
+namespace solver { class API; }
+
+START_NAMESPACE(sbml)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Native SBML importer.
+///
+/// Reads an SBML file (levels 1 to 3, core) into a steps::model::Model and
+/// a well-mixed steps::wm::Geom, like steps.utilities.sbml.Interface but
+/// without libSBML and without creating the model one Python call at a
+/// time. Every kinetic law, rule and initial assignment is compiled once
+/// to a MathExpr over one vector of variables (time, compartment sizes,
+/// species and parameters, in SBML model units), so that the mass-action
+/// test, the rate constants and the rules in updateSim() are evaluated
+/// without walking MathML again.
+///
+/// Model conventions follow the Python importer: compartment c gets volume
+/// system c_volsys, two-dimensional compartment p becomes patch p with
+/// surface system p_ssys, reversible reactions r are split into r_f and
+/// r_b, and species that take part in no reaction get a null reaction so
+/// that they exist in their compartment.
+///
+/// Reactions whose kinetic law is mass action in their reactants (numerically
+/// tested; reversible laws must be the difference of the forward and
+/// backward laws) become Reac and SReac objects. Other reactions, rate rules
+/// and assignment rules are applied by updateSim(), unless strict_mode is
+/// set, in which case the former are an error. Events, algebraic rules,
+/// delays, reactions across two volumes without a surface and units other
+/// than moles, items, litres, metres and seconds throw steps::NotImplErr;
+/// use the Python importer for those models.
+///
+class Interface
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Constructor. Arguments as for steps.utilities.sbml.Interface; the
+    /// defaults apply where the file does not declare model units, and
+    /// volume_def and area_def (if not zero) replace sizes of 1 without
+    /// units.
+    Interface(std::string const & filename, double timeunits_def = 1.0,
+              double volunits_def = 1.0e-3, double subsunits_def = 1.0,
+              double volume_def = 0.0, double area_def = 0.0,
+              bool strict_mode = false);
+
+    /// Destructor. Deletes the model and the geometry.
+    ~Interface(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // OPERATIONS (EXPOSED TO PYTHON)
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Return the imported model. It is owned by the interface.
+    steps::model::Model * getModel(void) const
+    { return pModel; }
+
+    /// Return the imported well-mixed geometry. It is owned by the
+    /// interface.
+    steps::wm::Geom * getGeom(void) const
+    { return pGeom; }
+
+    /// Set the compartment sizes, initial amounts and clamped species of
+    /// sim, and reset the rules to the state after import.
+    void setupSim(steps::solver::API * sim);
+
+    /// Apply rate rules, non-mass-action reactions and assignment rules for
+    /// a step of simdt seconds, and update the rate constants that depend
+    /// on changed variables.
+    void updateSim(steps::solver::API * sim, double simdt);
+
+    /// Run sim to endtime, calling updateSim() every update interval
+    /// without returning to Python. The last step may be shorter.
+    void run(steps::solver::API * sim, double endtime);
+
+    /// Return the interval at which run() applies the rules (seconds).
+    double getUpdateInterval(void) const
+    { return pUpdateDt; }
+
+    /// Set the interval at which run() applies the rules (seconds).
+    void setUpdateInterval(double dt);
+
+    ////////////////////////////////////////////////////////////////////////
+    // INTERNAL (NON-EXPOSED)
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Count the mass-action reactions (Reac and SReac objects, the split
+    /// halves of reversible ones counted apart, null reactions not).
+    uint _countMassActionReacs(void) const
+    { return pReacs.size(); }
+
+    /// Count the reactions applied by updateSim().
+    uint _countMathReacs(void) const
+    { return pMathReacs.size(); }
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    struct CompInfo
+    {
+        std::string                         id;
+        bool                                surface;
+        uint                                var;
+        // Patches only: the inner and outer compartment, or "".
+        std::string                         icomp;
+        std::string                         ocomp;
+        // Compartment or patch index in the bound solver.
+        uint                                sidx;
+    };
+
+    struct SpecInfo
+    {
+        std::string                         id;
+        uint                                comp;
+        // True if the species stands for an amount rather than a
+        // concentration in math (hasOnlySubstanceUnits).
+        bool                                amount;
+        bool                                constant;
+        bool                                bc;
+        uint                                var;
+        // Species index in the bound solver.
+        uint                                sidx;
+    };
+
+    /// A reaction or half of a reversible one, the species as indices into
+    /// pSpecs. The rate is sign * rate with the species in zero set to 0,
+    /// which picks one half out of a reversible kinetic law.
+    struct ReacInfo
+    {
+        std::string                         id;
+        uint                                comp;
+        std::vector<uint>                   lhs;
+        std::vector<uint>                   rhs;
+        MathExpr                            rate;
+        std::vector<uint>                   zero;
+        double                              sign;
+        // Reac or SReac index in the bound solver.
+        uint                                sidx;
+    };
+
+    struct RuleInfo
+    {
+        uint                                var;
+        MathExpr                            expr;
+    };
+
+    ////////////////////////////////////////////////////////////////////////
+
+    void _parseUnits(XMLNode const * model, double timeunits_def,
+                     double volunits_def, double subsunits_def);
+    double _unitFactor(std::string const & units, double def) const;
+    void _parseComps(XMLNode const * model, double volume_def, double area_def);
+    void _parseSpecies(XMLNode const * model);
+    void _parseParams(XMLNode const * model);
+    void _parseInitialAssignments(XMLNode const * model);
+    void _parseRules(XMLNode const * model);
+    void _parseReactions(XMLNode const * model, bool strict);
+    void _build(void);
+
+    uint _addVar(std::string const & id, double value);
+    void _randomSpecs(std::vector<double> & vars);
+    double _rate(ReacInfo const & r, std::vector<double> & vars) const;
+    bool _isMassAction(ReacInfo const & r);
+    bool _isSplit(ReacInfo const & f, ReacInfo const & b);
+    double _kcst(ReacInfo const & r) const;
+    double _molPerUnit(SpecInfo const & s) const;
+
+    // Look up the solver indices of everything, unless sim is the solver
+    // they were looked up in last.
+    void _bind(steps::solver::API * sim);
+    void _setSize(CompInfo const & c);
+    void _setSpec(SpecInfo const & s);
+    void _setK(ReacInfo const & r);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    steps::model::Model                   * pModel;
+    steps::wm::Geom                       * pGeom;
+
+    // Model units in SI (and moles), and those of kinetic laws.
+    double                                  pTimeUnits;
+    double                                  pVolUnits;
+    double                                  pAreaUnits;
+    double                                  pSubsUnits;
+    double                                  pExtentUnits;
+
+    std::map<std::string, XMLNode const *>  pUnitDefs;
+    std::map<std::string, XMLNode const *>  pFuncDefs;
+
+    // Slot 0 is time.
+    std::map<std::string, uint>             pVarIdcs;
+    std::vector<double>                     pVars;
+    std::vector<double>                     pInitVars;
+
+    std::vector<CompInfo>                   pComps;
+    std::map<std::string, uint>             pCompIdcs;
+    std::vector<SpecInfo>                   pSpecs;
+    std::map<std::string, uint>             pSpecIdcs;
+
+    std::vector<ReacInfo>                   pReacs;
+    std::vector<ReacInfo>                   pMathReacs;
+    std::vector<RuleInfo>                   pRateRules;
+    std::vector<RuleInfo>                   pAssignRules;
+
+    // Random numbers for the mass-action test.
+    unsigned long                           pSeed;
+
+    steps::solver::API                    * pSim;
+    double                                  pUpdateDt;
+    // Scratch space for updateSim().
+    std::vector<double>                     pBefore;
+    std::vector<double>                     pRates;
+
+    // The parsed document, kept for the function definitions.
+    XMLNode                               * pDoc;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(sbml)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SBML_SBML_HPP
+
+// END
@@ -0,0 +1,353 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <cassert>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "xml.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+USING_NAMESPACE(std);
+USING_NAMESPACE(steps::sbml);
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+static const vector<XMLNode *> EMPTY_LIST;
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+string localName(string const & name)
+{
+    string::size_type colon = name.find(':');
+    return (colon == string::npos ? name : name.substr(colon + 1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+string trim(string const & s)
+{
+    string::size_type b = 0, e = s.size();
+    while (b < e && isSpace(s[b])) ++b;
+    while (e > b && isSpace(s[e - 1])) --e;
+    return s.substr(b, e - b);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xmlError(string const & doc, string::size_type pos, string const & what)
+{
+    uint line = 1;
+    for (string::size_type i = 0; i < pos && i < doc.size(); ++i)
+    {
+        if (doc[i] == '\n') ++line;
+    }
+    ostringstream os;
+    os << "Malformed XML at line " << line << ": " << what << ".";
+    throw steps::ArgErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void appendUTF8(string & out, unsigned long c)
+{
+    if (c < 0x80) out += char(c);
+    else if (c < 0x800)
+    {
+        out += char(0xC0 | (c >> 6));
+        out += char(0x80 | (c & 0x3F));
+    }
+    else if (c < 0x10000)
+    {
+        out += char(0xE0 | (c >> 12));
+        out += char(0x80 | ((c >> 6) & 0x3F));
+        out += char(0x80 | (c & 0x3F));
+    }
+    else
+    {
+        out += char(0xF0 | (c >> 18));
+        out += char(0x80 | ((c >> 12) & 0x3F));
+        out += char(0x80 | ((c >> 6) & 0x3F));
+        out += char(0x80 | (c & 0x3F));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Append doc[b, e) to out with entities resolved.
+void appendText(string & out, string const & doc,
+                string::size_type b, string::size_type e)
+{
+    while (b < e)
+    {
+        string::size_type amp = doc.find('&', b);
+        if (amp == string::npos || amp >= e)
+        {
+            out.append(doc, b, e - b);
+            return;
+        }
+        out.append(doc, b, amp - b);
+        string::size_type semi = doc.find(';', amp);
+        if (semi == string::npos || semi >= e) xmlError(doc, amp, "unterminated entity");
+        string ent = doc.substr(amp + 1, semi - amp - 1);
+        if (ent == "lt") out += '<';
+        else if (ent == "gt") out += '>';
+        else if (ent == "amp") out += '&';
+        else if (ent == "quot") out += '"';
+        else if (ent == "apos") out += '\'';
+        else if (ent.size() > 1 && ent[0] == '#')
+        {
+            bool hex = (ent[1] == 'x' || ent[1] == 'X');
+            appendUTF8(out, strtoul(ent.c_str() + (hex ? 2 : 1), 0, hex ? 16 : 10));
+        }
+        else xmlError(doc, amp, "unknown entity '&" + ent + ";'");
+        b = semi + 1;
+    }
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+XMLNode::XMLNode(string const & name)
+: pName(name)
+, pAttrs()
+, pChildren()
+, pText()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+XMLNode::~XMLNode(void)
+{
+    for (uint i = 0; i < pChildren.size(); ++i) delete pChildren[i];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+XMLNode const * XMLNode::child(string const & name) const
+{
+    for (uint i = 0; i < pChildren.size(); ++i)
+    {
+        if (pChildren[i]->pName == name) return pChildren[i];
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+vector<XMLNode *> const & XMLNode::listOf(string const & list) const
+{
+    XMLNode const * l = child(list);
+    return (l == 0 ? EMPTY_LIST : l->pChildren);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+string XMLNode::attr(string const & name, string const & def) const
+{
+    map<string, string>::const_iterator a = pAttrs.find(name);
+    return (a == pAttrs.end() ? def : a->second);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double XMLNode::numAttr(string const & name, double def) const
+{
+    map<string, string>::const_iterator a = pAttrs.find(name);
+    if (a == pAttrs.end()) return def;
+    char * end = 0;
+    double v = strtod(a->second.c_str(), &end);
+    if (end == a->second.c_str() || trim(end) != "")
+    {
+        ostringstream os;
+        os << "Attribute '" << name << "' of <" << pName << "> is not a number: '";
+        os << a->second << "'.";
+        throw steps::ArgErr(os.str());
+    }
+    return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool XMLNode::boolAttr(string const & name, bool def) const
+{
+    map<string, string>::const_iterator a = pAttrs.find(name);
+    if (a == pAttrs.end()) return def;
+    string v = trim(a->second);
+    return (v == "true" || v == "1");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+XMLNode * steps::sbml::parseXML(string const & doc)
+{
+    XMLNode * root = 0;
+    vector<XMLNode *> open;
+    // Raw character data of the open elements, trimmed when they close.
+    vector<string> texts;
+    string::size_type pos = 0, n = doc.size();
+
+    try
+    {
+        while (pos < n)
+        {
+            string::size_type lt = doc.find('<', pos);
+            if (lt == string::npos) lt = n;
+            if (!open.empty()) appendText(texts.back(), doc, pos, lt);
+            if (lt == n) break;
+
+            if (doc.compare(lt, 4, "<!--") == 0)
+            {
+                pos = doc.find("-->", lt + 4);
+                if (pos == string::npos) xmlError(doc, lt, "unterminated comment");
+                pos += 3;
+            }
+            else if (doc.compare(lt, 9, "<![CDATA[") == 0)
+            {
+                pos = doc.find("]]>", lt + 9);
+                if (pos == string::npos) xmlError(doc, lt, "unterminated CDATA section");
+                if (!open.empty()) texts.back().append(doc, lt + 9, pos - lt - 9);
+                pos += 3;
+            }
+            else if (doc.compare(lt, 2, "<?") == 0)
+            {
+                pos = doc.find("?>", lt + 2);
+                if (pos == string::npos) xmlError(doc, lt, "unterminated processing instruction");
+                pos += 2;
+            }
+            else if (doc.compare(lt, 2, "<!") == 0)
+            {
+                // DOCTYPE, possibly with an internal subset in brackets.
+                int depth = 0;
+                for (pos = lt + 2; pos < n; ++pos)
+                {
+                    if (doc[pos] == '[') ++depth;
+                    else if (doc[pos] == ']') --depth;
+                    else if (doc[pos] == '>' && depth <= 0) break;
+                }
+                if (pos == n) xmlError(doc, lt, "unterminated declaration");
+                ++pos;
+            }
+            else if (doc.compare(lt, 2, "</") == 0)
+            {
+                string::size_type gt = doc.find('>', lt);
+                if (gt == string::npos) xmlError(doc, lt, "unterminated end tag");
+                string name = localName(trim(doc.substr(lt + 2, gt - lt - 2)));
+                if (open.empty() || open.back()->name() != name)
+                {
+                    xmlError(doc, lt, "unexpected end tag </" + name + ">");
+                }
+                open.back()->pText = trim(texts.back());
+                open.pop_back();
+                texts.pop_back();
+                pos = gt + 1;
+            }
+            else
+            {
+                string::size_type p = lt + 1;
+                while (p < n && !isSpace(doc[p]) && doc[p] != '>' && doc[p] != '/') ++p;
+                XMLNode * node = new XMLNode(localName(doc.substr(lt + 1, p - lt - 1)));
+                if (!open.empty()) texts.back() += ' ';
+                if (open.empty())
+                {
+                    if (root != 0)
+                    {
+                        delete node;
+                        xmlError(doc, lt, "more than one root element");
+                    }
+                    root = node;
+                }
+                else open.back()->pChildren.push_back(node);
+
+                // Attributes.
+                bool empty = false;
+                while (true)
+                {
+                    while (p < n && isSpace(doc[p])) ++p;
+                    if (p >= n) xmlError(doc, lt, "unterminated start tag");
+                    if (doc[p] == '>') { ++p; break; }
+                    if (doc[p] == '/')
+                    {
+                        if (p + 1 >= n || doc[p + 1] != '>') xmlError(doc, p, "expected '/>'");
+                        empty = true;
+                        p += 2;
+                        break;
+                    }
+                    string::size_type eq = doc.find('=', p);
+                    if (eq == string::npos) xmlError(doc, p, "attribute without value");
+                    string aname = localName(trim(doc.substr(p, eq - p)));
+                    p = eq + 1;
+                    while (p < n && isSpace(doc[p])) ++p;
+                    if (p >= n || (doc[p] != '"' && doc[p] != '\''))
+                    {
+                        xmlError(doc, p, "unquoted attribute value");
+                    }
+                    string::size_type close = doc.find(doc[p], p + 1);
+                    if (close == string::npos) xmlError(doc, p, "unterminated attribute value");
+                    string value;
+                    appendText(value, doc, p + 1, close);
+                    node->pAttrs[aname] = value;
+                    p = close + 1;
+                }
+                if (!empty)
+                {
+                    open.push_back(node);
+                    texts.push_back(string());
+                }
+                pos = p;
+            }
+        }
+        if (root == 0) xmlError(doc, n, "no root element");
+        if (!open.empty()) xmlError(doc, n, "unclosed element <" + open.back()->name() + ">");
+    }
+    catch (...)
+    {
+        delete root;
+        throw;
+    }
+    return root;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
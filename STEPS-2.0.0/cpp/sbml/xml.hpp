@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SBML_XML_HPP
+#define STEPS_SBML_XML_HPP 1
+
+
+// STL headers.
+#include <map>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(sbml)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// An element of a parsed XML document.
+///
+/// Element and attribute names have their namespace prefix removed, since
+/// SBML and MathML never mix elements of the same local name. The text of
+/// an element is the concatenation of its character data, entities
+/// resolved, with leading and trailing white space removed. Character
+/// data on either side of a child element is separated by a space, so that
+/// "1.5<sep/>3" in a MathML number reads "1.5 3".
+///
+class XMLNode
+{
+
+public:
+
+    XMLNode(std::string const & name);
+    ~XMLNode(void);
+
+    std::string const & name(void) const
+    { return pName; }
+
+    std::string const & text(void) const
+    { return pText; }
+
+    std::vector<XMLNode *> const & children(void) const
+    { return pChildren; }
+
+    /// Return the first child called name, or 0 if there is none.
+    XMLNode const * child(std::string const & name) const;
+
+    /// Return the children of the first child called list (for instance
+    /// the species of listOfSpecies), or an empty list.
+    std::vector<XMLNode *> const & listOf(std::string const & list) const;
+
+    bool hasAttr(std::string const & name) const
+    { return pAttrs.find(name) != pAttrs.end(); }
+
+    /// Return the value of attribute name, or def if it is not set.
+    std::string attr(std::string const & name,
+                     std::string const & def = "") const;
+
+    /// Return attribute name as a number, or def if it is not set.
+    double numAttr(std::string const & name, double def) const;
+
+    /// Return attribute name as a boolean ("true" or "1"), or def if it is
+    /// not set.
+    bool boolAttr(std::string const & name, bool def) const;
+
+private:
+
+    friend XMLNode * parseXML(std::string const & doc);
+
+    std::string                             pName;
+    std::map<std::string, std::string>      pAttrs;
+    std::vector<XMLNode *>                  pChildren;
+    std::string                             pText;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Parse an XML document and return its root element, which the caller
+/// owns. Comments, processing instructions and DOCTYPE declarations are
+/// skipped; CDATA sections and the predefined and numeric character
+/// entities are supported. Throws steps::ArgErr if the document is not
+/// well formed.
+///
+XMLNode * parseXML(std::string const & doc);
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(sbml)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SBML_XML_HPP
+
+// END
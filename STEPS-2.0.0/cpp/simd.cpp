@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// Standard library & STL headers.
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "common.h"
+#include "error.hpp"
+#include "simd.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+static char const * pSimdNames[] = { "generic", "sse2", "avx2", "avx512" };
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The best instruction set the CPU supports.
+static steps::SimdLevel simdDetect(void)
+{
+#ifdef STEPS_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return steps::SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2")) return steps::SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return steps::SIMD_SSE2;
+#endif
+    return steps::SIMD_GENERIC;
+}
+
+static steps::SimdLevel pSimdBest = simdDetect();
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The level named name, or -1.
+static int simdFind(std::string const & name)
+{
+    for (int l = steps::SIMD_GENERIC; l <= steps::SIMD_AVX512; ++l)
+    {
+        if (name == pSimdNames[l]) return l;
+    }
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// STEPS_SIMD, if it names a supported instruction set, else the best one.
+static steps::SimdLevel simdFromEnv(void)
+{
+    char const * name = getenv("STEPS_SIMD");
+    if (name == 0) return pSimdBest;
+    int l = simdFind(name);
+    if (l < 0 || l > pSimdBest) return pSimdBest;
+    return static_cast<steps::SimdLevel>(l);
+}
+
+static steps::SimdLevel pSimd = simdFromEnv();
+
+////////////////////////////////////////////////////////////////////////////////
+
+steps::SimdLevel steps::simdLevel(void)
+{
+    return pSimd;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::setSimd(std::string const & name)
+{
+    if (name == "auto")
+    {
+        pSimd = pSimdBest;
+        return;
+    }
+    int l = simdFind(name);
+    if (l < 0)
+    {
+        std::ostringstream os;
+        os << "Unknown instruction set '" << name << "'; expected auto, ";
+        os << "generic, sse2, avx2 or avx512.";
+        throw steps::ArgErr(os.str());
+    }
+    if (l > pSimdBest)
+    {
+        std::ostringstream os;
+        os << "Instruction set '" << name << "' is not supported here; ";
+        os << "the best one is '" << pSimdNames[pSimdBest] << "'.";
+        throw steps::ArgErr(os.str());
+    }
+    pSimd = static_cast<SimdLevel>(l);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string steps::getSimd(void)
+{
+    return pSimdNames[pSimd];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<std::string> steps::getSimdSupported(void)
+{
+    std::vector<std::string> names;
+    for (int l = SIMD_GENERIC; l <= pSimdBest; ++l)
+    {
+        names.push_back(pSimdNames[l]);
+    }
+    return names;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,153 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef STEPS_SIMD_HPP
+#define STEPS_SIMD_HPP 1
+
+// Standard library & STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The instruction sets the vectorized kernels are compiled for, in
+/// increasing order.
+///
+enum SimdLevel
+{
+    SIMD_GENERIC = 0,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+/// The instruction set the kernels run with: the best one the CPU
+/// supports, found on first use, unless another one is chosen with
+/// setSimd or the environment variable STEPS_SIMD.
+///
+SimdLevel simdLevel(void);
+
+/// Choose the instruction set of the kernels by name: "auto" (the best
+/// one the CPU supports), "generic", "sse2", "avx2" or "avx512". Throws
+/// an ArgErr for an unknown name or one the CPU does not support.
+///
+/// All instruction sets give the same results, bit for bit: the
+/// variants are compiled without contracting multiplies and adds into
+/// FMA instructions, so a run does not depend on the node it ran on.
+///
+void setSimd(std::string const & name);
+
+/// The name of the instruction set the kernels run with.
+///
+std::string getSimd(void);
+
+/// The names of the instruction sets this build and CPU support, from
+/// "generic" up.
+///
+std::vector<std::string> getSimdSupported(void);
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(steps)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A kernel is written once, as a function declared STEPS_SIMD_INLINE,
+// after which
+//
+//     STEPS_SIMD_CLONES(kernel, (double const * a, double * b, uint n),
+//                       (a, b, n))
+//
+// compiles a copy of it for each instruction set, kernelGeneric,
+// kernelSSE2, kernelAVX2 and kernelAVX512, and STEPS_SIMD_PICK(kernel)
+// is the one to call for simdLevel(). Only GCC on x86 builds the
+// variants; elsewhere there is just kernelGeneric.
+
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) \
+    && (defined(__x86_64__) || defined(__i386__))
+#define STEPS_SIMD_X86 1
+#endif
+
+#ifdef __GNUC__
+#define STEPS_SIMD_INLINE inline __attribute__((always_inline))
+#else
+#define STEPS_SIMD_INLINE inline
+#endif
+
+#ifdef STEPS_SIMD_X86
+
+#define STEPS_TARGET_SSE2 \
+    __attribute__((target("sse2"), optimize("fp-contract=off")))
+#define STEPS_TARGET_AVX2 \
+    __attribute__((target("avx2"), optimize("fp-contract=off")))
+#define STEPS_TARGET_AVX512 \
+    __attribute__((target("avx512f"), optimize("fp-contract=off")))
+
+#define STEPS_SIMD_CLONES(name, params, args)                           \
+    static void name##Generic params { name args; }                     \
+    static STEPS_TARGET_SSE2 void name##SSE2 params { name args; }      \
+    static STEPS_TARGET_AVX2 void name##AVX2 params { name args; }      \
+    static STEPS_TARGET_AVX512 void name##AVX512 params { name args; }
+
+#define STEPS_SIMD_PICK(name)                                           \
+    (steps::simdPick(&name##Generic, &name##SSE2, &name##AVX2,          \
+                     &name##AVX512))
+
+START_NAMESPACE(steps)
+
+template <class F>
+inline F simdPick(F generic, F sse2, F avx2, F avx512)
+{
+    switch (simdLevel())
+    {
+        case SIMD_AVX512: return avx512;
+        case SIMD_AVX2: return avx2;
+        case SIMD_SSE2: return sse2;
+        default: return generic;
+    }
+}
+
+END_NAMESPACE(steps)
+
+#else
+
+#define STEPS_SIMD_CLONES(name, params, args)                           \
+    static void name##Generic params { name args; }
+
+#define STEPS_SIMD_PICK(name) (&name##Generic)
+
+#endif
+
+#endif
+// STEPS_SIMD_HPP
+
+// END
@@ -34,6 +34,7 @@
 
 // STL headers.
 #include <string>
+#include <vector>
 
 // STEPS headers.
 #include "../common.h"
@@ -45,6 +46,10 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 START_NAMESPACE(steps)
+
+// Forward declarations
+namespace sbml { class Interface; }
+
 START_NAMESPACE(solver)
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -167,6 +172,53 @@ public:
     /// Return the number of steps.
     virtual uint getNSteps(void) const;
 
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER STATE ACCESS:
+    //      INDICES
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Returns the global index of a species, compartment, patch,
+    /// reaction or surface reaction, for the index-based methods below.
+    ///
+    /// \param id Name of the object.
+    uint getSpecIdx(std::string const & id) const;
+    uint getCompIdx(std::string const & id) const;
+    uint getPatchIdx(std::string const & id) const;
+    uint getReacIdx(std::string const & id) const;
+    uint getSReacIdx(std::string const & id) const;
+
+    /// Returns the number of molecules of species sidx in compartment
+    /// cidx.
+    ///
+    /// \param cidx Global index of the compartment.
+    /// \param sidx Global index of the species.
+    double getCompCountIdx(uint cidx, uint sidx) const;
+
+    /// Returns the number of molecules of species sidx in patch pidx.
+    ///
+    /// \param pidx Global index of the patch.
+    /// \param sidx Global index of the species.
+    double getPatchCountIdx(uint pidx, uint sidx) const;
+
+    /// Returns the number of molecules of species sidx in a voxel.
+    ///
+    /// \param tidx Index of the tetrahedron.
+    /// \param sidx Global index of the species.
+    double getTetCountIdx(uint tidx, uint sidx) const;
+
+    /// Sets the number of molecules of species sidx in a voxel.
+    ///
+    /// \param tidx Index of the tetrahedron.
+    /// \param sidx Global index of the species.
+    /// \param n Number of molecules of the species.
+    void setTetCountIdx(uint tidx, uint sidx, double n);
+
+    /// Returns the number of molecules of species sidx in a triangle.
+    ///
+    /// \param tidx Index of the triangle.
+    /// \param sidx Global index of the species.
+    double getTriCountIdx(uint tidx, uint sidx) const;
+
     ////////////////////////////////////////////////////////////////////////
     // SOLVER CONTROLS:
     //      COMPARTMENT
@@ -425,6 +477,56 @@ public:
     /// \param c Concentration of the species.
     void setTetConc(uint tidx, std::string const & s, double c);
 
+    /// Returns the number of molecules of species s in each of a list of
+    /// voxels, resolving the species and checking the mesh only once.
+    ///
+    /// \param tidcs Indices of the tetrahedrons.
+    /// \param s Name of the species.
+    std::vector<double> getBatchTetCounts(std::vector<uint> const & tidcs,
+                                          std::string const & s) const;
+
+    /// Sets the number of molecules of species s in each of a list of
+    /// voxels. Nothing is changed if an index or count is invalid.
+    ///
+    /// \param tidcs Indices of the tetrahedrons.
+    /// \param s Name of the species.
+    /// \param ns Number of molecules in each tetrahedron.
+    void setBatchTetCounts(std::vector<uint> const & tidcs,
+                           std::string const & s,
+                           std::vector<double> const & ns);
+
+    /// Returns the concentration (in molar units) of species s in each
+    /// of a list of voxels.
+    ///
+    /// \param tidcs Indices of the tetrahedrons.
+    /// \param s Name of the species.
+    std::vector<double> getBatchTetConcs(std::vector<uint> const & tidcs,
+                                         std::string const & s) const;
+
+    /// Sets the concentration (in molar units) of species s in each of a
+    /// list of voxels. Nothing is changed if an index or concentration
+    /// is invalid.
+    ///
+    /// \param tidcs Indices of the tetrahedrons.
+    /// \param s Name of the species.
+    /// \param cs Concentration in each tetrahedron.
+    void setBatchTetConcs(std::vector<uint> const & tidcs,
+                          std::string const & s,
+                          std::vector<double> const & cs);
+
+    /// Adds n molecules of species s to a list of voxels, placing each
+    /// one independently in voxel i with probability proportional to
+    /// density[i] times its volume (a multinomial draw), or to its volume
+    /// alone if density is empty. The counts are set as one batch.
+    ///
+    /// \param tidcs Indices of the tetrahedrons.
+    /// \param s Name of the species.
+    /// \param n Number of molecules to add.
+    /// \param density Relative density of the molecules in each tetrahedron.
+    void distributeTetCounts(std::vector<uint> const & tidcs,
+                             std::string const & s, double n,
+                             std::vector<double> const & density);
+
     /// Returns whether the concentration of species s in a voxel
     /// remains constant over time (unless changed explicitly).
     ///
@@ -453,6 +555,17 @@ public:
     /// \param kf Rate constant of the reaction.
     void setTetReacK(uint tidx, std::string const & r, double kf);
 
+    /// Sets the macroscopic reaction constant of reaction r in each of a
+    /// list of voxels, refreshing the propensities once for the whole
+    /// list. Nothing is changed if an index or constant is invalid.
+    ///
+    /// \param tidcs Indices of the tetrahedrons.
+    /// \param r Name of the reaction.
+    /// \param kfs Rate constant in each tetrahedron.
+    void setBatchTetReacKs(std::vector<uint> const & tidcs,
+                           std::string const & r,
+                           std::vector<double> const & kfs);
+
     /// Returns whether reaction r in a voxel is active or not
     ///
     /// \param tidx Index of the tetrahedron.
@@ -466,6 +579,15 @@ public:
     /// \param act Flag to activate or deactivate the reaction.
     void setTetReacActive(uint tidx, std::string const & r, bool act);
 
+    /// Activates/deactivates reaction r in each of a list of voxels,
+    /// refreshing the propensities once for the whole list.
+    ///
+    /// \param tidcs Indices of the tetrahedrons.
+    /// \param r Name of the reaction.
+    /// \param act Flag to activate or deactivate the reaction.
+    void setBatchTetReacActive(std::vector<uint> const & tidcs,
+                               std::string const & r, bool act);
+
     /// Returns the diffusion constant of diffusion rule d in a voxel.
     ///
     /// \param tidx Index of the tetrahedron.
@@ -479,6 +601,17 @@ public:
     /// \param dk Rate constant of the diffusion.
     void setTetDiffD(uint tidx, std::string const & d, double dk);
 
+    /// Sets the diffusion constant of diffusion rule d in each of a list
+    /// of voxels, refreshing the propensities once for the whole list.
+    /// Nothing is changed if an index or constant is invalid.
+    ///
+    /// \param tidcs Indices of the tetrahedrons.
+    /// \param d Name of the diffusion.
+    /// \param dks Diffusion constant in each tetrahedron.
+    void setBatchTetDiffDs(std::vector<uint> const & tidcs,
+                           std::string const & d,
+                           std::vector<double> const & dks);
+
     /// Returns whether diffusion rule d in a voxel is active or not.
     ///
     /// \param tidx Index of the tetrahedron.
@@ -492,6 +625,15 @@ public:
     /// \param act Flag to activate / deactivate the diffusion.
     void setTetDiffActive(uint tidx, std::string const & d, bool act);
 
+    /// Activates/deactivates diffusion rule d in each of a list of
+    /// voxels, refreshing the propensities once for the whole list.
+    ///
+    /// \param tidcs Indices of the tetrahedrons.
+    /// \param d Name of the diffusion.
+    /// \param act Flag to activate / deactivate the diffusion.
+    void setBatchTetDiffActive(std::vector<uint> const & tidcs,
+                               std::string const & d, bool act);
+
     ////////////////////////////////////////////////////////////////////////
 
     /// Returns c_mu, the mesoscopic reaction constant of reaction r in
@@ -773,6 +915,37 @@ public:
     /// \param n Number of molecules of the species.
     void setTriCount(uint tidx, std::string const & s, double n);
 
+    /// Returns the number of molecules of species s in each of a list of
+    /// triangles, resolving the species and checking the mesh only once.
+    ///
+    /// \param tidcs Indices of the triangles.
+    /// \param s Name of the species.
+    std::vector<double> getBatchTriCounts(std::vector<uint> const & tidcs,
+                                          std::string const & s) const;
+
+    /// Sets the number of molecules of species s in each of a list of
+    /// triangles. Nothing is changed if an index or count is invalid.
+    ///
+    /// \param tidcs Indices of the triangles.
+    /// \param s Name of the species.
+    /// \param ns Number of molecules in each triangle.
+    void setBatchTriCounts(std::vector<uint> const & tidcs,
+                           std::string const & s,
+                           std::vector<double> const & ns);
+
+    /// Adds n molecules of species s to a list of triangles, placing
+    /// each one independently in triangle i with probability proportional
+    /// to density[i] times its area, or to its area alone if density is
+    /// empty. The counts are set as one batch.
+    ///
+    /// \param tidcs Indices of the triangles.
+    /// \param s Name of the species.
+    /// \param n Number of molecules to add.
+    /// \param density Relative density of the molecules in each triangle.
+    void distributeTriCounts(std::vector<uint> const & tidcs,
+                             std::string const & s, double n,
+                             std::vector<double> const & density);
+
     /// Returns the amount (in mols) of species s in a triangle.
     ///
     /// \param tidx Index of the triangle.
@@ -815,6 +988,18 @@ public:
     /// \param kf Rate constant of the reaction.
     void setTriSReacK(uint tidx, std::string const & r, double kf);
 
+    /// Sets the macroscopic reaction constant of surface reaction r in
+    /// each of a list of triangles, refreshing the propensities once for
+    /// the whole list. Nothing is changed if an index or constant is
+    /// invalid.
+    ///
+    /// \param tidcs Indices of the triangles.
+    /// \param r name of the reaction.
+    /// \param kfs Rate constant in each triangle.
+    void setBatchTriSReacKs(std::vector<uint> const & tidcs,
+                            std::string const & r,
+                            std::vector<double> const & kfs);
+
     /// Returns whether surface reaction r in a triangle is active or not.
     ///
     /// \param tidx Index of the triangle.
@@ -828,6 +1013,15 @@ public:
     /// \param act Flag to activate / deactivate the reaction.
     void setTriSReacActive(uint tidx, std::string const & r, bool act);
 
+    /// Activates/inactivates surface reaction r in each of a list of
+    /// triangles, refreshing the propensities once for the whole list.
+    ///
+    /// \param tidcs Indices of the triangles.
+    /// \param r name of the reaction.
+    /// \param act Flag to activate / deactivate the reaction.
+    void setBatchTriSReacActive(std::vector<uint> const & tidcs,
+                                std::string const & r, bool act);
+
     ////////////////////////////////////////////////////////////////////////
 
     // Returns c_mu, the mesoscopic reaction constant of surface reaction r
@@ -958,6 +1152,11 @@ public:
     /// \param I Current in amperes.
     void setVertIClamp(uint vidx, double i);
 
+    /// Returns the potential in Volts of each of a list of vertices.
+    ///
+    /// \param vidcs Indices of the vertices.
+    std::vector<double> getBatchVertVs(std::vector<uint> const & vidcs) const;
+
     ////////////////////////////////////////////////////////////////////////
     // SOLVER CONTROL:
     //      MEMBRANES
@@ -987,9 +1186,83 @@ public:
 	void setMembRes(std::string const & m, double ro, double vrev);
 
     ////////////////////////////////////////////////////////////////////////
+    // FLUX COUNTERS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Start counting the events of reaction r in the tetrahedrons tets.
+    /// Returns the index of the counter, for takeFluxCount.
+    ///
+    uint addTetsReacFlux(std::vector<uint> const & tets, std::string const & r);
+
+    /// Start counting the events of surface reaction sr in the
+    /// triangles tris. Returns the index of the counter.
+    ///
+    uint addTrisSReacFlux(std::vector<uint> const & tris, std::string const & sr);
+
+    /// Start counting the net number of molecules of species s that
+    /// diffuse across the triangles tris, from the first tetrahedron of
+    /// each triangle (see Tetmesh::getTriTetNeighb) into the second.
+    /// Returns the index of the counter.
+    ///
+    uint addTrisDiffFlux(std::vector<uint> const & tris, std::string const & s);
+
+    /// Return the count of counter i since it was added or last taken,
+    /// and zero it.
+    ///
+    double takeFluxCount(uint i);
+
+    ////////////////////////////////////////////////////////////////////////
+    // REGIONS OF INTEREST
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Register a region of interest made of the tetrahedrons tets and
+    /// the triangles tris, whose species totals the solver keeps up to
+    /// date as counts change. Returns the index of the region.
+    ///
+    uint addROI(std::vector<uint> const & tets, std::vector<uint> const & tris);
+
+    /// Returns the number of molecules of species s in region roi.
+    ///
+    double getROICount(uint roi, std::string const & s) const;
+
+    /// Returns the number of molecules of species sidx in region roi.
+    ///
+    /// \param roi Index of the region (see addROI).
+    /// \param sidx Global index of the species.
+    double getROICountIdx(uint roi, uint sidx) const;
+
+    ////////////////////////////////////////////////////////////////////////
 
 protected:
 
+    /// Bracket a sequence of element setters (the batch setters): a
+    /// solver may defer refreshing its propensities from each setter to
+    /// _endBatch. Batches may nest. The defaults do nothing.
+    ///
+    virtual void _beginBatch(void);
+    virtual void _endBatch(void);
+
+    /// Replace weights, checked non-negative with a positive sum, by a
+    /// multinomial draw of n molecules with those relative probabilities;
+    /// a fractional part of n adds one molecule with that probability.
+    ///
+    void _multinomial(double n, std::vector<double> & weights);
+
+    /// The flux counters (see addTetsReacFlux); the indices are checked.
+    /// The defaults throw NotImplErr.
+    ///
+    virtual uint _addTetsReacFlux(std::vector<uint> const & tets, uint ridx);
+    virtual uint _addTrisSReacFlux(std::vector<uint> const & tris, uint sridx);
+    virtual uint _addTrisDiffFlux(std::vector<uint> const & tris, uint sidx);
+    virtual double _takeFluxCount(uint i);
+
+    /// The regions of interest (see addROI); the element and species
+    /// indices are checked. The defaults throw NotImplErr.
+    ///
+    virtual uint _addROI(std::vector<uint> const & tets,
+                         std::vector<uint> const & tris);
+    virtual double _getROICount(uint roi, uint sidx) const;
+
     ////////////////////////////////////////////////////////////////////////
     // SOLVER CONTROL:
     //      COMPARTMENT
@@ -1214,6 +1487,11 @@ protected:
 
 private:
 
+    // Writes the model and mesh description into its output files.
+    friend class Recorder;
+    // Applies SBML rules through the index-based methods.
+    friend class steps::sbml::Interface;
+
     ////////////////////////////////////////////////////////////////////////
 
     steps::model::Model *               pModel;
@@ -29,6 +29,7 @@
  */
 
 // STL headers.
+#include <cmath>
 #include <string>
 #include <sstream>
 
@@ -40,6 +41,7 @@
 #include "../rng/rng.hpp"
 #include "api.hpp"
 #include "statedef.hpp"
+#include "../geom/tetmesh.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -213,5 +215,364 @@ void API::setNSteps(uint nsteps)
 	throw steps::NotImplErr();
 }
 
+uint API::getSpecIdx(string const & id) const
+{
+	return pStatedef->getSpecIdx(id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::getCompIdx(string const & id) const
+{
+	return pStatedef->getCompIdx(id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::getPatchIdx(string const & id) const
+{
+	return pStatedef->getPatchIdx(id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::getReacIdx(string const & id) const
+{
+	return pStatedef->getReacIdx(id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::getSReacIdx(string const & id) const
+{
+	return pStatedef->getSReacIdx(id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double API::getCompCountIdx(uint cidx, uint sidx) const
+{
+	if (cidx >= pStatedef->countComps())
+	{
+		std::ostringstream os;
+		os << "Compartment index out of range.";
+		throw steps::ArgErr(os.str());
+	}
+	if (sidx >= pStatedef->countSpecs())
+	{
+		std::ostringstream os;
+		os << "Species index out of range.";
+		throw steps::ArgErr(os.str());
+	}
+
+	return _getCompCount(cidx, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double API::getPatchCountIdx(uint pidx, uint sidx) const
+{
+	if (pidx >= pStatedef->countPatches())
+	{
+		std::ostringstream os;
+		os << "Patch index out of range.";
+		throw steps::ArgErr(os.str());
+	}
+	if (sidx >= pStatedef->countSpecs())
+	{
+		std::ostringstream os;
+		os << "Species index out of range.";
+		throw steps::ArgErr(os.str());
+	}
+
+	return _getPatchCount(pidx, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double API::getTetCountIdx(uint tidx, uint sidx) const
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		if (tidx >= mesh->countTets())
+		{
+			std::ostringstream os;
+			os << "Tetrahedron index out of range.";
+			throw steps::ArgErr(os.str());
+		}
+		if (sidx >= pStatedef->countSpecs())
+		{
+			std::ostringstream os;
+			os << "Species index out of range.";
+			throw steps::ArgErr(os.str());
+		}
+
+		return _getTetCount(tidx, sidx);
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void API::setTetCountIdx(uint tidx, uint sidx, double n)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		if (tidx >= mesh->countTets())
+		{
+			std::ostringstream os;
+			os << "Tetrahedron index out of range.";
+			throw steps::ArgErr(os.str());
+		}
+		if (sidx >= pStatedef->countSpecs())
+		{
+			std::ostringstream os;
+			os << "Species index out of range.";
+			throw steps::ArgErr(os.str());
+		}
+		if (n < 0.0)
+		{
+			std::ostringstream os;
+			os << "Number of molecules cannot be negative.";
+			throw steps::ArgErr(os.str());
+		}
+
+		_setTetCount(tidx, sidx, n);
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double API::getTriCountIdx(uint tidx, uint sidx) const
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		if (tidx >= mesh->countTris())
+		{
+			std::ostringstream os;
+			os << "Triangle index out of range.";
+			throw steps::ArgErr(os.str());
+		}
+		if (sidx >= pStatedef->countSpecs())
+		{
+			std::ostringstream os;
+			os << "Species index out of range.";
+			throw steps::ArgErr(os.str());
+		}
+
+		return _getTriCount(tidx, sidx);
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Throw unless the geometry is a mesh and every index of elems is a
+/// tetrahedron of it (tets) or a triangle.
+///
+static void checkMeshElems(steps::wm::Geom * geom, std::vector<uint> const & elems,
+                           bool tets)
+{
+    steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom);
+    if (mesh == 0)
+    {
+        std::ostringstream os;
+        os << "Method not available for this solver.";
+        throw steps::NotImplErr(os.str());
+    }
+    uint n = (tets == true ? mesh->countTets() : mesh->countTris());
+    for (uint i = 0; i < elems.size(); ++i)
+    {
+        if (elems[i] >= n)
+        {
+            std::ostringstream os;
+            os << (tets == true ? "Tetrahedron" : "Triangle");
+            os << " index out of range.";
+            throw steps::ArgErr(os.str());
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::addTetsReacFlux(std::vector<uint> const & tets, string const & r)
+{
+    checkMeshElems(geom(), tets, true);
+    // the following may throw exception if string is unknown
+    uint ridx = pStatedef->getReacIdx(r);
+    return _addTetsReacFlux(tets, ridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::addTrisSReacFlux(std::vector<uint> const & tris, string const & sr)
+{
+    checkMeshElems(geom(), tris, false);
+    uint sridx = pStatedef->getSReacIdx(sr);
+    return _addTrisSReacFlux(tris, sridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::addTrisDiffFlux(std::vector<uint> const & tris, string const & s)
+{
+    checkMeshElems(geom(), tris, false);
+    uint sidx = pStatedef->getSpecIdx(s);
+    return _addTrisDiffFlux(tris, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double API::takeFluxCount(uint i)
+{
+    return _takeFluxCount(i);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::addROI(std::vector<uint> const & tets, std::vector<uint> const & tris)
+{
+    checkMeshElems(geom(), tets, true);
+    checkMeshElems(geom(), tris, false);
+    return _addROI(tets, tris);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double API::getROICount(uint roi, string const & s) const
+{
+    // the following may throw exception if string is unknown
+    uint sidx = pStatedef->getSpecIdx(s);
+    return _getROICount(roi, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double API::getROICountIdx(uint roi, uint sidx) const
+{
+    if (sidx >= pStatedef->countSpecs())
+    {
+        std::ostringstream os;
+        os << "Species index out of range.";
+        throw steps::ArgErr(os.str());
+    }
+    return _getROICount(roi, sidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::_addTetsReacFlux(std::vector<uint> const & tets, uint ridx)
+{
+    throw steps::NotImplErr();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::_addTrisSReacFlux(std::vector<uint> const & tris, uint sridx)
+{
+    throw steps::NotImplErr();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::_addTrisDiffFlux(std::vector<uint> const & tris, uint sidx)
+{
+    throw steps::NotImplErr();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double API::_takeFluxCount(uint i)
+{
+    throw steps::NotImplErr();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint API::_addROI(std::vector<uint> const & tets, std::vector<uint> const & tris)
+{
+    throw steps::NotImplErr();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double API::_getROICount(uint roi, uint sidx) const
+{
+    throw steps::NotImplErr();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void API::_beginBatch(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void API::_endBatch(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void API::_multinomial(double n, std::vector<double> & weights)
+{
+	double total = 0.0;
+	uint nw = weights.size();
+	for (uint i = 0; i < nw; ++i)
+	{
+		if (weights[i] < 0.0)
+		{
+			std::ostringstream os;
+			os << "Density cannot be negative.";
+			throw steps::ArgErr(os.str());
+		}
+		total += weights[i];
+	}
+	if (total <= 0.0 && n > 0.0)
+	{
+		std::ostringstream os;
+		os << "Density must be positive somewhere.";
+		throw steps::ArgErr(os.str());
+	}
+
+	uint c = static_cast<uint>(std::floor(n));
+	if (n - c > 0.0 && pRNG->getUnfIE() < n - c) ++c;
+
+	// Each element takes a binomial share of the molecules left, with the
+	// probability of its weight among the weights left.
+	for (uint i = 0; i < nw; ++i)
+	{
+		double w = weights[i];
+		uint k = 0;
+		if (c > 0 && w > 0.0)
+		{
+			k = (w >= total) ? c : pRNG->getBinom(c, w / total);
+		}
+		c -= k;
+		total -= w;
+		weights[i] = k;
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // END
@@ -293,6 +293,256 @@ void API::setTetConc(uint tidx, string const & s, double c)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::vector<double> API::getBatchTetCounts(std::vector<uint> const & tidcs,
+                                           string const & s) const
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint ntets = mesh->countTets();
+		uint n = tidcs.size();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= ntets)
+			{
+				std::ostringstream os;
+				os << "Tetrahedron index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint sidx = pStatedef->getSpecIdx(s);
+
+		std::vector<double> vals(n);
+		for (uint i = 0; i < n; ++i)
+		{
+			vals[i] = _getTetCount(tidcs[i], sidx);
+		}
+		return vals;
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void API::setBatchTetCounts(std::vector<uint> const & tidcs, string const & s,
+                            std::vector<double> const & ns)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint n = tidcs.size();
+		if (ns.size() != n)
+		{
+			std::ostringstream os;
+			os << "Length of values list does not match the number of indices.";
+			throw steps::ArgErr(os.str());
+		}
+		uint ntets = mesh->countTets();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= ntets)
+			{
+				std::ostringstream os;
+				os << "Tetrahedron index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+			if (ns[i] < 0.0)
+			{
+				std::ostringstream os;
+				os << "Number of molecules cannot be negative.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint sidx = pStatedef->getSpecIdx(s);
+
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < n; ++i)
+			{
+				_setTetCount(tidcs[i], sidx, ns[i]);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> API::getBatchTetConcs(std::vector<uint> const & tidcs,
+                                          string const & s) const
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint ntets = mesh->countTets();
+		uint n = tidcs.size();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= ntets)
+			{
+				std::ostringstream os;
+				os << "Tetrahedron index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint sidx = pStatedef->getSpecIdx(s);
+
+		std::vector<double> vals(n);
+		for (uint i = 0; i < n; ++i)
+		{
+			vals[i] = _getTetConc(tidcs[i], sidx);
+		}
+		return vals;
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void API::setBatchTetConcs(std::vector<uint> const & tidcs, string const & s,
+                           std::vector<double> const & cs)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint n = tidcs.size();
+		if (cs.size() != n)
+		{
+			std::ostringstream os;
+			os << "Length of values list does not match the number of indices.";
+			throw steps::ArgErr(os.str());
+		}
+		uint ntets = mesh->countTets();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= ntets)
+			{
+				std::ostringstream os;
+				os << "Tetrahedron index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+			if (cs[i] < 0.0)
+			{
+				std::ostringstream os;
+				os << "Concentration cannot be negative.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint sidx = pStatedef->getSpecIdx(s);
+
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < n; ++i)
+			{
+				_setTetConc(tidcs[i], sidx, cs[i]);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void API::distributeTetCounts(std::vector<uint> const & tidcs, string const & s,
+                              double n, std::vector<double> const & density)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint ntidcs = tidcs.size();
+		if (density.empty() == false && density.size() != ntidcs)
+		{
+			std::ostringstream os;
+			os << "Length of density list does not match the number of indices.";
+			throw steps::ArgErr(os.str());
+		}
+		if (n < 0.0)
+		{
+			std::ostringstream os;
+			os << "Number of molecules cannot be negative.";
+			throw steps::ArgErr(os.str());
+		}
+		uint ntets = mesh->countTets();
+		std::vector<double> counts(ntidcs);
+		for (uint i = 0; i < ntidcs; ++i)
+		{
+			if (tidcs[i] >= ntets)
+			{
+				std::ostringstream os;
+				os << "Tetrahedron index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+			counts[i] = mesh->getTetVol(tidcs[i]);
+			if (density.empty() == false) counts[i] *= density[i];
+		}
+		// the following may throw exception if string is unknown
+		uint sidx = pStatedef->getSpecIdx(s);
+
+		_multinomial(n, counts);
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < ntidcs; ++i)
+			{
+				if (counts[i] == 0.0) continue;
+				_setTetCount(tidcs[i], sidx, _getTetCount(tidcs[i], sidx) + counts[i]);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool API::getTetClamped(uint tidx, string const & s) const
 {
 	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
@@ -403,6 +653,63 @@ void API::setTetReacK(uint tidx, string const & r, double kf)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void API::setBatchTetReacKs(std::vector<uint> const & tidcs, string const & r,
+                           std::vector<double> const & kfs)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint n = tidcs.size();
+		if (kfs.size() != n)
+		{
+			std::ostringstream os;
+			os << "Length of values list does not match the number of indices.";
+			throw steps::ArgErr(os.str());
+		}
+		uint nelems = mesh->countTets();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= nelems)
+			{
+				std::ostringstream os;
+				os << "Tetrahedron index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+			if (kfs[i] < 0.0)
+			{
+				std::ostringstream os;
+				os << "Reaction constant cannot be negative.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint idx = pStatedef->getReacIdx(r);
+
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < n; ++i)
+			{
+				_setTetReacK(tidcs[i], idx, kfs[i]);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool API::getTetReacActive(uint tidx, string const & r) const
 {
 	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
@@ -455,6 +762,51 @@ void API::setTetReacActive(uint tidx, string const & r, bool act)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void API::setBatchTetReacActive(std::vector<uint> const & tidcs, string const & r,
+                               bool act)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint n = tidcs.size();
+		uint nelems = mesh->countTets();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= nelems)
+			{
+				std::ostringstream os;
+				os << "Tetrahedron index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint idx = pStatedef->getReacIdx(r);
+
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < n; ++i)
+			{
+				_setTetReacActive(tidcs[i], idx, act);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 double API::getTetDiffD(uint tidx, string const & d) const
 {
 	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
@@ -513,6 +865,63 @@ void API::setTetDiffD(uint tidx, string const & d, double dk)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void API::setBatchTetDiffDs(std::vector<uint> const & tidcs, string const & d,
+                           std::vector<double> const & dks)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint n = tidcs.size();
+		if (dks.size() != n)
+		{
+			std::ostringstream os;
+			os << "Length of values list does not match the number of indices.";
+			throw steps::ArgErr(os.str());
+		}
+		uint nelems = mesh->countTets();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= nelems)
+			{
+				std::ostringstream os;
+				os << "Tetrahedron index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+			if (dks[i] < 0.0)
+			{
+				std::ostringstream os;
+				os << "Diffusion constant cannot be negative.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint idx = pStatedef->getDiffIdx(d);
+
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < n; ++i)
+			{
+				_setTetDiffD(tidcs[i], idx, dks[i]);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool API::getTetDiffActive(uint tidx, string const & d) const
 {
 	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
@@ -566,6 +975,51 @@ void API::setTetDiffActive(uint tidx, string const & d, bool act)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void API::setBatchTetDiffActive(std::vector<uint> const & tidcs, string const & d,
+                               bool act)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint n = tidcs.size();
+		uint nelems = mesh->countTets();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= nelems)
+			{
+				std::ostringstream os;
+				os << "Tetrahedron index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint idx = pStatedef->getDiffIdx(d);
+
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < n; ++i)
+			{
+				_setTetDiffActive(tidcs[i], idx, act);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 double API::getTetReacH(uint tidx, string const & r) const
 {
 	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
@@ -177,6 +177,162 @@ void API::setTriCount(uint tidx, string const & s, double n)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::vector<double> API::getBatchTriCounts(std::vector<uint> const & tidcs,
+                                           string const & s) const
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint ntris = mesh->countTris();
+		uint n = tidcs.size();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= ntris)
+			{
+				std::ostringstream os;
+				os << "Triangle index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint sidx = pStatedef->getSpecIdx(s);
+
+		std::vector<double> vals(n);
+		for (uint i = 0; i < n; ++i)
+		{
+			vals[i] = _getTriCount(tidcs[i], sidx);
+		}
+		return vals;
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void API::setBatchTriCounts(std::vector<uint> const & tidcs, string const & s,
+                            std::vector<double> const & ns)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint n = tidcs.size();
+		if (ns.size() != n)
+		{
+			std::ostringstream os;
+			os << "Length of values list does not match the number of indices.";
+			throw steps::ArgErr(os.str());
+		}
+		uint ntris = mesh->countTris();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= ntris)
+			{
+				std::ostringstream os;
+				os << "Triangle index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+			if (ns[i] < 0.0)
+			{
+				std::ostringstream os;
+				os << "Number of molecules cannot be negative.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint sidx = pStatedef->getSpecIdx(s);
+
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < n; ++i)
+			{
+				_setTriCount(tidcs[i], sidx, ns[i]);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void API::distributeTriCounts(std::vector<uint> const & tidcs, string const & s,
+                              double n, std::vector<double> const & density)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint ntidcs = tidcs.size();
+		if (density.empty() == false && density.size() != ntidcs)
+		{
+			std::ostringstream os;
+			os << "Length of density list does not match the number of indices.";
+			throw steps::ArgErr(os.str());
+		}
+		if (n < 0.0)
+		{
+			std::ostringstream os;
+			os << "Number of molecules cannot be negative.";
+			throw steps::ArgErr(os.str());
+		}
+		uint ntris = mesh->countTris();
+		std::vector<double> counts(ntidcs);
+		for (uint i = 0; i < ntidcs; ++i)
+		{
+			if (tidcs[i] >= ntris)
+			{
+				std::ostringstream os;
+				os << "Triangle index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+			counts[i] = mesh->getTriArea(tidcs[i]);
+			if (density.empty() == false) counts[i] *= density[i];
+		}
+		// the following may throw exception if string is unknown
+		uint sidx = pStatedef->getSpecIdx(s);
+
+		_multinomial(n, counts);
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < ntidcs; ++i)
+			{
+				if (counts[i] == 0.0) continue;
+				_setTriCount(tidcs[i], sidx, _getTriCount(tidcs[i], sidx) + counts[i]);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 double API::getTriAmount(uint tidx, string const & s) const
 {
 	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
@@ -345,6 +501,63 @@ void API::setTriSReacK(uint tidx, string const & r, double kf)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void API::setBatchTriSReacKs(std::vector<uint> const & tidcs, string const & r,
+                            std::vector<double> const & kfs)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint n = tidcs.size();
+		if (kfs.size() != n)
+		{
+			std::ostringstream os;
+			os << "Length of values list does not match the number of indices.";
+			throw steps::ArgErr(os.str());
+		}
+		uint nelems = mesh->countTris();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= nelems)
+			{
+				std::ostringstream os;
+				os << "Triangle index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+			if (kfs[i] < 0.0)
+			{
+				std::ostringstream os;
+				os << "Reaction constant cannot be negative.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint idx = pStatedef->getSReacIdx(r);
+
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < n; ++i)
+			{
+				_setTriSReacK(tidcs[i], idx, kfs[i]);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool API::getTriSReacActive(uint tidx, string const & r) const
 {
 	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
@@ -398,6 +611,51 @@ void API::setTriSReacActive(uint tidx, string const & r, bool act)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void API::setBatchTriSReacActive(std::vector<uint> const & tidcs, string const & r,
+                                bool act)
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint n = tidcs.size();
+		uint nelems = mesh->countTris();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (tidcs[i] >= nelems)
+			{
+				std::ostringstream os;
+				os << "Triangle index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+		// the following may throw exception if string is unknown
+		uint idx = pStatedef->getSReacIdx(r);
+
+		_beginBatch();
+		try
+		{
+			for (uint i = 0; i < n; ++i)
+			{
+				_setTriSReacActive(tidcs[i], idx, act);
+			}
+		}
+		catch (...)
+		{
+			_endBatch();
+			throw;
+		}
+		_endBatch();
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 double API::getTriSReacH(uint tidx, string const & r) const
 {
 	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
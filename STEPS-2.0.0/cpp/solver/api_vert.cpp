@@ -155,6 +155,40 @@ void API::setVertIClamp(uint vidx, double i)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::vector<double> API::getBatchVertVs(std::vector<uint> const & vidcs) const
+{
+	if (steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom()))
+	{
+		uint nverts = mesh->countVertices();
+		uint n = vidcs.size();
+		for (uint i = 0; i < n; ++i)
+		{
+			if (vidcs[i] >= nverts)
+			{
+				std::ostringstream os;
+				os << "Vertex index out of range.";
+				throw steps::ArgErr(os.str());
+			}
+		}
+
+		std::vector<double> vals(n);
+		for (uint i = 0; i < n; ++i)
+		{
+			vals[i] = _getVertV(vidcs[i]);
+		}
+		return vals;
+	}
+
+	else
+	{
+		std::ostringstream os;
+		os << "Method not available for this solver.";
+		throw steps::NotImplErr();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 double API::_getVertV(uint vidx) const
 {
     throw steps::NotImplErr();
@@ -72,7 +72,7 @@ ssolver::Chandef::~Chandef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Chandef::checkpoint(std::fstream & cp_file)
+void ssolver::Chandef::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pNChanStates, sizeof(uint));
     cp_file.write((char*)pChanStates, sizeof(uint) * pNChanStates);
@@ -80,7 +80,7 @@ void ssolver::Chandef::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Chandef::restore(std::fstream & cp_file)
+void ssolver::Chandef::restore(std::iostream & cp_file)
 {
     if (pNChanStates > 0) delete[] pChanStates;
 
@@ -114,6 +114,13 @@ void ssolver::Chandef::setup(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::Chandef::getMemoryUsage(void) const
+{
+    return sizeof(Chandef) + pNChanStates * sizeof(uint);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 
 // END
 
@@ -32,6 +32,7 @@
 #include <string>
 #include <cassert>
 #include <algorithm>
+#include <vector>
 
 // STEPS headers.
 #include "../common.h"
@@ -50,6 +51,56 @@ NAMESPACE_ALIAS(steps::solver, ssolver);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Store the columns and values of the nonzero entries of the nrows x ncols
+// table upd, row by row: the entries of row r are at positions start[r] to
+// start[r+1]-1 of cols and vals.
+template <typename T>
+static void nonzero_cols(T const * upd, uint nrows, uint ncols,
+                         uint *& start, uint *& cols, T *& vals)
+{
+    start = new uint[nrows + 1];
+    start[0] = 0;
+    for (uint r = 0; r < nrows; ++r)
+    {
+        start[r + 1] = start[r];
+        for (uint c = 0; c < ncols; ++c)
+        {
+            if (upd[(r * ncols) + c] != 0) ++start[r + 1];
+        }
+    }
+    cols = new uint[start[nrows]];
+    vals = new T[start[nrows]];
+    uint i = 0;
+    for (uint r = 0; r < nrows; ++r)
+    {
+        for (uint c = 0; c < ncols; ++c)
+        {
+            T v = upd[(r * ncols) + c];
+            if (v == 0) continue;
+            cols[i] = c;
+            vals[i] = v;
+            ++i;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The entry in column col of row row of a table stored by nonzero_cols,
+// or zero.
+template <typename T>
+static T nonzero_at(uint const * start, uint const * cols, T const * vals,
+                    uint row, uint col)
+{
+    uint const * bgn = cols + start[row];
+    uint const * end = cols + start[row + 1];
+    uint const * c = std::lower_bound(bgn, end, col);
+    if (c == end || *c != col) return 0;
+    return vals[c - cols];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 ssolver::Compdef::Compdef(Statedef * sd, uint idx, steps::wm::Comp * c)
 : pStatedef(sd)
 , pIdx(idx)
@@ -69,13 +120,23 @@ ssolver::Compdef::Compdef(Statedef * sd, uint idx, steps::wm::Comp * c)
 , pReacsN(0)
 , pReac_G2L(0)
 , pReac_L2G(0)
-, pReac_DEP_Spec(0)
 , pReac_LHS_Spec(0)
 , pReac_UPD_Spec(0)
+, pReac_DEPSpec_Start(0)
+, pReac_DEPSpec(0)
+, pReac_DEPVal(0)
+, pReac_LHSSpec_Start(0)
+, pReac_LHSSpec(0)
+, pReac_LHSOrder(0)
+, pReac_UPDSpec_Start(0)
+, pReac_UPDSpec(0)
+, pReac_UPDDelta(0)
 , pDiffsN(0)
 , pDiff_G2L(0)
 , pDiff_L2G(0)
-, pDiff_DEP_Spec(0)
+, pDiff_DEPSpec_Start(0)
+, pDiff_DEPSpec(0)
+, pDiff_DEPVal(0)
 , pDiff_LIG(0)
 {
     assert(pStatedef != 0);
@@ -125,9 +186,17 @@ ssolver::Compdef::~Compdef(void)
     if (pReacsN != 0)
     {
     	delete[] pReac_L2G;
-    	delete[] pReac_DEP_Spec;
     	delete[] pReac_LHS_Spec;
     	delete[] pReac_UPD_Spec;
+    	delete[] pReac_DEPSpec_Start;
+    	delete[] pReac_DEPSpec;
+    	delete[] pReac_DEPVal;
+    	delete[] pReac_LHSSpec_Start;
+    	delete[] pReac_LHSSpec;
+    	delete[] pReac_LHSOrder;
+    	delete[] pReac_UPDSpec_Start;
+    	delete[] pReac_UPDSpec;
+    	delete[] pReac_UPDDelta;
     	delete[] pReacKcst;
     	delete[] pReacFlags;
     }
@@ -135,7 +204,9 @@ ssolver::Compdef::~Compdef(void)
     if (pDiffsN != 0)
     {
     	delete[] pDiff_L2G;
-    	delete[] pDiff_DEP_Spec;
+    	delete[] pDiff_DEPSpec_Start;
+    	delete[] pDiff_DEPSpec;
+    	delete[] pDiff_DEPVal;
     	delete[] pDiff_LIG;
     	delete[] pDiffDcst;
 
@@ -145,7 +216,7 @@ ssolver::Compdef::~Compdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Compdef::checkpoint(std::fstream & cp_file)
+void ssolver::Compdef::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)pPoolCount, sizeof(double) * pSpecsN);
     cp_file.write((char*)pPoolFlags, sizeof(uint) * pSpecsN);
@@ -155,7 +226,7 @@ void ssolver::Compdef::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Compdef::restore(std::fstream & cp_file)
+void ssolver::Compdef::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)pPoolCount, sizeof(double) * pSpecsN);
     cp_file.read((char*)pPoolFlags, sizeof(uint) * pSpecsN);
@@ -189,7 +260,7 @@ void ssolver::Compdef::setup_references()
     for(std::set<std::string>::const_iterator v = pCvsys.begin();
 		v != v_end; ++v)
     {
-    	std::map<std::string, steps::model::Reac *> vreacs = pStatedef->model()->getVolsys(*v)->_getAllReacs();
+    	std::map<std::string, steps::model::Reac *> const & vreacs = pStatedef->model()->getVolsys(*v)->_getAllReacs();
     	if (ngreacs == 0) assert(vreacs.empty() == true);
 		std::map<std::string, steps::model::Reac*>::const_iterator r_end = vreacs.end();
        	for (std::map<std::string, steps::model::Reac*>::const_iterator r = vreacs.begin(); r != r_end; ++r)
@@ -199,7 +270,7 @@ void ssolver::Compdef::setup_references()
        		if (pReac_G2L[gidx] != LIDX_UNDEFINED) continue;
        		pReac_G2L[gidx] = pReacsN++;
       	}
-       	std::map<std::string, steps::model::Diff *> vdiffs = pStatedef->model()->getVolsys(*v)->_getAllDiffs();
+       	std::map<std::string, steps::model::Diff *> const & vdiffs = pStatedef->model()->getVolsys(*v)->_getAllDiffs();
     	if (ngdiffs == 0) assert(vdiffs.empty() == true);
        	std::map<std::string, steps::model::Diff*>::const_iterator d_end = vdiffs.end();
        	for (std::map<std::string, steps::model::Diff*>::const_iterator d = vdiffs.begin(); d != d_end; ++d)
@@ -220,9 +291,10 @@ void ssolver::Compdef::setup_references()
     	if (pReac_G2L[r] == LIDX_UNDEFINED) continue;
     	Reacdef * rdef = pStatedef->reacdef(r);
     	assert (rdef != 0);
-    	for (uint s = 0; s < ngspecs; ++s)
+    	gidxTVecCI s_end = rdef->endReqColl();
+    	for (gidxTVecCI s = rdef->bgnReqColl(); s != s_end; ++s)
     	{
-    		if (rdef->reqspec(s) == true) addSpec(s);
+    		addSpec(*s);
     	}
     }
     for (uint d = 0; d < ngdiffs; ++d)
@@ -230,10 +302,8 @@ void ssolver::Compdef::setup_references()
     	if (pDiff_G2L[d] == LIDX_UNDEFINED) continue;
     	Diffdef * ddef = pStatedef->diffdef(d);
     	assert (ddef != 0);
-    	for (uint s = 0; s < ngspecs; ++s)
-    	{
-    		if (ddef->reqspec(s) == true) addSpec(s);
-    	}
+    	// The ligand is the only species a diffusion rule references.
+    	addSpec(ddef->lig());
     }
 
     pSetupRefsdone = true;
@@ -272,27 +342,33 @@ void ssolver::Compdef::setup_indices(void)
     		pReac_L2G[lidx] = i;
     	}
     	uint arrsize = pSpecsN * pReacsN;
-    	pReac_DEP_Spec = new int[arrsize];
+    	std::vector<int> dep(arrsize, 0);
     	pReac_LHS_Spec = new uint[arrsize];
     	pReac_UPD_Spec = new int[arrsize];
-        std::fill_n(pReac_DEP_Spec, arrsize, 0);
         std::fill_n(pReac_LHS_Spec, arrsize, 0);
         std::fill_n(pReac_UPD_Spec, arrsize, 0);
         for(uint ri = 0; ri < pReacsN; ++ri)
         {
         	Reacdef * rdef = reacdef(ri);
-        	for (uint si = 0; si < ngspecs; ++si)
+        	gidxTVecCI s_end = rdef->endReqColl();
+        	for (gidxTVecCI s = rdef->bgnReqColl(); s != s_end; ++s)
         	{
-        		if (rdef->reqspec(si) == false) continue;
+        		uint si = *s;
         		uint sil = pSpec_G2L[si];
         		assert(sil != LIDX_UNDEFINED);
 
         		uint aridx = _IDX_Reac_Spec(ri, sil);
-        		pReac_DEP_Spec[aridx] = rdef->dep(si);
+        		dep[aridx] = rdef->dep(si);
         		pReac_LHS_Spec[aridx] = rdef->lhs(si);
         		pReac_UPD_Spec[aridx] = rdef->upd(si);
         	}
         }
+        nonzero_cols(pReac_UPD_Spec, pReacsN, pSpecsN,
+                     pReac_UPDSpec_Start, pReac_UPDSpec, pReac_UPDDelta);
+        nonzero_cols(pReac_LHS_Spec, pReacsN, pSpecsN,
+                     pReac_LHSSpec_Start, pReac_LHSSpec, pReac_LHSOrder);
+        nonzero_cols(dep.empty() ? 0 : &dep[0], pReacsN, pSpecsN,
+                     pReac_DEPSpec_Start, pReac_DEPSpec, pReac_DEPVal);
     }
 
     if (pDiffsN != 0)
@@ -306,8 +382,7 @@ void ssolver::Compdef::setup_indices(void)
     	}
 
     	uint arrsize = pSpecsN * pDiffsN;
-    	pDiff_DEP_Spec = new uint[arrsize];
-    	std::fill_n(pDiff_DEP_Spec, arrsize, 0);
+    	std::vector<uint> dep(arrsize, 0);
     	pDiff_LIG = new uint[pDiffsN];
     	for (uint di = 0; di < pDiffsN; ++di)
     	{
@@ -319,9 +394,11 @@ void ssolver::Compdef::setup_indices(void)
     			uint sil = pSpec_G2L[si];
     			assert(sil != LIDX_UNDEFINED);
     			uint aridx = _IDX_Diff_Spec(di, sil);
-    			pDiff_DEP_Spec[aridx] = ddef->dep(si);
+    			dep[aridx] = ddef->dep(si);
     		}
     	}
+    	nonzero_cols(dep.empty() ? 0 : &dep[0], pDiffsN, pSpecsN,
+    	             pDiff_DEPSpec_Start, pDiff_DEPSpec, pDiff_DEPVal);
     }
 
     // Initialise the pools and flags members to zeros.
@@ -503,18 +580,100 @@ int * ssolver::Compdef::reac_upd_end(uint rlidx) const
 	assert (rlidx < pReacsN);
 	return pReac_UPD_Spec + ((rlidx+1) * pSpecsN);
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Compdef::reac_updspec_bgn(uint rlidx) const
+{
+	assert (rlidx < pReacsN);
+	return pReac_UPDSpec + pReac_UPDSpec_Start[rlidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Compdef::reac_updspec_end(uint rlidx) const
+{
+	assert (rlidx < pReacsN);
+	return pReac_UPDSpec + pReac_UPDSpec_Start[rlidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int * ssolver::Compdef::reac_upddelta_bgn(uint rlidx) const
+{
+	assert (rlidx < pReacsN);
+	return pReac_UPDDelta + pReac_UPDSpec_Start[rlidx];
+}
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Compdef::reac_lhsspec_bgn(uint rlidx) const
+{
+	assert (rlidx < pReacsN);
+	return pReac_LHSSpec + pReac_LHSSpec_Start[rlidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Compdef::reac_lhsspec_end(uint rlidx) const
+{
+	assert (rlidx < pReacsN);
+	return pReac_LHSSpec + pReac_LHSSpec_Start[rlidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Compdef::reac_lhsorder_bgn(uint rlidx) const
+{
+	assert (rlidx < pReacsN);
+	return pReac_LHSOrder + pReac_LHSSpec_Start[rlidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Compdef::reac_depspec_bgn(uint rlidx) const
+{
+	assert (rlidx < pReacsN);
+	return pReac_DEPSpec + pReac_DEPSpec_Start[rlidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Compdef::reac_depspec_end(uint rlidx) const
+{
+	assert (rlidx < pReacsN);
+	return pReac_DEPSpec + pReac_DEPSpec_Start[rlidx + 1];
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 int ssolver::Compdef::reac_dep(uint rlidx, uint slidx) const
 {
-	return pReac_DEP_Spec[slidx + ((rlidx) * pSpecsN)];
+	assert (rlidx < pReacsN);
+	return nonzero_at(pReac_DEPSpec_Start, pReac_DEPSpec, pReac_DEPVal,
+	                  rlidx, slidx);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 uint ssolver::Compdef::diff_dep(uint dlidx, uint slidx) const
 {
-	return pDiff_DEP_Spec[slidx + ((dlidx) * pSpecsN)];
+	assert (dlidx < pDiffsN);
+	return nonzero_at(pDiff_DEPSpec_Start, pDiff_DEPSpec, pDiff_DEPVal,
+	                  dlidx, slidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Compdef::diff_depspec_bgn(uint dlidx) const
+{
+	return pDiff_DEPSpec + pDiff_DEPSpec_Start[dlidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Compdef::diff_depspec_end(uint dlidx) const
+{
+	return pDiff_DEPSpec + pDiff_DEPSpec_Start[dlidx + 1];
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -570,4 +729,29 @@ ssolver::Diffdef * ssolver::Compdef::diffdef(uint dlidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::Compdef::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(Compdef);
+
+    // Global to local and local to global index tables.
+    bytes += (pStatedef->countSpecs() + pStatedef->countReacs()
+              + pStatedef->countDiffs()) * sizeof(uint);
+    bytes += (pSpecsN + pReacsN + pDiffsN) * sizeof(uint);
+
+    bytes += pSpecsN * (sizeof(double) + sizeof(uint));
+    bytes += pReacsN * (sizeof(double) + sizeof(uint));
+    bytes += pReacsN * pSpecsN * (2 * sizeof(int) + sizeof(uint));
+    if (pReacsN != 0)
+    {
+        bytes += (pReacsN + 1) * sizeof(uint);
+        bytes += pReac_UPDSpec_Start[pReacsN] * (sizeof(uint) + sizeof(int));
+    }
+    bytes += pDiffsN * (sizeof(double) + (pSpecsN + 1) * sizeof(uint));
+
+    bytes += (pIPatches.capacity() + pOPatches.capacity()) * sizeof(Patchdef *);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
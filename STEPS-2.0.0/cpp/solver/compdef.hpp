@@ -80,10 +80,13 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by this object and its tables.
+    std::size_t getMemoryUsage(void) const;
 
 
     ////////////////////////////////////////////////////////////////////////
@@ -152,6 +155,12 @@ public:
 	inline uint specG2L(uint gidx) const
 	{ return pSpec_G2L[gidx]; }
 
+	/// Return the global species index for local index argument.
+    ///
+    /// \param lidx Local index of the species.
+	inline uint specL2G(uint lidx) const
+	{ return pSpec_L2G[lidx]; }
+
 	/// Returns pointer to flags on species for this compartment.
 	inline uint * flags(void) const
 	{ return pPoolFlags; }
@@ -224,6 +233,48 @@ public:
     /// \param rlidx Local index of the reaction.
 	int * reac_upd_end(uint rlidx) const;
 
+	/// Return the beginning of the list of local indices of the species
+	/// that reaction specified by local index argument changes, i.e. the
+	/// nonzero entries of its update array, in increasing order.
+    ///
+    /// \param rlidx Local index of the reaction.
+	uint * reac_updspec_bgn(uint rlidx) const;
+
+	/// Return the end of the list of species changed by reaction
+	/// specified by local index argument.
+    ///
+    /// \param rlidx Local index of the reaction.
+	uint * reac_updspec_end(uint rlidx) const;
+
+	/// Return the beginning of the changes in the species listed by
+	/// reac_updspec_bgn, in the same order, for reaction specified by
+	/// local index argument.
+    ///
+    /// \param rlidx Local index of the reaction.
+	int * reac_upddelta_bgn(uint rlidx) const;
+
+	/// Return the beginning and end of the list of local indices of the
+	/// species on the lhs of reaction specified by local index argument,
+	/// i.e. the nonzero entries of its lhs array, in increasing order.
+    ///
+    /// \param rlidx Local index of the reaction.
+	uint * reac_lhsspec_bgn(uint rlidx) const;
+	uint * reac_lhsspec_end(uint rlidx) const;
+
+	/// Return the beginning of the lhs entries (the orders) of the species
+	/// listed by reac_lhsspec_bgn, in the same order.
+    ///
+    /// \param rlidx Local index of the reaction.
+	uint * reac_lhsorder_bgn(uint rlidx) const;
+
+	/// Return the beginning and end of the list of local indices of the
+	/// species that reaction specified by local index argument depends
+	/// on, in increasing order.
+    ///
+    /// \param rlidx Local index of the reaction.
+	uint * reac_depspec_bgn(uint rlidx) const;
+	uint * reac_depspec_end(uint rlidx) const;
+
 	/// Return the local index of species of reaction specified by
 	/// local index argument.
     ///
@@ -300,6 +351,14 @@ public:
     /// \todo make sure this is correct.
 	uint diff_dep(uint dlidx, uint slidx) const;
 
+	/// Return the beginning and end of the list of local indices of the
+	/// species that diffusion rule specified by local index argument
+	/// depends on.
+    ///
+    /// \param dlidx Local index of the diffusion rule.
+	uint * diff_depspec_bgn(uint dlidx) const;
+	uint * diff_depspec_end(uint dlidx) const;
+
     /// Return the rate constant of diffusion by local index argument.
     ///
     /// \param dlidx Local index of the diffusion.
@@ -384,9 +443,22 @@ private:
 	inline uint _IDX_Reac_Spec(uint reac, uint spec) const
 	{ return (pSpecsN * reac) + spec; }
 
-	int                               * pReac_DEP_Spec;
 	uint                              * pReac_LHS_Spec;
 	int                               * pReac_UPD_Spec;
+	// The dependencies and lhs entries in the same sparse form as the
+	// update entries below; the dependencies are only kept in this form,
+	// as reactions depend on few of the species.
+	uint                              * pReac_DEPSpec_Start;
+	uint                              * pReac_DEPSpec;
+	int                               * pReac_DEPVal;
+	uint                              * pReac_LHSSpec_Start;
+	uint                              * pReac_LHSSpec;
+	uint                              * pReac_LHSOrder;
+	// The species with a nonzero entry in pReac_UPD_Spec and that entry,
+	// reaction by reaction; pReac_UPDSpec_Start has pReacsN + 1 entries.
+	uint                              * pReac_UPDSpec_Start;
+	uint                              * pReac_UPDSpec;
+	int                               * pReac_UPDDelta;
 
     ////////////////////////////////////////////////////////////////////////
     // DATA: DIFFUSION RULES
@@ -406,7 +478,10 @@ private:
 
     inline uint _IDX_Diff_Spec(uint diff, uint spec) const
     { return (pSpecsN * diff) + spec; }
-	uint                              * pDiff_DEP_Spec;
+	// The dependencies, in the sparse form of the reaction tables.
+	uint                              * pDiff_DEPSpec_Start;
+	uint                              * pDiff_DEPSpec;
+	uint                              * pDiff_DEPVal;
 	uint                              * pDiff_LIG;
 
     ////////////////////////////////////////////////////////////////////////
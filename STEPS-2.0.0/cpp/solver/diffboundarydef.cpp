@@ -73,14 +73,14 @@ ssolver::DiffBoundarydef::~DiffBoundarydef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::DiffBoundarydef::checkpoint(std::fstream & cp_file)
+void ssolver::DiffBoundarydef::checkpoint(std::iostream & cp_file)
 {
     // reserve
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::DiffBoundarydef::restore(std::fstream & cp_file)
+void ssolver::DiffBoundarydef::restore(std::iostream & cp_file)
 {
     // reserve
 }
@@ -108,4 +108,11 @@ std::string const ssolver::DiffBoundarydef::name(void) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::DiffBoundarydef::getMemoryUsage(void) const
+{
+    return sizeof(DiffBoundarydef) + pTris.capacity() * sizeof(uint);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 
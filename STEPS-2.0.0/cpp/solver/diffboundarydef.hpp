@@ -72,10 +72,14 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by this object and its
+    /// triangle list.
+    std::size_t getMemoryUsage(void) const;
 
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS: DIFFUSION BOUNDARY
@@ -80,14 +80,14 @@ ssolver::Diffdef::~Diffdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Diffdef::checkpoint(std::fstream & cp_file)
+void ssolver::Diffdef::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pDcst, sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Diffdef::restore(std::fstream & cp_file)
+void ssolver::Diffdef::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pDcst, sizeof(double));
 }
@@ -164,4 +164,11 @@ bool ssolver::Diffdef::reqspec(uint gidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::Diffdef::getMemoryUsage(void) const
+{
+    return sizeof(Diffdef) + pStatedef->countSpecs() * sizeof(int);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
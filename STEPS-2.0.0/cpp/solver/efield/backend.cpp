@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "../../error.hpp"
+#include "backend.hpp"
+#include "bdmatrixprop.hpp"
+#include "schurmatrixprop.hpp"
+#include "sparsematrixprop.hpp"
+#include "tetmesh.hpp"
+#include "vprop.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+USING_NAMESPACE(std);
+NAMESPACE_ALIAS(steps::solver::efield, sefield);
+
+////////////////////////////////////////////////////////////////////////////////
+
+static sefield::VProp * cpuVProp(sefield::TetMesh * mesh, uint opt_method)
+{
+	// Method 3 solves the system iteratively on a sparse matrix instead
+	// of factorizing the banded matrix, method 5 reduces it to the
+	// membrane vertices.
+	if (opt_method == 3)
+	{
+		return new sefield::SparseMatrixProp(mesh);
+	}
+	else if (opt_method == 5)
+	{
+		return new sefield::SchurMatrixProp(mesh);
+	}
+	return new sefield::BandedMatrixProp(mesh);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The registered backends, created with the built-in one on first use so
+// that registrations from static initializers elsewhere find it.
+static map<string, sefield::VPropFactory> & backends(void)
+{
+	static map<string, sefield::VPropFactory> b;
+	if (b.empty() == true) b["cpu"] = cpuVProp;
+	return b;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::registerBackend(string const & name, VPropFactory factory)
+{
+	if (name.empty() == true || factory == 0)
+	{
+		std::ostringstream os;
+		os << "An EField backend needs a name and a factory.";
+		throw steps::ArgErr(os.str());
+	}
+	backends()[name] = factory;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sefield::hasBackend(string const & name)
+{
+	return backends().count(name) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+vector<string> sefield::getBackends(void)
+{
+	vector<string> names;
+	map<string, VPropFactory>::const_iterator b_end = backends().end();
+	for (map<string, VPropFactory>::const_iterator b = backends().begin(); b != b_end; ++b)
+	{
+		names.push_back(b->first);
+	}
+	return names;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sefield::VProp * sefield::createVProp(string const & name, TetMesh * mesh, uint opt_method)
+{
+	map<string, VPropFactory>::const_iterator b = backends().find(name);
+	if (b == backends().end())
+	{
+		std::ostringstream os;
+		os << "Unknown EField backend '" << name << "' (available:";
+		vector<string> names = getBackends();
+		for (uint i = 0; i < names.size(); ++i) os << " '" << names[i] << "'";
+		os << ").";
+		throw steps::ArgErr(os.str());
+	}
+	return b->second(mesh, opt_method);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_EFIELD_BACKEND_HPP
+#define STEPS_SOLVER_EFIELD_BACKEND_HPP 1
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(efield)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Forward declarations
+class TetMesh;
+class VProp;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Create the propagator of an EField for mesh, which is coupled, ordered
+/// and has its membrane parameters applied, and for the EField's
+/// optimization method.
+///
+typedef VProp * (*VPropFactory)(TetMesh * mesh, uint opt_method);
+
+/// EField backends: named propagator factories, chosen when an EField
+/// (or a Tetexact with calcMembPot) is constructed. "cpu", the default,
+/// gives the propagators of this directory: SparseMatrixProp for method
+/// 3, SchurMatrixProp for method 5 and BandedMatrixProp otherwise.
+///
+/// A backend that keeps the system elsewhere, such as on a GPU, derives
+/// from VProp and overrides advance() to step it there, uploading the
+/// currents collected in the VProp tables and leaving the vertex
+/// potentials current on the host on return, which is all EField reads.
+/// It is registered, before the solver is built, by the module that
+/// provides it.
+///
+void registerBackend(std::string const & name, VPropFactory factory);
+
+/// Return whether a backend of this name is registered.
+///
+bool hasBackend(std::string const & name);
+
+/// Return the names of the registered backends.
+///
+std::vector<std::string> getBackends(void);
+
+/// Create a propagator with backend name; throws steps::ArgErr if there
+/// is no such backend.
+///
+VProp * createVProp(std::string const & name, TetMesh * mesh, uint opt_method);
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(efield)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
+// STEPS_SOLVER_EFIELD_BACKEND_HPP
+
+// END
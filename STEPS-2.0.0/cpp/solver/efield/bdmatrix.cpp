@@ -23,6 +23,7 @@
 /////////////////////////////////////////////////////////////////////////////
 
 // STL headers.
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 
@@ -37,6 +38,137 @@ NAMESPACE_ALIAS(steps::solver::efield, sefield);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+#ifdef STEPS_USE_LAPACK
+extern "C"
+{
+    void dgbtrf_(int * m, int * n, int * kl, int * ku, double * ab,
+                 int * ldab, int * ipiv, int * info);
+    void dgbtrs_(char * trans, int * n, int * kl, int * ku, int * nrhs,
+                 double * ab, int * ldab, int * ipiv, double * b, int * ldb,
+                 int * info);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The Numerical Recipes band LU decomposition (bandec), on rows of
+// 2 * halfbw + 1 entries in a, with the multipliers in al and the
+// row interchanges in perm, in the precision of T.
+template <class T>
+static void nr_banlu(T * a, T * al, int * perm, int n, int halfbw)
+{
+	T TINY = 1.0e-20;
+
+	int w = 2 * halfbw + 1;
+	int p = halfbw;
+
+	// Shift the top rows left, so that every row starts with its
+	// first nonzero.
+	for (int i = 0; i < halfbw; ++i)
+	{
+		for (int j = halfbw - i; j < w; ++j)
+		{
+			a[(i * w) + (j - p)] = a[(i * w) + j];
+		}
+		p = p - 1;
+		for (int j = w - p - 1; j < w; ++j)
+		{
+			a[(i * w) + j] = 0.0;
+		}
+	}
+
+	p = halfbw;
+	for (int k = 0; k < n; ++k)
+	{
+		T dum = a[k * w];
+		int ipiv = k;
+		if (p < n)
+		{
+			p = p + 1;
+		}
+		// Find the pivot element.
+		for (int j = k + 1; j < p; ++j)
+		{
+			if (abs(a[j * w]) > abs(dum))
+			{
+				dum = a[j * w];
+				ipiv = j;
+			}
+		}
+		perm[k] = ipiv;
+		if (dum == 0.0)
+		{
+			a[k * w] = TINY;
+		}
+		if (ipiv != k)
+		{
+			for (int j = 0; j < w; ++j)
+			{
+				swap(a[(k * w) + j], a[(ipiv * w) + j]);
+			}
+		}
+
+		// Now for the elimination.
+		T * ak = a + (k * w);
+		for (int i = k + 1; i < p; ++i)
+		{
+			T * ai = a + (i * w);
+			dum = ai[0] / ak[0];
+			al[(k * (halfbw + 1)) + i - k - 1] = dum;
+			for (int j = 1; j < w; ++j)
+			{
+				ai[j - 1] = ai[j] - (ak[j] * dum);
+			}
+			ai[w - 1] = 0.0;
+		}
+	}
+}
+
+// Forward and back substitution (banbks) with a decomposition of
+// nr_banlu, in place on b.
+template <class T>
+static void nr_banbks(T const * a, T const * al, int const * perm, int n,
+                      int halfbw, T * b)
+{
+	int w = 2 * halfbw + 1;
+	int p = halfbw;
+
+	for (int k = 0; k < n; ++k)
+	{
+		int ipiv = perm[k];
+		if (ipiv != k)
+		{
+			swap(b[k], b[ipiv]);
+		}
+		if (p < n)
+		{
+			p = p + 1;
+		}
+		for (int i = k + 1; i < p; ++i)
+		{
+			b[i] -= al[(k * (halfbw + 1)) + i - k - 1] * b[k];
+		}
+	}
+
+	p = 1;
+	// Backsubstitution.
+	for (int i = n - 1; i >= 0; --i)
+	{
+		T dum = b[i];
+		for (int k = 1; k < p; ++k)
+		{
+			dum = dum - (a[(i * w) + k] * b[k + i]);
+		}
+		b[i] = dum / a[i * w];
+		if (p < w)
+		{
+			p = p + 1;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 sefield::BandDiagonalMatrix::BandDiagonalMatrix
 (
     int nrow,
@@ -62,6 +194,12 @@ sefield::BandDiagonalMatrix::BandDiagonalMatrix
     std::cout << "\nHalf bandwidth: " << halfbw;
 	perm = new int[nrow];
 	ws = new double[nrow];
+
+	ab = 0;
+	lapack = false;
+#ifdef STEPS_USE_LAPACK
+	ab = new double[nrow * (3 * halfbw + 1)];
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -70,11 +208,12 @@ sefield::BandDiagonalMatrix::~BandDiagonalMatrix(void)
 {
     delete[] perm;
     delete[] ws;
+    delete[] ab;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::BandDiagonalMatrix::checkpoint(std::fstream & cp_file)
+void sefield::BandDiagonalMatrix::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)perm, sizeof(int) * n);
     cp_file.write((char*)ws, sizeof(double) * n);
@@ -82,7 +221,7 @@ void sefield::BandDiagonalMatrix::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::BandDiagonalMatrix::restore(std::fstream & cp_file)
+void sefield::BandDiagonalMatrix::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)perm, sizeof(int) * n);
     cp_file.read((char*)ws, sizeof(double) * n);
@@ -92,211 +231,142 @@ void sefield::BandDiagonalMatrix::restore(std::fstream & cp_file)
 
 void sefield::BandDiagonalMatrix::lu(void)
 {
-	double TINY = 1.0e-20;
-
-	int w = 2 * halfbw + 1;
-    // w is equivalent to pBW in the prop. 'a' dimensions are nrow ('n') x 'w'
-
-	int p = halfbw;
-
-	for (int i = 0; i < halfbw; ++i)
+#ifdef STEPS_USE_LAPACK
+	// Row i of 'a' holds columns i - halfbw to i + halfbw. LAPACK keeps
+	// column c in ab[c * ldab] to ab[c * ldab + ldab - 1], with the
+	// element of row i at 2 * halfbw + i - c and the top halfbw rows
+	// left free for the fill-in of row interchanges. 'a' itself is not
+	// changed, so the code below can still be used if LAPACK fails.
 	{
-		for (int j = halfbw - i; j < w; ++j)
-		{
-            /*
-			a[i][j - p] = a[i][j];
-             */
-            a[(i*w) +(j - p)] = a[(i*w) +j];
-		}
-		p = p - 1;
-		for (int j = w - p - 1; j < w; ++j)
+		int w = 2 * halfbw + 1;
+		int ldab = 3 * halfbw + 1;
+		fill_n(ab, n * ldab, 0.0);
+		for (int i = 0; i < n; ++i)
 		{
-            /*
-			a[i][j] = 0.;
-             */
-            a[(i*w) +j] = 0.0;
-		}
-	}
-
-	double d = 1.;
-
-	p = halfbw;
-
-    double * dpointerk = &a[0];
-
-	for (int k = 0; k < n; ++k)
-	{
-        /*
-		double dum = a[k][0];
-		*/
-        double dum = a[k*w];
-
-        int ipiv = k;
-		if (p < n)
-		{
-			p=p+1;
-		}
-		for (int j=k+1; j < p; ++j)
-		{
-			//Find the pivot element.
-            /*
-			if (abs(a[j][0]) > abs(dum))
-             */
-            if (abs(a[j*w]) > abs(dum))
+			for (int j = 0; j < w; ++j)
 			{
-                /*
-				dum=a[j][0];
-                 */
-                dum=a[j*w];
-
-				ipiv = j;
+				int c = i + j - halfbw;
+				if (c < 0 || c >= n) continue;
+				ab[(c * ldab) + (2 * halfbw) + i - c] = a[(i * w) + j];
 			}
 		}
+		int kl = halfbw;
+		int ku = halfbw;
+		int info = 0;
+		dgbtrf_(&n, &n, &kl, &ku, ab, &ldab, perm, &info);
+		lapack = (info == 0);
+		if (lapack == true) return;
+	}
+#endif
 
-		perm[k] = ipiv;
-
-		if (dum == 0.)
-		{
-            /*
-			a[k][0] = TINY;
-             */
-            a[k*w] = TINY;
+	nr_banlu(a, al, perm, n, halfbw);
+}
 
-		}
+////////////////////////////////////////////////////////////////////////////////
 
-		if (ipiv != k)
-		{
-			// swap rowS
-			d=-d;
-			for (int j = 0; j < w; ++j)
-			{
-                /*
-				dum=a[k][j];
-				a[k][j] = a[ipiv][j];
-				a[ipiv][j] = dum;
-                 */
-                dum=a[(k*w)+j];
-				a[(k*w)+j] = a[(ipiv*w)+j];
-				a[(ipiv*w)+j] = dum;
+void sefield::BandDiagonalMatrix::lubksb(double * bin, double * b)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		b[i] = bin[i];
+	}
 
-			}
-		}
+#ifdef STEPS_USE_LAPACK
+	if (lapack == true)
+	{
+		char trans = 'N';
+		int kl = halfbw;
+		int ku = halfbw;
+		int nrhs = 1;
+		int ldab = 3 * halfbw + 1;
+		int info = 0;
+		dgbtrs_(&trans, &n, &kl, &ku, &nrhs, ab, &ldab, perm, b, &n, &info);
+		return;
+	}
+#endif
 
+	nr_banbks(a, al, perm, n, halfbw, b);
+}
 
-        double * dpointeri = &a[0];
+////////////////////////////////////////////////////////////////////////////////
 
-        dpointeri = dpointeri+((k+1)*w);
+std::size_t sefield::BandDiagonalMatrix::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(BandDiagonalMatrix);
+    bytes += n * (sizeof(int) + sizeof(double));
+    if (ab != 0) bytes += n * (3 * halfbw + 1) * sizeof(double);
+    return bytes;
+}
 
-		// now for the eliminiation
-		for (int i = k+1; i < p; ++i)
-		{
-            /*
-			dum=a[i][0] / a[k][0];
-             */
-            //dum=a[i*w] / a[k*w];
+////////////////////////////////////////////////////////////////////////////////
 
-            dum = (*dpointeri)/(*dpointerk);
+sefield::FloatBandDiagonalMatrix::FloatBandDiagonalMatrix(int nrow, int ncol)
+: a(0)
+, al(0)
+, ws(0)
+, perm(0)
+, n(nrow)
+, halfbw((ncol - 1) / 2)
+{
+	a = new float[n * ncol];
+	fill_n(a, n * ncol, 0.0f);
+	al = new float[n * (halfbw + 1)];
+	fill_n(al, n * (halfbw + 1), 0.0f);
+	ws = new float[n];
+	perm = new int[n];
+}
 
-            /*
-			al[k][i-k-1] = dum;
-             */
-            al[k*(halfbw+1)+i-k-1] = dum;
+////////////////////////////////////////////////////////////////////////////////
 
+sefield::FloatBandDiagonalMatrix::~FloatBandDiagonalMatrix(void)
+{
+	delete[] a;
+	delete[] al;
+	delete[] ws;
+	delete[] perm;
+}
 
-			for (int j = 1; j < w; ++j)
-			{
-                /*
-                double negt =  a[k][j] * dum;
-                double numb = a[i][j] - negt;
-                a[i][j-1] = numb;
-                 */
-                //int idx1 = (k*w)+j;
-                //int idx2 = (i*w)+j;
-                //double negt =  a[idx1] * dum;
-                //double numb = a[idx2] - negt;
-                //a[idx2-1] = numb;
-
-                double * dptempk = dpointerk+j;
-                double negt = *(dptempk) * dum;
-                double numb = *(dpointeri+1) - negt;
-                *(dpointeri)= numb;
-
-                dpointeri++;
-
-                // original
-				//a[i][j-1] = a[i][j] - dum * a[k][j];
-			}
-            // We have to increment one more time for a total of w
-			// increments because j starts at 1 in above loop
-            dpointeri++;
-            /*
-			a[i][w-1] = 0.;
-             */
-            a[(i*w)+(w-1)]=0.0;
+////////////////////////////////////////////////////////////////////////////////
 
-		}
-    dpointerk = dpointerk+w;
+void sefield::FloatBandDiagonalMatrix::setRow(int i, double const * row)
+{
+	int w = 2 * halfbw + 1;
+	for (int j = 0; j < w; ++j)
+	{
+		a[(i * w) + j] = static_cast<float>(row[j]);
 	}
+}
 
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::FloatBandDiagonalMatrix::lu(void)
+{
+	nr_banlu(a, al, perm, n, halfbw);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::BandDiagonalMatrix::lubksb(double * bin, double * b)
+void sefield::FloatBandDiagonalMatrix::lubksb(double const * bin, double * b)
 {
 	for (int i = 0; i < n; ++i)
 	{
-		b[i] = bin[i];
+		ws[i] = static_cast<float>(bin[i]);
 	}
-
-	int w = 2 * halfbw + 1;
-	int p = halfbw;
-
-	for (int k = 0; k < n; ++k)
+	nr_banbks(a, al, perm, n, halfbw, ws);
+	for (int i = 0; i < n; ++i)
 	{
-		int ipiv = perm[k];
-		if (ipiv != k)
-		{
-			double dum = b[k];
-			b[k] = b[ipiv];
-			b[ipiv] = dum;
-		}
-		if (p < n)
-		{
-			p=p+1;
-		}
-		for (int i= k+1; i < p; ++i)
-		{
-			/*
-            b[i] -= al[k][i-k-1] * b[k];
-             */
-            b[i] -= al[k*(halfbw+1)+i-k-1]*b[k];
-		}
+		b[i] = ws[i];
 	}
+}
 
-	p = 1;
-	// Backsubstitution.
-	for (int i = n-1; i >= 0; --i)
-	{
-		double dum = b[i];
-		for (int k=1; k < p; ++k)
-		{
-            /*
-			dum = dum - a[i][k] * b[k+i];
-             */
-            dum = dum - a[(i*w)+k] * b[k+i];
-		}
-
-        /******************
-		b[i] = dum / a[i][0];
-         */
-        b[i] = dum/a[i*w];
+////////////////////////////////////////////////////////////////////////////////
 
-		if (p < w)
-		{
-			p=p+1;
-		}
-	}
+std::size_t sefield::FloatBandDiagonalMatrix::getMemoryUsage(void) const
+{
+	std::size_t bytes = sizeof(FloatBandDiagonalMatrix);
+	bytes += n * ((3 * halfbw) + 3) * sizeof(float);
+	bytes += n * sizeof(int);
+	return bytes;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
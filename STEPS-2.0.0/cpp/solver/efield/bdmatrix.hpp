@@ -46,6 +46,12 @@ START_NAMESPACE(efield)
 ///
 /// Author: Robert Cannon
 ///
+/// When built with STEPS_USE_LAPACK (setup.py defines it if it finds a
+/// LAPACK library), the decomposition and solves are done by LAPACK's
+/// dgbtrf and dgbtrs on a copy of the matrix in LAPACK band storage, so
+/// a tuned, possibly multithreaded, BLAS does the work. The Numerical
+/// Recipes code is still used if LAPACK finds the matrix singular.
+///
 class BandDiagonalMatrix
 {
 
@@ -67,10 +73,14 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by the matrix, not counting the
+    /// band and workspace arrays passed to the constructor.
+    std::size_t getMemoryUsage(void) const;
 
 	/// Perform LU decomposition.
 	///
@@ -97,6 +107,57 @@ private:
     int n;
     int halfbw;
 
+    // The matrix in LAPACK band storage, n columns of 3 * halfbw + 1
+    // rows, and whether it holds the current decomposition.
+    double* ab;
+    bool lapack;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The decomposition and solves of BandDiagonalMatrix (the Numerical
+/// Recipes code) in single precision, on band and workspace arrays of
+/// its own: half the storage and memory traffic, for use with iterative
+/// refinement against the matrix in double precision.
+///
+class FloatBandDiagonalMatrix
+{
+
+public:
+
+    /// Constructor: an n by n matrix with ncol = 2 * halfbw + 1 entries
+    /// per row, all zero.
+    ///
+    FloatBandDiagonalMatrix(int n, int ncol);
+
+    ~FloatBandDiagonalMatrix(void);
+
+    /// Set row i from ncol doubles, diagonal in the middle, as for the
+    /// band passed to BandDiagonalMatrix.
+    ///
+    void setRow(int i, double const * row);
+
+    void lu(void);
+
+    /// Solve for bin, returning the solution in b, in double precision
+    /// but to single precision accuracy.
+    ///
+    void lubksb(double const * bin, double * b);
+
+    /// Return the number of bytes held by the matrix.
+    ///
+    std::size_t getMemoryUsage(void) const;
+
+private:
+
+    float* a;
+    float* al;
+    float* ws;
+    int* perm;
+    int n;
+    int halfbw;
+
 };
 
 ////////////////////////////////////////////////////////////////////////////////
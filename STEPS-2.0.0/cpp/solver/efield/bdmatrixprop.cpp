@@ -24,18 +24,24 @@
 
 // STL headers.
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <ctime>
+#include <map>
+#include <vector>
 
 // STEPS headers.
 #include "../../common.h"
+#include "../../meshcache.hpp"
+#include "../../parallel.hpp"
 #include "bdmatrix.hpp"
 #include "bdmatrixprop.hpp"
 #include "tetmesh.hpp"
 #include "vertexconnection.hpp"
 #include "vertexelement.hpp"
+#include "vprop.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -44,442 +50,513 @@ NAMESPACE_ALIAS(steps::solver::efield, sefield);
 
 ////////////////////////////////////////////////////////////////////////////////
 
-sefield::BandedMatrixProp::BandedMatrixProp(TetMesh * msh)
-: pMesh(msh)
-, pNVerts(pMesh->countVertices())
-//, pV0(0.0)
-, pGExt(0)
-, pVExt(0.0)
-, pVertexInj(0)
-, pVertexClamp(0)
-, pTriCur(0)
-, pVertCur(0)
-, pTriCurClamp(0)
-, pVertCurClamp(0)
-//, pTotGSurf(0.0)
-, pInjTot(0.0)
-, pRawBDM(0)
-, pMWK(0)
-, pDV(0)
-, pRHS(0)
-, pHalfBW(0)
-, pBW(0)
-, pBDM(0)
+// The banded LU decompositions of the diagonal blocks of a matrix,
+// shared by all the BandedMatrixProps whose matrices hash to key.
+struct sefield::BandedFactor
+{
+    std::string                         key;
+    uint                                refs;
+    std::vector<double *>               raw;
+    std::vector<double *>               mwk;
+    std::vector<BandDiagonalMatrix *>   bdm;
+    // Single precision decompositions, in place of the above.
+    std::vector<FloatBandDiagonalMatrix *> fbdm;
+};
+
+// The decompositions in use, by key. EFields are built and stepped from
+// one thread at a time, so this needs no lock.
+static std::map<std::string, sefield::BandedFactor *> bandedFactors;
+
+static void releaseFactor(sefield::BandedFactor * f)
 {
-	pMesh->reindexElements(); // Is this necessary?
+    if (f == 0 || --f->refs != 0) return;
+    bandedFactors.erase(f->key);
+    for (uint b = 0; b < f->bdm.size(); ++b)
+    {
+        delete f->bdm[b];
+        delete[] f->raw[b];
+        delete[] f->mwk[b];
+    }
+    for (uint b = 0; b < f->fbdm.size(); ++b)
+    {
+        delete f->fbdm[b];
+    }
+    delete f;
+}
 
-	pV = new double[pNVerts];
-	fill_n(pV, pNVerts, 0.0);
+// Decompose, or solve with, the blocks of a decomposition, one block per
+// iteration. Each block has its own matrix and workspace.
+class sefield::BandedBlockLoop : public steps::ParallelLoop
+{
 
-	pGExt = new double[pNVerts];
-	fill_n(pGExt, pNVerts, 0.0);
+public:
 
-	pVertexInj = new double[pNVerts];
-	fill_n(pVertexInj, pNVerts, 0.0);
+    BandedBlockLoop(BandedMatrixProp * prop, double const * rhs, double * dv)
+    : pProp(prop), pRHS(rhs), pDV(dv)
+    { }
 
-    pVertexClamp = new bool[pNVerts];
-    fill_n(pVertexClamp, pNVerts, false);
+    void run(uint b, uint thread)
+    {
+        if (pRHS == 0) pProp->factorBlock(b);
+        else pProp->solveBlock(b, pRHS, pDV, thread);
+    }
 
-    int ntri = pMesh->getNTri();
-	pTriCur = new double[ntri];
-	fill_n(pTriCur, ntri, 0.0);
-	pTriCurClamp = new double[ntri];
-	fill_n(pTriCurClamp, ntri, 0.0);
+private:
 
-	pVertCur = new double[pNVerts];
-	fill_n(pVertCur, pNVerts, 0.0);
+    BandedMatrixProp *                  pProp;
+    double const *                      pRHS;
+    double *                            pDV;
 
-	pVertCurClamp = new double[pNVerts];
-	fill_n(pVertCurClamp, pNVerts, 0.0);
+};
 
-	// Find out how big the band of the band-diagonal matrix should be.
-	maxdi = 0;
-	for (int iv = 0; iv < pNVerts; ++iv)
+// Write n zero bytes, in place of a decomposition in checkpoints.
+static void writeZeros(std::iostream & cp_file, std::size_t n)
+{
+    char zeros[4096];
+    fill_n(zeros, sizeof(zeros), 0);
+    while (n > 0)
+    {
+        std::size_t chunk = std::min(n, sizeof(zeros));
+        cp_file.write(zeros, chunk);
+        n -= chunk;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sefield::BandedMatrixProp::BandedMatrixProp(TetMesh * msh)
+: VProp(msh)
+, pHalfBW(0)
+, pBW(0)
+, maxdi(0)
+, pBlockStart()
+, pBlockHalfBW()
+, pFree()
+, pCompact()
+, pFreeRHS()
+, pFreeDV()
+, pMixed(false)
+, pBuildDt(0.0)
+, pWork()
+, pRefines()
+, pFactor(0)
+{
+	buildBlocks();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::BandedMatrixProp::buildBlocks(void)
+{
+	// The unknowns are the potential changes of the unclamped vertices,
+	// in vertex order; those of clamped vertices are zero.
+	pFree.clear();
+	pCompact.assign(pNVerts, -1);
+	for (int ind = 0; ind < pNVerts; ++ind)
+	{
+		if (pVertexClamp[ind] == true) continue;
+		pCompact[ind] = pFree.size();
+		pFree.push_back(ind);
+	}
+	int nfree = pFree.size();
+	if (nfree == pNVerts)
 	{
-		VertexElement* ve = pMesh->getVertex(iv);
-		int ind = ve->getIDX();
+		pFreeRHS.clear();
+		pFreeDV.clear();
+	}
+	else
+	{
+		pFreeRHS.assign(nfree, 0.0);
+		pFreeDV.assign(nfree, 0.0);
+	}
 
-		for (int i = 0; i < ve->getNCon(); ++i)
+	// Find out how big the band of the band-diagonal matrix should be,
+	// and where it splits into blocks: a block ends at a row that no
+	// row before it, or itself, connects beyond.
+	maxdi = 0;
+	int reach = 0;
+	int blockdi = 0;
+	pBlockStart.assign(1, 0);
+	pBlockHalfBW.clear();
+	for (int ind = 0; ind < nfree; ++ind)
+	{
+		int v = pFree[ind];
+		int row_end = pMesh->getNbrStart(v + 1);
+		for (int i = pMesh->getNbrStart(v); i < row_end; ++i)
 		{
-			int inbr = ve->nbrIdx(i);
+			int inbr = pCompact[pMesh->getNbrIdx(i)];
+			if (inbr < 0)
+			{
+				continue;
+			}
 			int di = ind - inbr;
 			if (di < 0)
 			{
 				di = -di;
 			}
-			if (di > maxdi)
+			if (di > blockdi)
+			{
+				blockdi = di;
+			}
+			if (inbr > reach)
 			{
-				maxdi = di;
+				reach = inbr;
 			}
 		}
+		if (reach <= ind)
+		{
+			pBlockStart.push_back(ind + 1);
+			pBlockHalfBW.push_back(blockdi);
+			if (blockdi > maxdi)
+			{
+				maxdi = blockdi;
+			}
+			blockdi = 0;
+		}
 	}
-	/*
-	// Report on standard output (remove later).
-	stringstream ss;
-	ss << "banded matrix, mesh size=";
-	ss << pNVerts << "  band half width=" << maxdi;
-	cout << ss.str() << endl;
-	*/
 
 	pHalfBW = maxdi;
 	pBW = 2 * maxdi + 1;
-
-
-
-    /* *******************************
-	pRawBDM = new double*[pNVerts];
-	for (int i = 0; i < pNVerts; ++i)
-	{
-		pRawBDM[i] = new double[pBW];
-		fill_n(pRawBDM[i], pBW, 0.0);
-	}
-    */
-    pRawBDM = new double[pBW*pNVerts];
-    fill_n(pRawBDM, pBW*pNVerts, 0.0);
-
-    /***************************
-	pMWK = new double*[pNVerts];
-	for (int i = 0; i < pNVerts; ++i)
-	{
-		pMWK[i] = new double[maxdi + 1];
-		fill_n(pMWK[i], maxdi + 1, 0.0);
-	}
-     */
-    pMWK = new double[pNVerts*(maxdi + 1)];
-    fill_n(pMWK, pNVerts*(maxdi + 1), 0.0);
-
-
-
-	pRHS = new double[pNVerts];
-	fill_n(pRHS, pNVerts, 0.0);
-
-	pDV = new double[pNVerts];
-	fill_n(pDV, pNVerts, 0.0);
-
-	pBDM = new BandDiagonalMatrix(pNVerts, pBW, pRawBDM, pMWK);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 sefield::BandedMatrixProp::~BandedMatrixProp(void)
 {
-    delete[] pV;
-    delete[] pGExt;
-    delete[] pVertexInj;
-    delete[] pVertexClamp;
-    // bug(swils) 22-Oct-2008: forgotten
-    delete[] pTriCur;
-    delete[] pVertCur;
-
-    /* *********************
-    for (int i = 0; i < pNVerts; ++i)
-    {
-        delete[] pRawBDM[i];
-    }
-    */
-    delete[] pRawBDM;
-
-    /************************
-    for (int i = 0; i < pNVerts; ++i)
-    {
-        delete[] pMWK[i];
-    }
-    delete[] pMWK;
-     */
-    delete[] pMWK;
-
-
-
-    delete[] pDV;
-    delete[] pRHS;
-
-    // bug(swils) 06-Aug-2008: forgotten
-    delete pBDM;
+    releaseFactor(pFactor);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::BandedMatrixProp::checkpoint(std::fstream & cp_file)
+void sefield::BandedMatrixProp::checkpoint(std::iostream & cp_file)
 {
-    cp_file.write((char*)pV, sizeof(double) * pNVerts);
-    cp_file.write((char*)pGExt, sizeof(double) * pNVerts);
-    cp_file.write((char*)&pVExt, sizeof(double));
-    cp_file.write((char*)pVertexInj, sizeof(double) * pNVerts);
-    cp_file.write((char*)pVertexClamp, sizeof(bool) * pNVerts);
-    int ntri = pMesh->getNTri();
-    cp_file.write((char*)&ntri, sizeof(int));
-    cp_file.write((char*)pTriCur, sizeof(double) * ntri);
-    cp_file.write((char*)pTriCurClamp, sizeof(double) * ntri);
-    cp_file.write((char*)pVertCur, sizeof(double) * pNVerts);
-    cp_file.write((char*)pVertCurClamp, sizeof(double) * pNVerts);
-    cp_file.write((char*)&pInjTot, sizeof(double));
+    VProp::checkpoint(cp_file);
 
     cp_file.write((char*)&pHalfBW, sizeof(int));
     cp_file.write((char*)&pBW, sizeof(int));
     cp_file.write((char*)&maxdi, sizeof(int));
 
-    cp_file.write((char*)pRawBDM, sizeof(double) * pNVerts * pBW);
-    cp_file.write((char*)pMWK, sizeof(double) * pNVerts * (maxdi + 1));
+    // The decomposition, which restore rebuilds anyway, is written as
+    // zeros of the size of a single band, as the file layout has it.
+    writeZeros(cp_file, sizeof(double) * pNVerts * pBW);
+    writeZeros(cp_file, sizeof(double) * pNVerts * (maxdi + 1));
     cp_file.write((char*)pDV, sizeof(double) * pNVerts);
     cp_file.write((char*)pRHS, sizeof(double) * pNVerts);
-
-    pBDM->checkpoint(cp_file);
+    writeZeros(cp_file, (sizeof(int) + sizeof(double)) * pNVerts);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::BandedMatrixProp::restore(std::fstream & cp_file)
+void sefield::BandedMatrixProp::restore(std::iostream & cp_file)
 {
-    cp_file.read((char*)pV, sizeof(double) * pNVerts);
-    cp_file.read((char*)pGExt, sizeof(double) * pNVerts);
-    cp_file.read((char*)&pVExt, sizeof(double));
-    cp_file.read((char*)pVertexInj, sizeof(double) * pNVerts);
-    cp_file.read((char*)pVertexClamp, sizeof(bool) * pNVerts);
-    int ntri = 0;
-    cp_file.read((char*)&ntri, sizeof(int));
-    cp_file.read((char*)pTriCur, sizeof(double) * ntri);
-    cp_file.read((char*)pTriCurClamp, sizeof(double) * ntri);
-    cp_file.read((char*)pVertCur, sizeof(double) * pNVerts);
-    cp_file.read((char*)pVertCurClamp, sizeof(double) * pNVerts);
-    cp_file.read((char*)&pInjTot, sizeof(double));
+    VProp::restore(cp_file);
 
     cp_file.read((char*)&pHalfBW, sizeof(int));
     cp_file.read((char*)&pBW, sizeof(int));
     cp_file.read((char*)&maxdi, sizeof(int));
 
-    cp_file.read((char*)pRawBDM, sizeof(double) * pNVerts * pBW);
-    cp_file.read((char*)pMWK, sizeof(double) * pNVerts * (maxdi + 1));
+    // VProp::restore has invalidated the matrix, so the stored
+    // decomposition is skipped and rebuilt on the next step.
+    std::streamoff skip = sizeof(double) * pNVerts * pBW;
+    skip += sizeof(double) * pNVerts * (maxdi + 1);
+    cp_file.seekg(skip, std::ios_base::cur);
     cp_file.read((char*)pDV, sizeof(double) * pNVerts);
     cp_file.read((char*)pRHS, sizeof(double) * pNVerts);
-
-    pBDM->restore(cp_file);
+    skip = (sizeof(int) + sizeof(double)) * pNVerts;
+    cp_file.seekg(skip, std::ios_base::cur);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::BandedMatrixProp::advance(double dt)
+void sefield::BandedMatrixProp::solve(void)
 {
-    populateMRHS(dt);
-
-    // Performance: the vast majority of the work is in bdm->lu()
-    pBDM->lu();
-    pBDM->lubksb(pRHS, pDV);
+    uint nblocks = pBlockHalfBW.size();
+    if (pMixed == true)
+    {
+        // Refinement workspace and counts, per thread.
+        pWork.resize(pThreads);
+        pRefines.assign(pThreads, 0);
+    }
 
-    for (uint i = 0; i < pNVerts; ++i)
+    if (pFree.size() == pNVerts)
     {
-        // bugfix(wils) 06-Aug-2008: the voltage-clamp variable was being
-        // stored for each vertex (in variable pVertexClamp), but not used
-        // during the update step.
-        if (pVertexClamp[i] == false)
-        {
-            pV[i] += pDV[i];
-        }
+        BandedBlockLoop loop(this, pRHS, pDV);
+        steps::parallelFor(loop, nblocks, pThreads);
+    }
+    else
+    {
+        // Solve for the unclamped vertices only.
+        uint nfree = pFree.size();
+        for (uint i = 0; i < nfree; ++i) pFreeRHS[i] = pRHS[pFree[i]];
+        fill_n(pDV, pNVerts, 0.0);
+        if (nfree == 0) return;
+        BandedBlockLoop loop(this, &pFreeRHS[0], &pFreeDV[0]);
+        steps::parallelFor(loop, nblocks, pThreads);
+        for (uint i = 0; i < nfree; ++i) pDV[pFree[i]] = pFreeDV[i];
     }
 
-    // Has strange behaviours, uses unexplainable variables such as this
-    // pInjTot. Look at this later...
-    //chargeCheck(dt);
+    if (pMixed == true)
+    {
+        for (uint t = 0; t < pRefines.size(); ++t) pNRefine += pRefines[t];
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/*
-void BandedMatrixProp::setInitialPotential(double d)
+
+void sefield::BandedMatrixProp::factorBlock(uint b)
 {
-	// NOTE: getting rid of this- replace with setPotential, to behave a little
-	// like reset(), and no need to store pV0;
-	pV0 = d;
+    if (pMixed == true) pFactor->fbdm[b]->lu();
+    else pFactor->bdm[b]->lu();
 }
-*/
+
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::BandedMatrixProp::setSurfaceConductance(double gsa, double vr)
+void sefield::BandedMatrixProp::solveBlock(uint b, double const * rhs,
+                                           double * dv, uint thread)
 {
-	pVExt = vr;
-	// pTotGSurf = 0.;
-	double totsurf = 0.;
-	for (int i = 0; i < pNVerts; ++i)
-	{
-		VertexElement* ve = pMesh->getVertex(i);
-		double ge = gsa * ve->getSurfaceArea();
-		pGExt[ve->getIDX()] = ge;
-		// pTotGSurf += ge;
-
-		totsurf += ve->getSurfaceArea();
-	}
+    int start = pBlockStart[b];
+    int n = pBlockStart[b + 1] - start;
+    rhs += start;
+    dv += start;
+    if (pMixed == false)
+    {
+        // lubksb does not change its input.
+        pFactor->bdm[b]->lubksb(const_cast<double *>(rhs), dv);
+        return;
+    }
 
-	/*
-	stringstream ss;
-	ss << "total surface area " << totsurf;
-	cout << ss.str() << endl;
-	*/
-}
+    // Solve in single precision, then correct the solution with the
+    // residual of the double precision matrix, which is computed from
+    // the mesh rather than stored. The corrections are conjugate
+    // gradient steps preconditioned by the single precision solve: the
+    // matrix is symmetric positive definite, and this converges where
+    // plain refinement is slowed down by its condition number.
+    FloatBandDiagonalMatrix * fbdm = pFactor->fbdm[b];
+    fbdm->lubksb(rhs, dv);
+
+    std::vector<double> & work = pWork[thread];
+    work.resize(4 * n);
+    double * res = &work[0];
+    double * z = &work[n];
+    double * p = &work[2 * n];
+    double * q = &work[3 * n];
+
+    double bnorm2 = 0.0;
+    for (int i = 0; i < n; ++i) bnorm2 += rhs[i] * rhs[i];
+    double tol2 = EFIELD_REFINE_TOLERANCE * EFIELD_REFINE_TOLERANCE * bnorm2;
+
+    blockMatVec(start, n, dv, q);
+    double rr = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+        res[i] = rhs[i] - q[i];
+        rr += res[i] * res[i];
+    }
+    if (rr <= tol2) return;
 
-////////////////////////////////////////////////////////////////////////////////
+    fbdm->lubksb(res, z);
+    double rz = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+        p[i] = z[i];
+        rz += res[i] * z[i];
+    }
 
-string sefield::BandedMatrixProp::makeOutputLine(double time, double* v)
-{
-	stringstream s;
-	s << time << " " << pV[0] << " " << pV[pNVerts-1];
-	return s.str();
-}
+    for (uint iter = 0; iter < EFIELD_REFINE_MAX && rr > tol2; ++iter)
+    {
+        blockMatVec(start, n, p, q);
+        double pq = 0.0;
+        for (int i = 0; i < n; ++i) pq += p[i] * q[i];
+        double alpha = rz / pq;
+        rr = 0.0;
+        for (int i = 0; i < n; ++i)
+        {
+            dv[i] += alpha * p[i];
+            res[i] -= alpha * q[i];
+            rr += res[i] * res[i];
+        }
+        ++pRefines[thread];
+        if (rr <= tol2) break;
+
+        fbdm->lubksb(res, z);
+        double rz_new = 0.0;
+        for (int i = 0; i < n; ++i) rz_new += res[i] * z[i];
+        double beta = rz_new / rz;
+        rz = rz_new;
+        for (int i = 0; i < n; ++i) p[i] = z[i] + (beta * p[i]);
+    }
 
-////////////////////////////////////////////////////////////////////////////////
-/*
-void BandedMatrixProp::reset(void)
-{
-    for (int i = 0; i < pNVerts; ++i)
+    if (rr > tol2)
     {
-        pV[i] = pV0;
+        cout << "\nWarning - EField iterative refinement did not converge, relative residual ";
+        cout << sqrt(rr / bnorm2) << endl;
     }
 }
-*/
+
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::BandedMatrixProp::setPotential(double v)
+void sefield::BandedMatrixProp::blockMatVec(int start, int n, double const * x,
+                                            double * y) const
 {
-    for (int i = 0; i < pNVerts; ++i)
+    // The same terms as fillRow, over the rows [start, start + n) of a
+    // block, with x and y indexed from start.
+    for (int i = 0; i < n; ++i)
     {
-        pV[i] = v;
+        int vert = pFree[start + i];
+        double diag = pMesh->getVertex(vert)->getCapacitance() + pBuildDt * pGExt[vert];
+        double off = 0.0;
+        int row_end = pMesh->getNbrStart(vert + 1);
+        for (int inbr = pMesh->getNbrStart(vert); inbr < row_end; ++inbr)
+        {
+            double cc = pBuildDt * pMesh->getNbrCC(inbr);
+            diag += cc;
+            int k = pCompact[pMesh->getNbrIdx(inbr)];
+            if (k >= 0) off += cc * x[k - start];
+        }
+        y[i] = (diag * x[i]) - off;
     }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::BandedMatrixProp::populateMRHS(double dt)
+void sefield::BandedMatrixProp::fillRow(int ind, int hbw, double dt, double * row) const
 {
-	// Currents into vertices are the per-vertex injections plus
-	// the per-triangle currents divided over their neighbors.
-
-	// NOTE: at the moment pVertexInj is not used at all, and
-	// this is a little inefficient at the moment- i.e. looping
-	// over all vertices when typically only a few will have
-	// a current clamp, if any
-	for (uint i = 0; i < pNVerts; ++i)
+	fill_n(row, 2 * hbw + 1, 0.0);
+	int vert = pFree[ind];
+	VertexElement * ve = pMesh->getVertex(vert);
+
+	// NOTE: In following units are:
+	// Time: ms
+	// External conductance: ??
+	// Potentials: mV
+	// Capacitance: pF
+
+	// the diagonal term (zero for all the internal points)
+	row[hbw] += ve->getCapacitance() + dt * pGExt[vert];
+
+	// Now, loop through all the neighbours adding on contributions
+	// to the matrix. A clamped neighbour does not change, so only the
+	// diagonal sees its conductance.
+	int row_end = pMesh->getNbrStart(vert + 1);
+	for (int inbr = pMesh->getNbrStart(vert); inbr < row_end; ++inbr)
 	{
-		pVertCur[i] = pVertexInj[i];
-		pVertCur[i] += pVertCurClamp[i];
+		int k = pCompact[pMesh->getNbrIdx(inbr)];
+		double cc = pMesh->getNbrCC(inbr);
 
-	}
-	uint ntris = pMesh->getNTri();
-	for (uint i = 0; i < ntris; ++i)
-	{
-		uint * triv = pMesh->getTriangle(i);
-		double c = pTriCur[i] / 3.0;
-		double cc = pTriCurClamp[i] / 3.0;
+		// conductance terms for the diagonal
+		row[hbw] += dt * cc;
 
-		pVertCur[triv[0]] += (c+cc);
-		pVertCur[triv[1]] += (c+cc);
-		pVertCur[triv[2]] += (c+cc);
+		// other ends of the conductances
+		if (k >= 0) row[k - ind + hbw] -= dt * cc;
 	}
+}
 
+////////////////////////////////////////////////////////////////////////////////
 
-	// NOTE: Vertex currents at this point are given in pA
-
-	for (uint i = 0; i < pNVerts; ++i)
-	{
-		pRHS[i] = pVertCur[i] * dt;
-	}
-	// NOTE: time is in units of ms
-
-	int nw = 2 * pHalfBW + 1;
-	for (int i = 0; i < pNVerts; ++i)
+void sefield::BandedMatrixProp::buildMatrix(double dt)
+{
+	// The matrix is hashed row by row, which costs little next to the
+	// decomposition, to find out if an equal one is already decomposed.
+	// Clamped vertices are left out of the system, so a change in the
+	// clamps changes its structure.
+	buildBlocks();
+	pBuildDt = dt;
+	uint nblocks = pBlockHalfBW.size();
+	int nfree = pFree.size();
+	std::vector<double> row(pBW);
+	steps::ContentHash hash;
+	hash.add(&pMixed, sizeof(pMixed));
+	hash.add(&nfree, sizeof(nfree));
+	hash.add(pBlockStart);
+	hash.add(pBlockHalfBW);
+	for (uint b = 0; b < nblocks; ++b)
 	{
-		for (int j = 0; j < nw; ++j)
+		int hbw = pBlockHalfBW[b];
+		for (int ind = pBlockStart[b]; ind < pBlockStart[b + 1]; ++ind)
 		{
-            /* *************************
-			pRawBDM[i][j] = 0.0;
-            */
-            pRawBDM[(i*nw)+j] = 0.0;
+			fillRow(ind, hbw, dt, &row[0]);
+			hash.add(&row[0], (2 * hbw + 1) * sizeof(double));
 		}
 	}
-	for (int ivert = 0; ivert < pNVerts; ++ivert)
-	{
-		VertexElement * ve = pMesh->getVertex(ivert);
+	std::string key = hash.hex();
+	if (pFactor != 0 && pFactor->key == key) return;
 
-		int ind = ve->getIDX();
-
-		// NOTE: In following units are:
-		// Time: ms
-		// External conductance: ??
-		// Potentials: mV
-		// Capacitance: pF
-
-		// the diagonal term (zero for all the internal points)
-        /* ***************************************
-		pRawBDM[ind][pHalfBW] += ve->getCapacitance() + dt * pGExt[ind];
-         */
-        pRawBDM[(ind*nw)+pHalfBW] += ve->getCapacitance() + dt * pGExt[ind];
-
-		pRHS[ind] += dt * pGExt[ind] * (pVExt - pV[ind]);
+	releaseFactor(pFactor);
+	pFactor = 0;
+	std::map<std::string, BandedFactor *>::iterator f = bandedFactors.find(key);
+	if (f != bandedFactors.end())
+	{
+		pFactor = f->second;
+		++pFactor->refs;
+		return;
+	}
 
-		// Now, loop through all the neighbours adding on contributions
-		// to matrix and pRHS.
-		for (int inbr = 0; inbr < ve->getNCon(); ++inbr)
+	pFactor = new BandedFactor;
+	pFactor->key = key;
+	pFactor->refs = 1;
+	for (uint b = 0; b < nblocks; ++b)
+	{
+		int start = pBlockStart[b];
+		int n = pBlockStart[b + 1] - start;
+		int hbw = pBlockHalfBW[b];
+		int bw = 2 * hbw + 1;
+		if (pMixed == true)
 		{
-			int k = ve->nbrIdx(inbr);
-			double cc = ve->getCC(inbr);
-			// right hand side
-			pRHS[ind] += dt * cc * (pV[k] - pV[ind]);
-
-			/* if (pV[k] != pV[ind])
+			FloatBandDiagonalMatrix * fbdm = new FloatBandDiagonalMatrix(n, bw);
+			for (int i = 0; i < n; ++i)
 			{
-			    //std::cerr << ind << "->" << k << ": ";
-			    //std::cerr << "{cc=" << cc << "} * ";
-			    //std::cerr << "{dt=" << dt << "} * ";
-			    //std::cerr << "{pV=" << pV[ind] << "} * ";
-			    //std::cerr << "{pVn=" << pV[k] << "} = ";
-			    //std::cerr << dt * cc * (pV[k] - pV[ind]) << "\n";
+				fillRow(start + i, hbw, dt, &row[0]);
+				fbdm->setRow(i, &row[0]);
 			}
-			*/
-
-			// conductance terms for the doagonal
-            /* ***************************************
-			pRawBDM[ind][pHalfBW] += dt * cc;
-             */
-            pRawBDM[(ind*nw)+pHalfBW] += dt * cc;
-
-			// other ends of the conductances
-            /* ***************************************
-			pRawBDM[ind][k - ind + pHalfBW] -= dt * cc;
-             */
-            pRawBDM[(ind*nw)+ (k-ind+pHalfBW)]-= dt * cc;
-
+			pFactor->fbdm.push_back(fbdm);
+			continue;
+		}
+		double * raw = new double[bw * n];
+		double * mwk = new double[n * (hbw + 1)];
+		fill_n(mwk, n * (hbw + 1), 0.0);
+		for (int i = 0; i < n; ++i)
+		{
+			fillRow(start + i, hbw, dt, raw + (i * bw));
 		}
+		pFactor->raw.push_back(raw);
+		pFactor->mwk.push_back(mwk);
+		pFactor->bdm.push_back(new BandDiagonalMatrix(n, bw, raw, mwk));
 	}
+	bandedFactors[key] = pFactor;
 
-	// Iain 31/8/2011 Now reset the currents
-	fill_n(pVertexInj, pNVerts, 0.0);
-	fill_n(pTriCur, ntris, 0.0);
-	fill_n(pVertCur, pNVerts, 0.0);
+    // Performance: the vast majority of the work is in bdm->lu(), which
+    // is why the decomposition is kept for as long as dt and the membrane
+    // parameters are unchanged, and shared between equal matrices.
+    BandedBlockLoop loop(this, 0, 0);
+    steps::parallelFor(loop, nblocks, pThreads);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::BandedMatrixProp::chargeCheck(double dt)
+std::size_t sefield::BandedMatrixProp::getMemoryUsage(void) const
 {
-    //if (pTotGSurf == 0.0)
-    //{
-        // Can do a charge conservation check -
-        // TODO: smarter check that adds currents
-        double cvt = 0.;
-        for (int i = 0; i < pNVerts; ++i)
+    // A shared decomposition is counted in equal parts.
+    std::size_t bytes = sizeof(BandedMatrixProp) + _tableMemoryUsage();
+    bytes += (pBlockStart.capacity() + pBlockHalfBW.capacity()) * sizeof(int);
+    bytes += (pFree.capacity() + pCompact.capacity()) * sizeof(int);
+    bytes += (pFreeRHS.capacity() + pFreeDV.capacity()) * sizeof(double);
+    if (pFactor != 0)
+    {
+        std::size_t fbytes = 0;
+        for (uint b = 0; b < pFactor->bdm.size(); ++b)
         {
-            VertexElement * ve = pMesh->getVertex(i);
-            pInjTot += pVertexInj[i] * dt;
-            // NOTE: IH 5/10 removed pV0 in below:
-            // cvt += (pV[i] - pV0) * ve->getCapacitance();
-            cvt += (pV[i]) * ve->getCapacitance();
+            int n = pBlockStart[b + 1] - pBlockStart[b];
+            int hbw = pBlockHalfBW[b];
+            fbytes += n * ((3 * hbw) + 2) * sizeof(double);
+            fbytes += pFactor->bdm[b]->getMemoryUsage();
         }
-        double dabs = abs((cvt - pInjTot) / (cvt + pInjTot));
-        if (dabs > 1.e-7)
+        for (uint b = 0; b < pFactor->fbdm.size(); ++b)
         {
-            stringstream s;
-
-            s << "NEAR FATAL sum error too large ";
-            s << dabs << " " << cvt << " " << pInjTot;
-            cout << s.str() << endl;
+            fbytes += pFactor->fbdm[b]->getMemoryUsage();
         }
-    //}
+        bytes += fbytes / pFactor->refs;
+    }
+    return bytes;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -29,11 +29,13 @@
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 // STEPS headers.
 #include "../../common.h"
 #include "bdmatrix.hpp"
 #include "tetmesh.hpp"
+#include "vprop.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -43,11 +45,48 @@ START_NAMESPACE(efield)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Forward declarations
+struct BandedFactor;
+class BandedBlockLoop;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Relative residual at which the iterative refinement of a single
+/// precision solve stops, and the most refinement steps.
+#define EFIELD_REFINE_TOLERANCE         1.0e-12
+#define EFIELD_REFINE_MAX               50
+
+////////////////////////////////////////////////////////////////////////////////
+
 /// The main current problem with this class is that it has some implicit
 /// assumptions about what happens at each time step. Important task:
 /// document or otherwise 'fix' them to be more in line with STEPS.
 ///
+/// Solves the system with a banded LU decomposition; the band width is
+/// set by the vertex ordering of TetMesh::axisOrderElements. Objects
+/// whose matrices come out equal, such as the EFields of replicates with
+/// the same mesh, membrane parameters and time step, share one
+/// decomposition, found by a hash of the matrix.
+///
+/// A mesh in several connected parts, such as a network of cells, gives
+/// a block diagonal matrix, since axisOrderElements numbers the parts one
+/// after the other. Each block is then decomposed and solved on its own,
+/// with the band width of its own part, the blocks in parallel on the
+/// threads set with VProp::setThreads.
+///
+/// Voltage-clamped vertices are left out of the system: their potential
+/// does not change, so their couplings only add to the diagonal of their
+/// neighbours' rows. Clamping or releasing a vertex rebuilds the matrix.
+///
+/// With mixed precision on, the blocks are decomposed and solved in
+/// single precision (FloatBandDiagonalMatrix), which halves the storage
+/// and memory traffic of the decomposition, and each solution is refined
+/// against the double precision matrix, by conjugate gradient steps
+/// preconditioned with the single precision solve, until its residual
+/// is down to EFIELD_REFINE_TOLERANCE.
+///
 class BandedMatrixProp
+: public VProp
 {
 
 public:
@@ -68,213 +107,117 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
-
-    /// Set the initial potential (in millivolt).
-	///
-    //void setInitialPotential(double v);
-
-    void setSurfaceConductance(double, double);
+    void restore(std::iostream & cp_file);
 
-    std::string makeOutputLine(double, double*);
+    std::size_t getMemoryUsage(void) const;
 
-    //void reset(void);
-
-    // New method to replace setInitialPotential and reset()
-    void setPotential(double v);
-
-	////////////////////////////////////////////////////////////////////////
-	// METHODS
-	////////////////////////////////////////////////////////////////////////
-
-    /// This is the crucial method -- advance the system with a certain
-	/// timestep dt.
-	///
-    void advance(double dt);	// converted to ms in Efield object
-
-    ////////////////////////////////////////////////////////////////////////
-    // METHODS: OBJECT ACCESS
     ////////////////////////////////////////////////////////////////////////
 
-    /// Return the potential at vertex i in mV
-    ///
-    double getV(int i) const
-    { return pV[i]; }
-
-    /// Set the potential at vertex i in mV.
-    ///
-	void setV(int i, double d)
-	{ pV[i] = d;}
-
-	////////////////////////////////////////////////////////////////////////
-
-	/// Return whether vertex i is clamped.
-	///
-	bool getClamped(int i) const
-	{ return pVertexClamp[i]; }
+    int getHalfBW(void) const
+    { return pHalfBW; }
 
-	/// (De-)activate the voltage clamp on some vertex i.
-	///
-	void setClamped(int i, bool b)
-    { pVertexClamp[i] = b; }
+    uint getNBlocks(void) const
+    { return pBlockHalfBW.size(); }
 
-	////////////////////////////////////////////////////////////////////////
+    void setMixedPrecision(bool mixed)
+    { pMixed = mixed; pMatrixValid = false; }
 
-	/// Return the amount of current being injected in a vertex in picoamp
-	///
-	bool getInj(int i) const
-    { return -pVertexInj[i]; }
-
-	/// Set the amount of current being injected in a vertex in picoamp
-	/// NOTE: Have to change the sign here to match the terms in the
-	/// matrix solution
-	void setInj(int i, double d)
-	{ pVertexInj[i] = -d; }
-
-	/// Set the amount of current that is constantly injected through a
-	/// vertex element until explicitly cancelled or changed.
-	/// NOTE: Have to change the sign here to match the terms in the
-	/// matrix solution
-    void setVertIClamp(int i, double c)
-	{
-		pVertCurClamp[i] = -c;
-	}
-
-	////////////////////////////////////////////////////////////////////////
-
-	/// Returns the current that will be injected in a triangle in picoamp
-	///
-    double getTriI(int i) const
-    { return -pTriCur[i]; }
-
-    /// Set an amount of current (expressed in ...) which is 'injected'
-    /// through a triangular surface element over one EField dt. This current is divided
-    /// over the 3 vertices that comprise the triangle and added to the
-    /// current injected in vertex, on top of the current set with
-    /// BandedMatrixProp::setInj. Usually these triangle currents
-    /// result from open channels and receptors computed in the
-    /// biochemical part of STEPS.
-	/// NOTE: Have to change the sign here to match the terms in the
-	/// matrix solution
-    void setTriI(int i, double d)
-	{
-		pTriCur[i] = -d;
-	}
-
-	/// Set the amount of current that is constantly injected through a
-	/// triangular element until explicitly cancelled or changed.
-	/// NOTE: Have to change the sign here to match the terms in the
-	/// matrix solution
-    void setTriIClamp(int i, double c)
-	{
-		pTriCurClamp[i] = -c;
-	}
+    bool getMixedPrecision(void) const
+    { return pMixed; }
 
 	////////////////////////////////////////////////////////////////////////
 
 private:
 
+    friend class BandedBlockLoop;
+
     ////////////////////////////////////////////////////////////////////////
     // INTERNAL METHODS
     ////////////////////////////////////////////////////////////////////////
 
-    /// Construct the matrix.
+    /// Decompose block b of the current matrix.
     ///
-    void populateMRHS(double);
+    void factorBlock(uint b);
 
-    /// What the hell does this do???? And when?? (See also: pTotGSurf,
-    /// pInjTot in this class.)
+    /// Solve block b for the right hand side rhs (over the rows of the
+    /// system), storing the solution in dv; thread is the index of the
+    /// calling thread, for its refinement workspace.
     ///
-    void chargeCheck(double);
+    void solveBlock(uint b, double const * rhs, double * dv, uint thread);
 
-    ////////////////////////////////////////////////////////////////////////
-    // DATA FIELDS
-    ////////////////////////////////////////////////////////////////////////
+    /// y = A x over the n rows of a block starting at row start, with
+    /// the double precision matrix A computed from the mesh.
+    ///
+    void blockMatVec(int start, int n, double const * x, double * y) const;
 
-    /// Pointer to the mesh.
+    /// Construct the banded matrix and compute its LU decomposition, or
+    /// take the shared decomposition of an equal matrix.
     ///
-    TetMesh *                   pMesh;
+    void buildMatrix(double dt);
 
-    /// Number of vertices in the mesh, stored locally.
+    /// Find the unclamped vertices and the blocks and band widths of
+    /// the system over them.
     ///
-    uint                        pNVerts;
+    void buildBlocks(void);
 
-    ////////////////////////////////////////////////////////////////////////
+    void clampsChanged(void)
+    { pMatrixValid = false; }
 
-    /// The initial potential set to all vertex points.
+    /// Write row ind of the banded matrix (that of unclamped vertex
+    /// pFree[ind]) for time step dt to row, with half bandwidth hbw,
+    /// that of the block of the row.
     ///
-    // double                      pV0;
+    void fillRow(int ind, int hbw, double dt, double * row) const;
 
-    /// The local potential over all mesh vertex points.
+    /// A pair of banded triangular solves with the stored decomposition.
     ///
-    double *                    pV;
-
-    double *                    pGExt;
+    void solve(void);
 
-    /// Extracellular potential (?)
-    ///
-    double                      pVExt;
+    ////////////////////////////////////////////////////////////////////////
+    // SOLUTION WORKSPACE
+    ////////////////////////////////////////////////////////////////////////
 
-    /// Vertex-based current injections.
+    /// The largest half bandwidth of the blocks, and the corresponding
+    /// band width.
     ///
-    double *                    pVertexInj;
+    int                         pHalfBW;
+    int                         pBW;
+    int                         maxdi;
 
-    /// An array storing, for each mesh vertex, whether the potential at
-    /// that vertex point should be clamped (true) or not (false).
+    /// The first vertex of each diagonal block, and the end of the last
+    /// (one more entry than blocks), and the half bandwidth of each.
     ///
-    bool *                      pVertexClamp;
+    std::vector<int>            pBlockStart;
+    std::vector<int>            pBlockHalfBW;
 
-    /// Currents over triangles.
+    /// The unclamped vertices, which the rows of the system stand for,
+    /// and the row of each vertex (-1 if clamped).
     ///
-    double *                    pTriCur;
+    std::vector<int>            pFree;
+    std::vector<int>            pCompact;
 
-    /// Current clamps over triangles
+    /// The right hand side and solution over the unclamped vertices,
+    /// empty when no vertex is clamped.
     ///
-    double * 					pTriCurClamp;
+    std::vector<double>         pFreeRHS;
+    std::vector<double>         pFreeDV;
 
+    /// Whether the decomposition is in single precision, and the time
+    /// step (times theta) of the current matrix, for the residuals.
     ///
-    double *                    pVertCur;
-
-    /// Current clamp over vertices. This will complement any triangle clamp
-
-    double *					pVertCurClamp;
-
-    ////////////////////////////////////////////////////////////////////////
-    // CONSISTENCY CHECKING
-    ////////////////////////////////////////////////////////////////////////
-
-    /// Total surface conductance... what does it mean, from where and in
-    /// which context is it set and why doesn't it appear to be used
-    /// anywhere outside of the chargeCheck method?
-    //double                      pTotGSurf;
+    bool                        pMixed;
+    double                      pBuildDt;
 
+    /// Refinement workspace and refinement step counts, per thread.
     ///
-    double                      pInjTot;
-
-    ////////////////////////////////////////////////////////////////////////
-    // SOLUTION WORKSPACE
-    ////////////////////////////////////////////////////////////////////////
-
-    // Replace with flat arrays as they are far quicker
-    /* *******************************
-    double **                   pRawBDM;
-    double **                   pMWK;
-    */
-
-    double *                    pRawBDM;
-
-    double *                    pMWK;
+    std::vector<std::vector<double> > pWork;
+    std::vector<uint>           pRefines;
 
-    double *                    pDV;
-    double *                    pRHS;
-
-    int                         pHalfBW;
-    int                         pBW;
-    int                         maxdi;
-    BandDiagonalMatrix *        pBDM;
+    // The decomposition of the current matrix, or 0 before the first.
+    BandedFactor *              pFactor;
 
     ////////////////////////////////////////////////////////////////////////
 
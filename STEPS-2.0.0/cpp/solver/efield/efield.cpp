@@ -25,15 +25,22 @@
 // STL headers.
 #include <iostream>
 #include <cassert>
+#include <map>
 #include <sstream>
+#include <string>
+#include <vector>
+#include <sys/time.h>
 
 // STEPS headers.
 #include "../../common.h"
 #include "../../error.hpp"
-#include "bdmatrixprop.hpp"
+#include "../../meshcache.hpp"
+#include "../../trace.hpp"
+#include "backend.hpp"
 #include "efield.hpp"
 #include "tetmesh.hpp"
 #include "tetcoupler.hpp"
+#include "vprop.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -41,6 +48,16 @@ NAMESPACE_ALIAS(steps::solver::efield, sefield);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Wall clock time in seconds, for the timing of the construction.
+static double wallTime(void)
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // All parameters are supplied in base s.i. units. EField object converts to
 // different units for matrix calculation:
 // Specific membrane capacitance: microfarad per square centimetre
@@ -51,94 +68,257 @@ NAMESPACE_ALIAS(steps::solver::efield, sefield);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// A coupled and ordered mesh with its membrane parameters applied, shared
+// by the EFields whose setup key is key.
+struct sefield::EFieldSetup
+{
+    std::string                         key;
+    uint                                refs;
+    TetMesh *                           mesh;
+    std::vector<uint>                   tritovert;
+};
+
+// The shared setups, by key. EFields are built and changed from one
+// thread at a time, so this needs no lock.
+static std::map<std::string, sefield::EFieldSetup *> efieldSetups;
+
+static void releaseSetup(sefield::EFieldSetup * s)
+{
+    if (s == 0 || --s->refs != 0) return;
+    if (s->key.empty() == false) efieldSetups.erase(s->key);
+    delete s->mesh;
+    delete s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 sefield::EField::EField
 (
     uint nverts, double * verts,
     uint ntris, uint * tris,
     uint ntets, uint * tets,
     uint opt_method,
-    std::string const & opt_file_name
+    std::string const & opt_file_name,
+    std::string const & backend,
+    std::string const & opt_data
 )
 : pVProp(0)
 , pMesh(0)
-, pNVerts(0)
-, pNTris(0)
-, pNTets(0)
+, pNVerts(nverts)
+, pNTris(ntris)
+, pNTets(ntets)
 , pCPerm()
+, pVerts(verts)
+, pTris(tris)
+, pTets(tets)
+, pOptMethod(opt_method)
+, pOptFile(opt_file_name)
+, pOptData(opt_data)
+, pBackend(backend)
+, pMeshKey()
+// Geometry is in microns, calculation uses pF, so we need to supply
+// specific capacitance in pF/um2. Default 1 uF/cm^2 = 0.01 pF/um^2
+, pCapac(0.01)
+// Geometry is in microns, times in ms and voltages in mV, so here we
+// need a conductivity in units of nS/um. or resistivity in Gohm_micron:
+// 1 ohm_m = 10-9 Gohm_m = 10-3 Gohm_micron.
+// Default is 100 ohm.cm  = 1 ohm.m
+, pCond(1.0/1.0e-3)
+, pSetup(0)
 , pTritoVert(0)
+, pSetupTime()
 {
-    pNVerts = nverts;
-    pNTris = ntris;
-    pNTets = ntets;
+    uint version = 1;
+    steps::ContentHash key;
+    key.add(&version, sizeof(uint));
+    key.add(&opt_method, sizeof(uint));
+    key.add(&nverts, sizeof(uint));
+    key.add(&ntris, sizeof(uint));
+    key.add(&ntets, sizeof(uint));
+    key.add(verts, nverts * 3 * sizeof(double));
+    key.add(tris, ntris * 3 * sizeof(uint));
+    key.add(tets, ntets * 4 * sizeof(uint));
+    pMeshKey = key.hex();
+
+    if (hasBackend(backend) == false)
+    {
+        // Fail before the mesh is built; createVProp lists the backends.
+        createVProp(backend, 0, opt_method);
+    }
+    _acquireSetup(0);
+    double t_start = wallTime();
+
+	// Default value for the membrane potential is -65mV but may be changed with
+	// solver method setPotential.
+	pVProp = createVProp(backend, pMesh, opt_method);
+	assert(pVProp != 0);
+	pVProp->setPotential(-65);
+
+	pSetupTime["matrix"] = wallTime() - t_start;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string sefield::EField::_setupKey(void) const
+{
+    steps::ContentHash key;
+    key.add(pMeshKey);
+    key.add(pOptFile);
+    key.add(pOptData);
+    key.add(&pCapac, sizeof(double));
+    key.add(&pCond, sizeof(double));
+    return key.hex();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::EField::_acquireSetup(EFieldSetup * src, bool priv)
+{
+    std::string setupkey;
+    if (priv == false)
+    {
+        setupkey = _setupKey();
+        if (pSetup != 0 && pSetup->key == setupkey) return;
+        std::map<std::string, EFieldSetup *>::iterator s = efieldSetups.find(setupkey);
+        if (s != efieldSetups.end())
+        {
+            ++s->second->refs;
+            releaseSetup(pSetup);
+            pSetup = s->second;
+            pMesh = pSetup->mesh;
+            pTritoVert = pNTris ? &pSetup->tritovert[0] : 0;
+            pCPerm = pMesh->getVertexPermutation();
+            if (pVProp != 0) pVProp->setMesh(pMesh);
+            pSetupTime["mesh"] = 0.0;
+            pSetupTime["couple"] = 0.0;
+            pSetupTime["order"] = 0.0;
+            return;
+        }
+    }
+
+    double t_start = wallTime();
+
+    // Without an optimization file of its own, the vertex ordering and
+    // coupling constants come from the mesh cache if it has them for
+    // this mesh and method, and are saved there if not.
+    std::string opt_file = pOptFile;
+    std::string cachefile;
+    if (src == 0 && opt_file.empty() && pOptData.empty() && steps::meshCacheOn())
+    {
+        steps::ContentHash key;
+        // The mesh key covers the same data as before it was kept.
+        key.add(pMeshKey);
+        cachefile = steps::meshCachePath("efield", key, ".opt");
+        if (steps::meshCacheHas(cachefile))
+        {
+            opt_file = cachefile;
+            cachefile.clear();
+        }
+    }
 
     // First, the mesh is constructed -- VertexElements are created
     // and triangle and tetrahedron arrays are copied
 	// TODO: (copying tris and tets is maybe not necessary?).
-	pMesh = new sefield::TetMesh(pNVerts, verts, pNTris, tris, pNTets, tets);
-	assert(pMesh != 0);
+	TetMesh * mesh = new sefield::TetMesh(pNVerts, pVerts, pNTris, pTris, pNTets, pTets);
+	assert(mesh != 0);
 
 	// Extract all unique connections, by looping over vertices and
 	// analyzing their edges.
-	pMesh->extractConnections();
+	mesh->extractConnections();
 
 	// For each triangle, compute its surface area and add one third
 	// of this value to each vertex associated with that triangle. The
 	// surface area of each vertex therefore receives contributions from
 	// each triangle that it is part of.
-	pMesh->allocateSurface();
-
-	// "Couple the mesh": this means that the coupling constant between
-	// each vertex-vertex connection gets computed.
-	TetCoupler tc(pMesh);
-	tc.coupleMesh();
+	mesh->allocateSurface();
 
+	double t_mesh = wallTime();
+	pSetupTime["mesh"] = t_mesh - t_start;
 
-	pMesh->axisOrderElements(opt_method, opt_file_name);
+	// "Couple the mesh": this means that the coupling constant between
+	// each vertex-vertex connection gets computed, unless a file saved
+	// with saveOptimal already holds them, or another EField's mesh.
+	if (src != 0)
+	{
+		mesh->copyOptimal(*src->mesh);
+	}
+	else if (pOptData.empty() == false)
+	{
+		std::istringstream opt(pOptData);
+		if (mesh->loadCoupling(opt) == false)
+		{
+			delete mesh;
+			std::ostringstream os;
+			os << "EField optimization data does not match the mesh.";
+			throw steps::ArgErr(os.str());
+		}
+	}
+	else if (opt_file == "" || mesh->loadCoupling(opt_file) == false)
+	{
+		TetCoupler tc(mesh);
+		tc.coupleMesh();
+	}
 
-	pCPerm = pMesh->getVertexPermutation();
+	double t_couple = wallTime();
+	pSetupTime["couple"] = t_couple - t_mesh;
 
+	// Method 5 steps only the membrane vertices; the interior, which it
+	// factorizes once, is ordered as in method 4.
+	if (src == 0 && pOptData.empty() == false)
+	{
+		std::istringstream opt(pOptData);
+		mesh->loadOrdering(opt);
+	}
+	else if (src == 0)
+	{
+		mesh->axisOrderElements((pOptMethod == 5) ? 4 : pOptMethod, opt_file);
+	}
 
-	// Geometry is in microns, calculation uses pF, so we need to supply
-	// specific capacitance in pF/um2. Default 1 uF/cm^2 = 0.01 pF/um^2
-	pMesh->applySurfaceCapacitance(0.01);
+	if (cachefile.empty() == false)
+	{
+		std::string tmp = steps::meshCacheTemp(cachefile);
+		mesh->saveOptimal(tmp);
+		steps::meshCachePublish(tmp, cachefile);
+	}
 
-	// Geometry is in microns, times in ms and voltages in mV, so here we
-	// need a conductivity in units of nS/um. or resistivity in Gohm_micron:
-	// 1 ohm_m = 10-9 Gohm_m = 10-3 Gohm_micron.
-	// Default is 100 ohm.cm  = 1 ohm.m
-	pMesh->applyConductance(1.0/1.0e-3);
+	pSetupTime["order"] = wallTime() - t_couple;
 
-	// Default value for the membrane potential is -65mV but may be changed with
-	// solver method setPotential
-	pVProp = new BandedMatrixProp(pMesh);
-	pVProp->setPotential(-65);
-	assert(pVProp != 0);
+	mesh->applySurfaceCapacitance(pCapac);
+	mesh->applyConductance(pCond);
 
-	pTritoVert = new uint[pNTris*3];
-	for (uint i=0; i< pNTris; ++i)
+	EFieldSetup * setup = new EFieldSetup;
+	setup->key = setupkey;
+	setup->refs = 1;
+	setup->mesh = mesh;
+	setup->tritovert.resize(pNTris * 3);
+	for (uint i = 0; i < pNTris; ++i)
 	{
-		pTritoVert[i*3] = pMesh->getTriangleVertex(i, 0);
-		pTritoVert[(i*3)+1] = pMesh->getTriangleVertex(i, 1);
-		pTritoVert[(i*3)+2] = pMesh->getTriangleVertex(i, 2);
-
+		setup->tritovert[i*3] = mesh->getTriangleVertex(i, 0);
+		setup->tritovert[(i*3)+1] = mesh->getTriangleVertex(i, 1);
+		setup->tritovert[(i*3)+2] = mesh->getTriangleVertex(i, 2);
 	}
+	if (priv == false) efieldSetups[setupkey] = setup;
 
+	releaseSetup(pSetup);
+	pSetup = setup;
+	pMesh = mesh;
+	pTritoVert = pNTris ? &setup->tritovert[0] : 0;
+	pCPerm = pMesh->getVertexPermutation();
+	if (pVProp != 0) pVProp->setMesh(pMesh);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 sefield::EField::~EField(void)
 {
-	delete pMesh;
 	delete pVProp;
-
-	delete[] pTritoVert;
+	releaseSetup(pSetup);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::EField::checkpoint(std::fstream & cp_file)
+void sefield::EField::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pNVerts, sizeof(uint));
     cp_file.write((char*)&pNTris, sizeof(uint));
@@ -154,7 +334,7 @@ void sefield::EField::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::EField::restore(std::fstream & cp_file)
+void sefield::EField::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pNVerts, sizeof(uint));
     cp_file.read((char*)&pNTris, sizeof(uint));
@@ -165,6 +345,8 @@ void sefield::EField::restore(std::fstream & cp_file)
     pCPerm.resize(nCPerm);
     cp_file.read((char*)&pCPerm.front(), sizeof(uint) * nCPerm);
 
+    // The restored mesh state belongs to this EField alone.
+    _acquireSetup(pSetup, true);
     pMesh->restore(cp_file);
     pVProp->restore(cp_file);
 }
@@ -180,7 +362,15 @@ void sefield::EField::setMembCapac(uint midx, double cm)
 	// Geometry is in microns, calculation uses pF, so we need to supply
 	// specific capacitance in pF/um2.
 	// Argument is in F/m^2: 1 F/m^2 = 1 pF / um^2 so no conversion needed!
-	pMesh->applySurfaceCapacitance(cm);
+	// A shared mesh is left to the EFields still using it.
+	if (pSetup->key.empty())
+	{
+		pMesh->applySurfaceCapacitance(cm);
+		pVProp->invalidateMatrix();
+		return;
+	}
+	pCapac = cm;
+	_acquireSetup(pSetup);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -199,7 +389,14 @@ void sefield::EField::setMembPotential(uint midx, double v)
 void sefield::EField::setMembVolRes(uint midx, double ro)
 {
 	assert(ro >= 0.0);
-	pMesh->applyConductance(1.0/(ro*1.0e-3));
+	if (pSetup->key.empty())
+	{
+		pMesh->applyConductance(1.0/(ro*1.0e-3));
+		pVProp->invalidateMatrix();
+		return;
+	}
+	pCond = 1.0/(ro*1.0e-3);
+	_acquireSetup(pSetup);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -250,6 +447,7 @@ void sefield::EField::setVertIClamp(uint vidx, double cur)
 
 void sefield::EField::advance(double dt)
 {
+	STEPS_TRACE("EField::advance");
 	assert(dt >= 0.0);
 
 	//Convert to ms
@@ -258,6 +456,92 @@ void sefield::EField::advance(double dt)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void sefield::EField::setTheta(double theta)
+{
+	assert(theta >= 0.5 && theta <= 1.0);
+	pVProp->setTheta(theta);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double sefield::EField::getTheta(void) const
+{
+	return pVProp->getTheta();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double sefield::EField::getMaxDV(void) const
+{
+	// Convert to volts
+	return pVProp->getMaxDV() * 1.0e-3;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int sefield::EField::getHalfBW(void) const
+{
+	return pVProp->getHalfBW();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sefield::EField::getNBlocks(void) const
+{
+	return pVProp->getNBlocks();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sefield::EField::getNRefine(void) const
+{
+	return pVProp->getNRefine();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::EField::setMixedPrecision(bool mixed)
+{
+	pVProp->setMixedPrecision(mixed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sefield::EField::getMixedPrecision(void) const
+{
+	return pVProp->getMixedPrecision();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::EField::setThreads(uint n)
+{
+	assert(n >= 1);
+	pVProp->setThreads(n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::EField::getStats(double & t_rhs, double & t_matrix,
+                               double & t_solve, uint & nsteps,
+                               uint & nmatrix) const
+{
+	t_rhs = pVProp->getTimeRHS();
+	t_matrix = pVProp->getTimeMatrix();
+	t_solve = pVProp->getTimeSolve();
+	nsteps = pVProp->getNSteps();
+	nmatrix = pVProp->getNMatrix();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::EField::resetStats(void)
+{
+	pVProp->resetTimes();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 double sefield::EField::getVertV(uint vidx)
 {
 	// vidx argument converted to local index in Tetexact.
@@ -268,6 +552,7 @@ double sefield::EField::getVertV(uint vidx)
 	vidx = pCPerm[vidx];
 
 	// convert from mV to V
+	pVProp->updateInterior();
 	return pVProp->getV(vidx)*1.0e-3;
 }
 
@@ -416,8 +701,25 @@ void sefield::EField::setTriIClamp(uint tidx, double cur)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/*
-void    sefield::EField::setTriI(double * cur)
+
+void sefield::EField::getTriVs(double * v)
+{
+	uint * tv = pTritoVert;
+	for (uint i = 0; i < pNTris; ++i, tv += 3)
+	{
+		double pot = 0.0;
+		pot += pVProp->getV(tv[0]);
+		pot += pVProp->getV(tv[1]);
+		pot += pVProp->getV(tv[2]);
+
+		// getV returns in milliVolts
+		v[i] = ((pot*1.0e-3)/3.0);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::EField::setTriIs(double const * cur)
 {
 	for (uint i = 0; i < pNTris; ++i)
 	{
@@ -425,7 +727,7 @@ void    sefield::EField::setTriI(double * cur)
 		pVProp->setTriI(i, cur[i]*1.0e12);
 	}
 }
-*/
+
 ////////////////////////////////////////////////////////////////////////////////
 
 double	sefield::EField::getTetV(uint tidx)
@@ -443,6 +745,7 @@ double	sefield::EField::getTetV(uint tidx)
 	uint v3 = pMesh->getTetrahedronVertex(tidx, 3);
 
 	// Directly use VProp since we have mesh indices
+	pVProp->updateInterior();
 	pot += pVProp->getV(v0);
 	pot += pVProp->getV(v1);
 	pot += pVProp->getV(v2);
@@ -506,5 +809,25 @@ void sefield::EField::saveOptimal(std::string const & opt_file_name)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void sefield::EField::saveOptimal(std::ostream & opt)
+{
+	pMesh->saveOptimal(opt);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t sefield::EField::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(EField);
+    bytes += pCPerm.capacity() * sizeof(uint);
+    // The shared setup is split between the EFields using it.
+    bytes += (pSetup->tritovert.capacity() * sizeof(uint)
+        + pMesh->getMemoryUsage()) / pSetup->refs;
+    bytes += pVProp->getMemoryUsage();
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
 
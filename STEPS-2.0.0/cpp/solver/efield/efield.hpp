@@ -32,6 +32,9 @@
 #include "../../common.h"
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <vector>
+#include <string>
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -43,7 +46,8 @@ START_NAMESPACE(efield)
 
 // Forward declarations
 class TetMesh;
-class BandedMatrixProp;
+class VProp;
+struct EFieldSetup;
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -56,6 +60,14 @@ class BandedMatrixProp;
 // may be set with solver methods, or take default values.
 // Default value for resistivity  = 1.0x10^-2 farad / m^2
 // Default value for bulk resistivity is 1 ohm.m
+//
+// EFields of the same mesh, optimization method and file, capacitance and
+// bulk resistivity, such as those of an ensemble of replicates, share one
+// coupled and ordered mesh; each keeps its own potentials and currents,
+// and the banded LU factors are shared too while the matrices are equal
+// (see BandedMatrixProp). Changing the capacitance or resistivity moves an
+// EField to the mesh for the new values, made from the current one
+// without coupling or ordering again.
 class EField
 {
 
@@ -75,6 +87,11 @@ public:
     /// \param ntets Number of tetrahedral elements in the mesh.
     /// \param tets  A 1D array of ntets * 4 uints in row-major order. These
     ///         indices point into the vertex array.
+    /// \param backend The registered backend (see backend.hpp) that
+    ///         creates the propagator; "cpu" by default.
+    /// \param opt_data The bytes saveOptimal writes for this mesh, read
+    ///         in place of an optimization file, as when a solver is
+    ///         restarted from a checkpoint.
     ///
 	EField
 	(
@@ -82,7 +99,9 @@ public:
         uint ntris, uint * tris,
         uint ntets, uint * tets,
         uint opt_method = 1,
-        std::string const & opt_file_name = ""
+        std::string const & opt_file_name = "",
+        std::string const & backend = "cpu",
+        std::string const & opt_data = ""
 	);
 
 	/// Destructor
@@ -92,13 +111,26 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by the EField: its mesh, its
+    /// potential propagator with the system matrix, and its own tables.
+    std::size_t getMemoryUsage(void) const;
 
     // Save optimal vertex configuration
     void saveOptimal(std::string const & opt_file_name);
+    void saveOptimal(std::ostream & opt);
+
+    /// Wall clock time in seconds that each phase of the construction
+    /// took: "mesh" (vertices, connections and surface areas), "couple"
+    /// (the coupling constants, computed or loaded), "order" (the vertex
+    /// ordering) and "matrix" (the potential propagator). The first three
+    /// are 0 if the mesh was shared with another EField.
+    inline std::map<std::string, double> const & getSetupTimes(void) const
+    { return pSetupTime; }
 
     ////////////////////////////////////////////////////////////////////////
 
@@ -191,10 +223,16 @@ public:
 	/// \param cur Current clamp for the triangle surface element
 	void 	setTriIClamp(uint tidx, double cur);
 
-	/// Auxiliary function for setting current in all triangles at once.
+	/// Return the electric potential of all triangle surface elements
+	/// at once (volts), as getTriV does for each.
+	/// \param v A 1D array, size = number of surface triangles, to fill
+	void    getTriVs(double * v);
+
+	/// Set the current across all triangle surface elements at once, as
+	/// setTriI does for each.
 	/// \param cur A 1D array, size = number of surface triangles,
-	/// 	of current across triangles
-	// void    setTriI(double * cur);
+	/// 	of current across triangles (amps)
+	void    setTriIs(double const * cur);
 
 	////////////////////////////////////////////////////////////////////////
 
@@ -232,20 +270,98 @@ public:
 	/// \param sec The time to advance the EField simulation (seconds)
 	void    advance(double sec);
 
+	/// Set the implicitness of the potential update: 1.0 for backward
+	/// Euler (default), 0.5 for Crank-Nicolson.
+	/// \param theta Weight of the end of the step, in [0.5, 1.0]
+	void    setTheta(double theta);
+
+	/// Return the implicitness of the potential update.
+	double  getTheta(void) const;
+
+	/// Return the largest potential change of an unclamped vertex over
+	/// the last call to advance (volts).
+	double  getMaxDV(void) const;
+
+	/// Return the half bandwidth of the banded matrix of the solver
+	/// (0 if it does not factorize one).
+	int     getHalfBW(void) const;
+
+	/// Return the number of independent blocks of the system, one per
+	/// connected part of the mesh for the banded solver.
+	uint    getNBlocks(void) const;
+
+	/// Set the number of threads that decompose and solve independent
+	/// blocks of the system (default 1).
+	void    setThreads(uint n);
+
+	/// Return the wall clock time (seconds) that advance spent in the
+	/// right hand side, the matrix construction and factorization and the
+	/// solve, and the number of steps and matrix constructions, since the
+	/// last call to resetStats.
+	void    getStats(double & t_rhs, double & t_matrix, double & t_solve,
+	                 uint & nsteps, uint & nmatrix) const;
+
+	/// Return the number of iterative refinement steps since the last
+	/// resetStats (with mixed precision).
+	uint    getNRefine(void) const;
+
+	/// Zero the counters returned by getStats.
+	void    resetStats(void);
+
+	/// Return the name of the backend of the propagator.
+	std::string const & getBackend(void) const
+	{ return pBackend; }
+
+	/// Decompose the banded matrix in single precision and refine its
+	/// solutions in double precision (default off). Only the banded
+	/// solver supports this; the others ignore it.
+	void    setMixedPrecision(bool mixed);
+
+	bool    getMixedPrecision(void) const;
+
 	////////////////////////////////////////////////////////////////////////
 
 private:
 
+    /// Key of the shared mesh for the current parameters.
+    std::string _setupKey(void) const;
+
+    /// Switch to the shared mesh for the current parameters, building it
+    /// if no EField has it: coupled and ordered from scratch (or the
+    /// optimization data or file, or mesh cache) if src is 0, else copied from
+    /// the mesh of src. If priv, the mesh is built for this EField alone
+    /// and can be changed in place.
+    void _acquireSetup(EFieldSetup * src, bool priv = false);
+
     TetMesh *                   pMesh;
-    BandedMatrixProp *          pVProp;
+    VProp *                     pVProp;
     std::vector<uint>           pCPerm;
 
     uint 						pNVerts;
     uint 						pNTris;
     uint 						pNTets;
 
+    // The mesh arrays, kept by the solver, to build meshes from.
+    double                    * pVerts;
+    uint                      * pTris;
+    uint                      * pTets;
+    uint                        pOptMethod;
+    std::string                 pOptFile;
+    std::string                 pOptData;
+    std::string                 pBackend;
+    // Hash of the above, the part of the setup key that never changes.
+    std::string                 pMeshKey;
+
+    // Capacitance (pF/um^2) and conductance (nS/um) applied to the mesh.
+    double                      pCapac;
+    double                      pCond;
+
+    EFieldSetup               * pSetup;
+
     uint 					  * pTritoVert;
 
+    std::map<std::string, double> pSetupTime;
+
 };
 
 ////////////////////////////////////////////////////////////////////////////////
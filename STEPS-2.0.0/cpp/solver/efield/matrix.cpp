@@ -101,7 +101,7 @@ sefield::Matrix::~Matrix(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::Matrix::checkpoint(std::fstream & cp_file)
+void sefield::Matrix::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pN, sizeof(uint));
     cp_file.write((char*)&pSign, sizeof(int));
@@ -112,7 +112,7 @@ void sefield::Matrix::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::Matrix::restore(std::fstream & cp_file)
+void sefield::Matrix::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pN, sizeof(uint));
     cp_file.read((char*)&pSign, sizeof(int));
@@ -0,0 +1,426 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+// STEPS headers.
+#include "../../common.h"
+#include "../../error.hpp"
+#include "bdmatrix.hpp"
+#include "schurmatrixprop.hpp"
+#include "tetmesh.hpp"
+#include "vertexelement.hpp"
+#include "vprop.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+USING_NAMESPACE(std);
+NAMESPACE_ALIAS(steps::solver::efield, sefield);
+
+////////////////////////////////////////////////////////////////////////////////
+
+sefield::SchurMatrixProp::SchurMatrixProp(TetMesh * msh)
+: VProp(msh)
+, pSurf()
+, pInt()
+, pPos(pNVerts)
+, pOnSurf(pNVerts, 0)
+, pIntHalfBW(0)
+, pKII(0)
+, pKIIWK(0)
+, pKIIBDM(0)
+, pKred()
+, pChol()
+, pReduced(false)
+, pReducedStamp(0)
+, pIntCur()
+, pIntStale(false)
+, pWorkS()
+, pWorkI()
+, pWorkI2()
+{
+	// The membrane vertices are the ones with surface area: only they
+	// carry capacitance, membrane conductance and triangle currents.
+	for (uint i = 0; i < pNVerts; ++i)
+	{
+		if (pMesh->getVertex(i)->getSurfaceArea() > 0.0)
+		{
+			pOnSurf[i] = 1;
+			pPos[i] = pSurf.size();
+			pSurf.push_back(i);
+		}
+		else
+		{
+			pPos[i] = pInt.size();
+			pInt.push_back(i);
+		}
+	}
+	uint ns = pSurf.size();
+	uint ni = pInt.size();
+
+	// The band of K_II, with the interior vertices in mesh order.
+	for (uint a = 0; a < ni; ++a)
+	{
+		uint v = pInt[a];
+		uint row_end = pMesh->getNbrStart(v + 1);
+		for (uint j = pMesh->getNbrStart(v); j < row_end; ++j)
+		{
+			uint k = pMesh->getNbrIdx(j);
+			if (pOnSurf[k] != 0) continue;
+			int di = static_cast<int>(pPos[k]) - static_cast<int>(a);
+			if (di < 0) di = -di;
+			if (di > pIntHalfBW) pIntHalfBW = di;
+		}
+	}
+	if (ni != 0)
+	{
+		int bw = 2 * pIntHalfBW + 1;
+		pKII = new double[ni * bw];
+		fill_n(pKII, ni * bw, 0.0);
+		pKIIWK = new double[ni * (pIntHalfBW + 1)];
+		fill_n(pKIIWK, ni * (pIntHalfBW + 1), 0.0);
+		pKIIBDM = new BandDiagonalMatrix(ni, bw, pKII, pKIIWK);
+	}
+
+	pKred.resize(ns * ns, 0.0);
+	pChol.resize(ns * ns, 0.0);
+	pIntCur.resize(ni, 0.0);
+	pWorkS.resize(ns, 0.0);
+	pWorkI.resize(ni, 0.0);
+	pWorkI2.resize(ni, 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sefield::SchurMatrixProp::~SchurMatrixProp(void)
+{
+	delete pKIIBDM;
+	delete[] pKII;
+	delete[] pKIIWK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SchurMatrixProp::checkpoint(std::iostream & cp_file)
+{
+	// Only the potentials are stored; the reduction is rebuilt on restore.
+	updateInterior();
+	VProp::checkpoint(cp_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SchurMatrixProp::restore(std::iostream & cp_file)
+{
+	VProp::restore(cp_file);
+	fill(pIntCur.begin(), pIntCur.end(), 0.0);
+	pIntStale = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SchurMatrixProp::reduce(void)
+{
+	uint ns = pSurf.size();
+	uint ni = pInt.size();
+
+	// K_SS first: the diagonal holds the sum of all coupling constants
+	// of a vertex, the off-diagonals minus the constant of each
+	// surface-surface connection.
+	fill(pKred.begin(), pKred.end(), 0.0);
+	for (uint a = 0; a < ns; ++a)
+	{
+		uint v = pSurf[a];
+		uint row_end = pMesh->getNbrStart(v + 1);
+		for (uint j = pMesh->getNbrStart(v); j < row_end; ++j)
+		{
+			uint k = pMesh->getNbrIdx(j);
+			double cc = pMesh->getNbrCC(j);
+			pKred[a * ns + a] += cc;
+			if (pOnSurf[k] != 0)
+			{
+				pKred[a * ns + pPos[k]] -= cc;
+			}
+		}
+	}
+
+	if (ni != 0)
+	{
+		int nw = 2 * pIntHalfBW + 1;
+		fill_n(pKII, ni * nw, 0.0);
+		for (uint a = 0; a < ni; ++a)
+		{
+			uint v = pInt[a];
+			uint row_end = pMesh->getNbrStart(v + 1);
+			for (uint j = pMesh->getNbrStart(v); j < row_end; ++j)
+			{
+				uint k = pMesh->getNbrIdx(j);
+				double cc = pMesh->getNbrCC(j);
+				pKII[a * nw + pIntHalfBW] += cc;
+				if (pOnSurf[k] == 0)
+				{
+					pKII[a * nw + (pPos[k] - a + pIntHalfBW)] -= cc;
+				}
+			}
+		}
+		pKIIBDM->lu();
+
+		// Subtract K_SI K_II^-1 K_IS one column at a time. Column b of
+		// K_IS is minus the constants of surface vertex b to its
+		// interior neighbours, so only those columns need a solve.
+		for (uint b = 0; b < ns; ++b)
+		{
+			uint vb = pSurf[b];
+			bool inner = false;
+			fill(pWorkI.begin(), pWorkI.end(), 0.0);
+			uint row_end = pMesh->getNbrStart(vb + 1);
+			for (uint j = pMesh->getNbrStart(vb); j < row_end; ++j)
+			{
+				uint k = pMesh->getNbrIdx(j);
+				if (pOnSurf[k] != 0) continue;
+				pWorkI[pPos[k]] = -pMesh->getNbrCC(j);
+				inner = true;
+			}
+			if (inner == false) continue;
+
+			pKIIBDM->lubksb(&pWorkI[0], &pWorkI2[0]);
+			for (uint a = 0; a < ns; ++a)
+			{
+				uint va = pSurf[a];
+				double sum = 0.0;
+				uint a_end = pMesh->getNbrStart(va + 1);
+				for (uint j = pMesh->getNbrStart(va); j < a_end; ++j)
+				{
+					uint k = pMesh->getNbrIdx(j);
+					if (pOnSurf[k] != 0) continue;
+					sum += pMesh->getNbrCC(j) * pWorkI2[pPos[k]];
+				}
+				pKred[a * ns + b] += sum;
+			}
+		}
+	}
+
+	// Symmetric up to rounding.
+	for (uint a = 0; a < ns; ++a)
+	{
+		for (uint b = 0; b < a; ++b)
+		{
+			double m = 0.5 * (pKred[a * ns + b] + pKred[b * ns + a]);
+			pKred[a * ns + b] = m;
+			pKred[b * ns + a] = m;
+		}
+	}
+
+	pReduced = true;
+	pReducedStamp = pMesh->getNbrTableStamp();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SchurMatrixProp::buildMatrix(double dt)
+{
+	if (pReduced == false || pReducedStamp != pMesh->getNbrTableStamp())
+	{
+		reduce();
+	}
+
+	uint ns = pSurf.size();
+	for (uint a = 0; a < ns; ++a)
+	{
+		uint v = pSurf[a];
+		for (uint b = 0; b < a; ++b)
+		{
+			pChol[a * ns + b] = dt * pKred[a * ns + b];
+		}
+		pChol[a * ns + a] = pMesh->getVertex(v)->getCapacitance()
+		                  + dt * (pGExt[v] + pKred[a * ns + a]);
+	}
+
+	// In-place Cholesky of the lower triangle.
+	for (uint j = 0; j < ns; ++j)
+	{
+		double * lj = &pChol[j * ns];
+		double d = lj[j];
+		for (uint k = 0; k < j; ++k) d -= lj[k] * lj[k];
+		if (d <= 0.0)
+		{
+			std::ostringstream os;
+			os << "EField reduced membrane matrix is not positive definite.";
+			throw steps::ProgErr(os.str());
+		}
+		lj[j] = sqrt(d);
+		for (uint i = j + 1; i < ns; ++i)
+		{
+			double * li = &pChol[i * ns];
+			double s = li[j];
+			for (uint k = 0; k < j; ++k) s -= li[k] * lj[k];
+			li[j] = s / lj[j];
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SchurMatrixProp::populateRHS(double dt)
+{
+	collectCurrents();
+
+	uint ns = pSurf.size();
+	uint ni = pInt.size();
+
+	// Currents injected into interior vertices reach the membrane
+	// through K_SI K_II^-1.
+	bool intcur = false;
+	for (uint a = 0; a < ni; ++a)
+	{
+		pIntCur[a] = pVertCur[pInt[a]];
+		if (pIntCur[a] != 0.0) intcur = true;
+	}
+	if (intcur == true)
+	{
+		pKIIBDM->lubksb(&pIntCur[0], &pWorkI2[0]);
+	}
+
+	for (uint a = 0; a < ns; ++a)
+	{
+		uint v = pSurf[a];
+		double cur = pVertCur[v] + pGExt[v] * (pVExt - pV[v]);
+
+		double const * kred = &pKred[a * ns];
+		for (uint b = 0; b < ns; ++b)
+		{
+			cur -= kred[b] * pV[pSurf[b]];
+		}
+
+		if (intcur == true)
+		{
+			uint row_end = pMesh->getNbrStart(v + 1);
+			for (uint j = pMesh->getNbrStart(v); j < row_end; ++j)
+			{
+				uint k = pMesh->getNbrIdx(j);
+				if (pOnSurf[k] != 0) continue;
+				cur += pMesh->getNbrCC(j) * pWorkI2[pPos[k]];
+			}
+		}
+		pRHS[v] = cur * dt;
+	}
+	for (uint a = 0; a < ni; ++a)
+	{
+		pRHS[pInt[a]] = 0.0;
+	}
+
+	fill_n(pVertCur, pNVerts, 0.0);
+	pIntStale = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SchurMatrixProp::solve(void)
+{
+	uint ns = pSurf.size();
+	for (uint a = 0; a < ns; ++a)
+	{
+		double const * la = &pChol[a * ns];
+		double s = pRHS[pSurf[a]];
+		for (uint k = 0; k < a; ++k) s -= la[k] * pWorkS[k];
+		pWorkS[a] = s / la[a];
+	}
+	for (uint a = ns; a-- > 0; )
+	{
+		double s = pWorkS[a];
+		for (uint k = a + 1; k < ns; ++k) s -= pChol[k * ns + a] * pWorkS[k];
+		pWorkS[a] = s / pChol[a * ns + a];
+	}
+	for (uint a = 0; a < ns; ++a)
+	{
+		pDV[pSurf[a]] = pWorkS[a];
+	}
+
+	// The interior follows when read, see updateInterior.
+	uint ni = pInt.size();
+	for (uint a = 0; a < ni; ++a)
+	{
+		pDV[pInt[a]] = 0.0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SchurMatrixProp::updateInterior(void)
+{
+	uint ni = pInt.size();
+	if (pIntStale == false || ni == 0) return;
+	if (pReduced == false || pReducedStamp != pMesh->getNbrTableStamp())
+	{
+		reduce();
+	}
+
+	// K_II V_I = I_I - K_IS V_S.
+	for (uint a = 0; a < ni; ++a)
+	{
+		uint v = pInt[a];
+		double b = pIntCur[a];
+		uint row_end = pMesh->getNbrStart(v + 1);
+		for (uint j = pMesh->getNbrStart(v); j < row_end; ++j)
+		{
+			uint k = pMesh->getNbrIdx(j);
+			if (pOnSurf[k] == 0) continue;
+			b += pMesh->getNbrCC(j) * pV[k];
+		}
+		pWorkI[a] = b;
+	}
+	pKIIBDM->lubksb(&pWorkI[0], &pWorkI2[0]);
+	for (uint a = 0; a < ni; ++a)
+	{
+		uint v = pInt[a];
+		if (pVertexClamp[v] == false) pV[v] = pWorkI2[a];
+	}
+	pIntStale = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t sefield::SchurMatrixProp::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(SchurMatrixProp) + _tableMemoryUsage();
+    bytes += (pSurf.capacity() + pInt.capacity() + pPos.capacity()) * sizeof(uint);
+    bytes += pOnSurf.capacity() * sizeof(char);
+    if (pKIIBDM != 0)
+    {
+        uint ni = pInt.size();
+        bytes += ni * (3 * pIntHalfBW + 2) * sizeof(double);
+        bytes += pKIIBDM->getMemoryUsage();
+    }
+    bytes += (pKred.capacity() + pChol.capacity() + pIntCur.capacity()) * sizeof(double);
+    bytes += (pWorkS.capacity() + pWorkI.capacity() + pWorkI2.capacity()) * sizeof(double);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
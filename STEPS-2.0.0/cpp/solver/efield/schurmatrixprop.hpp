@@ -0,0 +1,191 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef STEPS_SOLVER_EFIELD_SCHURMATRIXPROP_HPP
+#define STEPS_SOLVER_EFIELD_SCHURMATRIXPROP_HPP 1
+
+// STL headers.
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "bdmatrix.hpp"
+#include "tetmesh.hpp"
+#include "vprop.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(efield)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Steps only the membrane (surface) vertices. The interior vertices have
+/// no capacitance, so their potentials follow from the surface ones at
+/// every instant: with K the conductance matrix split into surface (S)
+/// and interior (I) blocks, K_II V_I = I_I - K_IS V_S. Eliminating them
+/// leaves the Schur complement
+///
+///     Kred = K_SS - K_SI K_II^-1 K_IS
+///
+/// and C_S dV_S/dt = I_S + G (VExt - V_S) - Kred V_S - K_SI K_II^-1 I_I,
+/// which is stepped like the full system. This is exact, not an
+/// approximation.
+///
+/// Kred is dense. It is computed once from a banded factorization of
+/// K_II and recomputed only when the coupling constants change, and the
+/// reduced matrix is factorized (Cholesky) only when dt or the membrane
+/// parameters change. A step then costs O(ns^2) for ns surface vertices,
+/// independent of the interior; storage is 2 ns^2 doubles. Interior
+/// potentials are solved for only when read. Clamps on interior vertices
+/// are not supported.
+///
+class SchurMatrixProp
+: public VProp
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Constructor; splits the vertices of a mesh into surface and
+    /// interior ones.
+    ///
+	SchurMatrixProp(TetMesh * msh);
+
+	/// Destructor.
+	///
+	~SchurMatrixProp(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // CHECKPOINTING
+    ////////////////////////////////////////////////////////////////////////
+    /// checkpoint data
+    void checkpoint(std::iostream & cp_file);
+
+    /// restore data
+    void restore(std::iostream & cp_file);
+
+    std::size_t getMemoryUsage(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Solve for the interior potentials if the surface has been stepped
+    /// since they were last computed.
+    ///
+    void updateInterior(void);
+
+    /// The half bandwidth of K_II.
+    ///
+    int getHalfBW(void) const
+    { return pIntHalfBW; }
+
+	////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+    // INTERNAL METHODS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Factorize K_II and compute Kred.
+    ///
+    void reduce(void);
+
+    /// Factorize C_S + dt (G_S + Kred), reducing first if the coupling
+    /// constants have changed.
+    ///
+    void buildMatrix(double dt);
+
+    /// The right hand side of the reduced system on the surface vertices.
+    ///
+    void populateRHS(double dt);
+
+    /// Forward and back substitution with the Cholesky factor.
+    ///
+    void solve(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLUTION WORKSPACE
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Vertex indices of the surface and interior vertices, the
+    /// position of each vertex in its own list and whether it is on
+    /// the surface.
+    ///
+    std::vector<uint>           pSurf;
+    std::vector<uint>           pInt;
+    std::vector<uint>           pPos;
+    std::vector<char>           pOnSurf;
+
+    /// Banded LU of K_II, over the interior vertices in mesh order.
+    ///
+    int                         pIntHalfBW;
+    double *                    pKII;
+    double *                    pKIIWK;
+    BandDiagonalMatrix *        pKIIBDM;
+
+    /// The Schur complement and the Cholesky factor of the reduced
+    /// system matrix, both ns x ns, row by row.
+    ///
+    std::vector<double>         pKred;
+    std::vector<double>         pChol;
+
+    /// Whether pKred is valid, and the mesh stamp it was computed for.
+    ///
+    bool                        pReduced;
+    uint                        pReducedStamp;
+
+    /// The interior currents of the last step (pA), and whether the
+    /// interior potentials are behind the surface.
+    ///
+    std::vector<double>         pIntCur;
+    bool                        pIntStale;
+
+    std::vector<double>         pWorkS;
+    std::vector<double>         pWorkI;
+    std::vector<double>         pWorkI2;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(efield)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
+// STEPS_SOLVER_EFIELD_SCHURMATRIXPROP_HPP
+
+// END
@@ -0,0 +1,274 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+// STEPS headers.
+#include "../../common.h"
+#include "sparsematrixprop.hpp"
+#include "tetmesh.hpp"
+#include "vertexconnection.hpp"
+#include "vertexelement.hpp"
+#include "vprop.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+USING_NAMESPACE(std);
+NAMESPACE_ALIAS(steps::solver::efield, sefield);
+
+////////////////////////////////////////////////////////////////////////////////
+
+sefield::SparseMatrixProp::SparseMatrixProp(TetMesh * msh)
+: VProp(msh)
+, pRowStart(0)
+, pColIdx(0)
+, pValues(0)
+, pDiagInv(0)
+, pR(0)
+, pZ(0)
+, pP(0)
+, pQ(0)
+{
+	// Each row holds the diagonal followed by the vertex neighbours.
+	pRowStart = new uint[pNVerts + 1];
+	fill_n(pRowStart, pNVerts + 1, 0);
+	for (uint i = 0; i < pNVerts; ++i)
+	{
+		pRowStart[i + 1] = pMesh->getNbrStart(i + 1) + i + 1;
+	}
+
+	uint nnz = pRowStart[pNVerts];
+	pColIdx = new uint[nnz];
+	pValues = new double[nnz];
+	fill_n(pValues, nnz, 0.0);
+	fillColumns();
+
+	pDiagInv = new double[pNVerts];
+	fill_n(pDiagInv, pNVerts, 0.0);
+
+	pR = new double[pNVerts];
+	pZ = new double[pNVerts];
+	pP = new double[pNVerts];
+	pQ = new double[pNVerts];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sefield::SparseMatrixProp::~SparseMatrixProp(void)
+{
+	delete[] pRowStart;
+	delete[] pColIdx;
+	delete[] pValues;
+	delete[] pDiagInv;
+	delete[] pR;
+	delete[] pZ;
+	delete[] pP;
+	delete[] pQ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SparseMatrixProp::checkpoint(std::iostream & cp_file)
+{
+    VProp::checkpoint(cp_file);
+
+    cp_file.write((char*)pDV, sizeof(double) * pNVerts);
+    cp_file.write((char*)pRHS, sizeof(double) * pNVerts);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SparseMatrixProp::restore(std::iostream & cp_file)
+{
+    VProp::restore(cp_file);
+
+    cp_file.read((char*)pDV, sizeof(double) * pNVerts);
+    cp_file.read((char*)pRHS, sizeof(double) * pNVerts);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SparseMatrixProp::fillColumns(void)
+{
+	for (uint ind = 0; ind < pNVerts; ++ind)
+	{
+		uint * cols = pColIdx + pRowStart[ind];
+		cols[0] = ind;
+		uint nbr0 = pMesh->getNbrStart(ind);
+		uint ncon = pMesh->getNbrStart(ind + 1) - nbr0;
+		for (uint inbr = 0; inbr < ncon; ++inbr)
+		{
+			cols[inbr + 1] = pMesh->getNbrIdx(nbr0 + inbr);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SparseMatrixProp::setMesh(TetMesh * msh)
+{
+	// Same vertices and connections, possibly listed in another order.
+	VProp::setMesh(msh);
+	fillColumns();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SparseMatrixProp::buildMatrix(double dt)
+{
+	// Same terms as BandedMatrixProp::buildMatrix; the matrix is
+	// symmetric because the coupling constants are per connection.
+	// A clamped vertex has an identity row and column, and a zero
+	// right hand side (see solve), so its potential does not change.
+	for (uint ind = 0; ind < pNVerts; ++ind)
+	{
+		VertexElement * ve = pMesh->getVertex(ind);
+		double * vals = pValues + pRowStart[ind];
+		if (pVertexClamp[ind] == true)
+		{
+			fill_n(vals, pRowStart[ind + 1] - pRowStart[ind], 0.0);
+			vals[0] = 1.0;
+			pDiagInv[ind] = 1.0;
+			continue;
+		}
+
+		vals[0] = ve->getCapacitance() + dt * pGExt[ind];
+		uint nbr0 = pMesh->getNbrStart(ind);
+		uint ncon = pMesh->getNbrStart(ind + 1) - nbr0;
+		for (uint inbr = 0; inbr < ncon; ++inbr)
+		{
+			double cc = dt * pMesh->getNbrCC(nbr0 + inbr);
+			vals[0] += cc;
+			vals[inbr + 1] = pVertexClamp[pColIdx[pRowStart[ind] + inbr + 1]] ? 0.0 : -cc;
+		}
+		pDiagInv[ind] = (vals[0] != 0.0) ? 1.0 / vals[0] : 1.0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SparseMatrixProp::matVec(double const * x, double * y) const
+{
+	for (uint i = 0; i < pNVerts; ++i)
+	{
+		double sum = 0.0;
+		uint end = pRowStart[i + 1];
+		for (uint j = pRowStart[i]; j < end; ++j)
+		{
+			sum += pValues[j] * x[pColIdx[j]];
+		}
+		y[i] = sum;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::SparseMatrixProp::solve(void)
+{
+	double bnorm2 = 0.0;
+	for (uint i = 0; i < pNVerts; ++i)
+	{
+		if (pVertexClamp[i] == true) pRHS[i] = 0.0;
+		bnorm2 += pRHS[i] * pRHS[i];
+	}
+	if (bnorm2 == 0.0)
+	{
+		fill_n(pDV, pNVerts, 0.0);
+		return;
+	}
+	double tol2 = EFIELD_CG_TOLERANCE * EFIELD_CG_TOLERANCE * bnorm2;
+
+	// The previous step's solution is a good starting guess: the
+	// potential changes vary smoothly from one step to the next.
+	matVec(pDV, pQ);
+	double rz = 0.0;
+	double rr = 0.0;
+	for (uint i = 0; i < pNVerts; ++i)
+	{
+		pR[i] = pRHS[i] - pQ[i];
+		pZ[i] = pDiagInv[i] * pR[i];
+		pP[i] = pZ[i];
+		rz += pR[i] * pZ[i];
+		rr += pR[i] * pR[i];
+	}
+
+	// In exact arithmetic CG converges in at most pNVerts iterations.
+	uint maxiter = pNVerts + 1;
+	uint iter = 0;
+	while (rr > tol2 && iter < maxiter)
+	{
+		matVec(pP, pQ);
+		double pq = 0.0;
+		for (uint i = 0; i < pNVerts; ++i)
+		{
+			pq += pP[i] * pQ[i];
+		}
+		double alpha = rz / pq;
+
+		double rznew = 0.0;
+		rr = 0.0;
+		for (uint i = 0; i < pNVerts; ++i)
+		{
+			pDV[i] += alpha * pP[i];
+			pR[i] -= alpha * pQ[i];
+			pZ[i] = pDiagInv[i] * pR[i];
+			rznew += pR[i] * pZ[i];
+			rr += pR[i] * pR[i];
+		}
+
+		double beta = rznew / rz;
+		rz = rznew;
+		for (uint i = 0; i < pNVerts; ++i)
+		{
+			pP[i] = pZ[i] + beta * pP[i];
+		}
+		++iter;
+	}
+
+	if (rr > tol2)
+	{
+		cout << "\nWarning - EField conjugate gradient did not converge, relative residual ";
+		cout << sqrt(rr / bnorm2) << endl;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t sefield::SparseMatrixProp::getMemoryUsage(void) const
+{
+    uint nnz = pRowStart[pNVerts];
+    std::size_t bytes = sizeof(SparseMatrixProp) + _tableMemoryUsage();
+    bytes += (pNVerts + 1 + nnz) * sizeof(uint) + nnz * sizeof(double);
+    // Inverse diagonal and the four conjugate gradient vectors.
+    bytes += pNVerts * 5 * sizeof(double);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,156 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_EFIELD_SPARSEMATRIXPROP_HPP
+#define STEPS_SOLVER_EFIELD_SPARSEMATRIXPROP_HPP 1
+
+// STL headers.
+#include <fstream>
+#include <iostream>
+
+// STEPS headers.
+#include "../../common.h"
+#include "tetmesh.hpp"
+#include "vprop.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(efield)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Relative residual at which the conjugate gradient iteration stops.
+#define EFIELD_CG_TOLERANCE             1.0e-10
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Solves the system with a Jacobi-preconditioned conjugate gradient
+/// iteration on a compressed sparse row copy of the matrix, built from
+/// the vertex connections. Storage is proportional to the number of
+/// connections rather than to the band width, so this is the better
+/// choice for branched morphologies where no vertex ordering gives a
+/// narrow band.
+///
+class SparseMatrixProp
+: public VProp
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Constructor; creates the sparse matrix structure for a certain mesh.
+    ///
+	SparseMatrixProp(TetMesh * msh);
+
+	/// Destructor.
+	///
+	~SparseMatrixProp(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // CHECKPOINTING
+    ////////////////////////////////////////////////////////////////////////
+    /// checkpoint data
+    void checkpoint(std::iostream & cp_file);
+
+    /// restore data
+    void restore(std::iostream & cp_file);
+
+    std::size_t getMemoryUsage(void) const;
+
+    /// Switch to msh as VProp::setMesh does, taking the column indices
+    /// from its neighbour table.
+    ///
+    void setMesh(TetMesh * msh);
+
+	////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+    // INTERNAL METHODS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Copy the column indices of each row from the mesh neighbour table.
+    ///
+    void fillColumns(void);
+
+    void clampsChanged(void)
+    { pMatrixValid = false; }
+
+    /// Fill in the matrix values and the inverse diagonal used as
+    /// preconditioner.
+    ///
+    void buildMatrix(double dt);
+
+    /// Conjugate gradient solve, starting from the previous solution.
+    ///
+    void solve(void);
+
+    /// y = A * x.
+    ///
+    void matVec(double const * x, double * y) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLUTION WORKSPACE
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Start of each row in pColIdx and pValues (pNVerts + 1 entries).
+    /// The diagonal is stored first in each row.
+    ///
+    uint *                      pRowStart;
+    uint *                      pColIdx;
+    double *                    pValues;
+
+    /// Inverse of the matrix diagonal (Jacobi preconditioner).
+    ///
+    double *                    pDiagInv;
+
+    /// Conjugate gradient work vectors.
+    ///
+    double *                    pR;
+    double *                    pZ;
+    double *                    pP;
+    double *                    pQ;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(efield)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
+// STEPS_SOLVER_EFIELD_SPARSEMATRIXPROP_HPP
+
+// END
@@ -32,7 +32,7 @@
 
 // STEPS headers.
 #include "../../common.h"
-#include "matrix.hpp"
+#include "../../math/smallmatrix.hpp"
 #include "tetcoupler.hpp"
 #include "tetmesh.hpp"
 #include "vertexconnection.hpp"
@@ -60,99 +60,61 @@ sefield::TetCoupler::~TetCoupler(void)
 
 void sefield::TetCoupler::coupleMesh(void)
 {
-    typedef vector<double*> doublePVec;
-    typedef doublePVec::iterator doublePVecI;
-    typedef doublePVec::const_iterator doublePVecCI;
-
-    // For each vertex allocate space to accumulate coupling coefficients
-    // to neighbors.
+    // For each vertex, the coupling coefficients to its neighbours are
+    // accumulated in one flat array, in the order of the vertex's
+    // neighbour list, starting at offset[vertex].
     uint nvertices = pMesh->countVertices();
-    doublePVec vccs(nvertices);
-    doublePVecI vccs_bgn = vccs.begin();
-    doublePVecI vccs_end = vccs.end();
+    vector<uint> offset(nvertices + 1, 0);
     for (uint i = 0; i < nvertices; ++i)
     {
         VertexElement * vertex = pMesh->getVertex(i);
         assert(vertex->getIDX() == i);
-        uint ncons = vertex->getNCon();
-        double * new_vccs = new double[ncons];
-        // initialize the array.
-        fill_n(new_vccs, ncons, 0.0);
-        vccs[i] = new_vccs;
+        offset[i + 1] = offset[i] + vertex->getNCon();
     }
+    vector<double> vccs(offset[nvertices], 0.0);
 
-    // Loop over all vertices in the mesh. For each vertex:
-    //
-    //   * Fetch a list of neighbouring tetrahedra ('neighbouring'
-    //     meaning a tetrahedron that includes the current vertex).
+    // A single pass over the tetrahedra. For each tetrahedron and each
+    // of its corners:
     //
-    //   * For each neighbouring tetrahedron:
+    //   * Compute the flux into the polyhedron around the corner in
+    //     terms of the potential difference to the other three corners.
     //
-    //       * Transform its vertex indices into pointers to
-    //         corresponding VertexElement objects.
+    //   * Add these to the coefficients of the corner's connections to
+    //     the other three, found by a scan of its (short) neighbour list.
     //
-    //       * Compute flux coefficients and distribute them over the
-    //         'neighbouring' vertex nodes.
-    //
-    for (uint ivert = 0; ivert < nvertices; ++ivert)
+    uint ntets = pMesh->getNTet();
+    for (uint itet = 0; itet < ntets; ++itet)
     {
-        VertexElement * ve = pMesh->getVertex(ivert);
-
-        // Now we need the following information about vertex ve:
-        // a list of tetrahedrons of which ve is a part. This list
-        // is returned as indices in the ve's neighbour's list.
-        vector<vector<uint> >  vti = pMesh->getNeighboringTetrahedra(ve);
-
-        // for (int[] tetinds : pMesh.neighboringTetrahedra(ve)) {
-
-        // Loop over neighoubring tetrahedra
-        for (uint inbr = 0; inbr < vti.size(); ++inbr)
+        uint * tet = pMesh->getTetrahedron(itet);
+        for (uint icorner = 0; icorner < 4; ++icorner)
         {
-            // Get the tetrahedron by vertex neighbour indices (e.g if the vertex has 6 nighbours one
-            // tetrahedron may be 2,4,5 or something
-
-            vector<uint> tetinds = (vti)[inbr];
-
-            // Get an array of the neighbouring vertices.
-            // (As said before, the ints in tetinds are indices in
-            // the neighbours list of vertex ve, not global indices.
-            VertexElement ** ves = new VertexElement*[3];
+            VertexElement * ve = pMesh->getVertex(tet[icorner]);
+            VertexElement * ves[3];
             for (uint i = 0; i < 3; ++i)
             {
-                ves[i] = ve->getNeighbor(tetinds[i]);
+                ves[i] = pMesh->getVertex(tet[(icorner + i + 1) % 4]);
             }
-            // Compute the flux into the polyhedron around the vertex in
-            // terms of the potential difference to each of the corners.
-            double facs[3];
-            facs[0]=0.0;
-            facs[1]=0.0;
-            facs[2]=0.0;
-
 
+            double facs[3];
+            facs[0] = 0.0;
+            facs[1] = 0.0;
+            facs[2] = 0.0;
             fluxCoeficients(ve, ves, facs);
-            // Destroy the ves array
-            delete[] ves;
 
-            // Accumulate coefficients for neighbours in vccs.
+            uint ncons = ve->getNCon();
+            double * ve_vccs = &vccs[offset[tet[icorner]]];
             for (uint i = 0; i < 3; ++i)
             {
-                //assert(facs[i] > 0.0);
-                vccs[ivert][tetinds[i]] += facs[i];
+                for (uint inbr = 0; inbr < ncons; ++inbr)
+                {
+                    if (ve->getNeighbor(inbr) == ves[i])
+                    {
+                        ve_vccs[inbr] += facs[i];
+                        break;
+                    }
+                }
             }
-
-            // Delete the return vector.
-            //delete[] facs;
         }
-
-        /*
-        // Destroy the list of neighbouring tetrahedrons.
-        vector<vector<uint> >::iterator vti_end = vti.end();
-        for (vector<vector<uint> >::iterator vti_r = vti.begin();
-            vti_r != vti_end; ++vti_r)
-        {
-            delete[] (*vti_r);
-        }
-        */
     }
 
     // If all has gone according to plan, then the fluxes are symmetric
@@ -177,9 +139,10 @@ void sefield::TetCoupler::coupleMesh(void)
         double wab = 0.0;
         for (uint i = 0; i < va->getNCon(); ++i)
         {
-            if (va->getNeighbor(i)->getIDX() == vb_idx)
+            if (va->getNeighbor(i) == vb)
             {
-                wab = vccs[va_idx][i];
+                wab = vccs[offset[va_idx] + i];
+                break;
             }
         }
 
@@ -187,9 +150,10 @@ void sefield::TetCoupler::coupleMesh(void)
         double wba = 0.0;
         for (uint i = 0; i < vb->getNCon(); ++i)
         {
-            if (vb->getNeighbor(i)->getIDX() == va_idx)
+            if (vb->getNeighbor(i) == va)
             {
-                wba = vccs[vb_idx][i];
+                wba = vccs[offset[vb_idx] + i];
+                break;
             }
         }
 
@@ -220,13 +184,6 @@ void sefield::TetCoupler::coupleMesh(void)
     {
         cout << "\nSymmetry test: all fine" << endl;
     }
-
-    // Deallocate vccs.
-
-    for (doublePVecI vccs_i = vccs_bgn; vccs_i != vccs_end; ++vccs_i)
-    {
-        delete[] (*vccs_i);
-    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -301,14 +258,8 @@ void sefield::TetCoupler::fluxCoeficients(sefield::VertexElement * ve, sefield::
 
     // Matrix ordering is [row][colunmn], so m[2][0] is the third row,
     // first column of matrix with the vectors to the three adjacent
-
-
     // vertices in its rows.
-    double** m = new double*[3];
-    for (uint i = 0; i < 3; ++i)
-    {
-        m[i] = new double[3];
-    }
+    double m[3][3];
 
     // This matrix is already the transpose of matrix in equation 13
     for (uint iv = 0; iv < 3; ++iv)
@@ -317,18 +268,14 @@ void sefield::TetCoupler::fluxCoeficients(sefield::VertexElement * ve, sefield::
         m[iv][1] = ves[iv]->getY() - ve->getY();
         m[iv][2] = ves[iv]->getZ() - ve->getZ();
     }
-    // Create a matrix with m as initialization.
-    Matrix* vm = new Matrix(3, m);
 
     // Need to be consistent about the orientation of tetrahedra. One way
     // is to take the dot product of one vector with the cross product of
     // the other two and make sure it always has the same sign by swapping
     // rows two and three if neessary. The dot-cross product is the same
     // as the determinant up to a scaling factor
-
-
     bool swap = false;
-    if (vm->det() < 0.)
+    if (steps::math::det(m) < 0.)
     {
         // switch second and third rows of m;
         for (uint i = 0; i < 3; ++i)
@@ -336,16 +283,12 @@ void sefield::TetCoupler::fluxCoeficients(sefield::VertexElement * ve, sefield::
             double w = m[1][i];
             m[1][i] = m[2][i];
             m[2][i] = w;
-            swap = true;
         }
-        delete vm;
-        vm = new Matrix(3, m);
+        swap = true;
     }
 
-
-    // CORRECT METHOD
-    Matrix * vmi = vm->inverse();
-    delete vm;
+    double inv[3][3];
+    steps::math::inverse(m, inv);
 
     // consider the other vertices in turn
     for (int ivert = 0; ivert < 3; ivert++)
@@ -378,15 +321,13 @@ void sefield::TetCoupler::fluxCoeficients(sefield::VertexElement * ve, sefield::
         vec[1] = (f * c1[1]) + (g * c2[1]) + (f * c3[1]);
         vec[2] = (f * c1[2]) + (g * c2[2]) + (f * c3[2]);
 
-        double * wk = vmi->lvprod(vec);
-
         // accumulate the contribution from these two triangles into the final return array
 		// the 0.5 is because the area of the triangle is half the cross product
         for (int i = 0; i < 3; i++)
         {
-            ret[i] += (0.5 * wk[i]);
+            double wk = (vec[0] * inv[0][i]) + (vec[1] * inv[1][i]) + (vec[2] * inv[2][i]);
+            ret[i] += (0.5 * wk);
         }
-        delete wk;
     }
 
     // if we swapped the sense of the tetrahedron above, swap the results
@@ -397,16 +338,6 @@ void sefield::TetCoupler::fluxCoeficients(sefield::VertexElement * ve, sefield::
         ret[1] = ret[2];
         ret[2] = w;
     }
-
-	// memory allocated for m not cleaned up. Lets do that now
-	for (uint i = 0; i < 3; ++i)
-    {
-        delete[] m[i];
-    }
-	delete[] m;
-
-    delete vmi;
-
 }
 
 ////////////////////////////////////////////////////////////////////////////////
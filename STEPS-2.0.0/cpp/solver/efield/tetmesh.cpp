@@ -109,6 +109,10 @@ sefield::TetMesh::TetMesh
 : pElements(nv)
 , pConnections()
 , pVertexPerm(0)
+, pNbrStart()
+, pNbrIdx()
+, pNbrCC()
+, pNbrTableStamp(0)
 , pNTri(ntr)
 , pNTet(ntet)
 , pTetrahedrons(0)
@@ -189,7 +193,7 @@ sefield::TetMesh::~TetMesh(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::TetMesh::checkpoint(std::fstream & cp_file)
+void sefield::TetMesh::checkpoint(std::iostream & cp_file)
 {
     uint nelems = pElements.size();
     cp_file.write((char*)&nelems, sizeof(uint));
@@ -206,7 +210,7 @@ void sefield::TetMesh::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::TetMesh::restore(std::fstream & cp_file)
+void sefield::TetMesh::restore(std::iostream & cp_file)
 {
     uint nelems = 0;
     cp_file.read((char*)&nelems, sizeof(uint));
@@ -232,6 +236,7 @@ void sefield::TetMesh::restore(std::fstream & cp_file)
         pConnections[c]->restore(cp_file);
     }
     cp_file.read((char*)pVertexPerm, sizeof(uint) * nelems);
+    buildNbrTable();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -286,6 +291,7 @@ void sefield::TetMesh::extractConnections(void)
         pElements[i]->fix();
         pVertexPerm[i] = i;
     }
+    buildNbrTable();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -357,6 +363,37 @@ void sefield::TetMesh::reindexElements(void)
     {
         (*e)->setIDX(i);
     }
+    buildNbrTable();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::TetMesh::buildNbrTable(void)
+{
+    uint nelems = pElements.size();
+    pNbrStart.resize(nelems + 1);
+    pNbrStart[0] = 0;
+    for (uint i = 0; i < nelems; ++i)
+    {
+        pNbrStart[i + 1] = pNbrStart[i] + pElements[i]->getNCon();
+    }
+
+    static uint stamps = 0;
+    pNbrTableStamp = ++stamps;
+    pNbrIdx.resize(pNbrStart[nelems]);
+    pNbrCC.resize(pNbrStart[nelems]);
+    for (uint i = 0; i < nelems; ++i)
+    {
+        VertexElement * ve = pElements[i];
+        assert(ve->getIDX() == i);
+        uint ncon = ve->getNCon();
+        uint row = pNbrStart[i];
+        for (uint j = 0; j < ncon; ++j)
+        {
+            pNbrIdx[row + j] = ve->nbrIdx(j);
+            pNbrCC[row + j] = ve->getCC(j);
+        }
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -416,6 +453,7 @@ void sefield::TetMesh::applyConductance(double d)
     {
         pElements[i]->applyConductance(d);
     }
+    buildNbrTable();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -465,6 +503,84 @@ std::vector<double> sefield::TetMesh::centerOfMass(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Breadth-first walk over the vertices from start that takes the
+// neighbours of each vertex in the order of its connections, as
+// TetMesh::fill_ve_vec does, marking each reached vertex with stamp in mark.
+static void csr_walk(vector<uint> const & nbr_start, vector<uint> const & nbr_idx,
+                     uint start, vector<uint> & mark, uint stamp,
+                     vector<uint> & walk)
+{
+    walk.clear();
+    walk.push_back(start);
+    mark[start] = stamp;
+    for (uint head = 0; head < walk.size(); ++head)
+    {
+        uint v = walk[head];
+        uint row_end = nbr_start[v + 1];
+        for (uint i = nbr_start[v]; i < row_end; ++i)
+        {
+            uint nb = nbr_idx[i];
+            if (mark[nb] == stamp) continue;
+            mark[nb] = stamp;
+            walk.push_back(nb);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Breadth-first walk over the vertices from start, marking each reached
+// vertex with stamp in mark. Return the number of levels of the walk and
+// fill last with the vertices of its last level.
+static uint rcm_levels(vector<uint> const & nbr_start, vector<uint> const & nbr_idx,
+                       uint start, vector<uint> & mark, uint stamp,
+                       vector<uint> & walk, vector<uint> & last)
+{
+    walk.clear();
+    walk.push_back(start);
+    mark[start] = stamp;
+    uint levels = 0;
+    uint head = 0;
+    while (head < walk.size())
+    {
+        uint level_end = walk.size();
+        last.assign(walk.begin() + head, walk.end());
+        ++levels;
+        for (; head < level_end; ++head)
+        {
+            uint v = walk[head];
+            uint row_end = nbr_start[v + 1];
+            for (uint i = nbr_start[v]; i < row_end; ++i)
+            {
+                uint nb = nbr_idx[i];
+                if (mark[nb] == stamp) continue;
+                mark[nb] = stamp;
+                walk.push_back(nb);
+            }
+        }
+    }
+    return levels;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Orders vertex indices by increasing number of connections.
+struct rcm_by_degree
+{
+    rcm_by_degree(vector<uint> const & nbr_start)
+    : pNbrStart(nbr_start)
+    { }
+
+    bool operator() (uint a, uint b) const
+    {
+        return (pNbrStart[a + 1] - pNbrStart[a]) < (pNbrStart[b + 1] - pNbrStart[b]);
+    }
+
+    vector<uint> const & pNbrStart;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 void sefield::TetMesh::axisOrderElements(uint opt_method, std::string const & opt_file_name)
 {
 
@@ -472,6 +588,8 @@ void sefield::TetMesh::axisOrderElements(uint opt_method, std::string const & op
 	// and the new method by Iain. The original method is fast and suffices for
 	// simple geometries, Iain's method is superior and important for complex
 	// geometries, but slow.
+	// Method 4, reverse Cuthill-McKee, gives a band like Iain's method
+	// in near-linear time.
 
 	if (opt_file_name != "")
 	{
@@ -480,30 +598,7 @@ void sefield::TetMesh::axisOrderElements(uint opt_method, std::string const & op
 	    opt_file.open(opt_file_name.c_str(),
 	                std::fstream::in | std::fstream::binary);
 	    opt_file.seekg(0);
-
-	    uint nelems = 0;
-	    opt_file.read((char*)&nelems, sizeof(uint));
-	    if (pElements.size() != nelems) {
-	        std::ostringstream os;
-	        os << "optimal data mismatch with simulator parameters: sefield::Tetmesh::nelems, ";
-	        os << nelems << ":" << pElements.size();
-	        throw steps::ArgErr(os.str());
-	    }
-	    opt_file.read((char*)pVertexPerm, sizeof(uint) * nelems);
-
-	    VertexElementPVec elements_temp = pElements;
-
-	    for (uint vidx = 0; vidx < nelems; ++vidx)
-	    {
-	    	VertexElementP vep = elements_temp[vidx];
-	    	// sanity check
-	    	assert(vep->getIDX() == vidx);
-	    	uint new_idx = pVertexPerm[vidx];
-	    	pElements[new_idx] = vep;
-	    }
-
-	    reindexElements();
-	    reordered();
+	    loadOrdering(opt_file);
 	    opt_file.close();
 	    return;
 
@@ -523,53 +618,30 @@ void sefield::TetMesh::axisOrderElements(uint opt_method, std::string const & op
 		uint bestone = 0;
 		uint bestwidth = pNVerts;
 
-		std::vector<VertexElement*> orig_indices = pElements;
-
         stringstream ss;
         ss << "\nFinding optimal vertex indexing. This can take some time...";
         cout << ss.str() << endl;
+
+		// The walks and their band widths run over the compressed vertex
+		// graph, in the original indices; only the best walk is applied.
+		vector<uint> mark(pNVerts, 0);
+		vector<uint> walk;
+		vector<uint> pos(pNVerts, 0);
 		for (uint vidx = 0; vidx < pNVerts; ++vidx)
 		{
-			set<VertexElement*> verteleset = set<VertexElement*>();
-			vector<VertexElement*> vertelevec = vector<VertexElement*>();
-			queue<VertexElement*> vertelqueue = queue<VertexElement*>();
-
-			verteleset.insert(orig_indices[vidx]);
-			vertelevec.push_back(orig_indices[vidx]);
-			uint ve0ncons = orig_indices[vidx]->getNCon();
-			VertexElement ** ve0neighbs = orig_indices[vidx]->getNeighbours();
-
-			fill_ve_vec(verteleset, vertelevec, vertelqueue, ve0ncons, ve0neighbs);
-			pElements.clear();
-
-			vector<VertexElement*>::iterator vertele_end = vertelevec.end();
-			uint ielt = 0;
-
-			for (vector<VertexElement*>::iterator vertele = vertelevec.begin(); vertele != vertele_end; ++vertele)
-			{
-				pElements.push_back(*vertele);
-				pVertexPerm[(*vertele)->getIDX()]=ielt;
-				ielt++;
-			}
-
-			// Note: this will reorder the vertex indices as we go- not a problem in this loop
-			// but they must be reset for the final index setting to work
-			reindexElements();
+			csr_walk(pNbrStart, pNbrIdx, vidx, mark, vidx + 1, walk);
+			uint nwalk = walk.size();
+			for (uint i = 0; i < nwalk; ++i) pos[walk[i]] = i;
 
 			uint maxdi = 0;
-			for (int iv = 0; iv < pNVerts; ++iv)
+			for (uint i = 0; i < nwalk; ++i)
 			{
-				VertexElement* ve = getVertex(iv);
-				int ind = ve->getIDX();
-
-				for (int i = 0; i < ve->getNCon(); ++i)
+				uint v = walk[i];
+				uint row_end = pNbrStart[v + 1];
+				for (uint j = pNbrStart[v]; j < row_end; ++j)
 				{
-					int inbr = ve->nbrIdx(i);
-					int di = ind - inbr;
-					if (di < 0)
-					{
-						di = -di;
-					}
+					uint p = pos[pNbrIdx[j]];
+					uint di = (p > i) ? (p - i) : (i - p);
 					if (di > maxdi)
 					{
 						maxdi = di;
@@ -584,36 +656,28 @@ void sefield::TetMesh::axisOrderElements(uint opt_method, std::string const & op
 			}
 		}
 
-		// reset the vertex indices to their original value: important
-		for (uint v = 0; v < pNVerts; ++v)
-		{
-			orig_indices[v]->setIDX(v);
-		}
-
-		set<VertexElement*> verteleset = set<VertexElement*>();
-		vector<VertexElement*> vertelevec = vector<VertexElement*>();
-		queue<VertexElement*> vertelqueue = queue<VertexElement*>();
-
-		verteleset.insert(orig_indices[bestone]);
-		vertelevec.push_back(orig_indices[bestone]);
-		uint ve0ncons = orig_indices[bestone]->getNCon();
-		VertexElement ** ve0neighbs = orig_indices[bestone]->getNeighbours();
-
-		fill_ve_vec(verteleset, vertelevec, vertelqueue, ve0ncons, ve0neighbs);
+		// A walk only covers the part of the mesh it starts in; the
+		// other parts follow, each walked from its first vertex.
+		VertexElementPVec orig_indices = pElements;
 		pElements.clear();
-
-		vector<VertexElement*>::iterator vertele_end = vertelevec.end();
-		uint ielt = 0;
-		for (vector<VertexElement*>::iterator vertele = vertelevec.begin(); vertele != vertele_end; ++vertele)
+		for (uint vidx = bestone; pElements.size() < pNVerts; vidx = (vidx + 1) % pNVerts)
 		{
-			pElements.push_back(*vertele);
-			pVertexPerm[(*vertele)->getIDX()]=ielt;
-			ielt++;
+			if (mark[vidx] == pNVerts + 1) continue;
+			csr_walk(pNbrStart, pNbrIdx, vidx, mark, pNVerts + 1, walk);
+
+			uint nwalk = walk.size();
+			for (uint ielt = 0; ielt < nwalk; ++ielt)
+			{
+				pVertexPerm[walk[ielt]] = pElements.size();
+				pElements.push_back(orig_indices[walk[ielt]]);
+			}
 		}
 	}
     // / / / / / / / / / / / /  / / / / / / / / / / / / / / / / / / / / / / //
 
-	else if (opt_method == 1)
+	// Method 3 uses a sparse iterative solver, for which the band width
+	// does not matter; the cheap axis ordering still gives good locality.
+	else if (opt_method == 1 || opt_method == 3)
 	{
 		/*
 
@@ -706,6 +770,75 @@ void sefield::TetMesh::axisOrderElements(uint opt_method, std::string const & op
 			ielt++;
 		}
 	}
+	else if (opt_method == 4)
+	{
+		// Reverse Cuthill-McKee. In each connected part of the membrane,
+		// the walk starts from a pseudo-peripheral vertex (Gibbs, Poole and
+		// Stockmeyer; George and Liu): walk from a vertex, restart from
+		// the least connected vertex of the last level as long as that
+		// gives more levels. The walk then takes the neighbours of each
+		// vertex in order of increasing connections, and the ordering is
+		// its reverse. Each walk is linear in the size of the part, so
+		// this gives a band comparable to method 2 in near-linear time.
+		uint nverts = pElements.size();
+		for (uint v = 0; v < nverts; ++v) assert(pElements[v]->getIDX() == v);
+
+		vector<uint> bydegree(nverts);
+		for (uint v = 0; v < nverts; ++v) bydegree[v] = v;
+		stable_sort(bydegree.begin(), bydegree.end(), rcm_by_degree(pNbrStart));
+
+		vector<uint> mark(nverts, 0);
+		uint stamp = 0;
+		vector<bool> visited(nverts, false);
+		vector<uint> walk, last, next;
+		vector<uint> order;
+		order.reserve(nverts);
+		for (uint s = 0; s < nverts; ++s)
+		{
+			uint start = bydegree[s];
+			if (visited[start] == true) continue;
+
+			uint levels = rcm_levels(pNbrStart, pNbrIdx, start, mark, ++stamp, walk, last);
+			while (true)
+			{
+				uint cand = *min_element(last.begin(), last.end(), rcm_by_degree(pNbrStart));
+				vector<uint> cand_last;
+				uint cand_levels = rcm_levels(pNbrStart, pNbrIdx, cand, mark, ++stamp, walk, cand_last);
+				if (cand_levels <= levels) break;
+				start = cand;
+				levels = cand_levels;
+				last.swap(cand_last);
+			}
+
+			visited[start] = true;
+			uint head = order.size();
+			order.push_back(start);
+			while (head < order.size())
+			{
+				uint v = order[head++];
+				uint row_end = pNbrStart[v + 1];
+				next.clear();
+				for (uint i = pNbrStart[v]; i < row_end; ++i)
+				{
+					uint nb = pNbrIdx[i];
+					if (visited[nb] == true) continue;
+					visited[nb] = true;
+					next.push_back(nb);
+				}
+				stable_sort(next.begin(), next.end(), rcm_by_degree(pNbrStart));
+				order.insert(order.end(), next.begin(), next.end());
+			}
+		}
+		assert(order.size() == nverts);
+
+		VertexElementPVec elements_temp = pElements;
+		for (uint i = 0; i < nverts; ++i)
+		{
+			uint vidx = order[nverts - 1 - i];
+			pElements[i] = elements_temp[vidx];
+			pVertexPerm[vidx] = i;
+		}
+	}
 	else
 	{
 		std::ostringstream os;
@@ -713,7 +846,7 @@ void sefield::TetMesh::axisOrderElements(uint opt_method, std::string const & op
 		throw steps::ArgErr(os.str());
 	}
 
-
+    groupComponents();
     reindexElements();
     reordered();
 
@@ -721,19 +854,173 @@ void sefield::TetMesh::axisOrderElements(uint opt_method, std::string const & op
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void sefield::TetMesh::saveOptimal(std::string const & opt_file_name)
+void sefield::TetMesh::groupComponents(void)
 {
+    // The neighbour table still holds the original indices here.
+    uint nverts = pElements.size();
+    vector<uint> comp(nverts, nverts);
+    vector<uint> mark(nverts, 0);
+    vector<uint> walk;
+    vector<uint> start(1, 0);
+    for (uint i = 0; i < nverts; ++i)
+    {
+        uint v = pElements[i]->getIDX();
+        if (comp[v] != nverts) continue;
+        csr_walk(pNbrStart, pNbrIdx, v, mark, 1, walk);
+        uint nwalk = walk.size();
+        for (uint j = 0; j < nwalk; ++j) comp[walk[j]] = start.size() - 1;
+        start.push_back(start.back() + nwalk);
+    }
+    if (start.size() <= 2) return;
+
+    VertexElementPVec elements_temp = pElements;
+    for (uint i = 0; i < nverts; ++i)
+    {
+        uint v = elements_temp[i]->getIDX();
+        uint pos = start[comp[v]]++;
+        pElements[pos] = elements_temp[i];
+        pVertexPerm[v] = pos;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
 
+void sefield::TetMesh::loadOrdering(std::istream & opt_file)
+{
+    uint nelems = 0;
+    opt_file.read((char*)&nelems, sizeof(uint));
+    if (pElements.size() != nelems) {
+        std::ostringstream os;
+        os << "optimal data mismatch with simulator parameters: sefield::Tetmesh::nelems, ";
+        os << nelems << ":" << pElements.size();
+        throw steps::ArgErr(os.str());
+    }
+    opt_file.read((char*)pVertexPerm, sizeof(uint) * nelems);
+
+    VertexElementPVec elements_temp = pElements;
+
+    for (uint vidx = 0; vidx < nelems; ++vidx)
+    {
+    	VertexElementP vep = elements_temp[vidx];
+    	// sanity check
+    	assert(vep->getIDX() == vidx);
+    	uint new_idx = pVertexPerm[vidx];
+    	pElements[new_idx] = vep;
+    }
+
+    reindexElements();
+    reordered();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::TetMesh::saveOptimal(std::string const & opt_file_name)
+{
 	std::fstream opt_file;
 
 	opt_file.open(opt_file_name.c_str(),
                 std::fstream::out | std::fstream::binary | std::fstream::trunc);
+	saveOptimal(opt_file);
+    opt_file.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::TetMesh::saveOptimal(std::ostream & opt_file)
+{
 	uint nelems = pElements.size();
 	opt_file.write((char*)&nelems, sizeof(uint));
 
 	opt_file.write((char*)pVertexPerm, sizeof(uint) * nelems);
-    opt_file.close();
 
+	// The order of the connections differs between runs, so each
+	// coupling constant is stored with the original indices of its
+	// vertices.
+	std::vector<uint> orig_idx(nelems);
+	for (uint i = 0; i < nelems; ++i) orig_idx[pVertexPerm[i]] = i;
+
+	uint ncons = pConnections.size();
+	opt_file.write((char*)&ncons, sizeof(uint));
+	for (uint icon = 0; icon < ncons; ++icon)
+	{
+		VertexConnection * vc = pConnections[icon];
+		uint ends[2];
+		ends[0] = orig_idx[vc->getA()->getIDX()];
+		ends[1] = orig_idx[vc->getB()->getIDX()];
+		double cc = vc->getGeomCouplingConstant();
+		opt_file.write((char*)ends, sizeof(uint) * 2);
+		opt_file.write((char*)&cc, sizeof(double));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sefield::TetMesh::loadCoupling(std::string const & opt_file_name)
+{
+	std::fstream opt_file;
+
+	opt_file.open(opt_file_name.c_str(),
+                std::fstream::in | std::fstream::binary);
+	bool ok = loadCoupling(opt_file);
+	opt_file.close();
+	return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sefield::TetMesh::loadCoupling(std::istream & opt_file)
+{
+	uint nelems = 0;
+	opt_file.read((char*)&nelems, sizeof(uint));
+	if (!opt_file || nelems != pElements.size()) return false;
+	opt_file.seekg(sizeof(uint) * nelems, std::ios_base::cur);
+
+	uint ncons = 0;
+	opt_file.read((char*)&ncons, sizeof(uint));
+	if (!opt_file || ncons != pConnections.size()) return false;
+
+	// Nothing is reordered yet, so vertex indices are the original ones.
+	std::map<std::pair<uint, uint>, double> ccs;
+	for (uint icon = 0; icon < ncons; ++icon)
+	{
+		uint ends[2];
+		double cc = 0.0;
+		opt_file.read((char*)ends, sizeof(uint) * 2);
+		opt_file.read((char*)&cc, sizeof(double));
+		if (!opt_file) return false;
+		ccs[std::make_pair(std::min(ends[0], ends[1]), std::max(ends[0], ends[1]))] = cc;
+	}
+
+	std::vector<double> found(ncons);
+	for (uint icon = 0; icon < ncons; ++icon)
+	{
+		VertexConnection * vc = pConnections[icon];
+		uint a = vc->getA()->getIDX();
+		uint b = vc->getB()->getIDX();
+		std::map<std::pair<uint, uint>, double>::const_iterator cc =
+			ccs.find(std::make_pair(std::min(a, b), std::max(a, b)));
+		if (cc == ccs.end()) return false;
+		found[icon] = cc->second;
+	}
+	for (uint icon = 0; icon < ncons; ++icon)
+	{
+		pConnections[icon]->setGeomCouplingConstant(found[icon]);
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::TetMesh::copyOptimal(TetMesh & src)
+{
+	std::stringstream opt;
+	src.saveOptimal(opt);
+	opt.seekg(0);
+	bool ok = loadCoupling(opt);
+	assert(ok == true);
+	opt.clear();
+	opt.seekg(0);
+	loadOrdering(opt);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -996,4 +1283,30 @@ void sefield::TetMesh::savematrix(void)
 */
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t sefield::TetMesh::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(TetMesh);
+
+    uint nelems = pElements.size();
+    bytes += pElements.capacity() * sizeof(VertexElement *);
+    for (uint i = 0; i < nelems; ++i)
+    {
+        bytes += pElements[i]->getMemoryUsage();
+    }
+    bytes += pConnections.capacity() * sizeof(VertexConnection *);
+    bytes += pConnections.size() * sizeof(VertexConnection);
+    if (pVertexPerm != 0) bytes += nelems * sizeof(uint);
+
+    bytes += (pNbrStart.capacity() + pNbrIdx.capacity()) * sizeof(uint);
+    bytes += pNbrCC.capacity() * sizeof(double);
+
+    bytes += (pNTri * 3 + pNTet * 4) * sizeof(uint);
+    // A set node carries the stub and, in the common red-black tree
+    // implementations, a colour and three links.
+    bytes += pTetLUT.size() * (sizeof(TetStub) + 4 * sizeof(void *));
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
@@ -172,10 +172,14 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by the mesh: its vertices,
+    /// connections, neighbour tables and element lists.
+    std::size_t getMemoryUsage(void) const;
 
     /// Called by the EField constructor after all the triangles and
     /// tetrahedrons have been specified. It extracts all unique
@@ -206,6 +210,14 @@ public:
     ///
     void reindexElements(void);
 
+    /// Rebuild the compressed (CSR) copy of the vertex graph from the
+    /// VertexElements, in the current vertex order: for vertex v, its
+    /// neighbours and coupling constants are at [getNbrStart(v),
+    /// getNbrStart(v + 1)) in getNbrIdx and getNbrCC. Called whenever
+    /// the indices or the coupling constants change.
+    ///
+    void buildNbrTable(void);
+
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS: VERTICES
     ////////////////////////////////////////////////////////////////////////
@@ -235,13 +247,33 @@ public:
     ///      indices in VertexElement's list of neighbours.
     /// </UL>
     ///
-    /// This information is used by class TetCoupler to compute coupling
-    /// constants.
+    /// Class TetCoupler used this to compute coupling constants; it now
+    /// walks the tetrahedron array directly.
     ///
     /// Originally from TetMesh.
     ///
     std::vector<std::vector<uint> >  getNeighboringTetrahedra(VertexElement *);
 
+    ////////////////////////////////////////////////////////////////////////
+    // DATA ACCESS: COMPRESSED VERTEX GRAPH
+    ////////////////////////////////////////////////////////////////////////
+
+    inline uint getNbrStart(uint v) const
+    { return pNbrStart[v]; }
+
+    inline uint getNbrIdx(uint i) const
+    { return pNbrIdx[i]; }
+
+    inline double getNbrCC(uint i) const
+    { return pNbrCC[i]; }
+
+    /// Changed by every buildNbrTable, so that derived data can tell
+    /// whether it is out of date. Stamps are unique across meshes too, so
+    /// data derived from one mesh is never taken for another's.
+    ///
+    inline uint getNbrTableStamp(void) const
+    { return pNbrTableStamp; }
+
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS: TRIANGLES
     ////////////////////////////////////////////////////////////////////////
@@ -296,11 +328,38 @@ public:
 
     /// Originally from Mesh.
     /// Iain: big changes here
+    /// The connected parts of the mesh, such as separate cells, are
+    /// ordered one after the other.
     ///
     void axisOrderElements(uint opt_method, std::string const & opt_file_name ="");
 
+    /// Write the vertex permutation to a file that axisOrderElements
+    /// can read back instead of searching again, followed by the
+    /// geometric coupling constant of each connection.
+    ///
     void saveOptimal(std::string const & opt_file_name);
 
+    /// Read the geometric coupling constants stored by saveOptimal, so
+    /// that TetCoupler::coupleMesh can be skipped. Returns false, and
+    /// leaves the connections alone, if the file holds none for a mesh
+    /// of this size (such as files written before they were stored).
+    ///
+    bool loadCoupling(std::string const & opt_file_name);
+
+    /// Stream versions of saveOptimal and loadCoupling, and the reading
+    /// of the vertex permutation that axisOrderElements does with a file.
+    ///
+    void saveOptimal(std::ostream & opt);
+    bool loadCoupling(std::istream & opt);
+    void loadOrdering(std::istream & opt);
+
+    /// Take the coupling constants and vertex ordering of src, a mesh
+    /// built from the same vertices, triangles and tetrahedrons that has
+    /// been coupled and ordered, in place of coupleMesh and
+    /// axisOrderElements.
+    ///
+    void copyOptimal(TetMesh & src);
+
     void fill_ve_vec(set<VertexElement*> & veset, vector<VertexElement*> & vevec, queue<VertexElement*> & vequeue, uint ncons, VertexElement ** nbrs);
 
     /// Originally from Mesh.
@@ -336,6 +395,14 @@ public:
 	///
 	void reordered(void);
 
+	/// Stably reorder the new vertex order in pElements and pVertexPerm
+	/// so that each connected part of the mesh takes a contiguous range
+	/// of indices, the parts in the order of their first vertex. Called
+	/// by axisOrderElements before the vertices are reindexed; the
+	/// matrix of a mesh in several parts is then block diagonal.
+	///
+	void groupComponents(void);
+
 	// Just temporary functions to have a look at the matrix
 	//void displayMatrix(uint);
     //void savematrix(void);
@@ -370,6 +437,12 @@ private:
 
     uint                              * pVertexPerm;
 
+    /// The vertex graph in compressed rows, see buildNbrTable.
+    std::vector<uint>                   pNbrStart;
+    std::vector<uint>                   pNbrIdx;
+    std::vector<double>                 pNbrCC;
+    uint                                pNbrTableStamp;
+
     ////////////////////////////////////////////////////////////////////////
     // COPIED FROM TETMESH
     ////////////////////////////////////////////////////////////////////////
@@ -58,14 +58,14 @@ sefield::VertexConnection::~VertexConnection(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::VertexConnection::checkpoint(std::fstream & cp_file)
+void sefield::VertexConnection::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pGeomCC, sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::VertexConnection::restore(std::fstream & cp_file)
+void sefield::VertexConnection::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pGeomCC, sizeof(double));
 }
@@ -65,7 +65,7 @@ sefield::VertexElement::~VertexElement(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::VertexElement::checkpoint(std::fstream & cp_file)
+void sefield::VertexElement::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pSurface, sizeof(double));
     cp_file.write((char*)&pVolume, sizeof(double));
@@ -76,7 +76,7 @@ void sefield::VertexElement::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void sefield::VertexElement::restore(std::fstream & cp_file)
+void sefield::VertexElement::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pSurface, sizeof(double));
     cp_file.read((char*)&pVolume, sizeof(double));
@@ -137,4 +137,14 @@ ostream & operator<< (ostream & os, sefield::VertexElement const & ve)
 */
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t sefield::VertexElement::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(VertexElement);
+    bytes += pConnections.capacity() * sizeof(VertexConnection *);
+    bytes += pNCon * (sizeof(VertexElement *) + sizeof(double));
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
@@ -0,0 +1,395 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <sys/time.h>
+
+// STEPS headers.
+#include "../../common.h"
+#include "tetmesh.hpp"
+#include "vertexconnection.hpp"
+#include "vertexelement.hpp"
+#include "vprop.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+USING_NAMESPACE(std);
+NAMESPACE_ALIAS(steps::solver::efield, sefield);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Wall clock time in seconds, for the instrumentation of advance().
+static double wallTime(void)
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sefield::VProp::VProp(TetMesh * msh)
+: pMesh(msh)
+, pNVerts(pMesh->countVertices())
+, pV(0)
+, pGExt(0)
+, pVExt(0.0)
+, pVertexInj(0)
+, pVertexClamp(0)
+, pTriCur(0)
+, pTriCurClamp(0)
+, pVertCur(0)
+, pVertCurClamp(0)
+, pInjTot(0.0)
+, pDV(0)
+, pRHS(0)
+, pMatrixValid(false)
+, pMatrixdt(0.0)
+, pTheta(1.0)
+, pThreads(1)
+, pTimeRHS(0.0)
+, pTimeMatrix(0.0)
+, pTimeSolve(0.0)
+, pNSteps(0)
+, pNMatrix(0)
+, pNRefine(0)
+{
+	// The mesh comes ordered and indexed from EField, and may be shared
+	// with other replicates, so it is left alone here.
+
+	pV = new double[pNVerts];
+	fill_n(pV, pNVerts, 0.0);
+
+	pGExt = new double[pNVerts];
+	fill_n(pGExt, pNVerts, 0.0);
+
+	pVertexInj = new double[pNVerts];
+	fill_n(pVertexInj, pNVerts, 0.0);
+
+    pVertexClamp = new bool[pNVerts];
+    fill_n(pVertexClamp, pNVerts, false);
+
+    int ntri = pMesh->getNTri();
+	pTriCur = new double[ntri];
+	fill_n(pTriCur, ntri, 0.0);
+	pTriCurClamp = new double[ntri];
+	fill_n(pTriCurClamp, ntri, 0.0);
+
+	pVertCur = new double[pNVerts];
+	fill_n(pVertCur, pNVerts, 0.0);
+
+	pVertCurClamp = new double[pNVerts];
+	fill_n(pVertCurClamp, pNVerts, 0.0);
+
+	pRHS = new double[pNVerts];
+	fill_n(pRHS, pNVerts, 0.0);
+
+	pDV = new double[pNVerts];
+	fill_n(pDV, pNVerts, 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sefield::VProp::~VProp(void)
+{
+    delete[] pV;
+    delete[] pGExt;
+    delete[] pVertexInj;
+    delete[] pVertexClamp;
+    delete[] pTriCur;
+    delete[] pTriCurClamp;
+    delete[] pVertCur;
+    delete[] pVertCurClamp;
+    delete[] pDV;
+    delete[] pRHS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::VProp::checkpoint(std::iostream & cp_file)
+{
+    cp_file.write((char*)pV, sizeof(double) * pNVerts);
+    cp_file.write((char*)pGExt, sizeof(double) * pNVerts);
+    cp_file.write((char*)&pVExt, sizeof(double));
+    cp_file.write((char*)pVertexInj, sizeof(double) * pNVerts);
+    cp_file.write((char*)pVertexClamp, sizeof(bool) * pNVerts);
+    int ntri = pMesh->getNTri();
+    cp_file.write((char*)&ntri, sizeof(int));
+    cp_file.write((char*)pTriCur, sizeof(double) * ntri);
+    cp_file.write((char*)pTriCurClamp, sizeof(double) * ntri);
+    cp_file.write((char*)pVertCur, sizeof(double) * pNVerts);
+    cp_file.write((char*)pVertCurClamp, sizeof(double) * pNVerts);
+    cp_file.write((char*)&pInjTot, sizeof(double));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::VProp::restore(std::iostream & cp_file)
+{
+    cp_file.read((char*)pV, sizeof(double) * pNVerts);
+    cp_file.read((char*)pGExt, sizeof(double) * pNVerts);
+    cp_file.read((char*)&pVExt, sizeof(double));
+    cp_file.read((char*)pVertexInj, sizeof(double) * pNVerts);
+    cp_file.read((char*)pVertexClamp, sizeof(bool) * pNVerts);
+    int ntri = 0;
+    cp_file.read((char*)&ntri, sizeof(int));
+    cp_file.read((char*)pTriCur, sizeof(double) * ntri);
+    cp_file.read((char*)pTriCurClamp, sizeof(double) * ntri);
+    cp_file.read((char*)pVertCur, sizeof(double) * pNVerts);
+    cp_file.read((char*)pVertCurClamp, sizeof(double) * pNVerts);
+    cp_file.read((char*)&pInjTot, sizeof(double));
+
+    // The timestep of any stored matrix is unknown, so rebuild it
+    // on the next step.
+    pMatrixValid = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::VProp::advance(double dt)
+{
+    // The matrix only changes with dt or the membrane parameters, so it
+    // (and its factorization, if any) is reused between steps.
+    // With C dV/dt = I - K V, the theta method solves
+    // (C + theta dt K) dV = dt (I - K V): only the matrix sees theta.
+    double t0 = wallTime();
+    if (pMatrixValid == false || dt != pMatrixdt)
+    {
+        buildMatrix(pTheta * dt);
+        pMatrixValid = true;
+        pMatrixdt = dt;
+        ++pNMatrix;
+    }
+    double t1 = wallTime();
+    populateRHS(dt);
+    double t2 = wallTime();
+    solve();
+    double t3 = wallTime();
+    pTimeMatrix += t1 - t0;
+    pTimeRHS += t2 - t1;
+    pTimeSolve += t3 - t2;
+    ++pNSteps;
+
+    for (uint i = 0; i < pNVerts; ++i)
+    {
+        // bugfix(wils) 06-Aug-2008: the voltage-clamp variable was being
+        // stored for each vertex (in variable pVertexClamp), but not used
+        // during the update step.
+        if (pVertexClamp[i] == false)
+        {
+            pV[i] += pDV[i];
+        }
+    }
+
+    // Has strange behaviours, uses unexplainable variables such as this
+    // pInjTot. Look at this later...
+    //chargeCheck(dt);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::VProp::resetTimes(void)
+{
+    pTimeRHS = 0.0;
+    pTimeMatrix = 0.0;
+    pTimeSolve = 0.0;
+    pNSteps = 0;
+    pNMatrix = 0;
+    pNRefine = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double sefield::VProp::getMaxDV(void) const
+{
+    double maxdv = 0.0;
+    for (uint i = 0; i < pNVerts; ++i)
+    {
+        if (pVertexClamp[i] == true) continue;
+        double dv = std::fabs(pDV[i]);
+        if (dv > maxdv) maxdv = dv;
+    }
+    return maxdv;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::VProp::setSurfaceConductance(double gsa, double vr)
+{
+	pVExt = vr;
+	// pTotGSurf = 0.;
+	double totsurf = 0.;
+	for (uint i = 0; i < pNVerts; ++i)
+	{
+		VertexElement* ve = pMesh->getVertex(i);
+		double ge = gsa * ve->getSurfaceArea();
+		pGExt[ve->getIDX()] = ge;
+		// pTotGSurf += ge;
+
+		totsurf += ve->getSurfaceArea();
+	}
+	pMatrixValid = false;
+
+	/*
+	stringstream ss;
+	ss << "total surface area " << totsurf;
+	cout << ss.str() << endl;
+	*/
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+string sefield::VProp::makeOutputLine(double time, double* v)
+{
+	stringstream s;
+	s << time << " " << pV[0] << " " << pV[pNVerts-1];
+	return s.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::VProp::setPotential(double v)
+{
+    for (uint i = 0; i < pNVerts; ++i)
+    {
+        pV[i] = v;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::VProp::populateRHS(double dt)
+{
+	collectCurrents();
+
+	// NOTE: Vertex currents at this point are given in pA
+
+	for (uint i = 0; i < pNVerts; ++i)
+	{
+		pRHS[i] = pVertCur[i] * dt;
+	}
+	// NOTE: time is in units of ms
+
+	for (uint ind = 0; ind < pNVerts; ++ind)
+	{
+		pRHS[ind] += dt * pGExt[ind] * (pVExt - pV[ind]);
+
+		// Now, loop through all the neighbours adding on contributions
+		// to pRHS.
+		uint row_end = pMesh->getNbrStart(ind + 1);
+		for (uint inbr = pMesh->getNbrStart(ind); inbr < row_end; ++inbr)
+		{
+			uint k = pMesh->getNbrIdx(inbr);
+			double cc = pMesh->getNbrCC(inbr);
+			// right hand side
+			pRHS[ind] += dt * cc * (pV[k] - pV[ind]);
+		}
+	}
+
+	fill_n(pVertCur, pNVerts, 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::VProp::collectCurrents(void)
+{
+	// Currents into vertices are the per-vertex injections plus
+	// the per-triangle currents divided over their neighbors.
+
+	// NOTE: at the moment pVertexInj is not used at all, and
+	// this is a little inefficient at the moment- i.e. looping
+	// over all vertices when typically only a few will have
+	// a current clamp, if any
+	for (uint i = 0; i < pNVerts; ++i)
+	{
+		pVertCur[i] = pVertexInj[i];
+		pVertCur[i] += pVertCurClamp[i];
+
+	}
+	uint ntris = pMesh->getNTri();
+	for (uint i = 0; i < ntris; ++i)
+	{
+		uint * triv = pMesh->getTriangle(i);
+		double c = pTriCur[i] / 3.0;
+		double cc = pTriCurClamp[i] / 3.0;
+
+		pVertCur[triv[0]] += (c+cc);
+		pVertCur[triv[1]] += (c+cc);
+		pVertCur[triv[2]] += (c+cc);
+	}
+
+	// Iain 31/8/2011 Now reset the currents
+	fill_n(pVertexInj, pNVerts, 0.0);
+	fill_n(pTriCur, ntris, 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sefield::VProp::chargeCheck(double dt)
+{
+    //if (pTotGSurf == 0.0)
+    //{
+        // Can do a charge conservation check -
+        // TODO: smarter check that adds currents
+        double cvt = 0.;
+        for (uint i = 0; i < pNVerts; ++i)
+        {
+            VertexElement * ve = pMesh->getVertex(i);
+            pInjTot += pVertexInj[i] * dt;
+            // NOTE: IH 5/10 removed pV0 in below:
+            // cvt += (pV[i] - pV0) * ve->getCapacitance();
+            cvt += (pV[i]) * ve->getCapacitance();
+        }
+        double dabs = abs((cvt - pInjTot) / (cvt + pInjTot));
+        if (dabs > 1.e-7)
+        {
+            stringstream s;
+
+            s << "NEAR FATAL sum error too large ";
+            s << dabs << " " << cvt << " " << pInjTot;
+            cout << s.str() << endl;
+        }
+    //}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t sefield::VProp::_tableMemoryUsage(void) const
+{
+    // Potentials, conductances, injections, currents, current clamps,
+    // right hand side and changes per vertex, and the currents and
+    // current clamps per triangle.
+    std::size_t bytes = pNVerts * (7 * sizeof(double) + sizeof(bool));
+    bytes += pMesh->getNTri() * 2 * sizeof(double);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
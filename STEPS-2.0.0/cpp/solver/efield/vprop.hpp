@@ -0,0 +1,429 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_EFIELD_VPROP_HPP
+#define STEPS_SOLVER_EFIELD_VPROP_HPP 1
+
+// STL headers.
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// STEPS headers.
+#include "../../common.h"
+#include "tetmesh.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(efield)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Base class for the membrane potential propagators. Holds the potentials,
+/// the current injections and clamps and builds the right hand side of the
+/// implicit system that is solved at each step; derived classes provide
+/// the storage and the solution method for the system matrix.
+///
+class VProp
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Constructor.
+    ///
+	VProp(TetMesh * msh);
+
+	/// Destructor.
+	///
+	virtual ~VProp(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // CHECKPOINTING
+    ////////////////////////////////////////////////////////////////////////
+    /// checkpoint data
+    virtual void checkpoint(std::iostream & cp_file);
+
+    /// restore data
+    virtual void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by the propagator, its potential
+    /// and current tables and its solution workspace.
+    ///
+    virtual std::size_t getMemoryUsage(void) const = 0;
+
+    void setSurfaceConductance(double, double);
+
+    std::string makeOutputLine(double, double*);
+
+    // New method to replace setInitialPotential and reset()
+    void setPotential(double v);
+
+    /// Discard the cached system matrix, so that it is rebuilt on the
+    /// next call to advance(). Must be called whenever the membrane
+    /// capacitance or the vertex coupling constants change in the mesh.
+    ///
+    void invalidateMatrix(void)
+    { pMatrixValid = false; }
+
+    /// Switch to msh, a mesh with the same vertices in the same order
+    /// but other membrane parameters, such as one shared with other
+    /// replicates (see EField). The matrix is rebuilt on the next step.
+    ///
+    virtual void setMesh(TetMesh * msh)
+    { pMesh = msh; pMatrixValid = false; }
+
+    /// Set the implicitness of the time stepping: 1.0 (the default) is
+    /// backward Euler, 0.5 is Crank-Nicolson, which is second order in
+    /// dt. The matrix keeps its banded structure for either.
+    ///
+    void setTheta(double theta)
+    { pTheta = theta; pMatrixValid = false; }
+
+    double getTheta(void) const
+    { return pTheta; }
+
+    /// Set the number of threads that work on independent parts of the
+    /// system, such as the blocks of BandedMatrixProp (default 1).
+    ///
+    void setThreads(uint n)
+    { pThreads = n; }
+
+    uint getThreads(void) const
+    { return pThreads; }
+
+    /// Decompose the matrix in single precision and refine the solutions
+    /// in double precision, where the propagator supports it (only
+    /// BandedMatrixProp; the others ignore this).
+    ///
+    virtual void setMixedPrecision(bool mixed)
+    { }
+
+    virtual bool getMixedPrecision(void) const
+    { return false; }
+
+	////////////////////////////////////////////////////////////////////////
+	// METHODS
+	////////////////////////////////////////////////////////////////////////
+
+    /// This is the crucial method -- advance the system with a certain
+	/// timestep dt. Backends that keep the system elsewhere override it
+	/// (see backend.hpp).
+	///
+    virtual void advance(double dt);	// converted to ms in Efield object
+
+    /// Bring the potentials of any vertices that the propagator does not
+    /// step directly up to date. Called before these are read.
+    ///
+    virtual void updateInterior(void)
+    { }
+
+    /// Return the largest absolute potential change (in mV) that the
+    /// last call to advance() applied to an unclamped vertex.
+    ///
+    double getMaxDV(void) const;
+
+    /// Return the half bandwidth of the banded matrix that is factorized
+    /// (0 if the propagator does not use one).
+    ///
+    virtual int getHalfBW(void) const
+    { return 0; }
+
+    /// Return the number of independent blocks the system is solved in.
+    ///
+    virtual uint getNBlocks(void) const
+    { return 1; }
+
+    ////////////////////////////////////////////////////////////////////////
+    // METHODS: INSTRUMENTATION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Wall clock time in seconds spent by advance() in the right hand
+    /// side, the matrix construction (including its factorization) and
+    /// the solve since the last resetTimes().
+    ///
+    double getTimeRHS(void) const
+    { return pTimeRHS; }
+
+    double getTimeMatrix(void) const
+    { return pTimeMatrix; }
+
+    double getTimeSolve(void) const
+    { return pTimeSolve; }
+
+    /// Number of calls to advance() and of matrix constructions since
+    /// the last resetTimes().
+    ///
+    uint getNSteps(void) const
+    { return pNSteps; }
+
+    uint getNMatrix(void) const
+    { return pNMatrix; }
+
+    /// Number of iterative refinement steps (with mixed precision) since
+    /// the last resetTimes().
+    ///
+    uint getNRefine(void) const
+    { return pNRefine; }
+
+    void resetTimes(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // METHODS: OBJECT ACCESS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Return the potential at vertex i in mV
+    ///
+    double getV(int i) const
+    { return pV[i]; }
+
+    /// Set the potential at vertex i in mV.
+    ///
+	void setV(int i, double d)
+	{ pV[i] = d;}
+
+	////////////////////////////////////////////////////////////////////////
+
+	/// Return whether vertex i is clamped.
+	///
+	bool getClamped(int i) const
+	{ return pVertexClamp[i]; }
+
+	/// (De-)activate the voltage clamp on some vertex i.
+	///
+	void setClamped(int i, bool b)
+    {
+        if (pVertexClamp[i] == b) return;
+        pVertexClamp[i] = b;
+        clampsChanged();
+    }
+
+	////////////////////////////////////////////////////////////////////////
+
+	/// Return the amount of current being injected in a vertex in picoamp
+	///
+	bool getInj(int i) const
+    { return -pVertexInj[i]; }
+
+	/// Set the amount of current being injected in a vertex in picoamp
+	/// NOTE: Have to change the sign here to match the terms in the
+	/// matrix solution
+	void setInj(int i, double d)
+	{ pVertexInj[i] = -d; }
+
+	/// Set the amount of current that is constantly injected through a
+	/// vertex element until explicitly cancelled or changed.
+	/// NOTE: Have to change the sign here to match the terms in the
+	/// matrix solution
+    void setVertIClamp(int i, double c)
+	{
+		pVertCurClamp[i] = -c;
+	}
+
+	////////////////////////////////////////////////////////////////////////
+
+	/// Returns the current that will be injected in a triangle in picoamp
+	///
+    double getTriI(int i) const
+    { return -pTriCur[i]; }
+
+    /// Set an amount of current (expressed in ...) which is 'injected'
+    /// through a triangular surface element over one EField dt. This current is divided
+    /// over the 3 vertices that comprise the triangle and added to the
+    /// current injected in vertex, on top of the current set with
+    /// VProp::setInj. Usually these triangle currents
+    /// result from open channels and receptors computed in the
+    /// biochemical part of STEPS.
+	/// NOTE: Have to change the sign here to match the terms in the
+	/// matrix solution
+    void setTriI(int i, double d)
+	{
+		pTriCur[i] = -d;
+	}
+
+	/// Set the amount of current that is constantly injected through a
+	/// triangular element until explicitly cancelled or changed.
+	/// NOTE: Have to change the sign here to match the terms in the
+	/// matrix solution
+    void setTriIClamp(int i, double c)
+	{
+		pTriCurClamp[i] = -c;
+	}
+
+	////////////////////////////////////////////////////////////////////////
+
+protected:
+
+    ////////////////////////////////////////////////////////////////////////
+    // INTERNAL METHODS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Construct the right hand side for a step of length dt.
+    ///
+    virtual void populateRHS(double);
+
+    /// Called when a vertex is clamped or released, for propagators
+    /// whose matrix leaves out the clamped vertices.
+    ///
+    virtual void clampsChanged(void)
+    { }
+
+    /// Sum the injected and triangle currents of each vertex into
+    /// pVertCur (pA) and clear the injections for the next step.
+    ///
+    void collectCurrents(void);
+
+    /// Construct (and, where applicable, factorize) the system matrix for
+    /// a step of length dt. This only depends on dt and the membrane
+    /// parameters, not on the potentials, and is only called by advance()
+    /// when one of these has changed.
+    ///
+    virtual void buildMatrix(double dt) = 0;
+
+    /// Solve the system matrix for the right hand side in pRHS, storing
+    /// the potential changes in pDV.
+    ///
+    virtual void solve(void) = 0;
+
+    /// The number of bytes held by the tables of the base class.
+    ///
+    std::size_t _tableMemoryUsage(void) const;
+
+    /// What the hell does this do???? And when?? (See also: pTotGSurf,
+    /// pInjTot in this class.)
+    ///
+    void chargeCheck(double);
+
+    ////////////////////////////////////////////////////////////////////////
+    // DATA FIELDS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Pointer to the mesh.
+    ///
+    TetMesh *                   pMesh;
+
+    /// Number of vertices in the mesh, stored locally.
+    ///
+    uint                        pNVerts;
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// The local potential over all mesh vertex points.
+    ///
+    double *                    pV;
+
+    double *                    pGExt;
+
+    /// Extracellular potential (?)
+    ///
+    double                      pVExt;
+
+    /// Vertex-based current injections.
+    ///
+    double *                    pVertexInj;
+
+    /// An array storing, for each mesh vertex, whether the potential at
+    /// that vertex point should be clamped (true) or not (false).
+    ///
+    bool *                      pVertexClamp;
+
+    /// Currents over triangles.
+    ///
+    double *                    pTriCur;
+
+    /// Current clamps over triangles
+    ///
+    double * 					pTriCurClamp;
+
+    ///
+    double *                    pVertCur;
+
+    /// Current clamp over vertices. This will complement any triangle clamp
+
+    double *					pVertCurClamp;
+
+    ////////////////////////////////////////////////////////////////////////
+    // CONSISTENCY CHECKING
+    ////////////////////////////////////////////////////////////////////////
+
+    ///
+    double                      pInjTot;
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLUTION WORKSPACE
+    ////////////////////////////////////////////////////////////////////////
+
+    double *                    pDV;
+    double *                    pRHS;
+
+    /// Whether the system matrix is valid for the current membrane
+    /// parameters and pMatrixdt.
+    ///
+    bool                        pMatrixValid;
+
+    /// The timestep for which the system matrix was built.
+    ///
+    double                      pMatrixdt;
+
+    /// The weight of the end of the step in the potential coupling terms
+    /// (1.0 backward Euler, 0.5 Crank-Nicolson).
+    ///
+    double                      pTheta;
+
+    /// The number of threads for independent parts of the system.
+    ///
+    uint                        pThreads;
+
+    ////////////////////////////////////////////////////////////////////////
+    // INSTRUMENTATION
+    ////////////////////////////////////////////////////////////////////////
+
+    double                      pTimeRHS;
+    double                      pTimeMatrix;
+    double                      pTimeSolve;
+    uint                        pNSteps;
+    uint                        pNMatrix;
+    uint                        pNRefine;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(efield)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
+// STEPS_SOLVER_EFIELD_VPROP_HPP
+
+// END
@@ -29,6 +29,7 @@
 
 // STL headers.
 #include <string>
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <sstream>
@@ -36,6 +37,7 @@
 
 // STEPS headers.
 #include "../common.h"
+#include "../math/constants.hpp"
 #include "../math/ghk.hpp"
 #include "types.hpp"
 #include "../error.hpp"
@@ -65,6 +67,9 @@ ssolver::GHKcurrdef::GHKcurrdef(Statedef * sd, uint gidx, smod::GHKcurr * ghk)
 , pSpec_CHANSTATE(GIDX_UNDEFINED)
 , pSpec_ION(GIDX_UNDEFINED)
 , pSpec_VOL_DEP(0)
+, pTabDX(0.0)
+, pTabHalf(0)
+, pTabG()
 {
 	assert(pStatedef != 0);
 	assert(ghk != 0);
@@ -142,7 +147,7 @@ ssolver::GHKcurrdef::~GHKcurrdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::GHKcurrdef::checkpoint(std::fstream & cp_file)
+void ssolver::GHKcurrdef::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pRealFlux, sizeof(bool));
     cp_file.write((char*)&pVirtual_oconc, sizeof(double));
@@ -153,7 +158,7 @@ void ssolver::GHKcurrdef::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::GHKcurrdef::restore(std::fstream & cp_file)
+void ssolver::GHKcurrdef::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pRealFlux, sizeof(bool));
     cp_file.read((char*)&pVirtual_oconc, sizeof(double));
@@ -164,6 +169,61 @@ void ssolver::GHKcurrdef::restore(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void ssolver::GHKcurrdef::setupFluxTable(double T)
+{
+	assert(T > 0.0);
+	// Without a valence the flux is 0 and there is nothing to tabulate.
+	if (pValence == 0) return;
+	double xscale = fabs(pValence * steps::math::FARADAY / (steps::math::GAS_CONSTANT * T));
+	if (pTabG.empty() == true) pTabDX = GHKCURRDEF_TAB_DV * xscale;
+	double xmax = std::max(fabs(GHKCURRDEF_TAB_VMIN), fabs(GHKCURRDEF_TAB_VMAX)) * xscale;
+	uint half = static_cast<uint>(ceil(xmax / pTabDX));
+	if (pTabG.empty() == false && half <= pTabHalf) return;
+
+	// Entries already there are moved, only the new ends are computed.
+	std::vector<double> g(2 * half + 1);
+	uint off = half - pTabHalf;
+	uint nold = pTabG.size();
+	std::copy(pTabG.begin(), pTabG.end(), g.begin() + off);
+	uint size = g.size();
+	for (uint i = 0; i < size; ++i)
+	{
+		if (i >= off && i < off + nold) continue;
+		// g tends to 1 at x = 0, where the GHK equation itself is 0 / 0.
+		double x = (static_cast<double>(i) - half) * pTabDX;
+		if (fabs(x) < 1.0e-8) g[i] = 1.0 + 0.5 * x;
+		else g[i] = x / (1.0 - exp(-x));
+	}
+	pTabG.swap(g);
+	pTabHalf = half;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double ssolver::GHKcurrdef::getFlux(double v, double T, double iconc, double oconc) const
+{
+	double u = v + pVshift;
+	double last = static_cast<double>(2 * pTabHalf);
+	double fa = pTabHalf + (u * pValence * steps::math::FARADAY)
+	          / (steps::math::GAS_CONSTANT * T * pTabDX);
+	double fb = last - fa;
+	if (pTabG.empty() == true || !(fa >= 0.0) || fa >= last || !(fb >= 0.0) || fb >= last)
+	{
+		return steps::math::GHKcurrent(pPerm, u, pValence, T, iconc, oconc);
+	}
+
+	uint ia = static_cast<uint>(fa);
+	uint ib = static_cast<uint>(fb);
+	double ra = fa - ia;
+	double rb = fb - ib;
+	double a = ((1.0 - ra) * pTabG[ia]) + (ra * pTabG[ia + 1]);
+	double b = ((1.0 - rb) * pTabG[ib]) + (rb * pTabG[ib + 1]);
+	double pzf = pPerm * pValence * steps::math::FARADAY;
+	return pzf * ((a * iconc) - (b * oconc));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void ssolver::GHKcurrdef::setup(void)
 {
 	assert(pSetupdone == false);
@@ -246,4 +306,14 @@ bool ssolver::GHKcurrdef::req_v(uint gidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::GHKcurrdef::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(GHKcurrdef);
+    bytes += pStatedef->countSpecs() * 2 * sizeof(int);
+    bytes += pTabG.capacity() * sizeof(double);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
@@ -43,6 +43,15 @@
 START_NAMESPACE(steps)
 START_NAMESPACE(solver)
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Range and step (volts) of the potentials, including the voltage shift,
+// at which GHKcurrdef tabulates the GHK flux, at the temperature of the
+// first table.
+#define GHKCURRDEF_TAB_VMIN         -0.5
+#define GHKCURRDEF_TAB_VMAX         0.5
+#define GHKCURRDEF_TAB_DV           1.0e-4
+
 // Forward declarations.
 class GHKcurrdef;
 
@@ -72,10 +81,14 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by this object, its tables
+    /// and its flux table.
+    std::size_t getMemoryUsage(void) const;
 
     ////////////////////////////////////////////////////////////////////////
     // SOLVER METHODS: SETUP
@@ -84,6 +97,25 @@ public:
     /// Setup the object.
 	void setup(void);
 
+    /// Tabulate the GHK flux for temperature T. The flux is linear in the
+    /// concentrations, flux = P z F (g(x) * iconc - g(-x) * oconc) with
+    /// x = z F V / (R T) and g(x) = x / (1 - exp(-x)), so only g is
+    /// tabulated, over x, and the table holds whatever the
+    /// concentrations, permeability and temperature. A new temperature
+    /// only extends the table where its potential range reaches x not
+    /// yet covered, at the spacing of the first. The solver calls this
+    /// at setup, when the temperature changes and after a restore.
+    ///
+    void setupFluxTable(double T);
+
+    /// Return the single-channel current for membrane potential v (the
+    /// voltage shift is added here), temperature T and the inner and
+    /// outer concentrations (mol per cubic meter), as
+    /// steps::math::GHKcurrent, interpolated from the table. Potentials
+    /// off the table are computed exactly.
+    ///
+    double getFlux(double v, double T, double iconc, double oconc) const;
+
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS: GHK CURRENT
     ////////////////////////////////////////////////////////////////////////
@@ -190,6 +222,12 @@ private:
     // Global index of the ion.
     uint 								pSpec_ION;
 
+    // g(x) at x = (i - pTabHalf) * pTabDX, for i up to 2 * pTabHalf, or
+    // empty.
+    double                              pTabDX;
+    uint                                pTabHalf;
+    std::vector<double>                 pTabG;
+
     ////////////////////////////////////////////////////////////////////////
 
 };
@@ -0,0 +1,465 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// The whole writer needs the HDF5 library; without it Recorder reports
+// that HDF5 output is not available.
+#ifdef STEPS_USE_HDF5
+
+// STL headers.
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+// HDF5 headers.
+#include <hdf5.h>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "hdf5writer.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::solver, ssolver);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Largest number of values in one chunk of /data (1 MB).
+#define HDF5WRITER_CHUNK_VALUES     131072
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct ssolver::HDF5Writer::Handles
+{
+    hid_t                               file;
+    hid_t                               time;
+    hid_t                               data;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void hdf5Fail(std::string const & what)
+{
+    std::ostringstream os;
+    os << "HDF5 error: cannot " << what << ".";
+    throw steps::ProgErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Create the groups on the way to the object at path, and return the
+// group (or file) it goes in and its name there.
+static hid_t parentGroup(hid_t file, std::string const & path, std::string & name)
+{
+    std::string::size_type slash = path.rfind('/');
+    name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+    if (slash == std::string::npos || slash == 0) return H5Gopen2(file, "/", H5P_DEFAULT);
+
+    std::string::size_type pos = (path[0] == '/') ? 1 : 0;
+    hid_t grp = H5Gopen2(file, "/", H5P_DEFAULT);
+    while (pos <= slash)
+    {
+        std::string::size_type next = path.find('/', pos);
+        std::string gname = path.substr(pos, next - pos);
+        hid_t sub = (H5Lexists(grp, gname.c_str(), H5P_DEFAULT) > 0)
+                  ? H5Gopen2(grp, gname.c_str(), H5P_DEFAULT)
+                  : H5Gcreate2(grp, gname.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Gclose(grp);
+        if (sub < 0) hdf5Fail("create group '" + gname + "'");
+        grp = sub;
+        pos = next + 1;
+    }
+    return grp;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ssolver::HDF5Writer::HDF5Writer(std::string const & file_name,
+                                std::vector<std::string> const & labels,
+                                uint block_rows, uint level)
+: pH(new Handles)
+, pNCols(labels.size())
+, pBlockRows(std::max(block_rows, 1u))
+, pNRows(0)
+, pCurrent()
+, pPending()
+, pStarted(false)
+, pClosing(false)
+, pError()
+{
+    // The failure is reported as an ArgErr, so HDF5's own error stack
+    // is not printed.
+    H5E_auto2_t efunc;
+    void * edata;
+    H5Eget_auto2(H5E_DEFAULT, &efunc, &edata);
+    H5Eset_auto2(H5E_DEFAULT, 0, 0);
+    pH->file = H5Fcreate(file_name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    H5Eset_auto2(H5E_DEFAULT, efunc, edata);
+    if (pH->file < 0)
+    {
+        delete pH;
+        std::ostringstream os;
+        os << "Cannot create HDF5 file '" << file_name << "'.";
+        throw steps::ArgErr(os.str());
+    }
+
+    // /time and /data grow by one row per sample.
+    hsize_t tdim = 0;
+    hsize_t tmax = H5S_UNLIMITED;
+    hsize_t tchunk = pBlockRows;
+    hid_t space = H5Screate_simple(1, &tdim, &tmax);
+    hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(plist, 1, &tchunk);
+    pH->time = H5Dcreate2(pH->file, "time", H5T_NATIVE_DOUBLE, space,
+                          H5P_DEFAULT, plist, H5P_DEFAULT);
+    H5Pclose(plist);
+    H5Sclose(space);
+
+    hsize_t ddim[2] = {0, pNCols};
+    hsize_t dmax[2] = {H5S_UNLIMITED, pNCols};
+    hsize_t ccols = std::max(1u, std::min(pNCols, static_cast<uint>(HDF5WRITER_CHUNK_VALUES)));
+    hsize_t crows = std::max(static_cast<hsize_t>(1),
+                             std::min(static_cast<hsize_t>(pBlockRows), HDF5WRITER_CHUNK_VALUES / ccols));
+    hsize_t dchunk[2] = {crows, ccols};
+    space = H5Screate_simple(2, ddim, dmax);
+    plist = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(plist, 2, dchunk);
+    if (level > 0)
+    {
+        H5Pset_shuffle(plist);
+        H5Pset_deflate(plist, std::min(level, 9u));
+    }
+    pH->data = H5Dcreate2(pH->file, "data", H5T_NATIVE_DOUBLE, space,
+                          H5P_DEFAULT, plist, H5P_DEFAULT);
+    H5Pclose(plist);
+    H5Sclose(space);
+
+    if (pH->time < 0 || pH->data < 0)
+    {
+        H5Fclose(pH->file);
+        delete pH;
+        hdf5Fail("create the sample datasets");
+    }
+
+    writeStrings("columns", labels);
+
+    pCurrent.times.reserve(pBlockRows);
+    pCurrent.data.reserve(pBlockRows * pNCols);
+
+    pthread_mutex_init(&pMutex, 0);
+    pthread_cond_init(&pCond, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ssolver::HDF5Writer::~HDF5Writer(void)
+{
+    if (pH != 0)
+    {
+        // Errors cannot leave a destructor; close() reports them.
+        try
+        {
+            close();
+        }
+        catch (steps::Err &)
+        {
+        }
+    }
+    pthread_cond_destroy(&pCond);
+    pthread_mutex_destroy(&pMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::HDF5Writer::writeStrings(std::string const & path,
+                                       std::vector<std::string> const & strs)
+{
+    assert(pStarted == false);
+    std::string name;
+    hid_t grp = parentGroup(pH->file, path, name);
+
+    std::vector<char const *> ptrs(strs.size());
+    for (uint i = 0; i < strs.size(); ++i) ptrs[i] = strs[i].c_str();
+
+    hsize_t dim = strs.size();
+    hid_t type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, H5T_VARIABLE);
+    hid_t space = H5Screate_simple(1, &dim, 0);
+    hid_t dset = H5Dcreate2(grp, name.c_str(), type, space,
+                            H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    herr_t err = -1;
+    if (dset >= 0)
+    {
+        err = (dim == 0) ? 0 : H5Dwrite(dset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, &ptrs[0]);
+        H5Dclose(dset);
+    }
+    H5Sclose(space);
+    H5Tclose(type);
+    H5Gclose(grp);
+    if (err < 0) hdf5Fail("write '" + path + "'");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A rows x cols dataset of HDF5 type type at path.
+static void writeHDF5Matrix(hid_t file, std::string const & path,
+                            hid_t type, void const * vals, uint rows, uint cols)
+{
+    std::string name;
+    hid_t grp = parentGroup(file, path, name);
+    hsize_t dims[2] = {rows, cols};
+    hid_t space = H5Screate_simple(2, dims, 0);
+    hid_t dset = H5Dcreate2(grp, name.c_str(), type, space,
+                            H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    herr_t err = -1;
+    if (dset >= 0)
+    {
+        err = (rows * cols == 0) ? 0 : H5Dwrite(dset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, vals);
+        H5Dclose(dset);
+    }
+    H5Sclose(space);
+    H5Gclose(grp);
+    if (err < 0) hdf5Fail("write '" + path + "'");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::HDF5Writer::writeMatrix(std::string const & path,
+                                      double const * vals, uint rows, uint cols)
+{
+    assert(pStarted == false);
+    writeHDF5Matrix(pH->file, path, H5T_NATIVE_DOUBLE, vals, rows, cols);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::HDF5Writer::writeMatrix(std::string const & path,
+                                      uint const * vals, uint rows, uint cols)
+{
+    assert(pStarted == false);
+    writeHDF5Matrix(pH->file, path, H5T_NATIVE_UINT, vals, rows, cols);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::HDF5Writer::writeAttribute(std::string const & name,
+                                         std::string const & val)
+{
+    assert(pStarted == false);
+    hid_t type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, std::max(static_cast<size_t>(1), val.size()));
+    hid_t space = H5Screate(H5S_SCALAR);
+    hid_t attr = H5Acreate2(pH->file, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT);
+    herr_t err = -1;
+    if (attr >= 0)
+    {
+        std::string buf = val.empty() ? std::string(1, '\0') : val;
+        err = H5Awrite(attr, type, buf.c_str());
+        H5Aclose(attr);
+    }
+    H5Sclose(space);
+    H5Tclose(type);
+    if (err < 0) hdf5Fail("write attribute '" + name + "'");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::HDF5Writer::start(void)
+{
+    if (pStarted == true) return;
+    H5Fflush(pH->file, H5F_SCOPE_GLOBAL);
+    if (pthread_create(&pThread, 0, _work, this) != 0)
+    {
+        std::ostringstream os;
+        os << "Cannot start the HDF5 writer thread.";
+        throw steps::ProgErr(os.str());
+    }
+    pStarted = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::HDF5Writer::_checkError(void)
+{
+    pthread_mutex_lock(&pMutex);
+    std::string err = pError;
+    pthread_mutex_unlock(&pMutex);
+    if (err != "") throw steps::ProgErr(err);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::HDF5Writer::append(double t, double const * row)
+{
+    assert(pStarted == true);
+    pCurrent.times.push_back(t);
+    pCurrent.data.insert(pCurrent.data.end(), row, row + pNCols);
+    if (pCurrent.times.size() < pBlockRows) return;
+
+    pthread_mutex_lock(&pMutex);
+    while (pPending.size() >= 2 && pError == "")
+    {
+        pthread_cond_wait(&pCond, &pMutex);
+    }
+    if (pError == "")
+    {
+        pPending.push_back(Block());
+        pPending.back().times.swap(pCurrent.times);
+        pPending.back().data.swap(pCurrent.data);
+        pthread_cond_broadcast(&pCond);
+    }
+    pthread_mutex_unlock(&pMutex);
+
+    pCurrent.times.clear();
+    pCurrent.data.clear();
+    pCurrent.times.reserve(pBlockRows);
+    pCurrent.data.reserve(pBlockRows * pNCols);
+    _checkError();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void * ssolver::HDF5Writer::_work(void * arg)
+{
+    HDF5Writer * w = static_cast<HDF5Writer *>(arg);
+    while (true)
+    {
+        pthread_mutex_lock(&w->pMutex);
+        while (w->pPending.empty() && w->pClosing == false)
+        {
+            pthread_cond_wait(&w->pCond, &w->pMutex);
+        }
+        if (w->pPending.empty())
+        {
+            pthread_mutex_unlock(&w->pMutex);
+            break;
+        }
+        Block blk;
+        blk.times.swap(w->pPending.front().times);
+        blk.data.swap(w->pPending.front().data);
+        pthread_mutex_unlock(&w->pMutex);
+
+        // The block stays at the front of the queue while it is written,
+        // so that append() counts it as pending.
+        std::string err;
+        try
+        {
+            w->_writeBlock(blk);
+        }
+        catch (steps::Err & e)
+        {
+            err = e.getMsg();
+        }
+
+        pthread_mutex_lock(&w->pMutex);
+        w->pPending.pop_front();
+        if (err != "" && w->pError == "")
+        {
+            w->pError = err;
+            w->pPending.clear();
+        }
+        pthread_cond_broadcast(&w->pCond);
+        pthread_mutex_unlock(&w->pMutex);
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::HDF5Writer::_writeBlock(Block const & blk)
+{
+    hsize_t nrows = blk.times.size();
+    if (nrows == 0) return;
+
+    hsize_t start[2] = {pNRows, 0};
+    hsize_t count[2] = {nrows, pNCols};
+    hsize_t tsize = pNRows + nrows;
+    hsize_t dsize[2] = {tsize, pNCols};
+
+    if (H5Dset_extent(pH->time, &tsize) < 0) hdf5Fail("extend /time");
+    hid_t fspace = H5Dget_space(pH->time);
+    H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, 0, count, 0);
+    hid_t mspace = H5Screate_simple(1, &nrows, 0);
+    herr_t err = H5Dwrite(pH->time, H5T_NATIVE_DOUBLE, mspace, fspace, H5P_DEFAULT, &blk.times[0]);
+    H5Sclose(mspace);
+    H5Sclose(fspace);
+    if (err < 0) hdf5Fail("write /time");
+
+    if (pNCols != 0)
+    {
+        if (H5Dset_extent(pH->data, dsize) < 0) hdf5Fail("extend /data");
+        fspace = H5Dget_space(pH->data);
+        H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, 0, count, 0);
+        mspace = H5Screate_simple(2, count, 0);
+        err = H5Dwrite(pH->data, H5T_NATIVE_DOUBLE, mspace, fspace, H5P_DEFAULT, &blk.data[0]);
+        H5Sclose(mspace);
+        H5Sclose(fspace);
+        if (err < 0) hdf5Fail("write /data");
+    }
+
+    pNRows += nrows;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::HDF5Writer::close(void)
+{
+    if (pH == 0) return;
+
+    std::string err;
+    if (pStarted == true)
+    {
+        pthread_mutex_lock(&pMutex);
+        if (pCurrent.times.empty() == false && pError == "")
+        {
+            pPending.push_back(Block());
+            pPending.back().times.swap(pCurrent.times);
+            pPending.back().data.swap(pCurrent.data);
+        }
+        pClosing = true;
+        pthread_cond_broadcast(&pCond);
+        pthread_mutex_unlock(&pMutex);
+        pthread_join(pThread, 0);
+        pStarted = false;
+        err = pError;
+    }
+
+    H5Dclose(pH->time);
+    H5Dclose(pH->data);
+    H5Fclose(pH->file);
+    delete pH;
+    pH = 0;
+
+    if (err != "") throw steps::ProgErr(err);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
+// STEPS_USE_HDF5
+
+// END
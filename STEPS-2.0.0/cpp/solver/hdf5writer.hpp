@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_HDF5WRITER_HPP
+#define STEPS_SOLVER_HDF5WRITER_HPP 1
+
+// STL headers.
+#include <deque>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+// STEPS headers.
+#include "../common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Streams the samples of a Recorder to an HDF5 file, as a chunked and
+/// compressed dataset /data (samples x columns) with the sample times in
+/// /time and a label per column in /columns.
+///
+/// Rows are gathered in blocks which a background thread writes, so
+/// that the disk writes overlap with the simulation. At most two blocks
+/// wait to be written; append() blocks beyond that. All HDF5 calls are
+/// made either before the thread starts (metadata) or from the thread,
+/// so a library built without thread safety can be used.
+///
+/// Only available when built with STEPS_USE_HDF5 (setup.py defines it
+/// if it finds the HDF5 library).
+///
+class HDF5Writer
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Create the file and its datasets.
+    ///
+    /// \param file_name Name of the file, which is overwritten.
+    /// \param labels A label for each column.
+    /// \param block_rows Number of samples written at a time.
+    /// \param level Deflate compression level (0 for none, up to 9).
+    ///
+    HDF5Writer(std::string const & file_name,
+               std::vector<std::string> const & labels,
+               uint block_rows, uint level);
+
+    /// Close the file, writing any rows that are still buffered.
+    ///
+    ~HDF5Writer(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // METADATA
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Store a list of strings, a matrix or a string attribute of the
+    /// root group. path may name a group below the root ("/mesh/tets"),
+    /// which is created. Only allowed before start().
+    ///
+    void writeStrings(std::string const & path,
+                      std::vector<std::string> const & strs);
+
+    void writeMatrix(std::string const & path, double const * vals,
+                     uint rows, uint cols);
+
+    void writeMatrix(std::string const & path, uint const * vals,
+                     uint rows, uint cols);
+
+    void writeAttribute(std::string const & name, std::string const & val);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SAMPLES
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Start the writer thread.
+    ///
+    void start(void);
+
+    /// Add a sample: its time and one value per column.
+    ///
+    void append(double t, double const * row);
+
+    /// Write the buffered rows, stop the thread and close the file.
+    /// Throws the error of a failed write, if any.
+    ///
+    void close(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    struct Block
+    {
+        std::vector<double>             times;
+        std::vector<double>             data;
+    };
+
+    struct Handles;
+
+    static void * _work(void * arg);
+
+    void _writeBlock(Block const & blk);
+
+    void _checkError(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    Handles                           * pH;
+
+    uint                                pNCols;
+    uint                                pBlockRows;
+    unsigned long long                  pNRows;
+
+    Block                               pCurrent;
+    std::deque<Block>                   pPending;
+
+    bool                                pStarted;
+    bool                                pClosing;
+    std::string                         pError;
+
+    pthread_t                           pThread;
+    pthread_mutex_t                     pMutex;
+    pthread_cond_t                      pCond;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SOLVER_HDF5WRITER_HPP
+
+// END
@@ -77,7 +77,7 @@ ssolver::OhmicCurrdef::~OhmicCurrdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::OhmicCurrdef::checkpoint(std::fstream & cp_file)
+void ssolver::OhmicCurrdef::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pG, sizeof(double));
     cp_file.write((char*)&pERev, sizeof(double));
@@ -85,7 +85,7 @@ void ssolver::OhmicCurrdef::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::OhmicCurrdef::restore(std::fstream & cp_file)
+void ssolver::OhmicCurrdef::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pG, sizeof(double));
     cp_file.read((char*)&pERev, sizeof(double));
@@ -134,4 +134,11 @@ bool ssolver::OhmicCurrdef::req(uint gidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::OhmicCurrdef::getMemoryUsage(void) const
+{
+    return sizeof(OhmicCurrdef) + pStatedef->countSpecs() * sizeof(int);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
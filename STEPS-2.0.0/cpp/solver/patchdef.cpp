@@ -32,6 +32,8 @@
 #include <string>
 #include <cassert>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 
 // STEPS headers.
 #include "../common.h"
@@ -57,6 +59,56 @@ NAMESPACE_ALIAS(steps::solver, ssolver);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Store the columns and values of the nonzero entries of the nrows x ncols
+// table upd, row by row: the entries of row r are at positions start[r] to
+// start[r+1]-1 of cols and vals.
+template <typename T>
+static void nonzero_cols(T const * upd, uint nrows, uint ncols,
+                         uint *& start, uint *& cols, T *& vals)
+{
+    start = new uint[nrows + 1];
+    start[0] = 0;
+    for (uint r = 0; r < nrows; ++r)
+    {
+        start[r + 1] = start[r];
+        for (uint c = 0; c < ncols; ++c)
+        {
+            if (upd[(r * ncols) + c] != 0) ++start[r + 1];
+        }
+    }
+    cols = new uint[start[nrows]];
+    vals = new T[start[nrows]];
+    uint i = 0;
+    for (uint r = 0; r < nrows; ++r)
+    {
+        for (uint c = 0; c < ncols; ++c)
+        {
+            T v = upd[(r * ncols) + c];
+            if (v == 0) continue;
+            cols[i] = c;
+            vals[i] = v;
+            ++i;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The entry in column col of row row of a table stored by nonzero_cols,
+// or zero.
+template <typename T>
+static T nonzero_at(uint const * start, uint const * cols, T const * vals,
+                    uint row, uint col)
+{
+    uint const * bgn = cols + start[row];
+    uint const * end = cols + start[row + 1];
+    uint const * c = std::lower_bound(bgn, end, col);
+    if (c == end || *c != col) return 0;
+    return vals[c - cols];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 ssolver::Patchdef::Patchdef(Statedef * sd, uint idx, steps::wm::Patch * p)
 : pStatedef(sd)
 , pIdx(idx)
@@ -81,19 +133,45 @@ ssolver::Patchdef::Patchdef(Statedef * sd, uint idx, steps::wm::Patch * p)
 , pSReac_L2G(0)
 , pSReacKcst(0)
 , pSReacFlags(0)
-, pSReac_DEP_I_Spec(0)
-, pSReac_DEP_S_Spec(0)
-, pSReac_DEP_O_Spec(0)
 , pSReac_LHS_I_Spec(0)
 , pSReac_LHS_S_Spec(0)
 , pSReac_LHS_O_Spec(0)
 , pSReac_UPD_I_Spec(0)
 , pSReac_UPD_S_Spec(0)
 , pSReac_UPD_O_Spec(0)
+, pSReac_UPDSpec_I_Start(0)
+, pSReac_UPDSpec_S_Start(0)
+, pSReac_UPDSpec_O_Start(0)
+, pSReac_UPDSpec_I(0)
+, pSReac_UPDSpec_S(0)
+, pSReac_UPDSpec_O(0)
+, pSReac_UPDDelta_I(0)
+, pSReac_UPDDelta_S(0)
+, pSReac_UPDDelta_O(0)
+, pSReac_LHSSpec_I_Start(0)
+, pSReac_LHSSpec_S_Start(0)
+, pSReac_LHSSpec_O_Start(0)
+, pSReac_LHSSpec_I(0)
+, pSReac_LHSSpec_S(0)
+, pSReac_LHSSpec_O(0)
+, pSReac_LHSOrder_I(0)
+, pSReac_LHSOrder_S(0)
+, pSReac_LHSOrder_O(0)
+, pSReac_DEPSpec_I_Start(0)
+, pSReac_DEPSpec_S_Start(0)
+, pSReac_DEPSpec_O_Start(0)
+, pSReac_DEPSpec_I(0)
+, pSReac_DEPSpec_S(0)
+, pSReac_DEPSpec_O(0)
+, pSReac_DEPVal_I(0)
+, pSReac_DEPVal_S(0)
+, pSReac_DEPVal_O(0)
 , pSurfDiffsN(0)
 , pSurfDiff_G2L(0)
 , pSurfDiff_L2G(0)
-, pSurfDiff_DEP_Spec(0)
+, pSurfDiff_DEPSpec_Start(0)
+, pSurfDiff_DEPSpec(0)
+, pSurfDiff_DEPVal(0)
 , pSurfDiff_LIG(0)
 , pOhmicCurrsN(0)
 , pOhmicCurr_G2L(0)
@@ -114,9 +192,15 @@ ssolver::Patchdef::Patchdef(Statedef * sd, uint idx, steps::wm::Patch * p)
 , pVDepSReacsN(0)
 , pVDepSReac_G2L(0)
 , pVDepSReac_L2G(0)
-, pVDepSReac_DEP_I_Spec(0)
-, pVDepSReac_DEP_S_Spec(0)
-, pVDepSReac_DEP_O_Spec(0)
+, pVDepSReac_DEPSpec_I_Start(0)
+, pVDepSReac_DEPSpec_S_Start(0)
+, pVDepSReac_DEPSpec_O_Start(0)
+, pVDepSReac_DEPSpec_I(0)
+, pVDepSReac_DEPSpec_S(0)
+, pVDepSReac_DEPSpec_O(0)
+, pVDepSReac_DEPVal_I(0)
+, pVDepSReac_DEPVal_S(0)
+, pVDepSReac_DEPVal_O(0)
 , pVDepSReac_LHS_I_Spec(0)
 , pVDepSReac_LHS_S_Spec(0)
 , pVDepSReac_LHS_O_Spec(0)
@@ -200,35 +284,65 @@ ssolver::Patchdef::~Patchdef(void)
     if (pSReacsN != 0)
     {
     	delete[] pSReac_L2G;
-    	delete[] pSReac_DEP_S_Spec;
     	delete[] pSReac_LHS_S_Spec;
     	delete[] pSReac_UPD_S_Spec;
-    	delete[] pSReac_DEP_I_Spec;
     	delete[] pSReac_LHS_I_Spec;
     	delete[] pSReac_UPD_I_Spec;
     	if (pOuter != 0)
     	{
-    		delete[] pSReac_DEP_O_Spec;
     		delete[] pSReac_LHS_O_Spec;
     		delete[] pSReac_UPD_O_Spec;
     	}
+    	delete[] pSReac_UPDSpec_I_Start;
+    	delete[] pSReac_UPDSpec_S_Start;
+    	delete[] pSReac_UPDSpec_O_Start;
+    	delete[] pSReac_UPDSpec_I;
+    	delete[] pSReac_UPDSpec_S;
+    	delete[] pSReac_UPDSpec_O;
+    	delete[] pSReac_UPDDelta_I;
+    	delete[] pSReac_UPDDelta_S;
+    	delete[] pSReac_UPDDelta_O;
+    	delete[] pSReac_LHSSpec_I_Start;
+    	delete[] pSReac_LHSSpec_S_Start;
+    	delete[] pSReac_LHSSpec_O_Start;
+    	delete[] pSReac_LHSSpec_I;
+    	delete[] pSReac_LHSSpec_S;
+    	delete[] pSReac_LHSSpec_O;
+    	delete[] pSReac_LHSOrder_I;
+    	delete[] pSReac_LHSOrder_S;
+    	delete[] pSReac_LHSOrder_O;
+    	delete[] pSReac_DEPSpec_I_Start;
+    	delete[] pSReac_DEPSpec_S_Start;
+    	delete[] pSReac_DEPSpec_O_Start;
+    	delete[] pSReac_DEPSpec_I;
+    	delete[] pSReac_DEPSpec_S;
+    	delete[] pSReac_DEPSpec_O;
+    	delete[] pSReac_DEPVal_I;
+    	delete[] pSReac_DEPVal_S;
+    	delete[] pSReac_DEPVal_O;
     }
 
     if (pVDepSReacsN != 0)
     {
     	delete[] pVDepSReac_L2G;
-    	delete[] pVDepSReac_DEP_S_Spec;
     	delete[] pVDepSReac_LHS_S_Spec;
     	delete[] pVDepSReac_UPD_S_Spec;
-    	delete[] pVDepSReac_DEP_I_Spec;
     	delete[] pVDepSReac_LHS_I_Spec;
     	delete[] pVDepSReac_UPD_I_Spec;
     	if (pOuter != 0)
     	{
-    		delete[] pVDepSReac_DEP_O_Spec;
     		delete[] pVDepSReac_LHS_O_Spec;
     		delete[] pVDepSReac_UPD_O_Spec;
     	}
+    	delete[] pVDepSReac_DEPSpec_I_Start;
+    	delete[] pVDepSReac_DEPSpec_S_Start;
+    	delete[] pVDepSReac_DEPSpec_O_Start;
+    	delete[] pVDepSReac_DEPSpec_I;
+    	delete[] pVDepSReac_DEPSpec_S;
+    	delete[] pVDepSReac_DEPSpec_O;
+    	delete[] pVDepSReac_DEPVal_I;
+    	delete[] pVDepSReac_DEPVal_S;
+    	delete[] pVDepSReac_DEPVal_O;
     }
 
     if (pOhmicCurrsN != 0)
@@ -263,7 +377,9 @@ ssolver::Patchdef::~Patchdef(void)
     if (pSurfDiffsN != 0)
     {
     	delete[] pSurfDiff_L2G;
-    	delete[] pSurfDiff_DEP_Spec;
+    	delete[] pSurfDiff_DEPSpec_Start;
+    	delete[] pSurfDiff_DEPSpec;
+    	delete[] pSurfDiff_DEPVal;
     	delete[] pSurfDiff_LIG;
     	delete[] pSurfDiffDcst;
 
@@ -278,7 +394,7 @@ ssolver::Patchdef::~Patchdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Patchdef::checkpoint(std::fstream & cp_file)
+void ssolver::Patchdef::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)pPoolCount, sizeof(double) * pSpecsN_S);
     cp_file.write((char*)pPoolFlags, sizeof(uint) * pSpecsN_S);
@@ -288,7 +404,7 @@ void ssolver::Patchdef::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Patchdef::restore(std::fstream & cp_file)
+void ssolver::Patchdef::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)pPoolCount, sizeof(double) * pSpecsN_S);
     cp_file.read((char*)pPoolFlags, sizeof(uint) * pSpecsN_S);
@@ -336,7 +452,7 @@ void ssolver::Patchdef::setup_references(void)
 	for(std::set<std::string>::const_iterator s = pPssys.begin();
 		s != s_end; ++s)
 	{
-		std::map<std::string, steps::model::SReac *> ssreacs = pStatedef->model()->getSurfsys(*s)->_getAllSReacs();
+		std::map<std::string, steps::model::SReac *> const & ssreacs = pStatedef->model()->getSurfsys(*s)->_getAllSReacs();
 		if (ngsreacs == 0) assert (ssreacs.empty() == true);
 		std::map<std::string, steps::model::SReac*>::const_iterator sr_end = ssreacs.end();
 		for(std::map<std::string, steps::model::SReac *>::const_iterator sr = ssreacs.begin(); sr != sr_end; ++sr)
@@ -347,7 +463,7 @@ void ssolver::Patchdef::setup_references(void)
 			pSReac_G2L[gidx] = pSReacsN++;
 		}
 
-       	std::map<std::string, steps::model::Diff *> sdiffs = pStatedef->model()->getSurfsys(*s)->_getAllDiffs();
+       	std::map<std::string, steps::model::Diff *> const & sdiffs = pStatedef->model()->getSurfsys(*s)->_getAllDiffs();
     	if (ngsdiffs == 0) assert(sdiffs.empty() == true);
        	std::map<std::string, steps::model::Diff*>::const_iterator sd_end = sdiffs.end();
        	for (std::map<std::string, steps::model::Diff*>::const_iterator sd = sdiffs.begin(); sd != sd_end; ++sd)
@@ -358,7 +474,7 @@ void ssolver::Patchdef::setup_references(void)
        		pSurfDiff_G2L[gidx] = pSurfDiffsN++;
        	}
 
-		std::map<std::string, steps::model::VDepSReac *> vdssreacs = pStatedef->model()->getSurfsys(*s)->_getAllVDepSReacs();
+		std::map<std::string, steps::model::VDepSReac *> const & vdssreacs = pStatedef->model()->getSurfsys(*s)->_getAllVDepSReacs();
 		if (ngvdepsreacs == 0) assert (vdssreacs.empty() == true);
 		std::map<std::string, steps::model::VDepSReac*>::const_iterator vdsr_end = vdssreacs.end();
 		for(std::map<std::string, steps::model::VDepSReac *>::const_iterator vdsr = vdssreacs.begin(); vdsr != vdsr_end; ++vdsr)
@@ -369,7 +485,7 @@ void ssolver::Patchdef::setup_references(void)
 			pVDepSReac_G2L[gidx] = pVDepSReacsN++;
 		}
 
-		std::map<std::string, steps::model::OhmicCurr *> ocs = pStatedef->model()->getSurfsys(*s)->_getAllOhmicCurrs();
+		std::map<std::string, steps::model::OhmicCurr *> const & ocs = pStatedef->model()->getSurfsys(*s)->_getAllOhmicCurrs();
 		if (ngohmiccurrs == 0) assert (ocs.empty() == true);
 		std::map<std::string, steps::model::OhmicCurr *>::const_iterator oc_end = ocs.end();
 		for(std::map<std::string, steps::model::OhmicCurr *>::const_iterator oc = ocs.begin(); oc != oc_end; ++oc)
@@ -380,7 +496,7 @@ void ssolver::Patchdef::setup_references(void)
 			pOhmicCurr_G2L[gidx] = pOhmicCurrsN++;
 		}
 
-		std::map<std::string, steps::model::GHKcurr *> ghks = pStatedef->model()->getSurfsys(*s)->_getAllGHKcurrs();
+		std::map<std::string, steps::model::GHKcurr *> const & ghks = pStatedef->model()->getSurfsys(*s)->_getAllGHKcurrs();
 		if (ngghkcurrs == 0) assert (ghks.empty() == true);
 		std::map<std::string, steps::model::GHKcurr *>::const_iterator ghk_end = ghks.end();
 		for(std::map<std::string, steps::model::GHKcurr *>::const_iterator ghk = ghks.begin(); ghk != ghk_end; ++ghk)
@@ -391,7 +507,7 @@ void ssolver::Patchdef::setup_references(void)
 			pGHKcurr_G2L[gidx] = pGHKcurrsN++;
 		}
 
-		std::map<std::string, steps::model::VDepTrans *> vdts = pStatedef->model()->getSurfsys(*s)->_getAllVDepTrans();
+		std::map<std::string, steps::model::VDepTrans *> const & vdts = pStatedef->model()->getSurfsys(*s)->_getAllVDepTrans();
 		if (ngvdeptrans == 0) assert (vdts.empty() == true);
 		std::map<std::string, steps::model::VDepTrans *>::const_iterator vdt_end = vdts.end();
 		for(std::map<std::string, steps::model::VDepTrans *>::const_iterator vdt = vdts.begin(); vdt != vdt_end; ++vdt)
@@ -412,29 +528,29 @@ void ssolver::Patchdef::setup_references(void)
 		if(pSReac_G2L[sr] == LIDX_UNDEFINED) continue;
 		SReacdef * srdef = pStatedef->sreacdef(sr);
 		assert(srdef != 0);
-		for (uint s = 0; s < ngspecs; ++s)
+		gidxTVecCI s_end = srdef->endReqColl_S();
+		for (gidxTVecCI s = srdef->beginReqColl_S(); s != s_end; ++s)
 		{
-			if (srdef->reqspec_S(s) == true)
-			{
-				assert (pStatedef->specdef(s) != 0);
-				if (pSpec_G2L[s] == LIDX_UNDEFINED) pSpec_G2L[s] = pSpecsN_S++;
-			}
-			if (srdef->reqspec_I(s) == true)
-			{
-				assert(pInner != 0);
-				pInner->addSpec(s);
-			}
-			if (srdef->reqspec_O(s) == true)
+			assert (pStatedef->specdef(*s) != 0);
+			if (pSpec_G2L[*s] == LIDX_UNDEFINED) pSpec_G2L[*s] = pSpecsN_S++;
+		}
+		gidxTVecCI i_end = srdef->endReqColl_I();
+		for (gidxTVecCI i = srdef->beginReqColl_I(); i != i_end; ++i)
+		{
+			assert(pInner != 0);
+			pInner->addSpec(*i);
+		}
+		gidxTVecCI o_end = srdef->endReqColl_O();
+		for (gidxTVecCI o = srdef->beginReqColl_O(); o != o_end; ++o)
+		{
+			if (pOuter == 0)
 			{
-				if (pOuter == 0)
-			    {
-			        std::ostringstream os;
-			        os << "Can't add surface reaction '" << srdef->name() << "' to patch '";
-			        os << name() << "'. Outer compartment not defined for this patch.";
-			        throw steps::ArgErr(os.str());
-			    }
-				pOuter->addSpec(s);
+				std::ostringstream os;
+				os << "Can't add surface reaction '" << srdef->name() << "' to patch '";
+				os << name() << "'. Outer compartment not defined for this patch.";
+				throw steps::ArgErr(os.str());
 			}
+			pOuter->addSpec(*o);
 		}
 	}
 
@@ -443,13 +559,9 @@ void ssolver::Patchdef::setup_references(void)
     	if (pSurfDiff_G2L[sd] == LIDX_UNDEFINED) continue;
     	SurfDiffdef * sddef = pStatedef->surfdiffdef(sd);
     	assert (sddef != 0);
-    	for (uint s = 0; s < ngspecs; ++s)
-    	{
-    		if (sddef->reqspec(s) == true)
-    		{
-    			if (pSpec_G2L[s] == LIDX_UNDEFINED) pSpec_G2L[s] = pSpecsN_S++;
-    		}
-    	}
+    	// The ligand is the only species a diffusion rule references.
+    	uint s = sddef->lig();
+    	if (pSpec_G2L[s] == LIDX_UNDEFINED) pSpec_G2L[s] = pSpecsN_S++;
     }
 
 	for(uint vdsr = 0; vdsr < ngvdepsreacs; ++vdsr)
@@ -641,34 +753,34 @@ void ssolver::Patchdef::setup_indices(void)
             pSReac_L2G[lidx] = i;
         }
 
-        // Create _DEP, _LHS and _UPD vectors.
+        // Create _DEP, _LHS and _UPD vectors. The _DEP tables are only
+        // filled here and kept in sparse form.
         uint arrsize_i = 0;
         uint arrsize_s = pSpecsN_S * pSReacsN;
         uint arrsize_o = 0;
-        pSReac_DEP_S_Spec = new int[arrsize_s];
+        std::vector<int> dep_s(arrsize_s, 0);
+        std::vector<int> dep_i;
+        std::vector<int> dep_o;
         pSReac_LHS_S_Spec = new uint[arrsize_s];
         pSReac_UPD_S_Spec = new int[arrsize_s];
-        std::fill_n(pSReac_DEP_S_Spec, arrsize_s, 0);
         std::fill_n(pSReac_LHS_S_Spec, arrsize_s, 0);
         std::fill_n(pSReac_UPD_S_Spec, arrsize_s, 0);
 
         assert (pInner != 0); // Inner comp should exist
         {
             arrsize_i = pSpecsN_I * pSReacsN;
-            pSReac_DEP_I_Spec = new int[arrsize_i];
+            dep_i.assign(arrsize_i, 0);
             pSReac_LHS_I_Spec = new uint[arrsize_i];
             pSReac_UPD_I_Spec = new int[arrsize_i];
-            std::fill_n(pSReac_DEP_I_Spec, arrsize_i, 0);
             std::fill_n(pSReac_LHS_I_Spec, arrsize_i, 0);
             std::fill_n(pSReac_UPD_I_Spec, arrsize_i, 0);
         }
         if (pOuter != 0) // Only create if outer comp exists.
         {
             arrsize_o = pSpecsN_O * pSReacsN;
-            pSReac_DEP_O_Spec = new int[arrsize_o];
+            dep_o.assign(arrsize_o, 0);
             pSReac_LHS_O_Spec = new uint[arrsize_o];
             pSReac_UPD_O_Spec = new int[arrsize_o];
-            std::fill_n(pSReac_DEP_O_Spec, arrsize_o, 0);
             std::fill_n(pSReac_LHS_O_Spec, arrsize_o, 0);
             std::fill_n(pSReac_UPD_O_Spec, arrsize_o, 0);
         }
@@ -679,16 +791,17 @@ void ssolver::Patchdef::setup_indices(void)
             SReacdef * srdef = sreacdef(ri);
 
             // Handle surface stuff.
-            for (uint si = 0; si < ngspecs; ++si)
+            gidxTVecCI s_end = srdef->endReqColl_S();
+            for (gidxTVecCI s = srdef->beginReqColl_S(); s != s_end; ++s)
             {
-                if (srdef->reqspec_S(si) == false) continue;
+                uint si = *s;
 
                 // TODO: turn into error check?
                 uint sil = pSpec_G2L[si];
                 assert(sil != LIDX_UNDEFINED);
 
                 uint aridx = _IDX_SReac_S_Spec(ri, sil);
-                pSReac_DEP_S_Spec[aridx] = srdef->dep_S(si);
+                dep_s[aridx] = srdef->dep_S(si);
                 pSReac_LHS_S_Spec[aridx] = srdef->lhs_S(si);
                 pSReac_UPD_S_Spec[aridx] = srdef->upd_S(si);
             }
@@ -699,16 +812,17 @@ void ssolver::Patchdef::setup_indices(void)
                 // TODO: turn into real error check?
                 assert(pInner != 0);
 
-                for (uint si = 0; si < ngspecs; ++si)
+                gidxTVecCI s_end = srdef->endReqColl_I();
+                for (gidxTVecCI s = srdef->beginReqColl_I(); s != s_end; ++s)
                 {
-                    if (srdef->reqspec_I(si) == false) continue;
+                    uint si = *s;
 
                     // TODO: turn into error check?
                     uint sil = specG2L_I(si);
                     assert(sil != LIDX_UNDEFINED);
 
                     uint aridx = _IDX_SReac_I_Spec(ri, sil);
-                    pSReac_DEP_I_Spec[aridx] = srdef->dep_I(si);
+                    dep_i[aridx] = srdef->dep_I(si);
                     pSReac_LHS_I_Spec[aridx] = srdef->lhs_I(si);
                     pSReac_UPD_I_Spec[aridx] = srdef->upd_I(si);
                 }
@@ -720,21 +834,52 @@ void ssolver::Patchdef::setup_indices(void)
                 // TODO: turn into real error check?
                 assert(pOuter != 0);
 
-                for (uint si = 0; si < ngspecs; ++si)
+                gidxTVecCI s_end = srdef->endReqColl_O();
+                for (gidxTVecCI s = srdef->beginReqColl_O(); s != s_end; ++s)
                 {
-                    if (srdef->reqspec_O(si) == false) continue;
+                    uint si = *s;
 
                     // TODO: turn into error check?
                     uint sil = specG2L_O(si);
                     assert(sil != LIDX_UNDEFINED);
 
                     uint aridx = _IDX_SReac_O_Spec(ri, sil);
-                    pSReac_DEP_O_Spec[aridx] = srdef->dep_O(si);
+                    dep_o[aridx] = srdef->dep_O(si);
                     pSReac_LHS_O_Spec[aridx] = srdef->lhs_O(si);
                     pSReac_UPD_O_Spec[aridx] = srdef->upd_O(si);
                 }
             }
         }
+
+        // Without an outer compartment there are no O columns, so the
+        // (unallocated) O table is never read.
+        nonzero_cols(pSReac_UPD_I_Spec, pSReacsN, pSpecsN_I,
+                     pSReac_UPDSpec_I_Start, pSReac_UPDSpec_I,
+                     pSReac_UPDDelta_I);
+        nonzero_cols(pSReac_UPD_S_Spec, pSReacsN, pSpecsN_S,
+                     pSReac_UPDSpec_S_Start, pSReac_UPDSpec_S,
+                     pSReac_UPDDelta_S);
+        nonzero_cols(pSReac_UPD_O_Spec, pSReacsN, pSpecsN_O,
+                     pSReac_UPDSpec_O_Start, pSReac_UPDSpec_O,
+                     pSReac_UPDDelta_O);
+        nonzero_cols(pSReac_LHS_I_Spec, pSReacsN, pSpecsN_I,
+                     pSReac_LHSSpec_I_Start, pSReac_LHSSpec_I,
+                     pSReac_LHSOrder_I);
+        nonzero_cols(pSReac_LHS_S_Spec, pSReacsN, pSpecsN_S,
+                     pSReac_LHSSpec_S_Start, pSReac_LHSSpec_S,
+                     pSReac_LHSOrder_S);
+        nonzero_cols(pSReac_LHS_O_Spec, pSReacsN, pSpecsN_O,
+                     pSReac_LHSSpec_O_Start, pSReac_LHSSpec_O,
+                     pSReac_LHSOrder_O);
+        nonzero_cols(dep_i.empty() ? 0 : &dep_i[0], pSReacsN, pSpecsN_I,
+                     pSReac_DEPSpec_I_Start, pSReac_DEPSpec_I,
+                     pSReac_DEPVal_I);
+        nonzero_cols(dep_s.empty() ? 0 : &dep_s[0], pSReacsN, pSpecsN_S,
+                     pSReac_DEPSpec_S_Start, pSReac_DEPSpec_S,
+                     pSReac_DEPVal_S);
+        nonzero_cols(dep_o.empty() ? 0 : &dep_o[0], pSReacsN, pSpecsN_O,
+                     pSReac_DEPSpec_O_Start, pSReac_DEPSpec_O,
+                     pSReac_DEPVal_O);
     }
 
     // 3.5 -- DEAL WITH PATCH SURFACE-DIFFUSION
@@ -751,8 +896,7 @@ void ssolver::Patchdef::setup_indices(void)
     	}
 
     	uint arrsize = pSpecsN_S * pSurfDiffsN;
-    	pSurfDiff_DEP_Spec = new uint[arrsize];
-    	std::fill_n(pSurfDiff_DEP_Spec, arrsize, 0);
+    	std::vector<uint> dep(arrsize, 0);
     	pSurfDiff_LIG = new uint[pSurfDiffsN];
     	for (uint di = 0; di < pSurfDiffsN; ++di)
     	{
@@ -764,9 +908,11 @@ void ssolver::Patchdef::setup_indices(void)
     			uint sil = pSpec_G2L[si];
     			assert(sil != LIDX_UNDEFINED);
     			uint aridx = _IDX_SurfDiff_Spec(di, sil);
-    			pSurfDiff_DEP_Spec[aridx] = sddef->dep(si);
+    			dep[aridx] = sddef->dep(si);
     		}
     	}
+    	nonzero_cols(dep.empty() ? 0 : &dep[0], pSurfDiffsN, pSpecsN_S,
+    	             pSurfDiff_DEPSpec_Start, pSurfDiff_DEPSpec, pSurfDiff_DEPVal);
     }
 
     // 4 -- DEAL WITH PATCH VOLTAGE-DEPENDENT SURFACE REACTIONS
@@ -782,34 +928,34 @@ void ssolver::Patchdef::setup_indices(void)
             pVDepSReac_L2G[lidx] = i;
         }
 
-        // Create _DEP, _LHS and _UPD vectors.
+        // Create _DEP, _LHS and _UPD vectors, the _DEP tables only to be
+        // kept in sparse form.
         uint arrsize_i = 0;
         uint arrsize_s = pSpecsN_S * pVDepSReacsN;
         uint arrsize_o = 0;
-        pVDepSReac_DEP_S_Spec = new int[arrsize_s];
+        std::vector<int> dep_s(arrsize_s, 0);
+        std::vector<int> dep_i;
+        std::vector<int> dep_o;
         pVDepSReac_LHS_S_Spec = new uint[arrsize_s];
         pVDepSReac_UPD_S_Spec = new int[arrsize_s];
-        std::fill_n(pVDepSReac_DEP_S_Spec, arrsize_s, 0);
         std::fill_n(pVDepSReac_LHS_S_Spec, arrsize_s, 0);
         std::fill_n(pVDepSReac_UPD_S_Spec, arrsize_s, 0);
 
         assert (pInner != 0); // Inner comp should exist
         {
             arrsize_i = pSpecsN_I * pVDepSReacsN;
-            pVDepSReac_DEP_I_Spec = new int[arrsize_i];
+            dep_i.assign(arrsize_i, 0);
             pVDepSReac_LHS_I_Spec = new uint[arrsize_i];
             pVDepSReac_UPD_I_Spec = new int[arrsize_i];
-            std::fill_n(pVDepSReac_DEP_I_Spec, arrsize_i, 0);
             std::fill_n(pVDepSReac_LHS_I_Spec, arrsize_i, 0);
             std::fill_n(pVDepSReac_UPD_I_Spec, arrsize_i, 0);
         }
         if (pOuter != 0) // Only create if outer comp exists.
         {
             arrsize_o = pSpecsN_O * pVDepSReacsN;
-            pVDepSReac_DEP_O_Spec = new int[arrsize_o];
+            dep_o.assign(arrsize_o, 0);
             pVDepSReac_LHS_O_Spec = new uint[arrsize_o];
             pVDepSReac_UPD_O_Spec = new int[arrsize_o];
-            std::fill_n(pVDepSReac_DEP_O_Spec, arrsize_o, 0);
             std::fill_n(pVDepSReac_LHS_O_Spec, arrsize_o, 0);
             std::fill_n(pVDepSReac_UPD_O_Spec, arrsize_o, 0);
         }
@@ -829,7 +975,7 @@ void ssolver::Patchdef::setup_indices(void)
                 assert(sil != LIDX_UNDEFINED);
 
                 uint aridx = _IDX_VDepSReac_S_Spec(ri, sil);
-                pVDepSReac_DEP_S_Spec[aridx] = vdsrdef->dep_S(si);
+                dep_s[aridx] = vdsrdef->dep_S(si);
                 pVDepSReac_LHS_S_Spec[aridx] = vdsrdef->lhs_S(si);
                 pVDepSReac_UPD_S_Spec[aridx] = vdsrdef->upd_S(si);
             }
@@ -849,7 +995,7 @@ void ssolver::Patchdef::setup_indices(void)
                     assert(sil != LIDX_UNDEFINED);
 
                     uint aridx = _IDX_VDepSReac_I_Spec(ri, sil);
-                    pVDepSReac_DEP_I_Spec[aridx] = vdsrdef->dep_I(si);
+                    dep_i[aridx] = vdsrdef->dep_I(si);
                     pVDepSReac_LHS_I_Spec[aridx] = vdsrdef->lhs_I(si);
                     pVDepSReac_UPD_I_Spec[aridx] = vdsrdef->upd_I(si);
                 }
@@ -870,12 +1016,22 @@ void ssolver::Patchdef::setup_indices(void)
                     assert(sil != LIDX_UNDEFINED);
 
                     uint aridx = _IDX_VDepSReac_O_Spec(ri, sil);
-                    pVDepSReac_DEP_O_Spec[aridx] = vdsrdef->dep_O(si);
+                    dep_o[aridx] = vdsrdef->dep_O(si);
                     pVDepSReac_LHS_O_Spec[aridx] = vdsrdef->lhs_O(si);
                     pVDepSReac_UPD_O_Spec[aridx] = vdsrdef->upd_O(si);
                 }
             }
         }
+
+        nonzero_cols(dep_i.empty() ? 0 : &dep_i[0], pVDepSReacsN, pSpecsN_I,
+                     pVDepSReac_DEPSpec_I_Start, pVDepSReac_DEPSpec_I,
+                     pVDepSReac_DEPVal_I);
+        nonzero_cols(dep_s.empty() ? 0 : &dep_s[0], pVDepSReacsN, pSpecsN_S,
+                     pVDepSReac_DEPSpec_S_Start, pVDepSReac_DEPSpec_S,
+                     pVDepSReac_DEPVal_S);
+        nonzero_cols(dep_o.empty() ? 0 : &dep_o[0], pVDepSReacsN, pSpecsN_O,
+                     pVDepSReac_DEPSpec_O_Start, pVDepSReac_DEPSpec_O,
+                     pVDepSReac_DEPVal_O);
     }
     // 5 -- DEAL WITH OHMIC CURRENTS
     if (pOhmicCurrsN != 0)
@@ -1162,21 +1318,24 @@ ssolver::VDepTransdef * ssolver::Patchdef::vdeptransdef(uint lidx) const
 
 int ssolver::Patchdef::sreac_dep_I(uint srlidx, uint splidx) const
 {
-    return pSReac_DEP_I_Spec[splidx + (srlidx * pSpecsN_I)];
+    return nonzero_at(pSReac_DEPSpec_I_Start, pSReac_DEPSpec_I,
+                      pSReac_DEPVal_I, srlidx, splidx);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 int ssolver::Patchdef::sreac_dep_S(uint srlidx, uint splidx) const
 {
-    return pSReac_DEP_S_Spec[splidx + (srlidx * pSpecsN_S)];
+    return nonzero_at(pSReac_DEPSpec_S_Start, pSReac_DEPSpec_S,
+                      pSReac_DEPVal_S, srlidx, splidx);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 int ssolver::Patchdef::sreac_dep_O(uint srlidx, uint splidx) const
 {
-    return pSReac_DEP_O_Spec[splidx + (srlidx * pSpecsN_O)];
+    return nonzero_at(pSReac_DEPSpec_O_Start, pSReac_DEPSpec_O,
+                      pSReac_DEPVal_O, srlidx, splidx);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1265,23 +1424,236 @@ int * ssolver::Patchdef::sreac_upd_O_end(uint lidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+uint * ssolver::Patchdef::sreac_updspec_I_bgn(uint lidx) const
+{
+    return pSReac_UPDSpec_I + pSReac_UPDSpec_I_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_updspec_I_end(uint lidx) const
+{
+    return pSReac_UPDSpec_I + pSReac_UPDSpec_I_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_updspec_S_bgn(uint lidx) const
+{
+    return pSReac_UPDSpec_S + pSReac_UPDSpec_S_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_updspec_S_end(uint lidx) const
+{
+    return pSReac_UPDSpec_S + pSReac_UPDSpec_S_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_updspec_O_bgn(uint lidx) const
+{
+    return pSReac_UPDSpec_O + pSReac_UPDSpec_O_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_updspec_O_end(uint lidx) const
+{
+    return pSReac_UPDSpec_O + pSReac_UPDSpec_O_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int * ssolver::Patchdef::sreac_upddelta_I_bgn(uint lidx) const
+{
+    return pSReac_UPDDelta_I + pSReac_UPDSpec_I_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int * ssolver::Patchdef::sreac_upddelta_S_bgn(uint lidx) const
+{
+    return pSReac_UPDDelta_S + pSReac_UPDSpec_S_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int * ssolver::Patchdef::sreac_upddelta_O_bgn(uint lidx) const
+{
+    return pSReac_UPDDelta_O + pSReac_UPDSpec_O_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_lhsspec_I_bgn(uint lidx) const
+{
+    return pSReac_LHSSpec_I + pSReac_LHSSpec_I_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_lhsspec_I_end(uint lidx) const
+{
+    return pSReac_LHSSpec_I + pSReac_LHSSpec_I_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_lhsspec_S_bgn(uint lidx) const
+{
+    return pSReac_LHSSpec_S + pSReac_LHSSpec_S_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_lhsspec_S_end(uint lidx) const
+{
+    return pSReac_LHSSpec_S + pSReac_LHSSpec_S_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_lhsspec_O_bgn(uint lidx) const
+{
+    return pSReac_LHSSpec_O + pSReac_LHSSpec_O_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_lhsspec_O_end(uint lidx) const
+{
+    return pSReac_LHSSpec_O + pSReac_LHSSpec_O_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_lhsorder_I_bgn(uint lidx) const
+{
+    return pSReac_LHSOrder_I + pSReac_LHSSpec_I_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_lhsorder_S_bgn(uint lidx) const
+{
+    return pSReac_LHSOrder_S + pSReac_LHSSpec_S_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_lhsorder_O_bgn(uint lidx) const
+{
+    return pSReac_LHSOrder_O + pSReac_LHSSpec_O_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_depspec_I_bgn(uint lidx) const
+{
+    return pSReac_DEPSpec_I + pSReac_DEPSpec_I_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_depspec_I_end(uint lidx) const
+{
+    return pSReac_DEPSpec_I + pSReac_DEPSpec_I_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_depspec_S_bgn(uint lidx) const
+{
+    return pSReac_DEPSpec_S + pSReac_DEPSpec_S_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_depspec_S_end(uint lidx) const
+{
+    return pSReac_DEPSpec_S + pSReac_DEPSpec_S_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_depspec_O_bgn(uint lidx) const
+{
+    return pSReac_DEPSpec_O + pSReac_DEPSpec_O_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::sreac_depspec_O_end(uint lidx) const
+{
+    return pSReac_DEPSpec_O + pSReac_DEPSpec_O_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 int ssolver::Patchdef::vdepsreac_dep_I(uint vdsrlidx, uint splidx) const
 {
-    return pVDepSReac_DEP_I_Spec[splidx + (vdsrlidx * pSpecsN_I)];
+    return nonzero_at(pVDepSReac_DEPSpec_I_Start, pVDepSReac_DEPSpec_I,
+                      pVDepSReac_DEPVal_I, vdsrlidx, splidx);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 int ssolver::Patchdef::vdepsreac_dep_S(uint vdsrlidx, uint splidx) const
 {
-    return pVDepSReac_DEP_S_Spec[splidx + (vdsrlidx * pSpecsN_S)];
+    return nonzero_at(pVDepSReac_DEPSpec_S_Start, pVDepSReac_DEPSpec_S,
+                      pVDepSReac_DEPVal_S, vdsrlidx, splidx);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 int ssolver::Patchdef::vdepsreac_dep_O(uint vdsrlidx, uint splidx) const
 {
-    return pVDepSReac_DEP_O_Spec[splidx + (vdsrlidx * pSpecsN_O)];
+    return nonzero_at(pVDepSReac_DEPSpec_O_Start, pVDepSReac_DEPSpec_O,
+                      pVDepSReac_DEPVal_O, vdsrlidx, splidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::vdepsreac_depspec_I_bgn(uint lidx) const
+{
+    return pVDepSReac_DEPSpec_I + pVDepSReac_DEPSpec_I_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::vdepsreac_depspec_I_end(uint lidx) const
+{
+    return pVDepSReac_DEPSpec_I + pVDepSReac_DEPSpec_I_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::vdepsreac_depspec_S_bgn(uint lidx) const
+{
+    return pVDepSReac_DEPSpec_S + pVDepSReac_DEPSpec_S_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::vdepsreac_depspec_S_end(uint lidx) const
+{
+    return pVDepSReac_DEPSpec_S + pVDepSReac_DEPSpec_S_Start[lidx + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::vdepsreac_depspec_O_bgn(uint lidx) const
+{
+    return pVDepSReac_DEPSpec_O + pVDepSReac_DEPSpec_O_Start[lidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::vdepsreac_depspec_O_end(uint lidx) const
+{
+    return pVDepSReac_DEPSpec_O + pVDepSReac_DEPSpec_O_Start[lidx + 1];
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1466,8 +1838,59 @@ uint ssolver::Patchdef::vdeptrans_dstchanstate(uint vdtlidx) const
 
 uint ssolver::Patchdef::surfdiff_dep(uint dlidx, uint slidx) const
 {
-	return pSurfDiff_DEP_Spec[slidx + (dlidx * pSpecsN_S)];
+	return nonzero_at(pSurfDiff_DEPSpec_Start, pSurfDiff_DEPSpec,
+	                  pSurfDiff_DEPVal, dlidx, slidx);
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::surfdiff_depspec_bgn(uint dlidx) const
+{
+	return pSurfDiff_DEPSpec + pSurfDiff_DEPSpec_Start[dlidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint * ssolver::Patchdef::surfdiff_depspec_end(uint dlidx) const
+{
+	return pSurfDiff_DEPSpec + pSurfDiff_DEPSpec_Start[dlidx + 1];
+}
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t ssolver::Patchdef::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(Patchdef);
+
+    // Global to local and local to global index tables.
+    bytes += (pStatedef->countSpecs() + pStatedef->countSReacs()
+              + pStatedef->countSurfDiffs() + pStatedef->countOhmicCurrs()
+              + pStatedef->countGHKcurrs() + pStatedef->countVDepTrans()
+              + pStatedef->countVDepSReacs()) * sizeof(uint);
+    bytes += (pSpecsN_S + pSReacsN + pSurfDiffsN + pOhmicCurrsN
+              + pGHKcurrsN + pVDepTransN + pVDepSReacsN) * sizeof(uint);
+
+    bytes += pSpecsN_S * (sizeof(double) + sizeof(uint));
+    bytes += pSReacsN * (sizeof(double) + sizeof(uint));
+
+    // DEP, LHS and UPD tables over the species of the patch and of the
+    // inner and outer compartment (zero species if there is none).
+    uint nspecs_all = pSpecsN_I + pSpecsN_S + pSpecsN_O;
+    bytes += (pSReacsN + pVDepSReacsN) * nspecs_all * (2 * sizeof(int) + sizeof(uint));
+    if (pSReacsN != 0)
+    {
+        bytes += 3 * (pSReacsN + 1) * sizeof(uint);
+        bytes += (pSReac_UPDSpec_I_Start[pSReacsN]
+                  + pSReac_UPDSpec_S_Start[pSReacsN]
+                  + pSReac_UPDSpec_O_Start[pSReacsN]) * (sizeof(uint) + sizeof(int));
+    }
+
+    bytes += pSurfDiffsN * (sizeof(double) + (pSpecsN_S + 1) * sizeof(uint));
+    bytes += pOhmicCurrsN * (pSpecsN_S * sizeof(int) + sizeof(uint));
+    bytes += pGHKcurrsN * (pSpecsN_S * sizeof(int) + 2 * sizeof(uint));
+    bytes += pVDepTransN * (pSpecsN_S * sizeof(int) + 2 * sizeof(uint));
+    return bytes;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 // END
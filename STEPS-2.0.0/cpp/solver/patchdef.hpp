@@ -85,10 +85,13 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by this object and its tables.
+    std::size_t getMemoryUsage(void) const;
 
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS: PATCH
@@ -166,10 +169,11 @@ public:
     inline uint specG2L(uint gidx) const
     { return pSpec_G2L[gidx]; }
 
-    /*										// don't need? Just used internally, instead of using member??
+    /// Return the global species index for local index argument.
+    ///
+    /// \param lidx Local index of the species.
     inline uint specL2G(uint lidx) const
     { return pSpec_L2G[lidx]; }
-    */
 
     /// Auxiliary function: resolves a species gidx for the inner
     /// compartment.
@@ -270,6 +274,54 @@ public:
     int * sreac_upd_O_bgn(uint lidx) const;
     int * sreac_upd_O_end(uint lidx) const;
 
+    /// Warning: these methods perform no error checking!
+    ///
+    // Return the beginning and end of the lists of local indices of the
+    // species that surface reaction specified by local index argument
+    // changes, i.e. the nonzero entries of its update arrays.
+    uint * sreac_updspec_I_bgn(uint lidx) const;
+    uint * sreac_updspec_I_end(uint lidx) const;
+    uint * sreac_updspec_S_bgn(uint lidx) const;
+    uint * sreac_updspec_S_end(uint lidx) const;
+    uint * sreac_updspec_O_bgn(uint lidx) const;
+    uint * sreac_updspec_O_end(uint lidx) const;
+
+    /// Warning: these methods perform no error checking!
+    ///
+    // Return the beginning of the changes in the species listed by
+    // sreac_updspec_X_bgn, in the same order.
+    int * sreac_upddelta_I_bgn(uint lidx) const;
+    int * sreac_upddelta_S_bgn(uint lidx) const;
+    int * sreac_upddelta_O_bgn(uint lidx) const;
+
+    /// Warning: these methods perform no error checking!
+    ///
+    // Return the beginning and end of the lists of local indices of the
+    // species on the lhs of surface reaction specified by local index
+    // argument, i.e. the nonzero entries of its lhs arrays, and the
+    // beginning of their lhs entries in the same order.
+    uint * sreac_lhsspec_I_bgn(uint lidx) const;
+    uint * sreac_lhsspec_I_end(uint lidx) const;
+    uint * sreac_lhsspec_S_bgn(uint lidx) const;
+    uint * sreac_lhsspec_S_end(uint lidx) const;
+    uint * sreac_lhsspec_O_bgn(uint lidx) const;
+    uint * sreac_lhsspec_O_end(uint lidx) const;
+    uint * sreac_lhsorder_I_bgn(uint lidx) const;
+    uint * sreac_lhsorder_S_bgn(uint lidx) const;
+    uint * sreac_lhsorder_O_bgn(uint lidx) const;
+
+    /// Warning: these methods perform no error checking!
+    ///
+    // Return the beginning and end of the lists of local indices of the
+    // species that surface reaction specified by local index argument
+    // depends on.
+    uint * sreac_depspec_I_bgn(uint lidx) const;
+    uint * sreac_depspec_I_end(uint lidx) const;
+    uint * sreac_depspec_S_bgn(uint lidx) const;
+    uint * sreac_depspec_S_end(uint lidx) const;
+    uint * sreac_depspec_O_bgn(uint lidx) const;
+    uint * sreac_depspec_O_end(uint lidx) const;
+
 	/// Return pointer to flags on surface reactions for this patch.
 	inline uint * srflags(void) const
 	{ return pSReacFlags; }
@@ -316,6 +368,14 @@ public:
     /// \todo make sure this is correct.
 	uint surfdiff_dep(uint dlidx, uint slidx) const;
 
+	/// Return the beginning and end of the list of local indices of the
+	/// species that surface diffusion rule specified by local index
+	/// argument depends on.
+    ///
+    /// \param dlidx Local index of the surface diffusion rule.
+	uint * surfdiff_depspec_bgn(uint dlidx) const;
+	uint * surfdiff_depspec_end(uint dlidx) const;
+
     /// Return the rate constant of surface diffusion by local index argument.
     ///
     /// \param dlidx Local index of the surface diffusion.
@@ -440,6 +500,18 @@ public:
     int vdepsreac_dep_S(uint vdsrlidx, uint splidx) const;
     int vdepsreac_dep_O(uint vdsrlidx, uint splidx) const;
 
+    /// Warning: these methods perform no error checking!
+    ///
+    // Return the beginning and end of the lists of local indices of the
+    // species that voltage-dependent reaction specified by local index
+    // argument depends on.
+    uint * vdepsreac_depspec_I_bgn(uint lidx) const;
+    uint * vdepsreac_depspec_I_end(uint lidx) const;
+    uint * vdepsreac_depspec_S_bgn(uint lidx) const;
+    uint * vdepsreac_depspec_S_end(uint lidx) const;
+    uint * vdepsreac_depspec_O_bgn(uint lidx) const;
+    uint * vdepsreac_depspec_O_end(uint lidx) const;
+
     /// Warning: these methods perform no error checking!
     ///
 	// Return the beginning and end of the lhs arrays of surface reaction
@@ -573,15 +645,44 @@ private:
     inline uint _IDX_SReac_O_Spec(uint srlidx, uint splidx)
     { return (countSpecs_O() * srlidx) + splidx; }
 
-    int                               * pSReac_DEP_I_Spec;
-    int                               * pSReac_DEP_S_Spec;
-    int                               * pSReac_DEP_O_Spec;
     uint                              * pSReac_LHS_I_Spec;
     uint                              * pSReac_LHS_S_Spec;
     uint                              * pSReac_LHS_O_Spec;
     int                               * pSReac_UPD_I_Spec;
     int                               * pSReac_UPD_S_Spec;
     int                               * pSReac_UPD_O_Spec;
+    // The species with a nonzero entry in the UPD tables and that entry,
+    // surface reaction by surface reaction; each _Start has pSReacsN + 1
+    // entries.
+    uint                              * pSReac_UPDSpec_I_Start;
+    uint                              * pSReac_UPDSpec_S_Start;
+    uint                              * pSReac_UPDSpec_O_Start;
+    uint                              * pSReac_UPDSpec_I;
+    uint                              * pSReac_UPDSpec_S;
+    uint                              * pSReac_UPDSpec_O;
+    int                               * pSReac_UPDDelta_I;
+    int                               * pSReac_UPDDelta_S;
+    int                               * pSReac_UPDDelta_O;
+    // The lhs entries in the same form, and the dependencies, which are
+    // only kept in this form as surface reactions depend on few species.
+    uint                              * pSReac_LHSSpec_I_Start;
+    uint                              * pSReac_LHSSpec_S_Start;
+    uint                              * pSReac_LHSSpec_O_Start;
+    uint                              * pSReac_LHSSpec_I;
+    uint                              * pSReac_LHSSpec_S;
+    uint                              * pSReac_LHSSpec_O;
+    uint                              * pSReac_LHSOrder_I;
+    uint                              * pSReac_LHSOrder_S;
+    uint                              * pSReac_LHSOrder_O;
+    uint                              * pSReac_DEPSpec_I_Start;
+    uint                              * pSReac_DEPSpec_S_Start;
+    uint                              * pSReac_DEPSpec_O_Start;
+    uint                              * pSReac_DEPSpec_I;
+    uint                              * pSReac_DEPSpec_S;
+    uint                              * pSReac_DEPSpec_O;
+    int                               * pSReac_DEPVal_I;
+    int                               * pSReac_DEPVal_S;
+    int                               * pSReac_DEPVal_O;
 
     ////////////////////////////////////////////////////////////////////////
     // DATA: SURFACE DIFFUSION RULES
@@ -601,7 +702,10 @@ private:
 
     inline uint _IDX_SurfDiff_Spec(uint sdiff, uint spec) const
     { return (pSpecsN_S * sdiff) + spec; }
-	uint                              * pSurfDiff_DEP_Spec;
+	// The dependencies, in the sparse form of the surface reaction tables.
+	uint                              * pSurfDiff_DEPSpec_Start;
+	uint                              * pSurfDiff_DEPSpec;
+	uint                              * pSurfDiff_DEPVal;
 	uint                              * pSurfDiff_LIG;
 
     ////////////////////////////////////////////////////////////////////////
@@ -631,9 +735,17 @@ private:
     inline uint _IDX_VDepSReac_O_Spec(uint vdsrlidx, uint splidx)
     { return (countSpecs_O() * vdsrlidx) + splidx; }
 
-    int                               * pVDepSReac_DEP_I_Spec;
-    int                               * pVDepSReac_DEP_S_Spec;
-    int                               * pVDepSReac_DEP_O_Spec;
+    // The dependencies, in the sparse form of the surface reaction
+    // tables.
+    uint                              * pVDepSReac_DEPSpec_I_Start;
+    uint                              * pVDepSReac_DEPSpec_S_Start;
+    uint                              * pVDepSReac_DEPSpec_O_Start;
+    uint                              * pVDepSReac_DEPSpec_I;
+    uint                              * pVDepSReac_DEPSpec_S;
+    uint                              * pVDepSReac_DEPSpec_O;
+    int                               * pVDepSReac_DEPVal_I;
+    int                               * pVDepSReac_DEPVal_S;
+    int                               * pVDepSReac_DEPVal_O;
     uint                              * pVDepSReac_LHS_I_Spec;
     uint                              * pVDepSReac_LHS_S_Spec;
     uint                              * pVDepSReac_LHS_O_Spec;
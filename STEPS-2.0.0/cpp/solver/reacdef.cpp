@@ -32,6 +32,7 @@
 // STL headers.
 #include <string>
 #include <cassert>
+#include <algorithm>
 
 // STEPS headers.
 #include "../common.h"
@@ -64,6 +65,7 @@ ssolver::Reacdef::Reacdef(Statedef * sd, uint idx, steps::model::Reac * r)
 , pSpec_RHS(0)
 , pSpec_UPD(0)
 , pSpec_UPD_Coll()
+, pSpec_REQ_Coll()
 {
     assert(pStatedef != 0);
     assert(r != 0);
@@ -102,14 +104,14 @@ ssolver::Reacdef::~Reacdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Reacdef::checkpoint(std::fstream & cp_file)
+void ssolver::Reacdef::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pKcst, sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Reacdef::restore(std::fstream & cp_file)
+void ssolver::Reacdef::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pKcst, sizeof(double));
 }
@@ -126,18 +128,25 @@ void ssolver::Reacdef::setup(void)
 	{
 		uint sidx = pStatedef->getSpecIdx(*l);
 		pSpec_LHS[sidx] += 1;
+		pSpec_REQ_Coll.push_back(sidx);
 	}
 	smod::SpecPVecCI r_end = pRhs.end();
 	for (smod::SpecPVecCI r = pRhs.begin(); r != r_end; ++r)
 	{
 		uint sidx = pStatedef->getSpecIdx(*r);
 		pSpec_RHS[sidx] += 1;
+		pSpec_REQ_Coll.push_back(sidx);
 	}
-
-	// Now set up the update vector
-	uint nspecs = pStatedef->countSpecs();
-	for (uint i = 0; i < nspecs; ++i)
+	std::sort(pSpec_REQ_Coll.begin(), pSpec_REQ_Coll.end());
+	pSpec_REQ_Coll.erase(std::unique(pSpec_REQ_Coll.begin(), pSpec_REQ_Coll.end()),
+	                     pSpec_REQ_Coll.end());
+
+	// Now set up the update vector, for the species in the reaction only
+	// (the others keep their zero entries).
+	ssolver::gidxTVecCI req_end = pSpec_REQ_Coll.end();
+	for (ssolver::gidxTVecCI req = pSpec_REQ_Coll.begin(); req != req_end; ++req)
 	{
+	    uint i = *req;
 	    int lhs = static_cast<int>(pSpec_LHS[i]);
 	    int rhs = static_cast<int>(pSpec_RHS[i]);
 	    int aux = pSpec_UPD[i] = (rhs - lhs);
@@ -216,4 +225,15 @@ bool ssolver::Reacdef::reqspec(uint gidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::Reacdef::getMemoryUsage(void) const
+{
+    uint nspecs = pStatedef->countSpecs();
+    std::size_t bytes = sizeof(Reacdef);
+    bytes += nspecs * (2 * sizeof(int) + 2 * sizeof(uint));
+    bytes += pSpec_UPD_Coll.capacity() * sizeof(gidxT);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
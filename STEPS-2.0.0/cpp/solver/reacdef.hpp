@@ -73,10 +73,13 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by this object and its tables.
+    std::size_t getMemoryUsage(void) const;
 
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS: REACTION RULE
@@ -110,6 +113,13 @@ public:
     inline steps::solver::gidxTVecCI endUpdColl(void) const
     { return pSpec_UPD_Coll.end(); }
 
+    /// The global indices of the species the reaction references (those
+    /// for which reqspec is true), in increasing order.
+    inline steps::solver::gidxTVecCI bgnReqColl(void) const
+    { return pSpec_REQ_Coll.begin(); }
+    inline steps::solver::gidxTVecCI endReqColl(void) const
+    { return pSpec_REQ_Coll.end(); }
+
     ////////////////////////////////////////////////////////////////////////
     // SOLVER METHODS: SETUP
     ////////////////////////////////////////////////////////////////////////
@@ -144,6 +154,7 @@ private:
     uint                              * pSpec_RHS;
     int                               * pSpec_UPD;
     steps::solver::gidxTVec             pSpec_UPD_Coll;
+    steps::solver::gidxTVec             pSpec_REQ_Coll;
 
 };
 
@@ -0,0 +1,514 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "../geom/geom.hpp"
+#include "../geom/comp.hpp"
+#include "../geom/patch.hpp"
+#include "../geom/tetmesh.hpp"
+#include "../model/model.hpp"
+#include "../model/spec.hpp"
+#include "../trace.hpp"
+#include "api.hpp"
+#include "hdf5writer.hpp"
+#include "recorder.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::solver, ssolver);
+
+////////////////////////////////////////////////////////////////////////////////
+
+ssolver::Recorder::Recorder(API * sim, double dt)
+: pSim(sim)
+, pDT(dt)
+, pColumns()
+, pStarted(false)
+, pStartTime(0.0)
+, pNSamples(0)
+, pTimes()
+, pData()
+, pFile()
+, pWriter(0)
+, pRow()
+{
+    if (pSim == 0)
+    {
+        std::ostringstream os;
+        os << "Recorder needs a solver.";
+        throw steps::ArgErr(os.str());
+    }
+    if (dt <= 0.0)
+    {
+        std::ostringstream os;
+        os << "Recording interval must be > 0.";
+        throw steps::ArgErr(os.str());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ssolver::Recorder::~Recorder(void)
+{
+    if (pFile.is_open()) pFile.close();
+    delete pWriter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::_checkCanAdd(void) const
+{
+    if (pNSamples != 0 || pWriter != 0)
+    {
+        std::ostringstream os;
+        os << "Cannot add observables to a recorder that has taken samples ";
+        os << "or writes an HDF5 file.";
+        throw steps::ArgErr(os.str());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::_addColumn(Column const & col)
+{
+    _checkCanAdd();
+    // Reading the value once checks the indices and that the species is
+    // defined where it is recorded, and may throw. A flux counter is
+    // checked when it is added to the solver.
+    if (col.type != FLUX) _value(col);
+    pColumns.push_back(col);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addCompCount(std::string const & c, std::string const & s)
+{
+    Column col;
+    col.type = COMP_COUNT;
+    col.elem = pSim->getCompIdx(c);
+    col.spec = pSim->getSpecIdx(s);
+    col.label = "comp:" + c + ":" + s;
+    _addColumn(col);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addPatchCount(std::string const & p, std::string const & s)
+{
+    Column col;
+    col.type = PATCH_COUNT;
+    col.elem = pSim->getPatchIdx(p);
+    col.spec = pSim->getSpecIdx(s);
+    col.label = "patch:" + p + ":" + s;
+    _addColumn(col);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addTetCounts(std::vector<uint> const & tets,
+                                     std::string const & s)
+{
+    Column col;
+    col.type = TET_COUNT;
+    col.spec = pSim->getSpecIdx(s);
+    for (uint i = 0; i < tets.size(); ++i)
+    {
+        col.elem = tets[i];
+        std::ostringstream os;
+        os << "tet:" << tets[i] << ":" << s;
+        col.label = os.str();
+        _addColumn(col);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addTriCounts(std::vector<uint> const & tris,
+                                     std::string const & s)
+{
+    Column col;
+    col.type = TRI_COUNT;
+    col.spec = pSim->getSpecIdx(s);
+    for (uint i = 0; i < tris.size(); ++i)
+    {
+        col.elem = tris[i];
+        std::ostringstream os;
+        os << "tri:" << tris[i] << ":" << s;
+        col.label = os.str();
+        _addColumn(col);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addVertVs(std::vector<uint> const & verts)
+{
+    Column col;
+    col.type = VERT_V;
+    col.spec = 0;
+    for (uint i = 0; i < verts.size(); ++i)
+    {
+        col.elem = verts[i];
+        std::ostringstream os;
+        os << "vert:" << verts[i] << ":V";
+        col.label = os.str();
+        _addColumn(col);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addCompReacExtent(std::string const & c,
+                                          std::string const & r)
+{
+    Column col;
+    col.type = COMP_REAC_EXTENT;
+    col.elem = 0;
+    col.spec = 0;
+    col.loc = c;
+    col.name = r;
+    col.label = "comp:" + c + ":" + r + ":extent";
+    _addColumn(col);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addPatchSReacExtent(std::string const & p,
+                                            std::string const & sr)
+{
+    Column col;
+    col.type = PATCH_SREAC_EXTENT;
+    col.elem = 0;
+    col.spec = 0;
+    col.loc = p;
+    col.name = sr;
+    col.label = "patch:" + p + ":" + sr + ":extent";
+    _addColumn(col);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addTetsReacFlux(std::vector<uint> const & tets,
+                                        std::string const & r)
+{
+    _checkCanAdd();
+    Column col;
+    col.type = FLUX;
+    col.elem = pSim->addTetsReacFlux(tets, r);
+    col.spec = 0;
+    col.label = "tets:" + r + ":flux";
+    _addColumn(col);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addTrisSReacFlux(std::vector<uint> const & tris,
+                                         std::string const & sr)
+{
+    _checkCanAdd();
+    Column col;
+    col.type = FLUX;
+    col.elem = pSim->addTrisSReacFlux(tris, sr);
+    col.spec = 0;
+    col.label = "tris:" + sr + ":flux";
+    _addColumn(col);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addTrisDiffFlux(std::vector<uint> const & tris,
+                                        std::string const & s)
+{
+    _checkCanAdd();
+    Column col;
+    col.type = FLUX;
+    col.elem = pSim->addTrisDiffFlux(tris, s);
+    col.spec = 0;
+    col.label = "tris:" + s + ":diffflux";
+    _addColumn(col);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::addROICount(uint roi, std::string const & s)
+{
+    Column col;
+    col.type = ROI_COUNT;
+    col.elem = roi;
+    col.spec = pSim->getSpecIdx(s);
+    std::ostringstream os;
+    os << "roi:" << roi << ":" << s;
+    col.label = os.str();
+    _addColumn(col);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::setFile(std::string const & file_name)
+{
+    closeFile();
+    if (file_name == "") return;
+
+    pFile.open(file_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!pFile)
+    {
+        std::ostringstream os;
+        os << "Cannot open recording file '" << file_name << "'.";
+        throw steps::ArgErr(os.str());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::setHDF5File(std::string const & file_name,
+                                    uint chunk_rows, uint level)
+{
+#ifdef STEPS_USE_HDF5
+    closeFile();
+
+    std::vector<std::string> labels(pColumns.size());
+    for (uint i = 0; i < pColumns.size(); ++i)
+    {
+        labels[i] = pColumns[i].label;
+    }
+    pWriter = new HDF5Writer(file_name, labels, chunk_rows, level);
+
+    try
+    {
+        _writeMetadata();
+        pWriter->start();
+    }
+    catch (steps::Err &)
+    {
+        delete pWriter;
+        pWriter = 0;
+        throw;
+    }
+#else
+    std::ostringstream os;
+    os << "HDF5 output is not available: STEPS was built without HDF5.";
+    throw steps::NotImplErr(os.str());
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::_writeMetadata(void)
+{
+    std::ostringstream os;
+    os << pDT;
+    pWriter->writeAttribute("solver", pSim->getSolverName());
+    pWriter->writeAttribute("dt", os.str());
+
+    steps::model::Model * model = pSim->model();
+    std::vector<std::string> ids(model->_countSpecs());
+    for (uint i = 0; i < ids.size(); ++i) ids[i] = model->_getSpec(i)->getID();
+    pWriter->writeStrings("model/species", ids);
+
+    steps::wm::Geom * geom = pSim->geom();
+    ids.resize(geom->_countComps());
+    for (uint i = 0; i < ids.size(); ++i) ids[i] = geom->_getComp(i)->getID();
+    pWriter->writeStrings("model/compartments", ids);
+    ids.resize(geom->_countPatches());
+    for (uint i = 0; i < ids.size(); ++i) ids[i] = geom->_getPatch(i)->getID();
+    pWriter->writeStrings("model/patches", ids);
+
+    steps::tetmesh::Tetmesh * mesh = dynamic_cast<steps::tetmesh::Tetmesh *>(geom);
+    if (mesh == 0) return;
+
+    uint nverts = mesh->countVertices();
+    std::vector<double> verts(nverts * 3);
+    for (uint i = 0; i < nverts; ++i)
+    {
+        double * v = mesh->_getVertex(i);
+        std::copy(v, v + 3, verts.begin() + i * 3);
+    }
+    pWriter->writeMatrix("mesh/vertices", nverts ? &verts[0] : 0, nverts, 3);
+
+    uint ntets = mesh->countTets();
+    std::vector<uint> tets(ntets * 4);
+    for (uint i = 0; i < ntets; ++i)
+    {
+        uint * t = mesh->_getTet(i);
+        std::copy(t, t + 4, tets.begin() + i * 4);
+    }
+    pWriter->writeMatrix("mesh/tets", ntets ? &tets[0] : 0, ntets, 4);
+
+    uint ntris = mesh->countTris();
+    std::vector<uint> tris(ntris * 3);
+    for (uint i = 0; i < ntris; ++i)
+    {
+        uint * t = mesh->_getTri(i);
+        std::copy(t, t + 3, tris.begin() + i * 3);
+    }
+    pWriter->writeMatrix("mesh/tris", ntris ? &tris[0] : 0, ntris, 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::closeFile(void)
+{
+    if (pFile.is_open()) pFile.close();
+    if (pWriter == 0) return;
+
+    // The writer is gone even if its last write failed.
+    HDF5Writer * writer = pWriter;
+    pWriter = 0;
+    try
+    {
+        writer->close();
+    }
+    catch (steps::Err &)
+    {
+        delete writer;
+        throw;
+    }
+    delete writer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double ssolver::Recorder::_value(Column const & col) const
+{
+    switch (col.type)
+    {
+        case COMP_COUNT:
+            return pSim->getCompCountIdx(col.elem, col.spec);
+        case PATCH_COUNT:
+            return pSim->getPatchCountIdx(col.elem, col.spec);
+        case TET_COUNT:
+            return pSim->getTetCountIdx(col.elem, col.spec);
+        case TRI_COUNT:
+            return pSim->getTriCountIdx(col.elem, col.spec);
+        case VERT_V:
+            return pSim->getVertV(col.elem);
+        case COMP_REAC_EXTENT:
+            return pSim->getCompReacExtent(col.loc, col.name);
+        case PATCH_SREAC_EXTENT:
+            return pSim->getPatchSReacExtent(col.loc, col.name);
+        case FLUX:
+            return pSim->takeFluxCount(col.elem);
+        case ROI_COUNT:
+            return pSim->getROICountIdx(col.elem, col.spec);
+    }
+    assert(false);
+    return 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::_sample(void)
+{
+    STEPS_TRACE("Recorder::sample");
+    uint ncols = pColumns.size();
+    pRow.resize(ncols + 1);
+    pRow[0] = pSim->getTime();
+    for (uint i = 0; i < ncols; ++i)
+    {
+        pRow[i + 1] = _value(pColumns[i]);
+    }
+
+    if (pWriter != 0)
+    {
+        pWriter->append(pRow[0], &pRow[0] + 1);
+    }
+    else if (pFile.is_open())
+    {
+        pFile.write((char*)&pRow[0], sizeof(double) * (ncols + 1));
+    }
+    else
+    {
+        pTimes.push_back(pRow[0]);
+        pData.insert(pData.end(), pRow.begin() + 1, pRow.end());
+    }
+    ++pNSamples;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::run(double endtime)
+{
+    STEPS_TRACE("Recorder::run");
+    if (endtime < pSim->getTime())
+    {
+        std::ostringstream os;
+        os << "Recorder end time is before the current time.";
+        throw steps::ArgErr(os.str());
+    }
+
+    if (pStarted == false)
+    {
+        pStarted = true;
+        pStartTime = pSim->getTime();
+        pNSamples = 0;
+    }
+
+    // The sample times are computed from the start time rather than
+    // accumulated, so that they do not drift over long runs. A sample
+    // that falls within rounding error of endtime is taken.
+    double tol = 1.0e-9 * pDT;
+    uint nnew = 0;
+    double last = pStartTime + pNSamples * pDT;
+    if (last <= endtime + tol)
+    {
+        nnew = static_cast<uint>(std::floor((endtime + tol - last) / pDT)) + 1;
+    }
+    if (pFile.is_open() == false && pWriter == 0)
+    {
+        pTimes.reserve(pTimes.size() + nnew);
+        pData.reserve(pData.size() + nnew * pColumns.size());
+    }
+
+    for (uint i = 0; i < nnew; ++i)
+    {
+        double t = pStartTime + pNSamples * pDT;
+        if (t > pSim->getTime()) pSim->run(t);
+        _sample();
+    }
+    if (endtime > pSim->getTime()) pSim->run(endtime);
+
+    if (pFile.is_open()) pFile.flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::Recorder::clear(void)
+{
+    pTimes.clear();
+    pData.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
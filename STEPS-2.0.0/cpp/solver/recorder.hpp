@@ -0,0 +1,266 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_RECORDER_HPP
+#define STEPS_SOLVER_RECORDER_HPP 1
+
+// STL headers.
+#include <fstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "api.hpp"
+#include "hdf5writer.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Samples a set of observables of a solver at a fixed interval while it
+/// runs, without returning to Python between samples.
+///
+/// Each observable adds one or more columns; a sample is one row of
+/// values, taken at the start time and then every dt. Rows are kept in
+/// memory, or streamed to a binary or HDF5 file as they are taken.
+///
+class Recorder
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Constructor.
+    ///
+    /// \param sim The solver to sample; it must outlive the recorder.
+    /// \param dt The sampling interval (seconds).
+    ///
+    Recorder(API * sim, double dt);
+
+    ~Recorder(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBSERVABLES
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Record the number of molecules of species s in compartment c.
+    ///
+    void addCompCount(std::string const & c, std::string const & s);
+
+    /// Record the number of molecules of species s in patch p.
+    ///
+    void addPatchCount(std::string const & p, std::string const & s);
+
+    /// Record the number of molecules of species s in each tetrahedron
+    /// of tets, one column per tetrahedron.
+    ///
+    void addTetCounts(std::vector<uint> const & tets, std::string const & s);
+
+    /// Record the number of molecules of species s in each triangle of
+    /// tris, one column per triangle.
+    ///
+    void addTriCounts(std::vector<uint> const & tris, std::string const & s);
+
+    /// Record the potential of each vertex of verts, one column per
+    /// vertex.
+    ///
+    void addVertVs(std::vector<uint> const & verts);
+
+    /// Record the extent of reaction r in compartment c.
+    ///
+    void addCompReacExtent(std::string const & c, std::string const & r);
+
+    /// Record the extent of surface reaction sr in patch p.
+    ///
+    void addPatchSReacExtent(std::string const & p, std::string const & sr);
+
+    /// Record the events of reaction r in the tetrahedrons tets during
+    /// each sampling interval: the value of a sample is the number since
+    /// the sample before (see API::addTetsReacFlux).
+    ///
+    void addTetsReacFlux(std::vector<uint> const & tets, std::string const & r);
+
+    /// Record the events of surface reaction sr in the triangles tris
+    /// during each sampling interval.
+    ///
+    void addTrisSReacFlux(std::vector<uint> const & tris, std::string const & sr);
+
+    /// Record the net number of molecules of species s that diffuse
+    /// across the triangles tris during each sampling interval, from the
+    /// first tetrahedron of each triangle into the second.
+    ///
+    void addTrisDiffFlux(std::vector<uint> const & tris, std::string const & s);
+
+    /// Record the number of molecules of species s in region of interest
+    /// roi (see API::addROI).
+    ///
+    void addROICount(uint roi, std::string const & s);
+
+    uint getNColumns(void) const
+    { return pColumns.size(); }
+
+    ////////////////////////////////////////////////////////////////////////
+    // OUTPUT
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Stream the samples to a file instead of keeping them: each sample
+    /// is written as getNColumns() + 1 native doubles, the time followed
+    /// by the columns. An empty file name goes back to keeping the
+    /// samples in memory.
+    ///
+    void setFile(std::string const & file_name);
+
+    /// Stream the samples to an HDF5 file instead of keeping them. The
+    /// file holds /time, /data (samples x columns), a label per column
+    /// in /columns, the species, compartment and patch names under
+    /// /model and, for a tetrahedral mesh, its vertices, tetrahedrons
+    /// and triangles under /mesh.
+    ///
+    /// The samples are written chunk_rows at a time, compressed at
+    /// deflate level (0 to 9), by a background thread. Observables can
+    /// no longer be added. Needs STEPS to be built with HDF5.
+    ///
+    void setHDF5File(std::string const & file_name, uint chunk_rows = 1024,
+                     uint level = 4);
+
+    /// Close the binary or HDF5 file, writing out any buffered samples,
+    /// and go back to keeping the samples in memory.
+    ///
+    void closeFile(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SIMULATION CONTROLS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Run the solver to endtime, taking the samples that fall in the
+    /// interval. The first call also samples the current state.
+    ///
+    void run(double endtime);
+
+    ////////////////////////////////////////////////////////////////////////
+    // DATA ACCESS
+    ////////////////////////////////////////////////////////////////////////
+
+    uint getNSamples(void) const
+    { return pNSamples; }
+
+    /// The time of each sample kept in memory.
+    ///
+    std::vector<double> getTimes(void) const
+    { return pTimes; }
+
+    /// The samples kept in memory, in sample, column order: element
+    /// [i * getNColumns() + j] is column j of sample i.
+    ///
+    std::vector<double> getData(void) const
+    { return pData; }
+
+    /// Drop the samples kept in memory. The sampling times carry on.
+    ///
+    void clear(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    enum ColumnType
+    {
+        COMP_COUNT,
+        PATCH_COUNT,
+        TET_COUNT,
+        TRI_COUNT,
+        VERT_V,
+        COMP_REAC_EXTENT,
+        PATCH_SREAC_EXTENT,
+        FLUX,
+        ROI_COUNT
+    };
+
+    /// One recorded value: the element (or compartment, patch, region of
+    /// interest or the solver's flux counter) and the species index, or for the extents
+    /// the names.
+    ///
+    struct Column
+    {
+        ColumnType                      type;
+        uint                            elem;
+        uint                            spec;
+        std::string                     loc;
+        std::string                     name;
+        std::string                     label;
+    };
+
+    // Throw if observables can no longer be added.
+    void _checkCanAdd(void) const;
+
+    void _addColumn(Column const & col);
+
+    double _value(Column const & col) const;
+
+    void _sample(void);
+
+    void _writeMetadata(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    API                               * pSim;
+    double                              pDT;
+
+    std::vector<Column>                 pColumns;
+
+    /// Time of the first sample and the number of samples taken, which
+    /// give the time of the next one.
+    bool                                pStarted;
+    double                              pStartTime;
+    uint                                pNSamples;
+
+    std::vector<double>                 pTimes;
+    std::vector<double>                 pData;
+
+    std::ofstream                       pFile;
+    HDF5Writer                        * pWriter;
+    std::vector<double>                 pRow;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SOLVER_RECORDER_HPP
+
+// END
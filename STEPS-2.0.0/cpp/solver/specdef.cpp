@@ -67,14 +67,14 @@ ssolver::Specdef::~Specdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Specdef::checkpoint(std::fstream & cp_file)
+void ssolver::Specdef::checkpoint(std::iostream & cp_file)
 {
     // reserve
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Specdef::restore(std::fstream & cp_file)
+void ssolver::Specdef::restore(std::iostream & cp_file)
 {
     // reserve
 }
@@ -95,6 +95,13 @@ void ssolver::Specdef::setup(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::Specdef::getMemoryUsage(void) const
+{
+    return sizeof(Specdef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 
 // END
 
@@ -32,6 +32,7 @@
 #include <string>
 #include <cassert>
 #include <sstream>
+#include <algorithm>
 
 // STEPS headers.
 #include "../common.h"
@@ -77,6 +78,9 @@ ssolver::SReacdef::SReacdef(Statedef * sd, uint idx, steps::model::SReac * sr)
 , pSpec_I_UPD_Coll()
 , pSpec_S_UPD_Coll()
 , pSpec_O_UPD_Coll()
+, pSpec_I_REQ_Coll()
+, pSpec_S_REQ_Coll()
+, pSpec_O_REQ_Coll()
 {
 
 	assert (pStatedef != 0);
@@ -170,14 +174,14 @@ ssolver::SReacdef::~SReacdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::SReacdef::checkpoint(std::fstream & cp_file)
+void ssolver::SReacdef::checkpoint(std::iostream & cp_file)
 {
     // reserve
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::SReacdef::restore(std::fstream & cp_file)
+void ssolver::SReacdef::restore(std::iostream & cp_file)
 {
     // reserve
 }
@@ -205,6 +209,15 @@ double ssolver::SReacdef::kcst(void) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Sort a list of global indices and drop the repeats.
+static void sort_unique(ssolver::gidxTVec & gidxs)
+{
+	std::sort(gidxs.begin(), gidxs.end());
+	gidxs.erase(std::unique(gidxs.begin(), gidxs.end()), gidxs.end());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void ssolver::SReacdef::setup(void)
 {
 	assert(pSetupdone == false);
@@ -220,6 +233,7 @@ void ssolver::SReacdef::setup(void)
 		pSurface_surface = false;
 		uint sidx = pStatedef->getSpecIdx(*ol);
 		pSpec_O_LHS[sidx] += 1;
+		pSpec_O_REQ_Coll.push_back(sidx);
 	}
 
 	smod::SpecPVecCI il_end = pIlhs.end();
@@ -228,6 +242,7 @@ void ssolver::SReacdef::setup(void)
 		pSurface_surface = false;
 		uint sidx = pStatedef->getSpecIdx(*il);
 		pSpec_I_LHS[sidx] += 1;
+		pSpec_I_REQ_Coll.push_back(sidx);
 	}
 
 	smod::SpecPVecCI sl_end = pSlhs.end();
@@ -235,6 +250,7 @@ void ssolver::SReacdef::setup(void)
 	{
 		uint sidx = pStatedef->getSpecIdx(*sl);
 		pSpec_S_LHS[sidx] += 1;
+		pSpec_S_REQ_Coll.push_back(sidx);
 	}
 
 	smod::SpecPVecCI ir_end = pIrhs.end();
@@ -242,6 +258,7 @@ void ssolver::SReacdef::setup(void)
 	{
 		uint sidx = pStatedef->getSpecIdx(*ir);
 		pSpec_I_RHS[sidx] += 1;
+		pSpec_I_REQ_Coll.push_back(sidx);
 	}
 
 	smod::SpecPVecCI sr_end = pSrhs.end();
@@ -249,6 +266,7 @@ void ssolver::SReacdef::setup(void)
 	{
 		uint sidx = pStatedef->getSpecIdx(*sr);
 		pSpec_S_RHS[sidx] += 1;
+		pSpec_S_REQ_Coll.push_back(sidx);
 	}
 
 	smod::SpecPVecCI orh_end = pOrhs.end();
@@ -256,13 +274,20 @@ void ssolver::SReacdef::setup(void)
 	{
 		uint sidx = pStatedef->getSpecIdx(*orh);
 		pSpec_O_RHS[sidx] += 1;
+		pSpec_O_REQ_Coll.push_back(sidx);
 	}
 
-	// Now set up the update vector
-	uint nspecs = pStatedef->countSpecs();
+	sort_unique(pSpec_I_REQ_Coll);
+	sort_unique(pSpec_S_REQ_Coll);
+	sort_unique(pSpec_O_REQ_Coll);
+
+	// Now set up the update vector, for the species in the reaction only
+	// (the others keep their zero entries).
 	// Deal with surface.
-	for (uint i = 0; i < nspecs; ++i)
+	ssolver::gidxTVecCI surf_end = pSpec_S_REQ_Coll.end();
+	for (ssolver::gidxTVecCI surf = pSpec_S_REQ_Coll.begin(); surf != surf_end; ++surf)
 	{
+	    uint i = *surf;
         int lhs = static_cast<int>(pSpec_S_LHS[i]);
         int rhs = static_cast<int>(pSpec_S_RHS[i]);
         int aux = pSpec_S_UPD[i] = (rhs - lhs);
@@ -271,8 +296,10 @@ void ssolver::SReacdef::setup(void)
     }
 
     // Deal with inside.
-    for (uint i = 0; i < nspecs; ++i)
+    ssolver::gidxTVecCI in_end = pSpec_I_REQ_Coll.end();
+    for (ssolver::gidxTVecCI in = pSpec_I_REQ_Coll.begin(); in != in_end; ++in)
     {
+        uint i = *in;
         int lhs = (inside() ? static_cast<int>(pSpec_I_LHS[i]) : 0);
         int rhs = static_cast<int>(pSpec_I_RHS[i]);
         int aux = pSpec_I_UPD[i] = (rhs - lhs);
@@ -281,8 +308,10 @@ void ssolver::SReacdef::setup(void)
     }
 
     // Deal with outside.
-    for (uint i = 0; i < nspecs; ++i)
+    ssolver::gidxTVecCI out_end = pSpec_O_REQ_Coll.end();
+    for (ssolver::gidxTVecCI out = pSpec_O_REQ_Coll.begin(); out != out_end; ++out)
     {
+        uint i = *out;
         int lhs = (outside() ? static_cast<int>(pSpec_O_LHS[i]) : 0);
         int rhs = static_cast<int>(pSpec_O_RHS[i]);
         int aux = pSpec_O_UPD[i] = (rhs - lhs);
@@ -298,12 +327,7 @@ void ssolver::SReacdef::setup(void)
 bool ssolver::SReacdef::reqInside(void) const
 {
 	assert (pSetupdone == true);
-
-    // This can be checked by seeing if DEP_I or RHS_I is non-zero
-    // for any species.
-    uint nspecs = pStatedef->countSpecs();
-    for (uint i = 0; i < nspecs; ++i) if (reqspec_I(i) == true) return true;
-    return false;
+	return (pSpec_I_REQ_Coll.empty() == false);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -311,13 +335,7 @@ bool ssolver::SReacdef::reqInside(void) const
 bool ssolver::SReacdef::reqOutside(void) const
 {
 	assert (pSetupdone == true);
-
-    // This can be checked by seeing if DEP_O or RHS_O is non-zero
-    // for any species.
-    uint nspecs = pStatedef->countSpecs();
-    for (uint i = 0; i < nspecs; ++i)
-        if (reqspec_O(i) == true) return true;
-    return false;
+	return (pSpec_O_REQ_Coll.empty() == false);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -463,4 +481,19 @@ bool ssolver::SReacdef::reqspec_O(uint gidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::SReacdef::getMemoryUsage(void) const
+{
+    uint nspecs = pStatedef->countSpecs();
+    std::size_t bytes = sizeof(SReacdef);
+    // Only the DEP and LHS tables of the side the reaction is oriented
+    // to are allocated, next to those of the patch.
+    bytes += nspecs * (2 * sizeof(depT) + 2 * sizeof(uint));
+    bytes += nspecs * (3 * sizeof(uint) + 3 * sizeof(int));
+    bytes += (pSpec_I_UPD_Coll.capacity() + pSpec_S_UPD_Coll.capacity()
+              + pSpec_O_UPD_Coll.capacity()) * sizeof(gidxT);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
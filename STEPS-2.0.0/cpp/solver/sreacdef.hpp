@@ -81,10 +81,13 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by this object and its tables.
+    std::size_t getMemoryUsage(void) const;
 
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS: SURFACE REACTION RULE
@@ -225,6 +228,22 @@ public:
     inline gidxTVecCI endUpdColl_O(void) const
     { return pSpec_O_UPD_Coll.end(); }
 
+    /// The global indices of the species the surface reaction rule
+    /// references on each side (those for which reqspec_I, reqspec_S or
+    /// reqspec_O is true), in increasing order.
+    inline gidxTVecCI beginReqColl_I(void) const
+    { return pSpec_I_REQ_Coll.begin(); }
+    inline gidxTVecCI endReqColl_I(void) const
+    { return pSpec_I_REQ_Coll.end(); }
+    inline gidxTVecCI beginReqColl_S(void) const
+    { return pSpec_S_REQ_Coll.begin(); }
+    inline gidxTVecCI endReqColl_S(void) const
+    { return pSpec_S_REQ_Coll.end(); }
+    inline gidxTVecCI beginReqColl_O(void) const
+    { return pSpec_O_REQ_Coll.begin(); }
+    inline gidxTVecCI endReqColl_O(void) const
+    { return pSpec_O_REQ_Coll.end(); }
+
     ////////////////////////////////////////////////////////////////////////
 
 private:
@@ -308,6 +327,12 @@ private:
     gidxTVec                            pSpec_S_UPD_Coll;
     gidxTVec                            pSpec_O_UPD_Coll;
 
+    /// The global indices of all species the surface reaction rule
+    /// references on each side.
+    gidxTVec                            pSpec_I_REQ_Coll;
+    gidxTVec                            pSpec_S_REQ_Coll;
+    gidxTVec                            pSpec_O_REQ_Coll;
+
     ////////////////////////////////////////////////////////////////////////
 };
 
@@ -0,0 +1,682 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// STEPS headers.
+#include "../../common.h"
+#include "../../error.hpp"
+#include "crsched.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::CRScheduler::CRScheduler(steps::rng::RNG * r)
+: Scheduler(r)
+, pEntries()
+, pA0(0.0)
+, pA0Comp(0.0)
+, pA0Updates(0)
+, pA0ResyncInterval(1000)
+, pNRecorded(0)
+, pBatchSize(0)
+, pGroupTree()
+, pGroupTreeSearch(true)
+, pNSelections(0.0)
+, pNTrials(0.0)
+, pNGroupExtends(0)
+, nGroups()
+, pGroups()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::CRScheduler::~CRScheduler(void)
+{
+    _clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string sssa::CRScheduler::getName(void) const
+{
+    return "cr";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::_clear(void)
+{
+    uint ngroups = nGroups.size();
+    for (uint i = 0; i < ngroups; i++) {
+        free(nGroups[i]->indices);
+        free(nGroups[i]->rates);
+        delete nGroups[i];
+    }
+    nGroups.clear();
+
+    ngroups = pGroups.size();
+    for (uint i = 0; i < ngroups; i++) {
+        free(pGroups[i]->indices);
+        free(pGroups[i]->rates);
+        delete pGroups[i];
+    }
+    pGroups.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::init(uint n)
+{
+    if (n == pEntries.size())
+    {
+        // Re-initialising the same set of entries (e.g. on reset): keep
+        // the group buffers, which have already grown to fit, and only
+        // empty them.
+        uint ngroups = nGroups.size();
+        for (uint i = 0; i < ngroups; i++) {
+            nGroups[i]->size = 0;
+            nGroups[i]->sum = 0.0;
+        }
+        ngroups = pGroups.size();
+        for (uint i = 0; i < ngroups; i++) {
+            pGroups[i]->size = 0;
+            pGroups[i]->sum = 0.0;
+        }
+        std::fill(pEntries.begin(), pEntries.end(), CREntryData());
+    }
+    else
+    {
+        _clear();
+        pEntries.assign(n, CREntryData());
+    }
+
+    pA0 = 0.0;
+    pA0Comp = 0.0;
+    pA0Updates = 0;
+    pNRecorded = 0;
+    pBatchSize = 0;
+    pGroupTree.clear();
+    resetStats();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::resetStats(void)
+{
+    pNSelections = 0.0;
+    pNTrials = 0.0;
+    pNGroupExtends = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::getGroupData(std::vector<int> & pows,
+                                     std::vector<uint> & sizes,
+                                     std::vector<double> & sums) const
+{
+    pows.clear();
+    sizes.clear();
+    sums.clear();
+
+    // nGroups[0] and pGroups[0] both hold power 0; only the latter
+    // is ever filled.
+    for (uint i = nGroups.size(); i > 1; i--) {
+        CRGroup * group = nGroups[i - 1];
+        pows.push_back(-static_cast<int>(i - 1));
+        sizes.push_back(group->size);
+        sums.push_back(group->sum);
+    }
+    uint n_pos_groups = pGroups.size();
+    for (uint i = 0; i < n_pos_groups; i++) {
+        pows.push_back(i);
+        sizes.push_back(pGroups[i]->size);
+        sums.push_back(pGroups[i]->sum);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::setA0ResyncInterval(uint n)
+{
+    if (n == 0)
+    {
+        std::ostringstream os;
+        os << "A0 resync interval must be at least 1.";
+        throw steps::ArgErr(os.str());
+    }
+    pA0ResyncInterval = n;
+    _updateSum();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::commit(double t)
+{
+    // A0 has been kept up to date by update(); only walk the groups once
+    // every pA0ResyncInterval batches to remove any drift, after a full
+    // refresh, or when rounding may have left a meaningless total.
+    pA0Updates++;
+    if (pA0Updates >= pA0ResyncInterval || pBatchSize >= pEntries.size()
+        || pNRecorded == 0 || pA0 <= 0.0)
+    {
+        _updateSum();
+    }
+    pBatchSize = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::_updateSum(void)
+{
+    #ifdef SSA_DEBUG
+    std::cout << "update A0 from " << pA0 << " to ";
+    #endif
+
+    pA0 = 0.0;
+    pA0Comp = 0.0;
+    pA0Updates = 0;
+
+    uint n_neg_groups = nGroups.size();
+    uint n_pos_groups = pGroups.size();
+
+    for (uint i = 0; i < n_neg_groups; i++) {
+        pA0 += nGroups[i]->sum;
+    }
+
+    for (uint i = 0; i < n_pos_groups; i++) {
+        pA0 += pGroups[i]->sum;
+    }
+
+    #ifdef SSA_DEBUG
+    std::cout << pA0 << "\n";
+    #endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sssa::CRScheduler::getNext(double t, double & dt)
+{
+#ifdef SSA_DEBUG
+    std::cout << "SSA: Search for next event\n";
+#endif
+    assert(pA0 >= 0.0);
+    // Quick check to see whether nothing is there.
+    if (pA0 == 0.0) return SCHED_IDX_UNDEFINED;
+
+    double selector = pA0 * rng()->getUnfII();
+
+#ifdef SSA_DEBUG
+    std::cout << "selector: " << selector << " in total " << pA0 << "\n";
+#endif
+
+    uint idx = _selectInGroup(_getGroupOf(selector));
+    dt = rng()->getExp(pA0);
+    return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::CRGroup * sssa::CRScheduler::_getGroupOf(double selector) const
+{
+    if (pGroupTreeSearch) {
+        int pow = pGroupTree.search(selector);
+        CRGroup* group = NULL;
+        if (pow >= 0) {
+            if (static_cast<uint>(pow) < pGroups.size()) group = pGroups[pow];
+        }
+        else if (static_cast<uint>(-pow) < nGroups.size()) {
+            group = nGroups[-pow];
+        }
+        if (group != NULL && group->size != 0) return group;
+        // Rounding in the tree left the selector outside any non-empty
+        // group: fall back to the linear scan.
+    }
+
+    double partial_sum = 0.0;
+
+    uint n_neg_groups = nGroups.size();
+    uint n_pos_groups = pGroups.size();
+
+    // Last non-empty group visited. A0 is maintained incrementally, so it
+    // can differ from the sum of the group sums by rounding; a selector
+    // that falls past the final partial sum belongs to this group.
+    CRGroup* last_group = NULL;
+
+    for (uint i = 0; i < n_neg_groups; i++) {
+        CRGroup* group = nGroups[i];
+        if (group->size == 0) continue;
+        last_group = group;
+
+        if (selector > partial_sum + group->sum) {
+            partial_sum += group->sum;
+#ifdef SSA_DEBUG
+            std::cout << "increase partial sum to " << partial_sum;
+            std::cout << " by neg group " << i << "\n";
+#endif
+            continue;
+        }
+
+        return group;
+    }
+
+    for (uint i = 0; i < n_pos_groups; i++) {
+        CRGroup* group = pGroups[i];
+        if (group->size == 0) continue;
+        last_group = group;
+
+        if (selector > partial_sum + group->sum) {
+            partial_sum += group->sum;
+#ifdef SSA_DEBUG
+            std::cout << "increase partial sum to " << partial_sum;
+            std::cout << " by pos group " << i << "\n";
+#endif
+            continue;
+        }
+
+        return group;
+    }
+
+    if (last_group != NULL) return last_group;
+
+    std::cerr << "Cannot find any suitable entry.\n";
+    std::cerr << "A0: " << std::setprecision (15) << pA0 << "\n";
+    std::cerr << "Selector: " << std::setprecision (15) << selector << "\n";
+    std::cerr << "Current Partial Sum: " << std::setprecision (15) << partial_sum << "\n";
+
+    std::cerr << "Distribution of group sums\n";
+    std::cerr << "Negative groups\n";
+
+    for (uint i = 0; i < n_neg_groups; i++) {
+        std::cerr << i << ": " << std::setprecision (15) << nGroups[i]->sum << "\n";
+    }
+    std::cerr << "Positive groups\n";
+    for (uint i = 0; i < n_pos_groups; i++) {
+        std::cerr << i << ": " << std::setprecision (15) << pGroups[i]->sum << "\n";
+    }
+
+    throw;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sssa::CRScheduler::_selectInGroup(CRGroup * group)
+{
+    assert(group->size != 0);
+
+    double g_max = group->max;
+    double * rates = group->rates;
+    double random_rate = g_max * rng()->getUnfII();
+    uint group_size = group->size;
+    uint random_pos = rng()->get() % group_size;
+    pNSelections += 1.0;
+    pNTrials += 1.0;
+
+#ifdef SSA_DEBUG
+    std::cout << "search for event\n";
+    std::cout << "group max: " << g_max << "\n";
+    std::cout << "random rate: " << random_rate << "\n";
+    std::cout << "random pos " << random_pos << "\n";
+    std::cout << "random entry rate " << rates[random_pos] << "\n";
+#endif
+
+    // Rejection only touches the group's contiguous rate array.
+    while (rates[random_pos] <= random_rate) {
+        random_rate = g_max * rng()->getUnfII();
+        random_pos = rng()->get() % group_size;
+        pNTrials += 1.0;
+#ifdef SSA_DEBUG
+        std::cout << "renew search\n";
+        std::cout << "random rate: " << random_rate << "\n";
+        std::cout << "random pos " << random_pos << "\n";
+        std::cout << "random entry rate " << rates[random_pos] << "\n";
+#endif
+    }
+
+    uint idx = group->indices[random_pos];
+
+#ifdef SSA_DEBUG
+    std::cout << "selected entry index: " << idx << "\n";
+    std::cout << "--------------------------------------------------------\n";
+#endif
+    return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::_extendPGroups(uint new_size)
+{
+    uint curr_size = pGroups.size();
+
+    #ifdef SSA_DEBUG
+    std::cout << "SSA: extending positive group size to " << new_size;
+    std::cout << " from " << curr_size << ".\n";
+    std::cout << "--------------------------------------------------------\n";
+    #endif
+
+    while (curr_size < new_size) {
+        pGroups.push_back(new CRGroup(curr_size));
+        curr_size ++;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::_extendNGroups(uint new_size)
+{
+    uint curr_size = nGroups.size();
+
+    #ifdef SSA_DEBUG
+    std::cout << "SSA: extending negative group size to " << new_size;
+    std::cout << " from " << curr_size << ".\n";
+    std::cout << "--------------------------------------------------------\n";
+    #endif
+
+    while (curr_size < new_size) {
+        nGroups.push_back(new CRGroup(-curr_size));
+        curr_size ++;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::_extendGroup(CRGroup * group, uint size)
+{
+    #ifdef SSA_DEBUG
+    std::cout << "SSA: extending group storage\n";
+    std::cout << "current capacity: " << group->capacity << "\n";
+    #endif
+
+    pNGroupExtends++;
+    group->capacity += size;
+    group->indices = (uint*)realloc(group->indices,
+                                    sizeof(uint) * group->capacity);
+    group->rates = (double*)realloc(group->rates,
+                                    sizeof(double) * group->capacity);
+    if (group->indices == NULL || group->rates == NULL) {
+        std::cerr << "DirectCR: unable to allocate memory for SSA group.\n";
+        throw;
+    }
+    #ifdef SSA_DEBUG
+    std::cout << "capacity after extending: " << group->capacity << "\n";
+    std::cout << "--------------------------------------------------------\n";
+    #endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::update(uint idx, double new_rate, double t)
+{
+    #ifdef SSA_DEBUG
+    std::cout << "SSA: Update entry " << idx << "\n";
+    std::cout << "new rate: " << new_rate << "\n";
+    #endif
+
+    assert(idx < pEntries.size());
+    pBatchSize++;
+
+    CREntryData & data = pEntries[idx];
+    double old_rate = data.rate;
+    bool old_recorded = data.recorded;
+    int prev_pow = data.pow;
+
+    data.rate = new_rate;
+
+    #ifdef SSA_DEBUG
+    std::cout << "data recorded: " << (data.recorded ? "Yes" : "No") << "\n";
+    std::cout << "pow: " << data.pow << "\n";
+    std::cout << "pos: " << data.pos << "\n";
+    std::cout << "rate: " << data.rate << "\n";
+    #endif
+
+    if (old_rate == new_rate)  return;
+
+    // Rates below 1e-20 are not recorded in any group.
+    if (new_rate > 1e-20) {
+        int old_pow = data.pow;
+        int new_pow;
+        frexp(new_rate, &new_pow);
+
+        #ifdef SSA_DEBUG
+        std::cout << "power changes from " << old_pow << " to " << new_pow << "\n";
+        #endif
+
+        if (old_pow == new_pow && data.recorded) {
+            // pow is the same
+            CRGroup* old_group = _getGroup(old_pow);
+            old_group->sum += (new_rate - old_rate);
+            old_group->rates[data.pos] = new_rate;
+        }
+        // pow is not the same
+        else {
+            data.pow = new_pow;
+
+            if (data.recorded) {
+                #ifdef SSA_DEBUG
+                std::cout << "remove data from group with power " << old_pow << "\n";
+                #endif
+
+                // remove old
+                CRGroup* old_group = _getGroup(old_pow);
+                (old_group->size) --;
+
+                if (old_group->size == 0) old_group->sum = 0.0;
+                else {
+                    old_group->sum -= old_rate;
+
+                    uint last = old_group->indices[old_group->size];
+                    old_group->indices[data.pos] = last;
+                    old_group->rates[data.pos] = old_group->rates[old_group->size];
+                    pEntries[last].pos = data.pos;
+                }
+            }
+
+            // add new
+            #ifdef SSA_DEBUG
+            std::cout << "add data to group with power " << new_pow << "\n";
+            #endif
+
+            CRGroup* new_group = NULL;
+            if (new_pow >= 0) {
+                if (pGroups.size() <= static_cast<uint>(new_pow)) _extendPGroups(new_pow + 1);
+                new_group = pGroups[new_pow];
+            }
+            else {
+                if (nGroups.size() <= static_cast<uint>(-new_pow)) _extendNGroups(-new_pow + 1);
+                new_group = nGroups[-new_pow];
+            }
+
+            assert(new_group != NULL);
+            if (new_group->size == new_group->capacity) _extendGroup(new_group);
+            uint pos = new_group->size;
+            new_group->indices[pos] = idx;
+            new_group->rates[pos] = new_rate;
+            new_group->size++;
+            new_group->sum += new_rate;
+            data.pos = pos;
+        }
+        data.recorded = true;
+    }
+
+    else {
+
+        if (data.recorded) {
+            #ifdef SSA_DEBUG
+            std::cout << "remove data from group with power " << data.pow << "\n";
+            #endif
+            CRGroup* old_group = _getGroup(data.pow);
+
+            // remove old
+            old_group->size --;
+
+            if (old_group->size == 0) old_group->sum = 0.0;
+            else {
+                old_group->sum -= old_rate;
+
+                uint last = old_group->indices[old_group->size];
+                old_group->indices[data.pos] = last;
+                old_group->rates[data.pos] = old_group->rates[old_group->size];
+                pEntries[last].pos = data.pos;
+            }
+        }
+        data.recorded = false;
+    }
+
+    // Keep the running A0 in step with the group sums.
+    double new_contrib = (data.recorded ? new_rate : 0.0);
+    double old_contrib = (old_recorded ? old_rate : 0.0);
+    _incA0(new_contrib - old_contrib);
+
+    if (data.recorded && !old_recorded) pNRecorded++;
+    else if (!data.recorded && old_recorded) pNRecorded--;
+
+    if (old_recorded) pGroupTree.set(prev_pow, _getGroup(prev_pow)->sum);
+    if (data.recorded) pGroupTree.set(data.pow, _getGroup(data.pow)->sum);
+
+    #ifdef SSA_DEBUG
+    std::cout << "--------------------------------------------------------\n";
+    #endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t sssa::CRScheduler::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(CRScheduler);
+    bytes += pEntries.capacity() * sizeof(CREntryData);
+    bytes += (pGroupTree.leaves.capacity() + pGroupTree.nodes.capacity()) * sizeof(double);
+
+    bytes += (nGroups.capacity() + pGroups.capacity()) * sizeof(CRGroup *);
+    uint n_neg_groups = nGroups.size();
+    for (uint i = 0; i < n_neg_groups; i++) {
+        bytes += sizeof(CRGroup) + nGroups[i]->capacity * (sizeof(uint) + sizeof(double));
+    }
+    uint n_pos_groups = pGroups.size();
+    for (uint i = 0; i < n_pos_groups; i++) {
+        bytes += sizeof(CRGroup) + pGroups[i]->capacity * (sizeof(uint) + sizeof(double));
+    }
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::CRScheduler::checkpoint(std::ostream & cp_file) const
+{
+    // The entries in the order of their groups, which rejection sampling
+    // depends on, and the running sums; the entry data follows from the
+    // groups.
+    uint n = pEntries.size();
+    cp_file.write((char*)&n, sizeof(uint));
+    std::vector<double> rates(n);
+    for (uint i = 0; i < n; i++) rates[i] = pEntries[i].rate;
+    _writeArray(cp_file, rates);
+
+    uint n_neg_groups = nGroups.size();
+    uint n_pos_groups = pGroups.size();
+    cp_file.write((char*)&n_neg_groups, sizeof(uint));
+    cp_file.write((char*)&n_pos_groups, sizeof(uint));
+    for (uint i = 0; i < n_neg_groups + n_pos_groups; i++) {
+        CRGroup * group = (i < n_neg_groups ? nGroups[i] : pGroups[i - n_neg_groups]);
+        cp_file.write((char*)&group->size, sizeof(unsigned));
+        cp_file.write((char*)&group->sum, sizeof(double));
+        if (group->size == 0) continue;
+        cp_file.write((char*)group->indices, sizeof(uint) * group->size);
+        cp_file.write((char*)group->rates, sizeof(double) * group->size);
+    }
+
+    cp_file.write((char*)&pA0, sizeof(double));
+    cp_file.write((char*)&pA0Comp, sizeof(double));
+    cp_file.write((char*)&pA0Updates, sizeof(uint));
+    cp_file.write((char*)&pNRecorded, sizeof(uint));
+    cp_file.write((char*)&pGroupTree.nsets, sizeof(uint));
+    _writeArray(cp_file, pGroupTree.leaves);
+    _writeArray(cp_file, pGroupTree.nodes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sssa::CRScheduler::restore(std::istream & cp_file)
+{
+    uint n = 0;
+    cp_file.read((char*)&n, sizeof(uint));
+    if (!cp_file || n != pEntries.size()) return false;
+    std::vector<double> rates(n);
+    _readArray(cp_file, rates);
+    std::fill(pEntries.begin(), pEntries.end(), CREntryData());
+    for (uint i = 0; i < n; i++) pEntries[i].rate = rates[i];
+
+    uint n_neg_groups = 0;
+    uint n_pos_groups = 0;
+    cp_file.read((char*)&n_neg_groups, sizeof(uint));
+    cp_file.read((char*)&n_pos_groups, sizeof(uint));
+    if (!cp_file) return false;
+    if (nGroups.size() < n_neg_groups) _extendNGroups(n_neg_groups);
+    if (pGroups.size() < n_pos_groups) _extendPGroups(n_pos_groups);
+    for (uint i = 0; i < n_neg_groups + n_pos_groups; i++) {
+        bool neg = (i < n_neg_groups);
+        int pow = (neg ? -static_cast<int>(i) : static_cast<int>(i - n_neg_groups));
+        CRGroup * group = _getGroup(pow);
+        unsigned size = 0;
+        cp_file.read((char*)&size, sizeof(unsigned));
+        cp_file.read((char*)&group->sum, sizeof(double));
+        if (!cp_file || size > n) return false;
+        if (size > group->capacity) _extendGroup(group, size - group->capacity);
+        group->size = size;
+        if (size == 0) continue;
+        cp_file.read((char*)group->indices, sizeof(uint) * size);
+        cp_file.read((char*)group->rates, sizeof(double) * size);
+        for (uint pos = 0; pos < size; pos++) {
+            uint idx = group->indices[pos];
+            if (idx >= n) return false;
+            pEntries[idx].recorded = true;
+            pEntries[idx].pow = pow;
+            pEntries[idx].pos = pos;
+        }
+    }
+
+    cp_file.read((char*)&pA0, sizeof(double));
+    cp_file.read((char*)&pA0Comp, sizeof(double));
+    cp_file.read((char*)&pA0Updates, sizeof(uint));
+    cp_file.read((char*)&pNRecorded, sizeof(uint));
+    cp_file.read((char*)&pGroupTree.nsets, sizeof(uint));
+    _readArray(cp_file, pGroupTree.leaves);
+    _readArray(cp_file, pGroupTree.nodes);
+    pBatchSize = 0;
+    resetStats();
+    return !cp_file.fail();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_SSA_CRSCHED_HPP
+#define STEPS_SOLVER_SSA_CRSCHED_HPP 1
+
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "scheduler.hpp"
+#include "crstruct.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(ssa)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Composition and rejection scheduler. Entries are grouped by the
+/// binary exponent of their propensity; a group is chosen by its sum and
+/// an entry within the group by rejection sampling.
+///
+class CRScheduler: public Scheduler
+{
+
+public:
+
+    CRScheduler(steps::rng::RNG * r);
+    ~CRScheduler(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    std::string getName(void) const;
+
+    void init(uint n);
+    void update(uint idx, double rate, double t);
+    void commit(double t);
+
+    inline double getA0(void) const
+    { return pA0; }
+
+    uint getNext(double t, double & dt);
+
+    std::size_t getMemoryUsage(void) const;
+
+    void checkpoint(std::ostream & cp_file) const;
+    bool restore(std::istream & cp_file);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Set the number of update batches between exact resummations of
+    /// A0. In between, A0 is maintained incrementally from the propensity
+    /// changes of the updated entries. A value of 1 resums after every
+    /// batch.
+    ///
+    void setA0ResyncInterval(uint n);
+
+    inline uint getA0ResyncInterval(void) const
+    { return pA0ResyncInterval; }
+
+    /// Choose whether the group holding the next event is found by a
+    /// search in the group sum tree (default) or by a linear scan over
+    /// all groups.
+    ///
+    inline void setGroupTreeSearch(bool tree)
+    { pGroupTreeSearch = tree; }
+
+    inline bool getGroupTreeSearch(void) const
+    { return pGroupTreeSearch; }
+
+    ////////////////////////////////////////////////////////////////////////
+    // HEALTH STATISTICS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Number of events selected by getNext() since the last
+    /// resetStats().
+    ///
+    inline double getNSelections(void) const
+    { return pNSelections; }
+
+    /// Number of rejection sampling trials made by those selections,
+    /// including the accepted ones; at least one per selection.
+    ///
+    inline double getNTrials(void) const
+    { return pNTrials; }
+
+    /// Number of times the storage of a group had to be reallocated
+    /// since the last resetStats().
+    ///
+    inline uint getNGroupExtends(void) const
+    { return pNGroupExtends; }
+
+    void resetStats(void);
+
+    /// Fill pows, sizes and sums with the power, number of entries and
+    /// propensity sum of every group allocated so far, in order of
+    /// increasing power.
+    ///
+    void getGroupData(std::vector<int> & pows, std::vector<uint> & sizes,
+                      std::vector<double> & sums) const;
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    // Select the group holding the next event.
+    CRGroup * _getGroupOf(double selector) const;
+
+    // Select an entry within a group by rejection sampling.
+    uint _selectInGroup(CRGroup * group);
+
+    void _clear(void);
+
+    inline CRGroup * _getGroup(int pow)
+    {
+        if (pow >= 0) return pGroups[pow];
+        else return nGroups[-pow];
+    }
+
+    void _extendPGroups(uint new_size);
+    void _extendNGroups(uint new_size);
+    void _extendGroup(CRGroup * group, uint size = 1024);
+
+    /// Apply a change in propensity to the running A0 total
+    /// (Kahan-compensated).
+    ///
+    inline void _incA0(double delta)
+    {
+        double y = delta - pA0Comp;
+        double t = pA0 + y;
+        pA0Comp = (t - pA0) - y;
+        pA0 = t;
+    }
+
+    /// Recompute A0 exactly from the group sums.
+    ///
+    void _updateSum(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    std::vector<CREntryData>                    pEntries;
+
+    double                                      pA0;
+    // Compensation term of the running A0 sum.
+    double                                      pA0Comp;
+    // Number of update batches since the last exact resummation.
+    uint                                        pA0Updates;
+    // Number of update batches between exact resummations.
+    uint                                        pA0ResyncInterval;
+    // Number of entries currently stored in a group.
+    uint                                        pNRecorded;
+    // Number of update() calls since the last commit().
+    uint                                        pBatchSize;
+
+    // Sum tree over the groups, and whether getNext uses it.
+    CRGroupTree                                 pGroupTree;
+    bool                                        pGroupTreeSearch;
+
+    // Health statistics since the last resetStats().
+    double                                      pNSelections;
+    double                                      pNTrials;
+    uint                                        pNGroupExtends;
+
+    std::vector<CRGroup*>                       nGroups;
+    std::vector<CRGroup*>                       pGroups;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(ssa)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SOLVER_SSA_CRSCHED_HPP
+
+// END
@@ -0,0 +1,186 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ *  Last Changed Rev:  $Rev: 380 $
+ *  Last Changed Date: $Date: 2010-11-03 11:04:45 +0900 (Wed, 03 Nov 2010) $
+ *  Last Changed By:   $Author: wchen $
+ */
+
+#ifndef STEPS_SOLVER_SSA_CRSTRUCT_HPP
+#define STEPS_SOLVER_SSA_CRSTRUCT_HPP 1
+
+#include "../../common.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+////////////////////////////////////////////////////////////////////////////////
+
+// Range of frexp() exponents of propensities stored in CR groups. Rates
+// below 1e-20 are not recorded, rates are bounded by DBL_MAX.
+#define CR_MIN_POW                              -66
+#define CR_MAX_POW                              1024
+
+// Number of group sum changes after which the CR group tree is rebuilt
+// from its leaves, to remove rounding drift in the internal nodes.
+#define CR_TREE_REBUILD_INTERVAL                4096
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(ssa)
+
+struct CRGroup {
+    CRGroup(int power, uint init_size = 1024) {
+        max = pow(2, power);
+        sum = 0.0;
+        capacity = init_size;
+        size = 0;
+        indices = (uint*)malloc(sizeof(uint) * init_size);
+        rates = (double*)malloc(sizeof(double) * init_size);
+        if (indices == NULL || rates == NULL) {
+            std::cerr << "DirectCR: unable to allocate memory for SSA group.\n";
+            throw;
+        }
+        #ifdef SSA_DEBUG
+        std::cout << "SSA: CRGroup Created\n";
+        std::cout << "power: " << power << "\n";
+        std::cout << "max: " << max << "\n";
+        std::cout << "capacity: " << capacity << "\n";
+        std::cout << "--------------------------------------------------------\n";
+        #endif
+    }
+
+    unsigned                                capacity;
+    unsigned                                size;
+    double                                  max;
+    double                                  sum;
+    uint*                                   indices;
+    // Rates of the entries in indices, stored contiguously so that
+    // rejection sampling does not have to look up the entry data.
+    double*                                 rates;
+};
+
+struct CREntryData {
+    CREntryData() {
+        recorded = false;
+        pow = 0;
+        pos = 0;
+        rate = 0.0;
+    }
+
+    bool                                    recorded;
+    int                                     pow;
+    unsigned                                pos;
+    double                                  rate;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Fenwick (binary indexed) tree over the sums of all CR groups, keyed by
+/// group power. Used to find the group a selector falls in with
+/// O(log n) work instead of a linear scan over the group vectors.
+///
+/// The leaves hold copies of the group sums; the internal nodes are
+/// updated by deltas and rebuilt exactly from the leaves every
+/// CR_TREE_REBUILD_INTERVAL changes.
+///
+struct CRGroupTree {
+    CRGroupTree(void)
+    : size(CR_MAX_POW - CR_MIN_POW + 1)
+    , top(1)
+    , nsets(0)
+    , leaves(CR_MAX_POW - CR_MIN_POW + 1, 0.0)
+    , nodes(CR_MAX_POW - CR_MIN_POW + 2, 0.0)
+    {
+        while (top * 2 <= size) top *= 2;
+    }
+
+    /// Set the sum stored for the group with power pow.
+    ///
+    inline void set(int pow, double sum) {
+        uint i = pow - CR_MIN_POW;
+        double delta = sum - leaves[i];
+        if (delta == 0.0) return;
+        leaves[i] = sum;
+        for (uint j = i + 1; j <= size; j += (j & (~j + 1))) {
+            nodes[j] += delta;
+        }
+        if (++nsets >= CR_TREE_REBUILD_INTERVAL) rebuild();
+    }
+
+    /// Recompute all internal nodes from the leaves.
+    ///
+    inline void rebuild(void) {
+        nsets = 0;
+        for (uint j = 1; j <= size; j++) nodes[j] = leaves[j - 1];
+        for (uint j = 1; j <= size; j++) {
+            uint parent = j + (j & (~j + 1));
+            if (parent <= size) nodes[parent] += nodes[j];
+        }
+    }
+
+    inline void clear(void) {
+        std::fill(leaves.begin(), leaves.end(), 0.0);
+        std::fill(nodes.begin(), nodes.end(), 0.0);
+        nsets = 0;
+    }
+
+    /// Return the power of the first group at which the cumulative sum
+    /// reaches selector, or CR_MAX_POW + 1 if selector exceeds the total.
+    ///
+    inline int search(double selector) const {
+        uint pos = 0;
+        for (uint step = top; step != 0; step >>= 1) {
+            uint next = pos + step;
+            if (next <= size && nodes[next] < selector) {
+                pos = next;
+                selector -= nodes[next];
+            }
+        }
+        return static_cast<int>(pos) + CR_MIN_POW;
+    }
+
+    uint                                    size;
+    uint                                    top;
+    uint                                    nsets;
+    std::vector<double>                     leaves;
+    std::vector<double>                     nodes;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(ssa)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+#endif
+
+// STEPS_SOLVER_SSA_CRSTRUCT_HPP
+
+// END
@@ -0,0 +1,292 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <sstream>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "../../error.hpp"
+#include "directsched.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::DirectScheduler::DirectScheduler(steps::rng::RNG * r, uint width)
+: Scheduler(r)
+, pWidth(width)
+, pNEntries(0)
+, pA0(0.0)
+, pLevelOffsets()
+, pTree(0)
+, pTreeMem(0)
+, pIndices()
+, pDirty()
+, pNTouched(0)
+, pNTouchedTotal(0.0)
+{
+    if (pWidth < 2)
+    {
+        std::ostringstream os;
+        os << "Direct scheduler tree width must be at least 2.";
+        throw steps::ArgErr(os.str());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::DirectScheduler::~DirectScheduler(void)
+{
+    _clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string sssa::DirectScheduler::getName(void) const
+{
+    return "direct";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::DirectScheduler::_clear(void)
+{
+    delete[] pTreeMem;
+    pTreeMem = 0;
+    pTree = 0;
+    pLevelOffsets.clear();
+    pIndices.clear();
+    pDirty.clear();
+    pNEntries = 0;
+    pA0 = 0.0;
+    pNTouched = 0;
+    pNTouchedTotal = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::DirectScheduler::init(uint n)
+{
+    _clear();
+
+    pNEntries = n;
+    if (n == 0) return;
+
+    // Work up. Every level is padded to a multiple of the width, so that
+    // with a base aligned to a cache line and a width that is a multiple
+    // of 8 no node's children straddle a cache line.
+    uint total = 0;
+    uint clsize = n;
+    do
+    {
+        uint extra = clsize % pWidth;
+        if (extra != 0) clsize += pWidth - extra;
+
+        pLevelOffsets.push_back(total);
+        total += clsize;
+
+        clsize = clsize / pWidth;
+    }
+    while (clsize > 1);
+
+    pTreeMem = new char[total * sizeof(double) + DIRECT_SCHED_ALIGN];
+    std::size_t addr = reinterpret_cast<std::size_t>(pTreeMem);
+    std::size_t pad = (DIRECT_SCHED_ALIGN - addr % DIRECT_SCHED_ALIGN) % DIRECT_SCHED_ALIGN;
+    pTree = reinterpret_cast<double *>(pTreeMem + pad);
+    std::fill_n(pTree, total, 0.0);
+
+    pIndices.reserve(n);
+    pDirty.assign(total, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::DirectScheduler::update(uint idx, double rate, double t)
+{
+    assert(idx < pNEntries);
+    pTree[idx] = rate;
+
+    // Queue the parent, once. With a single level the leaves are summed
+    // straight into pA0.
+    if (pLevelOffsets.size() == 1) return;
+    uint parent = pLevelOffsets[1] + idx / pWidth;
+    if (pDirty[parent] == 0)
+    {
+        pDirty[parent] = 1;
+        pIndices.push_back(idx / pWidth);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::DirectScheduler::commit(double t)
+{
+    pNTouched = 0;
+    if (pNEntries == 0) return;
+
+    // Sweep the levels bottom-up. Each dirty node is recomputed exactly
+    // once and marks its own parent, so ancestors shared by many updated
+    // leaves are only summed once per commit.
+    uint nlevels = pLevelOffsets.size();
+    uint nentries = pIndices.size();
+    for (uint l = 1; l < nlevels; ++l)
+    {
+        double const * prevlevel = pTree + pLevelOffsets[l - 1];
+        double * currlevel = pTree + pLevelOffsets[l];
+        char * currdirty = &pDirty[pLevelOffsets[l]];
+        char * nextdirty = (l + 1 < nlevels) ? &pDirty[pLevelOffsets[l + 1]] : 0;
+
+        uint cur_e = 0;
+        for (uint e = 0; e < nentries; ++e)
+        {
+            uint idx = pIndices[e];
+
+            double val = 0.0;
+            double const * child = prevlevel + idx * pWidth;
+            for (uint i = 0; i < pWidth; ++i)
+            {
+                val += child[i];
+            }
+            currlevel[idx] = val;
+            currdirty[idx] = 0;
+
+            // Queue the parent, unless a sibling already did.
+            idx /= pWidth;
+            if (nextdirty == 0)
+            {
+                continue;
+            }
+            if (nextdirty[idx] == 0)
+            {
+                nextdirty[idx] = 1;
+                pIndices[cur_e++] = idx;
+            }
+        }
+
+        pNTouched += nentries;
+        nentries = cur_e;
+    }
+    pIndices.clear();
+
+    // Update zero propensity.
+    double const * toplevel = pTree + pLevelOffsets[nlevels - 1];
+    pA0 = 0.0;
+    for (uint i = 0; i < pWidth; ++i)
+    {
+        pA0 += toplevel[i];
+    }
+    pNTouched += 1;
+    pNTouchedTotal += pNTouched;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sssa::DirectScheduler::getNext(double t, double & dt)
+{
+    assert(pA0 >= 0.0);
+    // Quick check to see whether nothing is there.
+    if (pA0 == 0.0) return SCHED_IDX_UNDEFINED;
+
+    // One random number for the whole descent: at each level the partial
+    // sums of the children passed over are subtracted from the selector,
+    // which leaves a uniform selector within the chosen child.
+    double selector = rng()->getUnfIE() * pA0;
+
+    uint clevel = pLevelOffsets.size();
+    uint cur_node = 0;
+    while (clevel != 0)
+    {
+        clevel--;
+        double const * level = pTree + pLevelOffsets[clevel];
+
+        cur_node *= pWidth;
+        uint last = cur_node + pWidth - 1;
+        double curval = level[cur_node];
+        while (selector >= curval && cur_node < last)
+        {
+            selector -= curval;
+            curval = level[++cur_node];
+        }
+
+        // Rounding in the partial sums can leave the selector just past
+        // the last non-zero child; step back to it.
+        while (curval <= 0.0 && cur_node > last + 1 - pWidth)
+        {
+            curval = level[--cur_node];
+        }
+        assert(curval > 0.0);
+        if (selector > curval) selector = curval;
+    }
+
+    // Check.
+    assert(cur_node < pNEntries);
+    dt = rng()->getExp(pA0);
+    return cur_node;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t sssa::DirectScheduler::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(DirectScheduler);
+    // pDirty has one entry per tree node.
+    if (pTreeMem != 0) bytes += pDirty.size() * sizeof(double) + DIRECT_SCHED_ALIGN;
+    bytes += (pLevelOffsets.capacity() + pIndices.capacity()) * sizeof(uint);
+    bytes += pDirty.capacity() * sizeof(char);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::DirectScheduler::checkpoint(std::ostream & cp_file) const
+{
+    cp_file.write((char*)&pNEntries, sizeof(uint));
+    if (pNEntries == 0) return;
+    cp_file.write((char*)pTree, sizeof(double) * pDirty.size());
+    cp_file.write((char*)&pA0, sizeof(double));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sssa::DirectScheduler::restore(std::istream & cp_file)
+{
+    uint n = 0;
+    cp_file.read((char*)&n, sizeof(uint));
+    if (!cp_file || n != pNEntries) return false;
+    if (pNEntries == 0) return true;
+    cp_file.read((char*)pTree, sizeof(double) * pDirty.size());
+    cp_file.read((char*)&pA0, sizeof(double));
+    return !cp_file.fail();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
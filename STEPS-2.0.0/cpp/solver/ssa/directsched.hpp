@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_SSA_DIRECTSCHED_HPP
+#define STEPS_SOLVER_SSA_DIRECTSCHED_HPP 1
+
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "scheduler.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(ssa)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Default number of children per node of the DirectScheduler tree: two
+/// 64 byte cache lines of propensities.
+#define DIRECT_SCHED_WIDTH              16
+
+/// Alignment (in bytes) of the start of the DirectScheduler tree.
+#define DIRECT_SCHED_ALIGN              64
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Direct method scheduler. The propensities are the leaves of an implicit
+/// n-ary sum tree stored level after level in one contiguous, cache line
+/// aligned block. The next event is found with a single random number,
+/// descending from the root and subtracting the partial sums of the
+/// siblings that are passed over.
+///
+class DirectScheduler: public Scheduler
+{
+
+public:
+
+    /// \param width Number of children per tree node. Multiples of 8 keep
+    ///        every node's children in whole cache lines.
+    ///
+    DirectScheduler(steps::rng::RNG * r, uint width = DIRECT_SCHED_WIDTH);
+    ~DirectScheduler(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    std::string getName(void) const;
+
+    void init(uint n);
+    void update(uint idx, double rate, double t);
+    void commit(double t);
+
+    inline double getA0(void) const
+    { return pA0; }
+
+    uint getNext(double t, double & dt);
+
+    std::size_t getMemoryUsage(void) const;
+
+    void checkpoint(std::ostream & cp_file) const;
+    bool restore(std::istream & cp_file);
+
+    inline uint getWidth(void) const
+    { return pWidth; }
+
+    inline uint getNNodesTouched(void) const
+    { return pNTouched; }
+
+    inline double getNNodesTouchedTotal(void) const
+    { return pNTouchedTotal; }
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    void _clear(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    uint                                        pWidth;
+
+    uint                                        pNEntries;
+
+    double                                      pA0;
+
+    // Offset of each level in pTree, leaves first; the last level is the
+    // single node below the root, pA0.
+    std::vector<uint>                           pLevelOffsets;
+
+    // The tree, aligned to DIRECT_SCHED_ALIGN inside pTreeMem.
+    double                                    * pTree;
+    char                                      * pTreeMem;
+
+    // Parents of the leaves changed by update() since the last commit().
+    std::vector<uint>                           pIndices;
+
+    // Per node of the tree (same layout as pTree), set while the node is
+    // queued for recomputation in commit().
+    std::vector<char>                           pDirty;
+
+    uint                                        pNTouched;
+    double                                      pNTouchedTotal;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(ssa)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SOLVER_SSA_DIRECTSCHED_HPP
+
+// END
@@ -0,0 +1,252 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "../../error.hpp"
+#include "groupsched.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::GroupScheduler::GroupScheduler(steps::rng::RNG * r, Scheduler * main)
+: Scheduler(r)
+, pMain(main)
+, pGroups()
+, pGroupOf()
+, pGroupStart()
+, pEntries()
+, pRates()
+, pPos()
+, pGroupSums()
+, pGroupDirty()
+, pDirtyGroups()
+, pNTouched(0)
+, pNTouchedTotal(0.0)
+{
+    assert(pMain != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::GroupScheduler::~GroupScheduler(void)
+{
+    delete pMain;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::GroupScheduler::setGroups(std::vector<uint> const & groups)
+{
+    pGroups = groups;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::Scheduler * sssa::GroupScheduler::releaseMain(void)
+{
+    Scheduler * main = pMain;
+    pMain = 0;
+    return main;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string sssa::GroupScheduler::getName(void) const
+{
+    return pMain->getName();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::GroupScheduler::init(uint n)
+{
+    std::vector<uint> & groups = pGroupOf;
+    if (pGroups.size() == n)
+    {
+        groups = pGroups;
+    }
+    else
+    {
+        groups.resize(n);
+        for (uint i = 0; i < n; ++i) groups[i] = i;
+    }
+
+    uint ngroups = 0;
+    for (uint i = 0; i < n; ++i)
+    {
+        if (groups[i] >= ngroups) ngroups = groups[i] + 1;
+    }
+
+    // Counting sort of the entries by group.
+    pGroupStart.assign(ngroups + 1, 0);
+    for (uint i = 0; i < n; ++i) ++pGroupStart[groups[i] + 1];
+    for (uint g = 0; g < ngroups; ++g) pGroupStart[g + 1] += pGroupStart[g];
+    std::vector<uint> next(pGroupStart.begin(), pGroupStart.end() - 1);
+    pEntries.resize(n);
+    pPos.resize(n);
+    for (uint i = 0; i < n; ++i)
+    {
+        uint pos = next[groups[i]]++;
+        pEntries[pos] = i;
+        pPos[i] = pos;
+    }
+
+    pRates.assign(n, 0.0);
+    pGroupSums.assign(ngroups, 0.0);
+    pGroupDirty.assign(ngroups, 0);
+    pDirtyGroups.clear();
+    pNTouched = 0;
+    pNTouchedTotal = 0.0;
+
+    pMain->init(ngroups);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::GroupScheduler::update(uint idx, double rate, double t)
+{
+    assert(idx < pPos.size());
+    pRates[pPos[idx]] = rate;
+    uint g = pGroupOf[idx];
+    if (pGroupDirty[g] == 0)
+    {
+        pGroupDirty[g] = 1;
+        pDirtyGroups.push_back(g);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::GroupScheduler::commit(double t)
+{
+    uint ndirty = pDirtyGroups.size();
+    for (uint i = 0; i < ndirty; ++i)
+    {
+        uint g = pDirtyGroups[i];
+        double sum = 0.0;
+        uint e = pGroupStart[g + 1];
+        for (uint pos = pGroupStart[g]; pos < e; ++pos) sum += pRates[pos];
+        pGroupSums[g] = sum;
+        pGroupDirty[g] = 0;
+        pMain->update(g, sum, t);
+    }
+    pDirtyGroups.clear();
+    pMain->commit(t);
+
+    pNTouched = ndirty + pMain->getNNodesTouched();
+    pNTouchedTotal += ndirty;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sssa::GroupScheduler::getNext(double t, double & dt)
+{
+    uint g = pMain->getNext(t, dt);
+    if (g == SCHED_IDX_UNDEFINED) return g;
+
+    uint b = pGroupStart[g];
+    uint e = pGroupStart[g + 1];
+    double selector = rng()->getUnfIE() * pGroupSums[g];
+    uint last = SCHED_IDX_UNDEFINED;
+    for (uint pos = b; pos < e; ++pos)
+    {
+        if (pRates[pos] <= 0.0) continue;
+        last = pos;
+        if (selector < pRates[pos]) return pEntries[pos];
+        selector -= pRates[pos];
+    }
+
+    // Rounding left the selector just above the last non-zero entry.
+    if (last == SCHED_IDX_UNDEFINED) return SCHED_IDX_UNDEFINED;
+    return pEntries[last];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t sssa::GroupScheduler::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(GroupScheduler);
+    bytes += pMain->getMemoryUsage();
+    bytes += sizeof(uint) * (pGroups.capacity() + pGroupOf.capacity()
+                             + pGroupStart.capacity() + pEntries.capacity()
+                             + pPos.capacity() + pDirtyGroups.capacity());
+    bytes += sizeof(double) * (pRates.capacity() + pGroupSums.capacity());
+    bytes += pGroupDirty.capacity();
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sssa::GroupScheduler::getNNodesTouched(void) const
+{
+    return pNTouched;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double sssa::GroupScheduler::getNNodesTouchedTotal(void) const
+{
+    return pNTouchedTotal + pMain->getNNodesTouchedTotal();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::GroupScheduler::checkpoint(std::ostream & cp_file) const
+{
+    uint n = pGroupOf.size();
+    cp_file.write((char*)&n, sizeof(uint));
+    _writeArray(cp_file, pGroupOf);
+    _writeArray(cp_file, pRates);
+    _writeArray(cp_file, pGroupSums);
+    pMain->checkpoint(cp_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sssa::GroupScheduler::restore(std::istream & cp_file)
+{
+    uint n = 0;
+    cp_file.read((char*)&n, sizeof(uint));
+    if (!cp_file || n != pGroupOf.size()) return false;
+    std::vector<uint> groups(n);
+    _readArray(cp_file, groups);
+    if (!cp_file || groups != pGroupOf) return false;
+    _readArray(cp_file, pRates);
+    _readArray(cp_file, pGroupSums);
+    return pMain->restore(cp_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,154 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_SSA_GROUPSCHED_HPP
+#define STEPS_SOLVER_SSA_GROUPSCHED_HPP 1
+
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "scheduler.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(ssa)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Two-level scheduler over groups of entries. In Tetexact a group holds
+/// the kprocs of one tetrahedron, triangle or well-mixed volume. Each
+/// group takes part in the main scheduler as a single entry with the sum
+/// of the propensities of its entries; when a group is selected, the
+/// entry that fires is found by a linear search within the group.
+///
+/// An event usually changes several kprocs of the same element and of its
+/// neighbours, which then cost one update of the main scheduler per
+/// element instead of one per kproc. The sum of a changed group is
+/// recomputed from its entries at every commit, so it does not drift.
+///
+class GroupScheduler: public Scheduler
+{
+
+public:
+
+    /// The group scheduler takes ownership of main.
+    ///
+    GroupScheduler(steps::rng::RNG * r, Scheduler * main);
+    ~GroupScheduler(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Choose the groups: entry i belongs to group groups[i]. Group
+    /// indices must be dense from 0. Takes effect at the next
+    /// init(groups.size()); init with another number of entries puts
+    /// every entry in a group of its own.
+    ///
+    void setGroups(std::vector<uint> const & groups);
+
+    /// Give up the main scheduler: it is returned and not deleted with
+    /// the group scheduler, which must not be used any more.
+    ///
+    Scheduler * releaseMain(void);
+
+    inline Scheduler * main(void) const
+    { return pMain; }
+
+    inline uint getNGroups(void) const
+    { return pGroupSums.size(); }
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// The name of the main scheduler.
+    ///
+    std::string getName(void) const;
+
+    void init(uint n);
+    void update(uint idx, double rate, double t);
+    void commit(double t);
+
+    inline double getA0(void) const
+    { return pMain->getA0(); }
+
+    uint getNext(double t, double & dt);
+
+    std::size_t getMemoryUsage(void) const;
+
+    /// The groups, their propensities and the state of the main
+    /// scheduler; restore() fails if the groups differ.
+    ///
+    void checkpoint(std::ostream & cp_file) const;
+    bool restore(std::istream & cp_file);
+
+    /// Nodes of the main scheduler plus the group sums recomputed.
+    ///
+    uint getNNodesTouched(void) const;
+    double getNNodesTouchedTotal(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    Scheduler                                 * pMain;
+
+    // The groups as set by setGroups(), and per entry its group since
+    // init().
+    std::vector<uint>                           pGroups;
+    std::vector<uint>                           pGroupOf;
+
+    // The entries ordered by group; the entries of group g are
+    // pEntries[pGroupStart[g]] to pEntries[pGroupStart[g + 1] - 1], with
+    // their propensities at the same positions in pRates.
+    std::vector<uint>                           pGroupStart;
+    std::vector<uint>                           pEntries;
+    std::vector<double>                         pRates;
+    // Per entry, its position in pEntries.
+    std::vector<uint>                           pPos;
+
+    std::vector<double>                         pGroupSums;
+    std::vector<char>                           pGroupDirty;
+    std::vector<uint>                           pDirtyGroups;
+
+    uint                                        pNTouched;
+    double                                      pNTouchedTotal;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(ssa)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SOLVER_SSA_GROUPSCHED_HPP
+
+// END
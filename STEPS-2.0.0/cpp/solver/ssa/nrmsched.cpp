@@ -0,0 +1,244 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cassert>
+#include <limits>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "nrmsched.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Number of committed batches after which A0 is resummed from the rates.
+#define NRM_A0_RESYNC_INTERVAL                  1000
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::NRMScheduler::NRMScheduler(steps::rng::RNG * r)
+: Scheduler(r)
+, pA0(0.0)
+, pA0Updates(0)
+, pRates()
+, pTimes()
+, pHeap()
+, pHeapPos()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::NRMScheduler::~NRMScheduler(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string sssa::NRMScheduler::getName(void) const
+{
+    return "nrm";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::NRMScheduler::init(uint n)
+{
+    pA0 = 0.0;
+    pA0Updates = 0;
+    pRates.assign(n, 0.0);
+    pTimes.assign(n, std::numeric_limits<double>::infinity());
+    pHeap.resize(n);
+    pHeapPos.resize(n);
+    for (uint i = 0; i < n; ++i)
+    {
+        pHeap[i] = i;
+        pHeapPos[i] = i;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double sssa::NRMScheduler::_draw(uint idx, double t) const
+{
+    if (pRates[idx] > 0.0) return t + rng()->getExp(pRates[idx]);
+    return std::numeric_limits<double>::infinity();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::NRMScheduler::update(uint idx, double rate, double t)
+{
+    assert(idx < pRates.size());
+    double old_rate = pRates[idx];
+    double old_time = pTimes[idx];
+    if (old_rate == rate && old_time > t) return;
+
+    pA0 += rate - old_rate;
+    pRates[idx] = rate;
+
+    if (rate <= 0.0)
+    {
+        pTimes[idx] = std::numeric_limits<double>::infinity();
+    }
+    else if (old_rate > 0.0 && old_time > t)
+    {
+        // Rescale the remaining waiting time to the new propensity.
+        pTimes[idx] = t + (old_rate / rate) * (old_time - t);
+    }
+    else
+    {
+        pTimes[idx] = _draw(idx, t);
+    }
+
+    uint pos = pHeapPos[idx];
+    if (pTimes[idx] < old_time) _siftUp(pos);
+    else _siftDown(pos);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::NRMScheduler::commit(double t)
+{
+    // A0 is not needed to select events; resum it now and then so that
+    // getA0() does not drift.
+    if (++pA0Updates < NRM_A0_RESYNC_INTERVAL) return;
+    pA0Updates = 0;
+    pA0 = 0.0;
+    std::vector<double>::const_iterator r_end = pRates.end();
+    for (std::vector<double>::const_iterator r = pRates.begin(); r != r_end; ++r)
+    {
+        pA0 += *r;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sssa::NRMScheduler::getNext(double t, double & dt)
+{
+    if (pHeap.empty()) return SCHED_IDX_UNDEFINED;
+
+    // Entries at the top that are not after t have already fired (their
+    // propensity need not have changed, so they may not have been
+    // updated): give them a new putative time.
+    uint top = pHeap[0];
+    while (pTimes[top] <= t)
+    {
+        pTimes[top] = _draw(top, t);
+        _siftDown(0);
+        top = pHeap[0];
+    }
+
+    if (pTimes[top] == std::numeric_limits<double>::infinity())
+    {
+        return SCHED_IDX_UNDEFINED;
+    }
+    dt = pTimes[top] - t;
+    return top;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::NRMScheduler::_siftUp(uint pos)
+{
+    while (pos != 0)
+    {
+        uint parent = (pos - 1) / 2;
+        if (pTimes[pHeap[parent]] <= pTimes[pHeap[pos]]) break;
+        _swap(pos, parent);
+        pos = parent;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::NRMScheduler::_siftDown(uint pos)
+{
+    uint size = pHeap.size();
+    while (true)
+    {
+        uint left = 2 * pos + 1;
+        if (left >= size) break;
+        uint child = left;
+        uint right = left + 1;
+        if (right < size && pTimes[pHeap[right]] < pTimes[pHeap[left]])
+        {
+            child = right;
+        }
+        if (pTimes[pHeap[pos]] <= pTimes[pHeap[child]]) break;
+        _swap(pos, child);
+        pos = child;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t sssa::NRMScheduler::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(NRMScheduler);
+    bytes += (pRates.capacity() + pTimes.capacity()) * sizeof(double);
+    bytes += (pHeap.capacity() + pHeapPos.capacity()) * sizeof(uint);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::NRMScheduler::checkpoint(std::ostream & cp_file) const
+{
+    // The putative times were drawn from the random numbers before the
+    // checkpoint, so they are part of the state.
+    uint n = pRates.size();
+    cp_file.write((char*)&n, sizeof(uint));
+    cp_file.write((char*)&pA0, sizeof(double));
+    cp_file.write((char*)&pA0Updates, sizeof(uint));
+    _writeArray(cp_file, pRates);
+    _writeArray(cp_file, pTimes);
+    _writeArray(cp_file, pHeap);
+    _writeArray(cp_file, pHeapPos);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sssa::NRMScheduler::restore(std::istream & cp_file)
+{
+    uint n = 0;
+    cp_file.read((char*)&n, sizeof(uint));
+    if (!cp_file || n != pRates.size()) return false;
+    cp_file.read((char*)&pA0, sizeof(double));
+    cp_file.read((char*)&pA0Updates, sizeof(uint));
+    _readArray(cp_file, pRates);
+    _readArray(cp_file, pTimes);
+    _readArray(cp_file, pHeap);
+    _readArray(cp_file, pHeapPos);
+    return !cp_file.fail();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
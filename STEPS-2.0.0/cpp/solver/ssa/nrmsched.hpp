@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_SSA_NRMSCHED_HPP
+#define STEPS_SOLVER_SSA_NRMSCHED_HPP 1
+
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "scheduler.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(ssa)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Next reaction method scheduler (Gibson and Bruck, 2000). Every entry
+/// carries an absolute putative firing time, kept in an indexed binary
+/// min-heap. When the propensity of an entry changes its remaining
+/// waiting time is rescaled, so only the entry that fired draws a new
+/// random number.
+///
+/// An entry whose putative time is not after the current time has fired
+/// (or the clock was moved past it) and gets a fresh waiting time the
+/// next time it is updated or reaches the top of the heap.
+///
+class NRMScheduler: public Scheduler
+{
+
+public:
+
+    NRMScheduler(steps::rng::RNG * r);
+    ~NRMScheduler(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    std::string getName(void) const;
+
+    void init(uint n);
+    void update(uint idx, double rate, double t);
+    void commit(double t);
+
+    inline double getA0(void) const
+    { return pA0; }
+
+    uint getNext(double t, double & dt);
+
+    std::size_t getMemoryUsage(void) const;
+
+    void checkpoint(std::ostream & cp_file) const;
+    bool restore(std::istream & cp_file);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    // Draw a fresh putative time for entry idx at time t.
+    double _draw(uint idx, double t) const;
+
+    // Restore the heap property at position pos after a time changed.
+    void _siftUp(uint pos);
+    void _siftDown(uint pos);
+
+    inline void _swap(uint pos1, uint pos2)
+    {
+        uint idx1 = pHeap[pos1];
+        uint idx2 = pHeap[pos2];
+        pHeap[pos1] = idx2;
+        pHeap[pos2] = idx1;
+        pHeapPos[idx1] = pos2;
+        pHeapPos[idx2] = pos1;
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+
+    double                                      pA0;
+
+    // Number of committed batches since A0 was last resummed.
+    uint                                        pA0Updates;
+
+    std::vector<double>                         pRates;
+    std::vector<double>                         pTimes;
+
+    // Heap of entry indices ordered by putative time, and the position
+    // of every entry in the heap.
+    std::vector<uint>                           pHeap;
+    std::vector<uint>                           pHeapPos;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(ssa)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SOLVER_SSA_NRMSCHED_HPP
+
+// END
@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cassert>
+#include <sstream>
+#include <string>
+
+// STEPS headers.
+#include "../../common.h"
+#include "../../error.hpp"
+#include "scheduler.hpp"
+#include "crsched.hpp"
+#include "directsched.hpp"
+#include "nrmsched.hpp"
+#include "sdmsched.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::Scheduler::Scheduler(steps::rng::RNG * r)
+: pRNG(r)
+{
+    assert(pRNG != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::Scheduler::~Scheduler(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::Scheduler * sssa::createScheduler(std::string const & name,
+                                        steps::rng::RNG * r)
+{
+    if (name == "cr") return new CRScheduler(r);
+    if (name == "direct") return new DirectScheduler(r);
+    if (name == "nrm") return new NRMScheduler(r);
+    if (name == "sdm") return new SDMScheduler(r);
+
+    std::ostringstream os;
+    os << "Unknown scheduler '" << name << "' (expected 'cr', 'direct', ";
+    os << "'nrm' or 'sdm').";
+    throw steps::ArgErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
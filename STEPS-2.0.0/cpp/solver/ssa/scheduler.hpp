@@ -0,0 +1,191 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_SSA_SCHEDULER_HPP
+#define STEPS_SOLVER_SSA_SCHEDULER_HPP 1
+
+
+// STL headers.
+#include <iostream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "../../rng/rng.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(ssa)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Returned by Scheduler::getNext() when no entry can fire.
+static const uint SCHED_IDX_UNDEFINED = 0xFFFFFFFF;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Base class of the event schedulers used by the SSA solvers.
+///
+/// A scheduler stores the propensities of a fixed number of entries,
+/// identified by their schedule index (the index of the KProc in the
+/// solver), and selects the next entry to fire together with the time
+/// until it fires. The solver calls update() for every entry whose
+/// propensity may have changed, followed by a single commit(), before
+/// asking for the next event.
+///
+/// All times passed to a scheduler are absolute simulation times.
+///
+class Scheduler
+{
+
+public:
+
+    Scheduler(steps::rng::RNG * r);
+    virtual ~Scheduler(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Name of the scheduler, as accepted by createScheduler().
+    ///
+    virtual std::string getName(void) const = 0;
+
+    /// Discard all entries and make room for n entries with zero
+    /// propensity.
+    ///
+    virtual void init(uint n) = 0;
+
+    /// Set the propensity of entry idx at simulation time t.
+    ///
+    virtual void update(uint idx, double rate, double t) = 0;
+
+    /// Finish a batch of update() calls made at simulation time t.
+    ///
+    virtual void commit(double t) = 0;
+
+    /// Return the sum of all propensities.
+    ///
+    virtual double getA0(void) const = 0;
+
+    /// Select the next entry to fire, given that the simulation is at
+    /// time t. Returns SCHED_IDX_UNDEFINED if no entry can fire, otherwise
+    /// the index of the entry, with the time until it fires in dt.
+    ///
+    virtual uint getNext(double t, double & dt) = 0;
+
+    /// Return the number of bytes held by the scheduler and its tables.
+    ///
+    virtual std::size_t getMemoryUsage(void) const = 0;
+
+    /// Return the number of internal scheduler nodes (sums, heap entries)
+    /// recomputed by the last commit(). Zero for schedulers that do not
+    /// keep track.
+    ///
+    virtual uint getNNodesTouched(void) const
+    { return 0; }
+
+    /// Return the number of internal scheduler nodes recomputed by all
+    /// commit() calls since init().
+    ///
+    virtual double getNNodesTouchedTotal(void) const
+    { return 0.0; }
+
+    /// Write the state of the scheduler as left by the last commit():
+    /// whatever later selections depend on beyond the propensities, such
+    /// as the order of the entries, drawn firing times and running sums.
+    /// The default writes nothing.
+    ///
+    virtual void checkpoint(std::ostream & cp_file) const
+    { }
+
+    /// Read the state written by checkpoint() of a scheduler of the same
+    /// kind, after init() with the same number of entries, and return
+    /// true. The restored scheduler then makes the same selections from
+    /// the same random numbers as the one checkpointed. Returns false if
+    /// the state was written by a scheduler set up otherwise, or none is
+    /// kept (the default); the caller then has to init() and update()
+    /// all entries again.
+    ///
+    virtual bool restore(std::istream & cp_file)
+    { return false; }
+
+    ////////////////////////////////////////////////////////////////////////
+
+    inline steps::rng::RNG * rng(void) const
+    { return pRNG; }
+
+    ////////////////////////////////////////////////////////////////////////
+
+protected:
+
+    /// Write the elements of v, and read them back into v, which must
+    /// already have the size of the v written.
+    ///
+    template <typename T>
+    static void _writeArray(std::ostream & cp_file, std::vector<T> const & v)
+    {
+        if (v.empty() == false)
+        {
+            cp_file.write((char const*)&v[0], sizeof(T) * v.size());
+        }
+    }
+
+    template <typename T>
+    static void _readArray(std::istream & cp_file, std::vector<T> & v)
+    {
+        if (v.empty() == false)
+        {
+            cp_file.read((char*)&v[0], sizeof(T) * v.size());
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    steps::rng::RNG                           * pRNG;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Create a scheduler by name. Known names are "cr" (composition and
+/// rejection), "direct" (n-ary sum tree), "nrm" (Gibson-Bruck next
+/// reaction method) and "sdm" (sorting direct method, for tens of
+/// entries). Throws steps::ArgErr for an unknown name.
+///
+Scheduler * createScheduler(std::string const & name, steps::rng::RNG * r);
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(ssa)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SOLVER_SSA_SCHEDULER_HPP
+
+// END
@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "sdmsched.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Number of committed batches after which A0 is resummed from the rates.
+#define SDM_A0_RESYNC_INTERVAL                  1000
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::SDMScheduler::SDMScheduler(steps::rng::RNG * r)
+: Scheduler(r)
+, pA0(0.0)
+, pA0Updates(0)
+, pRates()
+, pOrder()
+, pPos()
+, pNUpdates(0)
+, pNTouched(0)
+, pNTouchedTotal(0.0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::SDMScheduler::~SDMScheduler(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string sssa::SDMScheduler::getName(void) const
+{
+    return "sdm";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::SDMScheduler::init(uint n)
+{
+    pA0 = 0.0;
+    pA0Updates = 0;
+    pRates.assign(n, 0.0);
+    pOrder.resize(n);
+    pPos.resize(n);
+    for (uint i = 0; i < n; ++i)
+    {
+        pOrder[i] = i;
+        pPos[i] = i;
+    }
+    pNUpdates = 0;
+    pNTouched = 0;
+    pNTouchedTotal = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::SDMScheduler::update(uint idx, double rate, double t)
+{
+    assert(idx < pPos.size());
+    double & r = pRates[pPos[idx]];
+    pA0 += rate - r;
+    r = rate;
+    ++pNUpdates;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::SDMScheduler::commit(double t)
+{
+    pNTouched = pNUpdates + 1;
+    pNTouchedTotal += pNTouched;
+
+    // A batch that changes every entry (a reset) is as cheap a point as
+    // any to drop the rounding of the incremental sum.
+    bool full = (pNUpdates >= pRates.size());
+    pNUpdates = 0;
+    if (full == false && ++pA0Updates < SDM_A0_RESYNC_INTERVAL) return;
+    _resync();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::SDMScheduler::_resync(void)
+{
+    pA0Updates = 0;
+    pA0 = 0.0;
+    std::vector<double>::const_iterator r_end = pRates.end();
+    for (std::vector<double>::const_iterator r = pRates.begin(); r != r_end; ++r)
+    {
+        pA0 += *r;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sssa::SDMScheduler::getNext(double t, double & dt)
+{
+    for (uint attempt = 0; attempt < 2; ++attempt)
+    {
+        if (pA0 <= 0.0) return SCHED_IDX_UNDEFINED;
+
+        double selector = rng()->getUnfIE() * pA0;
+        uint n = pRates.size();
+        uint pos = 0;
+        uint last = n;
+        for (; pos < n; ++pos)
+        {
+            double rate = pRates[pos];
+            if (rate <= 0.0) continue;
+            last = pos;
+            if (selector < rate) break;
+            selector -= rate;
+        }
+
+        // Rounding in A0 can leave the selector past the last non-zero
+        // entry, which then fires; with no such entry A0 was stale.
+        if (last == n)
+        {
+            _resync();
+            continue;
+        }
+        pos = last;
+
+        // Move the entry one place towards the front.
+        uint idx = pOrder[pos];
+        if (pos != 0)
+        {
+            uint prev = pOrder[pos - 1];
+            pOrder[pos - 1] = idx;
+            pOrder[pos] = prev;
+            pPos[idx] = pos - 1;
+            pPos[prev] = pos;
+            double rate = pRates[pos];
+            pRates[pos] = pRates[pos - 1];
+            pRates[pos - 1] = rate;
+        }
+
+        dt = rng()->getExp(pA0);
+        return idx;
+    }
+    return SCHED_IDX_UNDEFINED;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t sssa::SDMScheduler::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(SDMScheduler);
+    bytes += pRates.capacity() * sizeof(double);
+    bytes += (pOrder.capacity() + pPos.capacity()) * sizeof(uint);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::SDMScheduler::checkpoint(std::ostream & cp_file) const
+{
+    // The search order, which getNext() has been sorting.
+    uint n = pRates.size();
+    cp_file.write((char*)&n, sizeof(uint));
+    cp_file.write((char*)&pA0, sizeof(double));
+    cp_file.write((char*)&pA0Updates, sizeof(uint));
+    _writeArray(cp_file, pRates);
+    _writeArray(cp_file, pOrder);
+    _writeArray(cp_file, pPos);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sssa::SDMScheduler::restore(std::istream & cp_file)
+{
+    uint n = 0;
+    cp_file.read((char*)&n, sizeof(uint));
+    if (!cp_file || n != pRates.size()) return false;
+    cp_file.read((char*)&pA0, sizeof(double));
+    cp_file.read((char*)&pA0Updates, sizeof(uint));
+    _readArray(cp_file, pRates);
+    _readArray(cp_file, pOrder);
+    _readArray(cp_file, pPos);
+    return !cp_file.fail();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_SSA_SDMSCHED_HPP
+#define STEPS_SOLVER_SSA_SDMSCHED_HPP 1
+
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "scheduler.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(ssa)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Sorting direct method scheduler (McCollum, Peterson, Cox, Simpson and
+/// Samatova 2006). The propensities are kept in one array, searched
+/// linearly for the next event. Every time an entry fires it swaps places
+/// with the one before it, so the entries that fire most often drift to
+/// the front and the search stops early.
+///
+/// There is no tree to maintain: an update changes one propensity and
+/// A0, which is resummed now and then. For tens of entries this beats the
+/// sum tree of DirectScheduler; the cost of a search grows with the
+/// number of entries, so large systems should use the others.
+///
+class SDMScheduler: public Scheduler
+{
+
+public:
+
+    SDMScheduler(steps::rng::RNG * r);
+    ~SDMScheduler(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    std::string getName(void) const;
+
+    void init(uint n);
+    void update(uint idx, double rate, double t);
+    void commit(double t);
+
+    inline double getA0(void) const
+    { return pA0; }
+
+    uint getNext(double t, double & dt);
+
+    std::size_t getMemoryUsage(void) const;
+
+    void checkpoint(std::ostream & cp_file) const;
+    bool restore(std::istream & cp_file);
+
+    /// Propensities changed by the last commit(), and A0.
+    ///
+    inline uint getNNodesTouched(void) const
+    { return pNTouched; }
+
+    inline double getNNodesTouchedTotal(void) const
+    { return pNTouchedTotal; }
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    // Resum A0 from the propensities.
+    void _resync(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    double                                      pA0;
+
+    // Number of committed batches since A0 was last resummed.
+    uint                                        pA0Updates;
+
+    // The propensities in search order, the entry at each position and
+    // the position of each entry.
+    std::vector<double>                         pRates;
+    std::vector<uint>                           pOrder;
+    std::vector<uint>                           pPos;
+
+    uint                                        pNUpdates;
+    uint                                        pNTouched;
+    double                                      pNTouchedTotal;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(ssa)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SOLVER_SSA_SDMSCHED_HPP
+
+// END
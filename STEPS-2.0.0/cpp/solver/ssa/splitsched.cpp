@@ -0,0 +1,214 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "../../error.hpp"
+#include "splitsched.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::SplitScheduler::SplitScheduler(steps::rng::RNG * r, Scheduler * main,
+                                     Scheduler * sub)
+: Scheduler(r)
+, pMain(main)
+, pSub(sub)
+, pSplit()
+, pLocal()
+, pInSub()
+, pMainIdcs()
+, pSubIdcs()
+, pSubDirty(false)
+{
+    assert(pMain != 0 && pSub != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::SplitScheduler::~SplitScheduler(void)
+{
+    delete pMain;
+    delete pSub;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::SplitScheduler::setSplit(std::vector<char> const & sub)
+{
+    pSplit = sub;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sssa::Scheduler * sssa::SplitScheduler::releaseMain(void)
+{
+    Scheduler * main = pMain;
+    pMain = 0;
+    return main;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string sssa::SplitScheduler::getName(void) const
+{
+    return pMain->getName();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::SplitScheduler::init(uint n)
+{
+    pLocal.resize(n);
+    pInSub.assign(n, 0);
+    pMainIdcs.clear();
+    pSubIdcs.clear();
+    bool split = (pSplit.size() == n);
+    for (uint i = 0; i < n; ++i)
+    {
+        if (split && pSplit[i] != 0)
+        {
+            pInSub[i] = 1;
+            pLocal[i] = pSubIdcs.size();
+            pSubIdcs.push_back(i);
+        }
+        else
+        {
+            pLocal[i] = pMainIdcs.size();
+            pMainIdcs.push_back(i);
+        }
+    }
+    pMain->init(pMainIdcs.size() + 1);
+    pSub->init(pSubIdcs.size());
+    pSubDirty = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::SplitScheduler::update(uint idx, double rate, double t)
+{
+    assert(idx < pLocal.size());
+    if (pInSub[idx] != 0)
+    {
+        pSub->update(pLocal[idx], rate, t);
+        pSubDirty = true;
+    }
+    else
+    {
+        pMain->update(pLocal[idx], rate, t);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::SplitScheduler::commit(double t)
+{
+    if (pSubDirty == true)
+    {
+        pSub->commit(t);
+        pMain->update(pMainIdcs.size(), pSub->getA0(), t);
+        pSubDirty = false;
+    }
+    pMain->commit(t);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sssa::SplitScheduler::getNext(double t, double & dt)
+{
+    uint idx = pMain->getNext(t, dt);
+    if (idx == SCHED_IDX_UNDEFINED) return idx;
+    if (idx < pMainIdcs.size()) return pMainIdcs[idx];
+
+    // The time is that of the main scheduler; the sub-scheduler only
+    // selects the entry.
+    double subdt;
+    idx = pSub->getNext(t, subdt);
+    if (idx == SCHED_IDX_UNDEFINED) return idx;
+    return pSubIdcs[idx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t sssa::SplitScheduler::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(SplitScheduler);
+    bytes += pMain->getMemoryUsage() + pSub->getMemoryUsage();
+    bytes += pSplit.capacity() + pInSub.capacity();
+    bytes += sizeof(uint) * (pLocal.capacity() + pMainIdcs.capacity()
+                             + pSubIdcs.capacity());
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint sssa::SplitScheduler::getNNodesTouched(void) const
+{
+    return pMain->getNNodesTouched() + pSub->getNNodesTouched();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double sssa::SplitScheduler::getNNodesTouchedTotal(void) const
+{
+    return pMain->getNNodesTouchedTotal() + pSub->getNNodesTouchedTotal();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sssa::SplitScheduler::checkpoint(std::ostream & cp_file) const
+{
+    uint n = pInSub.size();
+    cp_file.write((char*)&n, sizeof(uint));
+    _writeArray(cp_file, pInSub);
+    pMain->checkpoint(cp_file);
+    pSub->checkpoint(cp_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sssa::SplitScheduler::restore(std::istream & cp_file)
+{
+    uint n = 0;
+    cp_file.read((char*)&n, sizeof(uint));
+    if (!cp_file || n != pInSub.size()) return false;
+    std::vector<char> insub(n);
+    _readArray(cp_file, insub);
+    if (!cp_file || insub != pInSub) return false;
+    if (pMain->restore(cp_file) == false) return false;
+    return pSub->restore(cp_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
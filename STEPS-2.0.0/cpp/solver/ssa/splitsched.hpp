@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_SOLVER_SSA_SPLITSCHED_HPP
+#define STEPS_SOLVER_SSA_SPLITSCHED_HPP 1
+
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../../common.h"
+#include "scheduler.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(solver)
+START_NAMESPACE(ssa)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Two-level scheduler. A subset of the entries (in Tetexact the kprocs
+/// of the well-mixed volumes) is kept in a sub-scheduler of its own, which
+/// takes part in the main scheduler as a single entry with the sum of
+/// their propensities. When that entry is selected, the sub-scheduler
+/// picks the event among its entries.
+///
+/// Changes to the propensities of the sub-scheduler's entries then only
+/// touch the main scheduler once per commit, whatever the number of
+/// entries changed, and leave the groups of the other entries alone.
+///
+class SplitScheduler: public Scheduler
+{
+
+public:
+
+    /// The split scheduler takes ownership of main and sub.
+    ///
+    SplitScheduler(steps::rng::RNG * r, Scheduler * main, Scheduler * sub);
+    ~SplitScheduler(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Choose the entries held by the sub-scheduler: entry i if sub[i] is
+    /// non-zero. Takes effect at the next init(sub.size()); init with
+    /// another number of entries puts them all in the main scheduler.
+    ///
+    void setSplit(std::vector<char> const & sub);
+
+    /// Give up the main scheduler: it is returned and not deleted with
+    /// the split scheduler, which must not be used any more.
+    ///
+    Scheduler * releaseMain(void);
+
+    inline Scheduler * main(void) const
+    { return pMain; }
+
+    inline Scheduler * sub(void) const
+    { return pSub; }
+
+    inline uint getNSubEntries(void) const
+    { return pSubIdcs.size(); }
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// The name of the main scheduler.
+    ///
+    std::string getName(void) const;
+
+    void init(uint n);
+    void update(uint idx, double rate, double t);
+    void commit(double t);
+
+    inline double getA0(void) const
+    { return pMain->getA0(); }
+
+    uint getNext(double t, double & dt);
+
+    std::size_t getMemoryUsage(void) const;
+
+    /// The split and the states of the main and the sub-scheduler;
+    /// restore() fails if the split differs.
+    ///
+    void checkpoint(std::ostream & cp_file) const;
+    bool restore(std::istream & cp_file);
+
+    uint getNNodesTouched(void) const;
+    double getNNodesTouchedTotal(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    Scheduler                                 * pMain;
+    Scheduler                                 * pSub;
+
+    std::vector<char>                           pSplit;
+
+    // Per entry, its index in the main or the sub-scheduler (pInSub).
+    std::vector<uint>                           pLocal;
+    std::vector<char>                           pInSub;
+
+    // The entries of each scheduler, by their index in it. The last entry
+    // of the main scheduler stands for the sub-scheduler.
+    std::vector<uint>                           pMainIdcs;
+    std::vector<uint>                           pSubIdcs;
+
+    // An entry of the sub-scheduler changed since the last commit.
+    bool                                        pSubDirty;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(ssa)
+END_NAMESPACE(solver)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_SOLVER_SSA_SPLITSCHED_HPP
+
+// END
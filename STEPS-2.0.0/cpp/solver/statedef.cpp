@@ -32,6 +32,7 @@
 #include <string>
 #include <sstream>
 #include <cassert>
+#include <sys/time.h>
 
 // STEPS headers.
 #include "../common.h"
@@ -66,6 +67,7 @@ ssolver::Statedef::Statedef(steps::model::Model * m, steps::wm::Geom * g, steps:
 , pRNG(r)
 , pTime(0.0)
 , pNSteps(0)
+, pSetupTime(0.0)
 , pSpecdefs()
 , pChandefs()
 , pCompdefs()
@@ -78,114 +80,191 @@ ssolver::Statedef::Statedef(steps::model::Model * m, steps::wm::Geom * g, steps:
 , pOhmicCurrdefs()
 , pGHKcurrdefs()
 , pDiffBoundarydefs()
+, pSpecIdcs()
+, pCompIdcs()
+, pPatchIdcs()
+, pReacIdcs()
+, pSReacIdcs()
+, pDiffIdcs()
+, pSurfDiffIdcs()
+, pDiffBoundaryIdcs()
+, pVDepTransIdcs()
+, pVDepSReacIdcs()
+, pOhmicCurrIdcs()
+, pGHKcurrIdcs()
+, pPtrIdcs()
+{
+    timeval tv0;
+    gettimeofday(&tv0, 0);
 
-{
     assert(pModel != 0);
     assert(pGeom != 0);
 
 
+    // Collect the model and geometry objects in global index order (that
+    // of Model::_getSpec, _getReac etc.) in one pass, as those methods walk
+    // the model's tables from the start on every call.
+    std::vector<steps::model::Spec *> specs = pModel->getAllSpecs();
+    std::vector<steps::model::Chan *> chans = pModel->getAllChans();
+    std::vector<steps::model::Reac *> reacs;
+    std::vector<steps::model::Diff *> vdiffs;
+    std::vector<steps::model::Volsys *> volsyss = pModel->getAllVolsyss();
+    for (uint i = 0; i < volsyss.size(); ++i)
+    {
+        std::vector<steps::model::Reac *> vr = volsyss[i]->getAllReacs();
+        reacs.insert(reacs.end(), vr.begin(), vr.end());
+        std::vector<steps::model::Diff *> vd = volsyss[i]->getAllDiffs();
+        vdiffs.insert(vdiffs.end(), vd.begin(), vd.end());
+    }
+    std::vector<steps::model::Diff *> sdiffs;
+    std::vector<steps::model::SReac *> sreacs;
+    std::vector<steps::model::VDepTrans *> vdtrans;
+    std::vector<steps::model::VDepSReac *> vdsreacs;
+    std::vector<steps::model::OhmicCurr *> ohmiccurrs;
+    std::vector<steps::model::GHKcurr *> ghkcurrs;
+    std::vector<steps::model::Surfsys *> surfsyss = pModel->getAllSurfsyss();
+    for (uint i = 0; i < surfsyss.size(); ++i)
+    {
+        std::vector<steps::model::Diff *> sd = surfsyss[i]->getAllDiffs();
+        sdiffs.insert(sdiffs.end(), sd.begin(), sd.end());
+        std::vector<steps::model::SReac *> sr = surfsyss[i]->getAllSReacs();
+        sreacs.insert(sreacs.end(), sr.begin(), sr.end());
+        std::vector<steps::model::VDepTrans *> vdt = surfsyss[i]->getAllVDepTrans();
+        vdtrans.insert(vdtrans.end(), vdt.begin(), vdt.end());
+        std::vector<steps::model::VDepSReac *> vdsr = surfsyss[i]->getAllVDepSReacs();
+        vdsreacs.insert(vdsreacs.end(), vdsr.begin(), vdsr.end());
+        std::vector<steps::model::OhmicCurr *> oc = surfsyss[i]->getAllOhmicCurrs();
+        ohmiccurrs.insert(ohmiccurrs.end(), oc.begin(), oc.end());
+        std::vector<steps::model::GHKcurr *> ghk = surfsyss[i]->getAllGHKcurrs();
+        ghkcurrs.insert(ghkcurrs.end(), ghk.begin(), ghk.end());
+    }
+    std::vector<steps::wm::Comp *> comps = pGeom->getAllComps();
+    std::vector<steps::wm::Patch *> patches = pGeom->getAllPatches();
+
     // Create the def objects.
     // NOTE: The order is very important. For example all objects after SpecDef need
     // to know the number of species in the state so SpecDef must be first; CompDef must know what reacs and
     // diffs are in the system, so Reacdef and Diffdef must be created before Compdef.
     // Compdef MUST COME BEFORE Patchef, etc.
     //
-    uint nspecs = pModel->_countSpecs();
+    uint nspecs = specs.size();
     assert (nspecs > 0);
     for (uint sidx = 0; sidx < nspecs; ++sidx)
     {
-    	ssolver::Specdef * specdef = new Specdef(this, sidx,  pModel->_getSpec(sidx));
+    	ssolver::Specdef * specdef = new Specdef(this, sidx,  specs[sidx]);
     	assert (specdef != 0);
     	pSpecdefs.push_back(specdef);
+    	pSpecIdcs[specs[sidx]->getID()] = sidx;
+    	pPtrIdcs[specs[sidx]] = sidx;
     }
 
-    uint nchans = pModel->_countChans();
+    uint nchans = chans.size();
     for (uint chidx = 0; chidx < nchans; ++chidx)
     {
-    	ssolver::Chandef * chandef = new Chandef(this, chidx, pModel->_getChan(chidx));
+    	ssolver::Chandef * chandef = new Chandef(this, chidx, chans[chidx]);
     	assert(chandef != 0);
     	pChandefs.push_back(chandef);
     }
 
-    uint nreacs = pModel->_countReacs();
+    uint nreacs = reacs.size();
     for (uint ridx = 0; ridx < nreacs; ++ridx)
     {
-    	ssolver::Reacdef * reacdef = new Reacdef(this, ridx, pModel->_getReac(ridx));
+    	ssolver::Reacdef * reacdef = new Reacdef(this, ridx, reacs[ridx]);
     	assert (reacdef != 0);
     	pReacdefs.push_back(reacdef);
+    	pReacIdcs[reacs[ridx]->getID()] = ridx;
+    	pPtrIdcs[reacs[ridx]] = ridx;
     }
 
-    uint nvdiffs = pModel->_countVDiffs();
+    uint nvdiffs = vdiffs.size();
     for (uint didx = 0; didx < nvdiffs; ++didx)
     {
-       	ssolver::Diffdef * diffdef = new Diffdef(this, didx, pModel->_getVDiff(didx));
+       	ssolver::Diffdef * diffdef = new Diffdef(this, didx, vdiffs[didx]);
        	assert (diffdef != 0);
        	pDiffdefs.push_back(diffdef);
+       	pDiffIdcs[vdiffs[didx]->getID()] = didx;
+       	pPtrIdcs[vdiffs[didx]] = didx;
     }
 
-    uint nsdiffs = pModel->_countSDiffs();
+    uint nsdiffs = sdiffs.size();
     for (uint didx = 0; didx < nsdiffs; ++didx)
     {
-       	ssolver::SurfDiffdef * surfdiffdef = new SurfDiffdef(this, didx, pModel->_getSDiff(didx));
+       	ssolver::SurfDiffdef * surfdiffdef = new SurfDiffdef(this, didx, sdiffs[didx]);
        	assert (surfdiffdef != 0);
        	pSurfDiffdefs.push_back(surfdiffdef);
+       	pSurfDiffIdcs[sdiffs[didx]->getID()] = didx;
+       	pPtrIdcs[sdiffs[didx]] = didx;
     }
 
-    uint nsreacs = pModel->_countSReacs();
+    uint nsreacs = sreacs.size();
     for (uint sridx = 0; sridx < nsreacs; ++sridx)
     {
-      	ssolver::SReacdef * sreacdef = new SReacdef(this, sridx, pModel->_getSReac(sridx));
+      	ssolver::SReacdef * sreacdef = new SReacdef(this, sridx, sreacs[sridx]);
        	assert (sreacdef != 0);
        	pSReacdefs.push_back(sreacdef);
+       	pSReacIdcs[sreacs[sridx]->getID()] = sridx;
+       	pPtrIdcs[sreacs[sridx]] = sridx;
     }
 
-    uint nvdtrans = pModel->_countVDepTrans();
+    uint nvdtrans = vdtrans.size();
     for (uint vdtidx = 0; vdtidx < nvdtrans; ++vdtidx)
     {
-    	ssolver::VDepTransdef * vdtdef = new VDepTransdef(this, vdtidx, pModel->_getVDepTrans(vdtidx));
+    	ssolver::VDepTransdef * vdtdef = new VDepTransdef(this, vdtidx, vdtrans[vdtidx]);
     	assert(vdtdef != 0);
     	pVDepTransdefs.push_back(vdtdef);
+    	pVDepTransIdcs[vdtrans[vdtidx]->getID()] = vdtidx;
+    	pPtrIdcs[vdtrans[vdtidx]] = vdtidx;
     }
 
-    uint nvdsreacs = pModel->_countVDepSReacs();
+    uint nvdsreacs = vdsreacs.size();
     for (uint vdsridx = 0; vdsridx < nvdsreacs; ++vdsridx)
     {
-    	ssolver::VDepSReacdef * vdsrdef = new VDepSReacdef(this, vdsridx, pModel->_getVDepSReac(vdsridx));
+    	ssolver::VDepSReacdef * vdsrdef = new VDepSReacdef(this, vdsridx, vdsreacs[vdsridx]);
     	assert(vdsrdef != 0);
     	pVDepSReacdefs.push_back(vdsrdef);
+    	pVDepSReacIdcs[vdsreacs[vdsridx]->getID()] = vdsridx;
+    	pPtrIdcs[vdsreacs[vdsridx]] = vdsridx;
     }
 
-    uint nohmiccurrs = pModel->_countOhmicCurrs();
+    uint nohmiccurrs = ohmiccurrs.size();
     for (uint ocidx = 0; ocidx < nohmiccurrs; ++ocidx)
     {
-    	ssolver::OhmicCurrdef * ocdef = new OhmicCurrdef(this, ocidx, pModel->_getOhmicCurr(ocidx));
+    	ssolver::OhmicCurrdef * ocdef = new OhmicCurrdef(this, ocidx, ohmiccurrs[ocidx]);
     	assert(ocdef != 0);
     	pOhmicCurrdefs.push_back(ocdef);
+    	pOhmicCurrIdcs[ohmiccurrs[ocidx]->getID()] = ocidx;
+    	pPtrIdcs[ohmiccurrs[ocidx]] = ocidx;
     }
 
-    uint nghkcurrs = pModel->_countGHKcurrs();
+    uint nghkcurrs = ghkcurrs.size();
     for (uint ghkidx = 0; ghkidx < nghkcurrs; ++ghkidx)
     {
-    	ssolver::GHKcurrdef * ghkdef = new GHKcurrdef(this, ghkidx, pModel->_getGHKcurr(ghkidx));
+    	ssolver::GHKcurrdef * ghkdef = new GHKcurrdef(this, ghkidx, ghkcurrs[ghkidx]);
     	assert(ghkdef != 0);
     	pGHKcurrdefs.push_back(ghkdef);
+    	pGHKcurrIdcs[ghkcurrs[ghkidx]->getID()] = ghkidx;
+    	pPtrIdcs[ghkcurrs[ghkidx]] = ghkidx;
     }
 
-    uint ncomps = pGeom->_countComps();
+    uint ncomps = comps.size();
     assert(ncomps >0);
     for (uint cidx = 0; cidx < ncomps; ++cidx)
     {
-    	ssolver::Compdef * compdef = new Compdef(this, cidx, pGeom->_getComp(cidx));
+    	ssolver::Compdef * compdef = new Compdef(this, cidx, comps[cidx]);
     	assert (compdef != 0);
     	pCompdefs.push_back(compdef);
+    	pCompIdcs[comps[cidx]->getID()] = cidx;
+    	pPtrIdcs[comps[cidx]] = cidx;
     }
 
-    uint npatches = pGeom->_countPatches();
+    uint npatches = patches.size();
     for (uint pidx = 0; pidx < npatches; ++pidx)
     {
-    	ssolver::Patchdef * patchdef = new Patchdef(this, pidx, pGeom->_getPatch(pidx));
+    	ssolver::Patchdef * patchdef = new Patchdef(this, pidx, patches[pidx]);
     	assert (patchdef != 0);
     	pPatchdefs.push_back(patchdef);
+    	pPatchIdcs[patches[pidx]->getID()] = pidx;
+    	pPtrIdcs[patches[pidx]] = pidx;
     }
 
     if (steps::tetmesh::Tetmesh * tetmesh = dynamic_cast<steps::tetmesh::Tetmesh *>(pGeom))
@@ -196,6 +275,8 @@ ssolver::Statedef::Statedef(steps::model::Model * m, steps::wm::Geom * g, steps:
     		ssolver::DiffBoundarydef * diffboundarydef = new DiffBoundarydef(this, dbidx, tetmesh->_getDiffBoundary(dbidx));
     		assert (diffboundarydef != 0);
     		pDiffBoundarydefs.push_back(diffboundarydef);
+    		pDiffBoundaryIdcs[tetmesh->_getDiffBoundary(dbidx)->getID()] = dbidx;
+    		pPtrIdcs[tetmesh->_getDiffBoundary(dbidx)] = dbidx;
     	}
     }
 
@@ -240,6 +321,10 @@ ssolver::Statedef::Statedef(steps::model::Model * m, steps::wm::Geom * g, steps:
 
     for (DiffBoundaryDefPVecI db = pDiffBoundarydefs.begin(); db != pDiffBoundarydefs.end(); ++db)
     	(*db)->setup();
+
+    timeval tv1;
+    gettimeofday(&tv1, 0);
+    pSetupTime = (tv1.tv_sec - tv0.tv_sec) + 1.0e-6 * (tv1.tv_usec - tv0.tv_usec);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -289,7 +374,7 @@ ssolver::Statedef::~Statedef()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Statedef::checkpoint(std::fstream & cp_file)
+void ssolver::Statedef::checkpoint(std::iostream & cp_file)
 {
 
 	SpecdefPVecCI s_end = pSpecdefs.end();
@@ -362,7 +447,7 @@ void ssolver::Statedef::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::Statedef::restore(std::fstream & cp_file)
+void ssolver::Statedef::restore(std::iostream & cp_file)
 {
 
 	SpecdefPVecCI s_end = pSpecdefs.end();
@@ -436,6 +521,73 @@ void ssolver::Statedef::restore(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Bytes held by a vector of definition objects and the objects.
+template <class Def>
+static std::size_t defsMemoryUsage(std::vector<Def *> const & defs)
+{
+    std::size_t bytes = defs.capacity() * sizeof(Def *);
+    typename std::vector<Def *>::const_iterator d_end = defs.end();
+    for (typename std::vector<Def *>::const_iterator d = defs.begin(); d != d_end; ++d)
+    {
+        bytes += (*d)->getMemoryUsage();
+    }
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Bytes held by a name lookup table. A map node carries its value and,
+// in the common red-black tree implementations, a colour and three links.
+static std::size_t idxMapMemoryUsage(std::map<std::string, uint> const & idcs)
+{
+    std::size_t node = sizeof(std::pair<const std::string, uint>) + 4 * sizeof(void *);
+    std::size_t bytes = idcs.size() * node;
+    std::map<std::string, uint>::const_iterator i_end = idcs.end();
+    for (std::map<std::string, uint>::const_iterator i = idcs.begin(); i != i_end; ++i)
+    {
+        bytes += i->first.capacity();
+    }
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t ssolver::Statedef::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(Statedef);
+
+    bytes += defsMemoryUsage(pSpecdefs);
+    bytes += defsMemoryUsage(pChandefs);
+    bytes += defsMemoryUsage(pCompdefs);
+    bytes += defsMemoryUsage(pPatchdefs);
+    bytes += defsMemoryUsage(pReacdefs);
+    bytes += defsMemoryUsage(pSReacdefs);
+    bytes += defsMemoryUsage(pDiffdefs);
+    bytes += defsMemoryUsage(pSurfDiffdefs);
+    bytes += defsMemoryUsage(pDiffBoundarydefs);
+    bytes += defsMemoryUsage(pVDepTransdefs);
+    bytes += defsMemoryUsage(pVDepSReacdefs);
+    bytes += defsMemoryUsage(pOhmicCurrdefs);
+    bytes += defsMemoryUsage(pGHKcurrdefs);
+
+    bytes += idxMapMemoryUsage(pSpecIdcs);
+    bytes += idxMapMemoryUsage(pCompIdcs);
+    bytes += idxMapMemoryUsage(pPatchIdcs);
+    bytes += idxMapMemoryUsage(pReacIdcs);
+    bytes += idxMapMemoryUsage(pSReacIdcs);
+    bytes += idxMapMemoryUsage(pDiffIdcs);
+    bytes += idxMapMemoryUsage(pSurfDiffIdcs);
+    bytes += idxMapMemoryUsage(pDiffBoundaryIdcs);
+    bytes += idxMapMemoryUsage(pVDepTransIdcs);
+    bytes += idxMapMemoryUsage(pVDepSReacIdcs);
+    bytes += idxMapMemoryUsage(pOhmicCurrIdcs);
+    bytes += idxMapMemoryUsage(pGHKcurrIdcs);
+    bytes += pPtrIdcs.size() * (sizeof(std::pair<void const * const, uint>) + 4 * sizeof(void *));
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 ssolver::Compdef * ssolver::Statedef::compdef(uint gidx) const
 {
     assert(gidx < pCompdefs.size());
@@ -444,37 +596,30 @@ ssolver::Compdef * ssolver::Statedef::compdef(uint gidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+uint ssolver::Statedef::_ptrIdx(void const * obj) const
+{
+	PtrIdxMapCI idx = pPtrIdcs.find(obj);
+	// Argument should be valid so we should not get here
+	assert(idx != pPtrIdcs.end());
+	return idx->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 uint ssolver::Statedef::getCompIdx(std::string const & c) const
 {
-	uint maxcidx = pCompdefs.size();
-	assert (maxcidx > 0);
-	assert (maxcidx == pGeom->_countComps());
-	uint cidx = 0;
-    while(cidx < maxcidx)
-    {
-    	if (c == pGeom->_getComp(cidx)->getID()) return cidx;
-    	++cidx;
-    }
-    std::ostringstream os;
-    os << "Geometry does not contain comp with string identifier '" << c << "'.";
-    throw steps::ArgErr(os.str());
+	IdxMapCI idx = pCompIdcs.find(c);
+	if (idx != pCompIdcs.end()) return idx->second;
+	std::ostringstream os;
+	os << "Geometry does not contain comp with string identifier '" << c << "'.";
+	throw steps::ArgErr(os.str());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 uint ssolver::Statedef::getCompIdx(steps::wm::Comp * comp) const
 {
-	uint maxcidx = pCompdefs.size();
-	assert (maxcidx > 0);
-	assert (maxcidx == pGeom->_countComps());
-	uint cidx = 0;
-    while(cidx < maxcidx)
-    {
-    	if (comp == pGeom->_getComp(cidx)) return cidx;
-    	++cidx;
-    }
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(comp);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -489,14 +634,8 @@ ssolver::Patchdef * ssolver::Statedef::patchdef(uint gidx) const
 
 uint ssolver::Statedef::getPatchIdx(std::string const & p) const
 {
-	uint maxpidx = pPatchdefs.size();
-	assert (maxpidx == pGeom->_countPatches());
-	uint pidx = 0;
-	while(pidx < maxpidx)
-	{
-		if (p == pGeom->_getPatch(pidx)->getID()) return pidx;
-		++pidx;
-	}
+	IdxMapCI idx = pPatchIdcs.find(p);
+	if (idx != pPatchIdcs.end()) return idx->second;
 	std::ostringstream os;
 	os << "Geometry does not contain patch with string identifier '" << p << "'.";
 	throw steps::ArgErr(os.str());
@@ -506,16 +645,7 @@ uint ssolver::Statedef::getPatchIdx(std::string const & p) const
 
 uint ssolver::Statedef::getPatchIdx(steps::wm::Patch * patch) const
 {
-	uint maxpidx = pPatchdefs.size();
-	assert (maxpidx == pGeom->_countPatches());
-	uint pidx = 0;
-	while(pidx < maxpidx)
-	{
-		if (patch == pGeom->_getPatch(pidx)) return pidx;
-		++pidx;
-	}
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(patch);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -530,15 +660,8 @@ ssolver::Specdef * ssolver::Statedef::specdef(uint gidx) const
 
 uint ssolver::Statedef::getSpecIdx(std::string const & s) const
 {
-	uint maxsidx = pSpecdefs.size();
-	assert (maxsidx > 0);
-	assert(maxsidx == pModel->_countSpecs());
-	uint sidx = 0;
-	while(sidx < maxsidx)
-	{
-		if (s == pModel->_getSpec(sidx)->getID()) return sidx;
-		++sidx;
-	}
+	IdxMapCI idx = pSpecIdcs.find(s);
+	if (idx != pSpecIdcs.end()) return idx->second;
 	std::ostringstream os;
 	os << "Model does not contain species with string identifier '" << s << "'.";
 	throw steps::ArgErr(os.str());
@@ -548,17 +671,7 @@ uint ssolver::Statedef::getSpecIdx(std::string const & s) const
 
 uint ssolver::Statedef::getSpecIdx(steps::model::Spec * spec) const
 {
-	uint maxsidx = pSpecdefs.size();
-	assert (maxsidx > 0);
-	assert(maxsidx == pModel->_countSpecs());
-	uint sidx = 0;
-	while(sidx < maxsidx)
-	{
-		if (spec == pModel->_getSpec(sidx)) return sidx;
-		++sidx;
-	}
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(spec);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -573,14 +686,8 @@ ssolver::Reacdef * ssolver::Statedef::reacdef(uint gidx) const
 
 uint ssolver::Statedef::getReacIdx(std::string const & r) const
 {
-	uint maxridx = pReacdefs.size();
-	assert (maxridx == pModel->_countReacs());
-	uint ridx = 0;
-	while(ridx < maxridx)
-	{
-		if (r == pModel->_getReac(ridx)->getID()) return ridx;
-		++ridx;
-	}
+	IdxMapCI idx = pReacIdcs.find(r);
+	if (idx != pReacIdcs.end()) return idx->second;
 	std::ostringstream os;
 	os << "Model does not contain reac with string identifier '" << r <<"'.";
 	throw steps::ArgErr(os.str());
@@ -590,16 +697,7 @@ uint ssolver::Statedef::getReacIdx(std::string const & r) const
 
 uint ssolver::Statedef::getReacIdx(steps::model::Reac * reac) const
 {
-	uint maxridx = pReacdefs.size();
-	assert (maxridx == pModel->_countReacs());
-	uint ridx = 0;
-	while(ridx < maxridx)
-	{
-		if (reac == pModel->_getReac(ridx)) return ridx;
-		++ridx;
-	}
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(reac);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -614,14 +712,8 @@ ssolver::SReacdef * ssolver::Statedef::sreacdef(uint gidx) const
 
 uint ssolver::Statedef::getSReacIdx(std::string const & sr) const
 {
-	uint maxsridx = pSReacdefs.size();
-	assert (maxsridx == pModel->_countSReacs());
-	uint sridx = 0;
-	while(sridx < maxsridx)
-	{
-		if (sr == pModel->_getSReac(sridx)->getID()) return sridx;
-		++sridx;
-	}
+	IdxMapCI idx = pSReacIdcs.find(sr);
+	if (idx != pSReacIdcs.end()) return idx->second;
 	std::ostringstream os;
 	os << "Model does not contain sreac with string identifier '" << sr <<"'.";
 	throw steps::ArgErr(os.str());
@@ -631,16 +723,7 @@ uint ssolver::Statedef::getSReacIdx(std::string const & sr) const
 
 uint ssolver::Statedef::getSReacIdx(steps::model::SReac * sreac) const
 {
-	uint maxsridx = pSReacdefs.size();
-	assert (maxsridx == pModel->_countSReacs());
-	uint sridx = 0;
-	while(sridx < maxsridx)
-	{
-		if (sreac == pModel->_getSReac(sridx)) return sridx;
-		++sridx;
-	}
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(sreac);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -655,14 +738,8 @@ ssolver::Diffdef * ssolver::Statedef::diffdef(uint gidx) const
 
 uint ssolver::Statedef::getDiffIdx(std::string const & d) const
 {
-	uint maxdidx = pDiffdefs.size();
-	assert (maxdidx == pModel->_countVDiffs());
-	uint didx = 0;
-	while(didx < maxdidx)
-	{
-		if (d == pModel->_getVDiff(didx)->getID()) return didx;
-		++didx;
-	}
+	IdxMapCI idx = pDiffIdcs.find(d);
+	if (idx != pDiffIdcs.end()) return idx->second;
 	std::ostringstream os;
 	os << "Model does not contain diff with string identifier '" << d <<"'.";
 	throw steps::ArgErr(os.str());
@@ -672,16 +749,7 @@ uint ssolver::Statedef::getDiffIdx(std::string const & d) const
 
 uint ssolver::Statedef::getDiffIdx(steps::model::Diff * diff) const
 {
-	uint maxdidx = pDiffdefs.size();
-	assert (maxdidx == pModel->_countVDiffs());
-	uint didx = 0;
-	while(didx < maxdidx)
-	{
-		if (diff == pModel->_getVDiff(didx)) return didx;
-		++didx;
-	}
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(diff);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -696,14 +764,8 @@ ssolver::SurfDiffdef * ssolver::Statedef::surfdiffdef(uint gidx) const
 
 uint ssolver::Statedef::getSurfDiffIdx(std::string const & d) const
 {
-	uint maxdidx = pSurfDiffdefs.size();
-	assert (maxdidx == pModel->_countSDiffs());
-	uint didx = 0;
-	while(didx < maxdidx)
-	{
-		if (d == pModel->_getSDiff(didx)->getID()) return didx;
-		++didx;
-	}
+	IdxMapCI idx = pSurfDiffIdcs.find(d);
+	if (idx != pSurfDiffIdcs.end()) return idx->second;
 	std::ostringstream os;
 	os << "Model does not contain diff with string identifier '" << d <<"'.";
 	throw steps::ArgErr(os.str());
@@ -713,16 +775,7 @@ uint ssolver::Statedef::getSurfDiffIdx(std::string const & d) const
 
 uint ssolver::Statedef::getSurfDiffIdx(steps::model::Diff * diff) const
 {
-	uint maxdidx = pSurfDiffdefs.size();
-	assert (maxdidx == pModel->_countSDiffs());
-	uint didx = 0;
-	while(didx < maxdidx)
-	{
-		if (diff == pModel->_getSDiff(didx)) return didx;
-		++didx;
-	}
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(diff);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -737,14 +790,8 @@ ssolver::OhmicCurrdef * ssolver::Statedef::ohmiccurrdef(uint gidx) const
 
 uint ssolver::Statedef::getOhmicCurrIdx(std::string const & oc) const
 {
-	uint maxocidx = pOhmicCurrdefs.size();
-	assert (maxocidx == pModel->_countOhmicCurrs());
-	uint ocidx = 0;
-	while(ocidx < maxocidx)
-	{
-		if (oc == pModel->_getOhmicCurr(ocidx)->getID()) return ocidx;
-		++ocidx;
-	}
+	IdxMapCI idx = pOhmicCurrIdcs.find(oc);
+	if (idx != pOhmicCurrIdcs.end()) return idx->second;
 	std::ostringstream os;
 	os << "Model does not contain ohmic current with string identifier '" << oc <<"'.";
 	throw steps::ArgErr(os.str());
@@ -754,16 +801,7 @@ uint ssolver::Statedef::getOhmicCurrIdx(std::string const & oc) const
 
 uint ssolver::Statedef::getOhmicCurrIdx(steps::model::OhmicCurr * ohmiccurr) const
 {
-	uint maxocidx = pOhmicCurrdefs.size();
-	assert (maxocidx == pModel->_countOhmicCurrs());
-	uint ocidx = 0;
-	while(ocidx < maxocidx)
-	{
-		if (ohmiccurr == pModel->_getOhmicCurr(ocidx)) return ocidx;
-		++ocidx;
-	}
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(ohmiccurr);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -778,14 +816,8 @@ ssolver::VDepTransdef * ssolver::Statedef::vdeptransdef(uint gidx) const
 
 uint ssolver::Statedef::getVDepTransIdx(std::string const & vdt) const
 {
-	uint maxvdtidx = pVDepTransdefs.size();
-	assert (maxvdtidx == pModel->_countVDepTrans());
-	uint vdtidx = 0;
-	while(vdtidx < maxvdtidx)
-	{
-		if (vdt == pModel->_getVDepTrans(vdtidx)->getID()) return vdtidx;
-		++vdtidx;
-	}
+	IdxMapCI idx = pVDepTransIdcs.find(vdt);
+	if (idx != pVDepTransIdcs.end()) return idx->second;
 	std::ostringstream os;
 	os << "Model does not contain voltage-dependent transition with string identifier '" << vdt <<"'.";
 	throw steps::ArgErr(os.str());
@@ -795,16 +827,7 @@ uint ssolver::Statedef::getVDepTransIdx(std::string const & vdt) const
 
 uint ssolver::Statedef::getVDepTransIdx(steps::model::VDepTrans * vdeptrans) const
 {
-	uint maxvdtidx = pVDepTransdefs.size();
-	assert (maxvdtidx == pModel->_countVDepTrans());
-	uint vdtidx = 0;
-	while(vdtidx < maxvdtidx)
-	{
-		if (vdeptrans == pModel->_getVDepTrans(vdtidx)) return vdtidx;
-		++vdtidx;
-	}
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(vdeptrans);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -819,14 +842,8 @@ ssolver::VDepSReacdef * ssolver::Statedef::vdepsreacdef(uint gidx) const
 
 uint ssolver::Statedef::getVDepSReacIdx(std::string const & vdsr) const
 {
-	uint maxvdsridx = pVDepSReacdefs.size();
-	assert (maxvdsridx == pModel->_countVDepSReacs());
-	uint vdsridx = 0;
-	while(vdsridx < maxvdsridx)
-	{
-		if (vdsr == pModel->_getVDepSReac(vdsridx)->getID()) return vdsridx;
-		++vdsridx;
-	}
+	IdxMapCI idx = pVDepSReacIdcs.find(vdsr);
+	if (idx != pVDepSReacIdcs.end()) return idx->second;
 	std::ostringstream os;
 	os << "Model does not contain voltage-dependent reaction with string identifier '" << vdsr <<"'.";
 	throw steps::ArgErr(os.str());
@@ -836,16 +853,7 @@ uint ssolver::Statedef::getVDepSReacIdx(std::string const & vdsr) const
 
 uint ssolver::Statedef::getVDepSReacIdx(steps::model::VDepSReac * vdepsreac) const
 {
-	uint maxvdsridx = pVDepSReacdefs.size();
-	assert (maxvdsridx == pModel->_countVDepSReacs());
-	uint vdsridx = 0;
-	while(vdsridx < maxvdsridx)
-	{
-		if (vdepsreac == pModel->_getVDepSReac(vdsridx)) return vdsridx;
-		++vdsridx;
-	}
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(vdepsreac);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -860,14 +868,8 @@ ssolver::GHKcurrdef * ssolver::Statedef::ghkcurrdef(uint gidx) const
 
 uint ssolver::Statedef::getGHKcurrIdx(std::string const & ghk) const
 {
-	uint maxghkidx = pGHKcurrdefs.size();
-	assert (maxghkidx == pModel->_countGHKcurrs());
-	uint ghkidx = 0;
-	while(ghkidx < maxghkidx)
-	{
-		if (ghk == pModel->_getGHKcurr(ghkidx)->getID()) return ghkidx;
-		++ghkidx;
-	}
+	IdxMapCI idx = pGHKcurrIdcs.find(ghk);
+	if (idx != pGHKcurrIdcs.end()) return idx->second;
 	std::ostringstream os;
 	os << "Model does not contain ghk current with string identifier '" << ghk <<"'.";
 	throw steps::ArgErr(os.str());
@@ -877,16 +879,7 @@ uint ssolver::Statedef::getGHKcurrIdx(std::string const & ghk) const
 
 uint ssolver::Statedef::getGHKcurrIdx(steps::model::GHKcurr * ghkcurr) const
 {
-	uint maxghkidx = pGHKcurrdefs.size();
-	assert (maxghkidx == pModel->_countGHKcurrs());
-	uint ghkidx = 0;
-	while(ghkidx < maxghkidx)
-	{
-		if (ghkcurr == pModel->_getGHKcurr(ghkidx)) return ghkidx;
-		++ghkidx;
-	}
-    // Argument should be valid so we should not get here
-    assert(false);
+	return _ptrIdx(ghkcurr);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -901,16 +894,10 @@ ssolver::DiffBoundarydef * ssolver::Statedef::diffboundarydef(uint gidx) const
 
 uint ssolver::Statedef::getDiffBoundaryIdx(std::string const & d) const
 {
-	uint maxdidx = pDiffBoundarydefs.size();
-	if (steps::tetmesh::Tetmesh * tetmesh = dynamic_cast<steps::tetmesh::Tetmesh *>(pGeom))
+	if (dynamic_cast<steps::tetmesh::Tetmesh *>(pGeom) != 0)
 	{
-		assert (maxdidx == tetmesh->_countDiffBoundaries());
-		uint didx = 0;
-		while(didx < maxdidx)
-		{
-			if (d == tetmesh->_getDiffBoundary(didx)->getID()) return didx;
-			++didx;
-		}
+		IdxMapCI idx = pDiffBoundaryIdcs.find(d);
+		if (idx != pDiffBoundaryIdcs.end()) return idx->second;
 		std::ostringstream os;
 		os << "Geometry does not contain diff boundary with string identifier '" << d <<"'.";
 		throw steps::ArgErr(os.str());
@@ -927,25 +914,13 @@ uint ssolver::Statedef::getDiffBoundaryIdx(std::string const & d) const
 
 uint ssolver::Statedef::getDiffBoundaryIdx(steps::tetmesh::DiffBoundary * diffb) const
 {
-	uint maxdidx = pDiffBoundarydefs.size();
-	if (steps::tetmesh::Tetmesh * tetmesh = dynamic_cast<steps::tetmesh::Tetmesh *>(pGeom))
-	{
-		assert (maxdidx == tetmesh->_countDiffBoundaries());
-		uint didx = 0;
-		while(didx < maxdidx)
-		{
-			if (diffb == tetmesh->_getDiffBoundary(didx)) return didx;
-			++didx;
-		}
-		// Argument should be valid so we should not get here
-		assert(false);
-	}
-	else
+	if (dynamic_cast<steps::tetmesh::Tetmesh *>(pGeom) == 0)
 	{
 		std::ostringstream os;
 		os << "Diffusion boundary methods not available with well-mixed geometry";
 		throw steps::ArgErr(os.str());
 	}
+	return _ptrIdx(diffb);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
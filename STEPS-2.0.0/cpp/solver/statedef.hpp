@@ -35,6 +35,7 @@
 // STL headers.
 #include <string>
 #include <vector>
+#include <map>
 #include <fstream>
 
 // STEPS headers.
@@ -174,10 +175,15 @@ public:
     {return 0;}
 
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by the state definition: this
+    /// object, its name lookup tables and all the definition objects it
+    /// owns, with their tables.
+    std::size_t getMemoryUsage(void) const;
 
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS: COMPARTMENTS
@@ -547,6 +553,11 @@ public:
     inline void setNSteps(uint nsteps)
     { pNSteps = nsteps; }
 
+    /// Return the wall clock time in seconds that the construction of
+    /// the state definition took.
+    inline double getSetupTime(void) const
+    { return pSetupTime; }
+
     ////////////////////////////////////////////////////////////////////////
 
 private:
@@ -559,6 +570,8 @@ private:
 
 	uint                                pNSteps;
 
+	double                              pSetupTime;
+
 	std::vector<Specdef *>              pSpecdefs;
 	std::vector<Chandef *>				pChandefs;
 	std::vector<Compdef *>              pCompdefs;
@@ -575,6 +588,36 @@ private:
 	std::vector<OhmicCurrdef *> 		pOhmicCurrdefs;
 	std::vector<GHKcurrdef *> 			pGHKcurrdefs;
 
+	// Global index of each object by string identifier, built at
+	// construction so that the string-based lookups do not scan the
+	// model and geometry.
+	typedef std::map<std::string, uint>  IdxMap;
+	typedef IdxMap::const_iterator       IdxMapCI;
+
+	IdxMap                              pSpecIdcs;
+	IdxMap                              pCompIdcs;
+	IdxMap                              pPatchIdcs;
+	IdxMap                              pReacIdcs;
+	IdxMap                              pSReacIdcs;
+	IdxMap                              pDiffIdcs;
+	IdxMap                              pSurfDiffIdcs;
+	IdxMap                              pDiffBoundaryIdcs;
+	IdxMap                              pVDepTransIdcs;
+	IdxMap                              pVDepSReacIdcs;
+	IdxMap                              pOhmicCurrIdcs;
+	IdxMap                              pGHKcurrIdcs;
+
+	// Global index of each model and geometry object by address, for the
+	// lookups by object pointer that the def objects make during setup.
+	// One table serves all kinds, as distinct objects have distinct
+	// addresses.
+	typedef std::map<void const *, uint> PtrIdxMap;
+	typedef PtrIdxMap::const_iterator    PtrIdxMapCI;
+
+	PtrIdxMap                           pPtrIdcs;
+
+	uint _ptrIdx(void const * obj) const;
+
 
 };
 
@@ -75,14 +75,14 @@ ssolver::SurfDiffdef::~SurfDiffdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::SurfDiffdef::checkpoint(std::fstream & cp_file)
+void ssolver::SurfDiffdef::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pDcst, sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::SurfDiffdef::restore(std::fstream & cp_file)
+void ssolver::SurfDiffdef::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pDcst, sizeof(double));
 }
@@ -158,4 +158,11 @@ bool ssolver::SurfDiffdef::reqspec(uint gidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::SurfDiffdef::getMemoryUsage(void) const
+{
+    return sizeof(SurfDiffdef) + pStatedef->countSpecs() * sizeof(int);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
@@ -23,6 +23,8 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 // STL headers.
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <cassert>
 #include <iostream>
@@ -186,7 +188,7 @@ ssolver::VDepSReacdef::~VDepSReacdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::VDepSReacdef::checkpoint(std::fstream & cp_file)
+void ssolver::VDepSReacdef::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pVMin, sizeof(double));
     cp_file.write((char*)&pVMax, sizeof(double));
@@ -195,7 +197,7 @@ void ssolver::VDepSReacdef::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::VDepSReacdef::restore(std::fstream & cp_file)
+void ssolver::VDepSReacdef::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pVMin, sizeof(double));
     cp_file.read((char*)&pVMax, sizeof(double));
@@ -296,29 +298,76 @@ double ssolver::VDepSReacdef::getVDepK(double v) const
 {
 	assert(pSetupdone == true);
 	assert(pVKTab != 0);
-	if (v > pVMax)
+	checkVRange(v, v);
+
+	double v2 = ((v - pVMin) / pDV);
+	double lv = floor(v2);
+    uint lvidx = static_cast<uint>(lv);
+    uint uvidx = static_cast<uint>(ceil(v2));
+    double r = v2-lv;
+
+    return (((1.0 - r) * pVKTab[lvidx]) + (r * pVKTab[uvidx]));
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::VDepSReacdef::checkVRange(double vmin, double vmax) const
+{
+	if (vmax > pVMax)
     {
         std::ostringstream os;
         os << "Voltage to VDepSReac::getVDepRate higher than maximum: ";
-        os << v << " > " << pVMax;
+        os << vmax << " > " << pVMax;
         throw steps::ProgErr(os.str());
     }
-	if (v < pVMin)
+	if (vmin < pVMin)
     {
         std::ostringstream os;
         os << "Voltage to VDepSReac::getVDepRate lower than minimum: ";
-        os << v << " < " << pVMin;
+        os << vmin << " < " << pVMin;
         throw steps::ProgErr(os.str());
     }
+}
 
-	double v2 = ((v - pVMin) / pDV);
-	double lv = floor(v2);
-    uint lvidx = static_cast<uint>(lv);
-    uint uvidx = static_cast<uint>(ceil(v2));
-    double r = v2-lv;
+////////////////////////////////////////////////////////////////////////////////
 
-    return (((1.0 - r) * pVKTab[lvidx]) + (r * pVKTab[uvidx]));
+void ssolver::VDepSReacdef::getVDepKs(uint n, double const * v, double * k) const
+{
+	assert(pSetupdone == true);
+	assert(pVKTab != 0);
+	double invdv = 1.0 / pDV;
+	for (uint i = 0; i < n; ++i)
+	{
+		// v[i] >= pVMin, so truncation is floor, and the upper entry is
+		// the next one unless v[i] falls on an entry (as with ceil).
+		double v2 = (v[i] - pVMin) * invdv;
+		uint lvidx = static_cast<uint>(v2);
+		double r = v2 - lvidx;
+		uint uvidx = lvidx + (r > 0.0);
+		k[i] = ((1.0 - r) * pVKTab[lvidx]) + (r * pVKTab[uvidx]);
+	}
+}
 
+double ssolver::VDepSReacdef::getVDepKMax(double vmin, double vmax) const
+{
+	assert(pSetupdone == true);
+	assert(pVKTab != 0);
+	assert(vmin <= vmax);
+	vmin = std::max(vmin, pVMin);
+	vmax = std::min(vmax, pVMax);
+
+	// The table is interpolated linearly, so the largest value is at an
+	// end of the interval or at an entry inside it.
+	double v[2] = { vmin, vmax };
+	double k[2];
+	getVDepKs(2, v, k);
+	double kmax = std::max(k[0], k[1]);
+	uint last = static_cast<uint>(std::floor((pVMax - pVMin) / pDV));
+	uint b = static_cast<uint>(std::ceil((vmin - pVMin) / pDV));
+	uint e = std::min(static_cast<uint>(std::floor((vmax - pVMin) / pDV)), last);
+	for (uint i = b; i <= e; ++i) kmax = std::max(kmax, pVKTab[i]);
+	return kmax;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -489,5 +538,20 @@ bool ssolver::VDepSReacdef::reqspec_O(uint gidx) const
     return false;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t ssolver::VDepSReacdef::getMemoryUsage(void) const
+{
+    uint nspecs = pStatedef->countSpecs();
+    std::size_t bytes = sizeof(VDepSReacdef);
+    bytes += (static_cast<uint>(std::floor((pVMax - pVMin) / pDV)) + 1) * sizeof(double);
+    // As for SReacdef: DEP and LHS tables for the patch and one side.
+    bytes += nspecs * (2 * sizeof(depT) + 2 * sizeof(uint));
+    bytes += nspecs * (3 * sizeof(uint) + 3 * sizeof(int));
+    bytes += (pSpec_I_UPD_Coll.capacity() + pSpec_S_UPD_Coll.capacity()
+              + pSpec_O_UPD_Coll.capacity()) * sizeof(gidxT);
+    return bytes;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // END
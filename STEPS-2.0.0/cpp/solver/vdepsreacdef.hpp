@@ -78,10 +78,14 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by this object, its tables
+    /// and its rate table.
+    std::size_t getMemoryUsage(void) const;
 
     ////////////////////////////////////////////////////////////////////////
     // SOLVER METHODS: SETUP
@@ -110,6 +114,21 @@ public:
 	///
 	double getVDepK(double v) const;
 
+	/// Throw the error getVDepK would if any potential in [vmin, vmax]
+	/// is outside the range of the table.
+	///
+	void checkVRange(double vmin, double vmax) const;
+
+	/// Fill k[i] with the reaction constant for potential v[i], for n
+	/// potentials that checkVRange has accepted. Nothing is checked.
+	///
+	void getVDepKs(uint n, double const * v, double * k) const;
+
+	/// Return the largest reaction constant for a potential in [vmin, vmax],
+	/// clipped to the range of the table.
+	///
+	double getVDepKMax(double vmin, double vmax) const;
+
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS: STOICHIOMETRY
     ////////////////////////////////////////////////////////////////////////
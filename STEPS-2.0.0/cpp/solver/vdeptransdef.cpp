@@ -23,6 +23,8 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 // STL headers.
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <cassert>
 #include <iostream>
@@ -103,7 +105,7 @@ ssolver::VDepTransdef::~VDepTransdef(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::VDepTransdef::checkpoint(std::fstream & cp_file)
+void ssolver::VDepTransdef::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&pVMin, sizeof(double));
     cp_file.write((char*)&pVMax, sizeof(double));
@@ -112,7 +114,7 @@ void ssolver::VDepTransdef::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ssolver::VDepTransdef::restore(std::fstream & cp_file)
+void ssolver::VDepTransdef::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&pVMin, sizeof(double));
     cp_file.read((char*)&pVMax, sizeof(double));
@@ -158,29 +160,88 @@ double ssolver::VDepTransdef::getVDepRate(double v) const
 {
 	assert(pSetupdone == true);
 	assert(pVRateTab != 0);
-	if (v > pVMax)
+	checkVRange(v, v);
+
+	double v2 = ((v - pVMin) / pDV);
+	double lv = floor(v2);
+    uint lvidx = static_cast<uint>(lv);
+    uint uvidx = static_cast<uint>(ceil(v2));
+    double r = v2-lv;
+
+    return (((1.0 - r) * pVRateTab[lvidx]) + (r * pVRateTab[uvidx]));
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ssolver::VDepTransdef::checkVRange(double vmin, double vmax) const
+{
+	if (vmax > pVMax)
     {
         std::ostringstream os;
         os << "Voltage is higher than maximum for VDepTrans, " << name() << ": ";
-        os << v << " > " << pVMax;
+        os << vmax << " > " << pVMax;
         throw steps::ProgErr(os.str());
     }
-	if (v < pVMin)
+	if (vmin < pVMin)
     {
         std::ostringstream os;
         os << "Voltage is lower than maximum for VDepTrans, " << name() << ": ";
-        os << v << " < " << pVMin;
+        os << vmin << " < " << pVMin;
         throw steps::ProgErr(os.str());
     }
+}
 
-	double v2 = ((v - pVMin) / pDV);
-	double lv = floor(v2);
-    uint lvidx = static_cast<uint>(lv);
-    uint uvidx = static_cast<uint>(ceil(v2));
-    double r = v2-lv;
+////////////////////////////////////////////////////////////////////////////////
 
-    return (((1.0 - r) * pVRateTab[lvidx]) + (r * pVRateTab[uvidx]));
+void ssolver::VDepTransdef::getVDepRates(uint n, double const * v, double * rate) const
+{
+	assert(pSetupdone == true);
+	assert(pVRateTab != 0);
+	double invdv = 1.0 / pDV;
+	for (uint i = 0; i < n; ++i)
+	{
+		// v[i] >= pVMin, so truncation is floor, and the upper entry is
+		// the next one unless v[i] falls on an entry (as with ceil).
+		double v2 = (v[i] - pVMin) * invdv;
+		uint lvidx = static_cast<uint>(v2);
+		double r = v2 - lvidx;
+		uint uvidx = lvidx + (r > 0.0);
+		rate[i] = ((1.0 - r) * pVRateTab[lvidx]) + (r * pVRateTab[uvidx]);
+	}
+}
 
+double ssolver::VDepTransdef::getVDepRateMax(double vmin, double vmax) const
+{
+	assert(pSetupdone == true);
+	assert(pVRateTab != 0);
+	assert(vmin <= vmax);
+	vmin = std::max(vmin, pVMin);
+	vmax = std::min(vmax, pVMax);
+
+	// The table is interpolated linearly, so the largest value is at an
+	// end of the interval or at an entry inside it.
+	double v[2] = { vmin, vmax };
+	double k[2];
+	getVDepRates(2, v, k);
+	double kmax = std::max(k[0], k[1]);
+	uint last = static_cast<uint>(std::floor((pVMax - pVMin) / pDV));
+	uint b = static_cast<uint>(std::ceil((vmin - pVMin) / pDV));
+	uint e = std::min(static_cast<uint>(std::floor((vmax - pVMin) / pDV)), last);
+	for (uint i = b; i <= e; ++i) kmax = std::max(kmax, pVRateTab[i]);
+	return kmax;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double ssolver::VDepTransdef::getVDepRateClipped(double v) const
+{
+	assert(pSetupdone == true);
+	assert(pVRateTab != 0);
+	v = std::min(std::max(v, pVMin), pVMax);
+	double k;
+	getVDepRates(1, &v, &k);
+	return k;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -204,4 +265,14 @@ bool ssolver::VDepTransdef::req(uint gidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t ssolver::VDepTransdef::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(VDepTransdef);
+    bytes += (static_cast<uint>(std::floor((pVMax - pVMin) / pDV)) + 1) * sizeof(double);
+    bytes += pStatedef->countSpecs() * sizeof(int);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
@@ -72,10 +72,14 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by this object, its tables
+    /// and its rate table.
+    std::size_t getMemoryUsage(void) const;
     ////////////////////////////////////////////////////////////////////////
     // SOLVER METHODS: SETUP
     ////////////////////////////////////////////////////////////////////////
@@ -106,6 +110,26 @@ public:
 	///
 	double getVDepRate(double v) const;
 
+	/// Throw the error getVDepRate would if any potential in
+	/// [vmin, vmax] is outside the range of the table.
+	///
+	void checkVRange(double vmin, double vmax) const;
+
+	/// Fill rate[i] with the transition rate for potential v[i], for n
+	/// potentials that checkVRange has accepted. Nothing is checked.
+	///
+	void getVDepRates(uint n, double const * v, double * rate) const;
+
+	/// Return the largest transition rate for a potential in [vmin, vmax],
+	/// clipped to the range of the table.
+	///
+	double getVDepRateMax(double vmin, double vmax) const;
+
+	/// Return the transition rate for potential v clipped to the range
+	/// of the table.
+	///
+	double getVDepRateClipped(double v) const;
+
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS: CHANNEL STATES
     ////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+// STEPS headers.
+#include "../common.h"
+#include "arena.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::tetexact, stex);
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Arena::Arena(uint chunksize)
+: pChunkSize(chunksize)
+, pChunks()
+, pNext(0)
+, pEnd(0)
+, pAllocated(0)
+, pReserved(0)
+, pShared()
+, pSharedSaved(0)
+{
+    assert(chunksize >= TETEXACT_ARENA_ALIGN);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Arena::~Arena(void)
+{
+    std::vector<char *>::const_iterator c_end = pChunks.end();
+    for (std::vector<char *>::const_iterator c = pChunks.begin(); c != c_end; ++c)
+    {
+        delete[] *c;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void * stex::Arena::alloc(std::size_t bytes)
+{
+    // Round up so that the next allocation stays aligned; new[] returns
+    // memory aligned for any fundamental type, which covers the chunks.
+    bytes = footprint(bytes);
+
+    if (static_cast<std::size_t>(pEnd - pNext) < bytes)
+    {
+        // Objects larger than a chunk get one of their own; the
+        // remainder of the current chunk is then still used.
+        if (bytes > pChunkSize / 4)
+        {
+            char * big = new char[bytes];
+            pChunks.push_back(big);
+            pAllocated += bytes;
+            pReserved += bytes;
+            return big;
+        }
+        pNext = new char[pChunkSize];
+        pEnd = pNext + pChunkSize;
+        pChunks.push_back(pNext);
+        pReserved += pChunkSize;
+    }
+    void * p = pNext;
+    pNext += bytes;
+    pAllocated += bytes;
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void const * stex::Arena::share(void const * src, std::size_t bytes)
+{
+    // FNV-1a over the contents.
+    unsigned char const * c = static_cast<unsigned char const *>(src);
+    std::size_t h = 2166136261u;
+    for (std::size_t i = 0; i < bytes; ++i)
+    {
+        h = (h ^ c[i]) * 16777619u;
+    }
+
+    std::pair<SharedMap::const_iterator, SharedMap::const_iterator> r = pShared.equal_range(h);
+    for (SharedMap::const_iterator s = r.first; s != r.second; ++s)
+    {
+        if (s->second.second != bytes) continue;
+        if (std::memcmp(s->second.first, src, bytes) != 0) continue;
+        pSharedSaved += footprint(bytes);
+        return s->second.first;
+    }
+
+    void * p = alloc(bytes);
+    std::memcpy(p, src, bytes);
+    pShared.insert(SharedMap::value_type(h, std::make_pair(static_cast<void const *>(p), bytes)));
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Arena::clearShared(void)
+{
+    SharedMap().swap(pShared);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
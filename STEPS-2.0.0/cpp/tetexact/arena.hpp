@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETEXACT_ARENA_HPP
+#define STEPS_TETEXACT_ARENA_HPP 1
+
+// STL headers.
+#include <map>
+#include <vector>
+#include <cstddef>
+
+// STEPS headers.
+#include "../common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetexact)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Default size of the chunks an Arena allocates from, in bytes.
+#define TETEXACT_ARENA_CHUNK        (1 << 20)
+
+// Alignment of every allocation.
+#define TETEXACT_ARENA_ALIGN        16
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// A bump allocator for the mesh elements and kprocs of a Tetexact
+/// solver. Consecutive allocations are laid out next to each other in
+/// large chunks, and all memory is released in one go when the arena is
+/// destroyed. Objects constructed in it with placement new must have
+/// their destructors called explicitly before that.
+///
+class Arena
+{
+
+public:
+
+    Arena(uint chunksize = TETEXACT_ARENA_CHUNK);
+    ~Arena(void);
+
+    /// Return uninitialised, aligned storage for bytes bytes.
+    ///
+    void * alloc(std::size_t bytes);
+
+    /// Return uninitialised storage for n objects of type T.
+    ///
+    template <class T>
+    inline T * allocArray(uint n)
+    { return static_cast<T *>(alloc(n * sizeof(T))); }
+
+    /// Return storage holding a copy of the bytes bytes at src. If an
+    /// identical block was shared before (since the last clearShared),
+    /// that block is returned instead of a new copy, so it must never be
+    /// written to.
+    ///
+    void const * share(void const * src, std::size_t bytes);
+
+    /// Forget the blocks shared so far, releasing the table used to find
+    /// them; the blocks themselves stay valid.
+    ///
+    void clearShared(void);
+
+    /// Total number of bytes share() did not have to hand out because an
+    /// identical block existed.
+    ///
+    inline std::size_t sharedSaved(void) const
+    { return pSharedSaved; }
+
+    /// Total number of bytes handed out.
+    ///
+    inline std::size_t allocated(void) const
+    { return pAllocated; }
+
+    /// Total number of bytes obtained for the chunks, including the part
+    /// of each chunk that was never handed out.
+    ///
+    inline std::size_t reserved(void) const
+    { return pReserved; }
+
+    /// The number of bytes an allocation of bytes bytes takes up.
+    ///
+    static inline std::size_t footprint(std::size_t bytes)
+    {
+        if (bytes == 0) return TETEXACT_ARENA_ALIGN;
+        return (bytes + TETEXACT_ARENA_ALIGN - 1) & ~static_cast<std::size_t>(TETEXACT_ARENA_ALIGN - 1);
+    }
+
+private:
+
+    // Not copyable.
+    Arena(Arena const &);
+    Arena & operator=(Arena const &);
+
+    std::size_t                         pChunkSize;
+    std::vector<char *>                 pChunks;
+    char                              * pNext;
+    char                              * pEnd;
+    std::size_t                         pAllocated;
+    std::size_t                         pReserved;
+
+    // Shared blocks by hash of their contents, with their sizes.
+    typedef std::multimap<std::size_t, std::pair<void const *, std::size_t> > SharedMap;
+    SharedMap                           pShared;
+    std::size_t                         pSharedSaved;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetexact)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETEXACT_ARENA_HPP
+
+// END
@@ -0,0 +1,632 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "../parallel.hpp"
+#include "clusters.hpp"
+#include "diff.hpp"
+#include "sdiff.hpp"
+#include "tetexact.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::tetexact, stex);
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Runs the clusters of each thread's block of clusters, the same block in
+// every loop, so that a cluster always runs on the same (possibly pinned)
+// thread and its working memory stays where that thread touched it first.
+// Either sets the clusters up for a run, or simulates those that are
+// pending in a round.
+class ClusterLoop : public steps::ParallelLoop
+{
+public:
+    ClusterLoop(stex::Clusters & clusters, uint nthreads, bool begin)
+    : pClusters(clusters), pNThreads(nthreads), pBegin(begin) { }
+
+    void run(uint i, uint thread)
+    {
+        uint n = pClusters.countClusters();
+        uint c_end = (n * (i + 1)) / pNThreads;
+        for (uint c = (n * i) / pNThreads; c < c_end; ++c)
+        {
+            if (pBegin == true) pClusters.begin(c);
+            else if (pClusters.pending(c) == true) pClusters.simulate(c);
+        }
+    }
+
+private:
+    stex::Clusters                    & pClusters;
+    uint                                pNThreads;
+    bool                                pBegin;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Clusters::Clusters(stex::Tetexact * solver, uint nclusters,
+                         uint nthreads, double window)
+: pSolver(solver)
+, pNThreads(std::min(nthreads, nclusters))
+, pWindow(window)
+, pClusters()
+, pTetCluster()
+, pTriCluster()
+, pKProcCluster()
+, pKProcLocal()
+, pKProcCross()
+, pT0(0.0)
+, pT1(0.0)
+, pPending()
+, pSeed(0)
+, pNRuns(0.0)
+, pNRollbacks(0.0)
+{
+    assert(nclusters > 1);
+    if (solver->efflag() == true)
+    {
+        std::ostringstream os;
+        os << "Clusters are not available with EField calculation.";
+        throw steps::NotImplErr(os.str());
+    }
+    std::vector<stex::WmVol *> wmvols = solver->wmvolss();
+    for (uint i = 0; i < wmvols.size(); ++i)
+    {
+        if (wmvols[i] == 0) continue;
+        std::ostringstream os;
+        os << "Clusters are not available with well-mixed compartments.";
+        throw steps::NotImplErr(os.str());
+    }
+    if (window <= 0.0)
+    {
+        std::ostringstream os;
+        os << "Cluster window must be positive.";
+        throw steps::ArgErr(os.str());
+    }
+
+    std::vector<stex::Tet *> tets = solver->tets();
+    std::vector<stex::Tri *> tris = solver->tris();
+    pTetCluster = solver->mesh()->partitionTets(nclusters, solver->getTetLoads());
+    joinTriTets(solver, pTetCluster);
+
+    pClusters.resize(nclusters);
+    for (uint c = 0; c < nclusters; ++c)
+    {
+        pClusters[c].rng = 0;
+        pClusters[c].sched = 0;
+        pClusters[c].next = 0;
+        pClusters[c].time = 0.0;
+        pClusters[c].rollback = false;
+        pClusters[c].rollbackTime = 0.0;
+        pClusters[c].nevents = 0.0;
+    }
+    uint ntets = tets.size();
+    for (uint t = 0; t < ntets; ++t)
+    {
+        if (tets[t] != 0) pClusters[pTetCluster[t]].tets.push_back(tets[t]);
+    }
+    uint ntris = tris.size();
+    pTriCluster.assign(ntris, 0);
+    for (uint i = 0; i < ntris; ++i)
+    {
+        if (tris[i] == 0) continue;
+        int t = tris[i]->tet(0);
+        if (t < 0 || tets[t] == 0) t = tris[i]->tet(1);
+        assert(t >= 0 && tets[t] != 0);
+        pTriCluster[i] = pTetCluster[t];
+        pClusters[pTriCluster[i]].tris.push_back(tris[i]);
+    }
+
+    // The kprocs of each cluster, tet by tet and then tri by tri.
+    uint nkprocs = solver->countKProcs();
+    pKProcCluster.assign(nkprocs, 0);
+    pKProcLocal.assign(nkprocs, 0);
+    pKProcCross.assign(nkprocs, false);
+    for (uint c = 0; c < nclusters; ++c)
+    {
+        Cluster & cl = pClusters[c];
+        uint nctets = cl.tets.size();
+        for (uint t = 0; t < nctets; ++t)
+        {
+            stex::Tet * tet = cl.tets[t];
+            bool cross = false;
+            for (uint i = 0; i < 4; ++i)
+            {
+                stex::Tet * nb = tet->nextTet(i);
+                if (nb != 0 && pTetCluster[nb->idx()] != c) cross = true;
+            }
+            KProcPVecCI k_end = tet->kprocEnd();
+            for (KProcPVecCI k = tet->kprocBegin(); k != k_end; ++k)
+            {
+                uint sidx = (*k)->schedIDX();
+                pKProcCluster[sidx] = c;
+                pKProcLocal[sidx] = cl.kprocs.size();
+                pKProcCross[sidx] = cross && (*k)->type() == KP_DIFF;
+                cl.kprocs.push_back(*k);
+            }
+        }
+        uint nctris = cl.tris.size();
+        for (uint i = 0; i < nctris; ++i)
+        {
+            stex::Tri * tri = cl.tris[i];
+            bool cross = false;
+            for (uint j = 0; j < 3; ++j)
+            {
+                stex::Tri * nb = tri->nextTri(j);
+                if (nb != 0 && pTriCluster[nb->idx()] != c) cross = true;
+            }
+            KProcPVecCI k_end = tri->kprocEnd();
+            for (KProcPVecCI k = tri->kprocBegin(); k != k_end; ++k)
+            {
+                uint sidx = (*k)->schedIDX();
+                pKProcCluster[sidx] = c;
+                pKProcLocal[sidx] = cl.kprocs.size();
+                pKProcCross[sidx] = cross && (*k)->type() == KP_SDIFF;
+                cl.kprocs.push_back(*k);
+            }
+        }
+    }
+
+    // Only the diffusions flagged above may reach into another cluster.
+    for (uint c = 0; c < nclusters; ++c)
+    {
+        Cluster & cl = pClusters[c];
+        uint nck = cl.kprocs.size();
+        for (uint k = 0; k < nck; ++k)
+        {
+            stex::KProc * kp = cl.kprocs[k];
+            if (pKProcCross[kp->schedIDX()] == true) continue;
+            uint nlists = kp->countUpdLists();
+            for (uint l = 0; l < nlists; ++l)
+            {
+                KProcIdxSpan const & upd = kp->updList(l);
+                uint nupd = upd.size();
+                for (uint u = 0; u < nupd; ++u)
+                {
+                    if (pKProcCluster[upd[u]] == c) continue;
+                    std::ostringstream os;
+                    os << "A kinetic process couples two clusters.";
+                    throw steps::NotImplErr(os.str());
+                }
+            }
+        }
+
+        cl.rng = steps::rng::create("philox4x32", 512);
+        // A cluster schedules its kprocs one by one, even where the
+        // solver groups them by element.
+        cl.sched = sssa::createScheduler(solver->_baseScheduler()->getName(), cl.rng);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Clusters::~Clusters(void)
+{
+    uint nclusters = pClusters.size();
+    for (uint c = 0; c < nclusters; ++c)
+    {
+        delete pClusters[c].sched;
+        delete pClusters[c].rng;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::joinTriTets(stex::Tetexact const * solver,
+                                 std::vector<uint> & parts)
+{
+    // Join the two tets of every triangle (union-find), and give each
+    // group the cluster that holds most of its tets.
+    std::vector<stex::Tri *> tris = solver->tris();
+    std::vector<stex::Tet *> tets = solver->tets();
+    uint ntets = parts.size();
+    std::vector<uint> root(ntets);
+    for (uint t = 0; t < ntets; ++t) root[t] = t;
+
+    uint ntris = tris.size();
+    for (uint i = 0; i < ntris; ++i)
+    {
+        if (tris[i] == 0) continue;
+        int t0 = tris[i]->tet(0);
+        int t1 = tris[i]->tet(1);
+        if (t0 < 0 || t1 < 0 || tets[t0] == 0 || tets[t1] == 0) continue;
+        uint r0 = t0;
+        while (root[r0] != r0) r0 = root[r0] = root[root[r0]];
+        uint r1 = t1;
+        while (root[r1] != r1) r1 = root[r1] = root[root[r1]];
+        if (r0 < r1) root[r1] = r0;
+        else if (r1 < r0) root[r0] = r1;
+    }
+
+    // (group, cluster) of every tet, sorted, then counted per group.
+    std::vector<std::pair<uint, uint> > members(ntets);
+    for (uint t = 0; t < ntets; ++t)
+    {
+        uint r = t;
+        while (root[r] != r) r = root[r];
+        root[t] = r;
+        members[t] = std::make_pair(r, parts[t]);
+    }
+    std::sort(members.begin(), members.end());
+
+    std::vector<uint> best(ntets, 0);
+    uint nm = members.size();
+    uint i = 0;
+    while (i < nm)
+    {
+        uint r = members[i].first;
+        uint bestc = members[i].second;
+        uint bestn = 0;
+        while (i < nm && members[i].first == r)
+        {
+            uint c = members[i].second;
+            uint n = 0;
+            while (i < nm && members[i].first == r && members[i].second == c)
+            {
+                ++n;
+                ++i;
+            }
+            if (n > bestn)
+            {
+                bestn = n;
+                bestc = c;
+            }
+        }
+        best[r] = bestc;
+    }
+    for (uint t = 0; t < ntets; ++t) parts[t] = best[root[t]];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::CountJournal::undo(std::size_t n)
+{
+    pRecording = false;
+    while (pEntries.size() > n)
+    {
+        Entry const & e = pEntries.back();
+        if (e.vol != 0) e.vol->setCount(e.lidx, e.count);
+        else e.tri->setCount(e.lidx, e.count);
+        pEntries.pop_back();
+    }
+    pRecording = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Clusters::run(double endtime)
+{
+    double nevents = 0.0;
+    double t = pSolver->getTime();
+    uint nclusters = pClusters.size();
+    _begin(t);
+    while (t < endtime)
+    {
+        double t1 = std::min(t + pWindow, endtime);
+        _window(t, t1);
+        for (uint c = 0; c < nclusters; ++c) nevents += pClusters[c].nevents;
+        t = t1;
+    }
+    _end();
+    return nevents;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::_begin(double t)
+{
+    // The seed is drawn here so that it does not depend on the threads.
+    pSeed = pSolver->rng()->get();
+    pT0 = t;
+    ClusterLoop loop(*this, pNThreads, true);
+    steps::parallelFor(loop, pNThreads, pNThreads);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::begin(uint c)
+{
+    Cluster & cl = pClusters[c];
+    uint ntets = cl.tets.size();
+    for (uint i = 0; i < ntets; ++i) cl.tets[i]->setJournal(&cl.journal);
+    uint ntris = cl.tris.size();
+    for (uint i = 0; i < ntris; ++i) cl.tris[i]->setJournal(&cl.journal);
+
+    cl.rng->initializeStream(pSeed, c);
+    uint nkprocs = cl.kprocs.size();
+    cl.rates.resize(nkprocs);
+    for (uint k = 0; k < nkprocs; ++k)
+    {
+        cl.rates[k] = pSolver->_rate(cl.kprocs[k]);
+    }
+    _rebuild(cl, pT0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::_end(void)
+{
+    uint nclusters = pClusters.size();
+    for (uint c = 0; c < nclusters; ++c)
+    {
+        Cluster & cl = pClusters[c];
+        uint ntets = cl.tets.size();
+        for (uint i = 0; i < ntets; ++i) cl.tets[i]->setJournal(0);
+        uint ntris = cl.tris.size();
+        for (uint i = 0; i < ntris; ++i) cl.tris[i]->setJournal(0);
+        cl.journal.clear();
+        cl.ratelog.clear();
+        cl.items.clear();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::_rebuild(Cluster & cl, double t)
+{
+    uint nkprocs = cl.kprocs.size();
+    cl.sched->init(nkprocs);
+    for (uint k = 0; k < nkprocs; ++k) cl.sched->update(k, cl.rates[k], t);
+    cl.sched->commit(t);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::_window(double t0, double t1)
+{
+    pT0 = t0;
+    pT1 = t1;
+    uint nclusters = pClusters.size();
+    pPending.assign(nclusters, true);
+    uint npending = nclusters;
+    for (uint c = 0; c < nclusters; ++c)
+    {
+        Cluster & cl = pClusters[c];
+        cl.journal.clear();
+        cl.ratelog.clear();
+        cl.items.clear();
+        cl.inbox.clear();
+        cl.next = 0;
+        cl.outbox.clear();
+        cl.time = t0;
+        cl.rollback = false;
+        cl.nevents = 0.0;
+    }
+
+    std::vector<std::vector<Message> > inboxes(nclusters);
+    while (npending != 0)
+    {
+        ClusterLoop loop(*this, pNThreads, false);
+        steps::parallelFor(loop, pNThreads, pNThreads);
+        pNRuns += npending;
+
+        // Deliver the messages, in time order. A cluster whose messages
+        // changed rolls back to the first difference and goes again.
+        for (uint c = 0; c < nclusters; ++c) inboxes[c].clear();
+        for (uint c = 0; c < nclusters; ++c)
+        {
+            std::vector<Message> const & out = pClusters[c].outbox;
+            uint nout = out.size();
+            for (uint m = 0; m < nout; ++m) inboxes[out[m].dst].push_back(out[m]);
+        }
+        pPending.assign(nclusters, false);
+        npending = 0;
+        for (uint c = 0; c < nclusters; ++c)
+        {
+            Cluster & cl = pClusters[c];
+            std::vector<Message> & in = inboxes[c];
+            std::sort(in.begin(), in.end());
+            uint nnew = in.size();
+            uint nold = cl.inbox.size();
+            uint i = 0;
+            while (i < nnew && i < nold && in[i] == cl.inbox[i]) ++i;
+            if (i == nnew && i == nold) continue;
+
+            double t = pT1;
+            if (i < nnew) t = in[i].time;
+            if (i < nold) t = std::min(t, cl.inbox[i].time);
+            cl.inbox.swap(in);
+            cl.rollback = true;
+            cl.rollbackTime = t;
+            pPending[c] = true;
+            ++npending;
+            pNRollbacks += 1.0;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::_rollback(Cluster & cl, double t)
+{
+    // The next event is drawn afresh from the restored state, which is
+    // exact. A scheduler that keeps putative times is rebuilt, as those
+    // of the undone events do not hold any more.
+    bool rebuild = (cl.sched->getName() == "nrm");
+    uint n = cl.items.size();
+    while (n != 0 && cl.items[n - 1].time >= t) --n;
+    if (n != cl.items.size())
+    {
+        Item const & first = cl.items[n];
+        cl.journal.undo(first.ncounts);
+        while (cl.ratelog.size() > first.nrates)
+        {
+            std::pair<uint, double> const & r = cl.ratelog.back();
+            cl.rates[r.first] = r.second;
+            if (rebuild == false) cl.sched->update(r.first, r.second, t);
+            cl.ratelog.pop_back();
+        }
+        cl.outbox.resize(first.nout);
+        uint nitems = cl.items.size();
+        for (uint i = n; i < nitems; ++i)
+        {
+            stex::KProc * kp = cl.items[i].kproc;
+            if (kp == 0) continue;
+            kp->setExtent(kp->getExtent() - 1);
+            cl.nevents -= 1.0;
+        }
+        cl.items.resize(n);
+    }
+
+    if (rebuild == true) _rebuild(cl, t);
+    else cl.sched->commit(t);
+    cl.time = t;
+    Message m;
+    m.time = t;
+    m.src = 0;
+    m.seq = 0;
+    cl.next = std::lower_bound(cl.inbox.begin(), cl.inbox.end(), m) - cl.inbox.begin();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::simulate(uint c)
+{
+    Cluster & cl = pClusters[c];
+    if (cl.rollback == true)
+    {
+        if (cl.rollbackTime <= cl.time) _rollback(cl, cl.rollbackTime);
+        cl.rollback = false;
+    }
+
+    // A message preempts the event drawn past its time, which is then
+    // drawn again from the new state.
+    sssa::Scheduler * sched = cl.sched;
+    double t = cl.time;
+    uint nin = cl.inbox.size();
+    while (true)
+    {
+        double tnext = (cl.next < nin) ? cl.inbox[cl.next].time : pT1;
+        double dt = 0.0;
+        uint idx = sched->getNext(t, dt);
+        if (idx == sssa::SCHED_IDX_UNDEFINED || (t + dt) > tnext)
+        {
+            if (cl.next == nin) break;
+            t = tnext;
+            _deliver(c, cl.inbox[cl.next]);
+            ++cl.next;
+            continue;
+        }
+        _fire(c, idx, dt, t);
+        t += dt;
+        cl.nevents += 1.0;
+    }
+    cl.time = pT1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::_fire(uint c, uint idx, double dt, double t)
+{
+    Cluster & cl = pClusters[c];
+    stex::KProc * kp = cl.kprocs[idx];
+    Item it = { t + dt, kp, cl.journal.size(), cl.ratelog.size(), cl.outbox.size() };
+    cl.items.push_back(it);
+    if (pKProcCross[kp->schedIDX()] == false)
+    {
+        _update(c, kp->apply(cl.rng, dt, t), t + dt);
+        return;
+    }
+
+    uint dir = 0;
+    uint dst = c;
+    if (kp->type() == KP_DIFF)
+    {
+        stex::Diff * d = static_cast<stex::Diff *>(kp);
+        dir = d->applyOut(cl.rng);
+        dst = pTetCluster[d->neighb(dir)->idx()];
+        if (dst == c) d->applyIn(dir);
+    }
+    else
+    {
+        stex::SDiff * d = static_cast<stex::SDiff *>(kp);
+        dir = d->applyOut(cl.rng);
+        dst = pTriCluster[d->neighb(dir)->idx()];
+        if (dst == c) d->applyIn(dir);
+    }
+    if (dst != c)
+    {
+        Message msg;
+        msg.time = t + dt;
+        msg.src = c;
+        msg.seq = cl.outbox.size();
+        msg.dst = dst;
+        msg.kproc = kp;
+        msg.dir = dir;
+        cl.outbox.push_back(msg);
+    }
+    _update(c, kp->updList(dir), t + dt);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::_deliver(uint c, Message const & m)
+{
+    Cluster & cl = pClusters[c];
+    Item it = { m.time, 0, cl.journal.size(), cl.ratelog.size(), cl.outbox.size() };
+    cl.items.push_back(it);
+    if (m.kproc->type() == KP_DIFF)
+    {
+        static_cast<stex::Diff *>(m.kproc)->applyIn(m.dir);
+    }
+    else
+    {
+        static_cast<stex::SDiff *>(m.kproc)->applyIn(m.dir);
+    }
+    _update(c, m.kproc->updList(m.dir), m.time);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Clusters::_update(uint c, KProcIdxSpan const & upd, double t)
+{
+    Cluster & cl = pClusters[c];
+    sssa::Scheduler * sched = cl.sched;
+    uint nupd = upd.size();
+    for (uint i = 0; i < nupd; ++i)
+    {
+        uint sidx = upd[i];
+        if (pKProcCluster[sidx] != c) continue;
+        uint l = pKProcLocal[sidx];
+        double rate = pSolver->_rate(pSolver->kproc(sidx));
+        cl.ratelog.push_back(std::make_pair(l, cl.rates[l]));
+        cl.rates[l] = rate;
+        sched->update(l, rate, t);
+    }
+    sched->commit(t);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,356 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETEXACT_CLUSTERS_HPP
+#define STEPS_TETEXACT_CLUSTERS_HPP 1
+
+// STL headers.
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../rng/rng.hpp"
+#include "../solver/ssa/scheduler.hpp"
+#include "kproc.hpp"
+#include "tet.hpp"
+#include "tri.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetexact)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Forward declarations.
+class Tetexact;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The old counts of the count changes of a set of tetrahedrons and
+/// triangles, oldest first, so that the changes can be undone.
+///
+class CountJournal
+{
+
+public:
+
+    CountJournal(void)
+    : pEntries(), pRecording(true)
+    { }
+
+    inline void record(steps::tetexact::WmVol * vol, uint lidx, uint count)
+    {
+        if (pRecording == false) return;
+        Entry e = { vol, 0, lidx, count };
+        pEntries.push_back(e);
+    }
+
+    inline void record(steps::tetexact::Tri * tri, uint lidx, uint count)
+    {
+        if (pRecording == false) return;
+        Entry e = { 0, tri, lidx, count };
+        pEntries.push_back(e);
+    }
+
+    inline std::size_t size(void) const
+    { return pEntries.size(); }
+
+    inline void clear(void)
+    { pEntries.clear(); }
+
+    /// Undo the changes after the first n, newest first.
+    ///
+    void undo(std::size_t n);
+
+private:
+
+    struct Entry
+    {
+        steps::tetexact::WmVol                * vol;
+        steps::tetexact::Tri                  * tri;
+        uint                                    lidx;
+        uint                                    count;
+    };
+
+    std::vector<Entry>                  pEntries;
+    bool                                pRecording;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Runs the SSA of a Tetexact solver on spatial clusters of tetrahedrons
+/// in parallel, each cluster with its own scheduler and random number
+/// stream, synchronised optimistically (Time Warp).
+///
+/// The tetrahedrons are split with Tetmesh::partitionTets, weighted by
+/// Tetexact::getTetLoads, and the two tetrahedrons of every triangle are
+/// then put in the same cluster, with the triangle, so that only
+/// diffusion couples the clusters. Time is cut into windows. In a window
+/// each cluster simulates on its own, recording every molecule that
+/// diffuses out of it as a message stamped with its time, and journaling
+/// its count and propensity changes. The messages are then delivered and
+/// every cluster that got different ones rolls back to the time of its
+/// first new (or withdrawn) message, undoing its later events and
+/// withdrawing the messages they sent, and simulates on from there. The
+/// earliest change moves forward with every round and the window is done
+/// when no cluster gets new messages. Each cluster follows the SSA given
+/// its messages (a rollback redraws from the restored state, which is
+/// exact since the process is memoryless), so the result is an exact
+/// realisation, though not the one the serial solver would draw.
+///
+/// Cluster c draws from stream c of a seed taken from the solver's
+/// generator at the start of each run (RNG::initializeStream), so the
+/// streams never overlap. As the rounds are in lockstep and the messages
+/// are ordered by time and source, the result depends on the number of
+/// clusters but not on the number of threads.
+///
+/// The window bounds the journals and should be short enough that few
+/// molecules cross between clusters in one window, as every crossing may
+/// cost a round.
+///
+class Clusters
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Split the tetrahedrons of solver into nclusters clusters. Throws
+    /// steps::NotImplErr if the solver has well-mixed volumes or
+    /// computes the membrane potential.
+    ///
+    Clusters(steps::tetexact::Tetexact * solver, uint nclusters,
+             uint nthreads, double window);
+
+    ~Clusters(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    inline uint countClusters(void) const
+    { return pClusters.size(); }
+
+    inline uint getNThreads(void) const
+    { return pNThreads; }
+
+    inline double getWindow(void) const
+    { return pWindow; }
+
+    /// The number of tetrahedrons in cluster c.
+    ///
+    inline uint countTets(uint c) const
+    { return pClusters[c].tets.size(); }
+
+    /// The number of times a cluster simulated (part of) a window, and
+    /// of those that started with a rollback, since construction.
+    ///
+    inline double getNRuns(void) const
+    { return pNRuns; }
+
+    inline double getNRollbacks(void) const
+    { return pNRollbacks; }
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Run the SSA from the current time of the solver to endtime, and
+    /// return the number of events. The solver's own scheduler is left
+    /// untouched and has to be refreshed by the caller.
+    ///
+    double run(double endtime);
+
+    /// Give the elements of cluster c its journal and build its
+    /// scheduler; called by the thread that will simulate it, so that
+    /// its working memory is local to that thread.
+    ///
+    void begin(uint c);
+
+    /// Whether cluster c is to be simulated in the current round.
+    ///
+    inline bool pending(uint c) const
+    { return pPending[c]; }
+
+    /// Roll cluster c back if it got new messages and simulate it to the
+    /// end of the current window; called by the threads.
+    ///
+    void simulate(uint c);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Join the two tetrahedrons of every triangle of solver in parts, a
+    /// part of each tetrahedron: the tets that triangles link give one
+    /// group, which goes to the part holding most of its tets. Surface
+    /// processes then stay within a part. Also used by Domains.
+    ///
+    static void joinTriTets(steps::tetexact::Tetexact const * solver,
+                            std::vector<uint> & parts);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// A molecule diffusing between clusters: the Diff or SDiff kproc that
+    /// moved it, in which direction and when, with the source cluster and
+    /// the rank of the message there to order equal times.
+    ///
+    struct Message
+    {
+        double                                  time;
+        uint                                    src;
+        uint                                    seq;
+        uint                                    dst;
+        steps::tetexact::KProc                * kproc;
+        uint                                    dir;
+
+        bool operator<(Message const & m) const
+        {
+            if (time != m.time) return time < m.time;
+            if (src != m.src) return src < m.src;
+            return seq < m.seq;
+        }
+
+        bool operator==(Message const & m) const
+        { return time == m.time && kproc == m.kproc && dir == m.dir; }
+
+        bool operator!=(Message const & m) const
+        { return !(*this == m); }
+    };
+
+    /// An event (kproc != 0) or delivered message of a cluster, with the
+    /// sizes of its journal, rate log and outbox before it.
+    ///
+    struct Item
+    {
+        double                                  time;
+        steps::tetexact::KProc                * kproc;
+        std::size_t                             ncounts;
+        std::size_t                             nrates;
+        std::size_t                             nout;
+    };
+
+    struct Cluster
+    {
+        std::vector<steps::tetexact::Tet *>     tets;
+        std::vector<steps::tetexact::Tri *>     tris;
+        std::vector<steps::tetexact::KProc *>   kprocs;
+
+        steps::rng::RNG                       * rng;
+        steps::solver::ssa::Scheduler         * sched;
+
+        /// The propensity of each kproc, and the (kproc, old propensity)
+        /// of every change in the window.
+        std::vector<double>                     rates;
+        std::vector<std::pair<uint, double> >   ratelog;
+
+        CountJournal                            journal;
+        std::vector<Item>                       items;
+
+        /// The messages of the window, sorted, of which the first next
+        /// have been delivered, and the messages sent.
+        std::vector<Message>                    inbox;
+        uint                                    next;
+        std::vector<Message>                    outbox;
+
+        /// The time simulated to, and where to roll back to first.
+        double                                  time;
+        bool                                    rollback;
+        double                                  rollbackTime;
+
+        double                                  nevents;
+    };
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Set every cluster up with begin() at time t, each on its own
+    /// thread, and give the elements back no journal.
+    ///
+    void _begin(double t);
+    void _end(void);
+
+    void _window(double t0, double t1);
+
+    /// Undo the events and messages of cluster cl at or after time t.
+    ///
+    void _rollback(Cluster & cl, double t);
+
+    void _rebuild(Cluster & cl, double t);
+
+    /// Fire kproc idx of cluster c at time t, after dt.
+    ///
+    void _fire(uint c, uint idx, double dt, double t);
+
+    /// Put the molecule of message m into cluster c at its time.
+    ///
+    void _deliver(uint c, Message const & m);
+
+    /// Update the kprocs of cluster c among upd at time t.
+    ///
+    void _update(uint c, KProcIdxSpan const & upd, double t);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    steps::tetexact::Tetexact         * pSolver;
+    uint                                pNThreads;
+    double                              pWindow;
+
+    std::vector<Cluster>                pClusters;
+
+    // The cluster of each tet and tri (mesh index) and of each kproc
+    // (schedule index), the position of each kproc in its cluster, and
+    // whether a kproc is a diffusion with a neighbour in another cluster.
+    std::vector<uint>                   pTetCluster;
+    std::vector<uint>                   pTriCluster;
+    std::vector<uint>                   pKProcCluster;
+    std::vector<uint>                   pKProcLocal;
+    std::vector<bool>                   pKProcCross;
+
+    // The current window, the clusters to simulate in a round, and the
+    // seed of the random number streams of the clusters for a run.
+    double                              pT0;
+    double                              pT1;
+    std::vector<bool>                   pPending;
+    uint                                pSeed;
+
+    double                              pNRuns;
+    double                              pNRollbacks;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetexact)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETEXACT_CLUSTERS_HPP
+
+// END
@@ -30,6 +30,7 @@
 
 
 // Standard library & STL headers.
+#include <algorithm>
 #include <vector>
 
 // STEPS headers.
@@ -52,6 +53,8 @@ stex::Comp::Comp(steps::solver::Compdef * compdef)
 : pCompdef(compdef)
 , pVol(0.0)
 , pTets()
+, pCountTotalsOn(false)
+, pCountTotals()
 {
 	assert(pCompdef != 0);
 }
@@ -64,14 +67,14 @@ stex::Comp::~Comp(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Comp::checkpoint(std::fstream & cp_file)
+void stex::Comp::checkpoint(std::iostream & cp_file)
 {
     // reserve
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Comp::restore(std::fstream & cp_file)
+void stex::Comp::restore(std::iostream & cp_file)
 {
     // reserve
 }
@@ -97,6 +100,37 @@ void stex::Comp::modCount(uint slidx, double count)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void stex::Comp::setCountTotals(bool on)
+{
+	pCountTotalsOn = on;
+	pCountTotals.assign(on ? def()->countSpecs() : 0, 0.0);
+	double * totals = (on && !pCountTotals.empty()) ? &pCountTotals[0] : 0;
+	WmVolPVecCI t_end = pTets.end();
+	for (WmVolPVecCI t = pTets.begin(); t != t_end; ++t)
+	{
+		(*t)->setCountTotals(totals);
+	}
+	if (on) sumCountTotals();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Comp::sumCountTotals(void)
+{
+	uint nspecs = pCountTotals.size();
+	std::fill(pCountTotals.begin(), pCountTotals.end(), 0.0);
+	WmVolPVecCI t_end = pTets.end();
+	for (WmVolPVecCI t = pTets.begin(); t != t_end; ++t)
+	{
+		for (uint s = 0; s < nspecs; ++s)
+		{
+			pCountTotals[s] += (*t)->count(s);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 stex::WmVol * stex::Comp::pickTetByVol(double rand01) const
 {
 	if (countTets() == 0) return 0;
@@ -116,4 +150,14 @@ stex::WmVol * stex::Comp::pickTetByVol(double rand01) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t stex::Comp::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(Comp);
+    bytes += pTets.capacity() * sizeof(WmVol *);
+    bytes += pCountTotals.capacity() * sizeof(double);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
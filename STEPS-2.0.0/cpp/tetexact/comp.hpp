@@ -83,10 +83,15 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by the compartment and its tables,
+    /// not counting its volume elements.
+    ///
+    std::size_t getMemoryUsage(void) const;
 
     /// Checks whether the Tet's compdef() corresponds to this object's
     /// CompDef. There is no check whether the Tet object has already
@@ -114,6 +119,26 @@ public:
 
     void modCount(uint slidx, double count);
 
+    /// Keep a running total over the tets of the count of each species,
+    /// updated by the tets on every change, or stop. Turning it on sums
+    /// the current counts.
+    ///
+    void setCountTotals(bool on);
+
+    inline bool countTotals(void) const
+    { return pCountTotalsOn; }
+
+    /// The running total of local species slidx; only valid while
+    /// countTotals() is on.
+    ///
+    inline double countTotal(uint slidx) const
+    { return pCountTotals[slidx]; }
+
+    /// Sum the running totals afresh from the tets, after their counts
+    /// were changed in bulk (reset, restore).
+    ///
+    void sumCountTotals(void);
+
     inline uint countTets(void) const
     { return pTets.size(); }
 
@@ -135,6 +160,9 @@ private:
 
     WmVolPVec                                pTets;
 
+    bool                                     pCountTotalsOn;
+    std::vector<double>                      pCountTotals;
+
     ////////////////////////////////////////////////////////////////////////
 
 };
@@ -30,6 +30,7 @@
 
 // Standard library & STL headers.
 #include <vector>
+#include <cmath>
 
 // STEPS headers.
 #include "../common.h"
@@ -52,14 +53,17 @@ NAMESPACE_ALIAS(steps::math, smath);
 ////////////////////////////////////////////////////////////////////////////////
 
 stex::Diff::Diff(ssolver::Diffdef * ddef, stex::Tet * tet)
-: KProc()
+: KProc(stex::KP_DIFF)
 , pDiffdef(ddef)
 , pTet(tet)
 , pUpdVec()
+, pNeighbCompLidx()
 , pScaledDcst(0.0)
 , pDcst(0.0)
-, pCDFSelector()
-, pNeighbCompLidx()
+, pDirTable(0)
+, pBatched(false)
+, pLastDir(0)
+, pClosedDirs(0)
 {
 	assert(pDiffdef != 0);
 	assert(pTet != 0);
@@ -91,55 +95,12 @@ stex::Diff::Diff(ssolver::Diffdef * ddef, stex::Tet * tet)
         }
     }
 
+    for (uint i = 0; i < 4; ++i) { pDiffBndActive[i] = false; }
+    _setDirTable();
+
     // Precalculate part of the scaled diffusion constant.
 	uint ldidx = pTet->compdef()->diffG2L(pDiffdef->gidx());
-	double dcst = pTet->compdef()->dcst(ldidx);
-    pDcst = dcst;
-
-    double d[4] = { 0.0, 0.0, 0.0, 0.0 };
-    for (uint i = 0; i < 4; ++i)
-    {
-        // Compute the scaled diffusion constant.
-    	// Need to here check if the direction is a diffusion boundary
-        double dist = pTet->dist(i);
-        if ((dist > 0.0) && (next[i] != 0))
-        {
-        	if (pDiffBndDirection[i] == true)
-        	{
-        		if (pDiffBndActive[i]) d[i] = (pTet->area(i) * dcst) / (pTet->vol() * dist);
-        		else d[i] = 0.0;
-        	}
-        	else
-        	{
-        		// Bugfix 5/4/2012 IH: neighbouring tets in different compartments
-        		// NOT separated by a patch were allowing diffusion, even without diffusion boundary
-        		if (next[i]->compdef() == cdef)	d[i] = (pTet->area(i) * dcst) / (pTet->vol() * dist);
-        		else d[i] = 0;
-        	}
-        }
-    }
-    // Compute scaled "diffusion constant".
-    for (uint i = 0; i < 4; ++i)
-    {
-		pScaledDcst += d[i];
-	}
-
-    // Should not be negative!
-    assert(pScaledDcst >= 0);
-
-    // Setup the selector distribution.
-    if (pScaledDcst == 0.0)
-    {
-        pCDFSelector[0] = 0.0;
-        pCDFSelector[1] = 0.0;
-        pCDFSelector[2] = 0.0;
-    }
-    else
-    {
-        pCDFSelector[0] = d[0] / pScaledDcst;
-        pCDFSelector[1] = pCDFSelector[0] + (d[1] / pScaledDcst);
-        pCDFSelector[2] = pCDFSelector[1] + (d[2] / pScaledDcst);
-    }
+    setDcst(pTet->compdef()->dcst(ldidx));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -150,47 +111,43 @@ stex::Diff::~Diff(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Diff::checkpoint(std::fstream & cp_file)
+void stex::Diff::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&rExtent, sizeof(uint));
     cp_file.write((char*)&pFlags, sizeof(uint));
 
     cp_file.write((char*)&pScaledDcst, sizeof(double));
     cp_file.write((char*)&pDcst, sizeof(double));
-    cp_file.write((char*)pCDFSelector, sizeof(double) * 3);
+    cp_file.write((char*)pDirTable, sizeof(double) * 3);
     cp_file.write((char*)pDiffBndActive, sizeof(bool) * 4);
     cp_file.write((char*)pDiffBndDirection, sizeof(bool) * 4);
     cp_file.write((char*)pNeighbCompLidx, sizeof(int) * 4);
-
-    cp_file.write((char*)&(crData.recorded), sizeof(bool));
-    cp_file.write((char*)&(crData.pow), sizeof(int));
-    cp_file.write((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.write((char*)&(crData.rate), sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Diff::restore(std::fstream & cp_file)
+void stex::Diff::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&rExtent, sizeof(uint));
     cp_file.read((char*)&pFlags, sizeof(uint));
 
     cp_file.read((char*)&pScaledDcst, sizeof(double));
     cp_file.read((char*)&pDcst, sizeof(double));
-    cp_file.read((char*)pCDFSelector, sizeof(double) * 3);
+    // The selector is the tetrahedron's; skip the saved copy.
+    double cdf[3];
+    cp_file.read((char*)cdf, sizeof(double) * 3);
     cp_file.read((char*)pDiffBndActive, sizeof(bool) * 4);
     cp_file.read((char*)pDiffBndDirection, sizeof(bool) * 4);
     cp_file.read((char*)pNeighbCompLidx, sizeof(int) * 4);
 
-    cp_file.read((char*)&(crData.recorded), sizeof(bool));
-    cp_file.read((char*)&(crData.pow), sizeof(int));
-    cp_file.read((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.read((char*)&(crData.rate), sizeof(double));
+    // Rebuild the open directions from the restored boundary flags.
+    _setDirTable();
+    setDcst(pDcst);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Diff::setupDeps(void)
+void stex::Diff::setupDeps(stex::Arena & arena)
 {
     // We will check all KProcs of the following simulation elements:
     //   * the 'source' tetrahedron
@@ -206,33 +163,9 @@ void stex::Diff::setupDeps(void)
     // a triangle, there is no need to filter out duplicate dependent
     // kprocs.
 
-    // Search for dependencies in the 'source' tetrahedron.
-    std::set<stex::KProc*> local;
-    //std::set<stex::KProc*> local_objs;
-
-    KProcPVecCI kprocend = pTet->kprocEnd();
-    for (KProcPVecCI k = pTet->kprocBegin(); k != kprocend; ++k)
-    {
-        // Check locally.
-        if ((*k)->depSpecTet(ligGIdx, pTet) == true) {
-            //local.insert((*k)->getSSARef());
-            local.insert(*k);
-        }
-    }
-    // Check the neighbouring triangles.
-    for (uint i = 0; i < 4; ++i)
-    {
-        stex::Tri * next = pTet->nextTri(i);
-        if (next == 0) continue;
-        kprocend = next->kprocEnd();
-        for (KProcPVecCI k = next->kprocBegin(); k != kprocend; ++k)
-        {
-            if ((*k)->depSpecTet(ligGIdx, pTet) == true) {
-                //local.insert((*k)->getSSARef());
-                local.insert(*k);
-            }
-        }
-    }
+    // Dependencies in the 'source' tetrahedron and its triangles.
+    std::vector<stex::KProc*> local;
+    pTet->specDeps(ligGIdx, local);
 
     // Search for dependencies in neighbouring tetrahedra.
     for (uint i = 0; i < 4; ++i)
@@ -242,44 +175,12 @@ void stex::Diff::setupDeps(void)
         if (next == 0) continue;
         if (pTet->nextTri(i) != 0) continue;
 
-        // Copy local dependencies.
-        std::set<stex::KProc*> local2(local.begin(), local.end());
-        //std::set<stex::KProc*> local2_objs(local_objs.begin(), local_objs.end());
-
-        // Find the ones 'locally' in the next tet.
-        kprocend = next->kprocEnd();
-        for (KProcPVecCI k = next->kprocBegin(); k != kprocend; ++k)
-        {
-            if ((*k)->depSpecTet(ligGIdx, next) == true) {
-                //local.insert((*k)->getSSARef());
-                local2.insert(*k);
-            }
-        }
-
-        // Find deps in neighbouring triangles in the next tet.
-        // As said before, this cannot logically include the shared
-        // triangle.
-        for (uint j = 0; j < 4; ++j)
-        {
-            // Fetch next triangle, if it exists.
-            stex::Tri * next2 = next->nextTri(j);
-            if (next2 == 0) continue;
-
-            // Find deps.
-            kprocend = next2->kprocEnd();
-            for (KProcPVecCI k = next2->kprocBegin(); k != kprocend; ++k)
-            {
-                if ((*k)->depSpecTet(ligGIdx, next) == true) {
-                    //local.insert((*k)->getSSARef());
-                    local2.insert(*k);
-                }
-            }
-        }
-
-        // Copy the set to the update vector.
-        pUpdVec[i].assign(local2.begin(), local2.end());
-        //pUpdObjVec[i].assign(local2_objs.begin(), local2_objs.end());
+        // Add the ones in the next tet and its triangles. As said
+        // before, these cannot logically include the shared triangle.
+        std::vector<stex::KProc*> local2(local);
+        next->specDeps(ligGIdx, local2);
 
+        pUpdVec[i] = _pack(arena, local2);
     }
 }
 
@@ -301,6 +202,20 @@ bool stex::Diff::depSpecTri(uint gidx, stex::Tri * tri)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void stex::Diff::depSpecsTet(stex::WmVol * tet, std::vector<uint> & lidxs)
+{
+    if (pTet != tet) return;
+    lidxs.push_back(pTet->compdef()->specG2L(ligGIdx));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Diff::depSpecsTri(stex::Tri * tri, std::vector<uint> & lidxs)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void stex::Diff::reset(void)
 {
     resetExtent();
@@ -310,17 +225,15 @@ void stex::Diff::reset(void)
     pDiffBndActive[1] = false;
     pDiffBndActive[2] = false;
     pDiffBndActive[3] = false;
+    pClosedDirs = 0;
+    _setDirTable();
 
     uint ldidx = pTet->compdef()->diffG2L(pDiffdef->gidx());
 	double dcst = pTet->compdef()->dcst(ldidx);
     setDcst(dcst);
 
     setActive(true);
-
-    crData.recorded = false;
-    crData.pow = 0;
-    crData.pos = 0;
-    crData.rate = 0.0;
+    pBatched = false;
 
 }
 
@@ -335,6 +248,7 @@ void stex::Diff::setDiffBndActive(uint i, bool active)
 	if (pDiffBndActive[i] != active)
 	{
 		pDiffBndActive[i] = active;
+		_setDirTable();
 		setDcst(pDcst);
 	}
 
@@ -342,6 +256,17 @@ void stex::Diff::setDiffBndActive(uint i, bool active)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void stex::Diff::setClosedDirs(uint mask)
+{
+	assert(mask < 16);
+	if (pClosedDirs == mask) return;
+	pClosedDirs = mask;
+	_setDirTable();
+	setDcst(pDcst);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool stex::Diff::getDiffBndActive(uint i) const
 {
 	assert (i < 4);
@@ -356,197 +281,240 @@ void stex::Diff::setDcst(double dcst)
 {
 	assert(dcst >= 0.0);
 	pDcst = dcst;
+	rModified = true;
 
-	stex::Tet * next[4] =
-	{
-		pTet->nextTet(0),
-		pTet->nextTet(1),
-		pTet->nextTet(2),
-		pTet->nextTet(3)
-	};
+    // The geometry and the state of the diffusion boundaries are in the
+    // tetrahedron's table, shared by all species, so a new constant
+    // only rescales the rate.
+    pScaledDcst = dcst * pDirTable[3];
+    assert(pScaledDcst >= 0.0);
+}
 
-    double d[4] = { 0.0, 0.0, 0.0, 0.0 };
+////////////////////////////////////////////////////////////////////////////////
 
-    for (uint i = 0; i < 4; ++i)
+stex::KProcIdxSpan stex::Diff::apply(steps::rng::RNG * rng, double dt, double simtime)
+{
+    // Apply local change.
+	bool clamped = pTet->clamped(lidxTet);
+
+    if (clamped == false)
     {
-        // Compute the scaled diffusion constant.
-    	// Need to here check if the direction is a diffusion boundary
-        double dist = pTet->dist(i);
-        if ((dist > 0.0) && (next[i] != 0))
-        {
-        	if (pDiffBndDirection[i] == true)
-        	{
-        		if (pDiffBndActive[i]) d[i] = (pTet->area(i) * dcst) / (pTet->vol() * dist);
-        		else d[i] = 0.0;
-        	}
-        	else
-        	{
-        		// Bugfix 5/4/2012 IH: neighbouring tets in different compartments
-        		// NOT separated by a patch were allowing diffusion, even without diffusion boundary
-        		if (next[i]->compdef() == pTet->compdef())	d[i] = (pTet->area(i) * dcst) / (pTet->vol() * dist);
-        		else d[i] = 0;
-        	}
-         }
+        assert(pTet->count(lidxTet) > 0);
     }
 
-    // Compute scaled "diffusion constant".
-    pScaledDcst = 0.0;
-
-    for (uint i = 0; i < 4; ++i)
-    {
-    	pScaledDcst += d[i];
-	}
-    // Should not be negative!
-    assert(pScaledDcst >= 0);
+    // Apply change in next voxel: select a direction. The selector is
+    // non-decreasing, so the direction is the number of its entries at
+    // or below sel; closed directions have zero width.
+    double sel = rng->getUnfEE();
+    double const * cdf = pDirTable;
+    uint dir = (sel >= cdf[0]) + (sel >= cdf[1]) + (sel >= cdf[2]);
+    stex::Tet * nexttet = pTet->nextTet(dir);
+    assert(nexttet != 0);
 
-    // Setup the selector distribution.
-    if (pScaledDcst == 0.0)
+    uint nlidx = pNeighbCompLidx[dir];
+    if (nexttet->clamped(nlidx) == false)
     {
-        pCDFSelector[0] = 0.0;
-        pCDFSelector[1] = 0.0;
-        pCDFSelector[2] = 0.0;
-    }
-    else
-    {
-        pCDFSelector[0] = d[0] / pScaledDcst;
-        pCDFSelector[1] = pCDFSelector[0] + (d[1] / pScaledDcst);
-        pCDFSelector[2] = pCDFSelector[1] + (d[2] / pScaledDcst);
+        nexttet->incCount(nlidx, 1);
     }
+    if (clamped == false) {pTet->incCount(lidxTet, -1); }
+
+    pLastDir = dir;
+    rExtent++;
+    rModified = true;
+
+    return pUpdVec[dir];
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Diff::rate(steps::tetexact::Tetexact * solver)
+uint stex::Diff::applyOut(steps::rng::RNG * rng)
 {
-    if (inactive()) return 0.0;
+    double sel = rng->getUnfEE();
+    double const * cdf = pDirTable;
+    uint dir = (sel >= cdf[0]) + (sel >= cdf[1]) + (sel >= cdf[2]);
+    assert(neighb(dir) != 0);
+
+    if (pTet->clamped(lidxTet) == false) pTet->incCount(lidxTet, -1);
+    pLastDir = dir;
+    rExtent++;
+    rModified = true;
+    return dir;
+}
 
-    // Compute the rate.
-    double rate = (pScaledDcst) * static_cast<double>(pTet->pools()[lidxTet]);
-    assert(std::isnan(rate) == false);
+////////////////////////////////////////////////////////////////////////////////
 
-    // Return.
-    return rate;
+void stex::Diff::applyIn(uint dir)
+{
+    stex::Tet * nexttet = pTet->nextTet(dir);
+    uint nlidx = pNeighbCompLidx[dir];
+    if (nexttet->clamped(nlidx) == false) nexttet->incCount(nlidx, 1);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::vector<stex::KProc*> const & stex::Diff::apply(steps::rng::RNG * rng, double dt, double simtime)
+uint stex::Diff::updVecSize(void) const
 {
-    //uint lidxTet = this->lidxTet;
-    // Pre-fetch some general info.
-
+	uint maxsize = pUpdVec[0].size();
+	for (uint i=1; i <= 3; ++i)
+	{
+		if (pUpdVec[i].size() > maxsize) maxsize = pUpdVec[i].size();
+	}
+	return maxsize;
+}
 
-    // Apply local change.
-    uint * local = pTet->pools() + lidxTet;
-	bool clamped = pTet->clamped(lidxTet);
+////////////////////////////////////////////////////////////////////////////////
 
-    if (clamped == false)
+bool stex::Diff::leapStoich(std::vector<stex::LeapTerm> & lhs,
+                            std::vector<stex::LeapTerm> & upd) const
+{
+    LeapTerm src_l = {pTet, lidxTet, 1.0, 0.0, true};
+    lhs.push_back(src_l);
+    LeapTerm src_u = {pTet, lidxTet, -1.0, 1.0, true};
+    upd.push_back(src_u);
+
+    if (pScaledDcst == 0.0) return true;
+
+    // Each molecule goes to neighbour i with probability p[i], so the
+    // number arriving there in a leap is Poisson with mean and variance
+    // p[i] times those of the number of hops.
+    double p[4];
+    _dirProbs(p);
+    for (uint i = 0; i < 4; ++i)
     {
-        assert(*local > 0);
+        if (p[i] <= 0.0) continue;
+        LeapTerm dst = {pTet->nextTet(i), static_cast<uint>(pNeighbCompLidx[i]), p[i], p[i], false};
+        upd.push_back(dst);
     }
+    return true;
+}
 
-    // Apply change in next voxel: select a direction.
-    double sel = rng->getUnfEE();
+////////////////////////////////////////////////////////////////////////////////
 
-    if (sel < pCDFSelector[0])
+void stex::Diff::_dirProbs(double * p) const
+{
+    if (pDirTable[3] == 0.0)
     {
+        p[0] = p[1] = p[2] = p[3] = 0.0;
+        return;
+    }
+    p[0] = pDirTable[0];
+    p[1] = pDirTable[1] - pDirTable[0];
+    p[2] = pDirTable[2] - pDirTable[1];
+    p[3] = 1.0 - pDirTable[2];
+}
 
-        // Direction 1.
-        stex::Tet * nexttet = pTet->nextTet(0);
-        // If there is no next tet 0, pCDFSelector[0] should be zero
-        // So we can assert that nextet 0 does indeed exist
-        assert (nexttet != 0);
-        assert(pNeighbCompLidx[0] > -1);
+////////////////////////////////////////////////////////////////////////////////
 
-        if (nexttet->clamped(pNeighbCompLidx[0]) == false)
+void stex::Diff::_setDirTable(void)
+{
+    uint bndopen = 0;
+    for (uint i = 0; i < 4; ++i)
+    {
+        if (pDiffBndDirection[i] == true && pDiffBndActive[i] == true)
         {
-            nexttet->incCount(pNeighbCompLidx[0],1);
+            bndopen |= (1 << i);
         }
-        if (clamped == false) {pTet->incCount(lidxTet, -1); }
-
-        rExtent++;
-
-        return pUpdVec[0];
     }
-    else if (sel < pCDFSelector[1])
-    {
-
-        // Direction 2.
-        stex::Tet * nexttet = pTet->nextTet(1);
-        // If there is no next tet 1, pCDFSelector[1] should be zero
-        // So we can assert that nextet 1 does indeed exist
-        assert (nexttet != 0);
-        assert(pNeighbCompLidx[1] > -1);
+    pDirTable = pTet->diffTable(bndopen);
 
-        if (nexttet->clamped(pNeighbCompLidx[1]) == false)
+    if (pClosedDirs != 0)
+    {
+        // Drop the closed directions from the tetrahedron's row and
+        // rescale the others; the last open direction takes the
+        // selector up to exactly 1.
+        double p[4];
+        _dirProbs(p);
+        double open = 0.0;
+        uint last = 4;
+        for (uint i = 0; i < 4; ++i)
+        {
+            if ((pClosedDirs & (1 << i)) != 0) p[i] = 0.0;
+            open += p[i];
+            if (p[i] > 0.0) last = i;
+        }
+        double cum = 0.0;
+        for (uint i = 0; i < 3; ++i)
         {
-            nexttet->incCount(pNeighbCompLidx[1],1);
+            if (open > 0.0) cum += p[i] / open;
+            pClosedTable[i] = (i >= last) ? 1.0 : cum;
         }
+        pClosedTable[3] = pDirTable[3] * open;
+        pDirTable = pClosedTable;
+    }
 
-        if (clamped == false) {pTet->incCount(lidxTet, -1); }
+#ifndef NDEBUG
+    double p[4];
+    _dirProbs(p);
+    for (uint i = 0; i < 4; ++i)
+    {
+        if (p[i] > 0.0) assert(pNeighbCompLidx[i] > -1);
+    }
+#endif
+}
 
-        rExtent++;
+////////////////////////////////////////////////////////////////////////////////
 
-        return pUpdVec[1];
-    }
-    else if (sel < pCDFSelector[2])
-    {
+stex::Tet * stex::Diff::neighb(uint dir) const
+{
+    assert(dir < 4);
+    double p[4];
+    _dirProbs(p);
+    return (p[dir] > 0.0) ? pTet->nextTet(dir) : 0;
+}
 
-        // Direction 3.
-        stex::Tet * nexttet = pTet->nextTet(2);
-        // If there is no next tet 2, pCDFSelector[2] should be zero
-        // So we can assert that nextet 2 does indeed exist
-        assert (nexttet != 0);
-        assert(pNeighbCompLidx[2] > -1);
-        if (nexttet->clamped(pNeighbCompLidx[2]) == false)
-        {
-            nexttet->incCount(pNeighbCompLidx[2],1);
-        }
+////////////////////////////////////////////////////////////////////////////////
 
-        if (clamped == false) {pTet->incCount(lidxTet, -1); }
+void stex::Diff::applyN(steps::rng::RNG * rng, uint n, double dt, double simtime)
+{
+    if (n == 0) return;
+    if (pTet->clamped(lidxTet) == false)
+    {
+        assert(pTet->count(lidxTet) >= n);
+        pTet->incCount(lidxTet, -static_cast<int>(n));
+    }
 
-        rExtent++;
-        return pUpdVec[2];
+    // Multinomial split as a chain of binomials, each direction taking
+    // its share of what the previous ones left and the last open
+    // direction taking the rest.
+    double p[4];
+    _dirProbs(p);
+    uint last = 0;
+    for (uint i = 0; i < 4; ++i)
+    {
+        if (p[i] > 0.0) last = i;
     }
-    else
+    uint left = n;
+    double pleft = 1.0;
+    for (uint i = 0; i < 4 && left > 0; ++i)
     {
-
-        // Direction 4.
-        stex::Tet * nexttet = pTet->nextTet(3);
-        // If there is no next tet 3, pCDFSelector[3] should be zero
-        // So we can assert that nextet 3 does indeed exist
-        assert (nexttet != 0);
-        assert(pNeighbCompLidx[3] > -1);
-
-        if (nexttet->clamped(pNeighbCompLidx[3]) == false)
+        if (p[i] <= 0.0) continue;
+        uint ni = (i == last || p[i] >= pleft) ? left : rng->getBinom(left, p[i] / pleft);
+        pleft -= p[i];
+        left -= ni;
+        if (ni == 0) continue;
+        stex::Tet * nexttet = pTet->nextTet(i);
+        if (nexttet->clamped(pNeighbCompLidx[i]) == false)
         {
-            nexttet->incCount(pNeighbCompLidx[3],1);
+            nexttet->incCount(pNeighbCompLidx[i], ni);
         }
-        if (clamped == false) {pTet->incCount(lidxTet, -1); }
-
-        rExtent++;
-
-        return pUpdVec[3];
-
     }
+    rExtent += n;
+    rModified = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
 
-    // This should never happen!
-    assert(0);
-    std::cerr << "Cannot find a suitable direction for diffusion!\n";
-    throw;
-    return pUpdVec[0];
+uint stex::Diff::count(void) const
+{
+    return pTet->count(lidxTet);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-uint stex::Diff::updVecSize(void) const
+uint stex::Diff::sampleBatch(steps::rng::RNG * rng, double dt) const
 {
-	uint maxsize = pUpdVec[0].size();
-	for (uint i=1; i <= 3; ++i)
-	{
-		if (pUpdVec[i].size() > maxsize) maxsize = pUpdVec[i].size();
-	}
-	return maxsize;
+    if (inactive() || pScaledDcst == 0.0) return 0;
+    return rng->getBinom(count(), 1.0 - std::exp(-pScaledDcst * dt));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -37,6 +37,8 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <cassert>
+#include <cmath>
 
 // STEPS headers.
 #include "../common.h"
@@ -76,10 +78,10 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
 
     ////////////////////////////////////////////////////////////////////////
     // VIRTUAL INTERFACE METHODS
@@ -92,15 +94,100 @@ public:
     { return pDcst; }
     void setDcst(double d);
 
-    void setupDeps(void);
+    void setupDeps(steps::tetexact::Arena & arena);
     bool depSpecTet(uint gidx, steps::tetexact::WmVol * tet);
     bool depSpecTri(uint gidx, steps::tetexact::Tri * tri);
+    void depSpecsTet(steps::tetexact::WmVol * tet, std::vector<uint> & lidxs);
+    void depSpecsTri(steps::tetexact::Tri * tri, std::vector<uint> & lidxs);
     void reset(void);
-    double rate(steps::tetexact::Tetexact * solver = 0);
-    std::vector<KProc*> const & apply(steps::rng::RNG * rng, double dt, double simtime);
+    inline double rate(steps::tetexact::Tetexact * solver = 0)
+    {
+        if (inactive() || pBatched) return 0.0;
+        double rate = pScaledDcst * static_cast<double>(pTet->count(lidxTet));
+        assert(std::isnan(rate) == false);
+        return rate;
+    }
+    steps::tetexact::KProcIdxSpan apply(steps::rng::RNG * rng, double dt, double simtime);
 
     uint updVecSize(void) const;
 
+    uint countUpdLists(void) const
+    { return 4; }
+
+    steps::tetexact::KProcIdxSpan & updList(uint i)
+    { return pUpdVec[i]; }
+
+    bool leapStoich(std::vector<steps::tetexact::LeapTerm> & lhs,
+                    std::vector<steps::tetexact::LeapTerm> & upd) const;
+
+    /// Move n molecules at once, split multinomially over the neighbours.
+    ///
+    void applyN(steps::rng::RNG * rng, uint n, double dt, double simtime);
+
+    ////////////////////////////////////////////////////////////////////////
+    // BATCHED DIFFUSION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// While batched, the rate is zero so the SSA ignores this kproc, and
+    /// the solver moves its molecules with sampleBatch() and applyN() at
+    /// the end of fixed time windows instead.
+    ///
+    inline bool batched(void) const
+    { return pBatched; }
+    inline void setBatched(bool b)
+    { pBatched = b; }
+
+    /// Number of molecules of the diffusing species in the tetrahedron.
+    ///
+    uint count(void) const;
+
+    /// Draw the number of molecules that leave the tetrahedron in a
+    /// window of length dt, each leaving independently with probability
+    /// 1 - exp(-d dt).
+    ///
+    uint sampleBatch(steps::rng::RNG * rng, double dt) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // SPLIT MOVES
+    ////////////////////////////////////////////////////////////////////////
+
+    /// The first half of apply(): select a direction, take the molecule
+    /// out of the tetrahedron and return the direction. Followed by
+    /// applyIn(dir), this does what apply() does with the same random
+    /// numbers; in between, the molecule can be handed to the thread or
+    /// rank that owns the neighbour (see Clusters and Domains).
+    ///
+    uint applyOut(steps::rng::RNG * rng);
+
+    /// The second half of apply(): put the molecule into the neighbour
+    /// in direction dir.
+    ///
+    void applyIn(uint dir);
+
+    /// The direction of the last molecule moved by apply() or applyOut().
+    ///
+    inline uint lastDir(void) const
+    { return pLastDir; }
+
+    /// The neighbour in direction dir, 0 if that direction is closed.
+    ///
+    steps::tetexact::Tet * neighb(uint dir) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // COARSE-GRAINING
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Close the directions in mask (bit i for direction i) on top of
+    /// the diffusion boundaries, leaving the rate to the other
+    /// directions unchanged; 0 opens them again. Used by the
+    /// coarse-grained mode of Tetexact for the faces inside a merged
+    /// group of tetrahedrons.
+    ///
+    void setClosedDirs(uint mask);
+
+    inline uint closedDirs(void) const
+    { return pClosedDirs; }
+
     ////////////////////////////////////////////////////////////////////////
 
     void setDiffBndActive(uint i, bool active);
@@ -122,7 +209,7 @@ private:
     uint                                lidxTet;
     steps::solver::Diffdef            * pDiffdef;
     steps::tetexact::Tet              * pTet;
-    std::vector<KProc*>                 pUpdVec[4];
+    steps::tetexact::KProcIdxSpan         pUpdVec[4];
 
     // Storing the species local index for each neighbouring tet: Needed
     // because neighbours may belong to different compartments
@@ -133,8 +220,10 @@ private:
     double                              pScaledDcst;
     // Compartmental dcst. Stored for convenience
     double                              pDcst;
-    /// Used in selecting which directory the molecule should go.
-    double                              pCDFSelector[3];
+    /// The row of the tetrahedron's diffusion table for the current
+    /// state of the diffusion boundaries (see Tet::diffTable): the
+    /// direction selector, and the geometric factor of pScaledDcst.
+    double const                      * pDirTable;
 
     // A flag to see if the species can move between compartments
     bool 								pDiffBndActive[4];
@@ -142,6 +231,23 @@ private:
     // Flags to store if a direction is a diffusion boundary direction
     bool 							    pDiffBndDirection[4];
 
+    // Whether the molecules are moved in batches (see setBatched).
+    bool                                pBatched;
+
+    // The direction of the last move (see lastDir).
+    unsigned char                       pLastDir;
+
+    // The directions closed by setClosedDirs, and the row of pDirTable
+    // while any are.
+    unsigned char                       pClosedDirs;
+    double                              pClosedTable[4];
+
+    // Fill p with the probability of each of the four directions.
+    void _dirProbs(double * p) const;
+
+    // Point pDirTable at the row for the open diffusion boundaries.
+    void _setDirTable(void);
+
     ////////////////////////////////////////////////////////////////////////
 
 };
@@ -58,14 +58,14 @@ stex::DiffBoundary::~DiffBoundary(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::DiffBoundary::checkpoint(std::fstream & cp_file)
+void stex::DiffBoundary::checkpoint(std::iostream & cp_file)
 {
     // reserve
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::DiffBoundary::restore(std::fstream & cp_file)
+void stex::DiffBoundary::restore(std::iostream & cp_file)
 {
     // reserve
 }
@@ -112,5 +112,14 @@ void stex::DiffBoundary::setTetDirection(uint tet, uint direction)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t stex::DiffBoundary::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(DiffBoundary);
+    bytes += (pTets.capacity() + pTetDirection.capacity()) * sizeof(uint);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
 
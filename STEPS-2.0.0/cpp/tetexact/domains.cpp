@@ -0,0 +1,551 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <vector>
+
+#ifdef STEPS_USE_MPI
+// MPI headers.
+#include <mpi.h>
+#endif
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "../mpi.hpp"
+#include "../geom/tetmesh.hpp"
+#include "clusters.hpp"
+#include "diff.hpp"
+#include "domains.hpp"
+#include "sdiff.hpp"
+#include "tetexact.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::tetexact, stex);
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Message tag of the molecules a rank sends a neighbour at the end of a
+// window, as (kproc schedule index, direction) pairs.
+#define DOMAINS_TAG_MOLECULES           1
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct stex::Domains::Comm
+{
+#ifdef STEPS_USE_MPI
+    MPI_Comm                            comm;
+#endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef STEPS_USE_MPI
+// The data of v for MPI, which does not touch it if v is empty.
+static uint * bufferOf(std::vector<uint> & v)
+{
+    return v.empty() ? 0 : &v[0];
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Domains::Domains(stex::Tetexact * solver, double window)
+: pSolver(solver)
+, pWindow(window)
+, pComm(0)
+, pRank(0)
+, pNRanks(1)
+, pTetRank()
+, pTriRank()
+, pKProcRank()
+, pKProcLocal()
+, pKProcCross()
+, pRankTetStart()
+, pRankTets()
+, pRankTriStart()
+, pRankTris()
+, pRankKProcStart()
+, pRankKProcs()
+, pStateSize()
+, pHalo()
+, pNeighbs()
+, pNeighbIdx()
+, pOutbox()
+, pKProcs()
+, pRates()
+, pRNG(0)
+, pSched(0)
+, pNEvents(0.0)
+, pNMessages(0.0)
+, pNWindows(0.0)
+{
+    if (solver->efflag() == true)
+    {
+        std::ostringstream os;
+        os << "Domains are not available with EField calculation.";
+        throw steps::NotImplErr(os.str());
+    }
+    std::vector<stex::WmVol *> wmvols = solver->wmvolss();
+    for (uint i = 0; i < wmvols.size(); ++i)
+    {
+        if (wmvols[i] == 0) continue;
+        std::ostringstream os;
+        os << "Domains are not available with well-mixed compartments.";
+        throw steps::NotImplErr(os.str());
+    }
+    if (window <= 0.0)
+    {
+        std::ostringstream os;
+        os << "Domain window must be positive.";
+        throw steps::ArgErr(os.str());
+    }
+
+steps::initMPI();
+#ifdef STEPS_USE_MPI
+    int rank = 0;
+    int nranks = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+    pRank = rank;
+    pNRanks = nranks;
+#endif
+
+    // Every rank makes the same partition.
+    std::vector<stex::Tet *> tets = solver->tets();
+    std::vector<stex::Tri *> tris = solver->tris();
+    uint ntets = tets.size();
+    uint ntris = tris.size();
+    if (pNRanks > 1)
+    {
+        pTetRank = solver->mesh()->partitionTets(pNRanks, solver->getTetLoads());
+        stex::Clusters::joinTriTets(solver, pTetRank);
+    }
+    else
+    {
+        pTetRank.assign(ntets, 0);
+    }
+    pTriRank.assign(ntris, 0);
+    for (uint i = 0; i < ntris; ++i)
+    {
+        if (tris[i] == 0) continue;
+        int t = tris[i]->tet(0);
+        if (t < 0 || tets[t] == 0) t = tris[i]->tet(1);
+        assert(t >= 0 && tets[t] != 0);
+        pTriRank[i] = pTetRank[t];
+    }
+
+    // The elements and kprocs of each rank, tet by tet and then tri by
+    // tri, and the size of their counts and extents.
+    uint nkprocs = solver->countKProcs();
+    pKProcRank.assign(nkprocs, 0);
+    pKProcLocal.assign(nkprocs, 0);
+    pKProcCross.assign(nkprocs, false);
+    pRankTetStart.assign(pNRanks + 1, 0);
+    pRankTriStart.assign(pNRanks + 1, 0);
+    pRankKProcStart.assign(pNRanks + 1, 0);
+    pStateSize.assign(pNRanks, 0);
+    for (uint r = 0; r < pNRanks; ++r)
+    {
+        uint k0 = pRankKProcs.size();
+        int size = 0;
+        for (uint t = 0; t < ntets; ++t)
+        {
+            stex::Tet * tet = tets[t];
+            if (tet == 0 || pTetRank[t] != r) continue;
+            pRankTets.push_back(tet);
+            size += tet->compdef()->countSpecs();
+            bool cross = false;
+            for (uint i = 0; i < 4; ++i)
+            {
+                stex::Tet * nb = tet->nextTet(i);
+                if (nb != 0 && pTetRank[nb->idx()] != r) cross = true;
+            }
+            KProcPVecCI k_end = tet->kprocEnd();
+            for (KProcPVecCI k = tet->kprocBegin(); k != k_end; ++k)
+            {
+                uint sidx = (*k)->schedIDX();
+                pKProcRank[sidx] = r;
+                pKProcLocal[sidx] = pRankKProcs.size() - k0;
+                pKProcCross[sidx] = cross && (*k)->type() == KP_DIFF;
+                pRankKProcs.push_back(*k);
+            }
+        }
+        for (uint i = 0; i < ntris; ++i)
+        {
+            stex::Tri * tri = tris[i];
+            if (tri == 0 || pTriRank[i] != r) continue;
+            pRankTris.push_back(tri);
+            size += tri->patchdef()->countSpecs();
+            bool cross = false;
+            for (uint j = 0; j < 3; ++j)
+            {
+                stex::Tri * nb = tri->nextTri(j);
+                if (nb != 0 && pTriRank[nb->idx()] != r) cross = true;
+            }
+            KProcPVecCI k_end = tri->kprocEnd();
+            for (KProcPVecCI k = tri->kprocBegin(); k != k_end; ++k)
+            {
+                uint sidx = (*k)->schedIDX();
+                pKProcRank[sidx] = r;
+                pKProcLocal[sidx] = pRankKProcs.size() - k0;
+                pKProcCross[sidx] = cross && (*k)->type() == KP_SDIFF;
+                pRankKProcs.push_back(*k);
+            }
+        }
+        pRankTetStart[r + 1] = pRankTets.size();
+        pRankTriStart[r + 1] = pRankTris.size();
+        pRankKProcStart[r + 1] = pRankKProcs.size();
+        pStateSize[r] = size + (pRankKProcs.size() - k0);
+    }
+
+    // Only the diffusions flagged above may reach into another domain.
+    uint nrkprocs = pRankKProcs.size();
+    for (uint k = 0; k < nrkprocs; ++k)
+    {
+        stex::KProc * kp = pRankKProcs[k];
+        uint r = pKProcRank[kp->schedIDX()];
+        if (pKProcCross[kp->schedIDX()] == true) continue;
+        uint nlists = kp->countUpdLists();
+        for (uint l = 0; l < nlists; ++l)
+        {
+            KProcIdxSpan const & upd = kp->updList(l);
+            uint nupd = upd.size();
+            for (uint u = 0; u < nupd; ++u)
+            {
+                if (pKProcRank[upd[u]] == r) continue;
+                std::ostringstream os;
+                os << "A kinetic process couples two domains.";
+                throw steps::NotImplErr(os.str());
+            }
+        }
+    }
+
+    // The neighbours: the owners of the halo and of the triangles next
+    // to this rank's, which are the ranks molecules can diffuse to.
+    if (pNRanks > 1)
+    {
+        pHalo = solver->mesh()->getPartitionHalo(pTetRank, pRank);
+    }
+    std::vector<bool> neighb(pNRanks, false);
+    uint nhalo = pHalo.size();
+    for (uint h = 0; h < nhalo; ++h)
+    {
+        if (tets[pHalo[h]] != 0) neighb[pTetRank[pHalo[h]]] = true;
+    }
+    for (uint i = pRankTriStart[pRank]; i < pRankTriStart[pRank + 1]; ++i)
+    {
+        for (uint j = 0; j < 3; ++j)
+        {
+            stex::Tri * nb = pRankTris[i]->nextTri(j);
+            if (nb != 0) neighb[pTriRank[nb->idx()]] = true;
+        }
+    }
+    neighb[pRank] = false;
+    pNeighbIdx.assign(pNRanks, -1);
+    for (uint r = 0; r < pNRanks; ++r)
+    {
+        if (neighb[r] == false) continue;
+        pNeighbIdx[r] = pNeighbs.size();
+        pNeighbs.push_back(r);
+    }
+    pOutbox.resize(pNeighbs.size());
+
+    pKProcs.assign(pRankKProcs.begin() + pRankKProcStart[pRank],
+                   pRankKProcs.begin() + pRankKProcStart[pRank + 1]);
+    pRNG = steps::rng::create("philox4x32", 512);
+    // A rank schedules its kprocs one by one, even where the solver
+    // groups them by element.
+    pSched = sssa::createScheduler(solver->_baseScheduler()->getName(), pRNG);
+
+    // A communicator of its own keeps the messages of the domains apart
+    // from those of the caller.
+    pComm = new Comm;
+#ifdef STEPS_USE_MPI
+    MPI_Comm_dup(MPI_COMM_WORLD, &pComm->comm);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Domains::~Domains(void)
+{
+#ifdef STEPS_USE_MPI
+    int done = 0;
+    MPI_Finalized(&done);
+    if (done == 0) MPI_Comm_free(&pComm->comm);
+#endif
+    delete pComm;
+    delete pSched;
+    delete pRNG;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stex::Domains::getTets(void) const
+{
+    std::vector<uint> tets;
+    for (uint t = pRankTetStart[pRank]; t < pRankTetStart[pRank + 1]; ++t)
+    {
+        tets.push_back(pRankTets[t]->idx());
+    }
+    return tets;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Domains::run(double endtime)
+{
+    double t = pSolver->getTime();
+    pNEvents = 0.0;
+    _begin(t);
+    while (t < endtime)
+    {
+        double t1 = std::min(t + pWindow, endtime);
+        _window(t, t1);
+        t = t1;
+    }
+    _gather();
+
+    double nevents = pNEvents;
+#ifdef STEPS_USE_MPI
+    MPI_Allreduce(&pNEvents, &nevents, 1, MPI_DOUBLE, MPI_SUM, pComm->comm);
+#endif
+    return nevents;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Domains::_begin(double t)
+{
+    // All ranks draw from streams of the seed of rank 0.
+    uint seed = pSolver->rng()->get();
+#ifdef STEPS_USE_MPI
+    MPI_Bcast(&seed, 1, MPI_UNSIGNED, 0, pComm->comm);
+#endif
+    pRNG->initializeStream(seed, pRank);
+
+    uint nkprocs = pKProcs.size();
+    pRates.resize(nkprocs);
+    pSched->init(nkprocs);
+    for (uint k = 0; k < nkprocs; ++k)
+    {
+        pRates[k] = pSolver->_rate(pKProcs[k]);
+        pSched->update(k, pRates[k], t);
+    }
+    pSched->commit(t);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Domains::_window(double t0, double t1)
+{
+    uint nneighbs = pNeighbs.size();
+    for (uint n = 0; n < nneighbs; ++n) pOutbox[n].clear();
+
+    // The event drawn past the end of the window is drawn again from the
+    // state after the exchange.
+    double t = t0;
+    while (true)
+    {
+        double dt = 0.0;
+        uint idx = pSched->getNext(t, dt);
+        if (idx == sssa::SCHED_IDX_UNDEFINED || (t + dt) > t1) break;
+        _fire(idx, dt, t);
+        t += dt;
+        pNEvents += 1.0;
+    }
+    _exchange(t1);
+    pNWindows += 1.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Domains::_fire(uint idx, double dt, double t)
+{
+    stex::KProc * kp = pKProcs[idx];
+    if (pKProcCross[kp->schedIDX()] == false)
+    {
+        _update(kp->apply(pRNG, dt, t), t + dt);
+        return;
+    }
+
+    uint dir = 0;
+    uint dst = pRank;
+    if (kp->type() == KP_DIFF)
+    {
+        stex::Diff * diff = static_cast<stex::Diff *>(kp);
+        dir = diff->applyOut(pRNG);
+        dst = pTetRank[diff->neighb(dir)->idx()];
+        if (dst == pRank) diff->applyIn(dir);
+    }
+    else
+    {
+        stex::SDiff * sdiff = static_cast<stex::SDiff *>(kp);
+        dir = sdiff->applyOut(pRNG);
+        dst = pTriRank[sdiff->neighb(dir)->idx()];
+        if (dst == pRank) sdiff->applyIn(dir);
+    }
+    if (dst != pRank)
+    {
+        int n = pNeighbIdx[dst];
+        assert(n >= 0);
+        pOutbox[n].push_back(kp->schedIDX());
+        pOutbox[n].push_back(dir);
+        pNMessages += 1.0;
+    }
+    _update(kp->updList(dir), t + dt);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Domains::_exchange(double t)
+{
+#ifdef STEPS_USE_MPI
+    uint nneighbs = pNeighbs.size();
+    if (nneighbs == 0) return;
+
+    std::vector<MPI_Request> reqs(nneighbs);
+    for (uint n = 0; n < nneighbs; ++n)
+    {
+        MPI_Isend(bufferOf(pOutbox[n]), pOutbox[n].size(), MPI_UNSIGNED, pNeighbs[n],
+                  DOMAINS_TAG_MOLECULES, pComm->comm, &reqs[n]);
+    }
+
+    // The molecules are put in by source rank, in the order they left.
+    std::vector<uint> in;
+    for (uint n = 0; n < nneighbs; ++n)
+    {
+        MPI_Status status;
+        MPI_Probe(pNeighbs[n], DOMAINS_TAG_MOLECULES, pComm->comm, &status);
+        int size = 0;
+        MPI_Get_count(&status, MPI_UNSIGNED, &size);
+        in.resize(size);
+        MPI_Recv(bufferOf(in), size, MPI_UNSIGNED, pNeighbs[n],
+                 DOMAINS_TAG_MOLECULES, pComm->comm, MPI_STATUS_IGNORE);
+        for (int i = 0; i < size; i += 2)
+        {
+            stex::KProc * kp = pSolver->kproc(in[i]);
+            uint dir = in[i + 1];
+            if (kp->type() == KP_DIFF)
+            {
+                static_cast<stex::Diff *>(kp)->applyIn(dir);
+            }
+            else
+            {
+                static_cast<stex::SDiff *>(kp)->applyIn(dir);
+            }
+            _update(kp->updList(dir), t);
+        }
+    }
+    MPI_Waitall(nneighbs, &reqs[0], MPI_STATUSES_IGNORE);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Domains::_update(KProcIdxSpan const & upd, double t)
+{
+    uint nupd = upd.size();
+    for (uint i = 0; i < nupd; ++i)
+    {
+        uint sidx = upd[i];
+        if (pKProcRank[sidx] != pRank) continue;
+        uint l = pKProcLocal[sidx];
+        pRates[l] = pSolver->_rate(pSolver->kproc(sidx));
+        pSched->update(l, pRates[l], t);
+    }
+    pSched->commit(t);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Domains::_gather(void)
+{
+#ifdef STEPS_USE_MPI
+    if (pNRanks == 1) return;
+
+    std::vector<uint> mine;
+    mine.reserve(pStateSize[pRank]);
+    for (uint t = pRankTetStart[pRank]; t < pRankTetStart[pRank + 1]; ++t)
+    {
+        stex::Tet * tet = pRankTets[t];
+        uint nspecs = tet->compdef()->countSpecs();
+        for (uint s = 0; s < nspecs; ++s) mine.push_back(tet->count(s));
+    }
+    for (uint i = pRankTriStart[pRank]; i < pRankTriStart[pRank + 1]; ++i)
+    {
+        stex::Tri * tri = pRankTris[i];
+        uint nspecs = tri->patchdef()->countSpecs();
+        for (uint s = 0; s < nspecs; ++s) mine.push_back(tri->count(s));
+    }
+    uint nkprocs = pKProcs.size();
+    for (uint k = 0; k < nkprocs; ++k) mine.push_back(pKProcs[k]->getExtent());
+    assert(static_cast<int>(mine.size()) == pStateSize[pRank]);
+
+    std::vector<int> displs(pNRanks, 0);
+    for (uint r = 1; r < pNRanks; ++r) displs[r] = displs[r - 1] + pStateSize[r - 1];
+    std::vector<uint> all(displs[pNRanks - 1] + pStateSize[pNRanks - 1]);
+    MPI_Allgatherv(bufferOf(mine), mine.size(), MPI_UNSIGNED, bufferOf(all),
+                   &pStateSize[0], &displs[0], MPI_UNSIGNED, pComm->comm);
+
+    // Only counts that changed are set.
+    for (uint r = 0; r < pNRanks; ++r)
+    {
+        if (r == pRank) continue;
+        uint const * v = bufferOf(all) + displs[r];
+        for (uint t = pRankTetStart[r]; t < pRankTetStart[r + 1]; ++t)
+        {
+            stex::Tet * tet = pRankTets[t];
+            uint nspecs = tet->compdef()->countSpecs();
+            for (uint s = 0; s < nspecs; ++s, ++v)
+            {
+                if (tet->count(s) != *v) tet->setCount(s, *v);
+            }
+        }
+        for (uint i = pRankTriStart[r]; i < pRankTriStart[r + 1]; ++i)
+        {
+            stex::Tri * tri = pRankTris[i];
+            uint nspecs = tri->patchdef()->countSpecs();
+            for (uint s = 0; s < nspecs; ++s, ++v)
+            {
+                if (tri->count(s) != *v) tri->setCount(s, *v);
+            }
+        }
+        for (uint k = pRankKProcStart[r]; k < pRankKProcStart[r + 1]; ++k, ++v)
+        {
+            pRankKProcs[k]->setExtent(*v);
+        }
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETEXACT_DOMAINS_HPP
+#define STEPS_TETEXACT_DOMAINS_HPP 1
+
+// STL headers.
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../rng/rng.hpp"
+#include "../solver/ssa/scheduler.hpp"
+#include "kproc.hpp"
+#include "tet.hpp"
+#include "tri.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetexact)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Forward declarations.
+class Tetexact;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Runs the SSA of a Tetexact solver on the ranks of an MPI job, each
+/// rank simulating its own spatial domain of the mesh.
+///
+/// Every rank builds the same solver and the same Domains. The
+/// tetrahedrons are split with Tetmesh::partitionTets into one domain per
+/// rank, weighted by Tetexact::getTetLoads, and the two tetrahedrons of
+/// every triangle are put in the same domain, with the triangle
+/// (Clusters::joinTriTets), so that only diffusion couples the domains.
+/// A rank fires the kprocs of its own tets and triangles only. Its
+/// neighbours are the ranks that own the halo of its domain
+/// (Tetmesh::getPartitionHalo) and the triangles next to its own.
+///
+/// Time is cut into windows (operator splitting). In a window each rank
+/// simulates its domain on its own. A molecule that diffuses out of the
+/// domain leaves its tetrahedron or triangle at once (Diff::applyOut)
+/// and is sent to the rank owning the neighbour, which puts it in
+/// (Diff::applyIn) at the end of the window. The error is that of
+/// delaying the crossings by up to a window, so the window should be
+/// short next to the time a molecule stays in a boundary element.
+///
+/// At the end of each run() the ranks exchange the counts of their
+/// elements and the extents of their kprocs, so every rank then holds
+/// the whole state and the solver's data access works on all of them.
+/// All ranks have to call run() with the same end times.
+///
+/// Rank r draws from stream r of a seed that rank 0 takes from its
+/// solver's generator at the start of each run (RNG::initializeStream),
+/// so the result depends on the number of ranks but not on the seeds of
+/// the other ranks.
+///
+/// MPI is initialized on first use if the caller has not done so
+/// (steps::initMPI). Without STEPS_USE_MPI (setup.py defines it when it
+/// finds MPI) the solver is the only rank and owns the whole mesh.
+///
+class Domains
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Split the tetrahedrons of solver over the ranks. Throws
+    /// steps::NotImplErr if the solver has well-mixed volumes or
+    /// computes the membrane potential.
+    ///
+    Domains(steps::tetexact::Tetexact * solver, double window);
+
+    ~Domains(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    inline uint getRank(void) const
+    { return pRank; }
+
+    inline uint getNRanks(void) const
+    { return pNRanks; }
+
+    inline double getWindow(void) const
+    { return pWindow; }
+
+    /// The tetrahedrons (mesh indices) of the domain of this rank, and
+    /// the halo of the domain.
+    ///
+    std::vector<uint> getTets(void) const;
+
+    inline std::vector<uint> getHalo(void) const
+    { return pHalo; }
+
+    /// The ranks this rank exchanges molecules with.
+    ///
+    inline std::vector<uint> getNeighbours(void) const
+    { return pNeighbs; }
+
+    /// The number of molecules this rank sent to other ranks, and the
+    /// number of windows, since construction.
+    ///
+    inline double getNMessages(void) const
+    { return pNMessages; }
+
+    inline double getNWindows(void) const
+    { return pNWindows; }
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Run the SSA from the current time of the solver to endtime on all
+    /// ranks, and return the number of events of all ranks. The solver's
+    /// own scheduler is left untouched and has to be refreshed by the
+    /// caller.
+    ///
+    double run(double endtime);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// The communicator of the domains.
+    struct Comm;
+
+    /// Set the rank up for a run at time t.
+    ///
+    void _begin(double t);
+
+    /// Simulate the domain of this rank from t0 to t1, then exchange the
+    /// molecules that crossed and put them in at t1.
+    ///
+    void _window(double t0, double t1);
+
+    /// Fire local kproc idx at time t, after dt.
+    ///
+    void _fire(uint idx, double dt, double t);
+
+    /// Send the molecules of the window to the neighbours and put in
+    /// those received, at time t.
+    ///
+    void _exchange(double t);
+
+    /// Update the local kprocs among upd at time t.
+    ///
+    void _update(KProcIdxSpan const & upd, double t);
+
+    /// Bring the counts and extents of the other ranks' elements and
+    /// kprocs to this rank.
+    ///
+    void _gather(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    steps::tetexact::Tetexact         * pSolver;
+    double                              pWindow;
+
+    Comm                              * pComm;
+    uint                                pRank;
+    uint                                pNRanks;
+
+    // The rank of each tet and tri (mesh index) and of each kproc
+    // (schedule index), the position of each kproc in this rank's, and
+    // whether a kproc is a diffusion with a neighbour on another rank.
+    std::vector<uint>                   pTetRank;
+    std::vector<uint>                   pTriRank;
+    std::vector<uint>                   pKProcRank;
+    std::vector<uint>                   pKProcLocal;
+    std::vector<bool>                   pKProcCross;
+
+    // The elements and kprocs of every rank, those of rank r from
+    // pRankTets[r] (pRankTris, pRankKProcs) to the next, and the size of
+    // the state of each in _gather.
+    std::vector<uint>                   pRankTetStart;
+    std::vector<steps::tetexact::Tet *> pRankTets;
+    std::vector<uint>                   pRankTriStart;
+    std::vector<steps::tetexact::Tri *> pRankTris;
+    std::vector<uint>                   pRankKProcStart;
+    std::vector<steps::tetexact::KProc *> pRankKProcs;
+    std::vector<int>                    pStateSize;
+
+    // The halo of this rank's domain, the neighbouring ranks and, for
+    // each, the molecules to send in the current window as pairs of the
+    // schedule index of the kproc and the direction.
+    std::vector<uint>                   pHalo;
+    std::vector<uint>                   pNeighbs;
+    std::vector<int>                    pNeighbIdx;
+    std::vector<std::vector<uint> >     pOutbox;
+
+    // The kprocs of this rank with their propensities, scheduled by
+    // pSched with random numbers from pRNG.
+    std::vector<steps::tetexact::KProc *> pKProcs;
+    std::vector<double>                 pRates;
+    steps::rng::RNG                   * pRNG;
+    steps::solver::ssa::Scheduler     * pSched;
+
+    double                              pNEvents;
+    double                              pNMessages;
+    double                              pNWindows;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetexact)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETEXACT_DOMAINS_HPP
+
+// END
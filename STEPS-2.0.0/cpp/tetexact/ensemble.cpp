@@ -0,0 +1,572 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <cassert>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "../rng/rng.hpp"
+#include "../solver/compdef.hpp"
+#include "../solver/patchdef.hpp"
+#include "../solver/statedef.hpp"
+#include "ensemble.hpp"
+#include "tetexact.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::tetexact, stex);
+NAMESPACE_ALIAS(steps::rng, srng);
+NAMESPACE_ALIAS(steps::solver, ssolver);
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Ensemble::Ensemble(steps::model::Model * m, steps::wm::Geom * g,
+                         std::string const & init_file, uint nthreads,
+                         std::string const & rng_name, uint rng_bufsize,
+                         bool calcMembPot, std::string const & scheduler)
+: pInitFile(init_file)
+, pRNGs()
+, pSolvers()
+, pRecords()
+, pParams()
+, pStreams(false)
+, pStreamMaster(0)
+, pSeeds(0)
+, pTpnts(0)
+, pValues(0)
+, pResults()
+, pInitData()
+, pStartStates()
+, pEndStates()
+, pCheckpoint(false)
+, pNextSeed(0)
+, pError()
+{
+    if (nthreads == 0)
+    {
+        std::ostringstream os;
+        os << "Ensemble needs at least one thread.";
+        throw steps::ArgErr(os.str());
+    }
+
+    // The solvers are built here rather than in the worker threads, so
+    // that the shared model and geometry objects are only ever accessed
+    // from one thread while solvers are being set up.
+    for (uint i = 0; i < nthreads; ++i)
+    {
+        srng::RNG * r = srng::create(rng_name, rng_bufsize);
+        pRNGs.push_back(r);
+        r->initialize(i);
+        pSolvers.push_back(new Tetexact(m, g, r, calcMembPot, scheduler));
+    }
+
+    pthread_mutex_init(&pMutex, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Ensemble::~Ensemble(void)
+{
+    for (uint i = 0; i < pSolvers.size(); ++i)
+    {
+        delete pSolvers[i];
+        delete pRNGs[i];
+    }
+    pthread_mutex_destroy(&pMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Ensemble::addCompCountRecord(std::string const & c, std::string const & s)
+{
+    // Let the solver check the names.
+    pSolvers[0]->getCompCount(c, s);
+
+    Record rec;
+    rec.patch = false;
+    rec.loc = c;
+    rec.spec = s;
+    pRecords.push_back(rec);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Ensemble::addPatchCountRecord(std::string const & p, std::string const & s)
+{
+    pSolvers[0]->getPatchCount(p, s);
+
+    Record rec;
+    rec.patch = true;
+    rec.loc = p;
+    rec.spec = s;
+    pRecords.push_back(rec);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Ensemble::addCompReacKParam(std::string const & c, std::string const & r)
+{
+    Param par;
+    par.patch = false;
+    par.loc = pSolvers[0]->getCompIdx(c);
+    par.reac = pSolvers[0]->getReacIdx(r);
+    ssolver::Compdef * cdef = pSolvers[0]->statedef()->compdef(par.loc);
+    if (cdef->reacG2L(par.reac) == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction '" << r << "' undefined in compartment '" << c << "'.";
+        throw steps::ArgErr(os.str());
+    }
+    pParams.push_back(par);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Ensemble::addPatchSReacKParam(std::string const & p, std::string const & sr)
+{
+    Param par;
+    par.patch = true;
+    par.loc = pSolvers[0]->getPatchIdx(p);
+    par.reac = pSolvers[0]->getSReacIdx(sr);
+    ssolver::Patchdef * pdef = pSolvers[0]->statedef()->patchdef(par.loc);
+    if (pdef->sreacG2L(par.reac) == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Surface reaction '" << sr << "' undefined in patch '" << p << "'.";
+        throw steps::ArgErr(os.str());
+    }
+    pParams.push_back(par);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Ensemble::setStreams(bool on, uint master)
+{
+    pStreams = on;
+    pStreamMaster = master;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::Ensemble::run(std::vector<uint> const & seeds,
+                                        std::vector<double> const & tpnts,
+                                        std::string const & cp_file)
+{
+    pStartStates.clear();
+    return _runAll(seeds, tpnts, cp_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::Ensemble::resume(std::string const & cp_in,
+                                           std::vector<uint> const & seeds,
+                                           std::vector<double> const & tpnts,
+                                           std::string const & cp_out)
+{
+    _readCheckpoint(cp_in, seeds.size());
+    std::vector<double> results;
+    try
+    {
+        results = _runAll(seeds, tpnts, cp_out);
+    }
+    catch (...)
+    {
+        pStartStates.clear();
+        throw;
+    }
+    pStartStates.clear();
+    return results;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::Ensemble::sweep(std::vector<double> const & values,
+                                          std::vector<uint> const & seeds,
+                                          std::vector<double> const & tpnts,
+                                          std::string const & cp_file)
+{
+    if (pParams.empty() || values.size() != seeds.size() * pParams.size())
+    {
+        std::ostringstream os;
+        os << "Sweep needs " << pParams.size() << " parameter values per seed.";
+        throw steps::ArgErr(os.str());
+    }
+    for (uint i = 0; i < values.size(); ++i)
+    {
+        if (values[i] < 0.0)
+        {
+            std::ostringstream os;
+            os << "Reaction constant cannot be negative.";
+            throw steps::ArgErr(os.str());
+        }
+    }
+
+    pStartStates.clear();
+    pValues = &values;
+    std::vector<double> results;
+    try
+    {
+        results = _runAll(seeds, tpnts, cp_file);
+    }
+    catch (...)
+    {
+        pValues = 0;
+        throw;
+    }
+    pValues = 0;
+    return results;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::Ensemble::_runAll(std::vector<uint> const & seeds,
+                                            std::vector<double> const & tpnts,
+                                            std::string const & cp_file)
+{
+    for (uint t = 1; t < tpnts.size(); ++t)
+    {
+        if (tpnts[t] < tpnts[t - 1])
+        {
+            std::ostringstream os;
+            os << "Ensemble time points must be increasing.";
+            throw steps::ArgErr(os.str());
+        }
+    }
+
+    // The initial state is read (and checked) once and restored from
+    // memory for every seed. A resume keeps the one from its file.
+    if (pStartStates.empty())
+    {
+        pSolvers[0]->_readCheckpoint(pInitFile, pInitData);
+    }
+
+    pSeeds = &seeds;
+    pTpnts = &tpnts;
+    pResults.assign(seeds.size() * tpnts.size() * pRecords.size(), 0.0);
+    pCheckpoint = (cp_file != "");
+    pEndStates.assign(pCheckpoint ? seeds.size() : 0, std::string());
+    pNextSeed = 0;
+    pError = "";
+
+    uint nthreads = pSolvers.size();
+    std::vector<Worker> workers(nthreads);
+    std::vector<pthread_t> threads(nthreads);
+    for (uint i = 0; i < nthreads; ++i)
+    {
+        workers[i].ensemble = this;
+        workers[i].idx = i;
+        if (pthread_create(&threads[i], 0, _work, &workers[i]) != 0)
+        {
+            // Let the threads that did start finish the work.
+            nthreads = i;
+            break;
+        }
+    }
+    if (nthreads == 0)
+    {
+        _work(&workers[0]);
+    }
+    for (uint i = 0; i < nthreads; ++i)
+    {
+        pthread_join(threads[i], 0);
+    }
+
+    pSeeds = 0;
+    pTpnts = 0;
+
+    if (pError != "")
+    {
+        pEndStates.clear();
+        throw steps::ProgErr(pError);
+    }
+
+    // The replicates have serialised their states in parallel; only the
+    // file itself is written here.
+    if (pCheckpoint == true)
+    {
+        _writeCheckpoint(cp_file);
+        pEndStates.clear();
+    }
+
+    std::vector<double> results;
+    results.swap(pResults);
+    return results;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void * stex::Ensemble::_work(void * arg)
+{
+    Worker * w = static_cast<Worker *>(arg);
+    Ensemble * e = w->ensemble;
+
+    while (true)
+    {
+        pthread_mutex_lock(&e->pMutex);
+        uint sidx = e->pNextSeed;
+        if (e->pError == "" && sidx < e->pSeeds->size())
+        {
+            ++e->pNextSeed;
+        }
+        else
+        {
+            sidx = e->pSeeds->size();
+        }
+        pthread_mutex_unlock(&e->pMutex);
+
+        if (sidx == e->pSeeds->size()) break;
+
+        // Exceptions must not leave the thread; the first one is stored
+        // and rethrown by run().
+        try
+        {
+            e->_runSeed(w->idx, sidx);
+        }
+        catch (steps::Err & err)
+        {
+            pthread_mutex_lock(&e->pMutex);
+            if (e->pError == "")
+            {
+                std::ostringstream os;
+                os << "Ensemble run for seed " << (*e->pSeeds)[sidx];
+                os << " failed: " << err.getMsg();
+                e->pError = os.str();
+            }
+            pthread_mutex_unlock(&e->pMutex);
+        }
+    }
+
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Ensemble::_runSeed(uint widx, uint sidx)
+{
+    Tetexact * solver = pSolvers[widx];
+
+    if (pStreams == true)
+    {
+        pRNGs[widx]->initializeStream(pStreamMaster, (*pSeeds)[sidx]);
+    }
+    else
+    {
+        pRNGs[widx]->initialize((*pSeeds)[sidx]);
+    }
+    std::stringstream init(pInitData, std::stringstream::in
+                           | std::stringstream::out | std::stringstream::binary);
+    solver->_restore(init);
+    if (!pStartStates.empty())
+    {
+        std::stringstream start(pStartStates[sidx], std::stringstream::in
+                                | std::stringstream::out | std::stringstream::binary);
+        solver->_restoreRun(start);
+    }
+    if (pValues != 0)
+    {
+        uint nparams = pParams.size();
+        double const * vals = &(*pValues)[0] + sidx * nparams;
+        for (uint i = 0; i < nparams; ++i)
+        {
+            Param const & par = pParams[i];
+            if (par.patch == true)
+            {
+                solver->_applyPatchSReacK(par.loc, par.reac, vals[i]);
+            }
+            else
+            {
+                solver->_applyCompReacK(par.loc, par.reac, vals[i]);
+            }
+        }
+        solver->_update();
+    }
+
+    uint ntpnts = pTpnts->size();
+    uint nrecs = pRecords.size();
+    double * res = &pResults[0] + sidx * ntpnts * nrecs;
+    for (uint t = 0; t < ntpnts; ++t)
+    {
+        solver->run((*pTpnts)[t]);
+        for (uint r = 0; r < nrecs; ++r)
+        {
+            Record const & rec = pRecords[r];
+            if (rec.patch == true)
+            {
+                res[r] = solver->getPatchCount(rec.loc, rec.spec);
+            }
+            else
+            {
+                res[r] = solver->getCompCount(rec.loc, rec.spec);
+            }
+        }
+        res += nrecs;
+    }
+
+    if (pCheckpoint == true)
+    {
+        std::stringstream end(std::stringstream::in | std::stringstream::out
+                              | std::stringstream::binary);
+        solver->_checkpointRun(end);
+        pEndStates[sidx] = end.str();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Ensemble::_writeCheckpoint(std::string const & cp_file)
+{
+    std::fstream out;
+    out.open(cp_file.c_str(),
+             std::fstream::out | std::fstream::binary | std::fstream::trunc);
+    if (!out)
+    {
+        std::ostringstream os;
+        os << "Cannot open ensemble checkpoint file '" << cp_file << "'.";
+        throw steps::ArgErr(os.str());
+    }
+
+    std::vector<uint> shape;
+    pSolvers[0]->_checkpointShape(shape);
+    uint version = ENSEMBLE_CHECKPOINT_VERSION;
+    uint nshape = shape.size();
+    out.write(ENSEMBLE_CHECKPOINT_MAGIC, 8);
+    out.write((char*)&version, sizeof(uint));
+    out.write((char*)&nshape, sizeof(uint));
+    if (nshape > 0) out.write((char*)&shape[0], sizeof(uint) * nshape);
+
+    // The shared state, then one run state per replicate, each with its
+    // size and hash.
+    uint nreps = pEndStates.size();
+    for (uint i = 0; i <= nreps; ++i)
+    {
+        std::string const & data = (i == 0 ? pInitData : pEndStates[i - 1]);
+        unsigned long long nbytes = data.size();
+        uint hash = checkpointHash(data);
+        out.write((char*)&nbytes, sizeof(unsigned long long));
+        out.write((char*)&hash, sizeof(uint));
+        if (nbytes > 0) out.write(data.data(), nbytes);
+        if (i == 0) out.write((char*)&nreps, sizeof(uint));
+    }
+
+    if (!out)
+    {
+        std::ostringstream os;
+        os << "Failed to write ensemble checkpoint file '" << cp_file << "'.";
+        throw steps::ArgErr(os.str());
+    }
+    out.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Ensemble::_readCheckpoint(std::string const & cp_file, uint nreps)
+{
+    std::fstream in;
+    in.open(cp_file.c_str(), std::fstream::in | std::fstream::binary);
+    if (!in)
+    {
+        std::ostringstream os;
+        os << "Cannot open ensemble checkpoint file '" << cp_file << "'.";
+        throw steps::ArgErr(os.str());
+    }
+
+    char magic[8];
+    uint version = 0;
+    uint nshape = 0;
+    in.read(magic, 8);
+    in.read((char*)&version, sizeof(uint));
+    in.read((char*)&nshape, sizeof(uint));
+    if (!in || std::string(magic, 8) != ENSEMBLE_CHECKPOINT_MAGIC
+        || version != ENSEMBLE_CHECKPOINT_VERSION)
+    {
+        std::ostringstream os;
+        os << "'" << cp_file << "' is not an ensemble checkpoint file of ";
+        os << "format version " << ENSEMBLE_CHECKPOINT_VERSION << ".";
+        throw steps::ArgErr(os.str());
+    }
+
+    std::vector<uint> shape;
+    pSolvers[0]->_checkpointShape(shape);
+    std::vector<uint> stored(nshape, 0);
+    if (nshape > 0) in.read((char*)&stored[0], sizeof(uint) * nshape);
+    if (stored != shape)
+    {
+        std::ostringstream os;
+        os << "Ensemble checkpoint file '" << cp_file << "' was written for ";
+        os << "a different model, geometry or build.";
+        throw steps::ArgErr(os.str());
+    }
+
+    std::vector<std::string> states;
+    uint nstored = 0;
+    for (uint i = 0; i <= nstored; ++i)
+    {
+        unsigned long long nbytes = 0;
+        uint hash = 0;
+        in.read((char*)&nbytes, sizeof(unsigned long long));
+        in.read((char*)&hash, sizeof(uint));
+        std::string data(in ? nbytes : 0, '\0');
+        if (!data.empty()) in.read(&data[0], nbytes);
+        if (!in || checkpointHash(data) != hash)
+        {
+            std::ostringstream os;
+            os << "Ensemble checkpoint file '" << cp_file;
+            os << "' is truncated or corrupt.";
+            throw steps::ArgErr(os.str());
+        }
+        if (i == 0)
+        {
+            pInitData.swap(data);
+            in.read((char*)&nstored, sizeof(uint));
+            if (nstored != nreps)
+            {
+                std::ostringstream os;
+                os << "Ensemble checkpoint file '" << cp_file << "' holds ";
+                os << nstored << " replicates, but " << nreps;
+                os << " seeds were given.";
+                throw steps::ArgErr(os.str());
+            }
+            states.reserve(nstored);
+        }
+        else
+        {
+            states.push_back(std::string());
+            states.back().swap(data);
+        }
+    }
+    in.close();
+
+    pStartStates.swap(states);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
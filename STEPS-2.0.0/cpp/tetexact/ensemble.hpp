@@ -0,0 +1,279 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETEXACT_ENSEMBLE_HPP
+#define STEPS_TETEXACT_ENSEMBLE_HPP 1
+
+// STL headers.
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+// STEPS headers.
+#include "../common.h"
+#include "../model/model.hpp"
+#include "../geom/geom.hpp"
+#include "../rng/rng.hpp"
+#include "tetexact.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Header of an ensemble checkpoint file: the magic string, then the format
+/// version, the solver shape, the shared state and the run state of every
+/// replicate (see Ensemble::run).
+#define ENSEMBLE_CHECKPOINT_MAGIC      "STEPSENS"
+#define ENSEMBLE_CHECKPOINT_VERSION    1
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetexact)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Runs independent realisations of one Tetexact simulation on a pool of
+/// threads. The model and geometry are shared by all threads; each thread
+/// owns one solver and one RNG which are reused for every seed it runs, so
+/// the solver setup cost and memory are paid per thread rather than per
+/// seed.
+///
+/// Every realisation starts from a checkpoint file written by a prototype
+/// solver on which the initial conditions have been set, and its RNG is
+/// initialized with its own seed.
+///
+/// The final states of an ensemble can be checkpointed to a single file and
+/// continued with resume(). The initial checkpoint, which holds everything
+/// run() does not change, is stored once; each replicate only adds its
+/// time, molecule counts and kproc extents.
+///
+class Ensemble
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Constructor; builds nthreads solvers for model m and geometry g.
+    ///
+    /// \param init_file Checkpoint holding the initial state of each run.
+    /// \param nthreads Number of worker threads (and solver instances).
+    /// \param rng_name Name of the random number generator, see
+    ///        steps::rng::create.
+    /// \param rng_bufsize Buffer size of each random number generator.
+    ///
+    Ensemble(steps::model::Model * m, steps::wm::Geom * g,
+             std::string const & init_file, uint nthreads,
+             std::string const & rng_name = "mt19937", uint rng_bufsize = 512,
+             bool calcMembPot = false, std::string const & scheduler = "cr");
+
+    ~Ensemble(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // RECORDING
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Record the number of molecules of species s in compartment c.
+    ///
+    void addCompCountRecord(std::string const & c, std::string const & s);
+
+    /// Record the number of molecules of species s in patch p.
+    ///
+    void addPatchCountRecord(std::string const & p, std::string const & s);
+
+    uint getNRecords(void) const
+    { return pRecords.size(); }
+
+    ////////////////////////////////////////////////////////////////////////
+    // PARAMETER SWEEPS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Make the rate constant of reaction r in compartment c a parameter
+    /// of sweep().
+    ///
+    void addCompReacKParam(std::string const & c, std::string const & r);
+
+    /// Make the rate constant of surface reaction sr in patch p a
+    /// parameter of sweep().
+    ///
+    void addPatchSReacKParam(std::string const & p, std::string const & sr);
+
+    uint getNParams(void) const
+    { return pParams.size(); }
+
+    uint getNThreads(void) const
+    { return pSolvers.size(); }
+
+    ////////////////////////////////////////////////////////////////////////
+    // SIMULATION CONTROLS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Draw the realisations from the non-overlapping streams of one
+    /// master seed: while on, the realisation run with seed value s uses
+    /// stream s of master (see steps::rng::RNG::initializeStream) rather
+    /// than an RNG initialized with s. Off by default.
+    ///
+    void setStreams(bool on, uint master = 0);
+
+    bool getStreams(void) const
+    { return pStreams; }
+
+    /// Run one realisation per seed, recording at each time point in tpnts
+    /// (which must be increasing and not before the time in the initial
+    /// checkpoint).
+    ///
+    /// \param cp_file If not empty, the final states are written to this
+    ///        ensemble checkpoint file.
+    ///
+    /// \return The recorded values in seed, time point, record order:
+    ///         element [(i * tpnts.size() + j) * getNRecords() + k] is
+    ///         record k at tpnts[j] for seeds[i].
+    ///
+    std::vector<double> run(std::vector<uint> const & seeds,
+                            std::vector<double> const & tpnts,
+                            std::string const & cp_file = "");
+
+    /// Continue the replicates stored in ensemble checkpoint file cp_in,
+    /// which must hold one replicate per seed. Replicate i carries on from
+    /// its stored state with its RNG initialized with seeds[i]. Recording
+    /// and cp_out are as for run().
+    ///
+    std::vector<double> resume(std::string const & cp_in,
+                               std::vector<uint> const & seeds,
+                               std::vector<double> const & tpnts,
+                               std::string const & cp_out = "");
+
+    /// Run one realisation per parameter set. Set i takes the values
+    /// values[i * getNParams()] to values[(i + 1) * getNParams() - 1],
+    /// in the order the parameters were added, and runs with seed
+    /// seeds[i]. The rate constants are set on top of the initial
+    /// checkpoint, all in one pass, so a solver is reused for every set
+    /// it runs. Recording and cp_file are as for run().
+    ///
+    std::vector<double> sweep(std::vector<double> const & values,
+                              std::vector<uint> const & seeds,
+                              std::vector<double> const & tpnts,
+                              std::string const & cp_file = "");
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    struct Record
+    {
+        bool                            patch;
+        std::string                     loc;
+        std::string                     spec;
+    };
+
+    /// A swept rate constant: reaction (or surface reaction, if patch)
+    /// reac in compartment (or patch) loc, global indices.
+    struct Param
+    {
+        bool                            patch;
+        uint                            loc;
+        uint                            reac;
+    };
+
+    struct Worker
+    {
+        Ensemble                      * ensemble;
+        uint                            idx;
+    };
+
+    /// Thread entry point; runs seeds until there are none left.
+    ///
+    static void * _work(void * arg);
+
+    void _runSeed(uint widx, uint sidx);
+
+    /// Run all seeds on the thread pool and write cp_file if it is not
+    /// empty.
+    ///
+    std::vector<double> _runAll(std::vector<uint> const & seeds,
+                                std::vector<double> const & tpnts,
+                                std::string const & cp_file);
+
+    void _writeCheckpoint(std::string const & cp_file);
+
+    void _readCheckpoint(std::string const & cp_file, uint nreps);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    std::string                         pInitFile;
+
+    std::vector<steps::rng::RNG *>      pRNGs;
+    std::vector<Tetexact *>             pSolvers;
+
+    std::vector<Record>                 pRecords;
+    std::vector<Param>                  pParams;
+
+    /// Whether seeds are stream indices of pStreamMaster.
+    bool                                pStreams;
+    uint                                pStreamMaster;
+
+    ////////////////////////////////////////////////////////////////////////
+    // STATE OF THE CURRENT RUN
+    ////////////////////////////////////////////////////////////////////////
+
+    std::vector<uint> const           * pSeeds;
+    std::vector<double> const         * pTpnts;
+    /// Parameter values of a sweep, or null.
+    std::vector<double> const         * pValues;
+    std::vector<double>                 pResults;
+
+    /// State block of the initial checkpoint, read once per run.
+    std::string                         pInitData;
+
+    /// Run states to continue from (resume) and final run states (when
+    /// checkpointing), one per seed. Each worker only touches the entries
+    /// of the seeds it runs.
+    std::vector<std::string>            pStartStates;
+    std::vector<std::string>            pEndStates;
+    bool                                pCheckpoint;
+
+    /// Index of the next seed to be run, guarded by pMutex.
+    uint                                pNextSeed;
+
+    /// Message of the first error raised by a worker, guarded by pMutex.
+    std::string                         pError;
+
+    pthread_mutex_t                     pMutex;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetexact)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETEXACT_ENSEMBLE_HPP
+
+// END
@@ -0,0 +1,451 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// STL headers.
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef STEPS_USE_MPI
+// MPI headers.
+#include <mpi.h>
+#endif
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "../mpi.hpp"
+#include "../solver/hdf5writer.hpp"
+#include "ensemble.hpp"
+#include "ensemblefarm.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::tetexact, stex);
+NAMESPACE_ALIAS(steps::solver, ssolver);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Message tags: a request for work, which carries the results of the
+// last chunk (its first seed, or -1, then its values); the error a chunk
+// failed with, sent before the next request; and the answer, the first
+// seed of the next chunk or -1 to stop.
+#define ENSEMBLEFARM_TAG_REQUEST        1
+#define ENSEMBLEFARM_TAG_ERROR          2
+#define ENSEMBLEFARM_TAG_WORK           3
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct stex::EnsembleFarm::Comm
+{
+#ifdef STEPS_USE_MPI
+    MPI_Comm                            comm;
+#endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::EnsembleFarm::EnsembleFarm(steps::model::Model * m, steps::wm::Geom * g,
+                                 std::string const & init_file, uint nthreads,
+                                 std::string const & rng_name, uint rng_bufsize,
+                                 bool calcMembPot, std::string const & scheduler)
+: pEnsemble(m, g, init_file, nthreads, rng_name, rng_bufsize, calcMembPot, scheduler)
+, pLabels()
+, pChunk(0)
+, pComm(new Comm)
+, pRank(0)
+, pNRanks(1)
+, pServeThread(false)
+, pSeeds(0)
+, pTpnts(0)
+, pValues(0)
+, pRunChunk(1)
+, pResults()
+, pLoads()
+, pNextSeed(0)
+, pError()
+{
+#ifdef STEPS_USE_MPI
+    steps::initMPI();
+    int level = MPI_THREAD_SINGLE;
+    MPI_Query_thread(&level);
+    pServeThread = (level >= MPI_THREAD_SERIALIZED);
+
+    // A communicator of its own keeps the messages of the farm apart
+    // from those of the caller.
+    MPI_Comm_dup(MPI_COMM_WORLD, &pComm->comm);
+    int rank = 0;
+    int nranks = 1;
+    MPI_Comm_rank(pComm->comm, &rank);
+    MPI_Comm_size(pComm->comm, &nranks);
+    pRank = rank;
+    pNRanks = nranks;
+#endif
+
+    pthread_mutex_init(&pMutex, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::EnsembleFarm::~EnsembleFarm(void)
+{
+#ifdef STEPS_USE_MPI
+    int done = 0;
+    MPI_Finalized(&done);
+    if (done == 0) MPI_Comm_free(&pComm->comm);
+#endif
+    delete pComm;
+    pthread_mutex_destroy(&pMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EnsembleFarm::setChunk(uint n)
+{
+    pChunk = n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EnsembleFarm::addCompCountRecord(std::string const & c,
+                                            std::string const & s)
+{
+    pEnsemble.addCompCountRecord(c, s);
+    pLabels.push_back("comp:" + c + ":" + s);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EnsembleFarm::addPatchCountRecord(std::string const & p,
+                                             std::string const & s)
+{
+    pEnsemble.addPatchCountRecord(p, s);
+    pLabels.push_back("patch:" + p + ":" + s);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EnsembleFarm::addCompReacKParam(std::string const & c,
+                                           std::string const & r)
+{
+    pEnsemble.addCompReacKParam(c, r);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EnsembleFarm::addPatchSReacKParam(std::string const & p,
+                                             std::string const & sr)
+{
+    pEnsemble.addPatchSReacKParam(p, sr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::EnsembleFarm::run(std::vector<uint> const & seeds,
+                                            std::vector<double> const & tpnts,
+                                            std::string const & h5_file)
+{
+    return _farm(0, seeds, tpnts, h5_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::EnsembleFarm::sweep(std::vector<double> const & values,
+                                              std::vector<uint> const & seeds,
+                                              std::vector<double> const & tpnts,
+                                              std::string const & h5_file)
+{
+    if (values.size() != seeds.size() * pEnsemble.getNParams())
+    {
+        std::ostringstream os;
+        os << "Sweep needs " << pEnsemble.getNParams() << " values per seed.";
+        throw steps::ArgErr(os.str());
+    }
+    return _farm(&values, seeds, tpnts, h5_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::EnsembleFarm::_farm(std::vector<double> const * values,
+                                              std::vector<uint> const & seeds,
+                                              std::vector<double> const & tpnts,
+                                              std::string const & h5_file)
+{
+    pSeeds = &seeds;
+    pTpnts = &tpnts;
+    pValues = values;
+    pRunChunk = (pChunk != 0) ? pChunk : pEnsemble.getNThreads();
+    pNextSeed = 0;
+    pError = "";
+    pLoads.assign(pNRanks, 0.0);
+    pResults.clear();
+    if (pRank == 0)
+    {
+        pResults.assign(seeds.size() * tpnts.size() * pEnsemble.getNRecords(), 0.0);
+    }
+
+    if (pRank == 0)
+    {
+        pthread_t server;
+        bool serving = (pNRanks > 1 && pServeThread == true);
+        if (serving == true) pthread_create(&server, 0, _serve, this);
+
+        // Without the thread, rank 0 only answers the requests.
+        if (pNRanks == 1 || serving == true)
+        {
+            uint first = 0;
+            while (_takeChunk(first) == true)
+            {
+                try
+                {
+                    std::vector<double> vals = _runChunk(first);
+                    _store(first, 0, vals.empty() ? 0 : &vals[0]);
+                }
+                catch (steps::Err & err)
+                {
+                    _fail(err.getMsg());
+                }
+            }
+        }
+        if (serving == true) pthread_join(server, 0);
+        else if (pNRanks > 1) _serve(this);
+    }
+#ifdef STEPS_USE_MPI
+    else
+    {
+        // Ask for work, handing in the results of the last chunk.
+        std::vector<double> msg(1, -1.0);
+        while (true)
+        {
+            MPI_Send(&msg[0], msg.size(), MPI_DOUBLE, 0,
+                     ENSEMBLEFARM_TAG_REQUEST, pComm->comm);
+            int first = -1;
+            MPI_Recv(&first, 1, MPI_INT, 0, ENSEMBLEFARM_TAG_WORK,
+                     pComm->comm, MPI_STATUS_IGNORE);
+            if (first < 0) break;
+
+            msg.assign(1, static_cast<double>(first));
+            try
+            {
+                std::vector<double> vals = _runChunk(first);
+                msg.insert(msg.end(), vals.begin(), vals.end());
+            }
+            catch (steps::Err & err)
+            {
+                std::string e = err.getMsg();
+                MPI_Send(const_cast<char *>(e.c_str()), e.size(), MPI_CHAR, 0,
+                         ENSEMBLEFARM_TAG_ERROR, pComm->comm);
+                msg.assign(1, -1.0);
+            }
+        }
+    }
+#endif
+
+    pSeeds = 0;
+    pTpnts = 0;
+    pValues = 0;
+    _checkError();
+
+    if (pRank == 0 && h5_file != "") _writeHDF5(h5_file, values, seeds, tpnts);
+    std::vector<double> res;
+    res.swap(pResults);
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void * stex::EnsembleFarm::_serve(void * arg)
+{
+#ifdef STEPS_USE_MPI
+    EnsembleFarm * f = static_cast<EnsembleFarm *>(arg);
+    uint active = f->pNRanks - 1;
+    while (active != 0)
+    {
+        // Poll rather than block, which would keep a core busy next to
+        // the threads running chunks on this rank.
+        MPI_Status st;
+        int flag = 0;
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, f->pComm->comm, &flag, &st);
+        if (flag == 0)
+        {
+            usleep(ENSEMBLEFARM_POLL_USEC);
+            continue;
+        }
+
+        if (st.MPI_TAG == ENSEMBLEFARM_TAG_ERROR)
+        {
+            int n = 0;
+            MPI_Get_count(&st, MPI_CHAR, &n);
+            std::vector<char> e(n + 1, 0);
+            MPI_Recv(&e[0], n, MPI_CHAR, st.MPI_SOURCE, ENSEMBLEFARM_TAG_ERROR,
+                     f->pComm->comm, MPI_STATUS_IGNORE);
+            f->_fail(&e[0]);
+            continue;
+        }
+
+        int n = 0;
+        MPI_Get_count(&st, MPI_DOUBLE, &n);
+        std::vector<double> msg(n);
+        MPI_Recv(&msg[0], n, MPI_DOUBLE, st.MPI_SOURCE, ENSEMBLEFARM_TAG_REQUEST,
+                 f->pComm->comm, MPI_STATUS_IGNORE);
+        if (msg[0] >= 0.0)
+        {
+            f->_store(static_cast<uint>(msg[0]), st.MPI_SOURCE,
+                      (n > 1) ? &msg[1] : 0);
+        }
+
+        uint next = 0;
+        int first = (f->_takeChunk(next) == true) ? static_cast<int>(next) : -1;
+        MPI_Send(&first, 1, MPI_INT, st.MPI_SOURCE, ENSEMBLEFARM_TAG_WORK,
+                 f->pComm->comm);
+        if (first < 0) --active;
+    }
+#endif
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stex::EnsembleFarm::_takeChunk(uint & first)
+{
+    pthread_mutex_lock(&pMutex);
+    bool ok = (pError == "" && pNextSeed < pSeeds->size());
+    if (ok == true)
+    {
+        first = pNextSeed;
+        pNextSeed += _chunkSize(first);
+    }
+    pthread_mutex_unlock(&pMutex);
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::EnsembleFarm::_chunkSize(uint first) const
+{
+    return std::min(pRunChunk, static_cast<uint>(pSeeds->size()) - first);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::EnsembleFarm::_runChunk(uint first)
+{
+    uint n = _chunkSize(first);
+    std::vector<uint> seeds(pSeeds->begin() + first, pSeeds->begin() + first + n);
+    if (pValues == 0) return pEnsemble.run(seeds, *pTpnts);
+
+    uint np = pEnsemble.getNParams();
+    std::vector<double> values(pValues->begin() + first * np,
+                               pValues->begin() + (first + n) * np);
+    return pEnsemble.sweep(values, seeds, *pTpnts);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EnsembleFarm::_store(uint first, uint rank, double const * vals)
+{
+    uint n = _chunkSize(first);
+    uint stride = pTpnts->size() * pEnsemble.getNRecords();
+    pthread_mutex_lock(&pMutex);
+    if (stride != 0)
+    {
+        std::copy(vals, vals + n * stride, pResults.begin() + first * stride);
+    }
+    pLoads[rank] += n;
+    pthread_mutex_unlock(&pMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EnsembleFarm::_fail(std::string const & msg)
+{
+    pthread_mutex_lock(&pMutex);
+    if (pError == "") pError = msg;
+    pthread_mutex_unlock(&pMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EnsembleFarm::_checkError(void)
+{
+#ifdef STEPS_USE_MPI
+    if (pNRanks > 1)
+    {
+        int n = pError.size();
+        MPI_Bcast(&n, 1, MPI_INT, 0, pComm->comm);
+        std::vector<char> e(n + 1, 0);
+        if (pRank == 0) std::copy(pError.begin(), pError.end(), e.begin());
+        MPI_Bcast(&e[0], n, MPI_CHAR, 0, pComm->comm);
+        pError = &e[0];
+    }
+#endif
+    if (pError == "") return;
+    pResults.clear();
+    throw steps::ProgErr(pError);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EnsembleFarm::_writeHDF5(std::string const & h5_file,
+                                    std::vector<double> const * values,
+                                    std::vector<uint> const & seeds,
+                                    std::vector<double> const & tpnts) const
+{
+#ifdef STEPS_USE_HDF5
+    uint nseeds = seeds.size();
+    uint ntp = tpnts.size();
+    uint nrec = pLabels.size();
+    uint np = pEnsemble.getNParams();
+
+    // A block holds the rows of one seed.
+    ssolver::HDF5Writer w(h5_file, pLabels, std::max(ntp, 1u), 4);
+    w.writeAttribute("solver", "Tetexact ensemble");
+    w.writeMatrix("seeds", nseeds ? &seeds[0] : 0, nseeds, 1);
+    if (values != 0)
+    {
+        w.writeMatrix("params", values->empty() ? 0 : &(*values)[0], nseeds, np);
+    }
+    w.start();
+    for (uint i = 0; i < nseeds; ++i)
+    {
+        for (uint j = 0; j < ntp; ++j)
+        {
+            w.append(tpnts[j], nrec ? &pResults[(i * ntp + j) * nrec] : 0);
+        }
+    }
+    w.close();
+#else
+    std::ostringstream os;
+    os << "HDF5 output is not available: STEPS was built without HDF5.";
+    throw steps::NotImplErr(os.str());
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
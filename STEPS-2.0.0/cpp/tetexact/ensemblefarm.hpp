@@ -0,0 +1,255 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETEXACT_ENSEMBLEFARM_HPP
+#define STEPS_TETEXACT_ENSEMBLEFARM_HPP 1
+
+// STL headers.
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+// STEPS headers.
+#include "../common.h"
+#include "../model/model.hpp"
+#include "../geom/geom.hpp"
+#include "ensemble.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Interval (in microseconds) at which the coordinating rank of an
+/// EnsembleFarm polls for requests while it runs realisations itself.
+#define ENSEMBLEFARM_POLL_USEC          1000
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetexact)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Spreads the realisations of an Ensemble over the ranks of an MPI job.
+///
+/// Every rank builds the same farm and calls run() or sweep() with the
+/// same arguments. Rank 0 hands the seeds out in chunks, one at a time,
+/// to whichever rank asks next, so a rank that drew short realisations
+/// simply comes back for more and uneven run times do not leave ranks
+/// idle. Each rank runs its chunks on its own Ensemble, on all its
+/// threads. Rank 0 answers the requests from a thread of its own and
+/// runs chunks as well, if the MPI library allows calls from more than
+/// one thread (MPI_THREAD_SERIALIZED); otherwise it only hands out work.
+///
+/// The results of each chunk go back to rank 0 with the next request.
+/// Rank 0 returns them all, in the layout of Ensemble::run, and can
+/// write them to one HDF5 file; the other ranks return nothing.
+///
+/// MPI is initialized on first use if the caller has not done so (and
+/// finalized at exit). Without STEPS_USE_MPI (setup.py defines it when it
+/// finds MPI) the farm runs everything on the calling process, as rank 0
+/// of 1.
+///
+class EnsembleFarm
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Constructor; the arguments are those of the Ensemble of each rank.
+    ///
+    EnsembleFarm(steps::model::Model * m, steps::wm::Geom * g,
+                 std::string const & init_file, uint nthreads,
+                 std::string const & rng_name = "mt19937", uint rng_bufsize = 512,
+                 bool calcMembPot = false, std::string const & scheduler = "cr");
+
+    ~EnsembleFarm(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // RANKS
+    ////////////////////////////////////////////////////////////////////////
+
+    uint getRank(void) const
+    { return pRank; }
+
+    uint getNRanks(void) const
+    { return pNRanks; }
+
+    /// The number of realisations handed to a rank at a time; 0 (the
+    /// default) for the number of threads of its Ensemble. Larger chunks
+    /// mean fewer messages, smaller ones a finer balance.
+    ///
+    void setChunk(uint n);
+
+    uint getChunk(void) const
+    { return pChunk; }
+
+    /// On rank 0 after a run, the number of realisations each rank ran.
+    ///
+    std::vector<double> getRankLoads(void) const
+    { return pLoads; }
+
+    ////////////////////////////////////////////////////////////////////////
+    // RECORDING AND PARAMETERS (see Ensemble)
+    ////////////////////////////////////////////////////////////////////////
+
+    void addCompCountRecord(std::string const & c, std::string const & s);
+    void addPatchCountRecord(std::string const & p, std::string const & s);
+
+    uint getNRecords(void) const
+    { return pEnsemble.getNRecords(); }
+
+    void addCompReacKParam(std::string const & c, std::string const & r);
+    void addPatchSReacKParam(std::string const & p, std::string const & sr);
+
+    uint getNParams(void) const
+    { return pEnsemble.getNParams(); }
+
+    void setStreams(bool on, uint master = 0)
+    { pEnsemble.setStreams(on, master); }
+
+    bool getStreams(void) const
+    { return pEnsemble.getStreams(); }
+
+    ////////////////////////////////////////////////////////////////////////
+    // SIMULATION CONTROLS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// As Ensemble::run, over all ranks. On rank 0, returns the recorded
+    /// values of all seeds and, if h5_file is not empty, writes them to
+    /// that HDF5 file: /data holds a row per seed and time point (seed
+    /// major) and a column per record, /time the time of each row and
+    /// /seeds the seeds. Other ranks return an empty list.
+    ///
+    std::vector<double> run(std::vector<uint> const & seeds,
+                            std::vector<double> const & tpnts,
+                            std::string const & h5_file = "");
+
+    /// As Ensemble::sweep, over all ranks. Output is as for run(), and
+    /// the HDF5 file also holds the parameter sets in /params.
+    ///
+    std::vector<double> sweep(std::vector<double> const & values,
+                              std::vector<uint> const & seeds,
+                              std::vector<double> const & tpnts,
+                              std::string const & h5_file = "");
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// The communicator of the farm.
+    struct Comm;
+
+    /// Entry point of the thread that answers the requests on rank 0.
+    ///
+    static void * _serve(void * arg);
+
+    /// Run all seeds over the ranks; values is null for run().
+    ///
+    std::vector<double> _farm(std::vector<double> const * values,
+                              std::vector<uint> const & seeds,
+                              std::vector<double> const & tpnts,
+                              std::string const & h5_file);
+
+    /// Take the first seed of the next chunk on rank 0; false once there
+    /// are none left or a chunk has failed.
+    ///
+    bool _takeChunk(uint & first);
+
+    /// The number of seeds of the chunk starting at first.
+    ///
+    uint _chunkSize(uint first) const;
+
+    /// Run the chunk starting at first on this rank's Ensemble.
+    ///
+    std::vector<double> _runChunk(uint first);
+
+    /// On rank 0, store the results of the chunk starting at first, run
+    /// by rank, or the error it failed with.
+    ///
+    void _store(uint first, uint rank, double const * vals);
+    void _fail(std::string const & msg);
+
+    /// Bring the error of a run, if any, from rank 0 to all ranks and
+    /// throw it there.
+    ///
+    void _checkError(void);
+
+    /// On rank 0, write the results of a run to HDF5 file h5_file.
+    ///
+    void _writeHDF5(std::string const & h5_file,
+                    std::vector<double> const * values,
+                    std::vector<uint> const & seeds,
+                    std::vector<double> const & tpnts) const;
+
+    ////////////////////////////////////////////////////////////////////////
+
+    Ensemble                            pEnsemble;
+
+    /// A label for each record, as the Recorder writes them.
+    std::vector<std::string>            pLabels;
+
+    uint                                pChunk;
+
+    Comm                              * pComm;
+    uint                                pRank;
+    uint                                pNRanks;
+    /// Whether rank 0 runs chunks while a thread answers the requests.
+    bool                                pServeThread;
+
+    ////////////////////////////////////////////////////////////////////////
+    // STATE OF THE CURRENT RUN
+    ////////////////////////////////////////////////////////////////////////
+
+    std::vector<uint> const           * pSeeds;
+    std::vector<double> const         * pTpnts;
+    std::vector<double> const         * pValues;
+    uint                                pRunChunk;
+
+    /// On rank 0: the results of all seeds, the realisations run by each
+    /// rank, the next seed to hand out and the first error, guarded by
+    /// pMutex.
+    std::vector<double>                 pResults;
+    std::vector<double>                 pLoads;
+    uint                                pNextSeed;
+    std::string                         pError;
+
+    pthread_mutex_t                     pMutex;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetexact)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETEXACT_ENSEMBLEFARM_HPP
+
+// END
@@ -0,0 +1,206 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <pthread.h>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "eventtrace.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::tetexact, stex);
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::EventTrace::EventTrace(std::string const & file_name, double t0,
+                             double resolution, std::string const & header)
+: pT0(t0)
+, pInvRes(1.0 / resolution)
+, pLastTick(0)
+, pLastKProc(0)
+, pCount(0)
+, pBuf(0)
+, pPos(0)
+, pEnd(0)
+, pSpare(0)
+, pSpareLen(0)
+, pFile(0)
+, pFailed(false)
+, pClosing(false)
+, pThreaded(false)
+{
+    pFile = std::fopen(file_name.c_str(), "wb");
+    if (pFile == 0)
+    {
+        std::ostringstream os;
+        os << "Cannot open event trace file '" << file_name << "'.\n";
+        throw steps::IOErr(os.str());
+    }
+
+    std::string start(EVENTTRACE_MAGIC);
+    putVarint(start, EVENTTRACE_VERSION);
+    start.append(reinterpret_cast<char const *>(&t0), sizeof(double));
+    start.append(reinterpret_cast<char const *>(&resolution), sizeof(double));
+    start += header;
+    if (std::fwrite(start.data(), 1, start.size(), pFile) != start.size())
+    {
+        std::fclose(pFile);
+        pFile = 0;
+        std::ostringstream os;
+        os << "Cannot write event trace file '" << file_name << "'.\n";
+        throw steps::IOErr(os.str());
+    }
+
+    pBuf = new unsigned char[EVENTTRACE_BUFSIZE];
+    pSpare = new unsigned char[EVENTTRACE_BUFSIZE];
+    pPos = pBuf;
+    pEnd = pBuf + EVENTTRACE_BUFSIZE;
+
+    pthread_mutex_init(&pMutex, 0);
+    pthread_cond_init(&pCond, 0);
+    // Without a thread the buffers are written out as they fill.
+    pThreaded = (pthread_create(&pThread, 0, _writer, this) == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::EventTrace::~EventTrace(void)
+{
+    try
+    {
+        close();
+    }
+    catch (steps::Err &)
+    {
+    }
+    pthread_cond_destroy(&pCond);
+    pthread_mutex_destroy(&pMutex);
+    delete[] pBuf;
+    delete[] pSpare;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EventTrace::close(void)
+{
+    if (pFile == 0) return;
+
+    _flush();
+    if (pThreaded == true)
+    {
+        pthread_mutex_lock(&pMutex);
+        pClosing = true;
+        pthread_cond_broadcast(&pCond);
+        pthread_mutex_unlock(&pMutex);
+        pthread_join(pThread, 0);
+        pThreaded = false;
+    }
+    if (std::fclose(pFile) != 0) pFailed = true;
+    pFile = 0;
+
+    if (pFailed == true)
+    {
+        std::ostringstream os;
+        os << "Event trace could not be written in full.\n";
+        throw steps::IOErr(os.str());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EventTrace::putVarint(std::string & s, unsigned long long n)
+{
+    while (n >= 0x80)
+    {
+        s += static_cast<char>(n | 0x80);
+        n >>= 7;
+    }
+    s += static_cast<char>(n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::EventTrace::_flush(void)
+{
+    std::size_t len = pPos - pBuf;
+    if (len == 0) return;
+
+    if (pThreaded == false)
+    {
+        if (std::fwrite(pBuf, 1, len, pFile) != len) pFailed = true;
+        pPos = pBuf;
+        return;
+    }
+
+    pthread_mutex_lock(&pMutex);
+    while (pSpareLen != 0) pthread_cond_wait(&pCond, &pMutex);
+    std::swap(pBuf, pSpare);
+    pSpareLen = len;
+    pthread_cond_broadcast(&pCond);
+    pthread_mutex_unlock(&pMutex);
+
+    pPos = pBuf;
+    pEnd = pBuf + EVENTTRACE_BUFSIZE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void * stex::EventTrace::_writer(void * arg)
+{
+    EventTrace * tr = static_cast<EventTrace *>(arg);
+    pthread_mutex_lock(&tr->pMutex);
+    while (true)
+    {
+        while (tr->pSpareLen == 0 && tr->pClosing == false)
+        {
+            pthread_cond_wait(&tr->pCond, &tr->pMutex);
+        }
+        if (tr->pSpareLen == 0) break;
+
+        // The buffer is the writer's until pSpareLen is cleared.
+        unsigned char const * buf = tr->pSpare;
+        std::size_t len = tr->pSpareLen;
+        pthread_mutex_unlock(&tr->pMutex);
+        bool ok = (std::fwrite(buf, 1, len, tr->pFile) == len);
+        pthread_mutex_lock(&tr->pMutex);
+
+        if (ok == false) tr->pFailed = true;
+        tr->pSpareLen = 0;
+        pthread_cond_broadcast(&tr->pCond);
+    }
+    pthread_mutex_unlock(&tr->pMutex);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETEXACT_EVENTTRACE_HPP
+#define STEPS_TETEXACT_EVENTTRACE_HPP 1
+
+// STL headers.
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <pthread.h>
+
+// STEPS headers.
+#include "../common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetexact)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Magic string and format version at the start of an event trace file.
+#define EVENTTRACE_MAGIC            "STEPSEVT"
+#define EVENTTRACE_VERSION          1
+
+// Size of each of the two buffers of an event trace, in bytes.
+#define EVENTTRACE_BUFSIZE          (1 << 20)
+
+// The longest record: two 64 bit varints.
+#define EVENTTRACE_MAXRECORD        20
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// A stream of (time, kproc) event records written to a file by a
+/// background thread.
+///
+/// The file holds the magic string, the format version as a varint, the
+/// start time and the time resolution as 8 byte doubles, and a header
+/// supplied by the solver (see Tetexact::startEventTrace), followed by
+/// one record per event until the end of the file. A record is two
+/// varints: the change in the event time, counted in whole ticks of the
+/// resolution from the start time, and the change in the kproc index,
+/// both zigzag encoded so that either may go back (after a restore, or
+/// to a lower index). The ticks are taken from the absolute time, so
+/// rounding does not add up over a long trace.
+///
+/// Varints are little-endian base 128: 7 bits per byte, the high bit set
+/// on all but the last byte. Zigzag maps 0, -1, 1, -2, ... to 0, 1, 2,
+/// 3, ...
+///
+/// Records are encoded into one buffer while the writer thread writes
+/// the other out; add() only waits when the writer is a full buffer
+/// behind.
+///
+class EventTrace
+{
+
+public:
+
+    /// Open file_name and write the start of the file, ending with
+    /// header, and start the writer thread. Throws IOErr if the file
+    /// cannot be opened.
+    ///
+    EventTrace(std::string const & file_name, double t0, double resolution,
+               std::string const & header);
+
+    /// Closes the trace, discarding any write error.
+    ///
+    ~EventTrace(void);
+
+    /// Record an event of kproc kidx at time t.
+    ///
+    inline void add(double t, uint kidx)
+    {
+        long long tick = static_cast<long long>((t - pT0) * pInvRes);
+        long long k = kidx;
+        _putZigzag(tick - pLastTick);
+        _putZigzag(k - pLastKProc);
+        pLastTick = tick;
+        pLastKProc = k;
+        ++pCount;
+        if (pEnd - pPos < EVENTTRACE_MAXRECORD) _flush();
+    }
+
+    /// Write out the records so far, stop the writer and close the file.
+    /// Throws IOErr if any write failed.
+    ///
+    void close(void);
+
+    /// The number of events recorded.
+    ///
+    unsigned long long count(void) const
+    { return pCount; }
+
+    /// Append n to s as a varint.
+    ///
+    static void putVarint(std::string & s, unsigned long long n);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    inline void _putZigzag(long long n)
+    {
+        unsigned long long z = (static_cast<unsigned long long>(n) << 1)
+                               ^ static_cast<unsigned long long>(n >> 63);
+        while (z >= 0x80)
+        {
+            *pPos++ = static_cast<unsigned char>(z | 0x80);
+            z >>= 7;
+        }
+        *pPos++ = static_cast<unsigned char>(z);
+    }
+
+    /// Hand the current buffer to the writer and take the other one.
+    ///
+    void _flush(void);
+
+    /// Writer thread entry point.
+    ///
+    static void * _writer(void * arg);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    double                              pT0;
+    double                              pInvRes;
+
+    long long                           pLastTick;
+    long long                           pLastKProc;
+    unsigned long long                  pCount;
+
+    // The buffer being filled.
+    unsigned char                     * pBuf;
+    unsigned char                     * pPos;
+    unsigned char                     * pEnd;
+
+    // The other buffer, and the number of its bytes the writer has still
+    // to write (0 when it is free), guarded by pMutex.
+    unsigned char                     * pSpare;
+    std::size_t                         pSpareLen;
+
+    std::FILE                         * pFile;
+    bool                                pFailed;
+    bool                                pClosing;
+    bool                                pThreaded;
+
+    pthread_t                           pThread;
+    pthread_mutex_t                     pMutex;
+    pthread_cond_t                      pCond;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetexact)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETEXACT_EVENTTRACE_HPP
+
+// END
@@ -48,7 +48,7 @@ NAMESPACE_ALIAS(steps::math, sm);
 ////////////////////////////////////////////////////////////////////////////////
 
 stex::GHKcurr::GHKcurr(ssolver::GHKcurrdef * ghkdef, stex::Tri * tri)
-: KProc()
+: KProc(stex::KP_GHKCURR)
 , pGHKcurrdef(ghkdef)
 , pTri(tri)
 , pUpdVec()
@@ -66,50 +66,35 @@ stex::GHKcurr::~GHKcurr(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::GHKcurr::checkpoint(std::fstream & cp_file)
+void stex::GHKcurr::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&rExtent, sizeof(uint));
     cp_file.write((char*)&pFlags, sizeof(uint));
     cp_file.write((char*)&pEffFlux, sizeof(bool));
-
-    cp_file.write((char*)&(crData.recorded), sizeof(bool));
-    cp_file.write((char*)&(crData.pow), sizeof(int));
-    cp_file.write((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.write((char*)&(crData.rate), sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::GHKcurr::restore(std::fstream & cp_file)
+void stex::GHKcurr::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&rExtent, sizeof(uint));
     cp_file.read((char*)&pFlags, sizeof(uint));
     cp_file.read((char*)&pEffFlux, sizeof(bool));
-
-    cp_file.read((char*)&(crData.recorded), sizeof(bool));
-    cp_file.read((char*)&(crData.pow), sizeof(int));
-    cp_file.read((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.read((char*)&(crData.rate), sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void stex::GHKcurr::reset(void)
 {
-
-    crData.recorded = false;
-    crData.pow = 0;
-    crData.pos = 0;
-    crData.rate = 0.0;
 	setActive(true);
 	pEffFlux = true;	//TODO: come back to this and check if rate needs to be recalculated here
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::GHKcurr::setupDeps(void)
+void stex::GHKcurr::setupDeps(stex::Arena & arena)
 {
-    std::set<stex::KProc*> updset;
+    std::vector<stex::KProc*> updvec;
 
     // The only concentration changes for a GHK current event are in the outer
     // and inner volume. The flux can involve movement of ion from either
@@ -121,54 +106,10 @@ void stex::GHKcurr::setupDeps(void)
     // The global species of the ion
     const uint gidxion = pGHKcurrdef->ion();
 
-    // First check KProcs in the inner tetrahedron
-    KProcPVecCI kprocend = itet->kprocEnd();
-    for (KProcPVecCI k = itet->kprocBegin(); k != kprocend; ++k)
-    {
-        if ((*k)->depSpecTet(gidxion, itet) == true)
-            updset.insert(*k);
-    }
-
-    std::vector<stex::Tri *>::const_iterator tri_end = itet->nexttriEnd();
-    for (std::vector<stex::Tri *>::const_iterator tri = itet->nexttriBegin();
-			 tri != tri_end; ++tri)
-    {
-    	if ((*tri) == 0) continue;
-
-        kprocend = (*tri)->kprocEnd();
-        for (KProcPVecCI k = (*tri)->kprocBegin(); k != kprocend; ++k)
-        {
-            if ((*k)->depSpecTet(gidxion, itet) == true)
-            	updset.insert(*k);
-        }
-    }
-
-    if (otet != 0)
-    {
-    	// Now check KProcs in the outer tetrahedron
-    	kprocend = otet->kprocEnd();
-    	for (KProcPVecCI k = otet->kprocBegin(); k != kprocend; ++k)
-    	{
-    		if ((*k)->depSpecTet(gidxion, otet) == true)
-    			updset.insert(*k);
-    	}
-
-    	tri_end = otet->nexttriEnd();
-    	for (std::vector<stex::Tri *>::const_iterator tri = otet->nexttriBegin();
-			tri != tri_end; ++tri)
-    	{
-    		if ((*tri) == 0) continue;
-
-    		kprocend = (*tri)->kprocEnd();
-    		for (KProcPVecCI k = (*tri)->kprocBegin(); k != kprocend; ++k)
-    		{
-    			if ((*k)->depSpecTet(gidxion, otet) == true)
-    				updset.insert(*k);
-    		}
-    	}
-    }
-
-    pUpdVec.assign(updset.begin(), updset.end());
+    itet->specDeps(gidxion, updvec);
+    if (otet != 0) otet->specDeps(gidxion, updvec);
+
+    pUpdVec = _pack(arena, updvec);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -236,7 +177,7 @@ double stex::GHKcurr::rate(double v, double T)
 	uint ghklidx = pdef->ghkcurrG2L(pGHKcurrdef->gidx());
 	// Fetch the local index of the channelstate
 	uint cslidx = pdef->ghkcurr_chanstate(ghklidx);
-	double n = static_cast<double>(pTri->pools()[cslidx]);
+	double n = static_cast<double>(pTri->count(cslidx));
 
 	return fabs(rt) * n;
 }
@@ -260,8 +201,7 @@ double stex::GHKcurr::rate(steps::tetexact::Tetexact * solver)
 	double v = solver->getTriV(pTri->idx());
 	double T = solver->getTemp();
 
-	double flux = sm::GHKcurrent(pGHKcurrdef->perm(), v+pGHKcurrdef->vshift(), pGHKcurrdef->valence(),
-								 T, iconc, oconc);
+	double flux = pGHKcurrdef->getFlux(v, T, iconc, oconc);
 
 	// Note: For a positive flux, this could be an efflux of +ve cations,
 	// or an influx of -ve anions. Need to check the valence.
@@ -278,14 +218,14 @@ double stex::GHKcurr::rate(steps::tetexact::Tetexact * solver)
 	uint ghklidx = pdef->ghkcurrG2L(pGHKcurrdef->gidx());
 	// Fetch the local index of the channelstate
 	uint cslidx = pdef->ghkcurr_chanstate(ghklidx);
-	double n = static_cast<double>(pTri->pools()[cslidx]);
+	double n = static_cast<double>(pTri->count(cslidx));
 
 	return fabs(rt) * n;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::vector<stex::KProc*> const & stex::GHKcurr::apply(steps::rng::RNG * rng, double dt, double simtime)
+stex::KProcIdxSpan stex::GHKcurr::apply(steps::rng::RNG * rng, double dt, double simtime)
 {
     stex::WmVol * itet = pTri->iTet();
     stex::WmVol * otet = pTri->oTet();
@@ -339,6 +279,7 @@ std::vector<stex::KProc*> const & stex::GHKcurr::apply(steps::rng::RNG * rng, do
 	}
 
     rExtent++;
+    rModified = true;
 
     return pUpdVec;
 }
@@ -69,16 +69,16 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
 
     ////////////////////////////////////////////////////////////////////////
     // VIRTUAL INTERFACE METHODS
     ////////////////////////////////////////////////////////////////////////
 
-    void setupDeps(void);
+    void setupDeps(steps::tetexact::Arena & arena);
     bool depSpecTet(uint gidx, steps::tetexact::WmVol * tet);
     bool depSpecTri(uint gidx, steps::tetexact::Tri * tri);
     void reset(void);
@@ -87,17 +87,20 @@ public:
     double rate(steps::tetexact::Tetexact * solver);
 
     // double rate(double v, double T);
-    std::vector<KProc*> const & apply(steps::rng::RNG * rng, double dt, double simtime);
+    steps::tetexact::KProcIdxSpan apply(steps::rng::RNG * rng, double dt, double simtime);
 
     inline bool efflux(void) const
     { return pEffFlux; }
 
     void setEffFlux(bool efx)
-    { pEffFlux = efx; }
+    { pEffFlux = efx; rModified = true; }
 
     uint updVecSize(void) const
     { return pUpdVec.size(); }
 
+    steps::tetexact::KProcIdxSpan & updList(uint i)
+    { return pUpdVec; }
+
     ////////////////////////////////////////////////////////////////////////
 
 private:
@@ -106,7 +109,7 @@ private:
 
     steps::solver::GHKcurrdef         * pGHKcurrdef;
     steps::tetexact::Tri              * pTri;
-    std::vector<KProc*>                 pUpdVec;
+    steps::tetexact::KProcIdxSpan         pUpdVec;
 
     // Flag if flux is outward, positive flux (true) or inward, negative flux (false)
     bool								pEffFlux;
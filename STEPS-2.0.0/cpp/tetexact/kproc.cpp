@@ -31,11 +31,17 @@
 
 // Standard library & STL headers.
 #include <vector>
+#include <set>
+#include <algorithm>
 #include <cassert>
 
 // STEPS headers.
 #include "../common.h"
+#include "../solver/compdef.hpp"
+#include "../solver/patchdef.hpp"
 #include "kproc.hpp"
+#include "wmvol.hpp"
+#include "tri.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -43,11 +49,14 @@ NAMESPACE_ALIAS(steps::tetexact, stex);
 
 ////////////////////////////////////////////////////////////////////////////////
 
-stex::KProc::KProc(void)
+stex::KProc::KProc(stex::KProcType type)
 : rExtent(0)
+, rModified(true)
 , pFlags(0)
 , pSchedIDX(0)
-, crData()
+, pType(type)
+, pDepsResolved(true)
+, pPruned(false)
 {
 }
 
@@ -59,10 +68,141 @@ stex::KProc::~KProc(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+stex::KProcIdxSpan stex::KProc::_pack(stex::Arena & arena,
+                                    std::vector<stex::KProc *> & kprocs)
+{
+    uint nkprocs = kprocs.size();
+    if (nkprocs == 0) return KProcIdxSpan();
+    std::vector<uint> idxs(nkprocs);
+    for (uint i = 0; i < nkprocs; ++i) idxs[i] = kprocs[i]->schedIDX();
+    std::sort(idxs.begin(), idxs.end());
+    idxs.erase(std::unique(idxs.begin(), idxs.end()), idxs.end());
+    uint n = idxs.size();
+    uint const * p = static_cast<uint const *>(arena.share(&idxs[0], n * sizeof(uint)));
+    return KProcIdxSpan(p, p + n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// An update list of a source kproc: where it is, and which list of
+// which kproc it is.
+struct DepRef
+{
+    uint const                        * begin;
+    uint                                size;
+    uint                                kproc;
+    uint                                list;
+};
+
+struct DepRefLess
+{
+    bool operator()(DepRef const & a, DepRef const & b) const
+    {
+        if (a.begin != b.begin) return a.begin < b.begin;
+        return a.size < b.size;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::KProc::copyDeps(std::vector<stex::KProc *> const & src,
+                           std::vector<stex::KProc *> const & kprocs,
+                           stex::Arena & arena)
+{
+    assert(src.size() == kprocs.size());
+    std::vector<DepRef> refs;
+    uint nkprocs = kprocs.size();
+    for (uint k = 0; k < nkprocs; ++k)
+    {
+        assert(src[k]->type() == kprocs[k]->type());
+        uint nlists = kprocs[k]->countUpdLists();
+        assert(src[k]->countUpdLists() == nlists);
+        for (uint l = 0; l < nlists; ++l)
+        {
+            KProcIdxSpan const & from = src[k]->updList(l);
+            if (from.size() == 0)
+            {
+                kprocs[k]->updList(l) = KProcIdxSpan();
+                continue;
+            }
+            DepRef r = { from.begin(), from.size(), k, l };
+            refs.push_back(r);
+        }
+        kprocs[k]->pDepsResolved = src[k]->pDepsResolved;
+        kprocs[k]->pPruned = src[k]->pPruned;
+    }
+
+    // Lists src shares start at the same address: sorted by address,
+    // each is copied once and handed to every kproc that had it.
+    std::sort(refs.begin(), refs.end(), DepRefLess());
+    uint nrefs = refs.size();
+    uint r = 0;
+    while (r < nrefs)
+    {
+        uint n = refs[r].size;
+        uint * p = arena.allocArray<uint>(n);
+        std::copy(refs[r].begin, refs[r].begin + n, p);
+        KProcIdxSpan to(p, p + n);
+        uint s = r;
+        while (r < nrefs && refs[r].begin == refs[s].begin && refs[r].size == n)
+        {
+            kprocs[refs[r].kproc]->updList(refs[r].list) = to;
+            ++r;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t stex::KProc::getUpdListMemoryUsage(std::set<uint const *> & counted)
+{
+    std::size_t bytes = 0;
+    uint nlists = countUpdLists();
+    for (uint l = 0; l < nlists; ++l)
+    {
+        KProcIdxSpan const & upd = updList(l);
+        if (upd.size() == 0) continue;
+        if (counted.insert(upd.begin()).second == false) continue;
+        bytes += Arena::footprint(upd.size() * sizeof(uint));
+    }
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::KProc::depSpecsTet(stex::WmVol * tet, std::vector<uint> & lidxs)
+{
+    uint nspecs = tet->compdef()->countSpecs();
+    for (uint i = 0; i < nspecs; ++i)
+    {
+        if (depSpecTet(tet->compdef()->specL2G(i), tet) == true)
+        {
+            lidxs.push_back(i);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::KProc::depSpecsTri(stex::Tri * tri, std::vector<uint> & lidxs)
+{
+    uint nspecs = tri->patchdef()->countSpecs();
+    for (uint i = 0; i < nspecs; ++i)
+    {
+        if (depSpecTri(tri->patchdef()->specL2G(i), tri) == true)
+        {
+            lidxs.push_back(i);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void stex::KProc::setActive(bool active)
 {
     if (active == true) pFlags &= ~INACTIVATED;
     else pFlags |= INACTIVATED;
+    rModified = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -77,6 +217,15 @@ uint stex::KProc::getExtent(void) const
 void stex::KProc::resetExtent(void)
 {
 	rExtent = 0;
+	rModified = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::KProc::setExtent(uint extent)
+{
+	rExtent = extent;
+	rModified = true;
 }
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -104,4 +253,19 @@ double stex::KProc::h(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+bool stex::KProc::leapStoich(std::vector<stex::LeapTerm> & lhs,
+                             std::vector<stex::LeapTerm> & upd) const
+{
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::KProc::applyN(steps::rng::RNG * rng, uint n, double dt, double simtime)
+{
+	for (uint i = 0; i < n; ++i) apply(rng, dt, simtime);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
@@ -36,16 +36,17 @@
 
 // STL headers.
 #include <vector>
+#include <set>
 #include <fstream>
 
 // STEPS headers.
 #include "../common.h"
 #include "../solver/types.hpp"
 #include "../rng/rng.hpp"
+#include "arena.hpp"
 //#include "tetexact.hpp"
 
 // Tetexact CR header
-#include "crstruct.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -70,6 +71,80 @@ typedef KProcPVec::const_iterator       KProcPVecCI;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// A read-only list of kprocs held in an Arena, such as the kprocs to
+/// update after an event. The kprocs are given by their 32-bit schedule
+/// index, their place in the kproc list of the solver (where they are
+/// ordered by type), which takes half the room of a pointer. All lists
+/// of a solver are packed one after the other, instead of each owning a
+/// separate heap block, and identical lists (e.g. of two reactions that
+/// change the same species of one tetrahedron) are stored once.
+///
+class KProcIdxSpan
+{
+
+public:
+
+    KProcIdxSpan(void)
+    : pBegin(0), pEnd(0)
+    { }
+
+    KProcIdxSpan(uint const * b, uint const * e)
+    : pBegin(b), pEnd(e)
+    { }
+
+    inline uint const * begin(void) const
+    { return pBegin; }
+    inline uint const * end(void) const
+    { return pEnd; }
+    inline uint size(void) const
+    { return pEnd - pBegin; }
+    inline uint operator[](uint i) const
+    { return pBegin[i]; }
+
+private:
+
+    uint const                        * pBegin;
+    uint const                        * pEnd;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// A species pool touched by a KProc, as seen by the tau-leaping mode of
+/// Tetexact. In the list of reactants n is the number of molecules one
+/// instance consumes. In the list of updates n is the mean change per
+/// instance and var its variance; exact is false if the change is random
+/// (diffusion into one of several neighbours), in which case the change
+/// is never negative.
+///
+struct LeapTerm
+{
+    steps::tetexact::WmVol            * vol;
+    uint                                lidx;
+    double                              n;
+    double                              var;
+    bool                                exact;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The concrete class of a KProc, so that the solver can dispatch on it
+/// without going through the vtable.
+///
+enum KProcType
+{
+    KP_REAC = 0,
+    KP_DIFF,
+    KP_SREAC,
+    KP_SDIFF,
+    KP_VDEPTRANS,
+    KP_VDEPSREAC,
+    KP_GHKCURR,
+    KP_NTYPES
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 class KProc
 
 {
@@ -79,17 +154,17 @@ public:
     // OBJECT CONSTRUCTION & DESTRUCTION
     ////////////////////////////////////////////////////////////////////////
 
-    KProc(void);
+    KProc(KProcType type);
     virtual ~KProc(void);
 
     ////////////////////////////////////////////////////////////////////////
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    virtual void checkpoint(std::fstream & cp_file) = 0;
+    virtual void checkpoint(std::iostream & cp_file) = 0;
 
     /// restore data
-    virtual void restore(std::fstream & cp_file) = 0;
+    virtual void restore(std::iostream & cp_file) = 0;
 
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS
@@ -107,6 +182,9 @@ public:
     inline uint flags(void) const
     { return pFlags; }
 
+    inline KProcType type(void) const
+    { return pType; }
+
     ////////////////////////////////////////////////////////////////////////
 
     uint schedIDX(void) const
@@ -115,18 +193,48 @@ public:
     void setSchedIDX(uint idx)
     { pSchedIDX = idx; }
 
+    /// Whether the update lists of this kproc have been resolved. A
+    /// Tetexact created with lazydeps leaves them unresolved until the
+    /// kproc first fires.
+    ///
+    inline bool depsResolved(void) const
+    { return pDepsResolved; }
+
+    void setDepsResolved(bool resolved)
+    { pDepsResolved = resolved; }
+
+    /// Whether the kproc can never fire and is left out of the update
+    /// lists of the others (see Tetexact::setNetworkPruning).
+    ///
+    inline bool pruned(void) const
+    { return pPruned; }
+
+    void setPruned(bool pruned)
+    { pPruned = pruned; }
+
     ////////////////////////////////////////////////////////////////////////
     // VIRTUAL INTERFACE METHODS
     ////////////////////////////////////////////////////////////////////////
 
     /// This function is called when all kproc objects have been created,
-    /// allowing the kproc to pre-compute its SchedIDXVec.
+    /// allowing the kproc to pre-compute its update lists, which it
+    /// stores in the arena.
     ///
-    virtual void setupDeps(void) = 0;
+    virtual void setupDeps(steps::tetexact::Arena & arena) = 0;
 
     virtual bool depSpecTet(uint gidx, steps::tetexact::WmVol * tet) = 0;
     virtual bool depSpecTri(uint gidx, steps::tetexact::Tri * tri) = 0;
 
+    /// Append the local indices of the species in tet (or tri) that this
+    /// kproc depends on to lidxs, in increasing order. The default asks
+    /// depSpecTet (or depSpecTri) for every species; kprocs with sparse
+    /// dependency lists in their def objects return these directly.
+    ///
+    virtual void depSpecsTet(steps::tetexact::WmVol * tet,
+                             std::vector<uint> & lidxs);
+    virtual void depSpecsTri(steps::tetexact::Tri * tri,
+                             std::vector<uint> & lidxs);
+
     /// Reset this Kproc.
     ///
     virtual void reset(void) = 0;
@@ -147,19 +255,67 @@ public:
     virtual double h(void);
 
     /// Apply a single discrete instance of the kinetic process, returning
-    /// a vector of kproc schedule indices that need to be updated as a
-    /// result.
+    /// the kprocs that need to be updated as a result.
     ///
     // NOTE: Random number generator available to this function for use
     // by Diff
-    virtual std::vector<KProc*> const & apply(steps::rng::RNG * rng, double dt, double simtime) = 0;
+    virtual KProcIdxSpan apply(steps::rng::RNG * rng, double dt, double simtime) = 0;
 
     virtual uint updVecSize(void) const = 0;
 
+    /// The number of update lists of this kproc: one per direction for
+    /// diffusion, otherwise one.
+    ///
+    virtual uint countUpdLists(void) const
+    { return 1; }
+
+    /// Update list i of this kproc.
+    ///
+    virtual KProcIdxSpan & updList(uint i) = 0;
+
+    /// Make the update lists of each kproc in kprocs copies of those of
+    /// the kproc with the same schedule index in src, the kprocs of
+    /// another solver. The schedule indices are the same in both, so the
+    /// lists are copied as they are. Each distinct list of src is copied
+    /// into arena once, so the lists src shares stay shared without
+    /// comparing their contents again.
+    ///
+    static void copyDeps(std::vector<KProc *> const & src,
+                         std::vector<KProc *> const & kprocs,
+                         steps::tetexact::Arena & arena);
+
+    /// Return the number of bytes the update lists of this kproc take
+    /// up in the arena, leaving out lists whose beginning is in counted
+    /// (lists shared with kprocs counted before) and adding the others.
+    ///
+    std::size_t getUpdListMemoryUsage(std::set<uint const *> & counted);
+
+    /// Describe the stoichiometry of this kproc for tau-leaping, by
+    /// appending to lhs and upd. Returns false (the default) if the kproc
+    /// cannot be leaped; it is then always executed as an exact event.
+    ///
+    virtual bool leapStoich(std::vector<LeapTerm> & lhs,
+                            std::vector<LeapTerm> & upd) const;
+
+    /// Apply n instances of the kinetic process at once, as a tau-leap of
+    /// length dt. The default calls apply() n times.
+    ///
+    virtual void applyN(steps::rng::RNG * rng, uint n, double dt, double simtime);
+
     ////////////////////////////////////////////////////////////////////////
 
     uint getExtent(void) const;
     void resetExtent(void);
+    void setExtent(uint extent);
+
+    /// Whether the extent or the parameters have changed since the last
+    /// checkpoint (see Tetexact::checkpointDelta). Set by apply() and by
+    /// the setters of the checkpointed parameters.
+    ///
+    inline bool modified(void) const
+    { return rModified; }
+    inline void setModified(bool modified)
+    { rModified = modified; }
 
     ////////////////////////////////////////////////////////////////////////
     /*
@@ -173,19 +329,31 @@ public:
 
     ////////////////////////////////////////////////////////////////////////
 
-    // data for CR SSA
-    CRKProcData                         crData;
-
 protected:
 
+    /// Sort a list of kprocs by schedule index, drop duplicates and copy
+    /// the indices into the arena, sharing the copy with any identical
+    /// list packed before.
+    ///
+    static KProcIdxSpan _pack(steps::tetexact::Arena & arena,
+                            std::vector<KProc *> & kprocs);
+
     uint                                rExtent;
 
+    bool                                rModified;
+
     ////////////////////////////////////////////////////////////////////////
 
     uint                                pFlags;
 
     uint                                pSchedIDX;
 
+    KProcType                           pType;
+
+    bool                                pDepsResolved;
+
+    bool                                pPruned;
+
     ////////////////////////////////////////////////////////////////////////
 };
 
@@ -30,6 +30,7 @@
  */
 
 // Standard library & STL headers.
+#include <algorithm>
 #include <vector>
 
 // STEPS headers.
@@ -37,6 +38,7 @@
 #include "../solver/compdef.hpp"
 #include "patch.hpp"
 #include "kproc.hpp"
+#include "sdiff.hpp"
 #include "reac.hpp"
 #include "tri.hpp"
 
@@ -51,6 +53,11 @@ stex::Patch::Patch(ssolver::Patchdef * patchdef)
 : pPatchdef(patchdef)
 , pTris()
 , pArea(0.0)
+, pCountTotalsOn(false)
+, pCountTotals()
+, pSDiffNbrs()
+, pSDiffCDF()
+, pSDiffGeom()
 {
     assert(pPatchdef != 0);
 }
@@ -63,14 +70,14 @@ stex::Patch::~Patch(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Patch::checkpoint(std::fstream & cp_file)
+void stex::Patch::checkpoint(std::iostream & cp_file)
 {
     // reserve
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Patch::restore(std::fstream & cp_file)
+void stex::Patch::restore(std::iostream & cp_file)
 {
     // reserve
 }
@@ -96,6 +103,37 @@ void stex::Patch::modCount(uint slidx, double count)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void stex::Patch::setCountTotals(bool on)
+{
+	pCountTotalsOn = on;
+	pCountTotals.assign(on ? def()->countSpecs() : 0, 0.0);
+	double * totals = (on && !pCountTotals.empty()) ? &pCountTotals[0] : 0;
+	TriPVecCI t_end = pTris.end();
+	for (TriPVecCI t = pTris.begin(); t != t_end; ++t)
+	{
+		(*t)->setCountTotals(totals);
+	}
+	if (on) sumCountTotals();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Patch::sumCountTotals(void)
+{
+	uint nspecs = pCountTotals.size();
+	std::fill(pCountTotals.begin(), pCountTotals.end(), 0.0);
+	TriPVecCI t_end = pTris.end();
+	for (TriPVecCI t = pTris.begin(); t != t_end; ++t)
+	{
+		for (uint s = 0; s < nspecs; ++s)
+		{
+			pCountTotals[s] += (*t)->count(s);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 stex::Tri * stex::Patch::pickTriByArea(double rand01) const
 {
     if (countTris() == 0) return 0;
@@ -113,6 +151,50 @@ stex::Tri * stex::Patch::pickTriByArea(double rand01) const
     return *(t_end-1);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Patch::setupSDiffTable(void)
+{
+    uint ntris = pTris.size();
+    pSDiffNbrs.assign(3 * ntris, 0);
+    pSDiffCDF.assign(2 * ntris, 0.0);
+    pSDiffGeom.assign(ntris, 0.0);
+
+    for (uint t = 0; t < ntris; ++t)
+    {
+        stex::Tri * tri = pTris[t];
+        double g[3] = { 0.0, 0.0, 0.0 };
+        uint last = 0;
+        for (uint i = 0; i < 3; ++i)
+        {
+            // Molecules do not cross into other patches.
+            stex::Tri * next = tri->nextTri(i);
+            double dist = tri->dist(i);
+            if (next == 0 || dist <= 0.0 || next->patchdef() != def()) continue;
+            pSDiffNbrs[3 * t + i] = next;
+            g[i] = tri->length(i) / (tri->area() * dist);
+            last = i;
+        }
+        double gsum = g[0] + g[1] + g[2];
+        pSDiffGeom[t] = gsum;
+
+        // The last open direction closes the distribution at exactly 1,
+        // so rounding can never select a direction without a neighbour.
+        if (gsum > 0.0)
+        {
+            double * cdf = &pSDiffCDF[2 * t];
+            cdf[0] = (last == 0) ? 1.0 : g[0] / gsum;
+            cdf[1] = (last <= 1) ? 1.0 : (g[0] + g[1]) / gsum;
+        }
+
+        uint nsdiffs = def()->countSurfDiffs();
+        for (uint i = 0; i < nsdiffs; ++i)
+        {
+            tri->sdiff(i)->setTable(&pSDiffNbrs[3 * t], &pSDiffCDF[2 * t], gsum);
+        }
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /*
 void stex::Patch::setArea(double a)
@@ -123,4 +205,15 @@ void stex::Patch::setArea(double a)
 */
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t stex::Patch::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(Patch);
+    bytes += (pTris.capacity() + pSDiffNbrs.capacity()) * sizeof(Tri *);
+    bytes += (pCountTotals.capacity() + pSDiffCDF.capacity()
+              + pSDiffGeom.capacity()) * sizeof(double);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
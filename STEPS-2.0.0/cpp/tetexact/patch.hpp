@@ -80,10 +80,15 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by the patch and its tables, not
+    /// counting its triangles.
+    ///
+    std::size_t getMemoryUsage(void) const;
 
     /// Checks whether Tri::patchdef() corresponds to this object's
     /// PatchDef. There is no check whether the Tri object has already
@@ -114,12 +119,49 @@ public:
 
     void modCount(uint slidx, double count);
 
+    /// Keep a running total over the triangles of the count of each
+    /// species, updated by the triangles on every change, or stop.
+    /// Turning it on sums the current counts.
+    ///
+    void setCountTotals(bool on);
+
+    inline bool countTotals(void) const
+    { return pCountTotalsOn; }
+
+    /// The running total of local species slidx; only valid while
+    /// countTotals() is on.
+    ///
+    inline double countTotal(uint slidx) const
+    { return pCountTotals[slidx]; }
+
+    /// Sum the running totals afresh from the triangles, after their
+    /// counts were changed in bulk (reset, restore).
+    ///
+    void sumCountTotals(void);
+
 
     inline uint countTris(void) const
     { return pTris.size(); }
 
     stex::Tri * pickTriByArea(double rand01) const;
 
+    ////////////////////////////////////////////////////////////////////////
+    // SURFACE DIFFUSION TABLE
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Build the surface diffusion table of the triangles and point
+    /// their SDiff kprocs at their entries. Per triangle, in the order
+    /// they were added, it holds the three neighbours a molecule can hop
+    /// to (0 where there is no neighbour in this patch), the cumulative
+    /// probabilities of the first two directions, and the sum over the
+    /// edges of length / (area * distance), which times a diffusion
+    /// constant is the rate per molecule. None of it depends on the
+    /// diffusion constant, so all rules of the patch share it. To be
+    /// called once the kprocs of the triangles have been created.
+    ///
+    void setupSDiffTable(void);
+
+
     inline TriPVecCI bgnTri(void) const
     { return pTris.begin(); }
     inline TriPVecCI endTri(void) const
@@ -136,6 +178,15 @@ private:
 
     TriPVec                             pTris;
 
+    bool                                pCountTotalsOn;
+    std::vector<double>                 pCountTotals;
+
+    // The surface diffusion table (see setupSDiffTable): 3 neighbours,
+    // 2 cumulative probabilities and 1 geometric factor per triangle.
+    std::vector<stex::Tri *>            pSDiffNbrs;
+    std::vector<double>                 pSDiffCDF;
+    std::vector<double>                 pSDiffGeom;
+
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <vector>
+#include <cassert>
+#include <fstream>
+#include <algorithm>
+
+// STEPS headers.
+#include "../common.h"
+#include "pools.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::tetexact, stex);
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Pools::Pools(void)
+: pNSpecs(0)
+, pCount(0)
+, pCount16(0)
+, pFlags(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Pools::~Pools(void)
+{
+    delete[] pCount;
+    delete[] pCount16;
+    delete[] pFlags;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Pools::init(uint nspecs)
+{
+    assert(pCount == 0 && pCount16 == 0 && pFlags == 0);
+    pNSpecs = nspecs;
+    pCount = new uint[nspecs];
+    pFlags = new uint[_nFlagWords()];
+    reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Pools::setClamped(uint lidx, bool clamp)
+{
+    assert(lidx < pNSpecs);
+    uint bit = 1u << (lidx & 31);
+    if (clamp == true) pFlags[lidx >> 5] |= bit;
+    else pFlags[lidx >> 5] &= ~bit;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stex::Pools::anyClamped(void) const
+{
+    uint nwords = _nFlagWords();
+    for (uint i = 0; i < nwords; ++i)
+    {
+        if (pFlags[i] != 0) return true;
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Pools::setCompact(bool compact)
+{
+    if (compact == false)
+    {
+        if (pCount16 != 0) _widen();
+        return;
+    }
+    if (pCount16 != 0) return;
+    for (uint i = 0; i < pNSpecs; ++i)
+    {
+        if (pCount[i] > TETEXACT_POOL_COMPACT_MAX) return;
+    }
+    pCount16 = new unsigned short[pNSpecs];
+    std::copy(pCount, pCount + pNSpecs, pCount16);
+    delete[] pCount;
+    pCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Pools::_widen(void)
+{
+    assert(pCount16 != 0);
+    pCount = new uint[pNSpecs];
+    std::copy(pCount16, pCount16 + pNSpecs, pCount);
+    delete[] pCount16;
+    pCount16 = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Pools::reset(void)
+{
+    if (pCount16 != 0) std::fill_n(pCount16, pNSpecs, 0);
+    else std::fill_n(pCount, pNSpecs, 0);
+    std::fill_n(pFlags, _nFlagWords(), 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Pools::checkpoint(std::iostream & cp_file)
+{
+    std::vector<uint> buf(pNSpecs);
+    for (uint i = 0; i < pNSpecs; ++i) buf[i] = count(i);
+    if (pNSpecs != 0) cp_file.write((char*)&buf[0], sizeof(uint) * pNSpecs);
+    for (uint i = 0; i < pNSpecs; ++i) buf[i] = (clamped(i) ? 1 : 0);
+    if (pNSpecs != 0) cp_file.write((char*)&buf[0], sizeof(uint) * pNSpecs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Pools::restore(std::iostream & cp_file)
+{
+    std::vector<uint> buf(pNSpecs);
+    if (pNSpecs != 0) cp_file.read((char*)&buf[0], sizeof(uint) * pNSpecs);
+    for (uint i = 0; i < pNSpecs; ++i) setCount(i, buf[i]);
+    if (pNSpecs != 0) cp_file.read((char*)&buf[0], sizeof(uint) * pNSpecs);
+    for (uint i = 0; i < pNSpecs; ++i) setClamped(i, buf[i] != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t stex::Pools::getMemoryUsage(void) const
+{
+    std::size_t bytes = _nFlagWords() * sizeof(uint);
+    if (pCount16 != 0) bytes += pNSpecs * sizeof(unsigned short);
+    else bytes += pNSpecs * sizeof(uint);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETEXACT_POOLS_HPP
+#define STEPS_TETEXACT_POOLS_HPP 1
+
+// STL headers.
+#include <cassert>
+#include <fstream>
+
+// STEPS headers.
+#include "../common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetexact)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Largest count a compact pool holds before it is widened.
+#define TETEXACT_POOL_COMPACT_MAX   65535
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The molecule counts and clamped flags of the species of one tet,
+/// triangle or well-mixed volume.
+///
+/// The flags are kept one bit per species. The counts are full width
+/// unsigned ints, or, in compact mode, 16-bit; a compact set is widened
+/// for good as soon as any count exceeds TETEXACT_POOL_COMPACT_MAX.
+///
+class Pools
+{
+
+public:
+
+    Pools(void);
+    ~Pools(void);
+
+    /// Allocate nspecs empty, unclamped, full width pools.
+    ///
+    void init(uint nspecs);
+
+    inline uint countSpecs(void) const
+    { return pNSpecs; }
+
+    inline uint count(uint lidx) const
+    {
+        assert(lidx < pNSpecs);
+        return (pCount16 != 0) ? pCount16[lidx] : pCount[lidx];
+    }
+
+    inline void setCount(uint lidx, uint count)
+    {
+        assert(lidx < pNSpecs);
+        if (pCount16 != 0)
+        {
+            if (count <= TETEXACT_POOL_COMPACT_MAX)
+            {
+                pCount16[lidx] = count;
+                return;
+            }
+            _widen();
+        }
+        pCount[lidx] = count;
+    }
+
+    inline void incCount(uint lidx, int inc)
+    {
+        assert(static_cast<int>(count(lidx)) + inc >= 0);
+        setCount(lidx, count(lidx) + inc);
+    }
+
+    inline bool clamped(uint lidx) const
+    {
+        assert(lidx < pNSpecs);
+        return (pFlags[lidx >> 5] >> (lidx & 31)) & 1u;
+    }
+
+    void setClamped(uint lidx, bool clamp);
+
+    /// Whether any species is clamped.
+    ///
+    bool anyClamped(void) const;
+
+    inline bool compact(void) const
+    { return pCount16 != 0; }
+
+    /// Switch to 16-bit counts, if every count fits, or back to full
+    /// width.
+    ///
+    void setCompact(bool compact);
+
+    /// Set all counts to zero and clear all flags.
+    ///
+    void reset(void);
+
+    /// Write the counts and flags as nspecs uints each, whatever the
+    /// storage mode.
+    ///
+    void checkpoint(std::iostream & cp_file);
+
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes allocated for the counts and flags,
+    /// not counting the object itself.
+    ///
+    std::size_t getMemoryUsage(void) const;
+
+private:
+
+    // Not copyable.
+    Pools(Pools const &);
+    Pools & operator=(Pools const &);
+
+    // Move compact counts to full width storage.
+    void _widen(void);
+
+    inline uint _nFlagWords(void) const
+    { return (pNSpecs + 31) / 32; }
+
+    uint                                pNSpecs;
+    uint                              * pCount;
+    unsigned short                    * pCount16;
+    uint                              * pFlags;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetexact)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETEXACT_POOLS_HPP
+
+// END
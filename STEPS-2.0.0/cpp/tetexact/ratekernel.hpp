@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETEXACT_RATEKERNEL_HPP
+#define STEPS_TETEXACT_RATEKERNEL_HPP 1
+
+// STL headers.
+#include <cassert>
+
+// STEPS headers.
+#include "../common.h"
+#include "pools.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetexact)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// cnt * (cnt - 1) * ... * (cnt - N + 1), the number of ordered ways to
+/// pick N molecules out of cnt, or 0 if there are fewer than N.
+///
+template <uint N>
+inline double fallingFactorial(uint cnt)
+{
+    if (cnt < N) return 0.0;
+    return static_cast<double>(cnt - (N - 1)) * fallingFactorial<N - 1>(cnt);
+}
+
+template <>
+inline double fallingFactorial<0>(uint cnt)
+{
+    return 1.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The shape of the left hand side of a reaction.
+///
+enum RateShape
+{
+    RS_ZERO = 0,            // no reactants
+    RS_A,                   // one molecule of one species
+    RS_AA,                  // two molecules of one species
+    RS_AB,                  // one molecule each of two species
+    RS_GENERIC              // anything else
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The combinatorial part of the rate of a reaction of order two or less,
+/// h = prod falling factorial(count, lhs), without looping over the
+/// stoichiometry: the reactants and the shape of the left hand side are
+/// fixed when the reaction's KProc is built. Reactions with more
+/// reactants report generic() and keep their own loop.
+///
+/// The products are formed in the same order as in that loop, so the
+/// result is the same to the last bit.
+///
+class RateKernel
+{
+
+public:
+
+    RateKernel(void)
+    : pShape(RS_ZERO)
+    {
+        pPools[0] = pPools[1] = 0;
+        pLidx[0] = pLidx[1] = 0;
+    }
+
+    /// Add n molecules of species lidx of pools to the left hand side.
+    /// Call in the order the generic loop visits the reactants.
+    ///
+    void addReactant(steps::tetexact::Pools const * pools, uint lidx, uint n)
+    {
+        if (n == 0) return;
+        if (pShape == RS_ZERO && n <= 2)
+        {
+            pShape = (n == 1) ? RS_A : RS_AA;
+            pPools[0] = pools;
+            pLidx[0] = lidx;
+        }
+        else if (pShape == RS_A && n == 1)
+        {
+            pShape = RS_AB;
+            pPools[1] = pools;
+            pLidx[1] = lidx;
+        }
+        else
+        {
+            pShape = RS_GENERIC;
+        }
+    }
+
+    inline uint shape(void) const
+    { return pShape; }
+
+    inline bool generic(void) const
+    { return pShape == RS_GENERIC; }
+
+    /// Return h; only valid if generic() is false.
+    ///
+    inline double h(void) const
+    {
+        switch (pShape)
+        {
+            case RS_ZERO:
+                return 1.0;
+            case RS_A:
+                return fallingFactorial<1>(pPools[0]->count(pLidx[0]));
+            case RS_AA:
+                return fallingFactorial<2>(pPools[0]->count(pLidx[0]));
+            case RS_AB:
+                return fallingFactorial<1>(pPools[0]->count(pLidx[0]))
+                     * fallingFactorial<1>(pPools[1]->count(pLidx[1]));
+            default:
+                assert(0);
+                return 0.0;
+        }
+    }
+
+private:
+
+    uint                                pShape;
+    steps::tetexact::Pools const      * pPools[2];
+    uint                                pLidx[2];
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetexact)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETEXACT_RATEKERNEL_HPP
+
+// END
@@ -67,12 +67,13 @@ static inline double comp_ccst(double kcst, double vol, uint order, double compv
 ////////////////////////////////////////////////////////////////////////////////
 
 stex::Reac::Reac(ssolver::Reacdef * rdef, stex::WmVol * tet)
-: KProc()
+: KProc(stex::KP_REAC)
 , pReacdef(rdef)
 , pTet(tet)
 , pUpdVec()
 , pCcst(0.0)
 , pKcst(0.0)
+, pKernel()
 {
 	assert (pReacdef != 0);
 	assert (pTet != 0);
@@ -82,6 +83,13 @@ stex::Reac::Reac(ssolver::Reacdef * rdef, stex::WmVol * tet)
 	pKcst = kcst;
 	pCcst = comp_ccst(kcst, pTet->vol(), pReacdef->order(), pTet->compdef()->vol());
 	assert (pCcst >= 0.0);
+
+	uint * lhs = pTet->compdef()->reac_lhsorder_bgn(lridx);
+	uint * s_end = pTet->compdef()->reac_lhsspec_end(lridx);
+	for (uint * s = pTet->compdef()->reac_lhsspec_bgn(lridx); s != s_end; ++s, ++lhs)
+	{
+		pKernel.addReactant(&pTet->pools(), *s, *lhs);
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -92,45 +100,30 @@ stex::Reac::~Reac(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Reac::checkpoint(std::fstream & cp_file)
+void stex::Reac::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&rExtent, sizeof(uint));
     cp_file.write((char*)&pFlags, sizeof(uint));
 
     cp_file.write((char*)&pCcst, sizeof(double));
     cp_file.write((char*)&pKcst, sizeof(double));
-
-    cp_file.write((char*)&(crData.recorded), sizeof(bool));
-    cp_file.write((char*)&(crData.pow), sizeof(int));
-    cp_file.write((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.write((char*)&(crData.rate), sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Reac::restore(std::fstream & cp_file)
+void stex::Reac::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&rExtent, sizeof(uint));
     cp_file.read((char*)&pFlags, sizeof(uint));
 
     cp_file.read((char*)&pCcst, sizeof(double));
     cp_file.read((char*)&pKcst, sizeof(double));
-
-    cp_file.read((char*)&(crData.recorded), sizeof(bool));
-    cp_file.read((char*)&(crData.pow), sizeof(int));
-    cp_file.read((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.read((char*)&(crData.rate), sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void stex::Reac::reset(void)
 {
-
-    crData.recorded = false;
-    crData.pow = 0;
-    crData.pos = 0;
-    crData.rate = 0.0;
     resetExtent();
     resetCcst();
 	setActive(true);
@@ -154,52 +147,26 @@ void stex::Reac::setKcst(double k)
 {
 	assert (k >= 0.0);
 	pKcst = k;
+	rModified = true;
 	pCcst = comp_ccst(k, pTet->vol(), pReacdef->order(), pTet->compdef()->vol());
 	assert (pCcst >= 0.0);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Reac::setupDeps(void)
+void stex::Reac::setupDeps(stex::Arena & arena)
 {
-    std::set<stex::KProc*> updset;
+    // The kprocs of the tetrahedron and of its triangles that depend on
+    // the species this reaction changes.
+    std::vector<stex::KProc*> updvec;
     ssolver::gidxTVecCI sbgn = pReacdef->bgnUpdColl();
     ssolver::gidxTVecCI send = pReacdef->endUpdColl();
-
-    // Search in local tetrahedron.
-    KProcPVecCI kprocend = pTet->kprocEnd();
-    for (KProcPVecCI k = pTet->kprocBegin(); k != kprocend; ++k)
+    for (ssolver::gidxTVecCI s = sbgn; s != send; ++s)
     {
-        for (ssolver::gidxTVecCI s = sbgn; s != send; ++s)
-        {
-            if ((*k)->depSpecTet(*s, pTet) == true) {
-                //updset.insert((*k)->getSSARef());
-                updset.insert(*k);
-            }
-        }
-    }
-
-    std::vector<stex::Tri *>::const_iterator tri_end = pTet->nexttriEnd();
-    for (std::vector<stex::Tri *>::const_iterator tri = pTet->nexttriBegin();
-			 tri != tri_end; ++tri)
-    {
-    	if ((*tri) == 0) continue;
-
-        kprocend = (*tri)->kprocEnd();
-        for (KProcPVecCI k = (*tri)->kprocBegin(); k != kprocend; ++k)
-        {
-            for (ssolver::gidxTVecCI s = sbgn; s != send; ++s)
-            {
-                if ((*k)->depSpecTet(*s, pTet) == true) {
-                    //updset.insert((*k)->getSSARef());
-                    updset.insert(*k);
-                }
-            }
-        }
+        pTet->specDeps(*s, updvec);
     }
 
-    pUpdVec.assign(updset.begin(), updset.end());
-    //pUpdObjVec.assign(updset_obj.begin(), updset_obj.end());
+    pUpdVec = _pack(arena, updvec);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -219,80 +186,68 @@ bool stex::Reac::depSpecTri(uint gidx, stex::Tri * tri)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Reac::rate(steps::tetexact::Tetexact * solver)
+void stex::Reac::depSpecsTet(stex::WmVol * tet, std::vector<uint> & lidxs)
 {
-    if (inactive()) return 0.0;
-
-    // Prefetch some variables.
+    if (pTet != tet) return;
     ssolver::Compdef * cdef = pTet->compdef();
-    uint nspecs = cdef->countSpecs();
-    uint * lhs_vec = cdef->reac_lhs_bgn(cdef->reacG2L(pReacdef->gidx()));
-    uint * cnt_vec = pTet->pools();
+    uint l_ridx = cdef->reacG2L(pReacdef->gidx());
+    lidxs.insert(lidxs.end(), cdef->reac_depspec_bgn(l_ridx),
+                 cdef->reac_depspec_end(l_ridx));
+}
 
-    // Compute combinatorial part.
-    double h_mu = 1.0;
-    for (uint pool = 0; pool < nspecs; ++pool)
-    {
-        uint lhs = lhs_vec[pool];
-        if (lhs == 0) continue;
-        uint cnt = cnt_vec[pool];
-        if (lhs > cnt)
-        {
-            h_mu = 0.0;
-            break;
-        }
-        switch (lhs)
-        {
-            case 4:
-            {
-                h_mu *= static_cast<double>(cnt - 3);
-            }
-            case 3:
-            {
-                h_mu *= static_cast<double>(cnt - 2);
-            }
-            case 2:
-            {
-                h_mu *= static_cast<double>(cnt - 1);
-            }
-            case 1:
-            {
-                h_mu *= static_cast<double>(cnt);
-                break;
-            }
-            default:
-            {
-                assert(0);
-                return 0.0;
-            }
-        }
-    }
+////////////////////////////////////////////////////////////////////////////////
 
-    // Multiply with scaled reaction constant.
-    return h_mu * pCcst;
+void stex::Reac::depSpecsTri(stex::Tri * tri, std::vector<uint> & lidxs)
+{
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::vector<stex::KProc*> const & stex::Reac::apply(steps::rng::RNG * rng, double dt, double simtime)
+stex::KProcIdxSpan stex::Reac::apply(steps::rng::RNG * rng, double dt, double simtime)
 {
-    uint * local = pTet->pools();
     ssolver::Compdef * cdef = pTet->compdef();
     uint l_ridx = cdef->reacG2L(pReacdef->gidx());
-    int * upd_vec = cdef->reac_upd_bgn(l_ridx);
-    uint nspecs = cdef->countSpecs();
-    for (uint i = 0; i < nspecs; ++i)
+    int * delta = cdef->reac_upddelta_bgn(l_ridx);
+    uint * s_end = cdef->reac_updspec_end(l_ridx);
+    for (uint * s = cdef->reac_updspec_bgn(l_ridx); s != s_end; ++s, ++delta)
     {
+        uint i = *s;
         if (pTet->clamped(i) == true) continue;
-        int j = upd_vec[i];
-        if (j == 0) continue;
-        int nc = static_cast<int>(local[i]) + j;
+        int nc = static_cast<int>(pTet->count(i)) + *delta;
         pTet->setCount(i, static_cast<uint>(nc));
     }
     rExtent++;
+    rModified = true;
     return pUpdVec;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+bool stex::Reac::leapStoich(std::vector<stex::LeapTerm> & lhs,
+                            std::vector<stex::LeapTerm> & upd) const
+{
+    ssolver::Compdef * cdef = pTet->compdef();
+    uint l_ridx = cdef->reacG2L(pReacdef->gidx());
+    uint * lhs_vec = cdef->reac_lhs_bgn(l_ridx);
+    int * upd_vec = cdef->reac_upd_bgn(l_ridx);
+    uint nspecs = cdef->countSpecs();
+    for (uint i = 0; i < nspecs; ++i)
+    {
+        if (lhs_vec[i] != 0)
+        {
+            LeapTerm t = {pTet, i, static_cast<double>(lhs_vec[i]), 0.0, true};
+            lhs.push_back(t);
+        }
+        if (upd_vec[i] != 0)
+        {
+            double n = static_cast<double>(upd_vec[i]);
+            LeapTerm t = {pTet, i, n, n * n, true};
+            upd.push_back(t);
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
@@ -37,12 +37,16 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <cassert>
 
 // STEPS headers.
 #include "../common.h"
 #include "../math/constants.hpp"
 #include "../solver/reacdef.hpp"
+#include "../solver/compdef.hpp"
 #include "kproc.hpp"
+#include "ratekernel.hpp"
+#include "wmvol.hpp"
 //#include "tetexact.hpp"
 
 
@@ -77,10 +81,10 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
 
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS
@@ -101,16 +105,26 @@ public:
     // VIRTUAL INTERFACE METHODS
     ////////////////////////////////////////////////////////////////////////
 
-    void setupDeps(void);
+    void setupDeps(steps::tetexact::Arena & arena);
     bool depSpecTet(uint gidx, steps::tetexact::WmVol * tet);
     bool depSpecTri(uint gidx, steps::tetexact::Tri * tri);
+    void depSpecsTet(steps::tetexact::WmVol * tet, std::vector<uint> & lidxs);
+    void depSpecsTri(steps::tetexact::Tri * tri, std::vector<uint> & lidxs);
     void reset(void);
+    // Defined inline below, so that the solver can inline it when it
+    // dispatches on the type tag.
     double rate(steps::tetexact::Tetexact * solver = 0);
-    std::vector<KProc*> const & apply(steps::rng::RNG * rng, double dt, double simtime);
+    steps::tetexact::KProcIdxSpan apply(steps::rng::RNG * rng, double dt, double simtime);
 
     uint updVecSize(void) const
     { return pUpdVec.size(); }
 
+    steps::tetexact::KProcIdxSpan & updList(uint i)
+    { return pUpdVec; }
+
+    bool leapStoich(std::vector<steps::tetexact::LeapTerm> & lhs,
+                    std::vector<steps::tetexact::LeapTerm> & upd) const;
+
     ////////////////////////////////////////////////////////////////////////
 
 private:
@@ -119,11 +133,13 @@ private:
 
     steps::solver::Reacdef                              * pReacdef;
     steps::tetexact::WmVol                              * pTet;
-    std::vector<KProc*>                                   pUpdVec;
+    steps::tetexact::KProcIdxSpan                           pUpdVec;
     /// Properly scaled reaction constant.
     double                                                pCcst;
     // Also store the K constant for convenience
     double                                                pKcst;
+    /// The combinatorial part of the rate, if the order is two or less.
+    steps::tetexact::RateKernel                           pKernel;
 
     ////////////////////////////////////////////////////////////////////////
 
@@ -131,6 +147,63 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 
+inline double Reac::rate(steps::tetexact::Tetexact * solver)
+{
+    if (inactive()) return 0.0;
+
+    if (pKernel.generic() == false) return pKernel.h() * pCcst;
+
+    // Prefetch some variables.
+    steps::solver::Compdef * cdef = pTet->compdef();
+    uint lridx = cdef->reacG2L(pReacdef->gidx());
+    uint * lhs_vec = cdef->reac_lhsorder_bgn(lridx);
+    uint * pool_end = cdef->reac_lhsspec_end(lridx);
+
+    // Compute combinatorial part over the reactants only.
+    double h_mu = 1.0;
+    for (uint * pool = cdef->reac_lhsspec_bgn(lridx); pool != pool_end;
+         ++pool, ++lhs_vec)
+    {
+        uint lhs = *lhs_vec;
+        uint cnt = pTet->count(*pool);
+        if (lhs > cnt)
+        {
+            h_mu = 0.0;
+            break;
+        }
+        switch (lhs)
+        {
+            case 4:
+            {
+                h_mu *= static_cast<double>(cnt - 3);
+            }
+            case 3:
+            {
+                h_mu *= static_cast<double>(cnt - 2);
+            }
+            case 2:
+            {
+                h_mu *= static_cast<double>(cnt - 1);
+            }
+            case 1:
+            {
+                h_mu *= static_cast<double>(cnt);
+                break;
+            }
+            default:
+            {
+                assert(0);
+                return 0.0;
+            }
+        }
+    }
+
+    // Multiply with scaled reaction constant.
+    return h_mu * pCcst;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 END_NAMESPACE(tetexact)
 END_NAMESPACE(steps)
 
@@ -25,6 +25,7 @@
 
 // Standard library & STL headers.
 #include <vector>
+#include <cmath>
 
 // STEPS headers.
 #include "../common.h"
@@ -47,82 +48,28 @@ NAMESPACE_ALIAS(steps::math, smath);
 ////////////////////////////////////////////////////////////////////////////////
 
 stex::SDiff::SDiff(ssolver::SurfDiffdef * sdef, stex::Tri * tri)
-: KProc()
+: KProc(stex::KP_SDIFF)
 , pSDiffdef(sdef)
 , pTri(tri)
 , pUpdVec()
 , pScaledDcst(0.0)
 , pDcst(0.0)
-, pCDFSelector()
-
+, pNbrs(0)
+, pCDF(0)
+, pGeom(0.0)
+, pBatched(false)
 {
 	assert(pSDiffdef != 0);
 	assert(pTri != 0);
-	stex::Tri * next[3] =
-	{
-		pTri->nextTri(0),
-		pTri->nextTri(1),
-		pTri->nextTri(2),
-	};
 
     ligGIdx = pSDiffdef->lig();
     ssolver::Patchdef * pdef = pTri->patchdef();
     lidxTri = pdef->specG2L(ligGIdx);
 
-
-    /*
-    uint gidx = pSurfDiffdef->lig();
-    for (uint i = 0; i < 4; ++i)
-    {
-        if (next[i] == 0)
-        {
-        	pNeighbCompLidx[i] = -1;
-        	continue;
-        }
-        else
-        {
-        	pNeighbCompLidx[i] = next[i]->compdef()->specG2L(ligGIdx);
-        }
-    }
-	*/
-
-    // Precalculate part of the scaled diffusion constant.
-	uint ldidx = pTri->patchdef()->surfdiffG2L(pSDiffdef->gidx());
-	double dcst = pTri->patchdef()->dcst(ldidx);
-    pDcst = dcst;
-
-    double d[3] = { 0.0, 0.0, 0.0};
-    for (uint i = 0; i < 3; ++i)
-    {
-        // Compute the scaled diffusion constant.
-    	// Need to here check if the direction is a diffusion boundary
-        double dist = pTri->dist(i);
-        if ((dist > 0.0) && (next[i] != 0))
-        {
-        	if (next[i]->patchdef() == pdef)	d[i] = (pTri->length(i) * dcst) / (pTri->area() * dist);
-        	else d[i] = 0;
-        }
-    }
-    // Compute scaled "diffusion constant".
-    for (uint i = 0; i < 3; ++i)
-    {
-		pScaledDcst += d[i];
-	}
-
-    // Should not be negative!
-    assert(pScaledDcst >= 0);
-
-    // Setup the selector distribution.
-    if (pScaledDcst == 0.0)
-    {
-        pCDFSelector[0] = 0.0;
-        pCDFSelector[1] = 0.0;
-    }
-    else
-    {
-        pCDFSelector[0] = d[0] / pScaledDcst;
-        pCDFSelector[1] = pCDFSelector[0] + (d[1] / pScaledDcst);
-    }
+    // The rate is scaled once the patch hands this kproc its entries in
+    // the surface diffusion table (setTable).
+	uint ldidx = pdef->surfdiffG2L(pSDiffdef->gidx());
+    pDcst = pdef->dcst(ldidx);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -133,42 +80,47 @@ stex::SDiff::~SDiff(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::SDiff::checkpoint(std::fstream & cp_file)
+void stex::SDiff::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&rExtent, sizeof(uint));
     cp_file.write((char*)&pFlags, sizeof(uint));
 
     cp_file.write((char*)&pScaledDcst, sizeof(double));
     cp_file.write((char*)&pDcst, sizeof(double));
-    cp_file.write((char*)pCDFSelector, sizeof(double) * 2);
-
-    cp_file.write((char*)&(crData.recorded), sizeof(bool));
-    cp_file.write((char*)&(crData.pow), sizeof(int));
-    cp_file.write((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.write((char*)&(crData.rate), sizeof(double));
+    cp_file.write((char*)pCDF, sizeof(double) * 2);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::SDiff::restore(std::fstream & cp_file)
+void stex::SDiff::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&rExtent, sizeof(uint));
     cp_file.read((char*)&pFlags, sizeof(uint));
 
     cp_file.read((char*)&pScaledDcst, sizeof(double));
     cp_file.read((char*)&pDcst, sizeof(double));
-    cp_file.read((char*)pCDFSelector, sizeof(double) * 2);
 
+    // The selector is part of the patch's table now, which only depends
+    // on the mesh; the stored copy is skipped.
+    double cdf[2];
+    cp_file.read((char*)cdf, sizeof(double) * 2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
 
-    cp_file.read((char*)&(crData.recorded), sizeof(bool));
-    cp_file.read((char*)&(crData.pow), sizeof(int));
-    cp_file.read((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.read((char*)&(crData.rate), sizeof(double));
+void stex::SDiff::setTable(stex::Tri * const * nbrs, double const * cdf,
+                           double geom)
+{
+    assert(nbrs != 0 && cdf != 0);
+    pNbrs = nbrs;
+    pCDF = cdf;
+    pGeom = geom;
+    setDcst(pDcst);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::SDiff::setupDeps(void)
+void stex::SDiff::setupDeps(stex::Arena & arena)
 {
     // We will check all KProcs of the following simulation elements:
     //   * the 'source' triangle
@@ -181,47 +133,9 @@ void stex::SDiff::setupDeps(void)
     //   * any neighbouring tetrahedrons of these neighbouring tris
     //
 
-
-    // Search for dependencies in the 'source' triangle.
-    std::set<stex::KProc*> local;
-
-    KProcPVecCI kprocend = pTri->kprocEnd();
-    for (KProcPVecCI k = pTri->kprocBegin(); k != kprocend; ++k)
-    {
-        // Check locally.
-        if ((*k)->depSpecTri(ligGIdx, pTri) == true) {
-            //local.insert((*k)->getSSARef());
-            local.insert(*k);
-        }
-    }
-
-    // Check the neighbouring tetrahedrons.
-    stex::WmVol * itet = pTri->iTet();
-    if (itet != 0)
-    {
-    	kprocend = itet->kprocEnd();
-    	for (KProcPVecCI k = itet->kprocBegin(); k != kprocend; ++k)
-    	{
-    		if ((*k)->depSpecTri(ligGIdx, pTri) == true) {
-    			//local.insert((*k)->getSSARef());
-    			local.insert(*k);
-    		}
-    	}
-    }
-
-    stex::WmVol * otet = pTri->oTet();
-    if (otet != 0)
-    {
-    	kprocend = otet->kprocEnd();
-    	for (KProcPVecCI k = otet->kprocBegin(); k != kprocend; ++k)
-    	{
-    		if ((*k)->depSpecTri(ligGIdx, pTri) == true) {
-    			//local.insert((*k)->getSSARef());
-    			local.insert(*k);
-    		}
-    	}
-    }
-
+    // Dependencies in the 'source' triangle and its tetrahedrons.
+    std::vector<stex::KProc*> local;
+    pTri->specDeps(ligGIdx, local);
 
     // Search for dependencies in neighbouring triangles.
     for (uint i = 0; i < 3; ++i)
@@ -230,75 +144,12 @@ void stex::SDiff::setupDeps(void)
         stex::Tri * next = pTri->nextTri(i);
         if (next == 0) continue;
 
-        // Copy local dependencies.
-        std::set<stex::KProc*> local2(local.begin(), local.end());
-        //std::set<stex::KProc*> local2_objs(local_objs.begin(), local_objs.end());
-
-        // Find the ones 'locally' in the next tri.
-        kprocend = next->kprocEnd();
-        for (KProcPVecCI k = next->kprocBegin(); k != kprocend; ++k)
-        {
-            if ((*k)->depSpecTri(ligGIdx, next) == true) {
-                //local.insert((*k)->getSSARef());
-                local2.insert(*k);
-            }
-        }
-
-        /*
-        // Find deps in neighbouring tetrahedrons in the next tri.
-        for (uint j = 0; j < 2; ++j)
-        {
-            // Fetch next tetrahedron, if it exists.
-            stex::Tet * next2 = next->nextTet(j);
-            if (next2 == 0) continue;
-
-            // Find deps.
-            kprocend = next2->kprocEnd();
-            for (KProcPVecCI k = next2->kprocBegin(); k != kprocend; ++k)
-            {
-                if ((*k)->depSpecTri(ligGIdx, next) == true) {
-                    //local.insert((*k)->getSSARef());
-                    local2.insert(*k);
-                }
-            }
-        }
-        */
-        // Fetch inner tetrahedron, if it exists.
-        stex::WmVol * itet = next->iTet();
-        if (itet != 0)
-        {
-        	// Find deps.
-        	kprocend = itet->kprocEnd();
-        	for (KProcPVecCI k = itet->kprocBegin(); k != kprocend; ++k)
-        	{
-        		if ((*k)->depSpecTri(ligGIdx, next) == true) {
-        			//local.insert((*k)->getSSARef());
-        			local2.insert(*k);
-        		}
-        	}
-        }
-
-        // Fetch outer tetrahedron, if it exists.
-        stex::WmVol * otet = next->oTet();
-        if (otet != 0)
-        {
-        	// Find deps.
-        	kprocend = otet->kprocEnd();
-        	for (KProcPVecCI k = otet->kprocBegin(); k != kprocend; ++k)
-        	{
-        		if ((*k)->depSpecTri(ligGIdx, next) == true) {
-        			//local.insert((*k)->getSSARef());
-        			local2.insert(*k);
-        		}
-        	}
-        }
-
-        // Copy the set to the update vector.
-        pUpdVec[i].assign(local2.begin(), local2.end());
-        //pUpdObjVec[i].assign(local2_objs.begin(), local2_objs.end());
+        // Add the ones in the next tri and its tetrahedrons.
+        std::vector<stex::KProc*> local2(local);
+        next->specDeps(ligGIdx, local2);
 
+        pUpdVec[i] = _pack(arena, local2);
     }
-
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -330,11 +181,6 @@ void stex::SDiff::reset(void)
 
     setActive(true);
 
-    crData.recorded = false;
-    crData.pow = 0;
-    crData.pos = 0;
-    crData.rate = 0.0;
-
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -343,59 +189,21 @@ void stex::SDiff::setDcst(double dcst)
 {
 	assert(dcst >= 0.0);
 	pDcst = dcst;
+	rModified = true;
+    pScaledDcst = pGeom * dcst;
 
-	stex::Tri * next[3] =
-	{
-		pTri->nextTri(0),
-		pTri->nextTri(1),
-		pTri->nextTri(2),
-	};
-
-    double d[3] = { 0.0, 0.0, 0.0};
-
-    for (uint i = 0; i < 3; ++i)
-    {
-        // Compute the scaled diffusion constant.
-    	// Need to here check if the direction is a diffusion boundary
-        double dist = pTri->dist(i);
-        if ((dist > 0.0) && (next[i] != 0))
-        {
-    		if (next[i]->patchdef() == pTri->patchdef())	d[i] = (pTri->length(i) * dcst) / (pTri->area() * dist);
-    		else d[i] = 0;
-        }
-    }
-
-    // Compute scaled "diffusion constant".
-    pScaledDcst = 0.0;
-
-    for (uint i = 0; i < 3; ++i)
-    {
-    	pScaledDcst += d[i];
-	}
     // Should not be negative!
     assert(pScaledDcst >= 0);
-
-    // Setup the selector distribution.
-    if (pScaledDcst == 0.0)
-    {
-        pCDFSelector[0] = 0.0;
-        pCDFSelector[1] = 0.0;
-    }
-    else
-    {
-        pCDFSelector[0] = d[0] / pScaledDcst;
-        pCDFSelector[1] = pCDFSelector[0] + (d[1] / pScaledDcst);
-    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 double stex::SDiff::rate(steps::tetexact::Tetexact * solver)
 {
-    if (inactive()) return 0.0;
+    if (inactive() || pBatched) return 0.0;
 
     // Compute the rate.
-    double rate = (pScaledDcst) * static_cast<double>(pTri->pools()[lidxTri]);
+    double rate = (pScaledDcst) * static_cast<double>(pTri->count(lidxTri));
     assert(std::isnan(rate) == false);
 
     // Return.
@@ -404,83 +212,55 @@ double stex::SDiff::rate(steps::tetexact::Tetexact * solver)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::vector<stex::KProc*> const & stex::SDiff::apply(steps::rng::RNG * rng, double dt, double simtime)
+stex::KProcIdxSpan stex::SDiff::apply(steps::rng::RNG * rng, double dt, double simtime)
 {
-    //uint lidxTet = this->lidxTet;
-    // Pre-fetch some general info.
-
-
     // Apply local change.
-    uint * local = pTri->pools() + lidxTri;
 	bool clamped = pTri->clamped(lidxTri);
 
     if (clamped == false)
     {
-        assert(*local > 0);
+        assert(pTri->count(lidxTri) > 0);
     }
 
-    // Apply change in next voxel: select a direction.
+    // Apply change in next voxel: select a direction. A direction
+    // without a neighbour has zero probability in the table.
     double sel = rng->getUnfEE();
+    uint dir = (sel < pCDF[0]) ? 0 : ((sel < pCDF[1]) ? 1 : 2);
+    stex::Tri * nexttri = pNbrs[dir];
+    assert(nexttri != 0);
 
-    if (sel < pCDFSelector[0])
+    if (nexttri->clamped(lidxTri) == false)
     {
-        // Direction 1.
-        stex::Tri * nexttri = pTri->nextTri(0);
-        // If there is no next tet 0, pCDFSelector[0] should be zero
-        // So we can assert that nextet 0 does indeed exist
-        assert (nexttri != 0);
-
-        if (nexttri->clamped(lidxTri) == false)
-        {
-        	nexttri->incCount(lidxTri,1);
-        }
-        if (clamped == false) {pTri->incCount(lidxTri, -1); }
-
-        rExtent++;
-
-        return pUpdVec[0];
+        nexttri->incCount(lidxTri, 1);
     }
-    else if (sel < pCDFSelector[1])
-    {
-        // Direction 2.
-        stex::Tri * nexttri = pTri->nextTri(1);
-        // If there is no next tet 1, pCDFSelector[1] should be zero
-        // So we can assert that nextet 1 does indeed exist
-        assert (nexttri != 0);
-
-        if (nexttri->clamped(lidxTri) == false)
-        {
-        	nexttri->incCount(lidxTri,1);
-        }
-        if (clamped == false) {pTri->incCount(lidxTri, -1); }
+    if (clamped == false) {pTri->incCount(lidxTri, -1); }
 
-        rExtent++;
+    rExtent++;
+    rModified = true;
 
-        return pUpdVec[1];
-    }
-    else
-    {
-        // Direction 3.
-        stex::Tri * nexttri = pTri->nextTri(2);
-        assert (nexttri != 0);
+    return pUpdVec[dir];
+}
 
-        if (nexttri->clamped(lidxTri) == false)
-        {
-        	nexttri->incCount(lidxTri,1);
-        }
-        if (clamped == false) {pTri->incCount(lidxTri, -1); }
+////////////////////////////////////////////////////////////////////////////////
 
-        rExtent++;
+uint stex::SDiff::applyOut(steps::rng::RNG * rng)
+{
+    double sel = rng->getUnfEE();
+    uint dir = (sel < pCDF[0]) ? 0 : ((sel < pCDF[1]) ? 1 : 2);
+    assert(pNbrs[dir] != 0);
 
-        return pUpdVec[2];
+    if (pTri->clamped(lidxTri) == false) pTri->incCount(lidxTri, -1);
+    rExtent++;
+    rModified = true;
+    return dir;
+}
 
-    }
+////////////////////////////////////////////////////////////////////////////////
 
-    // This should never happen!
-    assert(0);
-    std::cerr << "Cannot find a suitable direction for diffusion!\n";
-    throw;
-    return pUpdVec[0];
+void stex::SDiff::applyIn(uint dir)
+{
+    stex::Tri * nexttri = pNbrs[dir];
+    if (nexttri->clamped(lidxTri) == false) nexttri->incCount(lidxTri, 1);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -497,4 +277,55 @@ uint stex::SDiff::updVecSize(void) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void stex::SDiff::applyN(steps::rng::RNG * rng, uint n, double dt, double simtime)
+{
+    if (n == 0) return;
+    if (pTri->clamped(lidxTri) == false)
+    {
+        assert(pTri->count(lidxTri) >= n);
+        pTri->incCount(lidxTri, -static_cast<int>(n));
+    }
+
+    // Multinomial split as a chain of binomials, as in Diff::applyN.
+    double p[3];
+    p[0] = pCDF[0];
+    p[1] = pCDF[1] - pCDF[0];
+    p[2] = 1.0 - pCDF[1];
+    uint left = n;
+    double pleft = 1.0;
+    for (uint i = 0; i < 3 && left > 0; ++i)
+    {
+        if (p[i] <= 0.0) continue;
+        uint ni = (i == 2 || p[i] >= pleft) ? left : rng->getBinom(left, p[i] / pleft);
+        pleft -= p[i];
+        left -= ni;
+        if (ni == 0) continue;
+        stex::Tri * nexttri = pNbrs[i];
+        assert(nexttri != 0);
+        if (nexttri->clamped(lidxTri) == false)
+        {
+            nexttri->incCount(lidxTri, ni);
+        }
+    }
+    rExtent += n;
+    rModified = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::SDiff::count(void) const
+{
+    return pTri->count(lidxTri);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::SDiff::sampleBatch(steps::rng::RNG * rng, double dt) const
+{
+    if (inactive() || pScaledDcst == 0.0) return 0;
+    return rng->getBinom(count(), 1.0 - std::exp(-pScaledDcst * dt));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
@@ -68,10 +68,10 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
 
     ////////////////////////////////////////////////////////////////////////
     // VIRTUAL INTERFACE METHODS
@@ -84,7 +84,14 @@ public:
     { return pDcst; }
     void setDcst(double d);
 
-    void setupDeps(void);
+    /// Point this kproc at the entries of its triangle in the surface
+    /// diffusion table of the patch (see Patch::setupSDiffTable), and
+    /// scale the diffusion constant with geom.
+    ///
+    void setTable(steps::tetexact::Tri * const * nbrs, double const * cdf,
+                  double geom);
+
+    void setupDeps(steps::tetexact::Arena & arena);
 
     bool depSpecTet(uint gidx, steps::tetexact::WmVol * tet);
     bool depSpecTri(uint gidx, steps::tetexact::Tri * tri);
@@ -92,10 +99,57 @@ public:
     void reset(void);
     double rate(steps::tetexact::Tetexact * solver = 0);
 
-    std::vector<KProc*> const & apply(steps::rng::RNG * rng, double dt, double simtime);
+    steps::tetexact::KProcIdxSpan apply(steps::rng::RNG * rng, double dt, double simtime);
 
     uint updVecSize(void) const;
 
+    uint countUpdLists(void) const
+    { return 3; }
+
+    steps::tetexact::KProcIdxSpan & updList(uint i)
+    { return pUpdVec[i]; }
+
+    /// Move n molecules at once, split multinomially over the neighbours.
+    ///
+    void applyN(steps::rng::RNG * rng, uint n, double dt, double simtime);
+
+    ////////////////////////////////////////////////////////////////////////
+    // BATCHED DIFFUSION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// While batched, the rate is zero so the SSA ignores this kproc, and
+    /// the solver moves its molecules with sampleBatch() and applyN() at
+    /// the end of fixed time windows instead (see Diff::setBatched).
+    ///
+    inline bool batched(void) const
+    { return pBatched; }
+    inline void setBatched(bool b)
+    { pBatched = b; }
+
+    /// Number of molecules of the diffusing species in the triangle.
+    ///
+    uint count(void) const;
+
+    /// Draw the number of molecules that leave the triangle in a window
+    /// of length dt, each leaving independently with probability
+    /// 1 - exp(-d dt).
+    ///
+    uint sampleBatch(steps::rng::RNG * rng, double dt) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // SPLIT MOVES
+    ////////////////////////////////////////////////////////////////////////
+
+    /// The two halves of apply(), as Diff::applyOut and Diff::applyIn.
+    ///
+    uint applyOut(steps::rng::RNG * rng);
+
+    void applyIn(uint dir);
+
+    /// The neighbour in direction dir, 0 if there is none.
+    ///
+    inline steps::tetexact::Tri * neighb(uint dir) const
+    { return pNbrs[dir]; }
 
     ////////////////////////////////////////////////////////////////////////
 
@@ -112,7 +166,7 @@ private:
     uint                                lidxTri;
     steps::solver::SurfDiffdef        * pSDiffdef;
     steps::tetexact::Tri              * pTri;
-    std::vector<KProc*>                 pUpdVec[3];
+    steps::tetexact::KProcIdxSpan         pUpdVec[3];
 
     /*
     // Storing the species local index for each neighbouring tri: Needed
@@ -129,8 +183,15 @@ private:
     // Compartmental dcst. Stored for convenience
     double                              pDcst;
 
-    /// Used in selecting which directory the molecule should go.
-    double                              pCDFSelector[2];
+    // This triangle's entries in the surface diffusion table of its
+    // patch: the three neighbours, the cumulative probabilities of the
+    // first two directions and the geometric factor of the rate.
+    steps::tetexact::Tri * const      * pNbrs;
+    double const                      * pCDF;
+    double                              pGeom;
+
+    // Whether the molecules are moved in batches (see setBatched).
+    bool                                pBatched;
 
     ////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,225 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "snapshot.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::tetexact, stex);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Offsets in the header of a snapshot stream file.
+static const std::size_t SNAPSHOT_OFF_SEQ = 80;
+static const std::size_t SNAPSHOT_OFF_FRAME = 88;
+static const std::size_t SNAPSHOT_OFF_TIME = 96;
+static const std::size_t SNAPSHOT_OFF_NAMES = 112;
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::SnapshotStream::SnapshotStream(std::string const & file_name,
+                                     uint nx, uint ny, uint nz,
+                                     std::vector<double> const & lo,
+                                     std::vector<double> const & size,
+                                     std::vector<std::string> const & names,
+                                     std::vector<uint> const & cols,
+                                     double const * totals, uint rowlen,
+                                     steps::solver::Statedef const * statedef,
+                                     double fps)
+: pNVoxels(nx * ny * nz)
+, pCols(cols)
+, pTotals(totals)
+, pRowLen(rowlen)
+, pStatedef(statedef)
+, pPeriod(1.0 / fps)
+, pMap(0)
+, pMapLen(0)
+, pSeq(0)
+, pFrame(0)
+, pTime(0)
+, pData(0)
+, pClosing(false)
+, pThreaded(false)
+{
+    // The counts start on a multiple of 8 bytes after the names.
+    uint nspecs = cols.size();
+    std::size_t hsize = SNAPSHOT_OFF_NAMES + nspecs * SNAPSHOT_NAMELEN;
+    hsize = (hsize + 7) & ~static_cast<std::size_t>(7);
+    pMapLen = hsize + sizeof(double) * nspecs * pNVoxels;
+
+    int fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1 || ftruncate(fd, pMapLen) != 0)
+    {
+        if (fd != -1) close(fd);
+        std::ostringstream os;
+        os << "Cannot create snapshot stream file '" << file_name << "'.\n";
+        throw steps::IOErr(os.str());
+    }
+    void * m = mmap(0, pMapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+    {
+        std::ostringstream os;
+        os << "Cannot map snapshot stream file '" << file_name << "'.\n";
+        throw steps::IOErr(os.str());
+    }
+    pMap = static_cast<char *>(m);
+
+    // The file is new, so it is all zeros: sequence number 0 and no
+    // frame yet.
+    std::memcpy(pMap, SNAPSHOT_MAGIC, 8);
+    uint head[6] = { SNAPSHOT_VERSION, static_cast<uint>(hsize),
+                     nx, ny, nz, nspecs };
+    std::memcpy(pMap + 8, head, sizeof(head));
+    double grid[6] = { lo[0], lo[1], lo[2], size[0], size[1], size[2] };
+    std::memcpy(pMap + 32, grid, sizeof(grid));
+    for (uint s = 0; s < nspecs; ++s)
+    {
+        std::size_t len = std::min<std::size_t>(names[s].size(), SNAPSHOT_NAMELEN - 1);
+        std::memcpy(pMap + SNAPSHOT_OFF_NAMES + s * SNAPSHOT_NAMELEN,
+                    names[s].data(), len);
+    }
+    pSeq = reinterpret_cast<unsigned long long volatile *>(pMap + SNAPSHOT_OFF_SEQ);
+    pFrame = reinterpret_cast<unsigned long long volatile *>(pMap + SNAPSHOT_OFF_FRAME);
+    pTime = reinterpret_cast<double volatile *>(pMap + SNAPSHOT_OFF_TIME);
+    pData = reinterpret_cast<double *>(pMap + hsize);
+
+    pthread_mutex_init(&pMutex, 0);
+    pthread_cond_init(&pCond, 0);
+    pthread_mutex_lock(&pMutex);
+    _write();
+    pthread_mutex_unlock(&pMutex);
+    // Without a thread frames are only published by publish().
+    pThreaded = (pthread_create(&pThread, 0, _publisher, this) == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::SnapshotStream::~SnapshotStream(void)
+{
+    if (pThreaded == true)
+    {
+        pthread_mutex_lock(&pMutex);
+        pClosing = true;
+        pthread_cond_broadcast(&pCond);
+        pthread_mutex_unlock(&pMutex);
+        pthread_join(pThread, 0);
+    }
+    pthread_cond_destroy(&pCond);
+    pthread_mutex_destroy(&pMutex);
+    munmap(pMap, pMapLen);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::SnapshotStream::publish(void)
+{
+    pthread_mutex_lock(&pMutex);
+    _write();
+    pthread_mutex_unlock(&pMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+unsigned long long stex::SnapshotStream::frames(void) const
+{
+    return *pFrame;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::SnapshotStream::_write(void)
+{
+    double t = pStatedef->time();
+    timeval now;
+    gettimeofday(&now, 0);
+
+    *pSeq = *pSeq + 1;
+    __sync_synchronize();
+    pTime[0] = t;
+    pTime[1] = now.tv_sec + 1.0e-6 * now.tv_usec;
+    uint ncols = pCols.size();
+    for (uint c = 0; c < ncols; ++c)
+    {
+        double * frame = pData + c * pNVoxels;
+        double const * col = pTotals + pCols[c];
+        for (uint v = 0; v < pNVoxels; ++v) frame[v] = col[v * pRowLen];
+    }
+    *pFrame = *pFrame + 1;
+    __sync_synchronize();
+    *pSeq = *pSeq + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void * stex::SnapshotStream::_publisher(void * arg)
+{
+    SnapshotStream * ss = static_cast<SnapshotStream *>(arg);
+    timeval now;
+    gettimeofday(&now, 0);
+    double next = now.tv_sec + 1.0e-6 * now.tv_usec;
+
+    pthread_mutex_lock(&ss->pMutex);
+    while (ss->pClosing == false)
+    {
+        // Frames keep to the rate rather than drift by the time they
+        // take; after a stall the missed ones are skipped.
+        next += ss->pPeriod;
+        gettimeofday(&now, 0);
+        double t = now.tv_sec + 1.0e-6 * now.tv_usec;
+        if (next < t) next = t;
+        timespec until;
+        until.tv_sec = static_cast<time_t>(next);
+        until.tv_nsec = static_cast<long>((next - until.tv_sec) * 1.0e9);
+        int rc = 0;
+        while (ss->pClosing == false && rc != ETIMEDOUT)
+        {
+            rc = pthread_cond_timedwait(&ss->pCond, &ss->pMutex, &until);
+        }
+        if (ss->pClosing == true) break;
+        ss->_write();
+    }
+    pthread_mutex_unlock(&ss->pMutex);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,166 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETEXACT_SNAPSHOT_HPP
+#define STEPS_TETEXACT_SNAPSHOT_HPP 1
+
+// STL headers.
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+// STEPS headers.
+#include "../common.h"
+#include "../solver/statedef.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetexact)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Magic string and format version at the start of a snapshot stream file.
+#define SNAPSHOT_MAGIC              "STEPSVIS"
+#define SNAPSHOT_VERSION            1
+
+// Bytes given to the name of each species in the header.
+#define SNAPSHOT_NAMELEN            32
+
+// Voxel of an element outside the compartments and patches.
+#define SNAPSHOT_VOXEL_NONE         0xFFFFFFFF
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Frames of the molecule counts of a mesh decimated onto a grid of
+/// voxels, published to a file mapped in memory by a background thread
+/// at a fixed rate, for viewers to map and read while the simulation
+/// runs.
+///
+/// The solver keeps the totals of every voxel up to date as the counts
+/// change (see Tetexact::setSnapshotStream); the stream copies those of
+/// the chosen species into the file, which holds, in native byte order:
+///
+///     0    the magic string (8 bytes)
+///     8    the format version, the size of the header in bytes, nx, ny,
+///          nz and the number of species (6 x uint32)
+///     32   the lower corner of the grid and the size of a voxel (6 x
+///          double)
+///     80   the sequence number and the frame number (2 x uint64)
+///     96   the simulation time and the wall clock time, in seconds
+///          since the epoch, of the frame (2 x double)
+///     112  the species names, SNAPSHOT_NAMELEN bytes each, zero padded
+///
+/// and after the header the counts as doubles, species by species, of
+/// voxel x + nx * (y + ny * z).
+///
+/// The sequence number is odd while a frame is being written. A viewer
+/// reads it, then the frame, then the number again, and keeps the frame
+/// if both were the same even number. The copy does not stop the
+/// solver, so each voxel count of a frame is one the voxel had at some
+/// moment of the copy, and the time is read before it.
+///
+class SnapshotStream
+{
+
+public:
+
+    /// Create file_name, sized for the header and one frame, map it and
+    /// start the thread publishing a frame fps times a second. totals
+    /// is the solver's array of voxel totals, rowlen doubles per voxel,
+    /// and cols the columns of the species named in names. Throws IOErr
+    /// if the file cannot be created or mapped.
+    ///
+    SnapshotStream(std::string const & file_name, uint nx, uint ny, uint nz,
+                   std::vector<double> const & lo,
+                   std::vector<double> const & size,
+                   std::vector<std::string> const & names,
+                   std::vector<uint> const & cols,
+                   double const * totals, uint rowlen,
+                   steps::solver::Statedef const * statedef, double fps);
+
+    /// Stops the thread and unmaps the file, which is left in place with
+    /// the last frame.
+    ///
+    ~SnapshotStream(void);
+
+    /// Publish a frame now, from the calling thread.
+    ///
+    void publish(void);
+
+    /// The number of frames published.
+    ///
+    unsigned long long frames(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Copy the totals into the file as the next frame. Called with
+    /// pMutex held.
+    ///
+    void _write(void);
+
+    /// Publisher thread entry point.
+    ///
+    static void * _publisher(void * arg);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    uint                                pNVoxels;
+    std::vector<uint>                   pCols;
+    double const                      * pTotals;
+    uint                                pRowLen;
+    steps::solver::Statedef const     * pStatedef;
+    double                              pPeriod;
+
+    // The mapping of the file, and the parts of it that change.
+    char                              * pMap;
+    std::size_t                         pMapLen;
+    unsigned long long volatile       * pSeq;
+    unsigned long long volatile       * pFrame;
+    double volatile                   * pTime;
+    double                            * pData;
+
+    bool                                pClosing;
+    bool                                pThreaded;
+
+    pthread_t                           pThread;
+    pthread_mutex_t                     pMutex;
+    pthread_cond_t                      pCond;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetexact)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETEXACT_SNAPSHOT_HPP
+
+// END
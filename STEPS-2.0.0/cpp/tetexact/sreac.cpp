@@ -86,12 +86,13 @@ static inline double comp_ccst_area(double kcst, double area, uint order)
 ////////////////////////////////////////////////////////////////////////////////
 
 stex::SReac::SReac(ssolver::SReacdef * srdef, stex::Tri * tri)
-: KProc()
+: KProc(stex::KP_SREAC)
 , pSReacdef(srdef)
 , pTri(tri)
 , pUpdVec()
 , pCcst(0.0)
 , pKcst(0.0)
+, pKernel()
 {
 	assert (pSReacdef != 0);
 	assert (pTri != 0);
@@ -124,6 +125,33 @@ stex::SReac::SReac(ssolver::SReacdef * srdef, stex::Tri * tri)
 	}
 
 	assert (pCcst >= 0);
+
+	// Reactants in the order rate() visits them.
+	ssolver::Patchdef * pdef = pTri->patchdef();
+	uint * lhs_s = pdef->sreac_lhsorder_S_bgn(lsridx);
+	uint * s_s_end = pdef->sreac_lhsspec_S_end(lsridx);
+	for (uint * s = pdef->sreac_lhsspec_S_bgn(lsridx); s != s_s_end; ++s, ++lhs_s)
+	{
+		pKernel.addReactant(&pTri->pools(), *s, *lhs_s);
+	}
+	if (pSReacdef->inside())
+	{
+		uint * lhs_i = pdef->sreac_lhsorder_I_bgn(lsridx);
+		uint * s_i_end = pdef->sreac_lhsspec_I_end(lsridx);
+		for (uint * s = pdef->sreac_lhsspec_I_bgn(lsridx); s != s_i_end; ++s, ++lhs_i)
+		{
+			pKernel.addReactant(&pTri->iTet()->pools(), *s, *lhs_i);
+		}
+	}
+	else if (pSReacdef->outside())
+	{
+		uint * lhs_o = pdef->sreac_lhsorder_O_bgn(lsridx);
+		uint * s_o_end = pdef->sreac_lhsspec_O_end(lsridx);
+		for (uint * s = pdef->sreac_lhsspec_O_bgn(lsridx); s != s_o_end; ++s, ++lhs_o)
+		{
+			pKernel.addReactant(&pTri->oTet()->pools(), *s, *lhs_o);
+		}
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -134,7 +162,7 @@ stex::SReac::~SReac(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::SReac::checkpoint(std::fstream & cp_file)
+void stex::SReac::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&rExtent, sizeof(uint));
     cp_file.write((char*)&pFlags, sizeof(uint));
@@ -142,38 +170,23 @@ void stex::SReac::checkpoint(std::fstream & cp_file)
     cp_file.write((char*)&pCcst, sizeof(double));
     cp_file.write((char*)&pKcst, sizeof(double));
 
-    cp_file.write((char*)&(crData.recorded), sizeof(bool));
-    cp_file.write((char*)&(crData.pow), sizeof(int));
-    cp_file.write((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.write((char*)&(crData.rate), sizeof(double));
-
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::SReac::restore(std::fstream & cp_file)
+void stex::SReac::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&rExtent, sizeof(uint));
     cp_file.read((char*)&pFlags, sizeof(uint));
 
     cp_file.read((char*)&pCcst, sizeof(double));
     cp_file.read((char*)&pKcst, sizeof(double));
-
-    cp_file.read((char*)&(crData.recorded), sizeof(bool));
-    cp_file.read((char*)&(crData.pow), sizeof(int));
-    cp_file.read((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.read((char*)&(crData.rate), sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void stex::SReac::reset(void)
 {
-
-    crData.recorded = false;
-    crData.pow = 0;
-    crData.pos = 0;
-    crData.rate = 0.0;
     resetExtent();
     resetCcst();
 	setActive(true);
@@ -219,6 +232,7 @@ void stex::SReac::setKcst(double k)
 {
 	assert (k >= 0.0);
 	pKcst = k;
+	rModified = true;
 
 	if (pSReacdef->surf_surf() == false)
 	{
@@ -248,26 +262,14 @@ void stex::SReac::setKcst(double k)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::SReac::setupDeps(void)
+void stex::SReac::setupDeps(stex::Arena & arena)
 {
-    // For all non-zero entries gidx in SReacDef's UPD_S:
-    //   Perform depSpecTri(gidx,tri()) for:
-    //     All kproc's of tri()
-    //     NOTE: we currently don't test kproc's of inner and external tet,
-    //     because that's not strictly necessary.
-    //
-    // If inner tetrahedron exists:
-    //   For all non-zero entries gidx in SReacDef's UPD_I:
-    //     Perform depSpecTet(gidx,itet) for:
-    //       All kproc's of itet
-    //       All kproc's of triangles next to itet
+    // For all non-zero entries gidx in the def's UPD_S, the kprocs that
+    // depend on gidx in tri(), and likewise for UPD_I and UPD_O in the
+    // inner and outer tetrahedron, if they exist (see
+    // Tri::setupSpecDeps and WmVol::setupSpecDeps).
     //
-    // If outer tetrahedron exists:
-    //   Similar to inner tet.
-    //
-    // All dependencies are first collected into a std::set, to sort them
-    // and to eliminate duplicates. At the end of the routine, they are
-    // copied into the vector that will be returned during execution.
+    // Duplicates are removed when the list is packed.
 
     WmVol * itet = pTri->iTet();
     WmVol * otet = pTri->oTet();
@@ -279,92 +281,29 @@ void stex::SReac::setupDeps(void)
     ssolver::gidxTVecCI o_beg = pSReacdef->beginUpdColl_O();
     ssolver::gidxTVecCI o_end = pSReacdef->endUpdColl_O();
 
-    std::set<stex::KProc*> updset;
-    KProcPVecCI kprocend = pTri->kprocEnd();
-    for (KProcPVecCI k = pTri->kprocBegin(); k != kprocend; ++k)
+    std::vector<stex::KProc*> updvec;
+    for (ssolver::gidxTVecCI spec = s_beg; spec != s_end; ++spec)
     {
-        for (ssolver::gidxTVecCI spec = s_beg; spec != s_end; ++spec)
-        {
-            if ((*k)->depSpecTri(*spec, pTri) == true) {
-                //updset.insert((*k)->getSSARef());
-                updset.insert(*k);
-            }
-        }
+        pTri->specDeps(*spec, updvec);
     }
 
     if (itet != 0)
     {
-        kprocend = itet->kprocEnd();
-        for (KProcPVecCI k = itet->kprocBegin(); k != kprocend; ++k)
+        for (ssolver::gidxTVecCI spec = i_beg; spec != i_end; ++spec)
         {
-            for (ssolver::gidxTVecCI spec = i_beg; spec != i_end; ++spec)
-            {
-                if ((*k)->depSpecTet(*spec, itet) == true) {
-                    //updset.insert((*k)->getSSARef());
-                    updset.insert(*k);
-                }
-            }
-        }
-
-
-        std::vector<stex::Tri *>::const_iterator tri_end = itet->nexttriEnd();
-        for (std::vector<stex::Tri *>::const_iterator tri = itet->nexttriBegin();
-    			 tri != tri_end; ++tri)
-        {
-        	if ((*tri) == 0) continue;
-
-            kprocend = (*tri)->kprocEnd();
-            for (KProcPVecCI k = (*tri)->kprocBegin(); k != kprocend; ++k)
-            {
-                for (ssolver::gidxTVecCI spec = i_beg; spec != i_end; ++spec)
-                {
-                    if ((*k)->depSpecTet(*spec, itet) == true) {
-                        //updset.insert((*k)->getSSARef());
-                        updset.insert(*k);
-                    }
-                }
-            }
+            itet->specDeps(*spec, updvec);
         }
     }
 
     if (otet != 0)
     {
-        kprocend = otet->kprocEnd();
-        for (KProcPVecCI k = otet->kprocBegin(); k != kprocend; ++k)
-        {
-            for (ssolver::gidxTVecCI spec = o_beg; spec != o_end; ++spec)
-            {
-                if ((*k)->depSpecTet(*spec, otet) == true) {
-                    //updset.insert((*k)->getSSARef());
-                    updset.insert(*k);
-                }
-            }
-        }
-
-
-
-        std::vector<stex::Tri *>::const_iterator tri_end = otet->nexttriEnd();
-        for (std::vector<stex::Tri *>::const_iterator tri = otet->nexttriBegin();
-    			 tri != tri_end; ++tri)
+        for (ssolver::gidxTVecCI spec = o_beg; spec != o_end; ++spec)
         {
-        	if ((*tri) == 0) continue;
-
-            kprocend = (*tri)->kprocEnd();
-            for (KProcPVecCI k = (*tri)->kprocBegin(); k != kprocend; ++k)
-            {
-                for (ssolver::gidxTVecCI spec = o_beg; spec != o_end; ++spec)
-                {
-                    if ((*k)->depSpecTet(*spec, otet) == true) {
-                        //updset.insert((*k)->getSSARef());
-                        updset.insert(*k);
-                    }
-                }
-            }
+            otet->specDeps(*spec, updvec);
         }
     }
 
-    pUpdVec.assign(updset.begin(), updset.end());
-    //pUpdObjVec.assign(updset_obj.begin(), updset_obj.end());
+    pUpdVec = _pack(arena, updvec);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -399,10 +338,43 @@ bool stex::SReac::depSpecTri(uint gidx, stex::Tri * triangle)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void stex::SReac::depSpecsTet(stex::WmVol * tet, std::vector<uint> & lidxs)
+{
+    // The patch's inner and outer species indices are those of the
+    // inner and outer compartments.
+    ssolver::Patchdef * pdef = pTri->patchdef();
+    uint lidx = pdef->sreacG2L(pSReacdef->gidx());
+    if (tet == pTri->iTet())
+    {
+        lidxs.insert(lidxs.end(), pdef->sreac_depspec_I_bgn(lidx),
+                     pdef->sreac_depspec_I_end(lidx));
+    }
+    else if (tet == pTri->oTet())
+    {
+        lidxs.insert(lidxs.end(), pdef->sreac_depspec_O_bgn(lidx),
+                     pdef->sreac_depspec_O_end(lidx));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::SReac::depSpecsTri(stex::Tri * triangle, std::vector<uint> & lidxs)
+{
+    if (triangle != pTri) return;
+    ssolver::Patchdef * pdef = pTri->patchdef();
+    uint lidx = pdef->sreacG2L(pSReacdef->gidx());
+    lidxs.insert(lidxs.end(), pdef->sreac_depspec_S_bgn(lidx),
+                 pdef->sreac_depspec_S_end(lidx));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 double stex::SReac::rate(steps::tetexact::Tetexact * solver)
 {
 	   if (inactive()) return 0.0;
 
+	    if (pKernel.generic() == false) return pKernel.h() * pCcst;
+
 	    // First we compute the combinatorial part.
 	    //   1/ for the surface part of the stoichiometry
 	    //   2/ for the inner or outer volume part of the stoichiometry,
@@ -414,14 +386,12 @@ double stex::SReac::rate(steps::tetexact::Tetexact * solver)
 
 	    double h_mu = 1.0;
 
-	    uint * lhs_s_vec = pdef->sreac_lhs_S_bgn(lidx);
-	    uint * cnt_s_vec = pTri->pools();
-	    uint nspecs_s = pdef->countSpecs();
-	    for (uint s = 0; s < nspecs_s; ++s)
+	    uint * lhs_s = pdef->sreac_lhsorder_S_bgn(lidx);
+	    uint * s_end = pdef->sreac_lhsspec_S_end(lidx);
+	    for (uint * s = pdef->sreac_lhsspec_S_bgn(lidx); s != s_end; ++s, ++lhs_s)
 	    {
-	        uint lhs = lhs_s_vec[s];
-	        if (lhs == 0) continue;
-	        uint cnt = cnt_s_vec[s];
+	        uint lhs = *lhs_s;
+	        uint cnt = pTri->count(*s);
 	        if (lhs > cnt)
 	        {
 	            return 0.0;
@@ -455,14 +425,12 @@ double stex::SReac::rate(steps::tetexact::Tetexact * solver)
 
 	    if (pSReacdef->inside())
 	    {
-	        uint * lhs_i_vec = pdef->sreac_lhs_I_bgn(lidx);
-	        uint * cnt_i_vec = pTri->iTet()->pools();
-	        uint nspecs_i = pdef->countSpecs_I();
-	        for (uint s = 0; s < nspecs_i; ++s)
+	        uint * lhs_i = pdef->sreac_lhsorder_I_bgn(lidx);
+	        uint * s_i_end = pdef->sreac_lhsspec_I_end(lidx);
+	        for (uint * s = pdef->sreac_lhsspec_I_bgn(lidx); s != s_i_end; ++s, ++lhs_i)
 	        {
-	            uint lhs = lhs_i_vec[s];
-	            if (lhs == 0) continue;
-	            uint cnt = cnt_i_vec[s];
+	            uint lhs = *lhs_i;
+	            uint cnt = pTri->iTet()->count(*s);
 	            if (lhs > cnt)
 	            {
 	                return 0.0;
@@ -496,14 +464,12 @@ double stex::SReac::rate(steps::tetexact::Tetexact * solver)
 	    }
 	    else if (pSReacdef->outside())
 	    {
-	        uint * lhs_o_vec = pdef->sreac_lhs_O_bgn(lidx);
-	        uint * cnt_o_vec = pTri->oTet()->pools();
-	        uint nspecs_o = pdef->countSpecs_O();
-	        for (uint s = 0; s < nspecs_o; ++s)
+	        uint * lhs_o = pdef->sreac_lhsorder_O_bgn(lidx);
+	        uint * s_o_end = pdef->sreac_lhsspec_O_end(lidx);
+	        for (uint * s = pdef->sreac_lhsspec_O_bgn(lidx); s != s_o_end; ++s, ++lhs_o)
 	        {
-	            uint lhs = lhs_o_vec[s];
-	            if (lhs == 0) continue;
-	            uint cnt = cnt_o_vec[s];
+	            uint lhs = *lhs_o;
+	            uint cnt = pTri->oTet()->count(*s);
 	            if (lhs > cnt)
 	            {
 	                return 0.0;
@@ -541,14 +507,13 @@ double stex::SReac::rate(steps::tetexact::Tetexact * solver)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::vector<stex::KProc*> const & stex::SReac::apply(steps::rng::RNG * rng, double dt, double simtime)
+stex::KProcIdxSpan stex::SReac::apply(steps::rng::RNG * rng, double dt, double simtime)
 {
     ssolver::Patchdef * pdef = pTri->patchdef();
     uint lidx = pdef->sreacG2L(pSReacdef->gidx());
 
     // Update triangle pools.
     int * upd_s_vec = pdef->sreac_upd_S_bgn(lidx);
-    uint * cnt_s_vec = pTri->pools();
 
     // First tell the triangles of any channel states relating to ohmic currents
     // that have been changed. If a change has occurred then the triangle will
@@ -568,13 +533,14 @@ std::vector<stex::KProc*> const & stex::SReac::apply(steps::rng::RNG * rng, doub
 		pTri->setOCchange(oc, cs_lidx, dt, simtime);
 	}
 
-    uint nspecs_s = pdef->countSpecs();
-    for (uint s = 0; s < nspecs_s; ++s)
+    int * s_delta = pdef->sreac_upddelta_S_bgn(lidx);
+    uint * s_end = pdef->sreac_updspec_S_end(lidx);
+    for (uint * sp = pdef->sreac_updspec_S_bgn(lidx); sp != s_end; ++sp, ++s_delta)
     {
+        uint s = *sp;
         if (pTri->clamped(s) == true) continue;
-        int upd = upd_s_vec[s];
-        if (upd == 0) continue;
-        int nc = static_cast<int>(cnt_s_vec[s]) + upd;
+        int upd = *s_delta;
+        int nc = static_cast<int>(pTri->count(s)) + upd;
         assert(nc >= 0);
         pTri->setCount(s, static_cast<uint>(nc));
     }
@@ -583,15 +549,14 @@ std::vector<stex::KProc*> const & stex::SReac::apply(steps::rng::RNG * rng, doub
     stex::WmVol * itet = pTri->iTet();
     if (itet != 0)
     {
-        int * upd_i_vec = pdef->sreac_upd_I_bgn(lidx);
-        uint * cnt_i_vec = itet->pools();
-        uint nspecs_i = pdef->countSpecs_I();
-        for (uint s = 0; s < nspecs_i; ++s)
+        int * i_delta = pdef->sreac_upddelta_I_bgn(lidx);
+        uint * i_end = pdef->sreac_updspec_I_end(lidx);
+        for (uint * sp = pdef->sreac_updspec_I_bgn(lidx); sp != i_end; ++sp, ++i_delta)
         {
+            uint s = *sp;
             if (itet->clamped(s) == true) continue;
-            int upd = upd_i_vec[s];
-            if (upd == 0) continue;
-            int nc = static_cast<int>(cnt_i_vec[s]) + upd;
+            int upd = *i_delta;
+            int nc = static_cast<int>(itet->count(s)) + upd;
             assert(nc >= 0);
             itet->setCount(s, static_cast<uint>(nc));
         }
@@ -601,21 +566,21 @@ std::vector<stex::KProc*> const & stex::SReac::apply(steps::rng::RNG * rng, doub
     stex::WmVol * otet = pTri->oTet();
     if (otet != 0)
     {
-        int * upd_o_vec = pdef->sreac_upd_O_bgn(lidx);
-        uint * cnt_o_vec = otet->pools();
-        uint nspecs_o = pdef->countSpecs_O();
-        for (uint s = 0; s < nspecs_o; ++s)
+        int * o_delta = pdef->sreac_upddelta_O_bgn(lidx);
+        uint * o_end = pdef->sreac_updspec_O_end(lidx);
+        for (uint * sp = pdef->sreac_updspec_O_bgn(lidx); sp != o_end; ++sp, ++o_delta)
         {
+            uint s = *sp;
             if (otet->clamped(s) == true) continue;
-            int upd = upd_o_vec[s];
-            if (upd == 0) continue;
-            int nc = static_cast<int>(cnt_o_vec[s]) + upd;
+            int upd = *o_delta;
+            int nc = static_cast<int>(otet->count(s)) + upd;
             assert(nc >= 0);
             otet->setCount(s, static_cast<uint>(nc));
         }
     }
 
     rExtent++;
+    rModified = true;
 
     return pUpdVec;
 }
@@ -45,6 +45,7 @@
 #include "../math/constants.hpp"
 #include "../solver/sreacdef.hpp"
 #include "kproc.hpp"
+#include "ratekernel.hpp"
 //#include "tetexact.hpp"
 
 
@@ -78,10 +79,10 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
 
     ////////////////////////////////////////////////////////////////////////
     // DATA ACCESS
@@ -102,16 +103,21 @@ public:
     // VIRTUAL INTERFACE METHODS
     ////////////////////////////////////////////////////////////////////////
 
-    void setupDeps(void);
+    void setupDeps(steps::tetexact::Arena & arena);
     bool depSpecTet(uint gidx, steps::tetexact::WmVol * tet);
     bool depSpecTri(uint gidx, steps::tetexact::Tri * tri);
+    void depSpecsTet(steps::tetexact::WmVol * tet, std::vector<uint> & lidxs);
+    void depSpecsTri(steps::tetexact::Tri * tri, std::vector<uint> & lidxs);
     void reset(void);
     double rate(steps::tetexact::Tetexact * solver = 0);
-    std::vector<KProc*> const & apply(steps::rng::RNG * rng, double dt, double simtime);
+    steps::tetexact::KProcIdxSpan apply(steps::rng::RNG * rng, double dt, double simtime);
 
     uint updVecSize(void) const
     { return pUpdVec.size(); }
 
+    steps::tetexact::KProcIdxSpan & updList(uint i)
+    { return pUpdVec; }
+
     ////////////////////////////////////////////////////////////////////////
 
     //inline steps::solver::Reacdef * defr(void) const
@@ -125,11 +131,13 @@ private:
 
     steps::solver::SReacdef           * pSReacdef;
     steps::tetexact::Tri              * pTri;
-    std::vector<KProc*>                 pUpdVec;
+    steps::tetexact::KProcIdxSpan         pUpdVec;
     /// Properly scaled reaction constant.
     double                              pCcst;
     // Store the kcst for convenience
     double                              pKcst;
+    /// The combinatorial part of the rate, if the order is two or less.
+    steps::tetexact::RateKernel         pKernel;
 
     ////////////////////////////////////////////////////////////////////////
 
@@ -35,6 +35,7 @@
 #include <algorithm>
 #include <functional>
 #include <iostream>
+#include <new>
 
 // STEPS headers.
 #include "../common.h"
@@ -69,6 +70,7 @@ stex::Tet::Tet
 , pNextTet()
 , pAreas()
 , pDist()
+, pDiffTables()
 {
 	assert (a0 > 0.0 && a1 > 0.0 && a2 > 0.0 && a3 > 0.0);
     assert (d0 >= 0.0 && d1 >= 0.0 && d2 >= 0.0 && d3 >= 0.0);
@@ -111,7 +113,7 @@ stex::Tet::~Tet(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tet::checkpoint(std::fstream & cp_file)
+void stex::Tet::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)pDiffBndDirection, sizeof(bool) * 4);
     WmVol::checkpoint(cp_file);
@@ -119,7 +121,7 @@ void stex::Tet::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tet::restore(std::fstream & cp_file)
+void stex::Tet::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)pDiffBndDirection, sizeof(bool) * 4);
     WmVol::restore(cp_file);
@@ -184,6 +186,8 @@ void stex::Tet::setNextTri(uint i, stex::Tri * t)
 
 void stex::Tet::setupKProcs(stex::Tetexact * tex)
 {
+    _setupDiffTables();
+
     uint j = 0;
 
     // Create reaction kproc's.
@@ -191,7 +195,7 @@ void stex::Tet::setupKProcs(stex::Tetexact * tex)
     for (uint i = 0; i < nreacs; ++i)
     {
         ssolver::Reacdef * rdef = compdef()->reacdef(i);
-        stex::Reac * r = new stex::Reac(rdef, this);
+        stex::Reac * r = new (tex->arena().alloc(sizeof(stex::Reac))) stex::Reac(rdef, this);
         kprocs()[j++] = r;
         tex->addKProc(r);
     }
@@ -204,7 +208,7 @@ void stex::Tet::setupKProcs(stex::Tetexact * tex)
     for (uint i = 0; i < ndiffs; ++i)
     {
         ssolver::Diffdef * ddef = compdef()->diffdef(i);
-        stex::Diff * d = new stex::Diff(ddef, this);
+        stex::Diff * d = new (tex->arena().alloc(sizeof(stex::Diff))) stex::Diff(ddef, this);
         kprocs()[j++] = d;
         tex->addKProc(d);
     }
@@ -212,6 +216,71 @@ void stex::Tet::setupKProcs(stex::Tetexact * tex)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void stex::Tet::_setupDiffTables(void)
+{
+    // The geometric weight of each direction, zero where no molecule can
+    // go whatever the boundaries: no neighbour, or a neighbour in another
+    // compartment that is not across a diffusion boundary.
+    double w[4] = { 0.0, 0.0, 0.0, 0.0 };
+    uint nbnd = 0;
+    for (uint i = 0; i < 4; ++i)
+    {
+        if (pDiffBndDirection[i] == true) ++nbnd;
+        if (pNextTet[i] == 0 || pDist[i] <= 0.0) continue;
+        if (pDiffBndDirection[i] == false && pNextTet[i]->compdef() != compdef()) continue;
+        w[i] = pAreas[i] / (vol() * pDist[i]);
+    }
+
+    uint nrows = 1 << nbnd;
+    pDiffTables.assign(4 * nrows, 0.0);
+    for (uint row = 0; row < nrows; ++row)
+    {
+        double d[4];
+        uint bit = 0;
+        for (uint i = 0; i < 4; ++i)
+        {
+            d[i] = w[i];
+            if (pDiffBndDirection[i] == false) continue;
+            if ((row & (1 << bit)) == 0) d[i] = 0.0;
+            ++bit;
+        }
+
+        double * t = &pDiffTables[4 * row];
+        t[3] = d[0] + d[1] + d[2] + d[3];
+        if (t[3] == 0.0) continue;
+
+        // The last open direction closes the selector at exactly 1, so
+        // rounding never selects a closed direction.
+        uint last = 0;
+        for (uint i = 0; i < 4; ++i)
+        {
+            if (d[i] > 0.0) last = i;
+        }
+        t[0] = d[0] / t[3];
+        t[1] = t[0] + (d[1] / t[3]);
+        t[2] = t[1] + (d[2] / t[3]);
+        for (uint i = last; i < 3; ++i) t[i] = 1.0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double const * stex::Tet::diffTable(uint bndopen) const
+{
+    assert(pDiffTables.empty() == false);
+    uint row = 0;
+    uint bit = 0;
+    for (uint i = 0; i < 4; ++i)
+    {
+        if (pDiffBndDirection[i] == false) continue;
+        if ((bndopen & (1 << i)) != 0) row |= (1 << bit);
+        ++bit;
+    }
+    return &pDiffTables[4 * row];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 stex::Diff * stex::Tet::diff(uint lidx) const
 {
     assert(lidx < compdef()->countDiffs());
@@ -220,4 +289,12 @@ stex::Diff * stex::Tet::diff(uint lidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t stex::Tet::getMemoryUsage(void) const
+{
+    return Arena::footprint(sizeof(Tet)) + _tableMemoryUsage()
+        + pDiffTables.capacity() * sizeof(double);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
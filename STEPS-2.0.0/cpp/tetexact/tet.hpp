@@ -90,10 +90,12 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    std::size_t getMemoryUsage(void) const;
 
     ////////////////////////////////////////////////////////////////////////
     // SETUP
@@ -156,6 +158,15 @@ public:
     inline bool getDiffBndDirection(uint idx) const
     { return pDiffBndDirection[idx]; }
 
+    /// The diffusion table shared by all species diffusing in this
+    /// tetrahedron, for the diffusion boundary directions set in bndopen
+    /// (bit i for direction i) being open. Entries 0 to 2 are the
+    /// cumulative probabilities of leaving in directions 0 to 2; entry 3
+    /// is the sum of area / (vol * dist) over the open directions, which
+    /// times D gives the scaled diffusion constant.
+    ///
+    double const * diffTable(uint bndopen) const;
+
 
     stex::Diff * diff(uint lidx) const;
 
@@ -193,6 +204,14 @@ private:
 
     bool  								pDiffBndDirection[4];
 
+    // The rows returned by diffTable(), four values each, one row for
+    // every combination of open diffusion boundary directions.
+    std::vector<double>                 pDiffTables;
+
+    // Fill pDiffTables from the geometry; needs the neighbours and the
+    // diffusion boundary directions.
+    void _setupDiffTables(void);
+
 
     ////////////////////////////////////////////////////////////////////////
 
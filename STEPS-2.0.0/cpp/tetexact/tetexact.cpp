@@ -33,13 +33,19 @@
 #include <cmath>
 #include <vector>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <functional>
 #include <limits>
 #include <queue>
+#include <set>
 #include <fstream>
 #include <iomanip>
+#include <new>
+#include <sys/time.h>
+#include <pthread.h>
 
 // STEPS headers.
 #include "../common.h"
@@ -50,6 +56,7 @@
 #include "reac.hpp"
 #include "sreac.hpp"
 #include "diff.hpp"
+#include "sdiff.hpp"
 #include "comp.hpp"
 #include "patch.hpp"
 #include "wmvol.hpp"
@@ -57,7 +64,17 @@
 #include "vdeptrans.hpp"
 #include "vdepsreac.hpp"
 #include "diffboundary.hpp"
+#include "clusters.hpp"
+#include "domains.hpp"
+#include "eventtrace.hpp"
+#include "snapshot.hpp"
+#include "../tetode/tetode.hpp"
+#include "../parallel.hpp"
+#include "../meshcache.hpp"
+#include "../trace.hpp"
 #include "../math/constants.hpp"
+#include "../math/tetrahedron.hpp"
+#include "../math/triangle.hpp"
 #include "../error.hpp"
 #include "../solver/statedef.hpp"
 #include "../solver/compdef.hpp"
@@ -65,6 +82,9 @@
 #include "../solver/reacdef.hpp"
 #include "../solver/sreacdef.hpp"
 #include "../solver/diffdef.hpp"
+#include "../solver/surfdiffdef.hpp"
+#include "../solver/diffboundarydef.hpp"
+#include "../solver/specdef.hpp"
 #include "../solver/chandef.hpp"
 #include "../solver/ghkcurrdef.hpp"
 #include "../solver/ohmiccurrdef.hpp"
@@ -75,13 +95,20 @@
 #include "../geom/tet.hpp"
 #include "../geom/tri.hpp"
 
+#include "../solver/efield/backend.hpp"
 #include "../solver/efield/efield.hpp"
+#include "../solver/ssa/scheduler.hpp"
+#include "../solver/ssa/directsched.hpp"
+#include "../solver/ssa/splitsched.hpp"
+#include "../solver/ssa/groupsched.hpp"
+#include "../solver/ssa/crsched.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
 
 NAMESPACE_ALIAS(steps::tetexact, stex);
 NAMESPACE_ALIAS(steps::solver, ssolver);
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
 NAMESPACE_ALIAS(steps::math, smath);
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -107,8 +134,300 @@ void stex::schedIDXSet_To_Vec(stex::SchedIDXSet const & s, stex::SchedIDXVec & v
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// Wall clock time in seconds.
+///
+static double wallTime(void)
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + 1.0e-6 * tv.tv_usec;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Binary predicate that orders indices by a key stored per index.
+///
+struct KeyLess
+{
+    KeyLess(std::vector<uint> const & key)
+    : pKey(key)
+    { }
+
+    bool operator() (uint a, uint b) const
+    {
+        return pKey[a] < pKey[b];
+    }
+
+    std::vector<uint> const & pKey;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The arguments _addTri takes for a patch triangle.
+struct TriGeom
+{
+    double                      area;
+    double                      l[3];
+    double                      d[3];
+    int                         tris[3];
+    int                         tetinner;
+    int                         tetouter;
+};
+
+// The distance between the points a[0..2] and b[0..2], computed as
+// steps::tetmesh::Tet and Tri compute the distances between barycentres.
+static inline double baryDist(double const * a, double const * b)
+{
+    double xdist = a[0] - b[0];
+    double ydist = a[1] - b[1];
+    double zdist = a[2] - b[2];
+    return (sqrt((xdist*xdist) + (ydist*ydist) + (zdist*zdist)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Gathers the TriGeom of each triangle of a patch, given the barycentres
+// of all triangles of the mesh. The mesh is only read, so this can run on
+// several threads.
+class TriGeomLoop : public steps::ParallelLoop
+{
+public:
+    TriGeomLoop(steps::tetmesh::Tetmesh * mesh, steps::tetmesh::TmPatch * patch,
+                std::vector<uint> const & tris, std::vector<double> const & barycs,
+                std::vector<TriGeom> & geom)
+    : pMesh(mesh), pPatch(patch), pTris(tris), pBarycs(barycs), pGeom(geom) { }
+
+    void run(uint i, uint thread)
+    {
+        steps::tetmesh::Tri tri(pMesh, pTris[i]);
+        assert (tri.getPatch() == pPatch);
+        TriGeom & g = pGeom[i];
+        g.area = tri.getArea();
+        g.l[0] = tri.getBar0Length();
+        g.l[1] = tri.getBar1Length();
+        g.l[2] = tri.getBar2Length();
+        std::vector<int> tris = tri.getTriIdxs(pPatch);
+        for (uint j = 0; j < 3; ++j)
+        {
+            g.tris[j] = tris[j];
+            g.d[j] = 0.0;
+            if (tris[j] != -1)
+            {
+                g.d[j] = baryDist(&pBarycs[pTris[i] * 3], &pBarycs[tris[j] * 3]);
+            }
+        }
+        g.tetinner = tri.getTet0Idx();
+        g.tetouter = tri.getTet1Idx();
+    }
+
+private:
+    steps::tetmesh::Tetmesh           * pMesh;
+    steps::tetmesh::TmPatch           * pPatch;
+    std::vector<uint> const           & pTris;
+    std::vector<double> const         & pBarycs;
+    std::vector<TriGeom>              & pGeom;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The arguments _addTet takes for a compartment tetrahedron.
+struct TetGeom
+{
+    double                      vol;
+    double                      a[4];
+    double                      d[4];
+    int                         tets[4];
+};
+
+// Gathers the TetGeom of each tetrahedron of a compartment from the mesh
+// tables and the barycentres of all tetrahedrons, like TriGeomLoop.
+class TetGeomLoop : public steps::ParallelLoop
+{
+public:
+    TetGeomLoop(steps::tetmesh::Tetmesh * mesh, steps::tetmesh::TmComp * comp,
+                std::vector<uint> const & tets, std::vector<double> const & barycs,
+                std::vector<TetGeom> & geom)
+    : pMesh(mesh), pComp(comp), pTets(tets), pBarycs(barycs), pGeom(geom) { }
+
+    void run(uint i, uint thread)
+    {
+        uint tidx = pTets[i];
+        assert (pMesh->getTetComp(tidx) == pComp);
+        uint * tris = pMesh->_getTetTriNeighb(tidx);
+        int * tets = pMesh->_getTetTetNeighb(tidx);
+        TetGeom & g = pGeom[i];
+        g.vol = pMesh->getTetVol(tidx);
+        for (uint j = 0; j < 4; ++j)
+        {
+            g.a[j] = pMesh->getTriArea(tris[j]);
+            g.tets[j] = tets[j];
+            g.d[j] = 0.0;
+            if (tets[j] != -1)
+            {
+                g.d[j] = baryDist(&pBarycs[tidx * 3], &pBarycs[tets[j] * 3]);
+            }
+        }
+    }
+
+private:
+    steps::tetmesh::Tetmesh           * pMesh;
+    steps::tetmesh::TmComp            * pComp;
+    std::vector<uint> const           & pTets;
+    std::vector<double> const         & pBarycs;
+    std::vector<TetGeom>              & pGeom;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Builds the species dependency index of each element. Every element
+// only writes its own index.
+class SpecDepsLoop : public steps::ParallelLoop
+{
+public:
+    SpecDepsLoop(std::vector<stex::WmVol *> const & vols,
+                 std::vector<stex::Tri *> const & tris)
+    : pVols(vols), pTris(tris) { }
+
+    void run(uint i, uint thread)
+    {
+        if (i < pVols.size()) pVols[i]->setupSpecDeps();
+        else pTris[i - pVols.size()]->setupSpecDeps();
+    }
+
+private:
+    std::vector<stex::WmVol *> const  & pVols;
+    std::vector<stex::Tri *> const    & pTris;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Computes the current of each membrane triangle over an EField step from
+// its potential. Every triangle only updates its own channel integrals
+// and charge, and writes its own current.
+class TriCurrLoop : public steps::ParallelLoop
+{
+public:
+    TriCurrLoop(std::vector<stex::Tri *> const & tris,
+                std::vector<double> const & v, std::vector<double> & cur,
+                double dt, double simtime)
+    : pTris(tris), pV(v), pCur(cur), pDT(dt), pSimTime(simtime) { }
+
+    void run(uint i, uint thread)
+    {
+        pCur[i] = pTris[i]->computeI(pV[i], pDT, pSimTime);
+    }
+
+private:
+    std::vector<stex::Tri *> const    & pTris;
+    std::vector<double> const         & pV;
+    std::vector<double>               & pCur;
+    double                              pDT;
+    double                              pSimTime;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Resolves the dependencies of each kproc, packing its update lists into
+// the arena of the calling thread.
+class DepsLoop : public steps::ParallelLoop
+{
+public:
+    DepsLoop(std::vector<stex::KProc *> const & kprocs,
+             std::vector<stex::Arena *> const & arenas)
+    : pKProcs(kprocs), pArenas(arenas) { }
+
+    void run(uint i, uint thread)
+    {
+        pKProcs[i]->setupDeps(*pArenas[thread]);
+    }
+
+private:
+    std::vector<stex::KProc *> const  & pKProcs;
+    std::vector<stex::Arena *> const  & pArenas;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The file of shard i of the sharded checkpoint with index file_name.
+static std::string shardFileName(std::string const & file_name, uint i)
+{
+    std::ostringstream os;
+    os << file_name << "." << i;
+    return os.str();
+}
+
+// Writes, reads or restores each shard of a sharded checkpoint. Every
+// shard only touches its own file, elements and kprocs.
+class ShardLoop : public steps::ParallelLoop
+{
+public:
+    enum Op { WRITE, READ, RESTORE };
+
+    ShardLoop(stex::Tetexact & solver, Op op, std::string const & file_name,
+              std::vector<uint> const & elems, std::vector<uint> const & ranges,
+              std::vector<uint> const & shape, std::vector<std::string> & data,
+              std::vector<uint> & hashes)
+    : pSolver(solver), pOp(op), pFileName(file_name), pElems(elems)
+    , pRanges(ranges), pShape(shape), pData(data), pHashes(hashes) { }
+
+    void run(uint i, uint thread)
+    {
+        std::string name = shardFileName(pFileName, i);
+        if (pOp == WRITE)
+        {
+            pHashes[i] = pSolver._writeShard(name, pElems, pRanges[i],
+                                             pRanges[i + 1], pShape);
+        }
+        else if (pOp == READ)
+        {
+            pHashes[i] = pSolver._readShard(name, pRanges[i], pRanges[i + 1],
+                                            pData[i]);
+        }
+        else
+        {
+            pSolver._restoreShard(pElems, pRanges[i], pRanges[i + 1], pData[i]);
+            std::string().swap(pData[i]);
+        }
+    }
+
+private:
+    stex::Tetexact                    & pSolver;
+    Op                                  pOp;
+    std::string const                 & pFileName;
+    std::vector<uint> const           & pElems;
+    std::vector<uint> const           & pRanges;
+    std::vector<uint> const           & pShape;
+    std::vector<std::string>          & pData;
+    std::vector<uint>                 & pHashes;
+};
+
+// The hash that deltas following a sharded checkpoint refer to: that of
+// the index block and the hashes of the shards.
+static uint shardsHash(std::string const & index, std::vector<uint> const & hashes)
+{
+    std::string all(index);
+    if (hashes.empty() == false)
+    {
+        all.append((char const *)&hashes[0], sizeof(uint) * hashes.size());
+    }
+    return stex::checkpointHash(all);
+}
+
+// Whether file_name starts as the index file of a sharded checkpoint.
+static bool isShardsIndex(std::string const & file_name)
+{
+    std::ifstream cp_file(file_name.c_str(), std::ifstream::binary);
+    char magic[8];
+    cp_file.read(magic, 8);
+    return (cp_file && std::string(magic, 8) == TETEXACT_SHARDS_MAGIC);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 stex::Tetexact::Tetexact(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
-						 bool calcMembPot)
+						 bool calcMembPot, std::string const & scheduler, bool reorder,
+						 uint setupthreads, std::string const & efieldbackend,
+						 bool lazydeps, std::string const & restart)
 : API(m, g, r)
 , pMesh(0)
 , pKProcs()
@@ -119,7 +438,59 @@ stex::Tetexact::Tetexact(steps::model::Model * m, steps::wm::Geom * g, steps::rn
 , pTets()
 , pTris()
 , pWmVols()
-, pA0(0.0)
+, pScheduler(0)
+, pDomains(0)
+, pReorder(reorder)
+, pSetupThreads(setupthreads)
+, pEFBackend(efieldbackend)
+, pLazyDeps(lazydeps)
+, pClampDeps(false)
+, pPruning(false)
+, pNPruned(0)
+, pPruneDead()
+, pPrunedSpecs()
+, pPrunedReacs()
+, pTauLeap(false)
+, pLeapEps(TETEXACT_LEAP_EPSILON)
+, pLeapNCrit(TETEXACT_LEAP_NCRIT)
+, pDiffBatchThreshold(0)
+, pDiffBatchDT(TETEXACT_DIFF_BATCH_DT)
+, pCGSpecs()
+, pCGSize(0.0)
+, pCGDT(TETEXACT_COARSE_GRAIN_DT)
+, pCGTol(TETEXACT_COARSE_GRAIN_TOL)
+, pCGGroup()
+, pCGGroupStart()
+, pCGGroupTets()
+, pCGNeighbStart()
+, pCGNeighbs()
+, pCGMerged()
+, pCGNMerged()
+, pCompactPools(false)
+, pCountTotals(false)
+, pTriggers()
+, pTriggered(-1)
+, pInterventions()
+, pTimeline()
+, pFluxFirst()
+, pFluxEntries()
+, pFluxCounts()
+, pROIElems()
+, pROICounts()
+, pROILinks()
+, pClusters(0)
+, pCountViews(false)
+, pTetCountView()
+, pTriCountView()
+, pProfiling(false)
+, pProfGetNext(0.0)
+, pElemEventsOn(false)
+, pElemEventElem()
+, pElemEvents()
+, pEventTrace(0)
+, pSnapshot(0)
+, pSnapVoxels()
+, pSnapCounts()
 //, pBuilt(false)
 , pEFflag(calcMembPot)
 , pEField(0)
@@ -130,6 +501,54 @@ stex::Tetexact::Tetexact(steps::model::Model * m, steps::wm::Geom * g, steps::rn
 , pEFNTris(0)
 , pEFTris(0)
 , pEFTris_vec(0)
+, pEFTriV()
+, pEFTriI()
+, pEFThreads(1)
+, pEFAdaptDV(0.0)
+, pEFDTMin(0.0)
+, pEFDTMax(0.0)
+, pEFTheta(1.0)
+, pEFMixed(false)
+, pEFPipeline(false)
+, pEFPipe(0)
+, pEFTimeCurr(0.0)
+, pEFTimeUpdate(0.0)
+, pEFStatMaxDV(0.0)
+, pVdepKProcs()
+, pVDepBatchKProcs()
+, pVDepBatchBegin()
+, pVDepNTransBatches(0)
+, pVDepBatchTri()
+, pVDepBatchV()
+, pVDepBatchK()
+, pVDepOtherKProcs()
+, pVDepWindow(0.0)
+, pVDepBatchVC()
+, pVDepBatchKMax()
+, pVDepSlot()
+, pVDepNCand(0.0)
+, pVDepNReject(0.0)
+, pVDepNMoved(0.0)
+, pVDepLump(0.0)
+, pVDepLumpOf()
+, pVDepLumpN()
+, pVDepLumpPos()
+, pVDepLumpHost()
+, pVDepLumpBin()
+, pVDepLumpK()
+, pVDepLumpNSum()
+, pVDepLumpMembers()
+, pVDepLumpFree()
+, pVDepLumpMap()
+, pCompSpecKProcs()
+, pDirtyKProcs()
+, pDirtyFlags()
+, pBatchDepth(0)
+, pPendingKProc(sssa::SCHED_IDX_UNDEFINED)
+, pPendingTime(0.0)
+, pDeltaBaseSet(false)
+, pDeltaBase(0)
+, pCPWrite(0)
 , pEFNTets(0)
 , pEFTets(0)
 , pEFVert_GtoL()
@@ -144,15 +563,208 @@ stex::Tetexact::Tetexact(steps::model::Model * m, steps::wm::Geom * g, steps::rn
         throw steps::ArgErr(os.str());
     }
 
+    if (setupthreads == 0)
+    {
+        std::ostringstream os;
+        os << "Tetexact needs at least one set up thread.";
+        throw steps::ArgErr(os.str());
+    }
+
+    if (calcMembPot == true && steps::solver::efield::hasBackend(efieldbackend) == false)
+    {
+        std::ostringstream os;
+        os << "Unknown EField backend '" << efieldbackend << "'.";
+        throw steps::ArgErr(os.str());
+    }
+
+    // The next subvolume method is the next reaction method over the
+    // elements, with the kproc selected within the element.
+    bool nsm = (scheduler == "nsm");
+    pScheduler = sssa::createScheduler(nsm ? "nrm" : scheduler, rng());
+
 	// All initialization code now in _setup() to allow EField solver to be
 	// derived and create EField local objects within the constructor
-    _setup();
+    resetProfile();
+    if (restart.empty() == true)
+    {
+        _setup();
+    }
+    else
+    {
+        std::string structure;
+        _readRestart(restart, structure);
+        std::istringstream in(structure, std::istringstream::binary);
+        _setup(0, &in);
+    }
+    if (nsm == true) setElementScheduler(true);
+    if (restart.empty() == false) restore(restart);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::Tetexact::Tetexact(stex::Tetexact & src, steps::rng::RNG * r)
+: API(src.model(), src.geom(), (r != 0 ? r : src.rng()))
+, pMesh(0)
+, pKProcs()
+, pComps()
+, pCompMap()
+, pPatches()
+, pDiffBoundaries()
+, pTets()
+, pTris()
+, pWmVols()
+, pScheduler(0)
+, pDomains(0)
+, pReorder(src.pReorder)
+, pSetupThreads(src.pSetupThreads)
+, pEFBackend(src.pEFBackend)
+, pLazyDeps(src.pLazyDeps)
+, pClampDeps(src.pClampDeps)
+, pPruning(src.pPruning)
+, pNPruned(src.pNPruned)
+, pPruneDead(src.pPruneDead)
+, pPrunedSpecs(src.pPrunedSpecs)
+, pPrunedReacs(src.pPrunedReacs)
+, pTauLeap(src.pTauLeap)
+, pLeapEps(src.pLeapEps)
+, pLeapNCrit(src.pLeapNCrit)
+, pDiffBatchThreshold(src.pDiffBatchThreshold)
+, pDiffBatchDT(src.pDiffBatchDT)
+, pCGSpecs(src.pCGSpecs)
+, pCGSize(src.pCGSize)
+, pCGDT(src.pCGDT)
+, pCGTol(src.pCGTol)
+, pCGGroup()
+, pCGGroupStart()
+, pCGGroupTets()
+, pCGNeighbStart()
+, pCGNeighbs()
+, pCGMerged()
+, pCGNMerged()
+, pCompactPools(false)
+, pCountTotals(false)
+, pTriggers()
+, pTriggered(-1)
+, pInterventions(src.pInterventions)
+, pTimeline(src.pTimeline)
+, pFluxFirst()
+, pFluxEntries()
+, pFluxCounts()
+, pROIElems()
+, pROICounts()
+, pROILinks()
+, pClusters(0)
+, pCountViews(false)
+, pTetCountView()
+, pTriCountView()
+, pProfiling(src.pProfiling)
+, pProfGetNext(0.0)
+, pElemEventsOn(false)
+, pElemEventElem()
+, pElemEvents()
+, pEventTrace(0)
+, pSnapshot(0)
+, pSnapVoxels()
+, pSnapCounts()
+//, pBuilt(false)
+, pEFflag(src.pEFflag)
+, pEField(0)
+, pTemp(0.0)
+, pEFDT(1.0e-5)
+, pEFNVerts(0)
+, pEFVerts(0)
+, pEFNTris(0)
+, pEFTris(0)
+, pEFTris_vec(0)
+, pEFTriV()
+, pEFTriI()
+, pEFThreads(src.pEFThreads)
+, pEFAdaptDV(src.pEFAdaptDV)
+, pEFDTMin(src.pEFDTMin)
+, pEFDTMax(src.pEFDTMax)
+, pEFTheta(src.pEFTheta)
+, pEFMixed(src.pEFMixed)
+, pEFPipeline(src.pEFPipeline)
+, pEFPipe(0)
+, pEFTimeCurr(0.0)
+, pEFTimeUpdate(0.0)
+, pEFStatMaxDV(0.0)
+, pVdepKProcs()
+, pVDepBatchKProcs()
+, pVDepBatchBegin()
+, pVDepNTransBatches(0)
+, pVDepBatchTri()
+, pVDepBatchV()
+, pVDepBatchK()
+, pVDepOtherKProcs()
+, pVDepWindow(0.0)
+, pVDepBatchVC()
+, pVDepBatchKMax()
+, pVDepSlot()
+, pVDepNCand(0.0)
+, pVDepNReject(0.0)
+, pVDepNMoved(0.0)
+, pVDepLump(0.0)
+, pVDepLumpOf()
+, pVDepLumpN()
+, pVDepLumpPos()
+, pVDepLumpHost()
+, pVDepLumpBin()
+, pVDepLumpK()
+, pVDepLumpNSum()
+, pVDepLumpMembers()
+, pVDepLumpFree()
+, pVDepLumpMap()
+, pCompSpecKProcs()
+, pDirtyKProcs()
+, pDirtyFlags()
+, pBatchDepth(0)
+, pPendingKProc(sssa::SCHED_IDX_UNDEFINED)
+, pPendingTime(0.0)
+, pDeltaBaseSet(false)
+, pDeltaBase(0)
+, pCPWrite(0)
+, pEFNTets(0)
+, pEFTets(0)
+, pEFVert_GtoL()
+, pEFTri_GtoL()
+, pEFTet_GtoL()
+, pEFTri_LtoG()
+{
+    pScheduler = sssa::createScheduler(src.pScheduler->getName(), rng());
+    resetProfile();
+    _setup(&src);
+    if (src.getWmVolScheduler() == true) setWmVolScheduler(true);
+    if (src.getElementScheduler() == true) setElementScheduler(true);
+    if (src.pVDepWindow > 0.0) setVDepWindow(src.pVDepWindow);
+    if (src.pVDepLump > 0.0) setVDepLump(src.pVDepLump);
+    if (src.pElemEventsOn == true) setElementEvents(true);
+    if (src.pROIElems.empty() == false)
+    {
+        pROIElems = src.pROIElems;
+        _linkROIs(true);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 stex::Tetexact::~Tetexact(void)
 {
+    _joinEfield();
+
+    // Let a background checkpoint finish; its error has nowhere to go.
+    try
+    {
+        waitCheckpoint();
+    }
+    catch (steps::Err &)
+    {
+    }
+
+    delete pClusters;
+    delete pEventTrace;
+    delete pSnapshot;
+
     CompPVecCI comp_e = pComps.end();
     for (CompPVecCI c = pComps.begin(); c != comp_e; ++c) delete *c;
     PatchPVecCI patch_e = pPatches.end();
@@ -164,32 +776,29 @@ stex::Tetexact::~Tetexact(void)
     WmVolPVecCI wvol_e = pWmVols.end();
     for (WmVolPVecCI wvol = pWmVols.begin(); wvol != wvol_e; ++wvol)
     {
-        if ((*wvol) != 0) delete (*wvol);
+        if ((*wvol) != 0) (*wvol)->~WmVol();
     }
 
     TetPVecCI tet_e = pTets.end();
     for (TetPVecCI t = pTets.begin(); t != tet_e; ++t)
     {
-        if ((*t) != 0) delete (*t);
+        if ((*t) != 0) (*t)->~Tet();
     }
 
     TriPVecCI tri_e = pTris.end();
-    for (TriPVecCI t = pTris.end(); t != tri_e; ++t)
+    for (TriPVecCI t = pTris.begin(); t != tri_e; ++t)
     {
-        if ((*t) != 0) delete (*t);
+        if ((*t) != 0) (*t)->~Tri();
     }
 
-    uint ngroups = nGroups.size();
-    for (uint i = 0; i < ngroups; i++) {
-        free(nGroups[i]->indices);
-        delete nGroups[i];
+    std::vector<Arena *>::const_iterator a_end = pSetupArenas.end();
+    for (std::vector<Arena *>::const_iterator a = pSetupArenas.begin(); a != a_end; ++a)
+    {
+        delete *a;
     }
 
-    ngroups = pGroups.size();
-    for (uint i = 0; i < ngroups; i++) {
-        free(pGroups[i]->indices);
-        delete pGroups[i];
-    }
+    delete pScheduler;
+    delete pDomains;
 
     if (efflag())
     {
@@ -206,2532 +815,8490 @@ stex::Tetexact::~Tetexact(void)
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::checkpoint(std::string const & file_name)
+uint stex::checkpointHash(std::string const & data)
 {
-    std::cout << "Checkpoint to " << file_name  << "...";
-	std::fstream cp_file;
+    uint h = 2166136261u;
+    std::string::const_iterator d_end = data.end();
+    for (std::string::const_iterator d = data.begin(); d != d_end; ++d)
+    {
+        h ^= static_cast<unsigned char>(*d);
+        h *= 16777619u;
+    }
+    return h;
+}
 
-    cp_file.open(file_name.c_str(),
-                std::fstream::out | std::fstream::binary | std::fstream::trunc);
+///////////////////////////////////////////////////////////////////////////////
 
-	statedef()->checkpoint(cp_file);
+void stex::Tetexact::_checkpointShape(std::vector<uint> & shape) const
+{
+    shape.clear();
+    shape.push_back(sizeof(uint));
+    shape.push_back(sizeof(double));
+    shape.push_back(pComps.size());
+    shape.push_back(pPatches.size());
+    shape.push_back(pDiffBoundaries.size());
+    shape.push_back(pTets.size());
+    shape.push_back(pTris.size());
+    shape.push_back(nEntries);
+    shape.push_back(pEFflag ? 1 : 0);
+}
 
-    CompPVecCI comp_e = pComps.end();
-    for (CompPVecCI c = pComps.begin(); c != comp_e; ++c) (*c)->checkpoint(cp_file);
+///////////////////////////////////////////////////////////////////////////////
 
-    PatchPVecCI patch_e = pPatches.end();
-    for (PatchPVecCI p = pPatches.begin(); p != patch_e; ++p) (*p)->checkpoint(cp_file);
+void stex::Tetexact::checkpoint(std::string const & file_name)
+{
+    STEPS_TRACE("Tetexact::checkpoint");
+    waitCheckpoint();
+    std::cout << "Checkpoint to " << file_name  << "...";
 
-    DiffBoundaryPVecCI db_e = pDiffBoundaries.end();
-    for (DiffBoundaryPVecCI db = pDiffBoundaries.begin(); db != db_e; ++db) {
-        (*db)->checkpoint(cp_file);
-    }
+    // The state is gathered in memory and written as one block after a
+    // header with the format version, the shape of the solver, and the
+    // size and hash of the block.
+    std::stringstream state(std::stringstream::in | std::stringstream::out
+                            | std::stringstream::binary);
+    _checkpoint(state);
+    std::string data = state.str();
+    _writeCheckpoint(file_name, data);
 
-    WmVolPVecCI wmv_e = pWmVols.end();
-    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
-    {
-        if ((*wmv) != 0) {
-            (*wmv)->checkpoint(cp_file);
-        }
-    }
+    // Deltas follow on from here.
+    _clearModified();
+    pDeltaBaseSet = true;
+    pDeltaBase = checkpointHash(data);
 
+    std::cout << "complete.\n";
+}
 
-    TetPVecCI tet_e = pTets.end();
-    for (TetPVecCI t = pTets.begin(); t != tet_e; ++t)
-    {
-        if ((*t) != 0) {
-        (*t)->checkpoint(cp_file);
-        }
-    }
+///////////////////////////////////////////////////////////////////////////////
 
-    TriPVecCI tri_e = pTris.end();
-    for (TriPVecCI t = pTris.begin(); t != tri_e; ++t)
+void stex::Tetexact::checkpointDelta(std::string const & file_name)
+{
+    STEPS_TRACE("Tetexact::checkpointDelta");
+    waitCheckpoint();
+    if (pDeltaBaseSet == false)
     {
-        if ((*t) != 0) {
-            (*t)->checkpoint(cp_file);
-        }
+        std::ostringstream os;
+        os << "A delta checkpoint needs a checkpoint or restore to follow ";
+        os << "on from (and none since the last reset).";
+        throw steps::ArgErr(os.str());
     }
+    std::cout << "Delta checkpoint to " << file_name  << "...";
 
-    KProcPVecCI e = pKProcs.end();
-    for (KProcPVecCI i = pKProcs.begin(); i != e; ++i) (*i)->checkpoint(cp_file);
+    std::stringstream state(std::stringstream::in | std::stringstream::out
+                            | std::stringstream::binary);
+    _checkpointDelta(state);
+    std::string data = state.str();
+    _writeCheckpoint(file_name, data, true);
 
-    if (pEFflag) {
-        cp_file.write((char*)&pTemp, sizeof(double));
-        cp_file.write((char*)&pEFDT, sizeof(double));
-        pEField->checkpoint(cp_file);
-    }
+    _clearModified();
+    pDeltaBase = checkpointHash(data);
 
-    cp_file.write((char*)&nEntries, sizeof(uint));
+    std::cout << "complete.\n";
+}
+
+///////////////////////////////////////////////////////////////////////////////
 
-    // checkpoint CR SSA
+void stex::Tetexact::_writeCheckpoint(std::string const & file_name,
+                                      std::string const & data, bool delta)
+{
+    std::vector<uint> shape;
+    _checkpointShape(shape);
+    _writeCheckpoint(file_name, shape, data, delta);
+}
 
-    cp_file.write((char*)&pSum, sizeof(double));
-    cp_file.write((char*)&nSum, sizeof(double));
-    cp_file.write((char*)&pA0, sizeof(double));
+///////////////////////////////////////////////////////////////////////////////
 
-    uint n_ngroups = nGroups.size();
-    uint n_pgroups = pGroups.size();
+void stex::Tetexact::_writeCheckpoint(std::string const & file_name,
+                                      std::vector<uint> const & shape,
+                                      std::string const & data, bool delta)
+{
+    if (delta == true)
+    {
+        _writeBlock(file_name, TETEXACT_DELTA_MAGIC, TETEXACT_DELTA_VERSION,
+                    shape, data);
+    }
+    else
+    {
+        _writeBlock(file_name, TETEXACT_CHECKPOINT_MAGIC,
+                    TETEXACT_CHECKPOINT_VERSION, shape, data);
+    }
+}
 
-    cp_file.write((char*)&n_ngroups, sizeof(uint));
-    cp_file.write((char*)&n_pgroups, sizeof(uint));
+////////////////////////////////////////////////////////////////////////////////
 
-    for (uint i = 0; i < n_ngroups; i++) {
-        CRGroup* group = nGroups[i];
-        cp_file.write((char*)&(group->capacity), sizeof(unsigned));
-        cp_file.write((char*)&(group->size), sizeof(unsigned));
-        cp_file.write((char*)&(group->max), sizeof(double));
-        cp_file.write((char*)&(group->sum), sizeof(double));
+uint stex::Tetexact::_writeBlock(std::string const & file_name,
+                                 char const * magic, uint version,
+                                 std::vector<uint> const & shape,
+                                 std::string const & data)
+{
+    uint nshape = shape.size();
+    unsigned long long nbytes = data.size();
+    uint hash = checkpointHash(data);
 
-        for (uint j = 0; j < group->size; j++) {
-            uint idx = group->indices[j]->schedIDX();
-            cp_file.write((char*)&idx, sizeof(uint));
-        }
+	std::fstream cp_file;
+    cp_file.open(file_name.c_str(),
+                std::fstream::out | std::fstream::binary | std::fstream::trunc);
+    if (!cp_file)
+    {
+        std::ostringstream os;
+        os << "Cannot open checkpoint file '" << file_name << "' for writing.";
+        throw steps::ArgErr(os.str());
     }
 
-    for (uint i = 0; i < n_pgroups; i++) {
-        CRGroup* group = pGroups[i];
-        cp_file.write((char*)&(group->capacity), sizeof(unsigned));
-        cp_file.write((char*)&(group->size), sizeof(unsigned));
-        cp_file.write((char*)&(group->max), sizeof(double));
-        cp_file.write((char*)&(group->sum), sizeof(double));
+    cp_file.write(magic, 8);
+    cp_file.write((char*)&version, sizeof(uint));
+    cp_file.write((char*)&nshape, sizeof(uint));
+    cp_file.write((char*)&shape[0], sizeof(uint) * nshape);
+    cp_file.write((char*)&nbytes, sizeof(unsigned long long));
+    cp_file.write((char*)&hash, sizeof(uint));
+    cp_file.write(data.data(), data.size());
 
-        for (uint j = 0; j < group->size; j++) {
-            uint idx = group->indices[j]->schedIDX();
-            cp_file.write((char*)&idx, sizeof(uint));
-        }
+    if (!cp_file)
+    {
+        std::ostringstream os;
+        os << "Error writing checkpoint file '" << file_name << "'.";
+        throw steps::ArgErr(os.str());
     }
 
     cp_file.close();
-    std::cout << "complete.\n";
+    return hash;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::restore(std::string const & file_name)
+struct stex::Tetexact::CheckpointWrite
 {
-    std::cout << "Restore from " << file_name << "...";
-	std::fstream cp_file;
+    std::string                         file_name;
+    std::vector<uint>                   shape;
+    std::string                         data;
+    bool                                delta;
 
-    cp_file.open(file_name.c_str(),
-                std::fstream::in | std::fstream::binary);
+    /// Whether data is being written on thread, and whether it is done
+    /// (guarded by mutex), with the error message if it failed.
+    bool                                threaded;
+    bool                                done;
+    std::string                         error;
 
-    cp_file.seekg(0);
+    pthread_t                           thread;
+    pthread_mutex_t                     mutex;
+};
 
-	statedef()->restore(cp_file);
+///////////////////////////////////////////////////////////////////////////////
 
-    CompPVecCI comp_e = pComps.end();
-    for (CompPVecCI c = pComps.begin(); c != comp_e; ++c) (*c)->restore(cp_file);
-
-    PatchPVecCI patch_e = pPatches.end();
-    for (PatchPVecCI p = pPatches.begin(); p != patch_e; ++p) (*p)->restore(cp_file);
-
-    DiffBoundaryPVecCI db_e = pDiffBoundaries.end();
-    for (DiffBoundaryPVecCI db = pDiffBoundaries.begin(); db != db_e; ++db) {
-        (*db)->restore(cp_file);
+void stex::Tetexact::checkpointAsync(std::string const & file_name, bool delta)
+{
+    STEPS_TRACE("Tetexact::checkpointAsync");
+    waitCheckpoint();
+    if (delta == true && pDeltaBaseSet == false)
+    {
+        std::ostringstream os;
+        os << "A delta checkpoint needs a checkpoint or restore to follow ";
+        os << "on from (and none since the last reset).";
+        throw steps::ArgErr(os.str());
     }
 
-    WmVolPVecCI wmv_e = pWmVols.end();
-    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
+    // Only the capture in memory holds up the simulation.
+    std::stringstream state(std::stringstream::in | std::stringstream::out
+                            | std::stringstream::binary);
+    if (delta == true) _checkpointDelta(state);
+    else _checkpoint(state);
+
+    CheckpointWrite * w = new CheckpointWrite;
+    w->file_name = file_name;
+    _checkpointShape(w->shape);
+    w->data = state.str();
+    w->delta = delta;
+    w->threaded = true;
+    w->done = false;
+    pthread_mutex_init(&w->mutex, 0);
+
+    _clearModified();
+    pDeltaBaseSet = true;
+    pDeltaBase = checkpointHash(w->data);
+
+    pCPWrite = w;
+    if (pthread_create(&w->thread, 0, _checkpointWriter, w) != 0)
     {
-        if ((*wmv) != 0) {
-            (*wmv)->restore(cp_file);
-        }
+        // No thread to be had: write it now.
+        w->threaded = false;
+        _checkpointWriter(w);
     }
+}
 
-    TetPVecCI tet_e = pTets.end();
-    for (TetPVecCI t = pTets.begin(); t != tet_e; ++t)
+///////////////////////////////////////////////////////////////////////////////
+
+void * stex::Tetexact::_checkpointWriter(void * arg)
+{
+    CheckpointWrite * w = static_cast<CheckpointWrite *>(arg);
+    std::string error;
+    try
     {
-        if ((*t) != 0) {
-            (*t)->restore(cp_file);
-        }
+        _writeCheckpoint(w->file_name, w->shape, w->data, w->delta);
     }
-    TriPVecCI tri_e = pTris.end();
-    for (TriPVecCI t = pTris.begin(); t != tri_e; ++t)
+    catch (steps::Err & err)
     {
-        if ((*t) != 0) {
-            (*t)->restore(cp_file);
-        }
+        error = err.getMsg();
     }
 
-    KProcPVecCI e = pKProcs.end();
-    for (KProcPVecCI i = pKProcs.begin(); i != e; ++i) (*i)->restore(cp_file);
+    pthread_mutex_lock(&w->mutex);
+    w->error = error;
+    w->done = true;
+    pthread_mutex_unlock(&w->mutex);
+    return 0;
+}
 
+///////////////////////////////////////////////////////////////////////////////
 
+bool stex::Tetexact::checkpointDone(void)
+{
+    if (pCPWrite == 0) return true;
+    pthread_mutex_lock(&pCPWrite->mutex);
+    bool done = pCPWrite->done;
+    pthread_mutex_unlock(&pCPWrite->mutex);
+    return done;
+}
 
-    if (pEFflag) {
-        cp_file.read((char*)&pTemp, sizeof(double));
-        cp_file.read((char*)&pEFDT, sizeof(double));
-        pEField->restore(cp_file);
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::waitCheckpoint(void)
+{
+    if (pCPWrite == 0) return;
+
+    CheckpointWrite * w = pCPWrite;
+    pCPWrite = 0;
+    if (w->threaded == true) pthread_join(w->thread, 0);
+    pthread_mutex_destroy(&w->mutex);
+    std::string error = w->error;
+    delete w;
+
+    if (error != "")
+    {
+        // The solver state has moved on from a file that is not there.
+        pDeltaBaseSet = false;
+        throw steps::ArgErr(error);
     }
+}
 
-    uint stored_entries = 0;
-    cp_file.read((char*)&stored_entries, sizeof(uint));
+///////////////////////////////////////////////////////////////////////////////
 
-    if (stored_entries != nEntries) {
-        std::ostringstream os;
-		os << "Unknown Restore Error!";
-		throw steps::ArgErr(os.str());
+void stex::Tetexact::restore(std::string const & file_name)
+{
+    STEPS_TRACE("Tetexact::restore");
+    if (isShardsIndex(file_name) == true)
+    {
+        restoreShards(file_name);
+        return;
     }
+    waitCheckpoint();
+    std::cout << "Restore from " << file_name << "...";
 
-    // restore CR SSA
-    cp_file.read((char*)&pSum, sizeof(double));
-    cp_file.read((char*)&nSum, sizeof(double));
-    cp_file.read((char*)&pA0, sizeof(double));
+    std::string data;
+    uint version = _readCheckpoint(file_name, data);
+    std::stringstream state(data, std::stringstream::in | std::stringstream::out
+                            | std::stringstream::binary);
+    _dropPruning();
+    _restore(state, version >= 3);
 
-    uint n_ngroups;
-    uint n_pgroups;
+    _clearModified();
+    pDeltaBaseSet = true;
+    pDeltaBase = checkpointHash(data);
 
-    cp_file.read((char*)&n_ngroups, sizeof(uint));
-    cp_file.read((char*)&n_pgroups, sizeof(uint));
+    std::cout << "complete.\n";
+}
 
-    nGroups.resize(n_ngroups);
-    pGroups.resize(n_pgroups);
+///////////////////////////////////////////////////////////////////////////////
 
-    for (uint i = 0; i < n_ngroups; i++) {
-        unsigned capacity;
-        unsigned size;
-        double max;
-        double sum;
+void stex::Tetexact::restoreDelta(std::string const & file_name)
+{
+    STEPS_TRACE("Tetexact::restoreDelta");
+    waitCheckpoint();
+    std::cout << "Restore delta from " << file_name << "...";
 
-        cp_file.read((char*)&capacity, sizeof(unsigned));
-        cp_file.read((char*)&size, sizeof(unsigned));
-        cp_file.read((char*)&max, sizeof(double));
-        cp_file.read((char*)&sum, sizeof(double));
+    std::string data;
+    _readCheckpoint(file_name, data, true);
+    std::stringstream state(data, std::stringstream::in | std::stringstream::out
+                            | std::stringstream::binary);
+    _dropPruning();
+    _restoreDelta(state);
 
-        nGroups[i] = new CRGroup(0, capacity);
-        nGroups[i]->size = size;
-        nGroups[i]->max = max;
-        nGroups[i]->sum = sum;
+    _clearModified();
+    pDeltaBase = checkpointHash(data);
 
-        for (uint j = 0; j < size; j++) {
-            uint idx;
-            cp_file.read((char*)&idx, sizeof(uint));
-            nGroups[i]->indices[j] = pKProcs[idx];
-        }
-    }
+    std::cout << "complete.\n";
+}
 
-    for (uint i = 0; i < n_pgroups; i++) {
-        unsigned capacity;
-        unsigned size;
-        double max;
-        double sum;
+////////////////////////////////////////////////////////////////////////////////
 
-        cp_file.read((char*)&capacity, sizeof(unsigned));
-        cp_file.read((char*)&size, sizeof(unsigned));
-        cp_file.read((char*)&max, sizeof(double));
-        cp_file.read((char*)&sum, sizeof(double));
+void stex::Tetexact::checkpointShards(std::string const & file_name, uint nshards)
+{
+    STEPS_TRACE("Tetexact::checkpointShards");
+    if (nshards == 0)
+    {
+        std::ostringstream os;
+        os << "Number of shards must be greater than zero.";
+        throw steps::ArgErr(os.str());
+    }
+    waitCheckpoint();
+    std::cout << "Checkpoint to " << file_name << " in " << nshards << " shards...";
 
-        pGroups[i] = new CRGroup(0, capacity);
-        pGroups[i]->size = size;
-        pGroups[i]->max = max;
-        pGroups[i]->sum = sum;
+    std::vector<uint> elems;
+    _shardElems(elems);
+    uint nelems = elems.size();
 
-        for (uint j = 0; j < size; j++) {
-            uint idx;
-            cp_file.read((char*)&idx, sizeof(uint));
-            pGroups[i]->indices[j] = pKProcs[idx];
-        }
+    // Every kproc has to be written with an element, in a shard or in
+    // the index.
+    uint nkprocs = 0;
+    for (uint p = 0; p < nelems; ++p)
+    {
+        if (elems[p] < pTets.size()) nkprocs += pTets[elems[p]]->countKProcs();
+        else nkprocs += pTris[elems[p] - pTets.size()]->countKProcs();
+    }
+    WmVolPVecCI wmv_e = pWmVols.end();
+    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
+    {
+        if ((*wmv) != 0) nkprocs += (*wmv)->countKProcs();
+    }
+    if (nkprocs != nEntries)
+    {
+        std::ostringstream os;
+        os << "Cannot shard the checkpoint: " << (nEntries - nkprocs);
+        os << " kprocs belong to no element.";
+        throw steps::ProgErr(os.str());
     }
 
-    cp_file.close();
+    // The shards split the elements into contiguous ranges; the index
+    // holds their bounds and the global state.
+    std::vector<uint> ranges(nshards + 1, 0);
+    for (uint i = 0; i <= nshards; ++i)
+    {
+        ranges[i] = static_cast<uint>((static_cast<unsigned long long>(nelems) * i) / nshards);
+    }
+    std::stringstream index(std::stringstream::in | std::stringstream::out
+                            | std::stringstream::binary);
+    index.write((char*)&nshards, sizeof(uint));
+    index.write((char*)&nelems, sizeof(uint));
+    index.write((char*)&ranges[0], sizeof(uint) * (nshards + 1));
+    _checkpointGlobal(index);
+    std::string data = index.str();
+
+    // The index is written last, so that it only exists once all its
+    // shards do.
+    std::vector<uint> shape;
+    _checkpointShape(shape);
+    std::vector<std::string> unused;
+    std::vector<uint> hashes(nshards, 0);
+    ShardLoop loop(*this, ShardLoop::WRITE, file_name, elems, ranges, shape,
+                   unused, hashes);
+    steps::parallelFor(loop, nshards, nshards);
+    _writeBlock(file_name, TETEXACT_SHARDS_MAGIC, TETEXACT_SHARDS_VERSION,
+                shape, data);
+
+    // Deltas follow on from here.
+    _clearModified();
+    pDeltaBaseSet = true;
+    pDeltaBase = shardsHash(data, hashes);
 
     std::cout << "complete.\n";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-
-std::string stex::Tetexact::getSolverName(void) const
+void stex::Tetexact::restoreShards(std::string const & file_name, uint nthreads)
 {
-	return "tetexact";
-}
+    STEPS_TRACE("Tetexact::restoreShards");
+    if (nthreads == 0)
+    {
+        std::ostringstream os;
+        os << "Number of threads must be greater than zero.";
+        throw steps::ArgErr(os.str());
+    }
+    waitCheckpoint();
+    std::cout << "Restore from " << file_name << "...";
 
-////////////////////////////////////////////////////////////////////////////////
+    std::fstream cp_file;
+    cp_file.open(file_name.c_str(), std::fstream::in | std::fstream::binary);
+    if (!cp_file)
+    {
+        std::ostringstream os;
+        os << "Cannot open checkpoint file '" << file_name << "'.";
+        throw steps::ArgErr(os.str());
+    }
+    char magic[8];
+    cp_file.read(magic, 8);
+    if (!cp_file || std::string(magic, 8) != TETEXACT_SHARDS_MAGIC)
+    {
+        std::ostringstream os;
+        os << "'" << file_name << "' is not the index file of a sharded checkpoint.";
+        throw steps::ArgErr(os.str());
+    }
+    std::string data;
+    _readBlock(cp_file, file_name, TETEXACT_SHARDS_VERSION, data);
+    cp_file.close();
 
-std::string stex::Tetexact::getSolverDesc(void) const
-{
-	return "SSA Composition and Rejection Exact Method in tetrahedral mesh";
+    std::stringstream index(data, std::stringstream::in | std::stringstream::out
+                            | std::stringstream::binary);
+    uint nshards = 0;
+    uint nelems = 0;
+    index.read((char*)&nshards, sizeof(uint));
+    index.read((char*)&nelems, sizeof(uint));
+    std::vector<uint> elems;
+    _shardElems(elems);
+    bool valid = (index && nshards > 0 && nelems == elems.size());
+    std::vector<uint> ranges;
+    if (valid == true)
+    {
+        ranges.assign(nshards + 1, 0);
+        index.read((char*)&ranges[0], sizeof(uint) * (nshards + 1));
+        valid = (index && ranges[0] == 0 && ranges[nshards] == nelems);
+        for (uint i = 0; i < nshards && valid == true; ++i)
+        {
+            valid = (ranges[i] <= ranges[i + 1]);
+        }
+    }
+    if (valid == false)
+    {
+        std::ostringstream os;
+        os << "Checkpoint file '" << file_name << "' has an invalid shard table.";
+        throw steps::ArgErr(os.str());
+    }
+
+    // All the shards are read and checked before any state changes. The
+    // shards are independent of each other, so any number of threads can
+    // restore them.
+    std::vector<uint> shape;
+    std::vector<std::string> shards(nshards);
+    std::vector<uint> hashes(nshards, 0);
+    ShardLoop read(*this, ShardLoop::READ, file_name, elems, ranges, shape,
+                   shards, hashes);
+    steps::parallelFor(read, nshards, nthreads);
+
+    _dropPruning();
+    _restoreGlobal(index);
+    ShardLoop restore(*this, ShardLoop::RESTORE, file_name, elems, ranges,
+                      shape, shards, hashes);
+    steps::parallelFor(restore, nshards, nthreads);
+    _restoreDone();
+
+    _clearModified();
+    pDeltaBaseSet = true;
+    pDeltaBase = shardsHash(data, hashes);
+
+    std::cout << "complete.\n";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::string stex::Tetexact::getSolverAuthors(void) const
+void stex::Tetexact::_shardElems(std::vector<uint> & elems) const
 {
-	return "Stefan Wils, Iain Hepburn, Weiliang Chen";
+    elems.clear();
+    for (uint t = 0; t < pTets.size(); ++t)
+    {
+        if (pTets[t] != 0) elems.push_back(t);
+    }
+    for (uint t = 0; t < pTris.size(); ++t)
+    {
+        if (pTris[t] != 0) elems.push_back(pTets.size() + t);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::string stex::Tetexact::getSolverEmail(void) const
+uint stex::Tetexact::_writeShard(std::string const & file_name,
+                                 std::vector<uint> const & elems,
+                                 uint begin, uint end,
+                                 std::vector<uint> const & shape)
 {
-	return "steps.dev@gmail.com";
+    std::stringstream state(std::stringstream::in | std::stringstream::out
+                            | std::stringstream::binary);
+    state.write((char*)&begin, sizeof(uint));
+    state.write((char*)&end, sizeof(uint));
+    for (uint p = begin; p < end; ++p)
+    {
+        if (elems[p] < pTets.size())
+        {
+            stex::Tet * tet = pTets[elems[p]];
+            tet->checkpoint(state);
+            KProcPVecCI k_end = tet->kprocEnd();
+            for (KProcPVecCI k = tet->kprocBegin(); k != k_end; ++k)
+            {
+                (*k)->checkpoint(state);
+            }
+        }
+        else
+        {
+            stex::Tri * tri = pTris[elems[p] - pTets.size()];
+            tri->checkpoint(state);
+            KProcPVecCI k_end = tri->kprocEnd();
+            for (KProcPVecCI k = tri->kprocBegin(); k != k_end; ++k)
+            {
+                (*k)->checkpoint(state);
+            }
+        }
+    }
+    return _writeBlock(file_name, TETEXACT_SHARD_MAGIC, TETEXACT_SHARDS_VERSION,
+                       shape, state.str());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setup(void)
+uint stex::Tetexact::_readShard(std::string const & file_name, uint begin,
+                                uint end, std::string & data) const
 {
-	// Perform upcast.
-	if  (! (pMesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom())))
-	{
-		std::ostringstream os;
-		os << "Geometry description to steps::solver::Tetexact solver";
-		os << " constructor is not a valid steps::tetmesh::Tetmesh object.";
-		throw steps::ArgErr(os.str());
-	}
-
-	// First initialise the pTets, pTris vector, because
-	// want tets and tris to maintain indexing from Geometry
-	uint ntets = mesh()->countTets();
-	uint ntris = mesh()->countTris();
-	uint ncomps = mesh()->_countComps();
-
-	pTets.assign(ntets, NULL);
-	pTris.assign(ntris, NULL);
-	pWmVols.assign(ncomps, NULL);
-
-	/*
-     // Now check that every Tetrahedron has been added to a compartment.
-     // This is a requirement for the forseeable future
-     uint ntmcomps = mesh()->_countComps();
-     uint tetcount = 0;
-
-     for (uint c = 0; c < ntmcomps; ++c)
-     {
-     steps::wm::Comp * wmcomp = mesh()->_getComp(c);
-     steps::tetmesh::TmComp * tmcomp = dynamic_cast<steps::tetmesh::TmComp*>(wmcomp);
-     tetcount += tmcomp->countTets();
-     }
-     if (tetcount != ntets)
-     {
-     std::ostringstream os;
-     os << "Cannot create solver object with this ";
-     os << "steps.geom.Tetmesh geometry description object";
-     os << " All tetrahedrons in Tetmesh must be assigned to a";
-     os << " steps.geom.TmComp compartment object.";
-     throw steps::ArgErr(os.str());
-     }
-     */
-
-	// Now create the actual compartments.
-	ssolver::CompDefPVecCI c_end = statedef()->endComp();
-    for (ssolver::CompDefPVecCI c = statedef()->bgnComp(); c != c_end; ++c)
+    std::fstream cp_file;
+    cp_file.open(file_name.c_str(), std::fstream::in | std::fstream::binary);
+    if (!cp_file)
     {
-        uint compdef_gidx = (*c)->gidx();
-        uint comp_idx = _addComp(*c);
-        assert(compdef_gidx == comp_idx);
+        std::ostringstream os;
+        os << "Cannot open checkpoint file '" << file_name << "'.";
+        throw steps::ArgErr(os.str());
     }
-    // Create the actual patches.
-    ssolver::PatchDefPVecCI p_end = statedef()->endPatch();
-    for (ssolver::PatchDefPVecCI p = statedef()->bgnPatch(); p != p_end; ++p)
+    char magic[8];
+    cp_file.read(magic, 8);
+    if (!cp_file || std::string(magic, 8) != TETEXACT_SHARD_MAGIC)
     {
-        uint patchdef_gidx = (*p)->gidx();
-        uint patch_idx = _addPatch(*p);
-        assert(patchdef_gidx == patch_idx);
+        std::ostringstream os;
+        os << "'" << file_name << "' is not a checkpoint shard file.";
+        throw steps::ArgErr(os.str());
     }
+    uint hash = _readBlock(cp_file, file_name, TETEXACT_SHARDS_VERSION, data);
+    cp_file.close();
 
-    // Create the diffusion boundaries
-    ssolver::DiffBoundarydefPVecCI db_end = statedef()->endDiffBoundary();
-    for (ssolver::DiffBoundaryDefPVecCI db = statedef()->bgnDiffBoundary(); db != db_end; ++db)
+    uint stored[2] = { 0, 0 };
+    if (data.size() >= sizeof(stored)) std::memcpy(stored, data.data(), sizeof(stored));
+    if (stored[0] != begin || stored[1] != end)
     {
-    	uint diffboundary_gidx = (*db)->gidx();
-    	uint diffb_idx = _addDiffBoundary(*db);
-    	assert(diffboundary_gidx == diffb_idx);
+        std::ostringstream os;
+        os << "Checkpoint shard '" << file_name << "' does not hold the ";
+        os << "elements its index file gives it.";
+        throw steps::ArgErr(os.str());
     }
+    return hash;
+}
 
-    /*
-
-    got to here. Now have to figure out how to connect patch triangles to the WmComps if
-    one of the compartments is well-mixed (or is that done automatically??)
-     */
+////////////////////////////////////////////////////////////////////////////////
 
-    uint npatches = pPatches.size();
-    assert (mesh()->_countPatches() == npatches);
-    for (uint p = 0; p < npatches; ++p)
+void stex::Tetexact::_restoreShard(std::vector<uint> const & elems,
+                                   uint begin, uint end,
+                                   std::string const & data)
+{
+    std::stringstream state(data, std::stringstream::in | std::stringstream::out
+                            | std::stringstream::binary);
+    state.seekg(2 * sizeof(uint));
+    for (uint p = begin; p < end; ++p)
     {
-    	// Now add the tris for this patch
-    	// We have checked the indexing- p is the global index
-    	steps::wm::Patch * wmpatch = mesh()->_getPatch(p);
-        // Perform upcast
-        if (steps::tetmesh::TmPatch * tmpatch = dynamic_cast<steps::tetmesh::TmPatch*>(wmpatch))
+        if (elems[p] < pTets.size())
         {
-        	steps::tetexact::Patch * localpatch = pPatches[p];
-			std::vector<uint> const & triindcs = tmpatch->_getAllTriIndices();
-			std::vector<uint>::const_iterator t_end = triindcs.end();
-			for (std::vector<uint>::const_iterator t = triindcs.begin();
-				 t != t_end; ++t)
-			{
-				steps::tetmesh::Tri * tri = new steps::tetmesh::Tri(mesh(), (*t));
-				assert (tri->getPatch() == tmpatch);
-				double area = tri->getArea();
-
-				double l0 = tri->getBar0Length();
-				double l1 = tri->getBar1Length();
-				double l2 = tri->getBar2Length();
+            stex::Tet * tet = pTets[elems[p]];
+            tet->restore(state);
+            KProcPVecCI k_end = tet->kprocEnd();
+            for (KProcPVecCI k = tet->kprocBegin(); k != k_end; ++k)
+            {
+                (*k)->restore(state);
+            }
+        }
+        else
+        {
+            stex::Tri * tri = pTris[elems[p] - pTets.size()];
+            tri->restore(state);
+            KProcPVecCI k_end = tri->kprocEnd();
+            for (KProcPVecCI k = tri->kprocBegin(); k != k_end; ++k)
+            {
+                (*k)->restore(state);
+            }
+        }
+    }
+}
 
-				std::vector<int> tris = tri->getTriIdxs(tmpatch);
+////////////////////////////////////////////////////////////////////////////////
 
-				int tri0 = tris[0];
-				int tri1 = tris[1];
-				int tri2 = tris[2];
+void stex::Tetexact::_checkpointGlobal(std::iostream & cp_file)
+{
+    statedef()->checkpoint(cp_file);
 
-				double d0 = tri->getTriDist(0, tri0);
-				double d1 = tri->getTriDist(1, tri1);
-				double d2 = tri->getTriDist(2, tri2);
+    CompPVecCI comp_e = pComps.end();
+    for (CompPVecCI c = pComps.begin(); c != comp_e; ++c) (*c)->checkpoint(cp_file);
 
+    PatchPVecCI patch_e = pPatches.end();
+    for (PatchPVecCI p = pPatches.begin(); p != patch_e; ++p) (*p)->checkpoint(cp_file);
 
-				int tetinner = tri->getTet0Idx();
-				int tetouter = tri->getTet1Idx();
+    DiffBoundaryPVecCI db_e = pDiffBoundaries.end();
+    for (DiffBoundaryPVecCI db = pDiffBoundaries.begin(); db != db_e; ++db) {
+        (*db)->checkpoint(cp_file);
+    }
 
-				_addTri((*t), localpatch, area, l0, l1, l2, d0, d1, d2, tetinner, tetouter, tri0, tri1, tri2);
-				delete tri;
-			}
-        }
-        else
+    WmVolPVecCI wmv_e = pWmVols.end();
+    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
+    {
+        if ((*wmv) == 0) continue;
+        (*wmv)->checkpoint(cp_file);
+        KProcPVecCI k_end = (*wmv)->kprocEnd();
+        for (KProcPVecCI k = (*wmv)->kprocBegin(); k != k_end; ++k)
         {
-    		std::ostringstream os;
-    		os << "Well-mixed patches not supported in steps::solver::Tetexact solver";
-    		throw steps::ArgErr(os.str());
+            (*k)->checkpoint(cp_file);
         }
     }
 
-    ncomps = pComps.size();
-    assert (mesh()->_countComps() == ncomps);
+    if (pEFflag) {
+        cp_file.write((char*)&pTemp, sizeof(double));
+        cp_file.write((char*)&pEFDT, sizeof(double));
+        pEField->checkpoint(cp_file);
+    }
 
-    for (uint c = 0; c < ncomps; ++c)
+    cp_file.write((char*)&nEntries, sizeof(uint));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_restoreGlobal(std::iostream & cp_file)
+{
+    statedef()->restore(cp_file);
+
+    CompPVecCI comp_e = pComps.end();
+    for (CompPVecCI c = pComps.begin(); c != comp_e; ++c) (*c)->restore(cp_file);
+
+    PatchPVecCI patch_e = pPatches.end();
+    for (PatchPVecCI p = pPatches.begin(); p != patch_e; ++p) (*p)->restore(cp_file);
+
+    DiffBoundaryPVecCI db_e = pDiffBoundaries.end();
+    for (DiffBoundaryPVecCI db = pDiffBoundaries.begin(); db != db_e; ++db) {
+        (*db)->restore(cp_file);
+    }
+
+    WmVolPVecCI wmv_e = pWmVols.end();
+    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
     {
-        // Now add the tets for this comp
-     	// We have checked the indexing- c is the global index
-        steps::wm::Comp * wmcomp = mesh()->_getComp(c);
-        // Perform upcast
-        if (steps::tetmesh::TmComp * tmcomp = dynamic_cast<steps::tetmesh::TmComp*>(wmcomp))
+        if ((*wmv) == 0) continue;
+        (*wmv)->restore(cp_file);
+        KProcPVecCI k_end = (*wmv)->kprocEnd();
+        for (KProcPVecCI k = (*wmv)->kprocBegin(); k != k_end; ++k)
         {
-         	steps::tetexact::Comp * localcomp = pComps[c];
-           	std::vector<uint> const & tetindcs = tmcomp->_getAllTetIndices();
-           	std::vector<uint>::const_iterator t_end = tetindcs.end();
-           	for (std::vector<uint>::const_iterator t = tetindcs.begin();
-   				t != t_end; ++t)
-           	{
-           		steps::tetmesh::Tet * tet = new steps::tetmesh::Tet(mesh(), (*t));
-           		assert (tet->getComp() == tmcomp);
-           		double vol = tet->getVol();
-           		double a0 = tet->getTri0Area();
-           		double a1 = tet->getTri1Area();
-           		double a2 = tet->getTri2Area();
-           		double a3 = tet->getTri3Area();
-           		double d0 = tet->getTet0Dist();
-           		double d1 = tet->getTet1Dist();
-           		double d2 = tet->getTet2Dist();
-           		double d3 = tet->getTet3Dist();
-           		// At this point fetch the indices of neighbouring tets too
-           		int tet0 = tet->getTet0Idx();
-           		int tet1 = tet->getTet1Idx();
-           		int tet2 = tet->getTet2Idx();
-           		int tet3 = tet->getTet3Idx();
-           		_addTet((*t), localcomp, vol, a0, a1, a2, a3, d0, d1, d2, d3,
-							tet0, tet1, tet2, tet3);
-           		delete tet;
-           	}
+            (*k)->restore(cp_file);
         }
-        else
-        {
-         	// This means that this compartment is a well-mixed compartment
-           	// It will behave like a tetrahedral-based compartment, but
-           	// contain only one 'voxel' that is connected to all surface
-           	// triangles and has the same volume as the whole compartment
-           	steps::tetexact::Comp * localcomp = pComps[c];
-           	uint cidx = c;
-           	_addWmVol(cidx, localcomp, localcomp->def()->vol());
+    }
 
-           	// Now find all the triangles that reference this well-mixed volume
-           	// and set the inner or outer tetrahedron index accordingly.
+    if (pEFflag) {
+        cp_file.read((char*)&pTemp, sizeof(double));
+        cp_file.read((char*)&pEFDT, sizeof(double));
+        pEField->restore(cp_file);
+        _setupGHKTables();
+    }
 
-           	uint nopatches = wmcomp->_countOPatches();
-           	for (uint i = 0; i < nopatches; ++i)
-           	{
-           		steps::wm::Patch * op = wmcomp->_getOPatch(i);
-           		// 	Comp may have no outer patch
-           		if (op != 0)
-           		{
-           			if (steps::tetmesh::TmPatch * comp_opatch = dynamic_cast<steps::tetmesh::TmPatch*>(op))
-           			{
-           				std::vector<uint> const & triindcs = comp_opatch->_getAllTriIndices();
-           				std::vector<uint>::const_iterator t_end = triindcs.end();
-           				for (std::vector<uint>::const_iterator t = triindcs.begin();
-							t != t_end; ++t)
-           				{
-           					// Well-mixed volume should have been added above
-           					assert (pWmVols[c] != 0);
-           					pTris[(*t)]->setInnerTet(pWmVols[c]);
-							// Add triangle to WmVols' table of neighbouring triangles.
-							pWmVols[c]->setNextTri(pTris[(*t)]);
-           				}
-           			}
-           			else
-           			{
-           				// This should never happen, but ok throw an exception
-           				std::ostringstream os;
-           				os << "Well-mixed patches not supported in steps::solver::Tetexact solver";
-           				throw steps::ProgErr(os.str());
-           			}
-           		}
-           	}
+    uint stored_entries = 0;
+    cp_file.read((char*)&stored_entries, sizeof(uint));
+    if (stored_entries != nEntries) {
+        std::ostringstream os;
+        os << "Unknown Restore Error!";
+        throw steps::ArgErr(os.str());
+    }
+}
 
-           	uint nipatches = wmcomp->_countIPatches();
-           	for (uint i = 0; i < nipatches; ++i)
-           	{
-           		steps::wm::Patch * ip = wmcomp->_getIPatch(i);
-				// Comp may not have an inner patch
-				if (ip != 0)
-				{
-					if (steps::tetmesh::TmPatch * comp_ipatch = dynamic_cast<steps::tetmesh::TmPatch*>(ip))
-					{
-						std::vector<uint> const & triindcs = comp_ipatch->_getAllTriIndices();
-						std::vector<uint>::const_iterator t_end = triindcs.end();
-						for (std::vector<uint>::const_iterator t = triindcs.begin();
-							t != t_end; ++t)
-						{
-							// Well-mixed volume should have been added above
-							assert (pWmVols[c] != 0);
-							pTris[(*t)]->setOuterTet(pWmVols[c]);
-							// Add triangle to WmVols' table of neighbouring triangles.
-							pWmVols[c]->setNextTri(pTris[(*t)]);
-						}
-					}
-					else
-					{
-						// This should never happen, but ok throw an exception
-						std::ostringstream os;
-						os << "Well-mixed patches not supported in steps::solver::Tetexact solver";
-						throw steps::ProgErr(os.str());
-					}
-				}
-           	}
+///////////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::_readCheckpoint(std::string const & file_name,
+                                     std::string & data, bool delta)
+{
+	std::fstream cp_file;
+
+    cp_file.open(file_name.c_str(),
+                std::fstream::in | std::fstream::binary);
+    if (!cp_file)
+    {
+        std::ostringstream os;
+        os << "Cannot open checkpoint file '" << file_name << "'.";
+        throw steps::ArgErr(os.str());
+    }
+
+    cp_file.seekg(0);
 
+    char magic[8];
+    cp_file.read(magic, 8);
+    if (delta == true)
+    {
+        if (!cp_file || std::string(magic, 8) != TETEXACT_DELTA_MAGIC)
+        {
+            std::ostringstream os;
+            os << "'" << file_name << "' is not a delta checkpoint file.";
+            throw steps::ArgErr(os.str());
         }
     }
+    else if (!cp_file || std::string(magic, 8) != TETEXACT_CHECKPOINT_MAGIC)
+    {
+        // A file from before the versioned format: the state starts at the
+        // beginning and runs to the end.
+        cp_file.clear();
+        cp_file.seekg(0);
+        std::ostringstream all(std::ostringstream::out | std::ostringstream::binary);
+        all << cp_file.rdbuf();
+        data = all.str();
+        cp_file.close();
+        return 0;
+    }
 
+    uint expected = (delta ? TETEXACT_DELTA_VERSION : TETEXACT_CHECKPOINT_VERSION);
+    if (delta == false)
+    {
+        // Version 2 lacks only the scheduler state at the end.
+        std::streampos pos = cp_file.tellg();
+        uint version = 0;
+        cp_file.read((char*)&version, sizeof(uint));
+        cp_file.seekg(pos);
+        if (version == 2) expected = version;
+    }
+    _readBlock(cp_file, file_name, expected, data);
+    cp_file.close();
+    return expected;
+}
 
-    // All tets and tris that belong to some comp or patch have been created
-    // locally- now we can connect them locally
-    // NOTE: currently if a tetrahedron's neighbour belongs to a different
-    // comp they do not talk to each other (see stex::Tet::setNextTet())
-    //
+////////////////////////////////////////////////////////////////////////////////
 
-    assert (ntets == pTets.size());
-    // pTets member size of all tets in geometry, but may not be filled with
-    // local tets if they have not been added to a compartment
-    /*
-	 std::vector<steps::tetexact::Tet *>::const_iterator t_end = pTets.end();
-	 for (std::vector<steps::tetexact::Tet *>::const_iterator t = pTets.begin();
-	 t < nlocaltets; ++t)
-	 */
-    for (uint t = 0; t < ntets; ++t)
+uint stex::Tetexact::_readBlock(std::istream & cp_file,
+                                std::string const & file_name, uint expected,
+                                std::string & data) const
+{
+    uint version = 0;
+    uint nshape = 0;
+    cp_file.read((char*)&version, sizeof(uint));
+    cp_file.read((char*)&nshape, sizeof(uint));
+    if (version != expected)
     {
-    	if (pTets[t] == 0) continue;
-    	int tet0 = pTets[t]->tet(0);
-    	int tet1 = pTets[t]->tet(1);
-    	int tet2 = pTets[t]->tet(2);
-    	int tet3 = pTets[t]->tet(3);
-    	// DEBUG 19/03/09 : again, incorrectly didn't allow for tet index == 0
-    	if (tet0 >= 0)
-    	{
-			if (pTets[tet0] != 0) pTets[t]->setNextTet(0, pTets[tet0]);
-    	}
-    	if (tet1 >= 0)
-    	{
-			if (pTets[tet1] != 0) pTets[t]->setNextTet(1, pTets[tet1]);
-    	}
-    	if (tet2 >= 0)
-    	{
-    		if (pTets[tet2] != 0) pTets[t]->setNextTet(2, pTets[tet2]);
-    	}
-    	if (tet3 >= 0)
-    	{
-    		if (pTets[tet3] != 0) pTets[t]->setNextTet(3, pTets[tet3]);
-    	}
-    	// Not setting Tet triangles at this point- only want to set
-    	// for surface triangles
+        std::ostringstream os;
+        os << "Checkpoint file '" << file_name << "' has format version ";
+        os << version << ", expected " << expected << ".";
+        throw steps::ArgErr(os.str());
     }
-    assert (ntris == pTris.size());
 
-    for (uint t = 0; t < ntris; ++t)
+    std::vector<uint> shape;
+    _checkpointShape(shape);
+    std::vector<uint> stored(nshape, 0);
+    if (nshape > 0) cp_file.read((char*)&stored[0], sizeof(uint) * nshape);
+    if (stored != shape)
     {
-    	// Looping over all possible tris, but only some have been added to a patch
-    	if (pTris[t] == 0) continue;
+        std::ostringstream os;
+        os << "Checkpoint file '" << file_name << "' was written by a solver ";
+        os << "for a different model, geometry or build.";
+        throw steps::ArgErr(os.str());
+    }
 
-    	int tri0 = pTris[t]->tri(0);
-    	int tri1 = pTris[t]->tri(1);
-    	int tri2 = pTris[t]->tri(2);
+    unsigned long long nbytes = 0;
+    uint hash = 0;
+    cp_file.read((char*)&nbytes, sizeof(unsigned long long));
+    cp_file.read((char*)&hash, sizeof(uint));
+    data.assign(nbytes, '\0');
+    if (nbytes > 0) cp_file.read(&data[0], nbytes);
+    if (!cp_file || checkpointHash(data) != hash)
+    {
+        std::ostringstream os;
+        os << "Checkpoint file '" << file_name << "' is truncated or corrupt.";
+        throw steps::ArgErr(os.str());
+    }
+    return hash;
+}
 
-    	if (tri0 >= 0)
-    	{
-			if (pTris[tri0] != 0) pTris[t]->setNextTri(0, pTris[tri0]);
-    	}
-    	if (tri1 >= 0)
-    	{
-			if (pTris[tri1] != 0) pTris[t]->setNextTri(1, pTris[tri1]);
-    	}
-    	if (tri2 >= 0)
-    	{
-    		if (pTris[tri2] != 0) pTris[t]->setNextTri(2, pTris[tri2]);
-    	}
+///////////////////////////////////////////////////////////////////////////////
 
-    	// By convention, triangles in a patch should have an inner tetrahedron defined
-    	// (neighbouring tets 'flipped' if necessary in Tetmesh)
-    	// but not necessarily an outer tet
-    	// 17/3/10- actually this is not the case any more with well-mixed compartments
-    	//
-    	int tetinner = pTris[t]->tet(0);
-    	int tetouter = pTris[t]->tet(1);
+// The list of a kproc that is empty, in the structure of a restart.
+static const uint RESTART_LIST_NONE = 0xFFFFFFFF;
 
-    	/* INNER MAY NOT EXIST FOR EFIELD VERSION NOW INNER TETS MAY BE WELL_MIXED COMPARTMENTS
-    	// DEBUG 18/03/09:
-    	// Now correct check, previously didn't allow for tet index == 0
-    	assert(tetinner >= 0);
-    	assert(pTets[tetinner] != 0 );
-		*/
+// A length-prefixed block of bytes, and a run of uints, in the structure
+// of a restart.
+static void writeBlock(std::ostream & out, std::string const & data)
+{
+    unsigned long long nbytes = data.size();
+    out.write((char*)&nbytes, sizeof(unsigned long long));
+    out.write(data.data(), data.size());
+}
 
-    	// Now inside and outside tetrahedrons may be normal tetrahedrons, which
-    	// means compartment is a mesh compartment, or wmvols describing a
-    	// well-mixed compartment with multiple triangle connections.
+static void readBlock(std::istream & in, std::string & data)
+{
+    unsigned long long nbytes = 0;
+    in.read((char*)&nbytes, sizeof(unsigned long long));
+    if (!in) nbytes = 0;
+    data.assign(nbytes, '\0');
+    if (nbytes > 0) in.read(&data[0], nbytes);
+}
+
+static void writeUints(std::ostream & out, std::vector<uint> const & v)
+{
+    uint n = v.size();
+    out.write((char*)&n, sizeof(uint));
+    if (n > 0) out.write((char*)&v[0], sizeof(uint) * n);
+}
 
+static void readUints(std::istream & in, std::vector<uint> & v)
+{
+    uint n = 0;
+    in.read((char*)&n, sizeof(uint));
+    if (!in) n = 0;
+    v.assign(n, 0);
+    if (n > 0) in.read((char*)&v[0], sizeof(uint) * n);
+}
 
-    	if (tetinner >= 0)
-    	{
-    		// NEW FOR THIS VERSION: Tris store index of inner and outer tet (outer may not exist if on
-    		// surface) but tets may not belong to a compartment, even inner tets now
-    		// since they may be well-mixed compartments
-    		//
-    		if (pTets[tetinner] != 0)
-    		{
-    			// A triangle may already have an inner tet defined as a well-mixed
-    			// volume, but that should not be the case here:
-    			assert (pTris[t]->iTet() == 0);
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::checkpointRestart(std::string const & file_name)
+{
+    STEPS_TRACE("Tetexact::checkpointRestart");
+    if (pPruning == true)
+    {
+        std::ostringstream os;
+        os << "A restart cannot hold pruned update lists; switch network ";
+        os << "pruning off first.";
+        throw steps::ArgErr(os.str());
+    }
+    checkpoint(file_name);
+
+    _resolveAllDeps();
+    std::ostringstream out(std::ostringstream::out | std::ostringstream::binary);
+    _checkpointStructure(out);
+    _appendRestart(file_name, out.str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_checkpointStructure(std::ostream & out)
+{
+    // The kprocs, by type, must line up with those of the restart.
+    uint nkprocs = pKProcs.size();
+    uint reorder = pReorder ? 1 : 0;
+    out.write((char*)&nkprocs, sizeof(uint));
+    out.write((char*)&reorder, sizeof(uint));
+    std::vector<uint> types(nkprocs);
+    for (uint k = 0; k < nkprocs; ++k) types[k] = pKProcs[k]->type();
+    writeUints(out, types);
+
+    // The distinct update lists, as CSR, and the list of each kproc.
+    std::map<std::pair<uint const *, uint>, uint> ids;
+    std::vector<uint> start(1, 0);
+    std::vector<uint> idxs;
+    std::vector<uint> lists;
+    for (uint k = 0; k < nkprocs; ++k)
+    {
+        uint nlists = pKProcs[k]->countUpdLists();
+        for (uint l = 0; l < nlists; ++l)
+        {
+            KProcIdxSpan const & upd = pKProcs[k]->updList(l);
+            if (upd.size() == 0)
+            {
+                lists.push_back(RESTART_LIST_NONE);
+                continue;
+            }
+            std::pair<uint const *, uint> key(upd.begin(), upd.size());
+            std::map<std::pair<uint const *, uint>, uint>::iterator i = ids.find(key);
+            if (i == ids.end())
+            {
+                i = ids.insert(std::make_pair(key, static_cast<uint>(start.size() - 1))).first;
+                idxs.insert(idxs.end(), upd.begin(), upd.end());
+                start.push_back(idxs.size());
+            }
+            lists.push_back(i->second);
+        }
+    }
+    writeUints(out, start);
+    writeUints(out, idxs);
+    writeUints(out, lists);
+
+    // The EField ordering and coupling constants.
+    std::ostringstream opt(std::ostringstream::out | std::ostringstream::binary);
+    if (efflag() == true) pEField->saveOptimal(opt);
+    writeBlock(out, opt.str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_restoreStructure(std::istream & in)
+{
+    uint nkprocs = 0;
+    uint reorder = 0;
+    in.read((char*)&nkprocs, sizeof(uint));
+    in.read((char*)&reorder, sizeof(uint));
+    std::vector<uint> types;
+    readUints(in, types);
+    std::vector<uint> start;
+    std::vector<uint> idxs;
+    std::vector<uint> lists;
+    readUints(in, start);
+    readUints(in, idxs);
+    readUints(in, lists);
+
+    bool match = (in && nkprocs == pKProcs.size() && reorder == (pReorder ? 1u : 0u)
+                  && types.size() == nkprocs && start.empty() == false
+                  && start.back() == idxs.size());
+    uint nlists = 0;
+    for (uint k = 0; match == true && k < nkprocs; ++k)
+    {
+        if (types[k] != static_cast<uint>(pKProcs[k]->type())) match = false;
+        nlists += pKProcs[k]->countUpdLists();
+    }
+    if (match == false || lists.size() != nlists)
+    {
+        std::ostringstream os;
+        os << "Restart structure was written by a solver for a different ";
+        os << "model, geometry or options.";
+        throw steps::ArgErr(os.str());
+    }
+
+    // All lists go into one block of the arena.
+    uint nids = start.size() - 1;
+    uint * block = 0;
+    if (idxs.empty() == false)
+    {
+        block = pArena.allocArray<uint>(idxs.size());
+        std::copy(idxs.begin(), idxs.end(), block);
+    }
+    uint n = 0;
+    for (uint k = 0; k < nkprocs; ++k)
+    {
+        KProc * kp = pKProcs[k];
+        uint nkl = kp->countUpdLists();
+        for (uint l = 0; l < nkl; ++l, ++n)
+        {
+            uint id = lists[n];
+            if (id == RESTART_LIST_NONE)
+            {
+                kp->updList(l) = KProcIdxSpan();
+                continue;
+            }
+            if (id >= nids || start[id] > start[id + 1])
+            {
+                std::ostringstream os;
+                os << "Restart structure is corrupt.";
+                throw steps::ArgErr(os.str());
+            }
+            kp->updList(l) = KProcIdxSpan(block + start[id], block + start[id + 1]);
+        }
+        kp->setDepsResolved(true);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_appendRestart(std::string const & file_name,
+                                    std::string const & structure)
+{
+    uint version = TETEXACT_RESTART_VERSION;
+    unsigned long long nbytes = structure.size();
+    uint hash = checkpointHash(structure);
+
+    std::fstream cp_file;
+    cp_file.open(file_name.c_str(),
+                 std::fstream::out | std::fstream::binary | std::fstream::app);
+    if (!cp_file)
+    {
+        std::ostringstream os;
+        os << "Cannot open checkpoint file '" << file_name << "' for writing.";
+        throw steps::ArgErr(os.str());
+    }
+
+    cp_file.write(TETEXACT_RESTART_MAGIC, 8);
+    cp_file.write((char*)&version, sizeof(uint));
+    cp_file.write((char*)&nbytes, sizeof(unsigned long long));
+    cp_file.write((char*)&hash, sizeof(uint));
+    cp_file.write(structure.data(), structure.size());
+
+    if (!cp_file)
+    {
+        std::ostringstream os;
+        os << "Error writing checkpoint file '" << file_name << "'.";
+        throw steps::ArgErr(os.str());
+    }
+
+    cp_file.close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_readRestart(std::string const & file_name,
+                                  std::string & structure)
+{
+    std::fstream cp_file;
+    cp_file.open(file_name.c_str(), std::fstream::in | std::fstream::binary);
+    if (!cp_file)
+    {
+        std::ostringstream os;
+        os << "Cannot open checkpoint file '" << file_name << "'.";
+        throw steps::ArgErr(os.str());
+    }
+
+    // Skip the header and the state block of the checkpoint.
+    char magic[8];
+    uint version = 0;
+    uint nshape = 0;
+    unsigned long long nbytes = 0;
+    cp_file.read(magic, 8);
+    bool found = (cp_file && std::string(magic, 8) == TETEXACT_CHECKPOINT_MAGIC);
+    if (found == true)
+    {
+        cp_file.read((char*)&version, sizeof(uint));
+        cp_file.read((char*)&nshape, sizeof(uint));
+        cp_file.seekg(sizeof(uint) * nshape, std::ios_base::cur);
+        cp_file.read((char*)&nbytes, sizeof(unsigned long long));
+        cp_file.seekg(sizeof(uint) + nbytes, std::ios_base::cur);
+        cp_file.read(magic, 8);
+        found = (cp_file && std::string(magic, 8) == TETEXACT_RESTART_MAGIC);
+    }
+    if (found == false)
+    {
+        std::ostringstream os;
+        os << "Checkpoint file '" << file_name << "' holds no restart ";
+        os << "structure (see checkpointRestart).";
+        throw steps::ArgErr(os.str());
+    }
+
+    cp_file.read((char*)&version, sizeof(uint));
+    if (version != TETEXACT_RESTART_VERSION)
+    {
+        std::ostringstream os;
+        os << "Checkpoint file '" << file_name << "' has restart format version ";
+        os << version << ", expected " << TETEXACT_RESTART_VERSION << ".";
+        throw steps::ArgErr(os.str());
+    }
+
+    uint hash = 0;
+    cp_file.read((char*)&nbytes, sizeof(unsigned long long));
+    cp_file.read((char*)&hash, sizeof(uint));
+    structure.assign(nbytes, '\0');
+    if (nbytes > 0) cp_file.read(&structure[0], nbytes);
+    if (!cp_file || checkpointHash(structure) != hash)
+    {
+        std::ostringstream os;
+        os << "Checkpoint file '" << file_name << "' is truncated or corrupt.";
+        throw steps::ArgErr(os.str());
+    }
+    cp_file.close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+stex::Tetexact * stex::Tetexact::clone(steps::rng::RNG * r)
+{
+    return _cloneFrom(_cloneImage(), r);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+std::vector<stex::Tetexact *> stex::Tetexact::fork
+(
+    std::vector<steps::rng::RNG *> const & rngs
+)
+{
+    std::set<steps::rng::RNG *> seen;
+    uint nreps = rngs.size();
+    for (uint i = 0; i < nreps; ++i)
+    {
+        if (rngs[i] == 0 || seen.insert(rngs[i]).second == false)
+        {
+            std::ostringstream os;
+            os << "Each replicate needs a random number generator of its own.\n";
+            throw steps::ArgErr(os.str());
+        }
+    }
+
+    std::string image = _cloneImage();
+    std::vector<Tetexact *> reps;
+    reps.reserve(nreps);
+    try
+    {
+        for (uint i = 0; i < nreps; ++i)
+        {
+            reps.push_back(_cloneFrom(image, rngs[i]));
+        }
+    }
+    catch (...)
+    {
+        for (uint i = 0; i < reps.size(); ++i) delete reps[i];
+        throw;
+    }
+    return reps;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+std::string stex::Tetexact::_cloneImage(void)
+{
+    std::stringstream state(std::stringstream::in | std::stringstream::out
+                            | std::stringstream::binary);
+    _checkpoint(state);
+    return state.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+stex::Tetexact * stex::Tetexact::_cloneFrom(std::string const & image,
+                                            steps::rng::RNG * r)
+{
+    // The structure is copied by the constructor, the state goes through
+    // the checkpoint traversal in memory, the scheduler state included.
+    Tetexact * copy = new Tetexact(*this, r);
+    try
+    {
+        std::stringstream state(image, std::stringstream::in
+                                | std::stringstream::binary);
+        copy->_restore(state);
+        copy->setCompactPools(pCompactPools);
+        copy->setCountTotals(pCountTotals);
+        copy->setCountViews(pCountViews);
+    }
+    catch (...)
+    {
+        delete copy;
+        throw;
+    }
+    return copy;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setStateFrom(steps::tetode::TetODE & ode,
+                                  std::vector<bool> const & specs)
+{
+    if (ode.mesh() != mesh())
+    {
+        std::ostringstream os;
+        os << "State can only be copied from a solver on the same mesh.\n";
+        throw steps::ArgErr(os.str());
+    }
+    if (specs.empty() == false && specs.size() != statedef()->countSpecs())
+    {
+        std::ostringstream os;
+        os << "Species flags must have one entry per species in the model.\n";
+        throw steps::ArgErr(os.str());
+    }
+
+    // Mark the kprocs as the counts change and refresh them once, instead
+    // of after every count as _setTetCount does.
+    uint ntets = pTets.size();
+    for (uint t = 0; t < ntets; ++t)
+    {
+        Tet * tet = pTets[t];
+        if (tet == 0) continue;
+        ssolver::Compdef * cdef = tet->compdef();
+        uint nspecs = cdef->countSpecs();
+        for (uint l = 0; l < nspecs; ++l)
+        {
+            uint s = cdef->specL2G(l);
+            if (specs.empty() == false && specs[s] == false) continue;
+            tet->setCount(l, _roundCount(ode._getTetCount(t, s)));
+            _markSpec(tet, l);
+        }
+    }
+
+    uint ntris = pTris.size();
+    for (uint t = 0; t < ntris; ++t)
+    {
+        Tri * tri = pTris[t];
+        if (tri == 0) continue;
+        ssolver::Patchdef * pdef = tri->patchdef();
+        uint nspecs = pdef->countSpecs();
+        for (uint l = 0; l < nspecs; ++l)
+        {
+            uint s = pdef->specL2G(l);
+            if (specs.empty() == false && specs[s] == false) continue;
+            tri->setCount(l, _roundCount(ode._getTriCount(t, s)));
+            _markSpec(tri, l);
+        }
+    }
+
+    _updateDirty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::copyStateTo(steps::tetode::TetODE & ode,
+                                 std::vector<bool> const & specs) const
+{
+    if (ode.mesh() != mesh())
+    {
+        std::ostringstream os;
+        os << "State can only be copied to a solver on the same mesh.\n";
+        throw steps::ArgErr(os.str());
+    }
+    if (specs.empty() == false && specs.size() != statedef()->countSpecs())
+    {
+        std::ostringstream os;
+        os << "Species flags must have one entry per species in the model.\n";
+        throw steps::ArgErr(os.str());
+    }
+
+    uint ntets = pTets.size();
+    for (uint t = 0; t < ntets; ++t)
+    {
+        Tet * tet = pTets[t];
+        if (tet == 0) continue;
+        ssolver::Compdef * cdef = tet->compdef();
+        uint nspecs = cdef->countSpecs();
+        for (uint l = 0; l < nspecs; ++l)
+        {
+            uint s = cdef->specL2G(l);
+            if (specs.empty() == false && specs[s] == false) continue;
+            ode._setTetCount(t, s, tet->count(l));
+        }
+    }
+
+    uint ntris = pTris.size();
+    for (uint t = 0; t < ntris; ++t)
+    {
+        Tri * tri = pTris[t];
+        if (tri == 0) continue;
+        ssolver::Patchdef * pdef = tri->patchdef();
+        uint nspecs = pdef->countSpecs();
+        for (uint l = 0; l < nspecs; ++l)
+        {
+            uint s = pdef->specL2G(l);
+            if (specs.empty() == false && specs[s] == false) continue;
+            ode._setTriCount(t, s, tri->count(l));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::_roundCount(double n)
+{
+    if (n <= 0.0) return 0;
+    if (n > std::numeric_limits<unsigned int>::max( ))
+    {
+        std::ostringstream os;
+        os << "Can't set count greater than maximum unsigned integer (";
+        os << std::numeric_limits<unsigned int>::max( ) << ").\n";
+        throw steps::ArgErr(os.str());
+    }
+
+    double n_int = std::floor(n);
+    double n_frc = n - n_int;
+    uint c = static_cast<uint>(n_int);
+    if (n_frc > 0.0)
+    {
+        double rand01 = rng()->getUnfIE();
+        if (rand01 < n_frc) c++;
+    }
+    return c;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_checkpoint(std::iostream & cp_file)
+{
+	statedef()->checkpoint(cp_file);
+
+    CompPVecCI comp_e = pComps.end();
+    for (CompPVecCI c = pComps.begin(); c != comp_e; ++c) (*c)->checkpoint(cp_file);
+
+    PatchPVecCI patch_e = pPatches.end();
+    for (PatchPVecCI p = pPatches.begin(); p != patch_e; ++p) (*p)->checkpoint(cp_file);
+
+    DiffBoundaryPVecCI db_e = pDiffBoundaries.end();
+    for (DiffBoundaryPVecCI db = pDiffBoundaries.begin(); db != db_e; ++db) {
+        (*db)->checkpoint(cp_file);
+    }
+
+    WmVolPVecCI wmv_e = pWmVols.end();
+    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
+    {
+        if ((*wmv) != 0) {
+            (*wmv)->checkpoint(cp_file);
+        }
+    }
+
+
+    TetPVecCI tet_e = pTets.end();
+    for (TetPVecCI t = pTets.begin(); t != tet_e; ++t)
+    {
+        if ((*t) != 0) {
+        (*t)->checkpoint(cp_file);
+        }
+    }
+
+    TriPVecCI tri_e = pTris.end();
+    for (TriPVecCI t = pTris.begin(); t != tri_e; ++t)
+    {
+        if ((*t) != 0) {
+            (*t)->checkpoint(cp_file);
+        }
+    }
+
+    KProcPVecCI e = pKProcs.end();
+    for (KProcPVecCI i = pKProcs.begin(); i != e; ++i) (*i)->checkpoint(cp_file);
+
+    if (pEFflag) {
+        cp_file.write((char*)&pTemp, sizeof(double));
+        cp_file.write((char*)&pEFDT, sizeof(double));
+        pEField->checkpoint(cp_file);
+    }
+
+    cp_file.write((char*)&nEntries, sizeof(uint));
+
+    // The scheduler, as its name and wrappers and its own state, and the
+    // event drawn past the end of the last run: a scheduler rebuilt from
+    // the propensities holds its entries in another order, so it would
+    // pick other events from the same random numbers.
+    std::string name = pScheduler->getName();
+    uint wrappers = (getWmVolScheduler() ? 1 : 0) + (getElementScheduler() ? 2 : 0);
+    writeBlock(cp_file, name);
+    cp_file.write((char*)&wrappers, sizeof(uint));
+    std::ostringstream sched(std::ostringstream::out | std::ostringstream::binary);
+    pScheduler->checkpoint(sched);
+    writeBlock(cp_file, sched.str());
+    cp_file.write((char*)&pPendingKProc, sizeof(uint));
+    cp_file.write((char*)&pPendingTime, sizeof(double));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_restore(std::iostream & cp_file, bool sched)
+{
+	statedef()->restore(cp_file);
+
+    CompPVecCI comp_e = pComps.end();
+    for (CompPVecCI c = pComps.begin(); c != comp_e; ++c) (*c)->restore(cp_file);
+
+    PatchPVecCI patch_e = pPatches.end();
+    for (PatchPVecCI p = pPatches.begin(); p != patch_e; ++p) (*p)->restore(cp_file);
+
+    DiffBoundaryPVecCI db_e = pDiffBoundaries.end();
+    for (DiffBoundaryPVecCI db = pDiffBoundaries.begin(); db != db_e; ++db) {
+        (*db)->restore(cp_file);
+    }
+
+    WmVolPVecCI wmv_e = pWmVols.end();
+    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
+    {
+        if ((*wmv) != 0) {
+            (*wmv)->restore(cp_file);
+        }
+    }
+
+    TetPVecCI tet_e = pTets.end();
+    for (TetPVecCI t = pTets.begin(); t != tet_e; ++t)
+    {
+        if ((*t) != 0) {
+            (*t)->restore(cp_file);
+        }
+    }
+    TriPVecCI tri_e = pTris.end();
+    for (TriPVecCI t = pTris.begin(); t != tri_e; ++t)
+    {
+        if ((*t) != 0) {
+            (*t)->restore(cp_file);
+        }
+    }
+
+    KProcPVecCI e = pKProcs.end();
+    for (KProcPVecCI i = pKProcs.begin(); i != e; ++i) (*i)->restore(cp_file);
+
+
+
+    if (pEFflag) {
+        cp_file.read((char*)&pTemp, sizeof(double));
+        cp_file.read((char*)&pEFDT, sizeof(double));
+        pEField->restore(cp_file);
+        _setupGHKTables();
+    }
+
+    uint stored_entries = 0;
+    cp_file.read((char*)&stored_entries, sizeof(uint));
+
+    if (stored_entries != nEntries) {
+        std::ostringstream os;
+		os << "Unknown Restore Error!";
+		throw steps::ArgErr(os.str());
+    }
+
+    _restoreDone(sched ? &cp_file : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_restoreDone(std::istream * sched)
+{
+    // Rebuild the scheduler from the restored propensities, which also
+    // brings the voltage-dependent windows and lumps up to date.
+    _allClampsChanged();
+    pScheduler->init(nEntries);
+    _update();
+
+    if (sched != 0)
+    {
+        std::string name;
+        std::string state;
+        uint wrappers = 0;
+        uint pending = sssa::SCHED_IDX_UNDEFINED;
+        double pendingtime = 0.0;
+        readBlock(*sched, name);
+        sched->read((char*)&wrappers, sizeof(uint));
+        readBlock(*sched, state);
+        sched->read((char*)&pending, sizeof(uint));
+        sched->read((char*)&pendingtime, sizeof(double));
+        if (!(*sched))
+        {
+            std::ostringstream os;
+            os << "Unknown Restore Error!";
+            throw steps::ArgErr(os.str());
+        }
+
+        // A scheduler of another kind keeps the rebuilt state; the run
+        // then goes on correctly, but not on the trajectory it would have
+        // taken without the checkpoint.
+        uint ours = (getWmVolScheduler() ? 1 : 0) + (getElementScheduler() ? 2 : 0);
+        if (name == pScheduler->getName() && wrappers == ours)
+        {
+            std::istringstream in(state, std::istringstream::in
+                                  | std::istringstream::binary);
+            pScheduler->init(nEntries);
+            if (pScheduler->restore(in) == true)
+            {
+                pPendingKProc = pending;
+                pPendingTime = pendingtime;
+            }
+            else
+            {
+                pScheduler->init(nEntries);
+                _update();
+            }
+        }
+    }
+
+    if (pCountTotals == true) _sumCountTotals();
+    if (_hasROIs() == true) _sumROICounts();
+    if (pCountViews == true) _syncCountViews();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_checkpointRun(std::iostream & cp_file)
+{
+    double t = statedef()->time();
+    uint nsteps = statedef()->nsteps();
+    cp_file.write((char*)&t, sizeof(double));
+    cp_file.write((char*)&nsteps, sizeof(uint));
+
+    // The pools only; the diffusion boundary directions of the tets are
+    // not changed by run().
+    WmVolPVecCI wmv_e = pWmVols.end();
+    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
+    {
+        if ((*wmv) != 0) (*wmv)->WmVol::checkpoint(cp_file);
+    }
+
+    TetPVecCI tet_e = pTets.end();
+    for (TetPVecCI t = pTets.begin(); t != tet_e; ++t)
+    {
+        if ((*t) != 0) (*t)->WmVol::checkpoint(cp_file);
+    }
+
+    TriPVecCI tri_e = pTris.end();
+    for (TriPVecCI t = pTris.begin(); t != tri_e; ++t)
+    {
+        if ((*t) != 0) (*t)->checkpoint(cp_file);
+    }
+
+    std::vector<uint> extents(pKProcs.size());
+    for (uint k = 0; k < pKProcs.size(); ++k) extents[k] = pKProcs[k]->getExtent();
+    if (!extents.empty())
+    {
+        cp_file.write((char*)&extents[0], sizeof(uint) * extents.size());
+    }
+
+    if (pEFflag) pEField->checkpoint(cp_file);
+
+    cp_file.write((char*)&nEntries, sizeof(uint));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_restoreRun(std::iostream & cp_file)
+{
+    _dropPruning();
+    double t = 0.0;
+    uint nsteps = 0;
+    cp_file.read((char*)&t, sizeof(double));
+    cp_file.read((char*)&nsteps, sizeof(uint));
+    statedef()->setTime(t);
+    statedef()->setNSteps(nsteps);
+
+    WmVolPVecCI wmv_e = pWmVols.end();
+    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
+    {
+        if ((*wmv) != 0) (*wmv)->WmVol::restore(cp_file);
+    }
+
+    TetPVecCI tet_e = pTets.end();
+    for (TetPVecCI t = pTets.begin(); t != tet_e; ++t)
+    {
+        if ((*t) != 0) (*t)->WmVol::restore(cp_file);
+    }
+
+    TriPVecCI tri_e = pTris.end();
+    for (TriPVecCI t = pTris.begin(); t != tri_e; ++t)
+    {
+        if ((*t) != 0) (*t)->restore(cp_file);
+    }
+
+    std::vector<uint> extents(pKProcs.size());
+    if (!extents.empty())
+    {
+        cp_file.read((char*)&extents[0], sizeof(uint) * extents.size());
+    }
+    for (uint k = 0; k < pKProcs.size(); ++k) pKProcs[k]->setExtent(extents[k]);
+
+    if (pEFflag) pEField->restore(cp_file);
+
+    uint stored_entries = 0;
+    cp_file.read((char*)&stored_entries, sizeof(uint));
+
+    if (!cp_file || stored_entries != nEntries) {
+        std::ostringstream os;
+        os << "Run state does not match this solver.";
+        throw steps::ArgErr(os.str());
+    }
+
+    _allClampsChanged();
+    pScheduler->init(nEntries);
+    _update();
+
+    if (pCountTotals == true) _sumCountTotals();
+    if (_hasROIs() == true) _sumROICounts();
+    if (pCountViews == true) _syncCountViews();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_checkpointDelta(std::iostream & cp_file)
+{
+    cp_file.write((char*)&pDeltaBase, sizeof(uint));
+
+    // The global state is small and always written in full.
+	statedef()->checkpoint(cp_file);
+
+    CompPVecCI comp_e = pComps.end();
+    for (CompPVecCI c = pComps.begin(); c != comp_e; ++c) (*c)->checkpoint(cp_file);
+
+    PatchPVecCI patch_e = pPatches.end();
+    for (PatchPVecCI p = pPatches.begin(); p != patch_e; ++p) (*p)->checkpoint(cp_file);
+
+    DiffBoundaryPVecCI db_e = pDiffBoundaries.end();
+    for (DiffBoundaryPVecCI db = pDiffBoundaries.begin(); db != db_e; ++db) {
+        (*db)->checkpoint(cp_file);
+    }
+
+    // Each of the per-element and per-kproc sections is the number of
+    // modified entries, their indices, and their records. With the EField
+    // all triangles are written, since their currents change without a
+    // count change.
+    std::vector<uint> idx;
+
+    for (uint i = 0; i < pWmVols.size(); ++i)
+    {
+        if (pWmVols[i] != 0 && pWmVols[i]->modified()) idx.push_back(i);
+    }
+    uint n = idx.size();
+    cp_file.write((char*)&n, sizeof(uint));
+    if (n > 0) cp_file.write((char*)&idx[0], sizeof(uint) * n);
+    for (uint i = 0; i < n; ++i) pWmVols[idx[i]]->checkpoint(cp_file);
+
+    idx.clear();
+    for (uint i = 0; i < pTets.size(); ++i)
+    {
+        if (pTets[i] != 0 && pTets[i]->modified()) idx.push_back(i);
+    }
+    n = idx.size();
+    cp_file.write((char*)&n, sizeof(uint));
+    if (n > 0) cp_file.write((char*)&idx[0], sizeof(uint) * n);
+    for (uint i = 0; i < n; ++i) pTets[idx[i]]->checkpoint(cp_file);
+
+    idx.clear();
+    for (uint i = 0; i < pTris.size(); ++i)
+    {
+        if (pTris[i] != 0 && (pEFflag || pTris[i]->modified())) idx.push_back(i);
+    }
+    n = idx.size();
+    cp_file.write((char*)&n, sizeof(uint));
+    if (n > 0) cp_file.write((char*)&idx[0], sizeof(uint) * n);
+    for (uint i = 0; i < n; ++i) pTris[idx[i]]->checkpoint(cp_file);
+
+    idx.clear();
+    for (uint i = 0; i < pKProcs.size(); ++i)
+    {
+        if (pKProcs[i]->modified()) idx.push_back(i);
+    }
+    n = idx.size();
+    cp_file.write((char*)&n, sizeof(uint));
+    if (n > 0) cp_file.write((char*)&idx[0], sizeof(uint) * n);
+    for (uint i = 0; i < n; ++i) pKProcs[idx[i]]->checkpoint(cp_file);
+
+    if (pEFflag) {
+        cp_file.write((char*)&pTemp, sizeof(double));
+        cp_file.write((char*)&pEFDT, sizeof(double));
+        pEField->checkpoint(cp_file);
+    }
+
+    cp_file.write((char*)&nEntries, sizeof(uint));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_restoreDelta(std::iostream & cp_file)
+{
+    uint base = 0;
+    cp_file.read((char*)&base, sizeof(uint));
+    if (pDeltaBaseSet == false || base != pDeltaBase)
+    {
+        std::ostringstream os;
+        os << "Delta checkpoint does not follow on from the last checkpoint ";
+        os << "or delta restored into this solver.";
+        throw steps::ArgErr(os.str());
+    }
+
+	statedef()->restore(cp_file);
+
+    CompPVecCI comp_e = pComps.end();
+    for (CompPVecCI c = pComps.begin(); c != comp_e; ++c) (*c)->restore(cp_file);
+
+    PatchPVecCI patch_e = pPatches.end();
+    for (PatchPVecCI p = pPatches.begin(); p != patch_e; ++p) (*p)->restore(cp_file);
+
+    DiffBoundaryPVecCI db_e = pDiffBoundaries.end();
+    for (DiffBoundaryPVecCI db = pDiffBoundaries.begin(); db != db_e; ++db) {
+        (*db)->restore(cp_file);
+    }
+
+    std::vector<uint> idx;
+    bool bad = false;
+
+    uint n = 0;
+    cp_file.read((char*)&n, sizeof(uint));
+    idx.assign(cp_file ? n : 0, 0);
+    if (!idx.empty()) cp_file.read((char*)&idx[0], sizeof(uint) * n);
+    for (uint i = 0; i < idx.size() && !bad; ++i)
+    {
+        bad = (idx[i] >= pWmVols.size() || pWmVols[idx[i]] == 0);
+        if (!bad) pWmVols[idx[i]]->restore(cp_file);
+    }
+
+    n = 0;
+    cp_file.read((char*)&n, sizeof(uint));
+    idx.assign(cp_file && !bad ? n : 0, 0);
+    if (!idx.empty()) cp_file.read((char*)&idx[0], sizeof(uint) * n);
+    for (uint i = 0; i < idx.size() && !bad; ++i)
+    {
+        bad = (idx[i] >= pTets.size() || pTets[idx[i]] == 0);
+        if (!bad) pTets[idx[i]]->restore(cp_file);
+    }
+
+    n = 0;
+    cp_file.read((char*)&n, sizeof(uint));
+    idx.assign(cp_file && !bad ? n : 0, 0);
+    if (!idx.empty()) cp_file.read((char*)&idx[0], sizeof(uint) * n);
+    for (uint i = 0; i < idx.size() && !bad; ++i)
+    {
+        bad = (idx[i] >= pTris.size() || pTris[idx[i]] == 0);
+        if (!bad) pTris[idx[i]]->restore(cp_file);
+    }
+
+    n = 0;
+    cp_file.read((char*)&n, sizeof(uint));
+    idx.assign(cp_file && !bad ? n : 0, 0);
+    if (!idx.empty()) cp_file.read((char*)&idx[0], sizeof(uint) * n);
+    for (uint i = 0; i < idx.size() && !bad; ++i)
+    {
+        bad = (idx[i] >= pKProcs.size());
+        if (!bad) pKProcs[idx[i]]->restore(cp_file);
+    }
+
+    if (pEFflag && !bad) {
+        cp_file.read((char*)&pTemp, sizeof(double));
+        cp_file.read((char*)&pEFDT, sizeof(double));
+        pEField->restore(cp_file);
+        _setupGHKTables();
+    }
+
+    uint stored_entries = 0;
+    cp_file.read((char*)&stored_entries, sizeof(uint));
+
+    if (bad || !cp_file || stored_entries != nEntries) {
+        std::ostringstream os;
+        os << "Delta checkpoint does not match this solver; the solver ";
+        os << "state is undefined until the next restore.";
+        pDeltaBaseSet = false;
+        throw steps::ArgErr(os.str());
+    }
+
+    _allClampsChanged();
+    pScheduler->init(nEntries);
+    _update();
+
+    if (pCountTotals == true) _sumCountTotals();
+    if (_hasROIs() == true) _sumROICounts();
+    if (pCountViews == true) _syncCountViews();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_clearModified(void)
+{
+    WmVolPVecCI wmv_e = pWmVols.end();
+    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
+    {
+        if ((*wmv) != 0) (*wmv)->setModified(false);
+    }
+
+    TetPVecCI tet_e = pTets.end();
+    for (TetPVecCI t = pTets.begin(); t != tet_e; ++t)
+    {
+        if ((*t) != 0) (*t)->setModified(false);
+    }
+
+    TriPVecCI tri_e = pTris.end();
+    for (TriPVecCI t = pTris.begin(); t != tri_e; ++t)
+    {
+        if ((*t) != 0) (*t)->setModified(false);
+    }
+
+    KProcPVecCI k_e = pKProcs.end();
+    for (KProcPVecCI k = pKProcs.begin(); k != k_e; ++k) (*k)->setModified(false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+
+std::string stex::Tetexact::getSolverName(void) const
+{
+	return "tetexact";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string stex::Tetexact::getSolverDesc(void) const
+{
+	return "SSA Composition and Rejection Exact Method in tetrahedral mesh";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string stex::Tetexact::getSolverAuthors(void) const
+{
+	return "Stefan Wils, Iain Hepburn, Weiliang Chen";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string stex::Tetexact::getSolverEmail(void) const
+{
+	return "steps.dev@gmail.com";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_setup(stex::Tetexact * src, std::istream * structure)
+{
+	double t_start = wallTime();
+	pSetupPhases.clear();
+	pSetupTime.clear();
+	pSetupCount.clear();
+	ssolver::Statedef * sd = statedef();
+	_setupPhase("statedef", sd->getSetupTime(), sd->countSpecs() + sd->countReacs()
+				+ sd->countSReacs() + sd->countDiffs() + sd->countSurfDiffs());
+
+	// Perform upcast.
+	if  (! (pMesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom())))
+	{
+		std::ostringstream os;
+		os << "Geometry description to steps::solver::Tetexact solver";
+		os << " constructor is not a valid steps::tetmesh::Tetmesh object.";
+		throw steps::ArgErr(os.str());
+	}
+
+	// First initialise the pTets, pTris vector, because
+	// want tets and tris to maintain indexing from Geometry
+	uint ntets = mesh()->countTets();
+	uint ntris = mesh()->countTris();
+	uint ncomps = mesh()->_countComps();
+
+	pTets.assign(ntets, NULL);
+	pTris.assign(ntris, NULL);
+	pWmVols.assign(ncomps, NULL);
+
+	/*
+     // Now check that every Tetrahedron has been added to a compartment.
+     // This is a requirement for the forseeable future
+     uint ntmcomps = mesh()->_countComps();
+     uint tetcount = 0;
+
+     for (uint c = 0; c < ntmcomps; ++c)
+     {
+     steps::wm::Comp * wmcomp = mesh()->_getComp(c);
+     steps::tetmesh::TmComp * tmcomp = dynamic_cast<steps::tetmesh::TmComp*>(wmcomp);
+     tetcount += tmcomp->countTets();
+     }
+     if (tetcount != ntets)
+     {
+     std::ostringstream os;
+     os << "Cannot create solver object with this ";
+     os << "steps.geom.Tetmesh geometry description object";
+     os << " All tetrahedrons in Tetmesh must be assigned to a";
+     os << " steps.geom.TmComp compartment object.";
+     throw steps::ArgErr(os.str());
+     }
+     */
+
+	// Now create the actual compartments.
+	ssolver::CompDefPVecCI c_end = statedef()->endComp();
+    for (ssolver::CompDefPVecCI c = statedef()->bgnComp(); c != c_end; ++c)
+    {
+        uint compdef_gidx = (*c)->gidx();
+        uint comp_idx = _addComp(*c);
+        assert(compdef_gidx == comp_idx);
+    }
+    // Create the actual patches.
+    ssolver::PatchDefPVecCI p_end = statedef()->endPatch();
+    for (ssolver::PatchDefPVecCI p = statedef()->bgnPatch(); p != p_end; ++p)
+    {
+        uint patchdef_gidx = (*p)->gidx();
+        uint patch_idx = _addPatch(*p);
+        assert(patchdef_gidx == patch_idx);
+    }
+
+    // Create the diffusion boundaries
+    ssolver::DiffBoundarydefPVecCI db_end = statedef()->endDiffBoundary();
+    for (ssolver::DiffBoundaryDefPVecCI db = statedef()->bgnDiffBoundary(); db != db_end; ++db)
+    {
+    	uint diffboundary_gidx = (*db)->gidx();
+    	uint diffb_idx = _addDiffBoundary(*db);
+    	assert(diffboundary_gidx == diffb_idx);
+    }
+
+    /*
+
+    got to here. Now have to figure out how to connect patch triangles to the WmComps if
+    one of the compartments is well-mixed (or is that done automatically??)
+     */
+
+    // The tets, and the triangles after the rank of their inner tet, are
+    // created and set up in layout order.
+    std::vector<uint> tetrank;
+    _tetLayout(tetrank);
+    std::vector<uint> trirank(ntris, ntets);
+    for (uint t = 0; t < ntris; ++t)
+    {
+        int inner = mesh()->_getTriTetNeighb(t)[0];
+        trirank[t] = (inner < 0 ? ntets : tetrank[inner]);
+    }
+
+    // The barycentres the distances between neighbours are measured
+    // between, computed for the whole mesh at once.
+    std::vector<double> tribarycs;
+    std::vector<double> tetbarycs;
+    if (src == 0)
+    {
+    	double * verts = mesh()->_getVertex(0);
+    	uint ntris = mesh()->countTris();
+    	uint ntets = mesh()->countTets();
+    	tribarycs.resize(ntris * 3);
+    	tetbarycs.resize(ntets * 3);
+    	if (ntris != 0)
+    	{
+    		steps::math::triBarycenters(verts, mesh()->_getTri(0), ntris, &tribarycs[0]);
+    	}
+    	if (ntets != 0)
+    	{
+    		steps::math::tet_barycenters(verts, mesh()->_getTet(0), ntets, &tetbarycs[0]);
+    	}
+    }
+
+    uint npatches = pPatches.size();
+    assert (mesh()->_countPatches() == npatches);
+    for (uint p = 0; p < npatches; ++p)
+    {
+    	// Now add the tris for this patch
+    	// We have checked the indexing- p is the global index
+    	steps::wm::Patch * wmpatch = mesh()->_getPatch(p);
+        // Perform upcast
+        if (steps::tetmesh::TmPatch * tmpatch = dynamic_cast<steps::tetmesh::TmPatch*>(wmpatch))
+        {
+        	steps::tetexact::Patch * localpatch = pPatches[p];
+			std::vector<uint> triindcs = tmpatch->_getAllTriIndices();
+			if (pReorder == true)
+			{
+				std::stable_sort(triindcs.begin(), triindcs.end(), KeyLess(trirank));
+			}
+			// The geometry is gathered in parallel, or taken from the
+			// source solver, and the triangles are then added in order.
+			uint npatchtris = triindcs.size();
+			std::vector<TriGeom> geom(npatchtris);
+			if (src == 0)
+			{
+				TriGeomLoop loop(mesh(), tmpatch, triindcs, tribarycs, geom);
+				steps::parallelFor(loop, npatchtris, pSetupThreads);
+			}
+			else
+			{
+				for (uint t = 0; t < npatchtris; ++t)
+				{
+					stex::Tri * stri = src->pTris[triindcs[t]];
+					TriGeom & g = geom[t];
+					g.area = stri->area();
+					for (uint j = 0; j < 3; ++j)
+					{
+						g.l[j] = stri->length(j);
+						g.d[j] = stri->dist(j);
+						g.tris[j] = stri->tri(j);
+					}
+					g.tetinner = stri->tet(0);
+					g.tetouter = stri->tet(1);
+				}
+			}
+			for (uint t = 0; t < npatchtris; ++t)
+			{
+				TriGeom const & g = geom[t];
+				_addTri(triindcs[t], localpatch, g.area, g.l[0], g.l[1], g.l[2],
+						g.d[0], g.d[1], g.d[2], g.tetinner, g.tetouter,
+						g.tris[0], g.tris[1], g.tris[2]);
+			}
+        }
+        else
+        {
+    		std::ostringstream os;
+    		os << "Well-mixed patches not supported in steps::solver::Tetexact solver";
+    		throw steps::ArgErr(os.str());
+        }
+    }
+
+    ncomps = pComps.size();
+    assert (mesh()->_countComps() == ncomps);
+
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        // Now add the tets for this comp
+     	// We have checked the indexing- c is the global index
+        steps::wm::Comp * wmcomp = mesh()->_getComp(c);
+        // Perform upcast
+        if (steps::tetmesh::TmComp * tmcomp = dynamic_cast<steps::tetmesh::TmComp*>(wmcomp))
+        {
+         	steps::tetexact::Comp * localcomp = pComps[c];
+           	std::vector<uint> tetindcs = tmcomp->_getAllTetIndices();
+           	if (pReorder == true)
+           	{
+           		std::sort(tetindcs.begin(), tetindcs.end(), KeyLess(tetrank));
+           	}
+           	// As for the triangles, the geometry (including the indices of
+           	// neighbouring tets) is gathered in parallel first.
+           	uint ncomptets = tetindcs.size();
+           	std::vector<TetGeom> geom(ncomptets);
+           	if (src == 0)
+           	{
+           		TetGeomLoop loop(mesh(), tmcomp, tetindcs, tetbarycs, geom);
+           		steps::parallelFor(loop, ncomptets, pSetupThreads);
+           	}
+           	else
+           	{
+           		for (uint t = 0; t < ncomptets; ++t)
+           		{
+           			stex::Tet * stet = src->pTets[tetindcs[t]];
+           			TetGeom & g = geom[t];
+           			g.vol = stet->vol();
+           			for (uint j = 0; j < 4; ++j)
+           			{
+           				g.a[j] = stet->area(j);
+           				g.d[j] = stet->dist(j);
+           				g.tets[j] = stet->tet(j);
+           			}
+           		}
+           	}
+           	for (uint t = 0; t < ncomptets; ++t)
+           	{
+           		TetGeom const & g = geom[t];
+           		_addTet(tetindcs[t], localcomp, g.vol, g.a[0], g.a[1], g.a[2], g.a[3],
+							g.d[0], g.d[1], g.d[2], g.d[3],
+							g.tets[0], g.tets[1], g.tets[2], g.tets[3]);
+           	}
+        }
+        else
+        {
+         	// This means that this compartment is a well-mixed compartment
+           	// It will behave like a tetrahedral-based compartment, but
+           	// contain only one 'voxel' that is connected to all surface
+           	// triangles and has the same volume as the whole compartment
+           	steps::tetexact::Comp * localcomp = pComps[c];
+           	uint cidx = c;
+           	_addWmVol(cidx, localcomp, localcomp->def()->vol());
+
+           	// Now find all the triangles that reference this well-mixed volume
+           	// and set the inner or outer tetrahedron index accordingly.
+
+           	uint nopatches = wmcomp->_countOPatches();
+           	for (uint i = 0; i < nopatches; ++i)
+           	{
+           		steps::wm::Patch * op = wmcomp->_getOPatch(i);
+           		// 	Comp may have no outer patch
+           		if (op != 0)
+           		{
+           			if (steps::tetmesh::TmPatch * comp_opatch = dynamic_cast<steps::tetmesh::TmPatch*>(op))
+           			{
+           				std::vector<uint> const & triindcs = comp_opatch->_getAllTriIndices();
+           				std::vector<uint>::const_iterator t_end = triindcs.end();
+           				for (std::vector<uint>::const_iterator t = triindcs.begin();
+							t != t_end; ++t)
+           				{
+           					// Well-mixed volume should have been added above
+           					assert (pWmVols[c] != 0);
+           					pTris[(*t)]->setInnerTet(pWmVols[c]);
+							// Add triangle to WmVols' table of neighbouring triangles.
+							pWmVols[c]->setNextTri(pTris[(*t)]);
+           				}
+           			}
+           			else
+           			{
+           				// This should never happen, but ok throw an exception
+           				std::ostringstream os;
+           				os << "Well-mixed patches not supported in steps::solver::Tetexact solver";
+           				throw steps::ProgErr(os.str());
+           			}
+           		}
+           	}
+
+           	uint nipatches = wmcomp->_countIPatches();
+           	for (uint i = 0; i < nipatches; ++i)
+           	{
+           		steps::wm::Patch * ip = wmcomp->_getIPatch(i);
+				// Comp may not have an inner patch
+				if (ip != 0)
+				{
+					if (steps::tetmesh::TmPatch * comp_ipatch = dynamic_cast<steps::tetmesh::TmPatch*>(ip))
+					{
+						std::vector<uint> const & triindcs = comp_ipatch->_getAllTriIndices();
+						std::vector<uint>::const_iterator t_end = triindcs.end();
+						for (std::vector<uint>::const_iterator t = triindcs.begin();
+							t != t_end; ++t)
+						{
+							// Well-mixed volume should have been added above
+							assert (pWmVols[c] != 0);
+							pTris[(*t)]->setOuterTet(pWmVols[c]);
+							// Add triangle to WmVols' table of neighbouring triangles.
+							pWmVols[c]->setNextTri(pTris[(*t)]);
+						}
+					}
+					else
+					{
+						// This should never happen, but ok throw an exception
+						std::ostringstream os;
+						os << "Well-mixed patches not supported in steps::solver::Tetexact solver";
+						throw steps::ProgErr(os.str());
+					}
+				}
+           	}
+
+        }
+    }
+
+
+    // All tets and tris that belong to some comp or patch have been created
+    // locally- now we can connect them locally
+    // NOTE: currently if a tetrahedron's neighbour belongs to a different
+    // comp they do not talk to each other (see stex::Tet::setNextTet())
+    //
+
+    assert (ntets == pTets.size());
+    // pTets member size of all tets in geometry, but may not be filled with
+    // local tets if they have not been added to a compartment
+    /*
+	 std::vector<steps::tetexact::Tet *>::const_iterator t_end = pTets.end();
+	 for (std::vector<steps::tetexact::Tet *>::const_iterator t = pTets.begin();
+	 t < nlocaltets; ++t)
+	 */
+    for (uint t = 0; t < ntets; ++t)
+    {
+    	if (pTets[t] == 0) continue;
+    	int tet0 = pTets[t]->tet(0);
+    	int tet1 = pTets[t]->tet(1);
+    	int tet2 = pTets[t]->tet(2);
+    	int tet3 = pTets[t]->tet(3);
+    	// DEBUG 19/03/09 : again, incorrectly didn't allow for tet index == 0
+    	if (tet0 >= 0)
+    	{
+			if (pTets[tet0] != 0) pTets[t]->setNextTet(0, pTets[tet0]);
+    	}
+    	if (tet1 >= 0)
+    	{
+			if (pTets[tet1] != 0) pTets[t]->setNextTet(1, pTets[tet1]);
+    	}
+    	if (tet2 >= 0)
+    	{
+    		if (pTets[tet2] != 0) pTets[t]->setNextTet(2, pTets[tet2]);
+    	}
+    	if (tet3 >= 0)
+    	{
+    		if (pTets[tet3] != 0) pTets[t]->setNextTet(3, pTets[tet3]);
+    	}
+    	// Not setting Tet triangles at this point- only want to set
+    	// for surface triangles
+    }
+    assert (ntris == pTris.size());
+
+    for (uint t = 0; t < ntris; ++t)
+    {
+    	// Looping over all possible tris, but only some have been added to a patch
+    	if (pTris[t] == 0) continue;
+
+    	int tri0 = pTris[t]->tri(0);
+    	int tri1 = pTris[t]->tri(1);
+    	int tri2 = pTris[t]->tri(2);
+
+    	if (tri0 >= 0)
+    	{
+			if (pTris[tri0] != 0) pTris[t]->setNextTri(0, pTris[tri0]);
+    	}
+    	if (tri1 >= 0)
+    	{
+			if (pTris[tri1] != 0) pTris[t]->setNextTri(1, pTris[tri1]);
+    	}
+    	if (tri2 >= 0)
+    	{
+    		if (pTris[tri2] != 0) pTris[t]->setNextTri(2, pTris[tri2]);
+    	}
+
+    	// By convention, triangles in a patch should have an inner tetrahedron defined
+    	// (neighbouring tets 'flipped' if necessary in Tetmesh)
+    	// but not necessarily an outer tet
+    	// 17/3/10- actually this is not the case any more with well-mixed compartments
+    	//
+    	int tetinner = pTris[t]->tet(0);
+    	int tetouter = pTris[t]->tet(1);
+
+    	/* INNER MAY NOT EXIST FOR EFIELD VERSION NOW INNER TETS MAY BE WELL_MIXED COMPARTMENTS
+    	// DEBUG 18/03/09:
+    	// Now correct check, previously didn't allow for tet index == 0
+    	assert(tetinner >= 0);
+    	assert(pTets[tetinner] != 0 );
+		*/
+
+    	// Now inside and outside tetrahedrons may be normal tetrahedrons, which
+    	// means compartment is a mesh compartment, or wmvols describing a
+    	// well-mixed compartment with multiple triangle connections.
+
+
+    	if (tetinner >= 0)
+    	{
+    		// NEW FOR THIS VERSION: Tris store index of inner and outer tet (outer may not exist if on
+    		// surface) but tets may not belong to a compartment, even inner tets now
+    		// since they may be well-mixed compartments
+    		//
+    		if (pTets[tetinner] != 0)
+    		{
+    			// A triangle may already have an inner tet defined as a well-mixed
+    			// volume, but that should not be the case here:
+    			assert (pTris[t]->iTet() == 0);
+
+    			pTris[t]->setInnerTet(pTets[tetinner]);
+    			// Now add this triangle to inner tet's list of neighbours
+    			for (uint i=0; i <= 4; ++i)
+    			{
+    				// include assert for debugging purposes and remove
+    				// once this is tested
+    				assert (i < 4);														//////////
+    				// check if there is already a neighbouring tet or tri
+    				// In theory if there is a tri to add, the tet should
+    				// have less than 4 neighbouring tets added because
+    				// a neighbouring tet(s) is in a different compartment
+
+    				// THIS IS NOT THE CASE ANYMORE: tets in different compartments can be neighbours
+    				// so as to allow for diffusion boundaries
+
+    				// 	Also check tris because in some cases a surface tet
+    				// may have more than 1 neighbouring tri
+    				// NOTE: The order here will end up being different to the
+    				// neighbour order at the Tetmesh level
+
+    				// Now with diffusion boundaries, meaning tets can have neighbours that
+    				// are in different comps, we must check the compartment
+    				steps::tetexact::Tet * tet_in = pTets[tetinner];
+    				if (tet_in->nextTet(i) != 0 && tet_in->compdef() == tet_in->nextTet(i)->compdef()) continue;
+
+    				if (tet_in->nextTri(i) != 0) continue;
+    				tet_in->setNextTri(i, pTris[t]);
+    				break;
+    			}
+    		}
+    	}
+
+    	// DEBUG 18/03/09:
+    	// Now correct check, previously didn't allow for tet index == 0
+    	if (tetouter >= 0)
+    	{
+    		if (pTets[tetouter] != 0)
+    		{
+    			// A triangle may already have an inner tet defined as a well-mixed
+    			// volume, but that should not be the case here:
+    			assert (pTris[t]->oTet() == 0);
+
+    			pTris[t]->setOuterTet(pTets[tetouter]);
+    			// Add this triangle to outer tet's list of neighbours
+    			for (uint i=0; i <= 4; ++i)
+    			{
+    				assert (i < 4);
+
+    				// See above in that tets now store tets from different comps
+    				steps::tetexact::Tet * tet_out = pTets[tetouter];
+
+    				if (tet_out->nextTet(i) != 0 && tet_out->compdef() == tet_out->nextTet(i)->compdef()) continue;
+
+    				if (tet_out->nextTri(i) != 0) continue;
+    				tet_out->setNextTri(i, pTris[t]);
+    				break;
+				}
+    		}
+    	}
+    }
+
+    // Now loop over the diffusion boundaries:
+    // 1) get all the triangles and get the two tetrahedrons
+    // 2) figure out which direction is the direction for a tetrahedron
+    // 3) add the tetrahedron and the direction to local object
+
+    // This is here because we need all tets to have been assigned correctly
+    // to compartments. Check every one and set the compA and compB for the db
+    uint ndiffbnds = pDiffBoundaries.size();
+    assert(ndiffbnds ==	mesh()->_countDiffBoundaries());
+
+    for (uint db = 0; db < ndiffbnds; ++db)
+    {
+    	steps::tetexact::DiffBoundary * localdiffb = pDiffBoundaries[db];
+        std::vector<uint> dbtrisvec = localdiffb->def()->tris();
+
+        uint compAidx = localdiffb->def()->compa();
+        uint compBidx = localdiffb->def()->compb();
+        steps::solver::Compdef * compAdef = statedef()->compdef(compAidx);
+        steps::solver::Compdef * compBdef = statedef()->compdef(compBidx);
+
+        std::vector<uint>::const_iterator dbtris_end = dbtrisvec.end();
+        for (std::vector<uint>::const_iterator dbtris = dbtrisvec.begin(); dbtris != dbtris_end; ++dbtris)
+        {
+    		steps::tetmesh::Tri * tri = new steps::tetmesh::Tri(mesh(), (*dbtris));
+
+    		uint tetAidx = tri->getTet0Idx();
+    		uint tetBidx = tri->getTet1Idx();
+    		assert (tetAidx >= 0 and tetBidx >= 0);
+
+    		delete tri;
+
+    		steps::tetexact::Tet * tetA = _tet(tetAidx);
+    		steps::tetexact::Tet * tetB = _tet(tetBidx);
+    		assert(tetA != 0 and tetB != 0);
+
+    		steps::solver::Compdef * tetA_cdef = tetA->compdef();
+    		steps::solver::Compdef * tetB_cdef = tetB->compdef();
+    		assert (tetA_cdef != 0);
+    		assert (tetB_cdef != 0);
+
+    		if (tetA_cdef != compAdef)
+    		{
+    			assert (tetB_cdef == compAdef);
+    			assert (tetA_cdef == compBdef);
+    		}
+    		else
+    		{
+    			assert (tetB_cdef == compBdef);
+    			assert (tetA_cdef == compAdef);
+    		}
+
+    		// Ok, checks over, lets get down to business
+    		int direction_idx_a = -1;
+    		int direction_idx_b = -1;
+
+    		steps::tetmesh::Tet * tetA_mesh = new steps::tetmesh::Tet(mesh(), (tetAidx));
+    		steps::tetmesh::Tet * tetB_mesh = new steps::tetmesh::Tet(mesh(), (tetBidx));
+
+    		for (uint i = 0; i < 4; ++i)
+    		{
+    			if (tetA_mesh->getTriIdx(i) == (*dbtris))
+    			{
+    				assert(direction_idx_a == -1);
+    				direction_idx_a = i;
+    			}
+    			if (tetB_mesh->getTriIdx(i) == (*dbtris))
+    			{
+    				assert(direction_idx_b == -1);
+    				direction_idx_b = i;
+    			}
+    		}
+    		assert (direction_idx_a != -1);
+    		assert (direction_idx_b != -1);
+
+    		// Set the tetrahedron and direction to the Diff Boundary object
+    		localdiffb->setTetDirection(tetAidx, direction_idx_a);
+    		localdiffb->setTetDirection(tetBidx, direction_idx_b);
+
+    		delete tetA_mesh;
+    		delete tetB_mesh;
+        }
+
+        localdiffb->setComps(_comp(compAidx), _comp(compBidx));
+
+        // Before the kprocs are set up ( in _setup) the tetrahedrons need to know the diffusion
+        // boundary direction, so let's do it here  - the diff bounday has had all
+        // tetrahedrons added
+
+        // Might as well copy the vectors because we need to index through
+        std::vector<uint> tets = localdiffb->getTets();
+        std::vector<uint> tets_direction = localdiffb->getTetDirection();
+
+        ntets = tets.size();
+        assert (ntets <= pTets.size());
+        assert (tets_direction.size() == ntets);
+
+        for (uint t = 0; t < ntets; ++t)
+        {
+        	steps::tetexact::Tet * localtet = _tet(tets[t]);
+        	localtet->setDiffBndDirection(tets_direction[t]);
+        }
+
+    }
+
+
+	double t_elements = wallTime();
+	uint nelems = 0;
+	for (uint i = 0; i < pTets.size(); ++i)
+	{
+		if (pTets[i] != 0) ++nelems;
+	}
+	for (uint i = 0; i < pTris.size(); ++i)
+	{
+		if (pTris[i] != 0) ++nelems;
+	}
+	for (uint i = 0; i < pWmVols.size(); ++i)
+	{
+		if (pWmVols[i] != 0) ++nelems;
+	}
+	_setupPhase("elements", t_elements - t_start, nelems);
+
+	// The elements in layout order. Pointers in pTets and pTris are null
+	// for tets that are not in a compartment and triangles that are not
+	// in a patch.
+	std::vector<uint> tetlayout, trilayout;
+	for (uint t = 0; t < pTets.size(); ++t)
+	{
+		if (pTets[t] != 0) tetlayout.push_back(t);
+	}
+	for (uint t = 0; t < pTris.size(); ++t)
+	{
+		if (pTris[t] != 0) trilayout.push_back(t);
+	}
+	if (pReorder == true)
+	{
+		std::sort(tetlayout.begin(), tetlayout.end(), KeyLess(tetrank));
+		std::stable_sort(trilayout.begin(), trilayout.end(), KeyLess(trirank));
+	}
+
+	std::vector<uint>::const_iterator tet_end = tetlayout.end();
+	for (std::vector<uint>::const_iterator t = tetlayout.begin(); t != tet_end; ++t)
+	{
+		pTets[*t]->setupKProcs(this);
+	}
+
+	WmVolPVecCI wmv_end = pWmVols.end();
+	for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_end; ++wmv)
+	{
+		// Vector allows for all compartments to be well-mixed, so
+		// hold null-pointer for mesh compartments
+		if ((*wmv) == 0) continue;
+
+		(*wmv)->setupKProcs(this);
+	}
+
+	std::vector<uint>::const_iterator tri_end = trilayout.end();
+	for (std::vector<uint>::const_iterator t = trilayout.begin(); t != tri_end; ++t)
+	{
+		stex::Tri * tri = pTris[*t];
+		tri->setupKProcs(this, efflag());
+
+		if (efflag() == true)
+		{
+			ssolver::Patchdef * pdef = tri->patchdef();
+			uint nvdtrans = pdef->countVDepTrans();
+			for (uint i = 0; i < nvdtrans; ++i)
+			{
+				pVdepKProcs.push_back(tri->vdeptrans(i));
+			}
+			uint nvdsreacs = pdef->countVDepSReacs();
+			for (uint i = 0; i < nvdsreacs; ++i)
+			{
+				pVdepKProcs.push_back(tri->vdepsreac(i));
+			}
+			uint nghkcurrs = pdef->countGHKcurrs();
+			for (uint i = 0; i < nghkcurrs; ++i)
+			{
+				pVdepKProcs.push_back(tri->ghkcurr(i));
+			}
+		}
+	}
+
+	PatchPVecCI patch_end = pPatches.end();
+	for (PatchPVecCI p = pPatches.begin(); p != patch_end; ++p)
+	{
+		(*p)->setupSDiffTable();
+	}
+
+	// Order the kprocs by type, so that full sweeps run over contiguous
+	// ranges of one class each.
+	std::vector<KProc *> bytype;
+	bytype.reserve(pKProcs.size());
+	for (uint ty = 0; ty < KP_NTYPES; ++ty)
+	{
+		pKProcTypeBegin[ty] = bytype.size();
+		KProcPVecCI k_end = pKProcs.end();
+		for (KProcPVecCI k = pKProcs.begin(); k != k_end; ++k)
+		{
+			if ((*k)->type() == ty) bytype.push_back(*k);
+		}
+	}
+	pKProcTypeBegin[KP_NTYPES] = bytype.size();
+	assert(bytype.size() == pKProcs.size());
+	pKProcs.swap(bytype);
+	for (uint i = 0; i < pKProcs.size(); ++i) pKProcs[i]->setSchedIDX(i);
+
+	double t_kprocs = wallTime();
+	_setupPhase("kprocs", t_kprocs - t_elements, pKProcs.size());
+
+	// Index the dependencies on each species of each element, for the
+	// kprocs to collect theirs from (unless they are copied below).
+	std::vector<WmVol *> vols;
+	for (std::vector<uint>::const_iterator t = tetlayout.begin(); t != tet_end; ++t)
+	{
+		vols.push_back(pTets[*t]);
+	}
+	for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_end; ++wmv)
+	{
+		if ((*wmv) != 0) vols.push_back(*wmv);
+	}
+	std::vector<Tri *> tris;
+	for (std::vector<uint>::const_iterator t = trilayout.begin(); t != tri_end; ++t)
+	{
+		tris.push_back(pTris[*t]);
+	}
+	if ((src == 0 && structure == 0) || pLazyDeps == true)
+	{
+		SpecDepsLoop specdeps(vols, tris);
+		steps::parallelFor(specdeps, vols.size() + tris.size(), pSetupThreads);
+	}
+
+	_setupSpecKProcs(vols);
+
+	double t_index = wallTime();
+	_setupPhase("index", t_index - t_kprocs, vols.size() + tris.size());
+
+	// Resolve all dependencies, in the order of the elements. Thread 0
+	// packs its update lists into the solver's arena, the others into
+	// arenas of their own. A clone instead translates the update lists
+	// of its source, whose kprocs have the same schedule indices, and
+	// leaves those its source has not resolved yet pending too. A
+	// restart reads them from its file. With lazydeps nothing is
+	// resolved here. Identical lists packed into the same arena are
+	// stored once.
+	if (src != 0)
+	{
+		assert(src->pKProcs.size() == pKProcs.size());
+		KProc::copyDeps(src->pKProcs, pKProcs, pArena);
+	}
+	else if (structure != 0)
+	{
+		_restoreStructure(*structure);
+	}
+	else if (pLazyDeps == true)
+	{
+		for (uint i = 0; i < pKProcs.size(); ++i)
+		{
+			pKProcs[i]->setDepsResolved(false);
+		}
+	}
+	else
+	{
+		std::vector<KProc *> kprocs;
+		for (std::vector<WmVol *>::const_iterator v = vols.begin(); v != vols.end(); ++v)
+		{
+			kprocs.insert(kprocs.end(), (*v)->kprocBegin(), (*v)->kprocEnd());
+		}
+		for (std::vector<Tri *>::const_iterator t = tris.begin(); t != tris.end(); ++t)
+		{
+			kprocs.insert(kprocs.end(), (*t)->kprocBegin(), (*t)->kprocEnd());
+		}
+		std::vector<Arena *> arenas(1, &pArena);
+		for (uint t = 1; t < pSetupThreads && t < kprocs.size(); ++t)
+		{
+			if (pSetupArenas.size() < t) pSetupArenas.push_back(new Arena());
+			arenas.push_back(pSetupArenas[t - 1]);
+		}
+		DepsLoop deps(kprocs, arenas);
+		steps::parallelFor(deps, kprocs.size(), arenas.size());
+	}
+	pArena.clearShared();
+	for (uint i = 0; i < pSetupArenas.size(); ++i)
+	{
+		pSetupArenas[i]->clearShared();
+	}
+
+	// The index is still needed for the lists left pending.
+	if (pLazyDeps == false)
+	{
+		for (std::vector<WmVol *>::const_iterator v = vols.begin(); v != vols.end(); ++v)
+		{
+			(*v)->clearSpecDeps();
+		}
+		for (std::vector<Tri *>::const_iterator t = tris.begin(); t != tris.end(); ++t)
+		{
+			(*t)->clearSpecDeps();
+		}
+	}
+
+	double t_deps = wallTime();
+	uint nupd = 0;
+	for (uint i = 0; i < pKProcs.size(); ++i)
+	{
+		uint nlists = pKProcs[i]->countUpdLists();
+		for (uint l = 0; l < nlists; ++l) nupd += pKProcs[i]->updList(l).size();
+	}
+	_setupPhase("deps", t_deps - t_index, nupd);
+
+	// Create EField structures if EField is to be calculated
+	if (efflag() == true)
+	{
+		// A restart has the EField ordering after the update lists.
+		std::string opt_data;
+		if (structure != 0) readBlock(*structure, opt_data);
+		_setupEField(opt_data);
+		_setupVDepBatches();
+		_setupGHKTables();
+	}
+
+	double t_efield = wallTime();
+	if (efflag() == true)
+	{
+		std::map<std::string, double> const & eftimes = pEField->getSetupTimes();
+		char const * efphases[] = {"mesh", "couple", "order", "matrix"};
+		for (uint i = 0; i < 4; ++i)
+		{
+			std::map<std::string, double>::const_iterator t = eftimes.find(efphases[i]);
+			assert(t != eftimes.end());
+			_setupPhase(std::string("efield.") + efphases[i], t->second, nefverts());
+		}
+		_setupPhase("efield", t_efield - t_deps, nefverts());
+	}
+
+	nEntries = pKProcs.size();
+	pScheduler->init(nEntries);
+
+	double t_end = wallTime();
+	_setupPhase("sched", t_end - t_efield, nEntries);
+	_setupPhase("total", t_end - t_start, nelems);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_setupPhase(std::string const & phase, double seconds, uint count)
+{
+	pSetupPhases.push_back(phase);
+	pSetupTime[phase] = seconds;
+	pSetupCount[phase] = count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<std::string> stex::Tetexact::getSetupPhases(void) const
+{
+	return pSetupPhases;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getSetupTime(std::string const & phase) const
+{
+	std::map<std::string, double>::const_iterator t = pSetupTime.find(phase);
+	if (t == pSetupTime.end())
+	{
+		std::ostringstream os;
+		os << "Unknown setup phase '" << phase << "' (see getSetupPhases()).";
+		throw steps::ArgErr(os.str());
+	}
+	return t->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getSetupCount(std::string const & phase) const
+{
+	std::map<std::string, uint>::const_iterator c = pSetupCount.find(phase);
+	if (c == pSetupCount.end())
+	{
+		std::ostringstream os;
+		os << "Unknown setup phase '" << phase << "' (see getSetupPhases()).";
+		throw steps::ArgErr(os.str());
+	}
+	return c->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::Tetexact::getTetLoads(void) const
+{
+	std::vector<double> loads(pTets.size(), 0.0);
+	uint ntets = pTets.size();
+	for (uint t = 0; t < ntets; ++t)
+	{
+		if (pTets[t] == 0) continue;
+		loads[t] = pTets[t]->countKProcs() + pTets[t]->compdef()->countSpecs();
+	}
+
+	// A triangle's processes go to its first tet in the solver.
+	TriPVecCI tri_end = pTris.end();
+	for (TriPVecCI tri = pTris.begin(); tri != tri_end; ++tri)
+	{
+		if ((*tri) == 0) continue;
+		for (uint j = 0; j < 2; ++j)
+		{
+			int t = (*tri)->tet(j);
+			if (t < 0 || pTets[t] == 0) continue;
+			loads[t] += (*tri)->countKProcs();
+			break;
+		}
+	}
+	return loads;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// A process of the network, as the pruning analysis sees it: the kproc
+/// at position pos of the elements of location loc (compartments first,
+/// then patches), or none for diffusion across a boundary, which can
+/// happen once all its reactants are reachable and then makes its
+/// products reachable. Species are given as loc * nspecs + gidx.
+///
+struct PruneRule
+{
+	uint                                loc;
+	uint                                pos;
+	std::string                         name;
+	std::vector<uint>                   lhs;
+	std::vector<uint>                   rhs;
+	bool                                live;
+};
+
+/// Fill the species of a reaction or surface reaction on one side into
+/// the lists of a rule, given its lhs and rhs by global species index.
+///
+template <class Def, class Fn>
+static void pruneTerms(Def * def, Fn lhs, Fn rhs, uint loc, uint nspecs,
+                       PruneRule & rule)
+{
+	for (uint g = 0; g < nspecs; ++g)
+	{
+		if ((def->*lhs)(g) != 0) rule.lhs.push_back(loc * nspecs + g);
+		if ((def->*rhs)(g) != 0) rule.rhs.push_back(loc * nspecs + g);
+	}
+}
+
+/// All the tets, well-mixed volumes and triangles of a solver.
+///
+static void allElements(std::vector<stex::WmVol *> const & wmvols,
+                        std::vector<stex::Tet *> const & tets,
+                        std::vector<stex::Tri *> const & tris,
+                        std::vector<stex::WmVol *> & vols,
+                        std::vector<stex::Tri *> & alltris)
+{
+	for (uint i = 0; i < wmvols.size(); ++i)
+	{
+		if (wmvols[i] != 0) vols.push_back(wmvols[i]);
+	}
+	for (uint i = 0; i < tets.size(); ++i)
+	{
+		if (tets[i] != 0) vols.push_back(tets[i]);
+	}
+	for (uint i = 0; i < tris.size(); ++i)
+	{
+		if (tris[i] != 0) alltris.push_back(tris[i]);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setNetworkPruning(bool prune)
+{
+	_dropPruning();
+	if (prune == false) return;
+
+	ssolver::Statedef * sd = statedef();
+	uint nspecs = sd->countSpecs();
+	uint ncomps = sd->countComps();
+	uint nlocs = ncomps + sd->countPatches();
+	static const uint NONE = 0xFFFFFFFF;
+
+	// The processes of each compartment and patch, in the order of the
+	// kprocs of their elements.
+	std::vector<PruneRule> rules;
+	for (uint c = 0; c < ncomps; ++c)
+	{
+		ssolver::Compdef * cdef = sd->compdef(c);
+		for (uint l = 0; l < cdef->countReacs(); ++l)
+		{
+			ssolver::Reacdef * rdef = cdef->reacdef(l);
+			PruneRule rule = { c, l, rdef->name() };
+			pruneTerms(rdef, &ssolver::Reacdef::lhs, &ssolver::Reacdef::rhs,
+			           c, nspecs, rule);
+			rules.push_back(rule);
+		}
+		for (uint l = 0; l < cdef->countDiffs(); ++l)
+		{
+			PruneRule rule = { c, cdef->countReacs() + l, "" };
+			rule.lhs.push_back(c * nspecs + cdef->diffdef(l)->lig());
+			rules.push_back(rule);
+		}
+	}
+	for (uint p = 0; p < sd->countPatches(); ++p)
+	{
+		ssolver::Patchdef * pdef = sd->patchdef(p);
+		uint loc = ncomps + p;
+		uint iloc = pdef->icompdef()->gidx();
+		uint oloc = (pdef->ocompdef() != 0) ? pdef->ocompdef()->gidx() : NONE;
+		uint pos = 0;
+		for (uint l = 0; l < pdef->countSReacs(); ++l, ++pos)
+		{
+			ssolver::SReacdef * srdef = pdef->sreacdef(l);
+			PruneRule rule = { loc, pos, srdef->name() };
+			pruneTerms(srdef, &ssolver::SReacdef::lhs_S, &ssolver::SReacdef::rhs_S,
+			           loc, nspecs, rule);
+			pruneTerms(srdef, &ssolver::SReacdef::lhs_I, &ssolver::SReacdef::rhs_I,
+			           iloc, nspecs, rule);
+			if (oloc != NONE)
+			{
+				pruneTerms(srdef, &ssolver::SReacdef::lhs_O, &ssolver::SReacdef::rhs_O,
+				           oloc, nspecs, rule);
+			}
+			rules.push_back(rule);
+		}
+		for (uint l = 0; l < pdef->countSurfDiffs(); ++l, ++pos)
+		{
+			PruneRule rule = { loc, pos, "" };
+			rule.lhs.push_back(loc * nspecs + pdef->surfdiffdef(l)->lig());
+			rules.push_back(rule);
+		}
+		if (efflag() == false) continue;
+		for (uint l = 0; l < pdef->countVDepTrans(); ++l, ++pos)
+		{
+			ssolver::VDepTransdef * vdtdef = pdef->vdeptransdef(l);
+			PruneRule rule = { loc, pos, vdtdef->name() };
+			rule.lhs.push_back(loc * nspecs + vdtdef->srcchanstate());
+			rule.rhs.push_back(loc * nspecs + vdtdef->dstchanstate());
+			rules.push_back(rule);
+		}
+		for (uint l = 0; l < pdef->countVDepSReacs(); ++l, ++pos)
+		{
+			ssolver::VDepSReacdef * vsrdef = pdef->vdepsreacdef(l);
+			PruneRule rule = { loc, pos, vsrdef->name() };
+			pruneTerms(vsrdef, &ssolver::VDepSReacdef::lhs_S, &ssolver::VDepSReacdef::rhs_S,
+			           loc, nspecs, rule);
+			pruneTerms(vsrdef, &ssolver::VDepSReacdef::lhs_I, &ssolver::VDepSReacdef::rhs_I,
+			           iloc, nspecs, rule);
+			if (oloc != NONE)
+			{
+				pruneTerms(vsrdef, &ssolver::VDepSReacdef::lhs_O, &ssolver::VDepSReacdef::rhs_O,
+				           oloc, nspecs, rule);
+			}
+			rules.push_back(rule);
+		}
+		// A current carries its ion both ways, and with a virtual outer
+		// concentration into the inner compartment from nothing.
+		for (uint l = 0; l < pdef->countGHKcurrs(); ++l, ++pos)
+		{
+			ssolver::GHKcurrdef * ghkdef = pdef->ghkcurrdef(l);
+			PruneRule rule = { loc, pos, ghkdef->name() };
+			rule.lhs.push_back(loc * nspecs + ghkdef->chanstate());
+			if (ghkdef->realflux() == true)
+			{
+				uint ion = ghkdef->ion();
+				if (pdef->icompdef()->specG2L(ion) != ssolver::LIDX_UNDEFINED)
+				{
+					rule.rhs.push_back(iloc * nspecs + ion);
+				}
+				if (oloc != NONE && pdef->ocompdef()->specG2L(ion) != ssolver::LIDX_UNDEFINED)
+				{
+					rule.rhs.push_back(oloc * nspecs + ion);
+				}
+			}
+			rules.push_back(rule);
+		}
+	}
+
+	// Diffusion boundaries pass every species both compartments have.
+	for (uint d = 0; d < sd->countDiffBoundaries(); ++d)
+	{
+		ssolver::DiffBoundarydef * dbdef = sd->diffboundarydef(d);
+		uint a = dbdef->compa();
+		uint b = dbdef->compb();
+		for (uint g = 0; g < nspecs; ++g)
+		{
+			if (sd->compdef(a)->specG2L(g) == ssolver::LIDX_UNDEFINED) continue;
+			if (sd->compdef(b)->specG2L(g) == ssolver::LIDX_UNDEFINED) continue;
+			PruneRule ab = { a, NONE, "" };
+			ab.lhs.push_back(a * nspecs + g);
+			ab.rhs.push_back(b * nspecs + g);
+			rules.push_back(ab);
+			PruneRule ba = { b, NONE, "" };
+			ba.lhs.push_back(b * nspecs + g);
+			ba.rhs.push_back(a * nspecs + g);
+			rules.push_back(ba);
+		}
+	}
+
+	// The species with molecules now, then what the processes that can
+	// fire add to them, until nothing changes.
+	std::vector<char> reach(nlocs * nspecs, 0);
+	std::vector<stex::WmVol *> vols;
+	std::vector<stex::Tri *> tris;
+	allElements(pWmVols, pTets, pTris, vols, tris);
+	for (uint i = 0; i < vols.size(); ++i)
+	{
+		ssolver::Compdef * cdef = vols[i]->compdef();
+		for (uint l = 0; l < cdef->countSpecs(); ++l)
+		{
+			if (vols[i]->count(l) == 0) continue;
+			reach[cdef->gidx() * nspecs + cdef->specL2G(l)] = 1;
+		}
+	}
+	for (uint i = 0; i < tris.size(); ++i)
+	{
+		ssolver::Patchdef * pdef = tris[i]->patchdef();
+		for (uint l = 0; l < pdef->countSpecs(); ++l)
+		{
+			if (tris[i]->count(l) == 0) continue;
+			reach[(ncomps + pdef->gidx()) * nspecs + pdef->specL2G(l)] = 1;
+		}
+	}
+	uint nrules = rules.size();
+	bool grown = true;
+	while (grown == true)
+	{
+		grown = false;
+		for (uint r = 0; r < nrules; ++r)
+		{
+			PruneRule & rule = rules[r];
+			if (rule.live == true) continue;
+			uint nlhs = rule.lhs.size();
+			uint i = 0;
+			while (i < nlhs && reach[rule.lhs[i]] != 0) ++i;
+			if (i < nlhs) continue;
+			rule.live = true;
+			grown = true;
+			for (uint j = 0; j < rule.rhs.size(); ++j) reach[rule.rhs[j]] = 1;
+		}
+	}
+
+	// The report, and the kprocs at each position of the elements that
+	// can never fire.
+	pPruneDead.assign(nlocs, std::vector<char>(nspecs, 0));
+	pPrunedSpecs.assign(nlocs, std::vector<std::string>());
+	pPrunedReacs.assign(nlocs, std::vector<std::string>());
+	std::vector<std::vector<char> > dead(nlocs);
+	for (uint loc = 0; loc < nlocs; ++loc)
+	{
+		for (uint g = 0; g < nspecs; ++g)
+		{
+			bool defined = (loc < ncomps)
+				? sd->compdef(loc)->specG2L(g) != ssolver::LIDX_UNDEFINED
+				: sd->patchdef(loc - ncomps)->specG2L(g) != ssolver::LIDX_UNDEFINED;
+			if (defined == false || reach[loc * nspecs + g] != 0) continue;
+			pPruneDead[loc][g] = 1;
+			pPrunedSpecs[loc].push_back(sd->specdef(g)->name());
+		}
+	}
+	for (uint r = 0; r < nrules; ++r)
+	{
+		PruneRule const & rule = rules[r];
+		if (rule.pos == NONE) continue;
+		std::vector<char> & d = dead[rule.loc];
+		if (d.size() <= rule.pos) d.resize(rule.pos + 1, 0);
+		if (rule.live == true) continue;
+		d[rule.pos] = 1;
+		if (rule.name != "") pPrunedReacs[rule.loc].push_back(rule.name);
+	}
+
+	pNPruned = 0;
+	for (uint i = 0; i < vols.size(); ++i)
+	{
+		std::vector<char> const & d = dead[vols[i]->compdef()->gidx()];
+		KProcPVecCI k = vols[i]->kprocBegin();
+		for (uint pos = 0; pos < vols[i]->countKProcs(); ++pos)
+		{
+			if (d[pos] == 0) continue;
+			k[pos]->setPruned(true);
+			++pNPruned;
+		}
+	}
+	for (uint i = 0; i < tris.size(); ++i)
+	{
+		std::vector<char> const & d = dead[ncomps + tris[i]->patchdef()->gidx()];
+		KProcPVecCI k = tris[i]->kprocBegin();
+		for (uint pos = 0; pos < tris[i]->countKProcs(); ++pos)
+		{
+			if (d[pos] == 0) continue;
+			k[pos]->setPruned(true);
+			++pNPruned;
+		}
+	}
+
+	pPruning = true;
+	if (pNPruned != 0) _clampsChanged(vols, tris);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getNetworkPruning(void) const
+{
+	return pPruning;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getNPrunedKProcs(void) const
+{
+	return pNPruned;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<std::string> stex::Tetexact::getPrunedSpecs(std::string const & loc) const
+{
+	uint l = _pruneLoc(loc);
+	if (pPruning == false) return std::vector<std::string>();
+	return pPrunedSpecs[l];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<std::string> stex::Tetexact::getPrunedReacs(std::string const & loc) const
+{
+	uint l = _pruneLoc(loc);
+	if (pPruning == false) return std::vector<std::string>();
+	return pPrunedReacs[l];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// The names of the kproc types, as getProfileStat takes them.
+///
+static char const * const kprocTypeNames[stex::KP_NTYPES] =
+{
+	"Reac", "Diff", "SReac", "SDiff", "VDepTrans", "VDepSReac", "GHKcurr"
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setProfiling(bool on)
+{
+	pProfiling = on;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getProfiling(void) const
+{
+	return pProfiling;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Set [tbegin, tend) to the kproc types ktype stands for: one of
+/// kprocTypeNames, or all of them for "all".
+///
+static void kprocTypeRange(std::string const & ktype, uint & tbegin, uint & tend)
+{
+	tbegin = 0;
+	tend = stex::KP_NTYPES;
+	if (ktype == "all") return;
+	while (tbegin < stex::KP_NTYPES && ktype != kprocTypeNames[tbegin]) ++tbegin;
+	if (tbegin == stex::KP_NTYPES)
+	{
+		std::ostringstream os;
+		os << "Unknown kproc type '" << ktype << "' (expected 'Reac', ";
+		os << "'Diff', 'SReac', 'SDiff', 'VDepTrans', 'VDepSReac', ";
+		os << "'GHKcurr' or 'all').";
+		throw steps::ArgErr(os.str());
+	}
+	tend = tbegin + 1;
+}
+
+/// The element of a kproc that is not in a tet or triangle, for the
+/// element events.
+///
+static const uint ELEM_EVENTS_NONE = 0xFFFFFFFF;
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getProfileStat(std::string const & ktype,
+                                      std::string const & stat) const
+{
+	uint tbegin = 0;
+	uint tend = 0;
+	kprocTypeRange(ktype, tbegin, tend);
+
+	if (stat == "getnext")
+	{
+		if (ktype != "all")
+		{
+			std::ostringstream os;
+			os << "Profile statistic 'getnext' is only available for 'all'.";
+			throw steps::ArgErr(os.str());
+		}
+		return pProfGetNext;
+	}
+
+	double const * tally = 0;
+	if (stat == "events") tally = pProfEvents;
+	else if (stat == "updates") tally = pProfUpdates;
+	else if (stat == "apply") tally = pProfApply;
+	else if (stat == "update") tally = pProfUpdate;
+	else
+	{
+		std::ostringstream os;
+		os << "Unknown profile statistic '" << stat << "' (expected ";
+		os << "'events', 'updates', 'apply', 'update' or 'getnext').";
+		throw steps::ArgErr(os.str());
+	}
+
+	double sum = 0.0;
+	for (uint t = tbegin; t < tend; ++t) sum += tally[t];
+	return sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::resetProfile(void)
+{
+	std::fill_n(pProfEvents, static_cast<uint>(KP_NTYPES), 0.0);
+	std::fill_n(pProfUpdates, static_cast<uint>(KP_NTYPES), 0.0);
+	std::fill_n(pProfApply, static_cast<uint>(KP_NTYPES), 0.0);
+	std::fill_n(pProfUpdate, static_cast<uint>(KP_NTYPES), 0.0);
+	pProfGetNext = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setElementEvents(bool on)
+{
+	if (on == pElemEventsOn) return;
+	pElemEventsOn = on;
+	if (on == false)
+	{
+		std::vector<uint>().swap(pElemEventElem);
+		std::vector<double>().swap(pElemEvents);
+		return;
+	}
+
+	uint ntets = pTets.size();
+	pElemEventElem.assign(pKProcs.size(), ELEM_EVENTS_NONE);
+	for (uint t = 0; t < ntets; ++t)
+	{
+		if (pTets[t] == 0) continue;
+		KProcPVecCI k_end = pTets[t]->kprocEnd();
+		for (KProcPVecCI k = pTets[t]->kprocBegin(); k != k_end; ++k)
+		{
+			pElemEventElem[(*k)->schedIDX()] = t;
+		}
+	}
+	for (uint t = 0; t < pTris.size(); ++t)
+	{
+		if (pTris[t] == 0) continue;
+		KProcPVecCI k_end = pTris[t]->kprocEnd();
+		for (KProcPVecCI k = pTris[t]->kprocBegin(); k != k_end; ++k)
+		{
+			pElemEventElem[(*k)->schedIDX()] = ntets + t;
+		}
+	}
+	pElemEvents.assign((ntets + pTris.size()) * KP_NTYPES, 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getElementEvents(void) const
+{
+	return pElemEventsOn;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::Tetexact::getTetEvents(std::string const & ktype) const
+{
+	return _elementEvents(ktype, 0, pTets.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::Tetexact::getTriEvents(std::string const & ktype) const
+{
+	return _elementEvents(ktype, pTets.size(), pTris.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::Tetexact::_elementEvents(std::string const & ktype,
+                                                   uint first, uint n) const
+{
+	uint tbegin = 0;
+	uint tend = 0;
+	kprocTypeRange(ktype, tbegin, tend);
+	if (pElemEventsOn == false)
+	{
+		std::ostringstream os;
+		os << "Element events are not being counted (see setElementEvents).";
+		throw steps::ArgErr(os.str());
+	}
+
+	std::vector<double> events(n, 0.0);
+	for (uint e = 0; e < n; ++e)
+	{
+		double const * counts = &pElemEvents[(first + e) * KP_NTYPES];
+		for (uint ty = tbegin; ty < tend; ++ty) events[e] += counts[ty];
+	}
+	return events;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::resetElementEvents(void)
+{
+	std::fill(pElemEvents.begin(), pElemEvents.end(), 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::startEventTrace(std::string const & file_name, double resolution)
+{
+	if (resolution <= 0.0)
+	{
+		std::ostringstream os;
+		os << "Event trace resolution must be positive.";
+		throw steps::ArgErr(os.str());
+	}
+	stopEventTrace();
+	pEventTrace = new EventTrace(file_name, statedef()->time(), resolution,
+	                             _eventTraceHeader());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::stopEventTrace(void)
+{
+	if (pEventTrace == 0) return;
+	EventTrace * tr = pEventTrace;
+	pEventTrace = 0;
+	try
+	{
+		tr->close();
+	}
+	catch (...)
+	{
+		delete tr;
+		throw;
+	}
+	delete tr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getEventTrace(void) const
+{
+	return pEventTrace != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getEventTraceCount(void) const
+{
+	if (pEventTrace == 0) return 0.0;
+	return static_cast<double>(pEventTrace->count());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setSnapshotStream(std::string const & file_name,
+                                       uint nx, uint ny, uint nz,
+                                       std::vector<std::string> const & specs,
+                                       double fps)
+{
+	if (nx == 0 || ny == 0 || nz == 0)
+	{
+		std::ostringstream os;
+		os << "Snapshot grid must have at least one voxel along each axis.";
+		throw steps::ArgErr(os.str());
+	}
+	if (fps <= 0.0)
+	{
+		std::ostringstream os;
+		os << "Snapshot frame rate must be positive.";
+		throw steps::ArgErr(os.str());
+	}
+	if (specs.empty() == true)
+	{
+		std::ostringstream os;
+		os << "Snapshot stream needs at least one species.";
+		throw steps::ArgErr(os.str());
+	}
+	std::vector<uint> cols;
+	for (uint s = 0; s < specs.size(); ++s)
+	{
+		cols.push_back(statedef()->getSpecIdx(specs[s]));
+	}
+	clearSnapshotStream();
+
+	// The voxel of each element is the one holding its barycentre, the
+	// elements on the upper faces of the box going to the last voxel.
+	std::vector<double> lo = pMesh->getBoundMin();
+	std::vector<double> hi = pMesh->getBoundMax();
+	uint dims[3] = { nx, ny, nz };
+	std::vector<double> size(3, 0.0);
+	for (uint d = 0; d < 3; ++d) size[d] = (hi[d] - lo[d]) / dims[d];
+
+	uint ntets = pTets.size();
+	std::vector<uint> voxels(ntets + pTris.size(), SNAPSHOT_VOXEL_NONE);
+	for (uint e = 0; e < voxels.size(); ++e)
+	{
+		std::vector<double> c;
+		if (e < ntets)
+		{
+			if (pTets[e] == 0) continue;
+			c = pMesh->getTetBarycenter(e);
+		}
+		else
+		{
+			if (pTris[e - ntets] == 0) continue;
+			c = pMesh->getTriBarycenter(e - ntets);
+		}
+		uint v[3] = { 0, 0, 0 };
+		for (uint d = 0; d < 3; ++d)
+		{
+			if (size[d] <= 0.0) continue;
+			double x = std::floor((c[d] - lo[d]) / size[d]);
+			if (x > 0.0) v[d] = std::min(static_cast<uint>(x), dims[d] - 1);
+		}
+		voxels[e] = v[0] + nx * (v[1] + ny * v[2]);
+	}
+
+	uint nspecs = statedef()->countSpecs();
+	pSnapVoxels.swap(voxels);
+	pSnapCounts.assign(nx * ny * nz * nspecs, 0.0);
+	_linkROIs(true);
+	try
+	{
+		pSnapshot = new SnapshotStream(file_name, nx, ny, nz, lo, size, specs,
+		                               cols, &pSnapCounts[0], nspecs,
+		                               statedef(), fps);
+	}
+	catch (...)
+	{
+		std::vector<uint>().swap(pSnapVoxels);
+		_linkROIs(pROIElems.empty() == false);
+		std::vector<double>().swap(pSnapCounts);
+		throw;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::clearSnapshotStream(void)
+{
+	if (pSnapshot == 0) return;
+	delete pSnapshot;
+	pSnapshot = 0;
+	std::vector<uint>().swap(pSnapVoxels);
+	_linkROIs(pROIElems.empty() == false);
+	std::vector<double>().swap(pSnapCounts);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::publishSnapshot(void)
+{
+	if (pSnapshot == 0)
+	{
+		std::ostringstream os;
+		os << "No snapshot stream is open.";
+		throw steps::ArgErr(os.str());
+	}
+	pSnapshot->publish();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getSnapshotFrames(void) const
+{
+	if (pSnapshot == 0) return 0.0;
+	return static_cast<double>(pSnapshot->frames());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string stex::Tetexact::_eventTraceHeader(void) const
+{
+	ssolver::Statedef * sd = statedef();
+	uint ntets = pTets.size();
+	uint ntris = pTris.size();
+	std::string h;
+	EventTrace::putVarint(h, ntets);
+	EventTrace::putVarint(h, ntris);
+
+	// The names of the processes of each kproc type, by global index.
+	std::vector<std::vector<std::string> > names(KP_NTYPES);
+	for (uint i = 0; i < sd->countReacs(); ++i) names[KP_REAC].push_back(sd->reacdef(i)->name());
+	for (uint i = 0; i < sd->countDiffs(); ++i) names[KP_DIFF].push_back(sd->diffdef(i)->name());
+	for (uint i = 0; i < sd->countSReacs(); ++i) names[KP_SREAC].push_back(sd->sreacdef(i)->name());
+	for (uint i = 0; i < sd->countSurfDiffs(); ++i) names[KP_SDIFF].push_back(sd->surfdiffdef(i)->name());
+	for (uint i = 0; i < sd->countVDepTrans(); ++i) names[KP_VDEPTRANS].push_back(sd->vdeptransdef(i)->name());
+	for (uint i = 0; i < sd->countVDepSReacs(); ++i) names[KP_VDEPSREAC].push_back(sd->vdepsreacdef(i)->name());
+	for (uint i = 0; i < sd->countGHKcurrs(); ++i) names[KP_GHKCURR].push_back(sd->ghkcurrdef(i)->name());
+	for (uint ty = 0; ty < KP_NTYPES; ++ty)
+	{
+		EventTrace::putVarint(h, names[ty].size());
+		for (uint i = 0; i < names[ty].size(); ++i)
+		{
+			EventTrace::putVarint(h, names[ty][i].size());
+			h += names[ty][i];
+		}
+	}
+
+	// The element and process of each kproc. The kprocs of a volume are
+	// its reactions and then its diffusions, those of a triangle its
+	// surface reactions, surface diffusions, voltage-dependent
+	// transitions and reactions and GHK currents, each in local order.
+	uint nkprocs = pKProcs.size();
+	std::vector<uint> elem(nkprocs, 0);
+	std::vector<uint> proc(nkprocs, 0);
+	for (uint c = 0; c < pWmVols.size() + ntets; ++c)
+	{
+		WmVol * v = (c < ntets ? pTets[c] : pWmVols[c - ntets]);
+		if (v == 0) continue;
+		ssolver::Compdef * cdef = v->compdef();
+		uint nreacs = cdef->countReacs();
+		uint p = 0;
+		KProcPVecCI k_end = v->kprocEnd();
+		for (KProcPVecCI k = v->kprocBegin(); k != k_end; ++k, ++p)
+		{
+			uint s = (*k)->schedIDX();
+			elem[s] = (c < ntets ? c : ntris + c);
+			if (p < nreacs) proc[s] = cdef->reacdef(p)->gidx();
+			else proc[s] = cdef->diffdef(p - nreacs)->gidx();
+		}
+	}
+	for (uint t = 0; t < ntris; ++t)
+	{
+		Tri * tri = pTris[t];
+		if (tri == 0) continue;
+		ssolver::Patchdef * pdef = tri->patchdef();
+		uint first[KP_NTYPES];
+		std::fill_n(first, static_cast<uint>(KP_NTYPES), 0);
+		uint p = 0;
+		uint prev = KP_NTYPES;
+		KProcPVecCI k_end = tri->kprocEnd();
+		for (KProcPVecCI k = tri->kprocBegin(); k != k_end; ++k, ++p)
+		{
+			uint s = (*k)->schedIDX();
+			uint ty = (*k)->type();
+			if (ty != prev) first[ty] = p;
+			prev = ty;
+			uint l = p - first[ty];
+			elem[s] = ntets + t;
+			switch (ty)
+			{
+				case KP_SREAC: proc[s] = pdef->sreacdef(l)->gidx(); break;
+				case KP_SDIFF: proc[s] = pdef->surfdiffdef(l)->gidx(); break;
+				case KP_VDEPTRANS: proc[s] = pdef->vdeptransdef(l)->gidx(); break;
+				case KP_VDEPSREAC: proc[s] = pdef->vdepsreacdef(l)->gidx(); break;
+				case KP_GHKCURR: proc[s] = pdef->ghkcurrdef(l)->gidx(); break;
+				default: assert(false);
+			}
+		}
+	}
+
+	EventTrace::putVarint(h, nkprocs);
+	for (uint s = 0; s < nkprocs; ++s)
+	{
+		h += static_cast<char>(pKProcs[s]->type());
+		EventTrace::putVarint(h, elem[s]);
+		EventTrace::putVarint(h, proc[s]);
+	}
+	return h;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_setupEField(std::string const & opt_data)
+{
+
+	//// Note to self: for now roughly following flow from original code in sim/controller.py.
+	//// code for setting up a mesh was in func_tetmesh constructor and called functions.
+
+	assert(efflag() == true);
+
+	// Give temperature a default value of 20c
+	pTemp = 293.15;
+
+	uint nmembs = mesh()->_countMembs();
+
+	if  (nmembs != 1)
+	{
+		std::ostringstream os;
+		os << "Membrane potential solver currently supports only one ";
+		os << "membrane description object.";
+		throw steps::ArgErr(os.str());
+	}
+
+	steps::tetmesh::Memb * memb = mesh()->_getMemb(0);
+	assert(memb != 0);
+
+	// TODO: Decide what checks are needed for the membrane and implement them here
+
+	pEFNTets = memb->countVolTets();
+	pEFNTris = memb->countTris();
+	pEFNVerts = memb->countVerts();
+
+    pEFTets = new uint[neftets() * 4];
+    assert(pEFTets != 0);
+
+    // All the triangles we will count here are the real membrane triangles,
+    // virtual triangles will not require a capacitance.
+    pEFTris = new uint[neftris() * 3];
+    assert(pEFTris != 0);
+
+    pEFVerts = new double[nefverts() * 3];
+    assert(pEFVerts != 0);
+
+    uint nverts = mesh()->countVertices();
+    uint ntris = mesh()->countTris();
+    uint ntets= mesh()->countTets();
+
+    pEFVert_GtoL = new int[nverts];
+    for (uint i=0; i < nverts; ++i) pEFVert_GtoL[i] = -1;
+    pEFTri_GtoL = new int[ntris];
+    for (uint i=0; i< ntris; ++i) pEFTri_GtoL[i] = -1;
+    pEFTet_GtoL = new int[ntets];
+    for (uint i=0; i < ntets; ++i) pEFTet_GtoL[i] = -1;
+
+    pEFTri_LtoG = new uint[neftris()];
+
+    // Copy the data to local structures.
+
+    std::vector<uint> membverts = memb->_getAllVertIndices();
+    assert(membverts.size() == nefverts());
+    for (uint efv = 0; efv < nefverts(); ++efv)
+    {
+    	uint vertidx = membverts[efv];
+    	double* verttemp = mesh()->_getVertex(vertidx);
+    	uint efv2 = efv*3;
+
+    	// CONVERTING TO MICRONS HERE. EFIELD OBJECT WILL NOT PERFORM THIS CONVERSION
+    	pEFVerts[efv2] = verttemp[0] * 1.0e6;
+    	pEFVerts[efv2+1] = verttemp[1] * 1.0e6;
+    	pEFVerts[efv2+2] = verttemp[2] * 1.0e6;
+
+    	pEFVert_GtoL[vertidx] = efv;
+    }
+
+    std::vector<uint> membtets = memb->_getAllVolTetIndices();
+    assert(membtets.size() == neftets());
+    for (uint eft=0; eft < neftets(); ++eft)
+    {
+    	uint tetidx = membtets[eft];
+    	uint* tettemp = mesh()->_getTet(tetidx);
+    	uint eft2 = eft*4;
+
+    	// Convert to indices used by EField object
+    	int tv0 =  pEFVert_GtoL[tettemp[0]];
+    	int tv1 = pEFVert_GtoL[tettemp[1]];
+    	int tv2 = pEFVert_GtoL[tettemp[2]];
+    	int tv3 = pEFVert_GtoL[tettemp[3]];
+    	if  (tv0 ==-1 || tv1 == -1 || tv2 == -1 || tv3 == -1)
+    	{
+    		std::ostringstream os;
+    		os << "Failed to create EField structures.";
+    		throw steps::ProgErr(os.str());
+    	}
+
+    	pEFTets[eft2] = tv0;
+    	pEFTets[eft2+1] = tv1;
+    	pEFTets[eft2+2] = tv2;
+    	pEFTets[eft2+3] = tv3;
+
+    	pEFTet_GtoL[tetidx] = eft;
+    }
+
+    std::vector<uint> membtris = memb->_getAllTriIndices();
+    assert(membtris.size() == neftris());
+
+    pEFTris_vec.resize(neftris());
+    pEFTriV.resize(neftris());
+    pEFTriI.resize(neftris());
+
+    for (uint eft = 0; eft < neftris(); ++eft)
+    {
+    	uint triidx = membtris[eft];
+    	uint* tritemp = mesh()->_getTri(triidx);
+    	uint eft2 = eft*3;
+
+    	// Convert to indices used by EField object
+    	int tv0 =  pEFVert_GtoL[tritemp[0]];
+    	int tv1 = pEFVert_GtoL[tritemp[1]];
+    	int tv2 = pEFVert_GtoL[tritemp[2]];
+    	if  (tv0 ==-1 || tv1 == -1 || tv2 == -1)
+    	{
+    		std::ostringstream os;
+    		os << "Failed to create EField structures.";
+    		throw steps::ProgErr(os.str());
+    	}
+
+    	pEFTris[eft2] = tv0;
+    	pEFTris[eft2+1] = tv1;
+    	pEFTris[eft2+2] = tv2;
+
+    	pEFTri_GtoL[triidx] = eft;
+    	pEFTri_LtoG[eft] = triidx;
+
+    	// This is added now for quicker iteration during run()
+    	// Extremely important for larger meshes, orders of magnitude times faster
+    	pEFTris_vec[eft] = pTris[triidx];
+    }
+
+    pEField = new steps::solver::efield::EField(nefverts(), pEFVerts, neftris(), pEFTris, neftets(), pEFTets, memb->_getOpt_method(), memb->_getOpt_file_name(), pEFBackend, opt_data);
+    pEField->setTheta(pEFTheta);
+    pEField->setThreads(pEFThreads);
+    pEField->setMixedPrecision(pEFMixed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::saveMembOpt(std::string const & opt_file_name)
+{
+	if  (efflag() != true)
+	{
+		std::ostringstream os;
+		os << "saveMembOpt method only available if running EField ";
+		throw steps::ArgErr(os.str());
+	}
+
+	pEField->saveOptimal(opt_file_name);
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::_addComp(steps::solver::Compdef * cdef)
+{
+    stex::Comp * comp = new Comp(cdef);
+    assert(comp != 0);
+    uint compidx = pComps.size();
+    pComps.push_back(comp);
+    pCompMap[cdef] = comp;
+    return compidx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::_addPatch(steps::solver::Patchdef * pdef)
+{
+    /* Comp * icomp = 0;
+	 Comp * ocomp = 0;
+	 if (pdef->icompdef()) icomp = pCompMap[pdef->icompdef()];
+	 if (pdef->ocompdef()) ocomp = pCompMap[pdef->ocompdef()];
+	 */
+    stex::Patch * patch = new Patch(pdef);
+    assert(patch != 0);
+    uint patchidx = pPatches.size();
+    pPatches.push_back(patch);
+    return patchidx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::_addDiffBoundary(steps::solver::DiffBoundarydef * dbdef)
+{
+	stex::DiffBoundary * diffb = new DiffBoundary(dbdef);
+	assert(diffb != 0);
+	uint dbidx = pDiffBoundaries.size();
+	pDiffBoundaries.push_back(diffb);
+	return dbidx;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_addTet(uint tetidx,
+							 steps::tetexact::Comp * comp, double vol,
+							 double a1, double a2, double a3, double a4,
+							 double d1, double d2, double d3, double d4,
+							 int tet0, int tet1, int tet2, int tet3)
+{
+	steps::solver::Compdef * compdef  = comp->def();
+    stex::Tet * localtet = new (pArena.alloc(sizeof(stex::Tet))) stex::Tet(tetidx, compdef, vol, a1, a2, a3, a4, d1, d2, d3, d4,
+									     tet0, tet1, tet2, tet3);
+    assert(localtet != 0);
+    assert(tetidx < pTets.size());
+    assert(pTets[tetidx] == 0);
+    pTets[tetidx] = localtet;
+    comp->addTet(localtet);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_addWmVol(uint cidx, steps::tetexact::Comp * comp, double vol)
+{
+	steps::solver::Compdef * compdef  = comp->def();
+	stex::WmVol * localtet = new (pArena.alloc(sizeof(stex::WmVol))) stex::WmVol(cidx, compdef, vol);
+	assert(localtet != 0);
+	assert(cidx < pWmVols.size());
+	pWmVols[cidx] = localtet;
+	comp->addTet(localtet);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_addTri(uint triidx, steps::tetexact::Patch * patch, double area,
+							 double l0, double l1, double l2, double d0, double d1, double d2,  int tinner, int touter, int tri0, int tri1, int tri2)
+{
+    steps::solver::Patchdef * patchdef = patch->def();
+    stex::Tri * tri = new (pArena.alloc(sizeof(stex::Tri))) stex::Tri(triidx, patchdef, area, l0, l1, l2, d0, d1, d2,  tinner, touter, tri0, tri1, tri2);
+    assert(tri != 0);
+    assert (triidx < pTris.size());
+    assert (pTris[triidx] == 0);
+    pTris[triidx] = tri;
+    patch->addTri(tri);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::reset(void)
+{
+	// An update left in flight by a failed run() is of no use now.
+	_joinEfield();
+
+	std::for_each(pComps.begin(), pComps.end(), std::mem_fun(&Comp::reset));
+	std::for_each(pPatches.begin(), pPatches.end(), std::mem_fun(&Patch::reset));
+
+    TetPVecCI tet_end = pTets.end();
+    for (TetPVecCI tet = pTets.begin(); tet != tet_end; ++tet)
+    {
+    	if (*tet == 0) continue;
+    	(*tet)->reset();
+    }
+
+    WmVolPVecCI wmvol_end = pWmVols.end();
+    for (WmVolPVecCI wmvol = pWmVols.begin(); wmvol != wmvol_end; ++wmvol)
+    {
+    	if ((*wmvol) == 0) continue;
+    	(*wmvol)->reset();
+    }
+
+	TriPVecCI tri_end = pTris.end();
+	for (TriPVecCI t = pTris.begin(); t != tri_end; ++t)
+	{
+		if ((*t) == 0) continue;
+		(*t)->reset();
+	}
+
+	// Compact again the pools that were widened.
+	if (pCompactPools == true) setCompactPools(true);
+	if (pCountTotals == true) _sumCountTotals();
+	if (_hasROIs() == true) _sumROICounts();
+	if (pCountViews == true) _syncCountViews();
+
+    // The scheduler keeps its group storage across resets; refill it
+    // with the propensities of the reset state in a single pass.
+    pScheduler->init(nEntries);
+
+	statedef()->resetTime();
+	statedef()->resetNSteps();
+
+	// The pools are reset without marking them modified.
+	pDeltaBaseSet = false;
+
+	_dropPruning();
+	_allClampsChanged();
+	_update();
+
+	// The timeline starts again from the beginning.
+	pTimeline.clear();
+	for (uint i = 0; i < pInterventions.size(); ++i)
+	{
+		pInterventions[i].applied = 0;
+		_queueIntervention(i);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::run(double endtime)
+{
+	STEPS_TRACE("Tetexact::run");
+	if (pEventTrace != 0 && (pClusters != 0 || pDomains != 0 || pTauLeap == true
+		|| pDiffBatchThreshold > 0 || pCGSize > 0.0))
+	{
+		std::ostringstream os;
+		os << "Event traces are only written by the exact SSA (no clusters, ";
+		os << "domains, tau-leaping, batched diffusion or coarse graining).";
+		throw steps::ArgErr(os.str());
+	}
+	if (efflag() == false && endtime < statedef()->time())
+	{
+		std::ostringstream os;
+		os << "Endtime is before current simulation time";
+		throw steps::ArgErr(os.str());
+	}
+	_armTriggers();
+	if (pTimeline.empty() == true)
+	{
+		_runTo(endtime);
+		return;
+	}
+
+	// The run is split at the interventions; a trigger set off by one
+	// stops it there.
+	bool trig = (pTriggers.empty() == false);
+	_applyInterventions(statedef()->time());
+	if (trig == true && _checkTriggers() == true) return;
+	while (pTimeline.empty() == false && pTimeline.begin()->first < endtime)
+	{
+		double t = pTimeline.begin()->first;
+		_runTo(t);
+		if (pTriggered >= 0) return;
+		_applyInterventions(t);
+		if (trig == true && _checkTriggers() == true) return;
+	}
+	_runTo(endtime);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_runTo(double endtime)
+{
+	bool trig = (pTriggers.empty() == false);
+	if (efflag() == false)
+	{
+		if (pClusters != 0)
+		{
+			_runClusters(endtime);
+		}
+		else if (pDomains != 0)
+		{
+			_runDomains(endtime);
+		}
+		else if (pTauLeap == true)
+		{
+			_dropPending();
+			_runTauLeap(endtime);
+		}
+		else if (pDiffBatchThreshold > 0)
+		{
+			_dropPending();
+			_runDiffBatched(endtime);
+		}
+		else if (pCGSize > 0.0)
+		{
+			_dropPending();
+			_runCoarseGrained(endtime);
+		}
+		else
+		{
+			while (statedef()->time() < endtime)
+			{
+				double dt = 0.0;
+				uint kidx = _nextEvent(dt);
+				if (kidx == sssa::SCHED_IDX_UNDEFINED) break;
+				if ((statedef()->time() + dt) > endtime)
+				{
+					// Keep the event for the next call rather than drawing
+					// it again: with the state unchanged it is still a
+					// correctly distributed next event.
+					pPendingKProc = kidx;
+					pPendingTime = statedef()->time() + dt;
+					break;
+				}
+				_executeStep(pKProcs[kidx], dt);
+				if (trig == true && _checkTriggers() == true) break;
+			}
+		}
+		// A trigger stops the run at the time of its event.
+		if (pTriggered < 0) statedef()->setTime(endtime);
+	}
+	else if (efflag() == true)
+	{
+		// Run the simulation, including the EField calculation.
+		// This loop will assume that the SSA dt is sufficiently small so
+		// that a number of SSA events execute between every EField calculation.
+		// A warning message will be printed if the SSA dt is larger than the EField dt.
+		// The EField dt is actually a MAXIMUM dt- the actual time for the EField
+		// calculation will be exact with respect to the last event time in the
+		// SSA before reaching the EField dt.
+		_dropPending();
+		while (statedef()->time() < endtime)
+		{
+			// We need a bool to check if the SSA contains no possible events. In
+			// this rare case (continue to) execute the EField calculation to the endtime.
+			double ssa_dt = 0.0;
+			uint kidx = _getNext(ssa_dt);
+			bool ssa_on = (kidx != sssa::SCHED_IDX_UNDEFINED);
+			// Set the actual efield dt. This value will take a maximum pEFDT.
+			double ef_dt = 0.0;
+
+			while (ssa_on && (ef_dt + ssa_dt) < pEFDT )
+			{
+				// A rejected candidate only moves time on.
+				KProc * kp = _vdepLumpPick(pKProcs[kidx]);
+				if (_vdepReject(kp) == true) statedef()->incTime(ssa_dt);
+				else _executeStep(kp, ssa_dt);
+				ef_dt += ssa_dt;
+				// The EField is still brought up to the trigger event.
+				if (trig == true && _checkTriggers() == true) break;
+
+				kidx = _getNext(ssa_dt);
+				ssa_on = (kidx != sssa::SCHED_IDX_UNDEFINED);
+			}
+			assert(ef_dt < pEFDT);
+
+			// It's possible that ef_dt is zero here: ssa_dt is large, or has become large.
+			// In that case print a warning but continue, running the EField simulation for EFDT
+			if (ssa_on == false || ef_dt == 0.0)
+			{
+	    		std::ostringstream os;
+	    		//os << "\nWARNING: SSA tau is larger than EField dt.";
+	    		//std::cout << os << std::endl;
+			}
+
+			if (ef_dt == 0.0)
+			{
+				// This means that tau is larger than EField dt. We have no choice but to
+				// increase the state time by pEFDT.
+				ef_dt = pEFDT;
+				statedef()->incTime(pEFDT);
+			}
+
+			// Now to perform the EField calculation. This means finding ohmic and GHK
+			// currents from triangles during the ef_dt and applying these to the EField
+			// object.
+
+			/*
+			 * Older method is much, much slower for larger meshes. e.g. for ~200,000
+			 * tets this method is 2 or 3 orders of magnitude slower than pEFTris_vec method
+			 *
+			for (uint ltidx = 0; ltidx < neftris(); ++ltidx)
+			{
+				uint gtidx = pEFTri_LtoG[ltidx];
+
+				Tri * tritemp = tris()[gtidx];
+				// We can use local indices for faster EField method
+				double v = pEField->getTriV(ltidx);
+				// The triangle will compute all GHK and Ohmic currents
+				double cur = tritemp->computeI(v, ef_dt, statedef()->time());
+				pEField->setTriI(ltidx, cur);
+			}
+			*/
+
+			// With the pipeline, the update started after the last step
+			// is taken up now, before the currents of this one.
+			if (pEFPipeline == true) _finishEfield();
+
+			// The potentials and currents of all triangles are exchanged
+			// with the EField object in one call each.
+			double t0 = wallTime();
+			uint neft = pEFTris_vec.size();
+			double sttime = statedef()->time();
+			if (neft != 0) pEField->getTriVs(&pEFTriV[0]);
+			{
+				STEPS_TRACE("Tetexact::membraneCurrents");
+				TriCurrLoop currs(pEFTris_vec, pEFTriV, pEFTriI, ef_dt, sttime);
+				steps::parallelFor(currs, neft, pEFThreads);
+				if (neft != 0) pEField->setTriIs(&pEFTriI[0]);
+			}
+			double t1 = wallTime();
+
+			if (pEFPipeline == true)
+			{
+				// The next step's SSA runs while this one's update does.
+				_startEfield(ef_dt);
+				pEFTimeCurr += t1 - t0;
+				if (pTriggered >= 0) break;
+				continue;
+			}
+
+			pEField->advance(ef_dt);
+			double dv = pEField->getMaxDV();
+			pEFStatMaxDV = std::max(pEFStatMaxDV, dv);
+			if (pEFAdaptDV > 0.0) _adaptEfieldDT(ef_dt, dv);
+			// Only the voltage-dependent propensities change with the potential.
+			double t2 = wallTime();
+			_updateVDep();
+			pEFTimeCurr += t1 - t0;
+			pEFTimeUpdate += wallTime() - t2;
+			if (pTriggered >= 0) break;
+		}
+		// The potentials are those of the end time when run() returns.
+		_finishEfield();
+	}
+
+	else assert(false);
+
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::advance(double adv)
+{
+	if (adv < 0.0)
+	{
+		std::ostringstream os;
+		os << "Time to advance cannot be negative";
+	    throw steps::ArgErr(os.str());
+	}
+
+	double endtime = statedef()->time() + adv;
+	run(endtime);
+}
+
+////////////////////////////////////////////////////////////////////////
+/*
+void stex::Tetexact::advanceSteps(uint nsteps)
+{
+	while (nsteps != 0) {
+        stex::KProc * kp = _getNext();
+        if (kp == 0) return;
+        double a0 = getA0();
+        if (a0 == 0.0) return;
+        double dt = rng()->getExp(a0);
+        _executeStep(kp, dt);
+        nsteps--;
+    }
+}
+*/
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::step(void)
+{
+	if (efflag() == true)
+	{
+		std::ostringstream os;
+		os << "Method not available with EField calculation.";
+		throw steps::ArgErr(os.str());
+	}
+
+	double dt = 0.0;
+	_armTriggers();
+	bool trig = (pTriggers.empty() == false);
+	uint kidx = _nextEvent(dt);
+
+	// The interventions due before the event come first, and the event
+	// is drawn again after each.
+	while (pTimeline.empty() == false)
+	{
+		double t = pTimeline.begin()->first;
+		if (kidx != sssa::SCHED_IDX_UNDEFINED && t > statedef()->time() + dt) break;
+		_applyInterventions(t);
+		if (trig == true && _checkTriggers() == true) return;
+		kidx = _nextEvent(dt);
+	}
+	if (kidx == sssa::SCHED_IDX_UNDEFINED) return;
+	_executeStep(pKProcs[kidx], dt);
+	if (trig == true) _checkTriggers();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getTime(void) const
+{
+	return statedef()->time();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getNSteps(void) const
+{
+    return statedef()->nsteps();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setTime(double time)
+{
+	_dropPending();
+	statedef()->setTime(time);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setNSteps(uint nsteps)
+{
+    statedef()->setNSteps(nsteps);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+std::string stex::Tetexact::getScheduler(void) const
+{
+	std::string name = _baseScheduler()->getName();
+	if (name == "nrm" && getElementScheduler() == true) return "nsm";
+	return name;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setWmVolScheduler(bool split)
+{
+	if (split == getWmVolScheduler()) return;
+
+	_unwrapScheduler();
+	if (split == true)
+	{
+		std::vector<char> sub(nEntries, 0);
+		WmVolPVecCI wmv_e = pWmVols.end();
+		for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
+		{
+			if ((*wmv) == 0) continue;
+			KProcPVecCI k_e = (*wmv)->kprocEnd();
+			for (KProcPVecCI k = (*wmv)->kprocBegin(); k != k_e; ++k)
+			{
+				sub[(*k)->schedIDX()] = 1;
+			}
+		}
+		sssa::SplitScheduler * ss = new sssa::SplitScheduler(rng(),
+				pScheduler, new sssa::DirectScheduler(rng()));
+		ss->setSplit(sub);
+		pScheduler = ss;
+	}
+
+	pScheduler->init(nEntries);
+	_update();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getWmVolScheduler(void) const
+{
+	return (dynamic_cast<sssa::SplitScheduler *>(pScheduler) != 0);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setElementScheduler(bool group)
+{
+	if (group == getElementScheduler()) return;
+
+	_unwrapScheduler();
+	if (group == true)
+	{
+		// One group per tet, tri and well-mixed volume; kprocs that
+		// belong to none get a group of their own.
+		std::vector<uint> groups(nEntries, sssa::SCHED_IDX_UNDEFINED);
+		uint ngroups = 0;
+		TetPVecCI tet_e = pTets.end();
+		for (TetPVecCI t = pTets.begin(); t != tet_e; ++t)
+		{
+			if ((*t) == 0) continue;
+			KProcPVecCI k_e = (*t)->kprocEnd();
+			for (KProcPVecCI k = (*t)->kprocBegin(); k != k_e; ++k)
+			{
+				groups[(*k)->schedIDX()] = ngroups;
+			}
+			++ngroups;
+		}
+		TriPVecCI tri_e = pTris.end();
+		for (TriPVecCI t = pTris.begin(); t != tri_e; ++t)
+		{
+			if ((*t) == 0) continue;
+			KProcPVecCI k_e = (*t)->kprocEnd();
+			for (KProcPVecCI k = (*t)->kprocBegin(); k != k_e; ++k)
+			{
+				groups[(*k)->schedIDX()] = ngroups;
+			}
+			++ngroups;
+		}
+		WmVolPVecCI wmv_e = pWmVols.end();
+		for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_e; ++wmv)
+		{
+			if ((*wmv) == 0) continue;
+			KProcPVecCI k_e = (*wmv)->kprocEnd();
+			for (KProcPVecCI k = (*wmv)->kprocBegin(); k != k_e; ++k)
+			{
+				groups[(*k)->schedIDX()] = ngroups;
+			}
+			++ngroups;
+		}
+		for (uint i = 0; i < nEntries; ++i)
+		{
+			if (groups[i] == sssa::SCHED_IDX_UNDEFINED) groups[i] = ngroups++;
+		}
+
+		sssa::GroupScheduler * gs = new sssa::GroupScheduler(rng(), pScheduler);
+		gs->setGroups(groups);
+		pScheduler = gs;
+	}
+
+	pScheduler->init(nEntries);
+	_update();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getElementScheduler(void) const
+{
+	return (dynamic_cast<sssa::GroupScheduler *>(pScheduler) != 0);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+sssa::Scheduler * stex::Tetexact::_baseScheduler(void) const
+{
+	if (sssa::SplitScheduler * ss = dynamic_cast<sssa::SplitScheduler *>(pScheduler))
+	{
+		return ss->main();
+	}
+	if (sssa::GroupScheduler * gs = dynamic_cast<sssa::GroupScheduler *>(pScheduler))
+	{
+		return gs->main();
+	}
+	return pScheduler;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_unwrapScheduler(void)
+{
+	if (sssa::SplitScheduler * ss = dynamic_cast<sssa::SplitScheduler *>(pScheduler))
+	{
+		pScheduler = ss->releaseMain();
+		delete ss;
+	}
+	else if (sssa::GroupScheduler * gs = dynamic_cast<sssa::GroupScheduler *>(pScheduler))
+	{
+		pScheduler = gs->releaseMain();
+		delete gs;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+sssa::CRScheduler * stex::Tetexact::_crScheduler(void) const
+{
+	sssa::CRScheduler * cr = dynamic_cast<sssa::CRScheduler *>(_baseScheduler());
+	if (cr == 0)
+	{
+		std::ostringstream os;
+		os << "Method only available with the 'cr' scheduler (solver uses '";
+		os << pScheduler->getName() << "').";
+		throw steps::ArgErr(os.str());
+	}
+	return cr;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_tetLayout(std::vector<uint> & rank)
+{
+	uint ntets = mesh()->countTets();
+	rank.resize(ntets);
+	if (pReorder == false)
+	{
+		for (uint t = 0; t < ntets; ++t) rank[t] = t;
+		return;
+	}
+
+	// Cuthill-McKee: a breadth-first walk over the tet adjacency that
+	// takes the neighbours of each tet in order of increasing degree,
+	// started in each connected part of the mesh from a tet of lowest
+	// degree. The layout is the reverse of the walk.
+	std::vector<uint> degree(ntets, 0);
+	std::vector<uint> bydegree(ntets);
+	for (uint t = 0; t < ntets; ++t)
+	{
+		int * nb = mesh()->_getTetTetNeighb(t);
+		for (uint i = 0; i < 4; ++i)
+		{
+			if (nb[i] >= 0) ++degree[t];
+		}
+		bydegree[t] = t;
+	}
+	std::stable_sort(bydegree.begin(), bydegree.end(), KeyLess(degree));
+
+	std::vector<uint> order;
+	order.reserve(ntets);
+	std::vector<bool> visited(ntets, false);
+	std::vector<uint> next;
+	for (uint s = 0; s < ntets; ++s)
+	{
+		uint start = bydegree[s];
+		if (visited[start] == true) continue;
+		visited[start] = true;
+		uint head = order.size();
+		order.push_back(start);
+		while (head < order.size())
+		{
+			int * nb = mesh()->_getTetTetNeighb(order[head++]);
+			next.clear();
+			for (uint i = 0; i < 4; ++i)
+			{
+				if (nb[i] < 0 || visited[nb[i]] == true) continue;
+				visited[nb[i]] = true;
+				next.push_back(nb[i]);
+			}
+			std::stable_sort(next.begin(), next.end(), KeyLess(degree));
+			order.insert(order.end(), next.begin(), next.end());
+		}
+	}
+	assert(order.size() == ntets);
+	for (uint i = 0; i < ntets; ++i) rank[order[ntets - 1 - i]] = i;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setA0ResyncInterval(uint n)
+{
+	_crScheduler()->setA0ResyncInterval(n);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getA0ResyncInterval(void) const
+{
+	return _crScheduler()->getA0ResyncInterval();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setGroupTreeSearch(bool tree)
+{
+	_crScheduler()->setGroupTreeSearch(tree);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getGroupTreeSearch(void) const
+{
+	return _crScheduler()->getGroupTreeSearch();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setDomains(bool on, double window)
+{
+	delete pDomains;
+	pDomains = 0;
+	if (on == true)
+	{
+		if (pClusters != 0)
+		{
+			std::ostringstream os;
+			os << "Domains are not available with clusters.";
+			throw steps::ArgErr(os.str());
+		}
+		_resolveAllDeps();
+		pDomains = new Domains(this, window);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getDomains(void) const
+{
+	return pDomains != 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getDomainRank(void) const
+{
+	return (pDomains != 0) ? pDomains->getRank() : 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getNDomains(void) const
+{
+	return (pDomains != 0) ? pDomains->getNRanks() : 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stex::Tetexact::getDomainTets(void) const
+{
+	return (pDomains != 0) ? pDomains->getTets() : std::vector<uint>();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+std::vector<uint> stex::Tetexact::getDomainHalo(void) const
+{
+	return (pDomains != 0) ? pDomains->getHalo() : std::vector<uint>();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getDomainMessages(void) const
+{
+	return (pDomains != 0) ? pDomains->getNMessages() : 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_runDomains(double endtime)
+{
+	if (pTauLeap == true || pDiffBatchThreshold > 0 || pTriggers.empty() == false)
+	{
+		std::ostringstream os;
+		os << "Domains are not available with tau-leaping, batched ";
+		os << "diffusion or triggers.";
+		throw steps::NotImplErr(os.str());
+	}
+	_dropPending();
+
+	// The running totals and the regions of interest are summed again
+	// once every rank holds the whole state.
+	bool totals = pCountTotals;
+	if (totals == true)
+	{
+		std::for_each(pComps.begin(), pComps.end(),
+		              std::bind2nd(std::mem_fun(&Comp::setCountTotals), false));
+		std::for_each(pPatches.begin(), pPatches.end(),
+		              std::bind2nd(std::mem_fun(&Patch::setCountTotals), false));
+	}
+
+	bool rois = (pROIElems.empty() == false);
+	if (rois == true) _linkROIs(false);
+
+	double nevents = pDomains->run(endtime);
+
+	if (totals == true)
+	{
+		std::for_each(pComps.begin(), pComps.end(),
+		              std::bind2nd(std::mem_fun(&Comp::setCountTotals), true));
+		std::for_each(pPatches.begin(), pPatches.end(),
+		              std::bind2nd(std::mem_fun(&Patch::setCountTotals), true));
+	}
+	if (rois == true) _linkROIs(true);
+	statedef()->setTime(endtime);
+	statedef()->incNSteps(static_cast<uint>(nevents));
+
+	_update();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getCRStat(std::string const & stat) const
+{
+	sssa::CRScheduler * cr = _crScheduler();
+	if (stat == "events") return cr->getNSelections();
+	if (stat == "trials") return cr->getNTrials();
+	if (stat == "meantrials")
+	{
+		double nsel = cr->getNSelections();
+		return (nsel > 0.0) ? cr->getNTrials() / nsel : 0.0;
+	}
+	if (stat == "extends") return cr->getNGroupExtends();
+	if (stat == "groups" || stat == "nonempty")
+	{
+		std::vector<int> pows;
+		std::vector<uint> sizes;
+		std::vector<double> sums;
+		cr->getGroupData(pows, sizes, sums);
+		if (stat == "groups") return sizes.size();
+		uint nonempty = 0;
+		for (uint i = 0; i < sizes.size(); ++i)
+		{
+			if (sizes[i] != 0) ++nonempty;
+		}
+		return nonempty;
+	}
+
+	std::ostringstream os;
+	os << "Unknown CR scheduler statistic '" << stat << "' (expected ";
+	os << "'events', 'trials', 'meantrials', 'extends', 'groups' or ";
+	os << "'nonempty').";
+	throw steps::ArgErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::resetCRStats(void)
+{
+	_crScheduler()->resetStats();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+std::vector<double> stex::Tetexact::getCRGroupData(std::string const & field) const
+{
+	sssa::CRScheduler * cr = _crScheduler();
+	if (field != "pow" && field != "size" && field != "sum" && field != "fill")
+	{
+		std::ostringstream os;
+		os << "Unknown CR group field '" << field << "' (expected 'pow', ";
+		os << "'size', 'sum' or 'fill').";
+		throw steps::ArgErr(os.str());
+	}
+
+	std::vector<int> pows;
+	std::vector<uint> sizes;
+	std::vector<double> sums;
+	cr->getGroupData(pows, sizes, sums);
+
+	uint ngroups = pows.size();
+	std::vector<double> data(ngroups, 0.0);
+	for (uint i = 0; i < ngroups; ++i)
+	{
+		if (field == "pow") data[i] = pows[i];
+		else if (field == "size") data[i] = sizes[i];
+		else if (field == "sum") data[i] = sums[i];
+		else if (sizes[i] != 0)
+		{
+			// The group bound is 2^pow.
+			data[i] = sums[i] / (sizes[i] * ldexp(1.0, pows[i]));
+		}
+	}
+	return data;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+static std::size_t vecBytes(std::vector<T> const & v)
+{
+	return v.capacity() * sizeof(T);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+static std::size_t kprocSize(stex::KProcType type)
+{
+	switch (type)
+	{
+		case stex::KP_REAC: return sizeof(stex::Reac);
+		case stex::KP_DIFF: return sizeof(stex::Diff);
+		case stex::KP_SREAC: return sizeof(stex::SReac);
+		case stex::KP_SDIFF: return sizeof(stex::SDiff);
+		case stex::KP_VDEPTRANS: return sizeof(stex::VDepTrans);
+		case stex::KP_VDEPSREAC: return sizeof(stex::VDepSReac);
+		case stex::KP_GHKCURR: return sizeof(stex::GHKcurr);
+		default: return sizeof(stex::KProc);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getMemoryUsage(std::string const & part) const
+{
+	bool all = (part == "total");
+	if (all == false && part != "elements" && part != "kprocs"
+		&& part != "scheduler" && part != "efield" && part != "mesh"
+		&& part != "statedef" && part != "arena")
+	{
+		std::ostringstream os;
+		os << "Unknown memory part '" << part << "' (expected 'elements', ";
+		os << "'kprocs', 'scheduler', 'efield', 'mesh', 'statedef', ";
+		os << "'arena' or 'total').";
+		throw steps::ArgErr(os.str());
+	}
+
+	std::size_t bytes = 0;
+	if (all || part == "elements")
+	{
+		for (uint i = 0; i < pTets.size(); ++i)
+		{
+			if (pTets[i] != 0) bytes += pTets[i]->getMemoryUsage();
+		}
+		for (uint i = 0; i < pTris.size(); ++i)
+		{
+			if (pTris[i] != 0) bytes += pTris[i]->getMemoryUsage();
+		}
+		for (uint i = 0; i < pWmVols.size(); ++i)
+		{
+			if (pWmVols[i] != 0) bytes += pWmVols[i]->getMemoryUsage();
+		}
+		for (uint i = 0; i < pComps.size(); ++i)
+		{
+			bytes += pComps[i]->getMemoryUsage();
+		}
+		for (uint i = 0; i < pPatches.size(); ++i)
+		{
+			bytes += pPatches[i]->getMemoryUsage();
+		}
+		for (uint i = 0; i < pDiffBoundaries.size(); ++i)
+		{
+			bytes += pDiffBoundaries[i]->getMemoryUsage();
+		}
+		bytes += vecBytes(pTets) + vecBytes(pTris) + vecBytes(pWmVols);
+		bytes += vecBytes(pComps) + vecBytes(pPatches) + vecBytes(pDiffBoundaries);
+		bytes += vecBytes(pTetCountView) + vecBytes(pTriCountView);
+		bytes += vecBytes(pROIElems) + vecBytes(pROICounts) + vecBytes(pROILinks);
+		bytes += vecBytes(pSnapVoxels) + vecBytes(pSnapCounts);
+		bytes += vecBytes(pCGGroup) + vecBytes(pCGGroupStart) + vecBytes(pCGGroupTets);
+		bytes += vecBytes(pCGNeighbStart) + vecBytes(pCGNeighbs) + vecBytes(pCGNMerged);
+		bytes += pCGMerged.capacity() / 8 + pCGSpecs.capacity() / 8;
+		for (uint r = 0; r < pROIElems.size(); ++r)
+		{
+			bytes += vecBytes(pROIElems[r]);
+		}
+	}
+	if (all || part == "kprocs")
+	{
+		std::set<uint const *> counted;
+		for (uint i = 0; i < pKProcs.size(); ++i)
+		{
+			KProc * kp = pKProcs[i];
+			bytes += Arena::footprint(kprocSize(kp->type()));
+			bytes += kp->getUpdListMemoryUsage(counted);
+		}
+		bytes += vecBytes(pKProcs);
+		bytes += vecBytes(pLeapVol) + vecBytes(pLeapLidx) + vecBytes(pLeapHOR);
+		bytes += vecBytes(pLeapHORn) + vecBytes(pLeapAble);
+		bytes += vecBytes(pLeapLhsStart) + vecBytes(pLeapLhsSpec) + vecBytes(pLeapLhsN);
+		bytes += vecBytes(pLeapUpdStart) + vecBytes(pLeapUpdSpec) + vecBytes(pLeapUpdN);
+		bytes += vecBytes(pLeapUpdVar) + vecBytes(pLeapUpdExact);
+		bytes += vecBytes(pLeapRate) + vecBytes(pLeapCrit) + vecBytes(pLeapK);
+		bytes += vecBytes(pLeapMu) + vecBytes(pLeapSigma) + vecBytes(pLeapReactant);
+		bytes += vecBytes(pLeapDelta);
+		bytes += vecBytes(pElemEventElem) + vecBytes(pElemEvents);
+		bytes += vecBytes(pFluxFirst) + vecBytes(pFluxEntries) + vecBytes(pFluxCounts);
+	}
+	if (all || part == "scheduler")
+	{
+		bytes += pScheduler->getMemoryUsage();
+	}
+	if ((all || part == "efield") && efflag() == true)
+	{
+		bytes += pEField->getMemoryUsage();
+		bytes += pEFNTets * 4 * sizeof(uint) + pEFNTris * 3 * sizeof(uint);
+		bytes += pEFNVerts * 3 * sizeof(double);
+		// The global to local tables and the local to global triangles.
+		bytes += (mesh()->countVertices() + mesh()->countTris()
+				  + mesh()->countTets()) * sizeof(int);
+		bytes += pEFNTris * sizeof(uint);
+		bytes += vecBytes(pEFTris_vec) + vecBytes(pEFTriV) + vecBytes(pEFTriI);
+		bytes += vecBytes(pVdepKProcs) + vecBytes(pVDepBatchKProcs);
+		bytes += vecBytes(pVDepBatchBegin) + vecBytes(pVDepBatchTri);
+		bytes += vecBytes(pVDepBatchV) + vecBytes(pVDepBatchK);
+		bytes += vecBytes(pVDepOtherKProcs);
+		bytes += vecBytes(pVDepBatchVC) + vecBytes(pVDepBatchKMax);
+		bytes += vecBytes(pVDepSlot);
+		bytes += vecBytes(pVDepLumpOf) + vecBytes(pVDepLumpN);
+		bytes += vecBytes(pVDepLumpPos) + vecBytes(pVDepLumpHost);
+		bytes += vecBytes(pVDepLumpBin) + vecBytes(pVDepLumpK);
+		bytes += vecBytes(pVDepLumpNSum);
+		for (uint i = 0; i < pVDepLumpMembers.size(); ++i)
+		{
+			bytes += vecBytes(pVDepLumpMembers[i]);
+		}
+		for (uint g = 0; g < pVDepLumpFree.size(); ++g)
+		{
+			bytes += vecBytes(pVDepLumpFree[g]);
+		}
+		bytes += pVDepLumpMap.size() * (sizeof(std::pair<uint, int>) + sizeof(uint) + 4 * sizeof(void *));
+	}
+	if (all || part == "mesh")
+	{
+		bytes += pMesh->getMemoryUsage();
+	}
+	if (all || part == "statedef")
+	{
+		bytes += statedef()->getMemoryUsage();
+	}
+	if (all || part == "arena")
+	{
+		bytes += pArena.reserved() - pArena.allocated();
+		for (uint i = 0; i < pSetupArenas.size(); ++i)
+		{
+			bytes += pSetupArenas[i]->reserved() - pSetupArenas[i]->allocated();
+		}
+	}
+	return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setTauLeaping(bool leap)
+{
+	if (leap == true && efflag() == true)
+	{
+		std::ostringstream os;
+		os << "Tau-leaping is not available with the EField.";
+		throw steps::ArgErr(os.str());
+	}
+	pTauLeap = leap;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getTauLeaping(void) const
+{
+	return pTauLeap;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setTauLeapEpsilon(double eps)
+{
+	if (eps <= 0.0 || eps >= 1.0)
+	{
+		std::ostringstream os;
+		os << "Tau-leap epsilon must lie in (0, 1).";
+		throw steps::ArgErr(os.str());
+	}
+	pLeapEps = eps;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getTauLeapEpsilon(void) const
+{
+	return pLeapEps;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setTauLeapNCrit(uint ncrit)
+{
+	pLeapNCrit = ncrit;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getTauLeapNCrit(void) const
+{
+	return pLeapNCrit;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setDiffBatchThreshold(uint n)
+{
+	if (n > 0 && efflag() == true)
+	{
+		std::ostringstream os;
+		os << "Batched diffusion is not available with the EField.";
+		throw steps::ArgErr(os.str());
+	}
+	pDiffBatchThreshold = n;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getDiffBatchThreshold(void) const
+{
+	return pDiffBatchThreshold;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setEfieldThreads(uint n)
+{
+	if (n == 0)
+	{
+		std::ostringstream os;
+		os << "Number of EField threads must be at least 1.";
+		throw steps::ArgErr(os.str());
+	}
+	pEFThreads = n;
+	if (efflag() == true) pEField->setThreads(n);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getEfieldThreads(void) const
+{
+	return pEFThreads;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setEfieldAdaptive(double dvmax, double dtmin, double dtmax)
+{
+	if (efflag() != true)
+	{
+		std::ostringstream os;
+		os << "Method not available: EField calculation not included in simulation.";
+		throw steps::ArgErr(os.str());
+	}
+	if (dvmax < 0.0)
+	{
+		std::ostringstream os;
+		os << "Adaptive EField potential change cannot be negative.";
+		throw steps::ArgErr(os.str());
+	}
+	if (dvmax == 0.0)
+	{
+		pEFAdaptDV = 0.0;
+		return;
+	}
+	if (dtmin <= 0.0 || dtmax < dtmin)
+	{
+		std::ostringstream os;
+		os << "Adaptive EField dt bounds must satisfy 0 < dtmin <= dtmax.";
+		throw steps::ArgErr(os.str());
+	}
+	pEFAdaptDV = dvmax;
+	pEFDTMin = dtmin;
+	pEFDTMax = dtmax;
+	pEFDT = std::min(dtmax, std::max(dtmin, pEFDT));
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getEfieldAdaptiveDV(void) const
+{
+	return pEFAdaptDV;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setEfieldTheta(double theta)
+{
+	if (efflag() != true)
+	{
+		std::ostringstream os;
+		os << "Method not available: EField calculation not included in simulation.";
+		throw steps::ArgErr(os.str());
+	}
+	if (theta < 0.5 || theta > 1.0)
+	{
+		std::ostringstream os;
+		os << "EField theta must be between 0.5 (Crank-Nicolson) ";
+		os << "and 1.0 (backward Euler).";
+		throw steps::ArgErr(os.str());
+	}
+	pEFTheta = theta;
+	pEField->setTheta(theta);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getEfieldTheta(void) const
+{
+	return pEFTheta;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setEfieldMixedPrecision(bool mixed)
+{
+	if (efflag() != true)
+	{
+		std::ostringstream os;
+		os << "Method not available: EField calculation not included in simulation.";
+		throw steps::ArgErr(os.str());
+	}
+	pEFMixed = mixed;
+	pEField->setMixedPrecision(mixed);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getEfieldMixedPrecision(void) const
+{
+	return pEFMixed;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+std::string stex::Tetexact::getEfieldBackend(void) const
+{
+	return pEFBackend;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setEfieldPipeline(bool pipe)
+{
+	if (efflag() != true)
+	{
+		std::ostringstream os;
+		os << "Method not available: EField calculation not included in simulation.";
+		throw steps::ArgErr(os.str());
+	}
+	pEFPipeline = pipe;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getEfieldPipeline(void) const
+{
+	return pEFPipeline;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+struct stex::Tetexact::EFieldAdvance
+{
+    steps::solver::efield::EField     * efield;
+    double                              dt;
+
+    /// Whether the update runs on thread, with the error message if it
+    /// failed.
+    bool                                threaded;
+    std::string                         error;
+
+    pthread_t                           thread;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+void * stex::Tetexact::_efieldAdvancer(void * arg)
+{
+	EFieldAdvance * a = static_cast<EFieldAdvance *>(arg);
+	try
+	{
+		a->efield->advance(a->dt);
+	}
+	catch (steps::Err & err)
+	{
+		a->error = err.getMsg();
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_startEfield(double ef_dt)
+{
+	assert(pEFPipe == 0);
+	EFieldAdvance * a = new EFieldAdvance;
+	a->efield = pEField;
+	a->dt = ef_dt;
+	a->threaded = true;
+	pEFPipe = a;
+	if (pthread_create(&a->thread, 0, _efieldAdvancer, a) != 0)
+	{
+		// No thread to be had: update now.
+		a->threaded = false;
+		_efieldAdvancer(a);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_joinEfield(void)
+{
+	if (pEFPipe == 0) return;
+	if (pEFPipe->threaded == true) pthread_join(pEFPipe->thread, 0);
+	delete pEFPipe;
+	pEFPipe = 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_finishEfield(void)
+{
+	if (pEFPipe == 0) return;
+	double ef_dt = pEFPipe->dt;
+	if (pEFPipe->threaded == true) pthread_join(pEFPipe->thread, 0);
+	std::string error = pEFPipe->error;
+	delete pEFPipe;
+	pEFPipe = 0;
+	if (error != "") throw steps::ArgErr(error);
+
+	double dv = pEField->getMaxDV();
+	pEFStatMaxDV = std::max(pEFStatMaxDV, dv);
+	if (pEFAdaptDV > 0.0) _adaptEfieldDT(ef_dt, dv);
+	double t2 = wallTime();
+	_updateVDep();
+	pEFTimeUpdate += wallTime() - t2;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setVDepWindow(double dv)
+{
+	if (efflag() != true)
+	{
+		std::ostringstream os;
+		os << "Method not available: EField calculation not included in simulation.";
+		throw steps::ArgErr(os.str());
+	}
+	if (dv < 0.0)
+	{
+		std::ostringstream os;
+		os << "Voltage-dependent rate window cannot be negative.";
+		throw steps::ArgErr(os.str());
+	}
+
+	pVDepWindow = dv;
+	if (dv == 0.0)
+	{
+		pVDepBatchVC.clear();
+		pVDepBatchKMax.clear();
+	}
+	else
+	{
+		uint n = pVDepBatchKProcs.size();
+		pVDepBatchVC.resize(n);
+		pVDepBatchKMax.resize(n);
+	}
+	_update();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getVDepWindow(void) const
+{
+	return pVDepWindow;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setVDepLump(double dv)
+{
+	if (efflag() != true)
+	{
+		std::ostringstream os;
+		os << "Method not available: EField calculation not included in simulation.";
+		throw steps::ArgErr(os.str());
+	}
+	if (dv < 0.0)
+	{
+		std::ostringstream os;
+		os << "Voltage-dependent transition lump width cannot be negative.";
+		throw steps::ArgErr(os.str());
+	}
+
+	pVDepLump = dv;
+	uint n = (dv == 0.0) ? 0 : pVDepBatchBegin[pVDepNTransBatches];
+	pVDepLumpOf.assign(n, ssolver::LIDX_UNDEFINED);
+	pVDepLumpN.assign(n, 0.0);
+	pVDepLumpPos.assign(n, 0);
+	pVDepLumpHost.assign(n, 0);
+	pVDepLumpBin.assign(n, 0);
+	pVDepLumpK.assign(n, 0.0);
+	pVDepLumpNSum.assign(n, 0.0);
+	pVDepLumpMembers.assign(n, std::vector<uint>());
+	pVDepLumpFree.assign((dv == 0.0) ? 0 : pVDepNTransBatches, std::vector<uint>());
+	pVDepLumpMap.clear();
+	_update();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getVDepLump(void) const
+{
+	return pVDepLump;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getEfieldStat(std::string const & stat) const
+{
+	if (efflag() != true)
+	{
+		std::ostringstream os;
+		os << "Method not available: EField calculation not included in simulation.";
+		throw steps::ArgErr(os.str());
+	}
+
+	double t_rhs, t_matrix, t_solve;
+	uint nsteps, nmatrix;
+	pEField->getStats(t_rhs, t_matrix, t_solve, nsteps, nmatrix);
+	if (stat == "steps") return nsteps;
+	if (stat == "matrices") return nmatrix;
+	if (stat == "rhs") return t_rhs;
+	if (stat == "matrix") return t_matrix;
+	if (stat == "solve") return t_solve;
+	if (stat == "currents") return pEFTimeCurr;
+	if (stat == "update") return pEFTimeUpdate;
+	if (stat == "maxdv") return pEFStatMaxDV;
+	if (stat == "halfbw") return pEField->getHalfBW();
+	if (stat == "blocks") return pEField->getNBlocks();
+	if (stat == "refine") return pEField->getNRefine();
+	if (stat == "vdepcand") return pVDepNCand;
+	if (stat == "vdepreject") return pVDepNReject;
+	if (stat == "vdepmoved") return pVDepNMoved;
+
+	std::ostringstream os;
+	os << "Unknown EField statistic '" << stat << "' (expected 'steps', ";
+	os << "'matrices', 'rhs', 'matrix', 'solve', 'currents', 'update', ";
+	os << "'maxdv', 'halfbw', 'blocks', 'refine', 'vdepcand', 'vdepreject' or ";
+	os << "'vdepmoved').";
+	throw steps::ArgErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::resetEfieldStats(void)
+{
+	if (efflag() != true)
+	{
+		std::ostringstream os;
+		os << "Method not available: EField calculation not included in simulation.";
+		throw steps::ArgErr(os.str());
+	}
+	pEField->resetStats();
+	pEFTimeCurr = 0.0;
+	pEFTimeUpdate = 0.0;
+	pEFStatMaxDV = 0.0;
+	pVDepNCand = 0.0;
+	pVDepNReject = 0.0;
+	pVDepNMoved = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_adaptEfieldDT(double ef_dt, double dv)
+{
+	// The step was often cut short by the next SSA event, so the change
+	// is scaled by the rate over ef_dt rather than compared to pEFDT.
+	double dt = 2.0 * pEFDT;
+	if (dv > 0.0) dt = std::min(dt, 0.9 * pEFAdaptDV * ef_dt / dv);
+	dt = std::max(dt, 0.5 * pEFDT);
+	pEFDT = std::min(pEFDTMax, std::max(pEFDTMin, dt));
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setDiffBatchDT(double dt)
+{
+	if (dt <= 0.0)
+	{
+		std::ostringstream os;
+		os << "Batched diffusion window must be > 0.";
+		throw steps::ArgErr(os.str());
+	}
+	pDiffBatchDT = dt;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getDiffBatchDT(void) const
+{
+	return pDiffBatchDT;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setCoarseGrainSize(double h)
+{
+	if (h < 0.0)
+	{
+		std::ostringstream os;
+		os << "Coarse-graining bin size must be >= 0.";
+		throw steps::ArgErr(os.str());
+	}
+	if (h > 0.0 && efflag() == true)
+	{
+		std::ostringstream os;
+		os << "Coarse-grained diffusion is not available with the EField.";
+		throw steps::ArgErr(os.str());
+	}
+	if (h == pCGSize) return;
+	pCGSize = h;
+	pCGGroupStart.clear();
+	pCGMerged.clear();
+	pCGNMerged.clear();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getCoarseGrainSize(void) const
+{
+	return pCGSize;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setCoarseGrainSpec(std::string const & s, bool cg)
+{
+	uint sidx = statedef()->getSpecIdx(s);
+	if (pCGSpecs.empty() == true) pCGSpecs.assign(statedef()->countSpecs(), false);
+	pCGSpecs[sidx] = cg;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getCoarseGrainSpec(std::string const & s) const
+{
+	uint sidx = statedef()->getSpecIdx(s);
+	return (pCGSpecs.empty() == false && pCGSpecs[sidx] == true);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setCoarseGrainDT(double dt)
+{
+	if (dt <= 0.0)
+	{
+		std::ostringstream os;
+		os << "Coarse-graining window must be > 0.";
+		throw steps::ArgErr(os.str());
+	}
+	pCGDT = dt;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getCoarseGrainDT(void) const
+{
+	return pCGDT;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setCoarseGrainTol(double tol)
+{
+	if (tol < 0.0)
+	{
+		std::ostringstream os;
+		os << "Coarse-graining tolerance must be >= 0.";
+		throw steps::ArgErr(os.str());
+	}
+	pCGTol = tol;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getCoarseGrainTol(void) const
+{
+	return pCGTol;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getCoarseGrainNGroups(void)
+{
+	if (pCGSize <= 0.0) return 0;
+	_setupCoarseGrain();
+	return pCGGroupStart.size() - 1;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getCoarseGrainNMerged(std::string const & s) const
+{
+	uint sidx = statedef()->getSpecIdx(s);
+	return (pCGNMerged.empty() == true) ? 0 : pCGNMerged[sidx];
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setCompactPools(bool compact)
+{
+	pCompactPools = compact;
+
+	WmVolPVecCI wmvol_end = pWmVols.end();
+	for (WmVolPVecCI wmvol = pWmVols.begin(); wmvol != wmvol_end; ++wmvol)
+	{
+		if ((*wmvol) != 0) (*wmvol)->setCompactPools(compact);
+	}
+	TetPVecCI tet_end = pTets.end();
+	for (TetPVecCI tet = pTets.begin(); tet != tet_end; ++tet)
+	{
+		if ((*tet) != 0) (*tet)->setCompactPools(compact);
+	}
+	TriPVecCI tri_end = pTris.end();
+	for (TriPVecCI tri = pTris.begin(); tri != tri_end; ++tri)
+	{
+		if ((*tri) != 0) (*tri)->setCompactPools(compact);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getCompactPools(void) const
+{
+	return pCompactPools;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setCountTotals(bool on)
+{
+	if (on == false && pTriggers.empty() == false)
+	{
+		std::ostringstream os;
+		os << "Count totals are needed by the triggers; clear them first.";
+		throw steps::ArgErr(os.str());
+	}
+	pCountTotals = on;
+	std::for_each(pComps.begin(), pComps.end(),
+	              std::bind2nd(std::mem_fun(&Comp::setCountTotals), on));
+	std::for_each(pPatches.begin(), pPatches.end(),
+	              std::bind2nd(std::mem_fun(&Patch::setCountTotals), on));
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::getCountTotals(void) const
+{
+	return pCountTotals;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_sumCountTotals(void)
+{
+	std::for_each(pComps.begin(), pComps.end(),
+	              std::mem_fun(&Comp::sumCountTotals));
+	std::for_each(pPatches.begin(), pPatches.end(),
+	              std::mem_fun(&Patch::sumCountTotals));
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::addCompCountTrigger(std::string const & c,
+                                         std::string const & s,
+                                         double n, bool above)
+{
+	uint cidx = statedef()->getCompIdx(c);
+	uint sidx = statedef()->getSpecIdx(s);
+	stex::Comp * comp = _comp(cidx);
+	uint slidx = comp->def()->specG2L(sidx);
+	if (slidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+	if (pCountTotals == false) setCountTotals(true);
+
+	Trigger tr;
+	tr.comp = comp;
+	tr.patch = 0;
+	tr.slidx = slidx;
+	tr.threshold = n;
+	tr.above = above;
+	tr.armed = true;
+	pTriggers.push_back(tr);
+	return pTriggers.size() - 1;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::addPatchCountTrigger(std::string const & p,
+                                          std::string const & s,
+                                          double n, bool above)
+{
+	uint pidx = statedef()->getPatchIdx(p);
+	uint sidx = statedef()->getSpecIdx(s);
+	stex::Patch * patch = _patch(pidx);
+	uint slidx = patch->def()->specG2L(sidx);
+	if (slidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in patch.\n";
+		throw steps::ArgErr(os.str());
+	}
+	if (pCountTotals == false) setCountTotals(true);
+
+	Trigger tr;
+	tr.comp = 0;
+	tr.patch = patch;
+	tr.slidx = slidx;
+	tr.threshold = n;
+	tr.above = above;
+	tr.armed = true;
+	pTriggers.push_back(tr);
+	return pTriggers.size() - 1;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::clearTriggers(void)
+{
+	pTriggers.clear();
+	pTriggered = -1;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+int stex::Tetexact::getTriggered(void) const
+{
+	return pTriggered;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::scheduleCompCount(double t, std::string const & c,
+                                       std::string const & s, double n)
+{
+	uint cidx = statedef()->getCompIdx(c);
+	uint sidx = statedef()->getSpecIdx(s);
+	if (_comp(cidx)->def()->specG2L(sidx) == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _addIntervention(t, IV_COMP_COUNT, cidx, sidx, n);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::scheduleCompInject(double t, std::string const & c,
+                                        std::string const & s, double n)
+{
+	uint cidx = statedef()->getCompIdx(c);
+	uint sidx = statedef()->getSpecIdx(s);
+	if (_comp(cidx)->def()->specG2L(sidx) == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _addIntervention(t, IV_COMP_INJECT, cidx, sidx, n);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::scheduleTetInject(double t, uint tidx,
+                                       std::string const & s, double n)
+{
+	uint sidx = statedef()->getSpecIdx(s);
+	if (tidx >= pTets.size() || pTets[tidx] == 0)
+	{
+		std::ostringstream os;
+		os << "Tetrahedron " << tidx << " has not been assigned to a compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+	if (pTets[tidx]->compdef()->specG2L(sidx) == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in tetrahedron.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _addIntervention(t, IV_TET_INJECT, tidx, sidx, n);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::schedulePatchCount(double t, std::string const & p,
+                                        std::string const & s, double n)
+{
+	uint pidx = statedef()->getPatchIdx(p);
+	uint sidx = statedef()->getSpecIdx(s);
+	if (_patch(pidx)->def()->specG2L(sidx) == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in patch.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _addIntervention(t, IV_PATCH_COUNT, pidx, sidx, n);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::scheduleCompReacK(double t, std::string const & c,
+                                       std::string const & r, double kf)
+{
+	uint cidx = statedef()->getCompIdx(c);
+	uint ridx = statedef()->getReacIdx(r);
+	if (_comp(cidx)->def()->reacG2L(ridx) == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Reaction undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _addIntervention(t, IV_COMP_REACK, cidx, ridx, kf);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::schedulePatchSReacK(double t, std::string const & p,
+                                         std::string const & r, double kf)
+{
+	uint pidx = statedef()->getPatchIdx(p);
+	uint ridx = statedef()->getSReacIdx(r);
+	if (_patch(pidx)->def()->sreacG2L(ridx) == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Surface reaction undefined in patch.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _addIntervention(t, IV_PATCH_SREACK, pidx, ridx, kf);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::scheduleCompClamped(double t, std::string const & c,
+                                         std::string const & s, bool clamped)
+{
+	uint cidx = statedef()->getCompIdx(c);
+	uint sidx = statedef()->getSpecIdx(s);
+	if (_comp(cidx)->def()->specG2L(sidx) == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _addIntervention(t, IV_COMP_CLAMPED, cidx, sidx, clamped ? 1.0 : 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::scheduleVertIClamp(double t, uint vidx, double cur)
+{
+	if (efflag() != true)
+	{
+		std::ostringstream os;
+		os << "Method not available: EField calculation not included in simulation.";
+		throw steps::ArgErr(os.str());
+	}
+	if (vidx >= mesh()->countVertices() || pEFVert_GtoL[vidx] == -1)
+	{
+		std::ostringstream os;
+		os << "Vertex index " << vidx << " not assigned to a conduction volume or membrane.";
+		throw steps::ArgErr(os.str());
+	}
+	return _addIntervention(t, IV_VERT_ICLAMP, vidx, 0, cur);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::_addIntervention(double t, uint kind, uint loc, uint obj,
+                                      double value)
+{
+	if (t < statedef()->time())
+	{
+		std::ostringstream os;
+		os << "Intervention time is before current simulation time.";
+		throw steps::ArgErr(os.str());
+	}
+	bool count = (kind == IV_COMP_COUNT || kind == IV_COMP_INJECT
+		|| kind == IV_TET_INJECT || kind == IV_PATCH_COUNT);
+	if (count == true && value > std::numeric_limits<unsigned int>::max())
+	{
+		std::ostringstream os;
+		os << "Can't set count greater than maximum unsigned integer (";
+		os << std::numeric_limits<unsigned int>::max() << ").\n";
+		throw steps::ArgErr(os.str());
+	}
+	if ((count == true || kind == IV_COMP_REACK || kind == IV_PATCH_SREACK)
+		&& value < 0.0)
+	{
+		std::ostringstream os;
+		os << "Intervention value cannot be negative.";
+		throw steps::ArgErr(os.str());
+	}
+
+	Intervention iv;
+	iv.kind = kind;
+	iv.loc = loc;
+	iv.obj = obj;
+	iv.value = value;
+	iv.time = t;
+	iv.period = 0.0;
+	iv.count = 1;
+	iv.applied = 0;
+	pInterventions.push_back(iv);
+	uint i = pInterventions.size() - 1;
+	_queueIntervention(i);
+	return i;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::repeatIntervention(uint i, double period, uint n)
+{
+	if (i >= pInterventions.size())
+	{
+		std::ostringstream os;
+		os << "Intervention index " << i << " out of range.";
+		throw steps::ArgErr(os.str());
+	}
+	if (n > 1 && period <= 0.0)
+	{
+		std::ostringstream os;
+		os << "Period of a repeated intervention must be positive.";
+		throw steps::ArgErr(os.str());
+	}
+	Intervention & iv = pInterventions[i];
+	if (iv.applied < iv.count)
+	{
+		double t = iv.time + iv.applied * iv.period;
+		pTimeline.erase(std::make_pair(t, i));
+	}
+	iv.period = period;
+	iv.count = n;
+	_queueIntervention(i);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::clearInterventions(void)
+{
+	pInterventions.clear();
+	pTimeline.clear();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getNInterventions(void) const
+{
+	uint n = 0;
+	for (uint i = 0; i < pInterventions.size(); ++i)
+	{
+		Intervention const & iv = pInterventions[i];
+		if (iv.applied < iv.count) n += iv.count - iv.applied;
+	}
+	return n;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_queueIntervention(uint i)
+{
+	Intervention const & iv = pInterventions[i];
+	if (iv.applied >= iv.count) return;
+	pTimeline.insert(std::make_pair(iv.time + iv.applied * iv.period, i));
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_applyInterventions(double t)
+{
+	if (t > statedef()->time()) statedef()->setTime(t);
+
+	// The changes of all interventions due mark the kprocs they affect,
+	// which are refreshed together at the end.
+	_beginBatch();
+	try
+	{
+		while (pTimeline.empty() == false && pTimeline.begin()->first <= t)
+		{
+			uint i = pTimeline.begin()->second;
+			pTimeline.erase(pTimeline.begin());
+			Intervention & iv = pInterventions[i];
+			++iv.applied;
+			_queueIntervention(i);
+
+			switch (iv.kind)
+			{
+			case IV_COMP_COUNT:
+				_setCompCount(iv.loc, iv.obj, iv.value);
+				break;
+			case IV_COMP_INJECT:
+			{
+				stex::Comp * comp = _comp(iv.loc);
+				uint l = comp->def()->specG2L(iv.obj);
+				std::vector<double> n;
+				for (WmVolPVecCI v = comp->bgnTet(); v != comp->endTet(); ++v)
+				{
+					n.push_back((*v)->vol());
+				}
+				_multinomial(iv.value, n);
+				uint k = 0;
+				for (WmVolPVecCI v = comp->bgnTet(); v != comp->endTet(); ++v, ++k)
+				{
+					if (n[k] == 0.0) continue;
+					(*v)->setCount(l, _roundCount((*v)->count(l) + n[k]));
+					_markSpec(*v, l);
+				}
+				break;
+			}
+			case IV_TET_INJECT:
+			{
+				stex::Tet * tet = pTets[iv.loc];
+				uint l = tet->compdef()->specG2L(iv.obj);
+				tet->setCount(l, _roundCount(tet->count(l) + iv.value));
+				_markSpec(tet, l);
+				break;
+			}
+			case IV_PATCH_COUNT:
+				_setPatchCount(iv.loc, iv.obj, iv.value);
+				break;
+			case IV_COMP_REACK:
+			{
+				_applyCompReacK(iv.loc, iv.obj, iv.value);
+				stex::Comp * comp = _comp(iv.loc);
+				uint l = comp->def()->reacG2L(iv.obj);
+				for (WmVolPVecCI v = comp->bgnTet(); v != comp->endTet(); ++v)
+				{
+					_updateElement((*v)->reac(l));
+				}
+				break;
+			}
+			case IV_PATCH_SREACK:
+			{
+				_applyPatchSReacK(iv.loc, iv.obj, iv.value);
+				stex::Patch * patch = _patch(iv.loc);
+				uint l = patch->def()->sreacG2L(iv.obj);
+				for (TriPVecCI v = patch->bgnTri(); v != patch->endTri(); ++v)
+				{
+					_updateElement((*v)->sreac(l));
+				}
+				break;
+			}
+			case IV_COMP_CLAMPED:
+				_setCompClamped(iv.loc, iv.obj, iv.value != 0.0);
+				break;
+			case IV_VERT_ICLAMP:
+				_setVertIClamp(iv.loc, iv.value);
+				break;
+			default:
+				assert(false);
+			}
+		}
+	}
+	catch (...)
+	{
+		_endBatch();
+		throw;
+	}
+	_endBatch();
+
+	// An event drawn before the changes is no longer valid.
+	_dropPending();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::setClusters(uint nclusters, uint nthreads, double window)
+{
+	delete pClusters;
+	pClusters = 0;
+	// The clusters fire their kprocs on several threads.
+	if (nclusters > 1)
+	{
+		if (pDomains != 0)
+		{
+			std::ostringstream os;
+			os << "Clusters are not available with domains.";
+			throw steps::ArgErr(os.str());
+		}
+		_resolveAllDeps();
+		pClusters = new Clusters(this, nclusters, nthreads, window);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::getNClusters(void) const
+{
+	return (pClusters != 0) ? pClusters->countClusters() : 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getClusterRuns(void) const
+{
+	return (pClusters != 0) ? pClusters->getNRuns() : 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::getClusterRollbacks(void) const
+{
+	return (pClusters != 0) ? pClusters->getNRollbacks() : 0.0;
+}
 
-    			pTris[t]->setInnerTet(pTets[tetinner]);
-    			// Now add this triangle to inner tet's list of neighbours
-    			for (uint i=0; i <= 4; ++i)
-    			{
-    				// include assert for debugging purposes and remove
-    				// once this is tested
-    				assert (i < 4);														//////////
-    				// check if there is already a neighbouring tet or tri
-    				// In theory if there is a tri to add, the tet should
-    				// have less than 4 neighbouring tets added because
-    				// a neighbouring tet(s) is in a different compartment
+////////////////////////////////////////////////////////////////////////
 
-    				// THIS IS NOT THE CASE ANYMORE: tets in different compartments can be neighbours
-    				// so as to allow for diffusion boundaries
+// Adds the counts of pools to hash.
+static void hashPools(steps::ContentHash & hash, stex::Pools const & pools)
+{
+	uint nspecs = pools.countSpecs();
+	for (uint s = 0; s < nspecs; ++s)
+	{
+		uint c = pools.count(s);
+		hash.add(&c, sizeof(c));
+	}
+}
 
-    				// 	Also check tris because in some cases a surface tet
-    				// may have more than 1 neighbouring tri
-    				// NOTE: The order here will end up being different to the
-    				// neighbour order at the Tetmesh level
+std::string stex::Tetexact::getStateHash(void) const
+{
+	steps::ContentHash hash;
+	double t = statedef()->time();
+	hash.add(&t, sizeof(t));
+	for (uint v = 0; v < pWmVols.size(); ++v)
+	{
+		if (pWmVols[v] != 0) hashPools(hash, pWmVols[v]->pools());
+	}
+	for (uint v = 0; v < pTets.size(); ++v)
+	{
+		if (pTets[v] != 0) hashPools(hash, pTets[v]->pools());
+	}
+	for (uint t = 0; t < pTris.size(); ++t)
+	{
+		if (pTris[t] != 0) hashPools(hash, pTris[t]->pools());
+	}
+	uint neft = pEFTris_vec.size();
+	if (pEField != 0 && neft != 0)
+	{
+		std::vector<double> v(neft);
+		pEField->getTriVs(&v[0]);
+		hash.add(v);
+	}
+	return hash.hex();
+}
 
-    				// Now with diffusion boundaries, meaning tets can have neighbours that
-    				// are in different comps, we must check the compartment
-    				steps::tetexact::Tet * tet_in = pTets[tetinner];
-    				if (tet_in->nextTet(i) != 0 && tet_in->compdef() == tet_in->nextTet(i)->compdef()) continue;
+////////////////////////////////////////////////////////////////////////
 
-    				if (tet_in->nextTri(i) != 0) continue;
-    				tet_in->setNextTri(i, pTris[t]);
-    				break;
-    			}
-    		}
-    	}
+void stex::Tetexact::_runClusters(double endtime)
+{
+	if (pTauLeap == true || pDiffBatchThreshold > 0 || pTriggers.empty() == false)
+	{
+		std::ostringstream os;
+		os << "Clusters are not available with tau-leaping, batched ";
+		os << "diffusion or triggers.";
+		throw steps::NotImplErr(os.str());
+	}
+	_dropPending();
 
-    	// DEBUG 18/03/09:
-    	// Now correct check, previously didn't allow for tet index == 0
-    	if (tetouter >= 0)
-    	{
-    		if (pTets[tetouter] != 0)
-    		{
-    			// A triangle may already have an inner tet defined as a well-mixed
-    			// volume, but that should not be the case here:
-    			assert (pTris[t]->oTet() == 0);
+	// The running totals are shared by the clusters of a compartment;
+	// they are summed again afterwards.
+	bool totals = pCountTotals;
+	if (totals == true)
+	{
+		std::for_each(pComps.begin(), pComps.end(),
+		              std::bind2nd(std::mem_fun(&Comp::setCountTotals), false));
+		std::for_each(pPatches.begin(), pPatches.end(),
+		              std::bind2nd(std::mem_fun(&Patch::setCountTotals), false));
+	}
 
-    			pTris[t]->setOuterTet(pTets[tetouter]);
-    			// Add this triangle to outer tet's list of neighbours
-    			for (uint i=0; i <= 4; ++i)
-    			{
-    				assert (i < 4);
+	bool rois = _hasROIs();
+	if (rois == true) _linkROIs(false);
 
-    				// See above in that tets now store tets from different comps
-    				steps::tetexact::Tet * tet_out = pTets[tetouter];
+	double nevents = pClusters->run(endtime);
 
-    				if (tet_out->nextTet(i) != 0 && tet_out->compdef() == tet_out->nextTet(i)->compdef()) continue;
+	if (totals == true)
+	{
+		std::for_each(pComps.begin(), pComps.end(),
+		              std::bind2nd(std::mem_fun(&Comp::setCountTotals), true));
+		std::for_each(pPatches.begin(), pPatches.end(),
+		              std::bind2nd(std::mem_fun(&Patch::setCountTotals), true));
+	}
+	if (rois == true) _linkROIs(true);
+	statedef()->setTime(endtime);
+	statedef()->incNSteps(static_cast<uint>(nevents));
 
-    				if (tet_out->nextTri(i) != 0) continue;
-    				tet_out->setNextTri(i, pTris[t]);
-    				break;
-				}
-    		}
-    	}
-    }
+	// The solver's own scheduler is refreshed for step() and the serial
+	// modes.
+	_update();
+}
 
-    // Now loop over the diffusion boundaries:
-    // 1) get all the triangles and get the two tetrahedrons
-    // 2) figure out which direction is the direction for a tetrahedron
-    // 3) add the tetrahedron and the direction to local object
+////////////////////////////////////////////////////////////////////////
 
-    // This is here because we need all tets to have been assigned correctly
-    // to compartments. Check every one and set the compA and compB for the db
-    uint ndiffbnds = pDiffBoundaries.size();
-    assert(ndiffbnds ==	mesh()->_countDiffBoundaries());
+void stex::Tetexact::_armTriggers(void)
+{
+	pTriggered = -1;
+	uint ntr = pTriggers.size();
+	for (uint i = 0; i < ntr; ++i)
+	{
+		Trigger & tr = pTriggers[i];
+		double n = (tr.comp != 0) ? tr.comp->countTotal(tr.slidx)
+		                          : tr.patch->countTotal(tr.slidx);
+		tr.armed = tr.above ? (n < tr.threshold) : (n > tr.threshold);
+	}
+}
 
-    for (uint db = 0; db < ndiffbnds; ++db)
-    {
-    	steps::tetexact::DiffBoundary * localdiffb = pDiffBoundaries[db];
-        std::vector<uint> dbtrisvec = localdiffb->def()->tris();
+////////////////////////////////////////////////////////////////////////
 
-        uint compAidx = localdiffb->def()->compa();
-        uint compBidx = localdiffb->def()->compb();
-        steps::solver::Compdef * compAdef = statedef()->compdef(compAidx);
-        steps::solver::Compdef * compBdef = statedef()->compdef(compBidx);
+bool stex::Tetexact::_checkTriggers(void)
+{
+	bool fired = false;
+	uint ntr = pTriggers.size();
+	for (uint i = 0; i < ntr; ++i)
+	{
+		Trigger & tr = pTriggers[i];
+		double n = (tr.comp != 0) ? tr.comp->countTotal(tr.slidx)
+		                          : tr.patch->countTotal(tr.slidx);
+		bool met = tr.above ? (n >= tr.threshold) : (n <= tr.threshold);
+		if (met == true && tr.armed == true && fired == false)
+		{
+			pTriggered = i;
+			fired = true;
+		}
+		tr.armed = !met;
+	}
+	return fired;
+}
 
-        std::vector<uint>::const_iterator dbtris_end = dbtrisvec.end();
-        for (std::vector<uint>::const_iterator dbtris = dbtrisvec.begin(); dbtris != dbtris_end; ++dbtris)
-        {
-    		steps::tetmesh::Tri * tri = new steps::tetmesh::Tri(mesh(), (*dbtris));
+////////////////////////////////////////////////////////////////////////
 
-    		uint tetAidx = tri->getTet0Idx();
-    		uint tetBidx = tri->getTet1Idx();
-    		assert (tetAidx >= 0 and tetBidx >= 0);
+void stex::Tetexact::setCountViews(bool on)
+{
+	pCountViews = on;
+	uint nspecs = statedef()->countSpecs();
+	if (on == true)
+	{
+		pTetCountView.assign(pTets.size() * nspecs, 0);
+		pTriCountView.assign(pTris.size() * nspecs, 0);
+	}
+	else
+	{
+		std::vector<uint>().swap(pTetCountView);
+		std::vector<uint>().swap(pTriCountView);
+	}
+	_syncCountViews();
+}
 
-    		delete tri;
+////////////////////////////////////////////////////////////////////////
 
-    		steps::tetexact::Tet * tetA = _tet(tetAidx);
-    		steps::tetexact::Tet * tetB = _tet(tetBidx);
-    		assert(tetA != 0 and tetB != 0);
+bool stex::Tetexact::getCountViews(void) const
+{
+	return pCountViews;
+}
 
-    		steps::solver::Compdef * tetA_cdef = tetA->compdef();
-    		steps::solver::Compdef * tetB_cdef = tetB->compdef();
-    		assert (tetA_cdef != 0);
-    		assert (tetB_cdef != 0);
+////////////////////////////////////////////////////////////////////////
 
-    		if (tetA_cdef != compAdef)
-    		{
-    			assert (tetB_cdef == compAdef);
-    			assert (tetA_cdef == compBdef);
-    		}
-    		else
-    		{
-    			assert (tetB_cdef == compBdef);
-    			assert (tetA_cdef == compAdef);
-    		}
+size_t stex::Tetexact::getTetCountViewAddr(void) const
+{
+	if (pTetCountView.empty() == true) return 0;
+	return reinterpret_cast<size_t>(&pTetCountView[0]);
+}
 
-    		// Ok, checks over, lets get down to business
-    		int direction_idx_a = -1;
-    		int direction_idx_b = -1;
+////////////////////////////////////////////////////////////////////////
 
-    		steps::tetmesh::Tet * tetA_mesh = new steps::tetmesh::Tet(mesh(), (tetAidx));
-    		steps::tetmesh::Tet * tetB_mesh = new steps::tetmesh::Tet(mesh(), (tetBidx));
+size_t stex::Tetexact::getTriCountViewAddr(void) const
+{
+	if (pTriCountView.empty() == true) return 0;
+	return reinterpret_cast<size_t>(&pTriCountView[0]);
+}
 
-    		for (uint i = 0; i < 4; ++i)
-    		{
-    			if (tetA_mesh->getTriIdx(i) == (*dbtris))
-    			{
-    				assert(direction_idx_a == -1);
-    				direction_idx_a = i;
-    			}
-    			if (tetB_mesh->getTriIdx(i) == (*dbtris))
-    			{
-    				assert(direction_idx_b == -1);
-    				direction_idx_b = i;
-    			}
-    		}
-    		assert (direction_idx_a != -1);
-    		assert (direction_idx_b != -1);
+////////////////////////////////////////////////////////////////////////
 
-    		// Set the tetrahedron and direction to the Diff Boundary object
-    		localdiffb->setTetDirection(tetAidx, direction_idx_a);
-    		localdiffb->setTetDirection(tetBidx, direction_idx_b);
+void stex::Tetexact::_syncCountViews(void)
+{
+	uint nspecs = statedef()->countSpecs();
+	bool on = (pCountViews == true && nspecs != 0);
+	for (uint t = 0; t < pTets.size(); ++t)
+	{
+		if (pTets[t] == 0) continue;
+		pTets[t]->setCountView(on ? &pTetCountView[t * nspecs] : 0);
+		pTets[t]->syncCountView();
+	}
+	for (uint t = 0; t < pTris.size(); ++t)
+	{
+		if (pTris[t] == 0) continue;
+		pTris[t]->setCountView(on ? &pTriCountView[t * nspecs] : 0);
+		pTris[t]->syncCountView();
+	}
+}
 
-    		delete tetA_mesh;
-    		delete tetB_mesh;
-        }
+////////////////////////////////////////////////////////////////////////
 
-        localdiffb->setComps(_comp(compAidx), _comp(compBidx));
+void stex::Tetexact::setTemp(double t)
+{
+	if (efflag() == false)
+	{
+		std::ostringstream os;
+		os << "\nWARNING: Temperature set in simulation without membrane ";
+		os << "potential calculation will be ignored.\n";
+		std::cout << os << std::endl;
+	}
+	assert(t >= 0.0);
+	pTemp = t;
+	if (efflag() == false) return;
+	_setupGHKTables();
 
-        // Before the kprocs are set up ( in _setup) the tetrahedrons need to know the diffusion
-        // boundary direction, so let's do it here  - the diff bounday has had all
-        // tetrahedrons added
+	// Of the kprocs only the GHK currents depend on the temperature.
+	double now = statedef()->time();
+	uint nother = pVDepOtherKProcs.size();
+	for (uint i = 0; i < nother; ++i)
+	{
+		KProc * kp = pVDepOtherKProcs[i];
+		pScheduler->update(kp->schedIDX(), _rate(kp), now);
+	}
+	_commit(now);
+}
 
-        // Might as well copy the vectors because we need to index through
-        std::vector<uint> tets = localdiffb->getTets();
-        std::vector<uint> tets_direction = localdiffb->getTetDirection();
+////////////////////////////////////////////////////////////////////////////////
 
-        ntets = tets.size();
-        assert (ntets <= pTets.size());
-        assert (tets_direction.size() == ntets);
+double stex::Tetexact::_getCompVol(uint cidx) const
+{
+	assert(cidx < statedef()->countComps());
+	assert (statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	assert(comp != 0);
+	return comp->vol();
+}
 
-        for (uint t = 0; t < ntets; ++t)
-        {
-        	steps::tetexact::Tet * localtet = _tet(tets[t]);
-        	localtet->setDiffBndDirection(tets_direction[t]);
-        }
+////////////////////////////////////////////////////////////////////////////////
 
-    }
+double stex::Tetexact::_getCompCount(uint cidx, uint sidx) const
+{
+	assert(cidx < statedef()->countComps());
+	assert(sidx < statedef()->countSpecs());
+	assert (statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	assert(comp != 0);
+	uint slidx = comp->def()->specG2L(sidx);
+	if (slidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+	if (comp->countTotals() == true) return comp->countTotal(slidx);
+
+	uint count = 0;
+	WmVolPVecCI t_end = comp->endTet();
+	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	{
+		count += (*t)->count(slidx);
+	}
+
+	return count;
+}
 
+////////////////////////////////////////////////////////////////////////////////
 
-	TetPVecCI tet_end = pTets.end();
-	for (TetPVecCI t = pTets.begin(); t != tet_end; ++t)
+void stex::Tetexact::_setCompCount(uint cidx, uint sidx, double n)
+{
+	assert(cidx < statedef()->countComps());
+	assert(sidx < statedef()->countSpecs());
+	assert (n >= 0.0);
+	assert (statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	uint slidx = comp->def()->specG2L(sidx);
+	if (slidx == ssolver::LIDX_UNDEFINED)
 	{
-		// DEBUG: vector holds all possible tetrahedrons,
-		// but they have not necessarily been added to a compartment.
-		if ((*t) == 0) continue;
-
-		(*t)->setupKProcs(this);
+		std::ostringstream os;
+		os << "Species undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
 	}
-
-	WmVolPVecCI wmv_end = pWmVols.end();
-	for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_end; ++wmv)
+	if (n > std::numeric_limits<unsigned int>::max( ))
 	{
-		// Vector allows for all compartments to be well-mixed, so
-		// hold null-pointer for mesh compartments
-		if ((*wmv) == 0) continue;
-
-		(*wmv)->setupKProcs(this);
+		std::ostringstream os;
+		os << "Can't set count greater than maximum unsigned integer (";
+		os << std::numeric_limits<unsigned int>::max( ) << ").\n";
+		throw steps::ArgErr(os.str());
 	}
 
-	TriPVecCI tri_end = pTris.end();
-	for (TriPVecCI t = pTris.begin(); t != tri_end; ++t)
-	{
-		// DEBUG: vector holds all possible triangles, but
-		// only patch triangles are filled
-		if ((*t) == 0) continue;
+	double totalvol = comp->def()->vol();
+	WmVolPVecCI t_end = comp->endTet();
 
-		(*t)->setupKProcs(this, efflag());
-	}
-	// Resolve all dependencies
-	for (TetPVecCI t = pTets.begin(); t != tet_end; ++t)
+	double n_int = std::floor(n);
+	double n_frc = n - n_int;
+	uint c = static_cast<uint>(n_int);
+	if (n_frc > 0.0)
 	{
-		// DEBUG: vector holds all possible tetrahedrons,
-		// but they have not necessarily been added to a compartment.
-		if ((*t) == 0) continue;
-
-		KProcPVecCI kprocend = (*t)->kprocEnd();
-		for (KProcPVecCI k = (*t)->kprocBegin(); k != kprocend; ++k)
-		{
-		    (*k)->setupDeps();
-		}
+		double rand01 = rng()->getUnfIE();
+		if (rand01 < n_frc) c++;
 	}
 
+    uint nremoved = 0;
+    for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+    {
+        WmVol * tet = *t;
+        if (n == 0.0) {
+            tet->setCount(slidx, 0);
+            continue;
+        }
 
-	for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_end; ++wmv)
-	{
-		// Vector allows for all compartments to be well-mixed, so
-		// hold null-pointer for mesh compartments
-		if ((*wmv) == 0) continue;
-		KProcPVecCI kprocend = (*wmv)->kprocEnd();
-		for (KProcPVecCI k = (*wmv)->kprocBegin(); k != kprocend; ++k)
+		// New method (allowing ceiling) means we have to set the counts
+		// to zero for any tets after all molecules have been injected
+		if (nremoved == c)
 		{
-		    (*k)->setupDeps();
+			tet->setCount(slidx, 0);
+			continue;
 		}
-	}
 
-	for (TriPVecCI t = pTris.begin(); t != tri_end; ++t)
+        double fract = static_cast<double>(c) * (tet->vol() / totalvol);
+        uint n3 = static_cast<uint>(std::floor(fract));
+
+		// BUGFIX 29/09/2010 IH. By not allowing the ceiling here
+		// concentration gradients could appear in the injection.
+        double n3_frac = fract - static_cast<double>(n3);
+        if (n3_frac > 0.0)
+        {
+            double rand01 = rng()->getUnfIE();
+            if (rand01 < n3_frac) n3++;
+        }
+
+        ///
+        // BUGFIX 18/11/09 IH. By reducing c here we were not giving all
+        // tets an equal share. Tets with low index would have a
+        // greater share than those with higher index.
+        //c -= n3;
+        nremoved += n3;
+
+        if (nremoved >= c)
+        {
+            n3 -= (nremoved-c);
+            nremoved = c;
+        }
+
+        tet->setCount(slidx, n3);
+    }
+    assert(nremoved <= c);
+    c -= nremoved;
+	while (c != 0)
 	{
-		// DEBUG: vector holds all possible triangles, but
-		// only patch triangles are filled
-		if ((*t) == 0) continue;
+        WmVol * tet = comp->pickTetByVol(rng()->getUnfIE());
 
-	    KProcPVecCI kprocend = (*t)->kprocEnd();
-	    for (KProcPVecCI k = (*t)->kprocBegin(); k != kprocend; ++k)
-	    {
-	        (*k)->setupDeps();
-	    }
+        assert (tet != 0);
+        tet->setCount(slidx, (tet->count(slidx) + 1.0));
+        c--;
+	}
+	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	{
+		_markSpec(*t, slidx);
 	}
+	if (pBatchDepth == 0) _updateDirty();
+}
 
-	// Create EField structures if EField is to be calculated
-	if (efflag() == true) _setupEField();
+////////////////////////////////////////////////////////////////////////////////
 
-	nEntries = pKProcs.size();
+double stex::Tetexact::_getCompAmount(uint cidx, uint sidx) const
+{
+	// the following method does all the necessary argument checking
+	double count = _getCompCount(cidx, sidx);
+	return (count / smath::AVOGADRO);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setupEField(void)
+void stex::Tetexact::_setCompAmount(uint cidx, uint sidx, double a)
 {
+	// convert amount in mols to number of molecules
+	double a2 = a * steps::math::AVOGADRO;
+	// the following method does all the necessary argument checking
+	_setCompCount(cidx, sidx, a2);
+}
 
-	//// Note to self: for now roughly following flow from original code in sim/controller.py.
-	//// code for setting up a mesh was in func_tetmesh constructor and called functions.
+////////////////////////////////////////////////////////////////////////////////
 
-	assert(efflag() == true);
+double stex::Tetexact::_getCompConc(uint cidx, uint sidx) const
+{
+	// the following method does all the necessary argument checking
+	double count = _getCompCount(cidx, sidx);
+	ssolver::Compdef * comp = statedef()->compdef(cidx);
+	assert(comp != 0);
+	double vol = comp->vol();
+	return count/ (1.0e3 * vol * steps::math::AVOGADRO);
+}
 
-	// Give temperature a default value of 20c
-	pTemp = 293.15;
+////////////////////////////////////////////////////////////////////////////////
 
-	uint nmembs = mesh()->_countMembs();
+void stex::Tetexact::_setCompConc(uint cidx, uint sidx, double c)
+{
+	assert(c >= 0.0);
+	assert (cidx < statedef()->countComps());
+	ssolver::Compdef * comp = statedef()->compdef(cidx);
+	assert(comp != 0);
+	double count = c * (1.0e3 * comp->vol() * steps::math::AVOGADRO);
+	// the following method does all the necessary argument checking
+	_setCompCount(cidx, sidx, count);
+}
 
-	if  (nmembs != 1)
+////////////////////////////////////////////////////////////////////////////////
+
+bool stex::Tetexact::_getCompClamped(uint cidx, uint sidx) const
+{
+	assert(cidx < statedef()->countComps());
+	assert(sidx < statedef()->countSpecs());
+	assert(statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	assert(comp != 0);
+	uint lsidx = comp->def()->specG2L(sidx);
+    if (lsidx == ssolver::LIDX_UNDEFINED)
 	{
 		std::ostringstream os;
-		os << "Membrane potential solver currently supports only one ";
-		os << "membrane description object.";
+		os << "Species undefined in compartment.\n";
 		throw steps::ArgErr(os.str());
 	}
 
-	steps::tetmesh::Memb * memb = mesh()->_getMemb(0);
-	assert(memb != 0);
-
-	// TODO: Decide what checks are needed for the membrane and implement them here
-
-	pEFNTets = memb->countVolTets();
-	pEFNTris = memb->countTris();
-	pEFNVerts = memb->countVerts();
-
-    pEFTets = new uint[neftets() * 4];
-    assert(pEFTets != 0);
-
-    // All the triangles we will count here are the real membrane triangles,
-    // virtual triangles will not require a capacitance.
-    pEFTris = new uint[neftris() * 3];
-    assert(pEFTris != 0);
-
-    pEFVerts = new double[nefverts() * 3];
-    assert(pEFVerts != 0);
-
-    uint nverts = mesh()->countVertices();
-    uint ntris = mesh()->countTris();
-    uint ntets= mesh()->countTets();
-
-    pEFVert_GtoL = new int[nverts];
-    for (uint i=0; i < nverts; ++i) pEFVert_GtoL[i] = -1;
-    pEFTri_GtoL = new int[ntris];
-    for (uint i=0; i< ntris; ++i) pEFTri_GtoL[i] = -1;
-    pEFTet_GtoL = new int[ntets];
-    for (uint i=0; i < ntets; ++i) pEFTet_GtoL[i] = -1;
-
-    pEFTri_LtoG = new uint[neftris()];
-
-    // Copy the data to local structures.
-
-    std::vector<uint> membverts = memb->_getAllVertIndices();
-    assert(membverts.size() == nefverts());
-    for (uint efv = 0; efv < nefverts(); ++efv)
+    WmVolPVecCI t_end = comp->endTet();
+    for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
     {
-    	uint vertidx = membverts[efv];
-    	double* verttemp = mesh()->_getVertex(vertidx);
-    	uint efv2 = efv*3;
+    	if ((*t)->clamped(lsidx) == false) return false;
+    }
+    return true;
+}
 
-    	// CONVERTING TO MICRONS HERE. EFIELD OBJECT WILL NOT PERFORM THIS CONVERSION
-    	pEFVerts[efv2] = verttemp[0] * 1.0e6;
-    	pEFVerts[efv2+1] = verttemp[1] * 1.0e6;
-    	pEFVerts[efv2+2] = verttemp[2] * 1.0e6;
+////////////////////////////////////////////////////////////////////////////////
 
-    	pEFVert_GtoL[vertidx] = efv;
-    }
+void stex::Tetexact::_setCompClamped(uint cidx, uint sidx, bool b)
+{
+	assert(cidx < statedef()->countComps());
+	assert(sidx < statedef()->countSpecs());
+	assert(statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	assert(comp != 0);
+	uint lsidx = comp->def()->specG2L(sidx);
+	if (lsidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
 
-    std::vector<uint> membtets = memb->_getAllVolTetIndices();
-    assert(membtets.size() == neftets());
-    for (uint eft=0; eft < neftets(); ++eft)
-    {
-    	uint tetidx = membtets[eft];
-    	uint* tettemp = mesh()->_getTet(tetidx);
-    	uint eft2 = eft*4;
+	// Set the flag in def object, though this may not be necessary
+	comp->def()->setClamped(lsidx, b);
 
-    	// Convert to indices used by EField object
-    	int tv0 =  pEFVert_GtoL[tettemp[0]];
-    	int tv1 = pEFVert_GtoL[tettemp[1]];
-    	int tv2 = pEFVert_GtoL[tettemp[2]];
-    	int tv3 = pEFVert_GtoL[tettemp[3]];
-    	if  (tv0 ==-1 || tv1 == -1 || tv2 == -1 || tv3 == -1)
-    	{
-    		std::ostringstream os;
-    		os << "Failed to create EField structures.";
-    		throw steps::ProgErr(os.str());
-    	}
+	WmVolPVecCI t_end = comp->endTet();
+	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	{
+		(*t)->setClamped(lsidx, b);
+	}
 
-    	pEFTets[eft2] = tv0;
-    	pEFTets[eft2+1] = tv1;
-    	pEFTets[eft2+2] = tv2;
-    	pEFTets[eft2+3] = tv3;
+	std::vector<stex::WmVol *> vols(comp->bgnTet(), comp->endTet());
+	_clampsChanged(vols, std::vector<stex::Tri *>());
+}
 
-    	pEFTet_GtoL[tetidx] = eft;
-    }
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::_getCompReacK(uint cidx, uint ridx) const
+{
+	assert(cidx < statedef()->countComps());
+	assert(ridx < statedef()->countReacs());
+	assert(statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	assert(comp != 0);
+	uint lridx = comp->def()->reacG2L(ridx);
+	if (lridx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Reaction undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
 
-    std::vector<uint> membtris = memb->_getAllTriIndices();
-    assert(membtris.size() == neftris());
+	// We're just returning the default value for this comp, individual
+	// tets may have different Kcsts set individually
+	return (comp->def()->kcst(lridx));
+}
 
-    pEFTris_vec.resize(neftris());
+////////////////////////////////////////////////////////////////////////////////
 
-    for (uint eft = 0; eft < neftris(); ++eft)
-    {
-    	uint triidx = membtris[eft];
-    	uint* tritemp = mesh()->_getTri(triidx);
-    	uint eft2 = eft*3;
+void stex::Tetexact::_setCompReacK(uint cidx, uint ridx, double kf)
+{
+	_applyCompReacK(cidx, ridx, kf);
 
-    	// Convert to indices used by EField object
-    	int tv0 =  pEFVert_GtoL[tritemp[0]];
-    	int tv1 = pEFVert_GtoL[tritemp[1]];
-    	int tv2 = pEFVert_GtoL[tritemp[2]];
-    	if  (tv0 ==-1 || tv1 == -1 || tv2 == -1)
-    	{
-    		std::ostringstream os;
-    		os << "Failed to create EField structures.";
-    		throw steps::ProgErr(os.str());
-    	}
+	// Rates have changed
+	_update();
+}
 
-    	pEFTris[eft2] = tv0;
-    	pEFTris[eft2+1] = tv1;
-    	pEFTris[eft2+2] = tv2;
+////////////////////////////////////////////////////////////////////////////////
 
-    	pEFTri_GtoL[triidx] = eft;
-    	pEFTri_LtoG[eft] = triidx;
+void stex::Tetexact::_applyCompReacK(uint cidx, uint ridx, double kf)
+{
+	assert(cidx < statedef()->countComps());
+	assert(ridx < statedef()->countReacs());
+	assert(statedef()->countComps() == pComps.size());
+	assert(kf >= 0.0);
+	stex::Comp * comp = _comp(cidx);
+	assert(comp != 0);
+	uint lridx = comp->def()->reacG2L(ridx);
+	if (lridx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Reaction undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
 
-    	// This is added now for quicker iteration during run()
-    	// Extremely important for larger meshes, orders of magnitude times faster
-    	pEFTris_vec[eft] = pTris[triidx];
-    }
+	// First set the default value for the comp
+	comp->def()->setKcst(lridx, kf);
 
-    pEField = new steps::solver::efield::EField(nefverts(), pEFVerts, neftris(), pEFTris, neftets(), pEFTets, memb->_getOpt_method(), memb->_getOpt_file_name());
+	// Now update all tetrahedra in this comp
+	WmVolPVecCI t_end = comp->endTet();
+	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	{
+		(*t)->reac(lridx)->setKcst(kf);
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::saveMembOpt(std::string const & opt_file_name)
+bool stex::Tetexact::_getCompReacActive(uint cidx, uint ridx) const
 {
-	if  (efflag() != true)
+	assert(cidx < statedef()->countComps());
+	assert(ridx < statedef()->countReacs());
+	assert(statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	assert(comp != 0);
+	uint lridx = comp->def()->reacG2L(ridx);
+	if (lridx == ssolver::LIDX_UNDEFINED)
 	{
 		std::ostringstream os;
-		os << "saveMembOpt method only available if running EField ";
+		os << "Reaction undefined in compartment.\n";
 		throw steps::ArgErr(os.str());
 	}
 
-	pEField->saveOptimal(opt_file_name);
-
+	WmVolPVecCI t_end = comp->endTet();
+	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	{
+		if ((*t)->reac(lridx)->inactive() == true) return false;
+	}
+	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-uint stex::Tetexact::_addComp(steps::solver::Compdef * cdef)
+void stex::Tetexact::_setCompReacActive(uint cidx, uint ridx, bool a)
 {
-    stex::Comp * comp = new Comp(cdef);
-    assert(comp != 0);
-    uint compidx = pComps.size();
-    pComps.push_back(comp);
-    pCompMap[cdef] = comp;
-    return compidx;
+	assert(cidx < statedef()->countComps());
+	assert(ridx < statedef()->countReacs());
+	assert(statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	assert(comp != 0);
+	uint lridx = comp->def()->reacG2L(ridx);
+	if (lridx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Reaction undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+
+	// Set the default value for the comp, though this is not entirely
+	// necessary
+	comp->def()->setActive(lridx, a);
+
+	WmVolPVecCI t_end = comp->endTet();
+	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	{
+		(*t)->reac(lridx)->setActive(a);
+	}
+    // It's cheaper to just recompute everything.
+    _update();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-uint stex::Tetexact::_addPatch(steps::solver::Patchdef * pdef)
+double stex::Tetexact::_getCompDiffD(uint cidx, uint didx) const
 {
-    /* Comp * icomp = 0;
-	 Comp * ocomp = 0;
-	 if (pdef->icompdef()) icomp = pCompMap[pdef->icompdef()];
-	 if (pdef->ocompdef()) ocomp = pCompMap[pdef->ocompdef()];
-	 */
-    stex::Patch * patch = new Patch(pdef);
-    assert(patch != 0);
-    uint patchidx = pPatches.size();
-    pPatches.push_back(patch);
-    return patchidx;
+	assert (cidx < statedef()->countComps());
+	assert (didx < statedef()->countDiffs());
+	assert (statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	assert (comp != 0);
+	uint ldidx = comp->def()->diffG2L(didx);
+	if (ldidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Diffusion rule undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+
+	// We're just returning the default value for this comp, individual
+	// tets may have different Dcsts set individually
+	return (comp->def()->dcst(ldidx));
+
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-uint stex::Tetexact::_addDiffBoundary(steps::solver::DiffBoundarydef * dbdef)
+void stex::Tetexact::_setCompDiffD(uint cidx, uint didx, double dk)
 {
-	stex::DiffBoundary * diffb = new DiffBoundary(dbdef);
-	assert(diffb != 0);
-	uint dbidx = pDiffBoundaries.size();
-	pDiffBoundaries.push_back(diffb);
-	return dbidx;
-}
+	assert (cidx < statedef()->countComps());
+	assert (didx < statedef()->countDiffs());
+	assert (statedef()->countComps() == pComps.size());
+	assert(dk >= 0.0);
+	stex::Comp * comp = _comp(cidx);
+	assert (comp != 0);
+	uint ldidx = comp->def()->diffG2L(didx);
+	if (ldidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Diffusion rule undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+
+	// First set the default value for the comp
+	comp->def()->setDcst(ldidx, dk);
+
+	// Now update all tets in this comp
+	WmVolPVecCI t_end = comp->endTet();
+	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	{
+		if (stex::Tet * tet = dynamic_cast<stex::Tet *>(*t))
+		{
+			tet->diff(ldidx)->setDcst(dk);
+		}
+		else
+		{
+			std::ostringstream os;
+			os << "Cannot change diffusion constant in well-mixed compartment.";
+			throw steps::ArgErr(os.str());
+		}
+	}
 
+	// Rates have changed
+	_update();
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_addTet(uint tetidx,
-							 steps::tetexact::Comp * comp, double vol,
-							 double a1, double a2, double a3, double a4,
-							 double d1, double d2, double d3, double d4,
-							 int tet0, int tet1, int tet2, int tet3)
+bool stex::Tetexact::_getCompDiffActive(uint cidx, uint didx) const
 {
-	steps::solver::Compdef * compdef  = comp->def();
-    stex::Tet * localtet = new stex::Tet(tetidx, compdef, vol, a1, a2, a3, a4, d1, d2, d3, d4,
-									     tet0, tet1, tet2, tet3);
-    assert(localtet != 0);
-    assert(tetidx < pTets.size());
-    assert(pTets[tetidx] == 0);
-    pTets[tetidx] = localtet;
-    comp->addTet(localtet);
+	assert (cidx < statedef()->countComps());
+	assert (didx < statedef()->countDiffs());
+	assert (statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	assert (comp != 0);
+	uint ldidx = comp->def()->diffG2L(didx);
+	if (ldidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Diffusion rule undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+
+	WmVolPVecCI t_end = comp->endTet();
+	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	{
+		//stex::WmVol * wmcomp = (*t);
+		if (stex::Tet * tet = dynamic_cast<stex::Tet *>((*t)))
+		{
+			if (tet->diff(ldidx)->inactive() == true) return false;
+		}
+		else
+		{
+			std::ostringstream os;
+			os << "Diffusion activation not defined in well-mixed compartment.\n";
+			throw steps::ArgErr(os.str());
+		}
+	}
+	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_addWmVol(uint cidx, steps::tetexact::Comp * comp, double vol)
+void stex::Tetexact::_setCompDiffActive(uint cidx, uint didx, bool act)
 {
-	steps::solver::Compdef * compdef  = comp->def();
-	stex::WmVol * localtet = new stex::WmVol(cidx, compdef, vol);
-	assert(localtet != 0);
-	assert(cidx < pWmVols.size());
-	pWmVols[cidx] = localtet;
-	comp->addTet(localtet);
+	assert (cidx < statedef()->countComps());
+	assert (didx < statedef()->countDiffs());
+	assert (statedef()->countComps() == pComps.size());
+	stex::Comp * comp = _comp(cidx);
+	assert (comp != 0);
+	uint ldidx = comp->def()->diffG2L(didx);
+	if (ldidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Diffusion rule undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+
+	WmVolPVecCI t_end = comp->endTet();
+	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	{
+		//stex::WmVol * wmcomp = (*t);
+		if (stex::Tet * tet = dynamic_cast<stex::Tet *>((*t)))
+		{
+			tet->diff(ldidx)->setActive(act);
+		}
+		else
+		{
+			std::ostringstream os;
+			os << "Cannot change diffusion constant in well-mixed compartment.\n";
+			throw steps::ArgErr(os.str());
+		}
+	}
+    // It's cheaper to just recompute everything.
+    _update();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_addTri(uint triidx, steps::tetexact::Patch * patch, double area,
-							 double l0, double l1, double l2, double d0, double d1, double d2,  int tinner, int touter, int tri0, int tri1, int tri2)
+double stex::Tetexact::_getPatchArea(uint pidx) const
 {
-    steps::solver::Patchdef * patchdef = patch->def();
-    stex::Tri * tri = new stex::Tri(triidx, patchdef, area, l0, l1, l2, d0, d1, d2,  tinner, touter, tri0, tri1, tri2);
-    assert(tri != 0);
-    assert (triidx < pTris.size());
-    assert (pTris[triidx] == 0);
-    pTris[triidx] = tri;
-    patch->addTri(tri);
+	assert (pidx < statedef()->countPatches());
+	assert (statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert (patch != 0);
+	return patch->area();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::reset(void)
+double stex::Tetexact::_getPatchCount(uint pidx, uint sidx) const
 {
-	std::for_each(pComps.begin(), pComps.end(), std::mem_fun(&Comp::reset));
-	std::for_each(pPatches.begin(), pPatches.end(), std::mem_fun(&Patch::reset));
-
-    TetPVecCI tet_end = pTets.end();
-    for (TetPVecCI tet = pTets.begin(); tet != tet_end; ++tet)
-    {
-    	if (*tet == 0) continue;
-    	(*tet)->reset();
-    }
-
-    WmVolPVecCI wmvol_end = pWmVols.end();
-    for (WmVolPVecCI wmvol = pWmVols.begin(); wmvol != wmvol_end; ++wmvol)
-    {
-    	if ((*wmvol) == 0) continue;
-    	(*wmvol)->reset();
-    }
-
-	TriPVecCI tri_end = pTris.end();
-	for (TriPVecCI t = pTris.begin(); t != tri_end; ++t)
+	assert (pidx < statedef()->countPatches());
+	assert (sidx < statedef()->countSpecs());
+	assert (statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert (patch != 0);
+	uint slidx = patch->def()->specG2L(sidx);
+	if (slidx == ssolver::LIDX_UNDEFINED)
 	{
-		if ((*t) == 0) continue;
-		(*t)->reset();
+		std::ostringstream os;
+		os << "Species undefined in patch.\n";
+		throw steps::ArgErr(os.str());
 	}
+	if (patch->countTotals() == true) return patch->countTotal(slidx);
 
-    uint ngroups = nGroups.size();
-    for (uint i = 0; i < ngroups; i++) {
-        free(nGroups[i]->indices);
-        delete nGroups[i];
-    }
-    nGroups.clear();
-
-    ngroups = pGroups.size();
-    for (uint i = 0; i < ngroups; i++) {
-        free(pGroups[i]->indices);
-        delete pGroups[i];
-    }
-    pGroups.clear();
-
-    pSum = 0.0;
-    nSum = 0.0;
-    pA0 = 0.0;
+	uint count = 0;
+	TriPVecCI t_end = patch->endTri();
+	for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+	{
+		count += (*t)->count(slidx);
+	}
 
-	statedef()->resetTime();
-	statedef()->resetNSteps();
+	return count;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::run(double endtime)
+void stex::Tetexact::_setPatchCount(uint pidx, uint sidx, double n)
 {
-	if (efflag() == false)
+	assert (pidx < statedef()->countPatches());
+	assert (sidx < statedef()->countSpecs());
+	assert (statedef()->countPatches() == pPatches.size());
+	assert (n >= 0.0);
+	stex::Patch * patch = _patch(pidx);
+	assert (patch != 0);
+	uint slidx = patch->def()->specG2L(sidx);
+	if (slidx == ssolver::LIDX_UNDEFINED)
 	{
-		if (endtime < statedef()->time())
-		{
-			std::ostringstream os;
-			os << "Endtime is before current simulation time";
-			throw steps::ArgErr(os.str());
-		}
-		while (statedef()->time() < endtime)
-		{
-			stex::KProc * kp = _getNext();
-			if (kp == 0) break;
-			double a0 = getA0();
-			if (a0 == 0.0) break;
-			double dt = rng()->getExp(a0);
-			if ((statedef()->time() + dt) > endtime) break;
-			_executeStep(kp, dt);
-		}
-		statedef()->setTime(endtime);
+		std::ostringstream os;
+		os << "Species undefined in patch.\n";
+		throw steps::ArgErr(os.str());
 	}
-	else if (efflag() == true)
+	if (n > std::numeric_limits<unsigned int>::max( ))
 	{
-		// Run the simulation, including the EField calculation.
-		// This loop will assume that the SSA dt is sufficiently small so
-		// that a number of SSA events execute between every EField calculation.
-		// A warning message will be printed if the SSA dt is larger than the EField dt.
-		// The EField dt is actually a MAXIMUM dt- the actual time for the EField
-		// calculation will be exact with respect to the last event time in the
-		// SSA before reaching the EField dt.
-		while (statedef()->time() < endtime)
-		{
-			// The zero propensity
-			double a0 = getA0();
-			// We need a bool to check if the SSA contains no possible events. In
-			// this rare case (continue to) execute the EField calculation to the endtime.
-			bool ssa_on = true;
-			double ssa_dt = 0.0;
-			if (a0 != 0.0) ssa_dt = rng()->getExp(a0);
-			else (ssa_on = false);
-			// Set the actual efield dt. This value will take a maximum pEFDT.
-			double ef_dt = 0.0;
+		std::ostringstream os;
+		os << "Can't set count greater than maximum unsigned integer (";
+		os << std::numeric_limits<unsigned int>::max( ) << ").\n";
+		throw steps::ArgErr(os.str());
+	}
 
-			while (ssa_on && (ef_dt + ssa_dt) < pEFDT )
-			{
-				stex::KProc * kp = _getNext();
-				if (kp == 0) break;
-				_executeStep(kp, ssa_dt);
-				ef_dt += ssa_dt;
+	double totalarea = patch->def()->area();
+	TriPVecCI t_end = patch->endTri();
 
-				a0 = getA0();
-				if (a0 != 0.0) ssa_dt = rng()->getExp(a0);
-				else (ssa_on = false);
+	double n_int = std::floor(n);
+	double n_frc = n - n_int;
+	uint c = static_cast<uint>(n_int);
+	if (n_frc > 0.0)
+	{
+		double rand01 = rng()->getUnfIE();
+		if (rand01 < n_frc) c++;
+	}
 
-			}
-			assert(ef_dt < pEFDT);
+	uint nremoved = 0;
+	for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+	{
+		Tri * tri = *t;
 
-			// It's possible that ef_dt is zero here: ssa_dt is large, or has become large.
-			// In that case print a warning but continue, running the EField simulation for EFDT
-			if (ssa_on == false || ef_dt == 0.0)
-			{
-	    		std::ostringstream os;
-	    		//os << "\nWARNING: SSA tau is larger than EField dt.";
-	    		//std::cout << os << std::endl;
-			}
+        if (n == 0.0) {
+            tri->setCount(slidx, 0);
+            continue;
+        }
+		// New method (allowing ceiling) means we have to set the counts
+		// to zero for any triangles after all molecules have been injected
+		if (nremoved == c)
+		{
+			tri->setCount(slidx, 0);
+			continue;
+		}
 
-			if (ef_dt == 0.0)
-			{
-				// This means that tau is larger than EField dt. We have no choice but to
-				// increase the state time by pEFDT.
-				ef_dt = pEFDT;
-				statedef()->incTime(pEFDT);
-			}
+		double fract = static_cast<double>(c) * (tri->area()/totalarea);
+        uint n3 = static_cast<uint>(std::floor(fract));
 
-			// Now to perform the EField calculation. This means finding ohmic and GHK
-			// currents from triangles during the ef_dt and applying these to the EField
-			// object.
+		// BUGFIX 29/09/2010 IH. By not allowing the ceiling here
+		// concentration gradients could appear in the injection.
+        double n3_frac = fract - static_cast<double>(n3);
+        if (n3_frac > 0.0)
+        {
+            double rand01 = rng()->getUnfIE();
+            if (rand01 < n3_frac) n3++;
+        }
 
-			/*
-			 * Older method is much, much slower for larger meshes. e.g. for ~200,000
-			 * tets this method is 2 or 3 orders of magnitude slower than pEFTris_vec method
-			 *
-			for (uint ltidx = 0; ltidx < neftris(); ++ltidx)
-			{
-				uint gtidx = pEFTri_LtoG[ltidx];
+        // BUGFIX 18/11/09 IH. By reducing c here we were not giving all
+        // triangles an equal share. Triangles with low index would have a
+        // greater share than those with higher index.
+        // c -= n3;
+        nremoved += n3;
 
-				Tri * tritemp = tris()[gtidx];
-				// We can use local indices for faster EField method
-				double v = pEField->getTriV(ltidx);
-				// The triangle will compute all GHK and Ohmic currents
-				double cur = tritemp->computeI(v, ef_dt, statedef()->time());
-				pEField->setTriI(ltidx, cur);
-			}
-			*/
+        if (nremoved >= c)
+        {
+            n3 -= (nremoved-c);
+            nremoved = c;
+        }
 
-			TriPVecCI eftri_end = pEFTris_vec.end();
-			uint tlidx = 0;
-			double sttime = statedef()->time();
-			for (TriPVecCI eft = pEFTris_vec.begin(); eft != eftri_end; ++eft)
-			{
-				double v = pEField->getTriV(tlidx);
-				double cur = (*eft)->computeI(v, ef_dt, sttime);
-				pEField->setTriI(tlidx, cur);
-				tlidx++;
-			}
+        tri->setCount(slidx, n3);
 
-			pEField->advance(ef_dt);
-			// TODO: Replace this with something that only resets voltage-dependent things
-			_update();
-		}
 	}
+	assert(nremoved <= c);
+	c -= nremoved;
 
-	else assert(false);
-
-}
-
-////////////////////////////////////////////////////////////////////////
-
-void stex::Tetexact::advance(double adv)
-{
-	if (adv < 0.0)
+	while(c != 0)
 	{
-		std::ostringstream os;
-		os << "Time to advance cannot be negative";
-	    throw steps::ArgErr(os.str());
+		Tri * tri = patch->pickTriByArea(rng()->getUnfIE());
+		assert (tri != 0);
+		tri->setCount(slidx, (tri->count(slidx) + 1.0));
+		c--;
 	}
 
-	double endtime = statedef()->time() + adv;
-	run(endtime);
-}
-
-////////////////////////////////////////////////////////////////////////
-/*
-void stex::Tetexact::advanceSteps(uint nsteps)
-{
-	while (nsteps != 0) {
-        stex::KProc * kp = _getNext();
-        if (kp == 0) return;
-        double a0 = getA0();
-        if (a0 == 0.0) return;
-        double dt = rng()->getExp(a0);
-        _executeStep(kp, dt);
-        nsteps--;
-    }
-}
-*/
-////////////////////////////////////////////////////////////////////////////////
-
-void stex::Tetexact::step(void)
-{
-	if (efflag() == true)
+	for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
 	{
-		std::ostringstream os;
-		os << "Method not available with EField calculation.";
-		throw steps::ArgErr(os.str());
+		_markSpec(*t, slidx);
 	}
-
-	stex::KProc * kp = _getNext();
-	if (kp == 0) return;
-	double a0 = getA0();
-	if (a0 == 0.0) return;
-	double dt = rng()->getExp(a0);
-	_executeStep(kp, dt);
+	if (pBatchDepth == 0) _updateDirty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Tetexact::getTime(void) const
+double stex::Tetexact::_getPatchAmount(uint pidx, uint sidx) const
 {
-	return statedef()->time();
+	// the following method does all the necessary argument checking
+	double count = _getPatchCount(pidx, sidx);
+	return (count / steps::math::AVOGADRO);
 }
 
-////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
 
-uint stex::Tetexact::getNSteps(void) const
+void stex::Tetexact::_setPatchAmount(uint pidx, uint sidx, double a)
 {
-    return statedef()->nsteps();
+	assert(a >= 0.0);
+	// convert amount in mols to number of molecules
+	double a2 = a * steps::math::AVOGADRO;
+	// the following method does all the necessary argument checking
+	_setPatchCount(pidx, sidx, a2);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::setTime(double time)
+bool stex::Tetexact::_getPatchClamped(uint pidx, uint sidx) const
 {
-	statedef()->setTime(time);
+	assert (pidx < statedef()->countPatches());
+	assert (sidx < statedef()->countSpecs());
+	assert(statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert(patch != 0);
+	uint lsidx = patch->def()->specG2L(sidx);
+    if (lsidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in patch.\n";
+		throw steps::ArgErr(os.str());
+	}
+
+    TriPVecCI t_end = patch->endTri();
+    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+    {
+        if ((*t)->clamped(lsidx) == false) return false;
+    }
+    return true;
 }
 
-////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::setNSteps(uint nsteps)
+void stex::Tetexact::_setPatchClamped(uint pidx, uint sidx, bool buf)
 {
-    statedef()->setNSteps(nsteps);
+	assert (pidx < statedef()->countPatches());
+	assert (sidx < statedef()->countSpecs());
+	assert(statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert(patch != 0);
+	uint lsidx = patch->def()->specG2L(sidx);
+    if (lsidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in patch.\n";
+		throw steps::ArgErr(os.str());
+	}
+
+    // Set the flag in def object for consistency, though this is not
+    // entirely necessary
+    patch->def()->setClamped(lsidx, buf);
+
+    TriPVecCI t_end = patch->endTri();
+    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+    {
+        (*t)->setClamped(lsidx, buf);
+    }
+
+    std::vector<stex::Tri *> tris(patch->bgnTri(), patch->endTri());
+    _clampsChanged(std::vector<stex::WmVol *>(), tris);
 }
 
-////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::setTemp(double t)
+double stex::Tetexact::_getPatchSReacK(uint pidx, uint ridx) const
 {
-	if (efflag() == false)
+	assert (pidx < statedef()->countPatches());
+	assert (ridx < statedef()->countSReacs());
+	assert(statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert(patch != 0);
+	uint lsridx = patch->def()->sreacG2L(ridx);
+    if (lsridx == ssolver::LIDX_UNDEFINED)
 	{
 		std::ostringstream os;
-		os << "\nWARNING: Temperature set in simulation without membrane ";
-		os << "potential calculation will be ignored.\n";
-		std::cout << os << std::endl;
+		os << "Surface reaction undefined in patch.\n";
+		throw steps::ArgErr(os.str());
 	}
-	assert(t >= 0.0);
-	pTemp = t;
+
+    // We're just returning the default value for this patch, individual
+    // triangles may have different Kcsts set
+    return (patch->def()->kcst(lsridx));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Tetexact::_getCompVol(uint cidx) const
+void stex::Tetexact::_setPatchSReacK(uint pidx, uint ridx, double kf)
 {
-	assert(cidx < statedef()->countComps());
-	assert (statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	assert(comp != 0);
-	return comp->vol();
+	_applyPatchSReacK(pidx, ridx, kf);
+
+	// Rates have changed
+	_update();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Tetexact::_getCompCount(uint cidx, uint sidx) const
+void stex::Tetexact::_applyPatchSReacK(uint pidx, uint ridx, double kf)
 {
-	assert(cidx < statedef()->countComps());
-	assert(sidx < statedef()->countSpecs());
-	assert (statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	assert(comp != 0);
-	uint slidx = comp->def()->specG2L(sidx);
-	if (slidx == ssolver::LIDX_UNDEFINED)
+	assert (pidx < statedef()->countPatches());
+	assert (ridx < statedef()->countSReacs());
+	assert(statedef()->countPatches() == pPatches.size());
+	assert(kf >= 0.0);
+	stex::Patch * patch = _patch(pidx);
+	assert(patch != 0);
+	uint lsridx = patch->def()->sreacG2L(ridx);
+    if (lsridx == ssolver::LIDX_UNDEFINED)
 	{
 		std::ostringstream os;
-		os << "Species undefined in compartment.\n";
+		os << "Surface reaction undefined in patch.\n";
 		throw steps::ArgErr(os.str());
 	}
 
-	uint count = 0;
-	WmVolPVecCI t_end = comp->endTet();
-	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
-	{
-		count += (*t)->pools()[slidx];
-	}
+    // First set the default values for this patch
+    patch->def()->setKcst(lsridx, kf);
 
-	return count;
+    // Now update all triangles in this patch
+    TriPVecCI t_end = patch->endTri();
+    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+    {
+        (*t)->sreac(lsridx)->setKcst(kf);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setCompCount(uint cidx, uint sidx, double n)
+bool stex::Tetexact::_getPatchSReacActive(uint pidx, uint ridx) const
 {
-	assert(cidx < statedef()->countComps());
-	assert(sidx < statedef()->countSpecs());
-	assert (n >= 0.0);
-	assert (statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	uint slidx = comp->def()->specG2L(sidx);
-	if (slidx == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Species undefined in compartment.\n";
-		throw steps::ArgErr(os.str());
-	}
-	if (n > std::numeric_limits<unsigned int>::max( ))
+	assert (pidx < statedef()->countPatches());
+	assert (ridx < statedef()->countSReacs());
+	assert(statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert(patch != 0);
+	uint lsridx = patch->def()->sreacG2L(ridx);
+    if (lsridx == ssolver::LIDX_UNDEFINED)
 	{
 		std::ostringstream os;
-		os << "Can't set count greater than maximum unsigned integer (";
-		os << std::numeric_limits<unsigned int>::max( ) << ").\n";
+		os << "Surface reaction undefined in patch.\n";
 		throw steps::ArgErr(os.str());
 	}
 
-	double totalvol = comp->def()->vol();
-	WmVolPVecCI t_end = comp->endTet();
-
-	double n_int = std::floor(n);
-	double n_frc = n - n_int;
-	uint c = static_cast<uint>(n_int);
-	if (n_frc > 0.0)
-	{
-		double rand01 = rng()->getUnfIE();
-		if (rand01 < n_frc) c++;
-	}
-
-    uint nremoved = 0;
-    for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+    TriPVecCI t_end = patch->endTri();
+    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
     {
-        WmVol * tet = *t;
-        if (n == 0.0) {
-            tet->setCount(slidx, 0);
-            continue;
-        }
+        if ((*t)->sreac(lsridx)->inactive() == true) return false;
+    }
+    return true;
+}
 
-		// New method (allowing ceiling) means we have to set the counts
-		// to zero for any tets after all molecules have been injected
-		if (nremoved == c)
-		{
-			tet->setCount(slidx, 0);
-			continue;
-		}
+////////////////////////////////////////////////////////////////////////////////
 
-        double fract = static_cast<double>(c) * (tet->vol() / totalvol);
-        uint n3 = static_cast<uint>(std::floor(fract));
+void stex::Tetexact::_setDiffBoundaryDiffusionActive(uint dbidx, uint sidx, bool act)
+{
+	assert (dbidx < statedef()->countDiffBoundaries());
+	assert (sidx < statedef()->countSpecs());
 
-		// BUGFIX 29/09/2010 IH. By not allowing the ceiling here
-		// concentration gradients could appear in the injection.
-        double n3_frac = fract - static_cast<double>(n3);
-        if (n3_frac > 0.0)
-        {
-            double rand01 = rng()->getUnfIE();
-            if (rand01 < n3_frac) n3++;
-        }
+	// Need to do two things:
+	// 1) check if the species is defined in both compartments conencted
+	// by the diffusion boundary
+	// 2) loop over all tetrahedrons around the diff boundary and then the
+	// diffusion rules and activate diffusion if the diffusion rule
+	// relates to this species
 
-        ///
-        // BUGFIX 18/11/09 IH. By reducing c here we were not giving all
-        // tets an equal share. Tets with low index would have a
-        // greater share than those with higher index.
-        //c -= n3;
-        nremoved += n3;
+	stex::DiffBoundary * diffb = _diffboundary(dbidx);
+	stex::Comp * compA = diffb->compA();
+	stex::Comp * compB = diffb->compB();
 
-        if (nremoved >= c)
-        {
-            n3 -= (nremoved-c);
-            nremoved = c;
-        }
+	/*
+	ssolver::Diffdef * diffdef = statedef()->diffdef(didx);
+	uint specgidx = diffdef->lig();
+	*/
+	uint lsidxA = compA->def()->specG2L(sidx);
+	uint lsidxB = compB->def()->specG2L(sidx);
 
-        tet->setCount(slidx, n3);
-    }
-    assert(nremoved <= c);
-    c -= nremoved;
-	while (c != 0)
-	{
-        WmVol * tet = comp->pickTetByVol(rng()->getUnfIE());
 
-        assert (tet != 0);
-        tet->setCount(slidx, (tet->pools()[slidx] + 1.0));
-        c--;
+	if (lsidxA == ssolver::LIDX_UNDEFINED or lsidxB == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in compartments connected by diffusion boundary.\n";
+		throw steps::ArgErr(os.str());
 	}
-	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+
+	std::vector<uint> bdtets = diffb->getTets();
+	std::vector<uint> bdtetsdir = diffb->getTetDirection();
+
+	// Have to use indices rather than iterator because need access to the
+	// tet direction
+	uint ntets = bdtets.size();
+
+	for (uint bdt = 0; bdt != ntets; ++bdt)
 	{
-		_updateSpec(*t, slidx);
+		stex::Tet * tet = _tet(bdtets[bdt]);
+		uint direction = bdtetsdir[bdt];
+		assert(direction >= 0 and direction < 4);
+
+		// Each diff kproc then has access to the species through it's defined parent
+		uint ndiffs = tet->compdef()->countDiffs();
+		for (uint d = 0; d != ndiffs; ++d)
+		{
+			stex::Diff * diff = tet->diff(d);
+			// sidx is the global species index; so is the lig() return from diffdef
+			uint specgidx = diff->def()->lig();
+			if (specgidx == sidx)
+			{
+				diff->setDiffBndActive(direction, act);
+			}
+		}
 	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Tetexact::_getCompAmount(uint cidx, uint sidx) const
+bool stex::Tetexact::_getDiffBoundaryDiffusionActive(uint dbidx, uint sidx) const
 {
-	// the following method does all the necessary argument checking
-	double count = _getCompCount(cidx, sidx);
-	return (count / smath::AVOGADRO);
-}
+	assert (dbidx < statedef()->countDiffBoundaries());
+	assert (sidx < statedef()->countSpecs());
 
-////////////////////////////////////////////////////////////////////////////////
+	stex::DiffBoundary * diffb = _diffboundary(dbidx);
+	stex::Comp * compA = diffb->compA();
+	stex::Comp * compB = diffb->compB();
 
-void stex::Tetexact::_setCompAmount(uint cidx, uint sidx, double a)
-{
-	// convert amount in mols to number of molecules
-	double a2 = a * steps::math::AVOGADRO;
-	// the following method does all the necessary argument checking
-	_setCompCount(cidx, sidx, a2);
-}
+	uint lsidxA = compA->def()->specG2L(sidx);
+	uint lsidxB = compB->def()->specG2L(sidx);
 
-////////////////////////////////////////////////////////////////////////////////
+	if (lsidxA == ssolver::LIDX_UNDEFINED or lsidxB == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in compartments connected by diffusion boundary.\n";
+		throw steps::ArgErr(os.str());
+	}
 
-double stex::Tetexact::_getCompConc(uint cidx, uint sidx) const
-{
-	// the following method does all the necessary argument checking
-	double count = _getCompCount(cidx, sidx);
-	ssolver::Compdef * comp = statedef()->compdef(cidx);
-	assert(comp != 0);
-	double vol = comp->vol();
-	return count/ (1.0e3 * vol * steps::math::AVOGADRO);
-}
+	std::vector<uint> bdtets = diffb->getTets();
+	std::vector<uint> bdtetsdir = diffb->getTetDirection();
 
-////////////////////////////////////////////////////////////////////////////////
+	// Have to use indices rather than iterator because need access to the
+	// tet direction
 
-void stex::Tetexact::_setCompConc(uint cidx, uint sidx, double c)
-{
-	assert(c >= 0.0);
-	assert (cidx < statedef()->countComps());
-	ssolver::Compdef * comp = statedef()->compdef(cidx);
-	assert(comp != 0);
-	double count = c * (1.0e3 * comp->vol() * steps::math::AVOGADRO);
-	// the following method does all the necessary argument checking
-	_setCompCount(cidx, sidx, count);
+	uint ntets = bdtets.size();
+
+	for (uint bdt = 0; bdt != ntets; ++bdt)
+	{
+		stex::Tet * tet = _tet(bdtets[bdt]);
+		uint direction = bdtetsdir[bdt];
+		assert(direction >= 0 and direction < 4);
+
+		// Each diff kproc then has access to the species through it's defined parent
+		uint ndiffs = tet->compdef()->countDiffs();
+		for (uint d = 0; d != ndiffs; ++d)
+		{
+			stex::Diff * diff = tet->diff(d);
+			// sidx is the global species index; so is the lig() return from diffdef
+			uint specgidx = diff->def()->lig();
+			if (specgidx == sidx)
+			{
+				// Just need to check the first one
+				if (diff->getDiffBndActive(direction)) return true;
+				else return false;
+			}
+		}
+	}
+	return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool stex::Tetexact::_getCompClamped(uint cidx, uint sidx) const
+void stex::Tetexact::_setPatchSReacActive(uint pidx, uint ridx, bool a)
 {
-	assert(cidx < statedef()->countComps());
-	assert(sidx < statedef()->countSpecs());
-	assert(statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	assert(comp != 0);
-	uint lsidx = comp->def()->specG2L(sidx);
-    if (lsidx == ssolver::LIDX_UNDEFINED)
+	assert (pidx < statedef()->countPatches());
+	assert (ridx < statedef()->countSReacs());
+	assert(statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert(patch != 0);
+	uint lsridx = patch->def()->sreacG2L(ridx);
+    if (lsridx == ssolver::LIDX_UNDEFINED)
 	{
 		std::ostringstream os;
-		os << "Species undefined in compartment.\n";
+		os << "Surface reaction undefined in patch.\n";
 		throw steps::ArgErr(os.str());
 	}
 
-    WmVolPVecCI t_end = comp->endTet();
-    for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+    // First set the flags in def object for consistency, though this is
+    // not entirely necessary for this solver
+    patch->def()->setActive(lsridx, a);
+
+    TriPVecCI t_end = patch->endTri();
+    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
     {
-    	if ((*t)->clamped(lsidx) == false) return false;
+        (*t)->sreac(lsridx)->setActive(a);
     }
-    return true;
+    // It's cheaper to just recompute everything.
+    _update();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setCompClamped(uint cidx, uint sidx, bool b)
+bool stex::Tetexact::_getPatchVDepSReacActive(uint pidx, uint vsridx) const
 {
-	assert(cidx < statedef()->countComps());
-	assert(sidx < statedef()->countSpecs());
-	assert(statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	assert(comp != 0);
-	uint lsidx = comp->def()->specG2L(sidx);
-	if (lsidx == ssolver::LIDX_UNDEFINED)
+	assert (pidx < statedef()->countPatches());
+	assert (vsridx < statedef()->countVDepSReacs());
+	assert(statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert(patch != 0);
+	uint lvsridx = patch->def()->vdepsreacG2L(vsridx);
+    if (lvsridx == ssolver::LIDX_UNDEFINED)
 	{
 		std::ostringstream os;
-		os << "Species undefined in compartment.\n";
+		os << "Voltage-dependent surface reaction undefined in patch.\n";
 		throw steps::ArgErr(os.str());
 	}
 
-	// Set the flag in def object, though this may not be necessary
-	comp->def()->setClamped(lsidx, b);
-
-	WmVolPVecCI t_end = comp->endTet();
-	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
-	{
-		(*t)->setClamped(lsidx, b);
-	}
+    TriPVecCI t_end = patch->endTri();
+    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+    {
+        if ((*t)->vdepsreac(lvsridx)->inactive() == true) return false;
+    }
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Tetexact::_getCompReacK(uint cidx, uint ridx) const
+void stex::Tetexact::_setPatchVDepSReacActive(uint pidx, uint vsridx, bool a)
 {
-	assert(cidx < statedef()->countComps());
-	assert(ridx < statedef()->countReacs());
-	assert(statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	assert(comp != 0);
-	uint lridx = comp->def()->reacG2L(ridx);
-	if (lridx == ssolver::LIDX_UNDEFINED)
+	assert (pidx < statedef()->countPatches());
+	assert (vsridx < statedef()->countVDepSReacs());
+	assert(statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert(patch != 0);
+	uint lvsridx = patch->def()->vdepsreacG2L(vsridx);
+    if (lvsridx == ssolver::LIDX_UNDEFINED)
 	{
 		std::ostringstream os;
-		os << "Reaction undefined in compartment.\n";
+		os << "Voltage-dependent surface reaction undefined in patch.\n";
 		throw steps::ArgErr(os.str());
 	}
 
-	// We're just returning the default value for this comp, individual
-	// tets may have different Kcsts set individually
-	return (comp->def()->kcst(lridx));
+    // Not necessary and not possible to set the flags in def object
+
+    TriPVecCI t_end = patch->endTri();
+    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+    {
+        (*t)->vdepsreac(lvsridx)->setActive(a);
+    }
+    // It's cheaper to just recompute everything.
+    _update();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setCompReacK(uint cidx, uint ridx, double kf)
+bool stex::Tetexact::_getPatchSDiffActive(uint pidx, uint didx) const
 {
-	assert(cidx < statedef()->countComps());
-	assert(ridx < statedef()->countReacs());
-	assert(statedef()->countComps() == pComps.size());
-	assert(kf >= 0.0);
-	stex::Comp * comp = _comp(cidx);
-	assert(comp != 0);
-	uint lridx = comp->def()->reacG2L(ridx);
-	if (lridx == ssolver::LIDX_UNDEFINED)
+	assert (pidx < statedef()->countPatches());
+	assert (didx < statedef()->countSurfDiffs());
+	assert(statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert(patch != 0);
+	uint ldidx = patch->def()->surfdiffG2L(didx);
+    if (ldidx == ssolver::LIDX_UNDEFINED)
 	{
 		std::ostringstream os;
-		os << "Reaction undefined in compartment.\n";
+		os << "Surface diffusion rule undefined in patch.\n";
 		throw steps::ArgErr(os.str());
 	}
 
-	// First set the default value for the comp
-	comp->def()->setKcst(lridx, kf);
-
-	// Now update all tetrahedra in this comp
-	WmVolPVecCI t_end = comp->endTet();
-	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
-	{
-		(*t)->reac(lridx)->setKcst(kf);
-	}
-
-	// Rates have changed
-	_update();
+    TriPVecCI t_end = patch->endTri();
+    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+    {
+        if ((*t)->sdiff(ldidx)->inactive() == true) return false;
+    }
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool stex::Tetexact::_getCompReacActive(uint cidx, uint ridx) const
+void stex::Tetexact::_setPatchSDiffActive(uint pidx, uint didx, bool act)
 {
-	assert(cidx < statedef()->countComps());
-	assert(ridx < statedef()->countReacs());
-	assert(statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	assert(comp != 0);
-	uint lridx = comp->def()->reacG2L(ridx);
-	if (lridx == ssolver::LIDX_UNDEFINED)
+	assert (pidx < statedef()->countPatches());
+	assert (didx < statedef()->countSurfDiffs());
+	assert(statedef()->countPatches() == pPatches.size());
+	stex::Patch * patch = _patch(pidx);
+	assert(patch != 0);
+	uint ldidx = patch->def()->surfdiffG2L(didx);
+    if (ldidx == ssolver::LIDX_UNDEFINED)
 	{
 		std::ostringstream os;
-		os << "Reaction undefined in compartment.\n";
+		os << "Surface diffusion rule undefined in patch.\n";
 		throw steps::ArgErr(os.str());
 	}
 
-	WmVolPVecCI t_end = comp->endTet();
-	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
-	{
-		if ((*t)->reac(lridx)->inactive() == true) return false;
-	}
-	return true;
+    TriPVecCI t_end = patch->endTri();
+    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+    {
+        (*t)->sdiff(ldidx)->setActive(act);
+    }
+    // It's cheaper to just recompute everything.
+    _update();
 }
-
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setCompReacActive(uint cidx, uint ridx, bool a)
+void stex::Tetexact::addKProc(steps::tetexact::KProc * kp)
 {
-	assert(cidx < statedef()->countComps());
-	assert(ridx < statedef()->countReacs());
-	assert(statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	assert(comp != 0);
-	uint lridx = comp->def()->reacG2L(ridx);
-	if (lridx == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Reaction undefined in compartment.\n";
-		throw steps::ArgErr(os.str());
-	}
+	assert (kp != 0);
+
+	SchedIDX nidx = pKProcs.size();
+	pKProcs.push_back(kp);
+	kp->setSchedIDX(nidx);
+}
 
-	// Set the default value for the comp, though this is not entirely
-	// necessary
-	comp->def()->setActive(lridx, a);
+////////////////////////////////////////////////////////////////////////////////
 
-	WmVolPVecCI t_end = comp->endTet();
-	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+double stex::Tetexact::_rate(steps::tetexact::KProc * kp)
+{
+	// The qualified calls are not virtual and, for the inline rates of
+	// Reac and Diff, can be inlined.
+	switch (kp->type())
 	{
-		(*t)->reac(lridx)->setActive(a);
+		case KP_REAC:
+			return static_cast<Reac *>(kp)->Reac::rate(this);
+		case KP_DIFF:
+			return static_cast<Diff *>(kp)->Diff::rate(this);
+		case KP_SREAC:
+			return static_cast<SReac *>(kp)->SReac::rate(this);
+		case KP_SDIFF:
+			return static_cast<SDiff *>(kp)->SDiff::rate(this);
+		case KP_VDEPTRANS:
+			if (pVDepLump > 0.0) return _vdepLumpRate(kp);
+			if (pVDepWindow > 0.0)
+			{
+				uint slot = pVDepSlot[kp->schedIDX() - pKProcTypeBegin[KP_VDEPTRANS]];
+				return static_cast<VDepTrans *>(kp)->rate(pVDepBatchKMax[slot]);
+			}
+			return static_cast<VDepTrans *>(kp)->VDepTrans::rate(this);
+		case KP_VDEPSREAC:
+			if (pVDepWindow > 0.0)
+			{
+				uint slot = pVDepSlot[kp->schedIDX() - pKProcTypeBegin[KP_VDEPTRANS]];
+				return static_cast<VDepSReac *>(kp)->rate(pVDepBatchKMax[slot]);
+			}
+			return static_cast<VDepSReac *>(kp)->VDepSReac::rate(this);
+		case KP_GHKCURR:
+			return static_cast<GHKcurr *>(kp)->GHKcurr::rate(this);
+		default:
+			assert(false);
+			return kp->rate(this);
 	}
-    // It's cheaper to just recompute everything.
-    _update();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Tetexact::_getCompDiffD(uint cidx, uint didx) const
+void stex::Tetexact::_update(KProcIdxSpan const & upd_entries)
 {
-	assert (cidx < statedef()->countComps());
-	assert (didx < statedef()->countDiffs());
-	assert (statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	assert (comp != 0);
-	uint ldidx = comp->def()->diffG2L(didx);
-	if (ldidx == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Diffusion rule undefined in compartment.\n";
-		throw steps::ArgErr(os.str());
+	#ifdef SSA_DEBUG
+	std::cout << "SSA: update selected entries\n";
+	#endif
+	double t = statedef()->time();
+	uint n_upd_entries = upd_entries.size();
+
+	for (uint i = 0; i < n_upd_entries; i++) {
+		uint sidx = upd_entries[i];
+		pScheduler->update(sidx, _rate(pKProcs[sidx]), t);
 	}
+	_commit(t);
+	#ifdef SSA_DEBUG
+	std::cout << "--------------------------------------------------------\n";
+	#endif
+}
 
-	// We're just returning the default value for this comp, individual
-	// tets may have different Dcsts set individually
-	return (comp->def()->dcst(ldidx));
+////////////////////////////////////////////////////////////////////////////////
 
+template <class T>
+void stex::Tetexact::_updateRange(uint begin, uint end, double t)
+{
+	for (uint i = begin; i < end; i++) {
+		T * kp = static_cast<T *>(pKProcs[i]);
+		pScheduler->update(i, kp->T::rate(this), t);
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setCompDiffD(uint cidx, uint didx, double dk)
+void stex::Tetexact::_setupVDepBatches(void)
 {
-	assert (cidx < statedef()->countComps());
-	assert (didx < statedef()->countDiffs());
-	assert (statedef()->countComps() == pComps.size());
-	assert(dk >= 0.0);
-	stex::Comp * comp = _comp(cidx);
-	assert (comp != 0);
-	uint ldidx = comp->def()->diffG2L(didx);
-	if (ldidx == ssolver::LIDX_UNDEFINED)
+	// Bucket the kprocs by rule, VDepTrans rules first.
+	uint ntrans = statedef()->countVDepTrans();
+	uint nsreacs = statedef()->countVDepSReacs();
+	std::vector<std::vector<KProc *> > groups(ntrans + nsreacs);
+	pVDepOtherKProcs.clear();
+	uint nvdep = pVdepKProcs.size();
+	for (uint i = 0; i < nvdep; ++i)
 	{
-		std::ostringstream os;
-		os << "Diffusion rule undefined in compartment.\n";
-		throw steps::ArgErr(os.str());
+		KProc * kp = pVdepKProcs[i];
+		if (kp->type() == KP_VDEPTRANS)
+		{
+			groups[static_cast<VDepTrans *>(kp)->vdeptransdef()->gidx()].push_back(kp);
+		}
+		else if (kp->type() == KP_VDEPSREAC)
+		{
+			groups[ntrans + static_cast<VDepSReac *>(kp)->vdepsreacdef()->gidx()].push_back(kp);
+		}
+		else
+		{
+			pVDepOtherKProcs.push_back(kp);
+		}
 	}
 
-	// First set the default value for the comp
-	comp->def()->setDcst(ldidx, dk);
-
-	// Now update all tets in this comp
-	WmVolPVecCI t_end = comp->endTet();
-	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	// Empty groups are dropped; pVDepNTransBatches counts the rest of
+	// the VDepTrans ones.
+	pVDepBatchKProcs.clear();
+	pVDepBatchTri.clear();
+	pVDepBatchBegin.assign(1, 0);
+	pVDepNTransBatches = 0;
+	for (uint g = 0; g < groups.size(); ++g)
 	{
-		if (stex::Tet * tet = dynamic_cast<stex::Tet *>(*t))
+		if (groups[g].empty()) continue;
+		if (g < ntrans) ++pVDepNTransBatches;
+		for (uint i = 0; i < groups[g].size(); ++i)
 		{
-			tet->diff(ldidx)->setDcst(dk);
+			KProc * kp = groups[g][i];
+			Tri * tri = (kp->type() == KP_VDEPTRANS)
+			          ? static_cast<VDepTrans *>(kp)->tri()
+			          : static_cast<VDepSReac *>(kp)->tri();
+			assert(pEFTri_GtoL[tri->idx()] >= 0);
+			pVDepBatchKProcs.push_back(kp);
+			pVDepBatchTri.push_back(pEFTri_GtoL[tri->idx()]);
 		}
-		else
+		pVDepBatchBegin.push_back(pVDepBatchKProcs.size());
+	}
+	pVDepBatchV.resize(pVDepBatchKProcs.size());
+	pVDepBatchK.resize(pVDepBatchKProcs.size());
+
+	// The batch position of each VDepTrans and VDepSReac kproc.
+	uint b = pKProcTypeBegin[KP_VDEPTRANS];
+	uint n = pVDepBatchKProcs.size();
+	pVDepSlot.assign(pKProcTypeBegin[KP_VDEPSREAC + 1] - b, 0);
+	for (uint i = 0; i < n; ++i)
+	{
+		pVDepSlot[pVDepBatchKProcs[i]->schedIDX() - b] = i;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_setupSpecKProcs(std::vector<WmVol *> const & vols)
+{
+	uint ncomps = statedef()->countComps();
+	pCompSpecKProcs.assign(ncomps, std::vector<std::vector<uint> >());
+	std::vector<WmVol *>::const_iterator v_end = vols.end();
+	for (std::vector<WmVol *>::const_iterator v = vols.begin(); v != v_end; ++v)
+	{
+		ssolver::Compdef * cdef = (*v)->compdef();
+		std::vector<std::vector<uint> > & specs = pCompSpecKProcs[cdef->gidx()];
+		if (specs.empty() == false) continue;
+
+		uint nspecs = cdef->countSpecs();
+		specs.resize(nspecs);
+		KProcPVecCI k_bgn = (*v)->kprocBegin();
+		KProcPVecCI k_end = (*v)->kprocEnd();
+		for (uint l = 0; l < nspecs; ++l)
 		{
-			std::ostringstream os;
-			os << "Cannot change diffusion constant in well-mixed compartment.";
-			throw steps::ArgErr(os.str());
+			uint gidx = cdef->specL2G(l);
+			for (KProcPVecCI k = k_bgn; k != k_end; ++k)
+			{
+				if ((*k)->depSpecTet(gidx, *v) == true) specs[l].push_back(k - k_bgn);
+			}
 		}
 	}
 
-	// Rates have changed
-	_update();
+	pDirtyKProcs.clear();
+	pDirtyFlags.assign(pKProcs.size(), false);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool stex::Tetexact::_getCompDiffActive(uint cidx, uint didx) const
+void stex::Tetexact::_setupGHKTables(void)
 {
-	assert (cidx < statedef()->countComps());
-	assert (didx < statedef()->countDiffs());
-	assert (statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	assert (comp != 0);
-	uint ldidx = comp->def()->diffG2L(didx);
-	if (ldidx == ssolver::LIDX_UNDEFINED)
+	// Without a valid temperature the currents are computed exactly.
+	if (pTemp <= 0.0) return;
+	uint nghk = statedef()->countGHKcurrs();
+	for (uint i = 0; i < nghk; ++i)
 	{
-		std::ostringstream os;
-		os << "Diffusion rule undefined in compartment.\n";
-		throw steps::ArgErr(os.str());
+		statedef()->ghkcurrdef(i)->setupFluxTable(pTemp);
 	}
+}
 
-	WmVolPVecCI t_end = comp->endTet();
-	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_updateVDep(void)
+{
+	double t = statedef()->time();
+	// With the rejection scheduling on, the batches are only updated
+	// where a potential left its window.
+	uint n = 0;
+	if (pVDepLump > 0.0) _updateVDepLumps(t, false);
+	if (pVDepWindow > 0.0) _updateVDepWindows(t, false);
+	else n = pVDepBatchKProcs.size();
+	if (n != 0)
 	{
-		//stex::WmVol * wmcomp = (*t);
-		if (stex::Tet * tet = dynamic_cast<stex::Tet *>((*t)))
+		// The potentials after the EField step.
+		pEField->getTriVs(&pEFTriV[0]);
+		for (uint i = 0; i < n; ++i)
 		{
-			if (tet->diff(ldidx)->inactive() == true) return false;
+			pVDepBatchV[i] = pEFTriV[pVDepBatchTri[i]];
+		}
+	}
+
+	// Lumped VDepTrans batches are done.
+	uint nbatches = (n == 0) ? 0 : pVDepBatchBegin.size() - 1;
+	uint g0 = (pVDepLump > 0.0) ? pVDepNTransBatches : 0;
+	for (uint g = g0; g < nbatches; ++g)
+	{
+		uint b = pVDepBatchBegin[g];
+		uint e = pVDepBatchBegin[g + 1];
+		double const * v = &pVDepBatchV[b];
+		double * k = &pVDepBatchK[b];
+		double vmin = v[0];
+		double vmax = v[0];
+		for (uint i = 1; i < e - b; ++i)
+		{
+			vmin = std::min(vmin, v[i]);
+			vmax = std::max(vmax, v[i]);
+		}
+
+		if (g < pVDepNTransBatches)
+		{
+			ssolver::VDepTransdef * def = static_cast<VDepTrans *>(pVDepBatchKProcs[b])->vdeptransdef();
+			def->checkVRange(vmin, vmax);
+			def->getVDepRates(e - b, v, k);
+			for (uint i = b; i < e; ++i)
+			{
+				VDepTrans * kp = static_cast<VDepTrans *>(pVDepBatchKProcs[i]);
+				pScheduler->update(kp->schedIDX(), kp->rate(pVDepBatchK[i]), t);
+			}
 		}
 		else
 		{
-			std::ostringstream os;
-			os << "Diffusion activation not defined in well-mixed compartment.\n";
-			throw steps::ArgErr(os.str());
+			ssolver::VDepSReacdef * def = static_cast<VDepSReac *>(pVDepBatchKProcs[b])->vdepsreacdef();
+			def->checkVRange(vmin, vmax);
+			def->getVDepKs(e - b, v, k);
+			for (uint i = b; i < e; ++i)
+			{
+				VDepSReac * kp = static_cast<VDepSReac *>(pVDepBatchKProcs[i]);
+				pScheduler->update(kp->schedIDX(), kp->rate(pVDepBatchK[i]), t);
+			}
 		}
 	}
-	return true;
+
+	uint nother = pVDepOtherKProcs.size();
+	for (uint i = 0; i < nother; ++i)
+	{
+		KProc * kp = pVDepOtherKProcs[i];
+		pScheduler->update(kp->schedIDX(), _rate(kp), t);
+	}
+	_commit(t);
 }
 
-////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setCompDiffActive(uint cidx, uint didx, bool act)
+void stex::Tetexact::_updateVDepWindows(double t, bool all)
 {
-	assert (cidx < statedef()->countComps());
-	assert (didx < statedef()->countDiffs());
-	assert (statedef()->countComps() == pComps.size());
-	stex::Comp * comp = _comp(cidx);
-	assert (comp != 0);
-	uint ldidx = comp->def()->diffG2L(didx);
-	if (ldidx == ssolver::LIDX_UNDEFINED)
+	uint n = pVDepBatchKProcs.size();
+	if (n == 0) return;
+	pEField->getTriVs(&pEFTriV[0]);
+	for (uint i = 0; i < n; ++i)
 	{
-		std::ostringstream os;
-		os << "Diffusion rule undefined in compartment.\n";
-		throw steps::ArgErr(os.str());
+		pVDepBatchV[i] = pEFTriV[pVDepBatchTri[i]];
 	}
 
-	WmVolPVecCI t_end = comp->endTet();
-	for (WmVolPVecCI t = comp->bgnTet(); t != t_end; ++t)
+	double w = pVDepWindow;
+	uint nbatches = pVDepBatchBegin.size() - 1;
+	uint g0 = (pVDepLump > 0.0) ? pVDepNTransBatches : 0;
+	for (uint g = g0; g < nbatches; ++g)
 	{
-		//stex::WmVol * wmcomp = (*t);
-		if (stex::Tet * tet = dynamic_cast<stex::Tet *>((*t)))
+		uint b = pVDepBatchBegin[g];
+		uint e = pVDepBatchBegin[g + 1];
+		double vmin = pVDepBatchV[b];
+		double vmax = pVDepBatchV[b];
+		for (uint i = b + 1; i < e; ++i)
 		{
-			tet->diff(ldidx)->setActive(act);
+			vmin = std::min(vmin, pVDepBatchV[i]);
+			vmax = std::max(vmax, pVDepBatchV[i]);
+		}
+
+		bool trans = (g < pVDepNTransBatches);
+		ssolver::VDepTransdef * tdef = 0;
+		ssolver::VDepSReacdef * sdef = 0;
+		if (trans == true)
+		{
+			tdef = static_cast<VDepTrans *>(pVDepBatchKProcs[b])->vdeptransdef();
+			tdef->checkVRange(vmin, vmax);
 		}
 		else
 		{
-			std::ostringstream os;
-			os << "Cannot change diffusion constant in well-mixed compartment.\n";
-			throw steps::ArgErr(os.str());
+			sdef = static_cast<VDepSReac *>(pVDepBatchKProcs[b])->vdepsreacdef();
+			sdef->checkVRange(vmin, vmax);
+		}
+
+		for (uint i = b; i < e; ++i)
+		{
+			double v = pVDepBatchV[i];
+			if (all == false && std::fabs(v - pVDepBatchVC[i]) <= w) continue;
+			if (all == false) pVDepNMoved += 1.0;
+			pVDepBatchVC[i] = v;
+			KProc * kp = pVDepBatchKProcs[i];
+			if (trans == true)
+			{
+				pVDepBatchKMax[i] = tdef->getVDepRateMax(v - w, v + w);
+				pScheduler->update(kp->schedIDX(), static_cast<VDepTrans *>(kp)->rate(pVDepBatchKMax[i]), t);
+			}
+			else
+			{
+				pVDepBatchKMax[i] = sdef->getVDepKMax(v - w, v + w);
+				pScheduler->update(kp->schedIDX(), static_cast<VDepSReac *>(kp)->rate(pVDepBatchKMax[i]), t);
+			}
 		}
 	}
-    // It's cheaper to just recompute everything.
-    _update();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Tetexact::_getPatchArea(uint pidx) const
+bool stex::Tetexact::_vdepReject(KProc * kp)
 {
-	assert (pidx < statedef()->countPatches());
-	assert (statedef()->countPatches() == pPatches.size());
-	stex::Patch * patch = _patch(pidx);
-	assert (patch != 0);
-	return patch->area();
+	if (pVDepWindow <= 0.0) return false;
+	uint ty = kp->type();
+	if (ty != KP_VDEPTRANS && ty != KP_VDEPSREAC) return false;
+	if (ty == KP_VDEPTRANS && pVDepLump > 0.0) return false;
+
+	// Thinning: the scheduler fired the bound, which the exact rate at
+	// the current potential does not exceed.
+	double bound = _rate(kp);
+	double exact = (ty == KP_VDEPTRANS)
+	             ? static_cast<VDepTrans *>(kp)->VDepTrans::rate(this)
+	             : static_cast<VDepSReac *>(kp)->VDepSReac::rate(this);
+	pVDepNCand += 1.0;
+	if (rng()->getUnfIE() * bound < exact) return false;
+	pVDepNReject += 1.0;
+	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Tetexact::_getPatchCount(uint pidx, uint sidx) const
+void stex::Tetexact::_updateVDepLumps(double t, bool all)
 {
-	assert (pidx < statedef()->countPatches());
-	assert (sidx < statedef()->countSpecs());
-	assert (statedef()->countPatches() == pPatches.size());
-	stex::Patch * patch = _patch(pidx);
-	assert (patch != 0);
-	uint slidx = patch->def()->specG2L(sidx);
-	if (slidx == ssolver::LIDX_UNDEFINED)
+	uint n = pVDepLumpOf.size();
+	if (n == 0) return;
+	if (all == true)
 	{
-		std::ostringstream os;
-		os << "Species undefined in patch.\n";
-		throw steps::ArgErr(os.str());
+		// Start again from empty lumps.
+		std::fill(pVDepLumpOf.begin(), pVDepLumpOf.end(), ssolver::LIDX_UNDEFINED);
+		std::fill(pVDepLumpHost.begin(), pVDepLumpHost.end(), 0);
+		for (uint i = 0; i < n; ++i) pVDepLumpMembers[i].clear();
+		pVDepLumpMap.clear();
+		for (uint g = 0; g < pVDepNTransBatches; ++g)
+		{
+			std::vector<uint> & fr = pVDepLumpFree[g];
+			fr.clear();
+			for (uint i = pVDepBatchBegin[g + 1]; i > pVDepBatchBegin[g]; --i)
+			{
+				fr.push_back(i - 1);
+			}
+		}
 	}
 
-	uint count = 0;
-	TriPVecCI t_end = patch->endTri();
-	for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+	pEField->getTriVs(&pEFTriV[0]);
+	for (uint i = 0; i < n; ++i)
 	{
-		count += (*t)->pools()[slidx];
+		pVDepBatchV[i] = pEFTriV[pVDepBatchTri[i]];
 	}
 
-	return count;
-}
+	// The hosts whose entry changed.
+	std::vector<uint> touched;
+	double dv = pVDepLump;
+	for (uint g = 0; g < pVDepNTransBatches; ++g)
+	{
+		uint b = pVDepBatchBegin[g];
+		uint e = pVDepBatchBegin[g + 1];
+		double vmin = pVDepBatchV[b];
+		double vmax = pVDepBatchV[b];
+		for (uint i = b + 1; i < e; ++i)
+		{
+			vmin = std::min(vmin, pVDepBatchV[i]);
+			vmax = std::max(vmax, pVDepBatchV[i]);
+		}
+		ssolver::VDepTransdef * def = static_cast<VDepTrans *>(pVDepBatchKProcs[b])->vdeptransdef();
+		def->checkVRange(vmin, vmax);
 
-////////////////////////////////////////////////////////////////////////////////
+		for (uint i = b; i < e; ++i)
+		{
+			int bin = static_cast<int>(std::floor(pVDepBatchV[i] / dv));
+			uint h = pVDepLumpOf[i];
+			if (h != ssolver::LIDX_UNDEFINED && pVDepLumpBin[h] == bin) continue;
+			if (all == false) pVDepNMoved += 1.0;
 
-void stex::Tetexact::_setPatchCount(uint pidx, uint sidx, double n)
-{
-	assert (pidx < statedef()->countPatches());
-	assert (sidx < statedef()->countSpecs());
-	assert (statedef()->countPatches() == pPatches.size());
-	assert (n >= 0.0);
-	stex::Patch * patch = _patch(pidx);
-	assert (patch != 0);
-	uint slidx = patch->def()->specG2L(sidx);
-	if (slidx == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Species undefined in patch.\n";
-		throw steps::ArgErr(os.str());
-	}
-	if (n > std::numeric_limits<unsigned int>::max( ))
-	{
-		std::ostringstream os;
-		os << "Can't set count greater than maximum unsigned integer (";
-		os << std::numeric_limits<unsigned int>::max( ) << ").\n";
-		throw steps::ArgErr(os.str());
-	}
+			// Leave the old lump, releasing its host when it empties.
+			if (h != ssolver::LIDX_UNDEFINED)
+			{
+				std::vector<uint> & mem = pVDepLumpMembers[h];
+				uint last = mem.back();
+				mem[pVDepLumpPos[i]] = last;
+				pVDepLumpPos[last] = pVDepLumpPos[i];
+				mem.pop_back();
+				pVDepLumpNSum[h] -= pVDepLumpN[i];
+				if (mem.empty() == true)
+				{
+					pVDepLumpMap.erase(std::make_pair(g, pVDepLumpBin[h]));
+					pVDepLumpHost[h] = 0;
+					pVDepLumpFree[g].push_back(h);
+				}
+				touched.push_back(h);
+			}
 
-	double totalarea = patch->def()->area();
-	TriPVecCI t_end = patch->endTri();
+			// Join the lump of the new bin, creating it if needed.
+			std::pair<uint, int> key(g, bin);
+			std::map<std::pair<uint, int>, uint>::iterator l = pVDepLumpMap.find(key);
+			if (l == pVDepLumpMap.end())
+			{
+				assert(pVDepLumpFree[g].empty() == false);
+				h = pVDepLumpFree[g].back();
+				pVDepLumpFree[g].pop_back();
+				pVDepLumpHost[h] = 1;
+				pVDepLumpBin[h] = bin;
+				pVDepLumpK[h] = def->getVDepRateClipped((bin + 0.5) * dv);
+				pVDepLumpNSum[h] = 0.0;
+				pVDepLumpMap.insert(std::make_pair(key, h));
+			}
+			else
+			{
+				h = l->second;
+			}
+			VDepTrans * kp = static_cast<VDepTrans *>(pVDepBatchKProcs[i]);
+			pVDepLumpOf[i] = h;
+			pVDepLumpPos[i] = pVDepLumpMembers[h].size();
+			pVDepLumpMembers[h].push_back(i);
+			pVDepLumpN[i] = kp->rate(1.0);
+			pVDepLumpNSum[h] += pVDepLumpN[i];
+			touched.push_back(h);
+		}
+	}
 
-	double n_int = std::floor(n);
-	double n_frc = n - n_int;
-	uint c = static_cast<uint>(n_int);
-	if (n_frc > 0.0)
+	// After a rebuild every entry is rewritten, otherwise only the
+	// hosts that changed.
+	if (all == true)
 	{
-		double rand01 = rng()->getUnfIE();
-		if (rand01 < n_frc) c++;
+		touched.resize(n);
+		for (uint i = 0; i < n; ++i) touched[i] = i;
 	}
-
-	uint nremoved = 0;
-	for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+	uint ntouched = touched.size();
+	for (uint j = 0; j < ntouched; ++j)
 	{
-		Tri * tri = *t;
-
-        if (n == 0.0) {
-            tri->setCount(slidx, 0);
-            continue;
-        }
-		// New method (allowing ceiling) means we have to set the counts
-		// to zero for any triangles after all molecules have been injected
-		if (nremoved == c)
-		{
-			tri->setCount(slidx, 0);
-			continue;
-		}
-
-		double fract = static_cast<double>(c) * (tri->area()/totalarea);
-        uint n3 = static_cast<uint>(std::floor(fract));
-
-		// BUGFIX 29/09/2010 IH. By not allowing the ceiling here
-		// concentration gradients could appear in the injection.
-        double n3_frac = fract - static_cast<double>(n3);
-        if (n3_frac > 0.0)
-        {
-            double rand01 = rng()->getUnfIE();
-            if (rand01 < n3_frac) n3++;
-        }
+		uint h = touched[j];
+		double a = (pVDepLumpHost[h] != 0) ? pVDepLumpK[h] * pVDepLumpNSum[h] : 0.0;
+		pScheduler->update(pVDepBatchKProcs[h]->schedIDX(), a, t);
+	}
+}
 
-        // BUGFIX 18/11/09 IH. By reducing c here we were not giving all
-        // triangles an equal share. Triangles with low index would have a
-        // greater share than those with higher index.
-        // c -= n3;
-        nremoved += n3;
+////////////////////////////////////////////////////////////////////////////////
 
-        if (nremoved >= c)
-        {
-            n3 -= (nremoved-c);
-            nremoved = c;
-        }
+double stex::Tetexact::_vdepLumpRate(KProc * kp)
+{
+	uint i = pVDepSlot[kp->schedIDX() - pKProcTypeBegin[KP_VDEPTRANS]];
+	uint h = pVDepLumpOf[i];
+	if (h == ssolver::LIDX_UNDEFINED) return 0.0;
 
-        tri->setCount(slidx, n3);
+	double n = static_cast<VDepTrans *>(kp)->rate(1.0);
+	if (n != pVDepLumpN[i])
+	{
+		pVDepLumpNSum[h] += n - pVDepLumpN[i];
+		pVDepLumpN[i] = n;
+		// The caller updates kp's own entry.
+		if (h != i)
+		{
+			pScheduler->update(pVDepBatchKProcs[h]->schedIDX(),
+			                   pVDepLumpK[h] * pVDepLumpNSum[h],
+			                   statedef()->time());
+		}
+	}
+	return (pVDepLumpHost[i] != 0) ? pVDepLumpK[i] * pVDepLumpNSum[i] : 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
 
+stex::KProc * stex::Tetexact::_vdepLumpPick(KProc * kp)
+{
+	if (pVDepLump <= 0.0 || kp->type() != KP_VDEPTRANS) return kp;
+	uint h = pVDepSlot[kp->schedIDX() - pKProcTypeBegin[KP_VDEPTRANS]];
+	assert(pVDepLumpHost[h] != 0);
+
+	// The counts are whole numbers, so the sum is exact.
+	std::vector<uint> const & mem = pVDepLumpMembers[h];
+	double sel = rng()->getUnfIE() * pVDepLumpNSum[h];
+	uint nmem = mem.size();
+	uint last = mem[0];
+	for (uint m = 0; m < nmem; ++m)
+	{
+		if (pVDepLumpN[mem[m]] <= 0.0) continue;
+		last = mem[m];
+		if (sel < pVDepLumpN[last]) break;
+		sel -= pVDepLumpN[last];
 	}
-	assert(nremoved <= c);
-	c -= nremoved;
+	return pVDepBatchKProcs[last];
+}
 
-	while(c != 0)
+////////
+
+void stex::Tetexact::_update(void)
+{
+	#ifdef SSA_DEBUG
+	std::cout << "SSA: update all entries\n";
+	#endif
+	double t = statedef()->time();
+	uint * b = pKProcTypeBegin;
+	_updateRange<Reac>(b[KP_REAC], b[KP_REAC + 1], t);
+	_updateRange<Diff>(b[KP_DIFF], b[KP_DIFF + 1], t);
+	_updateRange<SReac>(b[KP_SREAC], b[KP_SREAC + 1], t);
+	_updateRange<SDiff>(b[KP_SDIFF], b[KP_SDIFF + 1], t);
+	if (pVDepLump > 0.0) _updateVDepLumps(t, true);
+	if (pVDepWindow > 0.0)
 	{
-		Tri * tri = patch->pickTriByArea(rng()->getUnfIE());
-		assert (tri != 0);
-		tri->setCount(slidx, (tri->pools()[slidx] + 1.0));
-		c--;
+		_updateVDepWindows(t, true);
 	}
+	else
+	{
+		if (pVDepLump <= 0.0)
+		{
+			_updateRange<VDepTrans>(b[KP_VDEPTRANS], b[KP_VDEPTRANS + 1], t);
+		}
+		_updateRange<VDepSReac>(b[KP_VDEPSREAC], b[KP_VDEPSREAC + 1], t);
+	}
+	_updateRange<GHKcurr>(b[KP_GHKCURR], b[KP_GHKCURR + 1], t);
+	_commit(t);
+	#ifdef SSA_DEBUG
+	std::cout << "--------------------------------------------------------\n";
+	#endif
+}
 
-	for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_updateElement(KProc * kp)
+{
+	// Within a batch, only mark it; _endBatch updates.
+	if (pBatchDepth > 0)
 	{
-		_updateSpec(*t, slidx);
+		if (pDirtyFlags[kp->schedIDX()] == false)
+		{
+			pDirtyFlags[kp->schedIDX()] = true;
+			pDirtyKProcs.push_back(kp);
+		}
+		return;
 	}
+	double t = statedef()->time();
+	pScheduler->update(kp->schedIDX(), _rate(kp), t);
+	_commit(t);
+}
 
-	// Rates have changed
+////////////////////////////////////////////////////////////////////////////////
+/*
+void stex::Tetexact::_build(void)
+{
+	assert (pBuilt == false);
+
+    pBuilt = true;
 }
+*/
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+/*
+void stex::Tetexact::_reset(void)
+{
 
+}
+*/
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Tetexact::_getPatchAmount(uint pidx, uint sidx) const
+uint stex::Tetexact::_getNext(double & dt)
 {
-	// the following method does all the necessary argument checking
-	double count = _getPatchCount(pidx, sidx);
-	return (count / steps::math::AVOGADRO);
+	if (pProfiling == false) return pScheduler->getNext(statedef()->time(), dt);
+
+	double t0 = wallTime();
+	uint kidx = pScheduler->getNext(statedef()->time(), dt);
+	pProfGetNext += wallTime() - t0;
+	return kidx;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setPatchAmount(uint pidx, uint sidx, double a)
+uint stex::Tetexact::_nextEvent(double & dt)
 {
-	assert(a >= 0.0);
-	// convert amount in mols to number of molecules
-	double a2 = a * steps::math::AVOGADRO;
-	// the following method does all the necessary argument checking
-	_setPatchCount(pidx, sidx, a2);
+	if (pPendingKProc == sssa::SCHED_IDX_UNDEFINED) return _getNext(dt);
+
+	uint kidx = pPendingKProc;
+	dt = pPendingTime - statedef()->time();
+	pPendingKProc = sssa::SCHED_IDX_UNDEFINED;
+	return kidx;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool stex::Tetexact::_getPatchClamped(uint pidx, uint sidx) const
+void stex::Tetexact::_commit(double t)
 {
-	assert (pidx < statedef()->countPatches());
-	assert (sidx < statedef()->countSpecs());
-	assert(statedef()->countPatches() == pPatches.size());
-	stex::Patch * patch = _patch(pidx);
-	assert(patch != 0);
-	uint lsidx = patch->def()->specG2L(sidx);
-    if (lsidx == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Species undefined in patch.\n";
-		throw steps::ArgErr(os.str());
-	}
+	pScheduler->commit(t);
+	_dropPending();
+}
 
-    TriPVecCI t_end = patch->endTri();
-    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_executeStep(steps::tetexact::KProc * kp, double dt)
+{
+    if (pProfiling == true)
     {
-        if ((*t)->clamped(lsidx) == false) return false;
+        _executeStepProfiled(kp, dt);
+        return;
     }
-    return true;
+    if (kp->depsResolved() == false) _resolveDeps(kp);
+    if (pElemEventsOn == true) _countElementEvent(kp);
+    KProcIdxSpan upd = kp->apply(rng(), dt, statedef()->time());
+    if (pFluxFirst.empty() == false) _countFlux(kp);
+    statedef()->incTime(dt);
+    statedef()->incNSteps(1);
+    if (pEventTrace != 0) pEventTrace->add(statedef()->time(), kp->schedIDX());
+    // Propensities are updated at the time of the event.
+    _update(upd);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setPatchClamped(uint pidx, uint sidx, bool buf)
+void stex::Tetexact::_countElementEvent(steps::tetexact::KProc * kp)
 {
-	assert (pidx < statedef()->countPatches());
-	assert (sidx < statedef()->countSpecs());
-	assert(statedef()->countPatches() == pPatches.size());
-	stex::Patch * patch = _patch(pidx);
-	assert(patch != 0);
-	uint lsidx = patch->def()->specG2L(sidx);
-    if (lsidx == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Species undefined in patch.\n";
-		throw steps::ArgErr(os.str());
-	}
+    uint e = pElemEventElem[kp->schedIDX()];
+    if (e != ELEM_EVENTS_NONE) pElemEvents[e * KP_NTYPES + kp->type()] += 1.0;
+}
 
-    // Set the flag in def object for consistency, though this is not
-    // entirely necessary
-    patch->def()->setClamped(lsidx, buf);
+////////////////////////////////////////////////////////////////////////////////
 
-    TriPVecCI t_end = patch->endTri();
-    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+/// The end of the flux entries of a kproc.
+///
+static const uint FLUX_ENTRY_NONE = 0xFFFFFFFF;
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_countFlux(steps::tetexact::KProc * kp)
+{
+    uint e = pFluxFirst[kp->schedIDX()];
+    if (e == FLUX_ENTRY_NONE) return;
+    uint dir = 0;
+    if (kp->type() == KP_DIFF) dir = static_cast<stex::Diff *>(kp)->lastDir();
+    for (; e != FLUX_ENTRY_NONE; e = pFluxEntries[e].next)
     {
-        (*t)->setClamped(lsidx, buf);
+        FluxEntry const & fe = pFluxEntries[e];
+        pFluxCounts[fe.counter] += fe.sign[dir];
     }
-
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-double stex::Tetexact::_getPatchSReacK(uint pidx, uint ridx) const
+void stex::Tetexact::_resolveDeps(steps::tetexact::KProc * kp)
 {
-	assert (pidx < statedef()->countPatches());
-	assert (ridx < statedef()->countSReacs());
-	assert(statedef()->countPatches() == pPatches.size());
-	stex::Patch * patch = _patch(pidx);
-	assert(patch != 0);
-	uint lsridx = patch->def()->sreacG2L(ridx);
-    if (lsridx == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Surface reaction undefined in patch.\n";
-		throw steps::ArgErr(os.str());
-	}
+    kp->setupDeps(pArena);
+    kp->setDepsResolved(true);
+}
 
-    // We're just returning the default value for this patch, individual
-    // triangles may have different Kcsts set
-    return (patch->def()->kcst(lsridx));
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_resolveAllDeps(void)
+{
+    KProcPVecCI k_end = pKProcs.end();
+    for (KProcPVecCI k = pKProcs.begin(); k != k_end; ++k)
+    {
+        if ((*k)->depsResolved() == false) _resolveDeps(*k);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setPatchSReacK(uint pidx, uint ridx, double kf)
+void stex::Tetexact::_clampsChanged(std::vector<stex::WmVol *> const & vols,
+                                    std::vector<stex::Tri *> const & tris)
 {
-	assert (pidx < statedef()->countPatches());
-	assert (ridx < statedef()->countSReacs());
-	assert(statedef()->countPatches() == pPatches.size());
-	assert(kf >= 0.0);
-	stex::Patch * patch = _patch(pidx);
-	assert(patch != 0);
-	uint lsridx = patch->def()->sreacG2L(ridx);
-    if (lsridx == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Surface reaction undefined in patch.\n";
-		throw steps::ArgErr(os.str());
-	}
+    // The kprocs that can change the pools: those of the elements, of
+    // the triangles of the volumes, and the diffusions from neighbouring
+    // tetrahedrons and triangles. Their lists also draw on the index of
+    // the elements they change, which for the surface reactions of a
+    // triangle includes its tetrahedrons.
+    std::set<stex::KProc *> kprocs;
+    std::set<stex::WmVol *> ivols;
+    std::set<stex::Tri *> itris;
+    for (uint i = 0; i < vols.size(); ++i)
+    {
+        stex::WmVol * v = vols[i];
+        ivols.insert(v);
+        kprocs.insert(v->kprocBegin(), v->kprocEnd());
+        std::vector<stex::Tri *>::const_iterator tri_end = v->nexttriEnd();
+        for (std::vector<stex::Tri *>::const_iterator tri = v->nexttriBegin();
+             tri != tri_end; ++tri)
+        {
+            if ((*tri) == 0) continue;
+            itris.insert(*tri);
+            kprocs.insert((*tri)->kprocBegin(), (*tri)->kprocEnd());
+            ivols.insert((*tri)->iTet());
+            if ((*tri)->oTet() != 0) ivols.insert((*tri)->oTet());
+        }
+        stex::Tet * tet = dynamic_cast<stex::Tet *>(v);
+        if (tet == 0) continue;
+        for (uint j = 0; j < 4; ++j)
+        {
+            stex::Tet * next = tet->nextTet(j);
+            if (next == 0) continue;
+            ivols.insert(next);
+            kprocs.insert(next->kprocBegin(), next->kprocEnd());
+        }
+    }
+    for (uint i = 0; i < tris.size(); ++i)
+    {
+        stex::Tri * t = tris[i];
+        itris.insert(t);
+        kprocs.insert(t->kprocBegin(), t->kprocEnd());
+        ivols.insert(t->iTet());
+        if (t->oTet() != 0) ivols.insert(t->oTet());
+        for (uint j = 0; j < 3; ++j)
+        {
+            stex::Tri * next = t->nextTri(j);
+            if (next == 0) continue;
+            itris.insert(next);
+            kprocs.insert(next->kprocBegin(), next->kprocEnd());
+        }
+    }
 
-    // First set the default values for this patch
-    patch->def()->setKcst(lsridx, kf);
+    // With lazydeps the index is kept; otherwise it is rebuilt for the
+    // elements involved and freed again.
+    if (pLazyDeps == false)
+    {
+        std::set<stex::WmVol *>::const_iterator v_end = ivols.end();
+        for (std::set<stex::WmVol *>::const_iterator v = ivols.begin(); v != v_end; ++v)
+        {
+            (*v)->setupSpecDeps();
+        }
+        std::set<stex::Tri *>::const_iterator t_end = itris.end();
+        for (std::set<stex::Tri *>::const_iterator t = itris.begin(); t != t_end; ++t)
+        {
+            (*t)->setupSpecDeps();
+        }
+    }
 
-    // Now update all triangles in this patch
-    TriPVecCI t_end = patch->endTri();
-    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+    // Lists still pending pick up the clamps when they are resolved.
+    std::set<stex::KProc *>::const_iterator k_end = kprocs.end();
+    for (std::set<stex::KProc *>::const_iterator k = kprocs.begin(); k != k_end; ++k)
     {
-        (*t)->sreac(lsridx)->setKcst(kf);
+        if ((*k)->depsResolved() == true) (*k)->setupDeps(pArena);
     }
+    pArena.clearShared();
 
-	// Rates have changed
-	_update();
+    if (pLazyDeps == false)
+    {
+        std::set<stex::WmVol *>::const_iterator v_end = ivols.end();
+        for (std::set<stex::WmVol *>::const_iterator v = ivols.begin(); v != v_end; ++v)
+        {
+            (*v)->clearSpecDeps();
+        }
+        std::set<stex::Tri *>::const_iterator t_end = itris.end();
+        for (std::set<stex::Tri *>::const_iterator t = itris.begin(); t != t_end; ++t)
+        {
+            (*t)->clearSpecDeps();
+        }
+    }
+    pClampDeps = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool stex::Tetexact::_getPatchSReacActive(uint pidx, uint ridx) const
+void stex::Tetexact::_dropPruning(void)
 {
-	assert (pidx < statedef()->countPatches());
-	assert (ridx < statedef()->countSReacs());
-	assert(statedef()->countPatches() == pPatches.size());
-	stex::Patch * patch = _patch(pidx);
-	assert(patch != 0);
-	uint lsridx = patch->def()->sreacG2L(ridx);
-    if (lsridx == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Surface reaction undefined in patch.\n";
-		throw steps::ArgErr(os.str());
-	}
+    if (pPruning == false) return;
+    pPruning = false;
+    pPruneDead.clear();
+    pPrunedSpecs.clear();
+    pPrunedReacs.clear();
+    if (pNPruned == 0) return;
+    pNPruned = 0;
 
-    TriPVecCI t_end = patch->endTri();
-    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
+    KProcPVecCI k_end = pKProcs.end();
+    for (KProcPVecCI k = pKProcs.begin(); k != k_end; ++k)
     {
-        if ((*t)->sreac(lsridx)->inactive() == true) return false;
+        (*k)->setPruned(false);
     }
-    return true;
+    std::vector<stex::WmVol *> vols;
+    std::vector<stex::Tri *> tris;
+    allElements(pWmVols, pTets, pTris, vols, tris);
+    _clampsChanged(vols, tris);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setDiffBoundaryDiffusionActive(uint dbidx, uint sidx, bool act)
+uint stex::Tetexact::_pruneLoc(std::string const & loc) const
 {
-	assert (dbidx < statedef()->countDiffBoundaries());
-	assert (sidx < statedef()->countSpecs());
+    ssolver::Statedef * sd = statedef();
+    for (uint c = 0; c < sd->countComps(); ++c)
+    {
+        if (sd->compdef(c)->name() == loc) return c;
+    }
+    for (uint p = 0; p < sd->countPatches(); ++p)
+    {
+        if (sd->patchdef(p)->name() == loc) return sd->countComps() + p;
+    }
+    std::ostringstream os;
+    os << "No compartment or patch named '" << loc << "'.\n";
+    throw steps::ArgErr(os.str());
+}
 
-	// Need to do two things:
-	// 1) check if the species is defined in both compartments conencted
-	// by the diffusion boundary
-	// 2) loop over all tetrahedrons around the diff boundary and then the
-	// diffusion rules and activate diffusion if the diffusion rule
-	// relates to this species
+////////////////////////////////////////////////////////////////////////////////
 
-	stex::DiffBoundary * diffb = _diffboundary(dbidx);
-	stex::Comp * compA = diffb->compA();
-	stex::Comp * compB = diffb->compB();
+void stex::Tetexact::_allClampsChanged(void)
+{
+    std::vector<stex::WmVol *> vols;
+    bool clamped = false;
+    WmVolPVecCI wmv_end = pWmVols.end();
+    for (WmVolPVecCI wmv = pWmVols.begin(); wmv != wmv_end; ++wmv)
+    {
+        if ((*wmv) == 0) continue;
+        vols.push_back(*wmv);
+        if ((*wmv)->pools().anyClamped() == true) clamped = true;
+    }
+    TetPVecCI tet_end = pTets.end();
+    for (TetPVecCI t = pTets.begin(); t != tet_end; ++t)
+    {
+        if ((*t) == 0) continue;
+        vols.push_back(*t);
+        if ((*t)->pools().anyClamped() == true) clamped = true;
+    }
+    std::vector<stex::Tri *> tris;
+    TriPVecCI tri_end = pTris.end();
+    for (TriPVecCI t = pTris.begin(); t != tri_end; ++t)
+    {
+        if ((*t) == 0) continue;
+        tris.push_back(*t);
+        if ((*t)->pools().anyClamped() == true) clamped = true;
+    }
+    if (pClampDeps == false && clamped == false) return;
 
-	/*
-	ssolver::Diffdef * diffdef = statedef()->diffdef(didx);
-	uint specgidx = diffdef->lig();
-	*/
-	uint lsidxA = compA->def()->specG2L(sidx);
-	uint lsidxB = compB->def()->specG2L(sidx);
+    _clampsChanged(vols, tris);
+    pClampDeps = clamped;
+}
 
+////////////////////////////////////////////////////////////////////////////////
 
-	if (lsidxA == ssolver::LIDX_UNDEFINED or lsidxB == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Species undefined in compartments connected by diffusion boundary.\n";
-		throw steps::ArgErr(os.str());
-	}
+uint stex::Tetexact::getNResolvedKProcs(void) const
+{
+    uint n = 0;
+    KProcPVecCI k_end = pKProcs.end();
+    for (KProcPVecCI k = pKProcs.begin(); k != k_end; ++k)
+    {
+        if ((*k)->depsResolved() == true) ++n;
+    }
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_executeStepProfiled(steps::tetexact::KProc * kp, double dt)
+{
+    uint ty = kp->type();
+    if (kp->depsResolved() == false) _resolveDeps(kp);
+    if (pElemEventsOn == true) _countElementEvent(kp);
+    double t0 = wallTime();
+    KProcIdxSpan upd = kp->apply(rng(), dt, statedef()->time());
+    if (pFluxFirst.empty() == false) _countFlux(kp);
+    double t1 = wallTime();
+    statedef()->incTime(dt);
+    statedef()->incNSteps(1);
+    if (pEventTrace != 0) pEventTrace->add(statedef()->time(), kp->schedIDX());
+    _update(upd);
+    double t2 = wallTime();
 
-	std::vector<uint> bdtets = diffb->getTets();
-	std::vector<uint> bdtetsdir = diffb->getTetDirection();
+    pProfEvents[ty] += 1.0;
+    pProfUpdates[ty] += upd.size();
+    pProfApply[ty] += t1 - t0;
+    pProfUpdate[ty] += t2 - t1;
+}
 
-	// Have to use indices rather than iterator because need access to the
-	// tet direction
-	uint ntets = bdtets.size();
+////////////////////////////////////////////////////////////////////////////////
 
-	for (uint bdt = 0; bdt != ntets; ++bdt)
+void stex::Tetexact::_leapSetup(void)
+{
+	// This is redone at every run() call, as diffusion constants and
+	// hence the split of hops over the neighbours may have changed.
+	pLeapVol.clear();
+	pLeapLidx.clear();
+	pLeapHOR.clear();
+	pLeapHORn.clear();
+	pLeapAble.assign(nEntries, 0);
+	pLeapLhsStart.assign(1, 0);
+	pLeapLhsSpec.clear();
+	pLeapLhsN.clear();
+	pLeapUpdStart.assign(1, 0);
+	pLeapUpdSpec.clear();
+	pLeapUpdN.clear();
+	pLeapUpdVar.clear();
+	pLeapUpdExact.clear();
+
+	std::map<std::pair<WmVol *, uint>, uint> specidx;
+	std::vector<LeapTerm> lhs, upd;
+	for (uint i = 0; i < nEntries; ++i)
 	{
-		stex::Tet * tet = _tet(bdtets[bdt]);
-		uint direction = bdtetsdir[bdt];
-		assert(direction >= 0 and direction < 4);
+		lhs.clear();
+		upd.clear();
+		if (pKProcs[i]->leapStoich(lhs, upd) == true)
+		{
+			pLeapAble[i] = 1;
+		}
+		else
+		{
+			lhs.clear();
+			upd.clear();
+		}
 
-		// Each diff kproc then has access to the species through it's defined parent
-		uint ndiffs = tet->compdef()->countDiffs();
-		for (uint d = 0; d != ndiffs; ++d)
+		uint order = 0;
+		for (std::vector<LeapTerm>::const_iterator l = lhs.begin(); l != lhs.end(); ++l)
 		{
-			stex::Diff * diff = tet->diff(d);
-			// sidx is the global species index; so is the lig() return from diffdef
-			uint specgidx = diff->def()->lig();
-			if (specgidx == sidx)
+			order += static_cast<uint>(l->n);
+		}
+		for (uint pass = 0; pass < 2; ++pass)
+		{
+			std::vector<LeapTerm> const & terms = (pass == 0 ? lhs : upd);
+			for (std::vector<LeapTerm>::const_iterator l = terms.begin(); l != terms.end(); ++l)
 			{
-				diff->setDiffBndActive(direction, act);
+				std::pair<WmVol *, uint> key(l->vol, l->lidx);
+				std::map<std::pair<WmVol *, uint>, uint>::const_iterator s = specidx.find(key);
+				uint sidx;
+				if (s == specidx.end())
+				{
+					sidx = pLeapVol.size();
+					specidx[key] = sidx;
+					pLeapVol.push_back(l->vol);
+					pLeapLidx.push_back(l->lidx);
+					pLeapHOR.push_back(0);
+					pLeapHORn.push_back(0);
+				}
+				else sidx = s->second;
+
+				if (pass == 0)
+				{
+					uint n = static_cast<uint>(l->n);
+					pLeapLhsSpec.push_back(sidx);
+					pLeapLhsN.push_back(n);
+					if (order > pLeapHOR[sidx] || (order == pLeapHOR[sidx] && n > pLeapHORn[sidx]))
+					{
+						pLeapHOR[sidx] = order;
+						pLeapHORn[sidx] = n;
+					}
+				}
+				else
+				{
+					pLeapUpdSpec.push_back(sidx);
+					pLeapUpdN.push_back(l->n);
+					pLeapUpdVar.push_back(l->var);
+					pLeapUpdExact.push_back(l->exact ? 1 : 0);
+				}
 			}
 		}
+		pLeapLhsStart.push_back(pLeapLhsSpec.size());
+		pLeapUpdStart.push_back(pLeapUpdSpec.size());
 	}
+
+	uint nspecs = pLeapVol.size();
+	pLeapRate.assign(nEntries, 0.0);
+	pLeapCrit.assign(nEntries, 0);
+	pLeapK.assign(nEntries, 0);
+	pLeapMu.assign(nspecs, 0.0);
+	pLeapSigma.assign(nspecs, 0.0);
+	pLeapReactant.assign(nspecs, 0);
+	pLeapDelta.assign(nspecs, 0.0);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool stex::Tetexact::_getDiffBoundaryDiffusionActive(uint dbidx, uint sidx) const
+void stex::Tetexact::_runTauLeap(double endtime)
 {
-	assert (dbidx < statedef()->countDiffBoundaries());
-	assert (sidx < statedef()->countSpecs());
+	_leapSetup();
+	uint nspecs = pLeapVol.size();
+	steps::rng::RNG * r = rng();
 
-	stex::DiffBoundary * diffb = _diffboundary(dbidx);
-	stex::Comp * compA = diffb->compA();
-	stex::Comp * compB = diffb->compB();
+	while (statedef()->time() < endtime)
+	{
+		double t = statedef()->time();
 
-	uint lsidxA = compA->def()->specG2L(sidx);
-	uint lsidxB = compB->def()->specG2L(sidx);
+		// Propensities, and which kprocs are critical.
+		double a0 = 0.0;
+		double ac = 0.0;
+		for (uint j = 0; j < nEntries; ++j)
+		{
+			double a = _rate(pKProcs[j]);
+			pLeapRate[j] = a;
+			a0 += a;
+			bool crit = (pLeapAble[j] == 0);
+			if (crit == false && a > 0.0)
+			{
+				uint l_end = pLeapLhsStart[j + 1];
+				for (uint l = pLeapLhsStart[j]; l < l_end; ++l)
+				{
+					uint s = pLeapLhsSpec[l];
+					if (pLeapVol[s]->clamped(pLeapLidx[s]) == true) continue;
+					if (_leapCount(s) < pLeapNCrit * pLeapLhsN[l])
+					{
+						crit = true;
+						break;
+					}
+				}
+			}
+			pLeapCrit[j] = crit ? 1 : 0;
+			if (crit == true) ac += a;
+		}
+		if (a0 <= 0.0) break;
+
+		// Mean and variance of the change of each species per unit time
+		// from the non-critical kprocs.
+		std::fill(pLeapMu.begin(), pLeapMu.end(), 0.0);
+		std::fill(pLeapSigma.begin(), pLeapSigma.end(), 0.0);
+		std::fill(pLeapReactant.begin(), pLeapReactant.end(), 0);
+		for (uint j = 0; j < nEntries; ++j)
+		{
+			double a = pLeapRate[j];
+			if (pLeapCrit[j] == 1 || a <= 0.0) continue;
+			uint l_end = pLeapLhsStart[j + 1];
+			for (uint l = pLeapLhsStart[j]; l < l_end; ++l)
+			{
+				pLeapReactant[pLeapLhsSpec[l]] = 1;
+			}
+			uint u_end = pLeapUpdStart[j + 1];
+			for (uint u = pLeapUpdStart[j]; u < u_end; ++u)
+			{
+				uint s = pLeapUpdSpec[u];
+				pLeapMu[s] += pLeapUpdN[u] * a;
+				pLeapSigma[s] += pLeapUpdVar[u] * a;
+			}
+		}
 
-	if (lsidxA == ssolver::LIDX_UNDEFINED or lsidxB == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Species undefined in compartments connected by diffusion boundary.\n";
-		throw steps::ArgErr(os.str());
-	}
+		// Cao, Gillespie and Petzold, J Chem Phys 124, 044109 (2006),
+		// eq. 33: bound the relative change of all reactant species.
+		double tau1 = std::numeric_limits<double>::infinity();
+		for (uint s = 0; s < nspecs; ++s)
+		{
+			if (pLeapReactant[s] == 0) continue;
+			double x = _leapCount(s);
+			uint hor = pLeapHOR[s];
+			uint horn = pLeapHORn[s];
+			double g = hor;
+			if (hor == 2 && horn == 2 && x > 1.0)
+			{
+				g = 2.0 + 1.0 / (x - 1.0);
+			}
+			else if (hor == 3 && horn == 2 && x > 1.0)
+			{
+				g = 1.5 * (2.0 + 1.0 / (x - 1.0));
+			}
+			else if (hor == 3 && horn == 3 && x > 2.0)
+			{
+				g = 3.0 + 1.0 / (x - 1.0) + 2.0 / (x - 2.0);
+			}
+			double bound = std::max(pLeapEps * x / g, 1.0);
+			double mu = fabs(pLeapMu[s]);
+			if (mu > 0.0) tau1 = std::min(tau1, bound / mu);
+			if (pLeapSigma[s] > 0.0) tau1 = std::min(tau1, bound * bound / pLeapSigma[s]);
+		}
 
-	std::vector<uint> bdtets = diffb->getTets();
-	std::vector<uint> bdtetsdir = diffb->getTetDirection();
+		// Step exactly when the leap would not cover enough events to pay
+		// for a pass over all kprocs, counting that a critical event is
+		// expected after 1/ac. The exact steps are taken in batches that
+		// amortise the same pass.
+		double tau_exp = tau1;
+		if (ac > 0.0) tau_exp = std::min(tau_exp, 1.0 / ac);
+		double min_events = std::max(TETEXACT_LEAP_SSA_FACTOR, TETEXACT_LEAP_SSA_COST * nEntries);
+		if (tau_exp * a0 < min_events)
+		{
+			_update();
+			uint nssa = std::max(static_cast<uint>(TETEXACT_LEAP_SSA_STEPS), nEntries);
+			for (uint n = 0; n < nssa; ++n)
+			{
+				double dt = 0.0;
+				uint kidx = _getNext(dt);
+				if (kidx == sssa::SCHED_IDX_UNDEFINED) return;
+				if ((statedef()->time() + dt) > endtime) return;
+				_executeStep(pKProcs[kidx], dt);
+			}
+			continue;
+		}
 
-	// Have to use indices rather than iterator because need access to the
-	// tet direction
+		double tau2 = (ac > 0.0) ? r->getExp(ac) : std::numeric_limits<double>::infinity();
+		double tau = 0.0;
+		bool fire_crit = false;
+		uint nevents = 0;
+		while (true)
+		{
+			fire_crit = (tau2 <= tau1);
+			tau = fire_crit ? tau2 : tau1;
+			if (t + tau > endtime)
+			{
+				tau = endtime - t;
+				fire_crit = false;
+			}
 
-	uint ntets = bdtets.size();
+			// Draw the number of firings of each non-critical kproc and
+			// reject the leap if it drives a population negative.
+			nevents = 0;
+			for (uint j = 0; j < nEntries; ++j)
+			{
+				double a = pLeapRate[j];
+				uint k = 0;
+				if (pLeapCrit[j] == 0 && a > 0.0)
+				{
+					// Like getExp, getPsn takes the inverse of the mean.
+					k = static_cast<uint>(r->getPsn(static_cast<float>(1.0 / (a * tau))));
+					uint u_end = pLeapUpdStart[j + 1];
+					for (uint u = pLeapUpdStart[j]; u < u_end; ++u)
+					{
+						if (pLeapUpdExact[u] == 1) pLeapDelta[pLeapUpdSpec[u]] += pLeapUpdN[u] * k;
+					}
+				}
+				pLeapK[j] = k;
+				nevents += k;
+			}
+			bool neg = false;
+			for (uint s = 0; s < nspecs; ++s)
+			{
+				if (pLeapDelta[s] != 0.0 && pLeapVol[s]->clamped(pLeapLidx[s]) == false
+					&& _leapCount(s) + pLeapDelta[s] < 0.0)
+				{
+					neg = true;
+				}
+				pLeapDelta[s] = 0.0;
+			}
+			if (neg == false) break;
+			tau1 = 0.5 * tau;
+		}
 
-	for (uint bdt = 0; bdt != ntets; ++bdt)
-	{
-		stex::Tet * tet = _tet(bdtets[bdt]);
-		uint direction = bdtetsdir[bdt];
-		assert(direction >= 0 and direction < 4);
+		for (uint j = 0; j < nEntries; ++j)
+		{
+			if (pLeapK[j] > 0) pKProcs[j]->applyN(r, pLeapK[j], tau, t);
+		}
 
-		// Each diff kproc then has access to the species through it's defined parent
-		uint ndiffs = tet->compdef()->countDiffs();
-		for (uint d = 0; d != ndiffs; ++d)
+		// At most one critical event per leap, chosen with the
+		// propensities at the start of the leap.
+		if (fire_crit == true)
 		{
-			stex::Diff * diff = tet->diff(d);
-			// sidx is the global species index; so is the lig() return from diffdef
-			uint specgidx = diff->def()->lig();
-			if (specgidx == sidx)
+			double sel = r->getUnfIE() * ac;
+			uint jc = nEntries;
+			for (uint j = 0; j < nEntries; ++j)
 			{
-				// Just need to check the first one
-				if (diff->getDiffBndActive(direction)) return true;
-				else return false;
+				if (pLeapCrit[j] == 0 || pLeapRate[j] <= 0.0) continue;
+				jc = j;
+				sel -= pLeapRate[j];
+				if (sel < 0.0) break;
+			}
+			// The leap may have used up its reactants.
+			if (jc < nEntries && _rate(pKProcs[jc]) > 0.0)
+			{
+				pKProcs[jc]->apply(r, tau, t + tau);
+				nevents += 1;
 			}
 		}
-	}
-	return false;
-}
-
-////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_setPatchSReacActive(uint pidx, uint ridx, bool a)
-{
-	assert (pidx < statedef()->countPatches());
-	assert (ridx < statedef()->countSReacs());
-	assert(statedef()->countPatches() == pPatches.size());
-	stex::Patch * patch = _patch(pidx);
-	assert(patch != 0);
-	uint lsridx = patch->def()->sreacG2L(ridx);
-    if (lsridx == ssolver::LIDX_UNDEFINED)
-	{
-		std::ostringstream os;
-		os << "Surface reaction undefined in patch.\n";
-		throw steps::ArgErr(os.str());
+		statedef()->incTime(tau);
+		if (nevents > 0) statedef()->incNSteps(nevents);
+		if (pTriggers.empty() == false && _checkTriggers() == true) break;
 	}
 
-    // First set the flags in def object for consistency, though this is
-    // not entirely necessary for this solver
-    patch->def()->setActive(lsridx, a);
-
-    TriPVecCI t_end = patch->endTri();
-    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
-    {
-        (*t)->sreac(lsridx)->setActive(a);
-    }
-    // It's cheaper to just recompute everything.
-    _update();
+	// Leave the scheduler consistent with the new state.
+	_update();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool stex::Tetexact::_getPatchVDepSReacActive(uint pidx, uint vsridx) const
+void stex::Tetexact::_runDiffBatched(double endtime)
 {
-	assert (pidx < statedef()->countPatches());
-	assert (vsridx < statedef()->countVDepSReacs());
-	assert(statedef()->countPatches() == pPatches.size());
-	stex::Patch * patch = _patch(pidx);
-	assert(patch != 0);
-	uint lvsridx = patch->def()->vdepsreacG2L(vsridx);
-    if (lvsridx == ssolver::LIDX_UNDEFINED)
+	std::vector<Diff *> diffs;
+	TetPVecCI tet_end = pTets.end();
+	for (TetPVecCI t = pTets.begin(); t != tet_end; ++t)
 	{
-		std::ostringstream os;
-		os << "Voltage-dependent surface reaction undefined in patch.\n";
-		throw steps::ArgErr(os.str());
+		if ((*t) == 0) continue;
+		uint ndiffs = (*t)->compdef()->countDiffs();
+		for (uint i = 0; i < ndiffs; ++i) diffs.push_back((*t)->diff(i));
 	}
+	uint ndiffs = diffs.size();
+	std::vector<uint> nmove(ndiffs, 0);
 
-    TriPVecCI t_end = patch->endTri();
-    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
-    {
-        if ((*t)->vdepsreac(lvsridx)->inactive() == true) return false;
-    }
-    return true;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-
-void stex::Tetexact::_setPatchVDepSReacActive(uint pidx, uint vsridx, bool a)
-{
-	assert (pidx < statedef()->countPatches());
-	assert (vsridx < statedef()->countVDepSReacs());
-	assert(statedef()->countPatches() == pPatches.size());
-	stex::Patch * patch = _patch(pidx);
-	assert(patch != 0);
-	uint lvsridx = patch->def()->vdepsreacG2L(vsridx);
-    if (lvsridx == ssolver::LIDX_UNDEFINED)
+	// The surface diffusion kprocs, by patch and in the order of each
+	// patch's diffusion table.
+	std::vector<SDiff *> sdiffs;
+	PatchPVecCI patch_end = pPatches.end();
+	for (PatchPVecCI p = pPatches.begin(); p != patch_end; ++p)
 	{
-		std::ostringstream os;
-		os << "Voltage-dependent surface reaction undefined in patch.\n";
-		throw steps::ArgErr(os.str());
+		uint nsdiffs = (*p)->def()->countSurfDiffs();
+		TriPVecCI tri_end = (*p)->endTri();
+		for (TriPVecCI t = (*p)->bgnTri(); t != tri_end; ++t)
+		{
+			for (uint i = 0; i < nsdiffs; ++i) sdiffs.push_back((*t)->sdiff(i));
+		}
 	}
+	uint nsdiffs = sdiffs.size();
+	std::vector<uint> nsmove(nsdiffs, 0);
 
-    // Not necessary and not possible to set the flags in def object
-
-    TriPVecCI t_end = patch->endTri();
-    for (TriPVecCI t = patch->bgnTri(); t != t_end; ++t)
-    {
-        (*t)->vdepsreac(lvsridx)->setActive(a);
-    }
-    // It's cheaper to just recompute everything.
-    _update();
-}
-////////////////////////////////////////////////////////////////////////////////
+	while (statedef()->time() < endtime)
+	{
+		double t0 = statedef()->time();
+		double t1 = std::min(t0 + pDiffBatchDT, endtime);
 
-void stex::Tetexact::addKProc(steps::tetexact::KProc * kp)
-{
-	assert (kp != 0);
+		// Take the crowded diffusion kprocs off the SSA for this window.
+		for (uint i = 0; i < ndiffs; ++i)
+		{
+			Diff * d = diffs[i];
+			d->setBatched(d->active() && d->count() >= pDiffBatchThreshold);
+		}
+		for (uint i = 0; i < nsdiffs; ++i)
+		{
+			SDiff * d = sdiffs[i];
+			d->setBatched(d->active() && d->count() >= pDiffBatchThreshold);
+		}
+		_update();
 
-	SchedIDX nidx = pKProcs.size();
-	pKProcs.push_back(kp);
-	kp->setSchedIDX(nidx);
-}
+		while (true)
+		{
+			double dt = 0.0;
+			uint kidx = _getNext(dt);
+			if (kidx == sssa::SCHED_IDX_UNDEFINED) break;
+			if ((statedef()->time() + dt) > t1) break;
+			_executeStep(pKProcs[kidx], dt);
+		}
 
-////////////////////////////////////////////////////////////////////////////////
-/*
-void stex::Tetexact::_build(void)
-{
-	assert (pBuilt == false);
+		// Then the batched diffusion of the window, all outflows being
+		// drawn from the same state.
+		double wdt = t1 - t0;
+		uint nevents = 0;
+		for (uint i = 0; i < ndiffs; ++i)
+		{
+			nmove[i] = diffs[i]->batched() ? diffs[i]->sampleBatch(rng(), wdt) : 0;
+		}
+		for (uint i = 0; i < nsdiffs; ++i)
+		{
+			nsmove[i] = sdiffs[i]->batched() ? sdiffs[i]->sampleBatch(rng(), wdt) : 0;
+		}
+		for (uint i = 0; i < ndiffs; ++i)
+		{
+			if (nmove[i] == 0) continue;
+			diffs[i]->applyN(rng(), nmove[i], wdt, t1);
+			nevents += nmove[i];
+		}
+		for (uint i = 0; i < nsdiffs; ++i)
+		{
+			if (nsmove[i] == 0) continue;
+			sdiffs[i]->applyN(rng(), nsmove[i], wdt, t1);
+			nevents += nsmove[i];
+		}
+		statedef()->setTime(t1);
+		if (nevents > 0) statedef()->incNSteps(nevents);
+		if (pTriggers.empty() == false && _checkTriggers() == true) break;
+	}
 
-    pBuilt = true;
+	for (uint i = 0; i < ndiffs; ++i) diffs[i]->setBatched(false);
+	for (uint i = 0; i < nsdiffs; ++i) sdiffs[i]->setBatched(false);
+	_update();
 }
-*/
+
 ////////////////////////////////////////////////////////////////////////////////
 
-steps::tetexact::KProc * stex::Tetexact::_getNext(void) const
+void stex::Tetexact::_runCoarseGrained(double endtime)
 {
-#ifdef SSA_DEBUG
-    std::cout << "SSA: Search for next event\n";
-#endif
-    assert(pA0 >= 0.0);
-    // Quick check to see whether nothing is there.
-    if (pA0 == 0.0) return NULL;
+	_setupCoarseGrain();
 
-    double selector = pA0 * rng()->getUnfII();
+	while (statedef()->time() < endtime)
+	{
+		double t1 = std::min(statedef()->time() + pCGDT, endtime);
 
-#ifdef SSA_DEBUG
-    std::cout << "selector: " << selector << " in total " << pA0 << "\n";
-#endif
+		_coarseGrain(true);
 
-    double partial_sum = 0.0;
+		while (true)
+		{
+			double dt = 0.0;
+			uint kidx = _getNext(dt);
+			if (kidx == sssa::SCHED_IDX_UNDEFINED) break;
+			if ((statedef()->time() + dt) > t1) break;
+			_executeStep(pKProcs[kidx], dt);
+		}
 
-    uint n_neg_groups = nGroups.size();
-    uint n_pos_groups = pGroups.size();
+		statedef()->setTime(t1);
+		if (pTriggers.empty() == false && _checkTriggers() == true) break;
+	}
 
-    for (uint i = 0; i < n_neg_groups; i++) {
-        CRGroup* group = nGroups[i];
-        if (group->size == 0) continue;
+	// Leave every group split, so that the kprocs are as outside the
+	// mode, keeping the numbers merged in the last window.
+	uint ngroups = pCGGroupStart.size() - 1;
+	uint nspecs = statedef()->countSpecs();
+	pCGNMerged.assign(nspecs, 0);
+	for (uint i = 0; i < ngroups * nspecs; ++i)
+	{
+		if (pCGMerged[i] == true) ++pCGNMerged[i % nspecs];
+	}
+	_coarseGrain(false);
+}
 
-        if (selector > partial_sum + group->sum) {
-            partial_sum += group->sum;
-#ifdef SSA_DEBUG
-            std::cout << "increase partial sum to " << partial_sum;
-            std::cout << " by neg group " << i << "\n";
-#endif
-            continue;
-        }
+////////////////////////////////////////////////////////////////////////////////
 
-        double g_max = group->max;
-        double random_rate = g_max * rng()->getUnfII();;
-        uint group_size = group->size;
-        uint random_pos = rng()->get() % group_size;
-        KProc* random_kp = group->indices[random_pos];
-
-#ifdef SSA_DEBUG
-        std::cout << "search for event\n";
-        std::cout << "group max: " << g_max << "\n";
-        std::cout << "random rate: " << random_rate << "\n";
-        std::cout << "random pos " << random_pos << "\n";
-        std::cout << "random kp rate " << random_kp->crData.rate << "\n";
-#endif
-
-        while (random_kp->crData.rate <= random_rate) {
-            random_rate = g_max * rng()->getUnfII();
-            random_pos = rng()->get() % group_size;
-            random_kp = group->indices[random_pos];
-#ifdef SSA_DEBUG
-            std::cout << "renew search\n";
-            std::cout << "random rate: " << random_rate << "\n";
-            std::cout << "random pos " << random_pos << "\n";
-            std::cout << "random kp rate " << random_kp->crData.rate << "\n";
-#endif
-        }
+void stex::Tetexact::_setupCoarseGrain(void)
+{
+	if (pCGGroupStart.empty() == false) return;
 
-#ifdef SSA_DEBUG
-        std::cout << "selected kp index: " << random_kp->schedIDX() << "\n";
-        std::cout << "--------------------------------------------------------\n";
-#endif
-        return random_kp;
-    }
+	// Bin the tets by compartment and position, numbering the groups in
+	// the order of their first tet.
+	uint ntets = pTets.size();
+	pCGGroup.assign(ntets, TETEXACT_CG_GROUP_NONE);
+	std::map<std::vector<int>, uint> bins;
+	std::vector<uint> ngtets;
+	for (uint t = 0; t < ntets; ++t)
+	{
+		if (pTets[t] == 0) continue;
+		std::vector<double> bc = mesh()->getTetBarycenter(t);
+		std::vector<int> key(4);
+		key[0] = pTets[t]->compdef()->gidx();
+		for (uint i = 0; i < 3; ++i)
+		{
+			key[i + 1] = static_cast<int>(std::floor(bc[i] / pCGSize));
+		}
+		std::map<std::vector<int>, uint>::iterator b = bins.find(key);
+		if (b == bins.end())
+		{
+			b = bins.insert(std::make_pair(key, static_cast<uint>(ngtets.size()))).first;
+			ngtets.push_back(0);
+		}
+		pCGGroup[t] = b->second;
+		++ngtets[b->second];
+	}
 
-    for (uint i = 0; i < n_pos_groups; i++) {
-        CRGroup* group = pGroups[i];
-        if (group->size == 0) continue;
+	uint ngroups = ngtets.size();
+	pCGGroupStart.assign(ngroups + 1, 0);
+	for (uint g = 0; g < ngroups; ++g)
+	{
+		pCGGroupStart[g + 1] = pCGGroupStart[g] + ngtets[g];
+	}
+	pCGGroupTets.resize(pCGGroupStart[ngroups]);
+	std::vector<uint> fill(pCGGroupStart.begin(), pCGGroupStart.end() - 1);
+	for (uint t = 0; t < ntets; ++t)
+	{
+		if (pCGGroup[t] != TETEXACT_CG_GROUP_NONE) pCGGroupTets[fill[pCGGroup[t]]++] = t;
+	}
 
-        if (selector > partial_sum + group->sum) {
-            partial_sum += group->sum;
-#ifdef SSA_DEBUG
-            std::cout << "increase partial sum to " << partial_sum;
-            std::cout << " by neg group " << i << "\n";
-#endif
-            continue;
-        }
+	// Groups are neighbours when a tet of one shares a face with a tet
+	// of the other; the groups of a compartment never neighbour those of
+	// another.
+	pCGNeighbStart.assign(1, 0);
+	pCGNeighbs.clear();
+	for (uint g = 0; g < ngroups; ++g)
+	{
+		std::vector<uint> neighbs;
+		for (uint i = pCGGroupStart[g]; i < pCGGroupStart[g + 1]; ++i)
+		{
+			int * next = mesh()->_getTetTetNeighb(pCGGroupTets[i]);
+			for (uint d = 0; d < 4; ++d)
+			{
+				if (next[d] < 0) continue;
+				uint h = pCGGroup[next[d]];
+				if (h == TETEXACT_CG_GROUP_NONE || h == g) continue;
+				if (pTets[next[d]]->compdef() != pTets[pCGGroupTets[i]]->compdef()) continue;
+				neighbs.push_back(h);
+			}
+		}
+		std::sort(neighbs.begin(), neighbs.end());
+		neighbs.erase(std::unique(neighbs.begin(), neighbs.end()), neighbs.end());
+		pCGNeighbs.insert(pCGNeighbs.end(), neighbs.begin(), neighbs.end());
+		pCGNeighbStart.push_back(pCGNeighbs.size());
+	}
+	pCGMerged.assign(ngroups * statedef()->countSpecs(), false);
+}
 
-        double g_max = group->max;
-        double random_rate = g_max * rng()->getUnfII();;
-        uint group_size = group->size;
-        uint random_pos = rng()->get() % group_size;
-        KProc* random_kp = group->indices[random_pos];
-
-#ifdef SSA_DEBUG
-        std::cout << "search for event\n";
-        std::cout << "group max: " << g_max << "\n";
-        std::cout << "random rate: " << random_rate << "\n";
-        std::cout << "random pos " << random_pos << "\n";
-        std::cout << "random kp rate " << random_kp->crData.rate << "\n";
-#endif
-
-        while (random_kp->crData.rate <= random_rate) {
-            random_rate = g_max * rng()->getUnfII();
-            random_pos = rng()->get() % group_size;
-            random_kp = group->indices[random_pos];
-#ifdef SSA_DEBUG
-            std::cout << "renew search\n";
-            std::cout << "random rate: " << random_rate << "\n";
-            std::cout << "random pos " << random_pos << "\n";
-            std::cout << "random kp rate " << random_kp->crData.rate << "\n";
-#endif
-        }
+////////////////////////////////////////////////////////////////////////////////
 
-#ifdef SSA_DEBUG
-        std::cout << "selected kp index: " << random_kp->schedIDX() << "\n";
-        std::cout << "--------------------------------------------------------\n";
-#endif
-        return random_kp;
-    }
+void stex::Tetexact::_coarseGrain(bool on)
+{
+	uint ngroups = pCGGroupStart.size() - 1;
+	uint nspecs = statedef()->countSpecs();
+	if (pCGMerged.size() != ngroups * nspecs) pCGMerged.assign(ngroups * nspecs, false);
 
+	_beginBatch();
+	std::vector<double> conc(ngroups);
+	std::vector<bool> able(ngroups);
+	for (uint s = 0; s < nspecs; ++s)
+	{
+		if (pCGSpecs.empty() == true || pCGSpecs[s] == false) continue;
 
-    std::cerr << "Cannot find any suitable entry.\n";
-    std::cerr << "A0: " << std::setprecision (15) << pA0 << "\n";
-    std::cerr << "Selector: " << std::setprecision (15) << selector << "\n";
-    std::cerr << "Current Partial Sum: " << std::setprecision (15) << partial_sum << "\n";
+		// The concentration of each group, and whether it can be merged:
+		// it has more than one tet, the species diffuses there and is
+		// not clamped in any of them.
+		for (uint g = 0; g < ngroups; ++g)
+		{
+			uint first = pCGGroupStart[g];
+			uint last = pCGGroupStart[g + 1];
+			ssolver::Compdef * cdef = pTets[pCGGroupTets[first]]->compdef();
+			uint lidx = cdef->specG2L(s);
+			bool ok = (last - first > 1 && lidx != ssolver::LIDX_UNDEFINED);
+			if (ok == true)
+			{
+				ok = false;
+				for (uint l = 0; l < cdef->countDiffs(); ++l)
+				{
+					if (cdef->diffdef(l)->lig() == s) ok = true;
+				}
+			}
+			double n = 0.0;
+			double vol = 0.0;
+			for (uint i = first; i < last; ++i)
+			{
+				stex::Tet * tet = pTets[pCGGroupTets[i]];
+				vol += tet->vol();
+				if (lidx == ssolver::LIDX_UNDEFINED) continue;
+				n += tet->count(lidx);
+				if (tet->clamped(lidx) == true) ok = false;
+			}
+			conc[g] = n / vol;
+			able[g] = ok;
+		}
 
-    std::cerr << "Distribution of group sums\n";
-    std::cerr << "Negative groups\n";
+		for (uint g = 0; g < ngroups; ++g)
+		{
+			bool merge = (on == true && able[g] == true);
+			for (uint i = pCGNeighbStart[g]; merge == true && i < pCGNeighbStart[g + 1]; ++i)
+			{
+				double c1 = conc[g];
+				double c2 = conc[pCGNeighbs[i]];
+				if (c1 + c2 > 0.0 && std::fabs(c1 - c2) > pCGTol * (c1 + c2)) merge = false;
+			}
+			bool was = pCGMerged[g * nspecs + s];
+			if (merge == false && was == false) continue;
+
+			// Merged groups are mixed every window, and once more when
+			// they are split.
+			_mixGroup(g, s);
+			if (merge == was) continue;
+			pCGMerged[g * nspecs + s] = merge;
+			for (uint i = pCGGroupStart[g]; i < pCGGroupStart[g + 1]; ++i)
+			{
+				stex::Tet * tet = pTets[pCGGroupTets[i]];
+				int * next = mesh()->_getTetTetNeighb(pCGGroupTets[i]);
+				uint mask = 0;
+				for (uint d = 0; merge == true && d < 4; ++d)
+				{
+					if (next[d] >= 0 && pCGGroup[next[d]] == g) mask |= (1 << d);
+				}
+				ssolver::Compdef * cdef = tet->compdef();
+				for (uint l = 0; l < cdef->countDiffs(); ++l)
+				{
+					if (cdef->diffdef(l)->lig() != s) continue;
+					tet->diff(l)->setClosedDirs(mask);
+					_updateElement(tet->diff(l));
+				}
+			}
+		}
+	}
+	_endBatch();
+}
 
-    for (uint i = 0; i < n_neg_groups; i++) {
-        std::cerr << i << ": " << std::setprecision (15) << nGroups[i]->sum << "\n";
-    }
-    std::cerr << "Positive groups\n";
-    for (uint i = 0; i < n_pos_groups; i++) {
-        std::cerr << i << ": " << std::setprecision (15) << pGroups[i]->sum << "\n";
-    }
+////////////////////////////////////////////////////////////////////////////////
 
-    throw;
+void stex::Tetexact::_mixGroup(uint g, uint sidx)
+{
+	uint first = pCGGroupStart[g];
+	uint last = pCGGroupStart[g + 1];
+	uint lidx = pTets[pCGGroupTets[first]]->compdef()->specG2L(sidx);
+	double n = 0.0;
+	std::vector<double> weights(last - first);
+	for (uint i = first; i < last; ++i)
+	{
+		stex::Tet * tet = pTets[pCGGroupTets[i]];
+		if (tet->clamped(lidx) == true) return;
+		n += tet->count(lidx);
+		weights[i - first] = tet->vol();
+	}
+	if (n == 0.0) return;
+	_multinomial(n, weights);
+	for (uint i = first; i < last; ++i)
+	{
+		stex::Tet * tet = pTets[pCGGroupTets[i]];
+		tet->setCount(lidx, static_cast<uint>(weights[i - first]));
+		_updateSpec(tet, lidx);
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/*
-void stex::Tetexact::_reset(void)
-{
 
+void stex::Tetexact::_updateSpec(steps::tetexact::WmVol * tet, uint spec_lidx)
+{
+    _markSpec(tet, spec_lidx);
+    if (pBatchDepth == 0) _updateDirty();
 }
-*/
+
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_executeStep(steps::tetexact::KProc * kp, double dt)
+void stex::Tetexact::_updateSpec(steps::tetexact::Tri * tri, uint spec_lidx)
 {
-    std::vector<KProc*> const & upd = kp->apply(rng(), dt, statedef()->time());
-    _update(upd);
-    statedef()->incTime(dt);
-    statedef()->incNSteps(1);
+    _markSpec(tri, spec_lidx);
+    if (pBatchDepth == 0) _updateDirty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_updateSpec(steps::tetexact::WmVol * tet, uint spec_lidx)
+void stex::Tetexact::_markSpec(steps::tetexact::WmVol * tet, uint spec_lidx)
 {
-    std::set<KProc*> updset;
-
-    // Loop over tet.
-    KProcPVecCI kproc_end = tet->kprocEnd();
-    for (KProcPVecCI k = tet->kprocBegin(); k != kproc_end; ++k)
+    ssolver::Compdef * cdef = tet->compdef();
+    if (pPruning == true && tet->count(spec_lidx) != 0
+        && pPruneDead[cdef->gidx()][cdef->specL2G(spec_lidx)] != 0)
     {
-        updset.insert(*k);
+        _dropPruning();
+    }
+    std::vector<uint> const & slots = pCompSpecKProcs[cdef->gidx()][spec_lidx];
+    KProcPVecCI kprocs = tet->kprocBegin();
+    uint nslots = slots.size();
+    for (uint i = 0; i < nslots; ++i)
+    {
+        KProc * kp = kprocs[slots[i]];
+        if (pDirtyFlags[kp->schedIDX()] == true) continue;
+        pDirtyFlags[kp->schedIDX()] = true;
+        pDirtyKProcs.push_back(kp);
     }
 
+    // The surface kprocs reading the tet depend on which side of their
+    // triangle it lies, so they are asked directly; there are few.
+    uint gidx = cdef->specL2G(spec_lidx);
     std::vector<stex::Tri *>::const_iterator tri_end = tet->nexttriEnd();
     for (std::vector<stex::Tri *>::const_iterator tri = tet->nexttriBegin();
 			 tri != tri_end; ++tri)
     {
     	if ((*tri) == 0) continue;
-        kproc_end = (*tri)->kprocEnd();
+        KProcPVecCI kproc_end = (*tri)->kprocEnd();
         for (KProcPVecCI k = (*tri)->kprocBegin(); k != kproc_end; ++k)
         {
-            updset.insert(*k);
+            if (pDirtyFlags[(*k)->schedIDX()] == true) continue;
+            if ((*k)->depSpecTet(gidx, tet) == false) continue;
+            pDirtyFlags[(*k)->schedIDX()] = true;
+            pDirtyKProcs.push_back(*k);
         }
     }
-
-    // Send the list of kprocs that need to be updated to the schedule.
-    if (updset.empty()) return;
-    std::vector<KProc*> updvec(updset.begin(), updset.end());
-
-    _update(updvec);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_updateSpec(steps::tetexact::Tri * tri, uint spec_lidx)
+void stex::Tetexact::_markSpec(steps::tetexact::Tri * tri, uint spec_lidx)
 {
-    std::set<stex::KProc*> updset;
-
+    uint gidx = tri->patchdef()->specL2G(spec_lidx);
+    if (pPruning == true && tri->count(spec_lidx) != 0
+        && pPruneDead[statedef()->countComps() + tri->patchdef()->gidx()][gidx] != 0)
+    {
+        _dropPruning();
+    }
     KProcPVecCI kproc_end = tri->kprocEnd();
     for (KProcPVecCI k = tri->kprocBegin(); k != kproc_end; ++k)
     {
-        updset.insert(*k);
+        if (pDirtyFlags[(*k)->schedIDX()] == true) continue;
+        if ((*k)->depSpecTri(gidx, tri) == false) continue;
+        pDirtyFlags[(*k)->schedIDX()] = true;
+        pDirtyKProcs.push_back(*k);
     }
+}
 
-    // Send the list of kprocs that need to be updated to the schedule.
-    if (updset.empty()) return;
-
-    std::vector<stex::KProc*> updvec(updset.begin(), updset.end());
-
-    _update(updvec);
+////////////////////////////////////////////////////////////////////////////////
 
+void stex::Tetexact::_updateDirty(void)
+{
+    if (pDirtyKProcs.empty()) return;
+    double t = statedef()->time();
+    uint n = pDirtyKProcs.size();
+    for (uint i = 0; i < n; ++i)
+    {
+        KProc * kp = pDirtyKProcs[i];
+        pScheduler->update(kp->schedIDX(), _rate(kp), t);
+        pDirtyFlags[kp->schedIDX()] = false;
+    }
+    pDirtyKProcs.clear();
+    _commit(t);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3125,7 +9692,282 @@ double stex::Tetexact::_getTetCount(uint tidx, uint sidx) const
 		throw steps::ArgErr(os.str());
 	}
 
-	return tet->pools()[lsidx];
+	return tet->count(lsidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_addFluxEntry(steps::tetexact::KProc * kp, uint counter,
+                                   uint dir, int sign)
+{
+    if (pFluxFirst.empty() == true)
+    {
+        pFluxFirst.assign(pKProcs.size(), FLUX_ENTRY_NONE);
+    }
+    uint sidx = kp->schedIDX();
+    uint e = pFluxFirst[sidx];
+    while (e != FLUX_ENTRY_NONE && pFluxEntries[e].counter != counter)
+    {
+        e = pFluxEntries[e].next;
+    }
+    if (e == FLUX_ENTRY_NONE)
+    {
+        FluxEntry fe;
+        fe.counter = counter;
+        std::fill_n(fe.sign, 4, 0);
+        fe.next = pFluxFirst[sidx];
+        e = pFluxEntries.size();
+        pFluxEntries.push_back(fe);
+        pFluxFirst[sidx] = e;
+    }
+    if (kp->type() == KP_DIFF) pFluxEntries[e].sign[dir] = sign;
+    else std::fill_n(pFluxEntries[e].sign, 4, sign);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::_addTetsReacFlux(std::vector<uint> const & tets, uint ridx)
+{
+    uint counter = pFluxCounts.size();
+    for (uint i = 0; i < tets.size(); ++i)
+    {
+        assert(tets[i] < pTets.size());
+        stex::Tet * tet = pTets[tets[i]];
+        if (tet == 0) continue;
+        uint lridx = tet->compdef()->reacG2L(ridx);
+        if (lridx == ssolver::LIDX_UNDEFINED) continue;
+        _addFluxEntry(tet->reac(lridx), counter, 0, 1);
+    }
+    pFluxCounts.push_back(0.0);
+    return counter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::_addTrisSReacFlux(std::vector<uint> const & tris, uint sridx)
+{
+    uint counter = pFluxCounts.size();
+    for (uint i = 0; i < tris.size(); ++i)
+    {
+        assert(tris[i] < pTris.size());
+        stex::Tri * tri = pTris[tris[i]];
+        if (tri == 0) continue;
+        uint lsridx = tri->patchdef()->sreacG2L(sridx);
+        if (lsridx == ssolver::LIDX_UNDEFINED) continue;
+        _addFluxEntry(tri->sreac(lsridx), counter, 0, 1);
+    }
+    pFluxCounts.push_back(0.0);
+    return counter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::_addTrisDiffFlux(std::vector<uint> const & tris, uint sidx)
+{
+    // A molecule crosses triangle t when a diffusion of the species in
+    // one of its tetrahedrons moves it in the direction of the face t.
+    uint counter = pFluxCounts.size();
+    for (uint i = 0; i < tris.size(); ++i)
+    {
+        std::vector<int> neighbs = mesh()->getTriTetNeighb(tris[i]);
+        for (uint side = 0; side < 2; ++side)
+        {
+            if (neighbs[side] < 0) continue;
+            stex::Tet * tet = pTets[neighbs[side]];
+            if (tet == 0) continue;
+            ssolver::Compdef * cdef = tet->compdef();
+            uint * faces = mesh()->_getTetTriNeighb(neighbs[side]);
+            for (uint d = 0; d < 4; ++d)
+            {
+                if (faces[d] != tris[i]) continue;
+                for (uint l = 0; l < cdef->countDiffs(); ++l)
+                {
+                    if (cdef->diffdef(l)->lig() != sidx) continue;
+                    _addFluxEntry(tet->diff(l), counter, d, (side == 0 ? 1 : -1));
+                }
+            }
+        }
+    }
+    pFluxCounts.push_back(0.0);
+    return counter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::_takeFluxCount(uint i)
+{
+    if (i >= pFluxCounts.size())
+    {
+        std::ostringstream os;
+        os << "Flux counter index out of range.";
+        throw steps::ArgErr(os.str());
+    }
+    double count = pFluxCounts[i];
+    pFluxCounts[i] = 0.0;
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stex::Tetexact::_addROI(std::vector<uint> const & tets,
+                             std::vector<uint> const & tris)
+{
+    std::vector<uint> elems(tets);
+    for (uint i = 0; i < tris.size(); ++i)
+    {
+        elems.push_back(pTets.size() + tris[i]);
+    }
+    std::sort(elems.begin(), elems.end());
+    elems.erase(std::unique(elems.begin(), elems.end()), elems.end());
+    pROIElems.push_back(elems);
+    // The totals move, so every element is pointed at its rows again.
+    _linkROIs(true);
+    return pROIElems.size() - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::Tetexact::_getROICount(uint roi, uint sidx) const
+{
+    if (roi >= pROIElems.size())
+    {
+        std::ostringstream os;
+        os << "Region of interest index out of range.";
+        throw steps::ArgErr(os.str());
+    }
+    return pROICounts[roi * statedef()->countSpecs() + sidx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Add the counts of tet or triangle e (the triangles numbered after the
+// tets) to totals, by global species.
+static void addElemCounts(stex::TetPVec const & tets, stex::TriPVec const & tris,
+                          uint e, double * totals)
+{
+    uint ntets = tets.size();
+    if (e < ntets)
+    {
+        stex::Tet * tet = tets[e];
+        if (tet == 0) return;
+        ssolver::Compdef * cdef = tet->compdef();
+        for (uint l = 0; l < cdef->countSpecs(); ++l)
+        {
+            totals[cdef->specL2G(l)] += tet->count(l);
+        }
+    }
+    else
+    {
+        stex::Tri * tri = tris[e - ntets];
+        if (tri == 0) return;
+        ssolver::Patchdef * pdef = tri->patchdef();
+        for (uint l = 0; l < pdef->countSpecs(); ++l)
+        {
+            totals[pdef->specL2G(l)] += tri->count(l);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_linkROIs(bool on)
+{
+    uint ntets = pTets.size();
+    for (uint i = 0; i < ntets; ++i)
+    {
+        if (pTets[i] != 0) pTets[i]->setROITotals(0);
+    }
+    for (uint i = 0; i < pTris.size(); ++i)
+    {
+        if (pTris[i] != 0) pTris[i]->setROITotals(0);
+    }
+    if (on == false) return;
+
+    uint nspecs = statedef()->countSpecs();
+    uint nrois = pROIElems.size();
+    pROICounts.assign(nrois * nspecs, 0.0);
+
+    // Lay out the lists of the elements one after the other, then hand
+    // them out once pROILinks no longer grows.
+    std::vector<std::vector<uint> > rois(ntets + pTris.size());
+    for (uint r = 0; r < nrois; ++r)
+    {
+        for (uint i = 0; i < pROIElems[r].size(); ++i)
+        {
+            rois[pROIElems[r][i]].push_back(r);
+        }
+    }
+    // An element in a snapshot voxel also adds to the totals of that.
+    bool snap = (pSnapVoxels.empty() == false);
+    pROILinks.clear();
+    std::vector<uint> start(rois.size(), 0);
+    std::vector<bool> linked(rois.size(), false);
+    for (uint e = 0; e < rois.size(); ++e)
+    {
+        bool voxel = (snap == true && pSnapVoxels[e] != SNAPSHOT_VOXEL_NONE);
+        if (rois[e].empty() == true && voxel == false) continue;
+        start[e] = pROILinks.size();
+        linked[e] = true;
+        for (uint i = 0; i < rois[e].size(); ++i)
+        {
+            pROILinks.push_back(&pROICounts[rois[e][i] * nspecs]);
+        }
+        if (voxel == true)
+        {
+            pROILinks.push_back(&pSnapCounts[pSnapVoxels[e] * nspecs]);
+        }
+        pROILinks.push_back(0);
+    }
+    for (uint e = 0; e < rois.size(); ++e)
+    {
+        if (linked[e] == false) continue;
+        if (e < ntets)
+        {
+            if (pTets[e] != 0) pTets[e]->setROITotals(&pROILinks[start[e]]);
+        }
+        else if (pTris[e - ntets] != 0)
+        {
+            pTris[e - ntets]->setROITotals(&pROILinks[start[e]]);
+        }
+    }
+    _sumROICounts();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_sumROICounts(void)
+{
+    uint nspecs = statedef()->countSpecs();
+    std::fill(pROICounts.begin(), pROICounts.end(), 0.0);
+    for (uint r = 0; r < pROIElems.size(); ++r)
+    {
+        double * totals = &pROICounts[r * nspecs];
+        for (uint i = 0; i < pROIElems[r].size(); ++i)
+        {
+            addElemCounts(pTets, pTris, pROIElems[r][i], totals);
+        }
+    }
+    std::fill(pSnapCounts.begin(), pSnapCounts.end(), 0.0);
+    for (uint e = 0; e < pSnapVoxels.size(); ++e)
+    {
+        if (pSnapVoxels[e] == SNAPSHOT_VOXEL_NONE) continue;
+        addElemCounts(pTets, pTris, e, &pSnapCounts[pSnapVoxels[e] * nspecs]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_beginBatch(void)
+{
+	++pBatchDepth;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tetexact::_endBatch(void)
+{
+	assert(pBatchDepth > 0);
+	if (--pBatchDepth == 0) _updateDirty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3275,7 +10117,9 @@ void stex::Tetexact::_setTetClamped(uint tidx, uint sidx, bool buf)
 		throw steps::ArgErr(os.str());
 	}
 
+	if (tet->clamped(lsidx) == buf) return;
 	tet->setClamped(lsidx, buf);
+	_clampsChanged(std::vector<stex::WmVol *>(1, tet), std::vector<stex::Tri *>());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3333,7 +10177,6 @@ void stex::Tetexact::_setTetReacK(uint tidx, uint ridx, double kf)
 	tet->reac(lridx)->setKcst(kf);
 
 	_updateElement(tet->reac(lridx));
-    _updateSum();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3391,7 +10234,6 @@ void stex::Tetexact::_setTetReacActive(uint tidx, uint ridx, bool act)
 	tet->reac(lridx)->setActive(act);
 
 	_updateElement(tet->reac(lridx));
-    _updateSum();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3449,7 +10291,6 @@ void stex::Tetexact::_setTetDiffD(uint tidx, uint didx, double dk)
 	tet->diff(ldidx)->setDcst(dk);
 
 	_updateElement(tet->diff(ldidx));
-    _updateSum();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3507,7 +10348,6 @@ void stex::Tetexact::_setTetDiffActive(uint tidx, uint didx, bool act)
 	tet->diff(ldidx)->setActive(act);
 
 	_updateElement(tet->diff(ldidx));
-    _updateSum();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3680,7 +10520,7 @@ double stex::Tetexact::_getTriCount(uint tidx, uint sidx) const
 		throw steps::ArgErr(os.str());
 	}
 
-	return tri->pools()[lsidx];
+	return tri->count(lsidx);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3799,7 +10639,9 @@ void stex::Tetexact::_setTriClamped(uint tidx, uint sidx, bool buf)
 		throw steps::ArgErr(os.str());
 	}
 
+	if (tri->clamped(lsidx) == buf) return;
 	tri->setClamped(lsidx, buf);
+	_clampsChanged(std::vector<stex::WmVol *>(), std::vector<stex::Tri *>(1, tri));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3856,7 +10698,6 @@ void stex::Tetexact::_setTriSReacK(uint tidx, uint ridx, double kf)
 	tri->sreac(lsridx)->setKcst(kf);
 
 	_updateElement(tri->sreac(lsridx));
-    _updateSum();
 
 }
 
@@ -3915,7 +10756,6 @@ void stex::Tetexact::_setTriSReacActive(uint tidx, uint ridx, bool act)
 	tri->sreac(lsridx)->setActive(act);
 
 	_updateElement(tri->sreac(lsridx));
-    _updateSum();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3973,7 +10813,6 @@ void stex::Tetexact::_setTriVDepSReacActive(uint tidx, uint vsridx, bool act)
 	tri->vdepsreac(lvsridx)->setActive(act);
 
 	_updateElement(tri->vdepsreac(lvsridx));
-    _updateSum();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -4180,6 +11019,8 @@ double stex::Tetexact::_getTriV(uint tidx) const
     	os << "Triangle index " << tidx << " not assigned to a membrane.";
     	throw steps::ArgErr(os.str());
 	}
+	// The potentials the update in flight started from.
+	if (pEFPipe != 0) return pEFTriV[loctidx];
     // EField object should convert value to base s.i. units
     return pEField->getTriV(loctidx);
 }
@@ -4617,201 +11458,4 @@ void stex::Tetexact::_setMembVolRes(uint midx, double ro)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tetexact::_updateElement(KProc* kp)
-{
-
-    #ifdef SSA_DEBUG
-    std::cout << "SSA: Update KProc element " << kp->schedIDX() << "\n";
-    #endif
-
-    double new_rate = kp->rate(this);
-
-    #ifdef SSA_DEBUG
-    std::cout << "new rate: " << new_rate << "\n";
-    #endif
-
-    CRKProcData & data = kp->crData;
-    double old_rate = data.rate;
-
-    data.rate = new_rate;
-
-    #ifdef SSA_DEBUG
-    std::cout << "data recorded: " << (data.recorded ? "Yes" : "No") << "\n";
-    std::cout << "pow: " << data.pow << "\n";
-    std::cout << "pos: " << data.pos << "\n";
-    std::cout << "rate: " << data.rate << "\n";
-    #endif
-
-    if (old_rate == new_rate)  return;
-
-
-    // new rate in positive groups
-    if (new_rate >= 0.5) {
-        #ifdef SSA_DEBUG
-        std::cout << "new rate in positive group\n";
-        #endif
-
-        // pow is the same
-        int old_pow = data.pow;
-        int new_pow;
-        double temp = frexp(new_rate, &new_pow);
-
-        #ifdef SSA_DEBUG
-        std::cout << "power changes from " << old_pow << " to " << new_pow << "\n";
-        #endif
-
-        if (old_pow == new_pow && data.recorded) {
-
-            CRGroup* old_group = _getGroup(old_pow);
-
-            #ifdef SSA_DEBUG
-            std::cout << "in the same power group, change group sum and positive sum\n";
-            std::cout << "old group sum: " << old_group->sum << " old pSum " << pSum << "\n";
-            #endif
-
-            old_group->sum += (new_rate - old_rate);
-
-            #ifdef SSA_DEBUG
-            std::cout << "new group sum: " << old_group->sum << " new pSum " << pSum << "\n";
-            #endif
-        }
-        // pow is not the same
-        else {
-            data.pow = new_pow;
-
-
-            if (data.recorded) {
-                #ifdef SSA_DEBUG
-                std::cout << "remove data from group with power " << old_pow << "\n";
-                #endif
-
-                // remove old
-                CRGroup* old_group = _getGroup(old_pow);
-                (old_group->size) --;
-
-                if (old_group->size == 0) old_group->sum = 0.0;
-                else {
-                    old_group->sum -= old_rate;
-
-                    KProc* last = old_group->indices[old_group->size];
-                    old_group->indices[data.pos] = last;
-                    last->crData.pos = data.pos;
-                }
-            }
-
-            // add new
-            #ifdef SSA_DEBUG
-            std::cout << "add data to group with power " << new_pow << "\n";
-            #endif
-            if (pGroups.size() <= new_pow) _extendPGroups(new_pow + 1);
-
-            CRGroup* new_group = pGroups[new_pow];
-
-            assert(new_group != NULL);
-            if (new_group->size == new_group->capacity) _extendGroup(new_group);
-            uint pos = new_group->size;
-            new_group->indices[pos] = kp;
-            new_group->size++;
-            new_group->sum += new_rate;
-            data.pos = pos;
-
-        }
-        data.recorded = true;
-
-    }
-    // new rate in negative group
-    else if (new_rate < 0.5 && new_rate > 1e-20) {
-        int old_pow = data.pow;
-        int new_pow;
-        double temp = frexp(new_rate, &new_pow);
-
-        #ifdef SSA_DEBUG
-        std::cout << "power changes from " << old_pow << " to " << new_pow << "\n";
-        #endif
-
-        if (old_pow == new_pow && data.recorded) {
-
-            CRGroup* old_group = _getGroup(old_pow);
-            #ifdef SSA_DEBUG
-            std::cout << "in the same power group, change group sum and negative sum\n";
-            std::cout << "old group sum: " << old_group->sum << " old nSum " << nSum << "\n";
-            #endif
-
-            old_group->sum += (new_rate - old_rate);
-
-            #ifdef SSA_DEBUG
-            std::cout << "new group sum: " << old_group->sum << " new nSum " << nSum << "\n";
-            #endif
-        }
-        // pow is not the same
-        else {
-            data.pow = new_pow;
-
-            if (data.recorded) {
-                #ifdef SSA_DEBUG
-                std::cout << "remove data from group with power " << old_pow << "\n";
-                #endif
-
-                CRGroup* old_group = _getGroup(old_pow);
-                (old_group->size) --;
-
-                if (old_group->size == 0) old_group->sum = 0.0;
-                else {
-                    old_group->sum -= old_rate;
-
-                    KProc* last = old_group->indices[old_group->size];
-                    old_group->indices[data.pos] = last;
-                    last->crData.pos = data.pos;
-                }
-            }
-
-            // add new
-            #ifdef SSA_DEBUG
-            std::cout << "add data to group with power " << new_pow << "\n";
-            #endif
-
-            if (nGroups.size() <= -new_pow) _extendNGroups(-new_pow + 1);
-
-            CRGroup* new_group = nGroups[-new_pow];
-
-            if (new_group->size == new_group->capacity) _extendGroup(new_group);
-            uint pos = new_group->size;
-            new_group->indices[pos] = kp;
-            new_group->size++;
-            new_group->sum += new_rate;
-            data.pos = pos;
-
-        }
-        data.recorded = true;
-    }
-
-    else {
-
-        if (data.recorded) {
-            #ifdef SSA_DEBUG
-            std::cout << "remove data from group with power " << data.pow << "\n";
-            #endif
-            CRGroup* old_group = _getGroup(data.pow);
-
-            // remove old
-            old_group->size --;
-
-            if (old_group->size == 0) old_group->sum = 0.0;
-            else {
-                old_group->sum -= old_rate;
-
-                KProc* last = old_group->indices[old_group->size];
-                old_group->indices[data.pos] = last;
-                last->crData.pos = data.pos;
-            }
-        }
-        data.recorded = false;
-    }
-
-    #ifdef SSA_DEBUG
-    std::cout << "--------------------------------------------------------\n";
-    #endif
-}
-////////////////////////////////////////////////////////////////////////////////
-
 // END
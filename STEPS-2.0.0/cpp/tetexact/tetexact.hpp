@@ -48,23 +48,97 @@
 #include "tet.hpp"
 #include "wmvol.hpp"
 #include "kproc.hpp"
+#include "arena.hpp"
 #include "comp.hpp"
 #include "patch.hpp"
 #include "diffboundary.hpp"
-#include "crstruct.hpp"
+#include "../solver/ssa/scheduler.hpp"
+#include "../solver/ssa/crsched.hpp"
 
 
 #include "../solver/efield/efield.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Default window of the MPI domain mode.
+#define TETEXACT_DOMAIN_WINDOW      1.0e-6
+
+// Default error control parameter of the tau-leaping mode.
+#define TETEXACT_LEAP_EPSILON       0.03
+
+// Default number of firings below which a kproc is treated as critical
+// in the tau-leaping mode.
+#define TETEXACT_LEAP_NCRIT         10
+
+// The tau-leaping mode falls back to exact SSA steps when the leap
+// would cover fewer than this many events, or fewer than this fraction
+// of the number of kprocs, a leap costing about as much as that many
+// exact steps...
+#define TETEXACT_LEAP_SSA_FACTOR    10.0
+#define TETEXACT_LEAP_SSA_COST      0.25
+
+// ...and then takes this many of them, or one per kproc if there are
+// more kprocs, before trying to leap again.
+#define TETEXACT_LEAP_SSA_STEPS     100
+
+// Default window of the batched diffusion mode.
+#define TETEXACT_DIFF_BATCH_DT      1.0e-5
+
+// Defaults of the coarse-grained mode: the window and the largest
+// relative difference of concentration between neighbouring groups for
+// them to be merged.
+#define TETEXACT_COARSE_GRAIN_DT    1.0e-4
+#define TETEXACT_COARSE_GRAIN_TOL   0.1
+
+// Group of a tetrahedron outside the coarse-grained groups.
+#define TETEXACT_CG_GROUP_NONE      0xFFFFFFFF
+
+// Default window of the cluster mode.
+#define TETEXACT_CLUSTER_WINDOW     1.0e-6
+
+// Checkpoint files start with this magic string and format version.
+// Files without it are read as the unversioned format of STEPS 2.0.
+// Version 3 adds the scheduler state; version 2 files are still read,
+// with the scheduler rebuilt.
+#define TETEXACT_CHECKPOINT_MAGIC   "STEPSTEX"
+#define TETEXACT_CHECKPOINT_VERSION 3
+
+// Delta checkpoint files (see Tetexact::checkpointDelta).
+#define TETEXACT_DELTA_MAGIC        "STEPSTXD"
+#define TETEXACT_DELTA_VERSION      1
+
+// The solver structure that Tetexact::checkpointRestart appends to a
+// checkpoint file.
+#define TETEXACT_RESTART_MAGIC      "STEPSRST"
+#define TETEXACT_RESTART_VERSION    1
+
+// The index and shard files of Tetexact::checkpointShards.
+#define TETEXACT_SHARDS_MAGIC       "STEPSSHI"
+#define TETEXACT_SHARD_MAGIC        "STEPSSHD"
+#define TETEXACT_SHARDS_VERSION     1
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetode)
+
+// Forward declarations.
+class TetODE;
+
+END_NAMESPACE(tetode)
+END_NAMESPACE(steps)
+
 START_NAMESPACE(steps)
 START_NAMESPACE(tetexact)
 
 ////////////////////////////////////////////////////////////////////////////////
 
 // Forward declarations.
-
+class Clusters;
+class Domains;
+class Ensemble;
+class EventTrace;
+class SnapshotStream;
 
 // Auxiliary declarations.
 typedef uint                            SchedIDX;
@@ -82,15 +156,66 @@ typedef SchedIDXVec::const_iterator     SchedIDXVecCI;
 ///
 extern void schedIDXSet_To_Vec(SchedIDXSet const & s, SchedIDXVec & v);
 
+/// FNV-1a hash of a checkpoint payload, stored next to it to detect
+/// truncated or corrupt files.
+///
+extern uint checkpointHash(std::string const & data);
+
 ////////////////////////////////////////////////////////////////////////////////
 
 class Tetexact: public steps::solver::API
 {
 
+    friend class Clusters;
+    friend class Domains;
+    friend class Ensemble;
+
 public:
 
+    /// The scheduler selects the SSA kernel: "cr" (composition and
+    /// rejection, default), "direct" (n-ary sum tree), "nrm"
+    /// (Gibson-Bruck next reaction method) or "nsm" (next subvolume
+    /// method: "nrm" with the element scheduler on, see
+    /// setElementScheduler).
+    ///
+    /// If reorder is true the tets, and the triangles after their inner
+    /// tets, are laid out in memory in reverse Cuthill-McKee order of the
+    /// mesh instead of in index order, so that neighbouring elements and
+    /// their kprocs are close together. Indices at the API are unchanged.
+    ///
+    /// setupthreads is the number of threads that gather the element
+    /// geometry and resolve the kproc dependencies during set up. The
+    /// kprocs themselves are always created in one thread, so results
+    /// do not depend on it.
+    ///
+    /// efieldbackend names the EField backend (see
+    /// solver/efield/backend.hpp) that steps the membrane potential when
+    /// calcMembPot is true: "cpu", the default, or one registered by a
+    /// module that provides another, such as a GPU solver.
+    ///
+    /// If lazydeps is true the update lists of the kprocs are not
+    /// resolved during set up but the first time each kproc fires, which
+    /// needs its reactants to be present. The species dependency index
+    /// of the elements is kept for that. In models where most processes
+    /// never fire, such as those of species that only appear near a
+    /// stimulus, this skips most of the "deps" phase and its memory.
+    ///
+    /// If restart names a file written by checkpointRestart, the kproc
+    /// update lists and the EField vertex ordering and coupling are read
+    /// from it instead of being computed, which skips the "index" and
+    /// "deps" phases and most of "efield", and the solver is then
+    /// restored from the checkpoint in it, scheduler state included, so
+    /// that with the same random numbers it goes on as the writer would
+    /// have. The other arguments must be those of the solver that wrote
+    /// it. The WmVol and element schedulers are set after construction,
+    /// which rebuilds the scheduler; restore() the file again after
+    /// switching either on.
+    ///
     Tetexact(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
-    		 bool calcMembPot = false);
+    		 bool calcMembPot = false, std::string const & scheduler = "cr",
+    		 bool reorder = false, uint setupthreads = 1,
+    		 std::string const & efieldbackend = "cpu", bool lazydeps = false,
+    		 std::string const & restart = "");
     ~Tetexact(void);
 
 
@@ -113,8 +238,111 @@ public:
     //void advanceSteps(uint nsteps);
     void step(void);
 
+    /// The checkpoint holds the state of the scheduler and the event
+    /// drawn past the end of the last run, if any, so a solver restored
+    /// from it and drawing the same random numbers continues on the
+    /// same trajectory as this one. Files without them (version 2 and
+    /// earlier, or from a solver with another scheduler) are restored
+    /// with the scheduler rebuilt from the propensities.
+    ///
     void checkpoint(std::string const & file_name);
     void restore(std::string const & file_name);
+
+    /// Write only the state that has changed since the last checkpoint,
+    /// delta checkpoint or restore of this solver: the counts of the
+    /// tetrahedrons and triangles, and the kprocs, that were modified
+    /// since, plus the small global state (time, definitions, EField).
+    /// A delta is restored with restoreDelta() on top of the file it
+    /// follows, so a chain is restored with restore() of the full
+    /// checkpoint and restoreDelta() of each delta in order. The
+    /// scheduler state is not written; restoreDelta() rebuilds it.
+    ///
+    void checkpointDelta(std::string const & file_name);
+    void restoreDelta(std::string const & file_name);
+
+    /// Capture a checkpoint (or a delta, if delta is true) in memory and
+    /// write it to file_name on a background thread while the simulation
+    /// goes on. Only one write is in flight at a time: this, and the
+    /// other checkpoint and restore methods, first wait for the previous
+    /// one with waitCheckpoint().
+    ///
+    void checkpointAsync(std::string const & file_name, bool delta = false);
+
+    /// Checkpoint to file_name, followed by the structure that a restart
+    /// needs in place of set up (see the restart argument of the
+    /// constructor): the update list of each kproc, as schedule indices,
+    /// and the EField vertex ordering and coupling constants. Pending
+    /// update lists (see lazydeps) are resolved first. restore() reads
+    /// the file as an ordinary checkpoint. Like any checkpoint it holds
+    /// the scheduler state (see checkpoint()).
+    ///
+    void checkpointRestart(std::string const & file_name);
+
+    /// Checkpoint to an index file file_name and nshards shard files
+    /// file_name.0, file_name.1, ... The tetrahedrons and then the
+    /// triangles, in mesh index order, are split into nshards ranges of
+    /// about equal length; each shard holds the state of the elements of
+    /// its range and of their kprocs, and is serialised and written on a
+    /// thread of its own. The index holds the rest of the state and the
+    /// range of each shard, so the files can be restored whatever
+    /// nshards was. The scheduler state is not written; restoring
+    /// rebuilds it.
+    ///
+    void checkpointShards(std::string const & file_name, uint nshards);
+
+    /// Restore from the files of checkpointShards, reading and restoring
+    /// the shards on nthreads threads. restore() of an index file does
+    /// the same on one thread.
+    ///
+    void restoreShards(std::string const & file_name, uint nthreads = 1);
+
+    /// Whether the last checkpointAsync() write has finished.
+    ///
+    bool checkpointDone(void);
+
+    /// Wait for the last checkpointAsync() write to finish. Throws if it
+    /// failed; a delta chain then has to start again from a full
+    /// checkpoint.
+    ///
+    void waitCheckpoint(void);
+
+    /// Return a new solver in the same state as this one: the same
+    /// counts, clamped and active flags, rate constants, simulation time
+    /// and solver options. The model and geometry are shared. The clone
+    /// copies its element geometry and kproc update lists from this
+    /// solver instead of computing them from the mesh again.
+    ///
+    /// The clone draws from r, or from the RNG of this solver if r is
+    /// null. It copies the scheduler state and any pending event, so
+    /// given the same random numbers as this solver it follows the same
+    /// trajectory. The caller owns the clone.
+    ///
+    Tetexact * clone(steps::rng::RNG * r = 0);
+
+    /// Return one new solver per generator in rngs, each in the state of
+    /// this solver as clone() would make it and drawing from its own
+    /// generator. The state is captured once and every replicate is
+    /// restored from that image in memory, so the replicates cost the
+    /// copies of the structure and nothing more. The generators must be
+    /// distinct. The caller owns the replicates.
+    ///
+    std::vector<Tetexact *> fork(std::vector<steps::rng::RNG *> const & rngs);
+
+    /// Set the counts in every tetrahedron and triangle to those of ode, a
+    /// TetODE solver on the same mesh and model, each rounded
+    /// stochastically, and refresh the propensities once at the end. If
+    /// specs (indexed by global species index) is not empty, only the
+    /// flagged species are set. The simulation time is not copied.
+    ///
+    void setStateFrom(steps::tetode::TetODE & ode,
+                      std::vector<bool> const & specs = std::vector<bool>());
+
+    /// Set the counts in every tetrahedron and triangle of ode, a TetODE
+    /// solver on the same mesh and model, to those of this solver; specs
+    /// as for setStateFrom().
+    ///
+    void copyStateTo(steps::tetode::TetODE & ode,
+                     std::vector<bool> const & specs = std::vector<bool>()) const;
     ////////////////////////// ADDED FOR EFIELD ////////////////////////////
 
     void setEfieldDT(double efdt);
@@ -122,6 +350,10 @@ public:
     inline double efdt(void) const
     { return pEFDT; }
 
+    /// Set the temperature. Only the GHK current propensities, the
+    /// temperature-dependent kprocs, are refreshed, and the flux tables
+    /// extended where needed.
+    ///
     void setTemp(double t);
 
     inline double getTemp(void) const
@@ -140,10 +372,637 @@ public:
     double getTime(void) const;
 
     inline double getA0(void) const
-    { return pA0; }
+    { return pScheduler->getA0(); }
 
     uint getNSteps(void) const;
 
+    /// Return the name of the scheduler used by the SSA kernel; "nsm"
+    /// for "nrm" with the element scheduler on.
+    ///
+    std::string getScheduler(void) const;
+
+    /// Choose whether the kprocs of the well-mixed compartments are kept
+    /// in a direct-method sub-scheduler of their own, which enters the
+    /// scheduler as one entry with their total propensity (see
+    /// SplitScheduler). Off by default; turns the element scheduler off.
+    ///
+    void setWmVolScheduler(bool split);
+
+    bool getWmVolScheduler(void) const;
+
+    /// Choose whether the kprocs of each tet, tri and well-mixed volume
+    /// enter the scheduler as one entry with their summed propensity,
+    /// the kproc that fires being selected within the element (see
+    /// GroupScheduler). Off by default; turns the well-mixed volume
+    /// scheduler off.
+    ///
+    void setElementScheduler(bool group);
+
+    bool getElementScheduler(void) const;
+
+    /// Set the number of SSA updates between exact resummations of A0.
+    /// In between, A0 is maintained incrementally from the propensity
+    /// changes of the updated KProcs. A value of 1 resums after every
+    /// event. Only available with the "cr" scheduler.
+    ///
+    void setA0ResyncInterval(uint n);
+
+    uint getA0ResyncInterval(void) const;
+
+    /// Choose whether the CR group holding the next event is found by
+    /// a search in the group sum tree (default) or by a linear scan over
+    /// all groups. Only available with the "cr" scheduler.
+    ///
+    void setGroupTreeSearch(bool tree);
+
+    bool getGroupTreeSearch(void) const;
+
+    /// Run the SSA of run() over the ranks of the MPI job (true), each
+    /// rank simulating its own spatial domain of the mesh, with the
+    /// molecules that diffuse between domains handed over at the end of
+    /// every window of the given length (see Domains); false goes back
+    /// to the serial SSA. Every rank has to call it, and then run(), with
+    /// the same arguments; each holds the whole state after a run.
+    /// step() stays serial. Not available with the EField, well-mixed
+    /// compartments, clusters, tau-leaping, batched diffusion or
+    /// triggers.
+    ///
+    void setDomains(bool on, double window = TETEXACT_DOMAIN_WINDOW);
+
+    bool getDomains(void) const;
+
+    /// The rank of this process and the number of ranks, with domains
+    /// set; 0 otherwise.
+    ///
+    uint getDomainRank(void) const;
+
+    uint getNDomains(void) const;
+
+    /// The tetrahedrons of the domain of this rank, and its halo (the
+    /// tetrahedrons of other domains that share a face with it).
+    ///
+    std::vector<uint> getDomainTets(void) const;
+
+    std::vector<uint> getDomainHalo(void) const;
+
+    /// The number of molecules this rank handed to other ranks since
+    /// setDomains.
+    ///
+    double getDomainMessages(void) const;
+
+    /// A health statistic of the CR scheduler since the last
+    /// resetCRStats() or reset(): "events" (selections made), "trials"
+    /// (rejection sampling trials), "meantrials" (trials per event),
+    /// "extends" (group storage reallocations), "groups" (groups
+    /// allocated) or "nonempty" (groups holding at least one KProc).
+    /// Only available with the "cr" scheduler.
+    ///
+    double getCRStat(std::string const & stat) const;
+
+    void resetCRStats(void);
+
+    /// One value per CR group allocated, in order of increasing power:
+    /// "pow" (the binary exponent of the group's propensities), "size"
+    /// (the number of KProcs in it), "sum" (their total propensity) or
+    /// "fill" (the acceptance probability of a rejection trial, the
+    /// mean propensity over the group's upper bound; zero when empty).
+    /// Only available with the "cr" scheduler.
+    ///
+    std::vector<double> getCRGroupData(std::string const & field) const;
+
+    /// The number of bytes held by one part of the solver: "elements"
+    /// (tetrahedrons, triangles, well-mixed volumes, compartments,
+    /// patches and diffusion boundaries), "kprocs" (the kinetic
+    /// processes and their update lists), "scheduler", "efield" (zero
+    /// without the EField), "mesh", "statedef", "arena" (chunk space
+    /// reserved but never handed out) or "total" (the sum of all).
+    ///
+    double getMemoryUsage(std::string const & part) const;
+
+    /// Switch run() between exact SSA (the default) and tau-leaping with
+    /// the step selection of Cao, Gillespie and Petzold (2006). Reactions
+    /// and diffusion are leaped; surface processes and kprocs close to
+    /// exhausting a reactant are treated as critical and executed one
+    /// event at a time. When the leap would be too short to pay off the
+    /// solver takes exact SSA steps instead. Not available with the
+    /// EField.
+    ///
+    void setTauLeaping(bool leap);
+
+    bool getTauLeaping(void) const;
+
+    /// Set the error control parameter epsilon of the tau selection,
+    /// the largest relative change allowed in the propensities during a
+    /// leap. Must lie in (0, 1); the default is 0.03.
+    ///
+    void setTauLeapEpsilon(double eps);
+
+    double getTauLeapEpsilon(void) const;
+
+    /// Set the number of firings below which a kproc is critical, i.e.
+    /// the kproc could exhaust one of its reactants within ncrit events.
+    /// The default is 10.
+    ///
+    void setTauLeapNCrit(uint ncrit);
+
+    uint getTauLeapNCrit(void) const;
+
+    /// Diffuse the molecules of any species with at least n molecules in
+    /// a tetrahedron or triangle in batches instead of as single events:
+    /// at the start of each window of length setDiffBatchDT the Diff and
+    /// SDiff kprocs over the threshold are taken off the SSA, and at its
+    /// end each moves the molecules that left in the window, split
+    /// multinomially over the neighbours. The other kprocs, including
+    /// diffusion of the species below the threshold, stay exact. 0 (the
+    /// default) turns batching off. Not available with the EField;
+    /// ignored when tau-leaping.
+    ///
+    void setDiffBatchThreshold(uint n);
+
+    uint getDiffBatchThreshold(void) const;
+
+    /// Set the window of the batched diffusion mode (default 1.0e-5s).
+    /// It should be short compared to the time a molecule takes to leave
+    /// a tetrahedron or triangle.
+    ///
+    void setDiffBatchDT(double dt);
+
+    double getDiffBatchDT(void) const;
+
+    /// Coarse-grain the diffusion of the species selected with
+    /// setCoarseGrainSpec. The tetrahedrons of each compartment are
+    /// grouped by cubic bins of edge h (metres). At the start of each
+    /// window of length setCoarseGrainDT the concentration of each group
+    /// is compared with those of its neighbouring groups; a group within
+    /// setCoarseGrainTol of all of them is merged into a single
+    /// well-mixed voxel for the window: diffusion between its own
+    /// tetrahedrons is taken off the SSA and its molecules are spread
+    /// over them by volume instead, while diffusion out of the group
+    /// stays exact. A group that is split again, and every group at the
+    /// end of a run, has its molecules spread by volume once more. 0 (the
+    /// default) turns the mode off. Not available with the EField;
+    /// ignored when tau-leaping or with batched diffusion.
+    ///
+    void setCoarseGrainSize(double h);
+
+    double getCoarseGrainSize(void) const;
+
+    /// Select species s for coarse-graining, or not (the default).
+    ///
+    void setCoarseGrainSpec(std::string const & s, bool cg);
+
+    bool getCoarseGrainSpec(std::string const & s) const;
+
+    /// Set the window of the coarse-grained mode (default 1.0e-4s). It
+    /// should be short compared to the time a molecule takes to leave a
+    /// group, but every window mixes the merged groups again, which
+    /// costs about one event per tetrahedron.
+    ///
+    void setCoarseGrainDT(double dt);
+
+    double getCoarseGrainDT(void) const;
+
+    /// Set the largest relative difference |c1 - c2| / (c1 + c2) between
+    /// the concentrations of a group and a neighbouring group for the
+    /// group to be merged (default 0.1).
+    ///
+    void setCoarseGrainTol(double tol);
+
+    double getCoarseGrainTol(void) const;
+
+    /// The number of groups of the coarse-grained mode, and the number
+    /// merged for species s in the last window run.
+    ///
+    uint getCoarseGrainNGroups(void);
+
+    uint getCoarseGrainNMerged(std::string const & s) const;
+
+    /// Set the number of threads that compute the currents of the
+    /// membrane triangles on each EField step (default 1). Each thread
+    /// does a fixed block of triangles and each triangle only updates
+    /// itself, so results do not depend on the number of threads. The
+    /// same threads decompose and solve the EField matrix blocks of
+    /// separate parts of the membrane.
+    ///
+    void setEfieldThreads(uint n);
+
+    uint getEfieldThreads(void) const;
+
+    /// Let run() adapt the EField dt after every EField step, so that the
+    /// largest potential change of an unclamped vertex stays near dvmax
+    /// (volts). The dt grows or shrinks by at most a factor of 2 per step
+    /// and is kept within [dtmin, dtmax] (seconds). A dvmax of 0 turns
+    /// the adaptive mode off and leaves the dt where it is.
+    ///
+    void setEfieldAdaptive(double dvmax, double dtmin, double dtmax);
+
+    double getEfieldAdaptiveDV(void) const;
+
+    /// Set the implicitness of the EField potential update: 1.0 is
+    /// backward Euler (the default), 0.5 is Crank-Nicolson, which is
+    /// second order and so allows a larger EField dt for the same
+    /// accuracy. Values in between blend the two.
+    ///
+    void setEfieldTheta(double theta);
+
+    double getEfieldTheta(void) const;
+
+    /// Decompose the EField matrix in single precision, halving its
+    /// storage and memory traffic, and recover double precision
+    /// solutions by iterative refinement (off by default). Only the
+    /// banded solvers (opt_method other than 3 and 5) support this.
+    /// getEfieldStat('refine') counts the refinement steps.
+    ///
+    void setEfieldMixedPrecision(bool mixed);
+
+    bool getEfieldMixedPrecision(void) const;
+
+    /// Return the name of the EField backend given at construction.
+    ///
+    std::string getEfieldBackend(void) const;
+
+    /// Run the EField potential update of each step on a helper thread
+    /// while the SSA goes on with the next step, which then sees the
+    /// potentials of the step before: the coupling lags by one EField
+    /// step. The update in flight is finished before run() returns. Off
+    /// by default.
+    ///
+    void setEfieldPipeline(bool pipe);
+
+    bool getEfieldPipeline(void) const;
+
+    /// Schedule the VDepTrans and VDepSReac kprocs by rejection: each is
+    /// entered in the scheduler with the largest rate it can have while
+    /// the potential of its triangle stays within dv (volts) of where it
+    /// was when last bounded. When one is selected, its exact rate is
+    /// computed and the event is accepted with the ratio of the two,
+    /// otherwise time advances without a change. After an EField step,
+    /// only the kprocs whose potential left the window are updated. A dv
+    /// of 0 (the default) updates every kproc exactly after each step.
+    ///
+    void setVDepWindow(double dv);
+
+    double getVDepWindow(void) const;
+
+    /// Schedule the VDepTrans kprocs of each rule in lumps: the triangles
+    /// whose potential falls in the same bin of width dv (volts) share one
+    /// scheduler entry, with the rate constant at the centre of the bin
+    /// times their total count of the source channel state. The triangle
+    /// that fires is chosen in proportion to its count. After an EField
+    /// step only the kprocs that changed bin are moved. The rates are
+    /// approximated to within the change of the rate constant over a bin.
+    /// A dv of 0 (the default) schedules each kproc on its own. Takes
+    /// precedence over setVDepWindow for VDepTrans.
+    ///
+    void setVDepLump(double dv);
+
+    double getVDepLump(void) const;
+
+    /// A counter of the EField steps since the last resetEfieldStats():
+    /// "steps" and "matrices" (matrix constructions), the wall clock
+    /// seconds spent in "rhs", "matrix" (construction and factorization)
+    /// and "solve" of the potential update, in "currents" (the membrane
+    /// triangle currents) and "update" (the voltage-dependent
+    /// propensities), "maxdv" (the largest potential change of a step,
+    /// volts), "halfbw" (the half bandwidth of the EField matrix), or of
+    /// the rejection scheduling (see setVDepWindow): "vdepcand" (selected
+    /// candidates), "vdepreject" (rejected ones) and "vdepmoved" (windows
+    /// moved, or kprocs moved to another lump (see setVDepLump), after an
+    /// EField step).
+    ///
+    double getEfieldStat(std::string const & stat) const;
+
+    void resetEfieldStats(void);
+
+    /// Hold the molecule counts of each tet and triangle in 16 bits, which
+    /// roughly halves their pool storage. An element is widened for good
+    /// when one of its counts exceeds 65535, and compacted again on
+    /// reset(). Results are not affected. Off by default.
+    ///
+    void setCompactPools(bool compact);
+
+    bool getCompactPools(void) const;
+
+    /// Keep running totals of the count of each species per compartment
+    /// and per patch, updated on every count change, so that the
+    /// compartment and patch counts are read in constant time instead of
+    /// summed over the elements. Off by default.
+    ///
+    void setCountTotals(bool on);
+
+    bool getCountTotals(void) const;
+
+    /// Stop run() at the event that brings the number of molecules of
+    /// species s in compartment c up to at least n (above) or down to at
+    /// most n (!above). The condition is checked after every event, on
+    /// the running count totals, which this turns on. A trigger fires
+    /// when its condition becomes true: one that already holds when
+    /// run() is called does not stop it. Returns the index of the
+    /// trigger. With tau-leaping or batched diffusion the run stops at
+    /// the end of the leap or window in which the condition became true.
+    ///
+    uint addCompCountTrigger(std::string const & c, std::string const & s,
+                             double n, bool above = true);
+
+    /// As addCompCountTrigger, for species s in patch p.
+    ///
+    uint addPatchCountTrigger(std::string const & p, std::string const & s,
+                              double n, bool above = true);
+
+    /// Remove all the triggers.
+    ///
+    void clearTriggers(void);
+
+    /// The index of the trigger that stopped the last run() or step(),
+    /// or -1 if none did.
+    ///
+    int getTriggered(void) const;
+
+    /// Interventions: changes to the state or the rate constants that
+    /// run() applies at given times, as a stimulus protocol would from
+    /// Python by splitting the run. Each returns the index of the
+    /// intervention, which is applied once at time t unless
+    /// repeatIntervention says otherwise.
+    ///
+    /// run() stops the SSA at the time of each intervention, applies all
+    /// those due at that time and refreshes the propensities they changed
+    /// in one batch before carrying on. One at the end time of run() is
+    /// applied by the next run(), as is one whose time was passed by
+    /// setTime or a restore. reset() starts the timeline again from its
+    /// beginning.
+    ///
+    /// Set the number of molecules of species s in compartment c to n, as
+    /// setCompCount does.
+    ///
+    uint scheduleCompCount(double t, std::string const & c,
+                           std::string const & s, double n);
+
+    /// Add n molecules of species s to compartment c, spread over its
+    /// tetrahedrons by volume.
+    ///
+    uint scheduleCompInject(double t, std::string const & c,
+                            std::string const & s, double n);
+
+    /// Add n molecules of species s to tetrahedron tidx.
+    ///
+    uint scheduleTetInject(double t, uint tidx, std::string const & s, double n);
+
+    /// Set the number of molecules of species s in patch p to n.
+    ///
+    uint schedulePatchCount(double t, std::string const & p,
+                            std::string const & s, double n);
+
+    /// Set the rate constant of reaction r in compartment c, or of
+    /// surface reaction r in patch p, to kf.
+    ///
+    uint scheduleCompReacK(double t, std::string const & c,
+                           std::string const & r, double kf);
+    uint schedulePatchSReacK(double t, std::string const & p,
+                             std::string const & r, double kf);
+
+    /// Clamp or release species s in compartment c.
+    ///
+    uint scheduleCompClamped(double t, std::string const & c,
+                             std::string const & s, bool clamped);
+
+    /// Set the current clamp on vertex vidx to cur (EField only).
+    ///
+    uint scheduleVertIClamp(double t, uint vidx, double cur);
+
+    /// Apply intervention i n times in all, every period from its first
+    /// time. Applications already made count towards n.
+    ///
+    void repeatIntervention(uint i, double period, uint n);
+
+    /// Remove all the interventions.
+    ///
+    void clearInterventions(void);
+
+    /// The number of applications of the interventions still to come.
+    ///
+    uint getNInterventions(void) const;
+
+    /// Run the SSA of run() on nclusters spatial clusters of tets in
+    /// parallel on nthreads threads, with optimistic synchronisation
+    /// over windows of the given length (see Clusters). 0 or 1 cluster
+    /// goes back to the serial SSA. Not available with the EField,
+    /// well-mixed compartments, tau-leaping, batched diffusion or
+    /// triggers. Each cluster is set up and run by the same thread every
+    /// time, so its working memory is local to that thread once the
+    /// threads are pinned (steps::setParallelCPUs).
+    ///
+    void setClusters(uint nclusters, uint nthreads = 1,
+                     double window = TETEXACT_CLUSTER_WINDOW);
+
+    uint getNClusters(void) const;
+
+    /// The number of times a cluster simulated (part of) a window, and
+    /// of those that started with a rollback, since setClusters.
+    ///
+    double getClusterRuns(void) const;
+
+    double getClusterRollbacks(void) const;
+
+    /// A hash, as 16 hexadecimal digits, of the simulation time, the
+    /// molecule counts of all elements and the membrane potentials of
+    /// the EField triangles. Equal hashes of two runs at the same time
+    /// mean they followed the same trajectory so far, e.g. the same
+    /// model and seed run with different thread counts, which give the
+    /// same results bit for bit.
+    ///
+    std::string getStateHash(void) const;
+
+    /// Mirror the molecule counts of all tets, and of all triangles, into
+    /// two contiguous solver-owned arrays of uints, one row per element
+    /// (mesh index) and one column per species (global index), updated on
+    /// every count change. Elements outside any compartment or patch
+    /// have rows of zeros. Turning this off frees the arrays. Off by
+    /// default.
+    ///
+    void setCountViews(bool on);
+
+    bool getCountViews(void) const;
+
+    /// Address of the tet or triangle count view, for read-only access
+    /// without copying, or 0 when the views are off. The address stays
+    /// valid until the views are turned off or the solver is destroyed.
+    ///
+    size_t getTetCountViewAddr(void) const;
+
+    size_t getTriCountViewAddr(void) const;
+
+    /// The phases of the solver construction, in the order they ran:
+    /// "statedef" (the state definition), "elements" (compartments,
+    /// patches, tets and triangles), "kprocs", "index" (the per-element
+    /// species dependency index), "deps" (the kproc update lists), with
+    /// the EField "efield.mesh", "efield.couple", "efield.order",
+    /// "efield.matrix" (the phases of the EField object, see
+    /// EField::getSetupTimes) and "efield" (all EField structures),
+    /// then "sched" (the scheduler) and "total" (all but "statedef").
+    ///
+    std::vector<std::string> getSetupPhases(void) const;
+
+    /// Wall clock time in seconds that a phase of the construction took.
+    ///
+    double getSetupTime(std::string const & phase) const;
+
+    /// The number of items a phase of the construction handled: the
+    /// species, reaction and diffusion rules for "statedef", the
+    /// elements for "elements", "index" and "total", the kprocs for
+    /// "kprocs" and "sched", the update list entries for "deps" and the
+    /// EField vertices for the EField phases.
+    ///
+    double getSetupCount(std::string const & phase) const;
+
+    /// Whether the solver was created with lazydeps, and the number of
+    /// kprocs whose update lists have been resolved so far (all of them
+    /// without lazydeps).
+    ///
+    bool getLazyDeps(void) const
+    { return pLazyDeps; }
+
+    uint getNResolvedKProcs(void) const;
+
+    /// The expected load of each tet of the mesh, for
+    /// Tetmesh::partitionTets: the number of its kinetic processes and
+    /// species, plus the kinetic processes of the triangles next to it.
+    /// Tets outside the compartments weigh 0.
+    ///
+    std::vector<double> getTetLoads(void) const;
+
+    /// Leave the kprocs that can never fire out of the update lists
+    /// (true), or put them back (false, the default). Call it once the
+    /// initial counts and clamps are set. A species is reachable in a
+    /// compartment or patch if it has molecules there, or if a process
+    /// that can fire produces it there or brings it in across a patch
+    /// or diffusion boundary; processes without reactants can always
+    /// fire, and the others once all their reactants are reachable.
+    /// Active flags and rate constants are not looked at, so the
+    /// analysis holds whatever they are set to later. A process with an
+    /// unreachable reactant has a zero propensity for good, and so do
+    /// the diffusions of an unreachable species, so they are no longer
+    /// recomputed after the events that change their other reactants.
+    ///
+    /// The kprocs are still created, the analysis needing the counts.
+    /// Giving a pruned species molecules, reset() and the restore
+    /// methods switch pruning off again; it then has to be set again
+    /// for the new state. Not with checkpointRestart.
+    ///
+    void setNetworkPruning(bool prune);
+
+    bool getNetworkPruning(void) const;
+
+    /// The number of kprocs left out of the update lists by pruning.
+    ///
+    uint getNPrunedKProcs(void) const;
+
+    /// The names of the species that pruning found unreachable in
+    /// compartment or patch loc, and of the reactions (for a patch:
+    /// surface reactions, voltage-dependent surface reactions and
+    /// transitions, and GHK currents) that can never fire there.
+    ///
+    std::vector<std::string> getPrunedSpecs(std::string const & loc) const;
+
+    std::vector<std::string> getPrunedReacs(std::string const & loc) const;
+
+    /// Tally the SSA events per kproc type, with the length of their
+    /// update lists and the wall clock time spent selecting, applying
+    /// and updating them (off by default). The tallies add up until
+    /// resetProfile(). Batched diffusion moves and tau-leaps are not
+    /// SSA events and are not tallied.
+    ///
+    void setProfiling(bool on);
+
+    bool getProfiling(void) const;
+
+    /// A tally of the profile for the kprocs of type ktype ("Reac",
+    /// "Diff", "SReac", "SDiff", "VDepTrans", "VDepSReac", "GHKcurr", or
+    /// "all" for their sum): the number of "events", the total length of
+    /// their update lists "updates", and the wall clock seconds spent in
+    /// "apply" and in "update" (refreshing the propensities on the
+    /// update lists). "getnext", the seconds spent selecting the next
+    /// event, is only available for "all".
+    ///
+    double getProfileStat(std::string const & ktype, std::string const & stat) const;
+
+    void resetProfile(void);
+
+    /// Count the SSA events of the kprocs of each tet and triangle, by
+    /// kproc type (off by default), to show where in the mesh the solver
+    /// spends its events. The counts add up until resetElementEvents().
+    /// As with the profile, batched diffusion moves, tau-leaps and the
+    /// events of clusters are not counted, nor are those of well-mixed
+    /// volumes.
+    ///
+    void setElementEvents(bool on);
+
+    bool getElementEvents(void) const;
+
+    /// The events counted for the kprocs of type ktype ("Reac", "Diff",
+    /// "SReac", "SDiff", "VDepTrans", "VDepSReac", "GHKcurr" or "all")
+    /// of each tet, or of each triangle, of the mesh.
+    ///
+    std::vector<double> getTetEvents(std::string const & ktype) const;
+    std::vector<double> getTriEvents(std::string const & ktype) const;
+
+    void resetElementEvents(void);
+
+    /// Write every SSA event from now on to file_name, as the event time
+    /// (in whole ticks of resolution seconds) and the schedule index of
+    /// the kproc, until stopEventTrace(); a trace already being written
+    /// is closed first. The records are compact varints (see
+    /// EventTrace), encoded as the events happen and written to the file
+    /// by a background thread. The file starts with a table of the
+    /// kprocs: the type, the element (the tet, ntets + the triangle, or
+    /// ntets + ntris + the compartment of a well-mixed volume) and the
+    /// global index of the process, whose names are also listed.
+    ///
+    /// Runs with the EField are traced. Clusters, domains, tau-leaping,
+    /// batched diffusion and coarse graining do not run event by event,
+    /// and a run with any of them throws while a trace is being written.
+    ///
+    void startEventTrace(std::string const & file_name, double resolution = 1.0e-12);
+
+    /// Write out the rest of the trace and close its file. Throws if any
+    /// part of it could not be written.
+    ///
+    void stopEventTrace(void);
+
+    bool getEventTrace(void) const;
+
+    /// The number of events in the trace being written.
+    ///
+    double getEventTraceCount(void) const;
+
+    /// Stream a decimated view of the molecule counts to file_name, best
+    /// placed in shared memory (/dev/shm), for viewers to map and read
+    /// while the simulation runs; a stream already open is closed first.
+    /// The bounding box of the mesh is cut into nx * ny * nz voxels, and
+    /// every tet and triangle adds its counts of the species specs to
+    /// the voxel holding its barycentre. The solver keeps the voxel
+    /// totals up to date as the counts change, as it does those of the
+    /// regions of interest, and a background thread copies them to the
+    /// file fps times a second of wall clock time without stopping the
+    /// simulation (see SnapshotStream for the file layout). While
+    /// clusters run the totals only catch up at the end of each run().
+    ///
+    void setSnapshotStream(std::string const & file_name,
+                           uint nx, uint ny, uint nz,
+                           std::vector<std::string> const & specs,
+                           double fps = 10.0);
+
+    /// Stop the stream, leaving its file with the last frame.
+    ///
+    void clearSnapshotStream(void);
+
+    /// Publish a frame of the stream now, e.g. at the end of a run.
+    ///
+    void publishSnapshot(void);
+
+    /// The number of frames the stream has published, or 0 without one.
+    ///
+    double getSnapshotFrames(void) const;
+
 	////////////////////////////////////////////////////////////////////////
     // SOLVER STATE ACCESS:
     //      ADVANCE
@@ -223,6 +1082,12 @@ public:
     bool _getPatchVDepSReacActive(uint pidx, uint vsridx) const;
     void _setPatchVDepSReacActive(uint pidx, uint vsridx, bool a);
 
+    /// Surface diffusion has no solver API accessors; these are used by
+    /// the hybrid solver to hand a species' surface diffusion to the ODE.
+    ///
+    bool _getPatchSDiffActive(uint pidx, uint didx) const;
+    void _setPatchSDiffActive(uint pidx, uint didx, bool act);
+
     ////////////////////////////////////////////////////////////////////////
     // SOLVER STATE ACCESS:
     //      DIFFUSION BOUNDARIES
@@ -231,6 +1096,32 @@ public:
     void _setDiffBoundaryDiffusionActive(uint dbidx, uint didx, bool act);
     bool _getDiffBoundaryDiffusionActive(uint dbidx, uint didx) const;
 
+    ////////////////////////////////////////////////////////////////////////
+    // FLUX COUNTERS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// The counters add up the SSA events as they are executed; as with
+    /// the profile, batched diffusion moves, tau-leaps and the events of
+    /// clusters are not counted. Elements where the reaction or species
+    /// is not defined add nothing.
+    ///
+    uint _addTetsReacFlux(std::vector<uint> const & tets, uint ridx);
+    uint _addTrisSReacFlux(std::vector<uint> const & tris, uint sridx);
+    uint _addTrisDiffFlux(std::vector<uint> const & tris, uint sidx);
+    double _takeFluxCount(uint i);
+
+    ////////////////////////////////////////////////////////////////////////
+    // REGIONS OF INTEREST
+    ////////////////////////////////////////////////////////////////////////
+
+    /// The totals of a region are kept by its elements as their counts
+    /// change, so reading them costs nothing. An element listed twice
+    /// counts once; tets and triangles outside the compartments and
+    /// patches add nothing.
+    ///
+    uint _addROI(std::vector<uint> const & tets, std::vector<uint> const & tris);
+    double _getROICount(uint roi, uint sidx) const;
+
     ////////////////////////////////////////////////////////////////////////
     // SOLVER STATE ACCESS:
     //      TETRAHEDRAL VOLUME ELEMENTS
@@ -242,6 +1133,9 @@ public:
     bool _getTetSpecDefined(uint tidx, uint sidx) const;
 
     double _getTetCount(uint tidx, uint sidx) const;
+    void _beginBatch(void);
+    void _endBatch(void);
+
     void _setTetCount(uint tidx, uint sidx, double n);
 
     double _getTetAmount(uint tidx, uint sidx) const;
@@ -366,6 +1260,10 @@ public:
 	inline uint countKProcs(void) const
 	{ return pKProcs.size(); }
 
+	/// The kproc with schedule index sidx.
+	inline steps::tetexact::KProc * kproc(uint sidx) const
+	{ return pKProcs[sidx]; }
+
     ////////////////////////////////////////////////////////////////////////
 
 	inline steps::tetmesh::Tetmesh * mesh(void) const
@@ -408,7 +1306,7 @@ public:
     { return pTris; }
 
     inline double a0(void) const
-    { return pA0; }
+    { return pScheduler->getA0(); }
 
     //inline bool built(void)
     //{ return pBuilt; }
@@ -434,8 +1332,116 @@ public:
 			int tinner, int touter, int tri0, int tri1, int tri2);
 
 	// called when local tet, tri, reac, sreac objects have been created
-	// by constructor
-	void _setup(void);
+	// by constructor. If src is given, the element geometry and the kproc
+	// dependencies are copied from that solver, which must have been
+	// created with the same model and geometry. If structure is given,
+	// the kproc dependencies and EField ordering are read from it, as
+	// written by _checkpointStructure.
+	void _setup(Tetexact * src = 0, std::istream * structure = 0);
+
+	// Write the kproc update lists and the EField ordering and coupling
+	// constants for a restart, and read the update lists back into the
+	// kprocs of this solver, checking that they match.
+	void _checkpointStructure(std::ostream & out);
+	void _restoreStructure(std::istream & in);
+
+	// Append structure to checkpoint file file_name, and read it back.
+	static void _appendRestart(std::string const & file_name,
+	                           std::string const & structure);
+	static void _readRestart(std::string const & file_name,
+	                         std::string & structure);
+
+	// The state traversals behind checkpoint and restore. The state ends
+	// with that of the scheduler and the pending event, unless sched is
+	// false (files before version 3).
+	void _checkpoint(std::iostream & cp_file);
+	void _restore(std::iostream & cp_file, bool sched = true);
+
+	// Only the state that run() changes: the time and step count, the
+	// molecule counts, the kproc extents and the EField state. The rest
+	// is left as it is, so _restoreRun() goes on top of a full _restore()
+	// of the state the run started from (see Ensemble).
+	void _checkpointRun(std::iostream & cp_file);
+	void _restoreRun(std::iostream & cp_file);
+
+	// The traversals behind checkpointDelta and restoreDelta, and the
+	// reset of the modified flags of all elements and kprocs.
+	void _checkpointDelta(std::iostream & cp_file);
+	void _restoreDelta(std::iostream & cp_file);
+	void _clearModified(void);
+
+	// _setCompReacK and _setPatchSReacK without the refresh of the
+	// propensities, so that many constants can be set before one
+	// _update() (see Ensemble::sweep).
+	void _applyCompReacK(uint cidx, uint ridx, double kf);
+	void _applyPatchSReacK(uint pidx, uint ridx, double kf);
+
+	// Read the state block of checkpoint file file_name into data,
+	// checking its header against this solver, and return its format
+	// version (0 for the unversioned format). The delta format has its
+	// own magic string and version.
+	uint _readCheckpoint(std::string const & file_name, std::string & data,
+						 bool delta = false);
+
+	// Write data as the state block of a checkpoint or delta file. The
+	// static form takes the solver shape and touches no solver state, so
+	// that it can run on the thread of checkpointAsync.
+	void _writeCheckpoint(std::string const & file_name,
+						  std::string const & data, bool delta = false);
+	static void _writeCheckpoint(std::string const & file_name,
+								 std::vector<uint> const & shape,
+								 std::string const & data, bool delta);
+
+	// A checkpoint being written by checkpointAsync, and the entry point
+	// of its thread.
+	struct CheckpointWrite;
+	static void * _checkpointWriter(void * arg);
+
+	// The sizes that a checkpoint header records and that restore checks
+	// against this solver: sizeof(uint), sizeof(double), and the numbers
+	// of comps, patches, diffusion boundaries, tets, triangles and kprocs
+	// and the EField flag.
+	void _checkpointShape(std::vector<uint> & shape) const;
+
+	// Write data as a block of file file_name, after magic, version and
+	// shape, and return its hash; read it back, after the magic, checking
+	// the version and this solver's shape, and return its stored hash.
+	// The static form touches no solver state and the reader only reads
+	// the shape, so the shards of checkpointShards use them on threads
+	// of their own.
+	static uint _writeBlock(std::string const & file_name, char const * magic,
+							uint version, std::vector<uint> const & shape,
+							std::string const & data);
+	uint _readBlock(std::istream & cp_file, std::string const & file_name,
+					uint expected, std::string & data) const;
+
+	// The elements of the shards of checkpointShards: the positions of
+	// the tetrahedrons in pTets, then those of the triangles in pTris
+	// offset by pTets.size().
+	void _shardElems(std::vector<uint> & elems) const;
+
+	// The state of the elements elems[begin, end), each followed by its
+	// kprocs, written to or read from shard file file_name. Each shard
+	// only reads or writes its own elements and kprocs.
+	uint _writeShard(std::string const & file_name,
+					 std::vector<uint> const & elems, uint begin, uint end,
+					 std::vector<uint> const & shape);
+	uint _readShard(std::string const & file_name, uint begin, uint end,
+					std::string & data) const;
+	void _restoreShard(std::vector<uint> const & elems, uint begin, uint end,
+					   std::string const & data);
+
+	// The state outside the elements of the shards, held in the index
+	// file: definitions, compartments, patches, diffusion boundaries,
+	// well-mixed volumes and their kprocs, and the EField.
+	void _checkpointGlobal(std::iostream & cp_file);
+	void _restoreGlobal(std::iostream & cp_file);
+
+	// Rebuild the scheduler and the totals from the restored state. If
+	// sched is given, the scheduler state and the pending event written
+	// by _checkpoint are read from it and replace the rebuilt ones,
+	// unless the scheduler is set up otherwise than the one written.
+	void _restoreDone(std::istream * sched = 0);
 
 
 	//void _build(void);
@@ -443,30 +1449,46 @@ public:
 	double _getRate(uint i) const
 	{ return pKProcs[i]->rate(); }
 
-	steps::tetexact::KProc * _getNext(void) const;
-
 	//void _reset(void);
 
 	void _executeStep(steps::tetexact::KProc * kp, double dt);
 
-	// TODO: Change the following so that only the kprocs depending on
-	// the species are updated. These functions are called from interface
-	// methods setting compartment or patch counts.
-    /// Update the kproc's of a tet, after a species has been changed.
-    /// This also updates kproc's in surrounding triangles.
-    ///
-    /// Currently doesn't care about the species.
+    /// Update the kproc's of a tet and of its surrounding triangles
+    /// whose rates depend on species spec_lidx of the tet, after its
+    /// count has been changed.
     ///
     void _updateSpec(steps::tetexact::WmVol * tet, uint spec_lidx);
 
-    /// Update the kproc's of a triangle, after a species has been changed.
+    /// Update the kproc's of a triangle whose rates depend on species
+    /// spec_lidx of the triangle, after its count has been changed.
     /// This does not need to update the kproc's of any neighbouring
     /// tetrahedrons.
     ///
-    /// Currently doesn't care about the species.
-    ///
     void _updateSpec(steps::tetexact::Tri * tri, uint spec_lidx);
 
+    /// Add the kprocs _updateSpec would update to the dirty set, for a
+    /// later _updateDirty. Setters that change many elements mark them
+    /// all and update once.
+    ///
+    void _markSpec(steps::tetexact::WmVol * tet, uint spec_lidx);
+    void _markSpec(steps::tetexact::Tri * tri, uint spec_lidx);
+
+    /// Refresh the propensities of the kprocs in the dirty set, commit
+    /// the scheduler once and empty the set.
+    ///
+    void _updateDirty(void);
+
+    /// Round a count up with probability equal to its fraction, as the
+    /// count setters do; negative counts round to 0.
+    ///
+    uint _roundCount(double n);
+
+    /// The arena that holds the tets, triangles and kprocs of this solver
+    /// and their update lists.
+    ///
+    inline Arena & arena(void)
+    { return pArena; }
+
 
     ////////////////////////// ADDED FOR EFIELD ////////////////////////////
 
@@ -474,7 +1496,13 @@ public:
     inline bool efflag(void) const
     { return pEFflag; }
 
-    void _setupEField(void);
+    /// Set up the EField, with the vertex ordering and coupling
+    /// constants in opt_data (as EField::saveOptimal writes them) if not
+    /// empty.
+    ///
+    void _setupEField(std::string const & opt_data = "");
+
+    void _setupPhase(std::string const & phase, double seconds, uint count);
 
     inline uint neftets(void) const
     { return pEFNTets; }
@@ -491,6 +1519,16 @@ private:
 
 	////////////////////////////////////////////////////////////////////////
 
+	// Constructor of clone(). Copies the options of src and sets up from it.
+	Tetexact(Tetexact & src, steps::rng::RNG * r);
+
+	// The state image that clone() and fork() restore from, and a clone
+	// drawing from r restored from it.
+	std::string _cloneImage(void);
+	Tetexact * _cloneFrom(std::string const & image, steps::rng::RNG * r);
+
+	////////////////////////////////////////////////////////////////////////
+
 	steps::tetmesh::Tetmesh * 				   pMesh;
 
     ////////////////////////////////////////////////////////////////////////
@@ -504,6 +1542,14 @@ private:
 
     std::vector<steps::tetexact::DiffBoundary *> pDiffBoundaries;
 
+    // Storage of the mesh elements and kprocs, released in one go when
+    // the solver is destroyed.
+    Arena                                      pArena;
+
+    // Extra arenas for the dependency lists resolved by the other set up
+    // threads; pSetupArenas[t - 1] belongs to thread t.
+    std::vector<Arena *>                       pSetupArenas;
+
     // These objects are used to describe a mesh compartment that is
     // being treated as a well-mixed volume.
     std::vector<steps::tetexact::WmVol *>      pWmVols;
@@ -515,159 +1561,501 @@ private:
 
 
     ////////////////////////////////////////////////////////////////////////
-    // CR SSA Kernel Data and Methods
+    // SSA Kernel Data and Methods
     ////////////////////////////////////////////////////////////////////////
     uint                                        nEntries;
-    double                                      pSum;
-    double                                      nSum;
-    double                                      pA0;
 
     std::vector<KProc*>                         pKProcs;
 
-    std::vector<CRGroup*>                       nGroups;
-    std::vector<CRGroup*>                       pGroups;
+    // The event scheduler, owned by the solver.
+    steps::solver::ssa::Scheduler             * pScheduler;
+
+    // The MPI domains of setDomains, or 0.
+    steps::tetexact::Domains                  * pDomains;
+
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // The kprocs are ordered by type: those of type t have schedule
+    // indices [pKProcTypeBegin[t], pKProcTypeBegin[t + 1]).
+    uint                                        pKProcTypeBegin[KP_NTYPES + 1];
 
     ////////////////////////////////////////////////////////////////////////////////
 
-    inline void _update(std::vector<KProc*> const & upd_entries) {
-        #ifdef SSA_DEBUG
-        std::cout << "SSA: update selected entries\n";
-        #endif
-        uint n_upd_entries = upd_entries.size();
+    /// The propensity of a kproc, by a switch on its type tag instead of
+    /// the virtual call.
+    ///
+    double _rate(KProc * kp);
 
-        for (uint i = 0; i < n_upd_entries; i++) {
-            _updateElement(upd_entries[i]);
-        }
+    /// Refresh the propensities of the kprocs in a list.
+    ///
+    void _update(KProcIdxSpan const & upd_entries);
 
-        _updateSum();
-        #ifdef SSA_DEBUG
-        std::cout << "--------------------------------------------------------\n";
-        #endif
-    }
+    /// Refresh the propensities of all kprocs, one type at a time.
+    ///
+    void _update(void);
 
-    ////////////////////////////////////////////////////////////////////////////////
+    /// Select the next SSA event, as the scheduler's getNext at the
+    /// current time, timed when profiling.
+    ///
+    uint _getNext(double & dt);
 
-    inline void _update(void) {
-        #ifdef SSA_DEBUG
-        std::cout << "SSA: update all entries\n";
-        #endif
-        for (uint i = 0; i < nEntries; i++) {
-            _updateElement(pKProcs[i]);
-        }
+    /// The next SSA event: the one drawn but not fired by the last run()
+    /// if there is one, otherwise a new one from _getNext.
+    ///
+    uint _nextEvent(double & dt);
 
-        _updateSum();
-        #ifdef SSA_DEBUG
-        std::cout << "--------------------------------------------------------\n";
-        #endif
-    }
+    /// Commit the scheduler updates made at time t, which drops the
+    /// pending event.
+    ///
+    void _commit(double t);
 
-    ////////////////////////////////////////////////////////////////////////////////
+    /// run() in the cluster mode.
+    ///
+    void _runClusters(double endtime);
 
-    inline CRGroup* _getGroup(int pow) {
-        #ifdef SSA_DEBUG
-        std::cout << "SSA: get group with power " << pow << "\n";
-        #endif
-
-        if (pow >= 0) {
-            #ifdef SSA_DEBUG
-            std::cout << "positive group" << pow << "\n";
-            #endif
-            return pGroups[pow];
-        }
-        else {
-            #ifdef SSA_DEBUG
-            std::cout << "negative group" << -pow << "\n";
-            #endif
-            return nGroups[-pow];
-        }
-        #ifdef SSA_DEBUG
-        std::cout << "--------------------------------------------------------\n";
-        #endif
-    }
+    inline void _dropPending(void)
+    { pPendingKProc = steps::solver::ssa::SCHED_IDX_UNDEFINED; }
 
-    ////////////////////////////////////////////////////////////////////////////////
+    /// Compute the armed state of all triggers from the current counts.
+    ///
+    void _armTriggers(void);
 
-    inline void _extendPGroups(uint new_size) {
-        uint curr_size = pGroups.size();
+    /// Check the triggers after an event; returns true and sets
+    /// pTriggered if one fired.
+    ///
+    bool _checkTriggers(void);
 
-        #ifdef SSA_DEBUG
-        std::cout << "SSA: extending positive group size to " << new_size;
-        std::cout << " from " << curr_size << ".\n";
-        std::cout << "--------------------------------------------------------\n";
-        #endif
+    /// The body of run() for one stretch without interventions, up to
+    /// endtime.
+    ///
+    void _runTo(double endtime);
 
-        while (curr_size < new_size) {
-            pGroups.push_back(new CRGroup(curr_size));
-            curr_size ++;
-        }
-    }
+    /// Apply every intervention due at or before time t, bringing the
+    /// time up to t, with one refresh of the propensities.
+    ///
+    void _applyInterventions(double t);
 
-    ////////////////////////////////////////////////////////////////////////////////
+    /// Add intervention i to the timeline at its next application, if
+    /// any is left.
+    ///
+    void _queueIntervention(uint i);
+
+    /// Add an intervention of kind kind at time t and queue it.
+    ///
+    uint _addIntervention(double t, uint kind, uint loc, uint obj, double value);
+
+    /// _executeStep with the tallies of the profile.
+    ///
+    void _executeStepProfiled(KProc * kp, double dt);
 
-    inline void _extendNGroups(uint new_size) {
+    /// Count an event of kp for its element (see setElementEvents).
+    ///
+    void _countElementEvent(KProc * kp);
 
-        uint curr_size = nGroups.size();
+    // The kproc table of an event trace file.
+    std::string _eventTraceHeader(void) const;
 
-        #ifdef SSA_DEBUG
-        std::cout << "SSA: extending negative group size to " << new_size;
-        std::cout << " from " << curr_size << ".\n";
-        std::cout << "--------------------------------------------------------\n";
-        #endif
+    /// Make event direction dir of kp add sign to flux counter counter.
+    /// Direction 0 stands for every event of a kproc that is not a
+    /// diffusion.
+    ///
+    void _addFluxEntry(KProc * kp, uint counter, uint dir, int sign);
 
-        while (curr_size < new_size) {
+    /// Add an event of kp to the flux counters watching it.
+    ///
+    void _countFlux(KProc * kp);
 
-            nGroups.push_back(new CRGroup(-curr_size));
-            curr_size ++;
-        }
-    }
+    /// Point every tet and triangle at the totals rows of the regions of
+    /// interest holding it, and of its snapshot voxel, and sum the totals
+    /// afresh (on), or at none.
+    ///
+    void _linkROIs(bool on);
 
-    ////////////////////////////////////////////////////////////////////////////////
+    /// Whether the elements keep totals: those of regions of interest or
+    /// of the voxels of a snapshot stream.
+    ///
+    bool _hasROIs(void) const
+    { return (pROIElems.empty() == false || pSnapVoxels.empty() == false); }
 
-    inline void _extendGroup(CRGroup* group, uint size = 1024) {
-        #ifdef SSA_DEBUG
-        std::cout << "SSA: extending group storage\n";
-        std::cout << "current capacity: " << group->capacity << "\n";
-        #endif
-
-        group->capacity += size;
-        group->indices = (KProc**)realloc(group->indices,
-                                          sizeof(KProc*) * group->capacity);
-        if (group->indices == NULL) {
-            std::cerr << "DirectCR: unable to allocate memory for SSA group.\n";
-            throw;
-        }
-        #ifdef SSA_DEBUG
-        std::cout << "capacity after extending: " << group->capacity << "\n";
-        std::cout << "--------------------------------------------------------\n";
-        #endif
-    }
+    /// Sum the totals of the regions of interest and of the snapshot
+    /// voxels afresh, after a reset or restore.
+    ///
+    void _sumROICounts(void);
 
-    ////////////////////////////////////////////////////////////////////////////////
+    /// The events counted for the elements from first to first + n of
+    /// pElemEvents, for kproc type ktype.
+    ///
+    std::vector<double> _elementEvents(std::string const & ktype,
+                                       uint first, uint n) const;
 
-    void _updateElement(KProc* kp);
+    /// Resolve the update lists of kp, or of every kproc, where they are
+    /// still pending (see lazydeps).
+    ///
+    void _resolveDeps(KProc * kp);
+    void _resolveAllDeps(void);
+
+    /// Rebuild the update lists of the kprocs that can change the pools
+    /// of vols and tris, after their clamped flags changed. The lists
+    /// leave out the kprocs that depend only on clamped pools, since
+    /// those pools never change (see WmVol::specDeps). The new lists are
+    /// packed into the arena; the old ones are not reclaimed.
+    ///
+    void _clampsChanged(std::vector<WmVol *> const & vols,
+                        std::vector<Tri *> const & tris);
 
-    inline void _updateSum(void) {
-        #ifdef SSA_DEBUG
-        std::cout << "update A0 from " << pA0 << " to ";
-        #endif
+    /// _clampsChanged for every element, after the clamped flags were
+    /// restored or reset; does nothing while no list was built around
+    /// a clamp and nothing is clamped.
+    ///
+    void _allClampsChanged(void);
+
+    /// Switch pruning off if it is on, putting the pruned kprocs back
+    /// into the update lists.
+    ///
+    void _dropPruning(void);
+
+    /// The compartment (0 .. ncomps - 1) or patch (from ncomps on) named
+    /// loc, for the pruning report.
+    ///
+    uint _pruneLoc(std::string const & loc) const;
 
-        pA0 = 0.0;
+    /// Pick the next EField dt of the adaptive mode from the potential
+    /// change of the step of length ef_dt just taken.
+    ///
+    void _adaptEfieldDT(double ef_dt, double dv);
 
-        uint n_neg_groups = nGroups.size();
-        uint n_pos_groups = pGroups.size();
+    // An EField update running on a helper thread with setEfieldPipeline,
+    // and the entry point of its thread.
+    struct EFieldAdvance;
+    static void * _efieldAdvancer(void * arg);
 
-        for (uint i = 0; i < n_neg_groups; i++) {
-            pA0 += nGroups[i]->sum;
-        }
+    /// Start advancing the EField by ef_dt on a helper thread.
+    ///
+    void _startEfield(double ef_dt);
 
-        for (uint i = 0; i < n_pos_groups; i++) {
-            pA0 += pGroups[i]->sum;
-        }
+    /// Wait for the EField update in flight, if any, and bring the
+    /// voltage-dependent propensities up to date with it. Throws if the
+    /// update failed.
+    ///
+    void _finishEfield(void);
 
-        #ifdef SSA_DEBUG
-        std::cout << pA0 << "\n";
-        #endif
-    }
+    /// Wait for the EField update in flight, if any, and drop its result.
+    ///
+    void _joinEfield(void);
+
+    /// Sum the running count totals of the compartments and patches
+    /// afresh, after a reset or restore.
+    ///
+    void _sumCountTotals(void);
+
+    /// Point the tets and triangles at their rows of the count views, or
+    /// at none, and fill the views from the pools.
+    ///
+    void _syncCountViews(void);
+
+    // Refresh the kprocs of type T in [begin, end), without committing.
+    template <class T>
+    void _updateRange(uint begin, uint end, double t);
+
+    /// Group the VDepTrans and VDepSReac kprocs by rule for
+    /// _updateVDep (after _setupEField).
+    ///
+    void _setupVDepBatches(void);
+
+    /// Tabulate the GHK currents' flux at the current temperature.
+    ///
+    void _setupGHKTables(void);
+
+    /// Index, for each compartment, the kprocs of its volumes that depend
+    /// on each of its species (see pCompSpecKProcs), and size the dirty
+    /// set.
+    ///
+    void _setupSpecKProcs(std::vector<WmVol *> const & vols);
+
+    /// Refresh the propensities of the voltage-dependent kprocs after an
+    /// EField step. The potentials of each rule's kprocs are checked
+    /// against its table once, and interpolated in one pass.
+    ///
+    void _updateVDep(void);
+
+    /// With setVDepWindow on: give the VDepTrans and VDepSReac kprocs
+    /// whose potential left their window, or all of them, a window
+    /// around the current potential and the bounding rate.
+    ///
+    void _updateVDepWindows(double t, bool all);
+
+    /// With setVDepWindow on: whether the selected kproc kp is a
+    /// rejected candidate.
+    ///
+    bool _vdepReject(KProc * kp);
+
+    /// With setVDepLump on: move the VDepTrans kprocs whose potential left
+    /// the bin of their lump, or all of them, to the lump of their bin,
+    /// and update the entries of the lumps that changed.
+    ///
+    void _updateVDepLumps(double t, bool all);
+
+    /// With setVDepLump on: refresh the count of the VDepTrans kp in its
+    /// lump, updating the lump's entry if it changed, and return the rate
+    /// of kp's own entry (its lump's if it hosts one, otherwise 0).
+    ///
+    double _vdepLumpRate(KProc * kp);
+
+    /// With setVDepLump on: the kproc to apply when the entry of kp is
+    /// selected (a member of the lump kp hosts), otherwise kp.
+    ///
+    KProc * _vdepLumpPick(KProc * kp);
+
+    /// Refresh the propensity of a single KProc, or within a batch mark
+    /// it for _endBatch.
+    ///
+    void _updateElement(KProc * kp);
+
+    // Return the scheduler below any split or group wrapper.
+    steps::solver::ssa::Scheduler * _baseScheduler(void) const;
+
+    // Remove a split or group wrapper, keeping the scheduler below it.
+    void _unwrapScheduler(void);
+
+    // Return the scheduler as a CR scheduler, or throw if it is not one.
+    steps::solver::ssa::CRScheduler * _crScheduler(void) const;
+
+    /// Run to endtime with the domains of setDomains.
+    ///
+    void _runDomains(double endtime);
+
+    // Fill rank with the position of each mesh tet in the memory layout:
+    // its index, or its place in reverse Cuthill-McKee order if the
+    // solver was created with reorder.
+    void _tetLayout(std::vector<uint> & rank);
+
+    bool                                        pReorder;
+
+    uint                                        pSetupThreads;
+
+    // The EField backend.
+    std::string                                 pEFBackend;
+
+    // Whether the update lists are resolved on first use.
+    bool                                        pLazyDeps;
+
+    // Whether update lists may have been built around clamped pools.
+    bool                                        pClampDeps;
+
+    // Network pruning: whether it is on, the number of kprocs pruned,
+    // and per compartment, then per patch, a flag for each global
+    // species that is unreachable there and the names of the species
+    // and reactions pruned.
+    bool                                        pPruning;
+    uint                                        pNPruned;
+    std::vector<std::vector<char> >             pPruneDead;
+    std::vector<std::vector<std::string> >      pPrunedSpecs;
+    std::vector<std::vector<std::string> >      pPrunedReacs;
+
+    ////////////////////////////////////////////////////////////////////////
+    // TAU-LEAPING
+    ////////////////////////////////////////////////////////////////////////
+
+    // Collect the stoichiometry of all kprocs into the flat leap tables.
+    void _leapSetup(void);
+
+    // Advance the simulation to endtime by tau-leaping.
+    void _runTauLeap(double endtime);
+
+    // Advance the simulation to endtime with batched diffusion.
+    void _runDiffBatched(double endtime);
+
+    // Advance the simulation to endtime with coarse-grained diffusion.
+    void _runCoarseGrained(double endtime);
+
+    // Build the groups of the coarse-grained mode, if not built.
+    void _setupCoarseGrain(void);
+
+    // Decide which groups are merged for each coarse-grained species and
+    // spread the molecules of the merged ones by volume. With on false,
+    // split every group.
+    void _coarseGrain(bool on);
+
+    // Spread the molecules of species sidx in group g over its tets by
+    // volume.
+    void _mixGroup(uint g, uint sidx);
+
+    // Count of leap species s.
+    inline double _leapCount(uint s) const
+    { return pLeapVol[s]->count(pLeapLidx[s]); }
+
+    bool                                        pTauLeap;
+    double                                      pLeapEps;
+    uint                                        pLeapNCrit;
+
+    // The species pools the kprocs read or change, with for each the
+    // highest order of a leapable kproc consuming it and the number of
+    // molecules that kproc consumes.
+    std::vector<steps::tetexact::WmVol *>      pLeapVol;
+    std::vector<uint>                           pLeapLidx;
+    std::vector<uint>                           pLeapHOR;
+    std::vector<uint>                           pLeapHORn;
+
+    // Per kproc, whether it can be leaped, and in CSR form its reactants
+    // and its changes (see LeapTerm).
+    std::vector<char>                           pLeapAble;
+    std::vector<uint>                           pLeapLhsStart;
+    std::vector<uint>                           pLeapLhsSpec;
+    std::vector<uint>                           pLeapLhsN;
+    std::vector<uint>                           pLeapUpdStart;
+    std::vector<uint>                           pLeapUpdSpec;
+    std::vector<double>                         pLeapUpdN;
+    std::vector<double>                         pLeapUpdVar;
+    std::vector<char>                           pLeapUpdExact;
+
+    uint                                        pDiffBatchThreshold;
+    double                                      pDiffBatchDT;
+
+    // The coarse-grained mode: the selected species by global index,
+    // the bin size (0.0 when off), the window and the tolerance.
+    std::vector<bool>                           pCGSpecs;
+    double                                      pCGSize;
+    double                                      pCGDT;
+    double                                      pCGTol;
+
+    // The groups, built on first use (none while pCGGroupStart is
+    // empty): the group of each tet, in CSR form the tets and the
+    // neighbouring groups of each group, and whether group g is merged
+    // for species s, at g * nspecs + s; by species, the number merged
+    // in the last window run.
+    std::vector<uint>                           pCGGroup;
+    std::vector<uint>                           pCGGroupStart;
+    std::vector<uint>                           pCGGroupTets;
+    std::vector<uint>                           pCGNeighbStart;
+    std::vector<uint>                           pCGNeighbs;
+    std::vector<bool>                           pCGMerged;
+    std::vector<uint>                           pCGNMerged;
+
+    bool                                        pCompactPools;
+
+    bool                                        pCountTotals;
+
+    /// A stopping condition of run(): the count of a species in a
+    /// compartment (comp != 0) or patch, against a threshold. A trigger is
+    /// armed while its condition is false.
+    struct Trigger
+    {
+        steps::tetexact::Comp                 * comp;
+        steps::tetexact::Patch                * patch;
+        uint                                    slidx;
+        double                                  threshold;
+        bool                                    above;
+        bool                                    armed;
+    };
+
+    std::vector<Trigger>                        pTriggers;
+    int                                         pTriggered;
+
+    /// What an intervention changes.
+    enum InterventionKind
+    {
+        IV_COMP_COUNT,
+        IV_COMP_INJECT,
+        IV_TET_INJECT,
+        IV_PATCH_COUNT,
+        IV_COMP_REACK,
+        IV_PATCH_SREACK,
+        IV_COMP_CLAMPED,
+        IV_VERT_ICLAMP
+    };
+
+    /// An intervention: the change of the given kind to the comp, patch,
+    /// tet or vertex loc and the species or reaction obj (global indices),
+    /// applied count times from time every period.
+    struct Intervention
+    {
+        uint                                    kind;
+        uint                                    loc;
+        uint                                    obj;
+        double                                  value;
+        double                                  time;
+        double                                  period;
+        uint                                    count;
+        uint                                    applied;
+    };
+
+    // The interventions, and the timeline of their next applications by
+    // time and index, so that those due together go in the order they
+    // were added.
+    std::vector<Intervention>                   pInterventions;
+    std::set<std::pair<double, uint> >          pTimeline;
+
+    /// A flux counter watching a kproc: an event in direction dir (0 if
+    /// the kproc is not a diffusion) adds sign[dir] to the counter. The
+    /// entries of a kproc are linked through next.
+    struct FluxEntry
+    {
+        uint                                    counter;
+        int                                     sign[4];
+        uint                                    next;
+    };
+
+    // The first flux entry of each kproc by schedule index, empty while
+    // there are no counters, and the counts.
+    std::vector<uint>                           pFluxFirst;
+    std::vector<FluxEntry>                      pFluxEntries;
+    std::vector<double>                         pFluxCounts;
+
+    // The elements of each region of interest (tets, then triangles
+    // numbered after the tets), the totals by region and global species,
+    // and the null-terminated lists of totals rows of the elements.
+    std::vector<std::vector<uint> >             pROIElems;
+    std::vector<double>                         pROICounts;
+    std::vector<double *>                       pROILinks;
+
+    steps::tetexact::Clusters                 * pClusters;
+
+    bool                                        pCountViews;
+    std::vector<uint>                           pTetCountView;
+    std::vector<uint>                           pTriCountView;
+
+    // The profile (see setProfiling): per kproc type the events, the
+    // total length of their update lists and the seconds spent in
+    // apply() and in the update, and the seconds spent in getNext.
+    bool                                        pProfiling;
+    double                                      pProfEvents[KP_NTYPES];
+    double                                      pProfUpdates[KP_NTYPES];
+    double                                      pProfApply[KP_NTYPES];
+    double                                      pProfUpdate[KP_NTYPES];
+    double                                      pProfGetNext;
+
+    // The element events (see setElementEvents): the element of each
+    // kproc by schedule index, the tets first and then the triangles
+    // (0xFFFFFFFF for a well-mixed volume), and the counts by element
+    // and kproc type.
+    bool                                        pElemEventsOn;
+    std::vector<uint>                           pElemEventElem;
+    std::vector<double>                         pElemEvents;
+
+    // The event trace being written (see startEventTrace), or 0.
+    steps::tetexact::EventTrace               * pEventTrace;
+
+    // The snapshot stream being published (see setSnapshotStream), or 0,
+    // with the voxel of each tet and triangle (tris after the tets, or
+    // SNAPSHOT_VOXEL_NONE) and the totals, per voxel by global species.
+    steps::tetexact::SnapshotStream           * pSnapshot;
+    std::vector<uint>                           pSnapVoxels;
+    std::vector<double>                         pSnapCounts;
+
+    // The phases of the construction in order, with the wall clock time
+    // each took and the number of items it handled.
+    std::vector<std::string>                    pSetupPhases;
+    std::map<std::string, double>               pSetupTime;
+    std::map<std::string, uint>                 pSetupCount;
+
+    // Work arrays of _runTauLeap.
+    std::vector<double>                         pLeapRate;
+    std::vector<char>                           pLeapCrit;
+    std::vector<uint>                           pLeapK;
+    std::vector<double>                         pLeapMu;
+    std::vector<double>                         pLeapSigma;
+    std::vector<char>                           pLeapReactant;
+    std::vector<double>                         pLeapDelta;
 
 	////////////////////////////////////////////////////////////////////////
 
@@ -703,6 +2091,120 @@ private:
 
     std::vector<steps::tetexact::Tri *>        pEFTris_vec;
 
+    // The potential and current of each membrane triangle, exchanged
+    // with the EField object once per EField step.
+    std::vector<double>                        pEFTriV;
+    std::vector<double>                        pEFTriI;
+
+    // The threads that compute the membrane triangle currents.
+    uint                                       pEFThreads;
+
+    // The target potential change per EField step of the adaptive mode
+    // (0.0 when off) and the bounds of its dt.
+    double                                     pEFAdaptDV;
+    double                                     pEFDTMin;
+    double                                     pEFDTMax;
+
+    // The implicitness of the EField potential update.
+    double                                     pEFTheta;
+
+    // Whether the EField matrix is decomposed in single precision.
+    bool                                       pEFMixed;
+
+    // Whether the EField update overlaps the SSA, and the update in
+    // flight (or 0). While one is, the triangle potentials are read from
+    // pEFTriV.
+    bool                                       pEFPipeline;
+    EFieldAdvance                            * pEFPipe;
+
+    // Wall clock time spent in the membrane currents and the propensity
+    // refresh of the EField steps, and the largest potential change of
+    // a step, since the last resetEfieldStats().
+    double                                     pEFTimeCurr;
+    double                                     pEFTimeUpdate;
+    double                                     pEFStatMaxDV;
+
+    // The voltage-dependent KProcs (VDepTrans, VDepSReac and GHKcurr),
+    // whose propensities are refreshed after every EField step.
+    std::vector<steps::tetexact::KProc *>      pVdepKProcs;
+
+    // The VDepTrans kprocs grouped by rule, then the VDepSReac kprocs
+    // grouped by rule: group g is [pVDepBatchBegin[g],
+    // pVDepBatchBegin[g + 1]), and the first pVDepNTransBatches groups
+    // are VDepTrans. For each kproc, the EField local index of its
+    // triangle, and work space for its potential and rate constant.
+    std::vector<steps::tetexact::KProc *>      pVDepBatchKProcs;
+    std::vector<uint>                          pVDepBatchBegin;
+    uint                                       pVDepNTransBatches;
+    std::vector<uint>                          pVDepBatchTri;
+    std::vector<double>                        pVDepBatchV;
+    std::vector<double>                        pVDepBatchK;
+
+    // The other voltage-dependent kprocs (GHKcurr).
+    std::vector<steps::tetexact::KProc *>      pVDepOtherKProcs;
+
+    // The half width of the potential windows of the rejection scheduling
+    // (0.0 when off). For each batched kproc, the centre of its window
+    // and the largest rate constant within it; for each VDepTrans and
+    // VDepSReac kproc, from the first VDepTrans, its batch position.
+    double                                     pVDepWindow;
+    std::vector<double>                        pVDepBatchVC;
+    std::vector<double>                        pVDepBatchKMax;
+    std::vector<uint>                          pVDepSlot;
+
+    // Candidates, rejections and window moves of the rejection
+    // scheduling since the last resetEfieldStats().
+    double                                     pVDepNCand;
+    double                                     pVDepNReject;
+    double                                     pVDepNMoved;
+
+    // The bin width of the VDepTrans lumps (0.0 when off). A lump lives
+    // in the scheduler entry of one of the kprocs of its rule, its host,
+    // and is indexed by the host's batch position; the entries of the
+    // other kprocs are 0. For each VDepTrans batch position: the host of
+    // its lump, its count as last summed, its position in the member
+    // list of its lump, and if it hosts a lump, whether it does, the
+    // bin, the rate constant, the total count and the members. Per
+    // batch, the free host positions; per (batch, bin), the host.
+    double                                     pVDepLump;
+    std::vector<uint>                          pVDepLumpOf;
+    std::vector<double>                        pVDepLumpN;
+    std::vector<uint>                          pVDepLumpPos;
+    std::vector<char>                          pVDepLumpHost;
+    std::vector<int>                           pVDepLumpBin;
+    std::vector<double>                        pVDepLumpK;
+    std::vector<double>                        pVDepLumpNSum;
+    std::vector<std::vector<uint> >            pVDepLumpMembers;
+    std::vector<std::vector<uint> >            pVDepLumpFree;
+    std::map<std::pair<uint, int>, uint>       pVDepLumpMap;
+
+    // For compartment c and its species l, the positions in the kproc
+    // list of any of its volumes of the kprocs whose rates depend on l;
+    // all volumes of a compartment have the same kprocs in the same order.
+    std::vector<std::vector<std::vector<uint> > > pCompSpecKProcs;
+
+    // The kprocs marked for update by _markSpec, and whether each kproc
+    // (by schedule index) is among them. Within a batch (pBatchDepth > 0)
+    // _updateSpec and _updateElement only mark, and _endBatch updates.
+    std::vector<steps::tetexact::KProc *>      pDirtyKProcs;
+    std::vector<bool>                          pDirtyFlags;
+    uint                                       pBatchDepth;
+
+    // The event drawn by run() that fell beyond its end time, and its
+    // absolute firing time. It stays valid until a propensity or the time
+    // changes, so that the next run() need not draw again.
+    uint                                       pPendingKProc;
+    double                                     pPendingTime;
+
+    // The hash of the checkpoint or delta the modified flags are relative
+    // to, if pDeltaBaseSet. A delta records it to be restored only on top
+    // of that file.
+    bool                                       pDeltaBaseSet;
+    uint                                       pDeltaBase;
+
+    // The write in flight from checkpointAsync, or 0.
+    CheckpointWrite                          * pCPWrite;
+
     // The number of tetrahedrons
     uint 									   pEFNTets;
     // Array of tetrahedrons
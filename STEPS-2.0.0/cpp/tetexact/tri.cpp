@@ -34,6 +34,7 @@
 #include <algorithm>
 #include <functional>
 #include <iostream>
+#include <new>
 
 // STEPS headers.
 #include "../common.h"
@@ -49,6 +50,7 @@
 #include "tri.hpp"
 #include "kproc.hpp"
 #include "tetexact.hpp"
+#include "clusters.hpp"
 #include "../math/constants.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -70,8 +72,12 @@ stex::Tri::Tri(uint idx, steps::solver::Patchdef * patchdef, double area,
 , pOuterTet(0)
 , pTets()
 , pNextTri()
-, pPoolCount(0)
-, pPoolFlags(0)
+, pPools()
+, pCountTotals(0)
+, pROITotals(0)
+, pCountView(0)
+, pJournal(0)
+, pModified(true)
 , pKProcs()
 , pECharge(0)
 , pECharge_last(0)
@@ -104,10 +110,7 @@ stex::Tri::Tri(uint idx, steps::solver::Patchdef * patchdef, double area,
     pDist[2] = d2;
 
 	uint nspecs = pPatchdef->countSpecs();
-    pPoolCount = new uint[nspecs];
-    pPoolFlags = new uint[nspecs];
-    std::fill_n(pPoolCount, nspecs, 0);
-    std::fill_n(pPoolFlags, nspecs, 0);
+    pPools.init(nspecs);
 
     uint nghkcurrs = pPatchdef->countGHKcurrs();
     pECharge = new int[nghkcurrs];
@@ -127,24 +130,20 @@ stex::Tri::Tri(uint idx, steps::solver::Patchdef * patchdef, double area,
 
 stex::Tri::~Tri(void)
 {
-    delete[] pPoolCount;
-    delete[] pPoolFlags;
     delete[] pECharge;
     delete[] pOCchan_timeintg;
     delete[] pOCtime_upd;
 
     KProcPVecCI e = pKProcs.end();
     for (std::vector<stex::KProc *>::const_iterator i = pKProcs.begin();
-         i != e; ++i) delete *i;
+         i != e; ++i) (*i)->~KProc();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tri::checkpoint(std::fstream & cp_file)
+void stex::Tri::checkpoint(std::iostream & cp_file)
 {
-    uint nspecs = patchdef()->countSpecs();
-    cp_file.write((char*)pPoolCount, sizeof(uint) * nspecs);
-    cp_file.write((char*)pPoolFlags, sizeof(uint) * nspecs);
+    pPools.checkpoint(cp_file);
 
     uint nghkcurrs = pPatchdef->countGHKcurrs();
     cp_file.write((char*)pECharge, sizeof(int) * nghkcurrs);
@@ -158,11 +157,9 @@ void stex::Tri::checkpoint(std::fstream & cp_file)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tri::restore(std::fstream & cp_file)
+void stex::Tri::restore(std::iostream & cp_file)
 {
-    uint nspecs = patchdef()->countSpecs();
-    cp_file.read((char*)pPoolCount, sizeof(uint) * nspecs);
-    cp_file.read((char*)pPoolFlags, sizeof(uint) * nspecs);
+    pPools.restore(cp_file);
 
     uint nghkcurrs = pPatchdef->countGHKcurrs();
     cp_file.read((char*)pECharge, sizeof(int) * nghkcurrs);
@@ -212,7 +209,7 @@ void stex::Tri::setupKProcs(stex::Tetexact * tex, bool efield)
 	for (uint i=0; i < nsreacs; ++i)
 	{
 		ssolver::SReacdef * srdef = patchdef()->sreacdef(i);
-		stex::SReac * sr = new SReac(srdef, this);
+		stex::SReac * sr = new (tex->arena().alloc(sizeof(stex::SReac))) stex::SReac(srdef, this);
 		assert(sr != 0);
 		pKProcs[j++] = sr;
 		tex->addKProc(sr);
@@ -222,7 +219,7 @@ void stex::Tri::setupKProcs(stex::Tetexact * tex, bool efield)
 	for (uint i=0; i < nsdiffs; ++i)
 	{
 		ssolver::SurfDiffdef * sddef = patchdef()->surfdiffdef(i);
-		stex::SDiff * sd = new SDiff(sddef, this);
+		stex::SDiff * sd = new (tex->arena().alloc(sizeof(stex::SDiff))) stex::SDiff(sddef, this);
 		assert(sd != 0);
 		pKProcs[j++] = sd;
 		tex->addKProc(sd);
@@ -235,7 +232,7 @@ void stex::Tri::setupKProcs(stex::Tetexact * tex, bool efield)
 		for (uint i=0; i < nvdtrans; ++i)
 		{
 			ssolver::VDepTransdef * vdtdef = patchdef()->vdeptransdef(i);
-			stex::VDepTrans * vdt = new VDepTrans(vdtdef, this);
+			stex::VDepTrans * vdt = new (tex->arena().alloc(sizeof(stex::VDepTrans))) stex::VDepTrans(vdtdef, this);
 			assert(vdt != 0);
 			pKProcs[j++] = vdt;
 			tex->addKProc(vdt);
@@ -245,7 +242,7 @@ void stex::Tri::setupKProcs(stex::Tetexact * tex, bool efield)
 		for (uint i=0; i < nvdsreacs; ++i)
 		{
 			ssolver::VDepSReacdef * vdsrdef = patchdef()->vdepsreacdef(i);
-			stex::VDepSReac * vdsr = new VDepSReac(vdsrdef, this);
+			stex::VDepSReac * vdsr = new (tex->arena().alloc(sizeof(stex::VDepSReac))) stex::VDepSReac(vdsrdef, this);
 			assert(vdsr != 0);
 			pKProcs[j++] = vdsr;
 			tex->addKProc(vdsr);
@@ -255,7 +252,7 @@ void stex::Tri::setupKProcs(stex::Tetexact * tex, bool efield)
 		for (uint i=0; i < nghkcurrs; ++i)
 		{
 			ssolver::GHKcurrdef * ghkdef = patchdef()->ghkcurrdef(i);
-			stex::GHKcurr * ghk = new GHKcurr(ghkdef, this);
+			stex::GHKcurr * ghk = new (tex->arena().alloc(sizeof(stex::GHKcurr))) stex::GHKcurr(ghkdef, this);
 			assert(ghk != 0);
 			pKProcs[j++] = ghk;
 			tex->addKProc(ghk);
@@ -265,11 +262,77 @@ void stex::Tri::setupKProcs(stex::Tetexact * tex, bool efield)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::Tri::reset(void)
+void stex::Tri::setupSpecDeps(void)
 {
+    // The kprocs that can read this triangle's pools.
+    std::vector<stex::KProc *> cands(pKProcs.begin(), pKProcs.end());
+    if (pInnerTet != 0)
+    {
+        cands.insert(cands.end(), pInnerTet->kprocBegin(), pInnerTet->kprocEnd());
+    }
+    if (pOuterTet != 0)
+    {
+        cands.insert(cands.end(), pOuterTet->kprocBegin(), pOuterTet->kprocEnd());
+    }
+
+    // Collect (species, kproc) pairs from the candidates' sparse
+    // dependency lists and bucket them by species, keeping the candidate
+    // order within each bucket.
     uint nspecs = patchdef()->countSpecs();
-    std::fill_n(pPoolCount, nspecs, 0);
-    std::fill_n(pPoolFlags, nspecs, 0);
+    std::vector<uint> lidxs;
+    std::vector<uint> pair_spec;
+    std::vector<stex::KProc *> pair_kproc;
+    KProcPVecCI k_end = cands.end();
+    for (KProcPVecCI k = cands.begin(); k != k_end; ++k)
+    {
+        lidxs.clear();
+        (*k)->depSpecsTri(this, lidxs);
+        pair_spec.insert(pair_spec.end(), lidxs.begin(), lidxs.end());
+        pair_kproc.insert(pair_kproc.end(), lidxs.size(), *k);
+    }
+
+    pSpecDepStart.assign(nspecs + 1, 0);
+    uint npairs = pair_spec.size();
+    for (uint i = 0; i < npairs; ++i) ++pSpecDepStart[pair_spec[i] + 1];
+    for (uint i = 0; i < nspecs; ++i) pSpecDepStart[i + 1] += pSpecDepStart[i];
+    std::vector<uint> fill(pSpecDepStart.begin(), pSpecDepStart.end() - 1);
+    pSpecDeps.resize(npairs);
+    for (uint i = 0; i < npairs; ++i)
+    {
+        pSpecDeps[fill[pair_spec[i]]++] = pair_kproc[i];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tri::clearSpecDeps(void)
+{
+    std::vector<uint>().swap(pSpecDepStart);
+    std::vector<stex::KProc *>().swap(pSpecDeps);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tri::specDeps(uint gidx, std::vector<stex::KProc *> & deps) const
+{
+    uint lidx = patchdef()->specG2L(gidx);
+    if (lidx == ssolver::LIDX_UNDEFINED) return;
+    // No kproc changes a clamped pool, so nothing needs updating.
+    if (pPools.clamped(lidx) == true) return;
+    assert(lidx + 1 < pSpecDepStart.size());
+    uint e = pSpecDepStart[lidx + 1];
+    for (uint d = pSpecDepStart[lidx]; d < e; ++d)
+    {
+        // Pruned kprocs keep a zero propensity.
+        if (pSpecDeps[d]->pruned() == false) deps.push_back(pSpecDeps[d]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tri::reset(void)
+{
+    pPools.reset();
 
     std::for_each(pKProcs.begin(), pKProcs.end(),
         std::mem_fun(&stex::KProc::reset));
@@ -320,9 +383,20 @@ void stex::Tri::incECharge(uint lidx, int charge)
 void stex::Tri::setCount(uint lidx, uint count)
 {
 	assert (lidx < patchdef()->countSpecs());
-	double oldcount = pPoolCount[lidx];
-	double c = static_cast<double>(count);
-	pPoolCount[lidx] = c;
+	if (pJournal != 0) pJournal->record(this, lidx, pPools.count(lidx));
+	pModified = true;
+	if (pCountTotals != 0)
+	{
+		pCountTotals[lidx] += static_cast<double>(count) - pPools.count(lidx);
+	}
+	if (pROITotals != 0)
+	{
+		double diff = static_cast<double>(count) - pPools.count(lidx);
+		uint gidx = patchdef()->specL2G(lidx);
+		for (double * const * r = pROITotals; *r != 0; ++r) (*r)[gidx] += diff;
+	}
+	pPools.setCount(lidx, count);
+	if (pCountView != 0) pCountView[patchdef()->specL2G(lidx)] = count;
 
 	/* 16/01/10 IH: Counts no longer stored in patch object.
 	// Now update the count in this tri's patch
@@ -338,8 +412,28 @@ void stex::Tri::setCount(uint lidx, uint count)
 void stex::Tri::incCount(uint lidx, int inc)
 {
 	assert (lidx < patchdef()->countSpecs());
-	pPoolCount[lidx] += inc;
-    assert(pPoolCount[lidx] >= 0);
+	if (pJournal != 0) pJournal->record(this, lidx, pPools.count(lidx));
+	pModified = true;
+	if (pCountTotals != 0) pCountTotals[lidx] += inc;
+	if (pROITotals != 0)
+	{
+		uint gidx = patchdef()->specL2G(lidx);
+		for (double * const * r = pROITotals; *r != 0; ++r) (*r)[gidx] += inc;
+	}
+	pPools.incCount(lidx, inc);
+	if (pCountView != 0) pCountView[patchdef()->specL2G(lidx)] = pPools.count(lidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::Tri::syncCountView(void)
+{
+	if (pCountView == 0) return;
+	uint nspecs = patchdef()->countSpecs();
+	for (uint i = 0; i < nspecs; ++i)
+	{
+		pCountView[patchdef()->specL2G(i)] = pPools.count(i);
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -353,7 +447,7 @@ void stex::Tri::setOCchange(uint oclidx, uint slidx, double dt, double simtime)
 
 	// A channel state relating to an ohmic current has changed it's
 	// number.
-	double integral = pPoolCount[slidx]*((simtime+dt) - pOCtime_upd[oclidx]);
+	double integral = pPools.count(slidx)*((simtime+dt) - pOCtime_upd[oclidx]);
 	assert(integral >= 0.0);
 
 	pOCchan_timeintg[oclidx] += integral;
@@ -364,8 +458,8 @@ void stex::Tri::setOCchange(uint oclidx, uint slidx, double dt, double simtime)
 
 void stex::Tri::setClamped(uint lidx, bool clamp)
 {
-	if (clamp == true) pPoolFlags[lidx] |= CLAMPED;
-    else pPoolFlags[lidx] &= ~CLAMPED;
+	pPools.setClamped(lidx, clamp);
+	pModified = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -450,7 +544,7 @@ double stex::Tri::computeI(double v, double dt, double simtime)
 	{
 		ssolver::OhmicCurrdef * ocdef = patchdef()->ohmiccurrdef(i);
 		// The next is ok because Patchdef returns local index
-		uint n = pPoolCount[patchdef()->ohmiccurr_chanstate(i)];
+		uint n = pPools.count(patchdef()->ohmiccurr_chanstate(i));
 		current += (n*ocdef->getG())*(v-ocdef->getERev());
 	}
 	*/
@@ -461,7 +555,7 @@ double stex::Tri::computeI(double v, double dt, double simtime)
 	{
 		ssolver::OhmicCurrdef * ocdef = patchdef()->ohmiccurrdef(i);
 		// First calculate the last little bit up to the simtime
-		double integral = pPoolCount[patchdef()->ohmiccurr_chanstate(i)]*(simtime - pOCtime_upd[i]);
+		double integral = pPools.count(patchdef()->ohmiccurr_chanstate(i))*(simtime - pOCtime_upd[i]);
 		assert(integral >= 0.0);
 		pOCchan_timeintg[i] += integral;
 		pOCtime_upd[i] = simtime;
@@ -500,7 +594,7 @@ double stex::Tri::getOhmicI(double v,double dt) const
 	{
 		ssolver::OhmicCurrdef * ocdef = patchdef()->ohmiccurrdef(i);
 		// The next is ok because Patchdef returns local index
-		uint n = pPoolCount[patchdef()->ohmiccurr_chanstate(i)];
+		uint n = pPools.count(patchdef()->ohmiccurr_chanstate(i));
 		current += (n*ocdef->getG())*(v-ocdef->getERev());
 	}
 
@@ -513,11 +607,24 @@ double stex::Tri::getOhmicI(uint lidx, double v,double dt) const
 {
 	assert(lidx < patchdef()->countOhmicCurrs());
 	ssolver::OhmicCurrdef * ocdef = patchdef()->ohmiccurrdef(lidx);
-	uint n = pPoolCount[patchdef()->ohmiccurr_chanstate(lidx)];
+	uint n = pPools.count(patchdef()->ohmiccurr_chanstate(lidx));
 
 	return (n*ocdef->getG())*(v-ocdef->getERev());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t stex::Tri::getMemoryUsage(void) const
+{
+    std::size_t bytes = Arena::footprint(sizeof(Tri));
+    bytes += pPools.getMemoryUsage();
+    bytes += (pKProcs.capacity() + pSpecDeps.capacity()) * sizeof(KProc *);
+    bytes += pSpecDepStart.capacity() * sizeof(uint);
+    bytes += pPatchdef->countGHKcurrs() * 2 * sizeof(int);
+    bytes += pPatchdef->countOhmicCurrs() * 2 * sizeof(double);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 //END
@@ -39,6 +39,7 @@
 #include "../common.h"
 #include "../solver/patchdef.hpp"
 #include "kproc.hpp"
+#include "pools.hpp"
 #include "../solver/types.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -63,6 +64,7 @@ class Tetexact;
 class VDepTrans;
 class VDepSReac;
 class GHKcurr;
+class CountJournal;
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -92,10 +94,16 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by the triangle: its place in the
+    /// solver's arena and its pools, kproc, dependency and current
+    /// tables. The kprocs themselves are not included.
+    ///
+    std::size_t getMemoryUsage(void) const;
 
     ////////////////////////////////////////////////////////////////////////
     // SETUP
@@ -118,6 +126,20 @@ public:
     ///
     void setupKProcs(stex::Tetexact * tex, bool efield = false);
 
+    /// Index, for each species of the triangle, the kprocs of the
+    /// triangle and of its tetrahedrons whose rate depends on it. Used
+    /// while the kprocs resolve their dependencies; clearSpecDeps frees
+    /// it.
+    ///
+    void setupSpecDeps(void);
+    void clearSpecDeps(void);
+
+    /// Append to deps the kprocs that depend on species gidx in this
+    /// triangle (see setupSpecDeps), or none while the species is
+    /// clamped here. Pruned kprocs are left out.
+    ///
+    void specDeps(uint gidx, std::vector<stex::KProc *> & deps) const;
+
     /// Set all pool flags and molecular populations to zero.
     void reset(void);
 
@@ -193,16 +215,59 @@ public:
     // MAIN FUNCTIONALITY
     ////////////////////////////////////////////////////////////////////////
 
-    inline uint * pools(void) const
-    { return pPoolCount; }
+    inline uint count(uint lidx) const
+    { return pPools.count(lidx); }
+    inline steps::tetexact::Pools const & pools(void) const
+    { return pPools; }
     void setCount(uint lidx, uint count);
 	void incCount(uint lidx, int inc);
 
+    /// Hold the counts in 16 bits while they fit (see Pools).
+    ///
+    inline void setCompactPools(bool compact)
+    { pPools.setCompact(compact); }
+    inline bool compactPools(void) const
+    { return pPools.compact(); }
+
+    /// Keep the running totals of the patch (indexed by local species
+    /// index) up to date with every count change, or stop (0).
+    ///
+    inline void setCountTotals(double * totals)
+    { pCountTotals = totals; }
+
+    /// Keep the totals of the regions of interest this element belongs
+    /// to up to date with every count change, or stop (0). rois is a
+    /// null-terminated list of rows indexed by global species index.
+    ///
+    inline void setROITotals(double * const * rois)
+    { pROITotals = rois; }
+
+    /// Copy every count change to view (indexed by global species
+    /// index), or stop (0). syncCountView writes all current counts.
+    ///
+    inline void setCountView(uint * view)
+    { pCountView = view; }
+    void syncCountView(void);
+
+    /// Record the old count of every count change in journal, or stop
+    /// (0).
+    ///
+    inline void setJournal(stex::CountJournal * journal)
+    { pJournal = journal; }
+
+    /// Whether the counts or clamped flags have changed since the last
+    /// checkpoint (see Tetexact::checkpointDelta).
+    ///
+    inline bool modified(void) const
+    { return pModified; }
+    inline void setModified(bool modified)
+    { pModified = modified; }
+
 
     static const uint CLAMPED = 1;
 
     inline bool clamped(uint lidx) const
-    { return pPoolFlags[lidx] & CLAMPED; }
+    { return pPools.clamped(lidx); }
     void setClamped(uint lidx, bool clamp);
 
     // Set a channel state relating to an ohmic current change.
@@ -256,14 +321,32 @@ private:
     double                              pLengths[3];
     double                              pDist[3];
 
-    /// Numbers of molecules -- stored as machine word integers.
-    uint                              * pPoolCount;
-    /// Flags on these pools -- stored as machine word flags.
-    uint                              * pPoolFlags;
+    /// Numbers of molecules and clamped flags.
+    steps::tetexact::Pools              pPools;
+
+    /// The running totals of the patch, or 0.
+    double                            * pCountTotals;
+
+    /// The totals rows of the regions of interest holding this element
+    /// (null-terminated), or 0.
+    double * const                    * pROITotals;
+
+    /// The solver's count view row of this element, or 0.
+    uint                              * pCountView;
+
+    /// The journal that records count changes for Clusters, or 0.
+    stex::CountJournal                * pJournal;
+
+    bool                                pModified;
 
     /// The kinetic processes.
     std::vector<stex::KProc *>          pKProcs;
 
+    // Setup only: the kprocs depending on local species i are
+    // pSpecDeps[pSpecDepStart[i] .. pSpecDepStart[i+1]).
+    std::vector<uint>                   pSpecDepStart;
+    std::vector<stex::KProc *>          pSpecDeps;
+
     /// For the EFIELD calculation. An integer storing the amount of
     /// elementary charge from inner tet to outer tet (positive if
     /// net flux is positive, negative if net flux is negative) for
@@ -43,7 +43,7 @@ NAMESPACE_ALIAS(steps::math, smath);
 ////////////////////////////////////////////////////////////////////////////////
 
 stex::VDepSReac::VDepSReac(ssolver::VDepSReacdef * vdsrdef, stex::Tri * tri)
-: KProc()
+: KProc(stex::KP_VDEPSREAC)
 , pVDepSReacdef(vdsrdef)
 , pTri(tri)
 , pUpdVec()
@@ -92,69 +92,42 @@ stex::VDepSReac::~VDepSReac(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::VDepSReac::checkpoint(std::fstream & cp_file)
+void stex::VDepSReac::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&rExtent, sizeof(uint));
     cp_file.write((char*)&pFlags, sizeof(uint));
 
     cp_file.write((char*)&pScaleFactor, sizeof(double));
-
-    cp_file.write((char*)&(crData.recorded), sizeof(bool));
-    cp_file.write((char*)&(crData.pow), sizeof(int));
-    cp_file.write((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.write((char*)&(crData.rate), sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::VDepSReac::restore(std::fstream & cp_file)
+void stex::VDepSReac::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&rExtent, sizeof(uint));
     cp_file.read((char*)&pFlags, sizeof(uint));
 
     cp_file.read((char*)&pScaleFactor, sizeof(double));
-
-    cp_file.read((char*)&(crData.recorded), sizeof(bool));
-    cp_file.read((char*)&(crData.pow), sizeof(int));
-    cp_file.read((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.read((char*)&(crData.rate), sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void stex::VDepSReac::reset(void)
 {
-
-    crData.recorded = false;
-    crData.pow = 0;
-    crData.pos = 0;
-    crData.rate = 0.0;
     resetExtent();
 	setActive(true);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::VDepSReac::setupDeps(void)
+void stex::VDepSReac::setupDeps(stex::Arena & arena)
 {
-    // For all non-zero entries gidx in SReacDef's UPD_S:
-    //   Perform depSpecTri(gidx,tri()) for:
-    //     All kproc's of tri()
-    //     NOTE: we currently don't test kproc's of inner and external tet,
-    //     because that's not strictly necessary.
+    // For all non-zero entries gidx in the def's UPD_S, the kprocs that
+    // depend on gidx in tri(), and likewise for UPD_I and UPD_O in the
+    // inner and outer tetrahedron, if they exist (see
+    // Tri::setupSpecDeps and WmVol::setupSpecDeps).
     //
-    // If inner tetrahedron exists:
-    //   For all non-zero entries gidx in SReacDef's UPD_I:
-    //     Perform depSpecTet(gidx,itet) for:
-    //       All kproc's of itet
-    //       All kproc's of triangles next to itet
-    //
-    // If outer tetrahedron exists:
-    //   Similar to inner tet.
-    //
-    // All dependencies are first collected into a std::set, to sort them
-    // and to eliminate duplicates. At the end of the routine, they are
-    // copied into the vector that will be returned during execution.
+    // Duplicates are removed when the list is packed.
 
     WmVol * itet = pTri->iTet();
     WmVol * otet = pTri->oTet();
@@ -166,82 +139,29 @@ void stex::VDepSReac::setupDeps(void)
     ssolver::gidxTVecCI o_beg = pVDepSReacdef->beginUpdColl_O();
     ssolver::gidxTVecCI o_end = pVDepSReacdef->endUpdColl_O();
 
-    std::set<stex::KProc*> updset;
-
-    KProcPVecCI kprocend = pTri->kprocEnd();
-    for (KProcPVecCI k = pTri->kprocBegin(); k != kprocend; ++k)
+    std::vector<stex::KProc*> updvec;
+    for (ssolver::gidxTVecCI spec = s_beg; spec != s_end; ++spec)
     {
-        for (ssolver::gidxTVecCI spec = s_beg; spec != s_end; ++spec)
-        {
-            if ((*k)->depSpecTri(*spec, pTri) == true)
-                updset.insert(*k);
-        }
+        pTri->specDeps(*spec, updvec);
     }
 
     if (itet != 0)
     {
-        kprocend = itet->kprocEnd();
-        for (KProcPVecCI k = itet->kprocBegin(); k != kprocend; ++k)
-        {
-            for (ssolver::gidxTVecCI spec = i_beg; spec != i_end; ++spec)
-            {
-                if ((*k)->depSpecTet(*spec, itet) == true)
-                    updset.insert(*k);
-            }
-        }
-
-
-        std::vector<stex::Tri *>::const_iterator tri_end = itet->nexttriEnd();
-        for (std::vector<stex::Tri *>::const_iterator tri = itet->nexttriBegin();
-    			 tri != tri_end; ++tri)
+        for (ssolver::gidxTVecCI spec = i_beg; spec != i_end; ++spec)
         {
-        	if ((*tri) == 0) continue;
-
-            kprocend = (*tri)->kprocEnd();
-            for (KProcPVecCI k = (*tri)->kprocBegin(); k != kprocend; ++k)
-            {
-                for (ssolver::gidxTVecCI spec = i_beg; spec != i_end; ++spec)
-                {
-                    if ((*k)->depSpecTet(*spec, itet) == true)
-                        updset.insert(*k);
-                }
-            }
+            itet->specDeps(*spec, updvec);
         }
     }
 
     if (otet != 0)
     {
-        kprocend = otet->kprocEnd();
-        for (KProcPVecCI k = otet->kprocBegin(); k != kprocend; ++k)
+        for (ssolver::gidxTVecCI spec = o_beg; spec != o_end; ++spec)
         {
-            for (ssolver::gidxTVecCI spec = o_beg; spec != o_end; ++spec)
-            {
-                if ((*k)->depSpecTet(*spec, otet) == true)
-                    updset.insert(*k);
-            }
-        }
-
-
-
-        std::vector<stex::Tri *>::const_iterator tri_end = otet->nexttriEnd();
-        for (std::vector<stex::Tri *>::const_iterator tri = otet->nexttriBegin();
-    			 tri != tri_end; ++tri)
-        {
-        	if ((*tri) == 0) continue;
-
-            kprocend = (*tri)->kprocEnd();
-            for (KProcPVecCI k = (*tri)->kprocBegin(); k != kprocend; ++k)
-            {
-                for (ssolver::gidxTVecCI spec = o_beg; spec != o_end; ++spec)
-                {
-                    if ((*k)->depSpecTet(*spec, otet) == true)
-                        updset.insert(*k);
-                }
-            }
+            otet->specDeps(*spec, updvec);
         }
     }
 
-    pUpdVec.assign(updset.begin(), updset.end());
+    pUpdVec = _pack(arena, updvec);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -276,7 +196,51 @@ bool stex::VDepSReac::depSpecTri(uint gidx, stex::Tri * triangle)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void stex::VDepSReac::depSpecsTet(stex::WmVol * tet, std::vector<uint> & lidxs)
+{
+    // The patch's inner and outer species indices are those of the
+    // inner and outer compartments.
+    ssolver::Patchdef * pdef = pTri->patchdef();
+    uint lidx = pdef->vdepsreacG2L(pVDepSReacdef->gidx());
+    if (tet == pTri->iTet())
+    {
+        lidxs.insert(lidxs.end(), pdef->vdepsreac_depspec_I_bgn(lidx),
+                     pdef->vdepsreac_depspec_I_end(lidx));
+    }
+    else if (tet == pTri->oTet())
+    {
+        lidxs.insert(lidxs.end(), pdef->vdepsreac_depspec_O_bgn(lidx),
+                     pdef->vdepsreac_depspec_O_end(lidx));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::VDepSReac::depSpecsTri(stex::Tri * triangle, std::vector<uint> & lidxs)
+{
+    if (triangle != pTri) return;
+    ssolver::Patchdef * pdef = pTri->patchdef();
+    uint lidx = pdef->vdepsreacG2L(pVDepSReacdef->gidx());
+    lidxs.insert(lidxs.end(), pdef->vdepsreac_depspec_S_bgn(lidx),
+                 pdef->vdepsreac_depspec_S_end(lidx));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 double stex::VDepSReac::rate(steps::tetexact::Tetexact * solver)
+{
+	double h_mu = _hmu();
+	if (h_mu == 0.0) return 0.0;
+
+	double v = solver->getTriV(pTri->idx());
+	double k = pVDepSReacdef->getVDepK(v);
+
+	return h_mu * k * pScaleFactor;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stex::VDepSReac::_hmu(void) const
 {
 	   if (inactive()) return 0.0;
 
@@ -292,13 +256,12 @@ double stex::VDepSReac::rate(steps::tetexact::Tetexact * solver)
 	    double h_mu = 1.0;
 
 	    uint * lhs_s_vec = pdef->vdepsreac_lhs_S_bgn(lidx);
-	    uint * cnt_s_vec = pTri->pools();
 	    uint nspecs_s = pdef->countSpecs();
 	    for (uint s = 0; s < nspecs_s; ++s)
 	    {
 	        uint lhs = lhs_s_vec[s];
 	        if (lhs == 0) continue;
-	        uint cnt = cnt_s_vec[s];
+	        uint cnt = pTri->count(s);
 	        if (lhs > cnt)
 	        {
 	            return 0.0;
@@ -333,13 +296,12 @@ double stex::VDepSReac::rate(steps::tetexact::Tetexact * solver)
 	    if (pVDepSReacdef->inside())
 	    {
 	        uint * lhs_i_vec = pdef->vdepsreac_lhs_I_bgn(lidx);
-	        uint * cnt_i_vec = pTri->iTet()->pools();
 	        uint nspecs_i = pdef->countSpecs_I();
 	        for (uint s = 0; s < nspecs_i; ++s)
 	        {
 	            uint lhs = lhs_i_vec[s];
 	            if (lhs == 0) continue;
-	            uint cnt = cnt_i_vec[s];
+	            uint cnt = pTri->iTet()->count(s);
 	            if (lhs > cnt)
 	            {
 	                return 0.0;
@@ -374,13 +336,12 @@ double stex::VDepSReac::rate(steps::tetexact::Tetexact * solver)
 	    else if (pVDepSReacdef->outside())
 	    {
 	        uint * lhs_o_vec = pdef->vdepsreac_lhs_O_bgn(lidx);
-	        uint * cnt_o_vec = pTri->oTet()->pools();
 	        uint nspecs_o = pdef->countSpecs_O();
 	        for (uint s = 0; s < nspecs_o; ++s)
 	        {
 	            uint lhs = lhs_o_vec[s];
 	            if (lhs == 0) continue;
-	            uint cnt = cnt_o_vec[s];
+	            uint cnt = pTri->oTet()->count(s);
 	            if (lhs > cnt)
 	            {
 	                return 0.0;
@@ -413,16 +374,12 @@ double stex::VDepSReac::rate(steps::tetexact::Tetexact * solver)
 	        }
 	    }
 
-		double v = solver->getTriV(pTri->idx());
-		double k = pVDepSReacdef->getVDepK(v);
-
-	    return h_mu * k * pScaleFactor;
-
+	    return h_mu;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::vector<stex::KProc*> const & stex::VDepSReac::apply(steps::rng::RNG * rng, double dt, double simtime)
+stex::KProcIdxSpan stex::VDepSReac::apply(steps::rng::RNG * rng, double dt, double simtime)
 {
 	// NOTE: simtime is BEFORE the update has taken place
 
@@ -430,7 +387,6 @@ std::vector<stex::KProc*> const & stex::VDepSReac::apply(steps::rng::RNG * rng,
     uint lidx = pdef->vdepsreacG2L(pVDepSReacdef->gidx());
 
     int * upd_s_vec = pdef->vdepsreac_upd_S_bgn(lidx);
-    uint * cnt_s_vec = pTri->pools();
 
     // First tell the triangles of any channel states relating to ohmic currents
     // that have been changed. If a change has occured then the triangle will
@@ -457,7 +413,7 @@ std::vector<stex::KProc*> const & stex::VDepSReac::apply(steps::rng::RNG * rng,
         if (pTri->clamped(s) == true) continue;
         int upd = upd_s_vec[s];
         if (upd == 0) continue;
-        int nc = static_cast<int>(cnt_s_vec[s]) + upd;
+        int nc = static_cast<int>(pTri->count(s)) + upd;
         assert(nc >= 0);
         pTri->setCount(s, static_cast<uint>(nc));
     }
@@ -467,14 +423,13 @@ std::vector<stex::KProc*> const & stex::VDepSReac::apply(steps::rng::RNG * rng,
     if (itet != 0)
     {
         int * upd_i_vec = pdef->vdepsreac_upd_I_bgn(lidx);
-        uint * cnt_i_vec = itet->pools();
         uint nspecs_i = pdef->countSpecs_I();
         for (uint s = 0; s < nspecs_i; ++s)
         {
             if (itet->clamped(s) == true) continue;
             int upd = upd_i_vec[s];
             if (upd == 0) continue;
-            int nc = static_cast<int>(cnt_i_vec[s]) + upd;
+            int nc = static_cast<int>(itet->count(s)) + upd;
             assert(nc >= 0);
             itet->setCount(s, static_cast<uint>(nc));
         }
@@ -485,20 +440,20 @@ std::vector<stex::KProc*> const & stex::VDepSReac::apply(steps::rng::RNG * rng,
     if (otet != 0)
     {
         int * upd_o_vec = pdef->vdepsreac_upd_O_bgn(lidx);
-        uint * cnt_o_vec = otet->pools();
         uint nspecs_o = pdef->countSpecs_O();
         for (uint s = 0; s < nspecs_o; ++s)
         {
             if (otet->clamped(s) == true) continue;
             int upd = upd_o_vec[s];
             if (upd == 0) continue;
-            int nc = static_cast<int>(cnt_o_vec[s]) + upd;
+            int nc = static_cast<int>(otet->count(s)) + upd;
             assert(nc >= 0);
             otet->setCount(s, static_cast<uint>(nc));
         }
     }
 
     rExtent++;
+    rModified = true;
 
     return pUpdVec;
 }
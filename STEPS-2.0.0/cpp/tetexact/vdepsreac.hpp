@@ -75,35 +75,58 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
 
     ////////////////////////////////////////////////////////////////////////
     // VIRTUAL INTERFACE METHODS
     ////////////////////////////////////////////////////////////////////////
 
-    void setupDeps(void);
+    void setupDeps(steps::tetexact::Arena & arena);
     bool depSpecTet(uint gidx, steps::tetexact::WmVol * tet);
     bool depSpecTri(uint gidx, steps::tetexact::Tri * tri);
+    void depSpecsTet(steps::tetexact::WmVol * tet, std::vector<uint> & lidxs);
+    void depSpecsTri(steps::tetexact::Tri * tri, std::vector<uint> & lidxs);
     void reset(void);
 
     double rate(steps::tetexact::Tetexact * solver = 0);
-    std::vector<KProc*> const & apply(steps::rng::RNG * rng, double dt, double simtime);
+
+    /// The rate for reaction constant k, which Tetexact interpolates for
+    /// all VDepSReacs of a rule at once after each EField step.
+    ///
+    inline double rate(double k) const
+    { return _hmu() * k * pScaleFactor; }
+
+    inline steps::solver::VDepSReacdef * vdepsreacdef(void) const
+    { return pVDepSReacdef; }
+
+    inline steps::tetexact::Tri * tri(void) const
+    { return pTri; }
+    steps::tetexact::KProcIdxSpan apply(steps::rng::RNG * rng, double dt, double simtime);
 
     uint updVecSize(void) const
     { return pUpdVec.size(); }
 
+    steps::tetexact::KProcIdxSpan & updList(uint i)
+    { return pUpdVec; }
+
     ////////////////////////////////////////////////////////////////////////
 
 private:
 
     ////////////////////////////////////////////////////////////////////////
 
+    // The combinatorial part of the rate, 0 if inactive or short of
+    // reactants.
+    double _hmu(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+
     steps::solver::VDepSReacdef       * pVDepSReacdef;
     steps::tetexact::Tri              * pTri;
-    std::vector<KProc*>                   pUpdVec;
+    steps::tetexact::KProcIdxSpan           pUpdVec;
 
     // The information about the size of the comaprtment or patch, and the
     // dimensions. Important for scaling the constant.
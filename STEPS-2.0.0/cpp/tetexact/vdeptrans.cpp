@@ -42,7 +42,7 @@ NAMESPACE_ALIAS(steps::solver, ssolver);
 ////////////////////////////////////////////////////////////////////////////////
 
 stex::VDepTrans::VDepTrans(ssolver::VDepTransdef * vdtdef, stex::Tri * tri)
-: KProc()
+: KProc(stex::KP_VDEPTRANS)
 , pVDepTransdef(vdtdef)
 , pTri(tri)
 , pUpdVec()
@@ -59,59 +59,36 @@ stex::VDepTrans::~VDepTrans(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::VDepTrans::checkpoint(std::fstream & cp_file)
+void stex::VDepTrans::checkpoint(std::iostream & cp_file)
 {
     cp_file.write((char*)&rExtent, sizeof(uint));
     cp_file.write((char*)&pFlags, sizeof(uint));
-
-    cp_file.write((char*)&(crData.recorded), sizeof(bool));
-    cp_file.write((char*)&(crData.pow), sizeof(int));
-    cp_file.write((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.write((char*)&(crData.rate), sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::VDepTrans::restore(std::fstream & cp_file)
+void stex::VDepTrans::restore(std::iostream & cp_file)
 {
     cp_file.read((char*)&rExtent, sizeof(uint));
     cp_file.read((char*)&pFlags, sizeof(uint));
-
-    cp_file.read((char*)&(crData.recorded), sizeof(bool));
-    cp_file.read((char*)&(crData.pow), sizeof(int));
-    cp_file.read((char*)&(crData.pos), sizeof(unsigned));
-    cp_file.read((char*)&(crData.rate), sizeof(double));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void stex::VDepTrans::reset(void)
 {
-
-    crData.recorded = false;
-    crData.pow = 0;
-    crData.pos = 0;
-    crData.rate = 0.0;
 	setActive(true);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::VDepTrans::setupDeps(void)
+void stex::VDepTrans::setupDeps(stex::Arena & arena)
 {
-    std::set<stex::KProc*> updset;
-
-    KProcPVecCI kprocend = pTri->kprocEnd();
-    for (KProcPVecCI k = pTri->kprocBegin(); k != kprocend; ++k)
-    {
-    	if ((*k)->depSpecTri(pVDepTransdef->srcchanstate(), pTri) == true)
-			updset.insert(*k);
-    	if ((*k)->depSpecTri(pVDepTransdef->dstchanstate(), pTri) == true)
-			updset.insert(*k);
-    }
-
-    pUpdVec.assign(updset.begin(), updset.end());
+    std::vector<stex::KProc*> updvec;
+    pTri->specDeps(pVDepTransdef->srcchanstate(), updvec);
+    pTri->specDeps(pVDepTransdef->dstchanstate(), updvec);
 
+    pUpdVec = _pack(arena, updvec);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -138,7 +115,7 @@ double stex::VDepTrans::rate(steps::tetexact::Tetexact * solver)
 	// Fetch the local index of the srcchannel
 	uint srclidx = pdef->vdeptrans_srcchanstate(vdtlidx);
 
-	double n = static_cast<double>(pTri->pools()[srclidx]);
+	double n = static_cast<double>(pTri->count(srclidx));
 	double v = solver->getTriV(pTri->idx());
 	double ra = pVDepTransdef->getVDepRate(v);
 
@@ -147,7 +124,18 @@ double stex::VDepTrans::rate(steps::tetexact::Tetexact * solver)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::vector<stex::KProc*> const & stex::VDepTrans::apply(steps::rng::RNG * rng, double dt, double simtime)
+double stex::VDepTrans::rate(double ra) const
+{
+	ssolver::Patchdef * pdef = pTri->patchdef();
+	uint vdtlidx = pdef->vdeptransG2L(pVDepTransdef->gidx());
+	uint srclidx = pdef->vdeptrans_srcchanstate(vdtlidx);
+
+	return ra * static_cast<double>(pTri->count(srclidx));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stex::KProcIdxSpan stex::VDepTrans::apply(steps::rng::RNG * rng, double dt, double simtime)
 {
 	ssolver::Patchdef * pdef = pTri->patchdef();
 	uint lidx = pdef->vdeptransG2L(pVDepTransdef->gidx());
@@ -174,18 +162,19 @@ std::vector<stex::KProc*> const & stex::VDepTrans::apply(steps::rng::RNG * rng,
 
 	if (pTri->clamped(src) == false)
 	{
-		uint nc = pTri->pools()[src];
+		uint nc = pTri->count(src);
 		assert(nc >= 1);
 		pTri->setCount(src,  (nc-1));
 	}
 	if (pTri->clamped(dst) == false)
 	{
-		uint nc = pTri->pools()[dst];
+		uint nc = pTri->count(dst);
 		assert(nc >= 0);
 		pTri->setCount(dst,  (nc+1));
 	}
 
     rExtent++;
+    rModified = true;
 
 	return pUpdVec;
 }
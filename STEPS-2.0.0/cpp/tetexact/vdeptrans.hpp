@@ -69,27 +69,41 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    void checkpoint(std::fstream & cp_file);
+    void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    void restore(std::fstream & cp_file);
+    void restore(std::iostream & cp_file);
 
     ////////////////////////////////////////////////////////////////////////
     // VIRTUAL INTERFACE METHODS
     ////////////////////////////////////////////////////////////////////////
 
-    void setupDeps(void);
+    void setupDeps(steps::tetexact::Arena & arena);
     bool depSpecTet(uint gidx, steps::tetexact::WmVol * tet);
     bool depSpecTri(uint gidx, steps::tetexact::Tri * tri);
     void reset(void);
 
     double rate(steps::tetexact::Tetexact * solver);
 
-    std::vector<KProc*> const & apply(steps::rng::RNG * rng, double dt,double simtime);
+    /// The rate for transition rate ra, which Tetexact interpolates for
+    /// all VDepTranss of a rule at once after each EField step.
+    ///
+    double rate(double ra) const;
+
+    inline steps::solver::VDepTransdef * vdeptransdef(void) const
+    { return pVDepTransdef; }
+
+    inline steps::tetexact::Tri * tri(void) const
+    { return pTri; }
+
+    steps::tetexact::KProcIdxSpan apply(steps::rng::RNG * rng, double dt,double simtime);
 
     uint updVecSize(void) const
     { return pUpdVec.size(); }
 
+    steps::tetexact::KProcIdxSpan & updList(uint i)
+    { return pUpdVec; }
+
     ////////////////////////////////////////////////////////////////////////
 
 private:
@@ -98,7 +112,7 @@ private:
 
     steps::solver::VDepTransdef       * pVDepTransdef;
     steps::tetexact::Tri              * pTri;
-    std::vector<KProc*>                 pUpdVec;
+    steps::tetexact::KProcIdxSpan         pUpdVec;
 
     ////////////////////////////////////////////////////////////////////////
 
@@ -28,6 +28,7 @@
 #include <algorithm>
 #include <functional>
 #include <iostream>
+#include <new>
 
 // STEPS headers.
 #include "../common.h"
@@ -41,6 +42,7 @@
 #include "tri.hpp"
 #include "kproc.hpp"
 #include "tetexact.hpp"
+#include "clusters.hpp"
 #include "wmvol.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -54,23 +56,24 @@ stex::WmVol::WmVol
 (
     uint idx, solver::Compdef * cdef, double vol
 )
-: pIdx(idx)
+: pKProcs()
+, pNextTris()
+, pIdx(idx)
 , pCompdef(cdef)
 , pVol(vol)
-, pPoolCount(0)
-, pPoolFlags(0)
-, pKProcs()
-, pNextTris()
+, pPools()
+, pCountTotals(0)
+, pROITotals(0)
+, pCountView(0)
+, pJournal(0)
+, pModified(true)
 {
     assert(pCompdef != 0);
 	assert (pVol > 0.0);
 
     // Based on compartment definition, build other structures.
     uint nspecs = compdef()->countSpecs();
-    pPoolCount = new uint[nspecs];
-    pPoolFlags = new uint[nspecs];
-    std::fill_n(pPoolCount, nspecs, 0);
-    std::fill_n(pPoolFlags, nspecs, 0);
+    pPools.init(nspecs);
     pKProcs.resize(compdef()->countReacs());
 
 }
@@ -79,31 +82,90 @@ stex::WmVol::WmVol
 
 stex::WmVol::~WmVol(void)
 {
-    // Delete species pool information.
-    delete[] pPoolCount;
-    delete[] pPoolFlags;
-
     // Delete reaction rules.
     KProcPVecCI e = pKProcs.end();
-    for (KProcPVecCI i = pKProcs.begin(); i != e; ++i) delete *i;
+    for (KProcPVecCI i = pKProcs.begin(); i != e; ++i) (*i)->~KProc();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::WmVol::checkpoint(std::fstream & cp_file)
+void stex::WmVol::checkpoint(std::iostream & cp_file)
 {
-    uint nspecs = compdef()->countSpecs();
-    cp_file.write((char*)pPoolCount, sizeof(uint) * nspecs);
-    cp_file.write((char*)pPoolFlags, sizeof(uint) * nspecs);
+    pPools.checkpoint(cp_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::WmVol::restore(std::iostream & cp_file)
+{
+    pPools.restore(cp_file);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void stex::WmVol::restore(std::fstream & cp_file)
+void stex::WmVol::setupSpecDeps(void)
 {
+    // The kprocs that can read this volume's pools.
+    std::vector<stex::KProc *> cands(pKProcs.begin(), pKProcs.end());
+    std::vector<stex::Tri *>::const_iterator tri_end = pNextTris.end();
+    for (std::vector<stex::Tri *>::const_iterator tri = pNextTris.begin();
+         tri != tri_end; ++tri)
+    {
+        if ((*tri) == 0) continue;
+        cands.insert(cands.end(), (*tri)->kprocBegin(), (*tri)->kprocEnd());
+    }
+
+    // Collect (species, kproc) pairs from the candidates' sparse
+    // dependency lists and bucket them by species, keeping the candidate
+    // order within each bucket.
     uint nspecs = compdef()->countSpecs();
-    cp_file.read((char*)pPoolCount, sizeof(uint) * nspecs);
-    cp_file.read((char*)pPoolFlags, sizeof(uint) * nspecs);
+    std::vector<uint> lidxs;
+    std::vector<uint> pair_spec;
+    std::vector<stex::KProc *> pair_kproc;
+    KProcPVecCI k_end = cands.end();
+    for (KProcPVecCI k = cands.begin(); k != k_end; ++k)
+    {
+        lidxs.clear();
+        (*k)->depSpecsTet(this, lidxs);
+        pair_spec.insert(pair_spec.end(), lidxs.begin(), lidxs.end());
+        pair_kproc.insert(pair_kproc.end(), lidxs.size(), *k);
+    }
+
+    pSpecDepStart.assign(nspecs + 1, 0);
+    uint npairs = pair_spec.size();
+    for (uint i = 0; i < npairs; ++i) ++pSpecDepStart[pair_spec[i] + 1];
+    for (uint i = 0; i < nspecs; ++i) pSpecDepStart[i + 1] += pSpecDepStart[i];
+    std::vector<uint> fill(pSpecDepStart.begin(), pSpecDepStart.end() - 1);
+    pSpecDeps.resize(npairs);
+    for (uint i = 0; i < npairs; ++i)
+    {
+        pSpecDeps[fill[pair_spec[i]]++] = pair_kproc[i];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::WmVol::clearSpecDeps(void)
+{
+    std::vector<uint>().swap(pSpecDepStart);
+    std::vector<stex::KProc *>().swap(pSpecDeps);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stex::WmVol::specDeps(uint gidx, std::vector<stex::KProc *> & deps) const
+{
+    uint lidx = compdef()->specG2L(gidx);
+    if (lidx == ssolver::LIDX_UNDEFINED) return;
+    // No kproc changes a clamped pool, so nothing needs updating.
+    if (pPools.clamped(lidx) == true) return;
+    assert(lidx + 1 < pSpecDepStart.size());
+    uint e = pSpecDepStart[lidx + 1];
+    for (uint d = pSpecDepStart[lidx]; d < e; ++d)
+    {
+        // Pruned kprocs keep a zero propensity.
+        if (pSpecDeps[d]->pruned() == false) deps.push_back(pSpecDeps[d]);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -128,7 +190,7 @@ void stex::WmVol::setupKProcs(stex::Tetexact * tex)
     for (uint i = 0; i < nreacs; ++i)
     {
         ssolver::Reacdef * rdef = compdef()->reacdef(i);
-        stex::Reac * r = new stex::Reac(rdef, this);
+        stex::Reac * r = new (tex->arena().alloc(sizeof(stex::Reac))) stex::Reac(rdef, this);
         pKProcs[j++] = r;
         tex->addKProc(r);
     }
@@ -139,9 +201,7 @@ void stex::WmVol::setupKProcs(stex::Tetexact * tex)
 
 void stex::WmVol::reset(void)
 {
-    uint nspecs = compdef()->countSpecs();
-    std::fill_n(pPoolCount, nspecs, 0);
-    std::fill_n(pPoolFlags, nspecs, 0);
+    pPools.reset();
     std::for_each(pKProcs.begin(), pKProcs.end(),
     		std::mem_fun(&stex::KProc::reset));
 }
@@ -151,7 +211,7 @@ void stex::WmVol::reset(void)
 double stex::WmVol::conc(uint gidx) const
 {
 	uint lspidx = compdef()->specG2L(gidx);
-	double n = pPoolCount[lspidx];
+	double n = pPools.count(lspidx);
 	return (n/(1.0e3*pVol*steps::math::AVOGADRO));
 }
 
@@ -160,8 +220,20 @@ double stex::WmVol::conc(uint gidx) const
 void stex::WmVol::setCount(uint lidx, uint count)
 {
 	assert (lidx < compdef()->countSpecs());
-	uint oldcount = pPoolCount[lidx];
-	pPoolCount[lidx] = count;
+	if (pJournal != 0) pJournal->record(this, lidx, pPools.count(lidx));
+	pModified = true;
+	if (pCountTotals != 0)
+	{
+		pCountTotals[lidx] += static_cast<double>(count) - pPools.count(lidx);
+	}
+	if (pROITotals != 0)
+	{
+		double diff = static_cast<double>(count) - pPools.count(lidx);
+		uint gidx = compdef()->specL2G(lidx);
+		for (double * const * r = pROITotals; *r != 0; ++r) (*r)[gidx] += diff;
+	}
+	pPools.setCount(lidx, count);
+	if (pCountView != 0) pCountView[compdef()->specL2G(lidx)] = count;
 
 	/*
 	// 16/01/10 IH: Counts now not stored in compartment object.
@@ -179,8 +251,16 @@ void stex::WmVol::setCount(uint lidx, uint count)
 void stex::WmVol::incCount(uint lidx, int inc)
 {
 	assert (lidx < compdef()->countSpecs());
-	pPoolCount[lidx] += inc;
-    assert(pPoolCount[lidx] >= 0);
+	if (pJournal != 0) pJournal->record(this, lidx, pPools.count(lidx));
+	pModified = true;
+	if (pCountTotals != 0) pCountTotals[lidx] += inc;
+	if (pROITotals != 0)
+	{
+		uint gidx = compdef()->specL2G(lidx);
+		for (double * const * r = pROITotals; *r != 0; ++r) (*r)[gidx] += inc;
+	}
+	pPools.incCount(lidx, inc);
+	if (pCountView != 0) pCountView[compdef()->specL2G(lidx)] = pPools.count(lidx);
 
 
 	/* 16/01/10 IH: Counts now not stored in compartment object.
@@ -191,10 +271,22 @@ void stex::WmVol::incCount(uint lidx, int inc)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void stex::WmVol::syncCountView(void)
+{
+	if (pCountView == 0) return;
+	uint nspecs = compdef()->countSpecs();
+	for (uint i = 0; i < nspecs; ++i)
+	{
+		pCountView[compdef()->specL2G(i)] = pPools.count(i);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void stex::WmVol::setClamped(uint lidx, bool clamp)
 {
-    if (clamp == true) pPoolFlags[lidx] |= CLAMPED;
-    else pPoolFlags[lidx] &= ~CLAMPED;
+    pPools.setClamped(lidx, clamp);
+    pModified = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -207,4 +299,22 @@ stex::Reac * stex::WmVol::reac(uint lidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::size_t stex::WmVol::getMemoryUsage(void) const
+{
+    return Arena::footprint(sizeof(WmVol)) + _tableMemoryUsage();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t stex::WmVol::_tableMemoryUsage(void) const
+{
+    std::size_t bytes = pPools.getMemoryUsage();
+    bytes += (pKProcs.capacity() + pSpecDeps.capacity()) * sizeof(KProc *);
+    bytes += pNextTris.capacity() * sizeof(Tri *);
+    bytes += pSpecDepStart.capacity() * sizeof(uint);
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
@@ -34,6 +34,7 @@
 #include "../common.h"
 #include "../solver/compdef.hpp"
 #include "kproc.hpp"
+#include "pools.hpp"
 #include "../solver/types.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +53,7 @@ class WmVol;
 class Tri;
 class Reac;
 class Tetexact;
+class CountJournal;
 
 // Auxiliary declarations.
 typedef WmVol *                           WmVolP;
@@ -86,10 +88,16 @@ public:
     // CHECKPOINTING
     ////////////////////////////////////////////////////////////////////////
     /// checkpoint data
-    virtual void checkpoint(std::fstream & cp_file);
+    virtual void checkpoint(std::iostream & cp_file);
 
     /// restore data
-    virtual void restore(std::fstream & cp_file);
+    virtual void restore(std::iostream & cp_file);
+
+    /// Return the number of bytes held by the volume: its place in the
+    /// solver's arena and its pools, kproc and dependency tables. The
+    /// kprocs themselves are not included.
+    ///
+    virtual std::size_t getMemoryUsage(void) const;
 
     ////////////////////////////////////////////////////////////////////////
     // SETUP
@@ -102,6 +110,19 @@ public:
 
     virtual void setNextTri(stex::Tri *t);
 
+    /// Index, for each species of the volume, the kprocs of the volume
+    /// and of its triangles whose rate depends on it. Used while the
+    /// kprocs resolve their dependencies; clearSpecDeps frees it.
+    ///
+    void setupSpecDeps(void);
+    void clearSpecDeps(void);
+
+    /// Append to deps the kprocs that depend on species gidx in this
+    /// volume (see setupSpecDeps), or none while the species is clamped
+    /// here. Pruned kprocs are left out.
+    ///
+    void specDeps(uint gidx, std::vector<stex::KProc *> & deps) const;
+
     ////////////////////////////////////////////////////////////////////////
 
     virtual void reset(void);
@@ -127,18 +148,61 @@ public:
 
     ////////////////////////////////////////////////////////////////////////
 
-    inline uint * pools(void) const
-    { return pPoolCount; }
+    inline uint count(uint lidx) const
+    { return pPools.count(lidx); }
+    inline steps::tetexact::Pools const & pools(void) const
+    { return pPools; }
     void setCount(uint lidx, uint count);
 	void incCount(uint lidx, int inc);
 
+    /// Hold the counts in 16 bits while they fit (see Pools).
+    ///
+    inline void setCompactPools(bool compact)
+    { pPools.setCompact(compact); }
+    inline bool compactPools(void) const
+    { return pPools.compact(); }
+
+    /// Keep the running totals of the compartment (indexed by local
+    /// species index) up to date with every count change, or stop (0).
+    ///
+    inline void setCountTotals(double * totals)
+    { pCountTotals = totals; }
+
+    /// Keep the totals of the regions of interest this element belongs
+    /// to up to date with every count change, or stop (0). rois is a
+    /// null-terminated list of rows indexed by global species index.
+    ///
+    inline void setROITotals(double * const * rois)
+    { pROITotals = rois; }
+
+    /// Copy every count change to view (indexed by global species
+    /// index), or stop (0). syncCountView writes all current counts.
+    ///
+    inline void setCountView(uint * view)
+    { pCountView = view; }
+    void syncCountView(void);
+
+    /// Record the old count of every count change in journal, or stop
+    /// (0).
+    ///
+    inline void setJournal(stex::CountJournal * journal)
+    { pJournal = journal; }
+
+    /// Whether the counts or clamped flags have changed since the last
+    /// checkpoint (see Tetexact::checkpointDelta).
+    ///
+    inline bool modified(void) const
+    { return pModified; }
+    inline void setModified(bool modified)
+    { pModified = modified; }
+
 	// The concentration of species global index gidx in MOL PER l
 	double conc(uint gidx) const;
 
 	static const uint CLAMPED = 1;
 
     inline bool clamped(uint lidx) const
-    { return pPoolFlags[lidx] & CLAMPED; }
+    { return pPools.clamped(lidx); }
     void setClamped(uint lidx, bool clamp);
 
     ////////////////////////////////////////////////////////////////////////
@@ -166,6 +230,10 @@ public:
 
 protected:
 
+    /// The number of bytes held by the tables of the volume.
+    ///
+    std::size_t _tableMemoryUsage(void) const;
+
     /// The kinetic processes.
     std::vector<stex::KProc *>          pKProcs;
 
@@ -184,10 +252,28 @@ private:
 
     double                              pVol;
 
-    /// Numbers of molecules -- stored as uint.
-    uint                              * pPoolCount;
-    /// Flags on these pools -- stored as machine word flags.
-    uint                              * pPoolFlags;
+    /// Numbers of molecules and clamped flags.
+    steps::tetexact::Pools              pPools;
+
+    /// The running totals of the compartment, or 0.
+    double                            * pCountTotals;
+
+    /// The totals rows of the regions of interest holding this element
+    /// (null-terminated), or 0.
+    double * const                    * pROITotals;
+
+    /// The solver's count view row of this element, or 0.
+    uint                              * pCountView;
+
+    /// The journal that records count changes for Clusters, or 0.
+    stex::CountJournal                * pJournal;
+
+    bool                                pModified;
+
+    // Setup only: the kprocs depending on local species i are
+    // pSpecDeps[pSpecDepStart[i] .. pSpecDepStart[i+1]).
+    std::vector<uint>                   pSpecDepStart;
+    std::vector<stex::KProc *>          pSpecDeps;
 
     ////////////////////////////////////////////////////////////////////////
 
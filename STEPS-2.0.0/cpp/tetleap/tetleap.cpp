@@ -0,0 +1,1194 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPSis free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPSis distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "tetleap.hpp"
+#include "../error.hpp"
+#include "../parallel.hpp"
+#include "../math/constants.hpp"
+#include "../geom/tmcomp.hpp"
+#include "../solver/statedef.hpp"
+#include "../solver/compdef.hpp"
+#include "../solver/patchdef.hpp"
+#include "../solver/diffdef.hpp"
+#include "../solver/reacdef.hpp"
+#include "../solver/types.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::tetleap, stl);
+NAMESPACE_ALIAS(steps::solver, ssolver);
+NAMESPACE_ALIAS(steps::math, smath);
+
+////////////////////////////////////////////////////////////////////////////////
+
+static inline double tetleap_ccst(double kcst, double vol, uint order)
+{
+    int o1 = static_cast<int>(order) - 1;
+    return kcst * pow(1.0e3 * vol * smath::AVOGADRO, static_cast<double>(-o1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The number of distinct ordered selections of order molecules out of
+// cnt, as in Voxel.
+static inline double tetleap_h(double cnt, uint order)
+{
+    switch (order)
+    {
+        case 4: return cnt * (cnt - 1.0) * (cnt - 2.0) * (cnt - 3.0);
+        case 3: return cnt * (cnt - 1.0) * (cnt - 2.0);
+        case 2: return cnt * (cnt - 1.0);
+        default: return cnt;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The two passes of a leap, one block per iteration. Each block draws
+// from its own stream and writes only its own tetrahedrons, so the
+// blocks can run on any number of threads.
+class LeapLoop : public steps::ParallelLoop
+{
+public:
+    LeapLoop(stl::Tetleap * solver, double tau)
+    : pSolver(solver), pTau(tau) { }
+
+    void run(uint i, uint thread)
+    { pSolver->_leapBlock(i, pTau); }
+
+private:
+    stl::Tetleap                      * pSolver;
+    double                              pTau;
+};
+
+class GatherLoop : public steps::ParallelLoop
+{
+public:
+    GatherLoop(stl::Tetleap * solver)
+    : pSolver(solver) { }
+
+    void run(uint i, uint thread)
+    { pSolver->_gatherBlock(i); }
+
+private:
+    stl::Tetleap                      * pSolver;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+stl::Tetleap::Tetleap(steps::model::Model * m, steps::wm::Geom * g,
+                      steps::rng::RNG * r, double tau, uint nthreads)
+: API(m, g, r)
+, pMesh(0)
+, pTau(tau)
+, pThreads(nthreads)
+, pNTets(0)
+, pTetMesh()
+, pTetLocal()
+, pCompTetStart()
+, pTetComp()
+, pTetVol()
+, pNeighb()
+, pNeighbBack()
+, pDiffW()
+, pPools()
+, pCcst()
+, pDiffActive()
+, pDiffSpec()
+, pOut()
+, pRNGs()
+, pBlockEvents()
+{
+    if (rng() == 0)
+    {
+        std::ostringstream os;
+        os << "No RNG provided to solver initializer function";
+        throw steps::ArgErr(os.str());
+    }
+    if (tau <= 0.0)
+    {
+        std::ostringstream os;
+        os << "Leap length must be positive.";
+        throw steps::ArgErr(os.str());
+    }
+    if (nthreads == 0)
+    {
+        std::ostringstream os;
+        os << "Number of threads must be positive.";
+        throw steps::ArgErr(os.str());
+    }
+    if (! (pMesh = dynamic_cast<steps::tetmesh::Tetmesh*>(geom())))
+    {
+        std::ostringstream os;
+        os << "Geometry description to steps::solver::Tetleap solver";
+        os << " constructor is not a valid steps::tetmesh::Tetmesh object.";
+        throw steps::ArgErr(os.str());
+    }
+
+    uint npatches = statedef()->countPatches();
+    for (uint p = 0; p < npatches; ++p)
+    {
+        ssolver::Patchdef * pdef = statedef()->patchdef(p);
+        if (pdef->countSReacs() != 0 || pdef->countSurfDiffs() != 0 ||
+            pdef->countVDepSReacs() != 0 || pdef->countOhmicCurrs() != 0 ||
+            pdef->countGHKcurrs() != 0 || pdef->countVDepTrans() != 0)
+        {
+            std::ostringstream os;
+            os << "Patch '" << pdef->name() << "' has surface reactions,";
+            os << " surface diffusion or voltage dependent processes,";
+            os << " which the tetleap solver does not support.";
+            throw steps::ArgErr(os.str());
+        }
+    }
+
+    // Number the tetrahedrons compartment by compartment.
+    uint ncomps = statedef()->countComps();
+    assert(mesh()->_countComps() == ncomps);
+    pTetLocal.assign(mesh()->countTets(), TETLEAP_TET_NONE);
+    pCompTetStart.assign(ncomps + 1, 0);
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        steps::tetmesh::TmComp * tmcomp =
+            dynamic_cast<steps::tetmesh::TmComp*>(mesh()->_getComp(c));
+        assert(tmcomp != 0);
+        std::vector<uint> const & tets = tmcomp->_getAllTetIndices();
+        for (uint i = 0; i < tets.size(); ++i)
+        {
+            pTetLocal[tets[i]] = pTetMesh.size();
+            pTetMesh.push_back(tets[i]);
+            pTetComp.push_back(c);
+            pTetVol.push_back(mesh()->getTetVol(tets[i]));
+        }
+        pCompTetStart[c + 1] = pTetMesh.size();
+    }
+    pNTets = pTetMesh.size();
+
+    std::vector<double> barycs(3 * pNTets);
+    for (uint t = 0; t < pNTets; ++t)
+    {
+        std::vector<double> b = mesh()->getTetBarycenter(pTetMesh[t]);
+        std::copy(b.begin(), b.end(), barycs.begin() + 3 * t);
+    }
+
+    // The weights of the faces between tetrahedrons of one compartment,
+    // as Tet::_setupDiffTables weighs the directions.
+    pNeighb.assign(4 * pNTets, -1);
+    pNeighbBack.assign(4 * pNTets, 0);
+    pDiffW.assign(4 * pNTets, 0.0);
+    for (uint t = 0; t < pNTets; ++t)
+    {
+        uint * tris = mesh()->_getTetTriNeighb(pTetMesh[t]);
+        int * tets = mesh()->_getTetTetNeighb(pTetMesh[t]);
+        for (uint d = 0; d < 4; ++d)
+        {
+            if (tets[d] < 0) continue;
+            uint n = pTetLocal[tets[d]];
+            if (n == TETLEAP_TET_NONE || pTetComp[n] != pTetComp[t]) continue;
+            double const * a = &barycs[3 * t];
+            double const * b = &barycs[3 * n];
+            double dist = sqrt((a[0] - b[0]) * (a[0] - b[0]) +
+                               (a[1] - b[1]) * (a[1] - b[1]) +
+                               (a[2] - b[2]) * (a[2] - b[2]));
+            if (dist <= 0.0) continue;
+            int * back = mesh()->_getTetTetNeighb(tets[d]);
+            uint bd = 0;
+            while (bd < 4 && back[bd] != static_cast<int>(pTetMesh[t])) ++bd;
+            assert(bd < 4);
+            pNeighb[4 * t + d] = n;
+            pNeighbBack[4 * t + d] = bd;
+            pDiffW[4 * t + d] = mesh()->getTriArea(tris[d]) / (pTetVol[t] * dist);
+        }
+    }
+
+    pPools.resize(ncomps);
+    pCcst.resize(ncomps);
+    pDiffActive.resize(ncomps);
+    pDiffSpec.resize(ncomps);
+    pOut.resize(ncomps);
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        uint ntets = pCompTetStart[c + 1] - pCompTetStart[c];
+        uint ndiffs = cdef->countDiffs();
+        pPools[c].assign(cdef->countSpecs() * ntets, 0);
+        pCcst[c].assign(cdef->countReacs() * ntets, 0.0);
+        pDiffActive[c].assign(ndiffs, 1);
+        pDiffSpec[c].resize(ndiffs);
+        for (uint d = 0; d < ndiffs; ++d)
+        {
+            pDiffSpec[c][d] = cdef->specG2L(cdef->diffdef(d)->lig());
+        }
+        pOut[c].assign(4 * ndiffs * ntets, 0);
+    }
+
+    // One stream per block, all from one seed drawn from the solver's
+    // generator.
+    uint nblocks = (pNTets + TETLEAP_BLOCK - 1) / TETLEAP_BLOCK;
+    ulong seed = rng()->get();
+    pRNGs.assign(nblocks, 0);
+    for (uint b = 0; b < nblocks; ++b)
+    {
+        pRNGs[b] = steps::rng::create("philox4x32", 256);
+        pRNGs[b]->initializeStream(seed, b);
+    }
+    pBlockEvents.assign(nblocks, 0);
+
+    _refillCcst();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+stl::Tetleap::~Tetleap(void)
+{
+    for (uint b = 0; b < pRNGs.size(); ++b) delete pRNGs[b];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string stl::Tetleap::getSolverName(void) const
+{
+    return "tetleap";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string stl::Tetleap::getSolverDesc(void) const
+{
+    return "Spatial tau-leaping on a tetrahedral mesh";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string stl::Tetleap::getSolverAuthors(void) const
+{
+    return "Stefan Wils and Iain Hepburn";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string stl::Tetleap::getSolverEmail(void) const
+{
+    return "stefan@tnb.ua.ac.be, ihepburn@oist.jp";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::checkpoint(std::string const & file_name)
+{
+    std::fstream cp_file;
+
+    cp_file.open(file_name.c_str(),
+                std::fstream::out | std::fstream::binary | std::fstream::trunc);
+
+    uint ncomps = pPools.size();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        if (pPools[c].empty() == false)
+        {
+            cp_file.write((char*)&pPools[c].front(),
+                          sizeof(uint) * pPools[c].size());
+        }
+        if (pDiffActive[c].empty() == false)
+        {
+            cp_file.write((char*)&pDiffActive[c].front(),
+                          sizeof(uint) * pDiffActive[c].size());
+        }
+    }
+
+    statedef()->checkpoint(cp_file);
+
+    cp_file.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::restore(std::string const & file_name)
+{
+    std::fstream cp_file;
+
+    cp_file.open(file_name.c_str(),
+                std::fstream::in | std::fstream::binary);
+
+    cp_file.seekg(0);
+
+    uint ncomps = pPools.size();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        if (pPools[c].empty() == false)
+        {
+            cp_file.read((char*)&pPools[c].front(),
+                         sizeof(uint) * pPools[c].size());
+        }
+        if (pDiffActive[c].empty() == false)
+        {
+            cp_file.read((char*)&pDiffActive[c].front(),
+                         sizeof(uint) * pDiffActive[c].size());
+        }
+    }
+
+    statedef()->restore(cp_file);
+
+    cp_file.close();
+
+    _refillCcst();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::reset(void)
+{
+    uint ncomps = statedef()->countComps();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        statedef()->compdef(c)->reset();
+        std::fill(pPools[c].begin(), pPools[c].end(), 0);
+        std::fill(pDiffActive[c].begin(), pDiffActive[c].end(), 1);
+    }
+    uint npatches = statedef()->countPatches();
+    for (uint p = 0; p < npatches; ++p)
+    {
+        statedef()->patchdef(p)->reset();
+    }
+
+    statedef()->resetTime();
+    statedef()->resetNSteps();
+
+    _refillCcst();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::run(double endtime)
+{
+    if (endtime < statedef()->time())
+    {
+        std::ostringstream os;
+        os << "Endtime is before current simulation time";
+        throw steps::ArgErr(os.str());
+    }
+    // Count the leaps from the start, so that rounding does not add up
+    // over many of them, and do not take one of a length lost in the
+    // rounding.
+    double t0 = statedef()->time();
+    for (uint k = 0; ; ++k)
+    {
+        double t = t0 + k * pTau;
+        double dt = std::min(pTau, endtime - t);
+        if (dt <= 1.0e-9 * pTau) break;
+        _leap(dt);
+    }
+    statedef()->setTime(endtime);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::advance(double adv)
+{
+    if (adv < 0.0)
+    {
+        std::ostringstream os;
+        os << "Time to advance cannot be negative";
+        throw steps::ArgErr(os.str());
+    }
+
+    double endtime = statedef()->time() + adv;
+    run(endtime);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::step(void)
+{
+    _leap(pTau);
+    statedef()->incTime(pTau);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::getTime(void) const
+{
+    return statedef()->time();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stl::Tetleap::getNSteps(void) const
+{
+    return statedef()->nsteps();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::setTau(double tau)
+{
+    if (tau <= 0.0)
+    {
+        std::ostringstream os;
+        os << "Leap length must be positive.";
+        throw steps::ArgErr(os.str());
+    }
+    pTau = tau;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::getTau(void) const
+{
+    return pTau;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::setThreads(uint n)
+{
+    if (n == 0)
+    {
+        std::ostringstream os;
+        os << "Number of threads must be positive.";
+        throw steps::ArgErr(os.str());
+    }
+    pThreads = n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stl::Tetleap::getThreads(void) const
+{
+    return pThreads;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_refillCcst(void)
+{
+    uint ncomps = pPools.size();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        uint start = pCompTetStart[c];
+        uint ntets = pCompTetStart[c + 1] - start;
+        uint nreacs = cdef->countReacs();
+        for (uint r = 0; r < nreacs; ++r)
+        {
+            double kcst = cdef->kcst(r);
+            uint order = cdef->reacdef(r)->order();
+            double * ccst = &pCcst[c][r * ntets];
+            for (uint i = 0; i < ntets; ++i)
+            {
+                ccst[i] = tetleap_ccst(kcst, pTetVol[start + i], order);
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_leap(double tau)
+{
+    uint nblocks = pRNGs.size();
+    LeapLoop leap(this, tau);
+    steps::parallelFor(leap, nblocks, pThreads);
+    GatherLoop gather(this);
+    steps::parallelFor(gather, nblocks, pThreads);
+
+    uint nevents = 0;
+    for (uint b = 0; b < nblocks; ++b) nevents += pBlockEvents[b];
+    if (nevents != 0) statedef()->incNSteps(nevents);
+
+    // The compartment totals, which the getters read.
+    uint ncomps = pPools.size();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        uint ntets = pCompTetStart[c + 1] - pCompTetStart[c];
+        uint nspecs = cdef->countSpecs();
+        for (uint s = 0; s < nspecs; ++s)
+        {
+            if (cdef->clamped(s)) continue;
+            uint const * n = &pPools[c][s * ntets];
+            double total = 0.0;
+            for (uint i = 0; i < ntets; ++i) total += n[i];
+            cdef->setCount(s, total);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_leapBlock(uint b, double tau)
+{
+    steps::rng::RNG * r = pRNGs[b];
+    uint t_end = std::min(pNTets, (b + 1) * TETLEAP_BLOCK);
+    uint nevents = 0;
+
+    for (uint t = b * TETLEAP_BLOCK; t < t_end; ++t)
+    {
+        uint c = pTetComp[t];
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        uint ntets = pCompTetStart[c + 1] - pCompTetStart[c];
+        uint i = t - pCompTetStart[c];
+        uint * pools = &pPools[c].front();
+
+        // A Poisson number of firings of each reaction, no more than the
+        // reactants left allow, so that no count goes below zero.
+        uint nreacs = cdef->countReacs();
+        for (uint k = 0; k < nreacs; ++k)
+        {
+            if (cdef->active(k) == false) continue;
+            double a = pCcst[c][k * ntets + i];
+            uint * order = cdef->reac_lhsorder_bgn(k);
+            uint * s_end = cdef->reac_lhsspec_end(k);
+            for (uint * s = cdef->reac_lhsspec_bgn(k); s != s_end; ++s, ++order)
+            {
+                a *= tetleap_h(pools[(*s) * ntets + i], *order);
+            }
+            if (a <= 0.0) continue;
+            long nf = r->getPsn(static_cast<float>(1.0 / (a * tau)));
+            if (nf <= 0) continue;
+            order = cdef->reac_lhsorder_bgn(k);
+            for (uint * s = cdef->reac_lhsspec_bgn(k); s != s_end; ++s, ++order)
+            {
+                if (cdef->clamped(*s)) continue;
+                long avail = pools[(*s) * ntets + i] / (*order);
+                if (avail < nf) nf = avail;
+            }
+            if (nf <= 0) continue;
+            uint * u_end = cdef->reac_updspec_end(k);
+            int * delta = cdef->reac_upddelta_bgn(k);
+            for (uint * s = cdef->reac_updspec_bgn(k); s != u_end; ++s, ++delta)
+            {
+                if (cdef->clamped(*s)) continue;
+                pools[(*s) * ntets + i] += nf * (*delta);
+            }
+            nevents += nf;
+        }
+
+        // The molecules leaving through each face, each with probability
+        // 1 - exp(-D * wsum * tau) and then split over the faces by their
+        // weights. A clamped pool gives molecules without losing them.
+        double const * w = &pDiffW[4 * t];
+        double wsum = w[0] + w[1] + w[2] + w[3];
+        uint ndiffs = cdef->countDiffs();
+        for (uint d = 0; d < ndiffs; ++d)
+        {
+            uint * out = &pOut[c][(d * ntets + i) * 4];
+            std::fill_n(out, 4, 0);
+            if (pDiffActive[c][d] == 0) continue;
+            uint s = pDiffSpec[c][d];
+            uint n = pools[s * ntets + i];
+            double rate = cdef->dcst(d) * wsum;
+            if (n == 0 || rate <= 0.0) continue;
+            uint nleave = r->getBinom(n, 1.0 - std::exp(-rate * tau));
+            if (nleave == 0) continue;
+            uint left = nleave;
+            double wleft = wsum;
+            for (uint dir = 0; dir < 4 && left != 0; ++dir)
+            {
+                if (w[dir] <= 0.0) continue;
+                uint m = left;
+                if (w[dir] < wleft)
+                {
+                    m = r->getBinom(left, w[dir] / wleft);
+                }
+                out[dir] = m;
+                left -= m;
+                wleft -= w[dir];
+            }
+            if (cdef->clamped(s) == false) pools[s * ntets + i] -= nleave;
+            nevents += nleave;
+        }
+    }
+
+    pBlockEvents[b] = nevents;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_gatherBlock(uint b)
+{
+    uint t_end = std::min(pNTets, (b + 1) * TETLEAP_BLOCK);
+
+    for (uint t = b * TETLEAP_BLOCK; t < t_end; ++t)
+    {
+        uint c = pTetComp[t];
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        uint start = pCompTetStart[c];
+        uint ntets = pCompTetStart[c + 1] - start;
+        uint i = t - start;
+        uint ndiffs = cdef->countDiffs();
+        for (uint d = 0; d < ndiffs; ++d)
+        {
+            uint s = pDiffSpec[c][d];
+            if (cdef->clamped(s)) continue;
+            uint const * out = &pOut[c][d * ntets * 4];
+            uint in = 0;
+            for (uint dir = 0; dir < 4; ++dir)
+            {
+                int n = pNeighb[4 * t + dir];
+                if (n < 0) continue;
+                in += out[(n - start) * 4 + pNeighbBack[4 * t + dir]];
+            }
+            pPools[c][s * ntets + i] += in;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stl::Tetleap::_tetIdx(uint tidx) const
+{
+    assert(tidx < pTetLocal.size());
+    uint t = pTetLocal[tidx];
+    if (t == TETLEAP_TET_NONE)
+    {
+        std::ostringstream os;
+        os << "Tetrahedron " << tidx << " has not been assigned to a compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return t;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stl::Tetleap::_compSpecIdx(uint c, uint s) const
+{
+    uint slidx = statedef()->compdef(c)->specG2L(s);
+    if (slidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Species undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return slidx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stl::Tetleap::_patchSpecIdx(uint p, uint s) const
+{
+    uint slidx = statedef()->patchdef(p)->specG2L(s);
+    if (slidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Species undefined in patch.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return slidx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint stl::Tetleap::_roundCount(double n)
+{
+    if (n <= 0.0) return 0;
+    if (n > std::numeric_limits<unsigned int>::max())
+    {
+        std::ostringstream os;
+        os << "Can't set count greater than maximum unsigned integer (";
+        os << std::numeric_limits<unsigned int>::max() << ").\n";
+        throw steps::ArgErr(os.str());
+    }
+    double n_int = std::floor(n);
+    uint c = static_cast<uint>(n_int);
+    if (n - n_int > 0.0 && rng()->getUnfIE() < n - n_int) ++c;
+    return c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getCompVol(uint cidx) const
+{
+    assert(cidx < statedef()->countComps());
+    return statedef()->compdef(cidx)->vol();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getCompCount(uint cidx, uint sidx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(sidx < statedef()->countSpecs());
+    return statedef()->compdef(cidx)->pools()[_compSpecIdx(cidx, sidx)];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setCompCount(uint cidx, uint sidx, double n)
+{
+    assert(cidx < statedef()->countComps());
+    assert(sidx < statedef()->countSpecs());
+    uint slidx = _compSpecIdx(cidx, sidx);
+    if (n > std::numeric_limits<unsigned int>::max())
+    {
+        std::ostringstream os;
+        os << "Can't set count greater than maximum unsigned integer (";
+        os << std::numeric_limits<unsigned int>::max() << ").\n";
+        throw steps::ArgErr(os.str());
+    }
+    assert(n >= 0.0);
+
+    // Spread the molecules over the tetrahedrons by their volumes.
+    uint start = pCompTetStart[cidx];
+    uint ntets = pCompTetStart[cidx + 1] - start;
+    std::vector<double> counts(pTetVol.begin() + start,
+                               pTetVol.begin() + start + ntets);
+    _multinomial(n, counts);
+    double total = 0.0;
+    uint * pools = &pPools[cidx][slidx * ntets];
+    for (uint i = 0; i < ntets; ++i)
+    {
+        pools[i] = static_cast<uint>(counts[i]);
+        total += counts[i];
+    }
+    statedef()->compdef(cidx)->setCount(slidx, total);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getCompAmount(uint cidx, uint sidx) const
+{
+    // the following method does all the necessary argument checking
+    double count = _getCompCount(cidx, sidx);
+    return (count / smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setCompAmount(uint cidx, uint sidx, double a)
+{
+    // the following method does all the necessary argument checking
+    _setCompCount(cidx, sidx, a * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getCompConc(uint cidx, uint sidx) const
+{
+    // the following method does all the necessary argument checking
+    double count = _getCompCount(cidx, sidx);
+    double vol = statedef()->compdef(cidx)->vol();
+    return count / (1.0e3 * vol * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setCompConc(uint cidx, uint sidx, double c)
+{
+    assert(c >= 0.0);
+    assert(cidx < statedef()->countComps());
+    double vol = statedef()->compdef(cidx)->vol();
+    // the following method does all the necessary argument checking
+    _setCompCount(cidx, sidx, c * (1.0e3 * vol * smath::AVOGADRO));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stl::Tetleap::_getCompClamped(uint cidx, uint sidx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(sidx < statedef()->countSpecs());
+    return statedef()->compdef(cidx)->clamped(_compSpecIdx(cidx, sidx));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setCompClamped(uint cidx, uint sidx, bool b)
+{
+    assert(cidx < statedef()->countComps());
+    assert(sidx < statedef()->countSpecs());
+    statedef()->compdef(cidx)->setClamped(_compSpecIdx(cidx, sidx), b);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getCompReacK(uint cidx, uint ridx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(ridx < statedef()->countReacs());
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint lridx = comp->reacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return comp->kcst(lridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setCompReacK(uint cidx, uint ridx, double kf)
+{
+    assert(cidx < statedef()->countComps());
+    assert(ridx < statedef()->countReacs());
+    assert(kf >= 0.0);
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint lridx = comp->reacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    comp->setKcst(lridx, kf);
+
+    // Rates have changed
+    _refillCcst();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stl::Tetleap::_getCompReacActive(uint cidx, uint ridx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(ridx < statedef()->countReacs());
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint lridx = comp->reacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return comp->active(lridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setCompReacActive(uint cidx, uint ridx, bool a)
+{
+    assert(cidx < statedef()->countComps());
+    assert(ridx < statedef()->countReacs());
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint lridx = comp->reacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    comp->setActive(lridx, a);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getCompDiffD(uint cidx, uint didx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(didx < statedef()->countDiffs());
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint ldidx = comp->diffG2L(didx);
+    if (ldidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Diffusion rule undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return comp->dcst(ldidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setCompDiffD(uint cidx, uint didx, double dcst)
+{
+    assert(cidx < statedef()->countComps());
+    assert(didx < statedef()->countDiffs());
+    if (dcst < 0.0)
+    {
+        std::ostringstream os;
+        os << "Diffusion constant can't be negative";
+        throw steps::ArgErr(os.str());
+    }
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint ldidx = comp->diffG2L(didx);
+    if (ldidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Diffusion rule undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    comp->setDcst(ldidx, dcst);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stl::Tetleap::_getCompDiffActive(uint cidx, uint didx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(didx < statedef()->countDiffs());
+    uint ldidx = statedef()->compdef(cidx)->diffG2L(didx);
+    if (ldidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Diffusion rule undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return pDiffActive[cidx][ldidx] != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setCompDiffActive(uint cidx, uint didx, bool act)
+{
+    assert(cidx < statedef()->countComps());
+    assert(didx < statedef()->countDiffs());
+    uint ldidx = statedef()->compdef(cidx)->diffG2L(didx);
+    if (ldidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Diffusion rule undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    pDiffActive[cidx][ldidx] = act ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getPatchArea(uint pidx) const
+{
+    assert(pidx < statedef()->countPatches());
+    return statedef()->patchdef(pidx)->area();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getPatchCount(uint pidx, uint sidx) const
+{
+    assert(pidx < statedef()->countPatches());
+    assert(sidx < statedef()->countSpecs());
+    return statedef()->patchdef(pidx)->pools()[_patchSpecIdx(pidx, sidx)];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setPatchCount(uint pidx, uint sidx, double n)
+{
+    assert(pidx < statedef()->countPatches());
+    assert(sidx < statedef()->countSpecs());
+    uint slidx = _patchSpecIdx(pidx, sidx);
+    if (n > std::numeric_limits<unsigned int>::max())
+    {
+        std::ostringstream os;
+        os << "Can't set count greater than maximum unsigned integer (";
+        os << std::numeric_limits<unsigned int>::max() << ").\n";
+        throw steps::ArgErr(os.str());
+    }
+    assert(n >= 0.0);
+
+    // Patches have no processes, so their molecules are only counted.
+    statedef()->patchdef(pidx)->setCount(slidx, _roundCount(n));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getPatchAmount(uint pidx, uint sidx) const
+{
+    // the following method does all the necessary argument checking
+    double count = _getPatchCount(pidx, sidx);
+    return (count / smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setPatchAmount(uint pidx, uint sidx, double a)
+{
+    // the following method does all the necessary argument checking
+    _setPatchCount(pidx, sidx, a * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stl::Tetleap::_getPatchClamped(uint pidx, uint sidx) const
+{
+    assert(pidx < statedef()->countPatches());
+    assert(sidx < statedef()->countSpecs());
+    return statedef()->patchdef(pidx)->clamped(_patchSpecIdx(pidx, sidx));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setPatchClamped(uint pidx, uint sidx, bool buf)
+{
+    assert(pidx < statedef()->countPatches());
+    assert(sidx < statedef()->countSpecs());
+    statedef()->patchdef(pidx)->setClamped(_patchSpecIdx(pidx, sidx), buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getPatchSReacK(uint pidx, uint ridx) const
+{
+    assert(pidx < statedef()->countPatches());
+    assert(ridx < statedef()->countSReacs());
+    std::ostringstream os;
+    os << "Surface reaction undefined in patch.\n";
+    throw steps::ArgErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setPatchSReacK(uint pidx, uint ridx, double kf)
+{
+    assert(pidx < statedef()->countPatches());
+    assert(ridx < statedef()->countSReacs());
+    std::ostringstream os;
+    os << "Surface reaction undefined in patch.\n";
+    throw steps::ArgErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stl::Tetleap::_getPatchSReacActive(uint pidx, uint ridx) const
+{
+    assert(pidx < statedef()->countPatches());
+    assert(ridx < statedef()->countSReacs());
+    std::ostringstream os;
+    os << "Surface reaction undefined in patch.\n";
+    throw steps::ArgErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setPatchSReacActive(uint pidx, uint ridx, bool a)
+{
+    assert(pidx < statedef()->countPatches());
+    assert(ridx < statedef()->countSReacs());
+    std::ostringstream os;
+    os << "Surface reaction undefined in patch.\n";
+    throw steps::ArgErr(os.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getTetVol(uint tidx) const
+{
+    return pTetVol[_tetIdx(tidx)];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stl::Tetleap::_getTetSpecDefined(uint tidx, uint sidx) const
+{
+    assert(sidx < statedef()->countSpecs());
+    uint t = _tetIdx(tidx);
+    uint slidx = statedef()->compdef(pTetComp[t])->specG2L(sidx);
+    return slidx != ssolver::LIDX_UNDEFINED;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getTetCount(uint tidx, uint sidx) const
+{
+    assert(sidx < statedef()->countSpecs());
+    uint t = _tetIdx(tidx);
+    uint c = pTetComp[t];
+    uint slidx = statedef()->compdef(c)->specG2L(sidx);
+    if (slidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Species undefined in tetrahedron.\n";
+        throw steps::ArgErr(os.str());
+    }
+    uint start = pCompTetStart[c];
+    uint ntets = pCompTetStart[c + 1] - start;
+    return pPools[c][slidx * ntets + t - start];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setTetCount(uint tidx, uint sidx, double n)
+{
+    assert(sidx < statedef()->countSpecs());
+    assert(n >= 0.0);
+    uint t = _tetIdx(tidx);
+    uint c = pTetComp[t];
+    ssolver::Compdef * cdef = statedef()->compdef(c);
+    uint slidx = cdef->specG2L(sidx);
+    if (slidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Species undefined in tetrahedron.\n";
+        throw steps::ArgErr(os.str());
+    }
+    uint start = pCompTetStart[c];
+    uint ntets = pCompTetStart[c + 1] - start;
+    uint & cnt = pPools[c][slidx * ntets + t - start];
+    uint c_new = _roundCount(n);
+    cdef->setCount(slidx, cdef->pools()[slidx] + c_new - static_cast<double>(cnt));
+    cnt = c_new;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getTetAmount(uint tidx, uint sidx) const
+{
+    // the following method does all the necessary argument checking
+    double count = _getTetCount(tidx, sidx);
+    return count / smath::AVOGADRO;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setTetAmount(uint tidx, uint sidx, double m)
+{
+    // the following method does all the necessary argument checking
+    _setTetCount(tidx, sidx, m * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double stl::Tetleap::_getTetConc(uint tidx, uint sidx) const
+{
+    // the following method does all the necessary argument checking
+    double count = _getTetCount(tidx, sidx);
+    double vol = _getTetVol(tidx);
+    return count / (1.0e3 * vol * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stl::Tetleap::_setTetConc(uint tidx, uint sidx, double c)
+{
+    assert(c >= 0.0);
+    // the following method does all the necessary argument checking
+    double vol = _getTetVol(tidx);
+    _setTetCount(tidx, sidx, c * (1.0e3 * vol * smath::AVOGADRO));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
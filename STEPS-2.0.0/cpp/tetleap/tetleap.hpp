@@ -0,0 +1,292 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPSis free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPSis distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_TETLEAP_TETLEAP_HPP
+#define STEPS_TETLEAP_TETLEAP_HPP 1
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../solver/api.hpp"
+#include "../solver/statedef.hpp"
+#include "../geom/tetmesh.hpp"
+#include "../rng/rng.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetleap)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Number of tetrahedrons leaped together, with one random stream.
+#define TETLEAP_BLOCK               256
+
+// Local index of a mesh tetrahedron outside the compartments.
+#define TETLEAP_TET_NONE            0xFFFFFFFF
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Approximate spatial tau-leaping on a tetrahedral mesh, advancing the
+/// reactions and diffusion of all tetrahedrons at once by fixed leaps of
+/// length tau.
+///
+/// The state is held in flat arrays, species by species over the
+/// tetrahedrons of each compartment, next to the per-tetrahedron
+/// reaction constants and the diffusion weights area / (vol * dist) of
+/// each face, as Tetexact derives them from the mesh. A leap is two
+/// passes over fixed blocks of TETLEAP_BLOCK tetrahedrons, each block
+/// with its own Philox stream: the first fires a Poisson number of each
+/// reaction, capped by the reactants left, and draws the molecules
+/// leaving by diffusion, split multinomially over the faces, writing
+/// only its own tetrahedrons; the second gathers the molecules arriving
+/// from the neighbours. The blocks run on setThreads threads and the
+/// results do not depend on their number.
+///
+/// Diffusion is only between tetrahedrons of the same compartment.
+/// Patches can hold species but not have surface reactions, surface
+/// diffusion or voltage-dependent processes. Clamping is by compartment.
+///
+class Tetleap: public steps::solver::API
+{
+
+public:
+
+    Tetleap(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+            double tau, uint nthreads = 1);
+    ~Tetleap(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER INFORMATION
+    ////////////////////////////////////////////////////////////////////////
+
+    std::string getSolverName(void) const;
+    std::string getSolverDesc(void) const;
+    std::string getSolverAuthors(void) const;
+    std::string getSolverEmail(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER CONTROLS
+    ////////////////////////////////////////////////////////////////////////
+
+    void checkpoint(std::string const & file_name);
+    void restore(std::string const & file_name);
+
+    void reset(void);
+
+    /// Leap to endtime, the last leap being shortened to end on it.
+    ///
+    void run(double endtime);
+    void advance(double adv);
+
+    /// Take a single leap of length tau.
+    ///
+    void step(void);
+
+    double getTime(void) const;
+
+    /// The number of reaction and diffusion events of the leaps so far.
+    ///
+    uint getNSteps(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // LEAPING
+    ////////////////////////////////////////////////////////////////////////
+
+    void setTau(double tau);
+
+    double getTau(void) const;
+
+    void setThreads(uint n);
+
+    uint getThreads(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER METHODS: COMPARTMENT
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getCompVol(uint cidx) const;
+
+    double _getCompCount(uint cidx, uint sidx) const;
+    void _setCompCount(uint cidx, uint sidx, double n);
+
+    double _getCompAmount(uint cidx, uint sidx) const;
+    void _setCompAmount(uint cidx, uint sidx, double a);
+
+    double _getCompConc(uint cidx, uint sidx) const;
+    void _setCompConc(uint cidx, uint sidx, double c);
+
+    bool _getCompClamped(uint cidx, uint sidx) const;
+    void _setCompClamped(uint cidx, uint sidx, bool b);
+
+    double _getCompReacK(uint cidx, uint ridx) const;
+    void _setCompReacK(uint cidx, uint ridx, double kf);
+
+    bool _getCompReacActive(uint cidx, uint ridx) const;
+    void _setCompReacActive(uint cidx, uint ridx, bool a);
+
+    double _getCompDiffD(uint cidx, uint didx) const;
+    void _setCompDiffD(uint cidx, uint didx, double dcst);
+
+    bool _getCompDiffActive(uint cidx, uint didx) const;
+    void _setCompDiffActive(uint cidx, uint didx, bool act);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER METHODS: PATCH
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getPatchArea(uint pidx) const;
+
+    double _getPatchCount(uint pidx, uint sidx) const;
+    void _setPatchCount(uint pidx, uint sidx, double n);
+
+    double _getPatchAmount(uint pidx, uint sidx) const;
+    void _setPatchAmount(uint pidx, uint sidx, double a);
+
+    bool _getPatchClamped(uint pidx, uint sidx) const;
+    void _setPatchClamped(uint pidx, uint sidx, bool buf);
+
+    double _getPatchSReacK(uint pidx, uint ridx) const;
+    void _setPatchSReacK(uint pidx, uint ridx, double kf);
+
+    bool _getPatchSReacActive(uint pidx, uint ridx) const;
+    void _setPatchSReacActive(uint pidx, uint ridx, bool a);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER METHODS: TETRAHEDRAL VOLUME ELEMENTS
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getTetVol(uint tidx) const;
+
+    bool _getTetSpecDefined(uint tidx, uint sidx) const;
+
+    double _getTetCount(uint tidx, uint sidx) const;
+    void _setTetCount(uint tidx, uint sidx, double n);
+
+    double _getTetAmount(uint tidx, uint sidx) const;
+    void _setTetAmount(uint tidx, uint sidx, double m);
+
+    double _getTetConc(uint tidx, uint sidx) const;
+    void _setTetConc(uint tidx, uint sidx, double c);
+
+    ////////////////////////////////////////////////////////////////////////
+    // LEAP PASSES
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Fire the reactions and draw the diffusion out of the tetrahedrons
+    /// of block b, over a leap of length tau.
+    ///
+    void _leapBlock(uint b, double tau);
+
+    /// Add the molecules diffusing into the tetrahedrons of block b.
+    ///
+    void _gatherBlock(uint b);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    steps::tetmesh::Tetmesh * mesh(void) const
+    { return pMesh; }
+
+    /// Take a leap of length tau.
+    ///
+    void _leap(double tau);
+
+    /// Recompute the reaction constants of every tetrahedron from the
+    /// rate constants in the state definition.
+    ///
+    void _refillCcst(void);
+
+    /// Throw unless tidx is a tetrahedron of a compartment, and return
+    /// its local index.
+    ///
+    uint _tetIdx(uint tidx) const;
+
+    /// The local index of global species sidx in compartment c, or
+    /// throw.
+    ///
+    uint _compSpecIdx(uint c, uint sidx) const;
+    uint _patchSpecIdx(uint p, uint sidx) const;
+
+    /// Round n to a whole count, the fraction by chance.
+    ///
+    uint _roundCount(double n);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    steps::tetmesh::Tetmesh           * pMesh;
+
+    double                              pTau;
+    uint                                pThreads;
+
+    // The tetrahedrons of the compartments, compartment by compartment:
+    // the mesh index of each, the local index of each mesh tetrahedron
+    // (or TETLEAP_TET_NONE), the first of each compartment, and the
+    // compartment and volume of each.
+    uint                                pNTets;
+    std::vector<uint>                   pTetMesh;
+    std::vector<uint>                   pTetLocal;
+    std::vector<uint>                   pCompTetStart;
+    std::vector<uint>                   pTetComp;
+    std::vector<double>                 pTetVol;
+
+    // For face d of tetrahedron t, at 4 * t + d: the local neighbour in
+    // the same compartment (-1 if none), the face of the neighbour that
+    // leads back, and the diffusion weight area / (vol * dist).
+    std::vector<int>                    pNeighb;
+    std::vector<unsigned char>          pNeighbBack;
+    std::vector<double>                 pDiffW;
+
+    // Per compartment, over its n tetrahedrons: counts [s * n + i],
+    // reaction constants [r * n + i], the diffusion rules' active flags
+    // and local species, and the molecules leaving by each rule through
+    // each face in the last leap [(d * n + i) * 4 + face].
+    std::vector<std::vector<uint> >     pPools;
+    std::vector<std::vector<double> >   pCcst;
+    std::vector<std::vector<uint> >     pDiffActive;
+    std::vector<std::vector<uint> >     pDiffSpec;
+    std::vector<std::vector<uint> >     pOut;
+
+    // The random stream and the number of events of the last leap of
+    // each block.
+    std::vector<steps::rng::RNG *>      pRNGs;
+    std::vector<uint>                   pBlockEvents;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetleap)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TETLEAP_TETLEAP_HPP
+
+// END
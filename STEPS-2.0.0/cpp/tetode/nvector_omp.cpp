@@ -0,0 +1,497 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// STL headers.
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// STEPS headers.
+#include "../common.h"
+#include "nvector_omp.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::tetode, stode);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Below this length the vector operations stay on the calling thread; the
+// cost of a parallel region is then larger than the loop itself.
+const long int VECTOR_OMP_MIN_LENGTH = 4096;
+
+// The page size assumed by firstTouch; a smaller real page size would only
+// leave some pages to be placed by their first writer.
+const long int FIRST_TOUCH_PAGE = 4096;
+
+// The rows summed together by the reductions before the sums of the
+// blocks are added up, in order.
+const long int VECTOR_OMP_SUM_BLOCK = 4096;
+
+// The content of a serial vector followed by the number of threads.
+struct VectorOmpContent
+{
+	struct _N_VectorContent_Serial			serial;
+	uint									nthreads;
+};
+
+static int _nthreads(N_Vector x)
+{
+	return stode::ompThreads(static_cast<VectorOmpContent *>(x->content)->nthreads,
+		NV_LENGTH_S(x));
+}
+
+// Replace the serial content of v by a VectorOmpContent with the same
+// fields. Returns false if out of memory.
+static bool _extendContent(N_Vector v, uint nthreads)
+{
+	VectorOmpContent * c = static_cast<VectorOmpContent *>(std::malloc(sizeof(VectorOmpContent)));
+	if (c == 0) return false;
+	c->serial = *static_cast<N_VectorContent_Serial>(v->content);
+	c->nthreads = nthreads;
+	std::free(v->content);
+	v->content = c;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Loop indices are signed for OpenMP 2.0. Maxima and minima are combined
+// by hand since reduction(max) and reduction(min) only arrived in 3.1.
+
+// The sum of term(i) over the n rows. Rather than with reduction(+),
+// which adds the threads' partial sums in an order that depends on the
+// thread count, it is summed over fixed blocks of VECTOR_OMP_SUM_BLOCK
+// rows that are then added in order, so that the result, and with it
+// CVODE's step sizes and the whole trajectory, is the same bit for bit
+// on any number of threads.
+template <class Term>
+static realtype _sum(long int n, int nt, Term const & term)
+{
+	long int nb = (n + VECTOR_OMP_SUM_BLOCK - 1) / VECTOR_OMP_SUM_BLOCK;
+	if (nb <= 1)
+	{
+		realtype sum = 0.0;
+		for (long int i = 0; i < n; ++i) sum += term(i);
+		return sum;
+	}
+	std::vector<realtype> part(nb, 0.0);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int b = 0; b < nb; ++b)
+	{
+		long int end = (b + 1) * VECTOR_OMP_SUM_BLOCK;
+		if (end > n) end = n;
+		realtype sum = 0.0;
+		for (long int i = b * VECTOR_OMP_SUM_BLOCK; i < end; ++i) sum += term(i);
+		part[b] = sum;
+	}
+	realtype sum = 0.0;
+	for (long int b = 0; b < nb; ++b) sum += part[b];
+	return sum;
+}
+
+struct DotTerm
+{
+	realtype const * x;
+	realtype const * y;
+	inline realtype operator()(long int i) const
+	{ return x[i] * y[i]; }
+};
+
+struct SquareTerm
+{
+	realtype const * x;
+	realtype const * w;
+	inline realtype operator()(long int i) const
+	{ return (x[i] * w[i]) * (x[i] * w[i]); }
+};
+
+struct SquareMaskTerm
+{
+	realtype const * x;
+	realtype const * w;
+	realtype const * id;
+	inline realtype operator()(long int i) const
+	{ return (id[i] > 0.0) ? (x[i] * w[i]) * (x[i] * w[i]) : 0.0; }
+};
+
+struct AbsTerm
+{
+	realtype const * x;
+	inline realtype operator()(long int i) const
+	{ return std::fabs(x[i]); }
+};
+
+static void _linearSum(realtype a, N_Vector x, realtype b, N_Vector y, N_Vector z)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype const * yd = NV_DATA_S(y);
+	realtype * zd = NV_DATA_S(z);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int i = 0; i < n; ++i) zd[i] = a * xd[i] + b * yd[i];
+}
+
+static void _const(realtype c, N_Vector z)
+{
+	long int n = NV_LENGTH_S(z);
+	int nt = _nthreads(z);
+	realtype * zd = NV_DATA_S(z);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int i = 0; i < n; ++i) zd[i] = c;
+}
+
+static void _prod(N_Vector x, N_Vector y, N_Vector z)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype const * yd = NV_DATA_S(y);
+	realtype * zd = NV_DATA_S(z);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int i = 0; i < n; ++i) zd[i] = xd[i] * yd[i];
+}
+
+static void _div(N_Vector x, N_Vector y, N_Vector z)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype const * yd = NV_DATA_S(y);
+	realtype * zd = NV_DATA_S(z);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int i = 0; i < n; ++i) zd[i] = xd[i] / yd[i];
+}
+
+static void _scale(realtype c, N_Vector x, N_Vector z)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype * zd = NV_DATA_S(z);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int i = 0; i < n; ++i) zd[i] = c * xd[i];
+}
+
+static void _abs(N_Vector x, N_Vector z)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype * zd = NV_DATA_S(z);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int i = 0; i < n; ++i) zd[i] = std::fabs(xd[i]);
+}
+
+static void _inv(N_Vector x, N_Vector z)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype * zd = NV_DATA_S(z);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int i = 0; i < n; ++i) zd[i] = 1.0 / xd[i];
+}
+
+static void _addConst(N_Vector x, realtype b, N_Vector z)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype * zd = NV_DATA_S(z);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int i = 0; i < n; ++i) zd[i] = xd[i] + b;
+}
+
+static realtype _dotProd(N_Vector x, N_Vector y)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	DotTerm term = { NV_DATA_S(x), NV_DATA_S(y) };
+	return _sum(n, nt, term);
+}
+
+static realtype _maxNorm(N_Vector x)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype max = 0.0;
+#pragma omp parallel num_threads(nt) if(nt > 1)
+	{
+		realtype lmax = 0.0;
+#pragma omp for schedule(static)
+		for (long int i = 0; i < n; ++i)
+		{
+			if (std::fabs(xd[i]) > lmax) lmax = std::fabs(xd[i]);
+		}
+#pragma omp critical
+		if (lmax > max) max = lmax;
+	}
+	return max;
+}
+
+static realtype _wrmsNorm(N_Vector x, N_Vector w)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	SquareTerm term = { NV_DATA_S(x), NV_DATA_S(w) };
+	return std::sqrt(_sum(n, nt, term) / n);
+}
+
+static realtype _wrmsNormMask(N_Vector x, N_Vector w, N_Vector id)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	SquareMaskTerm term = { NV_DATA_S(x), NV_DATA_S(w), NV_DATA_S(id) };
+	return std::sqrt(_sum(n, nt, term) / n);
+}
+
+static realtype _min(N_Vector x)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype min = xd[0];
+#pragma omp parallel num_threads(nt) if(nt > 1)
+	{
+		realtype lmin = xd[0];
+#pragma omp for schedule(static)
+		for (long int i = 0; i < n; ++i)
+		{
+			if (xd[i] < lmin) lmin = xd[i];
+		}
+#pragma omp critical
+		if (lmin < min) min = lmin;
+	}
+	return min;
+}
+
+static realtype _wl2Norm(N_Vector x, N_Vector w)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	SquareTerm term = { NV_DATA_S(x), NV_DATA_S(w) };
+	return std::sqrt(_sum(n, nt, term));
+}
+
+static realtype _l1Norm(N_Vector x)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	AbsTerm term = { NV_DATA_S(x) };
+	return _sum(n, nt, term);
+}
+
+static void _compare(realtype c, N_Vector x, N_Vector z)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype * zd = NV_DATA_S(z);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int i = 0; i < n; ++i) zd[i] = (std::fabs(xd[i]) >= c) ? 1.0 : 0.0;
+}
+
+static booleantype _invTest(N_Vector x, N_Vector z)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * xd = NV_DATA_S(x);
+	realtype * zd = NV_DATA_S(z);
+	int nzero = 0;
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1) reduction(+:nzero)
+	for (long int i = 0; i < n; ++i)
+	{
+		if (xd[i] == 0.0) ++nzero;
+		else zd[i] = 1.0 / xd[i];
+	}
+	return (nzero == 0) ? TRUE : FALSE;
+}
+
+static booleantype _constrMask(N_Vector c, N_Vector x, N_Vector m)
+{
+	long int n = NV_LENGTH_S(x);
+	int nt = _nthreads(x);
+	realtype const * cd = NV_DATA_S(c);
+	realtype const * xd = NV_DATA_S(x);
+	realtype * md = NV_DATA_S(m);
+	int nfail = 0;
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1) reduction(+:nfail)
+	for (long int i = 0; i < n; ++i)
+	{
+		md[i] = 0.0;
+		if (cd[i] == 0.0) continue;
+		bool strict = (cd[i] > 1.5 || cd[i] < -1.5);
+		if (strict == false && cd[i] <= 0.5 && cd[i] >= -0.5) continue;
+		double p = xd[i] * cd[i];
+		if ((strict == true && p <= 0.0) || (strict == false && p < 0.0))
+		{
+			md[i] = 1.0;
+			++nfail;
+		}
+	}
+	return (nfail == 0) ? TRUE : FALSE;
+}
+
+static realtype _minQuotient(N_Vector num, N_Vector denom)
+{
+	long int n = NV_LENGTH_S(num);
+	int nt = _nthreads(num);
+	realtype const * nd = NV_DATA_S(num);
+	realtype const * dd = NV_DATA_S(denom);
+	realtype min = BIG_REAL;
+#pragma omp parallel num_threads(nt) if(nt > 1)
+	{
+		realtype lmin = BIG_REAL;
+#pragma omp for schedule(static)
+		for (long int i = 0; i < n; ++i)
+		{
+			if (dd[i] == 0.0) continue;
+			if (nd[i] / dd[i] < lmin) lmin = nd[i] / dd[i];
+		}
+#pragma omp critical
+		if (lmin < min) min = lmin;
+	}
+	return min;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static N_Vector _cloneEmpty(N_Vector w)
+{
+	// Copies the operations of w, so clones clone the same way.
+	N_Vector v = N_VCloneEmpty_Serial(w);
+	if (v == 0) return 0;
+	if (_extendContent(v, static_cast<VectorOmpContent *>(w->content)->nthreads) == false)
+	{
+		N_VDestroy_Serial(v);
+		return 0;
+	}
+	return v;
+}
+
+static N_Vector _clone(N_Vector w)
+{
+	N_Vector v = _cloneEmpty(w);
+	if (v == 0) return 0;
+	long int n = NV_LENGTH_S(w);
+	if (n > 0)
+	{
+		realtype * data = static_cast<realtype *>(std::malloc(n * sizeof(realtype)));
+		if (data == 0)
+		{
+			N_VDestroy_Serial(v);
+			return 0;
+		}
+		NV_OWN_DATA_S(v) = TRUE;
+		NV_DATA_S(v) = data;
+
+		// First touch: the pages of each row range are placed near the
+		// thread that will work on them.
+		_const(0.0, v);
+	}
+	return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+N_Vector stode::newVectorOmp(long int n, uint nthreads)
+{
+	N_Vector tmpl = N_VNewEmpty_Serial(n);
+	if (tmpl == 0) return 0;
+	if (_extendContent(tmpl, nthreads) == false)
+	{
+		N_VDestroy_Serial(tmpl);
+		return 0;
+	}
+
+	N_Vector_Ops ops = tmpl->ops;
+	ops->nvclone = _clone;
+	ops->nvcloneempty = _cloneEmpty;
+	ops->nvlinearsum = _linearSum;
+	ops->nvconst = _const;
+	ops->nvprod = _prod;
+	ops->nvdiv = _div;
+	ops->nvscale = _scale;
+	ops->nvabs = _abs;
+	ops->nvinv = _inv;
+	ops->nvaddconst = _addConst;
+	ops->nvdotprod = _dotProd;
+	ops->nvmaxnorm = _maxNorm;
+	ops->nvwrmsnorm = _wrmsNorm;
+	ops->nvwrmsnormmask = _wrmsNormMask;
+	ops->nvmin = _min;
+	ops->nvwl2norm = _wl2Norm;
+	ops->nvl1norm = _l1Norm;
+	ops->nvcompare = _compare;
+	ops->nvinvtest = _invTest;
+	ops->nvconstrmask = _constrMask;
+	ops->nvminquotient = _minQuotient;
+
+	N_Vector v = _clone(tmpl);
+	N_VDestroy_Serial(tmpl);
+	return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::setVectorOmpThreads(N_Vector v, uint nthreads)
+{
+	static_cast<VectorOmpContent *>(v->content)->nthreads = nthreads;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int stode::ompThreads(uint nthreads, long int n)
+{
+	if (n < VECTOR_OMP_MIN_LENGTH) return 1;
+	int nt = nthreads;
+#ifdef _OPENMP
+	if (nt == 0) nt = omp_get_max_threads();
+#endif
+	return (nt > 0) ? nt : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::firstTouch(void * p, std::size_t bytes, int nthreads)
+{
+	// One byte per page is enough; the rest of each page follows it.
+	char * data = static_cast<char *>(p);
+	long int npages = (static_cast<long int>(bytes) + FIRST_TOUCH_PAGE - 1) / FIRST_TOUCH_PAGE;
+	int nt = nthreads;
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (long int i = 0; i < npages; ++i) data[i * FIRST_TOUCH_PAGE] = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
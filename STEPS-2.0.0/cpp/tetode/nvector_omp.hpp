@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef STEPS_TETODE_NVECTOR_OMP_HPP
+#define STEPS_TETODE_NVECTOR_OMP_HPP 1
+
+// STL headers.
+#include <cstddef>
+#include <memory>
+
+// STEPS headers.
+#include "../common.h"
+
+// CVODE headers
+#include "../../third_party/cvode-2.6.0/src/nvec_ser/nvector_serial.h"
+#include "../../third_party/cvode-2.6.0/src/sundials/sundials_nvector.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(tetode)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Create a vector of length n for CVODE whose element-wise operations
+/// and reductions are shared out over nthreads OpenMP threads, or the
+/// OpenMP default if nthreads is 0.
+///
+/// The vector has the content of a serial vector followed by the thread
+/// count, so NV_DATA_S and N_VDestroy_Serial apply to it, and its clones
+/// carry the same operations and thread count. Every loop uses the same
+/// static schedule as the right-hand side in TetODE, so each thread
+/// touches the same rows of every vector throughout the integration.
+/// The sums (dot products and norms) are added up in an order that does
+/// not depend on the thread count, so neither do the results. Built
+/// without OpenMP it behaves as a serial vector.
+///
+N_Vector newVectorOmp(long int n, uint nthreads);
+
+/// Change the thread count of v; vectors cloned from it earlier keep
+/// theirs.
+///
+void setVectorOmpThreads(N_Vector v, uint nthreads);
+
+/// The number of threads for a loop over n rows given a requested count
+/// (0 for the OpenMP default): 1 for short loops, where starting the
+/// threads would cost more than the loop.
+///
+int ompThreads(uint nthreads, long int n);
+
+/// Touch the pages of [p, p + bytes) on nthreads OpenMP threads, in a
+/// static schedule over the pages, before anything else writes them.
+/// With a first-touch page policy (the Linux default) and the threads
+/// bound to cores (OMP_PROC_BIND), each page then lives on the NUMA
+/// node of the thread that touched it.
+///
+void firstTouch(void * p, std::size_t bytes, int nthreads);
+
+/// An allocator whose blocks are placed by firstTouch on nthreads
+/// threads, for the tables read row by row by loops with the static
+/// schedule of the right-hand side: each thread's share of a table is
+/// then (about) on its own NUMA node, as the rows have similar sizes.
+///
+template <class T>
+class FirstTouchAllocator : public std::allocator<T>
+{
+
+public:
+
+    template <class U>
+    struct rebind
+    { typedef FirstTouchAllocator<U> other; };
+
+    FirstTouchAllocator(int nthreads = 1) throw()
+    : std::allocator<T>(), pNThreads(nthreads)
+    { }
+
+    template <class U>
+    FirstTouchAllocator(FirstTouchAllocator<U> const & a) throw()
+    : std::allocator<T>(), pNThreads(a.getNThreads())
+    { }
+
+    inline int getNThreads(void) const
+    { return pNThreads; }
+
+    T * allocate(std::size_t n, void const * hint = 0)
+    {
+        T * p = std::allocator<T>::allocate(n, hint);
+        firstTouch(p, n * sizeof(T), pNThreads);
+        return p;
+    }
+
+private:
+
+    int                                 pNThreads;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(tetode)
+END_NAMESPACE(steps)
+
+#endif
+
+// STEPS_TETODE_NVECTOR_OMP_HPP
+
+// END
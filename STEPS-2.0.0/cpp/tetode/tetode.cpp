@@ -22,6 +22,7 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <cmath>
@@ -46,10 +47,14 @@
 #include "../geom/tri.hpp"
 
 #include "../error.hpp"
+#include "nvector_omp.hpp"
+#include "../meshcache.hpp"
 
 #include "../../third_party/cvode-2.6.0/src/cvode/cvode.h"             	/* prototypes for CVODE fcts., consts. */
 #include "../../third_party/cvode-2.6.0/src/nvec_ser/nvector_serial.h"  	/* serial N_Vector types, fcts., macros */
 #include "../../third_party/cvode-2.6.0/src/cvode/cvode_dense.h"      	/* prototype for CVDense */
+#include "../../third_party/cvode-2.6.0/src/cvode/cvode_spgmr.h"      	/* prototype for CVSpgmr */
+#include "../../third_party/cvode-2.6.0/src/cvode/cvode_impl.h"      	/* CVodeMem, for soft restarts */
 #include "../../third_party/cvode-2.6.0/src/sundials/sundials_dense.h" 	/* definitions DlsMat DENSE_ELEM */
 #include "../../third_party/cvode-2.6.0/src/sundials/sundials_types.h" 	/* definition of type realtype */
 #include "../../third_party/cvode-2.6.0/src/sundials/sundials_nvector.h"
@@ -61,16 +66,6 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
-// A vector all the reaction information, hopefully ingeniously
-// removing the need for a sparse matrix at all
-// This is stored in no-man's land because CVode function (f_cvode) needs access
-// to it and it wasn't possible to use as a class member, even as a friend
-// function (function needs access to Tetode pointer, which means re-writing the
-// function definition from the c side- messy)
-std::vector<std::vector<steps::tetode::structA> >  pSpec_matrixsub = std::vector<std::vector<steps::tetode::structA> > ();
-
-////////////////////////////////////////////////////////////////////////////////
-
 NAMESPACE_ALIAS(steps::tetode, stode);
 NAMESPACE_ALIAS(steps::solver, ssolver);
 NAMESPACE_ALIAS(steps::math, smath);
@@ -84,6 +79,14 @@ stode::TetODE::TetODE(steps::model::Model * m, steps::wm::Geom * g, steps::rng::
 , pPatches()
 , pTris()
 , pTets()
+, pSpec_matrixsub()
+, pRowStart()
+, pTermCoef()
+, pTermUpd()
+, pTermReac()
+, pTermLhsStart()
+, pLhsSpec()
+, pLhsOrder()
 , pSpecs_tot(0)
 , pReacs_tot(0)
 , reltol_cvode(1.0e-3)
@@ -91,6 +94,19 @@ stode::TetODE::TetODE(steps::model::Model * m, steps::wm::Geom * g, steps::rng::
 , pTolsset(false)
 , pReinit(true)
 , pNmax_cvode(10000)
+, pStiff(false)
+, pNThreads(0)
+, pBlockStart()
+, pPrecJ()
+, pPrecP()
+, pPrecPiv()
+, pDirect(false)
+, pJacStart()
+, pJacCol()
+, pJacPos()
+, pJacVal()
+, pDirectLU()
+, pDirectRhs()
 {
 	_setup();
 }
@@ -119,9 +135,18 @@ stode::TetODE::~TetODE(void)
 	// CVODE stuff
 	N_VDestroy_Serial(y_cvode);
 	N_VDestroy_Serial(abstol_cvode);
+	N_VDestroy(pYSoft);
 
 	/* Free integrator memory */
 	CVodeFree(&cvode_mem_cvode);
+
+	uint nblocks = pPrecJ.size();
+	for (uint b = 0; b < nblocks; ++b)
+	{
+		destroyMat(pPrecJ[b]);
+		destroyMat(pPrecP[b]);
+		destroyArray(pPrecPiv[b]);
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -228,6 +253,11 @@ void stode::TetODE::restore(std::string const & file_name)
 
     pTolsset = true;
 
+    // The restored state has no history to keep.
+    int flag = CVodeReInit(cvode_mem_cvode, statedef()->time(), y_cvode);
+    check_flag(&flag, "CVodeReInit", 1);
+    pReinit = false;
+
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -640,32 +670,30 @@ void stode::TetODE::_setup(void)
 				uint reac_order = cdef->reacdef(j)->order();
 				//pCcst[reac_gidx+j] =_ccst(reac_kcst, comp_vol, reac_order);
 				double ccst = _ccst(reac_kcst, tet_vol, reac_order);
-				for(uint k=0; k< compSpecs_N; ++k)
+				// Only the species the reaction changes.
+				uint * s_end = cdef->reac_updspec_end(j);
+				int * delta = cdef->reac_upddelta_bgn(j);
+				for (uint * s = cdef->reac_updspec_bgn(j); s != s_end; ++s, ++delta)
 				{
-					uint * lhs = cdef->reac_lhs_bgn(j);
-					int upd = cdef->reac_upd_bgn(j)[k];
-
-					if (upd != 0)
-					{
-						//structB btmp = {std::vector<uint>(), std::vector<uint>()};
-						structB btmp = {std::vector<structC>()};
+					uint k = *s;
+					int upd = *delta;
+					uint * lhs = cdef->reac_lhsorder_bgn(j);
+					uint * l_end = cdef->reac_lhsspec_end(j);
 
-						for (uint l=0; l < compSpecs_N; ++l)
-						{
-							uint lhs_spec = lhs[l];
-							if (lhs_spec != 0)
-							{
-								structC ctmp = {lhs_spec, spec_gidx +l};
-								//btmp.order.push_back(lhs_spec);
-								//btmp.spec_idx.push_back(spec_gidx +l);
-								btmp.info.push_back(ctmp);
-							}
-						}
-						structA atmp = {ccst,reac_gidx+j, upd, std::vector<steps::tetode::structB>()};
-						atmp.players.push_back(btmp);
+					//structB btmp = {std::vector<uint>(), std::vector<uint>()};
+					structB btmp = {std::vector<structC>()};
 
-						pSpec_matrixsub[spec_gidx+k].push_back(atmp);
+					for (uint * l = cdef->reac_lhsspec_bgn(j); l != l_end; ++l, ++lhs)
+					{
+						structC ctmp = {*lhs, spec_gidx + *l};
+						//btmp.order.push_back(lhs_spec);
+						//btmp.spec_idx.push_back(spec_gidx +l);
+						btmp.info.push_back(ctmp);
 					}
+					structA atmp = {ccst,reac_gidx+j, upd, std::vector<steps::tetode::structB>()};
+					atmp.players.push_back(btmp);
+
+					pSpec_matrixsub[spec_gidx+k].push_back(atmp);
 				}
 			}
 
@@ -680,9 +708,11 @@ void stode::TetODE::_setup(void)
 		{
 			for (uint j=0; j<compDiffs_N; ++j)
 			{
-				for(uint k=0; k< compSpecs_N; ++k)
+				// Only the species the diffusion rule depends on.
+				uint * k_end = cdef->diff_depspec_end(j);
+				for (uint * kp = cdef->diff_depspec_bgn(j); kp != k_end; ++kp)
 				{
-					if (cdef->diff_dep(j, k))
+					uint k = *kp;
 					{
 						Tet * tet_base = comp->getTet(t);
 						assert(tet_base != 0);
@@ -756,8 +786,6 @@ void stode::TetODE::_setup(void)
 
 		uint patchReacs_N = pdef->countSReacs();
 		uint patchSpecs_N_S = pdef->countSpecs();
-	    uint patchSpecs_N_I = pdef->countSpecs_I();
-		uint patchSpecs_N_O = pdef->countSpecs_O();
 
 		uint patchTris_N = patch->countTris();
 
@@ -806,16 +834,13 @@ void stode::TetODE::_setup(void)
 				// species whose upd value is non-zero, but all species
 				// can appear in 3 locations - the patch, the inner comp
 				// and the outer comp
-				uint * slhs = pdef->sreac_lhs_S_bgn(j);
-				for (uint l=0; l < patchSpecs_N_S; ++l)
+				uint * slhs = pdef->sreac_lhsorder_S_bgn(j);
+				uint * sl_end = pdef->sreac_lhsspec_S_end(j);
+				for (uint * l = pdef->sreac_lhsspec_S_bgn(j); l != sl_end; ++l, ++slhs)
 				{
-					uint slhs_spec = slhs[l];
-					if (slhs_spec != 0)
-					{
-						// spec_gidx is up to date for this triangle:
-						structC ctmp = {slhs_spec, spec_gidx +l};
-						btmp.info.push_back(ctmp);
-					}
+					// spec_gidx is up to date for this triangle:
+					structC ctmp = {*slhs, spec_gidx + *l};
+					btmp.info.push_back(ctmp);
 				}
 
 				ssolver::Compdef * icompdef = pdef->icompdef();
@@ -837,15 +862,12 @@ void stode::TetODE::_setup(void)
 					uint tet_lidx = localicomp->getTet_GtoL(tet_gidx);
 					mtx_itetidx+=(tet_lidx*icompdef->countSpecs());
 
-					uint * ilhs = pdef->sreac_lhs_I_bgn(j);
-					for (uint l=0; l<patchSpecs_N_I; ++l)
+					uint * ilhs = pdef->sreac_lhsorder_I_bgn(j);
+					uint * il_end = pdef->sreac_lhsspec_I_end(j);
+					for (uint * l = pdef->sreac_lhsspec_I_bgn(j); l != il_end; ++l, ++ilhs)
 					{
-						uint ilhs_spec = ilhs[l];
-						if (ilhs_spec != 0)
-						{
-							structC ctmp = {ilhs_spec, mtx_itetidx+l};
-							btmp.info.push_back(ctmp);
-						}
+						structC ctmp = {*ilhs, mtx_itetidx + *l};
+						btmp.info.push_back(ctmp);
 					}
 				}
 
@@ -868,40 +890,37 @@ void stode::TetODE::_setup(void)
 					uint tet_lidx = localocomp->getTet_GtoL(tet_gidx);
 					mtx_otetidx+=(tet_lidx*ocompdef->countSpecs());
 
-					uint * olhs = pdef->sreac_lhs_O_bgn(j);
-					for (uint l=0; l<patchSpecs_N_O; ++l)
+					uint * olhs = pdef->sreac_lhsorder_O_bgn(j);
+					uint * ol_end = pdef->sreac_lhsspec_O_end(j);
+					for (uint * l = pdef->sreac_lhsspec_O_bgn(j); l != ol_end; ++l, ++olhs)
 					{
-						uint olhs_spec = olhs[l];
-						if (olhs_spec != 0)
-						{
-							structC ctmp = {olhs_spec, mtx_otetidx+l};
-							btmp.info.push_back(ctmp);
-						}
+						structC ctmp = {*olhs, mtx_otetidx + *l};
+						btmp.info.push_back(ctmp);
 					}
 				}
 
 				// I can't see any alternative but to do the loops twice- once to fill the 'players' (lhs's),
 				// then go round again and add the reaction to every species involved (update not equal to 1)
-				for (uint k=0; k< patchSpecs_N_S; ++k)
+				uint * sp_end = pdef->sreac_updspec_S_end(j);
+				int * delta = pdef->sreac_upddelta_S_bgn(j);
+				for (uint * sp = pdef->sreac_updspec_S_bgn(j); sp != sp_end; ++sp, ++delta)
 				{
-					int supd = pdef->sreac_upd_S_bgn(j)[k];
-					if (supd != 0)
-					{
-						structA atmp = {ccst, reac_gidx+j,supd, std::vector<steps::tetode::structB>()};
-						atmp.players.push_back(btmp);
-						// PROBLEM here that I am going to add the same structure to a lot of vectors- need to figure out if I should copy, or
-						// something else fancy like storing it once and using pointers
-
-						// WHAT I COULD DO is have a big array of structBs somewhere (these are a bit like reactions)
-						// and add to the array as I go (keeping track of indices- actually is that necessary?)
-						// then the structAs simply store the pointer. This could also be useful for diffusion where the two 'reactions' depend on the same 'players'
-						// PRoblem is that we don't know how big it'll be- so use vectors instead? Then how to store pointer- store vector iterator??
-						// Could also do similar for structAs, then this pSpec_matrixsub only stores pointer to vector
-
-						// Each time a copy of the vector is made as a new object, which is fine. It will mean perhaps a
-						// 2 or 3 fold increase in memory to using pointers, but there should be some gain to efficiency.
-						pSpec_matrixsub[spec_gidx+k].push_back(atmp);
-					}
+					uint k = *sp;
+					int supd = *delta;
+					structA atmp = {ccst, reac_gidx+j,supd, std::vector<steps::tetode::structB>()};
+					atmp.players.push_back(btmp);
+					// PROBLEM here that I am going to add the same structure to a lot of vectors- need to figure out if I should copy, or
+					// something else fancy like storing it once and using pointers
+
+					// WHAT I COULD DO is have a big array of structBs somewhere (these are a bit like reactions)
+					// and add to the array as I go (keeping track of indices- actually is that necessary?)
+					// then the structAs simply store the pointer. This could also be useful for diffusion where the two 'reactions' depend on the same 'players'
+					// PRoblem is that we don't know how big it'll be- so use vectors instead? Then how to store pointer- store vector iterator??
+					// Could also do similar for structAs, then this pSpec_matrixsub only stores pointer to vector
+
+					// Each time a copy of the vector is made as a new object, which is fine. It will mean perhaps a
+					// 2 or 3 fold increase in memory to using pointers, but there should be some gain to efficiency.
+					pSpec_matrixsub[spec_gidx+k].push_back(atmp);
 				}
 
 				if (icompdef != 0)
@@ -920,15 +939,15 @@ void stode::TetODE::_setup(void)
 					uint tet_lidx = localicomp->getTet_GtoL(tet_gidx);
 					mtx_itetidx+=(tet_lidx*icompdef->countSpecs());
 
-					for (uint k=0; k<patchSpecs_N_I; ++k)
+					uint * sp_end = pdef->sreac_updspec_I_end(j);
+					int * delta = pdef->sreac_upddelta_I_bgn(j);
+					for (uint * sp = pdef->sreac_updspec_I_bgn(j); sp != sp_end; ++sp, ++delta)
 					{
-						int upd = pdef->sreac_upd_I_bgn(j)[k];
-						if (upd!=0)
-						{
-							structA atmp = {ccst, reac_gidx+j,upd,  std::vector<steps::tetode::structB>()};
-							atmp.players.push_back(btmp);
-							pSpec_matrixsub[mtx_itetidx+k].push_back(atmp);
-						}
+						uint k = *sp;
+						int upd = *delta;
+						structA atmp = {ccst, reac_gidx+j,upd,  std::vector<steps::tetode::structB>()};
+						atmp.players.push_back(btmp);
+						pSpec_matrixsub[mtx_itetidx+k].push_back(atmp);
 					}
 				}
 
@@ -948,16 +967,15 @@ void stode::TetODE::_setup(void)
 					uint tet_lidx = localocomp->getTet_GtoL(tet_gidx);
 					mtx_otetidx+=(tet_lidx*ocompdef->countSpecs());
 
-					for (uint k=0; k<patchSpecs_N_O; ++k)
+					uint * sp_end = pdef->sreac_updspec_O_end(j);
+					int * delta = pdef->sreac_upddelta_O_bgn(j);
+					for (uint * sp = pdef->sreac_updspec_O_bgn(j); sp != sp_end; ++sp, ++delta)
 					{
-						uint * olhs = pdef->sreac_lhs_O_bgn(j);
-						int upd = pdef->sreac_upd_O_bgn(j)[k];
-						if (upd!=0)
-						{
-							structA atmp = {ccst, reac_gidx+j,upd,  std::vector<steps::tetode::structB>()};
-							atmp.players.push_back(btmp);
-							pSpec_matrixsub[mtx_otetidx+k].push_back(atmp);
-						}
+						uint k = *sp;
+						int upd = *delta;
+						structA atmp = {ccst, reac_gidx+j,upd,  std::vector<steps::tetode::structB>()};
+						atmp.players.push_back(btmp);
+						pSpec_matrixsub[mtx_otetidx+k].push_back(atmp);
 					}
 				}
 			} // end of loop over patch surface reactions
@@ -973,9 +991,11 @@ void stode::TetODE::_setup(void)
 		{
 			for (uint j=0; j<patchSDiffs_N; ++j)
 			{
-				for(uint k=0; k< patchSpecs_N_S; ++k)
+				// Only the species the diffusion rule depends on.
+				uint * k_end = pdef->surfdiff_depspec_end(j);
+				for (uint * kp = pdef->surfdiff_depspec_bgn(j); kp != k_end; ++kp)
 				{
-					if (pdef->surfdiff_dep(j,k))
+					uint k = *kp;
 					{
 						Tri * tri_base = patch->getTri(t);
 						assert(tri_base != 0);
@@ -1048,35 +1068,72 @@ void stode::TetODE::_setup(void)
 
 	////////// Now to setup the cvode structures ///////////
 
-	// Creates serial vectors for y and absolute tolerances
-	y_cvode = N_VNew_Serial(pSpecs_tot);
-	check_flag((void *)y_cvode, "N_VNew_Serial", 0);
+	// Creates vectors for y and absolute tolerances; their operations
+	// share the rows out over OpenMP threads like f_cvode does.
+	y_cvode = newVectorOmp(pSpecs_tot, pNThreads);
+	check_flag((void *)y_cvode, "newVectorOmp", 0);
+
+	pYSoft = N_VClone(y_cvode);
+	check_flag((void *)pYSoft, "N_VClone", 0);
 
-	abstol_cvode = N_VNew_Serial(pSpecs_tot);
-	check_flag((void *)abstol_cvode, "N_VNew_Serial", 0);
+	abstol_cvode = newVectorOmp(pSpecs_tot, pNThreads);
+	check_flag((void *)abstol_cvode, "newVectorOmp", 0);
 
 	for (uint i=0; i< pSpecs_tot; ++i)
 	{
 		Ith(abstol_cvode, i) = 1.0e-3;
 	}
 
-	// Call CVodeCreate to create the solver memory and specify the
-	// Backward Differentiation Formula and the use of a Newton iteration
-	//cvode_mem_cvode = CVodeCreate(CV_BDF, CV_NEWTON);
-	// NO- the above choice eats up memory like you wouldn't believe
-	// and causes segmentation faults
-
-	// ADAMS and FUNCTIONAL are a much much better choice
-	cvode_mem_cvode = CVodeCreate(CV_ADAMS, CV_FUNCTIONAL) ;
-
-	check_flag((void *)cvode_mem_cvode, "CVodeCreate", 0);
-
 	// Initialise y and abs_tol:
 	for (uint i=0; i< pSpecs_tot; ++i)
 	{
 		Ith(y_cvode, i) = 0.0;
 	}
 
+	// The blocks of the stiff mode preconditioner: the species of each
+	// tet and of each tri are contiguous in y_cvode.
+	pBlockStart.push_back(0);
+	for (uint i=0; i< Comps_N; ++i)
+	{
+		uint nspecs = pComps[i]->def()->countSpecs();
+		if (nspecs == 0) continue;
+		uint ntets = pComps[i]->countTets();
+		for (uint t=0; t< ntets; ++t) pBlockStart.push_back(pBlockStart.back() + nspecs);
+	}
+	for (uint i=0; i< Patches_N; ++i)
+	{
+		uint nspecs = pPatches[i]->def()->countSpecs();
+		if (nspecs == 0) continue;
+		uint ntris = pPatches[i]->countTris();
+		for (uint t=0; t< ntris; ++t) pBlockStart.push_back(pBlockStart.back() + nspecs);
+	}
+	assert(pBlockStart.back() == pSpecs_tot);
+
+	_compileRHS();
+
+	cvode_mem_cvode = 0;
+	_createCVode();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::_createCVode(void)
+{
+	// Call CVodeCreate to create the solver memory and specify the
+	// Backward Differentiation Formula and the use of a Newton iteration.
+	// With a dense linear solver this eats up memory like you wouldn't
+	// believe, so the stiff mode uses preconditioned GMRES (see below).
+	// Otherwise ADAMS and FUNCTIONAL.
+	if (pStiff == true)
+	{
+		cvode_mem_cvode = CVodeCreate(CV_BDF, CV_NEWTON);
+	}
+	else
+	{
+		cvode_mem_cvode = CVodeCreate(CV_ADAMS, CV_FUNCTIONAL);
+	}
+	check_flag((void *)cvode_mem_cvode, "CVodeCreate", 0);
+
 	// Call CVodeInit to initialize the integrator memory and specify the
 	// user's right hand side function in y'=f(t,y), the initial time T0, and
 	// the initial dependent variable vector y.
@@ -1084,8 +1141,215 @@ void stode::TetODE::_setup(void)
 	// during any given run (such as injection of molecules) at the moment
 	// such features will not be supported. To support them will mean
 	// creating and freeing memory, copying structures etc and could be quite tricky
-	int flag = CVodeInit(cvode_mem_cvode, f_cvode, 0.0, y_cvode);
+	int flag = CVodeInit(cvode_mem_cvode, f_cvode, statedef()->time(), y_cvode);
 	check_flag(&flag, "CVodeInit", 1);
+
+	flag = CVodeSetUserData(cvode_mem_cvode, this);
+	check_flag(&flag, "CVodeSetUserData", 1);
+
+	if (pStiff == true)
+	{
+		// Left preconditioned GMRES with the default Krylov dimension.
+		flag = CVSpgmr(cvode_mem_cvode, PREC_LEFT, 0);
+		check_flag(&flag, "CVSpgmr", 1);
+		flag = CVSpilsSetJacTimesVecFn(cvode_mem_cvode, _jtimes_cvode);
+		check_flag(&flag, "CVSpilsSetJacTimesVecFn", 1);
+		flag = CVSpilsSetPreconditioner(cvode_mem_cvode, _psetup_cvode, _psolve_cvode);
+		check_flag(&flag, "CVSpilsSetPreconditioner", 1);
+
+		if (pDirect == true)
+		{
+			_setupDirect();
+		}
+		else if (pPrecJ.empty() == true)
+		{
+			uint nblocks = pBlockStart.size() - 1;
+			for (uint b=0; b< nblocks; ++b)
+			{
+				uint n = pBlockStart[b + 1] - pBlockStart[b];
+				pPrecJ.push_back(newDenseMat(n, n));
+				pPrecP.push_back(newDenseMat(n, n));
+				pPrecPiv.push_back(newIntArray(n));
+			}
+		}
+	}
+
+	// Tolerances and the step limit are (re)applied by the next run().
+	pInitialised = false;
+	pReinit = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::setStiff(bool stiff)
+{
+	if (stiff == pStiff) return;
+	pStiff = stiff;
+	CVodeFree(&cvode_mem_cvode);
+	_createCVode();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::setLinearSolver(std::string const & solver)
+{
+	bool direct;
+	if (solver == "block") direct = false;
+	else if (solver == "direct") direct = true;
+	else
+	{
+		std::ostringstream os;
+		os << "Unknown linear solver '" << solver << "' (expected 'block' ";
+		os << "or 'direct').";
+		throw steps::ArgErr(os.str());
+	}
+	if (direct == pDirect) return;
+	pDirect = direct;
+	if (pStiff == false) return;
+	CVodeFree(&cvode_mem_cvode);
+	_createCVode();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string stode::TetODE::getLinearSolver(void) const
+{
+	return (pDirect == true) ? "direct" : "block";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string stode::TetODE::getStateHash(void) const
+{
+	steps::ContentHash hash;
+	double t = statedef()->time();
+	hash.add(&t, sizeof(t));
+	if (pSpecs_tot != 0) hash.add(NV_DATA_S(y_cvode), pSpecs_tot * sizeof(realtype));
+	return hash.hex();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::_setupDirect(void)
+{
+	if (pJacStart.empty() == false) return;
+
+	// Row n has a column for each reactant of its terms, and the diagonal.
+	uint const * row_start = &pRowStart.front();
+	uint const * lhs_start = &pTermLhsStart.front();
+	pJacStart.assign(1, 0);
+	pJacCol.clear();
+	pJacPos.assign(pLhsSpec.size(), 0);
+	std::vector<uint> cols;
+	for (uint n = 0; n < pSpecs_tot; ++n)
+	{
+		cols.assign(1, n);
+		for (uint k = row_start[n]; k < row_start[n + 1]; ++k)
+		{
+			for (uint l = lhs_start[k]; l < lhs_start[k + 1]; ++l)
+			{
+				cols.push_back(pLhsSpec[l]);
+			}
+		}
+		std::sort(cols.begin(), cols.end());
+		cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+		uint bgn = pJacCol.size();
+		pJacCol.insert(pJacCol.end(), cols.begin(), cols.end());
+		for (uint k = row_start[n]; k < row_start[n + 1]; ++k)
+		{
+			for (uint l = lhs_start[k]; l < lhs_start[k + 1]; ++l)
+			{
+				pJacPos[l] = bgn + (std::lower_bound(cols.begin(), cols.end(), pLhsSpec[l]) - cols.begin());
+			}
+		}
+		pJacStart.push_back(pJacCol.size());
+	}
+	pJacVal.assign(pJacCol.size(), 0.0);
+	pDirectLU.setPattern(pSpecs_tot, pJacStart, pJacCol);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::setNThreads(uint n)
+{
+	if (n == pNThreads) return;
+	pNThreads = n;
+	setVectorOmpThreads(y_cvode, n);
+	setVectorOmpThreads(abstol_cvode, n);
+	_placeRHS();
+	// CVODE's work vectors are clones made when it was created.
+	CVodeFree(&cvode_mem_cvode);
+	_createCVode();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::_restrictToSpecs(std::vector<bool> const & specs)
+{
+	if (not pReacOff.empty())
+	{
+		std::copy(pTermCoefAll.begin(), pTermCoefAll.end(), pTermCoef.begin());
+		std::vector<bool>().swap(pReacOff);
+		std::vector<double>().swap(pTermCoefAll);
+	}
+	pReinit = true;
+	if (specs.empty()) return;
+
+	if (specs.size() != statedef()->countSpecs())
+	{
+		std::ostringstream os;
+		os << "Species flags must have one entry per species in the model.\n";
+		throw steps::ArgErr(os.str());
+	}
+
+	// Whether each row of y_cvode holds a flagged species; the rows are
+	// laid out as in _setup().
+	std::vector<bool> rowon;
+	rowon.reserve(pSpecs_tot);
+	CompPVecCI comp_end = pComps.end();
+	for (CompPVecCI comp = pComps.begin(); comp != comp_end; ++comp)
+	{
+		steps::solver::Compdef * cdef = (*comp)->def();
+		uint nspecs = cdef->countSpecs();
+		for (uint t = 0; t < (*comp)->countTets(); ++t)
+		{
+			for (uint l = 0; l < nspecs; ++l) rowon.push_back(specs[cdef->specL2G(l)]);
+		}
+	}
+	PatchPVecCI patch_end = pPatches.end();
+	for (PatchPVecCI patch = pPatches.begin(); patch != patch_end; ++patch)
+	{
+		steps::solver::Patchdef * pdef = (*patch)->def();
+		uint nspecs = pdef->countSpecs();
+		for (uint t = 0; t < (*patch)->countTris(); ++t)
+		{
+			for (uint l = 0; l < nspecs; ++l) rowon.push_back(specs[pdef->specL2G(l)]);
+		}
+	}
+	assert(rowon.size() == pSpecs_tot);
+
+	// A reaction instance is off if any species it updates or reads is
+	// not flagged, so that its terms in every row go together.
+	pReacOff.assign(pReacs_tot, false);
+	for (uint row = 0; row < pSpecs_tot; ++row)
+	{
+		for (uint k = pRowStart[row]; k < pRowStart[row + 1]; ++k)
+		{
+			bool on = rowon[row];
+			for (uint q = pTermLhsStart[k]; on and q < pTermLhsStart[k + 1]; ++q)
+			{
+				on = rowon[pLhsSpec[q]];
+			}
+			if (not on) pReacOff[pTermReac[k]] = true;
+		}
+	}
+
+	pTermCoefAll.assign(pTermCoef.begin(), pTermCoef.end());
+	uint nterms = pTermCoef.size();
+	for (uint k = 0; k < nterms; ++k)
+	{
+		if (pReacOff[pTermReac[k]]) pTermCoef[k] = 0.0;
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1100,6 +1364,13 @@ void stode::TetODE::setTolerances(double atol, double rtol)
 		os << "be negative.\n";
 		throw(steps::ArgErr(os.str()));
 	}
+	if (rtol < TETODE_MIN_RTOL)
+	{
+		std::ostringstream os;
+		os << "Relative tolerance cannot be below " << TETODE_MIN_RTOL;
+		os << " with the single precision state.\n";
+		throw(steps::ArgErr(os.str()));
+	}
 
 	reltol_cvode = rtol;
 
@@ -1222,7 +1493,8 @@ void stode::TetODE::run(double endtime)
 	    throw steps::ArgErr(os.str());
 	}
 
-    if (endtime == 0.0) return;
+    // Nothing to integrate; a pending change waits for the next run.
+    if (endtime == statedef()->time()) return;
 
 	int flag = 0;
 
@@ -1249,24 +1521,37 @@ void stode::TetODE::run(double endtime)
 		pInitialised = true;
 	}
 
-	// Call CVodeInit to re- initialize the integrator memory and specify the
-	// user's right hand side function in y'=f(t,y), the initial time T0, and
-	// the initial dependent variable vector y.
-	// Re-initialising here allows for injection of molecules, and possibly other
-	// additions in the future such as flags (though this would be a little tricky)
-
+	// Hand changes to the counts or the rates since the last run to CVODE.
+	// Continuing with the step size and order history treats them as a
+	// discontinuity: the error test and Newton iteration cut the step back
+	// if the history no longer fits. Only if that fails, or CVODE has not
+	// stopped at the current time, is the integrator reinitialised.
+	bool soft = false;
 	if (pReinit)
 	{
-		realtype starttime = statedef()->time();
-		flag = CVodeReInit(cvode_mem_cvode, starttime, y_cvode);
-		check_flag(&flag, "CVodeInit", 1);
+		soft = _softRestart();
+		if (not soft) _hardRestart();
 		pReinit = false;
 	}
 
+	// Stopping at endtime rather than interpolating back from a step past
+	// it keeps CVODE's own state at the current time.
+	flag = CVodeSetStopTime(cvode_mem_cvode, endtime);
+	check_flag(&flag, "CVodeSetStopTime", 1);
+
 	realtype t;
 	flag = CVode(cvode_mem_cvode, endtime, y_cvode, &t, CV_NORMAL);
 
-	if (flag != CV_SUCCESS)
+	if (flag < 0 and soft)
+	{
+		N_VScale(1.0, pYSoft, y_cvode);
+		_hardRestart();
+		flag = CVodeSetStopTime(cvode_mem_cvode, endtime);
+		check_flag(&flag, "CVodeSetStopTime", 1);
+		flag = CVode(cvode_mem_cvode, endtime, y_cvode, &t, CV_NORMAL);
+	}
+
+	if (flag != CV_SUCCESS and flag != CV_TSTOP_RETURN)
 	{
 		  std::ostringstream os;
 		  os << "\nCVODE iteration failed\n\n";
@@ -1277,6 +1562,42 @@ void stode::TetODE::run(double endtime)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+bool stode::TetODE::_softRestart(void)
+{
+	CVodeMem cv_mem = static_cast<CVodeMem>(cvode_mem_cvode);
+	if (cv_mem->cv_nst == 0) return false;
+
+	// The same roundoff CVODE allows when it stops at tstop.
+	realtype tcur = statedef()->time();
+	realtype troundoff = 100.0 * UNIT_ROUNDOFF
+		* (std::fabs(cv_mem->cv_tn) + std::fabs(cv_mem->cv_h));
+	if (std::fabs(cv_mem->cv_tn - tcur) > troundoff) return false;
+
+	// Replace the value in the Nordsieck history and shift its first
+	// derivative by the change the new state makes to f; the higher
+	// derivatives are kept. With the state unchanged only the rates
+	// differ, and the history is left as it is.
+	N_VScale(1.0, y_cvode, pYSoft);
+	N_Vector fold = cv_mem->cv_tempv;
+	N_Vector fnew = cv_mem->cv_ftemp;
+	f_cvode(tcur, cv_mem->cv_zn[0], fold, this);
+	f_cvode(tcur, y_cvode, fnew, this);
+	N_VLinearSum(1.0, fnew, -1.0, fold, fnew);
+	N_VLinearSum(1.0, cv_mem->cv_zn[1], cv_mem->cv_hscale, fnew, cv_mem->cv_zn[1]);
+	N_VScale(1.0, y_cvode, cv_mem->cv_zn[0]);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::_hardRestart(void)
+{
+	int flag = CVodeReInit(cvode_mem_cvode, statedef()->time(), y_cvode);
+	check_flag(&flag, "CVodeReInit", 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 double stode::TetODE::_getCompVol(uint cidx) const
 {
 	assert(cidx < statedef()->countComps());
@@ -1815,11 +2136,7 @@ void stode::TetODE::_setTetReacK(uint tidx, uint ridx, double kf)
 
 	for(uint k=0; k< compSpecs_N; ++k)
 	{
-		std::vector<stode::structA>::iterator r_end = pSpec_matrixsub[spec_idx+k].end();
-		for (std::vector<stode::structA>::iterator r = pSpec_matrixsub[spec_idx+k].begin(); r!=r_end; ++r)
-		{
-			if ((*r).r_idx == reac_idx) (*r).ccst = ccst;
-		}
+		_setTermCcst(spec_idx+k, reac_idx, ccst);
 	}
 }
 
@@ -2086,11 +2403,7 @@ void stode::TetODE::_setTriSReacK(uint tidx, uint ridx, double kf)
 
 	for (uint k=0; k < patchSpecs_N; ++k)
 	{
-		std::vector<stode::structA>::iterator r_end = pSpec_matrixsub[spec_idx+k].end();
-		for (std::vector<stode::structA>::iterator r = pSpec_matrixsub[spec_idx+k].begin(); r!=r_end; ++r)
-		{
-			if ((*r).r_idx == reac_idx) (*r).ccst = ccst;
-		}
+		_setTermCcst(spec_idx+k, reac_idx, ccst);
 	}
 
 	// Now the complicated part, which is to change the constants in the inner
@@ -2125,11 +2438,7 @@ void stode::TetODE::_setTriSReacK(uint tidx, uint ridx, double kf)
 		spec_idx += (icompSpecs_N*tlidx);
 		for(uint k=0; k< icompSpecs_N; ++k)
 		{
-			std::vector<stode::structA>::iterator r_end = pSpec_matrixsub[spec_idx+k].end();
-			for (std::vector<stode::structA>::iterator r = pSpec_matrixsub[spec_idx+k].begin(); r!=r_end; ++r)
-			{
-				if ((*r).r_idx == reac_idx) (*r).ccst = ccst;
-			}
+			_setTermCcst(spec_idx+k, reac_idx, ccst);
 		}
 	}
 
@@ -2159,11 +2468,7 @@ void stode::TetODE::_setTriSReacK(uint tidx, uint ridx, double kf)
 		spec_idx += (ocompSpecs_N*tlidx);
 		for(uint k=0; k< ocompSpecs_N; ++k)
 		{
-			std::vector<stode::structA>::iterator r_end = pSpec_matrixsub[spec_idx+k].end();
-			for (std::vector<stode::structA>::iterator r = pSpec_matrixsub[spec_idx+k].begin(); r!=r_end; ++r)
-			{
-				if ((*r).r_idx == reac_idx) (*r).ccst = ccst;
-			}
+			_setTermCcst(spec_idx+k, reac_idx, ccst);
 		}
 
 	}
@@ -2200,35 +2505,174 @@ double stode::TetODE::_getTetVol(uint tidx) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
-int f_cvode(realtype t, N_Vector y, N_Vector ydot, void *user_data)
+void stode::TetODE::_compileRHS(void)
 {
-	uint i = 0;
+	pRowStart.assign(1, 0);
+	pTermCoef.clear();
+	pTermUpd.clear();
+	pTermReac.clear();
+	pTermLhsStart.assign(1, 0);
+	pLhsSpec.clear();
+	pLhsOrder.clear();
+
 	std::vector< std::vector<steps::tetode::structA> >::const_iterator sp_end = pSpec_matrixsub.end();
-	//for (uint i = 0; i < tetode->pSpecs_tot; ++i)
 	for (std::vector< std::vector<steps::tetode::structA> >::const_iterator sp= pSpec_matrixsub.begin(); sp!=sp_end; ++sp)
 	{
-		double dydt = 0.0;
 		std::vector<steps::tetode::structA>::const_iterator r_end = (*sp).end();
 		for (std::vector<steps::tetode::structA>::const_iterator r = (*sp).begin(); r!=r_end; ++r)
 		{
-			double dydt_r = (*r).upd*(*r).ccst;
+			pTermCoef.push_back((*r).upd*(*r).ccst);
+			pTermUpd.push_back((*r).upd);
+			pTermReac.push_back((*r).r_idx);
 			std::vector<steps::tetode::structB>::const_iterator p_end = (*r).players.end();
 			for (std::vector<steps::tetode::structB>::const_iterator p = (*r).players.begin(); p!=p_end; ++p)
 			{
 				std::vector<steps::tetode::structC>::const_iterator q_end = (*p).info.end();
 				for (std::vector<steps::tetode::structC>::const_iterator q = (*p).info.begin(); q!=q_end; ++q)
 				{
-					double val = Ith(y,(*q).spec_idx);
-                    uint order = (*q).order;
-                    if (order == 1) dydt_r*=val;
-					else dydt_r*=pow(val, order);
+					pLhsSpec.push_back((*q).spec_idx);
+					pLhsOrder.push_back((*q).order);
 				}
 			}
+			pTermLhsStart.push_back(pLhsSpec.size());
+		}
+		pRowStart.push_back(pTermCoef.size());
+	}
+
+	// The nested form is not needed any more.
+	std::vector< std::vector<steps::tetode::structA> >().swap(pSpec_matrixsub);
+	_placeRHS();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::_placeRHS(void)
+{
+	int nt = ompThreads(pNThreads, pSpecs_tot);
+	FirstTouchAllocator<uint> ua(nt);
+	FirstTouchAllocator<realtype> ra(nt);
+	UintTable(pRowStart.begin(), pRowStart.end(), ua).swap(pRowStart);
+	RealTable(pTermCoef.begin(), pTermCoef.end(), ra).swap(pTermCoef);
+	UintTable(pTermLhsStart.begin(), pTermLhsStart.end(), ua).swap(pTermLhsStart);
+	UintTable(pLhsSpec.begin(), pLhsSpec.end(), ua).swap(pLhsSpec);
+	UintTable(pLhsOrder.begin(), pLhsOrder.end(), ua).swap(pLhsOrder);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::_setTermCcst(uint spec_idx, uint reac_idx, double ccst)
+{
+	assert(spec_idx < pSpecs_tot);
+	uint row_end = pRowStart[spec_idx + 1];
+	for (uint k = pRowStart[spec_idx]; k < row_end; ++k)
+	{
+		if (pTermReac[k] != reac_idx) continue;
+		double coef = pTermUpd[k] * ccst;
+		if (not pReacOff.empty())
+		{
+			pTermCoefAll[k] = coef;
+			if (pReacOff[reac_idx]) coef = 0.0;
+		}
+		pTermCoef[k] = coef;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int stode::TetODE::f_cvode(realtype t, N_Vector y, N_Vector ydot, void *user_data)
+{
+	TetODE const * tetode = static_cast<TetODE const *>(user_data);
+	realtype const * yv = NV_DATA_S(y);
+	realtype * ydotv = NV_DATA_S(ydot);
+	uint const * row_start = &tetode->pRowStart.front();
+	realtype const * coef = tetode->pTermCoef.empty() ? 0 : &tetode->pTermCoef.front();
+	uint const * lhs_start = &tetode->pTermLhsStart.front();
+	uint const * lhs_spec = tetode->pLhsSpec.empty() ? 0 : &tetode->pLhsSpec.front();
+	uint const * lhs_order = tetode->pLhsOrder.empty() ? 0 : &tetode->pLhsOrder.front();
+	int nspecs = tetode->pSpecs_tot;
+	int nt = ompThreads(tetode->pNThreads, nspecs);
+
+	// Rows are independent, so this parallelises when built with OpenMP.
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (int i = 0; i < nspecs; ++i)
+	{
+		double dydt = 0.0;
+		uint row_end = row_start[i + 1];
+		for (uint k = row_start[i]; k < row_end; ++k)
+		{
+			double dydt_r = coef[k];
+			uint l_end = lhs_start[k + 1];
+			for (uint l = lhs_start[k]; l < l_end; ++l)
+			{
+				double val = yv[lhs_spec[l]];
+				uint order = lhs_order[l];
+				if (order == 1) dydt_r*=val;
+				else dydt_r*=pow(val, order);
+			}
 			dydt+=dydt_r;
 		}
 		// Update the ydot vector with the calculated dydt
-		Ith(ydot, i) = dydt;
-		++i;
+		ydotv[i] = dydt;
+	}
+
+	return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Partial derivative of the rate of term k, with reactants [bgn, end) of
+// the flat reactant arrays, with respect to reactant wrt.
+static inline double term_drate(double coef, uint const * lhs_spec,
+		uint const * lhs_order, uint bgn, uint end, realtype const * y, uint wrt)
+{
+	double d = coef;
+	for (uint l = bgn; l < end; ++l)
+	{
+		double val = y[lhs_spec[l]];
+		uint order = lhs_order[l];
+		if (l == wrt)
+		{
+			d *= order;
+			order -= 1;
+		}
+		if (order == 1) d*=val;
+		else if (order != 0) d*=pow(val, order);
+	}
+	return d;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int stode::TetODE::_jtimes_cvode(N_Vector v, N_Vector Jv, realtype t,
+		N_Vector y, N_Vector fy, void * user_data, N_Vector tmp)
+{
+	TetODE const * tetode = static_cast<TetODE const *>(user_data);
+	realtype const * yv = NV_DATA_S(y);
+	realtype const * vv = NV_DATA_S(v);
+	realtype * jvv = NV_DATA_S(Jv);
+	uint const * row_start = &tetode->pRowStart.front();
+	realtype const * coef = tetode->pTermCoef.empty() ? 0 : &tetode->pTermCoef.front();
+	uint const * lhs_start = &tetode->pTermLhsStart.front();
+	uint const * lhs_spec = tetode->pLhsSpec.empty() ? 0 : &tetode->pLhsSpec.front();
+	uint const * lhs_order = tetode->pLhsOrder.empty() ? 0 : &tetode->pLhsOrder.front();
+	int nspecs = tetode->pSpecs_tot;
+	int nt = ompThreads(tetode->pNThreads, nspecs);
+
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (int i = 0; i < nspecs; ++i)
+	{
+		double jv = 0.0;
+		uint row_end = row_start[i + 1];
+		for (uint k = row_start[i]; k < row_end; ++k)
+		{
+			uint l_bgn = lhs_start[k];
+			uint l_end = lhs_start[k + 1];
+			for (uint l = l_bgn; l < l_end; ++l)
+			{
+				jv += term_drate(coef[k], lhs_spec, lhs_order, l_bgn, l_end, yv, l) * vv[lhs_spec[l]];
+			}
+		}
+		jvv[i] = jv;
 	}
 
 	return (0);
@@ -2236,4 +2680,285 @@ int f_cvode(realtype t, N_Vector y, N_Vector ydot, void *user_data)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+int stode::TetODE::_psetup_cvode(realtype t, N_Vector y, N_Vector fy,
+		booleantype jok, booleantype * jcurPtr, realtype gamma,
+		void * user_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+	TetODE * tetode = static_cast<TetODE *>(user_data);
+	realtype const * yv = NV_DATA_S(y);
+	if (tetode->pDirect == true) return tetode->_psetupDirect(yv, jok, jcurPtr, gamma);
+	uint nblocks = tetode->pBlockStart.size() - 1;
+	int nt = ompThreads(tetode->pNThreads, tetode->pSpecs_tot);
+
+	// Recompute the diagonal Jacobian blocks unless CVODE says the saved
+	// ones are still good enough.
+	if (jok == FALSE)
+	{
+		uint const * row_start = &tetode->pRowStart.front();
+		realtype const * coef = tetode->pTermCoef.empty() ? 0 : &tetode->pTermCoef.front();
+		uint const * lhs_start = &tetode->pTermLhsStart.front();
+		uint const * lhs_spec = tetode->pLhsSpec.empty() ? 0 : &tetode->pLhsSpec.front();
+		uint const * lhs_order = tetode->pLhsOrder.empty() ? 0 : &tetode->pLhsOrder.front();
+
+		// The blocks are independent; each fills only its own matrix.
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+		for (int b=0; b< (int)nblocks; ++b)
+		{
+			uint bgn = tetode->pBlockStart[b];
+			uint end = tetode->pBlockStart[b + 1];
+			realtype ** jac = tetode->pPrecJ[b];
+			for (uint j=0; j< end - bgn; ++j)
+			{
+				std::fill_n(jac[j], end - bgn, 0.0);
+			}
+
+			for (uint n = bgn; n < end; ++n)
+			{
+				uint row_end = row_start[n + 1];
+				for (uint k = row_start[n]; k < row_end; ++k)
+				{
+					uint l_bgn = lhs_start[k];
+					uint l_end = lhs_start[k + 1];
+					for (uint l = l_bgn; l < l_end; ++l)
+					{
+						uint s = lhs_spec[l];
+						if (s < bgn || s >= end) continue;
+						jac[s - bgn][n - bgn] += term_drate(coef[k], lhs_spec, lhs_order, l_bgn, l_end, yv, l);
+					}
+				}
+			}
+		}
+		*jcurPtr = TRUE;
+	}
+	else
+	{
+		*jcurPtr = FALSE;
+	}
+
+	// P = I - gamma J, LU factorised block by block.
+	int nsingular = 0;
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1) reduction(+:nsingular)
+	for (int b=0; b< (int)nblocks; ++b)
+	{
+		uint nb = tetode->pBlockStart[b + 1] - tetode->pBlockStart[b];
+		realtype ** jac = tetode->pPrecJ[b];
+		realtype ** prec = tetode->pPrecP[b];
+		for (uint j=0; j< nb; ++j)
+		{
+			for (uint i=0; i< nb; ++i)
+			{
+				prec[j][i] = -gamma * jac[j][i];
+			}
+			prec[j][j] += 1.0;
+		}
+		if (denseGETRF(prec, nb, nb, tetode->pPrecPiv[b]) != 0) ++nsingular;
+	}
+
+	// A singular block is a recoverable failure: CVODE retries with
+	// a smaller step.
+	return (nsingular == 0) ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int stode::TetODE::_psolve_cvode(realtype t, N_Vector y, N_Vector fy,
+		N_Vector r, N_Vector z, realtype gamma, realtype delta,
+		int lr, void * user_data, N_Vector tmp)
+{
+	TetODE * tetode = static_cast<TetODE *>(user_data);
+	N_VScale(1.0, r, z);
+
+	realtype * zdata = NV_DATA_S(z);
+	if (tetode->pDirect == true)
+	{
+		tetode->_directSolve(zdata);
+		return (0);
+	}
+	uint nblocks = tetode->pBlockStart.size() - 1;
+	int nt = ompThreads(tetode->pNThreads, tetode->pSpecs_tot);
+#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (int b=0; b< (int)nblocks; ++b)
+	{
+		uint bgn = tetode->pBlockStart[b];
+		uint nb = tetode->pBlockStart[b + 1] - bgn;
+		denseGETRS(tetode->pPrecP[b], nb, tetode->pPrecPiv[b], zdata + bgn);
+	}
+
+	return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int stode::TetODE::_psetupDirect(realtype const * y, booleantype jok,
+		booleantype * jcurPtr, realtype gamma)
+{
+	if (jok == FALSE)
+	{
+		_directJac(y);
+		*jcurPtr = TRUE;
+	}
+	else
+	{
+		*jcurPtr = FALSE;
+	}
+
+	// P = I - gamma J.
+	pDirectLU.clear();
+	for (uint n = 0; n < pSpecs_tot; ++n)
+	{
+		pDirectLU.add(n, n, 1.0);
+		for (uint j = pJacStart[n]; j < pJacStart[n + 1]; ++j)
+		{
+			pDirectLU.add(n, pJacCol[j], -gamma * pJacVal[j]);
+		}
+	}
+
+	// A zero pivot is a recoverable failure, as for a singular block.
+	return (pDirectLU.factor() == true) ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::_directJac(realtype const * y)
+{
+	uint const * row_start = &pRowStart.front();
+	realtype const * coef = pTermCoef.empty() ? 0 : &pTermCoef.front();
+	uint const * lhs_start = &pTermLhsStart.front();
+	uint const * lhs_spec = pLhsSpec.empty() ? 0 : &pLhsSpec.front();
+	uint const * lhs_order = pLhsOrder.empty() ? 0 : &pLhsOrder.front();
+	std::fill(pJacVal.begin(), pJacVal.end(), 0.0);
+	for (uint n = 0; n < pSpecs_tot; ++n)
+	{
+		uint row_end = row_start[n + 1];
+		for (uint k = row_start[n]; k < row_end; ++k)
+		{
+			uint l_bgn = lhs_start[k];
+			uint l_end = lhs_start[k + 1];
+			for (uint l = l_bgn; l < l_end; ++l)
+			{
+				pJacVal[pJacPos[l]] += term_drate(coef[k], lhs_spec, lhs_order, l_bgn, l_end, y, l);
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::_directSolve(realtype * z)
+{
+#if defined(SUNDIALS_SINGLE_PRECISION)
+	pDirectRhs.assign(z, z + pSpecs_tot);
+	pDirectLU.solve(&pDirectRhs.front());
+	std::copy(pDirectRhs.begin(), pDirectRhs.end(), z);
+#else
+	pDirectLU.solve(z);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stode::TetODE::steadyState(void)
+{
+	_setupDirect();
+
+	// The fastest time scale sets the pseudo time steps.
+	_directJac(NV_DATA_S(y_cvode));
+	double jmax = 0.0;
+	for (uint n = 0; n < pSpecs_tot; ++n)
+	{
+		uint diag = std::lower_bound(pJacCol.begin() + pJacStart[n],
+			pJacCol.begin() + pJacStart[n + 1], n) - pJacCol.begin();
+		jmax = std::max(jmax, std::fabs(pJacVal[diag]));
+	}
+	if (jmax == 0.0) return;
+
+	N_Vector y = N_VClone(y_cvode);
+	check_flag((void *)y, "N_VClone", 0);
+	double dtaumax = TETODE_STEADY_NEWTON_DTAU / jmax;
+	N_VScale(1.0, y_cvode, y);
+	bool found = _steadyIter(y, dtaumax, dtaumax, TETODE_STEADY_MAX_NEWTON);
+	if (found == false)
+	{
+		N_VScale(1.0, y_cvode, y);
+		found = _steadyIter(y, 1.0 / jmax, dtaumax, TETODE_STEADY_MAX_PTC);
+	}
+	if (found == true) N_VScale(1.0, y, y_cvode);
+	N_VDestroy(y);
+
+	if (found == false)
+	{
+		std::ostringstream os;
+		os << "Steady state not found from the current state.";
+		throw steps::SysErr(os.str());
+	}
+
+	// None of CVODE's history applies to the new state.
+	_hardRestart();
+	pReinit = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stode::TetODE::_steadyIter(N_Vector y, double dtau, double dtaumax, uint maxiter)
+{
+	bool newton = (dtau >= dtaumax);
+	N_Vector f = N_VClone(y);
+	N_Vector d = N_VClone(y);
+	realtype * yv = NV_DATA_S(y);
+	realtype * dv = NV_DATA_S(d);
+	realtype const * atol = NV_DATA_S(abstol_cvode);
+
+	f_cvode(0.0, y, f, this);
+	double fnorm = N_VDotProd(f, f);
+
+	bool found = false;
+	for (uint it = 0; it < maxiter && found == false; ++it)
+	{
+		// (I - dtau J) d = dtau f, an implicit Euler step of length dtau.
+		booleantype jcur;
+		bool ok = (_psetupDirect(yv, FALSE, &jcur, dtau) == 0);
+		double err = 0.0;
+		if (ok == true)
+		{
+			N_VScale(dtau, f, d);
+			_directSolve(dv);
+			for (uint n = 0; n < pSpecs_tot; ++n)
+			{
+				double w = atol[n] + reltol_cvode * std::fabs(yv[n]);
+				if (yv[n] + dv[n] < -w) ok = false;
+				err = std::max(err, std::fabs(dv[n]) / w);
+			}
+		}
+
+		// A step that fails or drives counts negative is retried shorter;
+		// Newton's method has no shorter step to retry.
+		if (ok == false)
+		{
+			if (newton == true) break;
+			dtau *= 0.1;
+			continue;
+		}
+
+		for (uint n = 0; n < pSpecs_tot; ++n) yv[n] = std::max(static_cast<realtype>(0.0), yv[n] + dv[n]);
+		if (dtau == dtaumax && err <= 1.0)
+		{
+			found = true;
+			continue;
+		}
+
+		// Switched evolution relaxation: grow the step as the rates fall.
+		double fnorm_prev = fnorm;
+		f_cvode(0.0, y, f, this);
+		fnorm = N_VDotProd(f, f);
+		double grow = (fnorm > 0.0) ? std::sqrt(fnorm_prev / fnorm) : 10.0;
+		dtau = std::min(dtaumax, dtau * std::min(10.0, grow));
+	}
+
+	N_VDestroy(f);
+	N_VDestroy(d);
+	return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
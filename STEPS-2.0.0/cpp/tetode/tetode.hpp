@@ -35,10 +35,12 @@
 #include "../solver/api.hpp"
 #include "../solver/statedef.hpp"
 #include "../geom/tetmesh.hpp"
+#include "../math/skyline.hpp"
 #include "comp.hpp"
 #include "patch.hpp"
 #include "tet.hpp"
 #include "tri.hpp"
+#include "nvector_omp.hpp"
 
 // CVODE headers
 #include "../../third_party/cvode-2.6.0/src/cvode/cvode.h"             	/* prototypes for CVODE fcts., consts. */
@@ -50,10 +52,6 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
-int f_cvode(realtype t, N_Vector y, N_Vector ydot, void * user_data);
-
-////////////////////////////////////////////////////////////////////////////////
-
 START_NAMESPACE(steps)
 START_NAMESPACE(tetode)
 
@@ -121,6 +119,29 @@ END_NAMESPACE(steps)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// Pseudo time step of steadyState()'s Newton iteration, relative to the
+/// fastest time scale of the Jacobian; its inverse on the diagonal keeps
+/// the Newton matrix regular across conservation laws.
+#define TETODE_STEADY_NEWTON_DTAU   1.0e8
+
+/// Maximum number of Newton iterations of steadyState() before it falls
+/// back to pseudo-transient continuation.
+#define TETODE_STEADY_MAX_NEWTON    50
+
+/// Maximum number of pseudo-transient continuation steps of steadyState().
+#define TETODE_STEADY_MAX_PTC       2000
+
+/// Smallest relative tolerance setTolerances() accepts. A build with
+/// SUNDIALS_SINGLE_PRECISION keeps the state and the right-hand side
+/// coefficients in single precision, which cannot meet tighter ones.
+#if defined(SUNDIALS_SINGLE_PRECISION)
+#define TETODE_MIN_RTOL             1.0e-5
+#else
+#define TETODE_MIN_RTOL             0.0
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
 START_NAMESPACE(steps)
 START_NAMESPACE(tetode)
 USING_NAMESPACE(steps::solver);
@@ -327,11 +348,70 @@ public:
 
     void setMaxNumSteps(uint maxn);
 
-	void check_flag(void *flagvalue, char *funcname, int opt);
+    /// Select CVODE's BDF method with Newton iteration for stiff systems.
+    /// The linear systems are solved with preconditioned GMRES, using the
+    /// analytic Jacobian-vector product and a block-Jacobi preconditioner
+    /// with one block per tetrahedron and per triangle. The default is
+    /// the Adams method with functional iteration.
+    ///
+    void setStiff(bool stiff);
+
+    bool getStiff(void) const
+    { return pStiff; }
+
+    /// Choose the preconditioner of the stiff mode's GMRES: "block" (the
+    /// default) is the block-Jacobi one, and "direct" a sparse LU of the
+    /// whole Newton matrix I - gamma J, diffusion between elements
+    /// included, after which GMRES converges in one iteration. The LU's
+    /// storage grows with the envelope of the matrix after reordering,
+    /// so it is meant for when GMRES struggles rather than for the
+    /// largest meshes.
+    ///
+    void setLinearSolver(std::string const & solver);
+
+    std::string getLinearSolver(void) const;
+
+    /// Set the number of OpenMP threads for the right-hand side, the
+    /// Jacobian products, the preconditioner and CVODE's vector
+    /// operations; 0 (the default) uses the OpenMP default. Systems of
+    /// fewer than a few thousand species always run on one thread. Has
+    /// no effect unless STEPS was built with OpenMP.
+    ///
+    void setNThreads(uint n);
+
+    uint getNThreads(void) const
+    { return pNThreads; }
+
+    /// A hash, as 16 hexadecimal digits, of the simulation time and the
+    /// state vector. The vector operations sum in a fixed order, so a
+    /// run gives the same hash on any number of threads.
+    ///
+    std::string getStateHash(void) const;
+
+    /// Set the counts to the steady state reached from the current state,
+    /// without advancing the simulation time. Uses Newton's method with the
+    /// sparse Jacobian of the whole system, decomposed as for the "direct"
+    /// linear solver, and, if that fails, pseudo-transient continuation;
+    /// converged within the CVODE tolerances. Throws and leaves the state
+    /// as it was if neither converges.
+    ///
+    void steadyState(void);
+
+    /// Integrate only the processes whose species are all flagged in
+    /// specs (indexed by global species index); the right hand side terms
+    /// of every other reaction, surface reaction and diffusion instance
+    /// are switched off. Used by the hybrid solver, which leaves those
+    /// processes to the SSA. An empty vector restores the full system.
+    ///
+    void _restrictToSpecs(std::vector<bool> const & specs);
 
-	//friend int f_cvode(realtype t, N_Vector y, N_Vector ydot, void * user_data, steps::tetode::TetODE * tetode);
+	void check_flag(void *flagvalue, char *funcname, int opt);
 
-	//int f_cvode(realtype t, N_Vector y, N_Vector ydot, void * user_data);
+	/// The CVODE right hand side function. user_data is the TetODE
+	/// object, so several solvers can exist (and run on separate
+	/// threads) in one process.
+	///
+	static int f_cvode(realtype t, N_Vector y, N_Vector ydot, void * user_data);
 
 
 	// CVODE stuff
@@ -343,6 +423,9 @@ public:
 	N_Vector								 abstol_cvode;
 	// Vector of values, for us species counts
 	N_Vector								 y_cvode;
+	// The state handed to CVODE by a soft restart, kept so that a run
+	// that fails from it can be retried from a cold start
+	N_Vector								 pYSoft;
 	// Memory block for CVODE
 	void 								   * cvode_mem_cvode;
 
@@ -363,11 +446,32 @@ private:
     // Now stored as base pointer
     std::vector<steps::tetode::Tet *>        pTets;
 
-    /*
 	// A vector all the reaction information, hopefully ingeniously
-    // removing the need for a sparse matrix at all
+    // removing the need for a sparse matrix at all. Only used while
+    // setting up; _compileRHS() flattens it into the arrays below.
 	std::vector<std::vector<steps::tetode::structA> >  pSpec_matrixsub;
-	*/
+
+	// The right hand side in CSR form. Row n (species n) holds the terms
+	// [pRowStart[n], pRowStart[n+1]); term k has coefficient upd*ccst in
+	// pTermCoef, the update value and reaction index it came from, and
+	// the reactants [pTermLhsStart[k], pTermLhsStart[k+1]) of pLhsSpec
+	// and pLhsOrder. The arrays read by f_cvode are placed by first touch
+	// (see _placeRHS()). The coefficients are in the precision of the
+	// state, the sums in double precision.
+	typedef std::vector<uint, FirstTouchAllocator<uint> >         UintTable;
+	typedef std::vector<realtype, FirstTouchAllocator<realtype> > RealTable;
+	UintTable								 pRowStart;
+	RealTable								 pTermCoef;
+	std::vector<int>						 pTermUpd;
+	std::vector<uint>						 pTermReac;
+	UintTable								 pTermLhsStart;
+	UintTable								 pLhsSpec;
+	UintTable								 pLhsOrder;
+
+	// Set by _restrictToSpecs(): the reaction instances that are switched
+	// off, and the coefficients of all terms as if none were.
+	std::vector<bool>						 pReacOff;
+	std::vector<double>						 pTermCoefAll;
 
 	uint 									 pSpecs_tot;
 	uint 									 pReacs_tot;
@@ -376,11 +480,112 @@ private:
 
 	bool 									 pInitialised;
 	bool									 pTolsset;
+	// Set when the state or the right hand side was changed since the
+	// last run(); the next run() hands the change to CVODE.
 	bool 									 pReinit;
 
 	// The maximum number of CVODE steps per run
 	uint 									 pNmax_cvode;
 
+	////////////////////////////////////////////////////////////////////////
+	// STIFF (BDF) MODE
+	////////////////////////////////////////////////////////////////////////
+
+	/// create the CVODE memory for the current method at the current time
+	///
+	void _createCVode(void);
+
+	/// hand y_cvode to CVODE as the state at the current time while
+	/// keeping its step size and order history; returns false if CVODE
+	/// has not stopped at the current time, which needs a reinit
+	///
+	bool _softRestart(void);
+
+	/// reinitialise CVODE at the current time from y_cvode
+	///
+	void _hardRestart(void);
+
+	/// flatten pSpec_matrixsub into the CSR right hand side arrays
+	///
+	void _compileRHS(void);
+
+	/// copy the arrays read by f_cvode to blocks first touched by the
+	/// threads of f_cvode, so that on a NUMA machine each thread's rows
+	/// are in its own node's memory
+	///
+	void _placeRHS(void);
+
+	/// set the rate constant of reaction reac_idx in the terms of species
+	/// spec_idx
+	///
+	void _setTermCcst(uint spec_idx, uint reac_idx, double ccst);
+
+	/// CVODE callbacks, user_data is the TetODE object
+	///
+	static int _jtimes_cvode(N_Vector v, N_Vector Jv, realtype t, N_Vector y,
+			N_Vector fy, void * user_data, N_Vector tmp);
+
+	static int _psetup_cvode(realtype t, N_Vector y, N_Vector fy,
+			booleantype jok, booleantype * jcurPtr, realtype gamma,
+			void * user_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+
+	static int _psolve_cvode(realtype t, N_Vector y, N_Vector fy,
+			N_Vector r, N_Vector z, realtype gamma, realtype delta,
+			int lr, void * user_data, N_Vector tmp);
+
+	/// the "direct" preconditioner: build the Jacobian pattern and the
+	/// LU's structure if not done yet
+	///
+	void _setupDirect(void);
+
+	/// the "direct" preconditioner setup: recompute the Jacobian at y
+	/// unless jok, and decompose I - gamma J
+	///
+	int _psetupDirect(realtype const * y, booleantype jok,
+			booleantype * jcurPtr, realtype gamma);
+
+	/// fill pJacVal with the Jacobian at y
+	///
+	void _directJac(realtype const * y);
+
+	/// solve (I - gamma J) x = z in place with the "direct" LU, which is
+	/// in double precision whatever the precision of the state
+	///
+	void _directSolve(realtype * z);
+
+	/// iterate y towards the steady state with pseudo time steps starting
+	/// at dtau, growing them up to dtaumax as the rates fall; with dtau
+	/// equal to dtaumax this is Newton's method. Returns true once a step
+	/// at dtaumax is within the tolerances; on false y is undefined.
+	///
+	bool _steadyIter(N_Vector y, double dtau, double dtaumax, uint maxiter);
+
+	bool 									 pStiff;
+
+	uint									 pNThreads;
+
+	// Species of block b (one per tet, then one per tri, in the order of
+	// y_cvode) are [pBlockStart[b], pBlockStart[b+1]).
+	std::vector<uint>						 pBlockStart;
+
+	// Per block: the diagonal block of the Jacobian, the factorised
+	// preconditioner I - gamma J and its pivots.
+	std::vector<realtype **>				 pPrecJ;
+	std::vector<realtype **>				 pPrecP;
+	std::vector<int *>						 pPrecPiv;
+
+	// With the "direct" preconditioner: the Jacobian in CSR form (row n
+	// has columns pJacCol[pJacStart[n]] to pJacCol[pJacStart[n+1]-1],
+	// values in pJacVal), the entry of pJacVal each reactant of pLhsSpec
+	// adds to, and the LU of I - gamma J.
+	bool									 pDirect;
+	std::vector<uint>						 pJacStart;
+	std::vector<uint>						 pJacCol;
+	std::vector<uint>						 pJacPos;
+	std::vector<double>						 pJacVal;
+	steps::math::SkylineLU					 pDirectLU;
+	std::vector<double>						 pDirectRhs;
+
 };
 
 
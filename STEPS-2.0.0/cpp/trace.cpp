@@ -0,0 +1,186 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// Standard library & STL headers.
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// STEPS headers.
+#include "common.h"
+#include "error.hpp"
+#include "trace.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+// One logged event.
+struct TraceRecord
+{
+    char const                        * name;
+    double                              begin;
+    double                              end;
+};
+
+// The ring buffer: once full, pTraceNext is the oldest event.
+static std::vector<TraceRecord>         pTraceLog;
+static uint                             pTraceCapacity = 0;
+static uint                             pTraceNext = 0;
+static bool                             pTraceFull = false;
+
+// Solvers run from several Python threads share the log.
+static pthread_mutex_t                  pTraceMutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct TraceLock
+{
+    TraceLock(void) { pthread_mutex_lock(&pTraceMutex); }
+    ~TraceLock(void) { pthread_mutex_unlock(&pTraceMutex); }
+};
+
+static void clearLog(void)
+{
+    pTraceLog.clear();
+    pTraceNext = 0;
+    pTraceFull = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool steps::traceOn = false;
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::setTracing(bool on, uint capacity)
+{
+    if (on == true)
+    {
+        if (capacity == 0)
+        {
+            std::ostringstream os;
+            os << "Trace capacity must be positive.";
+            throw steps::ArgErr(os.str());
+        }
+        TraceLock lock;
+        pTraceCapacity = capacity;
+        clearLog();
+        pTraceLog.reserve(capacity);
+    }
+    traceOn = on;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool steps::getTracing(void)
+{
+    return traceOn;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint steps::getTraceCount(void)
+{
+    TraceLock lock;
+    return pTraceLog.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::clearTrace(void)
+{
+    TraceLock lock;
+    clearLog();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double steps::traceClock(void)
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1.0e6 + ts.tv_nsec * 1.0e-3;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::traceEvent(char const * name, double begin, double end)
+{
+    TraceRecord rec;
+    rec.name = name;
+    rec.begin = begin;
+    rec.end = end;
+    TraceLock lock;
+    if (pTraceFull == false)
+    {
+        pTraceLog.push_back(rec);
+        if (pTraceLog.size() == pTraceCapacity) pTraceFull = true;
+        return;
+    }
+    pTraceLog[pTraceNext] = rec;
+    if (++pTraceNext == pTraceCapacity) pTraceNext = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void steps::writeTrace(std::string const & file_name)
+{
+    std::ofstream out(file_name.c_str());
+    if (!out)
+    {
+        std::ostringstream os;
+        os << "Cannot open trace file '" << file_name << "' for writing.";
+        throw steps::ArgErr(os.str());
+    }
+
+    // Complete events ("ph": "X") with begin and duration in microseconds.
+    out.precision(15);
+    TraceLock lock;
+    out << "{\"traceEvents\": [";
+    uint n = pTraceLog.size();
+    int pid = getpid();
+    for (uint i = 0; i < n; ++i)
+    {
+        TraceRecord const & rec = pTraceLog[(pTraceNext + i) % n];
+        if (i != 0) out << ",";
+        out << "\n{\"name\": \"" << rec.name << "\", \"cat\": \"steps\", ";
+        out << "\"ph\": \"X\", \"ts\": " << rec.begin << ", ";
+        out << "\"dur\": " << (rec.end - rec.begin) << ", ";
+        out << "\"pid\": " << pid << ", \"tid\": " << pid << "}";
+    }
+    out << "\n]}\n";
+
+    if (!out)
+    {
+        std::ostringstream os;
+        os << "Error writing trace file '" << file_name << "'.";
+        throw steps::ArgErr(os.str());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef STEPS_TRACE_HPP
+#define STEPS_TRACE_HPP 1
+
+// Standard library & STL headers.
+#include <string>
+
+// STEPS headers.
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Trace markers: the solvers mark their phases (a run, an EField step,
+/// a recorder sample, a checkpoint) with STEPS_TRACE(name), and while
+/// tracing is on each marked phase is logged with its begin and end
+/// time in a ring buffer, which keeps the most recent events. The log
+/// can be written in the trace event format that chrome://tracing and
+/// Perfetto read, with CLOCK_MONOTONIC timestamps, to line it up with
+/// system profiles.
+///
+/// Tracing is off by default; a marker then costs one test of a flag.
+/// Building with STEPS_NO_TRACE defined removes the markers. Only the
+/// thread that drives the solver logs events.
+///
+extern bool traceOn;
+
+/// Turn tracing on or off. Turning it on clears the log and sets the
+/// number of events it keeps.
+///
+void setTracing(bool on, uint capacity = 65536);
+
+bool getTracing(void);
+
+/// The number of events in the log.
+///
+uint getTraceCount(void);
+
+void clearTrace(void);
+
+/// Write the log to file_name, oldest event first.
+///
+void writeTrace(std::string const & file_name);
+
+/// The clock of the log, in microseconds.
+///
+double traceClock(void);
+
+/// Log an event. name must outlive the log (a string literal).
+///
+void traceEvent(char const * name, double begin, double end);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Logs the lifetime of the object as an event, if tracing was on when
+/// it was created.
+///
+class TraceScope
+{
+
+public:
+
+    TraceScope(char const * name)
+    : pName(name)
+    , pBegin(traceOn ? traceClock() : -1.0)
+    { }
+
+    ~TraceScope(void)
+    {
+        if (pBegin >= 0.0) traceEvent(pName, pBegin, traceClock());
+    }
+
+private:
+
+    char const                        * pName;
+    double                              pBegin;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef STEPS_NO_TRACE
+#define STEPS_TRACE(name)
+#else
+#define STEPS_TRACE(name) steps::TraceScope steps_trace_scope(name)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_TRACE_HPP
+
+// END
@@ -0,0 +1,1374 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPSis free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPSis distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "voxel.hpp"
+#include "../error.hpp"
+#include "../math/constants.hpp"
+#include "../solver/statedef.hpp"
+#include "../solver/compdef.hpp"
+#include "../solver/patchdef.hpp"
+#include "../solver/diffdef.hpp"
+#include "../solver/reacdef.hpp"
+#include "../solver/sreacdef.hpp"
+#include "../solver/types.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::voxel, svox);
+NAMESPACE_ALIAS(steps::solver, ssolver);
+NAMESPACE_ALIAS(steps::math, smath);
+
+////////////////////////////////////////////////////////////////////////////////
+
+static inline double voxel_ccst(double kcst, double scale, uint order)
+{
+    int o1 = static_cast<int>(order) - 1;
+    return kcst * pow(scale, static_cast<double>(-o1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The number of distinct ordered selections of order molecules out of
+// cnt, which is zero for integer cnt below order, as in Wmdirect.
+static inline double voxel_h(double cnt, uint order)
+{
+    switch (order)
+    {
+        case 4: return cnt * (cnt - 1.0) * (cnt - 2.0) * (cnt - 3.0);
+        case 3: return cnt * (cnt - 1.0) * (cnt - 2.0);
+        case 2: return cnt * (cnt - 1.0);
+        default: return cnt;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+svox::Voxel::Voxel(steps::model::Model * m, steps::wm::Geom * g,
+                   steps::rng::RNG * r, uint nx, uint ny, uint nz)
+: API(m, g, r)
+, pNX(nx)
+, pNY(ny)
+, pNZ(nz)
+, pNVox(nx * ny * nz)
+, pNFaces(2 * (nx * ny + ny * nz + nx * nz))
+, pNNeighb()
+, pFaceVox()
+, pVoxFaceStart()
+, pVoxFaces()
+, pCompPools()
+, pCompCcst()
+, pCompDRate()
+, pCompDiffActive()
+, pCompDiffSpec()
+, pCompSite()
+, pCompPatches()
+, pPatchPools()
+, pPatchCcst()
+, pPatchComp()
+, pPatchSite()
+, pNLeaves(1)
+, pTree()
+{
+    if (rng() == 0)
+    {
+        std::ostringstream os;
+        os << "No RNG provided to solver initializer function";
+        throw steps::ArgErr(os.str());
+    }
+    if (pNVox == 0)
+    {
+        std::ostringstream os;
+        os << "Voxel grid dimensions must be positive.";
+        throw steps::ArgErr(os.str());
+    }
+
+    _setupGrid();
+
+    uint ncomps = statedef()->countComps();
+    uint npatches = statedef()->countPatches();
+    uint nsites = 0;
+
+    pCompPools.resize(ncomps);
+    pCompCcst.resize(ncomps);
+    pCompDRate.resize(ncomps);
+    pCompDiffActive.resize(ncomps);
+    pCompDiffSpec.resize(ncomps);
+    pCompSite.resize(ncomps);
+    pCompPatches.resize(ncomps);
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        pCompPools[c].assign(cdef->countSpecs() * pNVox, 0.0);
+        pCompCcst[c].assign(cdef->countReacs(), 0.0);
+        uint ndiffs = cdef->countDiffs();
+        pCompDRate[c].assign(ndiffs, 0.0);
+        pCompDiffActive[c].assign(ndiffs, 1);
+        pCompDiffSpec[c].resize(ndiffs);
+        for (uint d = 0; d < ndiffs; ++d)
+        {
+            pCompDiffSpec[c][d] = cdef->specG2L(cdef->diffdef(d)->lig());
+        }
+        pCompSite[c] = nsites;
+        nsites += pNVox;
+    }
+
+    pPatchPools.resize(npatches);
+    pPatchCcst.resize(npatches);
+    pPatchComp.resize(npatches);
+    pPatchSite.resize(npatches);
+    for (uint p = 0; p < npatches; ++p)
+    {
+        ssolver::Patchdef * pdef = statedef()->patchdef(p);
+        if (pdef->icompdef() == 0)
+        {
+            std::ostringstream os;
+            os << "Patch '" << pdef->name() << "' has no inner compartment.";
+            throw steps::ArgErr(os.str());
+        }
+        if (pdef->countSurfDiffs() != 0 || pdef->countVDepSReacs() != 0 ||
+            pdef->countOhmicCurrs() != 0 || pdef->countGHKcurrs() != 0 ||
+            pdef->countVDepTrans() != 0)
+        {
+            std::ostringstream os;
+            os << "Patch '" << pdef->name() << "' has surface diffusion or";
+            os << " voltage dependent processes, which the voxel solver";
+            os << " does not support.";
+            throw steps::ArgErr(os.str());
+        }
+        uint nsreacs = pdef->countSReacs();
+        for (uint r = 0; r < nsreacs; ++r)
+        {
+            if (pdef->sreacdef(r)->reqOutside())
+            {
+                std::ostringstream os;
+                os << "Surface reaction '" << pdef->sreacdef(r)->name();
+                os << "' involves the outer compartment of patch '";
+                os << pdef->name() << "', which the voxel solver does";
+                os << " not support.";
+                throw steps::ArgErr(os.str());
+            }
+        }
+        pPatchPools[p].assign(pdef->countSpecs() * pNFaces, 0.0);
+        pPatchCcst[p].assign(nsreacs, 0.0);
+        pPatchComp[p] = pdef->icompdef()->gidx();
+        pPatchSite[p] = nsites;
+        pCompPatches[pPatchComp[p]].push_back(p);
+        nsites += pNFaces;
+    }
+
+    while (pNLeaves < nsites) pNLeaves *= 2;
+    pTree.assign(2 * pNLeaves, 0.0);
+
+    _refillCcst();
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+svox::Voxel::~Voxel(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setupGrid(void)
+{
+    uint nx = pNX;
+    uint ny = pNY;
+    uint nz = pNZ;
+
+    pNNeighb.resize(pNVox);
+    uint nb[6];
+    for (uint v = 0; v < pNVox; ++v)
+    {
+        pNNeighb[v] = static_cast<double>(_neighbours(v, nb));
+    }
+
+    // The faces of the walls at x = 0, x = nx - 1, y = 0, and so on.
+    pFaceVox.clear();
+    pFaceVox.reserve(pNFaces);
+    for (uint side = 0; side < 2; ++side)
+    {
+        uint i = (side == 0) ? 0 : nx - 1;
+        for (uint k = 0; k < nz; ++k)
+            for (uint j = 0; j < ny; ++j)
+                pFaceVox.push_back(i + nx * (j + ny * k));
+    }
+    for (uint side = 0; side < 2; ++side)
+    {
+        uint j = (side == 0) ? 0 : ny - 1;
+        for (uint k = 0; k < nz; ++k)
+            for (uint i = 0; i < nx; ++i)
+                pFaceVox.push_back(i + nx * (j + ny * k));
+    }
+    for (uint side = 0; side < 2; ++side)
+    {
+        uint k = (side == 0) ? 0 : nz - 1;
+        for (uint j = 0; j < ny; ++j)
+            for (uint i = 0; i < nx; ++i)
+                pFaceVox.push_back(i + nx * (j + ny * k));
+    }
+    assert(pFaceVox.size() == pNFaces);
+
+    pVoxFaceStart.assign(pNVox + 1, 0);
+    for (uint f = 0; f < pNFaces; ++f) ++pVoxFaceStart[pFaceVox[f] + 1];
+    for (uint v = 0; v < pNVox; ++v) pVoxFaceStart[v + 1] += pVoxFaceStart[v];
+    pVoxFaces.resize(pNFaces);
+    std::vector<uint> fill(pVoxFaceStart.begin(), pVoxFaceStart.end() - 1);
+    for (uint f = 0; f < pNFaces; ++f) pVoxFaces[fill[pFaceVox[f]]++] = f;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint svox::Voxel::_neighbours(uint v, uint * nb) const
+{
+    uint i = v % pNX;
+    uint j = (v / pNX) % pNY;
+    uint k = v / (pNX * pNY);
+    uint n = 0;
+    if (i > 0) nb[n++] = v - 1;
+    if (i + 1 < pNX) nb[n++] = v + 1;
+    if (j > 0) nb[n++] = v - pNX;
+    if (j + 1 < pNY) nb[n++] = v + pNX;
+    if (k > 0) nb[n++] = v - pNX * pNY;
+    if (k + 1 < pNZ) nb[n++] = v + pNX * pNY;
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string svox::Voxel::getSolverName(void) const
+{
+    return "voxel";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string svox::Voxel::getSolverDesc(void) const
+{
+    return "SSA Direct Method on a Cartesian voxel grid";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string svox::Voxel::getSolverAuthors(void) const
+{
+    return "Stefan Wils and Iain Hepburn";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string svox::Voxel::getSolverEmail(void) const
+{
+    return "stefan@tnb.ua.ac.be, ihepburn@oist.jp";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::checkpoint(std::string const & file_name)
+{
+    std::fstream cp_file;
+
+    cp_file.open(file_name.c_str(),
+                std::fstream::out | std::fstream::binary | std::fstream::trunc);
+
+    uint ncomps = pCompPools.size();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        cp_file.write((char*)&pCompPools[c].front(),
+                      sizeof(double) * pCompPools[c].size());
+        if (pCompDiffActive[c].empty() == false)
+        {
+            cp_file.write((char*)&pCompDiffActive[c].front(),
+                          sizeof(uint) * pCompDiffActive[c].size());
+        }
+    }
+    uint npatches = pPatchPools.size();
+    for (uint p = 0; p < npatches; ++p)
+    {
+        cp_file.write((char*)&pPatchPools[p].front(),
+                      sizeof(double) * pPatchPools[p].size());
+    }
+
+    statedef()->checkpoint(cp_file);
+
+    cp_file.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::restore(std::string const & file_name)
+{
+    std::fstream cp_file;
+
+    cp_file.open(file_name.c_str(),
+                std::fstream::in | std::fstream::binary);
+
+    cp_file.seekg(0);
+
+    uint ncomps = pCompPools.size();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        cp_file.read((char*)&pCompPools[c].front(),
+                     sizeof(double) * pCompPools[c].size());
+        if (pCompDiffActive[c].empty() == false)
+        {
+            cp_file.read((char*)&pCompDiffActive[c].front(),
+                         sizeof(uint) * pCompDiffActive[c].size());
+        }
+    }
+    uint npatches = pPatchPools.size();
+    for (uint p = 0; p < npatches; ++p)
+    {
+        cp_file.read((char*)&pPatchPools[p].front(),
+                     sizeof(double) * pPatchPools[p].size());
+    }
+
+    statedef()->restore(cp_file);
+
+    cp_file.close();
+
+    _refillCcst();
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::reset(void)
+{
+    uint ncomps = statedef()->countComps();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        statedef()->compdef(c)->reset();
+        std::fill(pCompPools[c].begin(), pCompPools[c].end(), 0.0);
+        std::fill(pCompDiffActive[c].begin(), pCompDiffActive[c].end(), 1);
+    }
+    uint npatches = statedef()->countPatches();
+    for (uint p = 0; p < npatches; ++p)
+    {
+        statedef()->patchdef(p)->reset();
+        std::fill(pPatchPools[p].begin(), pPatchPools[p].end(), 0.0);
+    }
+
+    statedef()->resetTime();
+    statedef()->resetNSteps();
+
+    _refillCcst();
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::run(double endtime)
+{
+    if (endtime < statedef()->time())
+    {
+        std::ostringstream os;
+        os << "Endtime is before current simulation time";
+        throw steps::ArgErr(os.str());
+    }
+    while (statedef()->time() < endtime)
+    {
+        double a0 = pTree[1];
+        if (a0 <= 0.0) break;
+        double dt = rng()->getExp(a0);
+        if ((statedef()->time() + dt) > endtime) break;
+        _executeStep();
+        statedef()->incTime(dt);
+        statedef()->incNSteps(1);
+    }
+    statedef()->setTime(endtime);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::advance(double adv)
+{
+    if (adv < 0.0)
+    {
+        std::ostringstream os;
+        os << "Time to advance cannot be negative";
+        throw steps::ArgErr(os.str());
+    }
+
+    double endtime = statedef()->time() + adv;
+    run(endtime);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::step(void)
+{
+    double a0 = pTree[1];
+    if (a0 <= 0.0) return;
+    double dt = rng()->getExp(a0);
+    _executeStep();
+    statedef()->incTime(dt);
+    statedef()->incNSteps(1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::getTime(void) const
+{
+    return statedef()->time();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::getA0(void) const
+{
+    return pTree[1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint svox::Voxel::getNSteps(void) const
+{
+    return statedef()->nsteps();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_refillCcst(void)
+{
+    double nvox = static_cast<double>(pNVox);
+    double nfaces = static_cast<double>(pNFaces);
+
+    uint ncomps = pCompPools.size();
+    for (uint c = 0; c < ncomps; ++c)
+    {
+        ssolver::Compdef * cdef = statedef()->compdef(c);
+        double vvol = cdef->vol() / nvox;
+        double vscale = 1.0e3 * vvol * smath::AVOGADRO;
+        uint nreacs = cdef->countReacs();
+        for (uint r = 0; r < nreacs; ++r)
+        {
+            pCompCcst[c][r] = voxel_ccst(cdef->kcst(r), vscale,
+                                         cdef->reacdef(r)->order());
+        }
+        double h = pow(vvol, 1.0 / 3.0);
+        uint ndiffs = cdef->countDiffs();
+        for (uint d = 0; d < ndiffs; ++d)
+        {
+            pCompDRate[c][d] = cdef->dcst(d) / (h * h);
+        }
+    }
+
+    uint npatches = pPatchPools.size();
+    for (uint p = 0; p < npatches; ++p)
+    {
+        ssolver::Patchdef * pdef = statedef()->patchdef(p);
+        double ivol = pdef->icompdef()->vol() / nvox;
+        double farea = pdef->area() / nfaces;
+        uint nsreacs = pdef->countSReacs();
+        for (uint r = 0; r < nsreacs; ++r)
+        {
+            ssolver::SReacdef * srdef = pdef->sreacdef(r);
+            double scale;
+            if (srdef->surf_surf()) scale = farea * smath::AVOGADRO;
+            else scale = 1.0e3 * ivol * smath::AVOGADRO;
+            pPatchCcst[p][r] = voxel_ccst(pdef->kcst(r), scale, srdef->order());
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_refreshComp(uint c)
+{
+    ssolver::Compdef * cdef = statedef()->compdef(c);
+    uint nvox = pNVox;
+    double * a = &pTree[pNLeaves + pCompSite[c]];
+    double const * pools = &pCompPools[c].front();
+    double const * nneighb = &pNNeighb.front();
+
+    std::fill_n(a, nvox, 0.0);
+
+    uint ndiffs = cdef->countDiffs();
+    for (uint d = 0; d < ndiffs; ++d)
+    {
+        if (pCompDiffActive[c][d] == 0) continue;
+        double k = pCompDRate[c][d];
+        double const * n = pools + pCompDiffSpec[c][d] * nvox;
+        for (uint v = 0; v < nvox; ++v) a[v] += k * nneighb[v] * n[v];
+    }
+
+    uint nreacs = cdef->countReacs();
+    std::vector<double> h(nvox);
+    for (uint r = 0; r < nreacs; ++r)
+    {
+        if (cdef->active(r) == false) continue;
+        std::fill(h.begin(), h.end(), pCompCcst[c][r]);
+        uint * order = cdef->reac_lhsorder_bgn(r);
+        uint * s_end = cdef->reac_lhsspec_end(r);
+        for (uint * s = cdef->reac_lhsspec_bgn(r); s != s_end; ++s, ++order)
+        {
+            double const * n = pools + (*s) * nvox;
+            uint o = *order;
+            for (uint v = 0; v < nvox; ++v) h[v] *= voxel_h(n[v], o);
+        }
+        for (uint v = 0; v < nvox; ++v) a[v] += h[v];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_refreshPatch(uint p)
+{
+    uint nfaces = pNFaces;
+    double * a = &pTree[pNLeaves + pPatchSite[p]];
+    for (uint f = 0; f < nfaces; ++f) a[f] = _faceProp(p, f);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_refresh(void)
+{
+    uint ncomps = pCompPools.size();
+    for (uint c = 0; c < ncomps; ++c) _refreshComp(c);
+    uint npatches = pPatchPools.size();
+    for (uint p = 0; p < npatches; ++p) _refreshPatch(p);
+    for (uint i = pNLeaves - 1; i > 0; --i)
+    {
+        pTree[i] = pTree[2 * i] + pTree[2 * i + 1];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_voxelProp(uint c, uint v) const
+{
+    ssolver::Compdef * cdef = statedef()->compdef(c);
+    uint nvox = pNVox;
+    double const * pools = &pCompPools[c].front();
+    double a = 0.0;
+
+    uint ndiffs = cdef->countDiffs();
+    for (uint d = 0; d < ndiffs; ++d)
+    {
+        if (pCompDiffActive[c][d] == 0) continue;
+        a += pCompDRate[c][d] * pNNeighb[v] * pools[pCompDiffSpec[c][d] * nvox + v];
+    }
+
+    uint nreacs = cdef->countReacs();
+    for (uint r = 0; r < nreacs; ++r)
+    {
+        if (cdef->active(r) == false) continue;
+        double h = pCompCcst[c][r];
+        uint * order = cdef->reac_lhsorder_bgn(r);
+        uint * s_end = cdef->reac_lhsspec_end(r);
+        for (uint * s = cdef->reac_lhsspec_bgn(r); s != s_end; ++s, ++order)
+        {
+            h *= voxel_h(pools[(*s) * nvox + v], *order);
+        }
+        a += h;
+    }
+    return a;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_faceProp(uint p, uint f) const
+{
+    ssolver::Patchdef * pdef = statedef()->patchdef(p);
+    uint nvox = pNVox;
+    uint nfaces = pNFaces;
+    uint v = pFaceVox[f];
+    double const * spools = &pPatchPools[p].front();
+    double const * ipools = &pCompPools[pPatchComp[p]].front();
+    double a = 0.0;
+
+    uint nsreacs = pdef->countSReacs();
+    for (uint r = 0; r < nsreacs; ++r)
+    {
+        if (pdef->active(r) == false) continue;
+        double h = pPatchCcst[p][r];
+        uint * order = pdef->sreac_lhsorder_S_bgn(r);
+        uint * s_end = pdef->sreac_lhsspec_S_end(r);
+        for (uint * s = pdef->sreac_lhsspec_S_bgn(r); s != s_end; ++s, ++order)
+        {
+            h *= voxel_h(spools[(*s) * nfaces + f], *order);
+        }
+        order = pdef->sreac_lhsorder_I_bgn(r);
+        s_end = pdef->sreac_lhsspec_I_end(r);
+        for (uint * s = pdef->sreac_lhsspec_I_bgn(r); s != s_end; ++s, ++order)
+        {
+            h *= voxel_h(ipools[(*s) * nvox + v], *order);
+        }
+        a += h;
+    }
+    return a;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setSite(uint site, double a)
+{
+    uint i = pNLeaves + site;
+    pTree[i] = a;
+    for (i /= 2; i > 0; i /= 2) pTree[i] = pTree[2 * i] + pTree[2 * i + 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_updateVoxel(uint c, uint v)
+{
+    _setSite(pCompSite[c] + v, _voxelProp(c, v));
+    std::vector<uint> const & patches = pCompPatches[c];
+    uint f_end = pVoxFaceStart[v + 1];
+    for (uint i = 0; i < patches.size(); ++i)
+    {
+        uint p = patches[i];
+        for (uint fi = pVoxFaceStart[v]; fi != f_end; ++fi)
+        {
+            uint f = pVoxFaces[fi];
+            _setSite(pPatchSite[p] + f, _faceProp(p, f));
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_addComp(uint c, uint s, uint v, int d)
+{
+    ssolver::Compdef * cdef = statedef()->compdef(c);
+    if (cdef->clamped(s)) return;
+    pCompPools[c][s * pNVox + v] += d;
+    cdef->pools()[s] += d;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_addPatch(uint p, uint s, uint f, int d)
+{
+    ssolver::Patchdef * pdef = statedef()->patchdef(p);
+    if (pdef->clamped(s)) return;
+    pPatchPools[p][s * pNFaces + f] += d;
+    pdef->pools()[s] += d;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_executeStep(void)
+{
+    // Descend the tree, never into an empty subtree, which rounding
+    // could otherwise select.
+    double x = rng()->getUnfIE() * pTree[1];
+    uint i = 1;
+    while (i < pNLeaves)
+    {
+        i *= 2;
+        if (x < pTree[i] || pTree[i + 1] <= 0.0) continue;
+        x -= pTree[i];
+        ++i;
+    }
+    uint site = i - pNLeaves;
+
+    uint npatches = pPatchSite.size();
+    for (uint p = npatches; p > 0; --p)
+    {
+        if (site >= pPatchSite[p - 1])
+        {
+            _fireFace(p - 1, site - pPatchSite[p - 1], x);
+            return;
+        }
+    }
+    uint c = site / pNVox;
+    _fireVoxel(c, site - pCompSite[c], x);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_fireVoxel(uint c, uint v, double x)
+{
+    ssolver::Compdef * cdef = statedef()->compdef(c);
+    uint nvox = pNVox;
+    double const * pools = &pCompPools[c].front();
+
+    // Scan the events of the voxel in the order of _voxelProp; the last
+    // possible one takes any rounding excess.
+    int diff = -1;
+    int reac = -1;
+    bool found = false;
+    uint ndiffs = cdef->countDiffs();
+    for (uint d = 0; d < ndiffs && found == false; ++d)
+    {
+        if (pCompDiffActive[c][d] == 0) continue;
+        double a = pCompDRate[c][d] * pNNeighb[v] * pools[pCompDiffSpec[c][d] * nvox + v];
+        if (a <= 0.0) continue;
+        diff = d;
+        if (x < a) found = true;
+        else x -= a;
+    }
+    uint nreacs = cdef->countReacs();
+    for (uint r = 0; r < nreacs && found == false; ++r)
+    {
+        if (cdef->active(r) == false) continue;
+        double h = pCompCcst[c][r];
+        uint * order = cdef->reac_lhsorder_bgn(r);
+        uint * s_end = cdef->reac_lhsspec_end(r);
+        for (uint * s = cdef->reac_lhsspec_bgn(r); s != s_end; ++s, ++order)
+        {
+            h *= voxel_h(pools[(*s) * nvox + v], *order);
+        }
+        if (h <= 0.0) continue;
+        reac = r;
+        if (x < h) found = true;
+        else x -= h;
+    }
+
+    if (reac < 0)
+    {
+        assert(diff >= 0);
+        uint s = pCompDiffSpec[c][diff];
+        uint nb[6];
+        uint n = _neighbours(v, nb);
+        uint dir = static_cast<uint>(rng()->getUnfIE() * n);
+        _addComp(c, s, v, -1);
+        _addComp(c, s, nb[dir], 1);
+        _updateVoxel(c, v);
+        _updateVoxel(c, nb[dir]);
+        return;
+    }
+
+    uint * s_end = cdef->reac_updspec_end(reac);
+    int * delta = cdef->reac_upddelta_bgn(reac);
+    for (uint * s = cdef->reac_updspec_bgn(reac); s != s_end; ++s, ++delta)
+    {
+        _addComp(c, *s, v, *delta);
+    }
+    _updateVoxel(c, v);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_fireFace(uint p, uint f, double x)
+{
+    ssolver::Patchdef * pdef = statedef()->patchdef(p);
+    uint c = pPatchComp[p];
+    uint v = pFaceVox[f];
+
+    int last_sreac = -1;
+    uint nvox = pNVox;
+    uint nfaces = pNFaces;
+    double const * spools = &pPatchPools[p].front();
+    double const * ipools = &pCompPools[c].front();
+    uint nsreacs = pdef->countSReacs();
+    for (uint r = 0; r < nsreacs; ++r)
+    {
+        if (pdef->active(r) == false) continue;
+        double h = pPatchCcst[p][r];
+        uint * order = pdef->sreac_lhsorder_S_bgn(r);
+        uint * s_end = pdef->sreac_lhsspec_S_end(r);
+        for (uint * s = pdef->sreac_lhsspec_S_bgn(r); s != s_end; ++s, ++order)
+        {
+            h *= voxel_h(spools[(*s) * nfaces + f], *order);
+        }
+        order = pdef->sreac_lhsorder_I_bgn(r);
+        s_end = pdef->sreac_lhsspec_I_end(r);
+        for (uint * s = pdef->sreac_lhsspec_I_bgn(r); s != s_end; ++s, ++order)
+        {
+            h *= voxel_h(ipools[(*s) * nvox + v], *order);
+        }
+        if (h <= 0.0) continue;
+        last_sreac = r;
+        if (x < h) break;
+        x -= h;
+    }
+    assert(last_sreac >= 0);
+
+    uint * s_end = pdef->sreac_updspec_S_end(last_sreac);
+    int * delta = pdef->sreac_upddelta_S_bgn(last_sreac);
+    for (uint * s = pdef->sreac_updspec_S_bgn(last_sreac); s != s_end; ++s, ++delta)
+    {
+        _addPatch(p, *s, f, *delta);
+    }
+    s_end = pdef->sreac_updspec_I_end(last_sreac);
+    delta = pdef->sreac_upddelta_I_bgn(last_sreac);
+    for (uint * s = pdef->sreac_updspec_I_bgn(last_sreac); s != s_end; ++s, ++delta)
+    {
+        _addComp(c, *s, v, *delta);
+    }
+    // The face is in front of v, so this updates it too.
+    _updateVoxel(c, v);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint svox::Voxel::_compSpecIdx(uint c, uint s) const
+{
+    uint slidx = statedef()->compdef(c)->specG2L(s);
+    if (slidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Species undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return slidx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint svox::Voxel::_patchSpecIdx(uint p, uint s) const
+{
+    uint slidx = statedef()->patchdef(p)->specG2L(s);
+    if (slidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Species undefined in patch.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return slidx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::getVoxelSize(std::string const & c) const
+{
+    uint cidx = statedef()->getCompIdx(c);
+    return pow(statedef()->compdef(cidx)->vol() / pNVox, 1.0 / 3.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::getCompVoxelCount(std::string const & c,
+                                      std::string const & s, uint vox) const
+{
+    uint cidx = statedef()->getCompIdx(c);
+    uint slidx = _compSpecIdx(cidx, statedef()->getSpecIdx(s));
+    if (vox >= pNVox)
+    {
+        std::ostringstream os;
+        os << "Voxel index out of range.";
+        throw steps::ArgErr(os.str());
+    }
+    return pCompPools[cidx][slidx * pNVox + vox];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::setCompVoxelCount(std::string const & c,
+                                    std::string const & s, uint vox, double n)
+{
+    uint cidx = statedef()->getCompIdx(c);
+    uint slidx = _compSpecIdx(cidx, statedef()->getSpecIdx(s));
+    if (vox >= pNVox)
+    {
+        std::ostringstream os;
+        os << "Voxel index out of range.";
+        throw steps::ArgErr(os.str());
+    }
+    if (n < 0.0 || n > std::numeric_limits<unsigned int>::max())
+    {
+        std::ostringstream os;
+        os << "Count must be between 0 and the maximum unsigned integer.";
+        throw steps::ArgErr(os.str());
+    }
+    double c_new = std::floor(n);
+    if (n - c_new > 0.0 && rng()->getUnfIE() < n - c_new) c_new += 1.0;
+    ssolver::Compdef * cdef = statedef()->compdef(cidx);
+    double & cnt = pCompPools[cidx][slidx * pNVox + vox];
+    cdef->setCount(slidx, cdef->pools()[slidx] + c_new - cnt);
+    cnt = c_new;
+    _updateVoxel(cidx, vox);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::getPatchFaceCount(std::string const & p,
+                                      std::string const & s, uint face) const
+{
+    uint pidx = statedef()->getPatchIdx(p);
+    uint slidx = _patchSpecIdx(pidx, statedef()->getSpecIdx(s));
+    if (face >= pNFaces)
+    {
+        std::ostringstream os;
+        os << "Face index out of range.";
+        throw steps::ArgErr(os.str());
+    }
+    return pPatchPools[pidx][slidx * pNFaces + face];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::setPatchFaceCount(std::string const & p,
+                                    std::string const & s, uint face, double n)
+{
+    uint pidx = statedef()->getPatchIdx(p);
+    uint slidx = _patchSpecIdx(pidx, statedef()->getSpecIdx(s));
+    if (face >= pNFaces)
+    {
+        std::ostringstream os;
+        os << "Face index out of range.";
+        throw steps::ArgErr(os.str());
+    }
+    if (n < 0.0 || n > std::numeric_limits<unsigned int>::max())
+    {
+        std::ostringstream os;
+        os << "Count must be between 0 and the maximum unsigned integer.";
+        throw steps::ArgErr(os.str());
+    }
+    double c_new = std::floor(n);
+    if (n - c_new > 0.0 && rng()->getUnfIE() < n - c_new) c_new += 1.0;
+    ssolver::Patchdef * pdef = statedef()->patchdef(pidx);
+    double & cnt = pPatchPools[pidx][slidx * pNFaces + face];
+    pdef->setCount(slidx, pdef->pools()[slidx] + c_new - cnt);
+    cnt = c_new;
+    _setSite(pPatchSite[pidx] + face, _faceProp(pidx, face));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_getCompVol(uint cidx) const
+{
+    assert(cidx < statedef()->countComps());
+    return statedef()->compdef(cidx)->vol();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_getCompCount(uint cidx, uint sidx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(sidx < statedef()->countSpecs());
+    return statedef()->compdef(cidx)->pools()[_compSpecIdx(cidx, sidx)];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setCompCount(uint cidx, uint sidx, double n)
+{
+    assert(cidx < statedef()->countComps());
+    assert(sidx < statedef()->countSpecs());
+    uint slidx = _compSpecIdx(cidx, sidx);
+    if (n > std::numeric_limits<unsigned int>::max())
+    {
+        std::ostringstream os;
+        os << "Can't set count greater than maximum unsigned integer (";
+        os << std::numeric_limits<unsigned int>::max() << ").\n";
+        throw steps::ArgErr(os.str());
+    }
+    assert(n >= 0.0);
+
+    // Spread the molecules uniformly over the voxels.
+    std::vector<double> counts(pNVox, 1.0);
+    _multinomial(n, counts);
+    double total = 0.0;
+    double * pools = &pCompPools[cidx][slidx * pNVox];
+    for (uint v = 0; v < pNVox; ++v)
+    {
+        pools[v] = counts[v];
+        total += counts[v];
+    }
+    statedef()->compdef(cidx)->setCount(slidx, total);
+
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_getCompAmount(uint cidx, uint sidx) const
+{
+    // the following method does all the necessary argument checking
+    double count = _getCompCount(cidx, sidx);
+    return (count / smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setCompAmount(uint cidx, uint sidx, double a)
+{
+    // the following method does all the necessary argument checking
+    _setCompCount(cidx, sidx, a * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_getCompConc(uint cidx, uint sidx) const
+{
+    // the following method does all the necessary argument checking
+    double count = _getCompCount(cidx, sidx);
+    double vol = statedef()->compdef(cidx)->vol();
+    return count / (1.0e3 * vol * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setCompConc(uint cidx, uint sidx, double c)
+{
+    assert(c >= 0.0);
+    assert(cidx < statedef()->countComps());
+    double vol = statedef()->compdef(cidx)->vol();
+    // the following method does all the necessary argument checking
+    _setCompCount(cidx, sidx, c * (1.0e3 * vol * smath::AVOGADRO));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool svox::Voxel::_getCompClamped(uint cidx, uint sidx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(sidx < statedef()->countSpecs());
+    return statedef()->compdef(cidx)->clamped(_compSpecIdx(cidx, sidx));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setCompClamped(uint cidx, uint sidx, bool b)
+{
+    assert(cidx < statedef()->countComps());
+    assert(sidx < statedef()->countSpecs());
+    statedef()->compdef(cidx)->setClamped(_compSpecIdx(cidx, sidx), b);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_getCompReacK(uint cidx, uint ridx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(ridx < statedef()->countReacs());
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint lridx = comp->reacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return comp->kcst(lridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setCompReacK(uint cidx, uint ridx, double kf)
+{
+    assert(cidx < statedef()->countComps());
+    assert(ridx < statedef()->countReacs());
+    assert(kf >= 0.0);
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint lridx = comp->reacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    comp->setKcst(lridx, kf);
+
+    // Rates have changed
+    _refillCcst();
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool svox::Voxel::_getCompReacActive(uint cidx, uint ridx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(ridx < statedef()->countReacs());
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint lridx = comp->reacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return comp->active(lridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setCompReacActive(uint cidx, uint ridx, bool a)
+{
+    assert(cidx < statedef()->countComps());
+    assert(ridx < statedef()->countReacs());
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint lridx = comp->reacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    comp->setActive(lridx, a);
+
+    // Rates have changed
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_getCompDiffD(uint cidx, uint didx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(didx < statedef()->countDiffs());
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint ldidx = comp->diffG2L(didx);
+    if (ldidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Diffusion rule undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return comp->dcst(ldidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setCompDiffD(uint cidx, uint didx, double dcst)
+{
+    assert(cidx < statedef()->countComps());
+    assert(didx < statedef()->countDiffs());
+    if (dcst < 0.0)
+    {
+        std::ostringstream os;
+        os << "Diffusion constant can't be negative";
+        throw steps::ArgErr(os.str());
+    }
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint ldidx = comp->diffG2L(didx);
+    if (ldidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Diffusion rule undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    comp->setDcst(ldidx, dcst);
+
+    // Rates have changed
+    _refillCcst();
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool svox::Voxel::_getCompDiffActive(uint cidx, uint didx) const
+{
+    assert(cidx < statedef()->countComps());
+    assert(didx < statedef()->countDiffs());
+    uint ldidx = statedef()->compdef(cidx)->diffG2L(didx);
+    if (ldidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Diffusion rule undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return pCompDiffActive[cidx][ldidx] != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setCompDiffActive(uint cidx, uint didx, bool act)
+{
+    assert(cidx < statedef()->countComps());
+    assert(didx < statedef()->countDiffs());
+    uint ldidx = statedef()->compdef(cidx)->diffG2L(didx);
+    if (ldidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Diffusion rule undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    pCompDiffActive[cidx][ldidx] = act ? 1 : 0;
+
+    // Rates have changed
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_getPatchArea(uint pidx) const
+{
+    assert(pidx < statedef()->countPatches());
+    return statedef()->patchdef(pidx)->area();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_getPatchCount(uint pidx, uint sidx) const
+{
+    assert(pidx < statedef()->countPatches());
+    assert(sidx < statedef()->countSpecs());
+    return statedef()->patchdef(pidx)->pools()[_patchSpecIdx(pidx, sidx)];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setPatchCount(uint pidx, uint sidx, double n)
+{
+    assert(pidx < statedef()->countPatches());
+    assert(sidx < statedef()->countSpecs());
+    uint slidx = _patchSpecIdx(pidx, sidx);
+    if (n > std::numeric_limits<unsigned int>::max())
+    {
+        std::ostringstream os;
+        os << "Can't set count greater than maximum unsigned integer (";
+        os << std::numeric_limits<unsigned int>::max() << ").\n";
+        throw steps::ArgErr(os.str());
+    }
+    assert(n >= 0.0);
+
+    // Spread the molecules uniformly over the faces.
+    std::vector<double> counts(pNFaces, 1.0);
+    _multinomial(n, counts);
+    double total = 0.0;
+    double * pools = &pPatchPools[pidx][slidx * pNFaces];
+    for (uint f = 0; f < pNFaces; ++f)
+    {
+        pools[f] = counts[f];
+        total += counts[f];
+    }
+    statedef()->patchdef(pidx)->setCount(slidx, total);
+
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_getPatchAmount(uint pidx, uint sidx) const
+{
+    // the following method does all the necessary argument checking
+    double count = _getPatchCount(pidx, sidx);
+    return (count / smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setPatchAmount(uint pidx, uint sidx, double a)
+{
+    // the following method does all the necessary argument checking
+    _setPatchCount(pidx, sidx, a * smath::AVOGADRO);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool svox::Voxel::_getPatchClamped(uint pidx, uint sidx) const
+{
+    assert(pidx < statedef()->countPatches());
+    assert(sidx < statedef()->countSpecs());
+    return statedef()->patchdef(pidx)->clamped(_patchSpecIdx(pidx, sidx));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setPatchClamped(uint pidx, uint sidx, bool buf)
+{
+    assert(pidx < statedef()->countPatches());
+    assert(sidx < statedef()->countSpecs());
+    statedef()->patchdef(pidx)->setClamped(_patchSpecIdx(pidx, sidx), buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double svox::Voxel::_getPatchSReacK(uint pidx, uint ridx) const
+{
+    assert(pidx < statedef()->countPatches());
+    assert(ridx < statedef()->countSReacs());
+    ssolver::Patchdef * patch = statedef()->patchdef(pidx);
+    uint lsridx = patch->sreacG2L(ridx);
+    if (lsridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Surface reaction undefined in patch.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return patch->kcst(lsridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setPatchSReacK(uint pidx, uint ridx, double kf)
+{
+    assert(pidx < statedef()->countPatches());
+    assert(ridx < statedef()->countSReacs());
+    assert(kf >= 0.0);
+    ssolver::Patchdef * patch = statedef()->patchdef(pidx);
+    uint lsridx = patch->sreacG2L(ridx);
+    if (lsridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Surface reaction undefined in patch.\n";
+        throw steps::ArgErr(os.str());
+    }
+    patch->setKcst(lsridx, kf);
+
+    // Rates have changed
+    _refillCcst();
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool svox::Voxel::_getPatchSReacActive(uint pidx, uint ridx) const
+{
+    assert(pidx < statedef()->countPatches());
+    assert(ridx < statedef()->countSReacs());
+    ssolver::Patchdef * patch = statedef()->patchdef(pidx);
+    uint lsridx = patch->sreacG2L(ridx);
+    if (lsridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Surface reaction undefined in patch.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return patch->active(lsridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void svox::Voxel::_setPatchSReacActive(uint pidx, uint ridx, bool a)
+{
+    assert(pidx < statedef()->countPatches());
+    assert(ridx < statedef()->countSReacs());
+    ssolver::Patchdef * patch = statedef()->patchdef(pidx);
+    uint lsridx = patch->sreacG2L(ridx);
+    if (lsridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Surface reaction undefined in patch.\n";
+        throw steps::ArgErr(os.str());
+    }
+    patch->setActive(lsridx, a);
+
+    // Rates have changed
+    _refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
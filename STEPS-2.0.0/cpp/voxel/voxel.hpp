@@ -0,0 +1,299 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPSis free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPSis distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_VOXEL_VOXEL_HPP
+#define STEPS_VOXEL_VOXEL_HPP 1
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../solver/api.hpp"
+#include "../solver/statedef.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(voxel)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Spatial SSA on a Cartesian grid of cubic voxels, for well-mixed
+/// geometries whose compartments are close enough to boxes.
+///
+/// Every compartment is an nx by ny by nz box of voxels of equal volume,
+/// its volume divided by the number of voxels, with edge length h the
+/// cube root of that. A species diffuses to each face neighbour of a
+/// voxel with rate D/h^2; the box walls reflect. Neighbours follow from
+/// the voxel index, there are no per-element tables, and the counts are
+/// stored species by species over all voxels, so that refreshing the
+/// propensities of a compartment is a set of unit stride loops.
+///
+/// A patch covers the walls of the box of its inner compartment, one
+/// face per voxel side on the boundary, its area shared equally between
+/// the faces. Surface reactions on a face act on the voxel behind it;
+/// they cannot involve the outer compartment, and there is no surface
+/// diffusion.
+///
+/// Events are selected by the direct method over a sum tree of the
+/// propensities of all voxels and faces.
+///
+class Voxel: public steps::solver::API
+{
+
+public:
+
+    Voxel(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+          uint nx, uint ny, uint nz);
+    ~Voxel(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER INFORMATION
+    ////////////////////////////////////////////////////////////////////////
+
+    std::string getSolverName(void) const;
+    std::string getSolverDesc(void) const;
+    std::string getSolverAuthors(void) const;
+    std::string getSolverEmail(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER CONTROLS
+    ////////////////////////////////////////////////////////////////////////
+
+    void checkpoint(std::string const & file_name);
+    void restore(std::string const & file_name);
+
+    void reset(void);
+    void run(double endtime);
+    void advance(double adv);
+    void step(void);
+
+    double getTime(void) const;
+
+    double getA0(void) const;
+
+    uint getNSteps(void) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // VOXELS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Return the number of voxels of each compartment, and of faces of
+    /// each patch. Voxel (i, j, k) has index i + nx * (j + ny * k).
+    ///
+    uint getNVoxels(void) const
+    { return pNVox; }
+
+    uint getNFaces(void) const
+    { return pNFaces; }
+
+    /// Return the edge length of the voxels of compartment c.
+    ///
+    double getVoxelSize(std::string const & c) const;
+
+    double getCompVoxelCount(std::string const & c, std::string const & s,
+                             uint vox) const;
+    void setCompVoxelCount(std::string const & c, std::string const & s,
+                           uint vox, double n);
+
+    double getPatchFaceCount(std::string const & p, std::string const & s,
+                             uint face) const;
+    void setPatchFaceCount(std::string const & p, std::string const & s,
+                           uint face, double n);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER METHODS: COMPARTMENT
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getCompVol(uint cidx) const;
+
+    double _getCompCount(uint cidx, uint sidx) const;
+    void _setCompCount(uint cidx, uint sidx, double n);
+
+    double _getCompAmount(uint cidx, uint sidx) const;
+    void _setCompAmount(uint cidx, uint sidx, double a);
+
+    double _getCompConc(uint cidx, uint sidx) const;
+    void _setCompConc(uint cidx, uint sidx, double c);
+
+    bool _getCompClamped(uint cidx, uint sidx) const;
+    void _setCompClamped(uint cidx, uint sidx, bool b);
+
+    double _getCompReacK(uint cidx, uint ridx) const;
+    void _setCompReacK(uint cidx, uint ridx, double kf);
+
+    bool _getCompReacActive(uint cidx, uint ridx) const;
+    void _setCompReacActive(uint cidx, uint ridx, bool a);
+
+    double _getCompDiffD(uint cidx, uint didx) const;
+    void _setCompDiffD(uint cidx, uint didx, double dcst);
+
+    bool _getCompDiffActive(uint cidx, uint didx) const;
+    void _setCompDiffActive(uint cidx, uint didx, bool act);
+
+    ////////////////////////////////////////////////////////////////////////
+    // SOLVER METHODS: PATCH
+    ////////////////////////////////////////////////////////////////////////
+
+    double _getPatchArea(uint pidx) const;
+
+    double _getPatchCount(uint pidx, uint sidx) const;
+    void _setPatchCount(uint pidx, uint sidx, double n);
+
+    double _getPatchAmount(uint pidx, uint sidx) const;
+    void _setPatchAmount(uint pidx, uint sidx, double a);
+
+    bool _getPatchClamped(uint pidx, uint sidx) const;
+    void _setPatchClamped(uint pidx, uint sidx, bool buf);
+
+    double _getPatchSReacK(uint pidx, uint ridx) const;
+    void _setPatchSReacK(uint pidx, uint ridx, double kf);
+
+    bool _getPatchSReacActive(uint pidx, uint ridx) const;
+    void _setPatchSReacActive(uint pidx, uint ridx, bool a);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+    // GRID
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Number the boundary faces and find the faces of each voxel.
+    ///
+    void _setupGrid(void);
+
+    /// Fill nb with the face neighbours of voxel v and return how many.
+    ///
+    uint _neighbours(uint v, uint * nb) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // PROPENSITIES
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Recompute the constants of the reactions and diffusion rules from
+    /// the rate constants in the state definition.
+    ///
+    void _refillCcst(void);
+
+    /// Recompute the propensities of every voxel of compartment c (or
+    /// face of patch p), without updating the tree.
+    ///
+    void _refreshComp(uint c);
+    void _refreshPatch(uint p);
+
+    /// Recompute all propensities and rebuild the tree.
+    ///
+    void _refresh(void);
+
+    double _voxelProp(uint c, uint v) const;
+    double _faceProp(uint p, uint f) const;
+
+    /// Set the propensity of a site and update the tree above it.
+    ///
+    void _setSite(uint site, double a);
+
+    /// Update voxel v of compartment c and the faces in front of it.
+    ///
+    void _updateVoxel(uint c, uint v);
+
+    ////////////////////////////////////////////////////////////////////////
+    // EVENTS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Fire the event x into the propensity of a voxel or face.
+    ///
+    void _fireVoxel(uint c, uint v, double x);
+    void _fireFace(uint p, uint f, double x);
+
+    /// Select a site and fire one of its events.
+    ///
+    void _executeStep(void);
+
+    /// Add d to species s (local) in voxel v of compartment c, or face f
+    /// of patch p, unless it is clamped.
+    ///
+    void _addComp(uint c, uint s, uint v, int d);
+    void _addPatch(uint p, uint s, uint f, int d);
+
+    ////////////////////////////////////////////////////////////////////////
+    // ARGUMENTS
+    ////////////////////////////////////////////////////////////////////////
+
+    uint _compSpecIdx(uint c, uint s) const;
+    uint _patchSpecIdx(uint p, uint s) const;
+
+    ////////////////////////////////////////////////////////////////////////
+
+    // Grid dimensions, number of voxels and of boundary faces.
+    uint                                pNX;
+    uint                                pNY;
+    uint                                pNZ;
+    uint                                pNVox;
+    uint                                pNFaces;
+
+    // Number of face neighbours of each voxel, and the voxel behind each
+    // boundary face, and the boundary faces of each voxel (pVoxFaces from
+    // pVoxFaceStart[v] to pVoxFaceStart[v + 1]).
+    std::vector<double>                 pNNeighb;
+    std::vector<uint>                   pFaceVox;
+    std::vector<uint>                   pVoxFaceStart;
+    std::vector<uint>                   pVoxFaces;
+
+    // Per compartment: counts [s * nvox + v], reaction constants per
+    // voxel, diffusion rates D/h^2 and active flags per rule, the local
+    // species of each rule, the first site, and the patches on it.
+    std::vector<std::vector<double> >   pCompPools;
+    std::vector<std::vector<double> >   pCompCcst;
+    std::vector<std::vector<double> >   pCompDRate;
+    std::vector<std::vector<uint> >     pCompDiffActive;
+    std::vector<std::vector<uint> >     pCompDiffSpec;
+    std::vector<uint>                   pCompSite;
+    std::vector<std::vector<uint> >     pCompPatches;
+
+    // Per patch: counts [s * nfaces + f], surface reaction constants per
+    // face, the inner compartment and the first site.
+    std::vector<std::vector<double> >   pPatchPools;
+    std::vector<std::vector<double> >   pPatchCcst;
+    std::vector<uint>                   pPatchComp;
+    std::vector<uint>                   pPatchSite;
+
+    // Sum tree over the sites, leaves from pNLeaves on.
+    uint                                pNLeaves;
+    std::vector<double>                 pTree;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(voxel)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_VOXEL_VOXEL_HPP
+
+// END
@@ -39,6 +39,8 @@
 // STEPS headers.
 #include "../common.h"
 #include "../solver/types.hpp"
+#include "../solver/compdef.hpp"
+#include "../solver/patchdef.hpp"
 #include "../solver/reacdef.hpp"
 #include "../solver/sreacdef.hpp"
 
@@ -61,6 +63,20 @@ typedef KProcPVec::const_iterator       KProcPVecCI;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// One term of the stoichiometry of a kproc, as used by the leaping
+/// modes: n molecules of species lidx of a compartment (cdef) or of a
+/// patch (pdef, cdef being 0).
+///
+struct LeapTerm
+{
+    steps::solver::Compdef            * cdef;
+    steps::solver::Patchdef           * pdef;
+    uint                                lidx;
+    int                                 n;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 class KProc
 
 {
@@ -122,6 +138,10 @@ public:
     ///
     virtual void reset(void) = 0;
 
+    /// Whether the process is active.
+    ///
+    virtual bool active(void) const = 0;
+
     // Recompute the Ccst for this KProc
     virtual void resetCcst(void) = 0;
 
@@ -143,6 +163,16 @@ public:
 
 	virtual uint updVecSize(void) const = 0;
 
+    /// Append the reactants of the kinetic process to lhs and the net
+    /// changes it makes to upd.
+    ///
+    virtual void leapStoich(std::vector<LeapTerm> & lhs,
+                            std::vector<LeapTerm> & upd) const = 0;
+
+    /// Apply n instances of the kinetic process at once, as a leap.
+    ///
+    virtual void applyN(uint n) = 0;
+
     ////////////////////////////////////////////////////////////////////////
 
     uint getExtent(void) const;
@@ -0,0 +1,382 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Standard library & STL headers.
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "kproc.hpp"
+#include "pdmsched.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::wmdirect, swmd);
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
+
+////////////////////////////////////////////////////////////////////////////////
+
+swmd::PDMScheduler::PDMScheduler(steps::rng::RNG * r)
+: Scheduler(r)
+, pCounts()
+, pKProcs()
+, pLhsStart()
+, pLhsSpec()
+, pUpdStart()
+, pUpdSpec()
+, pKind()
+, pGroup()
+, pPartner()
+, pC()
+, pPartial()
+, pGroupStart()
+, pMembers()
+, pDepStart()
+, pDeps()
+, pN()
+, pGroupSum()
+, pGroupRate()
+, pA0(0.0)
+, pDirty()
+, pNEvents(0)
+, pNTouched(0)
+, pNTouchedTotal(0.0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+swmd::PDMScheduler::~PDMScheduler(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::PDMScheduler::setup(std::vector<double const *> const & counts,
+                               std::vector<swmd::KProc *> const & kprocs,
+                               std::vector<uint> const & lhsstart,
+                               std::vector<uint> const & lhsspec,
+                               std::vector<uint> const & lhsn,
+                               std::vector<uint> const & updstart,
+                               std::vector<uint> const & updspec)
+{
+    pCounts = counts;
+    pKProcs = kprocs;
+    pLhsStart = lhsstart;
+    pLhsSpec = lhsspec;
+    pUpdStart = updstart;
+    pUpdSpec = updspec;
+
+    uint nspecs = counts.size();
+    uint nkprocs = kprocs.size();
+    uint other = nspecs;
+    pKind.assign(nkprocs, PDM_FULL);
+    pGroup.assign(nkprocs, other);
+    pPartner.assign(nkprocs, sssa::SCHED_IDX_UNDEFINED);
+
+    // Each kproc's kind and group, and the species its partial
+    // propensity reads.
+    std::vector<std::vector<uint> > deps(nspecs);
+    for (uint k = 0; k < nkprocs; ++k)
+    {
+        uint b = lhsstart[k];
+        uint e = lhsstart[k + 1];
+        if (e == b)
+        {
+            pKind[k] = PDM_CONST;
+        }
+        else if (e == b + 1 && lhsn[b] == 1)
+        {
+            pKind[k] = PDM_CONST;
+            pGroup[k] = lhsspec[b];
+        }
+        else if (e == b + 1 && lhsn[b] == 2)
+        {
+            pKind[k] = PDM_SELF;
+            pGroup[k] = lhsspec[b];
+            deps[lhsspec[b]].push_back(k);
+        }
+        else if (e == b + 2 && lhsn[b] == 1 && lhsn[b + 1] == 1)
+        {
+            pKind[k] = PDM_PARTNER;
+            pGroup[k] = std::min(lhsspec[b], lhsspec[b + 1]);
+            pPartner[k] = std::max(lhsspec[b], lhsspec[b + 1]);
+            deps[pPartner[k]].push_back(k);
+        }
+        else
+        {
+            for (uint l = b; l < e; ++l) deps[lhsspec[l]].push_back(k);
+        }
+    }
+
+    // Counting sort of the kprocs by group.
+    uint ngroups = nspecs + 1;
+    pGroupStart.assign(ngroups + 1, 0);
+    for (uint k = 0; k < nkprocs; ++k) ++pGroupStart[pGroup[k] + 1];
+    for (uint g = 0; g < ngroups; ++g) pGroupStart[g + 1] += pGroupStart[g];
+    std::vector<uint> next(pGroupStart.begin(), pGroupStart.end() - 1);
+    pMembers.resize(nkprocs);
+    for (uint k = 0; k < nkprocs; ++k) pMembers[next[pGroup[k]]++] = k;
+
+    pDepStart.assign(1, 0);
+    pDeps.clear();
+    for (uint s = 0; s < nspecs; ++s)
+    {
+        pDeps.insert(pDeps.end(), deps[s].begin(), deps[s].end());
+        pDepStart.push_back(pDeps.size());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string swmd::PDMScheduler::getName(void) const
+{
+    return "pdm";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::PDMScheduler::init(uint n)
+{
+    if (n != pKProcs.size())
+    {
+        std::ostringstream os;
+        os << "The partial-propensity scheduler was set up for ";
+        os << pKProcs.size() << " kprocs, not " << n << ".";
+        throw steps::ProgErr(os.str());
+    }
+
+    uint nspecs = pCounts.size();
+    pN.assign(nspecs, 0.0);
+    pC.assign(n, 0.0);
+    pPartial.assign(n, 0.0);
+    pGroupSum.assign(nspecs + 1, 0.0);
+    pGroupRate.assign(nspecs + 1, 0.0);
+    pA0 = 0.0;
+    pDirty.clear();
+    pNEvents = 0;
+    pNTouched = 0;
+    pNTouchedTotal = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::PDMScheduler::update(uint idx, double rate, double t)
+{
+    assert(idx < pKProcs.size());
+    pDirty.push_back(idx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::PDMScheduler::commit(double t)
+{
+    uint ndirty = pDirty.size();
+    pNTouched = 0;
+    for (uint i = 0; i < ndirty; ++i)
+    {
+        uint k = pDirty[i];
+        uint e = pLhsStart[k + 1];
+        for (uint l = pLhsStart[k]; l < e; ++l) _refresh(pLhsSpec[l]);
+        KProc * kp = pKProcs[k];
+        pC[k] = (kp->active() == true) ? kp->c() : 0.0;
+        _setPartial(k, _partial(k));
+    }
+    pDirty.clear();
+
+    // A full refresh (after a reset or a change through the API) is a
+    // good point to drop the rounding of the incremental sums.
+    if (ndirty >= pKProcs.size()) _resync();
+    pNTouchedTotal += pNTouched;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::PDMScheduler::applied(uint idx, double t)
+{
+    pNTouched = 0;
+    uint e = pUpdStart[idx + 1];
+    for (uint u = pUpdStart[idx]; u < e; ++u) _refresh(pUpdSpec[u]);
+    if (++pNEvents >= PDM_RESYNC_INTERVAL) _resync();
+    pNTouchedTotal += pNTouched;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmd::PDMScheduler::getNext(double t, double & dt)
+{
+    for (uint attempt = 0; attempt < 2; ++attempt)
+    {
+        if (pA0 <= 0.0) return sssa::SCHED_IDX_UNDEFINED;
+
+        // The species first, then the kprocs of the group.
+        double sel = rng()->getUnfIE() * pA0;
+        uint ngroups = pGroupRate.size();
+        uint g = 0;
+        for (; g < ngroups; ++g)
+        {
+            if (pGroupRate[g] <= 0.0) continue;
+            if (sel < pGroupRate[g]) break;
+            sel -= pGroupRate[g];
+        }
+        if (g == ngroups)
+        {
+            // Rounding left the selector above the last group.
+            for (g = ngroups; g > 0 && pGroupRate[g - 1] <= 0.0; --g) ;
+            if (g == 0) { _resync(); continue; }
+            --g;
+            sel = 0.0;
+        }
+
+        double n = (g < pN.size()) ? pN[g] : 1.0;
+        sel = std::min(sel / n, pGroupSum[g]);
+        uint e = pGroupStart[g + 1];
+        uint last = sssa::SCHED_IDX_UNDEFINED;
+        for (uint m = pGroupStart[g]; m < e; ++m)
+        {
+            double p = pPartial[pMembers[m]];
+            if (p <= 0.0) continue;
+            last = pMembers[m];
+            if (sel < p) break;
+            sel -= p;
+        }
+
+        // Only rounding in the sums can lead to a group without a
+        // kproc to fire; make them exact and try again.
+        if (last == sssa::SCHED_IDX_UNDEFINED)
+        {
+            _resync();
+            continue;
+        }
+        dt = rng()->getExp(pA0);
+        return last;
+    }
+    return sssa::SCHED_IDX_UNDEFINED;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t swmd::PDMScheduler::getMemoryUsage(void) const
+{
+    std::size_t bytes = sizeof(PDMScheduler);
+    bytes += sizeof(double const *) * pCounts.capacity();
+    bytes += sizeof(KProc *) * pKProcs.capacity();
+    bytes += sizeof(uint) * (pLhsStart.capacity() + pLhsSpec.capacity()
+                             + pUpdStart.capacity() + pUpdSpec.capacity()
+                             + pGroup.capacity() + pPartner.capacity()
+                             + pGroupStart.capacity() + pMembers.capacity()
+                             + pDepStart.capacity() + pDeps.capacity()
+                             + pDirty.capacity());
+    bytes += sizeof(double) * (pC.capacity() + pPartial.capacity()
+                               + pN.capacity() + pGroupSum.capacity()
+                               + pGroupRate.capacity());
+    bytes += pKind.capacity();
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmd::PDMScheduler::_partial(uint k) const
+{
+    switch (pKind[k])
+    {
+        case PDM_CONST:
+            return pC[k];
+        case PDM_PARTNER:
+            return pC[k] * pN[pPartner[k]];
+        case PDM_SELF:
+            return (pN[pGroup[k]] >= 1.0) ? pC[k] * (pN[pGroup[k]] - 1.0) : 0.0;
+        default:
+            return (pC[k] > 0.0) ? pKProcs[k]->rate() : 0.0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::PDMScheduler::_setPartial(uint k, double p)
+{
+    double old = pPartial[k];
+    if (p == old) return;
+    pPartial[k] = p;
+    uint g = pGroup[k];
+    pGroupSum[g] += p - old;
+    _setGroupRate(g);
+    ++pNTouched;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::PDMScheduler::_refresh(uint s)
+{
+    // Counts are whole numbers held in doubles; the kprocs truncate them.
+    double n = static_cast<double>(static_cast<uint>(*pCounts[s]));
+    if (n == pN[s]) return;
+    pN[s] = n;
+    _setGroupRate(s);
+    uint e = pDepStart[s + 1];
+    for (uint d = pDepStart[s]; d < e; ++d)
+    {
+        uint k = pDeps[d];
+        _setPartial(k, _partial(k));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::PDMScheduler::_setGroupRate(uint g)
+{
+    double n = (g < pN.size()) ? pN[g] : 1.0;
+    double rate = n * pGroupSum[g];
+    pA0 += rate - pGroupRate[g];
+    pGroupRate[g] = rate;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::PDMScheduler::_resync(void)
+{
+    pNEvents = 0;
+    pA0 = 0.0;
+    uint ngroups = pGroupSum.size();
+    for (uint g = 0; g < ngroups; ++g)
+    {
+        double sum = 0.0;
+        uint e = pGroupStart[g + 1];
+        for (uint m = pGroupStart[g]; m < e; ++m) sum += pPartial[pMembers[m]];
+        pGroupSum[g] = sum;
+        double n = (g < pN.size()) ? pN[g] : 1.0;
+        pGroupRate[g] = n * sum;
+        pA0 += pGroupRate[g];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,208 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STEPS_WMDIRECT_PDMSCHED_HPP
+#define STEPS_WMDIRECT_PDMSCHED_HPP 1
+
+
+// STL headers.
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../solver/ssa/scheduler.hpp"
+#include "kproc.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(wmdirect)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Number of events between exact resummations of the group sums and A0.
+#define PDM_RESYNC_INTERVAL         1000
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Partial-propensity direct method (Ramaswamy, Gonzalez-Segredo and
+/// Sbalzarini 2009) for Wmdirect.
+///
+/// Each kproc is filed under one of its reactants, its group, with a
+/// partial propensity that does not depend on that reactant's count:
+/// the rate constant for a first order kproc, the constant times the
+/// partner's count for A + B, and the constant times (n - 1) for 2 A.
+/// The propensity of a group is the count of its species times the sum
+/// of its partial propensities. Zeroth order kproc are in a group with
+/// a count of 1, as are those of higher order or with more than two
+/// reactant molecules, which keep their full propensity.
+///
+/// After an event only the species it changed are looked at: each one
+/// rescales its own group and updates the partial propensities in
+/// which it is the partner. The cost per event then grows with the
+/// number of species changed and their partner lists, not with the
+/// number of kprocs that read them, and the event is selected by a
+/// linear search over the species followed by one within the group.
+///
+/// The scheduler reads the counts itself; the solver calls applied()
+/// after each event instead of update() for its dependent kprocs.
+/// update() followed by commit() rereads the counts of the kproc's
+/// reactants and its rate constant and active flag.
+///
+class PDMScheduler: public steps::solver::ssa::Scheduler
+{
+
+public:
+
+    PDMScheduler(steps::rng::RNG * r);
+    ~PDMScheduler(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Give the structure of the system, before init(). counts[s] points
+    /// to the count of species s. Kproc k has the reactants
+    /// lhsspec[lhsstart[k]] to lhsspec[lhsstart[k + 1] - 1], with the
+    /// numbers of molecules in lhsn, and changes the species in updspec
+    /// from updstart[k] to updstart[k + 1] - 1.
+    ///
+    void setup(std::vector<double const *> const & counts,
+               std::vector<steps::wmdirect::KProc *> const & kprocs,
+               std::vector<uint> const & lhsstart,
+               std::vector<uint> const & lhsspec,
+               std::vector<uint> const & lhsn,
+               std::vector<uint> const & updstart,
+               std::vector<uint> const & updspec);
+
+    /// Take kproc idx having fired at time t into account.
+    ///
+    void applied(uint idx, double t);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    std::string getName(void) const;
+
+    void init(uint n);
+    void update(uint idx, double rate, double t);
+    void commit(double t);
+
+    inline double getA0(void) const
+    { return pA0; }
+
+    uint getNext(double t, double & dt);
+
+    std::size_t getMemoryUsage(void) const;
+
+    /// Partial propensities and group sums recomputed.
+    ///
+    uint getNNodesTouched(void) const
+    { return pNTouched; }
+
+    double getNNodesTouchedTotal(void) const
+    { return pNTouchedTotal; }
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    // How a kproc's partial propensity is computed.
+    enum
+    {
+        PDM_CONST,      // c
+        PDM_PARTNER,    // c n_partner
+        PDM_SELF,       // c (n_group - 1)
+        PDM_FULL        // the kproc's rate
+    };
+
+    // Compute the partial propensity of kproc k from the stored counts.
+    double _partial(uint k) const;
+
+    // Set the partial propensity of kproc k to p, updating the sums.
+    void _setPartial(uint k, double p);
+
+    // Reread the count of species s and propagate a change.
+    void _refresh(uint s);
+
+    // Set the propensity of group g from its count and sum.
+    void _setGroupRate(uint g);
+
+    // Recompute all sums exactly.
+    void _resync(void);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    std::vector<double const *>                 pCounts;
+    std::vector<steps::wmdirect::KProc *>       pKProcs;
+    std::vector<uint>                           pLhsStart;
+    std::vector<uint>                           pLhsSpec;
+    std::vector<uint>                           pUpdStart;
+    std::vector<uint>                           pUpdSpec;
+
+    // Per kproc: its kind, group, partner species (for PDM_PARTNER),
+    // rate constant (0 while inactive), partial propensity and position
+    // in pMembers.
+    std::vector<char>                           pKind;
+    std::vector<uint>                           pGroup;
+    std::vector<uint>                           pPartner;
+    std::vector<double>                         pC;
+    std::vector<double>                         pPartial;
+
+    // The kprocs by group: group g has pMembers[pGroupStart[g]] to
+    // pMembers[pGroupStart[g + 1] - 1]. Groups 0 to nspecs - 1 are the
+    // species; the last group has a count of 1.
+    std::vector<uint>                           pGroupStart;
+    std::vector<uint>                           pMembers;
+
+    // Per species s, the kprocs whose partial propensity depends on its
+    // count: pDeps[pDepStart[s]] to pDeps[pDepStart[s + 1] - 1].
+    std::vector<uint>                           pDepStart;
+    std::vector<uint>                           pDeps;
+
+    // Per species, the count as last read; per group, the sum of its
+    // partial propensities and its propensity.
+    std::vector<double>                         pN;
+    std::vector<double>                         pGroupSum;
+    std::vector<double>                         pGroupRate;
+    double                                      pA0;
+
+    // The kprocs passed to update() since the last commit().
+    std::vector<uint>                           pDirty;
+
+    uint                                        pNEvents;
+    uint                                        pNTouched;
+    double                                      pNTouchedTotal;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(wmdirect)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_WMDIRECT_PDMSCHED_HPP
+
+// END
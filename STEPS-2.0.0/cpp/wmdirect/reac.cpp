@@ -194,20 +194,27 @@ bool swmd::Reac::depSpecPatch(uint gidx, swmd::Patch * patch)
 double swmd::Reac::rate(void) const
 {
 	if (inactive()) return 0.0;
+	return propensity();
+}
+
+////////////////////////////////////////////////////////////////////////////////
 
+double swmd::Reac::propensity(void) const
+{
     // Prefetch some variables.
     ssolver::Compdef * cdef = pComp->def();
-    uint nspecs = cdef->countSpecs();
-    uint * lhs_vec = cdef->reac_lhs_bgn(cdef->reacG2L(defr()->gidx()));
+    uint lridx = cdef->reacG2L(defr()->gidx());
+    uint * lhs_vec = cdef->reac_lhsorder_bgn(lridx);
+    uint * pool_end = cdef->reac_lhsspec_end(lridx);
     double * cnt_vec = cdef->pools();
 
-    // Compute combinatorial part.
+    // Compute combinatorial part over the reactants only.
         double h_mu = 1.0;
-        for (uint pool = 0; pool < nspecs; ++pool)
+        for (uint * pool = cdef->reac_lhsspec_bgn(lridx); pool != pool_end;
+             ++pool, ++lhs_vec)
         {
-            uint lhs = lhs_vec[pool];
-            if (lhs == 0) continue;
-            uint cnt = static_cast<uint>(cnt_vec[pool]);
+            uint lhs = *lhs_vec;
+            uint cnt = static_cast<uint>(cnt_vec[*pool]);
             if (lhs > cnt)
             {
                 h_mu = 0.0;
@@ -252,14 +259,13 @@ std::vector<uint> const & swmd::Reac::apply(void)
     ssolver::Compdef * cdef = pComp->def();
     double * local = cdef->pools();
     uint l_ridx = cdef->reacG2L(defr()->gidx());
-    int * upd_vec = cdef->reac_upd_bgn(l_ridx);
-    uint nspecs = cdef->countSpecs();
-    for (uint i=0; i < nspecs; ++i)
+    int * delta = cdef->reac_upddelta_bgn(l_ridx);
+    uint * s_end = cdef->reac_updspec_end(l_ridx);
+    for (uint * s = cdef->reac_updspec_bgn(l_ridx); s != s_end; ++s, ++delta)
     {
+    	uint i = *s;
     	if (cdef->clamped(i) == true) continue;
-    	int j = upd_vec[i];
-    	if (j == 0) continue;
-    	int nc = static_cast<int>(local[i]) + j;
+    	int nc = static_cast<int>(local[i]) + *delta;
     	cdef->setCount(i, static_cast<double>(nc));
     }
     rExtent++;
@@ -268,5 +274,50 @@ std::vector<uint> const & swmd::Reac::apply(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void swmd::Reac::leapStoich(std::vector<swmd::LeapTerm> & lhs,
+                            std::vector<swmd::LeapTerm> & upd) const
+{
+    ssolver::Compdef * cdef = pComp->def();
+    uint l_ridx = cdef->reacG2L(defr()->gidx());
+    uint * lhs_vec = cdef->reac_lhs_bgn(l_ridx);
+    int * upd_vec = cdef->reac_upd_bgn(l_ridx);
+    uint nspecs = cdef->countSpecs();
+    for (uint i = 0; i < nspecs; ++i)
+    {
+        if (lhs_vec[i] != 0)
+        {
+            LeapTerm t = {cdef, 0, i, static_cast<int>(lhs_vec[i])};
+            lhs.push_back(t);
+        }
+        if (upd_vec[i] != 0)
+        {
+            LeapTerm t = {cdef, 0, i, upd_vec[i]};
+            upd.push_back(t);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::Reac::applyN(uint n)
+{
+    ssolver::Compdef * cdef = pComp->def();
+    double * local = cdef->pools();
+    uint l_ridx = cdef->reacG2L(defr()->gidx());
+    int * delta = cdef->reac_upddelta_bgn(l_ridx);
+    uint * s_end = cdef->reac_updspec_end(l_ridx);
+    for (uint * s = cdef->reac_updspec_bgn(l_ridx); s != s_end; ++s, ++delta)
+    {
+    	uint i = *s;
+    	if (cdef->clamped(i) == true) continue;
+    	double nc = local[i] + static_cast<double>(*delta) * n;
+    	assert(nc >= 0.0);
+    	cdef->setCount(i, nc);
+    }
+    rExtent += n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
 
@@ -97,7 +97,11 @@ public:
     bool depSpecPatch(uint gidx, Patch * patch);
     void reset(void);
     double rate(void) const;
+    /// The rate as if the process were active.
+    double propensity(void) const;
     std::vector<uint> const & apply(void);
+    void leapStoich(std::vector<LeapTerm> & lhs, std::vector<LeapTerm> & upd) const;
+    void applyN(uint n);
 
 	uint updVecSize(void) const
     { return pUpdVec.size(); }
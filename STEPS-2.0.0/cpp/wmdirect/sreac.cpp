@@ -323,7 +323,13 @@ void swmd::SReac::resetCcst(void)
 double swmd::SReac::rate(void) const
 {
     if (inactive()) return 0.0;
+    return propensity();
+}
+
+////////////////////////////////////////////////////////////////////////////////
 
+double swmd::SReac::propensity(void) const
+{
     // First we compute the combinatorial part.
     //   1/ for the surface part of the stoichiometry
     //   2/ for the inner or outer volume part of the stoichiometry, pool
@@ -335,14 +341,13 @@ double swmd::SReac::rate(void) const
 
     double h_mu = 1.0;
 
-    uint * lhs_s_vec = pdef->sreac_lhs_S_bgn(lidx);
+    uint * lhs_s_vec = pdef->sreac_lhsorder_S_bgn(lidx);
     double * cnt_s_vec = pdef->pools();
-    uint nspecs_s = pdef->countSpecs();
-    for (uint s = 0; s < nspecs_s; ++s)
+    uint * s_s_end = pdef->sreac_lhsspec_S_end(lidx);
+    for (uint * s = pdef->sreac_lhsspec_S_bgn(lidx); s != s_s_end; ++s, ++lhs_s_vec)
     {
-        uint lhs = lhs_s_vec[s];
-        if (lhs == 0) continue;
-        uint cnt = static_cast<uint>(cnt_s_vec[s]);
+        uint lhs = *lhs_s_vec;
+        uint cnt = static_cast<uint>(cnt_s_vec[*s]);
         if (lhs > cnt)
         {
             return 0.0;
@@ -376,14 +381,13 @@ double swmd::SReac::rate(void) const
 
     if (defsr()->inside())
     {
-        uint * lhs_i_vec = pdef->sreac_lhs_I_bgn(lidx);
+        uint * lhs_i_vec = pdef->sreac_lhsorder_I_bgn(lidx);
         double * cnt_i_vec = pPatch->iComp()->def()->pools();
-        uint nspecs_i = pdef->countSpecs_I();
-        for (uint s = 0; s < nspecs_i; ++s)
+        uint * s_i_end = pdef->sreac_lhsspec_I_end(lidx);
+        for (uint * s = pdef->sreac_lhsspec_I_bgn(lidx); s != s_i_end; ++s, ++lhs_i_vec)
         {
-            uint lhs = lhs_i_vec[s];
-            if (lhs == 0) continue;
-            uint cnt = static_cast<double>(cnt_i_vec[s]);
+            uint lhs = *lhs_i_vec;
+            uint cnt = static_cast<double>(cnt_i_vec[*s]);
             if (lhs > cnt)
             {
                 return 0.0;
@@ -417,14 +421,13 @@ double swmd::SReac::rate(void) const
     }
     else if (defsr()->outside())
     {
-        uint * lhs_o_vec = pdef->sreac_lhs_O_bgn(lidx);
+        uint * lhs_o_vec = pdef->sreac_lhsorder_O_bgn(lidx);
         double * cnt_o_vec = pPatch->oComp()->def()->pools();
-        uint nspecs_o = pdef->countSpecs_O();
-        for (uint s = 0; s < nspecs_o; ++s)
+        uint * s_o_end = pdef->sreac_lhsspec_O_end(lidx);
+        for (uint * s = pdef->sreac_lhsspec_O_bgn(lidx); s != s_o_end; ++s, ++lhs_o_vec)
         {
-            uint lhs = lhs_o_vec[s];
-            if (lhs == 0) continue;
-            uint cnt = static_cast<double>(cnt_o_vec[s]);
+            uint lhs = *lhs_o_vec;
+            uint cnt = static_cast<double>(cnt_o_vec[*s]);
             if (lhs > cnt)
             {
                 return 0.0;
@@ -468,15 +471,14 @@ std::vector<uint> const & swmd::SReac::apply(void)
     uint lidx = pdef->sreacG2L(defsr()->gidx());
 
     // Update patch pools.
-    int * upd_s_vec = pdef->sreac_upd_S_bgn(lidx);
+    int * s_delta = pdef->sreac_upddelta_S_bgn(lidx);
     double * cnt_s_vec = pdef->pools();
-    uint nspecs_s = pdef->countSpecs();
-
-    for (uint s = 0; s < nspecs_s; ++s)
+    uint * s_end = pdef->sreac_updspec_S_end(lidx);
+    for (uint * sp = pdef->sreac_updspec_S_bgn(lidx); sp != s_end; ++sp, ++s_delta)
     {
+        uint s = *sp;
         if (pdef->clamped(s) == true) continue;
-        int upd = upd_s_vec[s];
-        if (upd == 0) continue;
+        int upd = *s_delta;
         int nc = static_cast<int>(cnt_s_vec[s]) + upd;
         assert(nc >= 0);
         pdef->setCount(s, static_cast<double>(nc));
@@ -486,14 +488,14 @@ std::vector<uint> const & swmd::SReac::apply(void)
     Comp * icomp = pPatch->iComp();
     if (icomp != 0)
     {
-        int * upd_i_vec = pdef->sreac_upd_I_bgn(lidx);
+        int * i_delta = pdef->sreac_upddelta_I_bgn(lidx);
         double * cnt_i_vec = icomp->def()->pools();
-        uint nspecs_i = pdef->countSpecs_I();
-        for (uint s = 0; s < nspecs_i; ++s)
+        uint * i_end = pdef->sreac_updspec_I_end(lidx);
+        for (uint * sp = pdef->sreac_updspec_I_bgn(lidx); sp != i_end; ++sp, ++i_delta)
         {
+            uint s = *sp;
             if (icomp->def()->clamped(s) == true) continue;
-            int upd = upd_i_vec[s];
-            if (upd == 0) continue;
+            int upd = *i_delta;
             int nc = static_cast<int>(cnt_i_vec[s]) + upd;
             assert(nc >= 0);
             icomp->def()->setCount(s, static_cast<double>(nc));
@@ -504,14 +506,14 @@ std::vector<uint> const & swmd::SReac::apply(void)
     Comp * ocomp = pPatch->oComp();
     if (ocomp != 0)
     {
-        int * upd_o_vec = pdef->sreac_upd_O_bgn(lidx);
+        int * o_delta = pdef->sreac_upddelta_O_bgn(lidx);
         double * cnt_o_vec = ocomp->def()->pools();
-        uint nspecs_o = pdef->countSpecs_O();
-        for (uint s = 0; s < nspecs_o; ++s)
+        uint * o_end = pdef->sreac_updspec_O_end(lidx);
+        for (uint * sp = pdef->sreac_updspec_O_bgn(lidx); sp != o_end; ++sp, ++o_delta)
         {
+            uint s = *sp;
             if (ocomp->def()->clamped(s) == true) continue;
-            int upd = upd_o_vec[s];
-            if (upd == 0) continue;
+            int upd = *o_delta;
             int nc = static_cast<int>(cnt_o_vec[s]) + upd;
             assert(nc >= 0);
             ocomp->def()->setCount(s, static_cast<double>(nc));
@@ -524,5 +526,130 @@ std::vector<uint> const & swmd::SReac::apply(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void swmd::SReac::leapStoich(std::vector<swmd::LeapTerm> & lhs,
+                             std::vector<swmd::LeapTerm> & upd) const
+{
+    ssolver::Patchdef * pdef = pPatch->def();
+    uint lidx = pdef->sreacG2L(defsr()->gidx());
+
+    uint * lhs_s_vec = pdef->sreac_lhs_S_bgn(lidx);
+    int * upd_s_vec = pdef->sreac_upd_S_bgn(lidx);
+    uint nspecs_s = pdef->countSpecs();
+    for (uint s = 0; s < nspecs_s; ++s)
+    {
+        if (lhs_s_vec[s] != 0)
+        {
+            LeapTerm t = {0, pdef, s, static_cast<int>(lhs_s_vec[s])};
+            lhs.push_back(t);
+        }
+        if (upd_s_vec[s] != 0)
+        {
+            LeapTerm t = {0, pdef, s, upd_s_vec[s]};
+            upd.push_back(t);
+        }
+    }
+
+    Comp * icomp = pPatch->iComp();
+    if (icomp != 0)
+    {
+        ssolver::Compdef * cdef = icomp->def();
+        uint * lhs_i_vec = pdef->sreac_lhs_I_bgn(lidx);
+        int * upd_i_vec = pdef->sreac_upd_I_bgn(lidx);
+        uint nspecs_i = pdef->countSpecs_I();
+        for (uint s = 0; s < nspecs_i; ++s)
+        {
+            if (defsr()->inside() && lhs_i_vec[s] != 0)
+            {
+                LeapTerm t = {cdef, 0, s, static_cast<int>(lhs_i_vec[s])};
+                lhs.push_back(t);
+            }
+            if (upd_i_vec[s] != 0)
+            {
+                LeapTerm t = {cdef, 0, s, upd_i_vec[s]};
+                upd.push_back(t);
+            }
+        }
+    }
+
+    Comp * ocomp = pPatch->oComp();
+    if (ocomp != 0)
+    {
+        ssolver::Compdef * cdef = ocomp->def();
+        uint * lhs_o_vec = pdef->sreac_lhs_O_bgn(lidx);
+        int * upd_o_vec = pdef->sreac_upd_O_bgn(lidx);
+        uint nspecs_o = pdef->countSpecs_O();
+        for (uint s = 0; s < nspecs_o; ++s)
+        {
+            if (defsr()->outside() && lhs_o_vec[s] != 0)
+            {
+                LeapTerm t = {cdef, 0, s, static_cast<int>(lhs_o_vec[s])};
+                lhs.push_back(t);
+            }
+            if (upd_o_vec[s] != 0)
+            {
+                LeapTerm t = {cdef, 0, s, upd_o_vec[s]};
+                upd.push_back(t);
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::SReac::applyN(uint n)
+{
+    ssolver::Patchdef * pdef = pPatch->def();
+    uint lidx = pdef->sreacG2L(defsr()->gidx());
+    double dn = static_cast<double>(n);
+
+    int * s_delta = pdef->sreac_upddelta_S_bgn(lidx);
+    double * cnt_s_vec = pdef->pools();
+    uint * s_end = pdef->sreac_updspec_S_end(lidx);
+    for (uint * sp = pdef->sreac_updspec_S_bgn(lidx); sp != s_end; ++sp, ++s_delta)
+    {
+        uint s = *sp;
+        if (pdef->clamped(s) == true) continue;
+        double nc = cnt_s_vec[s] + *s_delta * dn;
+        assert(nc >= 0.0);
+        pdef->setCount(s, nc);
+    }
+
+    Comp * icomp = pPatch->iComp();
+    if (icomp != 0)
+    {
+        int * i_delta = pdef->sreac_upddelta_I_bgn(lidx);
+        double * cnt_i_vec = icomp->def()->pools();
+        uint * i_end = pdef->sreac_updspec_I_end(lidx);
+        for (uint * sp = pdef->sreac_updspec_I_bgn(lidx); sp != i_end; ++sp, ++i_delta)
+        {
+            uint s = *sp;
+            if (icomp->def()->clamped(s) == true) continue;
+            double nc = cnt_i_vec[s] + *i_delta * dn;
+            assert(nc >= 0.0);
+            icomp->def()->setCount(s, nc);
+        }
+    }
+
+    Comp * ocomp = pPatch->oComp();
+    if (ocomp != 0)
+    {
+        int * o_delta = pdef->sreac_upddelta_O_bgn(lidx);
+        double * cnt_o_vec = ocomp->def()->pools();
+        uint * o_end = pdef->sreac_updspec_O_end(lidx);
+        for (uint * sp = pdef->sreac_updspec_O_bgn(lidx); sp != o_end; ++sp, ++o_delta)
+        {
+            uint s = *sp;
+            if (ocomp->def()->clamped(s) == true) continue;
+            double nc = cnt_o_vec[s] + *o_delta * dn;
+            assert(nc >= 0.0);
+            ocomp->def()->setCount(s, nc);
+        }
+    }
+
+    rExtent += n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // END
 
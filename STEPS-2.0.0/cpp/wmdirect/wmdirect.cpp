@@ -54,33 +54,18 @@
 #include "../solver/reacdef.hpp"
 #include "../solver/sreacdef.hpp"
 #include "../solver/types.hpp"
-
-////////////////////////////////////////////////////////////////////////////////
-
-#define SCHEDULEWIDTH 32
-#define MAXLEVELS 10
+#include "../solver/ssa/scheduler.hpp"
+#include "pdmsched.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
 NAMESPACE_ALIAS(steps::wmdirect, swmd);
 NAMESPACE_ALIAS(steps::solver, ssolver);
+NAMESPACE_ALIAS(steps::solver::ssa, sssa);
 NAMESPACE_ALIAS(steps::math, smath);
 
 ////////////////////////////////////////////////////////////////////////////////
 
-/// Unary function that calls the array delete[] operator on pointers. Easy
-/// to use with STL/Boost (see steps::tools::DeletePointer).
-///
-struct DeleteArray
-{
-    template <typename Type> void operator() (Type * pointer) const
-    {
-        delete[] pointer;
-    }
-};
-
-////////////////////////////////////////////////////////////////////////////////
-
 void swmd::schedIDXSet_To_Vec(swmd::SchedIDXSet const & s, swmd::SchedIDXVec & v)
 {
     v.resize(s.size());
@@ -89,19 +74,39 @@ void swmd::schedIDXSet_To_Vec(swmd::SchedIDXSet const & s, swmd::SchedIDXVec & v
 
 ////////////////////////////////////////////////////////////////////////////////
 
-swmd::Wmdirect::Wmdirect(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r)
+swmd::Wmdirect::Wmdirect(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+                         std::string const & scheduler)
 : API(m, g, r)
 , pKProcs()
 , pComps()
 , pCompMap()
 , pPatches()
-, pA0(0.0)
-, pLevelSizes()
-, pLevels()
+, pScheduler(0)
+, pPDM(0)
 , pBuilt(false)
-, pIndices(0)
-, pMaxUpSize(0)
-, pRannum(0)
+, pAutoUpdate(true)
+, pTauLeap(false)
+, pRLeap(false)
+, pLeapEps(WMDIRECT_LEAP_EPSILON)
+, pLeapNCrit(WMDIRECT_LEAP_NCRIT)
+, pLeapCdef()
+, pLeapPdef()
+, pLeapLidx()
+, pLeapHOR()
+, pLeapHORn()
+, pLeapLhsStart()
+, pLeapLhsSpec()
+, pLeapLhsN()
+, pLeapUpdStart()
+, pLeapUpdSpec()
+, pLeapUpdN()
+, pLeapRate()
+, pLeapCrit()
+, pLeapK()
+, pLeapMu()
+, pLeapSigma()
+, pLeapReactant()
+, pLeapDelta()
 {
 	assert (model() != 0);
 	assert (geom() != 0);
@@ -113,6 +118,16 @@ swmd::Wmdirect::Wmdirect(steps::model::Model * m, steps::wm::Geom * g, steps::rn
         throw steps::ArgErr(os.str());
     }
 
+    if (scheduler == "pdm")
+    {
+        pPDM = new PDMScheduler(rng());
+        pScheduler = pPDM;
+    }
+    else if (scheduler != "auto")
+    {
+        pScheduler = sssa::createScheduler(scheduler, rng());
+    }
+
 	ssolver::CompDefPVecCI c_end = statedef()->endComp();
     for (ssolver::CompDefPVecCI c = statedef()->bgnComp(); c != c_end; ++c)
     {
@@ -143,9 +158,7 @@ swmd::Wmdirect::~Wmdirect(void)
     PatchPVecCI patch_e = pPatches.end();
     for (PatchPVecCI p = pPatches.begin(); p != patch_e; ++p) delete *p;
 
-    std::for_each(pLevels.begin(), pLevels.end(), DeleteArray());
-	delete[] pIndices;
-    delete[] pRannum;
+    delete pScheduler;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -313,15 +326,19 @@ void swmd::Wmdirect::run(double endtime)
 		os << "Endtime is before current simulation time";
 	    throw steps::ArgErr(os.str());
 	}
+	if (pTauLeap == true || pRLeap == true)
+	{
+		_runLeap(endtime);
+		statedef()->setTime(endtime);
+		return;
+	}
 	while (statedef()->time() < endtime)
 	{
-		swmd::KProc * kp = _getNext();
-		if (kp == 0) break;
-		double a0 = getA0();
-		if (a0 == 0.0) break;
-		double dt = rng()->getExp(a0);
+		double dt = 0.0;
+		uint kidx = pScheduler->getNext(statedef()->time(), dt);
+		if (kidx == sssa::SCHED_IDX_UNDEFINED) break;
 		if ((statedef()->time() + dt) > endtime) break;
-		_executeStep(kp, dt);
+		_executeStep(pKProcs[kidx], dt);
 	}
 	statedef()->setTime(endtime);
 }
@@ -345,12 +362,10 @@ void swmd::Wmdirect::advance(double adv)
 
 void swmd::Wmdirect::step(void)
 {
-	swmd::KProc * kp = _getNext();
-	if (kp == 0) return;
-	double a0 = getA0();
-	if (a0 == 0.0) return;
-	double dt = rng()->getExp(a0);
-	_executeStep(kp, dt);
+	double dt = 0.0;
+	uint kidx = pScheduler->getNext(statedef()->time(), dt);
+	if (kidx == sssa::SCHED_IDX_UNDEFINED) return;
+	_executeStep(pKProcs[kidx], dt);
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -362,6 +377,91 @@ double swmd::Wmdirect::getTime(void) const
 
 ////////////////////////////////////////////////////////////////////////
 
+std::string swmd::Wmdirect::getScheduler(void) const
+{
+	return pScheduler->getName();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void swmd::Wmdirect::setTauLeaping(bool leap)
+{
+	pTauLeap = leap;
+	if (leap == true) pRLeap = false;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool swmd::Wmdirect::getTauLeaping(void) const
+{
+	return pTauLeap;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void swmd::Wmdirect::setRLeaping(bool leap)
+{
+	pRLeap = leap;
+	if (leap == true) pTauLeap = false;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+bool swmd::Wmdirect::getRLeaping(void) const
+{
+	return pRLeap;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void swmd::Wmdirect::setTauLeapEpsilon(double eps)
+{
+	if (eps <= 0.0 || eps >= 1.0)
+	{
+		std::ostringstream os;
+		os << "Tau-leap epsilon must lie in (0, 1).";
+		throw steps::ArgErr(os.str());
+	}
+	pLeapEps = eps;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double swmd::Wmdirect::getTauLeapEpsilon(void) const
+{
+	return pLeapEps;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void swmd::Wmdirect::setTauLeapNCrit(uint ncrit)
+{
+	pLeapNCrit = ncrit;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint swmd::Wmdirect::getTauLeapNCrit(void) const
+{
+	return pLeapNCrit;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+uint swmd::Wmdirect::getSchedNodesTouched(void) const
+{
+	return pScheduler->getNNodesTouched();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+double swmd::Wmdirect::getSchedNodesTouchedTotal(void) const
+{
+	return pScheduler->getNNodesTouchedTotal();
+}
+
+////////////////////////////////////////////////////////////////////////
+
 uint swmd::Wmdirect::getNSteps(void) const
 {
     return statedef()->nsteps();
@@ -1157,261 +1257,97 @@ void swmd::Wmdirect::_build(void)
 {
 	assert (pBuilt == false);
 
-    // Setup level.
-    uint clsize = pKProcs.size();
-    if (clsize == 0) return;
-
-    // Work up.
-    uint clevel = 0;
-    do
-    {
-        // Make sure the new size is a multiple of SCHEDULEWIDTH.
-        uint extra = clsize % SCHEDULEWIDTH;
-        if (extra != 0) clsize += SCHEDULEWIDTH - extra;
-
-        // Create the level and add it.
-        double * level = new double[clsize];
-        std::fill_n(level, clsize, 0.0);
-        pLevelSizes.push_back(clsize);
-        pLevels.push_back(level);
-
-        // Prepare for next level.
-        clevel++;
-        clsize = clsize / SCHEDULEWIDTH;
-    }
-    while (clsize > 1);
-
-    // Set top level.
-    pA0 = 0.0;
-
-	// Time to create ONE indices table to hold the run's present reaction of
-    // choice's update vector. This will be re-used and replace old-version's
-    // hard-coded table in _update. Size is the maximum possible, found by looping
-    // over all KProcs. This little bit of computational time is well worth all
-    // that needless memory allocation
-	uint maxupvecsize = 0;
-	KProcPVecCI kproc_end = pKProcs.end();
-	for (KProcPVecCI kproc = pKProcs.begin(); kproc != kproc_end; ++kproc)
+	if (pPDM != 0)
 	{
-		if ((*kproc)->updVecSize() > maxupvecsize) maxupvecsize = (*kproc)->updVecSize();
+		// The partial-propensity scheduler works on the flat species
+		// tables of the leap methods.
+		_leapSetup();
+		uint nspecs = pLeapLidx.size();
+		std::vector<double const *> counts(nspecs);
+		for (uint s = 0; s < nspecs; ++s)
+		{
+			counts[s] = (pLeapCdef[s] != 0) ? &pLeapCdef[s]->pools()[pLeapLidx[s]]
+			                                : &pLeapPdef[s]->pools()[pLeapLidx[s]];
+		}
+		pPDM->setup(counts, pKProcs, pLeapLhsStart, pLeapLhsSpec, pLeapLhsN,
+		            pLeapUpdStart, pLeapUpdSpec);
 	}
 
-	pMaxUpSize = maxupvecsize;
-	pIndices = new uint[pMaxUpSize];
-
-    // Also let's create a random number holder-table,
-    // size of number of KProcs % SCHEDULEWIDTH or pLevels.size()
-    // This will be re-used in _getNext as opposed to hard-coded (again maximum
-    // limit).
-    uint lsize = pLevels.size();
-    pRannum = new double[lsize];
-
+	if (pScheduler == 0)
+	{
+		bool small = (pKProcs.size() < WMDIRECT_SDM_MAX_KPROCS);
+		pScheduler = sssa::createScheduler(small ? "sdm" : "direct", rng());
+	}
+	pScheduler->init(pKProcs.size());
 
     pBuilt = true;
 }
 
 ////////////////////////////////////////////////////////////////////////
 
-swmd::KProc * swmd::Wmdirect::_getNext(void) const
+void swmd::Wmdirect::_setAutoUpdate(bool b)
 {
-    assert(pA0 >= 0.0);
-    // Quick check to see whether nothing is there.
-    if (pA0 == 0.0) return 0;
-
-    // Start at top level.
-    uint clevel = pLevels.size();
-    // And start at the first node of that level.
-    uint cur_node = 0;
+    pAutoUpdate = b;
+    if (b) _reset();
+}
 
-    // Prepare random numbers.
-    for (uint i = 0; i < clevel; ++i)
-    {
-        pRannum[i] = rng()->getUnfIE();
-    }
+////////////////////////////////////////////////////////////////////////
 
-    // Run until top level.
-    double a0 = pA0;
-    double * level = 0;
-    while (clevel != 0)
+double swmd::Wmdirect::_getCompReacPropensity(uint cidx, uint ridx) const
+{
+    assert(cidx < statedef()->countComps());
+    ssolver::Compdef * comp = statedef()->compdef(cidx);
+    uint lridx = comp->reacG2L(ridx);
+    if (lridx == ssolver::LIDX_UNDEFINED)
     {
-        // Decrease the current level.
-        clevel--;
-        // and start looking in the right place.
-        cur_node *= SCHEDULEWIDTH;
-        uint max_node = cur_node + SCHEDULEWIDTH;
-
-        // Fetch the level.
-        level = pLevels[clevel];
-
-        // Compute local selector.
-        double selector = pRannum[clevel] * a0;
-
-        // Compare.
-        double accum = 0.0;
-        // 27/10/09 I.H. 'old' removed from for loop because not used.
-        // double old = 0.0;
-        double curval = 0.0;
-        for (uint i = 0; i < SCHEDULEWIDTH; ++i)
-        {
-            curval = level[cur_node];
-            if (selector < curval + accum) break;
-            accum += curval;
-            // old = accum;
-            cur_node++;
-        }
-
-        // Checks.
-        assert(cur_node < max_node);
-        assert(curval > 0.0);
-        a0 = curval;
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
     }
-
-    // Check.
-    assert(cur_node < pKProcs.size());
-    return pKProcs[cur_node];
+    return static_cast<Reac *>(pComps[cidx]->reac(lridx))->propensity();
 }
 
 ////////////////////////////////////////////////////////////////////////
 
-void swmd::Wmdirect::_reset(void)
+double swmd::Wmdirect::_getPatchSReacPropensity(uint pidx, uint ridx) const
 {
-    if (pKProcs.size() == 0) return;
-
-    // Reset the basic level: compute rates.
-    double * oldlevel = pLevels[0];
-    uint cur_node = 0;
-    std::vector<KProc*>::iterator kp_end = pKProcs.end();
-    for (std::vector<KProc*>::iterator kp = pKProcs.begin(); kp != kp_end; ++kp)
+    assert(pidx < statedef()->countPatches());
+    ssolver::Patchdef * patch = statedef()->patchdef(pidx);
+    uint lsridx = patch->sreacG2L(ridx);
+    if (lsridx == ssolver::LIDX_UNDEFINED)
     {
-        oldlevel[cur_node++] = (*kp)->rate();
+        std::ostringstream os;
+        os << "Surface reaction undefined in patch.\n";
+        throw steps::ArgErr(os.str());
     }
+    return static_cast<SReac *>(pPatches[pidx]->sreac(lsridx))->propensity();
+}
 
-    // Work up.
-    for (uint cur_level = 1; cur_level < pLevels.size(); ++cur_level)
-    {
-        // Compute the number of nodes to reset on this level.
-        uint numnodes = pLevelSizes[cur_level - 1] / SCHEDULEWIDTH;
-
-        // Fetch a pointer to this level.
-        double * level = pLevels[cur_level];
-
-        // Recompute them.
-        uint child_node = 0;
-        for (cur_node = 0; cur_node < numnodes; ++cur_node)
-        {
-            double val = 0.0;
-            for (uint i = 0; i < SCHEDULEWIDTH; ++i)
-            {
-                val += oldlevel[child_node++];
-            }
-            level[cur_node] = val;
-        }
-
-        // Copy the level.
-        oldlevel = level;
-    }
+////////////////////////////////////////////////////////////////////////
 
-    // Compute zero propensity.
-    pA0 = 0.0;
-    for (uint i = 0; i < SCHEDULEWIDTH; ++i)
+void swmd::Wmdirect::_reset(void)
+{
+    if (not pAutoUpdate) return;
+    double t = statedef()->time();
+    uint nkprocs = pKProcs.size();
+    for (uint i = 0; i < nkprocs; ++i)
     {
-        pA0 += oldlevel[i];
+        pScheduler->update(i, pKProcs[i]->rate(), t);
     }
+    pScheduler->commit(t);
 }
 
 ////////////////////////////////////////////////////////////////////////
 
 void swmd::Wmdirect::_update(SchedIDXVec const & entries)
 {
-    if (countKProcs() == 0) return;
-
-    // Prefetch zero level.
-    double * level0 = pLevels[0];
-    // Number of entries.
-    assert(entries.size() <= pMaxUpSize);											/////////
-
-    // Recompute rates.
+    double t = statedef()->time();
     SchedIDXVecCI sidx_end = entries.end();
-    uint prev_e = 0xFFFFFFFF;
-    uint cur_e = 0;
     for (SchedIDXVecCI sidx = entries.begin(); sidx != sidx_end; ++sidx)
     {
-        // Fetch index.
-        uint idx = *sidx;
-        // Recompute rate, get difference, and store.
-        double newrate = pKProcs[idx]->rate();
-        level0[idx] = newrate;
-
-        // Store and collapse if possible.
-        idx /= SCHEDULEWIDTH;
-        if (prev_e == 0xFFFFFFFF)
-        {
-            prev_e = 0;
-            pIndices[cur_e++] = idx;
-        }
-        else if (pIndices[prev_e] != idx)
-        {
-            prev_e = cur_e;
-            pIndices[cur_e++] = idx;
-        }
-    }
-    uint nentries = cur_e;
-
-    // Update upper levels.
-    uint nlevels = pLevels.size();
-    double * prevlevel = pLevels[0];
-    for (uint l = 1; l < nlevels; ++l)
-    {
-        // Update the first entry.
-        cur_e = 0;
-        prev_e = 0xFFFFFFFF;
-
-        // Fetch a pointer to the current level.
-        double * currlevel = pLevels[l];
-
-        // Recompute the entries.
-        for (uint e = 0; e < nentries; ++e)
-        {
-            // Fetch index.
-            uint idx = pIndices[e];
-
-            // Recompute.
-            double val = 0.0;
-            uint idx2 = idx * SCHEDULEWIDTH;
-            for (uint i = 0; i < SCHEDULEWIDTH; ++i)
-            {
-                val += prevlevel[idx2++];
-            }
-            currlevel[idx] = val;
-
-            // Store and collapse if possible.
-            idx /= SCHEDULEWIDTH;
-            if (prev_e == 0xFFFFFFFF)
-            {
-                prev_e = 0;
-                pIndices[cur_e++] = idx;
-            }
-            else if (pIndices[prev_e] != idx)
-            {
-                prev_e = cur_e;
-                pIndices[cur_e++] = idx;
-            }
-        }
-
-        // Update the pointer to the previous level.
-        prevlevel = currlevel;
-
-        // cur_e now is the new number of entries to handle.
-        nentries = cur_e;
-    }
-
-    // Update zero propensity.
-    double * toplevel = pLevels[pLevels.size() - 1];
-    pA0 = 0.0;
-    for (uint i = 0; i < SCHEDULEWIDTH; ++i)
-    {
-        pA0 += toplevel[i];
+        pScheduler->update(*sidx, pKProcs[*sidx]->rate(), t);
     }
+    pScheduler->commit(t);
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -1419,9 +1355,339 @@ void swmd::Wmdirect::_update(SchedIDXVec const & entries)
 void swmd::Wmdirect::_executeStep(swmd::KProc * kp, double dt)
 {
 	SchedIDXVec const & upd = kp->apply();
-	_update(upd);
 	statedef()->incTime(dt);
 	statedef()->incNSteps(1);
+	// Propensities are updated at the time of the event.
+	if (pPDM != 0) pPDM->applied(kp->schedIDX(), statedef()->time());
+	else _update(upd);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void swmd::Wmdirect::_leapSetup(void)
+{
+	// The stoichiometry does not change, so the tables are built once.
+	if (pLeapLhsStart.empty() == false) return;
+
+	uint nkprocs = pKProcs.size();
+	pLeapLhsStart.assign(1, 0);
+	pLeapUpdStart.assign(1, 0);
+
+	std::map<std::pair<void *, uint>, uint> specidx;
+	std::vector<LeapTerm> lhs, upd;
+	for (uint i = 0; i < nkprocs; ++i)
+	{
+		lhs.clear();
+		upd.clear();
+		pKProcs[i]->leapStoich(lhs, upd);
+
+		uint order = 0;
+		for (std::vector<LeapTerm>::const_iterator l = lhs.begin(); l != lhs.end(); ++l)
+		{
+			order += static_cast<uint>(l->n);
+		}
+		for (uint pass = 0; pass < 2; ++pass)
+		{
+			std::vector<LeapTerm> const & terms = (pass == 0 ? lhs : upd);
+			for (std::vector<LeapTerm>::const_iterator l = terms.begin(); l != terms.end(); ++l)
+			{
+				void * def = (l->cdef != 0) ? static_cast<void *>(l->cdef)
+				                            : static_cast<void *>(l->pdef);
+				std::pair<void *, uint> key(def, l->lidx);
+				std::map<std::pair<void *, uint>, uint>::const_iterator s = specidx.find(key);
+				uint sidx;
+				if (s == specidx.end())
+				{
+					sidx = pLeapLidx.size();
+					specidx[key] = sidx;
+					pLeapCdef.push_back(l->cdef);
+					pLeapPdef.push_back(l->pdef);
+					pLeapLidx.push_back(l->lidx);
+					pLeapHOR.push_back(0);
+					pLeapHORn.push_back(0);
+				}
+				else sidx = s->second;
+
+				if (pass == 0)
+				{
+					uint n = static_cast<uint>(l->n);
+					pLeapLhsSpec.push_back(sidx);
+					pLeapLhsN.push_back(n);
+					if (order > pLeapHOR[sidx] || (order == pLeapHOR[sidx] && n > pLeapHORn[sidx]))
+					{
+						pLeapHOR[sidx] = order;
+						pLeapHORn[sidx] = n;
+					}
+				}
+				else
+				{
+					pLeapUpdSpec.push_back(sidx);
+					pLeapUpdN.push_back(static_cast<double>(l->n));
+				}
+			}
+		}
+		pLeapLhsStart.push_back(pLeapLhsSpec.size());
+		pLeapUpdStart.push_back(pLeapUpdSpec.size());
+	}
+
+	uint nspecs = pLeapLidx.size();
+	pLeapRate.assign(nkprocs, 0.0);
+	pLeapCrit.assign(nkprocs, 0);
+	pLeapK.assign(nkprocs, 0);
+	pLeapMu.assign(nspecs, 0.0);
+	pLeapSigma.assign(nspecs, 0.0);
+	pLeapReactant.assign(nspecs, 0);
+	pLeapDelta.assign(nspecs, 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void swmd::Wmdirect::_runLeap(double endtime)
+{
+	_leapSetup();
+	uint nkprocs = pKProcs.size();
+	uint nspecs = pLeapLidx.size();
+	steps::rng::RNG * r = rng();
+
+	while (statedef()->time() < endtime)
+	{
+		double t = statedef()->time();
+
+		// Propensities, and which kprocs are critical.
+		double a0 = 0.0;
+		double ac = 0.0;
+		for (uint j = 0; j < nkprocs; ++j)
+		{
+			double a = pKProcs[j]->rate();
+			pLeapRate[j] = a;
+			a0 += a;
+			bool crit = false;
+			if (a > 0.0)
+			{
+				uint l_end = pLeapLhsStart[j + 1];
+				for (uint l = pLeapLhsStart[j]; l < l_end; ++l)
+				{
+					uint s = pLeapLhsSpec[l];
+					if (_leapClamped(s) == true) continue;
+					if (_leapCount(s) < pLeapNCrit * pLeapLhsN[l])
+					{
+						crit = true;
+						break;
+					}
+				}
+			}
+			pLeapCrit[j] = crit ? 1 : 0;
+			if (crit == true) ac += a;
+		}
+		if (a0 <= 0.0) break;
+		double anc = a0 - ac;
+
+		// Mean and variance of the change of each species per unit time
+		// from the non-critical kprocs.
+		std::fill(pLeapMu.begin(), pLeapMu.end(), 0.0);
+		std::fill(pLeapSigma.begin(), pLeapSigma.end(), 0.0);
+		std::fill(pLeapReactant.begin(), pLeapReactant.end(), 0);
+		for (uint j = 0; j < nkprocs; ++j)
+		{
+			double a = pLeapRate[j];
+			if (pLeapCrit[j] == 1 || a <= 0.0) continue;
+			uint l_end = pLeapLhsStart[j + 1];
+			for (uint l = pLeapLhsStart[j]; l < l_end; ++l)
+			{
+				pLeapReactant[pLeapLhsSpec[l]] = 1;
+			}
+			uint u_end = pLeapUpdStart[j + 1];
+			for (uint u = pLeapUpdStart[j]; u < u_end; ++u)
+			{
+				uint s = pLeapUpdSpec[u];
+				double n = pLeapUpdN[u];
+				pLeapMu[s] += n * a;
+				pLeapSigma[s] += n * n * a;
+			}
+		}
+
+		// Cao, Gillespie and Petzold, J Chem Phys 124, 044109 (2006),
+		// eq. 33: bound the relative change of all reactant species.
+		double tau1 = std::numeric_limits<double>::infinity();
+		for (uint s = 0; s < nspecs; ++s)
+		{
+			if (pLeapReactant[s] == 0) continue;
+			double x = _leapCount(s);
+			uint hor = pLeapHOR[s];
+			uint horn = pLeapHORn[s];
+			double g = hor;
+			if (hor == 2 && horn == 2 && x > 1.0)
+			{
+				g = 2.0 + 1.0 / (x - 1.0);
+			}
+			else if (hor == 3 && horn == 2 && x > 1.0)
+			{
+				g = 1.5 * (2.0 + 1.0 / (x - 1.0));
+			}
+			else if (hor == 3 && horn == 3 && x > 2.0)
+			{
+				g = 3.0 + 1.0 / (x - 1.0) + 2.0 / (x - 2.0);
+			}
+			double bound = std::max(pLeapEps * x / g, 1.0);
+			double mu = fabs(pLeapMu[s]);
+			if (mu > 0.0) tau1 = std::min(tau1, bound / mu);
+			if (pLeapSigma[s] > 0.0) tau1 = std::min(tau1, bound * bound / pLeapSigma[s]);
+		}
+
+		// Step exactly when the leap would cover too few events, counting
+		// that a critical event is expected after 1/ac.
+		double tau_exp = tau1;
+		if (ac > 0.0) tau_exp = std::min(tau_exp, 1.0 / ac);
+		if (tau_exp * a0 < WMDIRECT_LEAP_SSA_FACTOR)
+		{
+			_reset();
+			for (uint n = 0; n < WMDIRECT_LEAP_SSA_STEPS; ++n)
+			{
+				double dt = 0.0;
+				uint kidx = pScheduler->getNext(statedef()->time(), dt);
+				if (kidx == sssa::SCHED_IDX_UNDEFINED) return;
+				if ((statedef()->time() + dt) > endtime) return;
+				_executeStep(pKProcs[kidx], dt);
+			}
+			continue;
+		}
+
+		double tau2 = (ac > 0.0) ? r->getExp(ac) : std::numeric_limits<double>::infinity();
+		double tleft = endtime - t;
+
+		// For R-leaping, the number of events that tau1 allows on average.
+		double nleap = std::max(std::floor(tau1 * anc), 1.0);
+
+		double tau = 0.0;
+		bool fire_crit = false;
+		uint nevents = 0;
+		while (true)
+		{
+			nevents = 0;
+			if (pRLeap == false)
+			{
+				fire_crit = (tau2 <= tau1);
+				tau = fire_crit ? tau2 : tau1;
+				if (tau > tleft)
+				{
+					tau = tleft;
+					fire_crit = false;
+				}
+
+				// Draw the number of firings of each non-critical kproc.
+				for (uint j = 0; j < nkprocs; ++j)
+				{
+					double a = pLeapRate[j];
+					uint k = 0;
+					if (pLeapCrit[j] == 0 && a > 0.0)
+					{
+						// Like getExp, getPsn takes the inverse of the mean.
+						k = static_cast<uint>(r->getPsn(static_cast<float>(1.0 / (a * tau))));
+					}
+					pLeapK[j] = k;
+					nevents += k;
+				}
+			}
+			else
+			{
+				// Auger, Chatelain and Koumoutsakos, J Chem Phys 125,
+				// 084103 (2006): nleap events take a gamma distributed
+				// time. If a critical event or endtime comes first, the
+				// earlier of the events are uniform over the leap.
+				uint nfire = 0;
+				fire_crit = false;
+				tau = 0.0;
+				if (anc > 0.0)
+				{
+					uint nl = static_cast<uint>(nleap);
+					tau = r->getGamma(nleap) / anc;
+					nfire = nl;
+				}
+				else tau = std::numeric_limits<double>::infinity();
+				double cut = std::min(tau2, tleft);
+				if (cut < tau)
+				{
+					fire_crit = (tau2 <= tleft);
+					if (nfire > 0) nfire = r->getBinom(nfire - 1, cut / tau);
+					tau = cut;
+				}
+
+				// Split the events multinomially over the non-critical
+				// kprocs.
+				double arest = anc;
+				for (uint j = 0; j < nkprocs; ++j)
+				{
+					double a = pLeapRate[j];
+					uint k = 0;
+					if (pLeapCrit[j] == 0 && a > 0.0 && nfire > 0)
+					{
+						k = (a >= arest) ? nfire : r->getBinom(nfire, a / arest);
+						nfire -= k;
+						arest -= a;
+					}
+					pLeapK[j] = k;
+					nevents += k;
+				}
+			}
+
+			// Reject the leap if it drives a population negative.
+			for (uint j = 0; j < nkprocs; ++j)
+			{
+				uint k = pLeapK[j];
+				if (k == 0) continue;
+				uint u_end = pLeapUpdStart[j + 1];
+				for (uint u = pLeapUpdStart[j]; u < u_end; ++u)
+				{
+					pLeapDelta[pLeapUpdSpec[u]] += pLeapUpdN[u] * k;
+				}
+			}
+			bool neg = false;
+			for (uint s = 0; s < nspecs; ++s)
+			{
+				if (pLeapDelta[s] != 0.0 && _leapClamped(s) == false
+					&& _leapCount(s) + pLeapDelta[s] < 0.0)
+				{
+					neg = true;
+				}
+				pLeapDelta[s] = 0.0;
+			}
+			if (neg == false) break;
+			tau1 = 0.5 * tau;
+			nleap = std::max(std::floor(0.5 * nleap), 1.0);
+		}
+
+		for (uint j = 0; j < nkprocs; ++j)
+		{
+			if (pLeapK[j] > 0) pKProcs[j]->applyN(pLeapK[j]);
+		}
+
+		// At most one critical event per leap, chosen with the
+		// propensities at the start of the leap.
+		if (fire_crit == true)
+		{
+			double sel = r->getUnfIE() * ac;
+			uint jc = nkprocs;
+			for (uint j = 0; j < nkprocs; ++j)
+			{
+				if (pLeapCrit[j] == 0 || pLeapRate[j] <= 0.0) continue;
+				jc = j;
+				sel -= pLeapRate[j];
+				if (sel < 0.0) break;
+			}
+			// The leap may have used up its reactants.
+			if (jc < nkprocs && pKProcs[jc]->rate() > 0.0)
+			{
+				pKProcs[jc]->apply();
+				nevents += 1;
+			}
+		}
+
+		statedef()->incTime(tau);
+		if (nevents > 0) statedef()->incNSteps(nevents);
+	}
+
+	// Leave the scheduler consistent with the new state.
+	_reset();
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -48,6 +48,8 @@
 #include "comp.hpp"
 #include "patch.hpp"
 #include "kproc.hpp"
+#include "../solver/ssa/scheduler.hpp"
+#include "pdmsched.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -56,6 +58,26 @@ START_NAMESPACE(wmdirect)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Default error control parameter of the leaping modes.
+#define WMDIRECT_LEAP_EPSILON       0.03
+
+// Default number of firings below which a kproc is treated as critical
+// in the leaping modes.
+#define WMDIRECT_LEAP_NCRIT         10
+
+// The leaping modes fall back to exact SSA steps when the leap would
+// cover fewer than this many events...
+#define WMDIRECT_LEAP_SSA_FACTOR    10.0
+
+// ...and then take this many of them before trying to leap again.
+#define WMDIRECT_LEAP_SSA_STEPS     100
+
+// The "auto" scheduler is the sorting direct method below this many
+// kprocs, the sum tree from there on.
+#define WMDIRECT_SDM_MAX_KPROCS     128
+
+////////////////////////////////////////////////////////////////////////////////
+
 // Forward declarations.
 
 
@@ -82,7 +104,17 @@ class Wmdirect: public steps::solver::API
 
 public:
 
-    Wmdirect(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r);
+    /// The scheduler selects the SSA kernel: "direct" (n-ary sum tree),
+    /// "sdm" (sorting direct method, a linear search over propensities
+    /// that moves the most frequent kprocs to the front), "cr"
+    /// (composition and rejection), "nrm" (Gibson-Bruck next reaction
+    /// method) or "pdm" (partial-propensity direct method, for large
+    /// networks of reactions with at most two reactants). The default,
+    /// "auto", is "sdm" for fewer than WMDIRECT_SDM_MAX_KPROCS kprocs and
+    /// "direct" otherwise.
+    ///
+    Wmdirect(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+             std::string const & scheduler = "auto");
     ~Wmdirect(void);
 
     ////////////////////////////////////////////////////////////////////////
@@ -122,10 +154,62 @@ public:
     double getTime(void) const;
 
     inline double getA0(void) const
-    { return pA0; }
+    { return pScheduler->getA0(); }
 
     uint getNSteps(void) const;
 
+    /// Return the name of the scheduler used by the SSA kernel.
+    ///
+    std::string getScheduler(void) const;
+
+    /// Return the number of internal scheduler nodes recomputed by the
+    /// propensity update of the last step.
+    ///
+    uint getSchedNodesTouched(void) const;
+
+    /// Return the number of internal scheduler nodes recomputed since the
+    /// solver was created.
+    ///
+    double getSchedNodesTouchedTotal(void) const;
+
+    /// Switch run() between exact SSA (the default) and explicit
+    /// tau-leaping with the step selection of Cao, Gillespie and Petzold
+    /// (2006), as Tetexact::setTauLeaping. Kprocs that could exhaust a
+    /// reactant within the critical number of firings are executed one
+    /// event at a time, and the solver takes exact SSA steps when a leap
+    /// would be too short to pay off. Switching it on switches R-leaping
+    /// off.
+    ///
+    void setTauLeaping(bool leap);
+
+    bool getTauLeaping(void) const;
+
+    /// Switch run() between exact SSA (the default) and R-leaping
+    /// (Auger, Chatelain and Koumoutsakos 2006): each leap executes a
+    /// number of events chosen with the same error control as
+    /// tau-leaping, split multinomially over the non-critical kprocs,
+    /// and takes a gamma distributed time. Switching it on switches
+    /// tau-leaping off.
+    ///
+    void setRLeaping(bool leap);
+
+    bool getRLeaping(void) const;
+
+    /// Set the error control parameter epsilon of both leaping modes, the
+    /// largest relative change allowed in the propensities during a leap.
+    /// Must lie in (0, 1); the default is 0.03.
+    ///
+    void setTauLeapEpsilon(double eps);
+
+    double getTauLeapEpsilon(void) const;
+
+    /// Set the number of firings below which a kproc is critical in both
+    /// leaping modes. The default is 10.
+    ///
+    void setTauLeapNCrit(uint ncrit);
+
+    uint getTauLeapNCrit(void) const;
+
     ////////////////////////////////////////////////////////////////////////
     // SOLVER STATE ACCESS:
     //      ADVANCE
@@ -219,10 +303,26 @@ public:
 	inline uint countKProcs(void) const
 	{ return pKProcs.size(); }
 
+	/// Stop (false) or resume (true) recomputing the propensities after
+	/// each change of a count, flag, constant or volume; resuming
+	/// recomputes all of them. Lets the well-mixed hybrid solver change
+	/// many counts at once.
+	///
+	void _setAutoUpdate(bool b);
+
+	/// Propensity of a reaction or surface reaction, computed whether or
+	/// not it is active.
+	///
+	double _getCompReacPropensity(uint cidx, uint ridx) const;
+	double _getPatchSReacPropensity(uint pidx, uint ridx) const;
+
 	////////////////////////////////////////////////////////////////////////
 
 private:
 
+    // Reads the structure of a prototype solver.
+    friend class WmEnsemble;
+
     ////////////////////////////////////////////////////////////////////////
     // WMDIRECT SOLVER METHODS
     ////////////////////////////////////////////////////////////////////////
@@ -237,14 +337,35 @@ private:
 
 	void _build(void);
 
-	steps::wmdirect::KProc * _getNext(void) const;
-
 	void _reset(void);
 
 	void _update(SchedIDXVec const & entries);
 
 	void _executeStep(steps::wmdirect::KProc * kp, double dt);
 
+    ////////////////////////////////////////////////////////////////////////
+    // LEAPING
+    ////////////////////////////////////////////////////////////////////////
+
+    // Collect the stoichiometry of all kprocs into the flat leap tables.
+    void _leapSetup(void);
+
+    // Advance the simulation to endtime by tau- or R-leaping.
+    void _runLeap(double endtime);
+
+    // Count of leap species s.
+    inline double _leapCount(uint s) const
+    {
+        return (pLeapCdef[s] != 0) ? pLeapCdef[s]->pools()[pLeapLidx[s]]
+                                   : pLeapPdef[s]->pools()[pLeapLidx[s]];
+    }
+
+    inline bool _leapClamped(uint s) const
+    {
+        return (pLeapCdef[s] != 0) ? pLeapCdef[s]->clamped(pLeapLidx[s])
+                                   : pLeapPdef[s]->clamped(pLeapLidx[s]);
+    }
+
     ////////////////////////////////////////////////////////////////////////
     // LIST OF WMDIRECT SOLVER OBJECTS
     ////////////////////////////////////////////////////////////////////////
@@ -257,27 +378,58 @@ private:
     std::vector<steps::wmdirect::Patch *>      pPatches;
 
     ////////////////////////////////////////////////////////////////////////
-    // N-ARY TREE
+    // SCHEDULER
     ////////////////////////////////////////////////////////////////////////
 
-    double                                     pA0;
-
-    std::vector<uint>                          pLevelSizes;
+    // The event scheduler, owned by the solver. Created by _build() for
+    // "auto", when the number of kprocs is known.
+    steps::solver::ssa::Scheduler            * pScheduler;
 
-    std::vector<double *>                      pLevels;
+    // pScheduler if it is the partial-propensity scheduler, otherwise 0.
+    steps::wmdirect::PDMScheduler            * pPDM;
 
 	////////////////////////////////////////////////////////////////////////
 
     // Keeps track of whether _build() has been called
     bool                                       pBuilt;
 
-	////////////////////////////////////////////////////////////////////////
+    // Whether _reset() recomputes the propensities, see _setAutoUpdate()
+    bool                                       pAutoUpdate;
+
+    ////////////////////////////////////////////////////////////////////////
+    // LEAPING
+    ////////////////////////////////////////////////////////////////////////
 
-    // Tables to hold update vector indices and random numbers respectively,
-    // to be re-used each step.
-    uint                                     * pIndices;
-    uint 									   pMaxUpSize;
-    double                                   * pRannum;
+    bool                                       pTauLeap;
+    bool                                       pRLeap;
+    double                                     pLeapEps;
+    uint                                       pLeapNCrit;
+
+    // The species pools the kprocs read or change, with for each the
+    // highest order of a kproc consuming it and the number of molecules
+    // that kproc consumes.
+    std::vector<steps::solver::Compdef *>      pLeapCdef;
+    std::vector<steps::solver::Patchdef *>     pLeapPdef;
+    std::vector<uint>                          pLeapLidx;
+    std::vector<uint>                          pLeapHOR;
+    std::vector<uint>                          pLeapHORn;
+
+    // Per kproc, in CSR form, its reactants and its changes.
+    std::vector<uint>                          pLeapLhsStart;
+    std::vector<uint>                          pLeapLhsSpec;
+    std::vector<uint>                          pLeapLhsN;
+    std::vector<uint>                          pLeapUpdStart;
+    std::vector<uint>                          pLeapUpdSpec;
+    std::vector<double>                        pLeapUpdN;
+
+    // Work space of _runLeap().
+    std::vector<double>                        pLeapRate;
+    std::vector<char>                          pLeapCrit;
+    std::vector<uint>                          pLeapK;
+    std::vector<double>                        pLeapMu;
+    std::vector<double>                        pLeapSigma;
+    std::vector<char>                          pLeapReactant;
+    std::vector<double>                        pLeapDelta;
 
 	////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,625 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// STL headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// STEPS headers.
+#include "../common.h"
+#include "../error.hpp"
+#include "../solver/statedef.hpp"
+#include "../solver/compdef.hpp"
+#include "../solver/patchdef.hpp"
+#include "comp.hpp"
+#include "patch.hpp"
+#include "kproc.hpp"
+#include "wmensemble.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+NAMESPACE_ALIAS(steps::wmdirect, swmd);
+NAMESPACE_ALIAS(steps::solver, ssolver);
+
+////////////////////////////////////////////////////////////////////////////////
+
+swmd::WmEnsemble::WmEnsemble(steps::model::Model * m, steps::wm::Geom * g,
+                             steps::rng::RNG * r, uint nreps)
+: pRNG(r)
+, pNReps(nreps)
+, pProto(0)
+, pNPools(0)
+, pNKProcs(0)
+, pCompPoolStart()
+, pPatchPoolStart()
+, pClamped()
+, pLhsStart()
+, pLhsPool()
+, pLhsN()
+, pUpdStart()
+, pUpdPool()
+, pUpdN()
+, pPools()
+, pCcst()
+, pProps()
+, pA0()
+, pRepTime()
+, pRepNSteps()
+, pBlocks()
+, pBlockRNGs()
+, pTime(0.0)
+, pRecPool()
+{
+    if (r == 0)
+    {
+        std::ostringstream os;
+        os << "No RNG provided to ensemble initializer function";
+        throw steps::ArgErr(os.str());
+    }
+    if (nreps == 0)
+    {
+        std::ostringstream os;
+        os << "Ensemble needs at least one replicate.";
+        throw steps::ArgErr(os.str());
+    }
+
+    pProto = new Wmdirect(m, g, r);
+    ssolver::Statedef * sd = pProto->statedef();
+
+    for (uint c = 0; c < sd->countComps(); ++c)
+    {
+        pCompPoolStart.push_back(pNPools);
+        pNPools += sd->compdef(c)->countSpecs();
+    }
+    for (uint p = 0; p < sd->countPatches(); ++p)
+    {
+        pPatchPoolStart.push_back(pNPools);
+        pNPools += sd->patchdef(p)->countSpecs();
+    }
+    pClamped.assign(pNPools, 0);
+
+    pNKProcs = pProto->countKProcs();
+    pLhsStart.assign(1, 0);
+    pUpdStart.assign(1, 0);
+    std::vector<LeapTerm> lhs, upd;
+    for (uint j = 0; j < pNKProcs; ++j)
+    {
+        lhs.clear();
+        upd.clear();
+        pProto->pKProcs[j]->leapStoich(lhs, upd);
+        for (std::vector<LeapTerm>::const_iterator l = lhs.begin(); l != lhs.end(); ++l)
+        {
+            uint start = (l->cdef != 0) ? pCompPoolStart[l->cdef->gidx()]
+                                        : pPatchPoolStart[l->pdef->gidx()];
+            pLhsPool.push_back(start + l->lidx);
+            pLhsN.push_back(static_cast<uint>(l->n));
+        }
+        for (std::vector<LeapTerm>::const_iterator l = upd.begin(); l != upd.end(); ++l)
+        {
+            uint start = (l->cdef != 0) ? pCompPoolStart[l->cdef->gidx()]
+                                        : pPatchPoolStart[l->pdef->gidx()];
+            pUpdPool.push_back(start + l->lidx);
+            pUpdN.push_back(static_cast<double>(l->n));
+        }
+        pLhsStart.push_back(pLhsPool.size());
+        pUpdStart.push_back(pUpdPool.size());
+    }
+
+    pProps.assign(pNKProcs * pNReps, 0.0);
+    pA0.assign(pNReps, 0.0);
+    pRepTime.assign(pNReps, 0.0);
+    setNThreads(1);
+    reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+swmd::WmEnsemble::~WmEnsemble(void)
+{
+    for (uint i = 0; i < pBlockRNGs.size(); ++i) delete pBlockRNGs[i];
+    delete pProto;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setNThreads(uint n)
+{
+    if (n == 0)
+    {
+        std::ostringstream os;
+        os << "Number of threads must be positive.";
+        throw steps::ArgErr(os.str());
+    }
+    n = std::min(n, pNReps);
+
+    for (uint i = 0; i < pBlockRNGs.size(); ++i) delete pBlockRNGs[i];
+    pBlockRNGs.clear();
+    if (n > 1)
+    {
+        for (uint i = 0; i < n; ++i)
+        {
+            steps::rng::RNG * r = steps::rng::create("philox4x32", 512);
+            r->initialize(pRNG->get());
+            pBlockRNGs.push_back(r);
+        }
+    }
+
+    // Block boundaries are rounded to 8 replicates, a cache line of
+    // doubles, so that threads do not write to the same lines.
+    pBlocks.assign(n, Block());
+    uint per = (pNReps + n - 1) / n;
+    per = ((per + 7) / 8) * 8;
+    for (uint i = 0; i < n; ++i)
+    {
+        Block & b = pBlocks[i];
+        b.ensemble = this;
+        b.rbgn = std::min(i * per, pNReps);
+        b.rend = std::min(b.rbgn + per, pNReps);
+        b.rng = (n > 1) ? pBlockRNGs[i] : pRNG;
+        b.endtime = 0.0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::reset(void)
+{
+    // The prototype is never left changed, so its constants are those of
+    // the model.
+    pPools.assign(pNPools * pNReps, 0.0);
+    pCcst.resize(pNKProcs * pNReps);
+    for (uint j = 0; j < pNKProcs; ++j)
+    {
+        std::fill_n(pCcst.begin() + j * pNReps, pNReps, pProto->pKProcs[j]->c());
+    }
+    pRepNSteps.assign(pNReps, 0.0);
+    pTime = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::_computeProps(uint rbgn, uint rend)
+{
+    uint K = pNReps;
+    std::fill(pA0.begin() + rbgn, pA0.begin() + rend, 0.0);
+    double * a0 = &pA0[0];
+    for (uint j = 0; j < pNKProcs; ++j)
+    {
+        double * a = &pProps[j * K];
+        double const * c = &pCcst[j * K];
+        for (uint r = rbgn; r < rend; ++r) a[r] = c[r];
+
+        // For integral counts x the falling factorial is zero when x is
+        // smaller than the order, so no replicate needs a branch.
+        uint l_end = pLhsStart[j + 1];
+        for (uint l = pLhsStart[j]; l < l_end; ++l)
+        {
+            double const * x = &pPools[pLhsPool[l] * K];
+            switch (pLhsN[l])
+            {
+                case 1:
+                    for (uint r = rbgn; r < rend; ++r) a[r] *= x[r];
+                    break;
+                case 2:
+                    for (uint r = rbgn; r < rend; ++r) a[r] *= x[r] * (x[r] - 1.0);
+                    break;
+                case 3:
+                    for (uint r = rbgn; r < rend; ++r) a[r] *= x[r] * (x[r] - 1.0) * (x[r] - 2.0);
+                    break;
+                case 4:
+                    for (uint r = rbgn; r < rend; ++r)
+                    {
+                        a[r] *= x[r] * (x[r] - 1.0) * (x[r] - 2.0) * (x[r] - 3.0);
+                    }
+                    break;
+                default:
+                    assert(0);
+            }
+        }
+        for (uint r = rbgn; r < rend; ++r) a0[r] += a[r];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::run(double endtime)
+{
+    if (endtime < pTime)
+    {
+        std::ostringstream os;
+        os << "Endtime is before current simulation time";
+        throw steps::ArgErr(os.str());
+    }
+
+    std::fill(pRepTime.begin(), pRepTime.end(), pTime);
+    uint nblocks = pBlocks.size();
+    for (uint i = 0; i < nblocks; ++i) pBlocks[i].endtime = endtime;
+
+    if (nblocks == 1)
+    {
+        _runBlock(pBlocks[0]);
+    }
+    else
+    {
+        std::vector<pthread_t> threads(nblocks);
+        std::vector<char> started(nblocks, 0);
+        for (uint i = 0; i < nblocks; ++i)
+        {
+            started[i] = (pthread_create(&threads[i], 0, _work, &pBlocks[i]) == 0);
+            // A block whose thread did not start is run here.
+            if (started[i] == 0) _runBlock(pBlocks[i]);
+        }
+        for (uint i = 0; i < nblocks; ++i)
+        {
+            if (started[i] == 1) pthread_join(threads[i], 0);
+        }
+    }
+
+    pTime = endtime;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void * swmd::WmEnsemble::_work(void * arg)
+{
+    Block * b = static_cast<Block *>(arg);
+    b->ensemble->_runBlock(*b);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::_runBlock(Block & b)
+{
+    uint K = pNReps;
+    double endtime = b.endtime;
+    std::vector<uint> & live = b.live;
+    std::vector<double> & rand = b.rand;
+    live.resize(b.rend - b.rbgn);
+    for (uint r = b.rbgn; r < b.rend; ++r) live[r - b.rbgn] = r;
+
+    while (live.empty() == false)
+    {
+        _computeProps(b.rbgn, b.rend);
+
+        uint nlive = live.size();
+        rand.resize(2 * nlive);
+        b.rng->fillUnfEE(&rand[0], 2 * nlive);
+
+        uint nkeep = 0;
+        for (uint i = 0; i < nlive; ++i)
+        {
+            uint r = live[i];
+            double a0 = pA0[r];
+            if (a0 <= 0.0) continue;
+            double dt = -std::log(rand[2 * i]) / a0;
+            if (pRepTime[r] + dt > endtime) continue;
+
+            // Select the kproc by a linear search over the cumulative
+            // propensities of this replicate.
+            double sel = rand[2 * i + 1] * a0;
+            uint j = 0;
+            for (; j + 1 < pNKProcs; ++j)
+            {
+                sel -= pProps[j * K + r];
+                if (sel < 0.0) break;
+            }
+            // Rounding may leave the last kprocs with zero propensity.
+            while (pProps[j * K + r] <= 0.0) --j;
+
+            uint u_end = pUpdStart[j + 1];
+            for (uint u = pUpdStart[j]; u < u_end; ++u)
+            {
+                uint p = pUpdPool[u];
+                if (pClamped[p] == 0) pPools[p * K + r] += pUpdN[u];
+            }
+            pRepTime[r] += dt;
+            pRepNSteps[r] += 1.0;
+            live[nkeep++] = r;
+        }
+        live.resize(nkeep);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> swmd::WmEnsemble::runRecord(std::vector<double> const & tpnts)
+{
+    uint ntpnts = tpnts.size();
+    uint nrecs = pRecPool.size();
+    for (uint j = 0; j < ntpnts; ++j)
+    {
+        if (tpnts[j] < pTime || (j > 0 && tpnts[j] < tpnts[j - 1]))
+        {
+            std::ostringstream os;
+            os << "Time points must be increasing and not before the current time.";
+            throw steps::ArgErr(os.str());
+        }
+    }
+
+    std::vector<double> res(pNReps * ntpnts * nrecs, 0.0);
+    for (uint j = 0; j < ntpnts; ++j)
+    {
+        run(tpnts[j]);
+        for (uint r = 0; r < pNReps; ++r)
+        {
+            double * out = &res[(r * ntpnts + j) * nrecs];
+            for (uint k = 0; k < nrecs; ++k)
+            {
+                out[k] = pPools[pRecPool[k] * pNReps + r];
+            }
+        }
+    }
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmd::WmEnsemble::getRepNSteps(uint rep) const
+{
+    _checkRep(rep);
+    return pRepNSteps[rep];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::addCompCountRecord(std::string const & c, std::string const & s)
+{
+    pRecPool.push_back(_compPool(c, s));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::addPatchCountRecord(std::string const & p, std::string const & s)
+{
+    pRecPool.push_back(_patchPool(p, s));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::_checkRep(uint rep) const
+{
+    if (rep >= pNReps)
+    {
+        std::ostringstream os;
+        os << "Replicate index out of range.";
+        throw steps::ArgErr(os.str());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmd::WmEnsemble::_compPool(std::string const & c, std::string const & s) const
+{
+    ssolver::Statedef * sd = pProto->statedef();
+    uint cidx = sd->getCompIdx(c);
+    uint slidx = sd->compdef(cidx)->specG2L(sd->getSpecIdx(s));
+    if (slidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Species undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return pCompPoolStart[cidx] + slidx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmd::WmEnsemble::_patchPool(std::string const & p, std::string const & s) const
+{
+    ssolver::Statedef * sd = pProto->statedef();
+    uint pidx = sd->getPatchIdx(p);
+    uint slidx = sd->patchdef(pidx)->specG2L(sd->getSpecIdx(s));
+    if (slidx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Species undefined in patch.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return pPatchPoolStart[pidx] + slidx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmd::WmEnsemble::_compReac(std::string const & c, std::string const & r) const
+{
+    ssolver::Statedef * sd = pProto->statedef();
+    uint cidx = sd->getCompIdx(c);
+    uint lridx = sd->compdef(cidx)->reacG2L(sd->getReacIdx(r));
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Reaction undefined in compartment.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return pProto->pComps[cidx]->reac(lridx)->schedIDX();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmd::WmEnsemble::_patchSReac(std::string const & p, std::string const & r) const
+{
+    ssolver::Statedef * sd = pProto->statedef();
+    uint pidx = sd->getPatchIdx(p);
+    uint lridx = sd->patchdef(pidx)->sreacG2L(sd->getSReacIdx(r));
+    if (lridx == ssolver::LIDX_UNDEFINED)
+    {
+        std::ostringstream os;
+        os << "Surface reaction undefined in patch.\n";
+        throw steps::ArgErr(os.str());
+    }
+    return pProto->pPatches[pidx]->sreac(lridx)->schedIDX();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::_setCount(uint rep, uint pool, double n)
+{
+    if (n < 0.0)
+    {
+        std::ostringstream os;
+        os << "Negative number of molecules.\n";
+        throw steps::ArgErr(os.str());
+    }
+    // Counts are integral, as in Wmdirect.
+    pPools[pool * pNReps + rep] = std::floor(n + 0.5);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setCompCount(std::string const & c, std::string const & s, double n)
+{
+    uint pool = _compPool(c, s);
+    for (uint r = 0; r < pNReps; ++r) _setCount(r, pool, n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setRepCompCount(uint rep, std::string const & c,
+                                       std::string const & s, double n)
+{
+    _checkRep(rep);
+    _setCount(rep, _compPool(c, s), n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmd::WmEnsemble::getRepCompCount(uint rep, std::string const & c,
+                                         std::string const & s) const
+{
+    _checkRep(rep);
+    return pPools[_compPool(c, s) * pNReps + rep];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setPatchCount(std::string const & p, std::string const & s, double n)
+{
+    uint pool = _patchPool(p, s);
+    for (uint r = 0; r < pNReps; ++r) _setCount(r, pool, n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setRepPatchCount(uint rep, std::string const & p,
+                                        std::string const & s, double n)
+{
+    _checkRep(rep);
+    _setCount(rep, _patchPool(p, s), n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmd::WmEnsemble::getRepPatchCount(uint rep, std::string const & p,
+                                          std::string const & s) const
+{
+    _checkRep(rep);
+    return pPools[_patchPool(p, s) * pNReps + rep];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setCompClamped(std::string const & c, std::string const & s, bool b)
+{
+    pClamped[_compPool(c, s)] = b ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setPatchClamped(std::string const & p, std::string const & s, bool b)
+{
+    pClamped[_patchPool(p, s)] = b ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmd::WmEnsemble::_compCcst(uint kidx, std::string const & c,
+                                   std::string const & r, double kf)
+{
+    // The prototype scales the constant; its own is put back after.
+    double k0 = pProto->getCompReacK(c, r);
+    pProto->setCompReacK(c, r, kf);
+    double ccst = pProto->pKProcs[kidx]->c();
+    pProto->setCompReacK(c, r, k0);
+    return ccst;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmd::WmEnsemble::_patchCcst(uint kidx, std::string const & p,
+                                    std::string const & r, double kf)
+{
+    double k0 = pProto->getPatchSReacK(p, r);
+    pProto->setPatchSReacK(p, r, kf);
+    double ccst = pProto->pKProcs[kidx]->c();
+    pProto->setPatchSReacK(p, r, k0);
+    return ccst;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setCompReacK(std::string const & c, std::string const & r, double kf)
+{
+    uint kidx = _compReac(c, r);
+    double ccst = _compCcst(kidx, c, r, kf);
+    std::fill_n(pCcst.begin() + kidx * pNReps, pNReps, ccst);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setRepCompReacK(uint rep, std::string const & c,
+                                       std::string const & r, double kf)
+{
+    _checkRep(rep);
+    uint kidx = _compReac(c, r);
+    pCcst[kidx * pNReps + rep] = _compCcst(kidx, c, r, kf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setPatchSReacK(std::string const & p, std::string const & r, double kf)
+{
+    uint kidx = _patchSReac(p, r);
+    double ccst = _patchCcst(kidx, p, r, kf);
+    std::fill_n(pCcst.begin() + kidx * pNReps, pNReps, ccst);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmd::WmEnsemble::setRepPatchSReacK(uint rep, std::string const & p,
+                                         std::string const & r, double kf)
+{
+    _checkRep(rep);
+    uint kidx = _patchSReac(p, r);
+    pCcst[kidx * pNReps + rep] = _patchCcst(kidx, p, r, kf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// END
@@ -0,0 +1,255 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef STEPS_WMDIRECT_WMENSEMBLE_HPP
+#define STEPS_WMDIRECT_WMENSEMBLE_HPP 1
+
+// STL headers.
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+// STEPS headers.
+#include "../common.h"
+#include "../model/model.hpp"
+#include "../geom/geom.hpp"
+#include "../rng/rng.hpp"
+#include "wmdirect.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+START_NAMESPACE(steps)
+START_NAMESPACE(wmdirect)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Runs nreps independent replicates of one well-mixed model with the
+/// direct SSA, in lockstep: each pass draws the next event of every
+/// replicate that has not reached the end time.
+///
+/// The structure (species pools, reactions and their stoichiometry) is
+/// taken once from a prototype Wmdirect solver and shared. The state
+/// that differs between replicates, the counts, the scaled reaction
+/// constants, the propensities and the clocks, is stored replicate-major
+/// (element [i * nreps + rep]), so that the propensities of all
+/// replicates are computed in loops the compiler can vectorize and the
+/// random numbers of a pass are drawn in one batch.
+///
+/// Every replicate has its own clock during run(), but all of them stop
+/// at its end time, so between runs they share one time.
+///
+/// With setNThreads the replicates are split into contiguous blocks that
+/// are advanced in lockstep on their own threads, each block drawing from
+/// its own Philox generator seeded from the ensemble's RNG.
+///
+class WmEnsemble
+{
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////
+    // OBJECT CONSTRUCTION & DESTRUCTION
+    ////////////////////////////////////////////////////////////////////////
+
+    WmEnsemble(steps::model::Model * m, steps::wm::Geom * g,
+               steps::rng::RNG * r, uint nreps);
+    ~WmEnsemble(void);
+
+    uint getNReps(void) const
+    { return pNReps; }
+
+    ////////////////////////////////////////////////////////////////////////
+    // SIMULATION CONTROLS
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Set all counts to zero, all reaction constants to their values in
+    /// the model and the time to zero.
+    ///
+    void reset(void);
+
+    /// Advance all replicates to endtime.
+    ///
+    void run(double endtime);
+
+    /// Advance all replicates through the time points in tpnts (which
+    /// must be increasing and not before the current time), recording
+    /// at each of them.
+    ///
+    /// \return The recorded values in replicate, time point, record
+    ///         order: element [(i * tpnts.size() + j) * getNRecords() + k]
+    ///         is record k at tpnts[j] for replicate i.
+    ///
+    std::vector<double> runRecord(std::vector<double> const & tpnts);
+
+    double getTime(void) const
+    { return pTime; }
+
+    /// Advance the replicates in n blocks on n threads (default 1). The
+    /// block generators are seeded when this is called.
+    ///
+    void setNThreads(uint n);
+
+    uint getNThreads(void) const
+    { return pBlocks.size(); }
+
+    /// Return the number of events replicate rep executed since the last
+    /// reset.
+    ///
+    double getRepNSteps(uint rep) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // RECORDING
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Record the number of molecules of species s in compartment c.
+    ///
+    void addCompCountRecord(std::string const & c, std::string const & s);
+
+    /// Record the number of molecules of species s in patch p.
+    ///
+    void addPatchCountRecord(std::string const & p, std::string const & s);
+
+    uint getNRecords(void) const
+    { return pRecPool.size(); }
+
+    ////////////////////////////////////////////////////////////////////////
+    // STATE ACCESS
+    //      The methods without a replicate argument apply to all.
+    ////////////////////////////////////////////////////////////////////////
+
+    void setCompCount(std::string const & c, std::string const & s, double n);
+    void setRepCompCount(uint rep, std::string const & c, std::string const & s, double n);
+    double getRepCompCount(uint rep, std::string const & c, std::string const & s) const;
+
+    void setPatchCount(std::string const & p, std::string const & s, double n);
+    void setRepPatchCount(uint rep, std::string const & p, std::string const & s, double n);
+    double getRepPatchCount(uint rep, std::string const & p, std::string const & s) const;
+
+    /// Clamping is part of the shared structure.
+    ///
+    void setCompClamped(std::string const & c, std::string const & s, bool b);
+    void setPatchClamped(std::string const & p, std::string const & s, bool b);
+
+    void setCompReacK(std::string const & c, std::string const & r, double kf);
+    void setRepCompReacK(uint rep, std::string const & c, std::string const & r, double kf);
+
+    void setPatchSReacK(std::string const & p, std::string const & r, double kf);
+    void setRepPatchSReacK(uint rep, std::string const & p, std::string const & r, double kf);
+
+    ////////////////////////////////////////////////////////////////////////
+
+private:
+
+    ////////////////////////////////////////////////////////////////////////
+
+    uint _compPool(std::string const & c, std::string const & s) const;
+    uint _patchPool(std::string const & p, std::string const & s) const;
+    uint _compReac(std::string const & c, std::string const & r) const;
+    uint _patchSReac(std::string const & p, std::string const & r) const;
+
+    void _checkRep(uint rep) const;
+
+    // The scaled constant of kproc kidx, the kproc of reaction r in
+    // compartment c or of surface reaction r in patch p, for rate
+    // constant kf.
+    double _compCcst(uint kidx, std::string const & c, std::string const & r, double kf);
+    double _patchCcst(uint kidx, std::string const & p, std::string const & r, double kf);
+
+    void _setCount(uint rep, uint pool, double n);
+
+    struct Block
+    {
+        WmEnsemble                    * ensemble;
+        uint                            rbgn;
+        uint                            rend;
+        steps::rng::RNG               * rng;
+        double                          endtime;
+
+        // Replicates still running and the random numbers of a pass.
+        std::vector<uint>               live;
+        std::vector<double>             rand;
+    };
+
+    /// Thread entry point; advances one block.
+    ///
+    static void * _work(void * arg);
+
+    // Advance the replicates of block b to its endtime.
+    void _runBlock(Block & b);
+
+    // Compute the propensities of replicates [rbgn, rend) and their sums.
+    void _computeProps(uint rbgn, uint rend);
+
+    ////////////////////////////////////////////////////////////////////////
+
+    steps::rng::RNG                   * pRNG;
+    uint                                pNReps;
+
+    // Holds the structure; its own state is not used.
+    Wmdirect                          * pProto;
+
+    uint                                pNPools;
+    uint                                pNKProcs;
+    std::vector<uint>                   pCompPoolStart;
+    std::vector<uint>                   pPatchPoolStart;
+    std::vector<char>                   pClamped;
+
+    // Per kproc, in CSR form, its reactants and its changes.
+    std::vector<uint>                   pLhsStart;
+    std::vector<uint>                   pLhsPool;
+    std::vector<uint>                   pLhsN;
+    std::vector<uint>                   pUpdStart;
+    std::vector<uint>                   pUpdPool;
+    std::vector<double>                 pUpdN;
+
+    // Replicate-major state.
+    std::vector<double>                 pPools;
+    std::vector<double>                 pCcst;
+    std::vector<double>                 pProps;
+    std::vector<double>                 pA0;
+    std::vector<double>                 pRepTime;
+    std::vector<double>                 pRepNSteps;
+
+    std::vector<Block>                  pBlocks;
+    // Generators of the blocks when there is more than one.
+    std::vector<steps::rng::RNG *>      pBlockRNGs;
+
+    double                              pTime;
+
+    std::vector<uint>                   pRecPool;
+
+    ////////////////////////////////////////////////////////////////////////
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_NAMESPACE(wmdirect)
+END_NAMESPACE(steps)
+
+#endif
+// STEPS_WMDIRECT_WMENSEMBLE_HPP
+
+// END
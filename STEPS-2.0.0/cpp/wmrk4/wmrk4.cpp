@@ -30,6 +30,8 @@
 
 
 // Standard library & STL headers.
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
 #include <vector>
 #include <cassert>
@@ -48,6 +50,9 @@
 #include "../solver/patchdef.hpp"
 #include "../solver/reacdef.hpp"
 #include "../solver/sreacdef.hpp"
+
+#include "../../third_party/cvode-2.6.0/src/cvode/cvode_dense.h"
+#include "../../third_party/cvode-2.6.0/src/cvode/cvode_impl.h"
 #include "../solver/types.hpp"
 
 NAMESPACE_ALIAS(steps::wmrk4, swmrk4);
@@ -68,10 +73,66 @@ swmrk4::Wmrk4::Wmrk4(steps::model::Model * m, steps::wm::Geom * g, steps::rng::R
 , pNewVals()
 , pDyDx()
 , pDyDxlhs(0)
+, pLhsStart()
+, pLhsSpec()
+, pLhsOrder()
+, pUpdStart()
+, pUpdReac()
+, pUpdCoef()
+, pRates()
+, pLhsDeriv()
+, pStiff(false)
+, pCVodeMem(0)
+, pCVodeY(0)
+, pCVodeReinit(true)
+, pRedIndep()
+, pRedDep()
+, pRedStart()
+, pRedSpec()
+, pRedCoef()
+, pRedTotal()
+, pRedClamped()
+, pRedY()
+, pRedDyDx()
+, pRedJac(0)
 , pDT(0.0)
 , yt()
 , dyt()
 , dym()
+, pAdaptive(false)
+, pATol(WMRK4_DEFAULT_ATOL)
+, pRTol(WMRK4_DEFAULT_RTOL)
+, pAdaptDT(0.0)
+, pK2()
+, pK3()
+, pK4()
+, pK5()
+, pK6()
+, pK7()
+, pNDerivEvals(0.0)
+, pCcstUnit()
+, pSensReac()
+, pSens()
+, pSensNew()
+, pSensT()
+, pSensK(7)
+, pSensRates()
+, pCVodeNSens(0)
+, pCVodeATol(0)
+, pRedSens()
+, pRedSensDot()
+, pSensNewton(0)
+, pSensPiv(0)
+, pBatch(1)
+, pBatchVals()
+, pBatchK()
+, pBatchCcst()
+, pBatchNew()
+, pBatchDyDx()
+, pBatchYt()
+, pBatchDyt()
+, pBatchDym()
+, pBatchRates()
 {
 	assert (statedef() != 0);
 	assert (model() != 0);
@@ -126,6 +187,12 @@ swmrk4::Wmrk4::~Wmrk4(void)
 	delete[] pUpdMtx;
 	for (uint i=0; i< pSpecs_tot; ++i) delete[] pDyDxlhs[i];
 	delete[] pDyDxlhs;
+	if (pCVodeMem != 0) CVodeFree(&pCVodeMem);
+	if (pCVodeY != 0) N_VDestroy_Serial(pCVodeY);
+	if (pRedJac != 0) DestroyMat(pRedJac);
+	if (pCVodeATol != 0) N_VDestroy_Serial(pCVodeATol);
+	if (pSensNewton != 0) DestroyMat(pSensNewton);
+	if (pSensPiv != 0) DestroyArray(pSensPiv);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -168,6 +235,8 @@ void swmrk4::Wmrk4::reset(void)
 	statedef()->resetTime();
 	// recompute flags and counts vectors in Wmrk4 object
 	_refill();
+	std::fill(pSens.begin(), pSens.end(), 0.0);
+	if (pBatch > 1) _batchFromState();
 
 }
 
@@ -220,6 +289,418 @@ void swmrk4::Wmrk4::setRk4DT(double dt)
 		throw steps::ArgErr(os.str());
 	}
 	pDT = dt;
+	pAdaptDT = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::setAdaptive(bool adapt)
+{
+	pAdaptive = adapt;
+	pAdaptDT = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::setTolerances(double atol, double rtol)
+{
+	if (atol < 0.0 || rtol < 0.0 || (atol == 0.0 && rtol == 0.0))
+	{
+		std::ostringstream os;
+		os << "Tolerances cannot be negative and cannot both be zero.";
+		throw steps::ArgErr(os.str());
+	}
+	pATol = atol;
+	pRTol = rtol;
+	pCVodeReinit = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::setStiff(bool stiff)
+{
+	pStiff = stiff;
+	pCVodeReinit = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::addCompReacSensitivity(std::string const & c,
+	std::string const & r)
+{
+	return _addSensitivity(_compReacIdx(c, r));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::addPatchSReacSensitivity(std::string const & p,
+	std::string const & sr)
+{
+	return _addSensitivity(_patchSReacIdx(p, sr));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::_addSensitivity(uint r)
+{
+	assert(r < pReacs_tot);
+	if (std::find(pSensReac.begin(), pSensReac.end(), r) != pSensReac.end())
+	{
+		std::ostringstream os;
+		os << "Sensitivities to this rate constant are already integrated.";
+		throw steps::ArgErr(os.str());
+	}
+
+	pSensReac.push_back(r);
+	uint len = pSensReac.size() * pSpecs_tot;
+	pSens.resize(len, 0.0);
+	pSensNew.resize(len, 0.0);
+	pSensT.resize(len, 0.0);
+	for (uint k=0; k< pSensK.size(); ++k) pSensK[k].resize(len, 0.0);
+	pSensRates.resize(pReacs_tot, 0.0);
+	pRedSens.resize(len, 0.0);
+	pRedSensDot.resize(len, 0.0);
+	pCVodeReinit = true;
+	return pSensReac.size() - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::clearSensitivities(void)
+{
+	pSensReac.clear();
+	pSens.clear();
+	pSensNew.clear();
+	pSensT.clear();
+	for (uint k=0; k< pSensK.size(); ++k) pSensK[k].clear();
+	pRedSens.clear();
+	pRedSensDot.clear();
+	pCVodeReinit = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmrk4::Wmrk4::getCompSensitivity(std::string const & c,
+	std::string const & s, uint param) const
+{
+	uint idx = _compSpecIdx(c, s);
+	if (param >= pSensReac.size())
+	{
+		std::ostringstream os;
+		os << "Sensitivity parameter index out of range.";
+		throw steps::ArgErr(os.str());
+	}
+	return pSens[param * pSpecs_tot + idx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmrk4::Wmrk4::getPatchSensitivity(std::string const & p,
+	std::string const & s, uint param) const
+{
+	uint idx = _patchSpecIdx(p, s);
+	if (param >= pSensReac.size())
+	{
+		std::ostringstream os;
+		os << "Sensitivity parameter index out of range.";
+		throw steps::ArgErr(os.str());
+	}
+	return pSens[param * pSpecs_tot + idx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_zeroSens(uint n)
+{
+	uint nsens = pSensReac.size();
+	for (uint p=0; p< nsens; ++p) pSens[p * pSpecs_tot + n] = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::setBatchSize(uint nsets)
+{
+	if (nsets == 0)
+	{
+		std::ostringstream os;
+		os << "A batch needs at least one set.";
+		throw steps::ArgErr(os.str());
+	}
+	pBatch = nsets;
+	_batchFromState();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_batchFromState(void)
+{
+	uint nb = pBatch;
+	pBatchVals.resize(pSpecs_tot * nb);
+	pBatchK.resize(pReacs_tot * nb);
+	for (uint n=0; n< pSpecs_tot; ++n)
+	{
+		std::fill_n(&pBatchVals[n * nb], nb, pVals[n]);
+	}
+	for (uint r=0; r< pReacs_tot; ++r)
+	{
+		std::fill_n(&pBatchK[r * nb], nb, pCcst[r] / pCcstUnit[r]);
+	}
+
+	pBatchCcst.assign(pReacs_tot * nb, 0.0);
+	pBatchRates.assign(pReacs_tot * nb, 0.0);
+	pBatchNew.assign(pSpecs_tot * nb, 0.0);
+	pBatchDyDx.assign(pSpecs_tot * nb, 0.0);
+	pBatchYt.assign(pSpecs_tot * nb, 0.0);
+	pBatchDyt.assign(pSpecs_tot * nb, 0.0);
+	pBatchDym.assign(pSpecs_tot * nb, 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmrk4::Wmrk4::getBatchCompCount(uint b, std::string const & c,
+	std::string const & s) const
+{
+	uint idx = _compSpecIdx(c, s);
+	_checkBatchSet(b);
+	if (b == 0) return pVals[idx];
+	return pBatchVals[idx * pBatch + b];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::setBatchCompCount(uint b, std::string const & c,
+	std::string const & s, double n)
+{
+	uint idx = _compSpecIdx(c, s);
+	_checkBatchSet(b);
+	if (b == 0)
+	{
+		setCompCount(c, s, n);
+		return;
+	}
+	if (n < 0.0)
+	{
+		std::ostringstream os;
+		os << "Count cannot be negative.";
+		throw steps::ArgErr(os.str());
+	}
+	pBatchVals[idx * pBatch + b] = n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmrk4::Wmrk4::getBatchPatchCount(uint b, std::string const & p,
+	std::string const & s) const
+{
+	uint idx = _patchSpecIdx(p, s);
+	_checkBatchSet(b);
+	if (b == 0) return pVals[idx];
+	return pBatchVals[idx * pBatch + b];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::setBatchPatchCount(uint b, std::string const & p,
+	std::string const & s, double n)
+{
+	uint idx = _patchSpecIdx(p, s);
+	_checkBatchSet(b);
+	if (b == 0)
+	{
+		setPatchCount(p, s, n);
+		return;
+	}
+	if (n < 0.0)
+	{
+		std::ostringstream os;
+		os << "Count cannot be negative.";
+		throw steps::ArgErr(os.str());
+	}
+	pBatchVals[idx * pBatch + b] = n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmrk4::Wmrk4::getBatchCompReacK(uint b, std::string const & c,
+	std::string const & r) const
+{
+	uint idx = _compReacIdx(c, r);
+	_checkBatchSet(b);
+	if (b == 0) return getCompReacK(c, r);
+	return pBatchK[idx * pBatch + b];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::setBatchCompReacK(uint b, std::string const & c,
+	std::string const & r, double kf)
+{
+	uint idx = _compReacIdx(c, r);
+	_checkBatchSet(b);
+	if (b == 0)
+	{
+		setCompReacK(c, r, kf);
+		return;
+	}
+	if (kf < 0.0)
+	{
+		std::ostringstream os;
+		os << "Reaction constant cannot be negative.";
+		throw steps::ArgErr(os.str());
+	}
+	pBatchK[idx * pBatch + b] = kf;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmrk4::Wmrk4::getBatchPatchSReacK(uint b, std::string const & p,
+	std::string const & sr) const
+{
+	uint idx = _patchSReacIdx(p, sr);
+	_checkBatchSet(b);
+	if (b == 0) return getPatchSReacK(p, sr);
+	return pBatchK[idx * pBatch + b];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::setBatchPatchSReacK(uint b, std::string const & p,
+	std::string const & sr, double kf)
+{
+	uint idx = _patchSReacIdx(p, sr);
+	_checkBatchSet(b);
+	if (b == 0)
+	{
+		setPatchSReacK(p, sr, kf);
+		return;
+	}
+	if (kf < 0.0)
+	{
+		std::ostringstream os;
+		os << "Reaction constant cannot be negative.";
+		throw steps::ArgErr(os.str());
+	}
+	pBatchK[idx * pBatch + b] = kf;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_checkBatchSet(uint b) const
+{
+	if (b >= pBatch)
+	{
+		std::ostringstream os;
+		os << "Batch set index out of range.";
+		throw steps::ArgErr(os.str());
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::_compSpecIdx(uint cidx, uint slidx) const
+{
+	uint idx = slidx;
+	for (uint i=0; i< cidx; ++i) idx += statedef()->compdef(i)->countSpecs();
+	return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::_patchSpecIdx(uint pidx, uint slidx) const
+{
+	uint idx = slidx;
+	uint ncomps = statedef()->countComps();
+	for (uint i=0; i< ncomps; ++i) idx += statedef()->compdef(i)->countSpecs();
+	for (uint i=0; i< pidx; ++i) idx += statedef()->patchdef(i)->countSpecs();
+	return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::_compReacIdx(uint cidx, uint lridx) const
+{
+	uint idx = lridx;
+	for (uint i=0; i< cidx; ++i) idx += statedef()->compdef(i)->countReacs();
+	return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::_patchSReacIdx(uint pidx, uint lsridx) const
+{
+	uint idx = lsridx;
+	uint ncomps = statedef()->countComps();
+	for (uint i=0; i< ncomps; ++i) idx += statedef()->compdef(i)->countReacs();
+	for (uint i=0; i< pidx; ++i) idx += statedef()->patchdef(i)->countSReacs();
+	return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::_compSpecIdx(std::string const & c,
+	std::string const & s) const
+{
+	uint cidx = statedef()->getCompIdx(c);
+	uint sidx = statedef()->getSpecIdx(s);
+	uint slidx = statedef()->compdef(cidx)->specG2L(sidx);
+	if (slidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _compSpecIdx(cidx, slidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::_patchSpecIdx(std::string const & p,
+	std::string const & s) const
+{
+	uint pidx = statedef()->getPatchIdx(p);
+	uint sidx = statedef()->getSpecIdx(s);
+	uint slidx = statedef()->patchdef(pidx)->specG2L(sidx);
+	if (slidx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Species undefined in patch.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _patchSpecIdx(pidx, slidx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::_compReacIdx(std::string const & c,
+	std::string const & r) const
+{
+	uint cidx = statedef()->getCompIdx(c);
+	uint ridx = statedef()->getReacIdx(r);
+	uint lridx = statedef()->compdef(cidx)->reacG2L(ridx);
+	if (lridx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Reaction undefined in compartment.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _compReacIdx(cidx, lridx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint swmrk4::Wmrk4::_patchSReacIdx(std::string const & p,
+	std::string const & sr) const
+{
+	uint pidx = statedef()->getPatchIdx(p);
+	uint sridx = statedef()->getSReacIdx(sr);
+	uint lsridx = statedef()->patchdef(pidx)->sreacG2L(sridx);
+	if (lsridx == ssolver::LIDX_UNDEFINED)
+	{
+		std::ostringstream os;
+		os << "Surface reaction undefined in patch.\n";
+		throw steps::ArgErr(os.str());
+	}
+	return _patchSReacIdx(pidx, lsridx);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -327,6 +808,10 @@ void swmrk4::Wmrk4::restore(std::string const & file_name)
 	statedef()->restore(cp_file);
 
     cp_file.close();
+
+    // Sensitivities are not checkpointed; they restart from the restored
+    // state.
+    std::fill(pSens.begin(), pSens.end(), 0.0);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -389,6 +874,7 @@ void swmrk4::Wmrk4::_setCompCount(uint cidx, uint sidx, double n)
 	comp->setCount(slidx, n);
 	// easier to recompute all counts with _refill method
 	_refill();					/// may be a better way of doing this
+	_zeroSens(_compSpecIdx(cidx, slidx));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -617,6 +1103,7 @@ void swmrk4::Wmrk4::_setPatchCount(uint pidx, uint sidx, double n)
 	patch->setCount(slidx, n);
 	// easier to recompute all counts with _refill method
 	_refill();
+	_zeroSens(_patchSpecIdx(pidx, slidx));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -828,6 +1315,12 @@ void swmrk4::Wmrk4::_setup(void)
 		yt.push_back(0.0);
 		dyt.push_back(0.0);
 		dym.push_back(0.0);
+		pK2.push_back(0.0);
+		pK3.push_back(0.0);
+		pK4.push_back(0.0);
+		pK5.push_back(0.0);
+		pK6.push_back(0.0);
+		pK7.push_back(0.0);
 	}
 
 	/// fill the reaction matrix
@@ -953,12 +1446,56 @@ void swmrk4::Wmrk4::_setup(void)
 	}
 
 	assert (pCcst.size() == pReacs_tot);
+
+	_buildStoich();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_buildStoich(void)
+{
+	pLhsStart.assign(1, 0);
+	pLhsSpec.clear();
+	pLhsOrder.clear();
+	for (uint r=0; r< pReacs_tot; ++r)
+	{
+		for (uint i=0; i< pSpecs_tot; ++i)
+		{
+			uint lhs = pReacMtx[r][i];
+			if (lhs == 0) continue;
+			/// allow maximum 4 molecules of one species in reaction
+			assert(lhs <= 4);
+			pLhsSpec.push_back(i);
+			pLhsOrder.push_back(lhs);
+		}
+		pLhsStart.push_back(pLhsSpec.size());
+	}
+
+	pUpdStart.assign(1, 0);
+	pUpdReac.clear();
+	pUpdCoef.clear();
+	for (uint n=0; n< pSpecs_tot; ++n)
+	{
+		for (uint r=0; r< pReacs_tot; ++r)
+		{
+			int upd = pUpdMtx[r][n];
+			if (upd == 0) continue;
+			pUpdReac.push_back(r);
+			pUpdCoef.push_back(static_cast<double>(upd));
+		}
+		pUpdStart.push_back(pUpdReac.size());
+	}
+
+	pRates.assign(pReacs_tot, 0.0);
+	pLhsDeriv.assign(pLhsSpec.size(), 0.0);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void swmrk4::Wmrk4::_refill(void)
 {
+	pCVodeReinit = true;
+
 	uint Comps_N = statedef()->countComps();
 	uint Patches_N = statedef()->countPatches();
 	assert (Comps_N > 0);
@@ -1015,12 +1552,15 @@ void swmrk4::Wmrk4::_refill(void)
 
 void swmrk4::Wmrk4::_refillCcst(void)
 {
+	pCVodeReinit = true;
+
 	uint Comps_N = statedef()->countComps();
 	uint Patches_N = statedef()->countPatches();
 	assert (Comps_N > 0);
 
 	// simplest to reset Ccst vector
 	pCcst = std::vector<double>();
+	pCcstUnit = std::vector<double>();
 
 	for (uint i=0; i< Comps_N; ++i)
 	{
@@ -1036,6 +1576,7 @@ void swmrk4::Wmrk4::_refillCcst(void)
 			double comp_vol = statedef()->compdef(i)->vol();
 			uint reac_order = statedef()->compdef(i)->reacdef(j)->order();
 			pCcst.push_back(_ccst(reac_kcst, comp_vol, reac_order));
+			pCcstUnit.push_back(_ccst(1.0, comp_vol, reac_order));
 		}
 	}
 
@@ -1070,6 +1611,7 @@ void swmrk4::Wmrk4::_refillCcst(void)
 				double sreac_kcst = statedef()->patchdef(i)->kcst(j);
 				uint sreac_order = statedef()->patchdef(i)->sreacdef(j)->order();
 				pCcst.push_back(_ccst(sreac_kcst, vol, sreac_order));
+				pCcstUnit.push_back(_ccst(1.0, vol, sreac_order));
 				}
 			else
 			{
@@ -1078,70 +1620,76 @@ void swmrk4::Wmrk4::_refillCcst(void)
 				double sreac_kcst = statedef()->patchdef(i)->kcst(j);
 				uint sreac_order = statedef()->patchdef(i)->sreacdef(j)->order();
 				pCcst.push_back(_ccst2D(sreac_kcst, area, sreac_order));
+				pCcstUnit.push_back(_ccst2D(1.0, area, sreac_order));
 			}
 		}
 	}
 
 	assert (pCcst.size() == pReacs_tot);
+	assert (pCcstUnit.size() == pReacs_tot);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void swmrk4::Wmrk4::_setderivs(dVec & vals, dVec & dydx)
 {
-	for (uint n=0; n< pSpecs_tot; ++n)
+	_derivs(&vals.front(), &dydx.front());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_derivs(double const * v, double * dydx)
+{
+	pNDerivEvals += 1.0;
+
+	// This assumes correct reaction rate constant e.g unimolecular second order
+	// reaction A+A--k->B
+	// d[A]/dt = -2k[A]^2
+	uint const * lhs_spec = pLhsSpec.empty() ? 0 : &pLhsSpec.front();
+	uint const * lhs_order = pLhsOrder.empty() ? 0 : &pLhsOrder.front();
+	for (uint r=0; r< pReacs_tot; ++r)
 	{
-		for(uint r=0; r< pReacs_tot; ++r)
+		/// check reaction flags
+		if (pRFlags[r] & Statedef::INACTIVE_REACFLAG)
+		{
+			pRates[r] = 0.0;
+			continue;
+		}
+
+		double rate = pCcst[r];
+		uint lhs_end = pLhsStart[r + 1];
+		for (uint l = pLhsStart[r]; l < lhs_end; ++l)
 		{
-			/// check reaction flags
-			if (pRFlags[r] & Statedef::INACTIVE_REACFLAG)						/////////
+			double val = v[lhs_spec[l]];
+			double dydx_lhs_temp = val;
+			switch (lhs_order[l])
 			{
-				pDyDxlhs[n][r] = 0.0;
-				continue;
-			}
-
-			if (pUpdMtx[r][n] == 0)
-			{
-				pDyDxlhs[n][r] = 0.0;
-				continue;
-			}
-
-			// This assumes correct reaction rate constant e.g unimolecular second order
-			// reaction A+A--k->B
-			// d[A]/dt = -2k[A]^2
-			pDyDxlhs[n][r] = pUpdMtx[r][n] * pCcst[r];
-			for (uint i=0; i < pSpecs_tot; ++i)
-			{
-				double dydx_lhs_temp = 1.0;
-				double val = vals[i];
-				switch (pReacMtx[r][i])
-				{
-					case 4: dydx_lhs_temp *= val;
-					case 3: dydx_lhs_temp *= val;
-					case 2: dydx_lhs_temp *= val;
-					case 1: dydx_lhs_temp *= val;
-					case 0: break;
-					/// allow maximum 4 molecules of one species in reaction
-					default: assert(0);
-				}
-				pDyDxlhs[n][r] *= dydx_lhs_temp;
+				case 4: dydx_lhs_temp *= val;
+				case 3: dydx_lhs_temp *= val;
+				case 2: dydx_lhs_temp *= val;
+				default: break;
 			}
+			rate *= dydx_lhs_temp;
 		}
+		pRates[r] = rate;
 	}
 
+	double const * rates = &pRates.front();
+	uint const * upd_reac = pUpdReac.empty() ? 0 : &pUpdReac.front();
+	double const * upd_coef = pUpdCoef.empty() ? 0 : &pUpdCoef.front();
 	for (uint n=0; n< pSpecs_tot; ++n)
 	{
-		dydx[n] = 0.0;
+		double d = 0.0;
 		// If species is clamped the dy/dx is zero:
-		if (pSFlags[n] & Statedef::CLAMPED_POOLFLAG)
-		{
-			continue;
-		}
-
-		for (uint r=0; r< pReacs_tot; ++r)
+		if ((pSFlags[n] & Statedef::CLAMPED_POOLFLAG) == 0)
 		{
-			dydx[n] += pDyDxlhs[n][r];
+			uint upd_end = pUpdStart[n + 1];
+			for (uint k = pUpdStart[n]; k < upd_end; ++k)
+			{
+				d += upd_coef[k] * rates[upd_reac[k]];
+			}
 		}
+		dydx[n] = d;
 	}
 }
 
@@ -1149,23 +1697,45 @@ void swmrk4::Wmrk4::_setderivs(dVec & vals, dVec & dydx)
 
 void swmrk4::Wmrk4::_rk4(double pdt)
 {
+	// The sensitivities take the same stages, at the same stage states.
+	static const double sa2[] = { 0.5 };
+	static const double sa3[] = { 0.0, 0.5 };
+	static const double sa4[] = { 0.0, 0.0, 1.0 };
+	static const double sb[] = { 1.0/6.0, 1.0/3.0, 1.0/3.0, 1.0/6.0 };
+	bool sens = (pSensReac.empty() == false);
+
 	double dt_2 = pdt/2.0;
 	double dt_6 = pdt/6.0;
 
+	if (sens == true) _sensStage(0, pdt, 0, &pVals.front());
 	for(uint i=0; i< pSpecs_tot; ++i) yt[i] = pVals[i] + (dt_2 * pDyDx[i]);
 	_setderivs(yt, dyt);
+	if (sens == true) _sensStage(1, pdt, sa2, &yt.front());
 	for(uint i =0; i< pSpecs_tot; ++i) yt[i]= pVals[i] + (dt_2 * dyt[i]);
 	_setderivs(yt, dym);
+	if (sens == true) _sensStage(2, pdt, sa3, &yt.front());
 	for (uint i=0; i< pSpecs_tot; ++i)
 	{
 		yt[i] = pVals[i] + (pdt * dym[i]);
 		dym[i] += dyt[i];
 	}
 	_setderivs(yt, dyt);
+	if (sens == true) _sensStage(3, pdt, sa4, &yt.front());
 	for (uint i=0; i< pSpecs_tot; ++i)
 	{
 		pNewVals[i]=pVals[i]+dt_6*(pDyDx[i]+dyt[i]+(2.0*dym[i]));
 	}
+
+	if (sens == true)
+	{
+		uint len = pSens.size();
+		for (uint i=0; i< len; ++i)
+		{
+			pSensNew[i] = pSens[i] + pdt * (sb[0] * pSensK[0][i]
+				+ sb[1] * pSensK[1][i] + sb[2] * pSensK[2][i]
+				+ sb[3] * pSensK[3][i]);
+		}
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1174,6 +1744,21 @@ void swmrk4::Wmrk4::_rksteps(double t1, double t2)
 {
 	if (t1 == t2) return;
 	assert(t1 < t2);
+	if (pBatch > 1)
+	{
+		_rkbatch(t1, t2);
+		return;
+	}
+	if (pStiff == true)
+	{
+		_bdfsteps(t1, t2);
+		return;
+	}
+	if (pAdaptive == true)
+	{
+		_rkadapt(t1, t2);
+		return;
+	}
 	double t = t1;
 	if (pDT <= 0.0)
 	{
@@ -1221,9 +1806,1038 @@ void swmrk4::Wmrk4::_rksteps(double t1, double t2)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void swmrk4::Wmrk4::_rkbatch(double t1, double t2)
+{
+	if (pStiff == true || pAdaptive == true || pSensReac.empty() == false)
+	{
+		std::ostringstream os;
+		os << "Batched integration needs the fixed step method and no ";
+		os << "sensitivities.";
+		throw steps::ArgErr(os.str());
+	}
+	if (pDT <= 0.0)
+	{
+		std::ostringstream os;
+		os << "dt is zero or negative. Call setDT() method.";
+		throw steps::ArgErr(os.str());
+	}
+	if (pDT >= (t2-t1))
+	{
+		std::ostringstream os;
+		os << "dt is larger than simulation step.";
+		throw steps::ArgErr(os.str());
+	}
+
+	// Set 0 is the solver's own state and rate constants.
+	uint nb = pBatch;
+	for (uint n=0; n< pSpecs_tot; ++n) pBatchVals[n * nb] = pVals[n];
+	for (uint r=0; r< pReacs_tot; ++r)
+	{
+		double * ccst = &pBatchCcst[r * nb];
+		double const * kcst = &pBatchK[r * nb];
+		ccst[0] = pCcst[r];
+		for (uint b=1; b< nb; ++b) ccst[b] = kcst[b] * pCcstUnit[r];
+	}
+
+	// The same steps as _rksteps, ending with the fraction left.
+	double t = t1;
+	while(t < t2)
+	{
+		if ((t+pDT) > t2) break;
+
+		_derivsbatch(&pBatchVals.front(), &pBatchDyDx.front());
+		_rk4batch(pDT);
+		t += pDT;
+	}
+	double tfrac = t2-t;
+	assert (tfrac >= 0.0);
+	if (tfrac != 0.0)
+	{
+		assert (tfrac < pDT);
+		_derivsbatch(&pBatchVals.front(), &pBatchDyDx.front());
+		_rk4batch(tfrac);
+	}
+
+	for (uint n=0; n< pSpecs_tot; ++n) pNewVals[n] = pBatchVals[n * nb];
+	_update();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_rk4batch(double pdt)
+{
+	// As _rk4, over every species of every set; clamped species have no
+	// derivatives, so only the clipping of _update() is left to do.
+	uint len = pSpecs_tot * pBatch;
+	double dt_2 = pdt/2.0;
+	double dt_6 = pdt/6.0;
+	double * y = &pBatchVals.front();
+	double const * dydx = &pBatchDyDx.front();
+	double * yt = &pBatchYt.front();
+	double * dyt = &pBatchDyt.front();
+	double * dym = &pBatchDym.front();
+
+	for (uint i=0; i< len; ++i) yt[i] = y[i] + (dt_2 * dydx[i]);
+	_derivsbatch(yt, dyt);
+	for (uint i=0; i< len; ++i) yt[i] = y[i] + (dt_2 * dyt[i]);
+	_derivsbatch(yt, dym);
+	for (uint i=0; i< len; ++i)
+	{
+		yt[i] = y[i] + (pdt * dym[i]);
+		dym[i] += dyt[i];
+	}
+	_derivsbatch(yt, dyt);
+	for (uint i=0; i< len; ++i)
+	{
+		double newval = y[i]+dt_6*(dydx[i]+dyt[i]+(2.0*dym[i]));
+		y[i] = (newval < 0.0) ? 0.0 : newval;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_derivsbatch(double const * v, double * dydx)
+{
+	uint nb = pBatch;
+	pNDerivEvals += nb;
+
+	// As _derivs, with the set loop innermost.
+	for (uint r=0; r< pReacs_tot; ++r)
+	{
+		double * rate = &pBatchRates[r * nb];
+		if (pRFlags[r] & Statedef::INACTIVE_REACFLAG)
+		{
+			std::fill_n(rate, nb, 0.0);
+			continue;
+		}
+
+		double const * ccst = &pBatchCcst[r * nb];
+		for (uint b=0; b< nb; ++b) rate[b] = ccst[b];
+		uint lhs_end = pLhsStart[r + 1];
+		for (uint l = pLhsStart[r]; l < lhs_end; ++l)
+		{
+			double const * val = v + pLhsSpec[l] * nb;
+			switch (pLhsOrder[l])
+			{
+				case 4:
+					for (uint b=0; b< nb; ++b) rate[b] *= val[b] * val[b] * val[b] * val[b];
+					break;
+				case 3:
+					for (uint b=0; b< nb; ++b) rate[b] *= val[b] * val[b] * val[b];
+					break;
+				case 2:
+					for (uint b=0; b< nb; ++b) rate[b] *= val[b] * val[b];
+					break;
+				default:
+					for (uint b=0; b< nb; ++b) rate[b] *= val[b];
+					break;
+			}
+		}
+	}
+
+	double const * rates = &pBatchRates.front();
+	for (uint n=0; n< pSpecs_tot; ++n)
+	{
+		double * d = dydx + n * nb;
+		std::fill_n(d, nb, 0.0);
+		if (pSFlags[n] & Statedef::CLAMPED_POOLFLAG) continue;
+
+		uint upd_end = pUpdStart[n + 1];
+		for (uint k = pUpdStart[n]; k < upd_end; ++k)
+		{
+			double coef = pUpdCoef[k];
+			double const * rr = rates + pUpdReac[k] * nb;
+			for (uint b=0; b< nb; ++b) d[b] += coef * rr[b];
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_rkadapt(double t1, double t2)
+{
+	// Dormand-Prince 5(4) coefficients (Hairer, Norsett & Wanner, Solving
+	// Ordinary Differential Equations I, 2nd ed.). The 5th order solution is
+	// propagated; the last stage is evaluated at the new point, so it is
+	// reused as the first stage of the next step.
+	static const double a21 = 1.0/5.0;
+	static const double a31 = 3.0/40.0, a32 = 9.0/40.0;
+	static const double a41 = 44.0/45.0, a42 = -56.0/15.0, a43 = 32.0/9.0;
+	static const double a51 = 19372.0/6561.0, a52 = -25360.0/2187.0,
+		a53 = 64448.0/6561.0, a54 = -212.0/729.0;
+	static const double a61 = 9017.0/3168.0, a62 = -355.0/33.0,
+		a63 = 46732.0/5247.0, a64 = 49.0/176.0, a65 = -5103.0/18656.0;
+	static const double b1 = 35.0/384.0, b3 = 500.0/1113.0, b4 = 125.0/192.0,
+		b5 = -2187.0/6784.0, b6 = 11.0/84.0;
+	static const double e1 = 71.0/57600.0, e3 = -71.0/16695.0,
+		e4 = 71.0/1920.0, e5 = -17253.0/339200.0, e6 = 22.0/525.0,
+		e7 = -1.0/40.0;
+
+	// The same tableau by rows, for the sensitivity stages; the last
+	// stage is at the new point, so its stage state is the new value.
+	static const double sa2[] = { a21 };
+	static const double sa3[] = { a31, a32 };
+	static const double sa4[] = { a41, a42, a43 };
+	static const double sa5[] = { a51, a52, a53, a54 };
+	static const double sa6[] = { a61, a62, a63, a64, a65 };
+	static const double sa7[] = { b1, 0.0, b3, b4, b5, b6 };
+
+	uint n = pSpecs_tot;
+	uint nsens = pSensReac.size();
+	bool sens = (nsens != 0);
+	double t = t1;
+
+	_setderivs(pVals, pDyDx);
+	if (sens == true) _sensStage(0, 0.0, 0, &pVals.front());
+
+	double h = pAdaptDT;
+	if (h <= 0.0)
+	{
+		if (pDT > 0.0)
+		{
+			h = pDT;
+		}
+		else
+		{
+			// Starting step such that the explicit Euler increment is
+			// about 1% of the solution, measured in the error norm.
+			double d0 = 0.0;
+			double d1 = 0.0;
+			for (uint i = 0; i < n; ++i)
+			{
+				double sc = pATol + pRTol * fabs(pVals[i]);
+				d0 += (pVals[i] / sc) * (pVals[i] / sc);
+				d1 += (pDyDx[i] / sc) * (pDyDx[i] / sc);
+			}
+			d0 = sqrt(d0 / n);
+			d1 = sqrt(d1 / n);
+			if (d0 < 1.0e-5 || d1 < 1.0e-5) h = 1.0e-6 * (t2 - t1);
+			else h = 0.01 * d0 / d1;
+		}
+	}
+
+	while (t < t2)
+	{
+		// Land exactly on t2, but remember the proposed step.
+		double hprop = h;
+		bool last = false;
+		if (t + h >= t2)
+		{
+			h = t2 - t;
+			last = true;
+		}
+		if (h <= (fabs(t) + h) * DBL_EPSILON * 16.0)
+		{
+			std::ostringstream os;
+			os << "Adaptive Runge-Kutta step size underflow at t = " << t;
+			os << "; tolerances may be too strict.";
+			throw steps::ProgErr(os.str());
+		}
+
+		for (uint i = 0; i < n; ++i)
+			yt[i] = pVals[i] + h*a21*pDyDx[i];
+		_setderivs(yt, pK2);
+		if (sens == true) _sensStage(1, h, sa2, &yt.front());
+		for (uint i = 0; i < n; ++i)
+			yt[i] = pVals[i] + h*(a31*pDyDx[i] + a32*pK2[i]);
+		_setderivs(yt, pK3);
+		if (sens == true) _sensStage(2, h, sa3, &yt.front());
+		for (uint i = 0; i < n; ++i)
+			yt[i] = pVals[i] + h*(a41*pDyDx[i] + a42*pK2[i] + a43*pK3[i]);
+		_setderivs(yt, pK4);
+		if (sens == true) _sensStage(3, h, sa4, &yt.front());
+		for (uint i = 0; i < n; ++i)
+			yt[i] = pVals[i] + h*(a51*pDyDx[i] + a52*pK2[i] + a53*pK3[i]
+				+ a54*pK4[i]);
+		_setderivs(yt, pK5);
+		if (sens == true) _sensStage(4, h, sa5, &yt.front());
+		for (uint i = 0; i < n; ++i)
+			yt[i] = pVals[i] + h*(a61*pDyDx[i] + a62*pK2[i] + a63*pK3[i]
+				+ a64*pK4[i] + a65*pK5[i]);
+		_setderivs(yt, pK6);
+		if (sens == true) _sensStage(5, h, sa6, &yt.front());
+		for (uint i = 0; i < n; ++i)
+			pNewVals[i] = pVals[i] + h*(b1*pDyDx[i] + b3*pK3[i] + b4*pK4[i]
+				+ b5*pK5[i] + b6*pK6[i]);
+		_setderivs(pNewVals, pK7);
+		if (sens == true)
+		{
+			_sensStage(6, h, sa7, &pNewVals.front());
+			pSensNew.swap(pSensT);
+		}
+
+		// Scaled RMS norm of the embedded error estimate.
+		double err = 0.0;
+		for (uint i = 0; i < n; ++i)
+		{
+			double ei = h*(e1*pDyDx[i] + e3*pK3[i] + e4*pK4[i] + e5*pK5[i]
+				+ e6*pK6[i] + e7*pK7[i]);
+			double sc = pATol + pRTol * std::max(fabs(pVals[i]), fabs(pNewVals[i]));
+			err += (ei / sc) * (ei / sc);
+		}
+		// The sensitivities are part of the error test, as in CVODES with
+		// the sensitivity error control on.
+		for (uint p = 0; p < nsens; ++p)
+		{
+			double atol = _sensATol(p);
+			for (uint i = p * n; i < (p + 1) * n; ++i)
+			{
+				double ei = h*(e1*pSensK[0][i] + e3*pSensK[2][i]
+					+ e4*pSensK[3][i] + e5*pSensK[4][i] + e6*pSensK[5][i]
+					+ e7*pSensK[6][i]);
+				double sc = atol + pRTol * std::max(fabs(pSens[i]), fabs(pSensNew[i]));
+				err += (ei / sc) * (ei / sc);
+			}
+		}
+		err = sqrt(err / (n * (1 + nsens)));
+
+		double fac;
+		if (err == 0.0) fac = 5.0;
+		else fac = std::min(5.0, std::max(0.2, 0.9 * pow(err, -0.2)));
+
+		if (err > 1.0)
+		{
+			// Reject and retry with a smaller step.
+			h *= std::min(1.0, fac);
+			continue;
+		}
+
+		// Accept. The last stage is the derivative at the new point, unless
+		// _update() clips negative counts.
+		bool clipped = false;
+		for (uint i = 0; i < n; ++i)
+		{
+			if (pNewVals[i] < 0.0) clipped = true;
+		}
+		_update();
+		t = (last == true) ? t2 : t + h;
+		if (clipped == true)
+		{
+			_setderivs(pVals, pDyDx);
+			if (sens == true) _sensStage(0, 0.0, 0, &pVals.front());
+		}
+		else
+		{
+			pDyDx.swap(pK7);
+			if (sens == true) pSensK[0].swap(pSensK[6]);
+		}
+
+		if (last == true) h = std::max(hprop, h);
+		h *= fac;
+	}
+
+	pAdaptDT = h;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_lhsDerivs(double const * v)
+{
+	// Partial derivatives of each reaction rate with respect to each of
+	// its reactants, d/dy_l (c * prod_m y_m^o_m) = c * o_l * y_l^(o_l-1)
+	// * prod_{m != l} y_m^o_m.
+	for (uint r=0; r< pReacs_tot; ++r)
+	{
+		uint lhs_bgn = pLhsStart[r];
+		uint lhs_end = pLhsStart[r + 1];
+		bool active = ((pRFlags[r] & Statedef::INACTIVE_REACFLAG) == 0);
+		for (uint l = lhs_bgn; l < lhs_end; ++l)
+		{
+			if (active == false)
+			{
+				pLhsDeriv[l] = 0.0;
+				continue;
+			}
+			double d = pCcst[r];
+			for (uint m = lhs_bgn; m < lhs_end; ++m)
+			{
+				double val = v[pLhsSpec[m]];
+				uint order = pLhsOrder[m];
+				if (m == l)
+				{
+					d *= order;
+					--order;
+				}
+				for (uint o = 0; o < order; ++o) d *= val;
+			}
+			pLhsDeriv[l] = d;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_jacobian(double const * v, DlsMat jac)
+{
+	_lhsDerivs(v);
+
+	// J(n, s) = sum over the reactions r updating n of upd(n, r) * dr/dy_s.
+	for (uint n=0; n< pSpecs_tot; ++n)
+	{
+		if (pSFlags[n] & Statedef::CLAMPED_POOLFLAG) continue;
+
+		uint upd_end = pUpdStart[n + 1];
+		for (uint k = pUpdStart[n]; k < upd_end; ++k)
+		{
+			uint r = pUpdReac[k];
+			double coef = pUpdCoef[k];
+			uint lhs_end = pLhsStart[r + 1];
+			for (uint l = pLhsStart[r]; l < lhs_end; ++l)
+			{
+				DENSE_ELEM(jac, n, pLhsSpec[l]) += coef * pLhsDeriv[l];
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_sensDerivs(double const * v, double const * s, double * ds)
+{
+	_lhsDerivs(v);
+
+	uint nsens = pSensReac.size();
+	for (uint p=0; p< nsens; ++p)
+	{
+		double const * sp = s + p * pSpecs_tot;
+		double * dsp = ds + p * pSpecs_tot;
+
+		// Change of each rate along the sensitivities of its reactants...
+		for (uint r=0; r< pReacs_tot; ++r)
+		{
+			double d = 0.0;
+			uint lhs_end = pLhsStart[r + 1];
+			for (uint l = pLhsStart[r]; l < lhs_end; ++l)
+			{
+				d += pLhsDeriv[l] * sp[pLhsSpec[l]];
+			}
+			pSensRates[r] = d;
+		}
+
+		// ...plus that of the parameter's own reaction with its constant.
+		uint rp = pSensReac[p];
+		if ((pRFlags[rp] & Statedef::INACTIVE_REACFLAG) == 0)
+		{
+			double d = pCcstUnit[rp];
+			uint lhs_end = pLhsStart[rp + 1];
+			for (uint l = pLhsStart[rp]; l < lhs_end; ++l)
+			{
+				double val = v[pLhsSpec[l]];
+				for (uint o = 0; o < pLhsOrder[l]; ++o) d *= val;
+			}
+			pSensRates[rp] += d;
+		}
+
+		for (uint n=0; n< pSpecs_tot; ++n)
+		{
+			double d = 0.0;
+			if ((pSFlags[n] & Statedef::CLAMPED_POOLFLAG) == 0)
+			{
+				uint upd_end = pUpdStart[n + 1];
+				for (uint k = pUpdStart[n]; k < upd_end; ++k)
+				{
+					d += pUpdCoef[k] * pSensRates[pUpdReac[k]];
+				}
+			}
+			dsp[n] = d;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_sensStage(uint k, double h, double const * a,
+	double const * v)
+{
+	uint len = pSens.size();
+	for (uint i=0; i< len; ++i)
+	{
+		double s = pSens[i];
+		for (uint j=0; j< k; ++j) s += h * a[j] * pSensK[j][i];
+		pSensT[i] = s;
+	}
+	_sensDerivs(v, &pSensT.front(), &pSensK[k].front());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+double swmrk4::Wmrk4::_sensATol(uint p) const
+{
+	uint r = pSensReac[p];
+	double kcst = pCcst[r] / pCcstUnit[r];
+	return (kcst > 0.0) ? pATol / kcst : pATol;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int swmrk4::Wmrk4::_cvodeRhs(realtype t, N_Vector y, N_Vector ydot, void * user_data)
+{
+	Wmrk4 * sim = static_cast<Wmrk4 *>(user_data);
+	sim->_expand(NV_DATA_S(y));
+	sim->_derivs(&sim->pRedY.front(), &sim->pRedDyDx.front());
+	realtype * dz = NV_DATA_S(ydot);
+	uint nind = sim->pRedIndep.size();
+	for (uint i=0; i< nind; ++i) dz[i] = sim->pRedDyDx[sim->pRedIndep[i]];
+
+	// The sensitivities of the integrated species follow the state, one
+	// block of nind per parameter.
+	uint nsens = sim->pSensReac.size();
+	if (nsens == 0) return 0;
+	uint n = sim->pSpecs_tot;
+	for (uint p=0; p< nsens; ++p)
+	{
+		sim->_expandSens(NV_DATA_S(y) + (p + 1) * nind, &sim->pRedSens[p * n]);
+	}
+	sim->_sensDerivs(&sim->pRedY.front(), &sim->pRedSens.front(),
+		&sim->pRedSensDot.front());
+	for (uint p=0; p< nsens; ++p)
+	{
+		realtype * dzp = dz + (p + 1) * nind;
+		for (uint i=0; i< nind; ++i)
+		{
+			dzp[i] = sim->pRedSensDot[p * n + sim->pRedIndep[i]];
+		}
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int swmrk4::Wmrk4::_cvodeJac(int n, realtype t, N_Vector y, N_Vector fy,
+	DlsMat jac, void * user_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+	Wmrk4 * sim = static_cast<Wmrk4 *>(user_data);
+	sim->_expand(NV_DATA_S(y));
+	SetToZero(sim->pRedJac);
+	sim->_jacobian(&sim->pRedY.front(), sim->pRedJac);
+
+	// Chain rule through the laws: a dependent species moves with
+	// coefficient pRedCoef[j] when integrated species pRedSpec[j] does.
+	uiVec const & ind = sim->pRedIndep;
+	uint nind = ind.size();
+	for (uint k=0; k< nind; ++k)
+	{
+		for (uint i=0; i< nind; ++i)
+		{
+			DENSE_ELEM(jac, i, k) = DENSE_ELEM(sim->pRedJac, ind[i], ind[k]);
+		}
+	}
+	uint ndep = sim->pRedDep.size();
+	for (uint d=0; d< ndep; ++d)
+	{
+		uint f = sim->pRedDep[d];
+		for (uint j = sim->pRedStart[d]; j< sim->pRedStart[d+1]; ++j)
+		{
+			uint k = sim->pRedSpec[j];
+			double c = sim->pRedCoef[j];
+			for (uint i=0; i< nind; ++i)
+			{
+				DENSE_ELEM(jac, i, k) += c * DENSE_ELEM(sim->pRedJac, ind[i], f);
+			}
+		}
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int swmrk4::Wmrk4::_cvodeSensSetup(CVodeMemRec * cv_mem, int convfail,
+	N_Vector ypred, N_Vector fpred, booleantype * jcurPtr,
+	N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+	// M = I - gamma J of the integrated species. The sensitivity blocks
+	// have the same diagonal block; the blocks below it, which hold the
+	// second derivatives of the rates, are left out of the Newton matrix.
+	Wmrk4 * sim = static_cast<Wmrk4 *>(cv_mem->cv_lmem);
+	int nind = sim->pRedIndep.size();
+	_cvodeJac(nind, cv_mem->cv_tn, ypred, fpred, sim->pSensNewton, sim,
+		tmp1, tmp2, tmp3);
+	DenseScale(-cv_mem->cv_gamma, sim->pSensNewton);
+	AddIdentity(sim->pSensNewton);
+	*jcurPtr = TRUE;
+	return (DenseGETRF(sim->pSensNewton, sim->pSensPiv) == 0) ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int swmrk4::Wmrk4::_cvodeSensSolve(CVodeMemRec * cv_mem, N_Vector b,
+	N_Vector weight, N_Vector ycur, N_Vector fcur)
+{
+	Wmrk4 * sim = static_cast<Wmrk4 *>(cv_mem->cv_lmem);
+	uint nind = sim->pRedIndep.size();
+	uint nsens = sim->pSensReac.size();
+	realtype * bd = NV_DATA_S(b);
+	for (uint p=0; p<= nsens; ++p)
+	{
+		DenseGETRS(sim->pSensNewton, sim->pSensPiv, bd + p * nind);
+	}
+
+	// As CVDENSE: correct for the change of gamma since the setup.
+	if (cv_mem->cv_lmm == CV_BDF && cv_mem->cv_gamrat != 1.0)
+	{
+		N_VScale(2.0 / (1.0 + cv_mem->cv_gamrat), b, b);
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_buildReduction(std::vector<bool> const & clamped)
+{
+	pRedClamped = clamped;
+
+	// Unclamped species, fewest molecules first. Elimination makes the
+	// species it pivots on independent, so each law is solved for its most
+	// abundant species, where reconstructing it loses the least precision.
+	std::vector<std::pair<double, uint> > order;
+	for (uint n=0; n< pSpecs_tot; ++n)
+	{
+		if (clamped[n] == false) order.push_back(std::make_pair(pVals[n], n));
+	}
+	std::stable_sort(order.begin(), order.end());
+	uint nspecs = order.size();
+
+	// Reduced row echelon form of the transposed stoichiometry: the null
+	// space of its rows holds the conservation laws.
+	std::vector<dVec> a(pReacs_tot, dVec(nspecs, 0.0));
+	for (uint r=0; r< pReacs_tot; ++r)
+	{
+		for (uint j=0; j< nspecs; ++j) a[r][j] = pUpdMtx[r][order[j].second];
+	}
+	std::vector<int> pivrow(nspecs, -1);
+	uint row = 0;
+	for (uint j=0; j< nspecs && row < pReacs_tot; ++j)
+	{
+		uint best = row;
+		for (uint r = row + 1; r< pReacs_tot; ++r)
+		{
+			if (std::fabs(a[r][j]) > std::fabs(a[best][j])) best = r;
+		}
+		if (std::fabs(a[best][j]) < 1.0e-9) continue;
+		a[row].swap(a[best]);
+		double p = a[row][j];
+		for (uint k=j; k< nspecs; ++k) a[row][k] /= p;
+		for (uint r=0; r< pReacs_tot; ++r)
+		{
+			double m = a[r][j];
+			if (r == row || m == 0.0) continue;
+			for (uint k=j; k< nspecs; ++k) a[r][k] -= m * a[row][k];
+		}
+		pivrow[j] = row++;
+	}
+
+	// Pivot columns are integrated; every free column f is conserved as
+	// y_f - sum over pivot columns p of a[pivrow[p]][f] * y_p.
+	pRedIndep.clear();
+	uiVec pos(nspecs, 0);
+	for (uint j=0; j< nspecs; ++j)
+	{
+		if (pivrow[j] < 0) continue;
+		pos[j] = pRedIndep.size();
+		pRedIndep.push_back(order[j].second);
+	}
+	pRedDep.clear();
+	pRedStart.assign(1, 0);
+	pRedSpec.clear();
+	pRedCoef.clear();
+	for (uint f=0; f< nspecs; ++f)
+	{
+		if (pivrow[f] >= 0) continue;
+		pRedDep.push_back(order[f].second);
+		for (uint p=0; p< nspecs; ++p)
+		{
+			if (pivrow[p] < 0) continue;
+			double c = a[pivrow[p]][f];
+			if (std::fabs(c) < 1.0e-9) continue;
+			pRedSpec.push_back(pos[p]);
+			pRedCoef.push_back(c);
+		}
+		pRedStart.push_back(pRedSpec.size());
+	}
+	pRedTotal.assign(pRedDep.size(), 0.0);
+
+	pRedY.assign(pSpecs_tot, 0.0);
+	pRedDyDx.assign(pSpecs_tot, 0.0);
+	if (pRedJac == 0) pRedJac = NewDenseMat(pSpecs_tot, pSpecs_tot);
+	if (pRedJac == 0)
+	{
+		std::ostringstream os;
+		os << "Unable to allocate CVODE memory.";
+		throw steps::SysErr(os.str());
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_reductionTotals(void)
+{
+	uint ndep = pRedDep.size();
+	for (uint d=0; d< ndep; ++d)
+	{
+		double tot = pVals[pRedDep[d]];
+		for (uint j = pRedStart[d]; j< pRedStart[d+1]; ++j)
+		{
+			tot -= pRedCoef[j] * pVals[pRedIndep[pRedSpec[j]]];
+		}
+		pRedTotal[d] = tot;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_expand(realtype const * z)
+{
+	// Clamped species keep their values in pVals.
+	std::copy(pVals.begin(), pVals.end(), pRedY.begin());
+	uint nind = pRedIndep.size();
+	for (uint i=0; i< nind; ++i) pRedY[pRedIndep[i]] = z[i];
+	uint ndep = pRedDep.size();
+	for (uint d=0; d< ndep; ++d)
+	{
+		double y = pRedTotal[d];
+		for (uint j = pRedStart[d]; j< pRedStart[d+1]; ++j)
+		{
+			y += pRedCoef[j] * z[pRedSpec[j]];
+		}
+		pRedY[pRedDep[d]] = y;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_expandSens(realtype const * z, double * s)
+{
+	// The clamped counts and the conserved totals do not depend on the
+	// parameters.
+	std::fill(s, s + pSpecs_tot, 0.0);
+	uint nind = pRedIndep.size();
+	for (uint i=0; i< nind; ++i) s[pRedIndep[i]] = z[i];
+	uint ndep = pRedDep.size();
+	for (uint d=0; d< ndep; ++d)
+	{
+		double sd = 0.0;
+		for (uint j = pRedStart[d]; j< pRedStart[d+1]; ++j)
+		{
+			sd += pRedCoef[j] * z[pRedSpec[j]];
+		}
+		s[pRedDep[d]] = sd;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::_bdfsteps(double t1, double t2)
+{
+	int flag = 0;
+
+	// The conservation laws depend on which species are clamped.
+	std::vector<bool> clamped(pSpecs_tot);
+	for (uint n=0; n< pSpecs_tot; ++n)
+	{
+		clamped[n] = (pSFlags[n] & Statedef::CLAMPED_POOLFLAG) != 0;
+	}
+	uint nsens = pSensReac.size();
+	if (clamped != pRedClamped || nsens != pCVodeNSens)
+	{
+		if (pCVodeMem != 0) CVodeFree(&pCVodeMem);
+		if (pCVodeY != 0) N_VDestroy_Serial(pCVodeY);
+		if (pCVodeATol != 0) N_VDestroy_Serial(pCVodeATol);
+		if (pSensNewton != 0) DestroyMat(pSensNewton);
+		if (pSensPiv != 0) DestroyArray(pSensPiv);
+		pCVodeMem = 0;
+		pCVodeY = 0;
+		pCVodeATol = 0;
+		pSensNewton = 0;
+		pSensPiv = 0;
+		if (clamped != pRedClamped) _buildReduction(clamped);
+	}
+	uint nind = pRedIndep.size();
+	if (nind == 0)
+	{
+		// Every species is clamped or fixed by a law: nothing changes.
+		pNewVals = pVals;
+		pSensNew = pSens;
+		_update();
+		return;
+	}
+
+	if (pCVodeMem == 0)
+	{
+		// With sensitivities CVODE integrates the state and one block of
+		// sensitivities per parameter.
+		uint nsys = nind * (1 + nsens);
+		pCVodeY = N_VNew_Serial(nsys);
+		pCVodeMem = CVodeCreate(CV_BDF, CV_NEWTON);
+		if (pCVodeY == 0 || pCVodeMem == 0)
+		{
+			std::ostringstream os;
+			os << "Unable to allocate CVODE memory.";
+			throw steps::SysErr(os.str());
+		}
+		_reductionTotals();
+		for (uint i=0; i< nsys; ++i) NV_Ith_S(pCVodeY, i) = 0.0;
+		for (uint i=0; i< nind; ++i) NV_Ith_S(pCVodeY, i) = pVals[pRedIndep[i]];
+		flag = CVodeInit(pCVodeMem, _cvodeRhs, t1, pCVodeY);
+		if (flag == CV_SUCCESS) flag = CVodeSetUserData(pCVodeMem, this);
+		if (flag == CV_SUCCESS) flag = CVodeSetMaxNumSteps(pCVodeMem, WMRK4_CVODE_MAX_NUM_STEPS);
+		if (flag == CV_SUCCESS && nsens == 0)
+		{
+			flag = CVDense(pCVodeMem, nind);
+			if (flag == CV_SUCCESS) flag = CVDlsSetDenseJacFn(pCVodeMem, _cvodeJac);
+		}
+		else if (flag == CV_SUCCESS)
+		{
+			pCVodeATol = N_VNew_Serial(nsys);
+			pSensNewton = NewDenseMat(nind, nind);
+			pSensPiv = NewIntArray(nind);
+			if (pCVodeATol == 0 || pSensNewton == 0 || pSensPiv == 0)
+			{
+				std::ostringstream os;
+				os << "Unable to allocate CVODE memory.";
+				throw steps::SysErr(os.str());
+			}
+			CVodeMem cv_mem = static_cast<CVodeMem>(pCVodeMem);
+			cv_mem->cv_linit = 0;
+			cv_mem->cv_lsetup = _cvodeSensSetup;
+			cv_mem->cv_lsolve = _cvodeSensSolve;
+			cv_mem->cv_lfree = 0;
+			cv_mem->cv_lmem = this;
+			cv_mem->cv_setupNonNull = TRUE;
+		}
+		if (flag != CV_SUCCESS)
+		{
+			std::ostringstream os;
+			os << "CVODE initialisation failed with flag " << flag << ".";
+			throw steps::SysErr(os.str());
+		}
+		pCVodeNSens = nsens;
+		pCVodeReinit = true;
+	}
+
+	// The integrator keeps its history between calls, unless something
+	// changed the state or the rate constants since.
+	if (pCVodeReinit == true)
+	{
+		_reductionTotals();
+		for (uint i=0; i< nind; ++i) NV_Ith_S(pCVodeY, i) = pVals[pRedIndep[i]];
+		for (uint p=0; p< nsens; ++p)
+		{
+			for (uint i=0; i< nind; ++i)
+			{
+				NV_Ith_S(pCVodeY, (p + 1) * nind + i) = pSens[p * pSpecs_tot + pRedIndep[i]];
+			}
+		}
+		flag = CVodeReInit(pCVodeMem, t1, pCVodeY);
+		if (flag == CV_SUCCESS && nsens == 0)
+		{
+			flag = CVodeSStolerances(pCVodeMem, pRTol, pATol);
+		}
+		else if (flag == CV_SUCCESS)
+		{
+			for (uint i=0; i< nind; ++i) NV_Ith_S(pCVodeATol, i) = pATol;
+			for (uint p=0; p< nsens; ++p)
+			{
+				double atol = _sensATol(p);
+				for (uint i=0; i< nind; ++i)
+				{
+					NV_Ith_S(pCVodeATol, (p + 1) * nind + i) = atol;
+				}
+			}
+			flag = CVodeSVtolerances(pCVodeMem, pRTol, pCVodeATol);
+		}
+		if (flag != CV_SUCCESS)
+		{
+			std::ostringstream os;
+			os << "CVODE re-initialisation failed with flag " << flag << ".";
+			throw steps::SysErr(os.str());
+		}
+		pCVodeReinit = false;
+	}
+
+	// Stop exactly at t2, so that the integrator never steps past it.
+	realtype t = t1;
+	flag = CVodeSetStopTime(pCVodeMem, t2);
+	if (flag == CV_SUCCESS) flag = CVode(pCVodeMem, t2, pCVodeY, &t, CV_NORMAL);
+	if (flag < 0)
+	{
+		pCVodeReinit = true;
+		std::ostringstream os;
+		os << "CVODE integration failed with flag " << flag << " at t = " << t << ".";
+		throw steps::SysErr(os.str());
+	}
+
+	_expand(NV_DATA_S(pCVodeY));
+	for (uint i=0; i< pSpecs_tot; ++i)
+	{
+		pNewVals[i] = pRedY[i];
+		// The integrator's state no longer matches once _update() clips.
+		if (pRedY[i] < 0.0 && clamped[i] == false) pCVodeReinit = true;
+	}
+	for (uint p=0; p< nsens; ++p)
+	{
+		_expandSens(NV_DATA_S(pCVodeY) + (p + 1) * nind, &pSensNew[p * pSpecs_tot]);
+	}
+	_update();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void swmrk4::Wmrk4::steadyState(void)
+{
+	DlsMat jac = NewDenseMat(pSpecs_tot, pSpecs_tot);
+	int * piv = NewIntArray(pSpecs_tot);
+	if (jac == 0 || piv == 0)
+	{
+		if (jac != 0) DestroyMat(jac);
+		std::ostringstream os;
+		os << "Unable to allocate the steady state Jacobian.";
+		throw steps::SysErr(os.str());
+	}
+
+	// The fastest time scale sets the pseudo time steps.
+	SetToZero(jac);
+	_jacobian(&pVals.front(), jac);
+	double jmax = 0.0;
+	for (uint n=0; n< pSpecs_tot; ++n)
+	{
+		jmax = std::max(jmax, static_cast<double>(std::fabs(DENSE_ELEM(jac, n, n))));
+	}
+
+	bool found = true;
+	dVec y(pVals);
+	pSensNew = pSens;
+	if (jmax > 0.0)
+	{
+		double dtaumax = WMRK4_STEADY_NEWTON_DTAU / jmax;
+		found = _steadyIter(y, dtaumax, dtaumax, WMRK4_STEADY_MAX_NEWTON, jac, piv);
+		if (found == false)
+		{
+			y = pVals;
+			found = _steadyIter(y, 1.0 / jmax, dtaumax, WMRK4_STEADY_MAX_PTC, jac, piv);
+		}
+		if (found == true && pSensReac.empty() == false)
+		{
+			found = _steadySens(y, dtaumax, jac, piv);
+		}
+	}
+
+	DestroyMat(jac);
+	DestroyArray(piv);
+
+	if (found == false)
+	{
+		std::ostringstream os;
+		os << "Steady state not found from the current state.";
+		throw steps::SysErr(os.str());
+	}
+
+	pNewVals = y;
+	_update();
+	pCVodeReinit = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool swmrk4::Wmrk4::_steadyIter(dVec & y, double dtau, double dtaumax,
+	uint maxiter, DlsMat jac, int * piv)
+{
+	bool newton = (dtau >= dtaumax);
+	dVec f(pSpecs_tot);
+	// The solution vector is in the precision of the dense matrices.
+	std::vector<realtype> d(pSpecs_tot);
+	_derivs(&y.front(), &f.front());
+	double fnorm = 0.0;
+	for (uint n=0; n< pSpecs_tot; ++n) fnorm += f[n] * f[n];
+
+	for (uint it=0; it< maxiter; ++it)
+	{
+		// (I - dtau J) d = dtau f, an implicit Euler step of length dtau.
+		SetToZero(jac);
+		_jacobian(&y.front(), jac);
+		DenseScale(-dtau, jac);
+		AddIdentity(jac);
+		bool ok = (DenseGETRF(jac, piv) == 0);
+		double err = 0.0;
+		if (ok == true)
+		{
+			for (uint n=0; n< pSpecs_tot; ++n) d[n] = dtau * f[n];
+			DenseGETRS(jac, piv, &d.front());
+			for (uint n=0; n< pSpecs_tot; ++n)
+			{
+				double w = pATol + pRTol * std::fabs(y[n]);
+				if (y[n] + d[n] < -w) ok = false;
+				err = std::max(err, std::fabs(d[n]) / w);
+			}
+		}
+
+		// A step that fails or drives counts negative is retried shorter;
+		// Newton's method has no shorter step to retry.
+		if (ok == false)
+		{
+			if (newton == true) return false;
+			dtau *= 0.1;
+			continue;
+		}
+
+		for (uint n=0; n< pSpecs_tot; ++n) y[n] = std::max(0.0, y[n] + d[n]);
+		if (dtau == dtaumax && err <= 1.0) return true;
+
+		// Switched evolution relaxation: grow the step as the rates fall.
+		double fnorm_prev = fnorm;
+		_derivs(&y.front(), &f.front());
+		fnorm = 0.0;
+		for (uint n=0; n< pSpecs_tot; ++n) fnorm += f[n] * f[n];
+		double grow = (fnorm > 0.0) ? std::sqrt(fnorm_prev / fnorm) : 10.0;
+		dtau = std::min(dtaumax, dtau * std::min(10.0, grow));
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool swmrk4::Wmrk4::_steadySens(dVec const & y, double dtau, DlsMat jac,
+	int * piv)
+{
+	// The sensitivity equations are linear with constant coefficients at
+	// the steady state, so one decomposition serves every step. Their
+	// components along the conservation laws do not change.
+	SetToZero(jac);
+	_jacobian(&y.front(), jac);
+	DenseScale(-dtau, jac);
+	AddIdentity(jac);
+	if (DenseGETRF(jac, piv) != 0) return false;
+
+	uint nsens = pSensReac.size();
+	dVec ds(pSensNew.size());
+	std::vector<realtype> d(pSpecs_tot);
+	for (uint it=0; it< WMRK4_STEADY_MAX_NEWTON; ++it)
+	{
+		_sensDerivs(&y.front(), &pSensNew.front(), &ds.front());
+		double err = 0.0;
+		for (uint p=0; p< nsens; ++p)
+		{
+			double const * dsp = &ds[p * pSpecs_tot];
+			double * s = &pSensNew[p * pSpecs_tot];
+			for (uint n=0; n< pSpecs_tot; ++n) d[n] = dtau * dsp[n];
+			DenseGETRS(jac, piv, &d.front());
+			double atol = _sensATol(p);
+			for (uint n=0; n< pSpecs_tot; ++n)
+			{
+				s[n] += d[n];
+				err = std::max(err, std::fabs(d[n]) / (atol + pRTol * std::fabs(s[n])));
+			}
+		}
+		if (err <= 1.0) return true;
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void swmrk4::Wmrk4::_update(void)
 {
 	/// update local values vector with computed counts
+	uint nsens = pSensReac.size();
 	for (uint i=0; i< pSpecs_tot; ++i)
 	{
 		/// check clamped flag and only update if not clamped
@@ -1234,6 +2848,12 @@ void swmrk4::Wmrk4::_update(void)
 		else
 		{
 			double newval = pNewVals[i];
+			/// a count clipped at zero does not move with the parameters
+			for (uint p=0; p< nsens; ++p)
+			{
+				uint k = p * pSpecs_tot + i;
+				pSens[k] = (newval < 0.0) ? 0.0 : pSensNew[k];
+			}
 			if (newval < 0.0) newval = 0.0;
 			pVals[i] = newval;
 		}
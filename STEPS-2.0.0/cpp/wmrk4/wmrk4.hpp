@@ -41,6 +41,16 @@
 #include "../solver/api.hpp"
 #include "../solver/statedef.hpp"
 
+// CVODE headers.
+#include "../../third_party/cvode-2.6.0/src/cvode/cvode.h"
+#include "../../third_party/cvode-2.6.0/src/nvec_ser/nvector_serial.h"
+#include "../../third_party/cvode-2.6.0/src/sundials/sundials_direct.h"
+#include "../../third_party/cvode-2.6.0/src/sundials/sundials_types.h"
+
+// CVODE's integrator memory, which the linear solver of the sensitivity
+// system is attached to.
+struct CVodeMemRec;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 START_NAMESPACE(steps)
@@ -60,6 +70,29 @@ typedef uiVec::iterator					uiVecI;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// Default absolute tolerance (in molecules) of the adaptive mode.
+#define WMRK4_DEFAULT_ATOL          1.0e-3
+
+/// Default relative tolerance of the adaptive mode.
+#define WMRK4_DEFAULT_RTOL          1.0e-4
+
+/// Maximum number of internal CVODE steps per run() in stiff mode.
+#define WMRK4_CVODE_MAX_NUM_STEPS   1000000
+
+/// Pseudo time step of steadyState()'s Newton iteration, relative to the
+/// fastest time scale of the Jacobian; its inverse on the diagonal keeps
+/// the Newton matrix regular across conservation laws.
+#define WMRK4_STEADY_NEWTON_DTAU    1.0e8
+
+/// Maximum number of Newton iterations of steadyState() before it falls
+/// back to pseudo-transient continuation.
+#define WMRK4_STEADY_MAX_NEWTON     50
+
+/// Maximum number of pseudo-transient continuation steps of steadyState().
+#define WMRK4_STEADY_MAX_PTC        2000
+
+////////////////////////////////////////////////////////////////////////////////
+
 class Wmrk4: public API
 {
 
@@ -92,6 +125,113 @@ public:
 
     void setRk4DT(double dt);
 
+    /// Switch between the fixed step Runge-Kutta method (the default) and
+    /// the adaptive Dormand-Prince 5(4) method. In adaptive mode the step
+    /// set by setRk4DT() is only used as the first trial step.
+    ///
+    void setAdaptive(bool adapt);
+
+    bool getAdaptive(void) const
+    { return pAdaptive; }
+
+    /// Switch to CVODE's BDF method with Newton iteration, using a dense
+    /// direct linear solver and the analytic Jacobian of the reaction
+    /// network. Intended for stiff models; takes precedence over the
+    /// adaptive mode. In stiff mode the step set by setRk4DT() is only
+    /// used by step(). Species fixed by a linear conservation law of the
+    /// unclamped network are not integrated but computed from the others.
+    ///
+    void setStiff(bool stiff);
+
+    bool getStiff(void) const
+    { return pStiff; }
+
+    /// Set the absolute (in molecules) and relative error tolerances of
+    /// the adaptive and stiff modes.
+    ///
+    void setTolerances(double atol, double rtol);
+
+    /// Return the number of derivative evaluations since creation.
+    ///
+    double getNDerivEvals(void) const
+    { return pNDerivEvals; }
+
+    /// Set the pools to the steady state reached from the current state,
+    /// without advancing the simulation time. Uses Newton's method on the
+    /// rates with the analytic Jacobian and, if that fails, pseudo-transient
+    /// continuation; converged within the tolerances set with
+    /// setTolerances(). Throws and leaves the state as it was if neither
+    /// converges.
+    ///
+    void steadyState(void);
+
+    ////////////////////////////////////////////////////////////////////////
+    // FORWARD SENSITIVITIES
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Integrate the sensitivities of all counts to the rate constant of
+    /// reaction r in compartment c along with the state, in every mode,
+    /// starting from zero at the current state. Returns the index of the
+    /// new parameter for getCompSensitivity() and getPatchSensitivity().
+    ///
+    uint addCompReacSensitivity(std::string const & c, std::string const & r);
+
+    /// As addCompReacSensitivity(), for surface reaction sr in patch p.
+    ///
+    uint addPatchSReacSensitivity(std::string const & p, std::string const & sr);
+
+    /// Stop integrating sensitivities and forget the parameters.
+    ///
+    void clearSensitivities(void);
+
+    uint countSensitivities(void) const
+    { return pSensReac.size(); }
+
+    /// Return the derivative of the count of species s in compartment c
+    /// (or patch p) with respect to the rate constant of parameter param,
+    /// in the units of that constant.
+    ///
+    double getCompSensitivity(std::string const & c, std::string const & s,
+        uint param) const;
+    double getPatchSensitivity(std::string const & p, std::string const & s,
+        uint param) const;
+
+    ////////////////////////////////////////////////////////////////////////
+    // BATCHED INTEGRATION
+    ////////////////////////////////////////////////////////////////////////
+
+    /// Integrate nsets copies of the network at once, each with its own
+    /// counts and rate constants, for deterministic parameter scans. Set
+    /// 0 is the solver's own state, which all other access goes to; the
+    /// others start as copies of it, as they do again after reset().
+    /// Batches of more than one set need the fixed step method and no
+    /// sensitivities.
+    ///
+    void setBatchSize(uint nsets);
+
+    uint getBatchSize(void) const
+    { return pBatch; }
+
+    /// Counts and rate constants of batch set b; set 0 is the same as
+    /// the unbatched accessors.
+    ///
+    double getBatchCompCount(uint b, std::string const & c,
+        std::string const & s) const;
+    void setBatchCompCount(uint b, std::string const & c,
+        std::string const & s, double n);
+    double getBatchPatchCount(uint b, std::string const & p,
+        std::string const & s) const;
+    void setBatchPatchCount(uint b, std::string const & p,
+        std::string const & s, double n);
+    double getBatchCompReacK(uint b, std::string const & c,
+        std::string const & r) const;
+    void setBatchCompReacK(uint b, std::string const & c,
+        std::string const & r, double kf);
+    double getBatchPatchSReacK(uint b, std::string const & p,
+        std::string const & sr) const;
+    void setBatchPatchSReacK(uint b, std::string const & p,
+        std::string const & sr, double kf);
+
     ////////////////////////////////////////////////////////////////////////
     // SOLVER STATE ACCESS:
     //      GENERAL
@@ -189,9 +329,144 @@ private:
 	///
 	void _rksteps(double t1, double t2);
 
+	/// the simple stepper over all batch sets
+	///
+	void _rkbatch(double t1, double t2);
+
+	/// the Runge-Kutta algorithm and the derivatives over all batch sets,
+	/// on species-major, set-minor vectors
+	///
+	void _rk4batch(double pdt);
+	void _derivsbatch(double const * vals, double * dydx);
+
+	/// copy set 0, the solver's state, to every other batch set
+	///
+	void _batchFromState(void);
+
+	/// throw unless b is a batch set
+	///
+	void _checkBatchSet(uint b) const;
+
+	/// the index into pVals of species slidx of compartment cidx, or of
+	/// patch pidx, and into pCcst of reaction lridx of compartment cidx or
+	/// surface reaction lsridx of patch pidx
+	///
+	uint _compSpecIdx(uint cidx, uint slidx) const;
+	uint _patchSpecIdx(uint pidx, uint slidx) const;
+	uint _compReacIdx(uint cidx, uint lridx) const;
+	uint _patchSReacIdx(uint pidx, uint lsridx) const;
+
+	/// the index into pVals of species s of compartment c, or patch p,
+	/// and into pCcst of reaction r of compartment c, or surface reaction
+	/// sr of patch p; throw if not defined there
+	///
+	uint _compSpecIdx(std::string const & c, std::string const & s) const;
+	uint _patchSpecIdx(std::string const & p, std::string const & s) const;
+	uint _compReacIdx(std::string const & c, std::string const & r) const;
+	uint _patchSReacIdx(std::string const & p, std::string const & sr) const;
+
+	/// the adaptive Dormand-Prince 5(4) stepper
+	///
+	void _rkadapt(double t1, double t2);
+
+	/// compile pReacMtx and pUpdMtx into the flat reactant lists and the
+	/// species-by-reaction CSR stoichiometry used by _setderivs
+	///
+	void _buildStoich(void);
+
 	/// the derivatives calculator
 	///
 	void _setderivs(dVec& vals, dVec& dydx);
+	void _derivs(double const * vals, double * dydx);
+
+	/// the stiff stepper, integrating from t1 to t2 with CVODE
+	///
+	void _bdfsteps(double t1, double t2);
+
+	/// fill the (zeroed) dense column-major Jacobian of _derivs at vals
+	///
+	void _jacobian(double const * vals, DlsMat jac);
+
+	/// fill pLhsDeriv with the derivatives of the reaction rates at vals
+	/// with respect to their reactants
+	///
+	void _lhsDerivs(double const * vals);
+
+	/// the derivatives of the sensitivities sens of every parameter (laid
+	/// out as pSens) at state vals: J sens + df/dk, with the sparse
+	/// Jacobian of the reactant lists
+	///
+	void _sensDerivs(double const * vals, double const * sens, double * dsens);
+
+	/// stage k of the sensitivities for an explicit Runge-Kutta step of
+	/// length h with tableau row a, at stage state vals: the stage state
+	/// goes to pSensT, its derivative to pSensK[k]
+	///
+	void _sensStage(uint k, double h, double const * a, double const * vals);
+
+	/// absolute tolerance of the sensitivities of parameter p: that of the
+	/// counts over the rate constant, as CVODES scales it
+	///
+	double _sensATol(uint p) const;
+
+	/// add a sensitivity parameter for reaction r (index into pCcst)
+	///
+	uint _addSensitivity(uint r);
+
+	/// zero the sensitivities of species n, whose count was set
+	///
+	void _zeroSens(uint n);
+
+	/// full sensitivities for integrated species sensitivities z, which
+	/// the conservation laws hold to conserved totals
+	///
+	void _expandSens(realtype const * z, double * sens);
+
+	/// the steady state sensitivities at steady state y, by implicit Euler
+	/// steps of length dtau on the sensitivity equations into pSensNew;
+	/// returns false if they do not settle
+	///
+	bool _steadySens(dVec const & y, double dtau, DlsMat jac, int * piv);
+
+	/// find the linear conservation laws of the species not flagged in
+	/// clamped from the stoichiometry, and split the species into the
+	/// ones CVODE integrates and the ones the laws determine
+	///
+	void _buildReduction(std::vector<bool> const & clamped);
+
+	/// set the conserved totals of the laws from pVals
+	///
+	void _reductionTotals(void);
+
+	/// fill pRedY with the full state for the integrated species z
+	///
+	void _expand(realtype const * z);
+
+	/// CVODE callbacks on the integrated species, user_data is the Wmrk4
+	/// object
+	///
+	static int _cvodeRhs(realtype t, N_Vector y, N_Vector ydot, void * user_data);
+	static int _cvodeJac(int n, realtype t, N_Vector y, N_Vector fy,
+		DlsMat jac, void * user_data, N_Vector tmp1, N_Vector tmp2,
+		N_Vector tmp3);
+
+	/// CVODE linear solver of the state and sensitivity system: the
+	/// Newton matrix of the state alone, applied to every block, as in
+	/// CVODES's simultaneous corrector; cv_lmem is the Wmrk4 object
+	///
+	static int _cvodeSensSetup(CVodeMemRec * cv_mem, int convfail,
+		N_Vector ypred, N_Vector fpred, booleantype * jcurPtr,
+		N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+	static int _cvodeSensSolve(CVodeMemRec * cv_mem, N_Vector b,
+		N_Vector weight, N_Vector ycur, N_Vector fcur);
+
+	/// iterate y towards the steady state with pseudo time steps starting at
+	/// dtau, growing them up to dtaumax as the rates fall; with dtau equal
+	/// to dtaumax this is Newton's method. Returns true once a step at
+	/// dtaumax is within the tolerances; on false y is undefined.
+	///
+	bool _steadyIter(dVec & y, double dtau, double dtaumax, uint maxiter,
+		DlsMat jac, int * piv);
 
 	/// update local values vector,
 	/// then update state with computed counts
@@ -233,9 +508,53 @@ private:
 	/// vector of present derivatives
 	dVec						        pDyDx;
 
-	/// matrix of derivatives from each reaction for each species
+	/// matrix of derivatives from each reaction for each species;
+	/// no longer used by _setderivs, kept for the checkpoint layout
 	double **					        pDyDxlhs;
 
+	/// reactants of reaction r: pLhsSpec/pLhsOrder[pLhsStart[r]..pLhsStart[r+1])
+	uiVec						        pLhsStart;
+	uiVec						        pLhsSpec;
+	uiVec						        pLhsOrder;
+
+	/// non-zero updates of species n, in reaction order:
+	/// pUpdReac/pUpdCoef[pUpdStart[n]..pUpdStart[n+1])
+	uiVec						        pUpdStart;
+	uiVec						        pUpdReac;
+	dVec						        pUpdCoef;
+
+	/// rate of each reaction at the current derivative evaluation
+	dVec						        pRates;
+
+	/// derivative of each reaction rate with respect to each reactant,
+	/// same layout as pLhsSpec
+	dVec						        pLhsDeriv;
+
+	/// stiff mode flag and CVODE state; pCVodeReinit is set whenever the
+	/// state or the rate constants change outside the integrator
+	bool						        pStiff;
+	void						      * pCVodeMem;
+	N_Vector					        pCVodeY;
+	bool						        pCVodeReinit;
+
+	/// conservation laws of the stiff mode: CVODE integrates species
+	/// pRedIndep; dependent species pRedDep[k] is pRedTotal[k] plus
+	/// pRedCoef[j] times integrated species pRedSpec[j] (an index into
+	/// pRedIndep) for j in [pRedStart[k], pRedStart[k+1]). pRedClamped
+	/// holds the clamped flags the laws were found for.
+	uiVec						        pRedIndep;
+	uiVec						        pRedDep;
+	uiVec						        pRedStart;
+	uiVec						        pRedSpec;
+	dVec						        pRedCoef;
+	dVec						        pRedTotal;
+	std::vector<bool>			        pRedClamped;
+
+	/// full state, derivatives and Jacobian behind the CVODE callbacks
+	dVec						        pRedY;
+	dVec						        pRedDyDx;
+	DlsMat						        pRedJac;
+
 	/// the time step
 	double						        pDT;
 
@@ -244,6 +563,67 @@ private:
 	dVec						        dyt;
 	dVec						        dym;
 
+	/// adaptive mode flag and error tolerances
+	bool						        pAdaptive;
+	double						        pATol;
+	double						        pRTol;
+
+	/// the adaptive step proposed by the last accepted step
+	double						        pAdaptDT;
+
+	/// stage derivatives of the adaptive method, stage 1 is pDyDx
+	dVec						        pK2;
+	dVec						        pK3;
+	dVec						        pK4;
+	dVec						        pK5;
+	dVec						        pK6;
+	dVec						        pK7;
+
+	/// number of calls to _setderivs
+	double						        pNDerivEvals;
+
+	/// scaled reaction constant per unit rate constant
+	dVec						        pCcstUnit;
+
+	/// forward sensitivities: the reaction (index into pCcst) of each
+	/// parameter, and the derivative of every count with respect to its
+	/// rate constant, pSens[p * pSpecs_tot + n]; pSensNew holds the
+	/// values _update() commits
+	uiVec						        pSensReac;
+	dVec						        pSens;
+	dVec						        pSensNew;
+
+	/// stage state and stage derivatives of the sensitivities in the
+	/// explicit methods, and the reaction rate derivatives
+	dVec						        pSensT;
+	std::vector<dVec>			        pSensK;
+	dVec						        pSensRates;
+
+	/// stiff mode: the number of parameters the CVODE memory was made
+	/// for, the absolute tolerances, the full sensitivities behind the
+	/// callbacks and the decomposed Newton matrix of the state
+	uint						        pCVodeNSens;
+	N_Vector					        pCVodeATol;
+	dVec						        pRedSens;
+	dVec						        pRedSensDot;
+	DlsMat						        pSensNewton;
+	int						          * pSensPiv;
+
+	/// batched integration: the number of sets, and the counts, rate
+	/// constants and scaled constants of each, pBatchVals[n * pBatch + b]
+	/// and pBatchK[r * pBatch + b] (set 0 of these is only a copy, made
+	/// for the integration); the rest is workspace of the same layout
+	uint						        pBatch;
+	dVec						        pBatchVals;
+	dVec						        pBatchK;
+	dVec						        pBatchCcst;
+	dVec						        pBatchNew;
+	dVec						        pBatchDyDx;
+	dVec						        pBatchYt;
+	dVec						        pBatchDyt;
+	dVec						        pBatchDym;
+	dVec						        pBatchRates;
+
 	////////////////////////////////////////////////////////////////////////
 
 };
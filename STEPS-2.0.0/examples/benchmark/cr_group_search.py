@@ -0,0 +1,113 @@
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# STEPS - STochastic Engine for Pathway Simulation
+# Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+# Copyright (C) 2003-2006 University of Antwerp, Belgium.
+#
+# See the file AUTHORS for details.
+#
+# This file is part of STEPS.
+#
+# STEPS is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# STEPS is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+# Benchmark: CR group selection in Tetexact
+# Compares the group sum tree search with the linear scan over all
+# composition-rejection groups, for a model whose propensities span many
+# binary orders of magnitude (fast buffering next to slow gating).
+
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+import time
+
+import steps.model as smodel
+import steps.solver as solvmod
+import steps.geom as stetmesh
+import steps.rng as srng
+
+import steps.utilities.meshio as smeshio
+
+########################################################################
+
+# The number of species, each with its own reaction. Reaction i has a
+# rate constant NSPECS_SCALE**i times larger than reaction i-1.
+NSPECS = 24
+NSPECS_SCALE = 4.0
+
+# The diffusion constant of the buffer (m^2/s)
+DCST = 20.0e-12
+
+# Number of buffer and gating molecules per tetrahedron
+NBUFF = 5
+NGATE = 1
+
+# Simulation endtime (s)
+ENDTIME = 0.002
+
+########################################################################
+
+def gen_model():
+    mdl = smodel.Model()
+    vsys = smodel.Volsys('cytosolv', mdl)
+    B = smodel.Spec('B', mdl)
+    smodel.Diff('diff_B', vsys, B, dcst = DCST)
+    for i in range(NSPECS):
+        X = smodel.Spec('X%d' % i, mdl)
+        kcst = 1.0e6 * pow(NSPECS_SCALE, i - NSPECS / 2)
+        smodel.Reac('R%d' % i, vsys, lhs = [X, B], rhs = [X, B], kcst = kcst)
+    return mdl
+
+########################################################################
+
+def gen_geom():
+    mesh = smeshio.loadMesh('../tutorial/meshes/sphere_rad10_11Ktets')[0]
+    ntets = mesh.countTets()
+    comp = stetmesh.TmComp('cyto', mesh, range(ntets))
+    comp.addVolsys('cytosolv')
+    return mesh
+
+########################################################################
+
+def run(sim, tree):
+    sim.setGroupTreeSearch(tree)
+    sim.reset()
+    ntets = tmgeom.countTets()
+    sim.setCompCount('cyto', 'B', NBUFF * ntets)
+    for i in range(NSPECS):
+        sim.setCompCount('cyto', 'X%d' % i, NGATE * ntets)
+    beg_time = time.time()
+    sim.run(ENDTIME)
+    end_time = time.time()
+    return end_time - beg_time, sim.getNSteps()
+
+########################################################################
+
+model = gen_model()
+tmgeom = gen_geom()
+
+rng = srng.create('mt19937', 512)
+rng.initialize(2903)
+
+sim = solvmod.Tetexact(model, tmgeom, rng)
+
+for tree in [False, True]:
+    secs, nsteps = run(sim, tree)
+    if tree: label = 'group tree search'
+    else: label = 'linear group scan'
+    print '%s: %d steps in %.3f s (%.3f us/step)' \
+        % (label, nsteps, secs, 1.0e6 * secs / nsteps)
+
+########################################################################
+
+# END
@@ -0,0 +1,512 @@
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# STEPS - STochastic Engine for Pathway Simulation
+# Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+# Copyright (C) 2003-2006 University of Antwerp, Belgium.
+#
+# See the file AUTHORS for details.
+#
+# This file is part of STEPS.
+#
+# STEPS is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# STEPS is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+# Regression harness: statistics and throughput of the tutorial models
+# Runs an ensemble of each tutorial model with a fixed seed and compares
+# the mean and variance of a few observables against reference values
+# recorded with a trusted build:
+#
+#   well_mixed          A + B <-> C, Wmdirect
+#   diffusion           point source in a sphere, Tetexact (molecules in
+#                       radial shells)
+#   diffusion_boundary  two compartments of a cylinder joined by a
+#                       diffusion boundary, Tetexact
+#   ip3                 IP3 receptor gating, Wmdirect
+#   HH_APprop           Hodgkin-Huxley action potential along an axon,
+#                       Tetexact with the EField (potentials along the
+#                       axon)
+#
+# A mean fails when its Welch z statistic against the reference exceeds
+# the threshold, a variance when the z statistic of the log of the
+# variance ratio does. The same build gives the same samples; a change
+# that alters the random stream (a new scheduler, tau-leaping) gives a
+# different sample of the same distribution, which should pass. The
+# event rate is reported next to the reference rate but never fails:
+# the references may come from another machine.
+#
+# The restore check instead runs a Tetexact model with each scheduler,
+# checkpointed and restored on the way, and fails unless the restored
+# run follows the trajectory of the one that wrote the checkpoint bit
+# for bit (see steps.utilities.repro.checkRestore).
+#
+# Usage:
+#   python regression.py --record [workload ...]   record the references
+#   python regression.py [options] [workload ...]  compare (default: all)
+#   python regression.py --restore                 the restore check
+#
+# Options: --ref FILE (default regression_ref.json next to this script),
+# --scheduler cr|direct|nrm and --tauleap for the Tetexact models, and
+# --scale F to run F times the default number of iterations.
+
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+import json
+import math
+import optparse
+import os
+import sys
+import tempfile
+import time
+
+import steps.model as smodel
+import steps.solver as ssolver
+import steps.geom as sgeom
+import steps.rng as srng
+
+import steps.utilities.meshio as smeshio
+import steps.utilities.repro as srepro
+
+from solver_suite import MESHDIR, _hh_model
+
+########################################################################
+
+SEED = 2903
+
+# The z statistic above which a mean or a variance fails. The number of
+# comparisons is large, so this is well above the usual 2.
+ZCRIT = 4.0
+
+REFFILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), \
+    'regression_ref.json')
+
+# The Tetexact options, set from the command line.
+SCHEDULER = 'cr'
+TAULEAP = False
+
+########################################################################
+
+def _rng():
+    r = srng.create('mt19937', 512)
+    r.initialize(SEED)
+    return r
+
+def _tetexact(mdl, mesh, ef = False):
+    sim = ssolver.Tetexact(mdl, mesh, _rng(), ef, SCHEDULER)
+    # Tau-leaping is not available with the EField.
+    if TAULEAP and not ef:
+        sim.setTauLeaping(True)
+    return sim
+
+########################################################################
+# Each workload returns the default number of iterations and a function
+# that runs one iteration from reset() and returns a list of
+# (observable, value) pairs. The solver and its RNG live across the
+# iterations, as in the tutorials.
+
+def wl_well_mixed():
+    mdl = smodel.Model()
+    molA = smodel.Spec('molA', mdl)
+    molB = smodel.Spec('molB', mdl)
+    molC = smodel.Spec('molC', mdl)
+    vsys = smodel.Volsys('vsys', mdl)
+    smodel.Reac('kreac_f', vsys, lhs = [molA, molB], rhs = [molC], kcst = 0.3e6)
+    smodel.Reac('kreac_b', vsys, lhs = [molC], rhs = [molA, molB], kcst = 0.7)
+    geom = sgeom.Geom()
+    comp = sgeom.Comp('comp', geom)
+    comp.addVolsys('vsys')
+    comp.setVol(1.6667e-21)
+
+    sim = ssolver.Wmdirect(mdl, geom, _rng())
+
+    def run():
+        sim.reset()
+        sim.setCompConc('comp', 'molA', 31.4e-6)
+        sim.setCompConc('comp', 'molB', 22.3e-6)
+        obs = []
+        for t in [0.05, 0.5, 2.0]:
+            sim.run(t)
+            obs.append(('molA@%g' % t, sim.getCompCount('comp', 'molA')))
+            obs.append(('molC@%g' % t, sim.getCompCount('comp', 'molC')))
+        return obs
+    return sim, 200, run
+
+########################################################################
+
+def wl_diffusion():
+    mdl = smodel.Model()
+    A = smodel.Spec('A', mdl)
+    vsys = smodel.Volsys('cytosolv', mdl)
+    smodel.Diff('diff_A', vsys, A, dcst = 20.0e-12)
+
+    mesh = smeshio.loadMesh(os.path.join(MESHDIR, 'sphere_rad10_11Ktets'))[0]
+    ntets = mesh.countTets()
+    comp = sgeom.TmComp('cyto', mesh, range(ntets))
+    comp.addVolsys('cytosolv')
+
+    # The tets in shells 2 um thick around the central tet.
+    ctetidx = mesh.findTetByPoint([0.0, 0.0, 0.0])
+    cbaryc = mesh.getTetBarycenter(ctetidx)
+    shells = [[], [], []]
+    for t in range(ntets):
+        b = mesh.getTetBarycenter(t)
+        r = math.sqrt(sum([(b[i] - cbaryc[i]) ** 2 for i in range(3)]))
+        s = int(r / 2.0e-6)
+        if s < len(shells):
+            shells[s].append(t)
+
+    sim = _tetexact(mdl, mesh)
+
+    def run():
+        sim.reset()
+        sim.setTetCount(ctetidx, 'A', 10000)
+        obs = []
+        for t in [0.002, 0.01, 0.05]:
+            sim.run(t)
+            for s in range(len(shells)):
+                n = sum([sim.getTetCount(i, 'A') for i in shells[s]])
+                obs.append(('shell%d@%g' % (s, t), n))
+        return obs
+    return sim, 50, run
+
+########################################################################
+
+def wl_diffusion_boundary():
+    mdl = smodel.Model()
+    X = smodel.Spec('X', mdl)
+    Y = smodel.Spec('Y', mdl)
+    vsysA = smodel.Volsys('vsysA', mdl)
+    vsysB = smodel.Volsys('vsysB', mdl)
+    smodel.Diff('diff_X_A', vsysA, X, dcst = 0.1e-9)
+    smodel.Diff('diff_X_B', vsysB, X, dcst = 0.1e-9)
+    smodel.Diff('diff_Y_A', vsysA, Y, dcst = 0.1e-9)
+    smodel.Diff('diff_Y_B', vsysB, Y, dcst = 0.1e-9)
+
+    mesh = smeshio.loadMesh(os.path.join(MESHDIR, 'cyl_len10_diam1'))[0]
+    ntets = mesh.countTets()
+    z_min = mesh.getBoundMin()[2]
+    z_mid = z_min + (mesh.getBoundMax()[2] - z_min) / 2.0
+    tets_compA = []
+    tets_compB = []
+    tris_compA = set()
+    tris_compB = set()
+    for t in range(ntets):
+        if mesh.getTetBarycenter(t)[2] < z_mid:
+            tets_compA.append(t)
+            tris_compA.update(mesh.getTetTriNeighb(t))
+        else:
+            tets_compB.append(t)
+            tris_compB.update(mesh.getTetTriNeighb(t))
+    compA = sgeom.TmComp('compA', mesh, tets_compA)
+    compB = sgeom.TmComp('compB', mesh, tets_compB)
+    compA.addVolsys('vsysA')
+    compB.addVolsys('vsysB')
+    sgeom.DiffBoundary('diffb', mesh, list(tris_compA & tris_compB))
+
+    # The half of compartment A next to the boundary.
+    z_quarter = (z_min + z_mid) / 2.0
+    nearA = [t for t in tets_compA if mesh.getTetBarycenter(t)[2] > z_quarter]
+
+    tetx = mesh.findTetByPoint([0, 0, -4.99e-6])
+    tety = mesh.findTetByPoint([0, 0, 4.99e-6])
+
+    sim = _tetexact(mdl, mesh)
+
+    def run():
+        sim.reset()
+        sim.setTetCount(tetx, 'X', 1000)
+        sim.setTetCount(tety, 'Y', 500)
+        sim.setDiffBoundaryDiffusionActive('diffb', 'Y', True)
+        obs = []
+        for t in [0.01, 0.05, 0.1]:
+            sim.run(t)
+            obs.append(('YinA@%g' % t, sim.getCompCount('compA', 'Y')))
+            obs.append(('XnearB@%g' % t, \
+                sum([sim.getTetCount(i, 'X') for i in nearA])))
+        return obs
+    return sim, 50, run
+
+########################################################################
+
+def wl_ip3():
+    mdl = smodel.Model()
+    Ca = smodel.Spec('Ca', mdl)
+    IP3 = smodel.Spec('IP3', mdl)
+    R = smodel.Spec('R', mdl)
+    RIP3 = smodel.Spec('RIP3', mdl)
+    Ropen = smodel.Spec('Ropen', mdl)
+    RCa = smodel.Spec('RCa', mdl)
+    R2Ca = smodel.Spec('R2Ca', mdl)
+    R3Ca = smodel.Spec('R3Ca', mdl)
+    R4Ca = smodel.Spec('R4Ca', mdl)
+    ssys = smodel.Surfsys('ssys', mdl)
+
+    def sreac(id, kcst, **kw):
+        smodel.SReac(id, ssys, kcst = kcst, **kw)
+    sreac('R_bind_IP3_f', 1000e6, olhs = [IP3], slhs = [R], srhs = [RIP3])
+    sreac('RIP3_bind_Ca_f', 8000e6, olhs = [Ca], slhs = [RIP3], srhs = [Ropen])
+    sreac('R_bind_Ca_f', 8.889e6, olhs = [Ca], slhs = [R], srhs = [RCa])
+    sreac('RCa_bind_Ca_f', 20e6, olhs = [Ca], slhs = [RCa], srhs = [R2Ca])
+    sreac('R2Ca_bind_Ca_f', 40e6, olhs = [Ca], slhs = [R2Ca], srhs = [R3Ca])
+    sreac('R3Ca_bind_ca_f', 60e6, olhs = [Ca], slhs = [R3Ca], srhs = [R4Ca])
+    sreac('R_bind_IP3_b', 25800, slhs = [RIP3], orhs = [IP3], srhs = [R])
+    sreac('RIP3_bind_Ca_b', 2000, slhs = [Ropen], orhs = [Ca], srhs = [RIP3])
+    sreac('R_bind_Ca_b', 5, slhs = [RCa], orhs = [Ca], srhs = [R])
+    sreac('RCa_bind_Ca_b', 10, slhs = [R2Ca], orhs = [Ca], srhs = [RCa])
+    sreac('R2Ca_bind_Ca_b', 15, slhs = [R3Ca], orhs = [Ca], srhs = [R2Ca])
+    sreac('R3Ca_bind_ca_b', 20, slhs = [R4Ca], orhs = [Ca], srhs = [R3Ca])
+    sreac('R_Ca_channel_f', 2e8, ilhs = [Ca], slhs = [Ropen], orhs = [Ca], \
+        srhs = [Ropen])
+
+    geom = sgeom.Geom()
+    cyt = sgeom.Comp('cyt', geom)
+    cyt.setVol(1.6572e-19)
+    ER = sgeom.Comp('ER', geom, vol = 1.968e-20)
+    memb = sgeom.Patch('memb', geom, ER, cyt)
+    memb.addSurfsys('ssys')
+    memb.setArea(0.4143e-12)
+
+    sim = ssolver.Wmdirect(mdl, geom, _rng())
+
+    def run():
+        sim.reset()
+        sim.setCompConc('cyt', 'Ca', 3.30657e-8)
+        sim.setCompCount('cyt', 'IP3', 6)
+        sim.setCompConc('ER', 'Ca', 150e-6)
+        sim.setCompClamped('ER', 'Ca', True)
+        sim.setPatchCount('memb', 'R', 160)
+        obs = []
+        for t in [0.01, 0.05, 0.2]:
+            sim.run(t)
+            obs.append(('Ropen@%g' % t, sim.getPatchCount('memb', 'Ropen')))
+            obs.append(('Ca_uM@%g' % t, 1.0e6 * sim.getCompConc('cyt', 'Ca')))
+        return obs
+    return sim, 200, run
+
+########################################################################
+
+def wl_HH_APprop():
+    mdl = _hh_model()
+    mesh = smeshio.importAbaqus(os.path.join(MESHDIR, \
+        'axon_cube_L1000um_D443nm_equiv0.5_19087tets.inp'), 1e-6)[0]
+
+    zmin = mesh.getBoundMin()[2]
+    zmax = mesh.getBoundMax()[2]
+    injverts = [v for v in range(mesh.nverts) \
+        if mesh.getVertex(v)[2] < zmin + 0.1e-6]
+    injset = set(injverts)
+    memb_tris = [t for t in mesh.getSurfTris() \
+        if not set(mesh.getTri(t)) <= injset]
+
+    cyto = sgeom.TmComp('cyto', mesh, range(mesh.ntets))
+    patch = sgeom.TmPatch('patch', mesh, memb_tris, cyto)
+    patch.addSurfsys('ssys')
+    sgeom.Memb('membrane', mesh, [patch], opt_method = 1)
+
+    # The tets on the axis at a quarter, half and three quarters.
+    pot_tets = [mesh.findTetByPoint([0.0, 0.0, zmin + f * (zmax - zmin)]) \
+        for f in [0.25, 0.5, 0.75]]
+
+    sim = _tetexact(mdl, mesh, True)
+    area = sim.getPatchArea('patch')
+    K_facs = [0.21768, 0.40513, 0.28093, 0.08647, 0.00979]
+    Na_facs = [[0.34412, 0.05733, 0.00327, 6.0e-05], \
+        [0.50558, 0.08504, 0.00449, 0.00010]]
+
+    def run():
+        sim.reset()
+        for i in range(5):
+            sim.setPatchCount('patch', 'K_n%d' % i, 18.0e12 * area * K_facs[i])
+        for h in range(2):
+            for m in range(4):
+                sim.setPatchCount('patch', 'Na_m%dh%d' % (m, h), \
+                    60.0e12 * area * Na_facs[h][m])
+        sim.setPatchCount('patch', 'Leak', 10.0e12 * area)
+        sim.setEfieldDT(1.0e-5)
+        sim.setMembPotential('membrane', -65e-3)
+        sim.setMembCapac('membrane', 1.0e-2)
+        sim.setMembVolRes('membrane', 1.0)
+        for v in injverts:
+            sim.setVertIClamp(v, 50.0e-12 / len(injverts))
+        obs = []
+        for t in [1.0e-3, 2.0e-3, 4.0e-3]:
+            sim.run(t)
+            for i in range(len(pot_tets)):
+                obs.append(('V%d_mV@%g' % (i, t), 1.0e3 * sim.getTetV(pot_tets[i])))
+        return obs
+    return sim, 10, run
+
+########################################################################
+
+WORKLOADS = [('well_mixed', wl_well_mixed), ('diffusion', wl_diffusion), \
+    ('diffusion_boundary', wl_diffusion_boundary), ('ip3', wl_ip3), \
+    ('HH_APprop', wl_HH_APprop)]
+
+def run_workload(name, scale):
+    sim, niter, run = dict(WORKLOADS)[name]()
+    niter = max(2, int(round(niter * scale)))
+    samples = {}
+    order = []
+    secs = 0.0
+    events = 0
+    for i in range(niter):
+        t0 = time.time()
+        obs = run()
+        secs += time.time() - t0
+        events += sim.getNSteps()
+        for key, val in obs:
+            if key not in samples:
+                samples[key] = []
+                order.append(key)
+            samples[key].append(float(val))
+    stats = {}
+    for key in order:
+        x = samples[key]
+        n = len(x)
+        mean = sum(x) / n
+        var = sum([(v - mean) ** 2 for v in x]) / (n - 1)
+        stats[key] = {'n': n, 'mean': mean, 'var': var}
+    return {'order': order, 'stats': stats, 'rate': events / max(secs, 1.0e-9), \
+        'scheduler': SCHEDULER, 'tauleap': TAULEAP}
+
+########################################################################
+
+def _zmean(s, r):
+    se2 = s['var'] / s['n'] + r['var'] / r['n']
+    if se2 == 0.0:
+        if s['mean'] == r['mean']: return 0.0
+        return float('inf')
+    return (s['mean'] - r['mean']) / math.sqrt(se2)
+
+def _zvar(s, r):
+    if s['var'] == 0.0 or r['var'] == 0.0:
+        if s['var'] == r['var']: return 0.0
+        return float('inf')
+    se = math.sqrt(2.0 / (s['n'] - 1) + 2.0 / (r['n'] - 1))
+    return math.log(s['var'] / r['var']) / se
+
+def compare(name, res, ref):
+    nfail = 0
+    print '%s: %.0f events/s (reference %.0f, recorded with %s%s)' \
+        % (name, res['rate'], ref['rate'], ref['scheduler'], \
+        ref['tauleap'] and ' + tau-leaping' or '')
+    for key in res['order']:
+        s = res['stats'][key]
+        if key not in ref['stats']:
+            print '  %-16s no reference' % key
+            nfail += 1
+            continue
+        r = ref['stats'][key]
+        zm = _zmean(s, r)
+        zv = _zvar(s, r)
+        ok = abs(zm) <= ZCRIT and abs(zv) <= ZCRIT
+        if not ok: nfail += 1
+        print '  %-16s mean %12.5g (ref %12.5g, z %6.2f)  var %12.5g (ref %12.5g, z %6.2f)  %s' \
+            % (key, s['mean'], r['mean'], zm, s['var'], r['var'], zv, \
+            ok and 'ok' or 'FAIL')
+    return nfail
+
+########################################################################
+
+def check_restore():
+    mdl = smodel.Model()
+    A = smodel.Spec('A', mdl)
+    B = smodel.Spec('B', mdl)
+    vsys = smodel.Volsys('cytosolv', mdl)
+    smodel.Diff('diff_A', vsys, A, dcst = 20.0e-12)
+    smodel.Reac('kreac_f', vsys, lhs = [A], rhs = [B], kcst = 10.0)
+    smodel.Reac('kreac_b', vsys, lhs = [B], rhs = [A], kcst = 5.0)
+
+    mesh = smeshio.loadMesh(os.path.join(MESHDIR, 'sphere_rad10_11Ktets'))[0]
+    comp = sgeom.TmComp('cyto', mesh, range(mesh.countTets()))
+    comp.addVolsys('cytosolv')
+    ctetidx = mesh.findTetByPoint([0.0, 0.0, 0.0])
+
+    fd, cpfile = tempfile.mkstemp(suffix = '.cp')
+    os.close(fd)
+    nfail = 0
+    for sched in ['cr', 'direct', 'nrm', 'sdm']:
+        r = srng.create('mt19937', 512)
+        def make_solver():
+            r.initialize(SEED)
+            sim = ssolver.Tetexact(mdl, mesh, r, False, sched)
+            sim.setTetCount(ctetidx, 'A', 1000)
+            return sim
+        def reseed():
+            r.initialize(SEED + 1)
+        try:
+            srepro.checkRestore(make_solver, reseed, 0.005, [0.01, 0.02], cpfile)
+            print 'restore %s: ok' % sched
+        except RuntimeError, e:
+            print 'restore %s: FAIL (%s)' % (sched, e)
+            nfail += 1
+    os.remove(cpfile)
+    return nfail
+
+########################################################################
+
+if __name__ == '__main__':
+    parser = optparse.OptionParser(usage = 'python regression.py [options] [workload ...]')
+    parser.add_option('--record', action = 'store_true', default = False)
+    parser.add_option('--ref', default = REFFILE)
+    parser.add_option('--scheduler', default = 'cr')
+    parser.add_option('--tauleap', action = 'store_true', default = False)
+    parser.add_option('--scale', type = 'float', default = 1.0)
+    parser.add_option('--restore', action = 'store_true', default = False)
+    opts, names = parser.parse_args()
+    SCHEDULER = opts.scheduler
+    TAULEAP = opts.tauleap
+
+    if opts.restore:
+        nfail = check_restore()
+        if nfail != 0:
+            print '%d failures' % nfail
+            sys.exit(1)
+        sys.exit(0)
+
+    names = names or [n for n, f in WORKLOADS]
+    for name in names:
+        if name not in dict(WORKLOADS):
+            print 'Unknown workload %s (expected one of %s)' \
+                % (name, ', '.join([n for n, f in WORKLOADS]))
+            sys.exit(1)
+
+    refs = {}
+    if os.path.exists(opts.ref):
+        refs = json.load(open(opts.ref))
+    elif not opts.record:
+        print 'No reference file %s: record one with --record' % opts.ref
+        sys.exit(1)
+
+    nfail = 0
+    for name in names:
+        res = run_workload(name, opts.scale)
+        if opts.record:
+            refs[name] = res
+            print '%s: recorded %d observables, %.0f events/s' \
+                % (name, len(res['order']), res['rate'])
+        elif name not in refs:
+            print '%s: no reference' % name
+            nfail += 1
+        else:
+            nfail += compare(name, res, refs[name])
+
+    if opts.record:
+        json.dump(refs, open(opts.ref, 'w'), indent = 1, sort_keys = True)
+    elif nfail != 0:
+        print '%d failures' % nfail
+        sys.exit(1)
+
+########################################################################
+
+# END
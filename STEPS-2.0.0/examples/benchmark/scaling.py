@@ -0,0 +1,444 @@
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# STEPS - STochastic Engine for Pathway Simulation
+# Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+# Copyright (C) 2003-2006 University of Antwerp, Belgium.
+#
+# See the file AUTHORS for details.
+#
+# This file is part of STEPS.
+#
+# STEPS is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# STEPS is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+# Benchmark: strong and weak scaling of the parallel modes
+# Sweeps the thread count of each parallel mode over meshes generated
+# here, a cube or a cylinder of edge H cells split into 6 tetrahedrons
+# each, so that meshes of any size can be compared:
+#
+#   mesh      building the Tetmesh connectivity (Tetmesh nthreads)
+#   tetexact  A + B <-> C with diffusion, SSA on clusters of the mesh
+#             (Tetexact.setClusters, one cluster per thread)
+#   tetleap   the same model, spatial tau-leaping (Tetleap threads)
+#   tetode    the same model, deterministic (TetODE.setNThreads)
+#   efield    passive membrane driven by a current clamp (Tetexact
+#             with setEfieldThreads)
+#
+# Strong scaling runs each mesh size on every thread count. Weak
+# scaling grows the mesh with the number of cores, at the cell size H
+# so that the work per tetrahedron stays the same. STEPS has no MPI
+# layer, so the ranks of the weak sweep are independent processes run
+# at the same time, each on the mesh for its threads, as an ensemble
+# would be: they show what the cores share (memory bandwidth, caches).
+#
+# Speedup is the 1-core time over the time on n cores, the weak one
+# scaled by the ratio of the mesh sizes; efficiency is speedup / n.
+# Memory per core is the sum of the high-water marks of the processes
+# over the cores. Every point runs in processes of its own, and the
+# results are written as JSON with the machine and version so that
+# releases can be compared.
+#
+# Usage: python scaling.py [options] [mode ...]   (default: all)
+#
+# Options: --mesh cube|cylinder|both, --sizes N,N,.. (cells along the
+# edge of the cube, or the diameter of the cylinder, for strong
+# scaling), --weak N (the 1-core size of weak scaling), --threads
+# N,N,.. and --ranks N,N,.. (weak scaling only), --scaling
+# strong|weak|both and --out FILE (default scaling.json).
+
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+import json
+import math
+import optparse
+import os
+import platform
+import resource
+import subprocess
+import sys
+import time
+
+import steps
+import steps.model as smodel
+import steps.solver as ssolver
+import steps.geom as sgeom
+import steps.rng as srng
+
+########################################################################
+
+SEED = 2903
+
+# Edge of a mesh cell (m); the cylinder is CYL_ASPECT times as long as
+# it is wide.
+H = 0.2e-6
+CYL_ASPECT = 4
+
+# Molecules of A and B per tetrahedron, and rates.
+NPERTET = 5
+KF = 1.0e8
+KB = 10.0
+DCST = 1.0e-12
+
+TETEXACT_ENDTIME = 1.0e-3
+TETLEAP_ENDTIME = 1.0e-3
+TETLEAP_TAU = 1.0e-5
+TETODE_ENDTIME = 1.0e-2
+
+EF_ENDTIME = 1.0e-3
+EF_DT = 1.0e-5
+
+########################################################################
+
+def _maxrss():
+    # Kilobytes on Linux.
+    return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+def _rng():
+    r = srng.create('mt19937', 512)
+    r.initialize(SEED)
+    return r
+
+def _ncpus():
+    try:
+        import multiprocessing
+        return multiprocessing.cpu_count()
+    except (ImportError, NotImplementedError):
+        return 1
+
+########################################################################
+
+def _grid(nx, ny, nz):
+    # Vertices and tetrahedrons of nx * ny * nz unit cells, each split
+    # into 6 tetrahedrons around its diagonal from corner 0 to corner 7
+    # (corner b at offset (b & 1, b >> 1 & 1, b >> 2 & 1)); the split is
+    # the same in every cell, so the faces of neighbours match.
+    verts = []
+    for k in range(nz + 1):
+        for j in range(ny + 1):
+            for i in range(nx + 1):
+                verts.append((float(i), float(j), float(k)))
+    vidx = lambda i, j, k: (k * (ny + 1) + j) * (nx + 1) + i
+    paths = [(1, 2), (1, 4), (2, 1), (2, 4), (4, 1), (4, 2)]
+    tets = []
+    for k in range(nz):
+        for j in range(ny):
+            for i in range(nx):
+                c = [vidx(i + (b & 1), j + (b >> 1 & 1), k + (b >> 2 & 1)) \
+                    for b in range(8)]
+                for a, b in paths:
+                    tets.extend([c[0], c[a], c[a | b], c[7]])
+    return verts, tets
+
+def make_mesh(kind, n, nthreads = 1):
+    """
+    A cube of n cells along each edge, or a cylinder of n cells across
+    and CYL_ASPECT * n along, with cells of edge about H.
+    """
+    if kind == 'cube':
+        verts, tets = _grid(n, n, n)
+        coords = []
+        for x, y, z in verts:
+            coords.extend([x * H, y * H, z * H])
+    elif kind == 'cylinder':
+        verts, tets = _grid(n, n, CYL_ASPECT * n)
+        # Map the square cross-section onto the disk, keeping the cells.
+        r = 0.5 * n * H
+        coords = []
+        for x, y, z in verts:
+            u = 2.0 * x / n - 1.0
+            v = 2.0 * y / n - 1.0
+            coords.extend([r * u * math.sqrt(1.0 - 0.5 * v * v), \
+                r * v * math.sqrt(1.0 - 0.5 * u * u), z * H])
+    else:
+        raise ValueError('Unknown mesh %s' % kind)
+    return sgeom.Tetmesh(coords, tets, [], nthreads)
+
+def mesh_ntets(kind, n):
+    if kind == 'cube':
+        return 6 * n * n * n
+    return 6 * CYL_ASPECT * n * n * n
+
+def weak_size(n0, cores):
+    # The size with cores times the tetrahedrons of size n0.
+    return max(1, int(round(n0 * math.pow(cores, 1.0 / 3.0))))
+
+########################################################################
+
+def _model():
+    mdl = smodel.Model()
+    vsys = smodel.Volsys('vsys', mdl)
+    A = smodel.Spec('A', mdl)
+    B = smodel.Spec('B', mdl)
+    C = smodel.Spec('C', mdl)
+    smodel.Reac('fwd', vsys, lhs = [A, B], rhs = [C], kcst = KF)
+    smodel.Reac('bwd', vsys, lhs = [C], rhs = [A, B], kcst = KB)
+    smodel.Diff('diffA', vsys, A, dcst = DCST)
+    smodel.Diff('diffB', vsys, B, dcst = DCST)
+    return mdl
+
+def _geom(kind, n):
+    mesh = make_mesh(kind, n)
+    comp = sgeom.TmComp('cyto', mesh, range(mesh.ntets))
+    comp.addVolsys('vsys')
+    return mesh
+
+def _init(sim, mesh):
+    # A on the lower half, B everywhere.
+    zmid = 0.5 * (mesh.getBoundMin()[2] + mesh.getBoundMax()[2])
+    for t in range(mesh.ntets):
+        if mesh.getTetBarycenter(t)[2] < zmid:
+            sim.setTetCount(t, 'A', 2 * NPERTET)
+    sim.setCompCount('cyto', 'B', NPERTET * mesh.ntets)
+
+def bench_mesh(kind, n, nthreads):
+    t0 = time.time()
+    mesh = make_mesh(kind, n, nthreads)
+    t1 = time.time()
+    return {'setup': 0.0, 'run': t1 - t0}
+
+def bench_tetexact(kind, n, nthreads):
+    mdl = _model()
+    mesh = _geom(kind, n)
+    t0 = time.time()
+    sim = ssolver.Tetexact(mdl, mesh, _rng())
+    if nthreads > 1:
+        sim.setClusters(nthreads, nthreads)
+    t1 = time.time()
+    sim.reset()
+    _init(sim, mesh)
+    t2 = time.time()
+    sim.run(TETEXACT_ENDTIME)
+    t3 = time.time()
+    return {'setup': t1 - t0, 'run': t3 - t2, 'events': sim.getNSteps()}
+
+def bench_tetleap(kind, n, nthreads):
+    mdl = _model()
+    mesh = _geom(kind, n)
+    t0 = time.time()
+    sim = ssolver.Tetleap(mdl, mesh, _rng(), TETLEAP_TAU, nthreads)
+    t1 = time.time()
+    sim.reset()
+    _init(sim, mesh)
+    t2 = time.time()
+    sim.run(TETLEAP_ENDTIME)
+    t3 = time.time()
+    return {'setup': t1 - t0, 'run': t3 - t2, 'events': sim.getNSteps()}
+
+def bench_tetode(kind, n, nthreads):
+    mdl = _model()
+    mesh = _geom(kind, n)
+    t0 = time.time()
+    sim = ssolver.TetODE(mdl, mesh)
+    sim.setNThreads(nthreads)
+    t1 = time.time()
+    sim.setTolerances(1.0e-3, 1.0e-4)
+    _init(sim, mesh)
+    t2 = time.time()
+    sim.run(TETODE_ENDTIME)
+    t3 = time.time()
+    return {'setup': t1 - t0, 'run': t3 - t2}
+
+def bench_efield(kind, n, nthreads):
+    mdl = smodel.Model()
+    ssys = smodel.Surfsys('ssys', mdl)
+    L = smodel.Chan('L', mdl)
+    leak = smodel.ChanState('Leak', mdl, L)
+    smodel.OhmicCurr('OC_L', ssys, chanstate = leak, g = 0.3e-12, \
+        erev = -54.4e-3)
+
+    mesh = make_mesh(kind, n)
+    zmin = mesh.getBoundMin()[2]
+    injverts = [v for v in range(mesh.nverts) \
+        if mesh.getVertex(v)[2] < zmin + 0.5 * H]
+    cyto = sgeom.TmComp('cyto', mesh, range(mesh.ntets))
+    patch = sgeom.TmPatch('patch', mesh, mesh.getSurfTris(), cyto)
+    patch.addSurfsys('ssys')
+    sgeom.Memb('membrane', mesh, [patch], opt_method = 1)
+
+    t0 = time.time()
+    sim = ssolver.Tetexact(mdl, mesh, _rng(), True)
+    sim.setEfieldThreads(nthreads)
+    t1 = time.time()
+    sim.reset()
+    sim.setPatchCount('patch', 'Leak', 10.0e12 * sim.getPatchArea('patch'))
+    sim.setEfieldDT(EF_DT)
+    sim.setMembPotential('membrane', -65e-3)
+    sim.setMembCapac('membrane', 1.0e-2)
+    sim.setMembVolRes('membrane', 1.0)
+    for v in injverts:
+        sim.setVertIClamp(v, 1.0e-12 / len(injverts))
+    t2 = time.time()
+    sim.run(EF_ENDTIME)
+    t3 = time.time()
+    return {'setup': t1 - t0, 'run': t3 - t2}
+
+########################################################################
+
+MODES = [('mesh', bench_mesh), ('tetexact', bench_tetexact), \
+    ('tetleap', bench_tetleap), ('tetode', bench_tetode), \
+    ('efield', bench_efield)]
+
+def _run_one(mode, kind, n, nthreads):
+    res = dict(MODES)[mode](kind, n, nthreads)
+    res['maxrss'] = _maxrss()
+    print 'RESULT', ' '.join(['%s=%r' % kv for kv in res.items()])
+
+def _parse(out):
+    for l in out.splitlines():
+        if l.startswith('RESULT '):
+            return dict([(kv.split('=')[0], eval(kv.split('=')[1])) \
+                for kv in l.split()[1:]])
+    return None
+
+def run_point(mode, kind, n, nthreads, nranks = 1):
+    """
+    Run nranks processes of mode on mesh (kind, n) with nthreads
+    threads each, all at once. Return the slowest run and setup times,
+    the total events and the summed high-water mark, or None if any
+    process failed.
+    """
+    cmd = [sys.executable, os.path.abspath(__file__), '--one', mode, \
+        kind, str(n), str(nthreads)]
+    procs = [subprocess.Popen(cmd, stdout = subprocess.PIPE) \
+        for r in range(nranks)]
+    outs = [_parse(p.communicate()[0]) for p in procs]
+    if None in outs:
+        return None
+    res = {'setup': max([o['setup'] for o in outs]), \
+        'run': max([o['run'] for o in outs]), \
+        'maxrss': sum([o['maxrss'] for o in outs])}
+    if 'events' in outs[0]:
+        res['events'] = sum([o['events'] for o in outs])
+    return res
+
+########################################################################
+
+def _record(scaling, mode, kind, n, nthreads, nranks, res, base):
+    cores = nthreads * nranks
+    ntets = mesh_ntets(kind, n)
+    rec = {'scaling': scaling, 'mode': mode, 'mesh': kind, 'size': n, \
+        'ntets': ntets, 'threads': nthreads, 'ranks': nranks, \
+        'cores': cores, 'setup': res['setup'], 'run': res['run'], \
+        'maxrss_kb': res['maxrss'], \
+        'mem_per_core_mb': res['maxrss'] / 1024.0 / cores}
+    if 'events' in res:
+        rec['events'] = res['events']
+    if base is not None and res['run'] > 0.0:
+        # Work on n cores over work on one, per unit time.
+        work = float(ntets * nranks) / base['ntets']
+        if scaling == 'strong':
+            work = 1.0
+        rec['speedup'] = work * base['run'] / res['run']
+        rec['efficiency'] = rec['speedup'] / cores
+    return rec
+
+def _report(rec):
+    line = '%-6s %-8s %-8s %5d tets %7d  %2dx%-2d  run %8.3f s  %7.1f MB/core' \
+        % (rec['scaling'], rec['mode'], rec['mesh'], rec['size'], \
+        rec['ntets'], rec['ranks'], rec['threads'], rec['run'], \
+        rec['mem_per_core_mb'])
+    if 'speedup' in rec:
+        line += '  speedup %5.2f  eff %5.2f' \
+            % (rec['speedup'], rec['efficiency'])
+    print line
+    sys.stdout.flush()
+
+def _ints(s):
+    return [int(x) for x in s.split(',') if x]
+
+########################################################################
+
+if __name__ == '__main__':
+    args = sys.argv[1:]
+    if len(args) == 5 and args[0] == '--one':
+        _run_one(args[1], args[2], int(args[3]), int(args[4]))
+        sys.exit(0)
+
+    ncpus = _ncpus()
+    pow2 = [1]
+    while pow2[-1] * 2 <= ncpus:
+        pow2.append(pow2[-1] * 2)
+
+    parser = optparse.OptionParser(usage = 'python scaling.py [options] [mode ...]')
+    parser.add_option('--mesh', default = 'both')
+    parser.add_option('--sizes', default = '8,16')
+    parser.add_option('--weak', type = 'int', default = 8)
+    parser.add_option('--threads', default = ','.join(map(str, pow2)))
+    parser.add_option('--ranks', default = '1')
+    parser.add_option('--scaling', default = 'both')
+    parser.add_option('--out', default = 'scaling.json')
+    opts, names = parser.parse_args()
+
+    names = names or [m for m, f in MODES]
+    for name in names:
+        if name not in dict(MODES):
+            print 'Unknown mode %s (expected one of %s)' \
+                % (name, ', '.join([m for m, f in MODES]))
+            sys.exit(1)
+    kinds = ['cube', 'cylinder']
+    if opts.mesh != 'both':
+        kinds = [opts.mesh]
+    threads = _ints(opts.threads)
+    ranks = _ints(opts.ranks)
+
+    records = []
+    failed = 0
+    for mode in names:
+        for kind in kinds:
+            if opts.scaling in ('strong', 'both'):
+                for n in _ints(opts.sizes):
+                    base = None
+                    for nt in threads:
+                        res = run_point(mode, kind, n, nt)
+                        if res is None:
+                            print 'strong %-8s %-8s %5d  1x%-2d failed' \
+                                % (mode, kind, n, nt)
+                            failed += 1
+                            continue
+                        rec = _record('strong', mode, kind, n, nt, 1, \
+                            res, base)
+                        if nt == 1:
+                            base = rec
+                        _report(rec)
+                        records.append(rec)
+            if opts.scaling in ('weak', 'both'):
+                base = None
+                for nr in ranks:
+                    for nt in threads:
+                        n = weak_size(opts.weak, nt)
+                        res = run_point(mode, kind, n, nt, nr)
+                        if res is None:
+                            print 'weak   %-8s %-8s %5d  %dx%-2d failed' \
+                                % (mode, kind, n, nr, nt)
+                            failed += 1
+                            continue
+                        rec = _record('weak', mode, kind, n, nt, nr, \
+                            res, base)
+                        if nr == 1 and nt == 1:
+                            base = rec
+                        _report(rec)
+                        records.append(rec)
+
+    doc = {'version': steps.__version__, 'date': time.strftime('%Y-%m-%d %H:%M:%S'), \
+        'host': platform.node(), 'machine': platform.machine(), \
+        'platform': platform.platform(), 'python': platform.python_version(), \
+        'ncpus': ncpus, 'h': H, 'results': records}
+    json.dump(doc, open(opts.out, 'w'), indent = 1, sort_keys = True)
+    print 'Wrote %d results to %s' % (len(records), opts.out)
+    if failed != 0:
+        sys.exit(1)
+
+########################################################################
+
+# END
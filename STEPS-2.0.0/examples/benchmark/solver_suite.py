@@ -0,0 +1,351 @@
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# STEPS - STochastic Engine for Pathway Simulation
+# Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+# Copyright (C) 2003-2006 University of Antwerp, Belgium.
+#
+# See the file AUTHORS for details.
+#
+# This file is part of STEPS.
+#
+# STEPS is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# STEPS is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+# Benchmark suite: solver hot paths
+# Representative workloads for each solver, run with fixed seeds so that
+# the numbers are comparable between builds:
+#
+#   wmdirect   well-mixed enzyme network, SSA
+#   wmrk4      the same network, fixed step RK4
+#   tetexact   diffusion from a point source along a cylinder (as in
+#              the diffusion tutorial)
+#   efield     Hodgkin-Huxley action potential along an axon (as in the
+#              HH_APprop tutorial), with the membrane potential
+#   tetode     diffusion and binding in a sphere, deterministic
+#
+# For each it reports the setup time, the run time, the event rate
+# where the solver counts events, the memory high-water mark and, for
+# the EField run, the cost of an EField step. Every workload runs in a
+# process of its own so that the high-water marks are its own.
+#
+# Usage: python solver_suite.py [workload ...]   (default: all)
+
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+import math
+import os
+import resource
+import subprocess
+import sys
+import time
+
+import steps.model as smodel
+import steps.solver as ssolver
+import steps.geom as sgeom
+import steps.rng as srng
+
+import steps.utilities.meshio as smeshio
+
+########################################################################
+
+MESHDIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), \
+    '..', 'tutorial', 'meshes')
+
+SEED = 2903
+
+# Well-mixed network: NENZ substrates, each converted by the same
+# enzyme and converted back, in a compartment of WM_VOL (m^3).
+NENZ = 20
+WM_VOL = 1.0e-18
+WM_ENDTIME = 0.5
+RK4_DT = 1.0e-5
+
+# Cylinder diffusion: NINJECT molecules injected at one end.
+NINJECT = 100000
+DIFF_DCST = 20.0e-12
+DIFF_ENDTIME = 0.02
+
+# Axon action potential: simulated time and EField step (s).
+EF_ENDTIME = 2.0e-3
+EF_DT = 1.0e-5
+
+# Deterministic sphere: molecules per tetrahedron of each reactant.
+ODE_NPERTET = 10
+ODE_ENDTIME = 0.01
+
+########################################################################
+
+def _maxrss():
+    # Kilobytes on Linux.
+    return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+def _rng():
+    r = srng.create('mt19937', 512)
+    r.initialize(SEED)
+    return r
+
+########################################################################
+
+def _wm_model():
+    mdl = smodel.Model()
+    vsys = smodel.Volsys('vsys', mdl)
+    E = smodel.Spec('E', mdl)
+    for i in range(NENZ):
+        S = smodel.Spec('S%d' % i, mdl)
+        ES = smodel.Spec('ES%d' % i, mdl)
+        P = smodel.Spec('P%d' % i, mdl)
+        smodel.Reac('bind%d' % i, vsys, lhs = [S, E], rhs = [ES], kcst = 1.0e7)
+        smodel.Reac('unbind%d' % i, vsys, lhs = [ES], rhs = [S, E], kcst = 100.0)
+        smodel.Reac('cat%d' % i, vsys, lhs = [ES], rhs = [P, E], kcst = 50.0)
+        smodel.Reac('back%d' % i, vsys, lhs = [P], rhs = [S], kcst = 10.0)
+    geom = sgeom.Geom()
+    comp = sgeom.Comp('comp', geom)
+    comp.addVolsys('vsys')
+    comp.setVol(WM_VOL)
+    return mdl, geom
+
+def _wm_init(sim):
+    sim.reset()
+    sim.setCompConc('comp', 'E', 1.0e-6)
+    for i in range(NENZ):
+        sim.setCompConc('comp', 'S%d' % i, 5.0e-6)
+
+def bench_wmdirect():
+    mdl, geom = _wm_model()
+    t0 = time.time()
+    sim = ssolver.Wmdirect(mdl, geom, _rng())
+    t1 = time.time()
+    _wm_init(sim)
+    sim.run(WM_ENDTIME)
+    t2 = time.time()
+    return {'setup': t1 - t0, 'run': t2 - t1, 'events': sim.getNSteps()}
+
+def bench_wmrk4():
+    mdl, geom = _wm_model()
+    t0 = time.time()
+    sim = ssolver.Wmrk4(mdl, geom)
+    t1 = time.time()
+    sim.setRk4DT(RK4_DT)
+    _wm_init(sim)
+    sim.run(WM_ENDTIME)
+    t2 = time.time()
+    # One "event" per integration step.
+    return {'setup': t1 - t0, 'run': t2 - t1, \
+        'events': int(round(WM_ENDTIME / RK4_DT))}
+
+########################################################################
+
+def bench_tetexact():
+    mdl = smodel.Model()
+    vsys = smodel.Volsys('vsys', mdl)
+    X = smodel.Spec('X', mdl)
+    smodel.Diff('diffX', vsys, X, dcst = DIFF_DCST)
+
+    mesh = smeshio.loadMesh(os.path.join(MESHDIR, 'cyl_len10_diam1'))[0]
+    comp = sgeom.TmComp('cyto', mesh, range(mesh.ntets))
+    comp.addVolsys('vsys')
+
+    # Inject on the axis, next to the end of the longest extent.
+    bmin = mesh.getBoundMin()
+    bmax = mesh.getBoundMax()
+    ext = [bmax[i] - bmin[i] for i in range(3)]
+    axis = ext.index(max(ext))
+    p = [0.5 * (bmin[i] + bmax[i]) for i in range(3)]
+    p[axis] = bmin[axis] + 0.01 * ext[axis]
+
+    t0 = time.time()
+    sim = ssolver.Tetexact(mdl, mesh, _rng())
+    t1 = time.time()
+    sim.reset()
+    sim.setTetCount(mesh.findTetByPoint(p), 'X', NINJECT)
+    sim.run(DIFF_ENDTIME)
+    t2 = time.time()
+    return {'setup': t1 - t0, 'run': t2 - t1, 'events': sim.getNSteps()}
+
+########################################################################
+
+def _hh_model():
+    mdl = smodel.Model()
+    ssys = smodel.Surfsys('ssys', mdl)
+    vrange = [-100.0e-3, 50e-3, 1e-4]
+
+    thi = math.pow(3.0, ((20.0 - 6.3) / 10.0))
+    a_n = lambda mV: thi * ((0.01 * (10 - (mV + 65.)) / (math.exp((10 - (mV + 65.)) / 10.) - 1)))
+    b_n = lambda mV: thi * ((0.125 * math.exp(-(mV + 65.) / 80.)))
+    a_m = lambda mV: thi * ((0.1 * (25 - (mV + 65.)) / (math.exp((25 - (mV + 65.)) / 10.) - 1)))
+    b_m = lambda mV: thi * ((4. * math.exp(-(mV + 65.) / 18.)))
+    a_h = lambda mV: thi * ((0.07 * math.exp(-(mV + 65.) / 20.)))
+    b_h = lambda mV: thi * ((1. / (math.exp((30 - (mV + 65.)) / 10.) + 1)))
+
+    def vdep(id, src, dst, f, n):
+        smodel.VDepSReac(id, ssys, slhs = [src], srhs = [dst], \
+            k = lambda V: 1.0e3 * n * f(V * 1.0e3), vrange = vrange)
+
+    K = smodel.Chan('K', mdl)
+    kn = [smodel.ChanState('K_n%d' % i, mdl, K) for i in range(5)]
+    for i in range(4):
+        vdep('Kf%d' % i, kn[i], kn[i + 1], a_n, 4 - i)
+        vdep('Kb%d' % i, kn[i + 1], kn[i], b_n, i + 1)
+
+    Na = smodel.Chan('Na', mdl)
+    na = [[smodel.ChanState('Na_m%dh%d' % (m, h), mdl, Na) for m in range(4)] \
+        for h in range(2)]
+    for h in range(2):
+        for m in range(3):
+            vdep('Naf%d%d' % (m, h), na[h][m], na[h][m + 1], a_m, 3 - m)
+            vdep('Nab%d%d' % (m, h), na[h][m + 1], na[h][m], b_m, m + 1)
+    for m in range(4):
+        vdep('Nah%d' % m, na[0][m], na[1][m], a_h, 1)
+        vdep('Nahb%d' % m, na[1][m], na[0][m], b_h, 1)
+
+    L = smodel.Chan('L', mdl)
+    leak = smodel.ChanState('Leak', mdl, L)
+
+    smodel.OhmicCurr('OC_K', ssys, chanstate = kn[4], g = 20.0e-12, erev = -77e-3)
+    smodel.OhmicCurr('OC_Na', ssys, chanstate = na[1][3], g = 20.0e-12, erev = 50e-3)
+    smodel.OhmicCurr('OC_L', ssys, chanstate = leak, g = 0.3e-12, erev = -54.4e-3)
+    return mdl
+
+def bench_efield():
+    mdl = _hh_model()
+    mesh = smeshio.importAbaqus(os.path.join(MESHDIR, \
+        'axon_cube_L1000um_D443nm_equiv0.5_19087tets.inp'), 1e-6)[0]
+
+    zmin = mesh.getBoundMin()[2]
+    injverts = [v for v in range(mesh.nverts) \
+        if mesh.getVertex(v)[2] < zmin + 0.1e-6]
+    injset = set(injverts)
+    memb_tris = [t for t in mesh.getSurfTris() \
+        if not set(mesh.getTri(t)) <= injset]
+
+    cyto = sgeom.TmComp('cyto', mesh, range(mesh.ntets))
+    patch = sgeom.TmPatch('patch', mesh, memb_tris, cyto)
+    patch.addSurfsys('ssys')
+    sgeom.Memb('membrane', mesh, [patch], opt_method = 1)
+
+    t0 = time.time()
+    sim = ssolver.Tetexact(mdl, mesh, _rng(), True)
+    t1 = time.time()
+
+    sim.reset()
+    area = sim.getPatchArea('patch')
+    K_facs = [0.21768, 0.40513, 0.28093, 0.08647, 0.00979]
+    Na_facs = [[0.34412, 0.05733, 0.00327, 6.0e-05], \
+        [0.50558, 0.08504, 0.00449, 0.00010]]
+    for i in range(5):
+        sim.setPatchCount('patch', 'K_n%d' % i, 18.0e12 * area * K_facs[i])
+    for h in range(2):
+        for m in range(4):
+            sim.setPatchCount('patch', 'Na_m%dh%d' % (m, h), \
+                60.0e12 * area * Na_facs[h][m])
+    sim.setPatchCount('patch', 'Leak', 10.0e12 * area)
+
+    sim.setEfieldDT(EF_DT)
+    sim.setMembPotential('membrane', -65e-3)
+    sim.setMembCapac('membrane', 1.0e-2)
+    sim.setMembVolRes('membrane', 1.0)
+    for v in injverts:
+        sim.setVertIClamp(v, 50.0e-12 / len(injverts))
+
+    t2 = time.time()
+    sim.run(EF_ENDTIME)
+    t3 = time.time()
+
+    nsteps = sim.getEfieldStat('steps')
+    efcost = 0.0
+    for stat in ['rhs', 'matrix', 'solve', 'currents', 'update']:
+        efcost += sim.getEfieldStat(stat)
+    return {'setup': t1 - t0, 'run': t3 - t2, 'events': sim.getNSteps(), \
+        'efsteps': int(nsteps), 'efstep': efcost / max(nsteps, 1)}
+
+########################################################################
+
+def bench_tetode():
+    mdl = smodel.Model()
+    vsys = smodel.Volsys('vsys', mdl)
+    A = smodel.Spec('A', mdl)
+    B = smodel.Spec('B', mdl)
+    C = smodel.Spec('C', mdl)
+    smodel.Reac('fwd', vsys, lhs = [A, B], rhs = [C], kcst = 1.0e8)
+    smodel.Reac('bwd', vsys, lhs = [C], rhs = [A, B], kcst = 10.0)
+    smodel.Diff('diffA', vsys, A, dcst = 20.0e-12)
+    smodel.Diff('diffB', vsys, B, dcst = 10.0e-12)
+
+    mesh = smeshio.loadMesh(os.path.join(MESHDIR, 'sphere_rad10_11Ktets'))[0]
+    comp = sgeom.TmComp('cyto', mesh, range(mesh.ntets))
+    comp.addVolsys('vsys')
+
+    t0 = time.time()
+    sim = ssolver.TetODE(mdl, mesh)
+    t1 = time.time()
+    sim.setTolerances(1.0e-3, 1.0e-4)
+    # A on one half of the sphere, B everywhere.
+    for t in range(mesh.ntets):
+        if mesh.getTetBarycenter(t)[0] < 0.0:
+            sim.setTetCount(t, 'A', 2 * ODE_NPERTET)
+    sim.setCompCount('cyto', 'B', ODE_NPERTET * mesh.ntets)
+    sim.run(ODE_ENDTIME)
+    t2 = time.time()
+    return {'setup': t1 - t0, 'run': t2 - t1}
+
+########################################################################
+
+BENCHMARKS = [('wmdirect', bench_wmdirect), ('wmrk4', bench_wmrk4), \
+    ('tetexact', bench_tetexact), ('efield', bench_efield), \
+    ('tetode', bench_tetode)]
+
+def _run_one(name):
+    res = dict(BENCHMARKS)[name]()
+    res['maxrss'] = _maxrss()
+    print 'RESULT', ' '.join(['%s=%r' % kv for kv in res.items()])
+
+def _report(name, res):
+    line = '%-9s setup %8.3f s  run %8.3f s  mem %8.1f MB' \
+        % (name, res['setup'], res['run'], res['maxrss'] / 1024.0)
+    if 'events' in res:
+        line += '  %10.0f events/s' % (res['events'] / res['run'])
+    if 'efstep' in res:
+        line += '  EField %d steps, %.3f ms/step' \
+            % (res['efsteps'], 1.0e3 * res['efstep'])
+    print line
+
+########################################################################
+
+if __name__ == '__main__':
+    args = sys.argv[1:]
+    if len(args) == 2 and args[0] == '--one':
+        _run_one(args[1])
+        sys.exit(0)
+
+    names = args or [n for n, f in BENCHMARKS]
+    for name in names:
+        if name not in dict(BENCHMARKS):
+            print 'Unknown workload %s (expected one of %s)' \
+                % (name, ', '.join([n for n, f in BENCHMARKS]))
+            sys.exit(1)
+        out = subprocess.Popen([sys.executable, os.path.abspath(__file__), \
+            '--one', name], stdout = subprocess.PIPE).communicate()[0]
+        res = None
+        for l in out.splitlines():
+            if l.startswith('RESULT '):
+                res = dict([(kv.split('=')[0], eval(kv.split('=')[1])) \
+                    for kv in l.split()[1:]])
+        if res is None:
+            print '%-9s failed' % name
+        else:
+            _report(name, res)
+
+########################################################################
+
+# END
@@ -26,6 +26,10 @@
 #  Last Changed Date: $Date: 2013-04-19 19:37:42 +0900 (Fri, 19 Apr 2013) $
 #  Last Changed By:   $Author: iain $
 
+import os
+import shutil
+import tempfile
+
 try:
     from setuptools import setup, Extension
     
@@ -64,14 +68,178 @@ def license():
 def packages():
     return ['steps', 'steps/utilities']
   
+def lapack_libs():
+    """
+    The libraries that provide LAPACK's dgbtrf and dgbtrs, which the banded 
+    EField solver uses when available, or None to use its own LU 
+    decomposition. Set STEPS_USE_LAPACK=0 in the environment to skip this.
+    """
+    if os.environ.get('STEPS_USE_LAPACK', '1') == '0':
+        return None
+    try:
+        from distutils.ccompiler import new_compiler
+        from distutils.sysconfig import customize_compiler
+    except ImportError:
+        return None
+    test = 'void dgbtrf_(int *, int *, int *, int *, double *, int *, int *, int *);\n' \
+           'void dgbtrs_(char *, int *, int *, int *, int *, double *, int *, int *, double *, int *, int *);\n' \
+           'int main(void) { dgbtrf_(0, 0, 0, 0, 0, 0, 0, 0); dgbtrs_(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0); return 0; }\n'
+    for libs in (['openblas'], ['lapack', 'blas'], ['lapack']):
+        tmp = tempfile.mkdtemp()
+        try:
+            src = os.path.join(tmp, 'lapack_test.c')
+            f = open(src, 'w')
+            f.write(test)
+            f.close()
+            cc = new_compiler()
+            customize_compiler(cc)
+            objs = cc.compile([src], output_dir = tmp)
+            cc.link_executable(objs, os.path.join(tmp, 'lapack_test'), libraries = libs)
+            return libs
+        except Exception:
+            pass
+        finally:
+            shutil.rmtree(tmp, True)
+    return None
+
+def openmp_flags():
+    """
+    The compiler flag that enables OpenMP, which TetODE uses to share the
+    evaluation of its right-hand side, Jacobian products, preconditioner
+    and CVODE vector operations out over threads, or None. Set
+    STEPS_USE_OPENMP=0 in the environment to skip this.
+    """
+    if os.environ.get('STEPS_USE_OPENMP', '1') == '0':
+        return None
+    try:
+        from distutils.ccompiler import new_compiler
+        from distutils.sysconfig import customize_compiler
+    except ImportError:
+        return None
+    test = '#include <omp.h>\n' \
+           'int main(void) { return omp_get_max_threads() > 0 ? 0 : 1; }\n'
+    for flag in ('-fopenmp', '/openmp'):
+        tmp = tempfile.mkdtemp()
+        try:
+            src = os.path.join(tmp, 'openmp_test.c')
+            f = open(src, 'w')
+            f.write(test)
+            f.close()
+            cc = new_compiler()
+            customize_compiler(cc)
+            objs = cc.compile([src], output_dir = tmp, extra_postargs = [flag])
+            cc.link_executable(objs, os.path.join(tmp, 'openmp_test'),
+                               extra_postargs = [flag])
+            return flag
+        except Exception:
+            pass
+        finally:
+            shutil.rmtree(tmp, True)
+    return None
+
+def hdf5_config():
+    """
+    The include directories, library directories and libraries for HDF5,
+    which the Recorder uses to write HDF5 files when available, or None.
+    HDF5_DIR in the environment names the install prefix; otherwise the
+    default and Debian serial locations are tried. Set STEPS_USE_HDF5=0 in
+    the environment to skip this.
+    """
+    if os.environ.get('STEPS_USE_HDF5', '1') == '0':
+        return None
+    try:
+        from distutils.ccompiler import new_compiler
+        from distutils.sysconfig import customize_compiler
+    except ImportError:
+        return None
+    test = '#include <hdf5.h>\n' \
+           'int main(void) { H5open(); return 0; }\n'
+    if 'HDF5_DIR' in os.environ:
+        prefix = os.environ['HDF5_DIR']
+        candidates = [([os.path.join(prefix, 'include')], [os.path.join(prefix, 'lib')])]
+    else:
+        candidates = [([], []),
+                      (['/usr/include/hdf5/serial'], ['/usr/lib/x86_64-linux-gnu/hdf5/serial'])]
+    for incs, libdirs in candidates:
+        tmp = tempfile.mkdtemp()
+        try:
+            src = os.path.join(tmp, 'hdf5_test.c')
+            f = open(src, 'w')
+            f.write(test)
+            f.close()
+            cc = new_compiler()
+            customize_compiler(cc)
+            objs = cc.compile([src], output_dir = tmp, include_dirs = incs)
+            cc.link_executable(objs, os.path.join(tmp, 'hdf5_test'),
+                               libraries = ['hdf5'], library_dirs = libdirs)
+            return incs, libdirs, ['hdf5']
+        except Exception:
+            pass
+        finally:
+            shutil.rmtree(tmp, True)
+    return None
+
+def mpi_config():
+    """
+    The include directories, library directories and libraries for MPI,
+    which Tetexact.setDomains uses to spread the mesh over the ranks of a
+    job and EnsembleFarm to spread ensembles over them, or None. They are
+    taken from the compiler wrapper named by MPICXX in the environment, or
+    mpicxx. Set STEPS_USE_MPI=0 in the environment to skip this.
+    """
+    if os.environ.get('STEPS_USE_MPI', '1') == '0':
+        return None
+    try:
+        import subprocess
+        from distutils.ccompiler import new_compiler
+        from distutils.sysconfig import customize_compiler
+    except ImportError:
+        return None
+    wrapper = os.environ.get('MPICXX', 'mpicxx')
+    try:
+        p = subprocess.Popen([wrapper, '-show'], stdout = subprocess.PIPE,
+                             stderr = subprocess.PIPE)
+        out = p.communicate()[0]
+        if p.returncode != 0:
+            return None
+    except OSError:
+        return None
+    if not isinstance(out, str):
+        out = out.decode()
+    incs = [a[2:] for a in out.split() if a.startswith('-I')]
+    libdirs = [a[2:] for a in out.split() if a.startswith('-L')]
+    libs = [a[2:] for a in out.split() if a.startswith('-l')]
+    test = '#include <mpi.h>\n' \
+           'int main(void) { int init; MPI_Initialized(&init); return 0; }\n'
+    tmp = tempfile.mkdtemp()
+    try:
+        src = os.path.join(tmp, 'mpi_test.c')
+        f = open(src, 'w')
+        f.write(test)
+        f.close()
+        cc = new_compiler()
+        customize_compiler(cc)
+        objs = cc.compile([src], output_dir = tmp, include_dirs = incs)
+        cc.link_executable(objs, os.path.join(tmp, 'mpi_test'),
+                           libraries = libs, library_dirs = libdirs)
+        return incs, libdirs, libs
+    except Exception:
+        pass
+    finally:
+        shutil.rmtree(tmp, True)
+    return None
+
 def steps_ext():
-    return dict(
+    ext = dict(
         name='_steps_swig',
         
-        sources=['cpp/error.cpp',
+        sources=['cpp/error.cpp', 'cpp/mpi.cpp', 'cpp/parallel.cpp', 'cpp/trace.cpp',
+                 'cpp/meshcache.cpp', 'cpp/simd.cpp',
                  
                  'cpp/tetode/comp.cpp', 'cpp/tetode/patch.cpp', 'cpp/tetode/tet.cpp', 
+                 'cpp/tetode/nvector_omp.cpp',
                  'cpp/tetode/tri.cpp', 'cpp/tetode/tetode.cpp',
+                 'cpp/hybrid/hybrid.cpp', 'cpp/hybrid/wmhybrid.cpp',
                  
                  'third_party/cvode-2.6.0/src/cvode/cvode_band.c',
                  'third_party/cvode-2.6.0/src/cvode/cvode_bandpre.c',
@@ -102,6 +270,7 @@ def steps_ext():
                  'cpp/solver/api_comp.cpp','cpp/solver/api_main.cpp', 'cpp/solver/api_memb.cpp',
                  'cpp/solver/api_patch.cpp','cpp/solver/api_tet.cpp', 'cpp/solver/api_vert.cpp',
                  'cpp/solver/api_tri.cpp', 'cpp/solver/api_diffboundary.cpp',
+                 'cpp/solver/recorder.cpp', 'cpp/solver/hdf5writer.cpp',
                  'cpp/solver/compdef.cpp',
                  'cpp/solver/diffdef.cpp','cpp/solver/surfdiffdef.cpp','cpp/solver/patchdef.cpp',
                  'cpp/solver/reacdef.cpp','cpp/solver/specdef.cpp',
@@ -113,7 +282,15 @@ def steps_ext():
                  'cpp/solver/efield/efield.cpp', 'cpp/solver/efield/matrix.cpp',
                  'cpp/solver/efield/tetcoupler.cpp', 'cpp/solver/efield/tetmesh.cpp',
                  'cpp/solver/efield/vertexconnection.cpp', 'cpp/solver/efield/vertexelement.cpp',
+                 'cpp/solver/efield/vprop.cpp', 'cpp/solver/efield/sparsematrixprop.cpp',
+                 'cpp/solver/efield/schurmatrixprop.cpp', 'cpp/solver/efield/backend.cpp',
                  
+                 'cpp/solver/ssa/scheduler.cpp', 'cpp/solver/ssa/crsched.cpp',
+                 'cpp/solver/ssa/directsched.cpp', 'cpp/solver/ssa/nrmsched.cpp',
+                 'cpp/solver/ssa/splitsched.cpp', 'cpp/solver/ssa/groupsched.cpp',
+                 'cpp/solver/ssa/sdmsched.cpp',
+                 
+                 'cpp/tetexact/arena.cpp', 'cpp/tetexact/pools.cpp',
                  'cpp/tetexact/comp.cpp','cpp/tetexact/diff.cpp', 'cpp/tetexact/sdiff.cpp',
                  'cpp/tetexact/kproc.cpp','cpp/tetexact/patch.cpp',
                  'cpp/tetexact/reac.cpp','cpp/tetexact/sreac.cpp',
@@ -122,34 +299,76 @@ def steps_ext():
                  'cpp/tetexact/ghkcurr.cpp',
                  'cpp/tetexact/vdeptrans.cpp', 'cpp/tetexact/vdepsreac.cpp',
                  'cpp/tetexact/diffboundary.cpp', 
-                 'cpp/tetexact/wmvol.cpp',
+                 'cpp/tetexact/wmvol.cpp', 'cpp/tetexact/ensemble.cpp',
+                 'cpp/tetexact/ensemblefarm.cpp',
+                 'cpp/tetexact/clusters.cpp', 'cpp/tetexact/eventtrace.cpp',
+                 'cpp/tetexact/snapshot.cpp', 'cpp/tetexact/domains.cpp',
                  
                  'cpp/wmdirect/comp.cpp','cpp/wmdirect/kproc.cpp',
                  'cpp/wmdirect/patch.cpp','cpp/wmdirect/reac.cpp',
                  'cpp/wmdirect/sreac.cpp','cpp/wmdirect/wmdirect.cpp',
+                 'cpp/wmdirect/wmensemble.cpp','cpp/wmdirect/pdmsched.cpp',
                  
                  'cpp/wmrk4/wmrk4.cpp',
+
+                 'cpp/voxel/voxel.cpp',
+
+                 'cpp/tetleap/tetleap.cpp',
                                   
                  'cpp/model/model.cpp', 'cpp/model/diff.cpp', 'cpp/model/chan.cpp',
                  'cpp/model/reac.cpp','cpp/model/spec.cpp','cpp/model/sreac.cpp',
                  'cpp/model/surfsys.cpp','cpp/model/volsys.cpp',
                  'cpp/model/chanstate.cpp','cpp/model/ohmiccurr.cpp', 
                  'cpp/model/ghkcurr.cpp', 'cpp/model/vdeptrans.cpp', 'cpp/model/vdepsreac.cpp',
+                 'cpp/model/rateexpr.cpp',
+                 'cpp/model/network.cpp',
+                 
+                 'cpp/sbml/xml.cpp', 'cpp/sbml/mathml.cpp', 'cpp/sbml/sbml.cpp',
                  
                  'cpp/math/tetrahedron.cpp', 'cpp/math/tools.cpp',
                  'cpp/math/linsolve.cpp','cpp/math/triangle.cpp','cpp/math/ghk.cpp',
+                 'cpp/math/skyline.cpp',
                  
                  'cpp/geom/comp.cpp','cpp/geom/geom.cpp','cpp/geom/patch.cpp',
-                 'cpp/geom/tetmesh.cpp','cpp/geom/tet.cpp',
+                 'cpp/geom/tetmesh.cpp','cpp/geom/tetmesh_rw.cpp',
+                 'cpp/geom/tetmesh_import.cpp','cpp/geom/tet.cpp',
                  'cpp/geom/tmcomp.cpp','cpp/geom/tmpatch.cpp','cpp/geom/tri.cpp',
                  'cpp/geom/memb.cpp',  'cpp/geom/diffboundary.cpp',
                  
-                 'cpp/rng/rng.cpp', 'cpp/rng/mt19937.cpp',
+                 'cpp/rng/rng.cpp', 'cpp/rng/mt19937.cpp', 'cpp/rng/philox.cpp',
                  
                  'swig/steps_wrap.cpp'],
+            libraries=['pthread'],
                 #define_macros=[('SSA_DEBUG', 'None')],
             undef_macros=['NDEBUG']
         )
+    ext['define_macros'] = []
+    libs = lapack_libs()
+    if libs != None:
+        ext['define_macros'].append(('STEPS_USE_LAPACK', None))
+        ext['libraries'] = ext['libraries'] + libs
+    hdf5 = hdf5_config()
+    if hdf5 != None:
+        ext['define_macros'].append(('STEPS_USE_HDF5', None))
+        ext['include_dirs'] = hdf5[0]
+        ext['library_dirs'] = hdf5[1]
+        ext['libraries'] = ext['libraries'] + hdf5[2]
+    mpi = mpi_config()
+    if mpi != None:
+        ext['define_macros'].append(('STEPS_USE_MPI', None))
+        ext['include_dirs'] = ext.get('include_dirs', []) + mpi[0]
+        ext['library_dirs'] = ext.get('library_dirs', []) + mpi[1]
+        ext['libraries'] = ext['libraries'] + mpi[2]
+    omp = openmp_flags()
+    if omp != None:
+        ext['extra_compile_args'] = [omp]
+        ext['extra_link_args'] = [omp]
+    # Set STEPS_ODE_SINGLE=1 in the environment to build CVODE, and so the
+    # state of TetODE and of Wmrk4's BDF mode, in single precision, which
+    # halves the memory traffic of large deterministic runs.
+    if os.environ.get('STEPS_ODE_SINGLE', '0') == '1':
+        ext['define_macros'].append(('SUNDIALS_SINGLE_PRECISION', None))
+    return ext
         
 def ext_modules():
     modules = [steps_ext()]
@@ -44,6 +44,55 @@ import _steps_swig
 ### Now defunct mesh saving/loading tool ###
 # from steps_swig import loadASCII, saveASCII
 
+### Binary mesh saving/loading ###
+loadBinary = steps_swig.loadBinary
+saveBinary = steps_swig.saveBinary
+
+### Cache of data derived from meshes ###
+setMeshCacheDir = steps_swig.setMeshCacheDir
+getMeshCacheDir = steps_swig.getMeshCacheDir
+
+### Native mesh importers ###
+ElementMap = steps_swig.ElementMap
+
+def importTetGen(pathroot):
+    """
+    Read a TetGen mesh from pathroot.node, pathroot.ele and, if it
+    exists, pathroot.face. This is the C++ counterpart of
+    steps.utilities.meshio.importTetGen, with compact element maps
+    instead of ElementProxy dictionaries.
+
+    RETURNS:
+    mesh, nodes, tets, tris (steps.geom.Tetmesh and three ElementMap)
+    """
+    nodes, tets, tris = ElementMap('node'), ElementMap('tet'), ElementMap('tri')
+    mesh = steps_swig.importTetGen(pathroot, nodes, tets, tris)
+    return mesh, nodes, tets, tris
+
+def importGmsh(filename, scale):
+    """
+    Read an ASCII Gmsh mesh, multiplying the coordinates by scale.
+
+    RETURNS:
+    mesh, nodes, tets, tris (steps.geom.Tetmesh and three ElementMap)
+    """
+    nodes, tets, tris = ElementMap('node'), ElementMap('tet'), ElementMap('tri')
+    mesh = steps_swig.importGmsh(filename, scale, nodes, tets, tris)
+    return mesh, nodes, tets, tris
+
+def importAbaqus(filename, scale, ebs = None):
+    """
+    Read an Abaqus mesh, multiplying the coordinates by scale. If ebs
+    is a list of element block names, only those blocks are read.
+
+    RETURNS:
+    mesh, nodes, tets, tris (steps.geom.Tetmesh and three ElementMap)
+    """
+    nodes, tets, tris = ElementMap('node'), ElementMap('tet'), ElementMap('tri')
+    mesh = steps_swig.importAbaqus(filename, scale, nodes, tets, tris,
+                                   list(ebs or []))
+    return mesh, nodes, tets, tris
+
 
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # 
 
@@ -265,7 +314,7 @@ class Tetmesh(steps_swig.Tetmesh):
         """
         Construction1::
         
-            mesh = steps.geom.Tetmesh(verts, tets, tris)
+            mesh = steps.geom.Tetmesh(verts, tets, tris, nthreads = 1)
             
         Construct a Tetmesh container by the “first” method: Supply a list of all 
         vertices verts (by Cartesian coordinates), supply a list of all tetrahedrons 
@@ -280,11 +329,14 @@ class Tetmesh(steps_swig.Tetmesh):
         the total number of triangles. For example, if we have just three tetrahedrons; 
         tet0=[0,1,2,3], tet1=[0,1,3,4] and tet2=[1,3,4,5] then the required 
         one-dimensional list tets=[0,1,2,3,0,1,3,4,1,3,4,5]. 
+        The connectivity and geometry tables are built on nthreads threads; 
+        the resulting mesh does not depend on the number of threads. 
             
         Arguments: 
             * list<float> verts
             * list<uint> tets
             * list<unit> tris
+            * uint nthreads (default = 1)
             
         Construction2::
             mesh = steps.geom.Tetmesh(nverts, ntets, ntris)
@@ -456,8 +508,14 @@ class Memb(steps_swig.Memb):
             more than 3 neighbours. Specify optimization method with opt_method (default = 1): 
             1 = principle axis ordering (quick to set up but usually results in slower simulation than method 2). 
             2 = breadth first search (can be time-consuming to set up, but usually faster simulation), 
+            3 = sparse conjugate gradient solver with principle axis ordering (lower memory use than 
+            the banded solver of methods 1 and 2, recommended for branched morphologies), 
+            4 = reverse Cuthill-McKee ordering (a band comparable to method 2, set up in near-linear time), 
+            5 = as 4, but only the membrane vertices are stepped, through a once-computed dense reduction of the 
+            volume (per-step cost grows with the square of the number of membrane vertices, best for compact volumes), 
             If a filename (with full path) is given in optional argument opt_file_name the membrane optimization will be loaded from file,
             which was saved previously for this membrane with solver method steps.solver.Tetexact.saveMembOpt()
+            (files saved by this version also hold the vertex coupling constants, which are then not recomputed)
             
             Arguments:
             * string id
@@ -41,6 +41,36 @@
 from . import steps_swig
 import _steps_swig
 
+### Frozen model snapshots (see Model.compile) ###
+Network = steps_swig.Network
+
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+def _vdepTable(rate, minv, dv, tablesize):
+    """
+    Return (table, expr, array) for the voltage-dependent rate of a 
+    VDepTrans or VDepSReac, exactly one of them set:
+    a list of the values of a Python function rate(v) at minv + i * dv,
+    the string of a rate expression, compiled and tabulated in C++, or 
+    a contiguous float64 NumPy array of tablesize values, copied in 
+    C++ from its memory.
+    """
+    if isinstance(rate, basestring):
+        return None, rate, None
+    if callable(rate):
+        table = [0.0]*tablesize
+        v = minv
+        for i in range(tablesize):
+            table[i] = rate(v)
+            v+=dv
+        return table, None, None
+    import numpy
+    array = numpy.ascontiguousarray(rate, dtype = numpy.float64)
+    if array.ndim != 1 or array.size != tablesize:
+        raise ValueError("Rate table has %d values, expected %d." % 
+            (array.size, tablesize))
+    return None, None, array
+
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
 
 class Model(steps_swig.Model) : 
@@ -481,14 +511,18 @@ class VDepTrans(steps_swig.VDepTrans) :
             and assign surfsys as the parent surface system. The 'source' 
             channel state is assigned with src and the 'destination' channel state
             is assigned with dst. A function that returns the transition rate in /s at 
-            any voltage (in volts) is supplied with rate.
+            any voltage (in volts) is supplied with rate. Instead of a function, 
+            rate can be a rate expression string of the voltage v, tabulated in 
+            C++ (see steps.model.VDepTrans.setRateExpr), such as 
+            '1.0e4 * vtrap(-(v + 0.055), 0.01)', or a NumPy array of the rates 
+            at each voltage of the range.
             
             Arguments: 
             * string id
             * steps.model.Surfsys surfsys
             * steps.model.ChanState src
             * steps.model.ChanState dst
-            * function rate
+            * function, string or array rate
             """
         ### Create 'ratelist' from input function
         if kwargs.has_key('vrange'):
@@ -503,14 +537,9 @@ class VDepTrans(steps_swig.VDepTrans) :
             dv = 1.0e-4
         
         tablesize = int((maxv-minv)/dv) +1
-        ratelist = [0.0]*tablesize  
         rate = kwargs['rate']
-        
-        v = minv
-        for i in range(tablesize):
-        	ratelist[i] = rate(v)
-        	v+=dv
-        kwargs['ratetab'] = ratelist
+        ratelist, expr, array = _vdepTable(rate, minv, dv, tablesize)
+        kwargs['ratetab'] = ratelist or []
         kwargs['vmin'] = minv
         kwargs['vmax'] = maxv
         kwargs['dv'] = dv
@@ -529,6 +558,13 @@ class VDepTrans(steps_swig.VDepTrans) :
         self.__swig_getmethods__["src"] = _steps_swig.VDepTrans_getSrc
         self.__swig_setmethods__["dst"] = _steps_swig.VDepTrans_setDst
         self.__swig_getmethods__["dst"] = _steps_swig.VDepTrans_getDst
+        
+        try:
+            if expr != None: self.setRateExpr(expr)
+            elif array is not None: self.setRateAddr(array.ctypes.data)
+        except:
+            self.getSurfsys().delVDepTrans(self.getID())
+            raise
     
         del(minv)
         del(maxv)
@@ -536,7 +572,6 @@ class VDepTrans(steps_swig.VDepTrans) :
         del(tablesize)
         del(ratelist)
         del(rate)
-        del(v)
         
     id = steps_swig._swig_property(_steps_swig.VDepTrans_getID, _steps_swig.VDepTrans_setID)
     """Identifier string of the voltage-dependent transition."""
@@ -583,7 +618,9 @@ class VDepSReac(steps_swig.VDepSReac) :
             products are assigned with irhs, orhs and srhs (default for each 
             is an empty list). 
             A function that returns the kinetic reaction 'constant' in ordinary, Molar 
-            units at any voltage (in volts) is supplied with argument k.
+            units at any voltage (in volts) is supplied with argument k. As for 
+            VDepTrans, k can also be a rate expression string or a NumPy array 
+            (see steps.model.VDepSReac.setKExpr).
             A 'voltage range' over which to calculate the reaction rate is
             optionally provided by the argument vrange (in Volts) as a list:
             [minimum voltage, maximum voltage, voltage step]
@@ -597,7 +634,7 @@ class VDepSReac(steps_swig.VDepSReac) :
             * list(steps.model.Spec) irhs (default = [ ])
             * list(steps.model.Spec) orhs (default = [ ])
             * list(steps.model.Spec) srhs (default = [ ])
-            * function k
+            * function, string or array k
             * list vrange (default = [-150.0e-3, 100.0e-3, 1.0e-4])
             """
         ### Create 'ratelist' from input function
@@ -613,14 +650,9 @@ class VDepSReac(steps_swig.VDepSReac) :
             dv = 1.0e-4
         
         tablesize = int((maxv-minv)/dv) +1
-        klist = [0.0]*tablesize  
         k = kwargs['k']
-        
-        v = minv
-        for i in range(tablesize):
-        	klist[i] = k(v)
-        	v+=dv
-        kwargs['ktab'] = klist
+        klist, expr, array = _vdepTable(k, minv, dv, tablesize)
+        kwargs['ktab'] = klist or []
         kwargs['vmin'] = minv
         kwargs['vmax'] = maxv
         kwargs['dv'] = dv
@@ -648,6 +680,13 @@ class VDepSReac(steps_swig.VDepSReac) :
         self.__swig_getmethods__["srhs"] = _steps_swig.VDepSReac_getSRHS
         self.__swig_setmethods__["orhs"] = _steps_swig.VDepSReac_setORHS
         self.__swig_getmethods__["orhs"] = _steps_swig.VDepSReac_getORHS
+        
+        try:
+            if expr != None: self.setKExpr(expr)
+            elif array is not None: self.setKAddr(array.ctypes.data)
+        except:
+            self.getSurfsys().delVDepSReac(self.getID())
+            raise
     
         del(minv)
         del(maxv)
@@ -655,7 +694,6 @@ class VDepSReac(steps_swig.VDepSReac) :
         del(tablesize) 
         del(klist)  
         del(k)
-        del(v)
     
     id = steps_swig._swig_property(_steps_swig.VDepSReac_getID, _steps_swig.VDepSReac_setID)
     """Identifier string of the voltage-dependent reaction."""
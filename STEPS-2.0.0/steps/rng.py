@@ -49,6 +49,9 @@ def create(*args):
   """
     Creates and returns a reference to a steps.rng.RNG random number generator object, 
     which is specified by type and pre-allocates a buffer list with size of buffer_size.
+    Available types are 'mt19937' (Mersenne Twister) and 'philox4x32' 
+    (counter-based Philox4x32-10, whose seed is used as key so that 
+    different seeds give independent streams).
 
     Syntax::
         
@@ -85,3 +88,23 @@ def create_mt19937(*args):
   return steps_swig.create_mt19937(*args)
 
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # 
+
+def create_philox4x32(*args):
+  """
+    Creates and returns a reference to a steps.rng.RNG Philox4x32-10 random number 
+    generator object, which pre-allocates a buffer list with size of buffer_size.
+
+    Syntax::
+        
+        create_philox4x32(buffer_size)
+
+    Arguments:
+        * uint buffer_size
+
+    Return:
+        steps.rng.RNG
+
+    """
+  return steps_swig.create_philox4x32(*args)
+
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # 
@@ -56,6 +56,17 @@ from . import steps_swig
 import _steps_swig
 import cPickle
 
+### Trace markers ###
+setTracing = steps_swig.setTracing
+getTracing = steps_swig.getTracing
+getTraceCount = steps_swig.getTraceCount
+clearTrace = steps_swig.clearTrace
+writeTrace = steps_swig.writeTrace
+
+### Thread pinning ###
+setParallelCPUs = steps_swig.setParallelCPUs
+getParallelCPUs = steps_swig.getParallelCPUs
+
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
 # Well-mixed RK4
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
@@ -126,11 +137,11 @@ class Wmrk4(steps_swig.Wmrk4) :
 # Well-mixed Direct SSA
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
 class Wmdirect(steps_swig.Wmdirect) :
-    def __init__(self, model, geom, rng): 
+    def __init__(self, model, geom, rng, scheduler = "auto"): 
         """
         Construction::
         
-            sim = steps.solver.Wmdirect(model, geom, rng)
+            sim = steps.solver.Wmdirect(model, geom, rng, scheduler = "auto")
             
         Create a well-mixed Direct SSA simulation solver.
             
@@ -138,8 +149,9 @@ class Wmdirect(steps_swig.Wmdirect) :
             * steps.model.Model model
             * steps.geom.Geom geom
             * steps.rng.RNG rng
+            * string scheduler ("auto", "direct", "sdm", "cr", "nrm" or "pdm")
         """
-        this = _steps_swig.new_Wmdirect(model, geom, rng)
+        this = _steps_swig.new_Wmdirect(model, geom, rng, scheduler)
         try: self.this.append(this)
         except: self.this = this
         self.thisown = 1
@@ -188,15 +200,38 @@ class Wmdirect(steps_swig.Wmdirect) :
             _steps_swig.API_run(self, end_time)
             
         
+class WmEnsemble(steps_swig.WmEnsemble) :
+    def __init__(self, model, geom, rng, nreps): 
+        """
+        Construction::
+        
+            ens = steps.solver.WmEnsemble(model, geom, rng, nreps)
+            
+        Create an ensemble of nreps replicates of a well-mixed model, 
+        simulated with the direct SSA in lockstep.
+            
+        Arguments: 
+            * steps.model.Model model
+            * steps.geom.Geom geom
+            * steps.rng.RNG rng
+            * uint nreps
+        """
+        this = _steps_swig.new_WmEnsemble(model, geom, rng, nreps)
+        try: self.this.append(this)
+        except: self.this = this
+        self.thisown = 1
+        self.model = model
+        self.geom = geom
+
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
 # Tetrahedral Direct SSA
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #        
 class Tetexact(steps_swig.Tetexact) :  
-    def __init__(self, model, geom, rng, calcMembPot = False): 
+    def __init__(self, model, geom, rng, calcMembPot = False, scheduler = "cr", reorder = False, setupthreads = 1, efieldbackend = "cpu", lazydeps = False, restart = ""): 
         """
         Construction::
         
-            sim = steps.solver.Tetexact(model, geom, rng, calcMembPot = False)
+            sim = steps.solver.Tetexact(model, geom, rng, calcMembPot = False, scheduler = "cr", reorder = False, setupthreads = 1, efieldbackend = "cpu", lazydeps = False, restart = "")
             
         Create a Tetexact SSA simulation solver.
             
@@ -205,9 +240,26 @@ class Tetexact(steps_swig.Tetexact) :
             * steps.geom.Geom geom
             * steps.rng.RNG rng
             # bool calcMembPot
+            # string scheduler ("cr", "direct", "nrm" or "nsm")
+            # bool reorder (lay out tets and triangles in reverse
+              Cuthill-McKee order of the mesh; indices are unchanged)
+            # uint setupthreads (threads used while setting up the solver;
+              results do not depend on it)
+            # string efieldbackend (the backend of the membrane potential
+              solver with calcMembPot: "cpu", or one registered by a
+              module that provides another, such as a GPU solver)
+            # bool lazydeps (build the update list of each kinetic
+              process when it first fires rather than during
+              construction, which cuts setup time and memory on
+              large meshes where much of the model stays inactive)
+            # string restart (a file written by checkpointRestart: the
+              update lists and membrane potential ordering are read from
+              it instead of being computed, and its checkpoint is then
+              restored; the other arguments must match the solver that
+              wrote it)
             
         """
-        this = _steps_swig.new_Tetexact(model, geom, rng, calcMembPot)
+        this = _steps_swig.new_Tetexact(model, geom, rng, calcMembPot, scheduler, reorder, setupthreads, efieldbackend, lazydeps, restart)
         try: self.this.append(this)
         except: self.this = this
         self.thisown = 1
@@ -256,6 +308,179 @@ class Tetexact(steps_swig.Tetexact) :
         else:
             _steps_swig.API_run(self, end_time)
 
+    def fork(self, rngs):
+        """
+        Return one replicate of this solver per generator in rngs (see 
+        steps_swig.Tetexact.fork). The replicates are owned by Python.
+        """
+        reps = list(_steps_swig.Tetexact_fork(self, rngs))
+        for r in reps:
+            r.thisown = 1
+        return reps
+
+    def runSampled(self, end_time, dt, callback):
+        """
+        Run the simulation until <end_time>, calling callback(sim) at the 
+        current time and then every <dt>. The sample times are computed 
+        from the start time, so they do not drift. The event drawn but not 
+        fired at each sample time is kept for the next interval instead of 
+        being drawn again. To only record counts, a steps.solver.Recorder 
+        takes the samples without returning to Python.
+        """
+        if dt <= 0.0:
+            raise ValueError("Sampling interval must be positive.")
+        t0 = _steps_swig.API_getTime(self)
+        tol = 1.0e-9 * dt
+        i = 0
+        while t0 + i * dt <= end_time + tol:
+            t = min(t0 + i * dt, end_time)
+            if t > _steps_swig.API_getTime(self):
+                _steps_swig.API_run(self, t)
+            callback(self)
+            i += 1
+        if end_time > _steps_swig.API_getTime(self):
+            _steps_swig.API_run(self, end_time)
+
+    def distributeTetCountsByDensity(self, tets, spec, n, density):
+        """
+        Add <n> molecules of <spec> to the tetrahedrons <tets>, with the 
+        relative density given by the function density(x, y, z) at each 
+        tetrahedron's barycentre (see distributeTetCounts).
+        """
+        d = [density(*self.geom.getTetBarycenter(t)) for t in tets]
+        self.distributeTetCounts(tets, spec, n, d)
+
+    def distributeTriCountsByDensity(self, tris, spec, n, density):
+        """
+        Add <n> molecules of <spec> to the triangles <tris>, with the 
+        relative density given by the function density(x, y, z) at each 
+        triangle's barycentre (see distributeTriCounts).
+        """
+        d = [density(*self.geom.getTriBarycenter(t)) for t in tris]
+        self.distributeTriCounts(tris, spec, n, d)
+
+    def getTetCountView(self):
+        """
+        Return a read-only NumPy array of shape (ntets, nspecs) that shares 
+        its memory with the solver's tetrahedron count view, so that reading 
+        it copies nothing. Row t holds the counts of tetrahedron t, column 
+        getSpecIdx(s) those of species s. The array follows the simulation 
+        and must not be used after setCountViews(False).
+        """
+        return self._countView(self.getTetCountViewAddr(), self.geom.countTets())
+
+    def getTriCountView(self):
+        """
+        Return a read-only NumPy array of shape (ntris, nspecs) that shares 
+        its memory with the solver's triangle count view (see 
+        getTetCountView).
+        """
+        return self._countView(self.getTriCountViewAddr(), self.geom.countTris())
+
+    def _countView(self, addr, nelems):
+        import ctypes
+        import numpy
+        if addr == 0:
+            raise RuntimeError("Count views are off; call setCountViews(True) first.")
+        nspecs = len(self.model.getAllSpecs())
+        buf = (ctypes.c_uint * (nelems * nspecs)).from_address(addr)
+        # The buffer, and so the array based on it, keeps the solver alive.
+        buf._sim = self
+        view = numpy.frombuffer(buf, dtype = numpy.uintc).reshape(nelems, nspecs)
+        view.flags.writeable = False
+        return view
+
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# In-solver recording
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+class Recorder(steps_swig.Recorder) :
+    def __init__(self, sim, dt):
+        """
+        Construction::
+        
+            rec = steps.solver.Recorder(sim, dt)
+            
+        Create a recorder that samples observables of solver sim every 
+        dt seconds while it runs.
+            
+        Arguments: 
+            * steps.solver.API sim
+            * float dt
+            
+        """
+        this = _steps_swig.new_Recorder(sim, dt)
+        try: self.this.append(this)
+        except: self.this = this
+        self.thisown = 1
+        self.sim = sim
+
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# Multithreaded Tetexact ensemble
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+class Ensemble(steps_swig.Ensemble) :
+    def __init__(self, model, geom, init_file, nthreads, rng_name = "mt19937", 
+                 rng_bufsize = 512, calcMembPot = False, scheduler = "cr"):
+        """
+        Construction::
+        
+            ens = steps.solver.Ensemble(model, geom, init_file, nthreads, rng_name = "mt19937", rng_bufsize = 512, calcMembPot = False, scheduler = "cr")
+            
+        Create a runner for independent Tetexact realisations on nthreads 
+        threads, each starting from the checkpoint init_file.
+            
+        Arguments: 
+            * steps.model.Model model
+            * steps.geom.Geom geom
+            * string init_file
+            * uint nthreads
+            # string rng_name
+            # uint rng_bufsize
+            # bool calcMembPot
+            # string scheduler ("cr", "direct", "nrm" or "nsm")
+            
+        """
+        this = _steps_swig.new_Ensemble(model, geom, init_file, nthreads, rng_name, 
+                                        rng_bufsize, calcMembPot, scheduler)
+        try: self.this.append(this)
+        except: self.this = this
+        self.thisown = 1
+        self.model = model
+        self.geom = geom
+
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# Tetexact ensemble over the ranks of an MPI job
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+class EnsembleFarm(steps_swig.EnsembleFarm) :
+    def __init__(self, model, geom, init_file, nthreads, rng_name = "mt19937", 
+                 rng_bufsize = 512, calcMembPot = False, scheduler = "cr"):
+        """
+        Construction::
+        
+            farm = steps.solver.EnsembleFarm(model, geom, init_file, nthreads, rng_name = "mt19937", rng_bufsize = 512, calcMembPot = False, scheduler = "cr")
+            
+        Create a farm that hands the realisations of an ensemble out to 
+        the ranks of an MPI job as they ask for work, each running them 
+        on an Ensemble with these arguments. To be created on every rank.
+            
+        Arguments: 
+            * steps.model.Model model
+            * steps.geom.Geom geom
+            * string init_file
+            * uint nthreads
+            # string rng_name
+            # uint rng_bufsize
+            # bool calcMembPot
+            # string scheduler ("cr", "direct", "nrm" or "nsm")
+            
+        """
+        this = _steps_swig.new_EnsembleFarm(model, geom, init_file, nthreads, rng_name, 
+                                            rng_bufsize, calcMembPot, scheduler)
+        try: self.this.append(this)
+        except: self.this = this
+        self.thisown = 1
+        self.model = model
+        self.geom = geom
+
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
 # Tetrahedral-based ODE solver
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #        
@@ -321,3 +546,113 @@ class TetODE(steps_swig.TetODE) :
         else:
             _steps_swig.API_run(self, end_time)
 
+
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# Partitioned SSA-ODE solver
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+class Hybrid(steps_swig.Hybrid) :  
+    def __init__(self, model, geom, rng, scheduler = "cr"): 
+        """
+            Construction::
+            
+            sim = steps.solver.Hybrid(model, geom, rng, scheduler = "cr")
+            
+            Create a partitioned solver that simulates the stochastic 
+            species with Tetexact and the deterministic species with 
+            TetODE. All species start stochastic; see 
+            setSpecDeterministic and selectDeterministic.
+            
+            Arguments: 
+            * steps.model.Model model
+            * steps.geom.Geom geom
+            * steps.rng.RNG rng
+            * string scheduler (see Tetexact)
+            """
+        this = _steps_swig.new_Hybrid(model, geom, rng, scheduler)
+        try: self.this.append(this)
+        except: self.this = this
+        self.thisown = 1
+        self.model = model
+        self.geom = geom
+
+class Wmhybrid(steps_swig.Wmhybrid) :  
+    def __init__(self, model, geom, rng, scheduler = "direct"): 
+        """
+            Construction::
+            
+            sim = steps.solver.Wmhybrid(model, geom, rng, scheduler = "direct")
+            
+            Create a well-mixed hybrid solver that integrates the fast 
+            reactions with Wmrk4 and simulates the slow ones with 
+            Wmdirect, reclassing them every synchronisation window 
+            (Haseltine and Rawlings 2002).
+            
+            Arguments: 
+            * steps.model.Model model
+            * steps.geom.Geom geom
+            * steps.rng.RNG rng
+            * string scheduler (see Wmdirect)
+            """
+        this = _steps_swig.new_Wmhybrid(model, geom, rng, scheduler)
+        try: self.this.append(this)
+        except: self.this = this
+        self.thisown = 1
+        self.model = model
+        self.geom = geom
+
+class Voxel(steps_swig.Voxel) :  
+    def __init__(self, model, geom, rng, nx, ny, nz): 
+        """
+            Construction::
+            
+            sim = steps.solver.Voxel(model, geom, rng, nx, ny, nz)
+            
+            Create a spatial SSA solver that divides every compartment 
+            of a well-mixed geometry into an nx by ny by nz box of 
+            cubic voxels of equal volume. Each patch covers the walls 
+            of the box of its inner compartment; surface reactions 
+            cannot involve the outer compartment.
+            
+            Arguments: 
+            * steps.model.Model model
+            * steps.geom.Geom geom
+            * steps.rng.RNG rng
+            * uint nx
+            * uint ny
+            * uint nz
+            """
+        this = _steps_swig.new_Voxel(model, geom, rng, nx, ny, nz)
+        try: self.this.append(this)
+        except: self.this = this
+        self.thisown = 1
+        self.model = model
+        self.geom = geom
+
+class Tetleap(steps_swig.Tetleap) :  
+    def __init__(self, model, geom, rng, tau, nthreads = 1): 
+        """
+            Construction::
+            
+            sim = steps.solver.Tetleap(model, geom, rng, tau, nthreads = 1)
+            
+            Create a spatial tau-leaping solver on a tetrahedral mesh, 
+            which advances the reactions and diffusion of every 
+            tetrahedron together by leaps of length tau (in s), on 
+            nthreads threads. The results do not depend on nthreads. 
+            Diffusion is only between tetrahedrons of the same 
+            compartment, and patches cannot have surface reactions, 
+            surface diffusion or voltage dependent processes.
+            
+            Arguments: 
+            * steps.model.Model model
+            * steps.geom.Tetmesh geom
+            * steps.rng.RNG rng
+            * float tau
+            * uint nthreads (default = 1)
+            """
+        this = _steps_swig.new_Tetleap(model, geom, rng, tau, nthreads)
+        try: self.this.append(this)
+        except: self.this = this
+        self.thisown = 1
+        self.model = model
+        self.geom = geom
@@ -0,0 +1,186 @@
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# STEPS - STochastic Engine for Pathway Simulation
+# Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+# Copyright (C) 2003-2006 University of Antwerp, Belgium.
+#
+# See the file AUTHORS for details.
+#
+# This file is part of STEPS.
+#
+# STEPS is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# STEPS is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+
+"""
+Event Trace Utilities
+
+Reads the event traces that Tetexact writes with startEventTrace: the 
+time of every SSA event and the kinetic process (kproc) that fired, 
+with a table telling, for each kproc, its type, the element it belongs 
+to and the name of its reaction, diffusion rule or current.
+
+"""
+
+import struct
+
+################################################################################
+
+MAGIC = 'STEPSEVT'
+
+# The kproc types, in the order of their codes in the file.
+KPROC_TYPES = ['Reac', 'Diff', 'SReac', 'SDiff', 'VDepTrans', 'VDepSReac', \
+    'GHKcurr']
+
+################################################################################
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # 
+################################################################################
+
+class EventTrace(object):
+    """
+    The header of an event trace file, and its events once read.
+    
+    Attributes:
+        * t0 (the time of the start of the trace)
+        * resolution (the time resolution in seconds)
+        * ntets, ntris (the number of tetrahedrons and triangles of the 
+          mesh)
+        * names (the names of the processes of each kproc type, by 
+          global index: names['Reac'][i] is the name of reaction i)
+        * ktype, kelem, kproc (the type, element and process index of 
+          each kproc, by schedule index; the element is a tet, ntets + a 
+          triangle, or ntets + ntris + a well-mixed compartment)
+        * times, kprocs (the time and kproc of each event, after read())
+    """
+    
+    def __init__(self):
+        self.t0 = 0.0
+        self.resolution = 0.0
+        self.ntets = 0
+        self.ntris = 0
+        self.names = {}
+        self.ktype = []
+        self.kelem = []
+        self.kproc = []
+        self.times = []
+        self.kprocs = []
+    
+    def describe(self, k):
+        """
+        A description of kproc k, e.g. 'Diff diffA in tet 12'.
+        """
+        ty = self.ktype[k]
+        e = self.kelem[k]
+        if e < self.ntets:
+            where = 'tet %d' % e
+        elif e < self.ntets + self.ntris:
+            where = 'tri %d' % (e - self.ntets)
+        else:
+            where = 'comp %d' % (e - self.ntets - self.ntris)
+        return '%s %s in %s' % (ty, self.names[ty][self.kproc[k]], where)
+    
+    def counts(self):
+        """
+        The number of events of each process, as a dictionary from 
+        (kproc type, process name) to count.
+        """
+        n = {}
+        for k in self.kprocs:
+            key = (self.ktype[k], self.names[self.ktype[k]][self.kproc[k]])
+            n[key] = n.get(key, 0) + 1
+        return n
+
+################################################################################
+
+def _varint(data, pos):
+    n = 0
+    shift = 0
+    while True:
+        b = data[pos]
+        pos += 1
+        n |= (b & 0x7F) << shift
+        if b < 0x80:
+            return n, pos
+        shift += 7
+
+def _zigzag(z):
+    return (z >> 1) ^ -(z & 1)
+
+def _header(data):
+    if bytes(data[0:8]).decode('latin-1') != MAGIC:
+        raise IOError('Not an event trace file')
+    tr = EventTrace()
+    version, pos = _varint(data, 8)
+    if version != 1:
+        raise IOError('Unsupported event trace version %d' % version)
+    tr.t0, tr.resolution = struct.unpack('<dd', bytes(data[pos:pos + 16]))
+    pos += 16
+    tr.ntets, pos = _varint(data, pos)
+    tr.ntris, pos = _varint(data, pos)
+    for ty in KPROC_TYPES:
+        n, pos = _varint(data, pos)
+        names = []
+        for i in range(n):
+            l, pos = _varint(data, pos)
+            names.append(bytes(data[pos:pos + l]).decode('latin-1'))
+            pos += l
+        tr.names[ty] = names
+    nkprocs, pos = _varint(data, pos)
+    for k in range(nkprocs):
+        tr.ktype.append(KPROC_TYPES[data[pos]])
+        e, pos = _varint(data, pos + 1)
+        p, pos = _varint(data, pos)
+        tr.kelem.append(e)
+        tr.kproc.append(p)
+    return tr, pos
+
+################################################################################
+
+def _events(data, tr, pos):
+    tick = 0
+    k = 0
+    end = len(data)
+    while pos < end:
+        dt, pos = _varint(data, pos)
+        dk, pos = _varint(data, pos)
+        tick += _zigzag(dt)
+        k += _zigzag(dk)
+        yield tr.t0 + tick * tr.resolution, k
+
+def events(file_name):
+    """
+    Iterate over the events of an event trace file, as (time, kproc) 
+    pairs in the order they happened.
+    """
+    data = bytearray(open(file_name, 'rb').read())
+    tr, pos = _header(data)
+    return _events(data, tr, pos)
+
+def read(file_name):
+    """
+    Read an event trace file written by Tetexact.startEventTrace.
+    
+    Return:
+        EventTrace
+    """
+    data = bytearray(open(file_name, 'rb').read())
+    tr, pos = _header(data)
+    for t, k in _events(data, tr, pos):
+        tr.times.append(t)
+        tr.kprocs.append(k)
+    return tr
+
+################################################################################
+
+# END
@@ -59,19 +59,7 @@ def findOverlapTris(mesh, tets1, tets2):
         list<uint>
     """
     
-    tris1 = set()
-    for i in tets1:
-        tritemp = mesh.getTetTriNeighb(i)
-        for j in range(4): 
-            tris1.add(tritemp[j])
-    tris2 = set()
-    for i in tets2:
-        tritemp = mesh.getTetTriNeighb(i)
-        for j in range(4): 
-            tris2.add(tritemp[j])
-
-    common_tris = tris1.intersection(tris2)
-    return list(common_tris)
+    return list(mesh.findOverlapTris(tets1, tets2))
     
 ################################################################################
 
@@ -92,37 +80,11 @@ def findOverlapSurfTris(mesh1, mesh2):
         list<list<uint, uint, uint, uint, float>>
     """
     
-    surfs1 = mesh1.getSurfTris()
-    surfs2 = mesh2.getSurfTris()
+    flat = mesh1.findOverlapSurfTris(mesh2)
     data = []
-    
-    for s1 in surfs1:
-        c1 = mesh1.getTriBarycenter(s1)
-        
-        neighb_tets1 = mesh1.getTriTetNeighb(s1)
-        tetid1 = neighb_tets1[0]
-        if tetid1 < 0:
-            tetid1 = neighb_tets1[1]
-        assert(tetid1 >= 0)
-        tc1 = mesh1.getTetBarycenter(tetid1)
-        
-        for s2 in surfs2:
-            c2 = mesh2.getTriBarycenter(s2)
-            if (c1[0] == c2[0]) and (c1[1] == c2[1]) and (c1[2] == c2[2]): 
-                neighb_tets2 = mesh2.getTriTetNeighb(s2)
-                tetid2 = neighb_tets2[0]
-                if tetid2 < 0:
-                    tetid2 = neighb_tets2[1]
-                assert(tetid2 >= 0)
-                tc2 = mesh2.getTetBarycenter(tetid2)
-                
-                xdist = tc1[0] - tc2[0]
-                ydist = tc1[1] - tc2[1]
-                zdist = tc1[2] - tc2[2]
-                dist = sqrt((xdist*xdist) + (ydist*ydist) + (zdist*zdist))
-                
-                coupling = [tetid1, s1, tetid2, s2, dist]
-                data.append(coupling)
+    for i in range(0, len(flat), 5):
+        data.append([int(flat[i]), int(flat[i + 1]), int(flat[i + 2]), 
+                     int(flat[i + 3]), flat[i + 4]])
     return data
                 
 ################################################################################
@@ -144,17 +106,7 @@ def findSurfTrisInComp(mesh, comp):
         list<uint>
         """
     
-    surf_tris = mesh.getSurfTris()
-    comp_tets = comp.getAllTetIndices()
-    
-    out_surfs = []
-    for tet in  comp_tets:
-        nb_tris = mesh.getTetTriNeighb(tet)
-        for tri in nb_tris:
-            if tri in surf_tris:
-                out_surfs.append(tri)
-    
-    return out_surfs
+    return list(mesh.findSurfTrisInComp(comp))
             
 ################################################################################
 
@@ -175,16 +127,7 @@ def findSurfTrisInTets(mesh, tet_list):
         list<uint>
     """
     
-    surf_tris = mesh.getSurfTris()
-
-    out_surfs = []
-    for tet in  tet_list:
-        nb_tris = mesh.getTetTriNeighb(tet)
-        for tri in nb_tris:
-            if tri in surf_tris:
-                out_surfs.append(tri)
-    
-    return out_surfs
+    return list(mesh.findSurfTrisInTets(tet_list))
             
 ################################################################################
 
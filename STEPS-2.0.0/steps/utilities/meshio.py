@@ -76,6 +76,10 @@ via the importing functions each time, if the tetmesh objects are intented to
 be used in multiple simulations. Since the importing functions require a massive
 amount of time to create the Tetmesh object, comparing to the loadTetmesh() method.
 
+steps.geom.importTetGen, importGmsh and importAbaqus read the same files in C++
+and return ElementMap objects in place of Element Proxies; they are much faster
+than the functions here on large meshes.
+
 """
 
 import time
@@ -1057,6 +1061,9 @@ def loadMesh(pathname):
     from scratch and really negates the use of storing the mesh infomation at all.
     For maximum benefit the XML file should be accompanied by the ASCII file, which
     contains all the internal information.
+
+    Meshes saved with saveMeshBinary() load much faster with loadMeshBinary(),
+    which also restores membranes and diffusion boundaries.
      
     PARAMETERS:
     
@@ -1244,3 +1251,40 @@ def loadMesh(pathname):
     
     return (mesh,comps_out,patches_out)
 
+#############################################################################################
+
+def saveMeshBinary(pathname, tetmesh):
+    """
+    Save a STEPS Tetmesh, with its compartments, patches, membranes and
+    diffusion boundaries, to the single binary file pathname + '.stepsmesh'.
+
+    This is the successor of saveMesh(): the file is written in C++
+    (see steps.geom.saveBinary) and holds every table of the mesh, so
+    that loadMeshBinary() recomputes nothing and is limited by disk speed.
+    The file can only be read on machines with the same byte order.
+
+    PARAMETERS:
+
+    * pathname: the root of the path to store the file,
+      e.g. 'meshes/spine1' will save the file meshes/spine1.stepsmesh
+    * tetmesh: A valid STEPS Tetmesh object (of class steps.geom.Tetmesh).
+    """
+    stetmesh.saveBinary(pathname + '.stepsmesh', tetmesh)
+
+#############################################################################################
+
+def loadMeshBinary(pathname):
+    """
+    Load a mesh saved by saveMeshBinary(), with all its compartments,
+    patches, membranes and diffusion boundaries, in one call.
+
+    PARAMETERS:
+
+    * pathname: the root of the path where the file is stored,
+      e.g. 'meshes/spine1' will load the file meshes/spine1.stepsmesh
+
+    RETURNS: A tuple (mesh, comps, patches), as loadMesh() does.
+    """
+    mesh = stetmesh.loadBinary(pathname + '.stepsmesh')
+    return (mesh, list(mesh.getAllComps()), list(mesh.getAllPatches()))
+
@@ -0,0 +1,124 @@
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# STEPS - STochastic Engine for Pathway Simulation
+# Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+# Copyright (C) 2003-2006 University of Antwerp, Belgium.
+#
+# See the file AUTHORS for details.
+#
+# This file is part of STEPS.
+#
+# STEPS is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# STEPS is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+"""
+Reproducibility Utilities
+
+The repro module checks that a simulation gives the same results, bit 
+for bit, whatever the number of threads it runs on, or whether it is 
+checkpointed and restored on the way, by comparing the state hashes 
+(getStateHash) of the Tetexact or TetODE solvers.
+
+"""
+
+################################################################################
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # 
+################################################################################
+def checkThreads(make_solver, nthreads, tpnts):
+    """
+    Run a simulation on each of the given thread counts and check that 
+    every run follows the same trajectory.
+    
+    make_solver(n) builds the solver, sets it up to run on n threads 
+    (e.g. with setClusters(nclusters, n) for Tetexact, with the same 
+    number of clusters for every n, or setNThreads(n) for TetODE), 
+    seeds its random number generator the same way every time and sets 
+    the initial state. Each solver is then run to the time points in 
+    tpnts and its state hash taken at each of them. A RuntimeError is 
+    raised at the first time point where a thread count gives a 
+    different hash from the first one.
+    
+    Arguements:
+        * function make_solver
+        * list<uint> nthreads
+        * list<float> tpnts
+        
+    Return:
+        list<string> (the hashes of the first thread count)
+    """
+    
+    ref = None
+    for n in nthreads:
+        sim = make_solver(n)
+        hashes = []
+        for t in tpnts:
+            sim.run(t)
+            hashes.append(sim.getStateHash())
+        if ref is None:
+            ref = (n, hashes)
+            continue
+        for i in range(len(tpnts)):
+            if hashes[i] != ref[1][i]:
+                raise RuntimeError("Runs on %d and %d threads differ at time %g." 
+                                   % (ref[0], n, tpnts[i]))
+    if ref is None: return []
+    return ref[1]
+
+################################################################################
+
+def checkRestore(make_solver, reseed, tcp, tpnts, file_name):
+    """
+    Check that a simulation restored from a checkpoint follows the same 
+    trajectory as the one that wrote it.
+    
+    make_solver() builds the solver and sets the initial state. A first 
+    solver is run to time tcp and checkpointed to file_name; a second 
+    one is restored from file_name. After reseed() has seeded the random 
+    number generator of each the same way, both are run to the time 
+    points in tpnts and their state hashes compared. A RuntimeError is 
+    raised at the first time point where they differ.
+    
+    Arguements:
+        * function make_solver
+        * function reseed
+        * float tcp
+        * list<float> tpnts
+        * string file_name
+        
+    Return:
+        list<string> (the hashes of the solver that was checkpointed)
+    """
+    
+    sim = make_solver()
+    sim.run(tcp)
+    sim.checkpoint(file_name)
+    reseed()
+    ref = []
+    for t in tpnts:
+        sim.run(t)
+        ref.append(sim.getStateHash())
+    
+    sim = make_solver()
+    sim.restore(file_name)
+    reseed()
+    for i in range(len(tpnts)):
+        sim.run(tpnts[i])
+        if sim.getStateHash() != ref[i]:
+            raise RuntimeError("The restored run differs at time %g." 
+                               % tpnts[i])
+    return ref
+
+################################################################################
+
+# END
@@ -22,7 +22,11 @@
 #
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
 
-import libsbml
+try:
+    import libsbml
+except ImportError:
+    # Only Interface needs libSBML; NativeInterface reads SBML itself.
+    libsbml = None
 import sys
 import os
 import math
@@ -30,6 +34,7 @@ import random
 
 import steps.model as smodel
 import steps.geom as sgeom
+import steps.steps_swig as steps_swig
 
 ####################################################################################################
 #                                           Constants                                              #
@@ -456,6 +461,9 @@ class Interface(object):
                 raise IOError("Sbml File '%s' not found or unreadable in dir %s" %(filename, os.getcwd())) 
         
         # Need to save for reset() function
+        if libsbml == None:
+            raise ImportError("libSBML is not installed; use NativeInterface or install libSBML.")
+        
         self.__timeunits_def = timeunits_def
         self.__volunits_def = volunits_def
         self.__subsunits_def = subsunits_def
@@ -4113,6 +4121,155 @@ class Interface(object):
 ####################################################################################################
 ####################################################################################################
 
+class NativeInterface(object):
+    """
+    SBML importer implemented in C++ (steps_swig.SBMLInterface). It needs no libSBML 
+    and builds the model in one call, which makes importing large SBML models fast.
+    
+    The arguments and the methods are those of Interface, and the model follows the 
+    same conventions (volume systems 'compartment_volsys', surface systems 'patch_ssys', 
+    reversible reactions split into 'reaction_f' and 'reaction_b'). Models with events, 
+    algebraic rules or unusual units raise steps.NotImplErr; use Interface for those.
+    """
+    
+    def __init__(self, filename, timeunits_def = 1.0, volunits_def = 1.0e-3, subsunits_def = 1.0, volume_def = False, area_def = False, strict_mode = False):
+        """
+        Construction::
+        
+            iface = steps.utilities.sbml.NativeInterface(sbml_filename, timeunits_def = 1.0, volunits_def = 1.0e-3, subsunits_def = 1.0, volume_def = False, area_def = False, strict_mode = False)
+        
+        See Interface.
+        """
+        if volume_def == False: volume_def = 0.0
+        if area_def == False: area_def = 0.0
+        self.__iface = steps_swig.SBMLInterface(filename, timeunits_def, volunits_def, subsunits_def, volume_def, area_def, strict_mode)
+    
+    ################################################################################################
+    
+    def getModel(self):
+        """
+        Returns a reference to the steps.model.Model biochemical model container object 
+        created during SBML import.
+        
+        Syntax::
+        
+            getModel()
+        
+        Arguments:
+            None
+        
+        Return:
+            steps.model.Model
+        
+        """
+        # The C++ interface owns the model: keep it alive with it.
+        mdl = self.__iface.getModel()
+        mdl._sbml_iface = self.__iface
+        return mdl
+    
+    ################################################################################################
+    
+    def getGeom(self):
+        """
+        Returns a reference to the steps.geom.Geom geometry container object 
+        created during SBML import.
+        
+        Syntax::
+        
+            getGeom()
+        
+        Arguments:
+            None
+        
+        Return:
+            steps.geom.Geom
+        
+        """
+        geom = self.__iface.getGeom()
+        geom._sbml_iface = self.__iface
+        return geom
+    
+    ################################################################################################
+    
+    def setupSim(self, sim):
+        """
+        Setup the simulation, initialising molecule counts, compartment volumes and 
+        SBML 'boundary conditions' to those specified in the SBML file.
+        This function is NOT called internally and must be called by the user.
+        
+        Syntax::
+        
+            setupSim(sim)
+        
+        Arguments:
+            steps.solver.API sim (steps.solver.Wmdirect or steps.solver.Wmrk4 solver object)
+        
+        Return 
+            None
+        
+        """
+        self.__iface.setupSim(sim)
+    
+    ################################################################################################
+    
+    def updateSim(self, sim, simdt):
+        """
+        Update the simulation solver state, which may impact any variables in the simulation that 
+        can be altered within Rules. Time since last update given as argument dt in seconds. 
+        
+        Syntax:: 
+        
+            updateSim(sim, dt)
+        
+        Arguments:
+            * steps.solver.API  sim (steps.solver.Wmdirect or steps.solver.Wmrk4 solver object)
+            * float             dt
+            
+        Return 
+            None
+        """
+        self.__iface.updateSim(sim, simdt)
+    
+    ################################################################################################
+    
+    def run(self, sim, endtime):
+        """
+        Run the simulation to endtime, applying rules and non-mass-action reactions
+        every update interval inside the C++ importer rather than in a Python loop
+        of run() and updateSim() calls.
+        
+        Syntax::
+        
+            run(sim, endtime)
+        
+        Arguments:
+            * steps.solver.API  sim (steps.solver.Wmdirect or steps.solver.Wmrk4 solver object)
+            * float             endtime
+            
+        Return 
+            None
+        """
+        self.__iface.run(sim, endtime)
+    
+    ################################################################################################
+    
+    def getUpdateInterval(self):
+        """
+        Returns the interval (in seconds) at which run() applies the rules.
+        """
+        return self.__iface.getUpdateInterval()
+    
+    ################################################################################################
+    
+    def setUpdateInterval(self, dt):
+        """
+        Sets the interval (in seconds) at which run() applies the rules. Default 1.0e-3.
+        """
+        self.__iface.setUpdateInterval(dt)
+    
+####################################################################################################
+####################################################################################################
+
 class Reaction(object):
     def __init__(self):
         self.__name = ""
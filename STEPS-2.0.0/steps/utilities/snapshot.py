@@ -0,0 +1,142 @@
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+# STEPS - STochastic Engine for Pathway Simulation
+# Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+# Copyright (C) 2003-2006 University of Antwerp, Belgium.
+#
+# See the file AUTHORS for details.
+#
+# This file is part of STEPS.
+#
+# STEPS is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# STEPS is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+
+
+
+"""
+Snapshot Stream Utilities
+
+Reads the frames that Tetexact publishes with setSnapshotStream: the 
+molecule counts of chosen species summed over a coarse grid of voxels, 
+kept up to date in a file mapped in memory while the simulation runs. 
+A viewer opens the file once and reads a frame whenever it redraws, 
+without querying the solver.
+
+"""
+
+import mmap
+import struct
+import time
+
+################################################################################
+
+MAGIC = 'STEPSVIS'
+
+# Offsets in the header of a snapshot stream file.
+_OFF_SEQ = 80
+_OFF_NAMES = 112
+_NAMELEN = 32
+
+################################################################################
+# # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # 
+################################################################################
+
+class SnapshotReader(object):
+    """
+    A snapshot stream file, mapped for reading.
+    
+    Attributes:
+        * nx, ny, nz (the number of voxels along each axis)
+        * specs (the names of the species, in the order of the frame)
+        * lo (the lower corner of the grid)
+        * voxel (the size of a voxel along each axis)
+    """
+    
+    def __init__(self, file_name):
+        self._file = open(file_name, 'rb')
+        self._map = mmap.mmap(self._file.fileno(), 0, access = mmap.ACCESS_READ)
+        if self._map[0:8].decode('latin-1') != MAGIC:
+            self.close()
+            raise IOError('Not a snapshot stream file')
+        version, self._hsize, self.nx, self.ny, self.nz, nspecs = \
+            struct.unpack_from('=6I', self._map, 8)
+        if version != 1:
+            self.close()
+            raise IOError('Unsupported snapshot stream version %d' % version)
+        grid = struct.unpack_from('=6d', self._map, 32)
+        self.lo = list(grid[0:3])
+        self.voxel = list(grid[3:6])
+        self.specs = []
+        for s in range(nspecs):
+            pos = _OFF_NAMES + s * _NAMELEN
+            name = self._map[pos:pos + _NAMELEN].decode('latin-1')
+            self.specs.append(name.split('\0')[0])
+        self._nvox = self.nx * self.ny * self.nz
+        self._fmt = '=%dd' % (self._nvox * nspecs)
+    
+    def close(self):
+        """
+        Unmap the file.
+        """
+        self._map.close()
+        self._file.close()
+    
+    def index(self, x, y, z):
+        """
+        The position of voxel (x, y, z) in the counts of a species.
+        """
+        return x + self.nx * (y + self.ny * z)
+    
+    def center(self, i):
+        """
+        The centre of voxel i.
+        """
+        x = i % self.nx
+        y = (i // self.nx) % self.ny
+        z = i // (self.nx * self.ny)
+        return [self.lo[0] + (x + 0.5) * self.voxel[0], \
+            self.lo[1] + (y + 0.5) * self.voxel[1], \
+            self.lo[2] + (z + 0.5) * self.voxel[2]]
+    
+    def frame(self, timeout = 1.0):
+        """
+        Read the latest frame, retrying while the solver writes one.
+        
+        Arguments:
+            * float timeout (seconds to keep retrying)
+        
+        Return:
+            (frame number, simulation time, wall clock time, counts), 
+            counts a dictionary from species name to the list of its 
+            counts by voxel index; or None if no whole frame could be read
+        """
+        end = time.time() + timeout
+        while True:
+            seq, = struct.unpack_from('=Q', self._map, _OFF_SEQ)
+            if seq % 2 == 0:
+                frame, t, wall = struct.unpack_from('=Qdd', self._map, _OFF_SEQ + 8)
+                data = struct.unpack_from(self._fmt, self._map, self._hsize)
+                if struct.unpack_from('=Q', self._map, _OFF_SEQ)[0] == seq:
+                    counts = {}
+                    for s in range(len(self.specs)):
+                        counts[self.specs[s]] = \
+                            list(data[s * self._nvox:(s + 1) * self._nvox])
+                    return frame, t, wall, counts
+            if time.time() > end:
+                return None
+            time.sleep(0.001)
+
+################################################################################
+
+# END
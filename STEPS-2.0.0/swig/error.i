@@ -33,10 +33,51 @@
 %{
 // Autotools definitions.
 #include "../cpp/error.hpp"
+
+// Releases the Python GIL for its lifetime, letting other Python threads
+// run while a long solver call works on C++ data only.
+class StepsReleaseGIL
+{
+public:
+    StepsReleaseGIL(void) : pState(PyEval_SaveThread()) { }
+    ~StepsReleaseGIL(void) { PyEval_RestoreThread(pState); }
+private:
+    PyThreadState * pState;
+};
+%}
+
+%init
+%{
+#if PY_VERSION_HEX < 0x03070000
+    PyEval_InitThreads();
+#endif
 %}
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Wraps the named functions with the GIL released. They must not touch
+// Python objects; the GIL is back before an exception is translated.
+%define STEPS_RELEASE_GIL(name)
+%exception name
+{
+	try {
+		StepsReleaseGIL nogil;
+		$action
+	} catch (steps::ArgErr & ae) {
+		PyErr_SetString(PyExc_NameError, ae.getMsg());
+		return NULL;
+	} catch (steps::NotImplErr & nie) {
+		PyErr_SetString(PyExc_NotImplementedError, nie.getMsg());
+		return NULL;
+	} catch (steps::ProgErr & pe){
+        PyErr_SetString(PyExc_RuntimeError, pe.getMsg());
+        return NULL;
+    }
+}
+%enddef
+
+////////////////////////////////////////////////////////////////////////////////
+
 %feature("autodoc", "1");
 
 ////////////////////////////////////////////////////////////////////////////////
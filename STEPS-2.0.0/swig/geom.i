@@ -46,6 +46,8 @@
 #include "../cpp/geom/tmpatch.hpp"
 #include "../cpp/geom/tet.hpp"
 #include "../cpp/geom/tetmesh_rw.hpp"
+#include "../cpp/geom/tetmesh_import.hpp"
+#include "../cpp/meshcache.hpp"
 #include "../cpp/geom/tetmesh.hpp"
 #include "../cpp/geom/tri.hpp"
 #include "../cpp/error.hpp"
@@ -139,6 +141,15 @@ namespace std
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// Building or reading a mesh runs without the GIL.
+STEPS_RELEASE_GIL(steps::tetmesh::Tetmesh::Tetmesh);
+STEPS_RELEASE_GIL(steps::tetmesh::loadBinary);
+STEPS_RELEASE_GIL(steps::tetmesh::importTetGen);
+STEPS_RELEASE_GIL(steps::tetmesh::importGmsh);
+STEPS_RELEASE_GIL(steps::tetmesh::importAbaqus);
+
+///////////////////////////////////////////////////////////////////////////////
+
 namespace steps
 {
 namespace wm
@@ -728,7 +739,8 @@ public:
 	// Tetmesh(unsigned int nverts, unsigned int ntets, unsigned int ntris);
 	Tetmesh(std::vector<double> const & verts,
 			std::vector<unsigned int> const & tets,
-			std::vector<unsigned int> const & tris = std::vector<unsigned int>());
+			std::vector<unsigned int> const & tris = std::vector<unsigned int>(),
+			unsigned int nthreads = 1);
 	Tetmesh(std::vector<double> const & verts,
 			std::vector<unsigned int> const & tris,
 			std::vector<double> const & tri_areas,
@@ -1009,6 +1021,29 @@ Return:
 
     %feature("autodoc", 
 "
+Returns quality and size statistics of the tetrahedrons with indices 
+tets, or of all tetrahedrons if tets is empty, computed in batches on 
+nthreads threads. Six values are given per tetrahedron, one 
+tetrahedron after the other: the radius-edge-ratio (as 
+getTetQualityRER), the volume, the shortest and longest edge length, 
+and the smallest and largest dihedral angle in radians.
+
+Syntax::
+    
+    getTetStats(tets, nthreads)
+
+Arguments:
+    * list<uint> tets (default = [])
+    * uint nthreads (default = 1)
+             
+Return:
+    list<float, length = 6 * number of tetrahedrons>
+");
+	std::vector<double> getTetStats(std::vector<unsigned int> const & tets 
+		= std::vector<unsigned int>(), unsigned int nthreads = 1) const;
+
+    %feature("autodoc", 
+"
 Returns the normal vector of the triangle with index tidx.
 
 Syntax::
@@ -1126,6 +1161,159 @@ Return:
 ");
 	std::vector<int> getSurfTris(void) const;
 	//steps::tetmesh::TmComp * getTmComp(std::string const & id) const;
+
+    %feature("autodoc", 
+"
+Returns the triangles that are a face of a tetrahedron of tets1 and of 
+a tetrahedron of tets2, in increasing order.
+
+Syntax::
+
+    findOverlapTris(tets1, tets2)
+
+Arguments:
+    * list<uint> tets1
+    * list<uint> tets2
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> findOverlapTris(std::vector<unsigned int> const & tets1, 
+		std::vector<unsigned int> const & tets2) const;
+
+    %feature("autodoc", 
+"
+Returns the surface triangles (see getSurfTris) that are a face of a 
+tetrahedron of tets, in the order of their tetrahedrons.
+
+Syntax::
+
+    findSurfTrisInTets(tets)
+
+Arguments:
+    list<uint> tets
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> findSurfTrisInTets(std::vector<unsigned int> const & tets) const;
+
+    %feature("autodoc", 
+"
+Returns the surface triangles that are a face of a tetrahedron of comp, 
+a compartment of this mesh, in the order of its tetrahedrons.
+
+Syntax::
+
+    findSurfTrisInComp(comp)
+
+Arguments:
+    steps.geom.TmComp comp
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> findSurfTrisInComp(steps::tetmesh::TmComp * comp) const;
+
+    %feature("autodoc", 
+"
+Pairs the surface triangles of this mesh with the surface triangles of 
+mesh that have the same barycentre. For each pair, in the order of the 
+triangles of this mesh and then of mesh, returns five entries: the 
+tetrahedron and triangle of this mesh, the tetrahedron and triangle of 
+mesh, and the distance between the barycentres of the two tetrahedrons. 
+steps.utilities.meshctrl.findOverlapSurfTris returns these as one list 
+per pair.
+
+Syntax::
+
+    findOverlapSurfTris(mesh)
+
+Arguments:
+    steps.geom.Tetmesh mesh
+             
+Return:
+    list<float>
+");
+	std::vector<double> findOverlapSurfTris(steps::tetmesh::Tetmesh const & mesh) const;
+
+    %newobject extractSubmesh;
+    %feature("autodoc", 
+"
+Returns a new mesh made of the tetrahedrons tets of this one, with the 
+vertices and triangles they use, numbered in increasing order of their 
+indices in this mesh (see getParentVerts, getParentTris and 
+getParentTets for the maps back). Every compartment with tetrahedrons in 
+tets is carried over with those tetrahedrons, under the same ID and with 
+the same volume systems. A patch is carried over, with its surface 
+systems, with the triangles whose tetrahedrons in the new mesh are in 
+its inner and outer compartments (or, if none of the outer compartment 
+is left, in its inner compartment only). Membranes and diffusion 
+boundaries are not carried over. A simulation of a region then sets up 
+only that region.
+
+Syntax::
+
+    extractSubmesh(tets)
+
+Arguments:
+    list<uint> tets
+             
+Return:
+    steps.geom.Tetmesh
+");
+	steps::tetmesh::Tetmesh * extractSubmesh(std::vector<unsigned int> const & tets) const;
+
+    %feature("autodoc", 
+"
+For a mesh made by extractSubmesh, returns the index in the parent mesh 
+of each vertex; an empty list for other meshes.
+
+Syntax::
+
+    getParentVerts()
+
+Arguments:
+    None
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> getParentVerts(void) const;
+
+    %feature("autodoc", 
+"
+For a mesh made by extractSubmesh, returns the index in the parent mesh 
+of each triangle; an empty list for other meshes.
+
+Syntax::
+
+    getParentTris()
+
+Arguments:
+    None
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> getParentTris(void) const;
+
+    %feature("autodoc", 
+"
+For a mesh made by extractSubmesh, returns the index in the parent mesh 
+of each tetrahedron; an empty list for other meshes.
+
+Syntax::
+
+    getParentTets()
+
+Arguments:
+    None
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> getParentTets(void) const;
     
     %feature("autodoc", 
 "
@@ -1262,6 +1450,159 @@ Return:
 	
     %feature("autodoc", 
 "
+Returns the indices of the tetrahedra which encompass a list of points, 
+as findTetByPoint does for each point. -1 is returned for a point 
+outside the mesh. The points are searched with a grid over the mesh 
+that is built on the first search.
+
+Syntax::
+
+    findTetsByPoints(points)
+
+Arguments:
+    list<float> points (x0, y0, z0, x1, y1, z1, ...)
+             
+Return:
+    list<int>
+");
+	std::vector<int> findTetsByPoints(std::vector<double> const & points) const;
+
+    %feature("autodoc", 
+"
+Returns the tetrahedrons whose barycentre lies in the box from lo to hi, 
+bounds included, in increasing order. Uses the search grid of 
+findTetByPoint, so only the tetrahedrons near the box are examined.
+
+Syntax::
+
+    getTetsInBox(lo, hi)
+
+Arguments:
+    * list<float> lo
+    * list<float> hi
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> getTetsInBox(std::vector<double> const & lo, 
+		std::vector<double> const & hi) const;
+
+    %feature("autodoc", 
+"
+Returns the tetrahedrons whose barycentre lies within radius of 
+centre, in increasing order.
+
+Syntax::
+
+    getTetsInSphere(centre, radius)
+
+Arguments:
+    * list<float> centre
+    * float radius
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> getTetsInSphere(std::vector<double> const & centre, 
+		double radius) const;
+
+    %feature("autodoc", 
+"
+Returns the triangles with a point (a vertex, or a point on an edge or 
+in the interior) within dist of point, in increasing order.
+
+Syntax::
+
+    getTrisWithinDistance(point, dist)
+
+Arguments:
+    * list<float> point
+    * float dist
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> getTrisWithinDistance(std::vector<double> const & point, 
+		double dist) const;
+
+    %feature("autodoc", 
+"
+Returns the surface triangle (see getSurfTris) closest to point, the 
+lowest index of equally close ones, or -1 if the mesh has no surface. 
+The search grid of findTetByPoint is searched outwards from the point.
+
+Syntax::
+
+    findNearestSurfTri(point)
+
+Arguments:
+    list<float> point
+             
+Return:
+    int
+");
+	int findNearestSurfTri(std::vector<double> const & point) const;
+
+    %feature("autodoc", 
+"
+Returns the distance from point to the closest surface triangle.
+
+Syntax::
+
+    getSurfDistance(point)
+
+Arguments:
+    list<float> point
+             
+Return:
+    float
+");
+	double getSurfDistance(std::vector<double> const & point) const;
+	
+    %feature("autodoc", 
+"
+Splits the tetrahedrons into nparts parts of about equal weight for a 
+parallel solver, and returns the part of each tetrahedron. The parts 
+are grown over the tetrahedron neighbours, so each is a compact piece 
+of the mesh where the mesh allows. By default all tetrahedrons weigh 
+the same; the loads from Tetexact.getTetLoads can be given instead.
+
+Syntax::
+
+    partitionTets(nparts, weights = [])
+
+Arguments:
+    * uint nparts
+    * list<float> weights (default = [])
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> partitionTets(unsigned int nparts,
+		std::vector<double> const & weights = std::vector<double>()) const;
+	
+    %feature("autodoc", 
+"
+Returns the halo of part p of a partition from partitionTets: the 
+tetrahedrons of other parts that share a triangle with a tetrahedron 
+of part p, in increasing order.
+
+Syntax::
+
+    getPartitionHalo(parts, p)
+
+Arguments:
+    * list<uint> parts
+    * uint p
+             
+Return:
+    list<uint>
+");
+	std::vector<unsigned int> getPartitionHalo(std::vector<unsigned int> const & parts,
+		unsigned int p) const;
+	
+    %feature("autodoc", 
+"
 Returns the minimal Cartesian coordinate of the rectangular bounding box of the mesh. 
 
 Syntax::
@@ -1308,28 +1649,503 @@ Return:
 ");
 	double getMeshVolume(void) const;
 	
-};
+    %feature("autodoc", 
+"
+Returns the coordinates of all vertices in one flat list: 
+x, y, z of vertex 0, then of vertex 1, and so on.
 
-////////////////////////////////////////////////////////////////////////////////
-/*
-Tetmesh * loadASCII(std::string pathname);
+Syntax::
 
-void saveASCII(std::string pathname, Tetmesh * m);
-*/
-////////////////////////////////////////////////////////////////////////////////
+    getAllVertices()
 
-/* /////////////////////////////////////////////////////////////////////////////
-//////// OBJECT REMOVED BECAUSE OF MEMORY ISSUES. SEE TODO NOTE IN C++ /////////
-///////////////////////// CONSTRUCTOR FOR DETAILS //////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
+Arguments:
+    None
+             
+Return:
+    list<float, length = 3 * nverts>
+");
+	std::vector<double> getAllVertices(void) const;
+	
+    %feature("autodoc", 
+"
+Returns the vertices of all triangles in one flat list, three per 
+triangle.
 
-class Tri	
-{
+Syntax::
+
+    getAllTris()
+
+Arguments:
+    None
+             
+Return:
+    list<uint, length = 3 * ntris>
+");
+	std::vector<unsigned int> getAllTris(void) const;
 	
-public:
+    %feature("autodoc", 
+"
+Returns the vertices of all tetrahedrons in one flat list, four per 
+tetrahedron.
+
+Syntax::
+
+    getAllTets()
+
+Arguments:
+    None
+             
+Return:
+    list<uint, length = 4 * ntets>
+");
+	std::vector<unsigned int> getAllTets(void) const;
 	
-	Tri(Tetmesh * mesh, unsigned int tidx);
-	~Tri(void);
+    %feature("autodoc", 
+"
+Returns the areas of all triangles.
+
+Syntax::
+
+    getAllTriAreas()
+
+Arguments:
+    None
+             
+Return:
+    list<float, length = ntris>
+");
+	std::vector<double> getAllTriAreas(void) const;
+	
+    %feature("autodoc", 
+"
+Returns the barycenters of all triangles in one flat list, three 
+coordinates per triangle.
+
+Syntax::
+
+    getAllTriBarycenters()
+
+Arguments:
+    None
+             
+Return:
+    list<float, length = 3 * ntris>
+");
+	std::vector<double> getAllTriBarycenters(void) const;
+	
+    %feature("autodoc", 
+"
+Returns the normals of all triangles in one flat list, three 
+coordinates per triangle.
+
+Syntax::
+
+    getAllTriNorms()
+
+Arguments:
+    None
+             
+Return:
+    list<float, length = 3 * ntris>
+");
+	std::vector<double> getAllTriNorms(void) const;
+	
+    %feature("autodoc", 
+"
+Returns the tetrahedron neighbours of all triangles in one flat list, 
+two per triangle, as getTriTetNeighb does for each.
+
+Syntax::
+
+    getAllTriTetNeighbs()
+
+Arguments:
+    None
+             
+Return:
+    list<int, length = 2 * ntris>
+");
+	std::vector<int> getAllTriTetNeighbs(void) const;
+	
+    %feature("autodoc", 
+"
+Returns the volumes of all tetrahedrons.
+
+Syntax::
+
+    getAllTetVols()
+
+Arguments:
+    None
+             
+Return:
+    list<float, length = ntets>
+");
+	std::vector<double> getAllTetVols(void) const;
+	
+    %feature("autodoc", 
+"
+Returns the barycenters of all tetrahedrons in one flat list, three 
+coordinates per tetrahedron.
+
+Syntax::
+
+    getAllTetBarycenters()
+
+Arguments:
+    None
+             
+Return:
+    list<float, length = 3 * ntets>
+");
+	std::vector<double> getAllTetBarycenters(void) const;
+	
+    %feature("autodoc", 
+"
+Returns the triangle neighbours of all tetrahedrons in one flat list, 
+four per tetrahedron, as getTetTriNeighb does for each.
+
+Syntax::
+
+    getAllTetTriNeighbs()
+
+Arguments:
+    None
+             
+Return:
+    list<uint, length = 4 * ntets>
+");
+	std::vector<unsigned int> getAllTetTriNeighbs(void) const;
+	
+    %feature("autodoc", 
+"
+Returns the tetrahedron neighbours of all tetrahedrons in one flat 
+list, four per tetrahedron, as getTetTetNeighb does for each.
+
+Syntax::
+
+    getAllTetTetNeighbs()
+
+Arguments:
+    None
+             
+Return:
+    list<int, length = 4 * ntets>
+");
+	std::vector<int> getAllTetTetNeighbs(void) const;
+	
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/*
+Tetmesh * loadASCII(std::string pathname);
+
+void saveASCII(std::string pathname, Tetmesh * m);
+*/
+////////////////////////////////////////////////////////////////////////////////
+
+%newobject loadBinary;
+
+%feature("autodoc", 
+"
+Reads a tetrahedral mesh, with its compartments, patches, membranes and 
+diffusion boundaries, from a binary file written by saveBinary. The file is memory-mapped and 
+its tables are copied into the mesh as they are, so nothing is 
+recomputed and membranes are not verified again.
+
+With shared True the geometry tables are not copied but used in place 
+in a read-only shared mapping of the file. Worker processes loading 
+the same file, for instance to run an ensemble of Tetexact solvers, 
+then share a single copy of the mesh in memory. Meshes built while a 
+mesh cache directory is set are shared in the same way.
+
+Syntax::
+
+    loadBinary(pathname, shared = False)
+
+Arguments:
+    * string pathname
+    * bool shared
+             
+Return:
+    steps.geom.Tetmesh
+");
+Tetmesh * loadBinary(std::string pathname, bool shared = false);
+
+%feature("autodoc", 
+"
+Writes a tetrahedral mesh, with its compartments, patches, membranes and 
+diffusion boundaries, to a binary file that loadBinary can read. The 
+file is in the byte order of this machine.
+
+Syntax::
+
+    saveBinary(pathname, mesh)
+
+Arguments:
+    * string pathname
+    * steps.geom.Tetmesh mesh
+             
+Return:
+    None
+");
+void saveBinary(std::string pathname, Tetmesh * m);
+
+////////////////////////////////////////////////////////////////////////////////
+
+%feature("autodoc", 
+"
+The nodes, tetrahedrons or triangles of a mesh read by importTetGen, 
+importGmsh or importAbaqus: the ID each element has in the imported 
+file, and the groups and blocks of elements the file defines. STEPS 
+indices follow the order of the elements in the file.
+
+A group is a list of STEPS indices sharing an attribute in the file (a 
+TetGen region attribute or boundary marker, a Gmsh entity tag). A block 
+is a named range of STEPS indices (an Abaqus *NODE or *ELEMENT section).
+");
+class ElementMap
+{
+
+public:
+
+    ElementMap(std::string const & type = "");
+
+    %feature("autodoc", 
+"
+Returns the element type, \"node\", \"tet\" or \"tri\".
+
+Syntax::
+
+    getType()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    std::string getType(void) const;
+
+    %feature("autodoc", 
+"
+Returns the number of elements.
+
+Syntax::
+
+    getSize()
+
+Arguments:
+    None
+
+Return:
+    uint
+");
+    unsigned int getSize(void) const;
+
+    %feature("autodoc", 
+"
+Returns the import ID of every element, indexed by STEPS index.
+
+Syntax::
+
+    getImportIDs()
+
+Arguments:
+    None
+
+Return:
+    list<int>
+");
+    std::vector<int> getImportIDs(void) const;
+
+    %feature("autodoc", 
+"
+Returns the import ID of the element with STEPS index steps_id.
+
+Syntax::
+
+    getImportID(steps_id)
+
+Arguments:
+    uint steps_id
+
+Return:
+    int
+");
+    int getImportID(unsigned int steps_id) const;
+
+    %feature("autodoc", 
+"
+Returns the STEPS index of the element with import ID import_id.
+
+Syntax::
+
+    getSTEPSID(import_id)
+
+Arguments:
+    int import_id
+
+Return:
+    uint
+");
+    unsigned int getSTEPSID(int import_id) const;
+
+    %feature("autodoc", 
+"
+Returns the names of all groups.
+
+Syntax::
+
+    getGroupNames()
+
+Arguments:
+    None
+
+Return:
+    list<string>
+");
+    std::vector<std::string> getGroupNames(void) const;
+
+    %feature("autodoc", 
+"
+Returns the STEPS indices of the elements in group name.
+
+Syntax::
+
+    getGroup(name)
+
+Arguments:
+    string name
+
+Return:
+    list<uint>
+");
+    std::vector<unsigned int> getGroup(std::string const & name) const;
+
+    %feature("autodoc", 
+"
+Returns the names of all blocks.
+
+Syntax::
+
+    getBlockNames()
+
+Arguments:
+    None
+
+Return:
+    list<string>
+");
+    std::vector<std::string> getBlockNames(void) const;
+
+    %feature("autodoc", 
+"
+Returns the STEPS indices of the first and the last element of block 
+name.
+
+Syntax::
+
+    getBlock(name)
+
+Arguments:
+    string name
+
+Return:
+    list<uint, length = 2>
+");
+    std::vector<unsigned int> getBlock(std::string const & name) const;
+
+};
+
+%newobject importTetGen;
+%newobject importGmsh;
+%newobject importAbaqus;
+
+%feature("autodoc", 
+"
+Reads a TetGen mesh from pathroot.node, pathroot.ele and, if it exists, 
+pathroot.face, filling the element maps nodes, tets and tris. The files 
+are memory-mapped and parsed in C++. steps.geom.importTetGen wraps this 
+and creates the element maps.
+
+Syntax::
+
+    importTetGen(pathroot, nodes, tets, tris)
+
+Arguments:
+    * string pathroot
+    * steps.geom.ElementMap nodes
+    * steps.geom.ElementMap tets
+    * steps.geom.ElementMap tris
+
+Return:
+    steps.geom.Tetmesh
+");
+Tetmesh * importTetGen(std::string pathroot, ElementMap & nodes,
+                       ElementMap & tets, ElementMap & tris);
+
+%feature("autodoc", 
+"
+Reads an ASCII Gmsh mesh (format 2), multiplying the coordinates by 
+scale and filling the element maps nodes, tets and tris.
+
+Syntax::
+
+    importGmsh(filename, scale, nodes, tets, tris)
+
+Arguments:
+    * string filename
+    * float scale
+    * steps.geom.ElementMap nodes
+    * steps.geom.ElementMap tets
+    * steps.geom.ElementMap tris
+
+Return:
+    steps.geom.Tetmesh
+");
+Tetmesh * importGmsh(std::string filename, double scale, ElementMap & nodes,
+                     ElementMap & tets, ElementMap & tris);
+
+%feature("autodoc", 
+"
+Reads an Abaqus mesh, multiplying the coordinates by scale and filling 
+the element maps nodes, tets and tris. If blocks is not empty, only the 
+element sections it names are read.
+
+Syntax::
+
+    importAbaqus(filename, scale, nodes, tets, tris, blocks)
+
+Arguments:
+    * string filename
+    * float scale
+    * steps.geom.ElementMap nodes
+    * steps.geom.ElementMap tets
+    * steps.geom.ElementMap tris
+    * list<string> blocks (default = [])
+
+Return:
+    steps.geom.Tetmesh
+");
+Tetmesh * importAbaqus(std::string filename, double scale, ElementMap & nodes,
+                       ElementMap & tets, ElementMap & tris,
+                       std::vector<std::string> const & blocks = std::vector<std::string>());
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* /////////////////////////////////////////////////////////////////////////////
+//////// OBJECT REMOVED BECAUSE OF MEMORY ISSUES. SEE TODO NOTE IN C++ /////////
+///////////////////////// CONSTRUCTOR FOR DETAILS //////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+class Tri	
+{
+	
+public:
+	
+	Tri(Tetmesh * mesh, unsigned int tidx);
+	~Tri(void);
 	
 	unsigned int getIdx(void);
 	double getArea(void) const;
@@ -1897,6 +2713,49 @@ Return:
 ////////////////////////////////////////////////////////////////////////////////
 
 }	// end namespace tetmesh
+
+////////////////////////////////////////////////////////////////////////////////
+
+%feature("autodoc", 
+"
+Sets the mesh cache directory, an empty string turning the cache off 
+(the default unless the environment variable STEPS_MESH_CACHE names a 
+directory). While it is set, data derived from a mesh is saved in the 
+directory in files named after a hash of the mesh, and read back 
+instead of computed again by later jobs: the tables of Tetmesh, the 
+verification of Memb and the vertex ordering and coupling constants 
+of the EField (unless the membrane has an optimization file).
+
+Syntax::
+
+    setMeshCacheDir(dir)
+
+Arguments:
+    string dir
+
+Return:
+    None
+");
+void setMeshCacheDir(std::string const & dir);
+
+%feature("autodoc", 
+"
+Returns the mesh cache directory, or an empty string if there is none.
+
+Syntax::
+
+    getMeshCacheDir()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+std::string getMeshCacheDir(void);
+
+////////////////////////////////////////////////////////////////////////////////
+
 }	// end namespace steps
 
 // END
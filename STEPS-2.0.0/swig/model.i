@@ -50,6 +50,7 @@
 #include "../cpp/model/ghkcurr.hpp"
 #include "../cpp/model/chan.hpp"
 #include "../cpp/model/chanstate.hpp"
+#include "../cpp/model/network.hpp"
 %}
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -72,6 +73,7 @@ class VDepTrans;
 class VDepSReac;
 class OhmicCurr;
 class GHKcurr;
+class Network;
 }
 }
 
@@ -292,6 +294,125 @@ Return:
 ");
 	std::vector<Surfsys *> getAllSurfsyss(void) const;
 	
+    %newobject compile;
+    
+    %feature("autodoc", 
+"
+Returns a frozen steps.model.Network snapshot of the model: its species, 
+channels, reactions, diffusion rules and currents with all their 
+parameters. Later changes to the model do not affect the network.
+
+Syntax::
+
+    compile()
+    
+Arguments:
+    None
+             
+Return:
+    steps.model.Network
+");
+	Network * compile(void) const;
+	
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Network
+{
+
+public:
+
+	~Network(void);
+	
+    %newobject build;
+    
+    %feature("autodoc", 
+"
+Creates a new steps.model.Model from the network, with the same 
+identifiers, parameters and indices as the compiled model. The returned 
+model can be passed to any solver.
+
+Syntax::
+
+    build()
+    
+Arguments:
+    None
+             
+Return:
+    steps.model.Model
+");
+	Model * build(void) const;
+	
+    %feature("autodoc", 
+"
+Writes the network to a binary file that steps.model.Network.load can 
+read. The file is in the byte order of this machine.
+
+Syntax::
+
+    save(file)
+    
+Arguments:
+    string file
+             
+Return:
+    None
+");
+	void save(std::string const & file) const;
+	
+    %newobject load;
+    
+    %feature("autodoc", 
+"
+Reads a network from a file written by save.
+
+Syntax::
+
+    Network.load(file)
+    
+Arguments:
+    string file
+             
+Return:
+    steps.model.Network
+");
+	static Network * load(std::string const & file);
+	
+    %feature("autodoc", 
+"
+Returns the identifiers of all species in the network, channel states 
+included, in index order.
+
+Syntax::
+
+    getAllSpecIDs()
+    
+Arguments:
+    None
+             
+Return:
+    list<string>
+");
+	std::vector<std::string> getAllSpecIDs(void) const;
+	
+	uint countSpecs(void) const;
+	uint countChans(void) const;
+	uint countVolsyss(void) const;
+	uint countSurfsyss(void) const;
+	uint countReacs(void) const;
+	uint countSReacs(void) const;
+	uint countDiffs(void) const;
+	uint countVDepTrans(void) const;
+	uint countVDepSReacs(void) const;
+	uint countOhmicCurrs(void) const;
+	uint countGHKcurrs(void) const;
+
+private:
+
+	Network(void);
+
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1957,6 +2078,47 @@ Return:
 	list<float>
 ");
 	std::vector<double> getRate(void) const;
+
+	%feature("autodoc",
+"
+Fill the table of transition rates from a rate expression of the 
+voltage v (in volts), evaluated in C++ at each voltage of the range. 
+Expressions use numbers, v, + - * / ^ (or **), parentheses and the 
+functions exp, log, sqrt, abs, pow(x, y), vtrap(x, y) = x / (exp(x / y) - 1) 
+(equal to y at x = 0) and boltz(x, k) = 1 / (1 + exp(x / k)). For instance 
+the Hodgkin-Huxley alpha_n is '1.0e4 * vtrap(-(v + 0.055), 0.01)'.
+Passing the expression as the rate of the constructor calls this.
+			 
+Syntax::
+    
+    setRateExpr(expr)
+			 
+Arguments:
+    string expr
+	
+Return:
+	None
+");
+	void setRateExpr(std::string const & expr);
+
+	%feature("autodoc",
+"
+Copy the table of transition rates from the memory at address addr, 
+which must hold as many contiguous doubles as the table. Used by the 
+constructor to take a NumPy array of rates without converting each 
+element.
+			 
+Syntax::
+    
+    setRateAddr(addr)
+			 
+Arguments:
+    int addr
+	
+Return:
+	None
+");
+	void setRateAddr(size_t addr);
 	
 };	
 
@@ -2281,6 +2443,43 @@ Return:
 ");
 	std::vector<double> getK(void) const;
 
+	%feature("autodoc",
+"
+Fill the table of reaction parameters from a rate expression of the 
+voltage v (in volts), evaluated in C++ at each voltage of the range 
+(see steps.model.VDepTrans.setRateExpr for the expression language). 
+Passing the expression as k to the constructor calls this.
+			 
+Syntax::
+    
+    setKExpr(expr)
+			 
+Arguments:
+    string expr
+	
+Return:
+	None
+");
+	void setKExpr(std::string const & expr);
+
+	%feature("autodoc",
+"
+Copy the table of reaction parameters from the memory at address addr, 
+which must hold as many contiguous doubles as the table. Used by the 
+constructor to take a NumPy array without converting each element.
+			 
+Syntax::
+    
+    setKAddr(addr)
+			 
+Arguments:
+    int addr
+	
+Return:
+	None
+");
+	void setKAddr(size_t addr);
+
     %feature("autodoc", 
 "
 Returns a list of references to all steps.model.Spec species objects in 
@@ -98,6 +98,47 @@ Return:
 ");
 			void initialize(unsigned long const & seed);
 			
+            %feature("autodoc", 
+"
+Initialize the random number generator to stream number stream of seed. 
+Stream 0 is the sequence initialize(seed) gives, and stream k starts k 
+stream lengths after it, so the streams of one seed never overlap. Use one 
+stream per replicate or per thread for independent parallel simulations 
+from a single master seed. jump() on a generator set to stream k - 1 lands 
+a buffer size past the start of stream k, because it counts from the 
+numbers already drawn into the buffer.
+
+Syntax::
+    
+    initializeStream(seed, stream)
+    
+Arguments:
+    * uint seed
+    * uint stream
+
+Return:
+    None
+");
+			void initializeStream(unsigned long const & seed, unsigned long const & stream);
+			
+            %feature("autodoc", 
+"
+Move the generator n streams ahead of the numbers it has generated, 
+discarding the ones not used yet. A stream is 2^128 numbers long for 
+mt19937 and 2^66 numbers for philox4x32.
+
+Syntax::
+    
+    jump(n = 1)
+    
+Arguments:
+    uint n
+
+Return:
+    None
+");
+			void jump(unsigned long const & n = 1);
+			
 			unsigned int get(void);
 			
 			double getUnfII(void);
@@ -105,6 +146,43 @@ Return:
 			double getUnfEE(void);
 			double getUnfIE53(void);
 			
+            %feature("autodoc", 
+"
+Choose the methods of the exponential and normal samplers (getStdExp, 
+getExp, getStdNrm, and through them getPsn): the ziggurat method of 
+Marsaglia and Tsang, which is faster, or the algorithms of Ahrens and 
+Dieter used by earlier versions, the default, which reproduce their 
+results.
+
+Syntax::
+    
+    setZiggurat(on)
+    
+Arguments:
+    bool on
+
+Return:
+    None
+");
+			void setZiggurat(bool on);
+			
+            %feature("autodoc", 
+"
+Returns True if the exponential and normal samplers use the ziggurat 
+method.
+
+Syntax::
+    
+    getZiggurat()
+    
+Arguments:
+    None
+
+Return:
+    bool
+");
+			bool getZiggurat(void) const;
+			
 			float getStdExp(void);
 			virtual double getExp(double lambda);
 			long getPsn(float lambda);
@@ -136,8 +214,27 @@ Return:
 		
         %feature("autodoc", 
 "
+Equivalent to: create('philox4x32', buffer_size)
+
+Syntax::
+
+    create_philox4x32(buffer_size)
+    
+Arguments:
+    uint buffer_size
+
+Return:
+    steps.rng.RNG
+");		
+		RNG * create_philox4x32(unsigned int bufsize);
+		
+        %feature("autodoc", 
+"
 Creates and returns a reference to a steps.rng.RNG random number generator object, 
 which is specified by type and pre-allocates a buffer list with size of buffer_size.
+Available types are 'mt19937' (Mersenne Twister) and 'philox4x32' 
+(counter-based Philox4x32-10, whose seed is used as key so that 
+different seeds give independent streams).
 
 Syntax::
     
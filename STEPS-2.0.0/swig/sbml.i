@@ -0,0 +1,216 @@
+////////////////////////////////////////////////////////////////////////////////
+// STEPS - STochastic Engine for Pathway Simulation
+// Copyright (C) 2007-2013 Okinawa Institute of Science and Technology, Japan.
+// Copyright (C) 2003-2006 University of Antwerp, Belgium.
+//
+// See the file AUTHORS for details.
+//
+// This file is part of STEPS.
+//
+// STEPS is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// STEPS is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+%module sbml_swig
+
+%include "python/std_string.i"
+%include "error.i"
+%import "cpp/common.h"
+
+%{
+#include "../cpp/sbml/sbml.hpp"
+#include "../cpp/model/model.hpp"
+#include "../cpp/geom/geom.hpp"
+#include "../cpp/solver/api.hpp"
+%}
+
+namespace steps
+{
+namespace sbml
+{
+
+////////////////////////////////////////////////////////////////////////////////
+
+%feature("autodoc", "1");
+
+%rename(SBMLInterface) Interface;
+
+class Interface
+{
+
+public:
+
+    %feature("autodoc", 
+"
+Construction::
+
+    iface = steps.utilities.sbml.NativeInterface(filename, timeunits_def = 1.0, 
+        volunits_def = 1.0e-3, subsunits_def = 1.0, volume_def = 0.0, 
+        area_def = 0.0, strict_mode = False)
+
+Imports the SBML file filename into a steps.model.Model and a well-mixed 
+steps.geom.Geom without libSBML. The arguments are as for 
+steps.utilities.sbml.Interface, except that a volume_def or area_def of 
+0.0 leaves compartment sizes as they are.
+
+Arguments:
+    * string filename
+    * float timeunits_def (default = 1.0)
+    * float volunits_def (default = 1.0e-3)
+    * float subsunits_def (default = 1.0)
+    * float volume_def (default = 0.0)
+    * float area_def (default = 0.0)
+    * bool strict_mode (default = False)
+");
+    Interface(std::string const & filename, double timeunits_def = 1.0,
+              double volunits_def = 1.0e-3, double subsunits_def = 1.0,
+              double volume_def = 0.0, double area_def = 0.0,
+              bool strict_mode = false);
+
+    ~Interface(void);
+
+    %feature("autodoc", 
+"
+Returns a reference to the steps.model.Model created during SBML import. 
+The model belongs to the interface object.
+
+Syntax::
+
+    getModel()
+
+Arguments:
+    None
+
+Return:
+    steps.model.Model
+");
+    steps::model::Model * getModel(void) const;
+
+    %feature("autodoc", 
+"
+Returns a reference to the steps.geom.Geom created during SBML import. 
+The geometry belongs to the interface object.
+
+Syntax::
+
+    getGeom()
+
+Arguments:
+    None
+
+Return:
+    steps.geom.Geom
+");
+    steps::wm::Geom * getGeom(void) const;
+
+    %feature("autodoc", 
+"
+Sets the compartment sizes, initial molecule amounts, constant species and 
+rate constants of sim to those of the SBML file, and resets rules to their 
+state after import.
+
+Syntax::
+
+    setupSim(sim)
+
+Arguments:
+    steps.solver.API sim (steps.solver.Wmdirect or steps.solver.Wmrk4 solver object)
+
+Return:
+    None
+");
+    void setupSim(steps::solver::API * sim);
+
+    %feature("autodoc", 
+"
+Applies rate rules, non-mass-action reactions and assignment rules for 
+the last dt seconds of simulation and updates the rate constants that 
+depend on them.
+
+Syntax::
+
+    updateSim(sim, dt)
+
+Arguments:
+    * steps.solver.API sim (steps.solver.Wmdirect or steps.solver.Wmrk4 solver object)
+    * float dt
+
+Return:
+    None
+");
+    void updateSim(steps::solver::API * sim, double simdt);
+
+    %feature("autodoc", 
+"
+Runs sim to endtime, applying the rules and non-mass-action reactions 
+every update interval (see setUpdateInterval) without returning to 
+Python. The last interval may be shorter.
+
+Syntax::
+
+    run(sim, endtime)
+
+Arguments:
+    * steps.solver.API sim (steps.solver.Wmdirect or steps.solver.Wmrk4 solver object)
+    * float endtime
+
+Return:
+    None
+");
+    void run(steps::solver::API * sim, double endtime);
+
+    %feature("autodoc", 
+"
+Returns the interval at which run applies the rules (in seconds).
+
+Syntax::
+
+    getUpdateInterval()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    double getUpdateInterval(void) const;
+
+    %feature("autodoc", 
+"
+Sets the interval at which run applies the rules (in seconds). 
+The default is 1.0e-3.
+
+Syntax::
+
+    setUpdateInterval(dt)
+
+Arguments:
+    float dt
+
+Return:
+    None
+");
+    void setUpdateInterval(double dt);
+
+    uint _countMassActionReacs(void) const;
+    uint _countMathReacs(void) const;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+}
+}
+
+// END
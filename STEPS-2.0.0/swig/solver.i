@@ -38,11 +38,22 @@
 %{
 #include "../cpp//solver/api.hpp"
 #include "../cpp/solver/statedef.hpp"
+#include "../cpp/solver/recorder.hpp"
 #include "../cpp/wmrk4/wmrk4.hpp"
 #include "../cpp/wmdirect/wmdirect.hpp"
+#include "../cpp/wmdirect/wmensemble.hpp"
 #include "../cpp/tetexact/tetexact.hpp"
+#include "../cpp/tetexact/ensemble.hpp"
+#include "../cpp/tetexact/ensemblefarm.hpp"
 #include "../cpp/tetode/tetode.hpp"
+#include "../cpp/hybrid/hybrid.hpp"
+#include "../cpp/hybrid/wmhybrid.hpp"
+#include "../cpp/voxel/voxel.hpp"
+#include "../cpp/tetleap/tetleap.hpp"
 #include "../cpp/error.hpp"
+#include "../cpp/trace.hpp"
+#include "../cpp/parallel.hpp"
+#include "../cpp/simd.hpp"
     
 #include "../third_party/cvode-2.6.0/src/cvode/cvode.h"             	/* prototypes for CVODE fcts., consts. */
 #include "../third_party/cvode-2.6.0/src/nvec_ser/nvector_serial.h"  	/* serial N_Vector types, fcts., macros */
@@ -71,6 +82,8 @@ namespace steps
 namespace tetode
 {
 
+class TetODE;
+
 struct structC
 {
     unsigned int order;
@@ -94,9 +107,23 @@ struct structA
 
 ////////////////////////////////////////////////////////////////////////////////
 
+namespace steps
+{
+namespace tetexact
+{
+
+class Tetexact;
+
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 namespace std
 {
     %template(vector_strb) vector<steps::tetode::structB>;
+    %template(vector_tex) vector<steps::tetexact::Tetexact *>;
+    %template(vector_rng) vector<steps::rng::RNG *>;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -123,6 +150,14 @@ namespace std
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Long calls run without the GIL, so that several solvers can be driven
+// from Python threads.
+STEPS_RELEASE_GIL(run);
+STEPS_RELEASE_GIL(advance);
+STEPS_RELEASE_GIL(checkpoint);
+
+////////////////////////////////////////////////////////////////////////////////
+
 namespace steps
 {
 namespace solver
@@ -506,6 +541,179 @@ Return:
     uint
 ");
 	virtual unsigned int getNSteps(void) const;
+
+    %feature("autodoc", 
+"
+Returns the global index of the species with identifier string id. The name is 
+resolved once, so that loops can use the index-based methods such as 
+getTetCountIdx afterwards.
+
+Syntax::
+    
+    getSpecIdx(id)
+    
+Arguments:
+    * string id
+
+Return:
+    uint
+");
+    unsigned int getSpecIdx(std::string const & id) const;
+
+    %feature("autodoc", 
+"
+Returns the global index of the compartment with identifier string id.
+
+Syntax::
+    
+    getCompIdx(id)
+    
+Arguments:
+    * string id
+
+Return:
+    uint
+");
+    unsigned int getCompIdx(std::string const & id) const;
+
+    %feature("autodoc", 
+"
+Returns the global index of the patch with identifier string id.
+
+Syntax::
+    
+    getPatchIdx(id)
+    
+Arguments:
+    * string id
+
+Return:
+    uint
+");
+    unsigned int getPatchIdx(std::string const & id) const;
+
+    %feature("autodoc", 
+"
+Returns the global index of the reaction with identifier string id.
+
+Syntax::
+    
+    getReacIdx(id)
+    
+Arguments:
+    * string id
+
+Return:
+    uint
+");
+    unsigned int getReacIdx(std::string const & id) const;
+
+    %feature("autodoc", 
+"
+Returns the global index of the surface reaction with identifier string id.
+
+Syntax::
+    
+    getSReacIdx(id)
+    
+Arguments:
+    * string id
+
+Return:
+    uint
+");
+    unsigned int getSReacIdx(std::string const & id) const;
+
+    %feature("autodoc", 
+"
+Returns the number of molecules of the species with global index sidx in 
+the compartment with global index cidx.
+
+Syntax::
+    
+    getCompCountIdx(cidx, sidx)
+    
+Arguments:
+    * uint cidx
+    * uint sidx
+
+Return:
+    float
+");
+    double getCompCountIdx(unsigned int cidx, unsigned int sidx) const;
+
+    %feature("autodoc", 
+"
+Returns the number of molecules of the species with global index sidx in 
+the patch with global index pidx.
+
+Syntax::
+    
+    getPatchCountIdx(pidx, sidx)
+    
+Arguments:
+    * uint pidx
+    * uint sidx
+
+Return:
+    float
+");
+    double getPatchCountIdx(unsigned int pidx, unsigned int sidx) const;
+
+    %feature("autodoc", 
+"
+Returns the number of molecules of the species with global index sidx in 
+the tetrahedral element with index idx.
+
+Syntax::
+    
+    getTetCountIdx(idx, sidx)
+    
+Arguments:
+    * uint idx
+    * uint sidx
+
+Return:
+    float
+");
+    double getTetCountIdx(unsigned int tidx, unsigned int sidx) const;
+
+    %feature("autodoc", 
+"
+Sets the number of molecules of the species with global index sidx in 
+the tetrahedral element with index idx.
+
+Syntax::
+    
+    setTetCountIdx(idx, sidx, n)
+    
+Arguments:
+    * uint idx
+    * uint sidx
+    * float n
+
+Return:
+    None
+");
+    void setTetCountIdx(unsigned int tidx, unsigned int sidx, double n);
+
+    %feature("autodoc", 
+"
+Returns the number of molecules of the species with global index sidx in 
+the triangular element with index idx.
+
+Syntax::
+    
+    getTriCountIdx(idx, sidx)
+    
+Arguments:
+    * uint idx
+    * uint sidx
+
+Return:
+    float
+");
+    double getTriCountIdx(unsigned int tidx, unsigned int sidx) const;
     
 	
     %feature("autodoc", 
@@ -1200,6 +1408,116 @@ Return:
 
     %feature("autodoc", 
 "
+Returns the number of molecules of species with identifier string spec in 
+each of a list of tetrahedral elements, in one call. The species is resolved 
+and the indices are checked once for the whole list.
+
+Syntax::
+    
+    getBatchTetCounts(idcs, spec)
+    
+Arguments:
+    * list<uint> idcs
+    * string spec
+
+Return:
+    list<float>
+");
+    std::vector<double> getBatchTetCounts(std::vector<unsigned int> const & tidcs,
+                                          std::string const & s) const;
+
+    %feature("autodoc", 
+"
+Sets the number of molecules of species with identifier string spec in each 
+of a list of tetrahedral elements to the matching entry of counts. Nothing is 
+changed if an index or a count is invalid.
+
+Syntax::
+    
+    setBatchTetCounts(idcs, spec, counts)
+    
+Arguments:
+    * list<uint> idcs
+    * string spec
+    * list<float> counts
+
+Return:
+    None
+");
+    void setBatchTetCounts(std::vector<unsigned int> const & tidcs,
+                           std::string const & s,
+                           std::vector<double> const & ns);
+
+    %feature("autodoc", 
+"
+Returns the concentration (in Molar units) of species with identifier string 
+spec in each of a list of tetrahedral elements, in one call.
+
+Syntax::
+    
+    getBatchTetConcs(idcs, spec)
+    
+Arguments:
+    * list<uint> idcs
+    * string spec
+
+Return:
+    list<float>
+");
+    std::vector<double> getBatchTetConcs(std::vector<unsigned int> const & tidcs,
+                                         std::string const & s) const;
+
+    %feature("autodoc", 
+"
+Sets the concentration (in Molar units) of species with identifier string 
+spec in each of a list of tetrahedral elements to the matching entry of concs. 
+Nothing is changed if an index or a concentration is invalid.
+
+Syntax::
+    
+    setBatchTetConcs(idcs, spec, concs)
+    
+Arguments:
+    * list<uint> idcs
+    * string spec
+    * list<float> concs
+
+Return:
+    None
+");
+    void setBatchTetConcs(std::vector<unsigned int> const & tidcs,
+                          std::string const & s,
+                          std::vector<double> const & cs);
+
+    %feature("autodoc", 
+"
+Adds n molecules of species with identifier string spec to a list of 
+tetrahedral elements. Each molecule is placed independently in element 
+idcs[i] with probability proportional to density[i] times its volume, or to 
+its volume alone if density is empty, and the propensities are refreshed 
+once for the whole list. With a density sampled at the barycentres this 
+sets up gradients and clusters in one call (see 
+Tetexact.distributeTetCountsByDensity).
+
+Syntax::
+    
+    distributeTetCounts(idcs, spec, n, density)
+    
+Arguments:
+    * list<uint> idcs
+    * string spec
+    * float n
+    * list<float> density
+
+Return:
+    None
+");
+    void distributeTetCounts(std::vector<unsigned int> const & tidcs,
+                             std::string const & s, double n,
+                             std::vector<double> const & density);
+
+    %feature("autodoc", 
+"
 Returns True if concentration of species with identifier string spec in tetrahedral 
 element with index idx is clamped, which means the concentration stays the 
 same regardless of reactions that consume or produce molecules of this species or 
@@ -1279,6 +1597,28 @@ Return:
     None
 ");
     void setTetReacK(unsigned int tidx, std::string const & r, double kf);
+
+    %feature("autodoc", 
+"
+Sets the macroscopic reaction constant of reaction with identifier string reac 
+in each of a list of tetrahedral elements, kfs[i] in element idcs[i]. The 
+propensities are refreshed once for the whole list.
+
+Syntax::
+    
+    setBatchTetReacKs(idcs, reac, kfs)
+    
+Arguments:
+    * list<uint> idcs
+    * string reac
+    * list<float> kfs
+
+Return:
+    None
+");
+    void setBatchTetReacKs(std::vector<unsigned int> const & tidcs,
+                           std::string const & r,
+                           std::vector<double> const & kfs);
 		
     %feature("autodoc", 
 "
@@ -1320,6 +1660,26 @@ Return:
     None
 ");
     void setTetReacActive(unsigned int tidx, std::string const & r, bool act);
+
+    %feature("autodoc", 
+"
+Activates/deactivates reaction with identifier string reac in each of a list 
+of tetrahedral elements. The propensities are refreshed once for the whole list.
+
+Syntax::
+    
+    setBatchTetReacActive(idcs, reac, act)
+    
+Arguments:
+    * list<uint> idcs
+    * string reac
+    * bool act
+
+Return:
+    None
+");
+    void setBatchTetReacActive(std::vector<unsigned int> const & tidcs,
+                               std::string const & r, bool act);
 	
 	
     %feature("autodoc", 
@@ -1358,6 +1718,28 @@ Return:
     None
 ");
     void setTetDiffD(unsigned int tidx, std::string const & d, double dk);
+
+    %feature("autodoc", 
+"
+Sets the diffusion constant of diffusion rule with identifier string diff in 
+each of a list of tetrahedral elements, dks[i] in element idcs[i]. The 
+propensities are refreshed once for the whole list.
+
+Syntax::
+    
+    setBatchTetDiffDs(idcs, diff, dks)
+    
+Arguments:
+    * list<uint> idcs
+    * string diff
+    * list<float> dks
+
+Return:
+    None
+");
+    void setBatchTetDiffDs(std::vector<unsigned int> const & tidcs,
+                           std::string const & d,
+                           std::vector<double> const & dks);
 	
     %feature("autodoc", 
 "
@@ -1402,27 +1784,48 @@ Return:
 
     %feature("autodoc", 
 "
-Returns the 'stochastic reaction constant' (or 'specific probability rate constant') 
-of reaction with identifier string reac in tetrahedral element with index idx.
+Activates/deactivates diffusion rule with identifier string diff in each of a 
+list of tetrahedral elements. The propensities are refreshed once for the whole 
+list.
 
 Syntax::
     
-    getTetReacC(idx, reac)
+    setBatchTetDiffActive(idcs, diff, act)
     
 Arguments:
-    * uint idx
-    * string reac
+    * list<uint> idcs
+    * string diff
+    * bool act
 
 Return:
-    float
+    None
 ");
-    double getTetReacC(unsigned int tidx, std::string const & r) const;
+    void setBatchTetDiffActive(std::vector<unsigned int> const & tidcs,
+                               std::string const & d, bool act);
 
     %feature("autodoc", 
 "
-Returns h_mu, the distinct number of ways in which reaction with identifier string 
-reac can occur in tetrahedral element with index idx, by computing the product of 
-its reactants.
+Returns the 'stochastic reaction constant' (or 'specific probability rate constant') 
+of reaction with identifier string reac in tetrahedral element with index idx.
+
+Syntax::
+    
+    getTetReacC(idx, reac)
+    
+Arguments:
+    * uint idx
+    * string reac
+
+Return:
+    float
+");
+    double getTetReacC(unsigned int tidx, std::string const & r) const;
+
+    %feature("autodoc", 
+"
+Returns h_mu, the distinct number of ways in which reaction with identifier string 
+reac can occur in tetrahedral element with index idx, by computing the product of 
+its reactants.
 
 Syntax::
     
@@ -2066,6 +2469,72 @@ Return:
 
     %feature("autodoc", 
 "
+Returns the number of molecules of species with identifier string spec in 
+each of a list of triangular elements, in one call.
+
+Syntax::
+    
+    getBatchTriCounts(idcs, spec)
+    
+Arguments:
+    * list<uint> idcs
+    * string spec
+
+Return:
+    list<float>
+");
+    std::vector<double> getBatchTriCounts(std::vector<unsigned int> const & tidcs,
+                                          std::string const & s) const;
+
+    %feature("autodoc", 
+"
+Sets the number of molecules of species with identifier string spec in each 
+of a list of triangular elements to the matching entry of counts. Nothing is 
+changed if an index or a count is invalid.
+
+Syntax::
+    
+    setBatchTriCounts(idcs, spec, counts)
+    
+Arguments:
+    * list<uint> idcs
+    * string spec
+    * list<float> counts
+
+Return:
+    None
+");
+    void setBatchTriCounts(std::vector<unsigned int> const & tidcs,
+                           std::string const & s,
+                           std::vector<double> const & ns);
+
+    %feature("autodoc", 
+"
+Adds n molecules of species with identifier string spec to a list of 
+triangular elements. Each molecule is placed independently in element 
+idcs[i] with probability proportional to density[i] times its area, or to 
+its area alone if density is empty, and the propensities are refreshed once 
+for the whole list.
+
+Syntax::
+    
+    distributeTriCounts(idcs, spec, n, density)
+    
+Arguments:
+    * list<uint> idcs
+    * string spec
+    * float n
+    * list<float> density
+
+Return:
+    None
+");
+    void distributeTriCounts(std::vector<unsigned int> const & tidcs,
+                             std::string const & s, double n,
+                             std::vector<double> const & density);
+
+    %feature("autodoc", 
+"
 Returns the amount (in mols) of species with identifier string spec in triangular 
 element with index idx.  
 
@@ -2181,6 +2650,28 @@ Return:
     None
 ");
     void setTriSReacK(unsigned int tidx, std::string const & r, double kf);
+
+    %feature("autodoc", 
+"
+Sets the macroscopic reaction constant of surface reaction with identifier 
+string sreac in each of a list of triangular elements, kfs[i] in element 
+idcs[i]. The propensities are refreshed once for the whole list.
+
+Syntax::
+    
+    setBatchTriSReacKs(idcs, sreac, kfs)
+    
+Arguments:
+    * list<uint> idcs
+    * string sreac
+    * list<float> kfs
+
+Return:
+    None
+");
+    void setBatchTriSReacKs(std::vector<unsigned int> const & tidcs,
+                            std::string const & r,
+                            std::vector<double> const & kfs);
 	
     %feature("autodoc", 
 "
@@ -2222,6 +2713,27 @@ Return:
     None
 ");
     void setTriSReacActive(unsigned int tidx, std::string const & r, bool act);
+
+    %feature("autodoc", 
+"
+Activates/deactivates surface reaction with identifier string sreac in each 
+of a list of triangular elements. The propensities are refreshed once for the 
+whole list.
+
+Syntax::
+    
+    setBatchTriSReacActive(idcs, sreac, act)
+    
+Arguments:
+    * list<uint> idcs
+    * string sreac
+    * bool act
+
+Return:
+    None
+");
+    void setBatchTriSReacActive(std::vector<unsigned int> const & tidcs,
+                                std::string const & r, bool act);
 	
     %feature("autodoc", 
 "
@@ -2575,6 +3087,22 @@ Returns:
     None
 ");			
     void setVertIClamp(unsigned int vidx, double i);
+
+    %feature("autodoc", 
+"
+Returns the potential (in volts) of each of a list of vertices, in one call.
+
+Syntax::
+    
+    getBatchVertVs(idcs)
+    
+Arguments:
+    * list<uint> idcs
+
+Return:
+    list<float>
+");
+    std::vector<double> getBatchVertVs(std::vector<unsigned int> const & vidcs) const;
     
 	%feature("autodoc", 
 "
@@ -2652,390 +3180,545 @@ Returns:
 );
     void setMembRes(std::string memb, double ro, double vrev);                     
                              		 
-};  
 
-////////////////////////////////////////////////////////////////////////////////
-	
-} // end namespace solver
-} // end namespace steps
+%feature("autodoc", 
+"
+Starts counting the events of reaction r in the tetrahedrons tets, as 
+they happen. Returns the index of the counter, for takeFluxCount. The 
+SSA events of Tetexact are counted; batched diffusion moves, tau-leaps 
+and the events of clusters are not.
+             
+Syntax::
+             
+    addTetsReacFlux(tets, r)
+             
+Arguments:
+    * list<unsigned int> tets
+    * string r
+             
+Return:
+    unsigned int
+");
+    unsigned int addTetsReacFlux(std::vector<unsigned int> const & tets, std::string const & r);
 
-////////////////////////////////////////////////////////////////////////////////
+%feature("autodoc", 
+"
+Starts counting the events of surface reaction sr in the triangles 
+tris. Returns the index of the counter, for takeFluxCount.
+             
+Syntax::
+             
+    addTrisSReacFlux(tris, sr)
+             
+Arguments:
+    * list<unsigned int> tris
+    * string sr
+             
+Return:
+    unsigned int
+");
+    unsigned int addTrisSReacFlux(std::vector<unsigned int> const & tris, std::string const & sr);
 
-%feature("autodoc", "1");
+%feature("autodoc", 
+"
+Starts counting the net number of molecules of species s that diffuse 
+across the triangles tris, from the first tetrahedron of each triangle 
+(see Tetmesh.getTriTetNeighb) into the second. Returns the index of the 
+counter, for takeFluxCount.
+             
+Syntax::
+             
+    addTrisDiffFlux(tris, s)
+             
+Arguments:
+    * list<unsigned int> tris
+    * string s
+             
+Return:
+    unsigned int
+");
+    unsigned int addTrisDiffFlux(std::vector<unsigned int> const & tris, std::string const & s);
 
-namespace steps
-{
-namespace wmrk4
-{
-	
-class Wmrk4 : public steps::solver::API
+%feature("autodoc", 
+"
+Returns the count of flux counter i since it was added or last taken, 
+and zeroes it.
+             
+Syntax::
+             
+    takeFluxCount(i)
+             
+Arguments:
+    unsigned int i
+             
+Return:
+    float
+");
+    double takeFluxCount(unsigned int i);
+
+%feature("autodoc", 
+"
+Registers a region of interest made of the tetrahedrons tets and the 
+triangles tris. The solver keeps the species totals of the region up to 
+date as counts change, so that reading them is cheap. Returns the index 
+of the region.
+             
+Syntax::
+             
+    addROI(tets, tris)
+             
+Arguments:
+    * list<unsigned int> tets
+    * list<unsigned int> tris
+             
+Return:
+    unsigned int
+");
+    unsigned int addROI(std::vector<unsigned int> const & tets, std::vector<unsigned int> const & tris);
+
+%feature("autodoc", 
+"
+Returns the number of molecules of species s in region of interest roi.
+             
+Syntax::
+             
+    getROICount(roi, s)
+             
+Arguments:
+    * unsigned int roi
+    * string s
+             
+Return:
+    float
+");
+    double getROICount(unsigned int roi, std::string const & s) const;
+
+%feature("autodoc", 
+"
+Returns the number of molecules of species sidx in region of interest 
+roi.
+             
+Syntax::
+             
+    getROICountIdx(roi, sidx)
+             
+Arguments:
+    * unsigned int roi
+    * unsigned int sidx
+             
+Return:
+    float
+");
+    double getROICountIdx(unsigned int roi, unsigned int sidx) const;
+
+};  
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Recorder
 {
-	
+
 public:
-	%feature("autodoc", "1");
-	Wmrk4(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r);
+    %feature("autodoc", 
+"
+Construction::
+
+    rec = steps.solver.Recorder(sim, dt)
+
+Create a recorder that samples observables of solver sim every dt 
+seconds while it runs, without returning to Python between samples. 
+Each observable adds one or more columns; a sample holds one value per 
+column. The solver must outlive the recorder.
+
+Arguments:
+    * steps.solver.API sim
+    * float dt
+");
+    Recorder(steps::solver::API * sim, double dt);
+
     %feature("autodoc", "1");
-	~Wmrk4(void);
-    
+    ~Recorder(void);
+
     %feature("autodoc", 
 "
-Returns a string of the solver's name.
+Record the number of molecules of species s in compartment c.
 
 Syntax::
-    
-    getSolverName()
-    
+
+    addCompCount(c, s)
+
 Arguments:
-    None
+    * string c
+    * string s
 
 Return:
-    string
+    None
 ");
-    virtual std::string getSolverName(void) const;
-    
+    void addCompCount(std::string const & c, std::string const & s);
+
     %feature("autodoc", 
 "
-Returns a string giving a short description of the solver.
+Record the number of molecules of species s in patch p.
 
 Syntax::
-    
-    getSolverDesc()
-    
+
+    addPatchCount(p, s)
+
 Arguments:
-    None
+    * string p
+    * string s
 
 Return:
-    string
+    None
 ");
-    virtual std::string getSolverDesc(void) const;
-    
+    void addPatchCount(std::string const & p, std::string const & s);
+
     %feature("autodoc", 
 "
-Returns a string of the solver authors names.
+Record the number of molecules of species s in each tetrahedron of 
+tets, one column per tetrahedron.
 
 Syntax::
-    
-    getSolverAuthors()
-    
+
+    addTetCounts(tets, s)
+
 Arguments:
-    None
+    * list<unsigned int> tets
+    * string s
 
 Return:
-    string
+    None
 ");
-    virtual std::string getSolverAuthors(void) const;
-    
+    void addTetCounts(std::vector<unsigned int> const & tets, std::string const & s);
+
     %feature("autodoc", 
 "
-Returns a string giving the author's email address.
+Record the number of molecules of species s in each triangle of tris, 
+one column per triangle.
 
 Syntax::
-    
-    getSolverEmail()
-    
+
+    addTriCounts(tris, s)
+
 Arguments:
-    None
+    * list<unsigned int> tris
+    * string s
 
 Return:
-    string
+    None
 ");
-    virtual std::string getSolverEmail(void) const;
+    void addTriCounts(std::vector<unsigned int> const & tris, std::string const & s);
 
     %feature("autodoc", 
 "
-Checkpoint data to a file.
-    
+Record the potential of each vertex of verts, one column per vertex.
+
 Syntax::
-    
-    checkpoint(file_name)
-    
+
+    addVertVs(verts)
+
 Arguments:
-    string file_name
-    
+    * list<unsigned int> verts
+
 Return:
     None
 ");
-    virtual void checkpoint(std::string const & file_name);
-    
+    void addVertVs(std::vector<unsigned int> const & verts);
+
     %feature("autodoc", 
 "
-Restore data from a file.
-    
+Record the extent of reaction r in compartment c.
+
 Syntax::
-    
-    restore(file_name)
-    
+
+    addCompReacExtent(c, r)
+
 Arguments:
-    string file_name
-    
+    * string c
+    * string r
+
 Return:
     None
 ");
-    virtual void restore(std::string const & file_name);
-    
+    void addCompReacExtent(std::string const & c, std::string const & r);
+
     %feature("autodoc", 
 "
-Reset the simulation to the state the solver was initialised to. 
-Typically, this resets all concentrations of all chemical species in 
-all elements (whether compartments and patches in a well-mixed solver 
-or tetrahedrons and triangles in a mesh-based solver) to zero, 
-resets the simulation time to zero and resets reaction (and diffusion) 
-rates to the default values described in the steps.model objects. 
-All reaction (and diffusion) rules are reset to active and all 
-compartment volumes and patch areas are reset to default values 
-described in steps.geom objects (for well-mixed solvers). 
-Usually, this method should be called before starting each simulation iteration.
+Record the extent of surface reaction sr in patch p.
 
 Syntax::
-    
-    reset()
-    
+
+    addPatchSReacExtent(p, sr)
+
 Arguments:
-    None
+    * string p
+    * string sr
 
 Return:
     None
 ");
-    virtual void reset(void);
-    
+    void addPatchSReacExtent(std::string const & p, std::string const & sr);
+
     %feature("autodoc", 
 "
-Advance the simulation until endtime (given in seconds) is reached. 
-The endtime must be larger or equal to the current simulation time.
+Record the events of reaction r in the tetrahedrons tets during each 
+sampling interval: a sample holds the number since the sample before, 
+counted by the solver as the events happen (see 
+API.addTetsReacFlux).
 
 Syntax::
-    
-    run(endtime)
-    
+
+    addTetsReacFlux(tets, r)
+
 Arguments:
-    float endtime
+    * list<unsigned int> tets
+    * string r
 
 Return:
     None
 ");
-    virtual void run(double endtime);
-    
+    void addTetsReacFlux(std::vector<unsigned int> const & tets, std::string const & r);
+
     %feature("autodoc", 
 "
-Returns the current simulation time in seconds.
+Record the events of surface reaction sr in the triangles tris during 
+each sampling interval.
 
 Syntax::
-    
-    getTime()
-    
+
+    addTrisSReacFlux(tris, sr)
+
 Arguments:
-    None
+    * list<unsigned int> tris
+    * string sr
 
 Return:
-    float
+    None
 ");
-    virtual double getTime(void) const;
-
+    void addTrisSReacFlux(std::vector<unsigned int> const & tris, std::string const & sr);
 
-	////////////////////////////////////////////////////////////////////////			
-		
-};
+    %feature("autodoc", 
+"
+Record the net number of molecules of species s that diffuse across the 
+triangles tris during each sampling interval, from the first 
+tetrahedron of each triangle into the second.
 
-////////////////////////////////////////////////////////////////////////////////
-	
-} // end namespace wmrk4
-} // end namespace steps
+Syntax::
 
-////////////////////////////////////////////////////////////////////////////////
+    addTrisDiffFlux(tris, s)
 
-namespace steps
-{
-namespace wmdirect
-{
+Arguments:
+    * list<unsigned int> tris
+    * string s
 
-class Wmdirect : public steps::solver::API
-{
+Return:
+    None
+");
+    void addTrisDiffFlux(std::vector<unsigned int> const & tris, std::string const & s);
 
-public:
-    %feature("autodoc", "1");
-	Wmdirect(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r);
-	%feature("autodoc", "1");
-    ~Wmdirect(void);
-     %feature("autodoc", 
+    %feature("autodoc", 
 "
-Returns a string of the solver's name.
+Record the number of molecules of species s in region of interest roi 
+(see addROI of the solver).
 
 Syntax::
-    
-    getSolverName()
-    
+
+    addROICount(roi, s)
+
 Arguments:
-    None
+    * unsigned int roi
+    * string s
 
 Return:
-    string
+    None
 ");
-    virtual std::string getSolverName(void) const;
-    
+    void addROICount(unsigned int roi, std::string const & s);
+
     %feature("autodoc", 
 "
-Returns a string giving a short description of the solver.
+Returns the number of columns of a sample.
 
 Syntax::
-    
-    getSolverDesc()
-    
+
+    getNColumns()
+
 Arguments:
     None
 
 Return:
-    string
+    unsigned int
 ");
-    virtual std::string getSolverDesc(void) const;
-    
+    unsigned int getNColumns(void) const;
+
     %feature("autodoc", 
 "
-Returns a string of the solver authors names.
+Stream the samples to file_name instead of keeping them in memory. 
+Each sample is written as getNColumns() + 1 native doubles: the time 
+followed by the columns. An empty file name goes back to keeping the 
+samples in memory.
 
 Syntax::
-    
-    getSolverAuthors()
-    
+
+    setFile(file_name)
+
 Arguments:
-    None
+    * string file_name
 
 Return:
-    string
+    None
 ");
-    virtual std::string getSolverAuthors(void) const;
-    
+    void setFile(std::string const & file_name);
+
     %feature("autodoc", 
 "
-Returns a string giving the author's email address.
+Stream the samples to the HDF5 file file_name instead of keeping them 
+in memory. The file holds the datasets /time, /data (samples x columns) 
+and /columns (a label per column), the species, compartment and patch 
+names under /model and, for a Tetmesh geometry, /mesh/vertices, 
+/mesh/tets and /mesh/tris. The samples are written chunk_rows at a time 
+by a background thread, compressed at deflate level (0 to 9). No 
+observables can be added afterwards. Only available when STEPS is built 
+with HDF5.
 
 Syntax::
-    
-    getSolverEmail()
-    
+
+    setHDF5File(file_name, chunk_rows = 1024, level = 4)
+
 Arguments:
-    None
+    * string file_name
+    * uint chunk_rows
+    * uint level
 
 Return:
-    string
+    None
 ");
-    virtual std::string getSolverEmail(void) const;
+    void setHDF5File(std::string const & file_name, unsigned int chunk_rows = 1024,
+                     unsigned int level = 4);
 
     %feature("autodoc", 
-    "
-    Checkpoint data to a file.
-    
-    Syntax::
-    
-    checkpoint(file_name)
-    
-    Arguments:
-    string file_name
-    
-    Return:
+"
+Close the binary or HDF5 file, writing out any buffered samples, and go 
+back to keeping the samples in memory.
+
+Syntax::
+
+    closeFile()
+
+Arguments:
     None
-    ");
-    virtual void checkpoint(std::string const & file_name);
-    
+
+Return:
+    None
+");
+    void closeFile(void);
+
     %feature("autodoc", 
 "
-Restore data from a file.
-    
+Run the solver to endtime, taking the samples that fall in the 
+interval. The first call also samples the current state.
+
 Syntax::
-    
-    restore(file_name)
-    
+
+    run(endtime)
+
 Arguments:
-    string file_name
-    
+    * float endtime
+
 Return:
     None
 ");
-    virtual void restore(std::string const & file_name);
-    
+    void run(double endtime);
+
     %feature("autodoc", 
 "
-Reset the simulation to the state the solver was initialised to. 
-Typically, this resets all concentrations of all chemical species in 
-all elements (whether compartments and patches in a well-mixed solver 
-or tetrahedrons and triangles in a mesh-based solver) to zero, 
-resets the simulation time to zero and resets reaction (and diffusion) 
-rates to the default values described in the steps.model objects. 
-All reaction (and diffusion) rules are reset to active and all 
-compartment volumes and patch areas are reset to default values 
-described in steps.geom objects (for well-mixed solvers). 
-Usually, this method should be called before starting each simulation iteration.
+Returns the number of samples taken.
 
 Syntax::
-    
-    reset()
-    
+
+    getNSamples()
+
 Arguments:
     None
 
 Return:
-    None
+    unsigned int
 ");
-    virtual void reset(void);
-    
+    unsigned int getNSamples(void) const;
+
     %feature("autodoc", 
 "
-Advance the simulation until endtime (given in seconds) is reached. 
-The endtime must be larger or equal to the current simulation time.
+Returns the time of each sample kept in memory.
 
 Syntax::
-    
-    run(endtime)
-    
+
+    getTimes()
+
 Arguments:
-    float endtime
+    None
 
 Return:
-    None
+    list<float>
 ");
-    virtual void run(double endtime);
-    
+    std::vector<double> getTimes(void) const;
+
     %feature("autodoc", 
 "
-Returns the current simulation time in seconds.
+Returns the samples kept in memory as a flat list in sample, column 
+order: element i * getNColumns() + j is column j of sample i.
 
 Syntax::
-    
-    getTime()
-    
+
+    getData()
+
 Arguments:
     None
 
 Return:
-    float
+    list<float>
 ");
-    virtual double getTime(void) const;
+    std::vector<double> getData(void) const;
+
+    %feature("autodoc", 
+"
+Drops the samples kept in memory. The sampling times carry on.
 
+Syntax::
+
+    clear()
+
+Arguments:
+    None
+
+Return:
+    None
+");
+    void clear(void);
 
-	
-	////////////////////////////////////////////////////////////////////////			
-	
 };
-		
-////////////////////////////////////////////////////////////////////////////////
 
-} // end namespace wmdirect
+////////////////////////////////////////////////////////////////////////////////
+	
+} // end namespace solver
 } // end namespace steps
 
 ////////////////////////////////////////////////////////////////////////////////
 
+%feature("autodoc", "1");
+
 namespace steps
 {
-namespace tetexact
+namespace wmrk4
 {
-
-class Tetexact : public steps::solver::API
-{	
-
+	
+class Wmrk4 : public steps::solver::API
+{
+	
 public:
+	%feature("autodoc", "1");
+	Wmrk4(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r);
     %feature("autodoc", "1");
-    Tetexact(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r, bool calcMembPot = false);
-    %feature("autodoc", "1");
-    ~Tetexact(void);
+	~Wmrk4(void);
+    
     %feature("autodoc", 
 "
 Returns a string of the solver's name.
@@ -3189,47 +3872,5745 @@ Return:
     float
 ");
     virtual double getTime(void) const;
-
-%feature("autodoc", 
+    
+    %feature("autodoc", 
+"
+Switch between the fixed step 4th order Runge-Kutta method (the 
+default, step size set with setRk4DT) and an adaptive step 
+Dormand-Prince 5(4) method controlled by the tolerances set with 
+setTolerances. In adaptive mode a step size set with setRk4DT is 
+only used as the first trial step.
+
+Syntax::
+    
+    setAdaptive(adapt)
+    
+Arguments:
+    bool adapt
+
+Return:
+    None
+");
+    void setAdaptive(bool adapt);
+    
+    %feature("autodoc", 
+"
+Returns True if the solver uses the adaptive step method.
+
+Syntax::
+    
+    getAdaptive()
+    
+Arguments:
+    None
+
+Return:
+    bool
+");
+    bool getAdaptive(void) const;
+    
+    %feature("autodoc", 
+"
+Switch to the implicit BDF method of CVODE with Newton iteration, a 
+dense direct linear solver and the analytic Jacobian of the reaction 
+network. Intended for stiff models, where it allows steps many orders 
+of magnitude larger than the explicit methods. Takes precedence over 
+the adaptive mode and uses the tolerances set with setTolerances.
+Species fixed by a linear conservation law of the reaction network 
+(for instance the free and bound forms of an enzyme) are not 
+integrated but computed from the conserved total.
+
+Syntax::
+    
+    setStiff(stiff)
+    
+Arguments:
+    bool stiff
+
+Return:
+    None
+");
+    void setStiff(bool stiff);
+    
+    %feature("autodoc", 
+"
+Returns True if the solver uses the stiff (BDF) method.
+
+Syntax::
+    
+    getStiff()
+    
+Arguments:
+    None
+
+Return:
+    bool
+");
+    bool getStiff(void) const;
+    
+    %feature("autodoc", 
+"
+Set the absolute tolerance (in molecules) and the relative tolerance 
+of the adaptive step and stiff methods. Defaults are 1e-3 and 1e-4.
+
+Syntax::
+    
+    setTolerances(atol, rtol)
+    
+Arguments:
+    float atol
+    float rtol
+
+Return:
+    None
+");
+    void setTolerances(double atol, double rtol);
+    
+    %feature("autodoc", 
+"
+Returns the number of derivative evaluations since the solver was 
+created.
+
+Syntax::
+    
+    getNDerivEvals()
+    
+Arguments:
+    None
+
+Return:
+    float
+");
+    double getNDerivEvals(void) const;
+    
+    %feature("autodoc", 
+"
+Set the pools to the steady state reached from the current state, 
+without advancing the simulation time. Newton's method with the 
+analytic Jacobian is tried first and pseudo-transient continuation 
+(implicit Euler steps that grow as the rates fall) if that fails. 
+Converges within the tolerances set with setTolerances; clamped 
+species and conserved totals keep their values. Raises an exception 
+and leaves the state unchanged if no steady state is found.
+
+Syntax::
+    
+    steadyState()
+    
+Arguments:
+    None
+
+Return:
+    None
+");
+    void steadyState(void);
+    
+    %feature("autodoc", 
+"
+Integrate the sensitivities of all species counts to the rate constant 
+of reaction r in compartment c (the derivatives of the counts with 
+respect to that constant) along with the state, starting from zero at 
+the current state. All three methods integrate them, with the same 
+steps as the state, and the adaptive and stiff methods include them in 
+their error test. One such run replaces the two extra simulations per 
+parameter of a finite difference estimate. steadyState sets them to 
+those of the steady state. Setting the count of a species zeroes its 
+sensitivities; reset and restore zero all of them.
+
+Returns the index of the parameter for getCompSensitivity and 
+getPatchSensitivity.
+
+Syntax::
+    
+    addCompReacSensitivity(comp, reac)
+    
+Arguments:
+    * string comp
+    * string reac
+
+Return:
+    int
+");
+    unsigned int addCompReacSensitivity(std::string const & c, std::string const & r);
+    
+    %feature("autodoc", 
+"
+Integrate the sensitivities of all species counts to the rate constant 
+of surface reaction sr in patch p (see addCompReacSensitivity).
+
+Syntax::
+    
+    addPatchSReacSensitivity(patch, sreac)
+    
+Arguments:
+    * string patch
+    * string sreac
+
+Return:
+    int
+");
+    unsigned int addPatchSReacSensitivity(std::string const & p, std::string const & sr);
+    
+    %feature("autodoc", 
+"
+Stop integrating sensitivities and forget their parameters.
+
+Syntax::
+    
+    clearSensitivities()
+    
+Arguments:
+    None
+
+Return:
+    None
+");
+    void clearSensitivities(void);
+    
+    %feature("autodoc", 
+"
+Returns the number of parameters whose sensitivities are integrated.
+
+Syntax::
+    
+    countSensitivities()
+    
+Arguments:
+    None
+
+Return:
+    int
+");
+    unsigned int countSensitivities(void) const;
+    
+    %feature("autodoc", 
+"
+Returns the derivative of the count of species s in compartment c 
+with respect to the rate constant of sensitivity parameter param, in 
+molecules per unit of that constant (s.i.).
+
+Syntax::
+    
+    getCompSensitivity(comp, spec, param)
+    
+Arguments:
+    * string comp
+    * string spec
+    * int param
+
+Return:
+    float
+");
+    double getCompSensitivity(std::string const & c, std::string const & s, unsigned int param) const;
+    
+    %feature("autodoc", 
+"
+Returns the derivative of the count of species s in patch p with 
+respect to the rate constant of sensitivity parameter param (see 
+getCompSensitivity).
+
+Syntax::
+    
+    getPatchSensitivity(patch, spec, param)
+    
+Arguments:
+    * string patch
+    * string spec
+    * int param
+
+Return:
+    float
+");
+    double getPatchSensitivity(std::string const & p, std::string const & s, unsigned int param) const;
+    
+    %feature("autodoc", 
+"
+Integrate nsets copies of the network at once, each with its own 
+species counts and rate constants, for deterministic parameter scans 
+of small models. The sets are laid out set by set within each species, 
+so that one pass over the network computes the derivatives of all of 
+them. Set 0 is the solver's own state, which every other method reads 
+and sets; the others start as copies of it, and are set to copies of 
+it again by reset. A batch of more than one set needs the fixed step 
+method and no sensitivities. A size of 1 turns batching off.
+
+Syntax::
+    
+    setBatchSize(nsets)
+    
+Arguments:
+    int nsets
+
+Return:
+    None
+");
+    void setBatchSize(unsigned int nsets);
+    
+    %feature("autodoc", 
+"
+Returns the number of sets integrated at once.
+
+Syntax::
+    
+    getBatchSize()
+    
+Arguments:
+    None
+
+Return:
+    int
+");
+    unsigned int getBatchSize(void) const;
+    
+    %feature("autodoc", 
+"
+Returns the count of species s in compartment c in batch set b.
+
+Syntax::
+    
+    getBatchCompCount(b, comp, spec)
+    
+Arguments:
+    * int b
+    * string comp
+    * string spec
+
+Return:
+    float
+");
+    double getBatchCompCount(unsigned int b, std::string const & c, std::string const & s) const;
+    
+    %feature("autodoc", 
+"
+Sets the count of species s in compartment c in batch set b.
+
+Syntax::
+    
+    setBatchCompCount(b, comp, spec, n)
+    
+Arguments:
+    * int b
+    * string comp
+    * string spec
+    * float n
+
+Return:
+    None
+");
+    void setBatchCompCount(unsigned int b, std::string const & c, std::string const & s, double n);
+    
+    %feature("autodoc", 
+"
+Returns the count of species s in patch p in batch set b.
+
+Syntax::
+    
+    getBatchPatchCount(b, patch, spec)
+    
+Arguments:
+    * int b
+    * string patch
+    * string spec
+
+Return:
+    float
+");
+    double getBatchPatchCount(unsigned int b, std::string const & p, std::string const & s) const;
+    
+    %feature("autodoc", 
+"
+Sets the count of species s in patch p in batch set b.
+
+Syntax::
+    
+    setBatchPatchCount(b, patch, spec, n)
+    
+Arguments:
+    * int b
+    * string patch
+    * string spec
+    * float n
+
+Return:
+    None
+");
+    void setBatchPatchCount(unsigned int b, std::string const & p, std::string const & s, double n);
+    
+    %feature("autodoc", 
+"
+Returns the rate constant of reaction r in compartment c in batch set b.
+
+Syntax::
+    
+    getBatchCompReacK(b, comp, reac)
+    
+Arguments:
+    * int b
+    * string comp
+    * string reac
+
+Return:
+    float
+");
+    double getBatchCompReacK(unsigned int b, std::string const & c, std::string const & r) const;
+    
+    %feature("autodoc", 
+"
+Sets the rate constant of reaction r in compartment c in batch set b.
+
+Syntax::
+    
+    setBatchCompReacK(b, comp, reac, kf)
+    
+Arguments:
+    * int b
+    * string comp
+    * string reac
+    * float kf
+
+Return:
+    None
+");
+    void setBatchCompReacK(unsigned int b, std::string const & c, std::string const & r, double kf);
+    
+    %feature("autodoc", 
+"
+Returns the rate constant of surface reaction sr in patch p in batch 
+set b.
+
+Syntax::
+    
+    getBatchPatchSReacK(b, patch, sreac)
+    
+Arguments:
+    * int b
+    * string patch
+    * string sreac
+
+Return:
+    float
+");
+    double getBatchPatchSReacK(unsigned int b, std::string const & p, std::string const & sr) const;
+    
+    %feature("autodoc", 
+"
+Sets the rate constant of surface reaction sr in patch p in batch 
+set b.
+
+Syntax::
+    
+    setBatchPatchSReacK(b, patch, sreac, kf)
+    
+Arguments:
+    * int b
+    * string patch
+    * string sreac
+    * float kf
+
+Return:
+    None
+");
+    void setBatchPatchSReacK(unsigned int b, std::string const & p, std::string const & sr, double kf);
+
+
+	////////////////////////////////////////////////////////////////////////			
+		
+};
+
+////////////////////////////////////////////////////////////////////////////////
+	
+} // end namespace wmrk4
+} // end namespace steps
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace steps
+{
+namespace wmdirect
+{
+
+class Wmdirect : public steps::solver::API
+{
+
+public:
+    %feature("autodoc", "1");
+	Wmdirect(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+             std::string const & scheduler = "auto");
+	%feature("autodoc", "1");
+    ~Wmdirect(void);
+    %feature("autodoc", 
+"
+Returns the name of the SSA scheduler used by the solver 
+(\"direct\", \"sdm\", \"cr\", \"nrm\" or \"pdm\"). With the default 
+scheduler \"auto\" this is \"sdm\" (sorting direct method) for fewer 
+than 128 reactions and surface reactions, \"direct\" otherwise.
+
+Syntax::
+    
+    getScheduler()
+    
+Arguments:
+    None
+
+Return:
+    string
+");
+    std::string getScheduler(void) const;
+    %feature("autodoc", 
+"
+Returns the number of internal scheduler nodes (partial propensity sums) 
+recomputed after the last reaction event. Schedulers that do not keep 
+track return 0.
+
+Syntax::
+    
+    getSchedNodesTouched()
+    
+Arguments:
+    None
+
+Return:
+    int
+");
+    unsigned int getSchedNodesTouched(void) const;
+    %feature("autodoc", 
+"
+Returns the total number of internal scheduler nodes recomputed since 
+the solver was created. Schedulers that do not keep track return 0.
+
+Syntax::
+    
+    getSchedNodesTouchedTotal()
+    
+Arguments:
+    None
+
+Return:
+    float
+");
+    double getSchedNodesTouchedTotal(void) const;
+    %feature("autodoc", 
+"
+Switch run() between exact SSA (the default) and tau-leaping with the 
+step selection of Cao, Gillespie and Petzold (2006). Reactions close 
+to exhausting a reactant are executed one event at a time, and when a 
+leap would be too short to pay off the solver takes exact SSA steps 
+instead. Switching it on switches R-leaping off.
+
+Syntax::
+    
+    setTauLeaping(leap)
+    
+Arguments:
+    bool leap
+
+Return:
+    None
+");
+    void setTauLeaping(bool leap);
+    %feature("autodoc", 
+"
+Returns True if run() uses tau-leaping.
+
+Syntax::
+    
+    getTauLeaping()
+    
+Arguments:
+    None
+
+Return:
+    bool
+");
+    bool getTauLeaping(void) const;
+    %feature("autodoc", 
+"
+Switch run() between exact SSA (the default) and R-leaping (Auger, 
+Chatelain and Koumoutsakos 2006). Each leap executes a number of 
+events chosen with the error control of tau-leaping, split over the 
+reactions in proportion to their propensities, in a gamma distributed 
+time. Switching it on switches tau-leaping off.
+
+Syntax::
+    
+    setRLeaping(leap)
+    
+Arguments:
+    bool leap
+
+Return:
+    None
+");
+    void setRLeaping(bool leap);
+    %feature("autodoc", 
+"
+Returns True if run() uses R-leaping.
+
+Syntax::
+    
+    getRLeaping()
+    
+Arguments:
+    None
+
+Return:
+    bool
+");
+    bool getRLeaping(void) const;
+    %feature("autodoc", 
+"
+Set the error control parameter epsilon of both leaping modes, the 
+largest relative change allowed in the propensities during a leap. 
+Must lie in (0, 1); the default is 0.03.
+
+Syntax::
+    
+    setTauLeapEpsilon(eps)
+    
+Arguments:
+    float eps
+
+Return:
+    None
+");
+    void setTauLeapEpsilon(double eps);
+    %feature("autodoc", 
+"
+Returns the error control parameter epsilon of the leaping modes.
+
+Syntax::
+    
+    getTauLeapEpsilon()
+    
+Arguments:
+    None
+
+Return:
+    float
+");
+    double getTauLeapEpsilon(void) const;
+    %feature("autodoc", 
+"
+Set the number of firings below which a reaction is critical, i.e. 
+could exhaust one of its reactants, and is executed as single events 
+in the leaping modes. The default is 10.
+
+Syntax::
+    
+    setTauLeapNCrit(ncrit)
+    
+Arguments:
+    uint ncrit
+
+Return:
+    None
+");
+    void setTauLeapNCrit(uint ncrit);
+    %feature("autodoc", 
+"
+Returns the number of firings below which a reaction is critical.
+
+Syntax::
+    
+    getTauLeapNCrit()
+    
+Arguments:
+    None
+
+Return:
+    uint
+");
+    uint getTauLeapNCrit(void) const;
+     %feature("autodoc", 
+"
+Returns a string of the solver's name.
+
+Syntax::
+    
+    getSolverName()
+    
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverName(void) const;
+    
+    %feature("autodoc", 
+"
+Returns a string giving a short description of the solver.
+
+Syntax::
+    
+    getSolverDesc()
+    
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverDesc(void) const;
+    
+    %feature("autodoc", 
+"
+Returns a string of the solver authors names.
+
+Syntax::
+    
+    getSolverAuthors()
+    
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverAuthors(void) const;
+    
+    %feature("autodoc", 
+"
+Returns a string giving the author's email address.
+
+Syntax::
+    
+    getSolverEmail()
+    
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverEmail(void) const;
+
+    %feature("autodoc", 
+    "
+    Checkpoint data to a file.
+    
+    Syntax::
+    
+    checkpoint(file_name)
+    
+    Arguments:
+    string file_name
+    
+    Return:
+    None
+    ");
+    virtual void checkpoint(std::string const & file_name);
+    
+    %feature("autodoc", 
+"
+Restore data from a file.
+    
+Syntax::
+    
+    restore(file_name)
+    
+Arguments:
+    string file_name
+    
+Return:
+    None
+");
+    virtual void restore(std::string const & file_name);
+    
+    %feature("autodoc", 
+"
+Reset the simulation to the state the solver was initialised to. 
+Typically, this resets all concentrations of all chemical species in 
+all elements (whether compartments and patches in a well-mixed solver 
+or tetrahedrons and triangles in a mesh-based solver) to zero, 
+resets the simulation time to zero and resets reaction (and diffusion) 
+rates to the default values described in the steps.model objects. 
+All reaction (and diffusion) rules are reset to active and all 
+compartment volumes and patch areas are reset to default values 
+described in steps.geom objects (for well-mixed solvers). 
+Usually, this method should be called before starting each simulation iteration.
+
+Syntax::
+    
+    reset()
+    
+Arguments:
+    None
+
+Return:
+    None
+");
+    virtual void reset(void);
+    
+    %feature("autodoc", 
+"
+Advance the simulation until endtime (given in seconds) is reached. 
+The endtime must be larger or equal to the current simulation time.
+
+Syntax::
+    
+    run(endtime)
+    
+Arguments:
+    float endtime
+
+Return:
+    None
+");
+    virtual void run(double endtime);
+    
+    %feature("autodoc", 
+"
+Returns the current simulation time in seconds.
+
+Syntax::
+    
+    getTime()
+    
+Arguments:
+    None
+
+Return:
+    float
+");
+    virtual double getTime(void) const;
+
+
+	
+	////////////////////////////////////////////////////////////////////////			
+	
+};
+		
+////////////////////////////////////////////////////////////////////////////////
+
+class WmEnsemble
+{
+
+public:
+    %feature("autodoc", 
+"
+Construction::
+
+    ens = steps.solver.WmEnsemble(model, geom, rng, nreps)
+
+Create an ensemble of nreps independent replicates of a well-mixed 
+model, simulated with the direct SSA in lockstep. The structure of 
+the model is shared; the counts, reaction constants and clocks are 
+kept per replicate in arrays over the replicates, so that the 
+propensities of all replicates are computed together and the random 
+numbers of each pass are drawn in one batch.
+
+Arguments:
+    * steps.model.Model model
+    * steps.geom.Geom geom
+    * steps.rng.RNG rng
+    * unsigned int nreps
+");
+    WmEnsemble(steps::model::Model * m, steps::wm::Geom * g,
+               steps::rng::RNG * r, unsigned int nreps);
+    %feature("autodoc", "1");
+    ~WmEnsemble(void);
+
+    %feature("autodoc", 
+"
+Returns the number of replicates.
+
+Syntax::
+
+    getNReps()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getNReps(void) const;
+
+    %feature("autodoc", 
+"
+Set all counts to zero, all reaction constants to their values in 
+the model and the time to zero.
+
+Syntax::
+
+    reset()
+
+Arguments:
+    None
+
+Return:
+    None
+");
+    void reset(void);
+
+    %feature("autodoc", 
+"
+Advance all replicates to endtime. Each replicate has its own clock 
+during the run; all stop at endtime.
+
+Syntax::
+
+    run(endtime)
+
+Arguments:
+    float endtime
+
+Return:
+    None
+");
+    void run(double endtime);
+
+    %feature("autodoc", 
+"
+Advance all replicates through the time points tpnts and return the 
+recorded values as a flat list in replicate, time point, record 
+order: element (i * len(tpnts) + j) * getNRecords() + k is record k 
+at tpnts[j] for replicate i. The time points must be increasing and 
+not before the current time.
+
+Syntax::
+
+    runRecord(tpnts)
+
+Arguments:
+    list<float> tpnts
+
+Return:
+    list<float>
+");
+    std::vector<double> runRecord(std::vector<double> const & tpnts);
+
+    %feature("autodoc", 
+"
+Returns the current time, shared by all replicates.
+
+Syntax::
+
+    getTime()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    double getTime(void) const;
+
+    %feature("autodoc", 
+"
+Advance the replicates in n contiguous blocks on n threads (at most 
+one per replicate). Each block draws from its own Philox generator, 
+seeded from the ensemble's RNG when this is called. Default 1.
+
+Syntax::
+
+    setNThreads(n)
+
+Arguments:
+    unsigned int n
+
+Return:
+    None
+");
+    void setNThreads(unsigned int n);
+
+    %feature("autodoc", 
+"
+Returns the number of threads the replicates are advanced on.
+
+Syntax::
+
+    getNThreads()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getNThreads(void) const;
+
+    %feature("autodoc", 
+"
+Returns the number of events replicate rep executed since the last reset.
+
+Syntax::
+
+    getRepNSteps(rep)
+
+Arguments:
+    unsigned int rep
+
+Return:
+    float
+");
+    double getRepNSteps(unsigned int rep) const;
+
+    %feature("autodoc", 
+"
+Record the number of molecules of species s in compartment c at 
+each time point of runRecord().
+
+Syntax::
+
+    addCompCountRecord(c, s)
+
+Arguments:
+    * string c
+    * string s
+
+Return:
+    None
+");
+    void addCompCountRecord(std::string const & c, std::string const & s);
+
+    %feature("autodoc", 
+"
+Record the number of molecules of species s in patch p at 
+each time point of runRecord().
+
+Syntax::
+
+    addPatchCountRecord(p, s)
+
+Arguments:
+    * string p
+    * string s
+
+Return:
+    None
+");
+    void addPatchCountRecord(std::string const & p, std::string const & s);
+
+    %feature("autodoc", 
+"
+Returns the number of records.
+
+Syntax::
+
+    getNRecords()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getNRecords(void) const;
+
+    %feature("autodoc", 
+"
+Set the number of molecules of species s in compartment c in all replicates.
+
+Syntax::
+
+    setCompCount(c, s, n)
+
+Arguments:
+    * string c
+    * string s
+    * float n
+
+Return:
+    None
+");
+    void setCompCount(std::string const & c, std::string const & s, double n);
+
+    %feature("autodoc", 
+"
+Set the number of molecules of species s in compartment c in replicate rep.
+
+Syntax::
+
+    setRepCompCount(rep, c, s, n)
+
+Arguments:
+    * unsigned int rep
+    * string c
+    * string s
+    * float n
+
+Return:
+    None
+");
+    void setRepCompCount(unsigned int rep, std::string const & c, std::string const & s, double n);
+
+    %feature("autodoc", 
+"
+Returns the number of molecules of species s in compartment c in replicate rep.
+
+Syntax::
+
+    getRepCompCount(rep, c, s)
+
+Arguments:
+    * unsigned int rep
+    * string c
+    * string s
+
+Return:
+    float
+");
+    double getRepCompCount(unsigned int rep, std::string const & c, std::string const & s) const;
+
+    %feature("autodoc", 
+"
+Set the number of molecules of species s in patch p in all replicates.
+
+Syntax::
+
+    setPatchCount(p, s, n)
+
+Arguments:
+    * string p
+    * string s
+    * float n
+
+Return:
+    None
+");
+    void setPatchCount(std::string const & p, std::string const & s, double n);
+
+    %feature("autodoc", 
+"
+Set the number of molecules of species s in patch p in replicate rep.
+
+Syntax::
+
+    setRepPatchCount(rep, p, s, n)
+
+Arguments:
+    * unsigned int rep
+    * string p
+    * string s
+    * float n
+
+Return:
+    None
+");
+    void setRepPatchCount(unsigned int rep, std::string const & p, std::string const & s, double n);
+
+    %feature("autodoc", 
+"
+Returns the number of molecules of species s in patch p in replicate rep.
+
+Syntax::
+
+    getRepPatchCount(rep, p, s)
+
+Arguments:
+    * unsigned int rep
+    * string p
+    * string s
+
+Return:
+    float
+");
+    double getRepPatchCount(unsigned int rep, std::string const & p, std::string const & s) const;
+
+    %feature("autodoc", 
+"
+Clamp (True) or unclamp (False) species s in compartment c in all replicates.
+
+Syntax::
+
+    setCompClamped(c, s, b)
+
+Arguments:
+    * string c
+    * string s
+    * bool b
+
+Return:
+    None
+");
+    void setCompClamped(std::string const & c, std::string const & s, bool b);
+
+    %feature("autodoc", 
+"
+Clamp (True) or unclamp (False) species s in patch p in all replicates.
+
+Syntax::
+
+    setPatchClamped(p, s, b)
+
+Arguments:
+    * string p
+    * string s
+    * bool b
+
+Return:
+    None
+");
+    void setPatchClamped(std::string const & p, std::string const & s, bool b);
+
+    %feature("autodoc", 
+"
+Set the rate constant of reaction r in compartment c in all replicates.
+
+Syntax::
+
+    setCompReacK(c, r, kf)
+
+Arguments:
+    * string c
+    * string r
+    * float kf
+
+Return:
+    None
+");
+    void setCompReacK(std::string const & c, std::string const & r, double kf);
+
+    %feature("autodoc", 
+"
+Set the rate constant of reaction r in compartment c in replicate rep.
+
+Syntax::
+
+    setRepCompReacK(rep, c, r, kf)
+
+Arguments:
+    * unsigned int rep
+    * string c
+    * string r
+    * float kf
+
+Return:
+    None
+");
+    void setRepCompReacK(unsigned int rep, std::string const & c, std::string const & r, double kf);
+
+    %feature("autodoc", 
+"
+Set the rate constant of surface reaction r in patch p in all replicates.
+
+Syntax::
+
+    setPatchSReacK(p, r, kf)
+
+Arguments:
+    * string p
+    * string r
+    * float kf
+
+Return:
+    None
+");
+    void setPatchSReacK(std::string const & p, std::string const & r, double kf);
+
+    %feature("autodoc", 
+"
+Set the rate constant of surface reaction r in patch p in replicate rep.
+
+Syntax::
+
+    setRepPatchSReacK(rep, p, r, kf)
+
+Arguments:
+    * unsigned int rep
+    * string p
+    * string r
+    * float kf
+
+Return:
+    None
+");
+    void setRepPatchSReacK(unsigned int rep, std::string const & p, std::string const & r, double kf);
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace wmdirect
+} // end namespace steps
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace steps
+{
+namespace tetexact
+{
+
+class Tetexact : public steps::solver::API
+{	
+
+public:
+    %feature("autodoc", "1");
+    Tetexact(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r, bool calcMembPot = false,
+             std::string const & scheduler = "cr", bool reorder = false,
+             unsigned int setupthreads = 1, std::string const & efieldbackend = "cpu",
+             bool lazydeps = false, std::string const & restart = "");
+    %feature("autodoc", "1");
+    ~Tetexact(void);
+    %feature("autodoc", 
+"
+Returns a string of the solver's name.
+
+Syntax::
+    
+    getSolverName()
+    
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverName(void) const;
+    
+    %feature("autodoc", 
+"
+Returns a string giving a short description of the solver.
+
+Syntax::
+    
+    getSolverDesc()
+    
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverDesc(void) const;
+    
+    %feature("autodoc", 
+"
+Returns a string of the solver authors names.
+
+Syntax::
+    
+    getSolverAuthors()
+    
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverAuthors(void) const;
+    
+    %feature("autodoc", 
+"
+Returns a string giving the author's email address.
+
+Syntax::
+    
+    getSolverEmail()
+    
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverEmail(void) const;
+
+    %feature("autodoc", 
+"
+Checkpoint data to a file. The file holds the state of the event 
+scheduler and the next event if one was already drawn, so a solver 
+restored from it and given the same random numbers continues on the 
+same trajectory as this one.
+    
+Syntax::
+    
+    checkpoint(file_name)
+    
+Arguments:
+    string file_name
+    
+Return:
+    None
+");
+    virtual void checkpoint(std::string const & file_name);
+    
+    %feature("autodoc", 
+"
+Restore data from a file. Files written before the scheduler state was 
+stored (and by a solver with another scheduler) are restored with the 
+scheduler rebuilt from the molecule counts: the simulation continues 
+correctly, but not on the trajectory the writer would have taken.
+    
+Syntax::
+    
+    restore(file_name)
+    
+Arguments:
+    string file_name
+    
+Return:
+    None
+");
+    virtual void restore(std::string const & file_name);
+    
+    %feature("autodoc", 
+"
+Write a delta checkpoint: only the molecule counts and reaction data 
+that changed since the last checkpoint, delta checkpoint or restore of 
+this solver, plus the small global state. Needs a checkpoint or restore 
+to follow on from. The scheduler state is not written, so restoreDelta 
+rebuilds it.
+    
+Syntax::
+    
+    checkpointDelta(file_name)
+    
+Arguments:
+    string file_name
+    
+Return:
+    None
+");
+    void checkpointDelta(std::string const & file_name);
+    
+    %feature("autodoc", 
+"
+Restore a delta checkpoint on top of the checkpoint or delta it follows 
+on from, which must be the last one restored into (or written by) this 
+solver. A chain is restored with restore() of the full checkpoint and 
+restoreDelta() of each delta in order.
+    
+Syntax::
+    
+    restoreDelta(file_name)
+    
+Arguments:
+    string file_name
+    
+Return:
+    None
+");
+    void restoreDelta(std::string const & file_name);
+    
+    %feature("autodoc", 
+"
+Capture a checkpoint (or a delta checkpoint, if delta is True) in 
+memory and write it to file_name on a background thread while the 
+simulation continues. Only one write is in flight at a time; this and 
+the other checkpoint and restore methods first wait for the previous 
+one.
+    
+Syntax::
+    
+    checkpointAsync(file_name, delta = False)
+    
+Arguments:
+    * string file_name
+    * bool delta (default = False)
+    
+Return:
+    None
+");
+    void checkpointAsync(std::string const & file_name, bool delta = false);
+    
+    %feature("autodoc", 
+"
+Checkpoint to file_name, followed by the structure a restart needs in 
+place of set up: the update list of each kinetic process and the 
+membrane potential vertex ordering and coupling constants. A solver 
+created with restart = file_name reads these instead of computing them, 
+then restores the checkpoint, scheduler state included, so that given 
+the same random numbers it continues on the trajectory of the writer. 
+With setWmVolScheduler or setElementScheduler, which rebuild the 
+scheduler, restore the file again after switching them on. restore() 
+reads the file as an ordinary checkpoint.
+    
+Syntax::
+    
+    checkpointRestart(file_name)
+    
+Arguments:
+    string file_name
+    
+Return:
+    None
+");
+    void checkpointRestart(std::string const & file_name);
+    
+    %feature("autodoc", 
+"
+Checkpoint to an index file file_name and nshards shard files 
+file_name.0, file_name.1, ... The tetrahedrons and then the triangles, 
+in mesh index order, are split into nshards ranges of about equal 
+length; each shard holds the state of its elements and their kinetic 
+processes and is written on a thread of its own. The index holds the 
+rest of the state and the range of each shard, so the files can be 
+restored whatever nshards was. The scheduler state is not written, so 
+restoring rebuilds it.
+    
+Syntax::
+    
+    checkpointShards(file_name, nshards)
+    
+Arguments:
+    * string file_name
+    * uint nshards
+    
+Return:
+    None
+");
+    void checkpointShards(std::string const & file_name, uint nshards);
+    
+    %feature("autodoc", 
+"
+Restore from the files written by checkpointShards, reading and 
+restoring the shards on nthreads threads. restore() of an index file 
+does the same on one thread.
+    
+Syntax::
+    
+    restoreShards(file_name, nthreads = 1)
+    
+Arguments:
+    * string file_name
+    * uint nthreads (default = 1)
+    
+Return:
+    None
+");
+    void restoreShards(std::string const & file_name, uint nthreads = 1);
+    
+    %feature("autodoc", 
+"
+Returns whether the last checkpointAsync write has finished.
+    
+Syntax::
+    
+    checkpointDone()
+    
+Arguments:
+    None
+    
+Return:
+    bool
+");
+    bool checkpointDone(void);
+    
+    %feature("autodoc", 
+"
+Wait for the last checkpointAsync write to finish, raising an error if 
+it failed.
+    
+Syntax::
+    
+    waitCheckpoint()
+    
+Arguments:
+    None
+    
+Return:
+    None
+");
+    void waitCheckpoint(void);
+    
+    %feature("autodoc", 
+"
+Return a new solver in the same state as this one (counts, clamped and 
+active flags, rate constants, time and solver options), sharing its 
+model and geometry. The element geometry and dependency lists are 
+copied rather than computed from the mesh again, which makes this much 
+faster than creating a new solver from scratch.
+The event scheduler is copied too, so a clone whose generator is in 
+the same state as that of this solver follows the same trajectory.
+    
+Syntax::
+    
+    clone(rng = None)
+    
+Arguments:
+    steps.rng.RNG rng (random number generator of the clone; if None, 
+    the generator of this solver is shared)
+    
+Return:
+    steps.solver.Tetexact
+    
+Note: the model and geometry must stay alive as long as the clone.
+");
+    %newobject clone;
+    steps::tetexact::Tetexact * clone(steps::rng::RNG * r = 0);
+    
+    %feature("autodoc", 
+"
+Return one new solver per generator in rngs, each in the state of this 
+solver as clone() would make it and drawing from its own generator, 
+e.g. a stream of one seed each (see steps.rng.RNG.initializeStream). 
+The state is captured once and every replicate is restored from it in 
+memory, and the dependency lists are translated once per distinct 
+list, so forking replicates after an equilibration costs a fraction 
+of creating and restoring each solver.
+    
+Syntax::
+    
+    fork(rngs)
+    
+Arguments:
+    list<steps.rng.RNG> rngs (distinct generators, one per replicate)
+    
+Return:
+    list<steps.solver.Tetexact>
+    
+Note: the model, geometry and generators must stay alive as long as the 
+replicates.
+");
+    std::vector<steps::tetexact::Tetexact *> fork(std::vector<steps::rng::RNG *> const & rngs);
+    
+    %feature("autodoc", 
+"
+Set the counts in every tetrahedron and triangle to those of a TetODE 
+solver built on the same mesh and model, each rounded stochastically, 
+for instance to start stochastic runs from a deterministic 
+equilibration. Propensities are refreshed once at the end, which makes 
+this much faster than setting the counts element by element. The 
+simulation time is not copied.
+    
+Syntax::
+    
+    setStateFrom(ode)
+    
+Arguments:
+    steps.solver.TetODE ode
+    
+Return:
+    None
+");
+    void setStateFrom(steps::tetode::TetODE & ode);
+    
+    %feature("autodoc", 
+"
+Set the counts in every tetrahedron and triangle of a TetODE solver 
+built on the same mesh and model to those of this solver. The 
+simulation time is not copied.
+    
+Syntax::
+    
+    copyStateTo(ode)
+    
+Arguments:
+    steps.solver.TetODE ode
+    
+Return:
+    None
+");
+    void copyStateTo(steps::tetode::TetODE & ode) const;
+    
+    %feature("autodoc", 
+"
+Reset the simulation to the state the solver was initialised to. 
+Typically, this resets all concentrations of all chemical species in 
+all elements (whether compartments and patches in a well-mixed solver 
+or tetrahedrons and triangles in a mesh-based solver) to zero, 
+resets the simulation time to zero and resets reaction (and diffusion) 
+rates to the default values described in the steps.model objects. 
+All reaction (and diffusion) rules are reset to active and all 
+compartment volumes and patch areas are reset to default values 
+described in steps.geom objects (for well-mixed solvers). 
+Usually, this method should be called before starting each simulation iteration.
+
+Syntax::
+    
+    reset()
+    
+Arguments:
+    None
+
+Return:
+    None
+");
+    virtual void reset(void);
+    
+    %feature("autodoc", 
+"
+Advance the simulation until endtime (given in seconds) is reached. 
+The endtime must be larger or equal to the current simulation time.
+
+Syntax::
+    
+    run(endtime)
+    
+Arguments:
+    float endtime
+
+Return:
+    None
+");
+    virtual void run(double endtime);
+    
+    %feature("autodoc", 
+"
+Returns the current simulation time in seconds.
+
+Syntax::
+    
+    getTime()
+    
+Arguments:
+    None
+
+Return:
+    float
+");
+    virtual double getTime(void) const;
+
+%feature("autodoc", 
+"
+Saves the vertex optimization in the Efield structure, together with 
+the coupling constants of the vertex connections, so that loading it 
+also skips the coupling computation.
+             
+Syntax::
+             
+    saveMembOpt()
+             
+Arguments:
+    string filename
+             
+Return:
+    None
+");
+    void saveMembOpt(std::string const & opt_file_name);
+
+%feature("autodoc", 
+"
+Returns the name of the SSA scheduler used by the solver 
+(\"cr\", \"direct\", \"nrm\" or \"nsm\", the next subvolume method,
+which is \"nrm\" with the element scheduler on).
+             
+Syntax::
+             
+    getScheduler()
+             
+Arguments:
+    None
+             
+Return:
+    string
+");
+    std::string getScheduler(void) const;
+
+%feature("autodoc", 
+"
+Choose whether the reactions of well-mixed compartments attached to the
+mesh are selected by a direct-method sub-scheduler of their own, which
+takes part in the main scheduler as a single entry with their total
+propensity. This keeps the main scheduler's tree or groups limited to
+the mesh elements. Off by default.
+             
+Syntax::
+             
+    setWmVolScheduler(split)
+             
+Arguments:
+    bool split
+             
+Return:
+    None
+");
+    void setWmVolScheduler(bool split);
+
+%feature("autodoc", 
+"
+Returns True if the well-mixed compartments have their own sub-scheduler.
+             
+Syntax::
+             
+    getWmVolScheduler()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getWmVolScheduler(void) const;
+
+%feature("autodoc", 
+"
+Choose whether the reactions and diffusions of each tetrahedron, triangle
+and well-mixed compartment take part in the main scheduler as a single
+entry with their summed propensity, the one that fires being selected
+within the element. An event then updates the main scheduler once per
+changed element rather than once per changed process. Off by default;
+turns the well-mixed compartment scheduler off.
+             
+Syntax::
+             
+    setElementScheduler(group)
+             
+Arguments:
+    bool group
+             
+Return:
+    None
+");
+    void setElementScheduler(bool group);
+
+%feature("autodoc", 
+"
+Returns True if the processes of each element are scheduled as a group.
+             
+Syntax::
+             
+    getElementScheduler()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getElementScheduler(void) const;
+
+%feature("autodoc", 
+"
+Set the number of SSA events between exact recalculations of the total
+propensity A0 (default 1000). In between, A0 is updated incrementally
+from the propensity changes caused by each event. A value of 1 recalculates
+A0 after every event.
+             
+Syntax::
+             
+    setA0ResyncInterval(n)
+             
+Arguments:
+    unsigned integer n
+             
+Return:
+    None
+");
+    void setA0ResyncInterval(unsigned int n);
+
+%feature("autodoc", 
+"
+Returns the number of SSA events between exact recalculations of A0.
+             
+Syntax::
+             
+    getA0ResyncInterval()
+             
+Arguments:
+    None
+             
+Return:
+    unsigned integer
+");
+    unsigned int getA0ResyncInterval(void) const;
+
+%feature("autodoc", 
+"
+Choose how the SSA finds the composition-rejection group of the next event:
+by a search in a sum tree over all groups (default), or by a linear scan 
+over the groups.
+             
+Syntax::
+             
+    setGroupTreeSearch(tree)
+             
+Arguments:
+    bool tree
+             
+Return:
+    None
+");
+    void setGroupTreeSearch(bool tree);
+
+%feature("autodoc", 
+"
+Returns True if the SSA uses the group sum tree search, False if it 
+uses a linear scan over the composition-rejection groups.
+             
+Syntax::
+             
+    getGroupTreeSearch()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getGroupTreeSearch(void) const;
+
+%feature("autodoc", 
+"
+Runs the SSA of run() over the ranks of an MPI job (on = True), each rank 
+simulating its own spatial domain of the mesh. The tetrahedrons are split 
+with steps.geom.Tetmesh.partitionTets into one domain per rank, the two 
+tetrahedrons of every triangle in the same domain. Time is cut into windows 
+of the given length (in seconds): a molecule that diffuses out of a domain 
+leaves at once and enters the neighbouring domain at the end of the window 
+(operator splitting), so the window should be short next to the time a 
+molecule stays in a tetrahedron. After each run() every rank holds the 
+whole state. Every rank has to call setDomains() and run() with the same 
+arguments. on = False goes back to the serial SSA; step() is always 
+serial. MPI is initialized if the caller has not done so; without MPI 
+support the process is the only rank. Not available with the EField, 
+well-mixed compartments, clusters, tau-leaping, batched diffusion or 
+triggers.
+             
+Syntax::
+             
+    setDomains(on, window = 1.0e-6)
+             
+Arguments:
+    * bool on
+    * float window
+             
+Return:
+    None
+");
+    void setDomains(bool on, double window = 1.0e-6);
+
+%feature("autodoc", 
+"
+Returns whether domains are set with setDomains().
+             
+Syntax::
+             
+    getDomains()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getDomains(void) const;
+
+%feature("autodoc", 
+"
+Returns the MPI rank of this process with domains set, or 0.
+             
+Syntax::
+             
+    getDomainRank()
+             
+Arguments:
+    None
+             
+Return:
+    uint
+");
+    uint getDomainRank(void) const;
+
+%feature("autodoc", 
+"
+Returns the number of domains (MPI ranks) with domains set, or 0.
+             
+Syntax::
+             
+    getNDomains()
+             
+Arguments:
+    None
+             
+Return:
+    uint
+");
+    uint getNDomains(void) const;
+
+%feature("autodoc", 
+"
+Returns the indices of the tetrahedrons of the domain of this rank.
+             
+Syntax::
+             
+    getDomainTets()
+             
+Arguments:
+    None
+             
+Return:
+    list<uint>
+");
+    std::vector<uint> getDomainTets(void) const;
+
+%feature("autodoc", 
+"
+Returns the halo of the domain of this rank: the indices of the 
+tetrahedrons of other domains that share a face with it.
+             
+Syntax::
+             
+    getDomainHalo()
+             
+Arguments:
+    None
+             
+Return:
+    list<uint>
+");
+    std::vector<uint> getDomainHalo(void) const;
+
+%feature("autodoc", 
+"
+Returns the number of molecules this rank handed to other ranks since 
+setDomains().
+             
+Syntax::
+             
+    getDomainMessages()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getDomainMessages(void) const;
+
+%feature("autodoc", 
+"
+Returns a health statistic of the composition-rejection scheduler, 
+accumulated since the last resetCRStats() or reset(): \"events\" (the 
+number of events selected), \"trials\" (the number of rejection sampling 
+trials, accepted ones included), \"meantrials\" (trials per event; values 
+well above 2 point to sparsely filled groups), \"extends\" (group storage 
+reallocations), \"groups\" (groups allocated) or \"nonempty\" (groups 
+holding at least one kinetic process). Only available with the \"cr\" 
+scheduler.
+             
+Syntax::
+             
+    getCRStat(stat)
+             
+Arguments:
+    string stat
+             
+Return:
+    float
+");
+    double getCRStat(std::string const & stat) const;
+
+%feature("autodoc", 
+"
+Zeroes the counters returned by getCRStat.
+             
+Syntax::
+             
+    resetCRStats()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+    void resetCRStats(void);
+
+%feature("autodoc", 
+"
+Returns one value per composition-rejection group allocated, in order of 
+increasing power: \"pow\" (the binary exponent of the propensities held 
+by the group), \"size\" (the number of kinetic processes in it), \"sum\" 
+(their total propensity) or \"fill\" (the acceptance probability of a 
+rejection trial in the group, zero when empty). Only available with the 
+\"cr\" scheduler.
+             
+Syntax::
+             
+    getCRGroupData(field)
+             
+Arguments:
+    string field
+             
+Return:
+    list<float>
+");
+    std::vector<double> getCRGroupData(std::string const & field) const;
+
+%feature("autodoc", 
+"
+Returns the number of bytes held by one part of the solver: \"elements\" 
+(tetrahedrons, triangles, well-mixed volumes, compartments, patches and 
+diffusion boundaries), \"kprocs\" (the kinetic processes and their update 
+lists), \"scheduler\", \"efield\" (zero without the EField), \"mesh\", 
+\"statedef\", \"arena\" (space reserved for the solver's objects but never 
+handed out) or \"total\" (the sum of all parts).
+             
+Syntax::
+             
+    getMemoryUsage(part)
+             
+Arguments:
+    string part
+             
+Return:
+    float
+");
+    double getMemoryUsage(std::string const & part) const;
+
+%feature("autodoc", 
+"
+Switch run() between exact SSA (the default) and tau-leaping with the 
+step selection of Cao, Gillespie and Petzold (2006). Volume reactions 
+and diffusion are leaped, while surface processes and kinetic processes 
+close to exhausting a reactant are executed one event at a time. When a 
+leap would be too short to pay off the solver takes exact SSA steps 
+instead. Not available with the EField.
+             
+Syntax::
+             
+    setTauLeaping(leap)
+             
+Arguments:
+    bool leap
+             
+Return:
+    None
+");
+    void setTauLeaping(bool leap);
+
+%feature("autodoc", 
+"
+Returns True if run() uses tau-leaping.
+             
+Syntax::
+             
+    getTauLeaping()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getTauLeaping(void) const;
+
+%feature("autodoc", 
+"
+Set the error control parameter epsilon of the tau selection, the 
+largest relative change allowed in the propensities during a leap. 
+Must lie in (0, 1); the default is 0.03.
+             
+Syntax::
+             
+    setTauLeapEpsilon(eps)
+             
+Arguments:
+    float eps
+             
+Return:
+    None
+");
+    void setTauLeapEpsilon(double eps);
+
+%feature("autodoc", 
+"
+Returns the error control parameter epsilon of the tau selection.
+             
+Syntax::
+             
+    getTauLeapEpsilon()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getTauLeapEpsilon(void) const;
+
+%feature("autodoc", 
+"
+Set the number of firings below which a kinetic process is critical, 
+i.e. could exhaust one of its reactants, and is executed as single 
+events. The default is 10.
+             
+Syntax::
+             
+    setTauLeapNCrit(ncrit)
+             
+Arguments:
+    uint ncrit
+             
+Return:
+    None
+");
+    void setTauLeapNCrit(uint ncrit);
+
+%feature("autodoc", 
+"
+Returns the number of firings below which a kinetic process is 
+critical.
+             
+Syntax::
+             
+    getTauLeapNCrit()
+             
+Arguments:
+    None
+             
+Return:
+    uint
+");
+    uint getTauLeapNCrit(void) const;
+
+%feature("autodoc", 
+"
+Diffuse the molecules of any species with at least n molecules in a 
+tetrahedron or triangle in batches instead of as single events. At the 
+start of each window of length getDiffBatchDT() the volume and surface 
+diffusion processes over the threshold are taken off the SSA; at its 
+end each moves the molecules that left during the window, split 
+multinomially over the neighbours. 
+All other processes, including diffusion below the threshold, stay 
+exact. 0 (the default) turns batching off. Not available with the 
+EField; ignored when tau-leaping.
+             
+Syntax::
+             
+    setDiffBatchThreshold(n)
+             
+Arguments:
+    uint n
+             
+Return:
+    None
+");
+    void setDiffBatchThreshold(uint n);
+
+%feature("autodoc", 
+"
+Returns the molecule count above which diffusion is batched, 0 if 
+batching is off.
+             
+Syntax::
+             
+    getDiffBatchThreshold()
+             
+Arguments:
+    None
+             
+Return:
+    uint
+");
+    uint getDiffBatchThreshold(void) const;
+
+%feature("autodoc", 
+"
+Set the window of the batched diffusion mode (default 1.0e-5s). It 
+should be short compared to the time a molecule takes to leave a 
+tetrahedron or triangle.
+             
+Syntax::
+             
+    setDiffBatchDT(dt)
+             
+Arguments:
+    float dt
+             
+Return:
+    None
+");
+    void setDiffBatchDT(double dt);
+
+%feature("autodoc", 
+"
+Returns the window of the batched diffusion mode.
+             
+Syntax::
+             
+    getDiffBatchDT()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getDiffBatchDT(void) const;
+
+%feature("autodoc", 
+"
+Coarse-grain the diffusion of the species selected with 
+setCoarseGrainSpec. The tetrahedrons of each compartment are grouped by 
+cubic bins of edge h (metres). At the start of each window of length 
+setCoarseGrainDT the concentration of each group is compared with those 
+of its neighbouring groups; a group within setCoarseGrainTol of all of 
+them is merged into a single well-mixed voxel for the window: diffusion 
+between its own tetrahedrons is taken off the SSA and its molecules are 
+spread over them by volume instead, while diffusion out of the group 
+stays exact. A group that is split again, and every group at the end of 
+a run, has its molecules spread by volume once more. 0 (the default) 
+turns the mode off. Not available with the EField; ignored when 
+tau-leaping or with batched diffusion.
+             
+Syntax::
+             
+    setCoarseGrainSize(h)
+             
+Arguments:
+    float h
+             
+Return:
+    None
+");
+    void setCoarseGrainSize(double h);
+
+%feature("autodoc", 
+"
+Returns the bin size of the coarse-grained mode (0 when off).
+             
+Syntax::
+             
+    getCoarseGrainSize()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getCoarseGrainSize(void) const;
+
+%feature("autodoc", 
+"
+Select species s for coarse-graining, or not (the default).
+             
+Syntax::
+             
+    setCoarseGrainSpec(s, cg)
+             
+Arguments:
+    * string s
+    * bool cg
+             
+Return:
+    None
+");
+    void setCoarseGrainSpec(std::string const & s, bool cg);
+
+%feature("autodoc", 
+"
+Returns whether species s is selected for coarse-graining.
+             
+Syntax::
+             
+    getCoarseGrainSpec(s)
+             
+Arguments:
+    string s
+             
+Return:
+    bool
+");
+    bool getCoarseGrainSpec(std::string const & s) const;
+
+%feature("autodoc", 
+"
+Set the window of the coarse-grained mode (default 1.0e-4s). It should 
+be short compared to the time a molecule takes to leave a group, but 
+every window mixes the merged groups again, which costs about one event 
+per tetrahedron.
+             
+Syntax::
+             
+    setCoarseGrainDT(dt)
+             
+Arguments:
+    float dt
+             
+Return:
+    None
+");
+    void setCoarseGrainDT(double dt);
+
+%feature("autodoc", 
+"
+Returns the window of the coarse-grained mode.
+             
+Syntax::
+             
+    getCoarseGrainDT()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getCoarseGrainDT(void) const;
+
+%feature("autodoc", 
+"
+Set the largest relative difference abs(c1 - c2) / (c1 + c2) between 
+the concentrations of a group and a neighbouring group for the group to 
+be merged (default 0.1).
+             
+Syntax::
+             
+    setCoarseGrainTol(tol)
+             
+Arguments:
+    float tol
+             
+Return:
+    None
+");
+    void setCoarseGrainTol(double tol);
+
+%feature("autodoc", 
+"
+Returns the tolerance of the coarse-grained mode.
+             
+Syntax::
+             
+    getCoarseGrainTol()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getCoarseGrainTol(void) const;
+
+%feature("autodoc", 
+"
+Returns the number of groups of the coarse-grained mode.
+             
+Syntax::
+             
+    getCoarseGrainNGroups()
+             
+Arguments:
+    None
+             
+Return:
+    unsigned int
+");
+    unsigned int getCoarseGrainNGroups(void);
+
+%feature("autodoc", 
+"
+Returns the number of groups merged for species s in the last window 
+run.
+             
+Syntax::
+             
+    getCoarseGrainNMerged(s)
+             
+Arguments:
+    string s
+             
+Return:
+    unsigned int
+");
+    unsigned int getCoarseGrainNMerged(std::string const & s) const;
+
+%feature("autodoc", 
+"
+Set the number of threads that compute the currents of the membrane 
+triangles on each EField step (default 1). If the membrane mesh is in 
+several unconnected parts, such as separate cells, the threads also 
+decompose and solve the EField system of each part independently. 
+Results do not depend on the number of threads.
+             
+Syntax::
+             
+    setEfieldThreads(n)
+             
+Arguments:
+    uint n
+             
+Return:
+    None
+");
+    void setEfieldThreads(uint n);
+
+%feature("autodoc", 
+"
+Returns the number of threads that compute the membrane currents.
+             
+Syntax::
+             
+    getEfieldThreads()
+             
+Arguments:
+    None
+             
+Return:
+    uint
+");
+    uint getEfieldThreads(void) const;
+
+%feature("autodoc", 
+"
+Adapt the EField dt after every EField step, so that the largest 
+potential change of an unclamped vertex stays near dvmax (volts). The 
+dt grows or shrinks by at most a factor of 2 per step and is kept 
+within [dtmin, dtmax] (seconds). A dvmax of 0 turns the adaptive mode 
+off. Off by default.
+             
+Syntax::
+             
+    setEfieldAdaptive(dvmax, dtmin, dtmax)
+             
+Arguments:
+    float dvmax
+    float dtmin
+    float dtmax
+             
+Return:
+    None
+");
+    void setEfieldAdaptive(double dvmax, double dtmin, double dtmax);
+
+%feature("autodoc", 
+"
+Return the target potential change per EField step of the adaptive 
+mode (volts), or 0 if it is off.
+             
+Syntax::
+             
+    getEfieldAdaptiveDV()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getEfieldAdaptiveDV(void) const;
+
+%feature("autodoc", 
+"
+Set the implicitness of the EField potential update: 1.0 is backward 
+Euler (the default), 0.5 is Crank-Nicolson, which is second order in 
+the EField dt and so allows larger steps for the same accuracy. 
+Values in between blend the two.
+             
+Syntax::
+             
+    setEfieldTheta(theta)
+             
+Arguments:
+    float theta
+             
+Return:
+    None
+");
+    void setEfieldTheta(double theta);
+
+%feature("autodoc", 
+"
+Return the implicitness of the EField potential update.
+             
+Syntax::
+             
+    getEfieldTheta()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getEfieldTheta(void) const;
+
+%feature("autodoc", 
+"
+Decompose the EField matrix in single precision, which halves its 
+storage and memory traffic, and recover double precision solutions by 
+iterative refinement against the double precision matrix (off by 
+default). Only the banded solvers (opt_method other than 3 and 5) 
+support this. getEfieldStat('refine') counts the refinement steps.
+             
+Syntax::
+             
+    setEfieldMixedPrecision(mixed)
+             
+Arguments:
+    bool mixed
+             
+Return:
+    None
+");
+    void setEfieldMixedPrecision(bool mixed);
+
+%feature("autodoc", 
+"
+Return whether the EField matrix is decomposed in single precision.
+             
+Syntax::
+             
+    getEfieldMixedPrecision()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getEfieldMixedPrecision(void) const;
+
+%feature("autodoc", 
+"
+Return the name of the EField backend given at construction ('cpu' by 
+default).
+             
+Syntax::
+             
+    getEfieldBackend()
+             
+Arguments:
+    None
+             
+Return:
+    string
+");
+    std::string getEfieldBackend(void) const;
+
+%feature("autodoc", 
+"
+Run the EField potential update of each step on a helper thread while 
+the SSA goes on with the next step, which then uses the potentials of 
+the step before: the coupling lags by one EField step. The update in 
+flight is finished before run() returns. Off by default.
+             
+Syntax::
+             
+    setEfieldPipeline(pipe)
+             
+Arguments:
+    bool pipe
+             
+Return:
+    None
+");
+    void setEfieldPipeline(bool pipe);
+
+%feature("autodoc", 
+"
+Return whether the EField update overlaps the SSA.
+             
+Syntax::
+             
+    getEfieldPipeline()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getEfieldPipeline(void) const;
+
+%feature("autodoc", 
+"
+Schedule voltage-dependent transitions and surface reactions by 
+rejection. Each takes part in the scheduler with the largest rate it can 
+have while the potential of its triangle stays within dv (volts) of the 
+potential it was bounded at; a selected one fires with the ratio of its 
+exact rate to that bound, otherwise time moves on without a change. After 
+an EField step, only those whose potential left the window are updated. 
+A dv of 0 (the default) updates all of them exactly after every step.
+             
+Syntax::
+             
+    setVDepWindow(dv)
+             
+Arguments:
+    float dv
+             
+Return:
+    None
+");
+    void setVDepWindow(double dv);
+
+%feature("autodoc", 
+"
+Return the potential window of the rejection scheduling, 0 when off.
+             
+Syntax::
+             
+    getVDepWindow()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getVDepWindow(void) const;
+
+%feature("autodoc", 
+"
+Schedule the voltage-dependent transitions of each rule in lumps: the 
+triangles whose potential falls in the same bin of width dv (volts) share 
+one scheduler entry, with the rate at the centre of the bin times their 
+total number of channels in the source state, and the triangle that fires 
+is chosen in proportion to that number. After an EField step only the 
+transitions of triangles that changed bin are moved. Rates are 
+approximate to within their change over a bin. A dv of 0 (the default) 
+schedules each transition on its own.
+             
+Syntax::
+             
+    setVDepLump(dv)
+             
+Arguments:
+    float dv
+             
+Return:
+    None
+");
+    void setVDepLump(double dv);
+
+%feature("autodoc", 
+"
+Return the bin width of the voltage-dependent transition lumps, 0 when 
+off.
+             
+Syntax::
+             
+    getVDepLump()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getVDepLump(void) const;
+
+%feature("autodoc", 
+"
+Returns a counter of the EField steps since the last resetEfieldStats(): 
+'steps' and 'matrices' (constructions of the EField matrix), the wall 
+clock time in seconds spent in 'rhs', 'matrix' (construction and 
+factorization) and 'solve' of the potential update, in 'currents' (the 
+membrane triangle currents) and 'update' (the voltage-dependent 
+propensities), 'maxdv' (the largest potential change of a step, in 
+volts), 'halfbw' (the half bandwidth of the EField matrix), 'blocks' 
+(the independent blocks of the EField matrix, one per unconnected part of 
+the membrane for the banded solver), 'refine' (iterative refinement steps 
+with setEfieldMixedPrecision), or of the 
+rejection scheduling (see setVDepWindow): 'vdepcand' (selected 
+candidates), 'vdepreject' (rejected ones) and 'vdepmoved' (windows moved, 
+or transitions moved to another lump (see setVDepLump), after an EField 
+step).
+             
+Syntax::
+             
+    getEfieldStat(stat)
+             
+Arguments:
+    string stat
+             
+Return:
+    float
+");
+    double getEfieldStat(std::string const & stat) const;
+
+%feature("autodoc", 
+"
+Zeroes the EField counters returned by getEfieldStat.
+             
+Syntax::
+             
+    resetEfieldStats()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+    void resetEfieldStats(void);
+
+%feature("autodoc", 
+"
+Hold the molecule counts of each tetrahedron and triangle in 16 bits, 
+which roughly halves their pool storage. An element is widened when 
+one of its counts exceeds 65535, and compacted again on reset(). 
+Results are not affected. Off by default.
+             
+Syntax::
+             
+    setCompactPools(compact)
+             
+Arguments:
+    bool compact
+             
+Return:
+    None
+");
+    void setCompactPools(bool compact);
+
+%feature("autodoc", 
+"
+Returns whether compact pool storage is on.
+             
+Syntax::
+             
+    getCompactPools()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getCompactPools(void) const;
+
+%feature("autodoc", 
+"
+Keep running totals of the count of each species per compartment and 
+per patch, updated with every change of a count, so that getCompCount, 
+getPatchCount and the concentrations and amounts derived from them no 
+longer sum over all the elements. Results are not affected. Off by 
+default.
+             
+Syntax::
+             
+    setCountTotals(on)
+             
+Arguments:
+    bool on
+             
+Return:
+    None
+");
+    void setCountTotals(bool on);
+
+%feature("autodoc", 
+"
+Returns whether the per compartment and per patch count totals are kept.
+             
+Syntax::
+             
+    getCountTotals()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getCountTotals(void) const;
+
+%feature("autodoc", 
+"
+Stop run() at the event that brings the number of molecules of species 
+s in compartment c up to at least n (above = True) or down to at most n 
+(above = False). The condition is checked after every event on the 
+running count totals, which this turns on. A trigger fires when its 
+condition becomes true; one that already holds when run() is called does 
+not stop it. With tau-leaping or batched diffusion the run stops at the 
+end of the leap or window in which the condition became true. Returns 
+the index of the trigger.
+             
+Syntax::
+             
+    addCompCountTrigger(c, s, n, above = True)
+             
+Arguments:
+    string c
+    string s
+    float n
+    bool above
+             
+Return:
+    unsigned int
+");
+    unsigned int addCompCountTrigger(std::string const & c, std::string const & s,
+                                     double n, bool above = true);
+
+%feature("autodoc", 
+"
+As addCompCountTrigger, for the number of molecules of species s in 
+patch p.
+             
+Syntax::
+             
+    addPatchCountTrigger(p, s, n, above = True)
+             
+Arguments:
+    string p
+    string s
+    float n
+    bool above
+             
+Return:
+    unsigned int
+");
+    unsigned int addPatchCountTrigger(std::string const & p, std::string const & s,
+                                      double n, bool above = true);
+
+%feature("autodoc", 
+"
+Remove all the triggers.
+             
+Syntax::
+             
+    clearTriggers()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+    void clearTriggers(void);
+
+%feature("autodoc", 
+"
+Returns the index of the trigger that stopped the last run() or step(), 
+or -1 if none did.
+             
+Syntax::
+             
+    getTriggered()
+             
+Arguments:
+    None
+             
+Return:
+    int
+");
+    int getTriggered(void) const;
+
+%feature("autodoc", 
+"
+Set the number of molecules of species s in compartment c to n at time t 
+(in seconds), as setCompCount does. run() stops the simulation at the 
+time of each intervention, applies all those due at that time and 
+refreshes the propensities they changed at once before carrying on, so a 
+stimulus protocol does not need to split the run from Python. An 
+intervention at the end time of run() is applied by the next run(), as 
+is one whose time was passed by setTime or a restore. reset() starts the 
+interventions again from the beginning. Returns the index of the 
+intervention.
+             
+Syntax::
+             
+    scheduleCompCount(t, c, s, n)
+             
+Arguments:
+    float t
+    string c
+    string s
+    float n
+             
+Return:
+    unsigned int
+");
+    unsigned int scheduleCompCount(double t, std::string const & c,
+                                   std::string const & s, double n);
+
+%feature("autodoc", 
+"
+Add n molecules of species s to compartment c at time t, spread over its 
+tetrahedrons by volume (see scheduleCompCount).
+             
+Syntax::
+             
+    scheduleCompInject(t, c, s, n)
+             
+Arguments:
+    float t
+    string c
+    string s
+    float n
+             
+Return:
+    unsigned int
+");
+    unsigned int scheduleCompInject(double t, std::string const & c,
+                                    std::string const & s, double n);
+
+%feature("autodoc", 
+"
+Add n molecules of species s to tetrahedron tidx at time t (see 
+scheduleCompCount).
+             
+Syntax::
+             
+    scheduleTetInject(t, tidx, s, n)
+             
+Arguments:
+    float t
+    unsigned int tidx
+    string s
+    float n
+             
+Return:
+    unsigned int
+");
+    unsigned int scheduleTetInject(double t, unsigned int tidx,
+                                   std::string const & s, double n);
+
+%feature("autodoc", 
+"
+Set the number of molecules of species s in patch p to n at time t (see 
+scheduleCompCount).
+             
+Syntax::
+             
+    schedulePatchCount(t, p, s, n)
+             
+Arguments:
+    float t
+    string p
+    string s
+    float n
+             
+Return:
+    unsigned int
+");
+    unsigned int schedulePatchCount(double t, std::string const & p,
+                                    std::string const & s, double n);
+
+%feature("autodoc", 
+"
+Set the rate constant of reaction r in compartment c to kf at time t 
+(see scheduleCompCount).
+             
+Syntax::
+             
+    scheduleCompReacK(t, c, r, kf)
+             
+Arguments:
+    float t
+    string c
+    string r
+    float kf
+             
+Return:
+    unsigned int
+");
+    unsigned int scheduleCompReacK(double t, std::string const & c,
+                                   std::string const & r, double kf);
+
+%feature("autodoc", 
+"
+Set the rate constant of surface reaction r in patch p to kf at time t 
+(see scheduleCompCount).
+             
+Syntax::
+             
+    schedulePatchSReacK(t, p, r, kf)
+             
+Arguments:
+    float t
+    string p
+    string r
+    float kf
+             
+Return:
+    unsigned int
+");
+    unsigned int schedulePatchSReacK(double t, std::string const & p,
+                                     std::string const & r, double kf);
+
+%feature("autodoc", 
+"
+Clamp or release species s in compartment c at time t (see 
+scheduleCompCount).
+             
+Syntax::
+             
+    scheduleCompClamped(t, c, s, clamped)
+             
+Arguments:
+    float t
+    string c
+    string s
+    bool clamped
+             
+Return:
+    unsigned int
+");
+    unsigned int scheduleCompClamped(double t, std::string const & c,
+                                     std::string const & s, bool clamped);
+
+%feature("autodoc", 
+"
+Set the current clamp on vertex vidx to cur (in ampere) at time t (see 
+scheduleCompCount). Only available with the EField.
+             
+Syntax::
+             
+    scheduleVertIClamp(t, vidx, cur)
+             
+Arguments:
+    float t
+    unsigned int vidx
+    float cur
+             
+Return:
+    unsigned int
+");
+    unsigned int scheduleVertIClamp(double t, unsigned int vidx, double cur);
+
+%feature("autodoc", 
+"
+Apply intervention i n times in all, every period (in seconds) from its 
+first time. Applications already made count towards n.
+             
+Syntax::
+             
+    repeatIntervention(i, period, n)
+             
+Arguments:
+    unsigned int i
+    float period
+    unsigned int n
+             
+Return:
+    None
+");
+    void repeatIntervention(unsigned int i, double period, unsigned int n);
+
+%feature("autodoc", 
+"
+Remove all the interventions.
+             
+Syntax::
+             
+    clearInterventions()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+    void clearInterventions(void);
+
+%feature("autodoc", 
+"
+Returns the number of applications of the interventions still to come.
+             
+Syntax::
+             
+    getNInterventions()
+             
+Arguments:
+    None
+             
+Return:
+    unsigned int
+");
+    unsigned int getNInterventions(void) const;
+
+%feature("autodoc", 
+"
+Runs the SSA of run() on nclusters spatial clusters of tetrahedrons in 
+parallel on nthreads threads. The clusters are synchronised optimistically 
+over windows of the given length (in seconds): a cluster that receives a 
+molecule diffusing in at an earlier time than it has simulated to rolls 
+back and simulates on from there. The results are exact, but not the same 
+draws as the serial solver. 0 or 1 cluster goes back to the serial SSA. 
+Not available with the EField, well-mixed compartments, tau-leaping, 
+batched diffusion or triggers.
+             
+Syntax::
+             
+    setClusters(nclusters, nthreads = 1, window = 1.0e-6)
+             
+Arguments:
+    * uint nclusters
+    * uint nthreads
+    * float window
+             
+Return:
+    None
+");
+    void setClusters(uint nclusters, uint nthreads = 1, double window = 1.0e-6);
+
+%feature("autodoc", 
+"
+Returns the number of clusters set with setClusters(), or 0.
+             
+Syntax::
+             
+    getNClusters()
+             
+Arguments:
+    None
+             
+Return:
+    uint
+");
+    uint getNClusters(void) const;
+
+%feature("autodoc", 
+"
+Returns the number of times a cluster simulated (part of) a window since 
+setClusters().
+             
+Syntax::
+             
+    getClusterRuns()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getClusterRuns(void) const;
+
+%feature("autodoc", 
+"
+Returns the number of times a cluster rolled back since setClusters().
+             
+Syntax::
+             
+    getClusterRollbacks()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getClusterRollbacks(void) const;
+
+%feature("autodoc", 
+"
+Returns a hash, as 16 hexadecimal digits, of the simulation time, the 
+molecule counts of all elements and the membrane potentials of the 
+EField triangles. Two runs with equal hashes at the same time have 
+followed the same trajectory. Results do not depend on the number of 
+threads: the clusters of setClusters() draw from random number streams 
+keyed by the cluster index, and the setup and membrane current loops 
+work element by element. So the same model and seed give the same hash 
+with any number of threads, which steps.utilities.repro checks.
+             
+Syntax::
+             
+    getStateHash()
+             
+Arguments:
+    None
+             
+Return:
+    string
+");
+    std::string getStateHash(void) const;
+
+%feature("autodoc", 
+"
+Mirror the molecule counts of all tetrahedrons, and of all triangles, 
+into two contiguous arrays owned by the solver, one row per element and 
+one column per species (in the order of getSpecIdx), updated with every 
+change of a count. Elements outside any compartment or patch have rows 
+of zeros. Turning this off frees the arrays. Off by default. Use 
+getTetCountView and getTriCountView to read them from Python.
+             
+Syntax::
+             
+    setCountViews(on)
+             
+Arguments:
+    bool on
+             
+Return:
+    None
+");
+    void setCountViews(bool on);
+
+%feature("autodoc", 
+"
+Returns whether the tetrahedron and triangle count views are kept.
+             
+Syntax::
+             
+    getCountViews()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getCountViews(void) const;
+
+%feature("autodoc", 
+"
+Returns the address of the tetrahedron count view, or 0 when the views 
+are off. The address is valid until the views are turned off or the 
+solver is destroyed; getTetCountView wraps it in a NumPy array.
+             
+Syntax::
+             
+    getTetCountViewAddr()
+             
+Arguments:
+    None
+             
+Return:
+    size_t
+");
+    size_t getTetCountViewAddr(void) const;
+
+%feature("autodoc", 
+"
+Returns the address of the triangle count view, or 0 when the views are 
+off. The address is valid until the views are turned off or the solver 
+is destroyed; getTriCountView wraps it in a NumPy array.
+             
+Syntax::
+             
+    getTriCountViewAddr()
+             
+Arguments:
+    None
+             
+Return:
+    size_t
+");
+    size_t getTriCountViewAddr(void) const;
+
+%feature("autodoc", 
+"
+Returns the phases of the solver construction, in the order they ran: 
+'statedef' (the state definition), 'elements' (compartments, patches, 
+tetrahedrons and triangles), 'kprocs', 'index' (the per-element species 
+dependency index), 'deps' (the update lists of the kinetic processes), 
+with the EField 'efield.mesh' (vertices, connections and surface areas), 
+'efield.couple' (the coupling constants), 'efield.order' (the vertex 
+ordering), 'efield.matrix' (the potential propagator) and 'efield' (all 
+EField structures), then 'sched' (the scheduler) and 'total' (all but 
+'statedef').
+             
+Syntax::
+             
+    getSetupPhases()
+             
+Arguments:
+    None
+             
+Return:
+    list<string>
+");
+    std::vector<std::string> getSetupPhases(void) const;
+
+%feature("autodoc", 
+"
+Returns the wall clock time in seconds that a phase of the solver 
+construction took (see getSetupPhases).
+             
+Syntax::
+             
+    getSetupTime(phase)
+             
+Arguments:
+    string phase
+             
+Return:
+    float
+");
+    double getSetupTime(std::string const & phase) const;
+
+%feature("autodoc", 
+"
+Returns the number of items a phase of the solver construction handled: 
+the species, reaction and diffusion rules for 'statedef', the elements 
+for 'elements', 'index' and 'total', the kinetic processes for 'kprocs' 
+and 'sched', the update list entries for 'deps' and the EField vertices 
+for the EField phases.
+             
+Syntax::
+             
+    getSetupCount(phase)
+             
+Arguments:
+    string phase
+             
+Return:
+    float
+");
+    double getSetupCount(std::string const & phase) const;
+
+%feature("autodoc", 
+"
+Returns True if the solver was created with lazydeps, building the 
+update list of each kinetic process when it first fires instead of 
+during construction.
+             
+Syntax::
+             
+    getLazyDeps()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getLazyDeps(void) const;
+
+%feature("autodoc", 
+"
+Returns the number of kinetic processes whose update lists have been 
+built; with lazydeps this grows as processes fire for the first time, 
+otherwise it is the number of kinetic processes.
+             
+Syntax::
+             
+    getNResolvedKProcs()
+             
+Arguments:
+    None
+             
+Return:
+    int
+");
+    unsigned int getNResolvedKProcs(void) const;
+
+%feature("autodoc", 
+"
+Returns the expected load of each tetrahedron of the mesh, for 
+Tetmesh.partitionTets: the number of its kinetic processes and species, 
+plus the kinetic processes of the triangles next to it. Tetrahedrons 
+outside the compartments have load 0.
+             
+Syntax::
+             
+    getTetLoads()
+             
+Arguments:
+    None
+             
+Return:
+    list<float>
+");
+    std::vector<double> getTetLoads(void) const;
+
+%feature("autodoc", 
+"
+Leaves the kinetic processes that can never fire out of the update lists 
+(True), or puts them back (False, the default). Call it once the initial 
+counts and clamps are set. A species is reachable in a compartment or 
+patch if it has molecules there, or if a process that can fire produces 
+it there or brings it in across a patch or diffusion boundary. A process 
+with an unreachable reactant, and the diffusion of an unreachable 
+species, keep a zero propensity and are no longer recomputed. Giving a 
+pruned species molecules, reset() and the restore methods switch pruning 
+off again.
+             
+Syntax::
+             
+    setNetworkPruning(prune)
+             
+Arguments:
+    bool prune
+             
+Return:
+    None
+");
+    void setNetworkPruning(bool prune);
+
+%feature("autodoc", 
+"
+Returns True if network pruning is on (see setNetworkPruning).
+             
+Syntax::
+             
+    getNetworkPruning()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getNetworkPruning(void) const;
+
+%feature("autodoc", 
+"
+Returns the number of kinetic processes left out of the update lists by 
+network pruning.
+             
+Syntax::
+             
+    getNPrunedKProcs()
+             
+Arguments:
+    None
+             
+Return:
+    int
+");
+    unsigned int getNPrunedKProcs(void) const;
+
+%feature("autodoc", 
+"
+Returns the names of the species that network pruning found unreachable 
+in a compartment or patch.
+             
+Syntax::
+             
+    getPrunedSpecs(loc)
+             
+Arguments:
+    string loc
+             
+Return:
+    list<string>
+");
+    std::vector<std::string> getPrunedSpecs(std::string const & loc) const;
+
+%feature("autodoc", 
+"
+Returns the names of the reactions that can never fire in a compartment, 
+or of the surface reactions, voltage-dependent transitions and surface 
+reactions and GHK currents that can never fire in a patch, as found by 
+network pruning.
+             
+Syntax::
+             
+    getPrunedReacs(loc)
+             
+Arguments:
+    string loc
+             
+Return:
+    list<string>
+");
+    std::vector<std::string> getPrunedReacs(std::string const & loc) const;
+
+%feature("autodoc", 
+"
+Turn the profile of the SSA on or off (default off). While on, the 
+events are tallied per kinetic process type, with the length of their 
+update lists and the wall clock time spent selecting, applying and 
+updating them. The tallies add up until resetProfile(). Batched 
+diffusion moves and tau-leaps are not SSA events and are not tallied.
+             
+Syntax::
+             
+    setProfiling(on)
+             
+Arguments:
+    bool on
+             
+Return:
+    None
+");
+    void setProfiling(bool on);
+
+%feature("autodoc", 
+"
+Returns whether the profile of the SSA is on.
+             
+Syntax::
+             
+    getProfiling()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getProfiling(void) const;
+
+%feature("autodoc", 
+"
+Returns a tally of the profile for the kinetic processes of type ktype 
+('Reac', 'Diff', 'SReac', 'SDiff', 'VDepTrans', 'VDepSReac', 'GHKcurr', 
+or 'all' for their sum): the number of 'events', the total length of 
+their update lists 'updates', and the wall clock seconds spent in 
+'apply' and in 'update' (refreshing the propensities on the update 
+lists). 'getnext', the seconds spent selecting the next event, is only 
+available for 'all'.
+             
+Syntax::
+             
+    getProfileStat(ktype, stat)
+             
+Arguments:
+    * string ktype
+    * string stat
+             
+Return:
+    float
+");
+    double getProfileStat(std::string const & ktype, std::string const & stat) const;
+
+%feature("autodoc", 
+"
+Zeroes the tallies returned by getProfileStat.
+             
+Syntax::
+             
+    resetProfile()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+    void resetProfile(void);
+
+%feature("autodoc", 
+"
+Turn the counting of SSA events per tetrahedron and triangle on or off 
+(default off). While on, the events of the kinetic processes of each 
+element are counted per kinetic process type, showing where in the 
+mesh the solver spends its events. The counts add up until 
+resetElementEvents(). Batched diffusion moves, tau-leaps, the events of 
+clusters and those of well-mixed volumes are not counted.
+             
+Syntax::
+             
+    setElementEvents(on)
+             
+Arguments:
+    bool on
+             
+Return:
+    None
+");
+    void setElementEvents(bool on);
+
+%feature("autodoc", 
+"
+Returns whether SSA events are counted per element.
+             
+Syntax::
+             
+    getElementEvents()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getElementEvents(void) const;
+
+%feature("autodoc", 
+"
+Returns the events counted for each tetrahedron of the mesh, for the 
+kinetic processes of type ktype ('Reac', 'Diff', 'SReac', 'SDiff', 
+'VDepTrans', 'VDepSReac', 'GHKcurr', or 'all' for their sum).
+             
+Syntax::
+             
+    getTetEvents(ktype)
+             
+Arguments:
+    string ktype
+             
+Return:
+    list<float>
+");
+    std::vector<double> getTetEvents(std::string const & ktype) const;
+
+%feature("autodoc", 
+"
+Returns the events counted for each triangle of the mesh, for the 
+kinetic processes of type ktype ('Reac', 'Diff', 'SReac', 'SDiff', 
+'VDepTrans', 'VDepSReac', 'GHKcurr', or 'all' for their sum).
+             
+Syntax::
+             
+    getTriEvents(ktype)
+             
+Arguments:
+    string ktype
+             
+Return:
+    list<float>
+");
+    std::vector<double> getTriEvents(std::string const & ktype) const;
+
+%feature("autodoc", 
+"
+Zeroes the counts returned by getTetEvents and getTriEvents.
+             
+Syntax::
+             
+    resetElementEvents()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+    void resetElementEvents(void);
+
+%feature("autodoc", 
+"
+Write every SSA event from now on to file_name, as the event time (in 
+whole ticks of resolution seconds) and the index of the kinetic process 
+that fired, until stopEventTrace(). The records are varints of a few 
+bytes each, written by a background thread, and cost a few percent of 
+the run time. The file also lists the type, element and process name 
+of every kinetic process; read it with steps.utilities.eventtrace. 
+Runs with the EField are traced; runs with clusters, domains, 
+tau-leaping, batched diffusion or coarse graining raise an error while 
+tracing.
+             
+Syntax::
+             
+    startEventTrace(file_name, resolution = 1.0e-12)
+             
+Arguments:
+    * string file_name
+    * float resolution
+             
+Return:
+    None
+");
+    void startEventTrace(std::string const & file_name, double resolution = 1.0e-12);
+
+%feature("autodoc", 
+"
+Write out the rest of the event trace and close its file. Raises an 
+error if any of it could not be written.
+             
+Syntax::
+             
+    stopEventTrace()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+    void stopEventTrace(void);
+
+%feature("autodoc", 
+"
+Returns whether an event trace is being written.
+             
+Syntax::
+             
+    getEventTrace()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getEventTrace(void) const;
+
+%feature("autodoc", 
+"
+Returns the number of events in the event trace being written.
+             
+Syntax::
+             
+    getEventTraceCount()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getEventTraceCount(void) const;
+
+%feature("autodoc", 
+"
+Stream a decimated view of the molecule counts to file_name, best placed 
+in shared memory (/dev/shm), for viewers to read while the simulation 
+runs; a stream already open is closed first. The bounding box of the 
+mesh is cut into nx * ny * nz voxels and every tetrahedron and triangle 
+adds its counts of the species specs to the voxel holding its 
+barycentre. The solver keeps the voxel totals up to date as counts 
+change, and a background thread copies them to the file fps times a 
+second without stopping the simulation. Read the frames with 
+steps.utilities.snapshot.
+             
+Syntax::
+             
+    setSnapshotStream(file_name, nx, ny, nz, specs, fps = 10.0)
+             
+Arguments:
+    * string file_name
+    * uint nx
+    * uint ny
+    * uint nz
+    * list<string> specs
+    * float fps
+             
+Return:
+    None
+");
+    void setSnapshotStream(std::string const & file_name,
+                           uint nx, uint ny, uint nz,
+                           std::vector<std::string> const & specs,
+                           double fps = 10.0);
+
+%feature("autodoc", 
+"
+Stop the snapshot stream, leaving its file with the last frame.
+             
+Syntax::
+             
+    clearSnapshotStream()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+    void clearSnapshotStream(void);
+
+%feature("autodoc", 
+"
+Publish a frame of the snapshot stream now, e.g. at the end of a run.
+             
+Syntax::
+             
+    publishSnapshot()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+    void publishSnapshot(void);
+
+%feature("autodoc", 
+"
+Returns the number of frames the snapshot stream has published, or 0 
+without one.
+             
+Syntax::
+             
+    getSnapshotFrames()
+             
+Arguments:
+    None
+             
+Return:
+    float
+");
+    double getSnapshotFrames(void) const;
+	
+	////////////////////////////////////////////////////////////////////////			
+	
+};
+	
+////////////////////////////////////////////////////////////////////////////////
+
+class Ensemble
+{
+
+public:
+    %feature("autodoc", 
+"
+Construction::
+
+    ens = steps.solver.Ensemble(model, geom, init_file, nthreads, rng_name = \"mt19937\", rng_bufsize = 512, calcMembPot = False, scheduler = \"cr\")
+
+Create an ensemble runner for independent Tetexact realisations on 
+nthreads threads. One Tetexact solver and one random number generator 
+are created per thread and reused for every seed that thread runs. 
+Each realisation starts from init_file, a checkpoint written by a 
+Tetexact solver for the same model and geometry on which the initial 
+conditions have been set.
+
+Arguments:
+    * steps.model.Model model
+    * steps.geom.Geom geom
+    * string init_file
+    * unsigned int nthreads
+    * string rng_name (default = \"mt19937\")
+    * unsigned int rng_bufsize (default = 512)
+    * bool calcMembPot (default = False)
+    * string scheduler (default = \"cr\")
+");
+    Ensemble(steps::model::Model * m, steps::wm::Geom * g,
+             std::string const & init_file, unsigned int nthreads,
+             std::string const & rng_name = "mt19937", unsigned int rng_bufsize = 512,
+             bool calcMembPot = false, std::string const & scheduler = "cr");
+    %feature("autodoc", "1");
+    ~Ensemble(void);
+
+    %feature("autodoc", 
+"
+Record the number of molecules of species s in compartment c at 
+each time point of run().
+
+Syntax::
+
+    addCompCountRecord(c, s)
+
+Arguments:
+    * string c
+    * string s
+
+Return:
+    None
+");
+    void addCompCountRecord(std::string const & c, std::string const & s);
+
+    %feature("autodoc", 
+"
+Record the number of molecules of species s in patch p at 
+each time point of run().
+
+Syntax::
+
+    addPatchCountRecord(p, s)
+
+Arguments:
+    * string p
+    * string s
+
+Return:
+    None
+");
+    void addPatchCountRecord(std::string const & p, std::string const & s);
+
+    %feature("autodoc", 
+"
+Returns the number of records added with addCompCountRecord and 
+addPatchCountRecord.
+
+Syntax::
+
+    getNRecords()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getNRecords(void) const;
+
+    %feature("autodoc", 
+"
+Returns the number of worker threads.
+
+Syntax::
+
+    getNThreads()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getNThreads(void) const;
+
+    %feature("autodoc", 
+"
+Draw the realisations from non-overlapping streams of one master seed. 
+While on, the realisation run with seed value s uses stream s of 
+master (see steps.rng.RNG.initializeStream) rather than a generator 
+initialized with s, so the seeds passed to run, resume and sweep are 
+replicate numbers. Off by default.
+
+Syntax::
+
+    setStreams(on, master = 0)
+
+Arguments:
+    * bool on
+    * unsigned int master
+
+Return:
+    None
+");
+    void setStreams(bool on, unsigned int master = 0);
+
+    %feature("autodoc", 
+"
+Returns True if the seeds are stream numbers of a master seed.
+
+Syntax::
+
+    getStreams()
+
+Arguments:
+    None
+
+Return:
+    bool
+");
+    bool getStreams(void) const;
+
+    %feature("autodoc", 
+"
+Make the rate constant of reaction r in compartment c a parameter of 
+sweep().
+
+Syntax::
+
+    addCompReacKParam(c, r)
+
+Arguments:
+    * string c
+    * string r
+
+Return:
+    None
+");
+    void addCompReacKParam(std::string const & c, std::string const & r);
+
+    %feature("autodoc", 
+"
+Make the rate constant of surface reaction sr in patch p a parameter 
+of sweep().
+
+Syntax::
+
+    addPatchSReacKParam(p, sr)
+
+Arguments:
+    * string p
+    * string sr
+
+Return:
+    None
+");
+    void addPatchSReacKParam(std::string const & p, std::string const & sr);
+
+    %feature("autodoc", 
+"
+Returns the number of parameters added with addCompReacKParam and 
+addPatchSReacKParam.
+
+Syntax::
+
+    getNParams()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getNParams(void) const;
+
+    %feature("autodoc", 
+"
+Run one realisation for each seed and return the recorded values as a 
+flat list in seed, time point, record order: element 
+(i * len(tpnts) + j) * getNRecords() + k is record k at tpnts[j] for 
+seeds[i]. The time points must be increasing.
+
+If cp_file is given, the final states of all realisations are written 
+to this ensemble checkpoint file, which can be continued with resume(). 
+The initial state is stored once and each realisation only adds its 
+time, molecule counts and reaction extents.
+
+Syntax::
+
+    run(seeds, tpnts, cp_file = \"\")
+
+Arguments:
+    * list<unsigned int> seeds
+    * list<float> tpnts
+    * string cp_file (default = \"\")
+
+Return:
+    list<float>
+");
+    std::vector<double> run(std::vector<unsigned int> const & seeds,
+                            std::vector<double> const & tpnts,
+                            std::string const & cp_file = "");
+
+    %feature("autodoc", 
+"
+Continue the realisations stored in ensemble checkpoint file cp_in, 
+which must hold one realisation per seed. Realisation i carries on 
+from its stored state with its random number generator initialized 
+with seeds[i]. Recording and cp_out are as for run().
+
+Syntax::
+
+    resume(cp_in, seeds, tpnts, cp_out = \"\")
+
+Arguments:
+    * string cp_in
+    * list<unsigned int> seeds
+    * list<float> tpnts
+    * string cp_out (default = \"\")
+
+Return:
+    list<float>
+");
+    std::vector<double> resume(std::string const & cp_in,
+                               std::vector<unsigned int> const & seeds,
+                               std::vector<double> const & tpnts,
+                               std::string const & cp_out = "");
+
+    %feature("autodoc", 
+"
+Run one realisation for each parameter set: set i takes the values 
+values[i * getNParams()] to values[(i + 1) * getNParams() - 1], in the 
+order the parameters were added, and runs with seed seeds[i]. The rate 
+constants are applied on top of the initial checkpoint in one pass, 
+so each worker thread reuses its solver for every set it runs. 
+Recording and cp_file are as for run().
+
+Syntax::
+
+    sweep(values, seeds, tpnts, cp_file = \"\")
+
+Arguments:
+    * list<float> values
+    * list<unsigned int> seeds
+    * list<float> tpnts
+    * string cp_file (default = \"\")
+
+Return:
+    list<float>
+");
+    std::vector<double> sweep(std::vector<double> const & values,
+                              std::vector<unsigned int> const & seeds,
+                              std::vector<double> const & tpnts,
+                              std::string const & cp_file = "");
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+class EnsembleFarm
+{
+
+public:
+    %feature("autodoc", 
+"
+Construction::
+
+    farm = steps.solver.EnsembleFarm(model, geom, init_file, nthreads, rng_name = \"mt19937\", rng_bufsize = 512, calcMembPot = False, scheduler = \"cr\")
+
+Create a farm that spreads the realisations of an ensemble over the 
+ranks of an MPI job. Every rank creates the same farm and calls run() 
+or sweep() with the same arguments. Each rank runs the seeds it is given 
+on an Ensemble with the other arguments. Rank 0 hands the seeds out in 
+chunks to whichever rank asks next, so realisations of uneven length do 
+not leave ranks idle. Rank 0 also runs chunks itself if the MPI library 
+allows calls from more than one thread. MPI is initialized if the 
+caller has not done so. Without MPI support the farm runs everything in 
+the calling process.
+
+Arguments:
+    * steps.model.Model model
+    * steps.geom.Geom geom
+    * string init_file
+    * unsigned int nthreads
+    * string rng_name (default = \"mt19937\")
+    * unsigned int rng_bufsize (default = 512)
+    * bool calcMembPot (default = False)
+    * string scheduler (default = \"cr\")
+");
+    EnsembleFarm(steps::model::Model * m, steps::wm::Geom * g,
+                 std::string const & init_file, unsigned int nthreads,
+                 std::string const & rng_name = "mt19937", unsigned int rng_bufsize = 512,
+                 bool calcMembPot = false, std::string const & scheduler = "cr");
+    %feature("autodoc", "1");
+    ~EnsembleFarm(void);
+
+    %feature("autodoc", 
+"
+Returns the rank of this process in the farm.
+
+Syntax::
+
+    getRank()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getRank(void) const;
+
+    %feature("autodoc", 
+"
+Returns the number of ranks of the farm.
+
+Syntax::
+
+    getNRanks()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getNRanks(void) const;
+
+    %feature("autodoc", 
+"
+Set the number of realisations handed to a rank at a time. 0 (the 
+default) hands out as many as the rank has threads. Larger chunks mean 
+fewer messages; smaller ones balance the load more finely.
+
+Syntax::
+
+    setChunk(n)
+
+Arguments:
+    * unsigned int n
+
+Return:
+    None
+");
+    void setChunk(unsigned int n);
+
+    %feature("autodoc", 
+"
+Returns the number of realisations handed to a rank at a time.
+
+Syntax::
+
+    getChunk()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getChunk(void) const;
+
+    %feature("autodoc", 
+"
+On rank 0 after a run, returns the number of realisations each rank 
+ran.
+
+Syntax::
+
+    getRankLoads()
+
+Arguments:
+    None
+
+Return:
+    list<float>
+");
+    std::vector<double> getRankLoads(void) const;
+
+    %feature("autodoc", 
+"
+Record the number of molecules of species s in compartment c at 
+each time point (see Ensemble).
+
+Syntax::
+
+    addCompCountRecord(c, s)
+
+Arguments:
+    * string c
+    * string s
+
+Return:
+    None
+");
+    void addCompCountRecord(std::string const & c, std::string const & s);
+
+    %feature("autodoc", 
+"
+Record the number of molecules of species s in patch p at 
+each time point (see Ensemble).
+
+Syntax::
+
+    addPatchCountRecord(p, s)
+
+Arguments:
+    * string p
+    * string s
+
+Return:
+    None
+");
+    void addPatchCountRecord(std::string const & p, std::string const & s);
+
+    %feature("autodoc", 
+"
+Returns the number of records.
+
+Syntax::
+
+    getNRecords()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getNRecords(void) const;
+
+    %feature("autodoc", 
+"
+Make the rate constant of reaction r in compartment c a parameter of 
+sweep() (see Ensemble).
+
+Syntax::
+
+    addCompReacKParam(c, r)
+
+Arguments:
+    * string c
+    * string r
+
+Return:
+    None
+");
+    void addCompReacKParam(std::string const & c, std::string const & r);
+
+    %feature("autodoc", 
+"
+Make the rate constant of surface reaction sr in patch p a parameter 
+of sweep() (see Ensemble).
+
+Syntax::
+
+    addPatchSReacKParam(p, sr)
+
+Arguments:
+    * string p
+    * string sr
+
+Return:
+    None
+");
+    void addPatchSReacKParam(std::string const & p, std::string const & sr);
+
+    %feature("autodoc", 
+"
+Returns the number of parameters of sweep().
+
+Syntax::
+
+    getNParams()
+
+Arguments:
+    None
+
+Return:
+    unsigned int
+");
+    unsigned int getNParams(void) const;
+
+    %feature("autodoc", 
+"
+Draw the realisations from non-overlapping streams of one master seed 
+(see Ensemble.setStreams).
+
+Syntax::
+
+    setStreams(on, master = 0)
+
+Arguments:
+    * bool on
+    * unsigned int master
+
+Return:
+    None
+");
+    void setStreams(bool on, unsigned int master = 0);
+
+    %feature("autodoc", 
+"
+Returns True if the seeds are stream numbers of a master seed.
+
+Syntax::
+
+    getStreams()
+
+Arguments:
+    None
+
+Return:
+    bool
+");
+    bool getStreams(void) const;
+
+    %feature("autodoc", 
+"
+Run one realisation for each seed over all ranks. On rank 0, returns 
+the recorded values in the layout of Ensemble.run. If h5_file is given, 
+also writes them to that HDF5 file:
+    * /data has a row per seed and time point, seed major, and a column 
+      per record.
+    * /time holds the time of each row.
+    * /seeds holds the seeds.
+The other ranks return an empty list. An error in any realisation is 
+raised on all ranks.
+
+Syntax::
+
+    run(seeds, tpnts, h5_file = \"\")
+
+Arguments:
+    * list<unsigned int> seeds
+    * list<float> tpnts
+    * string h5_file (default = \"\")
+
+Return:
+    list<float>
+");
+    std::vector<double> run(std::vector<unsigned int> const & seeds,
+                            std::vector<double> const & tpnts,
+                            std::string const & h5_file = "");
+
+    %feature("autodoc", 
+"
+Run one realisation for each parameter set over all ranks, as 
+Ensemble.sweep does. Output is as for run(), and the HDF5 file also 
+holds the parameter sets in /params.
+
+Syntax::
+
+    sweep(values, seeds, tpnts, h5_file = \"\")
+
+Arguments:
+    * list<float> values
+    * list<unsigned int> seeds
+    * list<float> tpnts
+    * string h5_file (default = \"\")
+
+Return:
+    list<float>
+");
+    std::vector<double> sweep(std::vector<double> const & values,
+                              std::vector<unsigned int> const & seeds,
+                              std::vector<double> const & tpnts,
+                              std::string const & h5_file = "");
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+	
+} // end namespace tetexact
+} // end namespace steps
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace steps
+{
+namespace tetode
+{
+
+class TetODE : public steps::solver::API
+{	
+
+public:
+
+    TetODE(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r);
+    ~TetODE(void);
+
+    %feature("autodoc", 
+"
+Returns a string of the solver's name.
+
+Syntax::
+
+    getSolverName()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverName(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string giving a short description of the solver.
+
+Syntax::
+
+    getSolverDesc()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverDesc(void) const;
+
+%feature("autodoc", 
+"
+Returns a string of the solver authors names.
+
+Syntax::
+
+    getSolverAuthors()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverAuthors(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string giving the author's email address.
+
+Syntax::
+
+    getSolverEmail()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverEmail(void) const;
+
+    %feature("autodoc", 
+"
+Checkpoint data to a file.
+
+Syntax::
+
+    checkpoint(file_name)
+
+Arguments:
+    string file_name
+
+Return:
+    None
+");
+    virtual void checkpoint(std::string const & file_name);
+
+    %feature("autodoc", 
+"
+Restore data from a file.
+
+Syntax::
+
+    restore(file_name)
+
+Arguments:
+    string file_name
+
+Return:
+    None
+");
+    virtual void restore(std::string const & file_name);
+
+%feature("autodoc", 
+"
+Reset the simulation to the state the solver was initialised to. 
+Typically, this resets all concentrations of all chemical species in 
+all elements (whether compartments and patches in a well-mixed solver 
+or tetrahedrons and triangles in a mesh-based solver) to zero, 
+resets the simulation time to zero and resets reaction (and diffusion) 
+rates to the default values described in the steps.model objects. 
+All reaction (and diffusion) rules are reset to active and all 
+compartment volumes and patch areas are reset to default values 
+described in steps.geom objects (for well-mixed solvers). 
+Usually, this method should be called before starting each simulation iteration.
+
+Syntax::
+
+    reset()
+
+Arguments:
+    None
+
+Return:
+    None
+");
+
+    %feature("autodoc", 
+"
+Reset the simulation to the state the solver was initialised to. 
+Typically, this resets all concentrations of all chemical species in 
+all elements (whether compartments and patches in a well-mixed solver 
+or tetrahedrons and triangles in a mesh-based solver) to zero, 
+resets the simulation time to zero and resets reaction (and diffusion) 
+rates to the default values described in the steps.model objects. 
+All reaction (and diffusion) rules are reset to active and all 
+compartment volumes and patch areas are reset to default values 
+described in steps.geom objects (for well-mixed solvers). 
+Usually, this method should be called before starting each simulation iteration.
+
+Syntax::
+
+    reset()
+
+Arguments:
+    None
+
+Return:
+    None
+");
+    virtual void reset(void);
+
+    %feature("autodoc", 
+"
+Advance the simulation until endtime (given in seconds) is reached. 
+The endtime must be larger or equal to the current simulation time.
+
+Syntax::
+
+    run(endtime)
+
+Arguments:
+    float endtime
+
+Return:
+    None
+");
+    virtual void run(double endtime);
+
+    %feature("autodoc", 
+"
+Returns the current simulation time in seconds.
+
+Syntax::
+
+    getTime()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    virtual double getTime(void) const;
+    
+%feature("autodoc", 
+"
+Sets the maximum number of steps in CVODE per call to run().
+Default is 10000 if this function is not called.
+             
+Syntax::
+             
+    setMaxNumSteps()
+             
+Arguments:
+    unsigned integer maxn
+             
+Return:
+    None
+");
+    void setMaxNumSteps(unsigned int maxn);
+
+%feature("autodoc", 
+"
+Set the absolute tolerance and the relative tolerance for CVODE. 
+When STEPS is built with STEPS_ODE_SINGLE=1 the state is in single 
+precision and the relative tolerance cannot be below 1e-5.
+             
+Syntax::
+             
+    setTolerance(atol, rtol)
+             
+Arguments:
+    float atol
+    float rtol
+             
+Return:
+    None
+");
+    void setTolerances(double atol, double rtol);
+
+%feature("autodoc", 
+"
+Select the CVODE method. With stiff set to True CVODE uses the 
+Backward Differentiation Formula with Newton iteration, solving the 
+linear systems with preconditioned GMRES (analytic Jacobian-vector 
+product, block-Jacobi preconditioner with one block per tetrahedron 
+and triangle). This allows much larger steps on stiff 
+reaction-diffusion systems. The default (False) is the Adams method 
+with functional iteration.
+             
+Syntax::
+             
+    setStiff(stiff)
+             
+Arguments:
+    bool stiff
+             
+Return:
+    None
+");
+    void setStiff(bool stiff);
+
+%feature("autodoc", 
+"
+Returns True if CVODE uses the stiff (BDF) method.
+             
+Syntax::
+             
+    getStiff()
+             
+Arguments:
+    None
+             
+Return:
+    bool
+");
+    bool getStiff(void) const;
+
+%feature("autodoc", 
+"
+Choose the preconditioner of the stiff mode's GMRES: 'block' (the 
+default) is the block-Jacobi one, 'direct' a sparse LU decomposition of 
+the whole Newton matrix, diffusion between elements included, after which 
+GMRES converges in one iteration. The decomposition's storage grows with 
+the envelope of the reordered matrix, so it is meant as a fallback when 
+GMRES converges poorly rather than for the largest meshes.
+             
+Syntax::
+             
+    setLinearSolver(solver)
+             
+Arguments:
+    string solver
+             
+Return:
+    None
+");
+    void setLinearSolver(std::string const & solver);
+
+%feature("autodoc", 
+"
+Returns the preconditioner of the stiff mode ('block' or 'direct').
+             
+Syntax::
+             
+    getLinearSolver()
+             
+Arguments:
+    None
+             
+Return:
+    string
+");
+    std::string getLinearSolver(void) const;
+
+%feature("autodoc", 
+"
+Set the number of OpenMP threads for the right-hand side, the 
+Jacobian-vector products, the preconditioner and CVODE's vector 
+operations. 0 (the default) uses the OpenMP default, normally one 
+thread per core. Systems with fewer than a few thousand species 
+always run on one thread. Has no effect unless STEPS was built with 
+OpenMP.
+             
+Syntax::
+             
+    setNThreads(n)
+             
+Arguments:
+    unsigned int n
+             
+Return:
+    None
+");
+    void setNThreads(unsigned int n);
+
+%feature("autodoc", 
+"
+Returns the requested number of OpenMP threads (0 for the OpenMP 
+default).
+             
+Syntax::
+             
+    getNThreads()
+             
+Arguments:
+    None
+             
+Return:
+    unsigned int
+");
+    unsigned int getNThreads(void) const;
+
+%feature("autodoc", 
+"
+Returns a hash, as 16 hexadecimal digits, of the simulation time and 
+the state vector. CVODE's dot products and norms are summed over fixed 
+blocks of rows in a fixed order, so the same model gives the same hash 
+with any number of threads.
+             
+Syntax::
+             
+    getStateHash()
+             
+Arguments:
+    None
+             
+Return:
+    string
+");
+    std::string getStateHash(void) const;
+
+%feature("autodoc", 
+"
+Set the counts to the steady state reached from the current state, 
+without advancing the simulation time. Newton's method is tried first, 
+with the sparse Jacobian of the whole system, diffusion included, 
+decomposed as for the 'direct' linear solver; pseudo-transient 
+continuation (implicit Euler steps that grow as the rates fall) if that 
+fails. Converges within the tolerances set with setTolerances; conserved 
+totals keep their values. Raises an exception and leaves the state 
+unchanged if no steady state is found.
+             
+Syntax::
+             
+    steadyState()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+    void steadyState(void);
+
+////////////////////////////////////////////////////////////////////////			
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace tetode
+} // end namespace steps
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace steps
+{
+namespace hybrid
+{
+
+class Hybrid : public steps::solver::API
+{	
+
+public:
+
+    Hybrid(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+           std::string const & scheduler = "cr");
+    ~Hybrid(void);
+
+    %feature("autodoc", 
+"
+Returns a string of the solver's name.
+
+Syntax::
+
+    getSolverName()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverName(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string giving a short description of the solver.
+
+Syntax::
+
+    getSolverDesc()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverDesc(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string of the solver authors names.
+
+Syntax::
+
+    getSolverAuthors()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverAuthors(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string giving the author's email address.
+
+Syntax::
+
+    getSolverEmail()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverEmail(void) const;
+
+    %feature("autodoc", 
+"
+Advance the simulation until endtime (given in seconds) is reached. 
+The endtime must be larger or equal to the current simulation time.
+The stochastic and deterministic parts are advanced in turn over 
+windows of at most the synchronisation window (see setSyncDT).
+
+Syntax::
+
+    run(endtime)
+
+Arguments:
+    float endtime
+
+Return:
+    None
+");
+    virtual void run(double endtime);
+
+    %feature("autodoc", 
+"
+Advance the simulation for adv seconds.
+
+Syntax::
+
+    advance(adv)
+
+Arguments:
+    float adv
+
+Return:
+    None
+");
+    virtual void advance(double adv);
+
+    %feature("autodoc", 
+"
+Returns the current simulation time in seconds.
+
+Syntax::
+
+    getTime()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    virtual double getTime(void) const;
+
+    %feature("autodoc", 
+"
+Treat species s deterministically (True), with the TetODE right hand 
+side, or stochastically (False), with the Tetexact SSA. Reactions, 
+surface reactions and diffusion rules whose species are all 
+deterministic are integrated by the ODE solver; every other process 
+is simulated by the SSA. The current state of the species is handed 
+over to the solver that now owns it. All species start stochastic.
+
+Syntax::
+
+    setSpecDeterministic(s, det)
+
+Arguments:
+    * string s
+    * bool det
+
+Return:
+    None
+");
+    void setSpecDeterministic(std::string const & s, bool det);
+
+    %feature("autodoc", 
+"
+Returns True if species s is treated deterministically.
+
+Syntax::
+
+    getSpecDeterministic(s)
+
+Arguments:
+    string s
+
+Return:
+    bool
+");
+    bool getSpecDeterministic(std::string const & s) const;
+
+    %feature("autodoc", 
+"
+Make every species whose mean count per tetrahedron or triangle, over 
+the elements it is defined in, is at least threshold deterministic 
+and every other species stochastic.
+
+Syntax::
+
+    selectDeterministic(threshold)
+
+Arguments:
+    float threshold
+
+Return:
+    None
+");
+    void selectDeterministic(double threshold);
+
+    %feature("autodoc", 
+"
+Set the synchronisation window in seconds (default 1.0e-4). At the 
+start of each window the deterministic species that take part in 
+stochastic processes are copied into the SSA, at its end the changes 
+the SSA made to them are added to the ODE state. It should be short 
+compared to the time these species take to change appreciably.
+
+Syntax::
+
+    setSyncDT(dt)
+
+Arguments:
+    float dt
+
+Return:
+    None
+");
+    void setSyncDT(double dt);
+
+    %feature("autodoc", 
+"
+Returns the synchronisation window in seconds.
+
+Syntax::
+
+    getSyncDT()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    double getSyncDT(void) const;
+
+    %feature("autodoc", 
+"
+Set the absolute and relative tolerances of the ODE solver 
+(see TetODE.setTolerances).
+
+Syntax::
+
+    setTolerances(atol, rtol)
+
+Arguments:
+    * float atol
+    * float rtol
+
+Return:
+    None
+");
+    void setTolerances(double atol, double rtol);
+
+    %feature("autodoc", 
+"
+Set the maximum number of CVODE steps per run of the ODE solver.
+
+Syntax::
+
+    setMaxNumSteps(maxn)
+
+Arguments:
+    uint maxn
+
+Return:
+    None
+");
+    void setMaxNumSteps(uint maxn);
+
+    %feature("autodoc", 
+"
+Select the stiff (BDF) method of the ODE solver (see TetODE.setStiff).
+
+Syntax::
+
+    setStiff(stiff)
+
+Arguments:
+    bool stiff
+
+Return:
+    None
+");
+    void setStiff(bool stiff);
+
+////////////////////////////////////////////////////////////////////////			
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Wmhybrid : public steps::solver::API
+{	
+
+public:
+
+    Wmhybrid(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+             std::string const & scheduler = "direct");
+    ~Wmhybrid(void);
+
+    %feature("autodoc", 
+"
+Returns a string of the solver's name.
+
+Syntax::
+
+    getSolverName()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverName(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string giving a short description of the solver.
+
+Syntax::
+
+    getSolverDesc()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverDesc(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string of the solver authors names.
+
+Syntax::
+
+    getSolverAuthors()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverAuthors(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string giving the author's email address.
+
+Syntax::
+
+    getSolverEmail()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverEmail(void) const;
+
+    %feature("autodoc", 
+"
+Reset the simulation to the state the solver was initialised to. 
+All reactions are active and slow again.
+
+Syntax::
+
+    reset()
+
+Arguments:
+    None
+
+Return:
+    None
+");
+    virtual void reset(void);
+
+    %feature("autodoc", 
+"
+Advance the simulation until endtime (given in seconds) is reached. 
+The endtime must be larger or equal to the current simulation time. 
+At the start of each synchronisation window (see setSyncDT) the 
+reactions are classed again: a reaction expected to fire at least 
+the fast threshold number of times in the window (see 
+setFastThreshold) is integrated by Wmrk4, every other reaction is 
+simulated by Wmdirect.
+
+Syntax::
+
+    run(endtime)
+
+Arguments:
+    float endtime
+
+Return:
+    None
+");
+    virtual void run(double endtime);
+
+    %feature("autodoc", 
+"
+Advance the simulation for adv seconds.
+
+Syntax::
+
+    advance(adv)
+
+Arguments:
+    float adv
+
+Return:
+    None
+");
+    virtual void advance(double adv);
+
+    %feature("autodoc", 
+"
+Returns the current simulation time in seconds.
+
+Syntax::
+
+    getTime()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    virtual double getTime(void) const;
+
+    %feature("autodoc", 
+"
+Set the synchronisation window in seconds (default 1.0e-4). The 
+reactions are classed again at the start of each window, and the 
+changes made by the slow reactions are added to the continuous 
+state at its end.
+
+Syntax::
+
+    setSyncDT(dt)
+
+Arguments:
+    float dt
+
+Return:
+    None
+");
+    void setSyncDT(double dt);
+
+    %feature("autodoc", 
+"
+Returns the synchronisation window in seconds.
+
+Syntax::
+
+    getSyncDT()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    double getSyncDT(void) const;
+
+    %feature("autodoc", 
+"
+Set the expected number of firings per synchronisation window from 
+which a reaction is treated as fast (default 100).
+
+Syntax::
+
+    setFastThreshold(n)
+
+Arguments:
+    float n
+
+Return:
+    None
+");
+    void setFastThreshold(double n);
+
+    %feature("autodoc", 
+"
+Returns the fast reaction threshold.
+
+Syntax::
+
+    getFastThreshold()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    double getFastThreshold(void) const;
+
+    %feature("autodoc", 
+"
+Returns the number of reactions and surface reactions that were 
+fast in the last synchronisation window.
+
+Syntax::
+
+    getNFast()
+
+Arguments:
+    None
+
+Return:
+    uint
+");
+    uint getNFast(void) const;
+
+    %feature("autodoc", 
+"
+Use the adaptive (True, the default here) or the fixed step 
+Runge-Kutta method for the fast reactions (see Wmrk4.setAdaptive).
+
+Syntax::
+
+    setAdaptive(adapt)
+
+Arguments:
+    bool adapt
+
+Return:
+    None
+");
+    void setAdaptive(bool adapt);
+
+    %feature("autodoc", 
+"
+Select the stiff method for the fast reactions (see Wmrk4.setStiff).
+
+Syntax::
+
+    setStiff(stiff)
+
+Arguments:
+    bool stiff
+
+Return:
+    None
+");
+    void setStiff(bool stiff);
+
+    %feature("autodoc", 
+"
+Set the absolute and relative tolerances of the adaptive method 
+(see Wmrk4.setTolerances).
+
+Syntax::
+
+    setTolerances(atol, rtol)
+
+Arguments:
+    * float atol
+    * float rtol
+
+Return:
+    None
+");
+    void setTolerances(double atol, double rtol);
+
+////////////////////////////////////////////////////////////////////////			
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace hybrid
+} // end namespace steps
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace steps
+{
+namespace voxel
+{
+
+class Voxel : public steps::solver::API
+{	
+
+public:
+
+    Voxel(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+          uint nx, uint ny, uint nz);
+    ~Voxel(void);
+
+    %feature("autodoc", 
 "
-Saves the vertex optimization in the Efield structure.
-             
+Returns a string of the solver's name.
+
 Syntax::
-             
-    saveMembOpt()
-             
+
+    getSolverName()
+
 Arguments:
-    string filename
-             
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverName(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string giving a short description of the solver.
+
+Syntax::
+
+    getSolverDesc()
+
+Arguments:
+    None
+
 Return:
+    string
+");
+    virtual std::string getSolverDesc(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string of the solver authors names.
+
+Syntax::
+
+    getSolverAuthors()
+
+Arguments:
     None
+
+Return:
+    string
 ");
-    void saveMembOpt(std::string const & opt_file_name);
-	
-	////////////////////////////////////////////////////////////////////////			
-	
+    virtual std::string getSolverAuthors(void) const;
+
+    %feature("autodoc", 
+"
+Returns a string giving the author's email address.
+
+Syntax::
+
+    getSolverEmail()
+
+Arguments:
+    None
+
+Return:
+    string
+");
+    virtual std::string getSolverEmail(void) const;
+
+    %feature("autodoc", 
+"
+Reset the simulation to the state the solver was initialised to. 
+Typically, this resets all species counts to zero and all diffusion 
+rules to active.
+
+Syntax::
+
+    reset()
+
+Arguments:
+    None
+
+Return:
+    None
+");
+    virtual void reset(void);
+
+    %feature("autodoc", 
+"
+Advance the simulation until endtime (given in seconds) is reached. 
+The endtime must be larger or equal to the current simulation time.
+
+Syntax::
+
+    run(endtime)
+
+Arguments:
+    * float endtime
+
+Return:
+    None
+");
+    virtual void run(double endtime);
+
+    %feature("autodoc", 
+"
+Advance the simulation for the given time (in seconds).
+
+Syntax::
+
+    advance(adv)
+
+Arguments:
+    * float adv
+
+Return:
+    None
+");
+    virtual void advance(double adv);
+
+    %feature("autodoc", 
+"
+Fire the next event.
+
+Syntax::
+
+    step()
+
+Arguments:
+    None
+
+Return:
+    None
+");
+    virtual void step(void);
+
+    %feature("autodoc", 
+"
+Returns the current simulation time in seconds.
+
+Syntax::
+
+    getTime()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    virtual double getTime(void) const;
+
+    %feature("autodoc", 
+"
+Returns the total propensity of the current simulation state.
+
+Syntax::
+
+    getA0()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    virtual double getA0(void) const;
+
+    %feature("autodoc", 
+"
+Returns the number of events that have been fired since the last reset.
+
+Syntax::
+
+    getNSteps()
+
+Arguments:
+    None
+
+Return:
+    int
+");
+    virtual uint getNSteps(void) const;
+
+    %feature("autodoc", 
+"
+Returns the number of voxels of each compartment, nx * ny * nz. 
+Voxel (i, j, k) has index i + nx * (j + ny * k).
+
+Syntax::
+
+    getNVoxels()
+
+Arguments:
+    None
+
+Return:
+    int
+");
+    uint getNVoxels(void) const;
+
+    %feature("autodoc", 
+"
+Returns the number of faces of each patch, the voxel sides on the 
+walls of the grid: first those at i = 0 and i = nx - 1, then those 
+at j = 0 and j = ny - 1, then those at k = 0 and k = nz - 1.
+
+Syntax::
+
+    getNFaces()
+
+Arguments:
+    None
+
+Return:
+    int
+");
+    uint getNFaces(void) const;
+
+    %feature("autodoc", 
+"
+Returns the edge length of the voxels of compartment c (in m), the 
+cube root of its volume divided by the number of voxels.
+
+Syntax::
+
+    getVoxelSize(c)
+
+Arguments:
+    * string c
+
+Return:
+    float
+");
+    double getVoxelSize(std::string const & c) const;
+
+    %feature("autodoc", 
+"
+Returns the number of molecules of species s in voxel vox of 
+compartment c.
+
+Syntax::
+
+    getCompVoxelCount(c, s, vox)
+
+Arguments:
+    * string c
+    * string s
+    * uint vox
+
+Return:
+    float
+");
+    double getCompVoxelCount(std::string const & c, std::string const & s,
+                             uint vox) const;
+
+    %feature("autodoc", 
+"
+Sets the number of molecules of species s in voxel vox of 
+compartment c. A fractional part adds one molecule with that 
+probability.
+
+Syntax::
+
+    setCompVoxelCount(c, s, vox, n)
+
+Arguments:
+    * string c
+    * string s
+    * uint vox
+    * float n
+
+Return:
+    None
+");
+    void setCompVoxelCount(std::string const & c, std::string const & s,
+                           uint vox, double n);
+
+    %feature("autodoc", 
+"
+Returns the number of molecules of species s on face face of patch p.
+
+Syntax::
+
+    getPatchFaceCount(p, s, face)
+
+Arguments:
+    * string p
+    * string s
+    * uint face
+
+Return:
+    float
+");
+    double getPatchFaceCount(std::string const & p, std::string const & s,
+                             uint face) const;
+
+    %feature("autodoc", 
+"
+Sets the number of molecules of species s on face face of patch p. 
+A fractional part adds one molecule with that probability.
+
+Syntax::
+
+    setPatchFaceCount(p, s, face, n)
+
+Arguments:
+    * string p
+    * string s
+    * uint face
+    * float n
+
+Return:
+    None
+");
+    void setPatchFaceCount(std::string const & p, std::string const & s,
+                           uint face, double n);
+
+////////////////////////////////////////////////////////////////////////			
+
 };
-	
+
 ////////////////////////////////////////////////////////////////////////////////
-	
-} // end namespace tetexact
-} // end namespace steps
 
+} // end namespace voxel
+} // end namespace steps
 
 ////////////////////////////////////////////////////////////////////////////////
 
 namespace steps
 {
-namespace tetode
+namespace tetleap
 {
 
-class TetODE : public steps::solver::API
+class Tetleap : public steps::solver::API
 {	
 
 public:
 
-    TetODE(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r);
-    ~TetODE(void);
+    Tetleap(steps::model::Model * m, steps::wm::Geom * g, steps::rng::RNG * r,
+            double tau, uint nthreads = 1);
+    ~Tetleap(void);
 
     %feature("autodoc", 
 "
@@ -3263,7 +9644,7 @@ Return:
 ");
     virtual std::string getSolverDesc(void) const;
 
-%feature("autodoc", 
+    %feature("autodoc", 
 "
 Returns a string of the solver authors names.
 
@@ -3297,14 +9678,14 @@ Return:
 
     %feature("autodoc", 
 "
-Checkpoint data to a file.
+Checkpoint the species counts and diffusion rule states to a file.
 
 Syntax::
 
     checkpoint(file_name)
 
 Arguments:
-    string file_name
+    * string file_name
 
 Return:
     None
@@ -3313,32 +9694,26 @@ Return:
 
     %feature("autodoc", 
 "
-Restore data from a file.
+Restore the species counts and diffusion rule states from a 
+checkpoint file.
 
 Syntax::
 
     restore(file_name)
 
 Arguments:
-    string file_name
+    * string file_name
 
 Return:
     None
 ");
     virtual void restore(std::string const & file_name);
 
-%feature("autodoc", 
+    %feature("autodoc", 
 "
 Reset the simulation to the state the solver was initialised to. 
-Typically, this resets all concentrations of all chemical species in 
-all elements (whether compartments and patches in a well-mixed solver 
-or tetrahedrons and triangles in a mesh-based solver) to zero, 
-resets the simulation time to zero and resets reaction (and diffusion) 
-rates to the default values described in the steps.model objects. 
-All reaction (and diffusion) rules are reset to active and all 
-compartment volumes and patch areas are reset to default values 
-described in steps.geom objects (for well-mixed solvers). 
-Usually, this method should be called before starting each simulation iteration.
+Typically, this resets all species counts to zero and all diffusion 
+rules to active.
 
 Syntax::
 
@@ -3350,48 +9725,57 @@ Arguments:
 Return:
     None
 ");
+    virtual void reset(void);
 
     %feature("autodoc", 
 "
-Reset the simulation to the state the solver was initialised to. 
-Typically, this resets all concentrations of all chemical species in 
-all elements (whether compartments and patches in a well-mixed solver 
-or tetrahedrons and triangles in a mesh-based solver) to zero, 
-resets the simulation time to zero and resets reaction (and diffusion) 
-rates to the default values described in the steps.model objects. 
-All reaction (and diffusion) rules are reset to active and all 
-compartment volumes and patch areas are reset to default values 
-described in steps.geom objects (for well-mixed solvers). 
-Usually, this method should be called before starting each simulation iteration.
+Advance the simulation until endtime (given in seconds) is reached, 
+by leaps of length tau, the last one shortened to end on endtime. 
+The endtime must be larger or equal to the current simulation time.
 
 Syntax::
 
-    reset()
+    run(endtime)
 
 Arguments:
+    * float endtime
+
+Return:
     None
+");
+    virtual void run(double endtime);
+
+    %feature("autodoc", 
+"
+Advance the simulation for the given time (in seconds).
+
+Syntax::
+
+    advance(adv)
+
+Arguments:
+    * float adv
 
 Return:
     None
 ");
-    virtual void reset(void);
+    virtual void advance(double adv);
 
     %feature("autodoc", 
 "
-Advance the simulation until endtime (given in seconds) is reached. 
-The endtime must be larger or equal to the current simulation time.
+Take a single leap of length tau.
 
 Syntax::
 
-    run(endtime)
+    step()
 
 Arguments:
-    float endtime
+    None
 
 Return:
     None
 ");
-    virtual void run(double endtime);
+    virtual void step(void);
 
     %feature("autodoc", 
 "
@@ -3408,46 +9792,282 @@ Return:
     float
 ");
     virtual double getTime(void) const;
-    
+
+    %feature("autodoc", 
+"
+Returns the number of reaction and diffusion events of the leaps 
+since the last reset.
+
+Syntax::
+
+    getNSteps()
+
+Arguments:
+    None
+
+Return:
+    int
+");
+    virtual uint getNSteps(void) const;
+
+    %feature("autodoc", 
+"
+Sets the length of the leaps (in s). Each diffusion rule should 
+leave only a small fraction of the molecules of a tetrahedron in 
+a leap: leaps that are too long slow down the spread of molecules.
+
+Syntax::
+
+    setTau(tau)
+
+Arguments:
+    * float tau
+
+Return:
+    None
+");
+    void setTau(double tau);
+
+    %feature("autodoc", 
+"
+Returns the length of the leaps (in s).
+
+Syntax::
+
+    getTau()
+
+Arguments:
+    None
+
+Return:
+    float
+");
+    double getTau(void) const;
+
+    %feature("autodoc", 
+"
+Sets the number of threads the leaps run on. The results do not 
+depend on it.
+
+Syntax::
+
+    setThreads(n)
+
+Arguments:
+    * uint n
+
+Return:
+    None
+");
+    void setThreads(uint n);
+
+    %feature("autodoc", 
+"
+Returns the number of threads the leaps run on.
+
+Syntax::
+
+    getThreads()
+
+Arguments:
+    None
+
+Return:
+    int
+");
+    uint getThreads(void) const;
+
+////////////////////////////////////////////////////////////////////////			
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace tetleap
+} // end namespace steps
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace steps
+{
+
 %feature("autodoc", 
 "
-Sets the maximum number of steps in CVODE per call to run().
-Default is 10000 if this function is not called.
+Turn the trace markers of the solvers on or off (default off). While 
+on, each run, EField step, membrane current computation, recorder 
+sample and checkpoint is logged with its begin and end time, keeping 
+the most recent capacity events. Turning tracing on clears the log.
              
 Syntax::
              
-    setMaxNumSteps()
+    setTracing(on, capacity = 65536)
              
 Arguments:
-    unsigned integer maxn
+    * bool on
+    * uint capacity
              
 Return:
     None
 ");
-    void setMaxNumSteps(unsigned int maxn);
+void setTracing(bool on, unsigned int capacity = 65536);
 
 %feature("autodoc", 
 "
-Set the absolute tolerance and the relative tolerance for CVODE.
+Returns True if the trace markers are on.
              
 Syntax::
              
-    setTolerance(atol, rtol)
+    getTracing()
              
 Arguments:
-    float atol
-    float rtol
+    None
              
 Return:
+    bool
+");
+bool getTracing(void);
+
+%feature("autodoc", 
+"
+Returns the number of events in the trace log.
+             
+Syntax::
+             
+    getTraceCount()
+             
+Arguments:
     None
+             
+Return:
+    uint
 ");
-    void setTolerances(double atol, double rtol);
+unsigned int getTraceCount(void);
 
-////////////////////////////////////////////////////////////////////////			
+%feature("autodoc", 
+"
+Empties the trace log.
+             
+Syntax::
+             
+    clearTrace()
+             
+Arguments:
+    None
+             
+Return:
+    None
+");
+void clearTrace(void);
 
-};
+%feature("autodoc", 
+"
+Writes the trace log to a file in the trace event format read by 
+chrome://tracing and Perfetto, oldest event first. Timestamps are 
+CLOCK_MONOTONIC microseconds.
+             
+Syntax::
+             
+    writeTrace(file_name)
+             
+Arguments:
+    string file_name
+             
+Return:
+    None
+");
+void writeTrace(std::string const & file_name);
 
-////////////////////////////////////////////////////////////////////////////////
+%feature("autodoc", 
+"
+Pins thread t of the thread-parallel solver loops (such as the clusters 
+of Tetexact.setClusters()) to CPU cpus[t % len(cpus)], or stops pinning 
+if cpus is empty (the default). A pinned thread keeps its CPU, and so its 
+NUMA node, from one loop to the next, so the memory it set up stays 
+local to it. Only has an effect on Linux. The OpenMP threads of TetODE 
+are pinned with the OMP_PROC_BIND and OMP_PLACES environment variables 
+instead.
+             
+Syntax::
+             
+    setParallelCPUs(cpus)
+             
+Arguments:
+    list<uint> cpus
+             
+Return:
+    None
+");
+void setParallelCPUs(std::vector<unsigned int> const & cpus);
+
+%feature("autodoc", 
+"
+Returns the CPUs set with setParallelCPUs().
+             
+Syntax::
+             
+    getParallelCPUs()
+             
+Arguments:
+    None
+             
+Return:
+    list<uint>
+");
+std::vector<unsigned int> getParallelCPUs(void);
+
+%feature("autodoc", 
+"
+Chooses the instruction set of the vectorized kernels (random number 
+generation, mesh geometry): \"auto\" for the best one the CPU supports, 
+which is the default, or one of \"generic\", \"sse2\", \"avx2\" and 
+\"avx512\". All of them give the same results, bit for bit, so this 
+only changes the speed. The default can also be set with the 
+environment variable STEPS_SIMD. Only builds with GCC on x86 have 
+kernels other than \"generic\".
+             
+Syntax::
+             
+    setSimd(name)
+             
+Arguments:
+    string name
+             
+Return:
+    None
+");
+void setSimd(std::string const & name);
+
+%feature("autodoc", 
+"
+Returns the name of the instruction set the vectorized kernels run with.
+             
+Syntax::
+             
+    getSimd()
+             
+Arguments:
+    None
+             
+Return:
+    string
+");
+std::string getSimd(void);
+
+%feature("autodoc", 
+"
+Returns the names of the instruction sets this build and CPU support, 
+from \"generic\" up.
+             
+Syntax::
+             
+    getSimdSupported()
+             
+Arguments:
+    None
+             
+Return:
+    list<string>
+");
+std::vector<std::string> getSimdSupported(void);
 
-} // end namespace tetode
 } // end namespace steps
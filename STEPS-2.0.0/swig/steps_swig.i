@@ -27,4 +27,5 @@
 %include "model.i"
 %include "geom.i"
 %include "rng.i"
-%include "solver.i"
\ No newline at end of file
+%include "solver.i"
+%include "sbml.i"
\ No newline at end of file
@@ -40,8 +40,12 @@
  *     #define SUNDIALS_SINGLE_PRECISION 1
  *     #define SUNDIALS_DOUBLE_PRECISION 1
  *     #define SUNDIALS_EXTENDED_PRECISION 1
+ * STEPS builds with SUNDIALS_SINGLE_PRECISION defined on the command
+ * line for the single precision state of the ODE solvers.
  */
+#if !defined(SUNDIALS_SINGLE_PRECISION)
 #define SUNDIALS_DOUBLE_PRECISION 1
+#endif
 
 /* Use generic math functions 
  * If it was decided that generic math functions can be used, then